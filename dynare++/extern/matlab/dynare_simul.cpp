@@ -10,22 +10,159 @@
 //      nforw
 //      nexog
 //      ystart   starting value (full vector of endogenous)
-//      shocks   matrix of shocks (nexog x number of period)
+//      shocks   matrix of shocks (nexog x number of period), or array
+//               of shocks (nexog x number of periods x number of paths)
 //      vcov     covariance matrix of shocks (nexog x nexog)
 //      seed     integer seed
 //      ysteady  full vector of decision rule's steady
 //      ...      order+1 matrices of derivatives
+//      options  optional structure with the fields
+//               pruning      if true, the simulation is pruned (default false)
+//               num_threads  number of threads for more paths (default 2)
 
 // output:
-//      res      simulated results
+//      res      simulated results (ny x number of periods, or ny x number
+//               of periods x number of paths)
+
+// The paths are simulated by the threads in batches, the shocks of path j
+// (from zero) which are not finite are drawn from the stream j of the seed.
+// With a matrix of shocks (one path), the shocks are drawn from the seed.
+//
+// The pruned simulation splits the deviations from the steady state into
+// the components of orders 1 to order. The component of order m gets the
+// terms of the decision rule whose arguments are components with orders
+// summing to m (the shocks are of order 1), and the constant goes to the
+// second order (to the first one if order is 1). So the higher order terms
+// act on the lower order dynamics only, and do not explode (Kim, Kim,
+// Schaumburg and Sims, 2008; Andreasen, Fernandez-Villaverde and
+// Rubio-Ramirez, 2018).
 
 #include "dynmex.h"
 #include "mex.h"
+#include "tl_mxarray.hh"
 
 #include "decision_rule.h"
 #include "fs_tensor.h"
+#include "rfs_tensor.h"
+#include "sthread.h"
 #include "SylvException.h"
 
+#include <vector>
+
+// Pruned simulation of the polynomial pol (in deviations from ysteady) to
+// the columns of res
+static void
+simulate_pruned(const UTensorPolynomial& pol, const PartitionY& ypart, int nu,
+				const ConstVector& ysteady, const ConstVector& ystart,
+				ShockRealization& sr, TwoDMatrix& res)
+{
+	int order = pol.getMaxDim();
+	int nys = ypart.nys();
+	int np = res.ncols();
+	// states and shocks of the components, and their next values
+	TwoDMatrix z(nys+nu, order);
+	TwoDMatrix y(ypart.ny(), order);
+	z.zeros();
+	Vector z1(z, 0);
+	Vector dy(z1, 0, nys);
+	Vector u(z1, nys, nu);
+	dy = ConstVector(ystart, ypart.nstat, nys);
+	dy.add(-1.0, ConstVector(ysteady, ypart.nstat, nys));
+	int cord = (order < 2) ? order : 2;
+	res.zeros();
+	for (int t = 0; t < np; t++) {
+		sr.get(t, u);
+		y.zeros();
+		for (int m = 1; m <= order; m++) {
+			Vector ym(y, m-1);
+			if (m == cord && pol.check(Symmetry(0)))
+				ym.add(1.0, pol.get(Symmetry(0))->getData());
+			// go through the orders of d arguments summing to m, this
+			// is 1 plus the items of symmetries of dimension m-d
+			for (int d = 1; d <= m; d++) {
+				if (! pol.check(Symmetry(d)))
+					continue;
+				const UFSTensor* g = pol.get(Symmetry(d));
+				SymmetrySet ss(m-d, d);
+				for (symiterator si(ss); !si.isEnd(); ++si) {
+					std::vector<ConstVector> args;
+					for (int i = 0; i < d; i++)
+						args.push_back(ConstVector(z, (*si)[i]));
+					URSingleTensor kr(args);
+					g->multaVec(ym, kr.getData());
+				}
+			}
+		}
+		Vector out(res, t);
+		out = ysteady;
+		for (int m = 0; m < order; m++)
+			out.add(1.0, ConstVector(y, m));
+		if (t > 0 && ! out.isFinite())
+			break;
+		for (int m = 0; m < order; m++) {
+			Vector zm(z, m);
+			Vector zs(zm, 0, nys);
+			zs = ConstVector(ConstVector(y, m), ypart.nstat, nys);
+		}
+	}
+}
+
+// Simulates the paths first, ..., first+num-1 to their slots in res
+class SimulWorker : public THREAD {
+	const UnfoldDecisionRule& dr;
+	const UTensorPolynomial& pol;
+	const TwoDMatrix& vcov;
+	const ConstVector ystart;
+	double* shocks;
+	double* res;
+	int nper;
+	int first;
+	int num;
+	int seed;
+	bool streams;
+	bool pruning;
+	bool& failed;
+public:
+	SimulWorker(const UnfoldDecisionRule& d, const UTensorPolynomial& p,
+				const TwoDMatrix& v, const ConstVector& ys, double* sh,
+				double* r, int np, int f, int n, int s, bool str, bool pr,
+				bool& fail)
+		: dr(d), pol(p), vcov(v), ystart(ys), shocks(sh), res(r), nper(np),
+		  first(f), num(n), seed(s), streams(str), pruning(pr), failed(fail) {}
+	void operator()();
+};
+
+void SimulWorker::operator()()
+{
+	int nexog = dr.nexog();
+	int ny = dr.getYPart().ny();
+	std::vector<ShockRealization*> srs(num, (ShockRealization*)NULL);
+	std::vector<TwoDMatrix*> res_mats(num, (TwoDMatrix*)NULL);
+	try {
+		for (int j = 0; j < num; j++) {
+			TwoDMatrix sh(nexog, nper, shocks+(first+j)*nexog*nper);
+			int s = streams ? (int)MersenneTwister::streamSeed(seed, first+j) : seed;
+			srs[j] = new GenShockRealization(vcov, sh, s);
+			res_mats[j] = new TwoDMatrix(ny, nper, res+(first+j)*ny*nper);
+		}
+		if (pruning) {
+			for (int j = 0; j < num; j++)
+				simulate_pruned(pol, dr.getYPart(), nexog, dr.getSteady(), ystart,
+								*(srs[j]), *(res_mats[j]));
+		} else {
+			Vector st(ystart);
+			dr.simulateBatch(st, num, &(srs[0]), &(res_mats[0]));
+		}
+	} catch (...) {
+		SYNCHRO syn(&failed, "simulation");
+		failed = true;
+	}
+	for (int j = 0; j < num; j++) {
+		delete srs[j];
+		delete res_mats[j];
+	}
+}
+
 extern "C" {
 	void mexFunction(int nlhs, mxArray* plhs[],
 					 int nhrs, const mxArray* prhs[])
@@ -34,8 +171,24 @@ extern "C" {
                   DYN_MEX_FUNC_ERR_MSG_TXT("dynare_simul_ must have at least 12 input parameters and exactly 2 output arguments.\n");
 
 		int order = (int)mxGetScalar(prhs[0]);
-		if (nhrs != 12 + order)
-                  DYN_MEX_FUNC_ERR_MSG_TXT("dynare_simul_ must have exactly 11+order input parameters.\n");
+		if (nhrs != 12 + order && nhrs != 13 + order)
+                  DYN_MEX_FUNC_ERR_MSG_TXT("dynare_simul_ must have exactly 12+order or 13+order input parameters.\n");
+
+		bool pruning = false;
+		int num_threads = THREAD_GROUP::max_parallel_threads;
+		if (nhrs == 13 + order) {
+			const mxArray* const options = prhs[12+order];
+			if (!mxIsStruct(options))
+				DYN_MEX_FUNC_ERR_MSG_TXT("options must be a structure.\n");
+			const mxArray* fld = mxGetField(options, 0, "pruning");
+			if (fld != NULL && mxGetNumberOfElements(fld) > 0)
+				pruning = (mxGetScalar(fld) != 0);
+			fld = mxGetField(options, 0, "num_threads");
+			if (fld != NULL && mxGetNumberOfElements(fld) > 0)
+				num_threads = (int)mxGetScalar(fld);
+			if (num_threads < 1)
+				DYN_MEX_FUNC_ERR_MSG_TXT("num_threads must be positive.\n");
+		}
 
 		int nstat = (int)mxGetScalar(prhs[1]);
 		int npred = (int)mxGetScalar(prhs[2]);
@@ -50,6 +203,7 @@ extern "C" {
 		const mxArray* const ysteady = prhs[10];
 		const mwSize* const ystart_dim = mxGetDimensions(ystart);
 		const mwSize* const shocks_dim = mxGetDimensions(shocks);
+		int shocks_ndim = (int) mxGetNumberOfDimensions(shocks);
 		const mwSize* const vcov_dim = mxGetDimensions(vcov);
 		const mwSize* const ysteady_dim = mxGetDimensions(ysteady);
 
@@ -59,6 +213,9 @@ extern "C" {
 		if (1 != ystart_dim[1])
 			DYN_MEX_FUNC_ERR_MSG_TXT("ystart has wrong number of cols.\n");
 		int nper = shocks_dim[1];
+		if (shocks_ndim > 3)
+			DYN_MEX_FUNC_ERR_MSG_TXT("shocks has more than 3 dimensions.\n");
+		int nsim = (shocks_ndim == 3) ? (int) shocks_dim[2] : 1;
 		if (nexog != (int) shocks_dim[0])
 			DYN_MEX_FUNC_ERR_MSG_TXT("shocks has a wrong number of rows.\n");
 		if (nexog != (int) vcov_dim[0])
@@ -70,7 +227,8 @@ extern "C" {
 		if (1 != ysteady_dim[1])
 			DYN_MEX_FUNC_ERR_MSG_TXT("ysteady has wrong number of cols.\n");
 
-		mxArray* res = mxCreateDoubleMatrix(ny, nper, mxREAL);
+		mwSize res_dim[3] = {(mwSize) ny, (mwSize) nper, (mwSize) nsim};
+		mxArray* res = mxCreateNumericArray(shocks_ndim, res_dim, mxDOUBLE_CLASS, mxREAL);
 
 		try {
 			// initialize tensor library
@@ -95,8 +253,7 @@ extern "C" {
 					DYN_MEX_FUNC_ERR_MSG_TXT(buf);
 				}
 				ft.zeros();
-				ConstTwoDMatrix gk_mat(ft.nrows(), ft.ncols(), mxGetPr(gk));
-				ft.add(1.0, gk_mat);
+				ft.add(1.0, MxTwoDMatrix(gk));
 				UFSTensor* ut = new UFSTensor(ft);
 				pol.insert(ut);
 			}
@@ -104,18 +261,36 @@ extern "C" {
 			UnfoldDecisionRule
 				dr(pol, PartitionY(nstat, npred, nboth, nforw),
 				   nexog, ConstVector(mxGetPr(ysteady), ny));
-			// form the shock realization
-			TwoDMatrix shocks_mat(nexog, nper, (const double*)mxGetPr(shocks));
-			TwoDMatrix vcov_mat(nexog, nexog, (const double*)mxGetPr(vcov));
-			GenShockRealization sr(vcov_mat, shocks_mat, seed);
-			// simulate and copy the results
-			Vector ystart_vec((const double*)mxGetPr(ystart), ny);
-			TwoDMatrix* res_mat =
-				dr.simulate(DecisionRule::horner, nper,
-							ystart_vec, sr);
-			TwoDMatrix res_tmp_mat(ny, nper, mxGetPr(res));
-			res_tmp_mat = (const TwoDMatrix&)(*res_mat);
-			delete res_mat;
+			const MxTwoDMatrix vcov_mat(vcov);
+			const MxVector ystart_vec(ystart);
+			if (shocks_ndim == 2 && !pruning) {
+				// form the shock realization
+				const MxTwoDMatrix shocks_mat(shocks);
+				GenShockRealization sr(vcov_mat, shocks_mat, seed);
+				// simulate directly to the result
+				MxTwoDMatrix res_mat(res);
+				dr.simulate(DecisionRule::horner, ystart_vec, sr, res_mat);
+			} else if (nsim > 0 && nper > 0) {
+				// simulate the paths by the threads, each in one batch
+				int nthreads = (num_threads < nsim) ? num_threads : nsim;
+				int old_max = THREAD_GROUP::max_parallel_threads;
+				THREAD_GROUP::max_parallel_threads = nthreads;
+				bool failed = false;
+				{
+					THREAD_GROUP gr;
+					for (int i = 0; i < nthreads; i++) {
+						int first = (int)(((long int)nsim*i)/nthreads);
+						int last = (int)(((long int)nsim*(i+1))/nthreads);
+						gr.insert(new SimulWorker(dr, pol, vcov_mat, ystart_vec, mxGetPr(shocks),
+												  mxGetPr(res), nper, first, last-first, seed,
+												  shocks_ndim == 3, pruning, failed));
+					}
+					gr.run();
+				}
+				THREAD_GROUP::max_parallel_threads = old_max;
+				if (failed)
+					DYN_MEX_FUNC_ERR_MSG_TXT("Simulation failed.\n");
+			}
 			plhs[1] = res;
 		} catch (const KordException& e) {
 			DYN_MEX_FUNC_ERR_MSG_TXT("Caugth Kord exception.");
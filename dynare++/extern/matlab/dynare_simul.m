@@ -30,7 +30,10 @@
 %              number of columns gives the number of simulated
 %              periods. NaNs and Infs in the matrix are substitued by
 %              draws from the normal distribution using the covariance
-%              matrix given in the model file.
+%              matrix given in the model file. The shocks can also be a
+%              3-dimensional array, whose pages are the shocks of several
+%              paths simulated at once; then r is a 3-dimensional array
+%              of the simulated paths.
 %     start    Vector of endogenous variables in the ordering given by
 %              <prefix>_vars.
 %
@@ -13,6 +13,7 @@
 
 #include <getopt.h>
 #include <cstdio>
+#include <cstring>
 
 #include <cmath>
 
@@ -79,13 +80,6 @@ void QuadParams::check_consistency() const
 	}
 }
 
-/** Utility class for ordering pointers to vectors according their
- * ordering. */
-struct OrderVec {
-	bool operator()(const Vector* a, const Vector* b) const
-		{return *a < *b;}
-};
-
 int main(int argc, char** argv)
 {
 	QuadParams params(argc, argv);
@@ -110,9 +104,13 @@ int main(int argc, char** argv)
 								 "VCOV matrix not square");
 		// and put to the GeneralMatrix
 		GeneralMatrix vcov(mp.nrows(), mp.ncols());
-		vcov.zeros();
-		for (ogp::MPIterator it = mp.begin(); it != mp.end(); ++it)
-			vcov.get(it.row(), it.col()) = *it;
+		if (mp.colmajor_data()) {
+			memcpy(vcov.base(), mp.colmajor_data(), sizeof(double)*mp.nrows()*mp.ncols());
+		} else {
+			vcov.zeros();
+			for (ogp::MPIterator it = mp.begin(); it != mp.end(); ++it)
+				vcov.get(it.row(), it.col()) = *it;
+		}
 	
 		// calculate the factor A of vcov, so that A*A^T=VCOV
 		GeneralMatrix A(vcov.numRows(), vcov.numRows());
@@ -129,25 +127,18 @@ int main(int argc, char** argv)
 		printf("Maximum level:            %d\n", level);
 		printf("Total number of nodes:    %d\n", sq.numEvals(level));
 
-		// put the points to the vector
-		std::vector<Vector*> points;
-		for (smolpit qit = sq.start(level); qit != sq.end(level); ++qit)
-			points.push_back(new Vector((const Vector&)qit.point()));
-		// sort and uniq
-		OrderVec ordvec;
-		std::sort(points.begin(), points.end(), ordvec);
-		std::vector<Vector*>::iterator new_end = std::unique(points.begin(), points.end());
-		for (std::vector<Vector*>::iterator it = new_end; it != points.end(); ++it)
-			delete *it;
-		points.erase(new_end, points.end());
+		// the grid contains sorted points without duplicates
+		const SmolyakGrid& grid = sq.getGrid();
+		const TwoDMatrix& points = grid.getPoints();
 
-		printf("Duplicit nodes removed:   %lu\n", (unsigned long) (sq.numEvals(level)-points.size()));
+		printf("Duplicit nodes removed:   %d\n", sq.numEvals(level)-grid.numPoints());
 
 		// calculate weights and mass
 		double mass = 0.0;
 		std::vector<double> weights;
-		for (int i = 0; i < (int)points.size(); i++) {
-			weights.push_back(std::exp(-points[i]->dot(*(points[i]))));
+		for (int i = 0; i < grid.numPoints(); i++) {
+			ConstVector pi(points, i);
+			weights.push_back(std::exp(-pi.dot(pi)));
 			mass += weights.back();
 		}
 
@@ -168,7 +159,7 @@ int main(int argc, char** argv)
 				// print the upscaled weight
 				fprintf(fout, "%20.16g", upscale_weight*weights[i]);
 				// multiply point with the factor A and sqrt(2)
-				A.multVec(0.0, x, std::sqrt(2.), *(points[i]));
+				A.multVec(0.0, x, std::sqrt(2.), ConstVector(points, i));
 				// print the coordinates
 				for (int j = 0; j < x.length(); j++)
 					fprintf(fout, " %20.16g", x[j]);
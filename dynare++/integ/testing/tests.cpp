@@ -167,9 +167,11 @@ protected:
 	static bool smolyak_normal_moments(const GeneralMatrix& m, int imom, int level);
 	static bool product_normal_moments(const GeneralMatrix& m, int imom, int level);
 	static bool qmc_normal_moments(const GeneralMatrix& m, int imom, int level);
+	static bool smolyak_grid(int dim, int imom, int level);
 	static bool smolyak_product_cube(const VectorFunction& func, const Vector& res,
 									 double tol, int level);
 	static bool qmc_cube(const VectorFunction& func, double res, double tol, int level);
+	static bool rqmc_cube(const VectorFunction& func, double res, double tol, int level, int nrep);
 };
 
 bool TestRunnable::test() const
@@ -299,6 +301,53 @@ bool TestRunnable::qmc_normal_moments(const GeneralMatrix& m, int imom, int leve
 }
 
 
+bool TestRunnable::smolyak_grid(int dim, int imom, int level)
+{
+	TensorPower tp(dim, imom);
+	GaussHermite gs;
+	SmolyakQuadrature quad(dim, level, gs);
+
+	// sum through the iterator
+	Vector iter_out(tp.outdim());
+	iter_out.zeros();
+	Vector tmp(tp.outdim());
+	{
+		WallTimer tim("\tSmolyak iterator time:           ");
+		for (smolpit run = quad.start(level); run != quad.end(level); ++run) {
+			tp.eval(run.point(), run.signal(), tmp);
+			iter_out.add(run.weight(), tmp);
+		}
+	}
+
+	// integrate through the grid
+	Vector grid_out(tp.outdim());
+	{
+		WallTimer tim("\tSmolyak grid time:               ");
+		quad.integrate(tp, level, num_threads, grid_out);
+	}
+	const SmolyakGrid& grid = quad.getGrid();
+	printf("\tNumber of evaluations:            %d\n", quad.numEvals(level));
+	printf("\tNumber of grid points:            %d\n", grid.numPoints());
+
+	// a quadrature of the same kind must share the grid
+	SmolyakQuadrature quad2(dim, level, gs);
+	bool shared = (&grid == &(quad2.getGrid()));
+
+	// save and load the grid
+	grid.save("smolyak_grid.txt");
+	SmolyakGrid* loaded = SmolyakGrid::load("smolyak_grid.txt");
+	bool same = (loaded != NULL && loaded->numPoints() == grid.numPoints()
+				 && loaded->getWeights() == grid.getWeights()
+				 && loaded->getPoints().getData() == grid.getPoints().getData());
+	delete loaded;
+	remove("smolyak_grid.txt");
+
+	grid_out.add(-1.0, iter_out);
+	printf("\tError:                         %16.12g\n", grid_out.getMax());
+	return grid_out.getMax() < 1.e-10 && grid.numPoints() < quad.numEvals(level)
+		&& shared && same;
+}
+
 bool TestRunnable::smolyak_product_cube(const VectorFunction& func, const Vector& res,
 										double tol, int level)
 {
@@ -374,6 +423,23 @@ bool TestRunnable::qmc_cube(const VectorFunction& func, double res, double tol,
 	return error1 < tol && error2 < tol && error3 < tol;
 }
 
+bool TestRunnable::rqmc_cube(const VectorFunction& func, double res, double tol, int level, int nrep)
+{
+	Vector r(1);
+	Vector err(1);
+	{
+		WallTimer tim("\tRandomized Quasi-Monte Carlo time:            ");
+		RandomizedQMCarlo rqmc(func.indim(), level, nrep, 1234);
+		rqmc.integrateCube(func, num_threads, r, err);
+	}
+	double error = std::max(res - r[0], r[0] - res);
+	printf("\tRandomized Quasi-Monte Carlo error:           %16.12g\n", error);
+	printf("\tRandomized Quasi-Monte Carlo std. error:      %16.12g\n", err[0]);
+
+	// the error estimate must be positive, small, and cover the error
+	return err[0] > 0 && err[0] < tol && error < 4*err[0];
+}
+
 /****************************************************/
 /*     definition of TestRunnable subclasses        */
 /****************************************************/
@@ -405,6 +471,17 @@ public:
 		}
 };
 
+class SmolyakGridTest : public TestRunnable {
+public:
+	SmolyakGridTest()
+		: TestRunnable("Smolyak grid (dim=4, level=6, order=4)", 4, 4) {}
+
+	bool run() const
+		{
+			return smolyak_grid(4, 4, 6);
+		}
+};
+
 class ProductNormalMom1 : public TestRunnable {
 public:
 	ProductNormalMom1()
@@ -490,6 +567,18 @@ public:
 		}
 };
 
+class F1RandomizedQMC : public TestRunnable {
+public:
+	F1RandomizedQMC()
+		: TestRunnable("Function1 Randomized Quasi-Monte Carlo (dim=6, level=10000, reps=10)", 1, 1) {}
+
+	bool run() const
+		{
+			Function1 f1(6);
+			return rqmc_cube(f1, 1.0, 1.e-2, 10000, 10);
+		}
+};
+
 int main()
 {
 	TestRunnable* all_tests[50];
@@ -497,10 +586,12 @@ int main()
 	int num_tests = 0;
 	all_tests[num_tests++] = new SmolyakNormalMom1();
 	all_tests[num_tests++] = new SmolyakNormalMom2();
+	all_tests[num_tests++] = new SmolyakGridTest();
 	all_tests[num_tests++] = new ProductNormalMom1();
 	all_tests[num_tests++] = new ProductNormalMom2();
 	all_tests[num_tests++] = new QMCNormalMom1();
 	all_tests[num_tests++] = new QMCNormalMom2();
+	all_tests[num_tests++] = new F1RandomizedQMC();
 /*
 	all_tests[num_tests++] = new F1GaussLegendre();
 	all_tests[num_tests++] = new F1QuasiMCarlo();
@@ -0,0 +1,407 @@
+/* Benchmarks of the numeric kernels of the tensor library, the
+   Sylvester solver and the k-order perturbation. Every case is run a
+   given number of times for each point of a sweep of sizes, orders
+   and thread counts, and the median and minimum wall times are
+   written to stdout in JSON. The progress goes to stderr.
+
+   Usage: benchmarks [-r reps] [-t max_threads] [-q]
+   where -q runs a smaller sweep. */
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <sys/time.h>
+
+#include "korder.h"
+#include "kron_prod.h"
+#include "fs_tensor.h"
+#include "GeneralSylvester.h"
+#include "SylvException.h"
+
+static double wall_time()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec*1.0e-6;
+}
+
+static void fill_random(Vector& v, double m)
+{
+	for (int i = 0; i < v.length(); i++)
+		v[i] = 2*m*(drand48()-0.5);
+}
+
+static void fill_random(TwoDMatrix& a, double m)
+{
+	for (int j = 0; j < a.ncols(); j++)
+		for (int i = 0; i < a.nrows(); i++)
+			a.get(i, j) = 2*m*(drand48()-0.5);
+}
+
+/* One benchmarked kernel with fixed parameters. |prepare| is called
+   before each run and is not timed, |run| is timed. |flops| returns
+   the number of floating point operations of one run, or zero if it
+   is not known. */
+class BenchCase {
+public:
+	virtual ~BenchCase() {}
+	virtual void prepare() {}
+	virtual void run() =0;
+	virtual double flops() const
+		{return 0.0;}
+};
+
+struct BenchResult {
+	std::string kernel;
+	std::string params;
+	int threads;
+	int reps;
+	double median;
+	double min;
+	double flops;
+};
+
+class Bench {
+	int reps;
+	std::vector<BenchResult> results;
+public:
+	Bench(int r)
+		: reps(r) {}
+	void measure(const char* kernel, const std::string& params, int threads,
+				 BenchCase& c);
+	void print() const;
+};
+
+void Bench::measure(const char* kernel, const std::string& params, int threads,
+					BenchCase& c)
+{
+	fprintf(stderr, "%s %s threads=%d ...", kernel, params.c_str(), threads);
+	std::vector<double> times;
+	for (int i = 0; i < reps; i++) {
+		c.prepare();
+		double start = wall_time();
+		c.run();
+		times.push_back(wall_time()-start);
+	}
+	std::sort(times.begin(), times.end());
+	BenchResult r;
+	r.kernel = kernel;
+	r.params = params;
+	r.threads = threads;
+	r.reps = reps;
+	int n = times.size();
+	r.median = (n % 2) ? times[n/2] : 0.5*(times[n/2-1]+times[n/2]);
+	r.min = times[0];
+	r.flops = c.flops();
+	results.push_back(r);
+	fprintf(stderr, " %.4g s\n", r.median);
+}
+
+void Bench::print() const
+{
+	printf("{\n  \"benchmarks\": [\n");
+	for (unsigned int i = 0; i < results.size(); i++) {
+		const BenchResult& r = results[i];
+		printf("    {\"kernel\": \"%s\", \"params\": {%s}, \"threads\": %d, \"reps\": %d, "
+			   "\"median_s\": %.6e, \"min_s\": %.6e, \"gflops\": ",
+			   r.kernel.c_str(), r.params.c_str(), r.threads, r.reps, r.median, r.min);
+		if (r.flops > 0 && r.median > 0)
+			printf("%.4f}", r.flops/r.median*1.0e-9);
+		else
+			printf("null}");
+		printf("%s\n", (i+1 < results.size()) ? "," : "");
+	}
+	printf("  ]\n}\n");
+}
+
+static std::string params(const char* n1, int v1, const char* n2 = NULL, int v2 = 0,
+						  const char* n3 = NULL, int v3 = 0)
+{
+	char buf[200];
+	int l = sprintf(buf, "\"%s\": %d", n1, v1);
+	if (n2)
+		l += sprintf(buf+l, ", \"%s\": %d", n2, v2);
+	if (n3)
+		l += sprintf(buf+l, ", \"%s\": %d", n3, v3);
+	return std::string(buf);
+}
+
+/* Multiplication of q x n^k matrix by Kronecker product of k matrices n x n. */
+class KronMultCase : public BenchCase {
+	int q, n, k;
+	std::vector<TwoDMatrix*> mats;
+	KronProdAll kp;
+	TwoDMatrix in;
+	TwoDMatrix out;
+public:
+	KronMultCase(int qq, int nn, int kk)
+		: q(qq), n(nn), k(kk), kp(kk), in(qq, Tensor::power(nn, kk)),
+		  out(qq, Tensor::power(nn, kk))
+		{
+			for (int i = 0; i < k; i++) {
+				mats.push_back(new TwoDMatrix(n, n));
+				fill_random(*(mats[i]), 1.0);
+				kp.setMat(i, *(mats[i]));
+			}
+			fill_random(in, 1.0);
+		}
+	~KronMultCase()
+		{
+			for (unsigned int i = 0; i < mats.size(); i++)
+				delete mats[i];
+		}
+	void run()
+		{kp.mult(in, out);}
+	double flops() const
+		{return 2.0*k*q*Tensor::power(n, k)*n;}
+};
+
+/* Unfolding and folding of a fully symmetric tensor. */
+class UnfoldCase : public BenchCase {
+	FFSTensor f;
+public:
+	UnfoldCase(int r, int nv, int dim)
+		: f(r, nv, dim)
+		{fill_random(f.getData(), 1.0);}
+	void run()
+		{UFSTensor u(f);}
+};
+
+class FoldCase : public BenchCase {
+	UFSTensor* u;
+public:
+	FoldCase(int r, int nv, int dim)
+		{
+			FFSTensor f(r, nv, dim);
+			fill_random(f.getData(), 1.0);
+			u = new UFSTensor(f);
+		}
+	~FoldCase()
+		{delete u;}
+	void run()
+		{FFSTensor f(*u);}
+};
+
+/* Random model for the k-order kernels: sparse derivatives of f as in
+   the tests, and random first order rule. */
+struct BenchModel {
+	int nstat, npred, nboth, nforw, nu;
+	TensorContainer<FSSparseTensor> f;
+	TwoDMatrix gy;
+	TwoDMatrix gu;
+	TwoDMatrix v;
+	BenchModel(int ns, int np, int nb, int nf, int nuu, int maxdim);
+	int ny() const
+		{return nstat+npred+nboth+nforw;}
+	int nz() const
+		{return nboth+nforw+ny()+nboth+npred+nu;}
+};
+
+BenchModel::BenchModel(int ns, int np, int nb, int nf, int nuu, int maxdim)
+	: nstat(ns), npred(np), nboth(nb), nforw(nf), nu(nuu), f(1),
+	  gy(ns+np+nb+nf, np+nb), gu(ns+np+nb+nf, nuu), v(nuu, nuu)
+{
+	srand48(ny()*256+maxdim);
+	double fill = 0.5;
+	for (int d = 1; d <= maxdim; d++) {
+		FSSparseTensor* t = new FSSparseTensor(d, nz(), ny());
+		FFSTensor dummy(0, nz(), d);
+		for (Tensor::index fi = dummy.begin(); fi != dummy.end(); ++fi)
+			for (int i = 0; i < ny(); i++)
+				if (drand48() < fill)
+					t->insert(fi.getCoor(), i, 10*(drand48()-0.5));
+		f.insert(t);
+		fill *= 0.3;
+	}
+	fill_random(gy, 0.5/(np+nb));
+	fill_random(gu, 1.0);
+	TwoDMatrix a(nu, nu);
+	fill_random(a, 1.0);
+	v.zeros();
+	v.multAndAdd(ConstTwoDMatrix(a), "trans", ConstTwoDMatrix(a));
+}
+
+/* KOrder exposing the Faa Di Bruno of the Z stack. */
+class BenchKOrder : public KOrder {
+public:
+	BenchKOrder(const BenchModel& m, Journal& jr)
+		: KOrder(m.nstat, m.npred, m.nboth, m.nforw, m.f, m.gy, m.gu, m.v, jr) {}
+	FGSTensor* faaZ(const Symmetry& sym) const
+		{return faaDiBrunoZ<fold>(sym);}
+};
+
+/* Faa Di Bruno for g_{y^d} after the steps up to d-1. */
+class FaaDiBrunoCase : public BenchCase {
+	BenchKOrder kord;
+	int dim;
+public:
+	FaaDiBrunoCase(const BenchModel& m, int d, Journal& jr)
+		: kord(m, jr), dim(d)
+		{
+			kord.switchToFolded();
+			for (int i = 2; i < dim; i++)
+				kord.performStep<KOrder::fold>(i);
+		}
+	void run()
+		{delete kord.faaZ(Symmetry(dim, 0, 0, 0));}
+};
+
+/* The folded step of order d after the steps up to d-1. */
+class KOrderStepCase : public BenchCase {
+	const BenchModel& model;
+	Journal& journal;
+	int dim;
+	KOrder* kord;
+public:
+	KOrderStepCase(const BenchModel& m, int d, Journal& jr)
+		: model(m), journal(jr), dim(d), kord(NULL) {}
+	~KOrderStepCase()
+		{delete kord;}
+	void prepare()
+		{
+			delete kord;
+			kord = new KOrder(model.nstat, model.npred, model.nboth, model.nforw,
+							  model.f, model.gy, model.gu, model.v, journal);
+			kord->switchToFolded();
+			for (int i = 2; i < dim; i++)
+				kord->performStep<KOrder::fold>(i);
+		}
+	void run()
+		{kord->performStep<KOrder::fold>(dim);}
+};
+
+/* Solution of AX+BX(C\otimes...\otimes C)=D with n x n matrices A, B,
+   m x m matrix C, and given order. */
+class SylvesterCase : public BenchCase {
+	int order, n, m, threads;
+	TwoDMatrix a, b, c, d;
+	GeneralSylvester* gs;
+public:
+	SylvesterCase(int ord, int nn, int mm, int th)
+		: order(ord), n(nn), m(mm), threads(th), a(nn, nn), b(nn, nn), c(mm, mm),
+		  d(nn, Tensor::power(mm, ord)), gs(NULL)
+		{
+			fill_random(a, 1.0/n);
+			for (int i = 0; i < n; i++)
+				a.get(i, i) += 2.0;
+			fill_random(b, 1.0/n);
+			fill_random(c, 0.5/m);
+			fill_random(d, 1.0);
+		}
+	~SylvesterCase()
+		{delete gs;}
+	void prepare()
+		{
+			delete gs;
+			SylvParams ps;
+			ps.num_threads = threads;
+			gs = new GeneralSylvester(order, n, m, 0, a.getData().base(), b.getData().base(),
+									  c.getData().base(), d.getData().base(), ps);
+		}
+	void run()
+		{gs->solve();}
+};
+
+int main(int argc, char** argv)
+{
+	int reps = 5;
+	int max_threads = 4;
+	bool quick = false;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-r") && i+1 < argc)
+			reps = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-t") && i+1 < argc)
+			max_threads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-q"))
+			quick = true;
+		else {
+			fprintf(stderr, "Usage: %s [-r reps] [-t max_threads] [-q]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (reps < 1)
+		reps = 1;
+	std::vector<int> threads;
+	for (int t = 1; t <= max_threads; t *= 2)
+		threads.push_back(t);
+
+	const int maxorder = quick ? 3 : 4;
+	// sizes of the random models: nstat, npred, nboth, nforw, nu
+	const int models[][5] = {{2, 3, 1, 2, 2}, {5, 8, 3, 6, 4}};
+	const int nmodels = quick ? 1 : 2;
+	int maxnz = 0;
+	for (int i = 0; i < nmodels; i++) {
+		const int* s = models[i];
+		int nz = s[2]+s[3]+(s[0]+s[1]+s[2]+s[3])+s[2]+s[1]+s[4];
+		if (nz > maxnz)
+			maxnz = nz;
+	}
+	tls.init(maxorder, std::max(maxnz, 30));
+
+	Bench bench(reps);
+	try {
+		const int qs[] = {50, 500};
+		const int ns[] = {5, 10, 20};
+		for (int k = 2; k <= 3; k++)
+			for (int iq = 0; iq < 2; iq++)
+				for (int in = 0; in < (quick ? 2 : 3); in++) {
+					KronMultCase c(qs[iq], ns[in], k);
+					bench.measure("KronProdAll::mult", params("q", qs[iq], "n", ns[in], "k", k),
+								  1, c);
+				}
+
+		const int nvs[] = {10, 20, 30};
+		for (int dim = 2; dim <= maxorder; dim++)
+			for (int inv = 0; inv < (quick ? 2 : 3); inv++) {
+				UnfoldCase cu(20, nvs[inv], dim);
+				bench.measure("UFSTensor(FFSTensor)", params("r", 20, "nv", nvs[inv], "dim", dim),
+							  1, cu);
+				FoldCase cf(20, nvs[inv], dim);
+				bench.measure("FFSTensor(UFSTensor)", params("r", 20, "nv", nvs[inv], "dim", dim),
+							  1, cf);
+			}
+
+		const int sns[] = {20, 50, 100};
+		for (int order = 1; order <= 3; order++)
+			for (int in = 0; in < (quick ? 2 : 3); in++)
+				for (unsigned int it = 0; it < threads.size(); it++) {
+					SylvesterCase c(order, sns[in], 10, threads[it]);
+					bench.measure("GeneralSylvester::solve",
+								  params("order", order, "n", sns[in], "m", 10), threads[it], c);
+				}
+
+		Journal jr("bench.jnl");
+		int save_threads = THREAD_GROUP::max_parallel_threads;
+		for (int im = 0; im < nmodels; im++) {
+			const int* s = models[im];
+			BenchModel model(s[0], s[1], s[2], s[3], s[4], maxorder);
+			for (int dim = 2; dim <= maxorder; dim++)
+				for (unsigned int it = 0; it < threads.size(); it++) {
+					THREAD_GROUP::max_parallel_threads = threads[it];
+					FaaDiBrunoCase cf(model, dim, jr);
+					bench.measure("FaaDiBruno::calculate",
+								  params("ny", model.ny(), "nu", model.nu, "dim", dim), threads[it], cf);
+					KOrderStepCase ck(model, dim, jr);
+					bench.measure("KOrder::performStep",
+								  params("ny", model.ny(), "nu", model.nu, "dim", dim), threads[it], ck);
+				}
+		}
+		THREAD_GROUP::max_parallel_threads = save_threads;
+	} catch (const TLException& e) {
+		e.print();
+		return 1;
+	} catch (SylvException& e) {
+		e.printMessage();
+		return 1;
+	} catch (const KordException& e) {
+		e.print();
+		return 1;
+	}
+
+	bench.print();
+	return 0;
+}
@@ -2,7 +2,11 @@
 /* Copyright 2004, Ondra Kamenik */
 
 #include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <sys/time.h>
 #include "korder.h"
+#include "decision_rule.h"
 #include "SylvException.h"
 
 struct Rand {
@@ -226,6 +230,14 @@ protected:
 									 int nstat, int npred, int nboth, int forw,
 									 const TwoDMatrix& gy, const TwoDMatrix& gu,
 									 const TwoDMatrix& v);
+	static double korder_threads(int maxdim, int nthreads,
+								 int nstat, int npred, int nboth, int forw,
+								 const TwoDMatrix& gy, const TwoDMatrix& gu,
+								 const TwoDMatrix& v);
+	static double rtsim_threads(int nsim, int nper, int nthreads,
+								int nstat, int npred, int nboth, int forw,
+								const TwoDMatrix& gy, const TwoDMatrix& gu,
+								const TwoDMatrix& v);
 };
 
 
@@ -308,6 +320,134 @@ double TestRunnable::korder_unfold_fold(int maxdim, int unfold_dim,
 	return maxerror;
 }
 
+// Performs folded steps up to maxdim with one thread and with nthreads
+// threads, prints the wall times of the steps, and returns the maximum
+// difference between the two sets of folded derivatives relative to the
+// maximum derivative (the summation order differs with the threads)
+double TestRunnable::korder_threads(int maxdim, int nthreads,
+									int nstat, int npred, int nboth, int nforw,
+									const TwoDMatrix& gy, const TwoDMatrix& gu,
+									const TwoDMatrix& v)
+{
+	TensorContainer<FSSparseTensor> c(1);
+	int ny = nstat+npred+nboth+nforw;
+	int nu = v.nrows();
+	int nz = nboth+nforw+ny+nboth+npred+nu;
+	SparseGenerator::fillContainer(c, maxdim, nz, ny, 5.0);
+	Journal jr("out.txt");
+	int save_threads = THREAD_GROUP::max_parallel_threads;
+	KOrder* kords[2];
+	double wtime[2];
+	for (int i = 0; i < 2; i++) {
+		THREAD_GROUP::max_parallel_threads = (i == 0) ? 1 : nthreads;
+		kords[i] = new KOrder(nstat, npred, nboth, nforw, c, gy, gu, v, jr);
+		kords[i]->switchToFolded();
+		struct timeval start, end;
+		gettimeofday(&start, NULL);
+		for (int d = 2; d <= maxdim; d++)
+			kords[i]->performStep<KOrder::fold>(d);
+		gettimeofday(&end, NULL);
+		wtime[i] = end.tv_sec-start.tv_sec + (end.tv_usec-start.tv_usec)*1.0e-6;
+		printf("\twall time for folded steps with %d thread(s): %8.4g\n",
+			   THREAD_GROUP::max_parallel_threads, wtime[i]);
+	}
+	THREAD_GROUP::max_parallel_threads = save_threads;
+	if (wtime[1] > 0)
+		printf("\tspeedup with %d threads:                  %8.4g\n",
+			   nthreads, wtime[0]/wtime[1]);
+
+	double maxdiff = 0.0;
+	double maxder = 0.0;
+	for (int dim = 1; dim <= maxdim; dim++) {
+		SymmetrySet ss(dim, 4);
+		for (symiterator si(ss); !si.isEnd(); ++si) {
+			if ((*si)[2] == 0 && kords[0]->getFoldDers().check(*si)) {
+				TwoDMatrix diff(*(kords[0]->getFoldDers().get(*si)));
+				if (maxder < diff.getData().getMax())
+					maxder = diff.getData().getMax();
+				diff.add(-1.0, *(kords[1]->getFoldDers().get(*si)));
+				if (maxdiff < diff.getData().getMax())
+					maxdiff = diff.getData().getMax();
+			}
+		}
+	}
+	if (maxder > 0)
+		maxdiff /= maxder;
+	printf("\tmax relative difference of derivatives:   %10.6g\n", maxdiff);
+	delete kords[0];
+	delete kords[1];
+	return maxdiff;
+}
+
+// gives access to the computed moments of the real-time simulations
+class RTSimStats : public RTSimResultsStats {
+public:
+	RTSimStats(int ny, int nper)
+		: RTSimResultsStats(ny, nper) {}
+	const Vector& getMean() const
+		{return mean;}
+	const TwoDMatrix& getVcov() const
+		{return vcov;}
+};
+
+// Runs the real-time simulations of the first order decision rule given
+// by gy and gu with one thread and with nthreads threads from the same
+// seed, prints the wall times, and returns the maximum difference of the
+// means and variances (the blocks are merged in the same order, so they
+// should be the same)
+double TestRunnable::rtsim_threads(int nsim, int nper, int nthreads,
+								   int nstat, int npred, int nboth, int nforw,
+								   const TwoDMatrix& gy, const TwoDMatrix& gu,
+								   const TwoDMatrix& v)
+{
+	PartitionY ypart(nstat, npred, nboth, nforw);
+	int ny = ypart.ny();
+	int nu = v.nrows();
+	IntSequence nvs(4);
+	nvs[0] = ypart.nys(); nvs[1] = nu; nvs[2] = nu; nvs[3] = 1;
+	FGSContainer g(4);
+	FGSTensor* tgy = new FGSTensor(ny, TensorDimens(Symmetry(1,0,0,0), nvs));
+	FGSTensor* tgu = new FGSTensor(ny, TensorDimens(Symmetry(0,1,0,0), nvs));
+	((TwoDMatrix&)*tgy) = gy;
+	((TwoDMatrix&)*tgu) = gu;
+	g.insert(tgy);
+	g.insert(tgu);
+	Vector ys(ny);
+	ys.zeros();
+	FoldDecisionRule dr(g, ypart, nu, ys, 1.0);
+	Journal jr("out.txt");
+
+	int save_threads = THREAD_GROUP::max_parallel_threads;
+	RTSimStats* stats[2];
+	double wtime[2];
+	for (int i = 0; i < 2; i++) {
+		THREAD_GROUP::max_parallel_threads = (i == 0) ? 1 : nthreads;
+		system_random_generator.initSeed(17);
+		stats[i] = new RTSimStats(ny, nper);
+		struct timeval start, end;
+		gettimeofday(&start, NULL);
+		stats[i]->simulate(nsim, dr, ys, v, jr);
+		gettimeofday(&end, NULL);
+		wtime[i] = end.tv_sec-start.tv_sec + (end.tv_usec-start.tv_usec)*1.0e-6;
+		printf("\twall time for simulations with %d thread(s): %8.4g\n",
+			   THREAD_GROUP::max_parallel_threads, wtime[i]);
+	}
+	THREAD_GROUP::max_parallel_threads = save_threads;
+	if (wtime[1] > 0)
+		printf("\tspeedup with %d threads:                  %8.4g\n",
+			   nthreads, wtime[0]/wtime[1]);
+
+	Vector dmean(stats[0]->getMean());
+	dmean.add(-1.0, stats[1]->getMean());
+	TwoDMatrix dvcov(stats[0]->getVcov());
+	dvcov.add(-1.0, stats[1]->getVcov());
+	double maxdiff = std::max(dmean.getMax(), dvcov.getData().getMax());
+	printf("\tmax difference of moments:              %10.6g\n", maxdiff);
+	delete stats[0];
+	delete stats[1];
+	return maxdiff;
+}
+
 class UnfoldKOrderSmall : public TestRunnable {
 public:
 	UnfoldKOrderSmall()
@@ -367,6 +507,96 @@ public:
 		}
 };
 
+// scalability of the multithreaded Faa Di Bruno formula, orders 3 to 5
+class ThreadsKOrderSmall : public TestRunnable {
+public:
+	ThreadsKOrderSmall()
+		: TestRunnable("threaded fold-5 korder (stat=2,pred=3,both=1,forw=2,u=3,dim=5)",
+					   5, 18) {}
+
+	bool run() const
+		{
+			TwoDMatrix gy(8, 4, gy_data);
+			TwoDMatrix gu(8, 3, gu_data);
+			TwoDMatrix v(3, 3, vdata);
+			double err = korder_threads(5, 4, 2, 3, 1, 2,
+										gy, gu, v);
+
+			return err < 1.e-8;
+		}
+};
+
+class ThreadsKOrderSW : public TestRunnable {
+public:
+	ThreadsKOrderSW()
+		: TestRunnable("threaded fold-3 S&W korder (stat=5,pred=12,both=8,forw=5,u=10,dim=3)",
+					   3, 73) {}
+
+	bool run() const
+		{
+			TwoDMatrix gy(30, 20, gy_data2);
+			TwoDMatrix gu(30, 10, gu_data2);
+			TwoDMatrix v(10, 10, vdata2);
+			v.mult(0.001);
+			gu.mult(.01);
+			double err = korder_threads(3, 4, 5, 12, 8, 5,
+										gy, gu, v);
+
+			return err < 1.e-8;
+		}
+};
+
+class ThreadsKOrderSW4 : public TestRunnable {
+public:
+	ThreadsKOrderSW4()
+		: TestRunnable("threaded fold-4 S&W korder (stat=5,pred=12,both=8,forw=5,u=10,dim=4)",
+					   4, 73) {}
+
+	bool run() const
+		{
+			TwoDMatrix gy(30, 20, gy_data2);
+			TwoDMatrix gu(30, 10, gu_data2);
+			TwoDMatrix v(10, 10, vdata2);
+			v.mult(0.001);
+			gu.mult(.01);
+			double err = korder_threads(4, 4, 5, 12, 8, 5,
+										gy, gu, v);
+
+			return err < 1.e-8;
+		}
+};
+
+// scalability of the real-time simulations, the predetermined part of
+// gy is scaled so that the rule is stable
+class ThreadsRTSimSW : public TestRunnable {
+public:
+	ThreadsRTSimSW()
+		: TestRunnable("threaded real-time simulations (stat=5,pred=12,both=8,forw=5,u=10)",
+					   1, 30) {}
+
+	bool run() const
+		{
+			TwoDMatrix gy(30, 20, gy_data2);
+			TwoDMatrix gu(30, 10, gu_data2);
+			TwoDMatrix v(10, 10, vdata2);
+			v.mult(0.001);
+			gu.mult(.01);
+			double rmax = 0.0;
+			for (int i = 5; i < 25; i++) {
+				double r = 0.0;
+				for (int j = 0; j < 20; j++)
+					r += fabs(gy.get(i,j));
+				if (rmax < r)
+					rmax = r;
+			}
+			gy.mult(0.9/rmax);
+			double err = rtsim_threads(1000, 1000, 4, 5, 12, 8, 5,
+									   gy, gu, v);
+
+			return err == 0.0;
+		}
+};
+
 int main()
 {
 	TestRunnable* all_tests[50];
@@ -375,6 +605,10 @@ int main()
 	all_tests[num_tests++] = new UnfoldKOrderSmall();
 	all_tests[num_tests++] = new UnfoldKOrderSW();
 	all_tests[num_tests++] = new UnfoldFoldKOrderSW();
+	all_tests[num_tests++] = new ThreadsKOrderSmall();
+	all_tests[num_tests++] = new ThreadsKOrderSW();
+	all_tests[num_tests++] = new ThreadsKOrderSW4();
+	all_tests[num_tests++] = new ThreadsRTSimSW();
 
 	// find maximum dimension and maximum nvar
 	int dmax=0;
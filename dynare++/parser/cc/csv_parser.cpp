@@ -40,3 +40,35 @@ void CSVParser::csv_parse(int length, const char* str)
 	csv__destroy_buffer(p);
 	parsed_string = NULL;
 }
+
+void CSVParser::csv_scan(int length, const char* str)
+{
+	const char* end = str + length;
+	const char* p = str;
+	parsed_string = str;
+	while (p < end) {
+		const char* eol = (const char*)memchr(p, '\n', end-p);
+		if (eol == NULL)
+			eol = end;
+		const char* eoi = eol;
+		if (eol < end && eoi > p && eoi[-1] == '\r')
+			eoi--;
+		// the items of the line
+		while (true) {
+			const char* comma = (const char*)memchr(p, ',', eoi-p);
+			if (comma == NULL)
+				comma = eoi;
+			if (comma > p)
+				item(p-str, comma-p);
+			if (comma == eoi)
+				break;
+			nextcol();
+			p = comma+1;
+		}
+		if (eol == end)
+			break;
+		nextrow();
+		p = eol+1;
+	}
+	parsed_string = NULL;
+}
@@ -39,7 +39,14 @@ namespace ogp
     }
 
     void csv_error(const char *mes);
+    /** Parse the given string by the bison parser. */
     void csv_parse(int length, const char *str);
+    /** Parse the given string by a hand written scanner. It calls
+     * the peer in the same way as csv_parse(), but it does not copy
+     * the string and it finds the separators by memchr, which is
+     * vectorized in the usual C libraries. The only difference is
+     * that a lone '\r' (not followed by '\n') is a part of an item. */
+    void csv_scan(int length, const char *str);
 
     void
     nextrow()
@@ -0,0 +1,119 @@
+// Copyright (C) 2017, Dynare Team
+
+// $Id$
+
+#include "double_parser.h"
+
+#include <cstdlib>
+#include <cstring>
+
+/** The powers of ten which are exactly representable. */
+static const double exact_pow10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/** Mantissas upto 2^53 are exactly representable. */
+static const unsigned long long max_exact_mantissa = 9007199254740992ULL;
+
+static bool is_blank(char c)
+{
+	return c == ' ' || c == '\t';
+}
+
+static bool is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+/** This converts the blank trimmed string by strtod. The string is
+ * copied since strtod needs the terminating '\0', and d or D
+ * exponents are changed to e. */
+static bool parse_double_strtod(const char* str, int length, double& val)
+{
+	char buf[64];
+	char* s = (length < (int)sizeof(buf)) ? buf : new char[length+1];
+	for (int i = 0; i < length; i++)
+		s[i] = (str[i] == 'd' || str[i] == 'D') ? 'e' : str[i];
+	s[length] = '\0';
+	char* end;
+	val = strtod(s, &end);
+	bool ret = (length > 0 && end == s+length);
+	if (s != buf)
+		delete [] s;
+	return ret;
+}
+
+bool ogp::parse_double(const char* str, int length, double& val)
+{
+	int b = 0;
+	while (b < length && is_blank(str[b]))
+		b++;
+	while (length > b && is_blank(str[length-1]))
+		length--;
+	str += b;
+	length -= b;
+
+	int i = 0;
+	bool neg = false;
+	if (i < length && (str[i] == '+' || str[i] == '-'))
+		neg = (str[i++] == '-');
+
+	// mantissa digits, the leading zeros are not counted
+	unsigned long long mant = 0;
+	int ndig = 0;
+	int nread = 0;
+	int exp10 = 0;
+	while (i < length && is_digit(str[i])) {
+		if (mant != 0 || str[i] != '0') {
+			mant = 10*mant + (str[i] - '0');
+			ndig++;
+		}
+		nread++;
+		i++;
+	}
+	if (i < length && str[i] == '.') {
+		i++;
+		while (i < length && is_digit(str[i])) {
+			if (mant != 0 || str[i] != '0') {
+				mant = 10*mant + (str[i] - '0');
+				ndig++;
+			}
+			nread++;
+			exp10--;
+			i++;
+		}
+	}
+	if (nread == 0 || ndig > 19)
+		return parse_double_strtod(str, length, val);
+
+	// exponent
+	if (i < length && (str[i] == 'e' || str[i] == 'E' || str[i] == 'd' || str[i] == 'D')) {
+		i++;
+		bool eneg = false;
+		if (i < length && (str[i] == '+' || str[i] == '-'))
+			eneg = (str[i++] == '-');
+		if (i == length || ! is_digit(str[i]))
+			return false;
+		int e = 0;
+		while (i < length && is_digit(str[i])) {
+			if (e < 10000)
+				e = 10*e + (str[i] - '0');
+			i++;
+		}
+		exp10 += eneg ? -e : e;
+	}
+	if (i != length)
+		return false;
+
+	if (mant > max_exact_mantissa || exp10 < -22 || exp10 > 22)
+		return parse_double_strtod(str, length, val);
+
+	double v = (double)mant;
+	if (exp10 < 0)
+		v /= exact_pow10[-exp10];
+	else
+		v *= exact_pow10[exp10];
+	val = neg ? -v : v;
+	return true;
+}
@@ -0,0 +1,26 @@
+// Copyright (C) 2017, Dynare Team
+
+// $Id$
+
+#ifndef OGP_DOUBLE_PARSER_H
+#define OGP_DOUBLE_PARSER_H
+
+namespace ogp
+{
+  /** This converts the given number of characters of str to a double
+   * and returns true if all of them (besides leading and trailing
+   * blanks) form a number. The exponent may be introduced also by d
+   * or D as in Fortran. The usual numbers with at most 19 significant
+   * digits, whose mantissa is exactly representable and whose decimal
+   * exponent is small, are converted by one exact multiplication or
+   * division, giving the same correctly rounded result as strtod. All
+   * other numbers (including inf and nan) are passed to strtod. The
+   * string need not be terminated by '\0'. */
+  bool parse_double(const char *str, int length, double &val);
+};
+
+#endif
+
+// Local Variables:
+// mode:C++
+// End:
@@ -12,10 +12,55 @@
 
 #include <cmath>
 
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
 using namespace ogp;
 
 extern location_type fmla_lloc;
 
+/** This is a job of one thread in the parallel
+ * FormulaParser::differentiate. The thread differentiates the
+ * formulas first, first+step, first+2*step, etc. in its own copy of
+ * the tree. The copy is made in the thread, the source tree is only
+ * read. If the differentiation fails, the exception is stored in
+ * err. */
+struct DiffJob
+{
+	const OperationTree* src;
+	const vector<int>* vars;
+	const vector<int>* formulas;
+	int first;
+	int step;
+	int max_order;
+	OperationTree* tree;
+	vector<FormulaDerivatives*> ders;
+	ogu::Exception* err;
+};
+
+static void diff_job(DiffJob* job)
+{
+	try {
+		job->tree = new OperationTree(*(job->src));
+		for (unsigned int i = job->first; i < job->formulas->size(); i += job->step)
+			job->ders.push_back(new FormulaDerivatives(*(job->tree), *(job->vars),
+													   (*(job->formulas))[i], job->max_order));
+	} catch (const ogu::Exception& e) {
+		job->err = new ogu::Exception(e);
+	}
+}
+
+#ifdef HAVE_PTHREAD
+extern "C" {
+	static void* diff_job_run(void* arg)
+	{
+		diff_job((DiffJob*) arg);
+		return NULL;
+	}
+}
+#endif
+
 FormulaParser::FormulaParser(const FormulaParser& fp, Atoms& a)
 	: otree(fp.otree), atoms(a), formulas(fp.formulas), ders()
 {
@@ -29,13 +74,83 @@ FormulaParser::~FormulaParser()
 	destroy_derivatives();
 }
 
-void FormulaParser::differentiate(int max_order)
+void FormulaParser::differentiate(int max_order, int num_threads)
 {
 	destroy_derivatives();
 	vector<int> vars;
 	vars = atoms.variables();
-	for (unsigned int i = 0; i < formulas.size(); i++)
-		ders.push_back(new FormulaDerivatives(otree, vars, formulas[i], max_order));
+#ifndef HAVE_PTHREAD
+	num_threads = 1;
+#endif
+	if (num_threads > (int) formulas.size())
+		num_threads = formulas.size();
+	if (num_threads <= 1) {
+		for (unsigned int i = 0; i < formulas.size(); i++)
+			ders.push_back(new FormulaDerivatives(otree, vars, formulas[i], max_order));
+		return;
+	}
+
+	vector<DiffJob> jobs(num_threads);
+	for (int j = 0; j < num_threads; j++) {
+		jobs[j].src = &otree;
+		jobs[j].vars = &vars;
+		jobs[j].formulas = &formulas;
+		jobs[j].first = j;
+		jobs[j].step = num_threads;
+		jobs[j].max_order = max_order;
+		jobs[j].tree = NULL;
+		jobs[j].err = NULL;
+	}
+#ifdef HAVE_PTHREAD
+	// the calling thread runs the first job
+	vector<pthread_t> threads(num_threads);
+	vector<bool> started(num_threads, false);
+	for (int j = 1; j < num_threads; j++)
+		started[j] = (0 == pthread_create(&(threads[j]), NULL, diff_job_run, &(jobs[j])));
+	diff_job(&(jobs[0]));
+	for (int j = 1; j < num_threads; j++)
+		if (started[j])
+			pthread_join(threads[j], NULL);
+		else
+			diff_job(&(jobs[j]));
+#endif
+
+	// merge the trees in the order of the jobs, so that the result
+	// does not depend on the timing of the threads
+	int first = otree.get_num_op();
+	const ogu::Exception* err = NULL;
+	ders.resize(formulas.size(), NULL);
+	for (int j = 0; j < num_threads; j++) {
+		if (jobs[j].err == NULL && err == NULL) {
+			vector<int> mp;
+			otree.merge(*(jobs[j].tree), first, mp);
+			for (unsigned int k = 0; k < jobs[j].ders.size(); k++) {
+				jobs[j].ders[k]->remap(mp);
+				ders[j+k*num_threads] = jobs[j].ders[k];
+			}
+			jobs[j].ders.clear();
+		}
+		if (err == NULL)
+			err = jobs[j].err;
+	}
+
+	ogu::Exception* e = NULL;
+	if (err != NULL)
+		e = new ogu::Exception(*err);
+	for (int j = 0; j < num_threads; j++) {
+		for (unsigned int k = 0; k < jobs[j].ders.size(); k++)
+			delete jobs[j].ders[k];
+		if (jobs[j].tree)
+			delete jobs[j].tree;
+		if (jobs[j].err)
+			delete jobs[j].err;
+	}
+	if (e != NULL) {
+		ogu::Exception ee(*e);
+		delete e;
+		destroy_derivatives();
+		throw ee;
+	}
 }
 
 const FormulaDerivatives& FormulaParser::derivatives(int i) const
@@ -82,17 +197,20 @@ int FormulaParser::add_nulary(const char* str)
 
 void FormulaParser::add_subst_formulas(const map<int,int>& subst, const FormulaParser& fp)
 {
+	// the subterms shared by the formulas are substituted only once
+	map<int,int> memo;
 	for (int i = 0; i < fp.nformulas(); i++) {
-		int f = add_substitution(fp.formula(i), subst, fp);
+		int f = otree.add_substitution(fp.formula(i), subst, fp.otree, memo);
 		add_formula(f);
 	}
 }
 
 void FormulaParser::substitute_formulas(const map<int,int>& smap)
 {
+	map<int,int> memo;
 	for (int i = 0; i < nformulas(); i++) {
 		// make substitution and replace the formula for it
-		int f = add_substitution(formulas[i], smap);
+		int f = add_substitution(formulas[i], smap, memo);
 		formulas[i] = f;
 		// update the derivatives if any
 		if (i < (int)ders.size() && ders[i]) {
@@ -224,7 +342,11 @@ FormulaDerivatives::FormulaDerivatives(OperationTree& otree,
 			break;
 	}
 
-	// build ind2der map
+	// build ind2der map and the beginnings of the orders
+	ind2der.rehash(indices.size());
+	order_beg.assign(order+2, indices.size());
+	for (unsigned int i = indices.size(); i > 0; i--)
+		order_beg[indices[i-1].order()] = i-1;
 	for (unsigned int i = 0; i < indices.size(); i++)
 		ind2der.insert(Tfmiintmap::value_type(indices[i], i));
 
@@ -232,7 +354,7 @@ FormulaDerivatives::FormulaDerivatives(OperationTree& otree,
 
 FormulaDerivatives::FormulaDerivatives(const FormulaDerivatives& fd)
 	: tder(fd.tder), indices(fd.indices), ind2der(fd.ind2der),
-	  nvar(fd.nvar), order(fd.order)
+	  order_beg(fd.order_beg), nvar(fd.nvar), order(fd.order)
 {
 }
 
@@ -252,14 +374,19 @@ int FormulaDerivatives::derivative(const FoldMultiIndex& mi) const
 		return tder[(*it).second];
 }
 
+void FormulaDerivatives::remap(const vector<int>& mp)
+{
+	for (unsigned int i = 0; i < tder.size(); i++)
+		tder[i] = mp[tder[i]];
+}
+
 void FormulaDerivatives::print(const OperationTree& otree) const
 {
-	for (Tfmiintmap::const_iterator it = ind2der.begin();
-		 it != ind2der.end(); ++it) {
+	for (unsigned int i = 0; i < indices.size(); i++) {
 		printf("derivative ");
-		(*it).first.print();
-		printf(" is formula %d\n", tder[(*it).second]);
-		otree.print_operation(tder[(*it).second]);
+		indices[i].print();
+		printf(" is formula %d\n", tder[i]);
+		otree.print_operation(tder[i]);
 	}
 }
 
@@ -268,11 +395,28 @@ void FormulaCustomEvaluator::eval(const AtomValues& av, FormulaEvalLoader& loade
 	etree.reset_all();
 	av.setValues(etree);
 	for (unsigned int i = 0; i < terms.size(); i++) {
-		double res = etree.eval(terms[i]);
+		double res = prog.eval(etree, (int)i);
 		loader.load((int)i, res);
 	}
 }
 
+void FormulaCustomEvaluator::eval(const AtomValues& av, const AtomValues& dav,
+								  FormulaEvalLoader& loader, FormulaEvalLoader& dloader)
+{
+	if (! dtree)
+		dtree = new EvalTree(etree.getOperationTree(), last);
+	etree.reset_all();
+	av.setValues(etree);
+	dtree->reset_all();
+	dav.setValues(*dtree);
+	for (unsigned int i = 0; i < terms.size(); i++) {
+		double res, der;
+		prog.eval(etree, *dtree, (int)i, res, der);
+		loader.load((int)i, res);
+		dloader.load((int)i, der);
+	}
+}
+
 FoldMultiIndex::FoldMultiIndex(int nv)
 	: nvar(nv), ord(0), data(new int[ord])
 {
@@ -435,14 +579,87 @@ bool ltfmi::operator()(const FoldMultiIndex& i1, const FoldMultiIndex& i2) const
 	return i1 < i2;
 }
 
+size_t fmihash::operator()(const FoldMultiIndex& i) const
+{
+	size_t res = i.order();
+	for (int k = 0; k < i.order(); k++)
+		res = res*31 + i[k];
+	return res;
+}
+
 
 FormulaDerEvaluator::FormulaDerEvaluator(const FormulaParser& fp)
-	: etree(fp.otree, -1)
+	: etree(fp.otree, -1), otree(fp.otree)
 {
 	for (unsigned int i = 0; i < fp.ders.size(); i++)
 		ders.push_back((const FormulaDerivatives*)(fp.ders[i]));
 
 	der_atoms = fp.atoms.variables();
+
+	// compile the derivatives of each order in the order of tder
+	int maxorder = (ders.size() == 0)? -1 : ders[0]->order;
+	for (int order = 0; order <= maxorder; order++) {
+		vector<int> ts;
+		for (unsigned int i = 0; i < ders.size(); i++)
+			for (int j = ders[i]->order_beg[order]; j < ders[i]->order_beg[order+1]; j++)
+				ts.push_back(ders[i]->tder[j]);
+		progs.push_back(new EvalProgram(fp.otree, ts));
+		custom_progs.push_back(NULL);
+	}
+}
+
+FormulaDerEvaluator::~FormulaDerEvaluator()
+{
+	for (unsigned int i = 0; i < progs.size(); i++) {
+		delete progs[i];
+		if (custom_progs[i])
+			delete custom_progs[i];
+	}
+}
+
+int FormulaDerEvaluator::num_derivatives(int order) const
+{
+	if (order < 0 || order >= (int)progs.size())
+		return 0;
+	return progs[order]->num_targets();
+}
+
+void FormulaDerEvaluator::set_order(int order, const vector<int>& perm)
+{
+	if (order < 0 || order >= (int)progs.size())
+		throw ogu::Exception(__FILE__,__LINE__,
+							 "Wrong order in FormulaDerEvaluator::set_order");
+	const EvalProgram& prog = *(progs[order]);
+	if ((int)perm.size() != prog.num_targets())
+		throw ogu::Exception(__FILE__,__LINE__,
+							 "Wrong length of permutation in FormulaDerEvaluator::set_order");
+
+	vector<int> ts;
+	for (unsigned int p = 0; p < perm.size(); p++) {
+		if (perm[p] < 0 || perm[p] >= prog.num_targets())
+			throw ogu::Exception(__FILE__,__LINE__,
+								 "Permutation index out of range in FormulaDerEvaluator::set_order");
+		ts.push_back(prog.target(perm[p]));
+	}
+	if (custom_progs[order])
+		delete custom_progs[order];
+	custom_progs[order] = new EvalProgram(otree, ts);
+}
+
+void FormulaDerEvaluator::eval(const AtomValues& av, int order, double* res)
+{
+	if (ders.size() == 0)
+		return;
+	if (order < 0 || order >= (int)custom_progs.size() || ! custom_progs[order])
+		throw ogu::Exception(__FILE__,__LINE__,
+							 "Ordering of derivatives not set in FormulaDerEvaluator::eval");
+
+	etree.reset_all();
+	av.setValues(etree);
+
+	const EvalProgram& prog = *(custom_progs[order]);
+	for (int p = 0; p < prog.num_targets(); p++)
+		res[p] = prog.eval(etree, p);
 }
 
 void FormulaDerEvaluator::eval(const AtomValues& av, FormulaDerEvalLoader& loader, int order)
@@ -460,19 +677,18 @@ void FormulaDerEvaluator::eval(const AtomValues& av, FormulaDerEvalLoader& loade
 
 	int* vars = new int[order];
 
+	const EvalProgram& prog = *(progs[order]);
+	int ip = 0;
 	for (unsigned int i = 0; i < ders.size(); i++) {
-		for (FormulaDerivatives::Tfmiintmap::const_iterator it = ders[i]->ind2der.begin();
-			 it != ders[i]->ind2der.end(); ++it) {
-			const FoldMultiIndex& mi = (*it).first;
-			if (mi.order() == order) {
-				// set vars from multiindex mi and variables
-				for (int k = 0; k < order; k++)
-					vars[k] = der_atoms[mi[k]];
-				// evaluate
-				double res = etree.eval(ders[i]->tder[(*it).second]);
-				// load
-				loader.load(i, order, vars, res);
-			}
+		for (int j = ders[i]->order_beg[order]; j < ders[i]->order_beg[order+1]; j++) {
+			const FoldMultiIndex& mi = ders[i]->indices[j];
+			// set vars from multiindex mi and variables
+			for (int k = 0; k < order; k++)
+				vars[k] = der_atoms[mi[k]];
+			// evaluate
+			double res = prog.eval(etree, ip++);
+			// load
+			loader.load(i, order, vars, res);
 		}
 	}
 
@@ -61,6 +61,11 @@ namespace ogp
   {
     bool operator()(const FoldMultiIndex &i1, const FoldMultiIndex &i2) const;
   };
+  /** For hashing FoldMultiIndex in the unordered_map. */
+  struct fmihash
+  {
+    size_t operator()(const FoldMultiIndex &i) const;
+  };
 
   /** This class stores derivatives (tree indices) of one formula
    * for all orders upto a given one. It stores the derivatives as a
@@ -73,6 +78,10 @@ namespace ogp
    * The only reason we do not have only this map is that the
    * iterators of the map do not survive the insertions to the map,
    * and implementation of the constructor has to be very difficult.
+   *
+   * The sequence is ordered by the order of the derivatives and then
+   * lexicographically by the multiindices, so it is also used for
+   * an ordered traversal of the derivatives of a given order.
    */
   class FormulaDerivatives
   {
@@ -87,11 +96,14 @@ namespace ogp
     /** Vector of multiindices corresponding to the vector of
      * derivatives. */
     vector<FoldMultiIndex> indices;
-    /** For retrieving derivatives via a multiindex, we have a map
-     * mapping a multiindex to a derivative in the tder
+    /** For retrieving derivatives via a multiindex, we have a hash
+     * map mapping a multiindex to a derivative in the tder
      * ordering. This means that indices[ind2der[index]] == index. */
-    typedef map<FoldMultiIndex, int, ltfmi> Tfmiintmap;
+    typedef unordered_map<FoldMultiIndex, int, fmihash> Tfmiintmap;
     Tfmiintmap ind2der;
+    /** The derivatives of order k are in the interval
+     * <order_beg[k],order_beg[k+1]) of tder, for k upto order. */
+    vector<int> order_beg;
     /** The number of variables. */
     int nvar;
     /** The maximum order of derivatives. */
@@ -116,6 +128,10 @@ namespace ogp
     }
     /** Random access to the derivatives via multiindex. */
     int derivative(const FoldMultiIndex &mi) const;
+    /** Replace each tree index t of the derivatives by mp[t]. This
+     * is used when the derivatives were created in a copy of the
+     * tree merged by OperationTree::merge. */
+    void remap(const vector<int> &mp);
     /** Return the order. */
     int
     get_order() const
@@ -203,6 +219,14 @@ namespace ogp
     {
       return otree.add_substitution(t, subst, fp.otree);
     }
+    /** Adds a substitution remembering the substituted subterms in
+     * the given memo. This just calls
+     * OperationTree::add_substitution. */
+    int
+    add_substitution(int t, const map<int, int> &subst, map<int, int> &memo)
+    {
+      return otree.add_substitution(t, subst, otree, memo);
+    }
     /** This adds formulas from the given parser with (possibly)
      * different atoms applying substitutions from the given map
      * mapping atoms from fp to atoms of the object. */
@@ -239,8 +263,11 @@ namespace ogp
      * variables with respect to which the derivatives are taken
      * are obtained by Atoms::variables(). If the derivates exist,
      * they are destroyed and created again (with possibly
-     * different order). */
-    void differentiate(int max_order);
+     * different order). If num_threads is greater than one, the
+     * formulas are split among the threads, each thread
+     * differentiates its formulas in its own copy of the tree, and
+     * the copies are merged to the tree afterwards. */
+    void differentiate(int max_order, int num_threads = 1);
     /** Return i-th formula derivatives. */
     const FormulaDerivatives&derivatives(int i) const;
 
@@ -334,26 +361,49 @@ namespace ogp
     EvalTree etree;
     /** The custom tree indices to be evaluated. */
     vector<int> terms;
+    /** The compiled evaluation of the terms. */
+    EvalProgram prog;
+    /** The last tree index of etree, or -1 for the whole tree. */
+    int last;
+    /** The evaluation tree of directional derivatives, it is
+     * allocated by the first evaluation of the derivatives. */
+    EvalTree *dtree;
   public:
     /** Construct from FormulaParser and given list of terms. */
     FormulaCustomEvaluator(const FormulaParser &fp, const vector<int> &ts)
-      : etree(fp.otree), terms(ts)
+      : etree(fp.otree), terms(ts), prog(fp.otree, ts), last(-1), dtree(NULL)
     {
     }
     /** Construct from OperationTree and given list of terms. */
     FormulaCustomEvaluator(const OperationTree &ot, const vector<int> &ts)
-      : etree(ot), terms(ts)
+      : etree(ot), terms(ts), prog(ot, ts), last(-1), dtree(NULL)
+    {
+    }
+    virtual ~FormulaCustomEvaluator()
     {
+      if (dtree)
+        delete dtree;
     }
     /** Evaluate the terms using the given AtomValues and load the
      * results using the given loader. The loader is called for
      * each term in the order of the terms. */
     void eval(const AtomValues &av, FormulaEvalLoader &loader);
+    /** Evaluate the terms and their directional derivatives. The
+     * point is given by av, the direction by dav, which sets the
+     * nulary terms to the coordinates of the direction (zero for
+     * numerical constants and parameters). The values are loaded
+     * by the loader, the derivatives by the dloader. */
+    void eval(const AtomValues &av, const AtomValues &dav,
+              FormulaEvalLoader &loader, FormulaEvalLoader &dloader);
   protected:
     FormulaCustomEvaluator(const FormulaParser &fp)
-      : etree(fp.otree, fp.last_formula()), terms(fp.formulas)
+      : etree(fp.otree, fp.last_formula()), terms(fp.formulas),
+        prog(fp.otree, fp.formulas), last(fp.last_formula()), dtree(NULL)
     {
     }
+  private:
+    FormulaCustomEvaluator(const FormulaCustomEvaluator &);
+    const FormulaCustomEvaluator &operator=(const FormulaCustomEvaluator &);
   };
 
   /** This class evaluates zero derivatives of the FormulaParser. */
@@ -477,9 +527,34 @@ namespace ogp
     /** A copy of tree indices corresponding to atoms to with
      * respect the derivatives were taken. */
     vector<int> der_atoms;
+    /** The compiled evaluations of the derivatives, one for each
+     * order. The targets are all derivatives of the order of all
+     * formulas in the order in which they are loaded. */
+    vector<EvalProgram *> progs;
+    /** The compiled evaluations of the derivatives in the orderings
+     * given by set_order(), one for each order, NULL if the
+     * ordering has not been set. */
+    vector<EvalProgram *> custom_progs;
+    /** Reference to the OperationTree of the FormulaParser. */
+    const OperationTree &otree;
   public:
     /** Construct the object from FormulaParser. */
     FormulaDerEvaluator(const FormulaParser &fp);
+    /** Destructor deletes the programs. */
+    ~FormulaDerEvaluator();
+    /** Return the number of derivatives of the given order of all
+     * formulas, this is the number of loads made by eval(). */
+    int num_derivatives(int order) const;
+    /** Set the ordering in which the derivatives of the given order
+     * are output by the bulk eval(). The p-th output derivative is
+     * the perm[p]-th derivative in the ordering of the loads of
+     * eval() with a loader. This compiles a new program. */
+    void set_order(int order, const vector<int> &perm);
+    /** Evaluate all the derivatives of the given order at the given
+     * AtomValues and store them to res in the ordering given by
+     * set_order(). The res must have num_derivatives(order)
+     * elements. No loader is called. */
+    void eval(const AtomValues &av, int order, double *res);
     /** Evaluate the derivatives from the FormulaParser wrt to all
      * atoms in variables vector at the given AtomValues. The
      * given loader is used for output. */
@@ -490,6 +565,9 @@ namespace ogp
      * mapping to the indices (not values) of the der_atoms. */
     void eval(const vector<int> &mp, const AtomValues &av, FormulaDerEvalLoader &loader,
               int order);
+  private:
+    FormulaDerEvaluator(const FormulaDerEvaluator &);
+    const FormulaDerEvaluator &operator=(const FormulaDerEvaluator &);
   };
 };
 
@@ -7,6 +7,7 @@
 #include "location.h"
 #include "matrix_tab.hh"
 #include <cstring>
+#include <stdint.h>
 
 using namespace ogp;
 
@@ -21,12 +22,23 @@ void matrix__destroy_buffer(void*);
 int matrix_parse();
 extern ogp::location_type matrix_lloc;
 
+/** The magic starting a binary matrix. */
+static const char binary_magic[] = "OGPMATB\n";
+static const int binary_magic_len = 8;
+
 void MatrixParser::parse(int length, const char* stream)
 {
 	// reinitialize the object
 	data.clear();
 	row_lengths.clear();
 	nc = 0;
+	colmajor = false;
+	// binary matrix is not tokenized
+	if (length >= binary_magic_len
+		&& 0 == memcmp(stream, binary_magic, binary_magic_len)) {
+		parse_binary(length, stream);
+		return;
+	}
 	// allocate temporary buffer and parse
 	char* buffer = new char[length+2];
 	strncpy(buffer, stream, length);
@@ -61,6 +73,26 @@ void MatrixParser::error(const char* mes) const
 	throw ParserException(mes, matrix_lloc.off);
 }
 
+void MatrixParser::parse_binary(int length, const char* stream)
+{
+	int32_t dims[2];
+	int hlen = binary_magic_len + (int)sizeof(dims);
+	if (length < hlen)
+		throw ParserException("Binary matrix header too short", 0);
+	memcpy(dims, stream+binary_magic_len, sizeof(dims));
+	if (dims[0] < 0 || dims[1] < 0)
+		throw ParserException("Negative dimension of binary matrix", binary_magic_len);
+	if ((double)(length - hlen) != (double)dims[0]*dims[1]*sizeof(double))
+		throw ParserException("Wrong length of binary matrix data", hlen);
+	int n = dims[0]*dims[1];
+	data.resize(n);
+	if (n > 0)
+		memcpy(&(data[0]), stream+hlen, n*sizeof(double));
+	row_lengths.assign(dims[0], dims[1]);
+	nc = (dims[0] > 0) ? dims[1] : 0;
+	colmajor = true;
+}
+
 int MatrixParser::find_first_non_empty_row(int start) const
 {
 	int r = start;
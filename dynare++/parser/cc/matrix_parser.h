@@ -20,7 +20,15 @@ namespace ogp
    * in the row is not reconciliated, we do not construct a matrix
    * here. The class provides only an iterator to go through all
    * read items, the iterator provides information on row number and
-   * column number of the item. */
+   * column number of the item.
+   *
+   * If the string starts with the eight characters "OGPMATB\n", it
+   * is not tokenized but read as a binary matrix: the magic is
+   * followed by the number of rows and the number of columns as two
+   * 32-bit integers, and by the items as doubles in the column major
+   * order, all in the native byte order. The items are then kept in
+   * the column major order, so that they can be copied in one go to
+   * a matrix, see colmajor_data(). */
   class MPIterator;
   class MatrixParser
   {
@@ -32,13 +40,17 @@ namespace ogp
     vector<int> row_lengths;
     /** Maximum number of row lengths. */
     int nc;
+    /** True if the data are in the column major order of a binary
+     * matrix. */
+    bool colmajor;
   public:
     MatrixParser()
-      : nc(0)
+      : nc(0), colmajor(false)
     {
     }
     MatrixParser(const MatrixParser &mp)
-      : data(mp.data), row_lengths(mp.row_lengths), nc(mp.nc)
+      : data(mp.data), row_lengths(mp.row_lengths), nc(mp.nc),
+        colmajor(mp.colmajor)
     {
     }
     virtual ~MatrixParser()
@@ -56,6 +68,14 @@ namespace ogp
     {
       return nc;
     }
+    /** Return the items in the column major order of a nrows() by
+     * ncols() matrix if they were read from a binary matrix,
+     * otherwise NULL. */
+    const double *
+    colmajor_data() const
+    {
+      return (colmajor && !data.empty()) ? &(data[0]) : NULL;
+    }
     /** Parses a given data. This initializes the object data. */
     void parse(int length, const char *stream);
     /** Adds newly read item. This should be called from bison
@@ -76,6 +96,9 @@ namespace ogp
      * there is no other non-empty row, returns
      * row_lengths.size(). */
     int find_first_non_empty_row(int start = 0) const;
+    /** Reads a binary matrix from the stream, which starts with the
+     * magic. */
+    void parse_binary(int length, const char *stream);
   };
 
   /** This is an iterator intended to iterate through a matrix parsed
@@ -107,6 +130,8 @@ namespace ogp
     const double &
     operator*() const
     {
+      if (p->colmajor)
+        return p->data[c*p->row_lengths.size()+r];
       return p->data[i];
     }
     /** Return a row index of the pointed item. */
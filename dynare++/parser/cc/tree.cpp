@@ -9,6 +9,7 @@
 
 #include <cmath>
 #include <limits>
+#include <algorithm>
 
 #ifdef __MINGW32__
 #define __CROSS_COMPILATION__
@@ -36,6 +37,121 @@ double erffc(double x)
 	return x >= 0 ? r : 2-r;
 }
 
+OperationTable::OperationTable()
+	: slots(64, -1), num_used(0)
+{
+}
+
+/** This mixes the code and both operands, the Operation::hashval
+ * produces too many collisions for linear probing. */
+size_t OperationTable::hash(const Operation& op)
+{
+	size_t h = (size_t) op.getCode();
+	h = h*2654435761U + (size_t) (op.getOp1()+1);
+	h = h*2654435761U + (size_t) (op.getOp2()+1);
+	return h ^ (h >> 15);
+}
+
+int OperationTable::find(const vector<Operation>& terms, const Operation& op) const
+{
+	size_t mask = slots.size()-1;
+	for (size_t i = hash(op) & mask; slots[i] != -1; i = (i+1) & mask)
+		if (slots[i] >= 0 && terms[slots[i]] == op)
+			return slots[i];
+	return -1;
+}
+
+void OperationTable::insert(const vector<Operation>& terms, int t)
+{
+	if (2*(num_used+1) > (int) slots.size())
+		rehash(terms, 2*slots.size());
+	size_t mask = slots.size()-1;
+	size_t i = hash(terms[t]) & mask;
+	while (slots[i] >= 0)
+		i = (i+1) & mask;
+	if (slots[i] == -1)
+		num_used++;
+	slots[i] = t;
+}
+
+void OperationTable::erase(const vector<Operation>& terms, int t)
+{
+	size_t mask = slots.size()-1;
+	for (size_t i = hash(terms[t]) & mask; slots[i] != -1; i = (i+1) & mask)
+		if (slots[i] == t) {
+			slots[i] = -2;
+			return;
+		}
+}
+
+void OperationTable::rehash(const vector<Operation>& terms, int num_slots)
+{
+	vector<int> old;
+	old.swap(slots);
+	slots.assign(num_slots, -1);
+	num_used = 0;
+	for (unsigned int i = 0; i < old.size(); i++)
+		if (old[i] >= 0)
+			insert(terms, old[i]);
+}
+
+DerivativeTable::DerivativeTable()
+	: num_items(0)
+{
+	rehash(64);
+}
+
+size_t DerivativeTable::hash(int t, int v)
+{
+	size_t h = (size_t) t*2654435761U + (size_t) v;
+	h = h*2654435761U;
+	return h ^ (h >> 15);
+}
+
+int DerivativeTable::find(int t, int v) const
+{
+	size_t mask = slots.size()-1;
+	for (size_t i = hash(t, v) & mask; slots[i].t != -1; i = (i+1) & mask)
+		if (slots[i].t == t && slots[i].v == v)
+			return slots[i].der;
+	return -1;
+}
+
+void DerivativeTable::insert(int t, int v, int der)
+{
+	if (2*(num_items+1) > (int) slots.size())
+		rehash(2*slots.size());
+	size_t mask = slots.size()-1;
+	size_t i = hash(t, v) & mask;
+	for (; slots[i].t != -1; i = (i+1) & mask)
+		if (slots[i].t == t && slots[i].v == v)
+			return;
+	slots[i].t = t;
+	slots[i].v = v;
+	slots[i].der = der;
+	num_items++;
+}
+
+void DerivativeTable::clear()
+{
+	vector<Entry> empty;
+	slots.swap(empty);
+	num_items = 0;
+	rehash(64);
+}
+
+void DerivativeTable::rehash(int num_slots)
+{
+	vector<Entry> old;
+	old.swap(slots);
+	Entry empty = {-1, -1, -1};
+	slots.assign(num_slots, empty);
+	num_items = 0;
+	for (unsigned int i = 0; i < old.size(); i++)
+		if (old[i].t != -1)
+			insert(old[i].t, old[i].v, old[i].der);
+}
+
 /** Here we initialize OperationTree to contain only zero, one, nan
  * and two_over_pi terms. */
 OperationTree::OperationTree()
@@ -54,8 +170,6 @@ int OperationTree::add_nulary()
 	_Tintset s;
 	s.insert(op);
 	nul_incidence.push_back(s);
-	_Tderivmap empty;
-	derivatives.push_back(empty);
 	last_nulary = op;
 	return op;
 }
@@ -77,21 +191,18 @@ int OperationTree::add_unary(code_t code, int op)
 		return one;
 
 	Operation unary(code, op);
-	_Topmap::const_iterator i = ((const _Topmap&)opmap).find(unary);
-	if (i == opmap.end()) {
+	int i = opmap.find(terms, unary);
+	if (i == -1) {
 		int newop = terms.size();
 		// add to the terms
 		terms.push_back(unary);
 		// copy incidence of the operand
 		nul_incidence.push_back(nul_incidence[op]);
 		// insert it to opmap
-		opmap.insert(_Topval(unary, newop));
-		// add empty map of derivatives
-		_Tderivmap empty;
-		derivatives.push_back(empty);
+		opmap.insert(terms, newop);
 		return newop;
 	}
-	return (*i).second;
+	return i;
 }
 
 int OperationTree::add_binary(code_t code, int op1, int op2)
@@ -159,21 +270,18 @@ int OperationTree::add_binary(code_t code, int op1, int op2)
 
 	// construct operation and check/add it
 	Operation binary(code, op1, op2);
-	_Topmap::const_iterator i = ((const _Topmap&)opmap).find(binary);
-	if (i == opmap.end()) {
+	int i = opmap.find(terms, binary);
+	if (i == -1) {
 		int newop = terms.size();
 		terms.push_back(binary);
 		// sum both sets of incidenting nulary operations
 		nul_incidence.push_back(nul_incidence[op1]);
 		nul_incidence.back().insert(nul_incidence[op2].begin(), nul_incidence[op2].end());
 		// add to opmap
-		opmap.insert(_Topval(binary, newop));
-		// add empty map of derivatives
-		_Tderivmap empty;
-		derivatives.push_back(empty);
+		opmap.insert(terms, newop);
 		return newop;
 	}
-	return (*i).second;
+	return i;
 }
 
 int OperationTree::add_derivative(int t, int v)
@@ -194,9 +302,9 @@ int OperationTree::add_derivative(int t, int v)
 	}
 
 	// quick return if the derivative has been registered
-	_Tderivmap::const_iterator i = derivatives[t].find(v);
-	if (i != derivatives[t].end())
-		return (*i).second;
+	int i = derivatives.find(t, v);
+	if (i != -1)
+		return i;
 
 	int res = -1;
 	switch (terms[t].getCode()) {
@@ -338,6 +446,13 @@ int OperationTree::add_substitution(int t, const map<int,int>& subst)
 
 int OperationTree::add_substitution(int t, const map<int,int>& subst,
 									const OperationTree& otree)
+{
+	map<int,int> memo;
+	return add_substitution(t, subst, otree, memo);
+}
+
+int OperationTree::add_substitution(int t, const map<int,int>& subst,
+									const OperationTree& otree, map<int,int>& memo)
 {
 	// return substitution of t if it is in the map
 	map<int,int>::const_iterator it = subst.find(t);
@@ -345,15 +460,25 @@ int OperationTree::add_substitution(int t, const map<int,int>& subst,
 		return (*it).second;
 
 	int nary = otree.terms[t].nary();
+	if (nary > 0) {
+		// return t if it has been already substituted
+		it = memo.find(t);
+		if (memo.end() != it)
+			return (*it).second;
+	}
 	if (nary == 2) {
 		// return the binary operation of the substituted terms
-		int t1 = add_substitution(otree.terms[t].getOp1(), subst, otree);
-		int t2 = add_substitution(otree.terms[t].getOp2(), subst, otree);
-		return add_binary(otree.terms[t].getCode(), t1, t2);
+		int t1 = add_substitution(otree.terms[t].getOp1(), subst, otree, memo);
+		int t2 = add_substitution(otree.terms[t].getOp2(), subst, otree, memo);
+		int res = add_binary(otree.terms[t].getCode(), t1, t2);
+		memo.insert(map<int,int>::value_type(t, res));
+		return res;
 	} else if (nary == 1) {
 		// return the unary operation of the substituted term
-		int t1 = add_substitution(otree.terms[t].getOp1(), subst, otree);
-		return add_unary(otree.terms[t].getCode(), t1);
+		int t1 = add_substitution(otree.terms[t].getOp1(), subst, otree, memo);
+		int res = add_unary(otree.terms[t].getCode(), t1);
+		memo.insert(map<int,int>::value_type(t, res));
+		return res;
 	} else {
 		// if t is not the first num_constants, and otree is not this
 		// tree, then raise and exception. Otherwise return t, since
@@ -371,12 +496,39 @@ int OperationTree::add_substitution(int t, const map<int,int>& subst,
 }
 
 
+void OperationTree::merge(const OperationTree& ot, int first, vector<int>& mp)
+{
+	if (first < num_constants || first > (int) ot.terms.size() || first > (int) terms.size())
+		throw ogu::Exception(__FILE__,__LINE__,
+							 "Wrong first term in OperationTree::merge");
+
+	mp.resize(ot.terms.size());
+	for (int t = 0; t < first; t++)
+		mp[t] = t;
+	// operands have lower indices, so they are mapped before the term
+	for (int t = first; t < (int) ot.terms.size(); t++) {
+		const Operation& op = ot.terms[t];
+		if (op.nary() == 2)
+			mp[t] = add_binary(op.getCode(), mp[op.getOp1()], mp[op.getOp2()]);
+		else if (op.nary() == 1)
+			mp[t] = add_unary(op.getCode(), mp[op.getOp1()]);
+		else
+			throw ogu::Exception(__FILE__,__LINE__,
+								 "Nulary term cannot be merged in OperationTree::merge");
+	}
+
+	// merge the derivative mappings
+	for (int i = 0; i < ot.derivatives.num_slots(); i++) {
+		const DerivativeTable::Entry& e = ot.derivatives.slot(i);
+		if (e.t != -1)
+			register_derivative(mp[e.t], e.v, mp[e.der]);
+	}
+}
+
 void OperationTree::nularify(int t)
 {
 	// remove the original operation from opmap
-	_Topmap::iterator it = opmap.find(terms[t]);
-	if (it != opmap.end())
-		opmap.erase(it);
+	opmap.erase(terms, t);
 	// turn the operation to nulary
 	Operation nulary_op;
 	terms[t] = nulary_op;
@@ -390,7 +542,7 @@ void OperationTree::nularify(int t)
 void OperationTree::register_derivative(int t, int v, int tder)
 {
 	// todo: might check that the insert inserts a new pair
-	derivatives[t].insert(_Tderivmap::value_type(v, tder));
+	derivatives.insert(t, v, tder);
 }
 
 unordered_set<int> OperationTree::select_terms(int t, const opselector& sel) const
@@ -451,8 +603,20 @@ bool OperationTree::select_terms_inv(int t, const opselector& sel, unordered_set
 
 void OperationTree::forget_derivative_maps()
 {
-	for (unsigned int i = 0; i < derivatives.size(); i++)
-		derivatives[i].clear();
+	derivatives.clear();
+}
+
+void OperationTree::memory(size_t& terms_mem, size_t& opmap_mem, size_t& ders_mem,
+						   size_t& incidence_mem) const
+{
+	terms_mem = terms.capacity()*sizeof(Operation);
+	opmap_mem = opmap.memory();
+	ders_mem = derivatives.memory();
+	// a bucket pointer and a node of a value, a pointer and a hash per item
+	incidence_mem = nul_incidence.capacity()*sizeof(_Tintset);
+	for (unsigned int i = 0; i < nul_incidence.size(); i++)
+		incidence_mem += nul_incidence[i].bucket_count()*sizeof(void*)
+			+ nul_incidence[i].size()*(sizeof(int)+sizeof(void*)+sizeof(size_t));
 }
 
 
@@ -672,6 +836,227 @@ void EvalTree::print() const
 	}
 }
 
+EvalProgram::EvalProgram(const OperationTree& otree, const vector<int>& ts)
+	: targets(ts), max_term(OperationTree::num_constants-1)
+{
+	vector<bool> needed(otree.get_num_op(), false);
+	for (int i = 0; i < OperationTree::num_constants; i++)
+		needed[i] = true;
+
+	instr_start.push_back(0);
+	nulary_start.push_back(0);
+	vector<int> stack;
+	vector<int> seg;
+	for (unsigned int i = 0; i < targets.size(); i++) {
+		int t = targets[i];
+		if (t < 0 || t >= otree.get_num_op())
+			throw ogu::Exception(__FILE__,__LINE__,
+								 "The tree index out of bounds in EvalProgram constructor");
+		if (t > max_term)
+			max_term = t;
+		// collect the terms needed for t which are not needed yet
+		seg.clear();
+		if (! needed[t]) {
+			needed[t] = true;
+			stack.push_back(t);
+		}
+		while (! stack.empty()) {
+			int s = stack.back();
+			stack.pop_back();
+			seg.push_back(s);
+			const Operation& op = otree.operation(s);
+			if (op.nary() >= 1 && ! needed[op.getOp1()]) {
+				needed[op.getOp1()] = true;
+				stack.push_back(op.getOp1());
+			}
+			if (op.nary() == 2 && ! needed[op.getOp2()]) {
+				needed[op.getOp2()] = true;
+				stack.push_back(op.getOp2());
+			}
+		}
+		// operands have lower indices, so this is a topological order
+		std::sort(seg.begin(), seg.end());
+		for (unsigned int j = 0; j < seg.size(); j++) {
+			const Operation& op = otree.operation(seg[j]);
+			if (op.nary() == 0) {
+				nulary.push_back(seg[j]);
+				continue;
+			}
+			Instruction ins;
+			ins.code = op.getCode();
+			ins.t = seg[j];
+			ins.op1 = op.getOp1();
+			ins.op2 = (op.nary() == 2)? op.getOp2() : -1;
+			// inspect the factor with less nulary terms first as EvalTree::eval does
+			if (ins.code == TIMES
+				&& otree.nulary_of_term(ins.op1).size() >= otree.nulary_of_term(ins.op2).size()) {
+				ins.op1 = op.getOp2();
+				ins.op2 = op.getOp1();
+			}
+			instrs.push_back(ins);
+		}
+		instr_start.push_back((int)instrs.size());
+		nulary_start.push_back((int)nulary.size());
+	}
+}
+
+double EvalProgram::apply(const Instruction& ins, const double* values)
+{
+	double r1 = values[ins.op1];
+	switch (ins.code) {
+	case UMINUS:
+		return -r1;
+	case LOG:
+		return log(r1);
+	case EXP:
+		return exp(r1);
+	case SIN:
+		return sin(r1);
+	case COS:
+		return cos(r1);
+	case TAN:
+		return tan(r1);
+	case SQRT:
+		return sqrt(r1);
+	case ERF:
+		return 1-erffc(r1);
+	case ERFC:
+		return erffc(r1);
+	case PLUS:
+		return r1 + values[ins.op2];
+	case MINUS:
+		return r1 - values[ins.op2];
+	case TIMES:
+		return (r1 == 0.0)? 0.0 : r1*values[ins.op2];
+	case DIVIDE:
+		return (r1 == 0.0)? 0.0 : r1/values[ins.op2];
+	case POWER:
+		return (values[ins.op2] == 0.0)? 1.0 : pow(r1, values[ins.op2]);
+	default:
+		throw ogu::Exception(__FILE__,__LINE__,
+							 "Unknown operation code in EvalProgram::apply");
+	}
+	return 0.0;
+}
+
+double EvalProgram::apply_tangent(const Instruction& ins, const double* values,
+								  const double* tangents, double res)
+{
+	double r1 = values[ins.op1];
+	double d1 = tangents[ins.op1];
+	switch (ins.code) {
+	case UMINUS:
+		return -d1;
+	case LOG:
+		return d1/r1;
+	case EXP:
+		return res*d1;
+	case SIN:
+		return cos(r1)*d1;
+	case COS:
+		return -sin(r1)*d1;
+	case TAN:
+		return d1/(cos(r1)*cos(r1));
+	case SQRT:
+		return d1/(2*res);
+	case ERF:
+		return 2.0/sqrt(M_PI)*exp(-r1*r1)*d1;
+	case ERFC:
+		return -2.0/sqrt(M_PI)*exp(-r1*r1)*d1;
+	case PLUS:
+		return d1 + tangents[ins.op2];
+	case MINUS:
+		return d1 - tangents[ins.op2];
+	case TIMES:
+		// r1 is the factor inspected first, see apply()
+		if (r1 == 0.0)
+			return d1*values[ins.op2];
+		return d1*values[ins.op2] + r1*tangents[ins.op2];
+	case DIVIDE:
+		return (d1 - res*tangents[ins.op2])/values[ins.op2];
+	case POWER:
+	{
+		double r2 = values[ins.op2];
+		double d2 = tangents[ins.op2];
+		if (r2 == 0.0 && d2 == 0.0)
+			return 0.0;
+		double der = (d1 == 0.0)? 0.0 : r2*pow(r1, r2-1)*d1;
+		if (d2 != 0.0)
+			der += res*log(r1)*d2;
+		return der;
+	}
+	default:
+		throw ogu::Exception(__FILE__,__LINE__,
+							 "Unknown operation code in EvalProgram::apply_tangent");
+	}
+	return 0.0;
+}
+
+void EvalProgram::check(const EvalTree& et, int from, int to) const
+{
+	if (max_term > et.last_operation)
+		throw ogu::Exception(__FILE__,__LINE__,
+							 "The tree index out of bounds in EvalProgram::eval");
+	for (int j = nulary_start[from]; j < nulary_start[to]; j++)
+		if (! et.flags[nulary[j]])
+			throw ogu::Exception(__FILE__,__LINE__,
+								 "Nulary term has not been assigned a value in EvalProgram::eval");
+}
+
+void EvalProgram::run(EvalTree& et, int from, int to) const
+{
+	for (int j = instr_start[from]; j < instr_start[to]; j++) {
+		const Instruction& ins = instrs[j];
+		et.values[ins.t] = apply(ins, et.values);
+		et.flags[ins.t] = true;
+	}
+}
+
+double EvalProgram::eval(EvalTree& et, int i) const
+{
+	check(et, i, i+1);
+	run(et, i, i+1);
+	return et.values[targets[i]];
+}
+
+void EvalProgram::eval(EvalTree& et, EvalTree& dt, int i, double& val, double& der) const
+{
+	check(et, i, i+1);
+	check(dt, i, i+1);
+	// the constants do not move in any direction
+	for (int k = 0; k < OperationTree::num_constants; k++)
+		dt.values[k] = 0.0;
+	for (int j = instr_start[i]; j < instr_start[i+1]; j++) {
+		const Instruction& ins = instrs[j];
+		double res = apply(ins, et.values);
+		dt.values[ins.t] = apply_tangent(ins, et.values, dt.values, res);
+		dt.flags[ins.t] = true;
+		et.values[ins.t] = res;
+		et.flags[ins.t] = true;
+	}
+	val = et.values[targets[i]];
+	der = dt.values[targets[i]];
+}
+
+void EvalProgram::eval(EvalTree& et) const
+{
+	check(et, 0, num_targets());
+	run(et, 0, num_targets());
+}
+
+void EvalProgram::eval(EvalTree* const* ets, int num) const
+{
+	for (int k = 0; k < num; k++)
+		check(*(ets[k]), 0, num_targets());
+	for (unsigned int j = 0; j < instrs.size(); j++) {
+		const Instruction& ins = instrs[j];
+		for (int k = 0; k < num; k++) {
+			ets[k]->values[ins.t] = apply(ins, ets[k]->values);
+			ets[k]->flags[ins.t] = true;
+		}
+	}
+}
+
 void DefaultOperationFormatter::format(const Operation& op, int t, FILE* fd)
 {
 	// add to the stop_set
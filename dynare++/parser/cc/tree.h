@@ -150,6 +150,91 @@ namespace ogp
   class DefaultOperationFormatter;
 
   /** Forward declaration of EvalTree to make it friend of OperationTree. */
+  /** This is an open addressing hash table of unary and binary
+   * terms used by OperationTree to guarantee their uniqueness. The
+   * table stores only tree indices, the operations themselves are
+   * looked up in the vector of terms of the tree, which is passed to
+   * all methods. The table has a power of two slots, the collisions
+   * are resolved by linear probing, and it is grown twice when it
+   * gets half full. */
+  class OperationTable
+  {
+    /** The slots, an empty slot is -1, a slot of an erased term is
+     * -2, otherwise it is a tree index. */
+    vector<int> slots;
+    /** The number of the slots which are not empty (including the
+     * erased ones). */
+    int num_used;
+  public:
+    OperationTable();
+    /** Return the tree index of the given operation or -1 if it is
+     * not in the table. */
+    int find(const vector<Operation> &terms, const Operation &op) const;
+    /** Insert the term t, which must not be in the table yet. */
+    void insert(const vector<Operation> &terms, int t);
+    /** Erase the term t if it is in the table. */
+    void erase(const vector<Operation> &terms, int t);
+    /** Return the number of allocated bytes. */
+    size_t
+    memory() const
+    {
+      return slots.capacity()*sizeof(int);
+    }
+  protected:
+    static size_t hash(const Operation &op);
+    void rehash(const vector<Operation> &terms, int num_slots);
+  };
+
+  /** This is an open addressing hash table mapping pairs of a term
+   * and a variable (nulary term) to the derivative of the term with
+   * respect to the variable. It replaces a map per term, so that a
+   * term which has not been differentiated costs nothing. */
+  class DerivativeTable
+  {
+  public:
+    /** An entry of the table, an empty entry has t equal to -1. */
+    struct Entry
+    {
+      int t;
+      int v;
+      int der;
+    };
+  protected:
+    vector<Entry> slots;
+    int num_items;
+  public:
+    DerivativeTable();
+    /** Return the derivative of t wrt v or -1 if it is not in the
+     * table. */
+    int find(int t, int v) const;
+    /** Insert the derivative of t wrt v. If it is already in the
+     * table, nothing is changed. */
+    void insert(int t, int v, int der);
+    /** Remove all entries. */
+    void clear();
+    /** Return the number of the slots; together with slot() this
+     * allows for an iteration over all entries. */
+    int
+    num_slots() const
+    {
+      return (int) slots.size();
+    }
+    const Entry &
+    slot(int i) const
+    {
+      return slots[i];
+    }
+    /** Return the number of allocated bytes. */
+    size_t
+    memory() const
+    {
+      return slots.capacity()*sizeof(Entry);
+    }
+  protected:
+    static size_t hash(int t, int v);
+    void rehash(int num_slots);
+  };
+
   class EvalTree;
 
   /** Class representing a set of trees for terms. Each term is
@@ -161,8 +246,7 @@ namespace ogp
    * the caller, since at this level of Operation abstraction, one
    * cannot discriminate between different nulary operations
    * (constants, variables). The uniqueness is enforced by the
-   * unordered_map whose keys are operations and values are integers
-   * (indices of the terms).
+   * OperationTable of the indices of the terms.
 
    * This class can also make derivatives of a given term with
    * respect to a given nulary term. I order to be able to quickly
@@ -173,9 +257,9 @@ namespace ogp
    *
    * In addition, many term can be differentiated multiple times wrt
    * one variable since they can be referenced multiple times. To
-   * avoid this, for each term we maintain a map mapping variables
-   * to the derivatives of the term. As the caller will
-   * differentiate wrt more and more variables, these maps will
+   * avoid this, we maintain a DerivativeTable mapping terms and
+   * variables to the derivatives of the terms. As the caller will
+   * differentiate wrt more and more variables, the table will
    * become richer and richer.
    */
   class OperationTree
@@ -187,14 +271,9 @@ namespace ogp
      * uniquelly determines the term. */
     vector<Operation> terms;
 
-    /** This defines a type for a map mapping the unary and binary
-     * operations to their indices. */
-    typedef unordered_map<Operation, int, ophash> _Topmap;
-    typedef _Topmap::value_type _Topval;
-
-    /** This is the map mapping the unary and binary operations to
-     * the indices of the terms.*/
-    _Topmap opmap;
+    /** This is the table of the indices of the unary and binary
+     * operations. */
+    OperationTable opmap;
 
     /** This is a type for a set of integers. */
     typedef unordered_set<int> _Tintset;
@@ -202,13 +281,10 @@ namespace ogp
      * nulary terms contained in the term. */
     vector<_Tintset> nul_incidence;
 
-    /** This is a type of the map from variables (nulary terms) to
-     * the terms. */
-    typedef unordered_map<int, int> _Tderivmap;
-    /** This is a vector of derivative mappings. For each term, it
-     * maps variables to the derivatives of the term with respect
-     * to the variables. */
-    vector<_Tderivmap> derivatives;
+    /** This is the derivative mapping. It maps terms and variables
+     * to the derivatives of the terms with respect to the
+     * variables. */
+    DerivativeTable derivatives;
 
     /** The tree index of the last nulary term. */
     int last_nulary;
@@ -281,6 +357,29 @@ namespace ogp
     int add_substitution(int t, const map<int, int> &subst,
                          const OperationTree &otree);
 
+    /** The same as above, but the substituted subterms of otree are
+     * remembered in the given memo, so each shared subterm is
+     * substituted only once. The memo can be passed to subsequent
+     * calls with the same substitution map and the same otree
+     * (which must not change in the meantime, e.g. by nularify),
+     * then the common subterms of the terms are substituted only
+     * once for all the calls. */
+    int add_substitution(int t, const map<int, int> &subst,
+                         const OperationTree &otree, map<int, int> &memo);
+
+    /** Add the terms of the given tree from the index first on to
+     * this tree. The terms of the given tree below first must be
+     * the same as the terms of this tree, this is the case if the
+     * given tree was copied from this one and only unary and binary
+     * terms were added to both the trees since then. The derivative
+     * mappings of the given tree are merged as well.
+     * @param ot the tree whose terms are added
+     * @param first the first term of ot to be added
+     * @param mp the computed mapping of the tree indices of ot to
+     * the tree indices of this tree
+     */
+    void merge(const OperationTree &ot, int first, vector<int> &mp);
+
     /** This method turns the given term to a nulary
      * operation. This is an only method, which changes already
      * existing term (all other methods add something new). User
@@ -351,6 +450,12 @@ namespace ogp
     {
       return (int) (terms.size());
     }
+
+    /** Return the number of bytes allocated for the terms, the
+     * table of operations, the derivative mappings, and the
+     * incidences of nulary terms. The last is an estimate. */
+    void memory(size_t &terms_mem, size_t &opmap_mem, size_t &ders_mem,
+                size_t &incidence_mem) const;
   private:
     /** This registers a calculated derivative of the term in the
      * #derivatives vector.
@@ -394,8 +499,11 @@ namespace ogp
    * subclasses of OperationTree and EvalTree, since we need a
    * support for this in OperationTree.
    */
+  class EvalProgram;
+
   class EvalTree
   {
+    friend class EvalProgram;
   protected:
     /** Reference to the OperationTree over which all evaluations
      * are done. */
@@ -436,6 +544,108 @@ namespace ogp
     EvalTree(const EvalTree &);
   };
 
+  /** This is a linearized evaluation of a given sequence of terms
+   * (targets) of the OperationTree. In the constructor, all the
+   * unary and binary terms needed for the targets are collected and
+   * sorted by their tree indices. Since the operands of a term have
+   * always lower indices than the term, this gives a topological
+   * ordering, and the terms can be evaluated by a single forward
+   * sweep over the instructions without any recursion and without
+   * checking the evaluation flags. The instructions are split into
+   * segments, the i-th segment contains the terms needed for the
+   * i-th target which are not needed by any of the preceding
+   * targets. So the targets can be evaluated one after another, and
+   * a caller can change values of nulary terms between them (as
+   * AtomAsgnEvaluator does).
+   *
+   * The results are the same as of EvalTree::eval, in particular a
+   * product is zero if its first evaluated factor is zero, a ratio
+   * is zero if its numerator is zero, and a power is one if its
+   * exponent is zero. The difference is that the sweep evaluates
+   * also the operands which EvalTree::eval would skip. The results
+   * are stored in the given EvalTree and flagged as evaluated, so
+   * that EvalTree::eval can be used afterwards to retrieve them. */
+  class EvalProgram
+  {
+  protected:
+    /** One instruction computes the term t from its operands. For
+     * binary operations, op1 is the operand inspected first. */
+    struct Instruction
+    {
+      code_t code;
+      int t;
+      int op1;
+      int op2;
+    };
+    /** The instructions of all segments. */
+    vector<Instruction> instrs;
+    /** The nulary terms (besides the constants) read by
+     * the instructions of all segments. */
+    vector<int> nulary;
+    /** The targets. */
+    vector<int> targets;
+    /** The i-th segment of instructions starts at instr_start[i],
+     * and ends before instr_start[i+1]. */
+    vector<int> instr_start;
+    /** The same as instr_start for the nulary terms. */
+    vector<int> nulary_start;
+    /** The maximum tree index read or written by the program. */
+    int max_term;
+  public:
+    /** Compile the program for the given targets. */
+    EvalProgram(const OperationTree &otree, const vector<int> &ts);
+    /** Return the number of targets. */
+    int
+    num_targets() const
+    {
+      return (int) targets.size();
+    }
+    /** Return the i-th target. */
+    int
+    target(int i) const
+    {
+      return targets[i];
+    }
+    /** Return the number of instructions. */
+    int
+    num_instructions() const
+    {
+      return (int) instrs.size();
+    }
+    /** Evaluate the i-th segment in the given EvalTree and return
+     * the value of the i-th target. The segments preceding i must
+     * have been evaluated since the last EvalTree::reset_all. */
+    double eval(EvalTree &et, int i) const;
+    /** Evaluate all the targets in the given EvalTree. */
+    void eval(EvalTree &et) const;
+    /** Evaluate all the targets in the given number of EvalTrees,
+     * each of them holding the nulary terms of one point. The
+     * instructions are decoded once for all the trees. */
+    void eval(EvalTree *const *ets, int num) const;
+    /** Evaluate the i-th segment in the given EvalTree together
+     * with the directional derivatives (the forward mode) in the
+     * other EvalTree dt, whose nulary terms hold the direction
+     * (numerical constants and parameters must be set to zero, the
+     * special constants of dt are zeroed here). The values of the
+     * i-th target are returned in val and der. */
+    void eval(EvalTree &et, EvalTree &dt, int i, double &val, double &der) const;
+  protected:
+    /** Check that the given EvalTree is large enough and that the
+     * nulary terms of the segments [from, to) are set. */
+    void check(const EvalTree &et, int from, int to) const;
+    /** Return the value of the term computed by the instruction
+     * from the given values of its operands. */
+    static double apply(const Instruction &ins, const double *values);
+    /** Return the directional derivative of the term computed by
+     * the instruction given the values and the derivatives of its
+     * operands, and its value res. */
+    static double apply_tangent(const Instruction &ins, const double *values,
+                                const double *tangents, double res);
+    /** Run the instructions of the segments [from, to) in the
+     * given EvalTree. */
+    void run(EvalTree &et, int from, int to) const;
+  };
+
   /** This is an interface describing how a given operation is
    * formatted for output. */
   class OperationFormatter
@@ -11,6 +11,8 @@
 #include "../tl/cc/tl_exception.h"
 #include "../kord/kord_exception.h"
 
+#include <algorithm>
+
 #ifndef DYNVERSION
 #define DYNVERSION "unknown"
 #endif
@@ -41,7 +43,7 @@ vector<int> DynareNameList::selectIndices(const vector<const char*>& ns) const
 
 Dynare::Dynare(const char* modname, int ord, double sstol, Journal& jr)
 	: journal(jr), model(NULL), ysteady(NULL), md(1), dnl(NULL), denl(NULL), dsnl(NULL),
-	  fe(NULL), fde(NULL), ss_tol(sstol)
+	  fe(NULL), fde(NULL), ss_tol(sstol), ss_krylov(false), md_bulk(false)
 {
 	// make memory file
 	ogu::MemoryFile mf(modname);
@@ -72,7 +74,7 @@ Dynare::Dynare(const char** endo, int num_endo,
 			   const char* equations, int len, int ord,
 			   double sstol, Journal& jr)
 	: journal(jr), model(NULL), ysteady(NULL), md(1), dnl(NULL), denl(NULL), dsnl(NULL),
-	  fe(NULL), fde(NULL), ss_tol(sstol)
+	  fe(NULL), fde(NULL), ss_tol(sstol), ss_krylov(false), md_bulk(false)
 {
 	try {
 		model = new ogdyn::DynareSPModel(endo, num_endo, exo, num_exo, par, num_par,
@@ -93,7 +95,7 @@ Dynare::Dynare(const Dynare& dynare)
 	: journal(dynare.journal), model(NULL),
 	  ysteady(NULL), md(dynare.md),
 	  dnl(NULL), denl(NULL), dsnl(NULL), fe(NULL), fde(NULL),
-	  ss_tol(dynare.ss_tol)
+	  ss_tol(dynare.ss_tol), ss_krylov(dynare.ss_krylov), md_bulk(false)
 {
 	model = dynare.model->clone();
 	ysteady = new Vector(*(dynare.ysteady));
@@ -165,10 +167,18 @@ void Dynare::solveDeterministicSteady(Vector& steady)
 	pa << "Non-linear solver for deterministic steady state" << endrec;
 	steady = (const Vector&) model->getInit();
 	DynareVectorFunction dvf(*this);
-	DynareJacobian dj(*this);
-	ogu::NLSolver nls(dvf, dj, 500, ss_tol, journal);
 	int iter;
-	if (! nls.solve(steady, iter))
+	bool converged;
+	if (ss_krylov) {
+		DynareSparseJacobian dj(*this);
+		ogu::NKSolver nks(dvf, dj, 500, ss_tol, journal);
+		converged = nks.solve(steady, iter);
+	} else {
+		DynareJacobian dj(*this);
+		ogu::NLSolver nls(dvf, dj, 500, ss_tol, journal);
+		converged = nls.solve(steady, iter);
+	}
+	if (! converged)
 		throw DynareException(__FILE__, __LINE__,
 							  "Could not obtain convergence in non-linear solver");
 }
@@ -192,14 +202,46 @@ void Dynare::evaluateSystem(Vector& out, const Vector& yym, const Vector& yy,
 	fe->eval(dav, del);
 }
 
+// evaluate the static system at y_t=y_{t+1}=y_{t-1}=yy with zero
+// shocks and its derivative in the direction dy by the forward mode
+void Dynare::evaluateSystem(Vector& out, Vector& dout, const Vector& yy, const Vector& dy)
+{
+	ogdyn::DynareSteadyAtomValues dav(model->getAtoms(), model->getParams(), yy);
+	ogdyn::DynareSteadyTangentAtomValues tdav(model->getAtoms(), dy);
+	DynareEvalLoader del(model->getAtoms(), out);
+	DynareEvalLoader tdel(model->getAtoms(), dout);
+	fe->eval(dav, tdav, del, tdel);
+}
+
 void Dynare::calcDerivatives(const Vector& yy, const Vector& xx)
 {
 	ConstVector yym(yy, nstat(), nys());
 	ConstVector yyp(yy, nstat()+npred(), nyss());
 	ogdyn::DynareAtomValues dav(model->getAtoms(), model->getParams(), yym, yy, yyp, xx);
-	DynareDerEvalLoader ddel(model->getAtoms(), md, model->getOrder());
+
+	// the structure of the derivatives does not depend on the point,
+	// so after the first evaluation, the values are evaluated in the
+	// ordering of the tensors and overwritten in place
+	if (md_bulk) {
+		for (int iord = 1; iord <= model->getOrder(); iord++) {
+			FSSparseTensor* t = md.get(Symmetry(iord));
+			Vector vals(t->getNumNonZero());
+			fde->eval(dav, iord, vals.base());
+			t->setValues(vals);
+		}
+		return;
+	}
+
+	DynareDerBulkLoader ddel(model->getAtoms(), md, model->getOrder());
 	for (int iord = 1; iord <= model->getOrder(); iord++)
 		fde->eval(dav, ddel, iord);
+	for (int iord = 1; iord <= model->getOrder(); iord++) {
+		std::vector<int> perm;
+		ddel.getOrdering(iord, perm);
+		fde->set_order(iord, perm);
+		md.get(Symmetry(iord))->freeze();
+	}
+	md_bulk = true;
 }
 
 void Dynare::calcDerivativesAtSteady()
@@ -229,6 +271,25 @@ void Dynare::writeModelInfo(Journal& jr) const
 		rec6 << "Number of both:                  " << nboth() << endrec;
 	}
 
+	// write info on the operation tree
+	{
+		const ogp::OperationTree& otree = model->getParser().getTree();
+		size_t terms_mem, opmap_mem, ders_mem, incidence_mem;
+		otree.memory(terms_mem, opmap_mem, ders_mem, incidence_mem);
+		JournalRecordPair rp(journal);
+		rp << "Information on the operation tree" << endrec;
+		JournalRecord rec1(journal);
+		rec1 << "Number of terms:                 " << otree.get_num_op() << endrec;
+		JournalRecord rec2(journal);
+		rec2 << "Terms (MB):                      " << terms_mem/1048576. << endrec;
+		JournalRecord rec3(journal);
+		rec3 << "Table of operations (MB):        " << opmap_mem/1048576. << endrec;
+		JournalRecord rec4(journal);
+		rec4 << "Derivative table (MB):           " << ders_mem/1048576. << endrec;
+		JournalRecord rec5(journal);
+		rec5 << "Nulary incidences (MB):          " << incidence_mem/1048576. << endrec;
+	}
+
 	// write info on planner variables
 	const ogdyn::PlannerInfo* pinfo = model->get_planner_info();
 	if (pinfo) {
@@ -324,6 +385,44 @@ void DynareDerEvalLoader::load(int i, int iord, const int* vars, double res)
 	t->insert(s, i, res);
 }
 
+DynareDerBulkLoader::DynareDerBulkLoader(const ogp::FineAtoms& a,
+										 TensorContainer<FSSparseTensor>& mod_ders,
+										 int order)
+	: DynareDerEvalLoader(a, mod_ders, order), loaded(order+1)
+{
+}
+
+void DynareDerBulkLoader::load(int i, int iord, const int* vars, double res)
+{
+	DynareDerEvalLoader::load(i, iord, vars, res);
+	IntSequence s(iord, 0);
+	for (int j = 0; j < iord; j++)
+		s[j] = atoms.get_pos_of_all(vars[j]);
+	loaded[iord].push_back(Tkeyrow(s, i));
+}
+
+/** The loads are sorted by the key and row, then each item of the
+ * tensor is found in the sorted loads by a binary search. */
+void DynareDerBulkLoader::getOrdering(int iord, std::vector<int>& perm) const
+{
+	const std::vector<Tkeyrow>& ld = loaded[iord];
+	std::vector<std::pair<Tkeyrow, int> > sorted;
+	for (unsigned int j = 0; j < ld.size(); j++)
+		sorted.push_back(std::make_pair(ld[j], (int)j));
+	std::sort(sorted.begin(), sorted.end());
+
+	const FSSparseTensor* t = md.get(Symmetry(iord));
+	if (t->getNumNonZero() != (int)ld.size())
+		throw DynareException(__FILE__, __LINE__, "Wrong number of loads in DynareDerBulkLoader::getOrdering");
+	perm.clear();
+	for (FSSparseTensor::const_iterator it = t->getMap().begin(); it != t->getMap().end(); ++it) {
+		std::pair<Tkeyrow, int> item(Tkeyrow((*it).first, (*it).second.first), -1);
+		std::vector<std::pair<Tkeyrow, int> >::const_iterator pos
+			= std::lower_bound(sorted.begin(), sorted.end(), item);
+		perm.push_back((*pos).second);
+	}
+}
+
 DynareJacobian::DynareJacobian(Dynare& dyn)
 	: Jacobian(dyn.ny()), d(dyn)
 {
@@ -354,6 +453,37 @@ void DynareJacobian::load(int i, int iord, const int* vars, double res)
 		get(i, j-d.nyss()-d.ny()+d.nstat()) += res;
 }
 
+DynareSparseJacobian::DynareSparseJacobian(Dynare& dyn)
+	: SparseJacobian(dyn.ny()), d(dyn)
+{
+}
+
+void DynareSparseJacobian::eval(const Vector& yy)
+{
+	ogdyn::DynareSteadyAtomValues
+		dav(d.getModel().getAtoms(), d.getModel().getParams(), yy);
+	clear();
+	d.fde->eval(dav, *this, 1);
+}
+
+/** The column of the derivative is found as in DynareJacobian::load,
+ * the derivatives wrt the lags of the same variable sum up. */
+void DynareSparseJacobian::load(int i, int iord, const int* vars, double res)
+{
+	if (iord != 1)
+		throw DynareException(__FILE__, __LINE__,
+							  "Derivative order different from order=1 in DynareSparseJacobian::load");
+
+	int t = vars[0];
+	int j = d.getModel().getAtoms().get_pos_of_all(t);
+	if (j < d.nyss())
+		add(i, j+d.nstat()+d.npred(), res);
+	else if (j < d.nyss()+d.ny())
+		add(i, j-d.nyss(), res);
+	else if (j < d.nyss()+d.ny()+d.nys())
+		add(i, j-d.nyss()-d.ny()+d.nstat(), res);
+}
+
 void DynareVectorFunction::eval(const ConstVector& in, Vector& out)
 {
 	check_for_eval(in, out);
@@ -362,3 +492,11 @@ void DynareVectorFunction::eval(const ConstVector& in, Vector& out)
 	d.evaluateSystem(out, in, xx);
 }
 
+void DynareVectorFunction::eval(const ConstVector& in, const ConstVector& dir,
+								Vector& out, Vector& dout)
+{
+	check_for_eval(in, out);
+	check_for_eval(dir, dout);
+	d.evaluateSystem(out, dout, in, dir);
+}
+
@@ -77,12 +77,14 @@ public:
 // The following only implements DynamicModel with help of ogdyn::DynareModel
 
 class DynareJacobian;
+class DynareSparseJacobian;
 class Dynare : public DynamicModel
 {
   friend class DynareNameList;
   friend class DynareExogNameList;
   friend class DynareStateNameList;
   friend class DynareJacobian;
+  friend class DynareSparseJacobian;
   Journal &journal;
   ogdyn::DynareModel *model;
   Vector *ysteady;
@@ -93,6 +95,12 @@ class Dynare : public DynamicModel
   ogp::FormulaEvaluator *fe;
   ogp::FormulaDerEvaluator *fde;
   const double ss_tol;
+  /** Flag for solving the steady state by the Newton-Krylov solver. */
+  bool ss_krylov;
+  /** True if md holds the structure of the derivatives and the
+   * orderings of fde are set to the ordering of md, so that the
+   * derivatives can be reevaluated in bulk. */
+  bool md_bulk;
 public:
   /** Parses the given model file and uses the given order to
    * override order from the model file (if it is != -1). */
@@ -224,6 +232,11 @@ public:
   // here is true public interface
   void solveDeterministicSteady(Vector &steady);
   void
+  setSteadyKrylov(bool krylov)
+  {
+    ss_krylov = krylov;
+  }
+  void
   solveDeterministicSteady()
   {
     solveDeterministicSteady(*ysteady);
@@ -231,6 +244,9 @@ public:
   void evaluateSystem(Vector &out, const Vector &yy, const Vector &xx);
   void evaluateSystem(Vector &out, const Vector &yym, const Vector &yy,
                       const Vector &yyp, const Vector &xx);
+  /** Evaluate the static system at yy to out and its derivative in
+   * the direction dy to dout. */
+  void evaluateSystem(Vector &out, Vector &dout, const Vector &yy, const Vector &dy);
   void calcDerivatives(const Vector &yy, const Vector &xx);
   void calcDerivativesAtSteady();
 
@@ -262,6 +278,25 @@ public:
   void load(int i, int iord, const int *vars, double res);
 };
 
+/** This loader remembers the position of each loaded derivative in
+ * the tensor, so that after the loading, the ordering of the loads
+ * can be matched to the ordering of the items of the tensors. */
+class DynareDerBulkLoader : public DynareDerEvalLoader
+{
+protected:
+  typedef std::pair<IntSequence, int> Tkeyrow;
+  /** The pairs of key and row of the loads, one vector for each
+   * order. */
+  std::vector<std::vector<Tkeyrow> > loaded;
+public:
+  DynareDerBulkLoader(const ogp::FineAtoms &a, TensorContainer<FSSparseTensor> &mod_ders,
+                      int order);
+  void load(int i, int iord, const int *vars, double res);
+  /** Fill perm so that the p-th item of the tensor of the given
+   * order was loaded by the perm[p]-th load of the order. */
+  void getOrdering(int iord, std::vector<int> &perm) const;
+};
+
 class DynareJacobian : public ogu::Jacobian, public ogp::FormulaDerEvalLoader
 {
 protected:
@@ -275,7 +310,22 @@ public:
   void eval(const Vector &in);
 };
 
-class DynareVectorFunction : public ogu::VectorFunction
+/** This is the sparse Jacobian of the static system used as the
+ * preconditioner by the Newton-Krylov solver. */
+class DynareSparseJacobian : public ogu::SparseJacobian, public ogp::FormulaDerEvalLoader
+{
+protected:
+  Dynare &d;
+public:
+  DynareSparseJacobian(Dynare &dyn);
+  virtual ~DynareSparseJacobian()
+  {
+  }
+  void load(int i, int iord, const int *vars, double res);
+  void eval(const Vector &in);
+};
+
+class DynareVectorFunction : public ogu::DiffVectorFunction
 {
 protected:
   Dynare &d;
@@ -298,6 +348,7 @@ public:
     return d.ny();
   }
   void eval(const ConstVector &in, Vector &out);
+  void eval(const ConstVector &in, const ConstVector &dir, Vector &out, Vector &dout);
 };
 
 #endif
@@ -182,6 +182,16 @@ void DynareAtomValues::setValues(ogp::EvalTree& et) const
 	}
 }
 
+void DynareSteadyTangentAtomValues::setValues(ogp::EvalTree& et) const
+{
+	av.setValues(et);
+	// the numerical constants do not move
+	const ogp::Constants::Tconstantmap& cmap = atoms.get_constantmap();
+	for (ogp::Constants::Tconstantmap::const_iterator it = cmap.begin();
+		 it != cmap.end(); ++it)
+		et.set_nulary((*it).first, 0.0);
+}
+
 void DynareStaticSteadyAtomValues::setValues(ogp::EvalTree& et) const
 {
 	// set constants
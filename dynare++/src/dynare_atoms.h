@@ -153,6 +153,28 @@ namespace ogdyn
     }
   };
 
+  /** This class represents a direction at the steady state for
+   * the evaluation of directional derivatives. The endogenous
+   * variables at all lags are set to the direction, the numerical
+   * constants, the parameters and the exogenous variables are set
+   * to zeros. */
+  class DynareSteadyTangentAtomValues : public ogp::AtomValues
+  {
+  protected:
+    const ogp::FineAtoms &atoms;
+    /** Vector of zeros for parameters. */
+    Vector pp;
+    /** Atom values with the direction and the zero parameters. */
+    DynareSteadyAtomValues av;
+  public:
+    DynareSteadyTangentAtomValues(const ogp::FineAtoms &a, const Vector &dy)
+      : atoms(a), pp(a.np()), av(a, pp, dy)
+    {
+      pp.zeros();
+    }
+    void setValues(ogp::EvalTree &et) const;
+  };
+
   class DynareStaticSteadyAtomValues : public ogp::AtomValues
   {
   protected:
@@ -8,7 +8,10 @@
 #include "planner_builder.h"
 #include "forw_subst_builder.h"
 
+#include "sthread.h"
+
 #include <cstdlib>
+#include <cstring>
 
 #include <string>
 #include <cmath>
@@ -19,6 +22,11 @@ using namespace ogdyn;
 ParsedMatrix::ParsedMatrix(const ogp::MatrixParser& mp)
 	: TwoDMatrix(mp.nrows(), mp.ncols())
 {
+	// binary matrix is already in our storage order
+	if (mp.colmajor_data()) {
+		memcpy(base(), mp.colmajor_data(), sizeof(double)*nrows()*ncols());
+		return;
+	}
 	zeros();
 	for (ogp::MPIterator it = mp.begin(); it != mp.end(); ++it)
 		get(it.row(), it.col()) = *it;
@@ -450,7 +458,7 @@ DynareParser::DynareParser(const char* stream, int len, int ord)
 
 	// differentiate
 	if (order >= 1)
-		eqs.differentiate(order);
+		eqs.differentiate(order, THREAD_GROUP::max_parallel_threads);
 }
 
 DynareParser::DynareParser(const DynareParser& dp)
@@ -712,7 +720,7 @@ DynareSPModel::DynareSPModel(const char** endo, int num_endo,
 
 	// differentiate
 	if (order >= 1)
-		eqs.differentiate(order);
+		eqs.differentiate(order, THREAD_GROUP::max_parallel_threads);
 }
 
 void ModelSSWriter::write_der0(FILE* fd)
@@ -21,21 +21,35 @@ const char* help_str =
 "    --condper <num>      number of periods in cond. simulations [0]\n"
 "    --condsim <num>      number of conditional simulations [0]\n"
 "    --steps <num>        steps towards stoch. SS [0=deter.]\n"
+"    --steps-tol <num>    tolerance of step control, steps is then\n"
+"                         the max number of steps [0, equal steps]\n"
 "    --centralize         centralize the rule [do centralize]\n"
 "    --no-centralize      do not centralize the rule [do centralize]\n"
+"    --trace              write Chrome trace of the journal [no trace]\n"
+"    --stream-sims        write simulated paths as they finish [no paths]\n"
+"    --compress           compress the streamed paths [no compression]\n"
+"    --mat73              write MAT 7.3 (HDF5) file [MAT 5 file]\n"
 "    --prefix <string>    prefix of variables in Mat-4 file [\"dyn\"]\n"
 "    --seed <num>         random number generator seed [934098]\n"
 "    --order <num>        order of approximation [no default]\n"
 "    --threads <num>      number of max parallel threads [2]\n"
 "    --ss-tol <num>       steady state calcs tolerance [1.e-13]\n"
+"    --ss-krylov          Newton-Krylov steady state solver [dense Newton]\n"
 "    --check pesPES       check model residuals [no checks]\n"
 "                         lower/upper case switches off/on\n"
 "                           pP  checking along simulation path\n"
 "                           eE  checking on ellipse\n"
 "                           sS  checking along shocks\n"
 "    --check-evals <num>  max number of evals per residual [1000]\n"
+"    --check-tol <num>    tolerance of adaptive residual checks [0, off]\n"
 "    --check-num <num>    number of checked points [10]\n"
 "    --check-scale <num>  scaling of checked points [2.0]\n"
+"    --float-order <num>  experimental: repeat the checks with the terms\n"
+"                         of this order and higher rounded to single\n"
+"                         precision [0, off]\n"
+"    --scratch-dir <dir>  keeps big tensors in a scratch file in the\n"
+"                         directory instead of RAM [none]\n"
+"    --scratch-min <num>  min size in MB of a tensor in the scratch file [1]\n"
 "    --no-irfs            shuts down IRF simulations [do IRFs]\n"
 "    --irfs               performs IRF simulations [do IRFs]\n"
 "    --qz-criterium <num> threshold for stable eigenvalues [1.000001]\n"
@@ -49,11 +63,13 @@ DynareParams::DynareParams(int argc, char** argv)
 	: modname(NULL), num_per(100), num_burn(0), num_sim(80), 
 	  num_rtper(0), num_rtsim(0),
 	  num_condper(0), num_condsim(0),
-	  num_threads(2), num_steps(0),
-	  prefix("dyn"), seed(934098), order(-1), ss_tol(1.e-13),
+	  num_threads(2), num_steps(0), steps_tol(0.0),
+	  prefix("dyn"), seed(934098), order(-1), ss_tol(1.e-13), ss_krylov(false),
 	  check_along_path(false), check_along_shocks(false),
-	  check_on_ellipse(false), check_evals(1000), check_num(10), check_scale(2.0),
-	  do_irfs_all(true), do_centralize(true), qz_criterium(1.0+1e-6),
+	  check_on_ellipse(false), check_evals(1000), check_tol(0.0), check_num(10), check_scale(2.0),
+	  float_order(0), scratch_dir(NULL), scratch_min(1),
+	  do_irfs_all(true), do_centralize(true), do_trace(false),
+	  stream_sims(false), compress(false), mat73(false), qz_criterium(1.0+1e-6),
 	  help(false), version(false)
 {
 	if (argc == 1 || !strcmp(argv[1],"--help")) {
@@ -85,18 +101,28 @@ DynareParams::DynareParams(int argc, char** argv)
 		{"prefix", required_argument, NULL, opt_prefix},
 		{"threads", required_argument, NULL, opt_threads},
 		{"steps", required_argument, NULL, opt_steps},
+		{"steps-tol", required_argument, NULL, opt_steps_tol},
 		{"seed", required_argument, NULL, opt_seed},
 		{"order", required_argument, NULL, opt_order},
 		{"ss-tol", required_argument, NULL, opt_ss_tol},
+		{"ss-krylov", no_argument, NULL, opt_ss_krylov},
 		{"check", required_argument, NULL, opt_check},
 		{"check-scale", required_argument, NULL, opt_check_scale},
 		{"check-evals", required_argument, NULL, opt_check_evals},
+		{"check-tol", required_argument, NULL, opt_check_tol},
 		{"check-num", required_argument, NULL, opt_check_num},
+		{"float-order", required_argument, NULL, opt_float_order},
+		{"scratch-dir", required_argument, NULL, opt_scratch_dir},
+		{"scratch-min", required_argument, NULL, opt_scratch_min},
 		{"qz-criterium",required_argument, NULL, opt_qz_criterium},
 		{"no-irfs", no_argument, NULL, opt_noirfs},
 		{"irfs", no_argument, NULL, opt_irfs},
 		{"centralize", no_argument, NULL, opt_centralize},
 		{"no-centralize", no_argument, NULL, opt_no_centralize},
+		{"trace", no_argument, NULL, opt_trace},
+		{"stream-sims", no_argument, NULL, opt_stream_sims},
+		{"compress", no_argument, NULL, opt_compress},
+		{"mat73", no_argument, NULL, opt_mat73},
 		{"help", no_argument, NULL, opt_help},
 		{"version", no_argument, NULL, opt_version},
 		{NULL, 0, NULL, 0}
@@ -145,6 +171,10 @@ DynareParams::DynareParams(int argc, char** argv)
 			if (1 != sscanf(optarg, "%d", &num_steps))
 				fprintf(stderr, "Couldn't parse integer %s, ignored\n", optarg);
 			break;
+		case opt_steps_tol:
+			if (1 != sscanf(optarg, "%lf", &steps_tol))
+				fprintf(stderr, "Couldn't parse float %s, ignored\n", optarg);
+			break;
 		case opt_seed:
 			if (1 != sscanf(optarg, "%d", &seed))
 				fprintf(stderr, "Couldn't parse integer %s, ignored\n", optarg);
@@ -168,10 +198,25 @@ DynareParams::DynareParams(int argc, char** argv)
 			if (1 != sscanf(optarg, "%d", &check_evals))
 				fprintf(stderr, "Couldn't parse integer %s, ignored\n", optarg);
 			break;
+		case opt_check_tol:
+			if (1 != sscanf(optarg, "%lf", &check_tol))
+				fprintf(stderr, "Couldn't parse float %s, ignored\n", optarg);
+			break;
 		case opt_check_num:
 			if (1 != sscanf(optarg, "%d", &check_num))
 				fprintf(stderr, "Couldn't parse integer %s, ignored\n", optarg);
 			break;
+		case opt_float_order:
+			if (1 != sscanf(optarg, "%d", &float_order))
+				fprintf(stderr, "Couldn't parse integer %s, ignored\n", optarg);
+			break;
+		case opt_scratch_dir:
+			scratch_dir = optarg;
+			break;
+		case opt_scratch_min:
+			if (1 != sscanf(optarg, "%d", &scratch_min))
+				fprintf(stderr, "Couldn't parse integer %s, ignored\n", optarg);
+			break;
 		case opt_noirfs:
 			irf_list.clear();
 			do_irfs_all = false;
@@ -189,6 +234,21 @@ DynareParams::DynareParams(int argc, char** argv)
 		case opt_no_centralize:
 			do_centralize = false;
 			break;
+		case opt_trace:
+			do_trace = true;
+			break;
+		case opt_stream_sims:
+			stream_sims = true;
+			break;
+		case opt_compress:
+			compress = true;
+			break;
+		case opt_mat73:
+			mat73 = true;
+			break;
+		case opt_ss_krylov:
+			ss_krylov = true;
+			break;
 		case opt_qz_criterium:
 			if (1 != sscanf(optarg, "%lf", &qz_criterium))
 				fprintf(stderr, "Couldn't parse float %s, ignored\n", optarg);
@@ -26,22 +26,44 @@ struct DynareParams
   int num_condsim;
   int num_threads;
   int num_steps;
+  /** Tolerance of the predictor-corrector control of the steps, zero
+   * for equal steps. */
+  double steps_tol;
   const char *prefix;
   int seed;
   int order;
   /** Tolerance used for steady state calcs. */
   double ss_tol;
+  /** Flag for the Newton-Krylov steady state solver. */
+  bool ss_krylov;
   bool check_along_path;
   bool check_along_shocks;
   bool check_on_ellipse;
   int check_evals;
+  /** Tolerance of adaptive residual checks, zero for a fixed level. */
+  double check_tol;
   int check_num;
   double check_scale;
+  /** Lowest order of the terms rounded to single precision for the
+   * accuracy check of a float storage, zero for no such check. */
+  int float_order;
+  /** Directory of the scratch file for big tensors, NULL for none. */
+  const char *scratch_dir;
+  /** Minimum size in MB of a tensor kept in the scratch file. */
+  int scratch_min;
   /** Flag for doing IRFs even if the irf_list is empty. */
   bool do_irfs_all;
   /** List of shocks for which IRF will be calculated. */
   std::vector<const char *> irf_list;
   bool do_centralize;
+  /** Flag for writing the journal trace to <basename>_trace.json. */
+  bool do_trace;
+  /** Flag for writing the simulated paths as they finish. */
+  bool stream_sims;
+  /** Flag for compressing the streamed paths. */
+  bool compress;
+  /** Flag for writing a MAT 7.3 (HDF5) file. */
+  bool mat73;
   double qz_criterium;
   bool help;
   bool version;
@@ -75,10 +97,11 @@ struct DynareParams
 private:
   enum {opt_per, opt_burn, opt_sim, opt_rtper, opt_rtsim, opt_condper, opt_condsim,
         opt_prefix, opt_threads,
-        opt_steps, opt_seed, opt_order, opt_ss_tol, opt_check,
+        opt_steps, opt_steps_tol, opt_seed, opt_order, opt_ss_tol, opt_ss_krylov, opt_check,
         opt_check_along_path, opt_check_along_shocks, opt_check_on_ellipse,
-        opt_check_evals, opt_check_scale, opt_check_num, opt_noirfs, opt_irfs,
-        opt_help, opt_version, opt_centralize, opt_no_centralize, opt_qz_criterium};
+        opt_check_evals, opt_check_tol, opt_check_scale, opt_check_num, opt_float_order, opt_scratch_dir, opt_scratch_min, opt_noirfs, opt_irfs,
+        opt_help, opt_version, opt_centralize, opt_no_centralize, opt_trace,
+        opt_stream_sims, opt_compress, opt_mat73, opt_qz_criterium};
   void processCheckFlags(const char *flags);
   /** This gathers strings from argv[optind] and on not starting
    * with '-' to the irf_list. It stops one item before the end,
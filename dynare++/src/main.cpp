@@ -7,10 +7,37 @@
 #include "utils/cc/exception.h"
 #include "parser/cc/parser_exception.h"
 #include "../sylv/cc/SylvException.h"
+#include "../sylv/cc/SylvMemory.h"
 #include "../kord/random.h"
 #include "../kord/global_check.h"
 #include "../kord/approximation.h"
 
+// checks the residuals of the approximation as required by the
+// parameters, saving the errors with the given prefix
+static void check_approximation(const Approximation& app, const DynareParams& params,
+								const char* prefix, mat_t* matfd, Journal& journal)
+{
+	if (params.check_along_path || params.check_along_shocks
+		|| params.check_on_ellipse) {
+		GlobalChecker gcheck(app, THREAD_GROUP::max_parallel_threads, journal);
+		gcheck.setTolerance(params.check_tol);
+		if (params.check_along_shocks)
+			gcheck.checkAlongShocksAndSave(matfd, prefix,
+										   params.getCheckShockPoints(),
+										   params.getCheckShockScale(),
+										   params.check_evals);
+		if (params.check_on_ellipse)
+			gcheck.checkOnEllipseAndSave(matfd, prefix,
+										 params.getCheckEllipsePoints(),
+										 params.getCheckEllipseScale(),
+										 params.check_evals);
+		if (params.check_along_path)
+			gcheck.checkAlongSimulationAndSave(matfd, prefix,
+											   params.getCheckPathPoints(),
+											   params.check_evals);
+	}
+}
+
 int main(int argc, char** argv)
 {
 	DynareParams params(argc, argv);
@@ -29,15 +56,21 @@ int main(int argc, char** argv)
 		return 0;
 	}
 	THREAD_GROUP::max_parallel_threads = params.num_threads;
+	if (params.scratch_dir
+		&& ! SylvScratchFile::init(params.scratch_dir, ((size_t) params.scratch_min) << 20))
+		fprintf(stderr, "Couldn't create a scratch file in %s, ignored\n", params.scratch_dir);
 
 	try {
 		// make journal name and journal
 		std::string jname(params.basename);
 		jname += ".jnl";
 		Journal journal(jname.c_str());
+		if (params.do_trace)
+			journal.enableTrace();
 
 		// make dynare object
 		Dynare dynare(params.modname, params.order, params.ss_tol, journal);
+		dynare.setSteadyKrylov(params.ss_krylov);
 		// make list of shocks for which we will do IRFs
         vector<int> irf_list_ind;
 		if (params.do_irfs_all)
@@ -71,7 +104,14 @@ int main(int argc, char** argv)
 		// open mat file
 		std::string matfile(params.basename);
 		matfile += ".mat";
+#if MATIO_MAJOR_VERSION > 1 || (MATIO_MAJOR_VERSION == 1 && MATIO_MINOR_VERSION >= 5)
+		mat_t* matfd = Mat_CreateVer(matfile.c_str(), NULL,
+									 params.mat73 ? MAT_FT_MAT73 : MAT_FT_DEFAULT);
+#else
+		if (params.mat73)
+			fprintf(stderr, "MAT 7.3 files need matio 1.5 or later, writing default format.\n");
 		mat_t* matfd = Mat_Create(matfile.c_str(), NULL);
+#endif
 		if (matfd == NULL) {
 			fprintf(stderr, "Couldn't open %s for writing.\n", matfile.c_str());
 			exit(1);
@@ -90,6 +130,7 @@ int main(int argc, char** argv)
 				 2*dynare.nforw()+dynare.nexog());
 
 		Approximation app(dynare, journal, params.num_steps, params.do_centralize, params.qz_criterium);
+		app.setStepsTol(params.steps_tol);
 		try {
 			app.walkStochSteady();
 		} catch (const KordException& e) {
@@ -106,31 +147,14 @@ int main(int argc, char** argv)
 		ConstTwoDMatrix(app.getSS()).writeMat(matfd, ss_matrix_name.c_str());
 
 		// check the approximation
-		if (params.check_along_path || params.check_along_shocks
-			|| params.check_on_ellipse) {
-			GlobalChecker gcheck(app, THREAD_GROUP::max_parallel_threads, journal);
-			if (params.check_along_shocks)
-				gcheck.checkAlongShocksAndSave(matfd, params.prefix,
-											   params.getCheckShockPoints(),
-											   params.getCheckShockScale(),
-											   params.check_evals);
-			if (params.check_on_ellipse)
-				gcheck.checkOnEllipseAndSave(matfd, params.prefix,
-											 params.getCheckEllipsePoints(),
-											 params.getCheckEllipseScale(),
-											 params.check_evals);
-			if (params.check_along_path)
-				gcheck.checkAlongSimulationAndSave(matfd, params.prefix,
-												   params.getCheckPathPoints(),
-												   params.check_evals);
-		}
+		check_approximation(app, params, params.prefix, matfd, journal);
 
 		// write the folded decision rule to the Mat-4 file
 		app.getFoldDecisionRule().writeMat(matfd, params.prefix);
 
 		// simulate conditional
 		if (params.num_condper > 0 && params.num_condsim > 0) {
-			SimResultsDynamicStats rescond(dynare.numeq(), params.num_condper, 0);
+			SimResultsDynamicStats rescond(dynare.numeq(), params.num_condper, 0, false);
 			ConstVector det_ss(app.getSS(),0);
 			rescond.simulate(params.num_condsim, app.getFoldDecisionRule(), det_ss, dynare.getVcov(), journal);
 			rescond.writeMat(matfd, params.prefix);
@@ -140,7 +164,11 @@ int main(int argc, char** argv)
 		//const DecisionRule& dr = app.getUnfoldDecisionRule();
 		const DecisionRule& dr = app.getFoldDecisionRule();
 		if (params.num_per > 0 && params.num_sim > 0) {
-			SimResultsStats res(dynare.numeq(), params.num_per, params.num_burn);
+			// the paths are kept only as the controls of the IRFs
+			SimResultsStats res(dynare.numeq(), params.num_per, params.num_burn,
+								! irf_list_ind.empty());
+			if (params.stream_sims)
+				res.setStream(matfd, params.prefix, params.compress);
 			res.simulate(params.num_sim, dr, dynare.getSteady(), dynare.getVcov(), journal);
 			res.writeMat(matfd, params.prefix);
 			
@@ -158,8 +186,30 @@ int main(int argc, char** argv)
 			rtres.writeMat(matfd, params.prefix);
 		}
 
+		// check the approximation with the high order terms rounded to
+		// single precision, the errors are saved with the "_float" suffix
+		if (params.float_order > 0) {
+			int num = app.roundToFloat(params.float_order);
+			{
+				JournalRecord rec(journal);
+				rec << "Rounded " << num << " coefficients of order " << params.float_order
+					<< " and higher to single precision (" << (8.0*num)/(1024*1024)
+					<< " MB in double, " << (4.0*num)/(1024*1024) << " MB in float)" << endrec;
+			}
+			std::string float_prefix(params.prefix);
+			float_prefix += "_float";
+			check_approximation(app, params, float_prefix.c_str(), matfd, journal);
+		}
+
 		Mat_Close(matfd);
 
+		if (params.do_trace) {
+			std::string tname(params.basename);
+			tname += "_trace.json";
+			if (! journal.writeTrace(tname.c_str()))
+				fprintf(stderr, "Couldn't write the trace to %s.\n", tname.c_str());
+		}
+
 	} catch (const KordException& e) {
 		printf("Caugth Kord exception: ");
 		e.print();
@@ -6,6 +6,8 @@
 #include "dynare_exception.h"
 
 #include <cmath>
+#include <cstdio>
+#include <algorithm>
 
 using namespace ogu;
 
@@ -226,3 +228,250 @@ bool NLSolver::solve(Vector& xx, int& iter)
 
 	return converged;
 }
+
+void SparseJacobian::clear()
+{
+	for (int i = 0; i < n; i++)
+		rows[i].clear();
+}
+
+int SparseJacobian::nonzeros() const
+{
+	int nnz = 0;
+	for (int i = 0; i < n; i++)
+		nnz += rows[i].size();
+	return nnz;
+}
+
+/** This is the ILU(0) factorization in the IKJ ordering: the row i
+ * is eliminated by the already factorized rows k<i, only the
+ * elements in the pattern of the row i are updated. */
+void SparseJacobian::factorize()
+{
+	// compress the rows, make sure the diagonal is present
+	row_beg.assign(n+1, 0);
+	cols.clear();
+	vals.clear();
+	diag.assign(n, -1);
+	for (int i = 0; i < n; i++) {
+		rows[i].insert(std::map<int, double>::value_type(i, 0.0));
+		for (std::map<int, double>::const_iterator it = rows[i].begin();
+			 it != rows[i].end(); ++it) {
+			if ((*it).first == i)
+				diag[i] = cols.size();
+			cols.push_back((*it).first);
+			vals.push_back((*it).second);
+		}
+		row_beg[i+1] = cols.size();
+	}
+
+	std::vector<int> pos(n, -1);
+	for (int i = 0; i < n; i++) {
+		double rnorm = 0.0;
+		for (int p = row_beg[i]; p < row_beg[i+1]; p++) {
+			pos[cols[p]] = p;
+			rnorm += vals[p]*vals[p];
+		}
+		rnorm = std::sqrt(rnorm);
+		for (int p = row_beg[i]; p < diag[i]; p++) {
+			int k = cols[p];
+			vals[p] /= vals[diag[k]];
+			for (int q = diag[k]+1; q < row_beg[k+1]; q++)
+				if (pos[cols[q]] != -1)
+					vals[pos[cols[q]]] -= vals[p]*vals[q];
+		}
+		double small = 1.e-10*((rnorm > 0.0)? rnorm : 1.0);
+		if (std::abs(vals[diag[i]]) < small)
+			vals[diag[i]] = (vals[diag[i]] < 0.0)? -small : small;
+		for (int p = row_beg[i]; p < row_beg[i+1]; p++)
+			pos[cols[p]] = -1;
+	}
+}
+
+void SparseJacobian::solve(Vector& x) const
+{
+	if (x.length() != n || (int) diag.size() != n)
+		throw DynareException(__FILE__, __LINE__,
+							  "Wrong dimensions or no factorization in SparseJacobian::solve");
+	for (int i = 0; i < n; i++) {
+		double s = x[i];
+		for (int p = row_beg[i]; p < diag[i]; p++)
+			s -= vals[p]*x[cols[p]];
+		x[i] = s;
+	}
+	for (int i = n-1; i >= 0; i--) {
+		double s = x[i];
+		for (int p = diag[i]+1; p < row_beg[i+1]; p++)
+			s -= vals[p]*x[cols[p]];
+		x[i] = s/vals[diag[i]];
+	}
+}
+
+double NKSolver::eval(double lambda)
+{
+	Vector xx((const Vector&)x);
+	xx.add(lambda, dx);
+	Vector ff(func.outDim());
+	func.eval(xx, ff);
+	return ff.dot(ff);
+}
+
+/** This is the restarted GMRES with the right preconditioning by
+ * the ILU factors, the Hessenberg matrix is reduced by Givens
+ * rotations as it grows. */
+int NKSolver::gmres(const Vector& fx, double rtol, double& res)
+{
+	int n = func.inDim();
+	int m = krylov_dim;
+	TwoDMatrix V(n, m+1);
+	TwoDMatrix H(m+1, m);
+	Vector cs(m);
+	Vector sn(m);
+	Vector g(m+1);
+	Vector ff(n);
+	Vector w(n);
+	Vector z(n);
+
+	dx.zeros();
+	res = 0.0;
+	double bnorm = fx.getNorm();
+	if (bnorm == 0.0)
+		return 0;
+
+	int its = 0;
+	for (int restart = 0; restart <= max_restarts; restart++) {
+		// residual r=-fx-J*dx is the first column of V
+		Vector r(V, 0);
+		r = (const Vector&) fx;
+		r.mult(-1);
+		if (restart > 0) {
+			func.eval(x, dx, ff, w);
+			r.add(-1, w);
+		}
+		double beta = r.getNorm();
+		res = beta/bnorm;
+		if (res <= rtol)
+			return its;
+		r.mult(1/beta);
+		g.zeros();
+		g[0] = beta;
+
+		int j = 0;
+		while (j < m) {
+			its++;
+			Vector vj(V, j);
+			z = (const Vector&) vj;
+			jacob.solve(z);
+			func.eval(x, z, ff, w);
+			// modified Gram-Schmidt
+			for (int i = 0; i <= j; i++) {
+				Vector vi(V, i);
+				double h = w.dot(vi);
+				H.get(i, j) = h;
+				w.add(-h, vi);
+			}
+			double hn = w.getNorm();
+			H.get(j+1, j) = hn;
+			if (hn != 0.0) {
+				Vector vnext(V, j+1);
+				vnext = (const Vector&) w;
+				vnext.mult(1/hn);
+			}
+			// apply the previous rotations and make the new one
+			for (int i = 0; i < j; i++) {
+				double tmp = cs[i]*H.get(i, j) + sn[i]*H.get(i+1, j);
+				H.get(i+1, j) = -sn[i]*H.get(i, j) + cs[i]*H.get(i+1, j);
+				H.get(i, j) = tmp;
+			}
+			double d = std::sqrt(H.get(j, j)*H.get(j, j) + hn*hn);
+			if (d == 0.0) {
+				cs[j] = 1.0;
+				sn[j] = 0.0;
+			} else {
+				cs[j] = H.get(j, j)/d;
+				sn[j] = hn/d;
+			}
+			H.get(j, j) = cs[j]*H.get(j, j) + sn[j]*hn;
+			H.get(j+1, j) = 0.0;
+			g[j+1] = -sn[j]*g[j];
+			g[j] = cs[j]*g[j];
+			res = std::abs(g[j+1])/bnorm;
+			j++;
+			if (res <= rtol || hn == 0.0)
+				break;
+		}
+
+		// solve the triangular system and update dx
+		Vector y(j);
+		for (int i = j-1; i >= 0; i--) {
+			double s = g[i];
+			for (int k = i+1; k < j; k++)
+				s -= H.get(i, k)*y[k];
+			y[i] = (H.get(i, i) != 0.0)? s/H.get(i, i) : 0.0;
+		}
+		z.zeros();
+		for (int i = 0; i < j; i++)
+			z.add(y[i], Vector(V, i));
+		jacob.solve(z);
+		dx.add(1, z);
+		if (res <= rtol)
+			return its;
+	}
+	return its;
+}
+
+bool NKSolver::solve(Vector& xx, int& iter)
+{
+	JournalRecord rec(journal);
+	rec << "Iter   lambda      residual   GMRES   ILU" << endrec;
+	JournalRecord rec1(journal);
+	rec1 << "-----------------------------------------" << endrec;
+	char tmpbuf[14];
+
+	x = (const Vector&)xx;
+	iter = 0;
+	Vector fx(func.outDim());
+	func.eval(x, fx);
+	if (!fx.isFinite())
+		throw DynareException(__FILE__,__LINE__,
+							  "Initial guess does not yield finite residual in NKSolver::solve");
+	bool converged = fx.getMax() < tol;
+	JournalRecord rec2(journal);
+	sprintf(tmpbuf, "%10.6g", fx.getMax());
+	rec2 << iter << "         N/A   " << tmpbuf << endrec;
+	bool refresh = true;
+	while (! converged && iter < max_iter) {
+		// recompute the preconditioner if needed
+		bool refreshed = refresh;
+		if (refresh) {
+			jacob.clear();
+			jacob.eval(x);
+			jacob.factorize();
+		}
+		// inexact newton direction, the forcing term goes to zero
+		// with the residual
+		double fnorm = fx.getNorm();
+		double rtol = std::max(std::min(0.1, fnorm), 1.e-12);
+		double res;
+		int its = gmres(fx, rtol, res);
+		refresh = (res > rtol || its > krylov_dim/2);
+
+		// line search
+		double lambda = GoldenSectionSearch::search(*this, 0, 1);
+		if (lambda == 0.0)
+			refresh = true;
+		x.add(lambda, dx);
+		func.eval(x, fx);
+		converged = fx.getMax() < tol;
+
+		iter++;
+
+		JournalRecord rec3(journal);
+		sprintf(tmpbuf, "%10.6g", fx.getMax());
+		rec3 << iter << "    " << lambda << "   " << tmpbuf << "   " << its
+			 << "   " << (refreshed? "yes" : "no") << endrec;
+	}
+	xx = (const Vector&)x;
+
+	return converged;
+}
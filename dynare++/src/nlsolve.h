@@ -8,6 +8,9 @@
 #include "twod_matrix.h"
 #include "journal.h"
 
+#include <vector>
+#include <map>
+
 namespace ogu
 {
 
@@ -60,6 +63,70 @@ namespace ogu
     virtual void eval(const ConstVector &in, Vector &out) = 0;
   };
 
+  /** This is a vector function which can also evaluate its
+   * directional derivatives, i.e. the product of its Jacobian with a
+   * given vector, without forming the Jacobian. */
+  class DiffVectorFunction : public VectorFunction
+  {
+  public:
+    using VectorFunction::eval;
+    /** Evaluate the function at in to out, and its derivative at in
+     * in the direction dir to dout. */
+    virtual void eval(const ConstVector &in, const ConstVector &dir,
+                      Vector &out, Vector &dout) = 0;
+  };
+
+  /** This is a square Jacobian stored by rows in the compressed
+   * sparse row format. The implementations fill it in eval() by
+   * calling add(). Its only use is the incomplete LU factorization
+   * with no fill-in, which serves as a preconditioner, the pattern
+   * of the factors is the pattern of the Jacobian plus the
+   * diagonal. */
+  class SparseJacobian
+  {
+  protected:
+    int n;
+    /** Elements added since the last clear(), a map per row. */
+    std::vector<std::map<int, double> > rows;
+    /** The compressed rows of the factors, L has a unit diagonal
+     * which is not stored, the diagonal of U is at diag[i]. */
+    std::vector<int> row_beg;
+    std::vector<int> cols;
+    std::vector<double> vals;
+    std::vector<int> diag;
+  public:
+    SparseJacobian(int nn)
+      : n(nn), rows(nn)
+    {
+    }
+    virtual ~SparseJacobian()
+    {
+    }
+    int
+    nrows() const
+    {
+      return n;
+    }
+    /** Evaluate the Jacobian at the given point. */
+    virtual void eval(const Vector &in) = 0;
+    /** Remove all elements. */
+    void clear();
+    /** Add the value to the element (i,j). */
+    void
+    add(int i, int j, double v)
+    {
+      rows[i][j] += v;
+    }
+    /** Return the number of stored elements. */
+    int nonzeros() const;
+    /** Compute the incomplete LU factors from the added elements.
+     * Tiny pivots are replaced by a small multiple of the norm of
+     * the row. */
+    void factorize();
+    /** Solve by the factors in place. */
+    void solve(Vector &x) const;
+  };
+
   class Jacobian : public TwoDMatrix
   {
   public:
@@ -105,6 +172,53 @@ namespace ogu
     double eval(double lambda);
   };
 
+  /** This is a Jacobian-free Newton-Krylov solver. The Newton
+   * direction is an inexact solution of J*d=-f by restarted GMRES,
+   * right preconditioned by the incomplete LU factorization of the
+   * sparse Jacobian. The products with J are the directional
+   * derivatives of the function, so the Jacobian is only needed for
+   * the preconditioner, which is recomputed only when GMRES needs
+   * too many iterations. The step length along the direction is
+   * found by the golden section search. */
+  class NKSolver : public OneDFunction
+  {
+  protected:
+    Journal &journal;
+    DiffVectorFunction &func;
+    SparseJacobian &jacob;
+    const int max_iter;
+    const double tol;
+    /** Dimension of the Krylov subspace before the restart. */
+    const int krylov_dim;
+    /** Maximum number of GMRES restarts. */
+    const int max_restarts;
+  private:
+    Vector x;
+    Vector dx;
+  public:
+    NKSolver(DiffVectorFunction &f, SparseJacobian &j, int maxit, double tl, Journal &jr,
+             int kdim = 30, int maxrest = 10)
+      : journal(jr), func(f), jacob(j), max_iter(maxit), tol(tl),
+        krylov_dim(kdim), max_restarts(maxrest), x(f.inDim()), dx(f.inDim())
+    {
+      x.zeros(); dx.zeros();
+    }
+    virtual ~NKSolver()
+    {
+    }
+    /** Returns true if the problem has converged. xx as input is the
+     * starting value, as output it is a solution. */
+    bool solve(Vector &xx, int &iter);
+    /** To implement OneDFunction interface. It returns
+     * func(xx)^T*func(xx), where xx=x+lambda*dx. */
+    double eval(double lambda);
+  protected:
+    /** Solve J*d=-fx at x approximately to the relative tolerance
+     * rtol. It returns the number of GMRES iterations, the
+     * direction is stored in dx and the relative residual in res. */
+    int gmres(const Vector &fx, double rtol, double &res);
+  };
+
 };
 
 #endif
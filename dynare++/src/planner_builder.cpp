@@ -54,6 +54,7 @@ PlannerBuilder::PlannerBuilder(DynareModel& m, const Tvarset& yyset,
 	make_static_version();
 	lagrange_mult_f();
 	form_equations();
+	shift_cache.clear();
 
 	info.num_new_terms += model.getParser().getTree().get_num_op();
 }
@@ -104,31 +105,48 @@ void PlannerBuilder::add_derivatives_of_f()
 			}
 }
 
+int PlannerBuilder::shift_term(int t, int tshift)
+{
+	Tshiftcache::iterator it = shift_cache.find(tshift);
+	if (it == shift_cache.end())
+		it = shift_cache.insert(Tshiftcache::value_type(tshift, ShiftCache())).first;
+	ShiftCache& sc = (*it).second;
+
+	// collect the variables not yet in the substitution first, since
+	// shifting a variable may add a new nulary term, which
+	// invalidates the reference to the set of nulary terms
+	vector<int> vars;
+	const unordered_set<int>& nuls = model.eqs.nulary_of_term(t);
+	for (unordered_set<int>::const_iterator ni = nuls.begin();
+		 ni != nuls.end(); ++ni)
+		if (sc.subst.find(*ni) == sc.subst.end() && ! model.atoms.is_constant(*ni)) {
+			const char* name = model.atoms.name(*ni);
+			if (model.atoms.is_type(name, DynareDynamicAtoms::endovar) ||
+				model.atoms.is_type(name, DynareDynamicAtoms::exovar))
+				vars.push_back(*ni);
+		}
+	for (unsigned int i = 0; i < vars.size(); i++)
+		sc.subst.insert(map<int,int>::value_type(vars[i], model.variable_shift(vars[i], tshift)));
+
+	return model.eqs.add_substitution(t, sc.subst, sc.memo);
+}
+
 void PlannerBuilder::shift_derivatives_of_b()
 {
-	map<int,int> subst;
 	for (int yi = 0; yi < diff_b.nrows(); yi++)
 		for (int ll = minlag; ll < 0; ll++)
-			if (diff_b(yi, ll-minlag) != ogp::OperationTree::zero) {
-				model.variable_shift_map(model.eqs.nulary_of_term(diff_b(yi, ll-minlag)),
-										 -ll, subst);
-				diff_b(yi, ll-minlag) = model.eqs.add_substitution(diff_b(yi, ll-minlag), subst);
-			}
+			if (diff_b(yi, ll-minlag) != ogp::OperationTree::zero)
+				diff_b(yi, ll-minlag) = shift_term(diff_b(yi, ll-minlag), -ll);
 }
 
 void PlannerBuilder::shift_derivatives_of_f()
 {
-	map<int,int> subst;
 	for (int yi = 0; yi < diff_f.dim1(); yi++)
 		for (int fi = 0; fi < diff_f.dim2(); fi++) {
 			// first do it leads which are put under expectation before t: no problem
 			for (int ll = 0; ll <= maxlead; ll++)
-				if (diff_f(yi, fi, ll-minlag) != ogp::OperationTree::zero) {
-					model.variable_shift_map(model.eqs.nulary_of_term(diff_f(yi, fi, ll-minlag)),
-											 -ll, subst);
-					diff_f(yi, fi, ll-minlag) =
-						model.eqs.add_substitution(diff_f(yi, fi, ll-minlag), subst);
-				}
+				if (diff_f(yi, fi, ll-minlag) != ogp::OperationTree::zero)
+					diff_f(yi, fi, ll-minlag) = shift_term(diff_f(yi, fi, ll-minlag), -ll);
 			// now do it for lags, these are put as leads under
 			// expectations after time t, so we have to introduce
 			// auxiliary variables at time t, and make leads of them here
@@ -158,9 +176,7 @@ void PlannerBuilder::shift_derivatives_of_f()
 					} else {
 						// no auxiliary variable is needed and the
 						// term ft can be leaded in place
-						model.variable_shift_map(model.eqs.nulary_of_term(ft), -ll, subst);
-						diff_f(yi, fi, ll-minlag) =
-							model.eqs.add_substitution(ft, subst);
+						diff_f(yi, fi, ll-minlag) = shift_term(ft, -ll);
 					}
 				}
 			}
@@ -207,12 +223,16 @@ void PlannerBuilder::make_static_version()
 	// fill static atoms with outer ordering
 	static_atoms.import_atoms(model.atoms, static_tree, tmap);
 
+	// the terms of diff_b, diff_f and aux_map share a lot of
+	// subterms, they are substituted only once
+	map<int,int> memo;
+
 	// go through diff_b and fill diff_b_static
 	for (int ll = minlag; ll <= 0; ll++)
 		for (int yi = 0; yi < diff_b.nrows(); yi++)
 			diff_b_static(yi, ll-minlag) =
 				static_tree.add_substitution(diff_b(yi, ll-minlag),
-											 tmap,  model.eqs.getTree());
+											 tmap,  model.eqs.getTree(), memo);
 
 	// go through diff_f and fill diff_f_static
 	for (int ll = minlag; ll <= maxlead; ll++)
@@ -220,12 +240,12 @@ void PlannerBuilder::make_static_version()
 			for (int fi = 0; fi < diff_f.dim2(); fi++)
 				diff_f_static(yi, fi, ll-minlag) =
 					static_tree.add_substitution(diff_f(yi, fi, ll-minlag),
-												 tmap, model.eqs.getTree());
+												 tmap, model.eqs.getTree(), memo);
 
 	// go through aux_map and fill static_aux_map
 	for (Tsubstmap::const_iterator it = aux_map.begin();
 		 it != aux_map.end(); ++it) {
-		int tstatic = static_tree.add_substitution((*it).second, tmap, model.eqs.getTree());
+		int tstatic = static_tree.add_substitution((*it).second, tmap, model.eqs.getTree(), memo);
 		const char* name = static_atoms.get_name_storage().query((*it).first);
 		static_aux_map.insert(Tsubstmap::value_type(name, tstatic));
 	}
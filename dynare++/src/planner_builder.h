@@ -159,6 +159,18 @@ namespace ogdyn
      * retrieved as DynareModel::egs.formula(i). */
     typedef vector<int> Teqset;
   protected:
+    /** This is a substitution shifting the variables in time by a
+     * given shift. It maps the tree indices of the variables to
+     * the tree indices of the shifted variables, and memoizes the
+     * shifted terms, so that the subterms common to the derivatives
+     * are shifted only once. */
+    struct ShiftCache
+    {
+      map<int, int> subst;
+      map<int, int> memo;
+    };
+    /** Type for the shift caches indexed by the time shift. */
+    typedef map<int, ShiftCache> Tshiftcache;
     /** This is a set of variables wrt which the planner
      * optimizes. These could be all endogenous variables, but it
      * is beneficial to exclude all variables which are
@@ -224,6 +236,9 @@ namespace ogdyn
     Tsubstmap static_aux_map;
     /** Information about the number of various things. */
     PlannerInfo info;
+    /** The shift caches used by shift_term(). They are used only
+     * during the construction and cleared at its end. */
+    Tshiftcache shift_cache;
   public:
     /** Build the planner problem for the given model optimizing
      * through the given endogenous variables with the given
@@ -265,6 +280,12 @@ namespace ogdyn
     void lagrange_mult_f();
     /** Add the equations to the mode, including equation for auxiliary variables. */
     void form_equations();
+    /** Return the tree index of the given term shifted in time by
+     * the given shift. The variables of the term are added to the
+     * shift cache of tshift, and the term is substituted with the
+     * memo of the cache, so no term is shifted by the same shift
+     * twice. */
+    int shift_term(int t, int tshift);
   private:
     /** Fill yset for a given yyset and given name storage. */
     void fill_yset(const ogp::NameStorage &ns, const Tvarset &yyset);
@@ -5,6 +5,7 @@
 
 #include "SylvException.h"
 #include "GeneralMatrix.h"
+#include "SylvCublas.h"
 
 #include <dynblas.h>
 #include <dynlapack.h>
@@ -277,8 +278,15 @@ void GeneralMatrix::gemm(const char* transa, const ConstGeneralMatrix& a,
 	blas_int ldb = b.ld;
 	blas_int ldc = ld;
 	if (lda > 0 && ldb > 0 && ldc > 0) {
-		dgemm(transa, transb, &m, &n, &k, &alpha, a.data.base(), &lda,
-				   b.data.base(), &ldb, &beta, data.base(), &ldc); 
+		// the big products may go to the GPU, the rest of the columns to BLAS
+		int done = SylvCublas::gemm(transa, transb, m, n, k, alpha, a.data.base(), lda,
+									b.data.base(), ldb, beta, data.base(), ldc);
+		if (done < n) {
+			const double* bbase = b.data.base() + (strcmp(transb, "T") ? done*ldb : done);
+			blas_int nrest = n - done;
+			dgemm(transa, transb, &m, &nrest, &k, &alpha, a.data.base(), &lda,
+				  bbase, &ldb, &beta, data.base() + done*ldc, &ldc);
+		}
 	} else if (numRows()*numCols() > 0) {
 		if (beta == 0.0)
 			zeros();
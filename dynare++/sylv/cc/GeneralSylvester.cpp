@@ -9,14 +9,100 @@
 #include "IterativeSylvester.h"
 
 #include <ctime>
+#include <algorithm>
+
+GeneralSylvesterDecomp::GeneralSylvesterDecomp(int n, int m, int zero_cols,
+											   const double* da, const double* db,
+											   const double* dc, const SylvParams& ps)
+	: info(ps), a(da, n), b(db, n, n-zero_cols), c(dc, m), alu(a),
+	  ipiv(new lapack_int[n])
+{
+	// PLU factorization of a
+	lapack_int rows = n;
+	lapack_int linfo;
+	dgetrf(&rows, &rows, alu.base(), &rows, ipiv, &linfo);
+	GeneralMatrix ainvb(b);
+	multInvA(ainvb);
+
+	// condition numbers of a
+	double* const work = new double[4*n];
+	lapack_int* const iwork = new lapack_int[n];
+	double norm1 = a.getNorm1();
+	double rcond1;
+	dgecon("1", &rows, alu.base(), &rows, &norm1, &rcond1,
+		   work, iwork, &linfo);
+	double norminf = a.getNormInf();
+	double rcondinf;
+	dgecon("I", &rows, alu.base(), &rows, &norminf, &rcondinf,
+		   work, iwork, &linfo);
+	delete [] iwork;
+	delete [] work;
+	info.rcondA1 = rcond1;
+	info.rcondAI = rcondinf;
+
+	bdecomp = new SchurDecompZero(ainvb);
+	cdecomp = new SimilarityDecomp(c.getData().base(), c.numRows(), *(info.bs_norm));
+	cdecomp->check(info, c);
+	cdecomp->infoToPars(info);
+	if (*(info.method) == SylvParams::recurse)
+		sylv = new TriangularSylvester(*bdecomp, *cdecomp);
+	else
+		sylv = new IterativeSylvester(*bdecomp, *cdecomp);
+}
+
+GeneralSylvesterDecomp::~GeneralSylvesterDecomp()
+{
+	delete sylv;
+	delete bdecomp;
+	delete cdecomp;
+	delete [] ipiv;
+}
+
+bool GeneralSylvesterDecomp::isFor(int n, int m, int zero_cols,
+								   const double* da, const double* db,
+								   const double* dc, const SylvParams& ps) const
+{
+	return (n == getN() && m == getM() && zero_cols == getZeroCols()
+			&& *(ps.method) == *(info.method) && *(ps.bs_norm) == *(info.bs_norm)
+			&& std::equal(da, da+n*n, a.base())
+			&& std::equal(db, db+n*(n-zero_cols), b.base())
+			&& std::equal(dc, dc+m*m, c.base()));
+}
+
+void GeneralSylvesterDecomp::multInvA(GeneralMatrix& d) const
+{
+	lapack_int rows = getN();
+	lapack_int cols = d.numCols();
+	lapack_int ld = d.getLD();
+	lapack_int linfo;
+	dgetrs("N", &rows, &cols, alu.base(), &rows, ipiv,
+		   d.base(), &ld, &linfo);
+}
+
+void GeneralSylvesterDecomp::infoToPars(SylvParams& pars) const
+{
+	pars.rcondA1 = info.rcondA1;
+	pars.rcondAI = info.rcondAI;
+	pars.f_err1 = info.f_err1;
+	pars.f_errI = info.f_errI;
+	pars.viv_err1 = info.viv_err1;
+	pars.viv_errI = info.viv_errI;
+	pars.ivv_err1 = info.ivv_err1;
+	pars.ivv_errI = info.ivv_errI;
+	pars.f_blocks = info.f_blocks;
+	pars.f_largest = info.f_largest;
+	pars.f_zeros = info.f_zeros;
+	pars.f_offdiag = info.f_offdiag;
+}
 
 GeneralSylvester::GeneralSylvester(int ord, int n, int m, int zero_cols,
 								   const double* da, const double* db,
 								   const double* dc, const double* dd,
 								   const SylvParams& ps)
 	: pars(ps), 
-	  mem_driver(pars, 1, m, n, ord), order(ord), a(da, n),
-	  b(db, n, n-zero_cols), c(dc, m), d(dd, n, power(m, order)),
+	  mem_driver(pars, 1, m, n, ord), order(ord),
+	  decomp(new GeneralSylvesterDecomp(n, m, zero_cols, da, db, dc, pars)),
+	  own_decomp(true), d(dd, n, power(m, order)),
 	  solved(false)
 {
 	init();
@@ -27,8 +113,9 @@ GeneralSylvester::GeneralSylvester(int ord, int n, int m, int zero_cols,
 								   const double* dc, double* dd,
 								   const SylvParams& ps)
 	: pars(ps),
-	  mem_driver(pars, 0, m, n, ord), order(ord), a(da, n),
-	  b(db, n, n-zero_cols), c(dc, m), d(dd, n, power(m, order)),
+	  mem_driver(pars, 0, m, n, ord), order(ord),
+	  decomp(new GeneralSylvesterDecomp(n, m, zero_cols, da, db, dc, pars)),
+	  own_decomp(true), d(dd, n, power(m, order)),
 	  solved(false)
 {
 	init();
@@ -39,8 +126,9 @@ GeneralSylvester::GeneralSylvester(int ord, int n, int m, int zero_cols,
 								   const double* dc, const double* dd,
 								   bool alloc_for_check)
 	: pars(alloc_for_check), 
-	  mem_driver(pars, 1, m, n, ord), order(ord), a(da, n),
-	  b(db, n, n-zero_cols), c(dc, m), d(dd, n, power(m, order)),
+	  mem_driver(pars, 1, m, n, ord), order(ord),
+	  decomp(new GeneralSylvesterDecomp(n, m, zero_cols, da, db, dc, pars)),
+	  own_decomp(true), d(dd, n, power(m, order)),
 	  solved(false)
 {
 	init();
@@ -51,8 +139,31 @@ GeneralSylvester::GeneralSylvester(int ord, int n, int m, int zero_cols,
 								   const double* dc, double* dd,
 								   bool alloc_for_check)
 	: pars(alloc_for_check),
-	  mem_driver(pars, 0, m, n, ord), order(ord), a(da, n),
-	  b(db, n, n-zero_cols), c(dc, m), d(dd, n, power(m, order)),
+	  mem_driver(pars, 0, m, n, ord), order(ord),
+	  decomp(new GeneralSylvesterDecomp(n, m, zero_cols, da, db, dc, pars)),
+	  own_decomp(true), d(dd, n, power(m, order)),
+	  solved(false)
+{
+	init();
+}
+
+GeneralSylvester::GeneralSylvester(int ord, const GeneralSylvesterDecomp& dec,
+								   const double* dd, const SylvParams& ps)
+	: pars(ps),
+	  mem_driver(pars, 1, dec.getM(), dec.getN(), ord), order(ord),
+	  decomp(&dec), own_decomp(false),
+	  d(dd, dec.getN(), power(dec.getM(), order)),
+	  solved(false)
+{
+	init();
+}
+
+GeneralSylvester::GeneralSylvester(int ord, const GeneralSylvesterDecomp& dec,
+								   double* dd, const SylvParams& ps)
+	: pars(ps),
+	  mem_driver(pars, 0, dec.getM(), dec.getN(), ord), order(ord),
+	  decomp(&dec), own_decomp(false),
+	  d(dd, dec.getN(), power(dec.getM(), order)),
 	  solved(false)
 {
 	init();
@@ -60,20 +171,8 @@ GeneralSylvester::GeneralSylvester(int ord, int n, int m, int zero_cols,
 
 void GeneralSylvester::init()
 {
-	GeneralMatrix ainvb(b);
-	double rcond1;
-	double rcondinf;
-	a.multInvLeft2(ainvb, d, rcond1, rcondinf);
-	pars.rcondA1 = rcond1;
-	pars.rcondAI = rcondinf;
-	bdecomp = new SchurDecompZero(ainvb);
-	cdecomp = new SimilarityDecomp(c.getData().base(), c.numRows(), *(pars.bs_norm));
-	cdecomp->check(pars, c);
-	cdecomp->infoToPars(pars);
-	if (*(pars.method) == SylvParams::recurse)
-		sylv = new TriangularSylvester(*bdecomp, *cdecomp);
-	else
-		sylv = new IterativeSylvester(*bdecomp, *cdecomp);
+	decomp->multInvA(d);
+	decomp->infoToPars(pars);
 }
 
 void GeneralSylvester::solve()
@@ -85,15 +184,15 @@ void GeneralSylvester::solve()
 
 	clock_t start = clock();
 	// multiply d
-	d.multLeftITrans(bdecomp->getQ());
-	d.multRightKron(cdecomp->getQ(), order);
+	d.multLeftITrans(decomp->getBDecomp().getQ());
+	d.multRightKron(decomp->getCDecomp().getQ(), order);
 	// convert to KronVector
 	KronVector dkron(d.getData(), getM(), getN(), order);
 	// solve
-	sylv->solve(pars, dkron);
+	decomp->getSolver().solve(pars, dkron);
 	// multiply d back
-	d.multLeftI(bdecomp->getQ());
-	d.multRightKron(cdecomp->getInvQ(), order);
+	d.multLeftI(decomp->getBDecomp().getQ());
+	d.multRightKron(decomp->getCDecomp().getInvQ(), order);
 	clock_t end = clock();
 	pars.cpu_time = ((double)(end-start))/CLOCKS_PER_SEC;
 
@@ -110,9 +209,11 @@ void GeneralSylvester::check(const double* ds)
 	mem_driver.setStackMode(true);
 
 	// calculate xcheck = AX+BXC^i-D
+	const SqSylvMatrix& a = decomp->getA();
+	const SylvMatrix& b = decomp->getB();
 	SylvMatrix dcheck(d.numRows(), d.numCols());
 	dcheck.multLeft(b.numRows()-b.numCols(), b, d);
-	dcheck.multRightKron(c, order);
+	dcheck.multRightKron(decomp->getC(), order);
 	dcheck.multAndAdd(a,d);
 	ConstVector dv(ds, d.numRows()*d.numCols());
 	dcheck.getData().add(-1.0, dv);
@@ -128,9 +229,8 @@ void GeneralSylvester::check(const double* ds)
 
 GeneralSylvester::~GeneralSylvester()
 {
-	delete bdecomp;
-	delete cdecomp;
-	delete sylv;
+	if (own_decomp)
+		delete decomp;
 }
 
 // Local Variables:
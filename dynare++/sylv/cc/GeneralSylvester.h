@@ -10,19 +10,96 @@
 #include "SimilarityDecomp.h"
 #include "SylvesterSolver.h"
 
-class GeneralSylvester
+#include <dynlapack.h>
+
+/* The decompositions needed for solving A*X + [0 B]*X*kron(C,..,C) = D,
+   these are the LU factorization of A, the Schur decomposition of
+   inv(A)*[0 B], and the block diagonalization of C. They do not depend
+   on D and the order, so one instance can be shared by GeneralSylvester
+   objects for several orders and right hand sides. */
+class GeneralSylvesterDecomp
 {
-  SylvParams pars;
-  SylvMemoryDriver mem_driver;
-  int order;
+  SylvParams info; // parameters and diagnostics of the decompositions
   const SqSylvMatrix a;
   const SylvMatrix b;
   const SqSylvMatrix c;
-  SylvMatrix d;
-  bool solved;
+  SqSylvMatrix alu; // LU factors of a
+  lapack_int *const ipiv;
   SchurDecompZero *bdecomp;
   SimilarityDecomp *cdecomp;
   SylvesterSolver *sylv;
+  GeneralSylvesterDecomp(const GeneralSylvesterDecomp &);
+  const GeneralSylvesterDecomp &operator=(const GeneralSylvesterDecomp &);
+public:
+  GeneralSylvesterDecomp(int n, int m, int zero_cols,
+                         const double *da, const double *db,
+                         const double *dc, const SylvParams &ps);
+  ~GeneralSylvesterDecomp();
+  /* true if the decompositions are of the given matrices, and were
+     computed with the same method and diagonalization norm as ps */
+  bool isFor(int n, int m, int zero_cols,
+             const double *da, const double *db, const double *dc,
+             const SylvParams &ps) const;
+  int
+  getM() const
+  {
+    return c.numRows();
+  }
+  int
+  getN() const
+  {
+    return a.numRows();
+  }
+  int
+  getZeroCols() const
+  {
+    return a.numRows()-b.numCols();
+  }
+  const SqSylvMatrix &
+  getA() const
+  {
+    return a;
+  }
+  const SylvMatrix &
+  getB() const
+  {
+    return b;
+  }
+  const SqSylvMatrix &
+  getC() const
+  {
+    return c;
+  }
+  const SchurDecompZero &
+  getBDecomp() const
+  {
+    return *bdecomp;
+  }
+  const SimilarityDecomp &
+  getCDecomp() const
+  {
+    return *cdecomp;
+  }
+  const SylvesterSolver &
+  getSolver() const
+  {
+    return *sylv;
+  }
+  /* d = inv(A)*d */
+  void multInvA(GeneralMatrix &d) const;
+  /* stores the diagnostics of the decompositions to pars */
+  void infoToPars(SylvParams &pars) const;
+};
+
+class GeneralSylvester
+{
+  SylvParams pars;
+  SylvMemoryDriver mem_driver;
+  int order;
+  const GeneralSylvesterDecomp *decomp;
+  const bool own_decomp;
+  SylvMatrix d;
+  bool solved;
 public:
   /* construct with my copy of d*/
   GeneralSylvester(int ord, int n, int m, int zero_cols,
@@ -42,17 +119,24 @@ public:
                    const double *da, const double *db,
                    const double *dc, double *dd,
                    const SylvParams &ps);
+  /* construct with the shared decompositions and my copy of d, the
+     decompositions must outlive the object */
+  GeneralSylvester(int ord, const GeneralSylvesterDecomp &dec,
+                   const double *dd, const SylvParams &ps);
+  /* construct with the shared decompositions and provided storage for d */
+  GeneralSylvester(int ord, const GeneralSylvesterDecomp &dec,
+                   double *dd, const SylvParams &ps);
   virtual
   ~GeneralSylvester();
   int
   getM() const
   {
-    return c.numRows();
+    return decomp->getM();
   }
   int
   getN() const
   {
-    return a.numRows();
+    return decomp->getN();
   }
   const double *
   getResult() const
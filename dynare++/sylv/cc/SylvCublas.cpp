@@ -0,0 +1,204 @@
+#include "SylvCublas.h"
+
+#ifdef CUBLAS
+
+# include <cstdio>
+# include <cstdlib>
+# include <cstring>
+
+# include <cuda_runtime_api.h>
+# include <cublas_v2.h>
+
+# ifdef HAVE_PTHREAD
+#  include <pthread.h>
+# endif
+
+/* The number of column blocks of the result computed in turn on the
+   two streams. */
+static const int num_col_blocks = 4;
+
+static bool cublas_tried = false;
+static bool cublas_ok = false;
+static double cublas_min_mnk = 1e8;
+static cublasHandle_t cublas_handle;
+static cudaStream_t cublas_streams[2];
+/* device buffers of a, and of the two blocks of b and c, they only grow */
+static double *d_a = NULL, *d_b[2] = {NULL, NULL}, *d_c[2] = {NULL, NULL};
+static size_t d_a_size = 0, d_b_size = 0, d_c_size = 0;
+# ifdef HAVE_PTHREAD
+static pthread_mutex_t cublas_mutex = PTHREAD_MUTEX_INITIALIZER;
+# endif
+
+static void lock_cublas()
+{
+# ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&cublas_mutex);
+# endif
+}
+
+static void unlock_cublas()
+{
+# ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&cublas_mutex);
+# endif
+}
+
+static void free_buffers()
+{
+	cudaFree(d_a);
+	d_a = NULL;
+	d_a_size = 0;
+	for (int i = 0; i < 2; i++) {
+		cudaFree(d_b[i]);
+		cudaFree(d_c[i]);
+		d_b[i] = d_c[i] = NULL;
+	}
+	d_b_size = d_c_size = 0;
+}
+
+/* Called once, under the lock. */
+static void init_cublas()
+{
+	cublas_tried = true;
+	const char* s = getenv("DYNARE_CUBLAS_MIN_MNK");
+	if (s)
+		cublas_min_mnk = atof(s);
+	int device_count = 0;
+	if (cudaGetDeviceCount(&device_count) != cudaSuccess || device_count == 0)
+		return;
+	if (cublasCreate(&cublas_handle) != CUBLAS_STATUS_SUCCESS)
+		return;
+	if (cudaStreamCreate(&cublas_streams[0]) != cudaSuccess) {
+		cublasDestroy(cublas_handle);
+		return;
+	}
+	if (cudaStreamCreate(&cublas_streams[1]) != cudaSuccess) {
+		cudaStreamDestroy(cublas_streams[0]);
+		cublasDestroy(cublas_handle);
+		return;
+	}
+	cublas_ok = true;
+}
+
+/* Makes the buffer at least of the given number of doubles. */
+static bool reserve(double*& d, size_t& size, size_t needed)
+{
+	if (size >= needed)
+		return true;
+	cudaFree(d);
+	d = NULL;
+	size = 0;
+	if (cudaMalloc((void**)&d, needed*sizeof(double)) != cudaSuccess) {
+		d = NULL;
+		return false;
+	}
+	size = needed;
+	return true;
+}
+
+/* The matrix a is uploaded once. Then the column blocks of op(b) and c
+   go alternately to the two streams, so the upload of the block j+1
+   is queued on the other stream than the product of the block j. The
+   block j+2 reuses the buffers of the block j, so its stream is
+   synchronized before, which also tells that the block j is in c.
+   Returns the number of leading columns of c computed, all of them
+   unless cuBLAS fails. */
+static int cublas_gemm(bool ta, bool tb, int m, int n, int k,
+					   double alpha, const double* a, int lda, const double* b, int ldb,
+					   double beta, double* c, int ldc)
+{
+	int a_rows = ta ? k : m;
+	int a_cols = ta ? m : k;
+	int ncb = (n < num_col_blocks) ? n : num_col_blocks;
+	int bcols = (n + ncb - 1)/ncb;
+	if (! reserve(d_a, d_a_size, (size_t)a_rows*a_cols))
+		return 0;
+	for (int i = 0; i < 2; i++)
+		if (! reserve(d_b[i], d_b_size, (size_t)k*bcols)
+			|| ! reserve(d_c[i], d_c_size, (size_t)m*bcols))
+			return 0;
+
+	if (cublasSetMatrixAsync(a_rows, a_cols, sizeof(double), a, lda, d_a, a_rows,
+							 cublas_streams[0]) != CUBLAS_STATUS_SUCCESS
+		|| cudaStreamSynchronize(cublas_streams[0]) != cudaSuccess)
+		return 0;
+
+	cublasOperation_t opa = ta ? CUBLAS_OP_T : CUBLAS_OP_N;
+	cublasOperation_t opb = tb ? CUBLAS_OP_T : CUBLAS_OP_N;
+	int done = 0; // columns known to be in c
+	int queued = 0; // columns queued
+	bool ok = true;
+	for (int blk = 0; ok && queued < n; blk++) {
+		int nc = (n - queued < bcols) ? n - queued : bcols;
+		int s = blk % 2;
+		cudaStream_t stream = cublas_streams[s];
+		if (blk >= 2) {
+			if (cudaStreamSynchronize(stream) != cudaSuccess)
+				return done;
+			done += bcols;
+		}
+		// columns of op(b) are rows of b if transposed
+		const double* bj = tb ? b + queued : b + (size_t)queued*ldb;
+		int b_rows = tb ? nc : k;
+		int b_cols = tb ? k : nc;
+		double* cj = c + (size_t)queued*ldc;
+		ok = cublasSetMatrixAsync(b_rows, b_cols, sizeof(double), bj, ldb,
+								  d_b[s], b_rows, stream) == CUBLAS_STATUS_SUCCESS
+			&& (beta == 0.0
+				|| cublasSetMatrixAsync(m, nc, sizeof(double), cj, ldc,
+										d_c[s], m, stream) == CUBLAS_STATUS_SUCCESS)
+			&& cublasSetStream(cublas_handle, stream) == CUBLAS_STATUS_SUCCESS
+			&& cublasDgemm(cublas_handle, opa, opb, m, nc, k, &alpha, d_a, a_rows,
+						   d_b[s], b_rows, &beta, d_c[s], m) == CUBLAS_STATUS_SUCCESS
+			&& cublasGetMatrixAsync(m, nc, sizeof(double), d_c[s], m,
+									cj, ldc, stream) == CUBLAS_STATUS_SUCCESS;
+		if (ok)
+			queued += nc;
+	}
+	// wait for the last (at most two) blocks in their order
+	for (int blk = done/bcols; done < queued; blk++) {
+		if (cudaStreamSynchronize(cublas_streams[blk % 2]) != cudaSuccess)
+			return done;
+		done = (done + bcols < queued) ? done + bcols : queued;
+	}
+	return done;
+}
+
+/* If the GPU fails, we give it up for the rest of the run. */
+int SylvCublas::gemm(const char* transa, const char* transb, int m, int n, int k,
+					 double alpha, const double* a, int lda, const double* b, int ldb,
+					 double beta, double* c, int ldc)
+{
+	if (cublas_tried && ! cublas_ok)
+		return 0;
+	if (m <= 0 || n <= 0 || k <= 0 || ((double)m)*n*k < cublas_min_mnk)
+		return 0;
+	lock_cublas();
+	if (! cublas_tried)
+		init_cublas();
+	int done = 0;
+	if (cublas_ok && ((double)m)*n*k >= cublas_min_mnk) {
+		done = cublas_gemm(! strcmp(transa, "T"), ! strcmp(transb, "T"), m, n, k,
+						   alpha, a, lda, b, ldb, beta, c, ldc);
+		if (done < n) {
+			fprintf(stderr, "cuBLAS failure, falling back on BLAS\n");
+			cudaStreamSynchronize(cublas_streams[0]);
+			cudaStreamSynchronize(cublas_streams[1]);
+			free_buffers();
+			cublas_ok = false;
+		}
+	}
+	unlock_cublas();
+	return done;
+}
+
+#else
+
+int SylvCublas::gemm(const char* transa, const char* transb, int m, int n, int k,
+					 double alpha, const double* a, int lda, const double* b, int ldb,
+					 double beta, double* c, int ldc)
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef SYLV_CUBLAS_H
+#define SYLV_CUBLAS_H
+
+/* This is an optional cuBLAS backend of GeneralMatrix::gemm, compiled
+   in if CUBLAS is defined (configure with --enable-cublas). Only the
+   products with m*n*k at least DYNARE_CUBLAS_MIN_MNK (an environment
+   variable, default 1e8) go to the GPU, these are typically the
+   products of KronProdAll::mult and of the contractions of the stack
+   containers at high orders. The columns of the result are computed
+   by blocks on two streams, so that the transfer of the next block
+   overlaps the product of the current one. The GPU is used by one
+   thread at a time. */
+class SylvCublas
+{
+public:
+  /* returns the number of leading columns of c computed on the GPU,
+     this is zero if cuBLAS is not compiled in, there is no device or
+     the product is small, and less than n after a cuBLAS failure, the
+     caller then calls dgemm for the remaining columns */
+  static int gemm(const char *transa, const char *transb, int m, int n, int k,
+                   double alpha, const double *a, int lda, const double *b, int ldb,
+                   double beta, double *c, int ldc);
+};
+
+#endif /* SYLV_CUBLAS_H */
@@ -6,81 +6,102 @@
 #include "SylvException.h"
 #include "KronVector.h"
 
-#if defined(MATLAB_MEX_FILE) || defined(OCTAVE_MEX_FILE)
-# include <dynmex.h>
-#endif
-
 #include <cmath> 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+
+#include <map>
+#include <string>
+
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
+#if !defined(_WIN32) && !defined(__CYGWIN32__)
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+#endif
 
 /**********************************************************/
 /*   SylvMemoryPool                                       */
 /**********************************************************/
 
-SylvMemoryPool memory_pool;
+#ifdef HAVE_PTHREAD
+static pthread_key_t current_pool_key;
+static pthread_once_t current_pool_once = PTHREAD_ONCE_INIT;
 
-SylvMemoryPool::SylvMemoryPool()
-	: base(0), length(0), allocated(0), stack_mode(false)
+static void create_current_pool_key()
 {
+	pthread_key_create(&current_pool_key, NULL);
 }
-
-void SylvMemoryPool::init(size_t size)
-{
-#ifdef USE_MEMORY_POOL
-	length = size;
-
-#if defined(MATLAB_MEX_FILE) || defined(OCTAVE_MEX_FILE)
-	if (base)
-		throw SYLV_MES_EXCEPTION("Attempt to use matlab memory pool twice.");
-	base = (char*) mxMalloc(length);
 #else
-	base = (char*) malloc(length);
+static SylvMemoryPool* current_pool = 0;
 #endif
 
+SylvMemoryPool* SylvMemoryPool::current()
+{
+#ifdef HAVE_PTHREAD
+	pthread_once(&current_pool_once, create_current_pool_key);
+	return (SylvMemoryPool*) pthread_getspecific(current_pool_key);
 #else
-	throw SYLV_MES_EXCEPTION("SylvMemoryPool::init() called for non memory pool code.");
+	return current_pool;
 #endif
 }
 
-void* SylvMemoryPool::allocate(size_t size)
+void SylvMemoryPool::setCurrent(SylvMemoryPool* pool)
 {
-#ifdef USE_MEMORY_POOL
-	if (allocated + size < length) {
-		char* res = base + allocated;
-		allocated += size;
-		return res;
-	} else {
-		throw SYLV_MES_EXCEPTION("Run out of memory space");
-	}
+#ifdef HAVE_PTHREAD
+	pthread_once(&current_pool_once, create_current_pool_key);
+	pthread_setspecific(current_pool_key, pool);
 #else
-	throw SYLV_MES_EXCEPTION("SylvMemoryPool::allocate() called for non memory pool code.");
+	current_pool = pool;
 #endif
 }
 
-void SylvMemoryPool::free(void* p)
+SylvMemoryPool::SylvMemoryPool()
+	: base(0), length(0), allocated(0)
 {
-#ifdef USE_MEMORY_POOL
-	int offset = ((char*)p) - base;
-
-#ifdef DEBUG
-	if (offset < 0)
-		throw SYLV_MES_EXCEPTION("SylvMemoryPool::free() frees wrong address < begin.");
-	if (offset >= (int)length)
-		throw SYLV_MES_EXCEPTION("SylvMemoryPool::free() frees wrong address > end.");
-#endif	
+}
 
-	if (stack_mode && offset >= 0 && offset < (int)allocated)
-		allocated = offset;
+void SylvMemoryPool::init(size_t size)
+{
+	reset();
+	base = new char[size];
+	length = size;
+}
 
-#else
-	throw SYLV_MES_EXCEPTION("SylvMemoryPool::free() called for non memory pool code.");
-#endif
+/* The blocks are aligned to the size of two doubles. */
+void* SylvMemoryPool::allocate(size_t size)
+{
+	const size_t align = 2*sizeof(double);
+	size = (size + align - 1)/align*align;
+	if (allocated + size > length)
+		return 0;
+	char* res = base + allocated;
+	offsets.push_back(allocated);
+	freed.push_back(false);
+	allocated += size;
+	return res;
 }
 
-void SylvMemoryPool::setStackMode(bool mode)
+/* The freed block is usually the last one, blocks freed out of order
+   are only marked. Then we pop all freed blocks from the top. */
+void SylvMemoryPool::free(void* p)
 {
-	stack_mode = mode;
+	size_t offset = ((char*)p) - base;
+	int i = offsets.size()-1;
+	while (i >= 0 && offsets[i] != offset)
+		i--;
+	if (i < 0)
+		throw SYLV_MES_EXCEPTION("SylvMemoryPool::free() frees unallocated block.");
+	freed[i] = true;
+	while (!offsets.empty() && freed.back()) {
+		allocated = offsets.back();
+		offsets.pop_back();
+		freed.pop_back();
+	}
 }
 
 SylvMemoryPool::~SylvMemoryPool()
@@ -90,119 +111,170 @@ SylvMemoryPool::~SylvMemoryPool()
 
 void SylvMemoryPool::reset()
 {
-#if !defined(MATLAB_MEX_FILE) && !defined(OCTAVE_MEX_FILE)
 	delete [] base;
 	base = 0;
 	allocated = 0;
 	length = 0;
-	stack_mode = false;
-#endif
+	offsets.clear();
+	freed.clear();
 }
 
 /**********************************************************/
-/*   global new and delete                                */
+/*   SylvScratchFile                                      */
 /**********************************************************/
 
-#ifdef USE_MEMORY_POOL
-
-void* operator new(size_t size)
-{
-	return memory_pool.allocate(size);
-}
-
-void* operator new[](size_t size)
-{
-	return memory_pool.allocate(size);
-}
-
-void operator delete(void* p)
+#if !defined(_WIN32) && !defined(__CYGWIN32__)
+static int scratch_fd = -1;
+static size_t scratch_min_size = 0;
+static size_t scratch_length = 0;
+/* offsets and sizes of the mapped blocks */
+static std::map<void*, std::pair<off_t, size_t> > scratch_blocks;
+/* free regions of the file by their size */
+static std::multimap<size_t, off_t> scratch_holes;
+static bool scratch_used = false;
+# ifdef HAVE_PTHREAD
+static pthread_mutex_t scratch_mutex = PTHREAD_MUTEX_INITIALIZER;
+# endif
+
+static void lock_scratch()
 {
-	memory_pool.free(p);
+# ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&scratch_mutex);
+# endif
 }
 
-void operator delete[](void* p)
+static void unlock_scratch()
 {
-	memory_pool.free(p);
+# ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&scratch_mutex);
+# endif
 }
-
 #endif
 
-/**********************************************************/
-/*   saved version of global new and delete               */
-/**********************************************************/
-
-#ifdef USE_MEMORY_POOL
-void* MallocAllocator::operator new(size_t size)
+/* The file is unlinked right after its creation, so it disappears
+   with the process. */
+bool SylvScratchFile::init(const char* dir, size_t min_size)
 {
-#if defined(MATLAB_MEX_FILE) || defined(OCTAVE_MEX_FILE)
-	throw SYLV_MES_EXCEPTION("Attempt to call wrong memory allocator.");
+#if !defined(_WIN32) && !defined(__CYGWIN32__)
+	std::string name(dir);
+	name += "/dynare_scratch_XXXXXX";
+	char* tmpl = new char[name.length()+1];
+	strcpy(tmpl, name.c_str());
+	int fd = mkstemp(tmpl);
+	if (fd >= 0)
+		unlink(tmpl);
+	delete [] tmpl;
+	if (fd < 0)
+		return false;
+	lock_scratch();
+	if (scratch_fd >= 0)
+		close(scratch_fd);
+	scratch_fd = fd;
+	scratch_min_size = min_size;
+	scratch_length = 0;
+	scratch_holes.clear();
+	unlock_scratch();
+	return true;
 #else
-	void* res = malloc(size);
-	if (!res) 
-		throw SYLV_MES_EXCEPTION("Malloc unable to allocate memory.");
-	return res;
+	return false;
 #endif
 }
 
-void* MallocAllocator::operator new[](size_t size)
+/* The size is rounded up to pages. We take the smallest free region
+   which is large enough (the rest remains free), or extend the file. */
+void* SylvScratchFile::allocate(size_t size)
 {
-#if defined(MATLAB_MEX_FILE) || defined(OCTAVE_MEX_FILE)
-	throw SYLV_MES_EXCEPTION("Attempt to call wrong memory allocator.");
-#else
-	void* res = malloc(size);
-	if (!res)
-		throw SYLV_MES_EXCEPTION("Malloc unable allocate memory.");
+#if !defined(_WIN32) && !defined(__CYGWIN32__)
+	if (scratch_fd < 0 || size < scratch_min_size || size == 0)
+		return 0;
+	size_t page = (size_t) sysconf(_SC_PAGESIZE);
+	size = (size + page - 1)/page*page;
+	lock_scratch();
+	off_t offset;
+	std::multimap<size_t, off_t>::iterator hole = scratch_holes.lower_bound(size);
+	if (hole != scratch_holes.end()) {
+		offset = (*hole).second;
+		if ((*hole).first > size)
+			scratch_holes.insert(std::make_pair((*hole).first - size, (off_t)(offset + size)));
+		scratch_holes.erase(hole);
+	} else {
+		offset = (off_t) scratch_length;
+		if (ftruncate(scratch_fd, offset + size) != 0) {
+			unlock_scratch();
+			return 0;
+		}
+		scratch_length += size;
+	}
+	void* res = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, scratch_fd, offset);
+	if (res == MAP_FAILED) {
+		scratch_holes.insert(std::make_pair(size, offset));
+		unlock_scratch();
+		return 0;
+	}
+	scratch_blocks[res] = std::make_pair(offset, size);
+	scratch_used = true;
+	unlock_scratch();
 	return res;
-#endif
-}
-
-void MallocAllocator::operator delete(void* p)
-{
-#if defined(MATLAB_MEX_FILE) || defined(OCTAVE_MEX_FILE)
-	throw SYLV_MES_EXCEPTION("Attempt to call wrong memory destructor.");
 #else
-	free(p);
+	return 0;
 #endif
 }
 
-void MallocAllocator::operator delete[](void* p)
+/* The region of the freed block is deallocated from the file if the
+   system can punch holes, so that its pages are never written back. */
+bool SylvScratchFile::free(void* p)
 {
-#if defined(MATLAB_MEX_FILE) || defined(OCTAVE_MEX_FILE)
-	throw SYLV_MES_EXCEPTION("Attempt to call wrong memory destructor.");
+#if !defined(_WIN32) && !defined(__CYGWIN32__)
+	if (! scratch_used)
+		return false;
+	lock_scratch();
+	std::map<void*, std::pair<off_t, size_t> >::iterator it = scratch_blocks.find(p);
+	if (it == scratch_blocks.end()) {
+		unlock_scratch();
+		return false;
+	}
+	off_t offset = (*it).second.first;
+	size_t size = (*it).second.second;
+	scratch_blocks.erase(it);
+	munmap(p, size);
+# ifdef FALLOC_FL_PUNCH_HOLE
+	fallocate(scratch_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, size);
+# endif
+	scratch_holes.insert(std::make_pair(size, offset));
+	unlock_scratch();
+	return true;
 #else
-	free(p);
+	return false;
 #endif
 }
 
-#endif
-
-
 /**********************************************************/
 /*   SylvMemoryDriver                                     */
 /**********************************************************/
 
+/* The arena is for the temporary vectors and matrices created during
+   the solution, the num_d big matrices are allocated by the caller
+   outside the stack mode, so the num_d is not used now. */
 void SylvMemoryDriver::allocate(int num_d, int m, int n, int order)
 {
-#ifdef USE_MEMORY_POOL
-	int x_cols = power(m,order);
-	int total = num_d*x_cols*n; // storage for big matrices
-	total += x_cols; // storage for one extra row of a big matrix
-	int dig_vectors = (int)ceil(((double)(power(m,order)-1))/(m-1));
+	size_t x_cols = power(m,order);
+	size_t total = x_cols; // storage for one extra row of a big matrix
+	size_t dig_vectors = (m > 1) ? (x_cols-1)/(m-1) + 1 : order;
 	total += 8*n*dig_vectors; // storage for kron vectors instantiated during solv
 	total += 50*(m*m+n*n); // some storage for small square matrices
 	total *= sizeof(double); // everything in doubles
-	memory_pool.init(total);
-#endif
+	pool.init(total);
 }
 
-
 SylvMemoryDriver::SylvMemoryDriver(int num_d, int m, int n, int order)
+	: saved(0)
 {
 	allocate(num_d, m, n, order);
 }
 
 SylvMemoryDriver::SylvMemoryDriver(const SylvParams& pars, int num_d,
 								   int m, int n, int order)
+	: saved(0)
 {
 	if (*(pars.method) == SylvParams::iter)
 		num_d++;
@@ -213,9 +285,25 @@ SylvMemoryDriver::SylvMemoryDriver(const SylvParams& pars, int num_d,
 
 SylvMemoryDriver::~SylvMemoryDriver()
 {
-	memory_pool.reset();
+	if (SylvMemoryPool::current() == &pool)
+		SylvMemoryPool::setCurrent(saved);
 }
 
-void SylvMemoryDriver::setStackMode(bool mode) {
-	memory_pool.setStackMode(mode);
+/* Switching the stack mode on makes the arena the current arena of the
+   calling thread, switching it off restores the previous one. */
+void SylvMemoryDriver::setStackMode(bool mode)
+{
+	if (mode) {
+		if (SylvMemoryPool::current() != &pool) {
+			saved = SylvMemoryPool::current();
+			SylvMemoryPool::setCurrent(&pool);
+		}
+	} else if (SylvMemoryPool::current() == &pool) {
+		SylvMemoryPool::setCurrent(saved);
+		saved = 0;
+	}
 }
+
+// Local Variables:
+// mode:C++
+// End:
@@ -8,51 +8,86 @@
 #include "SylvParams.h"
 
 #include <new>
+#include <vector>
 
+/* Global new and delete are not overridden any more, all objects are
+   allocated by the standard allocator. The class is kept as a base of
+   the classes which used to be allocated outside the memory pool. */
 class MallocAllocator
 {
-#ifdef USE_MEMORY_POOL
-public:
-  void *operator new(size_t size);
-  void *operator new[](size_t size);
-  void operator delete(void *p);
-  void operator delete[](void *p);
-#endif
 };
 
-#ifdef USE_MEMORY_POOL
-void *operator new(size_t size);
-void *operator new[](size_t size);
-void operator delete(void *p);
-void operator delete[](void *p);
-#endif
-
+/* This is a bump arena for the data of vectors and matrices created
+   while its SylvMemoryDriver is in the stack mode. The blocks are freed
+   in arbitrary order, the space is reused when all the blocks above it
+   are freed. The arena is used only by the thread which set the stack
+   mode, so it needs no locking. */
 class SylvMemoryPool
 {
   char *base;
   size_t length;
   size_t allocated;
-  bool stack_mode;
+  std::vector<size_t> offsets; // offsets of allocated blocks
+  std::vector<bool> freed; // true if the block was freed
   SylvMemoryPool(const SylvMemoryPool &);
   const SylvMemoryPool &operator=(const SylvMemoryPool &);
 public:
   SylvMemoryPool();
   ~SylvMemoryPool();
   void init(size_t size);
+  /* returns 0 if the block does not fit */
   void *allocate(size_t size);
   void free(void *p);
+  bool
+  contains(const void *p) const
+  {
+    return base <= (const char *) p && (const char *) p < base + length;
+  }
+  bool
+  empty() const
+  {
+    return offsets.empty();
+  }
   void reset();
-  void setStackMode(bool);
+  /* the arena of the calling thread (or 0) */
+  static SylvMemoryPool *current();
+  static void setCurrent(SylvMemoryPool *pool);
+};
+
+/* This is a scratch file for the data of big vectors and matrices
+   (typically the tensors of high order approximations), so that they
+   can be larger than the RAM. Once it is initialized, every block of
+   at least min_size bytes allocated outside an arena is a shared
+   mapping of a region of an unlinked file in the given directory, the
+   kernel then keeps in RAM the recently used pages, and writes the
+   others to the file instead of the swap. Freed regions are reused.
+   Not available on Windows, where init() returns false. */
+class SylvScratchFile
+{
+public:
+  static bool init(const char *dir, size_t min_size);
+  /* returns 0 if not initialized, if the block is smaller than
+     min_size, or if the mapping fails */
+  static void *allocate(size_t size);
+  /* returns false if the block was not allocated by allocate() */
+  static bool free(void *p);
 };
 
+/* The driver owns an arena sized for the solution of a system of the
+   given dimensions. In the stack mode, the arena is the current arena
+   of the thread, the data allocated in that time must not outlive the
+   driver. Each thread solving a part of a system needs its own
+   driver. */
 class SylvMemoryDriver
 {
+  SylvMemoryPool pool;
+  SylvMemoryPool *saved;
   SylvMemoryDriver(const SylvMemoryDriver &);
   const SylvMemoryDriver &operator=(const SylvMemoryDriver &);
 public:
   SylvMemoryDriver(int num_d, int m, int n, int order);
   SylvMemoryDriver(const SylvParams &pars, int num_d, int m, int n, int order);
-  static void setStackMode(bool);
+  void setStackMode(bool);
   ~SylvMemoryDriver();
 protected:
   void allocate(int num_d, int m, int n, int order);
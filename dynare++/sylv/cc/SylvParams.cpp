@@ -25,6 +25,7 @@ void SylvParams::print(FILE* fdesc, const char* prefix) const
 	f_largest.print(fdesc, prefix,"largest block in F ", "%d");
 	f_zeros.print(fdesc, prefix,  "num zeros in F     ", "%d");
 	f_offdiag.print(fdesc, prefix,"num offdiag in F   ", "%d");
+	num_threads.print(fdesc, prefix,"num threads        ", "%d");
 	if (*method == iter) {
 		converged.print(fdesc, prefix,       "converged          ", "%d");
 		convergence_tol.print(fdesc, prefix, "convergence tol.   ", "%8.4g");
@@ -49,6 +50,7 @@ void SylvParams::copy(const SylvParams& p)
 	max_num_iter = p.max_num_iter;
 	bs_norm = p.bs_norm;
 	want_check = p.want_check;
+	num_threads = p.num_threads;
 	converged = p.converged;
 	iter_last_norm = p.iter_last_norm;
 	num_iter = p.num_iter;
@@ -84,6 +86,8 @@ void SylvParams::setArrayNames(int& num, const char** names) const
 		names[num++] = "max_num_iter";
 	if (bs_norm.getStatus() != undef)
 		names[num++] = "bs_norm";
+	if (num_threads.getStatus() != undef)
+		names[num++] = "num_threads";
 	if (converged.getStatus() != undef)
 		names[num++] = "converged";
 	if (iter_last_norm.getStatus() != undef)
@@ -176,6 +180,8 @@ mxArray* SylvParams::createStructArray() const
 		mxSetFieldByNumber(res, 0, i++, max_num_iter.createMatlabArray());
 	if (bs_norm.getStatus() != undef)
 		mxSetFieldByNumber(res, 0, i++, bs_norm.createMatlabArray());
+	if (num_threads.getStatus() != undef)
+		mxSetFieldByNumber(res, 0, i++, num_threads.createMatlabArray());
 	if (converged.getStatus() != undef)
 		mxSetFieldByNumber(res, 0, i++, converged.createMatlabArray());
 	if (iter_last_norm.getStatus() != undef)
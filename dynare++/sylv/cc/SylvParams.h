@@ -172,6 +172,7 @@ public:
   IntParamItem max_num_iter; // max number of iterations
   DoubleParamItem bs_norm; // Bavely Stewart log10 of norm for diagonalization
   BoolParamItem want_check; // true => allocate extra space for checks
+  IntParamItem num_threads; // number of threads solving independent slices
   // output parameters
   BoolParamItem converged; // true if converged
   DoubleParamItem iter_last_norm; // norm of the last iteration
@@ -199,7 +200,7 @@ public:
 
   SylvParams(bool wc = false)
     : method(recurse), convergence_tol(1.e-30), max_num_iter(15),
-      bs_norm(1.3), want_check(wc)
+      bs_norm(1.3), want_check(wc), num_threads(1)
   {
   }
   SylvParams(const SylvParams &p)
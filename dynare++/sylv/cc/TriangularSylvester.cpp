@@ -6,12 +6,21 @@
 #include "QuasiTriangularZero.h"
 #include "KronUtils.h"
 #include "BlockDiagonal.h"
+#include "SylvException.h"
+#include "SylvMemory.h"
 
 #include <cstdio>
 #include <cmath>
+#include <algorithm>
+#include <vector>
+
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
 
 double TriangularSylvester::diag_zero = 1.e-15;
 double TriangularSylvester::diag_zero_sq = 1.e-30;
+int TriangularSylvester::panel_size = 16;
 
 TriangularSylvester::TriangularSylvester(const QuasiTriangular& k,
 										 const QuasiTriangular& f)
@@ -54,7 +63,10 @@ void TriangularSylvester::print() const
 void TriangularSylvester::solve(SylvParams& pars, KronVector& d) const
 {
 	double eig_min = 1e30;
-	solvi(1., d, eig_min);
+	if (*(pars.num_threads) > 1 && d.getDepth() > 0)
+		solviParallel(*(pars.num_threads), d, eig_min);
+	else
+		solvi(1., d, eig_min);
 	pars.eig_min = sqrt(eig_min);
 }
 
@@ -65,9 +77,17 @@ void TriangularSylvester::solvi(double r, KronVector& d, double& eig_min) const
 		t->solvePre(d, eig_min);
 		delete t;
 	} else {
-		for (const_diag_iter di = matrixF->diag_begin();
-			 di != matrixF->diag_end();
-			 ++di) {
+		solviRange(r, d, matrixF->diag_begin(), matrixF->diag_end(), eig_min);
+	}
+}
+
+void TriangularSylvester::solviRange(double r, KronVector& d, const_diag_iter begin,
+									 const_diag_iter end, double& eig_min) const
+{
+	if (useBlocked(d)) {
+		solviBlocked(r, d, begin, end, eig_min);
+	} else {
+		for (const_diag_iter di = begin; di != end; ++di) {
 			if ((*di).isReal()) {
 				solviRealAndEliminate(r, di, d, eig_min);
 			} else {
@@ -105,6 +125,8 @@ void TriangularSylvester::solviip(double alpha, double betas,
 		QuasiTriangular* t= matrixK->clone(2*alpha, aspbs, *matrixKK);
 		t->solvePre(d, eig_min);
 		delete t;
+	} else if (useBlocked(d)) {
+		solviipBlocked(alpha, betas, d, eig_min);
 	} else {
 		const_diag_iter di = matrixF->diag_begin();
 		const_diag_iter dsi = matrixFF->diag_begin();
@@ -120,7 +142,8 @@ void TriangularSylvester::solviip(double alpha, double betas,
 
 
 void TriangularSylvester::solviRealAndEliminate(double r, const_diag_iter di,
-												KronVector& d, double& eig_min) const
+												KronVector& d, double& eig_min,
+												Panel* p) const
 {
 	// di is real
 	int jbar = (*di).getIndex();
@@ -135,14 +158,16 @@ void TriangularSylvester::solviRealAndEliminate(double r, const_diag_iter di,
 	KronUtils::multKron(*matrixF, *matrixK, y);
 	y.mult(r);
 	double divisor = 1.0;
-	solviEliminateReal(di, d, y, divisor);
+	storePanel(p, p ? p->y1 : NULL, jbar, y);
+	solviEliminateReal(di, d, y, divisor, p ? p->last : d.getM());
 }
 
 void TriangularSylvester::solviEliminateReal(const_diag_iter di, KronVector& d,
-											 const KronVector& y, double divisor) const
+											 const KronVector& y, double divisor,
+											 int colend) const
 {
 	for (const_row_iter ri = matrixF->row_begin(*di);
-		 ri != matrixF->row_end(*di);
+		 ri != matrixF->row_end(*di) && ri.getCol() < colend;
 		 ++ri) {
 		KronVector dk(d, ri.getCol());
 		dk.add(-(*ri)/divisor, y);
@@ -150,7 +175,8 @@ void TriangularSylvester::solviEliminateReal(const_diag_iter di, KronVector& d,
 }
 
 void TriangularSylvester::solviComplexAndEliminate(double r, const_diag_iter di,
-												   KronVector& d, double& eig_min) const
+												   KronVector& d, double& eig_min,
+												   Panel* p) const
 {
 	// di is complex
 	int jbar = (*di).getIndex();
@@ -172,15 +198,17 @@ void TriangularSylvester::solviComplexAndEliminate(double r, const_diag_iter di,
 	y1.mult(r);
 	y2.mult(r);
 	double divisor = 1.0;
-	solviEliminateComplex(di, d, y1, y2, divisor);
+	storePanel(p, p ? p->y1 : NULL, jbar, y1);
+	storePanel(p, p ? p->y1 : NULL, jbar+1, y2);
+	solviEliminateComplex(di, d, y1, y2, divisor, p ? p->last : d.getM());
 }
 
 void TriangularSylvester::solviEliminateComplex(const_diag_iter di, KronVector& d,
 												const KronVector& y1, const KronVector& y2,
-												double divisor) const
+												double divisor, int colend) const
 {
 	for (const_row_iter ri = matrixF->row_begin(*di);
-		 ri != matrixF->row_end(*di);
+		 ri != matrixF->row_end(*di) && ri.getCol() < colend;
 		 ++ri) {
 		KronVector dk(d, ri.getCol());
 		dk.add(-ri.a()/divisor, y1);
@@ -190,7 +218,8 @@ void TriangularSylvester::solviEliminateComplex(const_diag_iter di, KronVector&
 
 void TriangularSylvester::solviipRealAndEliminate(double alpha, double betas,
 												  const_diag_iter di, const_diag_iter dsi,
-												  KronVector& d, double& eig_min) const
+												  KronVector& d, double& eig_min,
+												  Panel* p) const
 {
 	// di, and dsi are real		
 	int jbar = (*di).getIndex();
@@ -211,17 +240,21 @@ void TriangularSylvester::solviipRealAndEliminate(double alpha, double betas,
 	y2.mult(aspbs);
 	double divisor = 1.0;
 	double divisor2 = 1.0;
-	solviipEliminateReal(di, dsi, d, y1, y2, divisor, divisor2);
+	storePanel(p, p ? p->y1 : NULL, jbar, y1);
+	storePanel(p, p ? p->y2 : NULL, jbar, y2);
+	solviipEliminateReal(di, dsi, d, y1, y2, divisor, divisor2,
+						 p ? p->last : d.getM());
 }
 
 void TriangularSylvester::solviipEliminateReal(const_diag_iter di, const_diag_iter dsi,
 											   KronVector& d,
 											   const KronVector& y1, const KronVector& y2,
-											   double divisor, double divisor2) const
+											   double divisor, double divisor2,
+											   int colend) const
 {
 	const_row_iter ri = matrixF->row_begin(*di);
 	const_row_iter rsi = matrixFF->row_begin(*dsi);
-	for (; ri != matrixF->row_end(*di); ++ri, ++rsi) {
+	for (; ri != matrixF->row_end(*di) && ri.getCol() < colend; ++ri, ++rsi) {
 		KronVector dk(d, ri.getCol());
 		dk.add(-(*ri)/divisor, y1);
 		dk.add(-(*rsi)/divisor2, y2);
@@ -230,7 +263,8 @@ void TriangularSylvester::solviipEliminateReal(const_diag_iter di, const_diag_it
 
 void TriangularSylvester::solviipComplexAndEliminate(double alpha, double betas,
 													 const_diag_iter di, const_diag_iter dsi,
-													 KronVector& d, double& eig_min) const
+													 KronVector& d, double& eig_min,
+													 Panel* p) const
 {
 	// di, and dsi are complex
 	int jbar = (*di).getIndex();
@@ -264,7 +298,12 @@ void TriangularSylvester::solviipComplexAndEliminate(double alpha, double betas,
 	y22.mult(aspbs);
 
 	double divisor = 1.0;
-	solviipEliminateComplex(di, dsi, d, y1, y11, y2, y22, divisor);
+	storePanel(p, p ? p->y1 : NULL, jbar, y1);
+	storePanel(p, p ? p->y1 : NULL, jbar+1, y11);
+	storePanel(p, p ? p->y2 : NULL, jbar, y2);
+	storePanel(p, p ? p->y2 : NULL, jbar+1, y22);
+	solviipEliminateComplex(di, dsi, d, y1, y11, y2, y22, divisor,
+							p ? p->last : d.getM());
 }
 
 
@@ -293,11 +332,11 @@ void TriangularSylvester::solviipEliminateComplex(const_diag_iter di, const_diag
 												  KronVector& d,
 												  const KronVector& y1, const KronVector& y11,
 												  const KronVector& y2, const KronVector& y22,
-												  double divisor) const
+												  double divisor, int colend) const
 {
 	const_row_iter ri = matrixF->row_begin(*di);
 	const_row_iter rsi = matrixFF->row_begin(*dsi);
-	for (; ri != matrixF->row_end(*di); ++ri, ++rsi) {
+	for (; ri != matrixF->row_end(*di) && ri.getCol() < colend; ++ri, ++rsi) {
 		KronVector dk(d, ri.getCol());
 		dk.add(-ri.a()/divisor, y1);
 		dk.add(-ri.b()/divisor, y11);
@@ -306,6 +345,255 @@ void TriangularSylvester::solviipEliminateComplex(const_diag_iter di, const_diag
 	}
 }
 
+/* The blocked solvers are used only if F is bigger than one panel and
+   the data of d are contiguous, so that the subvectors of d are columns
+   of a matrix. */
+bool TriangularSylvester::useBlocked(const KronVector& d) const
+{
+	return d.getM() > panel_size && d.skip() == 1;
+}
+
+/* This is the same as the loop in solvi, but the blocks are processed
+   by panels. Within the panel, the eliminations are done as in solvi,
+   the eliminations of the whole panel to the columns after it are done
+   by one matrix multiplication in eliminatePanel. */
+void TriangularSylvester::solviBlocked(double r, KronVector& d, const_diag_iter begin,
+									   const_diag_iter end, double& eig_min) const
+{
+	int len = d.length()/d.getM();
+	const_diag_iter di = begin;
+	while (di != end) {
+		Panel p;
+		const_diag_iter dend = findPanel(di, end, p, false);
+		GeneralMatrix y1(len, p.last-p.first);
+		p.y1 = &y1;
+		p.y2 = NULL;
+		for (; di != dend; ++di) {
+			if ((*di).isReal()) {
+				solviRealAndEliminate(r, di, d, eig_min, &p);
+			} else {
+				solviComplexAndEliminate(r, di, d, eig_min, &p);
+			}
+		}
+		eliminatePanel(p, d);
+	}
+}
+
+/* This is the same as the loop in solviip, but blocked as solviBlocked. */
+void TriangularSylvester::solviipBlocked(double alpha, double betas,
+										 KronVector& d, double& eig_min) const
+{
+	int len = d.length()/d.getM();
+	const_diag_iter di = matrixF->diag_begin();
+	const_diag_iter dsi = matrixFF->diag_begin();
+	while (di != matrixF->diag_end()) {
+		Panel p;
+		const_diag_iter dend = findPanel(di, matrixF->diag_end(), p, true);
+		GeneralMatrix y1(len, p.last-p.first);
+		GeneralMatrix y2(len, p.last-p.first);
+		p.y1 = &y1;
+		p.y2 = &y2;
+		for (; di != dend; ++di, ++dsi) {
+			if ((*di).isReal()) {
+				solviipRealAndEliminate(alpha, betas, di, dsi, d, eig_min, &p);
+			} else {
+				solviipComplexAndEliminate(alpha, betas, di, dsi, d, eig_min, &p);
+			}
+		}
+		eliminatePanel(p, d);
+	}
+}
+
+/* Sets the panel starting at di to at least panel_size rows (blocks are
+   not split) and returns the block after it. The colend is the end of
+   the longest row of F (and FF if squares is true) in the panel. */
+TriangularSylvester::const_diag_iter
+TriangularSylvester::findPanel(const_diag_iter di, const_diag_iter end,
+							   Panel& p, bool squares) const
+{
+	p.first = (*di).getIndex();
+	p.last = p.first;
+	p.colend = p.first;
+	const_diag_iter dsi = matrixFF->diag_begin();
+	while ((*dsi).getIndex() < p.first)
+		++dsi;
+	for (; di != end && p.last-p.first < panel_size; ++di, ++dsi) {
+		p.last += (*di).isReal() ? 1 : 2;
+		p.colend = std::max(p.colend, matrixF->row_end(*di).getCol());
+		if (squares)
+			p.colend = std::max(p.colend, matrixFF->row_end(*dsi).getCol());
+	}
+	return di;
+}
+
+/* Here we subtract y1*F and y2*FF restricted to the rows of the panel
+   and columns from last to colend from the corresponding columns of d. */
+void TriangularSylvester::eliminatePanel(const Panel& p, KronVector& d) const
+{
+	if (p.colend <= p.last)
+		return;
+	int len = d.length()/d.getM();
+	int nrows = p.last-p.first;
+	int ncols = p.colend-p.last;
+	GeneralMatrix drest(d.base()+p.last*len, len, ncols);
+	drest.multAndAdd(ConstGeneralMatrix(*(p.y1)),
+					 ConstGeneralMatrix(*matrixF, p.first, p.last, nrows, ncols),
+					 -1.0);
+	if (p.y2)
+		drest.multAndAdd(ConstGeneralMatrix(*(p.y2)),
+						 ConstGeneralMatrix(*matrixFF, p.first, p.last, nrows, ncols),
+						 -1.0);
+}
+
+/* If F is block diagonal (as it is after SimilarityDecomp), the
+   slices of d corresponding to different diagonal blocks of F are never
+   eliminated to each other, so they can be solved at the same time. */
+int TriangularSylvester::findIndependent(const_diag_iter& di) const
+{
+	int size = 0;
+	int colend = (*di).getIndex();
+	do {
+		size += (*di).isReal() ? 1 : 2;
+		colend = std::max(colend, matrixF->row_end(*di).getCol());
+		++di;
+	} while (di != matrixF->diag_end() && (*di).getIndex() < colend);
+	return size;
+}
+
+/* The queue of independent slices shared by the threads of
+   solviParallel. Each thread takes the next slices from the queue until
+   it is empty. The largest slices go first. */
+struct TriangularSylvester::SlicesQueue
+{
+	const TriangularSylvester* sylv;
+	KronVector* d;
+	std::vector<Slices*> slices;
+	int next;
+	bool failed;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t mutex;
+#endif
+	~SlicesQueue()
+		{
+			for (unsigned int i = 0; i < slices.size(); i++)
+				delete slices[i];
+		}
+	static bool larger(const Slices* s1, const Slices* s2)
+		{return s1->size > s2->size;}
+	void lock()
+		{
+#ifdef HAVE_PTHREAD
+			pthread_mutex_lock(&mutex);
+#endif
+		}
+	void unlock()
+		{
+#ifdef HAVE_PTHREAD
+			pthread_mutex_unlock(&mutex);
+#endif
+		}
+	Slices* pop()
+		{
+			lock();
+			Slices* res = NULL;
+			if (next < (int)slices.size() && !failed)
+				res = slices[next++];
+			unlock();
+			return res;
+		}
+	void fail()
+		{
+			lock();
+			failed = true;
+			unlock();
+		}
+};
+
+void* TriangularSylvester::solviWorker(void* arg)
+{
+	SlicesQueue* q = (SlicesQueue*)arg;
+	try {
+		Slices* s;
+		while (NULL != (s = q->pop()))
+			q->sylv->solviRange(1., *(q->d), s->begin, s->end, s->eig_min);
+	} catch (...) {
+		q->fail();
+	}
+	return NULL;
+}
+
+/* This is the entry of the started threads, each has its own memory
+   arena for the temporary vectors. */
+void* TriangularSylvester::solviThread(void* arg)
+{
+	SlicesQueue* q = (SlicesQueue*)arg;
+	try {
+		SylvMemoryDriver memdriver(0, q->d->getM(), q->d->getN(), q->d->getDepth());
+		memdriver.setStackMode(true);
+		solviWorker(arg);
+		memdriver.setStackMode(false);
+	} catch (...) {
+		q->fail();
+	}
+	return NULL;
+}
+
+/* The calling thread works as one of the num_threads threads, it uses
+   the arena of the caller. */
+void TriangularSylvester::solviParallel(int num_threads, KronVector& d,
+										double& eig_min) const
+{
+	SlicesQueue q;
+	q.sylv = this;
+	q.d = &d;
+	q.next = 0;
+	q.failed = false;
+	const_diag_iter di = matrixF->diag_begin();
+	while (di != matrixF->diag_end()) {
+		const_diag_iter begin(di);
+		int size = findIndependent(di);
+		q.slices.push_back(new Slices(begin, di, size));
+	}
+	if (q.slices.size() < 2) {
+		solvi(1., d, eig_min);
+		return;
+	}
+#ifdef HAVE_PTHREAD
+	pthread_mutex_init(&(q.mutex), NULL);
+#endif
+#ifdef HAVE_PTHREAD
+	std::stable_sort(q.slices.begin(), q.slices.end(), SlicesQueue::larger);
+	int num_workers = std::min(num_threads, (int)q.slices.size()) - 1;
+	std::vector<pthread_t> workers(num_workers);
+	int num_started = 0;
+	for (; num_started < num_workers; num_started++)
+		if (pthread_create(&(workers[num_started]), NULL, solviThread, &q))
+			break;
+	solviWorker(&q);
+	for (int i = 0; i < num_started; i++)
+		pthread_join(workers[i], NULL);
+#else
+	solviWorker(&q);
+#endif
+#ifdef HAVE_PTHREAD
+	pthread_mutex_destroy(&(q.mutex));
+#endif
+	if (q.failed)
+		throw SYLV_MES_EXCEPTION("Solution of independent slices failed.");
+	for (unsigned int i = 0; i < q.slices.size(); i++)
+		eig_min = std::min(eig_min, q.slices[i]->eig_min);
+}
+
+/* Stores v to the column of y corresponding to the given row of F. */
+void TriangularSylvester::storePanel(Panel* p, GeneralMatrix* y, int row,
+									 const KronVector& v)
+{
+	if (p) {
+		Vector ycol(y->getData(), (row-p->first)*v.length(), v.length());
+		ycol = v;
+	}
+}
+
 void TriangularSylvester::linEval(double alpha, double beta1, double beta2,
 								  KronVector& x1, KronVector& x2,
 								  const ConstKronVector& d1, const ConstKronVector& d2) const
@@ -16,6 +16,9 @@ class TriangularSylvester : public SylvesterSolver
   const QuasiTriangular *const matrixKK;
   const QuasiTriangular *const matrixFF;
 public:
+  /* number of rows of F eliminated at once by the blocked solvers, if F
+     has no more rows, the plain recursion is used */
+  static int panel_size;
   TriangularSylvester(const QuasiTriangular &k, const QuasiTriangular &f);
   TriangularSylvester(const SchurDecompZero &kdecomp, const SchurDecomp &fdecomp);
   TriangularSylvester(const SchurDecompZero &kdecomp, const SimilarityDecomp &fdecomp);
@@ -78,33 +81,88 @@ private:
   /* auxiliary typedefs */
   typedef QuasiTriangular::const_diag_iter const_diag_iter;
   typedef QuasiTriangular::const_row_iter const_row_iter;
+  /* a panel of diagonal blocks of F covering rows first..last-1, the
+     eliminations to columns last..colend-1 are postponed, the vectors
+     to be eliminated are stored in columns of y1 (multiplied by F) and
+     y2 (multiplied by FF) */
+  struct Panel
+  {
+    int first;
+    int last;
+    int colend;
+    GeneralMatrix *y1;
+    GeneralMatrix *y2;
+  };
+  /* solvi for depth > 0 restricted to the diagonal blocks of F from
+     begin to end, this is correct if no row of F in range has nonzeros
+     after the range */
+  void solviRange(double r, KronVector &d, const_diag_iter begin,
+                  const_diag_iter end, double &eig_min) const;
+  /* blocked versions of solvi and solviip for depth > 0 */
+  bool useBlocked(const KronVector &d) const;
+  void solviBlocked(double r, KronVector &d, const_diag_iter begin,
+                    const_diag_iter end, double &eig_min) const;
+  void solviipBlocked(double alpha, double betas,
+                      KronVector &d, double &eig_min) const;
+  const_diag_iter findPanel(const_diag_iter di, const_diag_iter end,
+                            Panel &p, bool squares) const;
+  void eliminatePanel(const Panel &p, KronVector &d) const;
+  static void storePanel(Panel *p, GeneralMatrix *y, int row, const KronVector &v);
+  /* a range of diagonal blocks of F whose slices of d do not depend on
+     the other slices, it is solved by solviRange */
+  struct Slices
+  {
+    const const_diag_iter begin;
+    const const_diag_iter end;
+    const int size;
+    double eig_min;
+    Slices(const_diag_iter b, const_diag_iter e, int s)
+      : begin(b), end(e), size(s), eig_min(1e30)
+    {
+    }
+  };
+  struct SlicesQueue;
+  /* moves di to the end of the smallest range of blocks starting at di
+     whose rows of F have no nonzeros after the range, returns the
+     number of rows of the range */
+  int findIndependent(const_diag_iter &di) const;
+  /* solvi(1., d, eig_min) with the independent slices solved in
+     parallel by num_threads threads */
+  void solviParallel(int num_threads, KronVector &d, double &eig_min) const;
+  static void *solviWorker(void *queue);
+  static void *solviThread(void *queue);
   /* called from solvi */
   void solviRealAndEliminate(double r, const_diag_iter di,
-                             KronVector &d, double &eig_min) const;
+                             KronVector &d, double &eig_min,
+                             Panel *p = NULL) const;
   void solviComplexAndEliminate(double r, const_diag_iter di,
-                                KronVector &d, double &eig_min) const;
+                                KronVector &d, double &eig_min,
+                                Panel *p = NULL) const;
   /* called from solviip */
   void solviipRealAndEliminate(double alpha, double betas,
                                const_diag_iter di, const_diag_iter dsi,
-                               KronVector &d, double &eig_min) const;
+                               KronVector &d, double &eig_min,
+                               Panel *p = NULL) const;
   void solviipComplexAndEliminate(double alpha, double betas,
                                   const_diag_iter di, const_diag_iter dsi,
-                                  KronVector &d, double &eig_min) const;
-  /* eliminations */
+                                  KronVector &d, double &eig_min,
+                                  Panel *p = NULL) const;
+  /* eliminations, only to the columns before colend */
   void solviEliminateReal(const_diag_iter di, KronVector &d,
-                          const KronVector &y, double divisor) const;
+                          const KronVector &y, double divisor,
+                          int colend) const;
   void solviEliminateComplex(const_diag_iter di, KronVector &d,
                              const KronVector &y1, const KronVector &y2,
-                             double divisor) const;
+                             double divisor, int colend) const;
   void solviipEliminateReal(const_diag_iter di, const_diag_iter dsi,
                             KronVector &d,
                             const KronVector &y1, const KronVector &y2,
-                            double divisor, double divisor2) const;
+                            double divisor, double divisor2, int colend) const;
   void solviipEliminateComplex(const_diag_iter di, const_diag_iter dsi,
                                KronVector &d,
                                const KronVector &y1, const KronVector &y11,
                                const KronVector &y2, const KronVector &y22,
-                               double divisor) const;
+                               double divisor, int colend) const;
   /* Lemma 2 */
   void solviipComplex(double alpha, double betas, double gamma,
                       double delta1, double delta2,
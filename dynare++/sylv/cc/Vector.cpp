@@ -3,6 +3,7 @@
 #include "Vector.h"
 #include "GeneralMatrix.h"
 #include "SylvException.h"
+#include "SylvMemory.h"
 
 #include <dynblas.h>
 
@@ -17,14 +18,37 @@ using namespace std;
 
 ZeroPad zero_pad;
 
+double* Vector::allocData(SylvMemoryPool*& pool, int l)
+{
+	pool = SylvMemoryPool::current();
+	if (pool) {
+		void* res = pool->allocate(l*sizeof(double));
+		if (res)
+			return (double*)res;
+		pool = 0;
+	}
+	void* res = SylvScratchFile::allocate(l*sizeof(double));
+	if (res)
+		return (double*)res;
+	return new double[l];
+}
+
+void Vector::freeData(SylvMemoryPool* pool, double* d)
+{
+	if (pool)
+		pool->free(d);
+	else if (! SylvScratchFile::free(d))
+		delete [] d;
+}
+
 Vector::Vector(const Vector& v)
-	: len(v.length()), s(1), data(new double[len]), destroy(true)
+	: len(v.length()), s(1), data(allocData(pool, len)), destroy(true)
 {
 	copy(v.base(), v.skip());
 }
 
 Vector::Vector(const ConstVector& v)
-	: len(v.length()), s(1), data(new double[len]), destroy(true)
+	: len(v.length()), s(1), data(allocData(pool, len)), destroy(true)
 {
 	copy(v.base(), v.skip());
 }
@@ -72,14 +96,14 @@ void Vector::copy(const double* d, int inc)
 }
 
 Vector::Vector(Vector& v, int off, int l)
-	: len(l), s(v.skip()), data(v.base()+off*v.skip()), destroy(false)
+	: len(l), s(v.skip()), pool(0), data(v.base()+off*v.skip()), destroy(false)
 {
 	if (off < 0 || off + length() > v.length())
 		throw SYLV_MES_EXCEPTION("Subvector not contained in supvector.");
 }
 
 Vector::Vector(const Vector& v, int off, int l)
-	: len(l), s(1), data(new double[len]), destroy(true)
+	: len(l), s(1), data(allocData(pool, len)), destroy(true)
 {
 	if (off < 0 || off + length() > v.length())
 		throw SYLV_MES_EXCEPTION("Subvector not contained in supvector.");
@@ -87,12 +111,12 @@ Vector::Vector(const Vector& v, int off, int l)
 }
 
 Vector::Vector(GeneralMatrix& m, int col)
-	: len(m.numRows()), s(1), data(&(m.get(0, col))), destroy(false)
+	: len(m.numRows()), s(1), pool(0), data(&(m.get(0, col))), destroy(false)
 {
 }
 
 Vector::Vector(int row, GeneralMatrix& m)
-	: len(m.numCols()), s(m.getLD()), data(&(m.get(row, 0))), destroy(false)
+	: len(m.numCols()), s(m.getLD()), pool(0), data(&(m.get(row, 0))), destroy(false)
 {
 }
 
@@ -156,7 +180,7 @@ void Vector::infs()
 Vector::~Vector()
 {
 	if (destroy) {
-		delete [] data;
+		freeData(pool, data);
 	}
 }
 
@@ -13,37 +13,39 @@
 
 class GeneralMatrix;
 class ConstVector;
+class SylvMemoryPool;
 
 class Vector
 {
 protected:
   int len;
   int s;
+  SylvMemoryPool *pool; // arena of the data, or 0 if allocated by new
   double *data;
   bool destroy;
 public:
-  Vector() : len(0), s(1), data(0), destroy(false)
+  Vector() : len(0), s(1), pool(0), data(0), destroy(false)
   {
   }
-  Vector(int l) : len(l), s(1), data(new double[l]), destroy(true)
+  Vector(int l) : len(l), s(1), data(allocData(pool, l)), destroy(true)
   {
   }
-  Vector(Vector &v) : len(v.length()), s(v.skip()), data(v.base()), destroy(false)
+  Vector(Vector &v) : len(v.length()), s(v.skip()), pool(0), data(v.base()), destroy(false)
   {
   }
   Vector(const Vector &v);
   Vector(const ConstVector &v);
   Vector(const double *d, int l)
-    : len(l), s(1), data(new double[len]), destroy(true)
+    : len(l), s(1), data(allocData(pool, l)), destroy(true)
   {
     copy(d, 1);
   }
   Vector(double *d, int l)
-    : len(l), s(1), data(d), destroy(false)
+    : len(l), s(1), pool(0), data(d), destroy(false)
   {
   }
   Vector(double *d, int skip, int l)
-    : len(l), s(skip), data(d), destroy(false)
+    : len(l), s(skip), pool(0), data(d), destroy(false)
   {
   }
   Vector(Vector &v, int off, int l);
@@ -136,6 +138,10 @@ public:
   }
 private:
   void copy(const double *d, int inc);
+  /* allocates the data from the current arena if it has space, and
+     from the heap otherwise, pool is set to the arena used */
+  static double *allocData(SylvMemoryPool * &pool, int l);
+  static void freeData(SylvMemoryPool *pool, double *d);
   const Vector &operator=(int); // must not be used (not implemented)
   const Vector &operator=(double); // must not be used (not implemented)
 };
@@ -26,6 +26,7 @@
 %       convergence_tol = convergence tolerance for iter. method
 %       max_num_iter    = max number of steps for iter. method
 %       bs_norm    = Bavely Stewart log10 norm for diagonalization
+%       num_threads = number of threads solving independent slices
 %       converged  = convergence status for iterative method
 %       iter_last_norm  = residual norm of the last step of iterations
 %       num_iter   = number of iterations performed
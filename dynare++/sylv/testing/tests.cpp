@@ -21,6 +21,7 @@
 #include <cstdio>
 #include <cstring>
 #include <ctime>
+#include <sys/time.h>
 
 #include <cmath>
 
@@ -50,8 +51,17 @@ protected:
 						 double delta1, double delta2);
 	static bool tri_sylv(const char* m1name, const char* m2name, const char* vname,
 						 int m, int n, int depth);
+	static bool tri_sylv_blocked(const char* m1name, const char* m2name, const char* vname,
+								 int m, int n, int depth);
+	static bool tri_sylv_arena(const char* m1name, const char* m2name, const char* vname,
+							   int m, int n, int depth);
 	static bool gen_sylv(const char* aname, const char* bname, const char* cname,
 						 const char* dname, int m, int n, int order);
+	static bool gen_sylv_threads(const char* aname, const char* bname, const char* cname,
+								 const char* dname, int m, int n, int order,
+								 int num_threads);
+	static bool gen_sylv_decomp(const char* aname, const char* bname, const char* cname,
+								const char* dname, int m, int n, int order);
 	static bool eig_bubble(const char* aname, int from, int to);
 	static bool block_diag(const char* aname, double log10norm = 3.0);
 	static bool iter_sylv(const char* m1name, const char* m2name, const char* vname,
@@ -347,6 +357,106 @@ bool TestRunnable::tri_sylv(const char* m1name, const char* m2name, const char*
 	return (norm < xnorm*eps_norm);
 }
 
+bool TestRunnable::tri_sylv_blocked(const char* m1name, const char* m2name, const char* vname,
+									int m, int n, int depth)
+{
+	MMMatrixIn mmt1(m1name);
+	MMMatrixIn mmt2(m2name);
+	MMMatrixIn mmv(vname);
+
+	int length = power(m,depth)*n;
+	if (mmt1.row() != m ||
+		mmt2.row() != n ||
+		mmv.row() != length) {
+		printf("  Incompatible sizes for triangular sylvester action, len=%d, row1=%d, row2=%d, m=%d, n=%d, vrow=%d\n",length,mmt1.row(), mmt2.row(), m, n, mmv.row());
+		return false;
+	}
+
+	SylvMemoryDriver memdriver(4, m, n, depth); // need extra 2 for checks done via KronUtils::multKron
+	memdriver.setStackMode(true);
+	QuasiTriangular t1(mmt1.getData(), mmt1.row());
+	QuasiTriangular t2(mmt2.getData(), mmt2.row());
+	TriangularSylvester ts(t2, t1);
+	Vector vraw(mmv.getData(), length);
+	ConstKronVector v(vraw, m, n, depth);
+	SylvParams pars;
+
+	// solve by the recursion only
+	int panel_size_save = TriangularSylvester::panel_size;
+	TriangularSylvester::panel_size = length;
+	KronVector drec(v);
+	clock_t start = clock();
+	ts.solve(pars, drec);
+	double rectime = ((double)(clock()-start))/CLOCKS_PER_SEC;
+	TriangularSylvester::panel_size = panel_size_save;
+
+	// solve with the blocked eliminations
+	KronVector d(v);
+	start = clock();
+	ts.solve(pars, d);
+	double blocktime = ((double)(clock()-start))/CLOCKS_PER_SEC;
+	printf("\tCPU time recursive = %8.4g\n\tCPU time blocked   = %8.4g\n",
+		   rectime, blocktime);
+
+	KronVector dcheck((const KronVector&)d);
+	KronUtils::multKron(t1, t2, dcheck);
+	dcheck.add(1.0, d);
+	dcheck.add(-1.0, v);
+	double norm = dcheck.getNorm();
+	double xnorm = v.getNorm();
+	printf("\trel. error norm = %8.4g\n",norm/xnorm);
+	drec.add(-1.0, d);
+	double dnorm = drec.getNorm();
+	printf("\trel. difference to recursive = %8.4g\n",dnorm/d.getNorm());
+	memdriver.setStackMode(false);
+	return (norm < xnorm*eps_norm && dnorm < d.getNorm()*eps_norm);
+}
+
+bool TestRunnable::tri_sylv_arena(const char* m1name, const char* m2name, const char* vname,
+								  int m, int n, int depth)
+{
+	MMMatrixIn mmt1(m1name);
+	MMMatrixIn mmt2(m2name);
+	MMMatrixIn mmv(vname);
+
+	int length = power(m,depth)*n;
+	if (mmt1.row() != m ||
+		mmt2.row() != n ||
+		mmv.row() != length) {
+		printf("  Incompatible sizes for triangular sylvester action, len=%d, row1=%d, row2=%d, m=%d, n=%d, vrow=%d\n",length,mmt1.row(), mmt2.row(), m, n, mmv.row());
+		return false;
+	}
+
+	SylvMemoryDriver memdriver(1, m, n, depth);
+	QuasiTriangular t1(mmt1.getData(), mmt1.row());
+	QuasiTriangular t2(mmt2.getData(), mmt2.row());
+	TriangularSylvester ts(t2, t1);
+	Vector vraw(mmv.getData(), length);
+	ConstKronVector v(vraw, m, n, depth);
+	SylvParams pars;
+
+	// solve with the temporaries allocated by new
+	KronVector dheap(v);
+	clock_t start = clock();
+	ts.solve(pars, dheap);
+	double heaptime = ((double)(clock()-start))/CLOCKS_PER_SEC;
+
+	// solve with the temporaries allocated from the arena
+	KronVector d(v);
+	memdriver.setStackMode(true);
+	start = clock();
+	ts.solve(pars, d);
+	double arenatime = ((double)(clock()-start))/CLOCKS_PER_SEC;
+	memdriver.setStackMode(false);
+	printf("\tCPU time with new   = %8.4g\n\tCPU time with arena = %8.4g\n",
+		   heaptime, arenatime);
+
+	dheap.add(-1.0, d);
+	double dnorm = dheap.getNorm();
+	printf("\tdifference to new = %8.4g\n",dnorm);
+	return (dnorm == 0.0);
+}
+
 bool TestRunnable::gen_sylv(const char* aname, const char* bname, const char* cname,
 							const char* dname, int m, int n, int order)
 {
@@ -377,6 +487,113 @@ bool TestRunnable::gen_sylv(const char* aname, const char* bname, const char* cn
 			*(pars.vec_errI) < eps_norm);
 }
 
+bool TestRunnable::gen_sylv_threads(const char* aname, const char* bname, const char* cname,
+									const char* dname, int m, int n, int order,
+									int num_threads)
+{
+	MMMatrixIn mma(aname);
+	MMMatrixIn mmb(bname);
+	MMMatrixIn mmc(cname);
+	MMMatrixIn mmd(dname);
+
+	if (m != mmc.row() || m != mmc.col() ||
+		n != mma.row() || n != mma.col() ||
+		n != mmb.row() || n <  mmb.col() ||
+		n != mmd.row() || power(m, order) != mmd.col()) {
+		printf("  Incompatible sizes for gen_sylv.\n");
+		return false;
+	}
+
+	SylvParams ps(true);
+	GeneralSylvester gs1(order, n, m, n-mmb.col(),
+						 mma.getData(), mmb.getData(),
+						 mmc.getData(), mmd.getData(),
+						 ps);
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	gs1.solve();
+	gettimeofday(&end, NULL);
+	double wtime1 = end.tv_sec-start.tv_sec + (end.tv_usec-start.tv_usec)*1.0e-6;
+	ps.num_threads = num_threads;
+	GeneralSylvester gs(order, n, m, n-mmb.col(),
+						mma.getData(), mmb.getData(),
+						mmc.getData(), mmd.getData(),
+						ps);
+	gettimeofday(&start, NULL);
+	gs.solve();
+	gettimeofday(&end, NULL);
+	double wtime = end.tv_sec-start.tv_sec + (end.tv_usec-start.tv_usec)*1.0e-6;
+	gs.check(mmd.getData());
+	const SylvParams& pars = gs.getParams();
+	pars.print("\t");
+	printf("\twall time with 1 thread      = %8.4g\n", wtime1);
+	printf("\twall time with %d threads     = %8.4g\n", num_threads, wtime);
+
+	ConstVector x1(gs1.getResult(), n*power(m, order));
+	Vector diff(gs.getResult(), n*power(m, order));
+	diff.add(-1.0, x1);
+	double dnorm = diff.getNorm()/x1.getNorm();
+	printf("\trel. difference to 1 thread = %8.4g\n", dnorm);
+	return (*(pars.mat_err1) < eps_norm && *(pars.mat_errI) < eps_norm &&
+			*(pars.mat_errF) < eps_norm && *(pars.vec_err1) < eps_norm &&
+			*(pars.vec_errI) < eps_norm && dnorm < eps_norm);
+}
+
+bool TestRunnable::gen_sylv_decomp(const char* aname, const char* bname, const char* cname,
+								   const char* dname, int m, int n, int order)
+{
+	MMMatrixIn mma(aname);
+	MMMatrixIn mmb(bname);
+	MMMatrixIn mmc(cname);
+	MMMatrixIn mmd(dname);
+
+	if (m != mmc.row() || m != mmc.col() ||
+		n != mma.row() || n != mma.col() ||
+		n != mmb.row() || n <  mmb.col() ||
+		n != mmd.row() || power(m, order) != mmd.col()) {
+		printf("  Incompatible sizes for gen_sylv.\n");
+		return false;
+	}
+
+	SylvParams ps(true);
+	GeneralSylvester gs1(order, n, m, n-mmb.col(),
+						 mma.getData(), mmb.getData(),
+						 mmc.getData(), mmd.getData(),
+						 ps);
+	gs1.solve();
+
+	GeneralSylvesterDecomp dec(n, m, n-mmb.col(),
+							   mma.getData(), mmb.getData(),
+							   mmc.getData(), ps);
+	if (!dec.isFor(n, m, n-mmb.col(), mma.getData(), mmb.getData(),
+				   mmc.getData(), ps)) {
+		printf("  Decompositions not recognized.\n");
+		return false;
+	}
+	// lower orders share the decompositions, take the leading columns of d
+	bool res = true;
+	for (int ord = 1; ord <= order; ord++) {
+		GeneralSylvester gs(ord, dec, mmd.getData(), ps);
+		gs.solve();
+		gs.check(mmd.getData());
+		const SylvParams& pars = gs.getParams();
+		printf("\torder %d:\n", ord);
+		pars.print("\t");
+		res = res && *(pars.mat_err1) < eps_norm && *(pars.mat_errI) < eps_norm &&
+			*(pars.mat_errF) < eps_norm && *(pars.vec_err1) < eps_norm &&
+			*(pars.vec_errI) < eps_norm;
+		if (ord == order) {
+			ConstVector x1(gs1.getResult(), n*power(m, order));
+			Vector diff(gs.getResult(), n*power(m, order));
+			diff.add(-1.0, x1);
+			double dnorm = diff.getNorm();
+			printf("\tdifference to own decompositions = %8.4g\n", dnorm);
+			res = res && dnorm == 0.0;
+		}
+	}
+	return res;
+}
+
 bool TestRunnable::eig_bubble(const char* aname, int from, int to)
 {
 	MMMatrixIn mma(aname);
@@ -656,6 +873,24 @@ public:
 	bool run() const;
 };
 
+class TriSylvBlockedBigTest : public TestRunnable {
+public:
+	TriSylvBlockedBigTest() : TestRunnable("triangular sylvester blocked big solve (48000=40x40x30)") {}
+	bool run() const;
+};
+
+class TriSylvBlockedLargeTest : public TestRunnable {
+public:
+	TriSylvBlockedLargeTest() : TestRunnable("triangular sylvester blocked large solve (1920000=40x40x40x30)") {}
+	bool run() const;
+};
+
+class TriSylvArenaTest : public TestRunnable {
+public:
+	TriSylvArenaTest() : TestRunnable("triangular sylvester arena allocation (1920000=40x40x40x30)") {}
+	bool run() const;
+};
+
 class IterSylvTest : public TestRunnable {
 public:
 	IterSylvTest() : TestRunnable("iterative sylvester solve (245=7x7x5)") {}
@@ -692,6 +927,18 @@ public:
 	bool run() const;
 };
 
+class GenSylvThreadsTest : public TestRunnable {
+public:
+	GenSylvThreadsTest() : TestRunnable("general sylvester solve by 4 threads (2500000=50x50x50x20)") {}
+	bool run() const;
+};
+
+class GenSylvDecompTest : public TestRunnable {
+public:
+	GenSylvDecompTest() : TestRunnable("general sylvester with shared decompositions (12000=20x20x30)") {}
+	bool run() const;
+};
+
 class EigBubFrankTest : public TestRunnable {
 public:
 	EigBubFrankTest() : TestRunnable("eig. bubble frank test (12x12)") {}
@@ -879,6 +1126,21 @@ bool TriSylvLargeTest::run() const
 	return tri_sylv("qt40x40.mm", "qt30x30eig011-095.mm", "v1920000.mm", 40, 30, 3);
 }
 
+bool TriSylvArenaTest::run() const
+{
+	return tri_sylv_arena("qt40x40.mm", "qt30x30eig011-095.mm", "v1920000.mm", 40, 30, 3);
+}
+
+bool TriSylvBlockedBigTest::run() const
+{
+	return tri_sylv_blocked("qt40x40.mm", "qt30x30eig011-095.mm", "v48000.mm", 40, 30, 2);
+}
+
+bool TriSylvBlockedLargeTest::run() const
+{
+	return tri_sylv_blocked("qt40x40.mm", "qt30x30eig011-095.mm", "v1920000.mm", 40, 30, 3);
+}
+
 bool IterSylvTest::run() const
 {
 	return iter_sylv("qt7x7eig06-09.mm", "qt5x5.mm", "v245r.mm", 7, 5, 2);
@@ -909,6 +1171,16 @@ bool GenSylvLargeTest::run() const
 	return gen_sylv("a20x20.mm", "b20x15.mm", "c50x50.mm", "d20x125000.mm", 50, 20, 3);
 }
 
+bool GenSylvThreadsTest::run() const
+{
+	return gen_sylv_threads("a20x20.mm", "b20x15.mm", "c50x50.mm", "d20x125000.mm", 50, 20, 3, 4);
+}
+
+bool GenSylvDecompTest::run() const
+{
+	return gen_sylv_decomp("a30x30.mm", "b30x25.mm", "c20x20.mm", "d30x400.mm", 20, 30, 2);
+}
+
 bool EigBubFrankTest::run() const
 {
 	return eig_bubble("qt_frank12x12.mm", 8, 0);
@@ -987,12 +1259,17 @@ int main()
 	all_tests[num_tests++] = new TriSylvTest();
 	all_tests[num_tests++] = new TriSylvBigTest();
 	all_tests[num_tests++] = new TriSylvLargeTest();
+	all_tests[num_tests++] = new TriSylvBlockedBigTest();
+	all_tests[num_tests++] = new TriSylvBlockedLargeTest();
+	all_tests[num_tests++] = new TriSylvArenaTest();
 	all_tests[num_tests++] = new IterSylvTest();
 	all_tests[num_tests++] = new IterSylvLargeTest();
 	all_tests[num_tests++] = new GenSylvSmallTest();
 	all_tests[num_tests++] = new GenSylvTest();
 	all_tests[num_tests++] = new GenSylvSingTest();
 	all_tests[num_tests++] = new GenSylvLargeTest();
+	all_tests[num_tests++] = new GenSylvThreadsTest();
+	all_tests[num_tests++] = new GenSylvDecompTest();
 
 	// launch the tests
 	int success = 0;
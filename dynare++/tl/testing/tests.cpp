@@ -12,10 +12,12 @@
 #include "rfs_tensor.h"
 #include "ps_tensor.h"
 #include "tl_static.h"
+#include "kron_prod.h"
 
 #include <cstdio>
 #include <cstring>
 #include <ctime>
+#include <algorithm>
 
 
 class TestRunnable {
@@ -63,6 +65,7 @@ protected:
 	static bool dense_prod(const Symmetry& bsym, const IntSequence& bnvs,
 						   int hdim, int hnv, int rows);
 
+	static bool kron_prod(int rows, const IntSequence& rs, const IntSequence& cs, int unit);
 	static bool folded_monomial(int ng, int nx, int ny, int nu, int dim);
 
 	static bool unfolded_monomial(int ng, int nx, int ny, int nu, int dim);
@@ -70,14 +73,19 @@ protected:
 	static bool fold_zcont(int nf, int ny, int nu, int nup, int nbigg,
 						   int ng, int dim);
 
+	static bool dense_zcont(int nf, int ny, int nu, int nup, int nbigg,
+							int ng, int dim);
 	static bool unfold_zcont(int nf, int ny, int nu, int nup, int nbigg,
 							 int ng, int dim);
+	static bool frozen_sparse(int nf, int ny, int nu, int nup, int nbigg,
+							  int ng, int dim);
 
 	static bool folded_contraction(int r, int nv, int dim);
 
 	static bool unfolded_contraction(int r, int nv, int dim);
 
 	static bool poly_eval(int r, int nv, int maxdim);
+	static bool poly_eval_batch(int r, int nv, int maxdim, int npoints);
 
 
 };
@@ -242,6 +250,76 @@ bool TestRunnable::dense_prod(const Symmetry& bsym, const IntSequence& bnvs,
 	return norm < 1.e-13;
 }
 
+/* Here we multiply by $A_1\otimes\ldots\otimes A_n$ with $A_{unit}$
+ * being identity, and compare with the multiplication by the explicitly
+ * constructed Kronecker product. Both the input and the output matrices
+ * have the leading dimension greater than the number of rows. */
+bool TestRunnable::kron_prod(int rows, const IntSequence& rs, const IntSequence& cs, int unit)
+{
+	Factory f;
+	int dim = rs.size();
+	KronProdAll kp(dim);
+	TwoDMatrix** mats = new TwoDMatrix*[dim];
+	for (int i = 0; i < dim; i++) {
+		mats[i] = new TwoDMatrix(rs[i], cs[i]);
+		if (i == unit) {
+			mats[i]->zeros();
+			for (int j = 0; j < rs[i]; j++)
+				mats[i]->get(j, j) = 1.0;
+			kp.setUnit(i, rs[i]);
+		} else {
+			for (int j = 0; j < rs[i]*cs[i]; j++)
+				mats[i]->getData()[j] = f.get();
+			kp.setMat(i, *(mats[i]));
+		}
+	}
+
+	TwoDMatrix kron(rs.mult(), cs.mult());
+	IntSequence ir(dim);
+	IntSequence ic(dim);
+	for (int r = 0; r < kron.nrows(); r++)
+		for (int c = 0; c < kron.ncols(); c++) {
+			int rr = r;
+			int cc = c;
+			double x = 1.0;
+			for (int i = dim-1; i >= 0; i--) {
+				x *= mats[i]->get(rr % rs[i], cc % cs[i]);
+				rr /= rs[i];
+				cc /= cs[i];
+			}
+			kron.get(r, c) = x;
+		}
+
+	TwoDMatrix inbig(rows+3, kron.nrows());
+	for (int j = 0; j < inbig.nrows()*inbig.ncols(); j++)
+		inbig.getData()[j] = f.get();
+	ConstTwoDMatrix in(ConstTwoDMatrix(inbig), 1, 0, rows, kron.nrows());
+	TwoDMatrix outbig(rows+2, kron.ncols());
+	TwoDMatrix out(outbig, 2, 0, rows, kron.ncols());
+
+	clock_t s1 = clock();
+	kp.mult(in, out);
+	clock_t s2 = clock();
+	TwoDMatrix outref(rows, kron.ncols());
+	outref.mult(in, ConstTwoDMatrix(kron));
+	clock_t s3 = clock();
+
+	outref.add(-1.0, out);
+	double norm = outref.getData().getMax();
+
+	printf("\ttime for Kronecker product:  %8.4g\n",
+		   ((double)(s2-s1))/CLOCKS_PER_SEC);
+	printf("\ttime for explicit product:   %8.4g\n",
+		   ((double)(s3-s2))/CLOCKS_PER_SEC);
+	printf("\tdifference normMax:          %10.6g\n", norm);
+
+	for (int i = 0; i < dim; i++)
+		delete mats[i];
+	delete [] mats;
+
+	return norm < 1.e-12;
+}
+
 bool TestRunnable::folded_monomial(int ng, int nx, int ny, int nu, int dim)
 {
 	clock_t gen_time = clock();
@@ -355,6 +433,71 @@ bool TestRunnable::fold_zcont(int nf, int ny, int nu, int nup, int nbigg,
 	return maxnorm < 1.0e-10;
 }
 
+/* Here we multiply a dense container of derivatives wrt. the stacks
+ * of the Z container, and compare the folded result with the unfolded
+ * one. The derivatives wrt. $u'$ are not in the container, so that some
+ * symmetries are skipped. */
+bool TestRunnable::dense_zcont(int nf, int ny, int nu, int nup, int nbigg,
+							   int ng, int dim)
+{
+	SparseDerivGenerator dg(nf, ny, nu, nup, nbigg, ng,
+							5, 0.55, dim);
+	Factory f;
+	IntSequence stack_sizes(4);
+	stack_sizes[0] = nbigg; stack_sizes[1] = ng;
+	stack_sizes[2] = ny; stack_sizes[3] = nu;
+	FGSContainer hcont(4);
+	for (int d = 1; d <= dim; d++) {
+		SymmetrySet ss(d, 4);
+		for (symiterator si(ss); !si.isEnd(); ++si)
+			if ((*si)[2] == 0 || (*si)[2] == d)
+				hcont.insert(f.make<FGSTensor>(nf, *si, stack_sizes));
+	}
+	UGSContainer uhcont(hcont);
+	UGSContainer uG_cont(*(dg.bigg));
+	UGSContainer ug_cont(*(dg.g));
+
+	IntSequence nvs(4);
+	nvs[0] = ny; nvs[1] = nu; nvs[2] = nup; nvs[3] = 1;
+	double maxnorm = 0.0;
+
+	FoldedZContainer zc(dg.bigg, nbigg, dg.g, ng, ny, nu);
+	UnfoldedZContainer uzc(&uG_cont, nbigg, &ug_cont, ng, ny, nu);
+
+	clock_t ftime = 0;
+	clock_t utime = 0;
+	for (int d = 2; d <= dim; d++) {
+		SymmetrySet ss(d, 4);
+		for (symiterator si(ss); !si.isEnd(); ++si) {
+			FGSTensor res(nf, TensorDimens(*si, nvs));
+			res.getData().zeros();
+			UGSTensor ures(nf, TensorDimens(*si, nvs));
+			ures.getData().zeros();
+			clock_t s1 = clock();
+			for (int l = 1; l <= (*si).dimen(); l++)
+				zc.multAndAdd(l, hcont, res);
+			clock_t s2 = clock();
+			for (int l = 1; l <= (*si).dimen(); l++)
+				uzc.multAndAdd(l, uhcont, ures);
+			clock_t s3 = clock();
+			ftime += s2-s1;
+			utime += s3-s2;
+			FGSTensor fold_ures(ures);
+			double scale = std::max(1.0, fold_ures.getData().getMax());
+			fold_ures.add(-1.0, res);
+			double normtmp = fold_ures.getData().getMax()/scale;
+			if (normtmp > maxnorm)
+				maxnorm = normtmp;
+		}
+	}
+	printf("\ttime for folded products:   %8.4g\n",
+		   ((double)ftime)/CLOCKS_PER_SEC);
+	printf("\ttime for unfolded products: %8.4g\n",
+		   ((double)utime)/CLOCKS_PER_SEC);
+	printf("\trelative difference normMax: %10.6g\n", maxnorm);
+	return maxnorm < 1.0e-13;
+}
+
 bool TestRunnable::unfold_zcont(int nf, int ny, int nu, int nup, int nbigg,
 								int ng, int dim)
 {
@@ -408,6 +551,50 @@ bool TestRunnable::unfold_zcont(int nf, int ny, int nu, int nup, int nbigg,
 	return maxnorm < 1.0e-10;
 }
 
+/* Here we multiply the sparse derivatives by a column before and after
+ * freezing them, both for a folded column (which goes through the frozen
+ * columns) and for its unfolded counterpart (which looks up each item). */
+bool TestRunnable::frozen_sparse(int nf, int ny, int nu, int nup, int nbigg,
+								 int ng, int dim)
+{
+	SparseDerivGenerator dg(nf, ny, nu, nup, nbigg, ng,
+							5, 0.55, dim);
+	Factory f;
+	double maxnorm = 0.0;
+	for (int d = 1; d <= dim; d++) {
+		FSSparseTensor t(*(dg.ts[d-1]));
+		FRSingleTensor col(t.nvar(), d);
+		for (int i = 0; i < col.nrows(); i++)
+			col.get(i, 0) = (i % 3 == 0) ? 0.0 : f.get();
+		UTensor& ucol = col.unfold();
+
+		Vector v(t.nrows());
+		Vector uv(t.nrows());
+		v.zeros();
+		uv.zeros();
+		t.multColumnAndAdd(col, v);
+		t.multColumnAndAdd(ucol, uv);
+
+		t.freeze();
+		Vector vf(t.nrows());
+		Vector uvf(t.nrows());
+		vf.zeros();
+		uvf.zeros();
+		t.multColumnAndAdd(col, vf);
+		t.multColumnAndAdd(ucol, uvf);
+		delete &ucol;
+
+		vf.add(-1.0, v);
+		uvf.add(-1.0, uv);
+		double normtmp = std::max(vf.getMax(), uvf.getMax());
+		printf("\tdim=%d, fill %3.2f %%, error normMax: %10.6g\n",
+			   d, 100*t.getFillFactor(), normtmp);
+		if (normtmp > maxnorm)
+			maxnorm = normtmp;
+	}
+	return maxnorm < 1.0e-10;
+}
+
 bool TestRunnable::folded_contraction(int r, int nv, int dim)
 {
 	Factory fact;
@@ -547,6 +734,54 @@ bool TestRunnable::poly_eval(int r, int nv, int maxdim)
 	return (max_ft+max_fh+max_uh < 1.0e-10);
 }
 
+bool TestRunnable::poly_eval_batch(int r, int nv, int maxdim, int npoints)
+{
+	Factory fact;
+	TwoDMatrix x(nv, npoints);
+	for (int j = 0; j < npoints; j++) {
+		Vector* xj = fact.makeVector(nv);
+		Vector col(x, j);
+		col = *xj;
+		delete xj;
+	}
+
+	FTensorPolynomial* fp = fact.makePoly<FFSTensor, FTensorPolynomial>(r, nv, maxdim);
+	UTensorPolynomial up(*fp);
+	TwoDMatrix out_fh(r, npoints);
+	TwoDMatrix out_fb(r, npoints);
+	TwoDMatrix out_ub(r, npoints);
+
+	clock_t fh_cl = clock();
+	for (int j = 0; j < npoints; j++) {
+		Vector outj(out_fh, j);
+		fp->evalHorner(outj, ConstVector(x, j));
+	}
+	fh_cl = clock() - fh_cl;
+	printf("\ttime for folded horner evals:  %8.4g\n",
+		   ((double)fh_cl)/CLOCKS_PER_SEC);
+
+	clock_t fb_cl = clock();
+	fp->evalBatch(out_fb, ConstTwoDMatrix(x));
+	fb_cl = clock() - fb_cl;
+	printf("\ttime for folded batch eval:    %8.4g\n",
+		   ((double)fb_cl)/CLOCKS_PER_SEC);
+
+	clock_t ub_cl = clock();
+	up.evalBatch(out_ub, ConstTwoDMatrix(x));
+	ub_cl = clock() - ub_cl;
+	printf("\ttime for unfolded batch eval:  %8.4g\n",
+		   ((double)ub_cl)/CLOCKS_PER_SEC);
+
+	out_fb.add(-1.0, out_fh);
+	double max_fb = out_fb.getData().getMax();
+	out_ub.add(-1.0, out_fh);
+	double max_ub = out_ub.getData().getMax();
+	printf("\tfolded batch error norm max:     %10.6g\n", max_fb);
+	printf("\tunfolded batch error norm max:   %10.6g\n", max_ub);
+
+	delete fp;
+	return (max_fb+max_ub < 1.0e-10);
+}
 
 /****************************************************/
 /*     definition of TestRunnable subclasses        */
@@ -794,6 +1029,30 @@ public:
 		}
 };
 
+class SmallKronProdTest : public TestRunnable {
+public:
+	SmallKronProdTest()
+		: TestRunnable("small kron prod rs=2-3-4,cs=3-2-5,unit=-1,r=3",3,4) {}
+	bool run() const
+		{
+			IntSequence rs(3); rs[0]=2; rs[1]=3; rs[2]=4;
+			IntSequence cs(3); cs[0]=3; cs[1]=2; cs[2]=5;
+			return kron_prod(3, rs, cs, -1);
+		}
+};
+
+class KronProdTest : public TestRunnable {
+public:
+	KronProdTest()
+		: TestRunnable("kron prod rs=5-3-4-6,cs=2-3-7-1,unit=1,r=10",4,7) {}
+	bool run() const
+		{
+			IntSequence rs(4); rs[0]=5; rs[1]=3; rs[2]=4; rs[3]=6;
+			IntSequence cs(4); cs[0]=2; cs[1]=3; cs[2]=7; cs[3]=1;
+			return kron_prod(10, rs, cs, 1);
+		}
+};
+
 class SmallFoldedMonomial : public TestRunnable {
 public:
 	SmallFoldedMonomial()
@@ -894,6 +1153,16 @@ public:
 		}
 };
 
+class PolyEvalBatch : public TestRunnable {
+public:
+	PolyEvalBatch()
+		: TestRunnable("batched polynomial evaluation (r=30, nv=12, maxdim=4, points=200)", 4, 12) {}
+	bool run() const
+		{
+			return poly_eval_batch(30, 12, 4, 200);
+		}
+};
+
 class FoldZContSmall : public TestRunnable {
 public:
 	FoldZContSmall()
@@ -916,6 +1185,39 @@ public:
 		}
 };
 
+class FrozenSparse : public TestRunnable {
+public:
+	FrozenSparse()
+		: TestRunnable("frozen sparse tensor (r=13,ny=5,nu=7,nup=4,G=6,g=7,dim=4)",
+					   4, 25) {}
+	bool run() const
+		{
+			return frozen_sparse(13, 5, 7, 4, 6, 7, 4);
+		}
+};
+
+class DenseZContSmall : public TestRunnable {
+public:
+	DenseZContSmall()
+		: TestRunnable("dense Z container (r=3,ny=2,nu=2,nup=1,G=2,g=2,dim=3)",
+					   3, 8) {}
+	bool run() const
+		{
+			return dense_zcont(3, 2, 2, 1, 2, 2, 3);
+		}
+};
+
+class DenseZCont : public TestRunnable {
+public:
+	DenseZCont()
+		: TestRunnable("dense Z container (r=13,ny=5,nu=7,nup=4,G=6,g=7,dim=4)",
+					   4, 25) {}
+	bool run() const
+		{
+			return dense_zcont(13, 5, 7, 4, 6, 7, 4);
+		}
+};
+
 class UnfoldZContSmall : public TestRunnable {
 public:
 	UnfoldZContSmall()
@@ -966,6 +1268,8 @@ int main()
 	all_tests[num_tests++] = new SmallDenseProd();
 	all_tests[num_tests++] = new DenseProd();
 	all_tests[num_tests++] = new BigDenseProd();
+	all_tests[num_tests++] = new SmallKronProdTest();
+	all_tests[num_tests++] = new KronProdTest();
 	all_tests[num_tests++] = new SmallFoldedMonomial();
 	all_tests[num_tests++] = new FoldedMonomial();
 	all_tests[num_tests++] = new SmallUnfoldedMonomial();
@@ -976,8 +1280,12 @@ int main()
 	all_tests[num_tests++] = new UnfoldedContractionBig();
 	all_tests[num_tests++] = new PolyEvalSmall();
 	all_tests[num_tests++] = new PolyEvalBig();
+	all_tests[num_tests++] = new PolyEvalBatch();
 	all_tests[num_tests++] = new FoldZContSmall();
 	all_tests[num_tests++] = new FoldZCont();
+	all_tests[num_tests++] = new FrozenSparse();
+	all_tests[num_tests++] = new DenseZContSmall();
+	all_tests[num_tests++] = new DenseZCont();
 	all_tests[num_tests++] = new UnfoldZContSmall();
 	all_tests[num_tests++] = new UnfoldZCont();
 
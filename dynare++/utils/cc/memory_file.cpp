@@ -5,6 +5,15 @@
 #include "memory_file.h"
 
 #include <cstdio>
+#include <climits>
+
+#if !defined(_WIN32) && !defined(__CYGWIN32__)
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
 
 using namespace ogu;
 
@@ -41,8 +50,30 @@ void ogu::calc_pos_line_and_col(int length, const char* str, int offset,
 }
 
 MemoryFile::MemoryFile(const char* fname)
-	: len(-1), data(NULL)
+	: len(-1), data(NULL), mapped(false)
 {
+#if !defined(_WIN32) && !defined(__CYGWIN32__)
+	// map the file if the ending '\0' falls to the zero filled rest
+	// of the last page, otherwise fall back to reading
+	int fdes = open(fname, O_RDONLY);
+	if (fdes >= 0) {
+		struct stat st;
+		long pagesize = sysconf(_SC_PAGESIZE);
+		if (fstat(fdes, &st) == 0 && S_ISREG(st.st_mode)
+			&& st.st_size > 0 && st.st_size < INT_MAX
+			&& pagesize > 0 && st.st_size % pagesize != 0) {
+			void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fdes, 0);
+			if (p != MAP_FAILED) {
+				data = (char*)p;
+				len = (int)st.st_size;
+				mapped = true;
+			}
+		}
+		close(fdes);
+		if (mapped)
+			return;
+	}
+#endif
 	FILE* fd = fopen(fname, "rb");
 	if (fd) {
 		// get the file size
@@ -50,13 +81,22 @@ MemoryFile::MemoryFile(const char* fname)
 		len = ftell(fd);
 		// allocate space for the file plus ending '\0' character
 		data = new char[len+1];
-		// read file and set data
+		// read file in one go and set data
 		fseek(fd, 0, SEEK_SET);
-		int i = 0;
-		int c;
-		while (EOF != (c = fgetc(fd)))
-			data[i++] = (unsigned char)c;
+		len = (int)fread(data, 1, len, fd);
 		data[len] = '\0';
 		fclose(fd);
 	}
 }
+
+MemoryFile::~MemoryFile()
+{
+#if !defined(_WIN32) && !defined(__CYGWIN32__)
+	if (mapped) {
+		munmap(data, len);
+		return;
+	}
+#endif
+	if (data)
+		delete [] data;
+}
@@ -22,19 +22,23 @@ namespace ogu
    * int, it can store files with size at most 4GB. If the file
    * could be opened for reading, data is NULL and length is -1. If
    * the file is empty but exists, len is zero and data points to a
-   * newly allocated memory containing '\0' character at the end. */
+   * newly allocated memory containing '\0' character at the end.
+   *
+   * On POSIX systems, the file is mapped to memory instead of being
+   * copied, if its size is not a multiple of the page size. Then the
+   * rest of the last page is filled with zeros, which provides the
+   * ending '\0' character. The mapping is read only and private, so
+   * the data are the same in both cases. */
   class MemoryFile
   {
   protected:
     int len;
     char *data;
+    /** True if data is mapped to the file. */
+    bool mapped;
   public:
     MemoryFile(const char *fname);
-    virtual ~MemoryFile()
-    {
-      if (data)
-        delete [] data;
-    }
+    virtual ~MemoryFile();
     int
     length() const
     {
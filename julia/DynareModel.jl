@@ -121,7 +121,9 @@ type Model
     params::Vector{Float64}
     static::Function
     static_params_derivs::Function
+    static_jacobian_pattern::Function
     dynamic::Function
+    dynamic_jacobian_pattern::Function
     dynamic_params_derivs::Function
     steady_state::Function
 end
@@ -170,7 +172,9 @@ function dynare_model()
                  Array(Float64, 0),     # params
                  function()end,         # static
                  function()end,         # static_params_derivs
+                 function()end,         # static_jacobian_pattern
                  function()end,         # dynamic
+                 function()end,         # dynamic_jacobian_pattern
                  function()end,         # dynamic_params_derivs
                  function()end          # steady_state
                 )
@@ -23,105 +23,105 @@ import DynareModel.Model
 import DynareOutput.Output
 import DynareOptions.Options
 
-export simulate_perfect_foresight_model!
+export simulate_perfect_foresight_model!, stacked_jacobian_pattern
+
+#=
+Builds the sparsity pattern of the Jacobian of the stacked perfect foresight problem, whose
+unknowns are the endogenous variables in periods 2 to periods+1, from the pattern g1 of the
+Jacobian of the dynamic model (as returned by model.dynamic_jacobian_pattern()).
+
+Returns the stacked matrix, with zero values, and a vector mapping the k-th nonzero element of
+g1 in period it (between 2 and periods+1) to element pos[(it-2)*nnz(g1)+k] of the nzval array
+of the stacked matrix, or to 0 if it does not appear in the stacked problem (derivatives with
+respect to the exogenous variables, to the initial or to the terminal conditions).
+=#
+function stacked_jacobian_pattern(g1::SparseMatrixCSC{Float64, Int}, lead_lag_incidence::Matrix{Int}, periods::Int)
+    ny = size(lead_lag_incidence, 2)
+    nnzg1 = length(g1.nzval)
+    n = periods*ny
+    colptr = zeros(Int, n+1)
+    rowval = Array(Int, 0)
+    pos = zeros(Int, periods*nnzg1)
+    colptr[1] = 1
+    for t = 1:periods
+        for i = 1:ny
+            # Variable i in period t appears with a lead in the equations of period t-1, at the
+            # current date in those of period t and with a lag in those of period t+1
+            for lag = 3:-1:1
+                p = t+2-lag
+                c = lead_lag_incidence[lag, i]
+                if p<1 || p>periods || c==0
+                    continue
+                end
+                for k = g1.colptr[c]:(g1.colptr[c+1]-1)
+                    push!(rowval, (p-1)*ny+g1.rowval[k])
+                    pos[(p-1)*nnzg1+k] = length(rowval)
+                end
+            end
+            colptr[(t-1)*ny+i+1] = length(rowval)+1
+        end
+    end
+    return SparseMatrixCSC(n, n, colptr, rowval, zeros(Float64, length(rowval))), pos
+end
 
 function simulate_perfect_foresight_model!(endogenousvariables::Matrix{Float64}, exogenousvariables::Matrix{Float64}, steadystate::Vector{Float64}, model::Model, options::Options)
 
     lead_lag_incidence = model.lead_lag_incidence
 
-    nyp = countnz(lead_lag_incidence[1,:])
-    ny0 = countnz(lead_lag_incidence[2,:])
-    nyf = countnz(lead_lag_incidence[3,:])
-
     ny = length(model.endo)
-    nd = nyp+ny0+nyf
-
     periods = options.pfmsolver.periods
     params = model.params
 
-    tmp = lead_lag_incidence[2:3,:]'
-    i_cols_A1 = find(tmp)
-    i_cols_1  = tmp[i_cols_A1]
-
-    tmp = lead_lag_incidence[1:2,:]'
-    i_cols_AT = find(tmp)
-    i_cols_T  = tmp[i_cols_AT]
-
-    tmp = lead_lag_incidence[2,:]'
-    i_cols_A0 = find(tmp)
-    i_cols_0  = tmp[i_cols_A0]
-
-    i_cols_j = collect(1:nd)
+    # Positions of the variables of the dynamic model in Y, for the first simulated period
+    i_cols = find(lead_lag_incidence')
+    nd = length(i_cols)
     i_upd = ny+collect(1:periods*ny)
 
     Y = vec(endogenousvariables)
-    z = Y[find(lead_lag_incidence')]
 
-    jacobian = zeros(Float64, ny, length(z)+length(model.exo))
+    # All the buffers are allocated once
+    y = zeros(Float64, nd)
     residuals = zeros(Float64, ny)
-
-    println("\nMODEL SIMULATION:\n")
-
+    jacobian = model.dynamic_jacobian_pattern()
+    A, pos = stacked_jacobian_pattern(jacobian, lead_lag_incidence, periods)
+    nnzjacobian = length(jacobian.nzval)
     rd = zeros(Float64, periods*ny)
 
-    iA = zeros(Int64, periods*model.nnzderivatives[1])
-    jA = zeros(Int64, periods*model.nnzderivatives[1])
-    vA = zeros(Float64, periods*model.nnzderivatives[1])
+    println("\nMODEL SIMULATION:\n")
 
     convergence = false
     iteration = 0
-    
+
     while !convergence
         iteration += 1
-        i_rows = collect(1:ny)
-        i_cols_A = find(lead_lag_incidence')
-        i_cols = i_cols_A
-        m = 0
         for it = 2:(periods+1)
-            model.dynamic(Y[i_cols], exogenousvariables, params, steadystate, it, residuals, jacobian)
-            if it==(periods+1) & it==2
-                (r, c, v) = findnz(jacobian[:,i_cols_0])
-                k = collect(1:length(v))+m
-                iA[k] = i_rows[r]
-                jA[k] = i_cols_A0[c]
-                vA[k] = v
-            elseif it==(periods+1)
-                (r, c, v) = findnz(jacobian[:,i_cols_T])
-                k = collect(1:length(v))+m
-                iA[k] = i_rows[r]
-                jA[k] = i_cols_A[i_cols_T[c]]
-                vA[k] = v
-            elseif it==2
-                (r, c, v) = findnz(jacobian[:,i_cols_1])
-                k = collect(1:length(v))+m
-                iA[k] = i_rows[r]
-                jA[k] = i_cols_A1[c]
-                vA[k] = v
-            else
-                (r, c, v) = findnz(jacobian[:,i_cols_j])
-                k = collect(1:length(v))+m
-                iA[k] = i_rows[r]
-                jA[k] = i_cols_A[c]
-                vA[k] = v
+            offset = (it-2)*ny
+            for j = 1:nd
+                @inbounds y[j] = Y[i_cols[j]+offset]
             end
-            m += length(v)
-            rd[i_rows] = residuals
-            i_rows += ny
-            i_cols += ny
-            if it>2
-                i_cols_A += ny
+            model.dynamic(y, exogenousvariables, params, steadystate, it, residuals, jacobian)
+            for i = 1:ny
+                @inbounds rd[offset+i] = residuals[i]
+            end
+            offset = (it-2)*nnzjacobian
+            for k = 1:nnzjacobian
+                @inbounds p = pos[offset+k]
+                if p>0
+                    @inbounds A.nzval[p] = jacobian.nzval[k]
+                end
             end
         end
-        err = maximum(abs(rd))
+        err = norm(rd, Inf)
         println("Iter. ", iteration, "\t err. ", round(err, 12))
         if err<options.pfmsolver.tolf
             iteration -= 1
             convergence = true
         end
-        A = sparse(iA[1:m], jA[1:m], vA[1:m])
-        dy = -A\rd
-        Y[i_upd] += dy
-        if maximum(abs(dy))<options.pfmsolver.tolx
+        dy = A\rd
+        for i = 1:length(i_upd)
+            @inbounds Y[i_upd[i]] -= dy[i]
+        end
+        if norm(dy, Inf)<options.pfmsolver.tolx
             convergence = true
         end
     end
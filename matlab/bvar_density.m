@@ -29,10 +29,28 @@ function bvar_density(maxnlags)
 % You should have received a copy of the GNU General Public License
 % along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
 
-global oo_
+global oo_ options_
 
 oo_.bvar.log_marginal_data_density=NaN(maxnlags,1);
 
+if exist('bvar_engine', 'file') == 3
+    % Native engine, computing the cross products of the data once for all the lag orders
+    dataset = read_variables(options_.datafile, options_.varobs, [], options_.xls_sheet, options_.xls_range);
+    options_ = set_default_option(options_, 'nobs', size(dataset,1)-options_.first_obs+1);
+    if options_.loglinear && ~options_.logdata
+        dataset = log(dataset);
+    end
+    [oo_.bvar.log_marginal_data_density, oo_.bvar.posterior, oo_.bvar.prior] = ...
+        bvar_engine('density', dataset, maxnlags, options_);
+    for nlags = 1:maxnlags
+        skipline()
+        fprintf('The marginal log density of the BVAR(%g) model is equal to %10.4f\n', ...
+                nlags, oo_.bvar.log_marginal_data_density(nlags));
+        skipline()
+    end
+    return
+end
+
 for nlags = 1:maxnlags
     [ny, nx, posterior, prior] = bvar_toolbox(nlags);
     oo_.bvar.posterior{nlags}=posterior;
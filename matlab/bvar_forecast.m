@@ -53,6 +53,13 @@ Companion_matrix = diag(ones(ny*(nlags-1),1),-ny);
 p = 0;
 % Loop counter initialization
 d = 0;
+if exist('bvar_engine', 'file') == 3
+    % Native engine, simulating the draws in parallel from a seed taken in the current random stream
+    [sims_no_shock, sims_with_shocks, p] = bvar_engine('forecast', posterior, forecast_data.initval, ...
+                                                       forecast_data.xdata, options_.bvar_replic, ...
+                                                       floor(rand()*2^31), options_);
+    d = options_.bvar_replic+1;
+end
 while d <= options_.bvar_replic
 
     Sigma = rand_inverse_wishart(ny, posterior.df, S_inv_upper_chol);
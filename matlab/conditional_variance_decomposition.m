@@ -12,6 +12,8 @@ function ConditionalVarianceDecomposition = conditional_variance_decomposition(S
 %                                                    n is equal to length(SubsetOfVariables)
 %                                                    h is the number of Steps
 %                                                    p is the number of state innovations and
+%                                                    ([n h p d] if the transition, impulse and covariance matrices
+%                                                    are given for d draws, stacked along their third dimension)
 % SPECIAL REQUIREMENTS
 %
 % [1] In this version, absence of measurement errors is assumed...
@@ -44,42 +46,27 @@ transition_matrix = StateSpaceModel.transition_matrix;
 number_of_state_equations = ...
     StateSpaceModel.number_of_state_equations;
 order_var = StateSpaceModel.order_var;
-nSteps = length(Steps);
+number_of_draws = size(transition_matrix,3);
 
-ConditionalVariance = zeros(number_of_state_equations,nSteps,number_of_state_innovations);
-
-if StateSpaceModel.sigma_e_is_diagonal
-    B = StateSpaceModel.impulse_matrix.* ...
-        repmat(sqrt(diag(StateSpaceModel.state_innovations_covariance_matrix)'),...
-               number_of_state_equations,1);
-else
-    B = StateSpaceModel.impulse_matrix*chol(StateSpaceModel.state_innovations_covariance_matrix)';
-end
-
-for i=1:number_of_state_innovations
-    BB = B(:,i)*B(:,i)';
-    V = zeros(number_of_state_equations,number_of_state_equations);
-    m = 1;
-    for h = 1:max(Steps)
-        V = transition_matrix*V*transition_matrix'+BB;
-        if h == Steps(m)
-            ConditionalVariance(order_var,m,i) = diag(V);
-            m = m+1;
-        end
+B = zeros(number_of_state_equations,number_of_state_innovations,number_of_draws);
+for d=1:number_of_draws
+    if StateSpaceModel.sigma_e_is_diagonal
+        B(:,:,d) = StateSpaceModel.impulse_matrix(:,:,d).* ...
+            repmat(sqrt(diag(StateSpaceModel.state_innovations_covariance_matrix(:,:,d))'),...
+                   number_of_state_equations,1);
+    else
+        B(:,:,d) = StateSpaceModel.impulse_matrix(:,:,d)*chol(StateSpaceModel.state_innovations_covariance_matrix(:,:,d))';
     end
 end
 
-ConditionalVariance = ConditionalVariance(SubsetOfVariables,:,:);
+inv_order_var(order_var) = 1:number_of_state_equations;
 
-NumberOfVariables = length(SubsetOfVariables);
-SumOfVariances = zeros(NumberOfVariables,nSteps);
-for h = 1:length(Steps)
-    SumOfVariances(:,h) = sum(ConditionalVariance(:,h,:),3);
+if isfield(StateSpaceModel,'number_of_threads')
+    number_of_threads = StateSpaceModel.number_of_threads;
+else
+    number_of_threads = 1;
 end
 
-ConditionalVarianceDecomposition = zeros(NumberOfVariables,length(Steps),number_of_state_innovations);
-for i=1:number_of_state_innovations
-    for h = 1:length(Steps)
-        ConditionalVarianceDecomposition(:,h,i) = squeeze(ConditionalVariance(:,h,i))./SumOfVariances(:,h);
-    end
-end
\ No newline at end of file
+ConditionalVarianceDecomposition = fast_conditional_variance_decomposition(transition_matrix,B,Steps, ...
+                                                                           inv_order_var(SubsetOfVariables), ...
+                                                                           number_of_threads);
@@ -0,0 +1,59 @@
+function [X, Gamma, info] = disclyap_autocovariances(G, V, tol, nar, fp_tol)
+
+% Solves the discrete Lyapunov equation X = G*X*G' + V with the doubling
+% algorithm, and computes the autocovariances G^k*X, k = 1..nar.
+%
+% INPUTS
+%   G         [double]    n*n matrix.
+%   V         [double]    n*n symmetric matrix.
+%   tol       [double]    tolerance of the doubling algorithm.
+%   nar       [integer]   number of autocovariances (0 if omitted).
+%   fp_tol    [double]    ignored (the MEX version uses it to warm-start
+%                         the solver with fixed point iterations).
+%
+% OUTPUTS
+%   X         [double]    n*n solution.
+%   Gamma     [double]    n*n*nar array, Gamma(:,:,k) = G^k*X.
+%   info      [integer]   0 on success, 1 if the solution is not finite.
+%
+% SPECIAL REQUIREMENTS
+%   This is the Matlab version of the MEX file of the same name.
+
+% Copyright (C) 2017 Dynare Team
+%
+% This file is part of Dynare.
+%
+% Dynare is free software: you can redistribute it and/or modify
+% it under the terms of the GNU General Public License as published by
+% the Free Software Foundation, either version 3 of the License, or
+% (at your option) any later version.
+%
+% Dynare is distributed in the hope that it will be useful,
+% but WITHOUT ANY WARRANTY; without even the implied warranty of
+% MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+% GNU General Public License for more details.
+%
+% You should have received a copy of the GNU General Public License
+% along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+
+if nargin < 4
+    nar = 0;
+end
+
+[X, info] = disclyap_fast(G, V, tol);
+if info || any(~isfinite(X(:)))
+    info = 1;
+    X = NaN(size(V));
+end
+
+n = length(V);
+Gamma = zeros(n, n, nar);
+for k = 1:nar
+    if info
+        Gamma(:,:,k) = NaN(n, n);
+    elseif k == 1
+        Gamma(:,:,k) = G*X;
+    else
+        Gamma(:,:,k) = G*Gamma(:,:,k-1);
+    end
+end
@@ -1,4 +1,4 @@
-function [H,G,retcode]=discretionary_policy_engine(AAlag,AA0,AAlead,BB,bigw,instr_id,beta,solve_maxit,discretion_tol,qz_criterium,H00,verbose)
+function [H,G,retcode]=discretionary_policy_engine(AAlag,AA0,AAlead,BB,bigw,instr_id,beta,solve_maxit,discretion_tol,qz_criterium,H00,verbose,anderson_depth)
 
 % Solves the discretionary problem for a model of the form:
 %
@@ -36,6 +36,9 @@ function [H,G,retcode]=discretionary_policy_engine(AAlag,AA0,AAlead,BB,bigw,inst
 %   qz_criterium        [scalar]    tolerance for QZ decomposition
 %   H00
 %   verbose             [scalar]    dummy to control verbosity
+%   anderson_depth      [scalar]    number of previous iterates combined with the
+%                                   current one by the discretionary_policy_fixed_point
+%                                   MEX (0 for the plain fixed point iteration)
 %
 % Outputs:
 %   H                   [double]    (endo_nbr*endo_nbr) solution matrix for endogenous
@@ -65,6 +68,9 @@ function [H,G,retcode]=discretionary_policy_engine(AAlag,AA0,AAlead,BB,bigw,inst
 % You should have received a copy of the GNU General Public License
 % along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
 
+if nargin<13
+    anderson_depth=0;
+end
 if nargin<12
     verbose=0;
     if nargin<11
@@ -105,36 +111,18 @@ end
 H10=H0(endo_augm_id,endo_augm_id);
 F10=H0(instr_id,endo_augm_id);
 
-iter=0;
-H1=H10;
-F1=F10;
 %solve equations (20) and (22) via fixed point iteration
-while 1
-    iter=iter+1;
-    P=SylvesterDoubling(W+beta*F1'*Q*F1,beta*H1',H1,discretion_tol,solve_maxit);
-    if any(any(isnan(P)))
-        P=SylvesterHessenbergSchur(W+beta*F1'*Q*F1,beta*H1',H1);
-        if any(any(isnan(P)))
-            retcode=2;
-            return
-        end
-    end
-    D=A0-A2*H1-A4*F1; %equation (20)
-    Dinv=inv(D);
-    A3DPD=A3'*Dinv'*P*Dinv;
-    F1=-(Q+A3DPD*A3)\(A3DPD*A1); %component of (26)
-    H1=Dinv*(A1+A3*F1); %component of (27)
-
-    [rcode,NQ]=CheckConvergence([H1;F1]-[H10;F10],iter,solve_maxit,discretion_tol);
-    if rcode
-        break
-    else
-        if verbose
-            disp(NQ)
-        end
+rcode=4;
+if exist('discretionary_policy_fixed_point','file') == 3
+    [H1,F1,H2,F2,rcode]=discretionary_policy_fixed_point(A0,A1,A2,A3,A4,A5,W,Q,beta,H10,F10,solve_maxit,discretion_tol,anderson_depth);
+end
+if rcode==4
+    % No MEX, or the doubling algorithm failed: use the Hessenberg-Schur solver
+    [H1,F1,H2,F2,rcode]=DennisFixedPoint(A0,A1,A2,A3,A4,A5,W,Q,beta,H10,F10,solve_maxit,discretion_tol,verbose);
+    if rcode==4
+        retcode=2;
+        return
     end
-    H10=H1;
-    F10=F1;
 end
 
 %check if successful
@@ -166,8 +154,6 @@ if retcode(1)
     H=[];
     G=[];
 else
-    F2=-(Q+A3DPD*A3)\(A3DPD*A5); %equation (29)
-    H2=Dinv*(A5+A3*F2); %equation (31)
     H=zeros(endo_nbr+AuxiliaryVariables_nbr);
     G=zeros(endo_nbr+AuxiliaryVariables_nbr,exo_nbr);
     H(endo_augm_id,endo_augm_id)=H1;
@@ -184,6 +170,49 @@ end
 end
 
 
+function [H1,F1,H2,F2,rcode]=DennisFixedPoint(A0,A1,A2,A3,A4,A5,W,Q,beta,H10,F10,solve_maxit,discretion_tol,verbose)
+% Fixed point iteration on equations (20) and (22), and shock coefficients
+% (29) and (31). rcode is that of CheckConvergence, or 4 if the Sylvester
+% equation could not be solved.
+
+iter=0;
+H1=H10;
+F1=F10;
+H2=[];
+F2=[];
+while 1
+    iter=iter+1;
+    P=SylvesterDoubling(W+beta*F1'*Q*F1,beta*H1',H1,discretion_tol,solve_maxit);
+    if any(any(isnan(P)))
+        P=SylvesterHessenbergSchur(W+beta*F1'*Q*F1,beta*H1',H1);
+        if any(any(isnan(P)))
+            rcode=4;
+            return
+        end
+    end
+    D=A0-A2*H1-A4*F1; %equation (20)
+    Dinv=inv(D);
+    A3DPD=A3'*Dinv'*P*Dinv;
+    F1=-(Q+A3DPD*A3)\(A3DPD*A1); %component of (26)
+    H1=Dinv*(A1+A3*F1); %component of (27)
+
+    [rcode,NQ]=CheckConvergence([H1;F1]-[H10;F10],iter,solve_maxit,discretion_tol);
+    if rcode
+        break
+    else
+        if verbose
+            disp(NQ)
+        end
+    end
+    H10=H1;
+    F10=F1;
+end
+
+F2=-(Q+A3DPD*A3)\(A3DPD*A5); %equation (29)
+H2=Dinv*(A5+A3*F2); %equation (31)
+
+end
+
 function [rcode,NQ]=CheckConvergence(Q,iter,MaxIter,crit)
 
 NQ=max(max(abs(Q)));% norm(Q); seems too costly
@@ -134,6 +134,9 @@ function [fval,info,exit_flag,DLIK,Hess,SteadyState,trend_coeff,Model,DynareOpti
 
 % AUTHOR(S) stephane DOT adjemian AT univ DASH lemans DOT FR
 
+% Solution of the Riccati equation at the previous evaluation (warm start of kalman_steady_state)
+persistent Pstar_riccati
+
 % Initialization of the returned variables and others...
 fval        = [];
 SteadyState = [];
@@ -147,9 +150,16 @@ Hess        = [];
 xparam1 = xparam1(:);
 
 if DynareOptions.estimation_dll
-    [fval,exit_flag,SteadyState,trend_coeff,info,params,H,Q] ...
-        = logposterior(xparam1,DynareDataset, DynareOptions,Model, ...
-                       EstimatedParameters,BayesInfo,DynareResults);
+    if DynareOptions.analytic_derivation && nargout > 3
+        % The DLL also returns the gradient of minus the log posterior
+        [fval,exit_flag,SteadyState,trend_coeff,info,params,H,Q,DLIK] ...
+            = logposterior(xparam1,DynareDataset, DynareOptions,Model, ...
+                           EstimatedParameters,BayesInfo,DynareResults);
+    else
+        [fval,exit_flag,SteadyState,trend_coeff,info,params,H,Q] ...
+            = logposterior(xparam1,DynareDataset, DynareOptions,Model, ...
+                           EstimatedParameters,BayesInfo,DynareResults);
+    end
     mexErrCheck('logposterior', exit_flag);
     Model.params = params;
     if ~isequal(Model.H,0)
@@ -455,7 +465,14 @@ switch DynareOptions.lik_init
     if kalman_algo ~= 2
         kalman_algo = 1;
     end
-    if isequal(H,0)
+    if isequal(size(Pstar_riccati),[mm mm])
+        % The parameters change only slightly between two evaluations, so the previous solution is a good initial condition.
+        if isequal(H,0)
+            [err,Pstar] = kalman_steady_state(transpose(T),R*Q*transpose(R),transpose(build_selection_matrix(Z,mm,length(Z))),[],Pstar_riccati);
+        else
+            [err,Pstar] = kalman_steady_state(transpose(T),R*Q*transpose(R),transpose(build_selection_matrix(Z,mm,length(Z))),H,Pstar_riccati);
+        end
+    elseif isequal(H,0)
         [err,Pstar] = kalman_steady_state(transpose(T),R*Q*transpose(R),transpose(build_selection_matrix(Z,mm,length(Z))));
     else
         [err,Pstar] = kalman_steady_state(transpose(T),R*Q*transpose(R),transpose(build_selection_matrix(Z,mm,length(Z))),H);
@@ -464,6 +481,8 @@ switch DynareOptions.lik_init
         disp(['dsge_likelihood:: I am not able to solve the Riccati equation, so I switch to lik_init=1!']);
         DynareOptions.lik_init = 1;
         Pstar=lyapunov_solver(T,R,Q,DynareOptions);
+    else
+        Pstar_riccati = Pstar;
     end
     Pinf  = [];
     a = zeros(mm,1);
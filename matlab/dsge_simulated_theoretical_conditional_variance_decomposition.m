@@ -97,6 +97,15 @@ StateSpaceModel.number_of_state_innovations = M_.exo_nbr;
 
 first_call = 1;
 
+% The draws are decomposed by batches, processed in parallel by the MEX file
+StateSpaceModel.number_of_threads = options_.threads.conditional_variance_decomposition;
+BatchSize = max(1,min(NumberOfConditionalDecompLines, ...
+                      floor(options_.MaxNumberOfBytes/(8*(M_.endo_nbr^2+M_.endo_nbr*M_.exo_nbr+M_.exo_nbr^2)))));
+BatchTransition = zeros(M_.endo_nbr,M_.endo_nbr,BatchSize);
+BatchImpulse = zeros(M_.endo_nbr,M_.exo_nbr,BatchSize);
+BatchCovariance = zeros(M_.exo_nbr,M_.exo_nbr,BatchSize);
+nbatch = 0;
+
 linea = 0;
 for file = 1:NumberOfDrawsFiles
     if posterior
@@ -128,10 +137,18 @@ for file = 1:NumberOfDrawsFiles
             first_call = 0;
             clear('endo_nbr','nstatic','nspred','k');
         end
-        [StateSpaceModel.transition_matrix,StateSpaceModel.impulse_matrix] = kalman_transition_matrix(dr,iv,ic,M_.exo_nbr);
-        StateSpaceModel.state_innovations_covariance_matrix = M_.Sigma_e;
+        nbatch = nbatch+1;
+        [BatchTransition(:,:,nbatch),BatchImpulse(:,:,nbatch)] = kalman_transition_matrix(dr,iv,ic,M_.exo_nbr);
+        BatchCovariance(:,:,nbatch) = M_.Sigma_e;
         clear('dr');
-        Conditional_decomposition_array(:,:,:,linea) = conditional_variance_decomposition(StateSpaceModel, Steps, ivar);
+        if nbatch == BatchSize || linea == NumberOfConditionalDecompLines || ...
+                (file == NumberOfDrawsFiles && linee == NumberOfDraws)
+            StateSpaceModel.transition_matrix = BatchTransition(:,:,1:nbatch);
+            StateSpaceModel.impulse_matrix = BatchImpulse(:,:,1:nbatch);
+            StateSpaceModel.state_innovations_covariance_matrix = BatchCovariance(:,:,1:nbatch);
+            Conditional_decomposition_array(:,:,:,linea-nbatch+1:linea) = conditional_variance_decomposition(StateSpaceModel, Steps, ivar);
+            nbatch = 0;
+        end
         if linea == NumberOfConditionalDecompLines
             ConditionalDecompFileNumber = ConditionalDecompFileNumber + 1;
             linea = 0;
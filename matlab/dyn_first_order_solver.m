@@ -162,6 +162,10 @@ dr.ghu = [];
 dr.state_var = state_var;
 
 jacobia = jacobia(:,reorder_jacobian_columns);
+if issparse(jacobia)
+    % The QR and QZ decompositions below work on dense blocks
+    jacobia = full(jacobia);
+end
 
 if nstatic > 0
     [Q, junk] = qr(jacobia(:,index_s));
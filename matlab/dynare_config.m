@@ -153,6 +153,33 @@ mex_status(4,3) = {'Sparse kronecker products'};
 mex_status(5,1) = {'local_state_space_iteration_2'};
 mex_status(5,2) = {'reduced_form_models/local_state_space_iteration_2'};
 mex_status(5,3) = {'Local state space iteration (second order)'};
+mex_status(6,1) = {'local_state_space_iteration_3'};
+mex_status(6,2) = {'reduced_form_models/local_state_space_iteration_3'};
+mex_status(6,3) = {'Local state space iteration (third order)'};
+mex_status(7,1) = {'particle_filter_step'};
+mex_status(7,2) = {'reduced_form_models/particle_filter_step'};
+mex_status(7,3) = {'Particle filter step'};
+mex_status(8,1) = {'cycle_reduction'};
+mex_status(8,2) = {'cycle_reduction'};
+mex_status(8,3) = {'Cycle reduction'};
+mex_status(9,1) = {'disclyap_autocovariances'};
+mex_status(9,2) = {'disclyap_autocovariances'};
+mex_status(9,3) = {'Lyapunov equation and autocovariances'};
+mex_status(10,1) = {'fast_shock_decomposition'};
+mex_status(10,2) = {'fast_shock_decomposition'};
+mex_status(10,3) = {'Shock decomposition'};
+mex_status(11,1) = {'identification_derivatives'};
+mex_status(11,2) = {'identification'};
+mex_status(11,3) = {'Identification derivatives'};
+mex_status(12,1) = {'identification_moments_derivatives'};
+mex_status(12,2) = {'identification'};
+mex_status(12,3) = {'Identification moments derivatives'};
+mex_status(13,1) = {'fast_conditional_variance_decomposition'};
+mex_status(13,2) = {'fast_conditional_variance_decomposition'};
+mex_status(13,3) = {'Conditional variance decomposition'};
+mex_status(14,1) = {'perfect_foresight_newton'};
+mex_status(14,2) = {'perfect_foresight_newton'};
+mex_status(14,3) = {'Perfect foresight Newton solver'};
 number_of_mex_files = size(mex_status,1);
 
 % Remove some directories from matlab's path. This is necessary if the user has
@@ -115,6 +115,17 @@ if options_.fast_kalman_filter
     end
 end
 
+% The square-root Kalman filter is only implemented in the estimation DLL
+if options_.sqrt_kalman_filter
+    if ~options_.estimation_dll
+        error(['estimation option conflict: sqrt_kalman_filter is only available ' ...
+               'with estimation_dll'])
+    elseif options_.fast_kalman_filter || options_.analytic_derivation
+        error(['estimation option conflict: sqrt_kalman_filter is not available ' ...
+               'with fast_kalman_filter or analytic_derivation'])
+    end
+end
+
 % Set options_.lik_init equal to 3 if diffuse filter is used or kalman_algo refers to a diffuse filter algorithm.
 if isequal(options_.diffuse_filter,1) || (options_.kalman_algo>2)
     if isequal(options_.lik_init,2)
@@ -0,0 +1,59 @@
+function profile = dynare_instrumentation(command, prefix)
+
+% Controls the run-time instrumentation of the MEX files (see
+% mex/sources/instrumentation.hh).
+%
+% INPUTS
+%   command   [string]  'on', 'off', 'reset', 'get' or 'dump'
+%   prefix    [string]  with 'dump', the trace of each MEX file is written in <prefix>_<mex file name>.json
+%
+% OUTPUTS
+%   profile   [struct]  with 'get', one field by instrumented MEX file, holding its timers and counters
+%
+% SPECIAL REQUIREMENTS
+%   Only the MEX files that are on the path are considered. Since each MEX
+%   file keeps its profile until it is cleared, 'clear mex' resets them all.
+
+% Copyright (C) 2017 Dynare Team
+%
+% This file is part of Dynare.
+%
+% Dynare is free software: you can redistribute it and/or modify
+% it under the terms of the GNU General Public License as published by
+% the Free Software Foundation, either version 3 of the License, or
+% (at your option) any later version.
+%
+% Dynare is distributed in the hope that it will be useful,
+% but WITHOUT ANY WARRANTY; without even the implied warranty of
+% MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+% GNU General Public License for more details.
+%
+% You should have received a copy of the GNU General Public License
+% along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+
+mexfiles = {'bytecode', 'k_order_perturbation', 'logposterior', 'logMHMCMCposterior', 'smc_posterior', ...
+            'kalman_smoother', 'osr_objective', 'posterior_irf_moments', 'first_order_solutions', 'particle_filter_likelihood', ...
+            'gsa_sample_evaluation', 'bvar_engine', 'conditional_forecast_engine', ...
+            'A_times_B_kronecker_C', 'sparse_hessian_times_B_kronecker_C', ...
+            'block_kalman_filter', 'local_state_space_iteration_2', ...
+            'local_state_space_iteration_3', 'particle_filter_step'};
+
+profile = struct();
+for i = 1:length(mexfiles)
+    if exist(mexfiles{i}) ~= 3
+        continue
+    end
+    switch command
+      case {'on', 'off', 'reset'}
+        feval(mexfiles{i}, 'instrumentation', command);
+      case 'get'
+        profile.(mexfiles{i}) = feval(mexfiles{i}, 'instrumentation', 'get');
+      case 'dump'
+        if nargin < 2
+            error('dynare_instrumentation: ''dump'' expects the prefix of the trace files')
+        end
+        feval(mexfiles{i}, 'instrumentation', 'dump', [prefix '_' mexfiles{i} '.json']);
+      otherwise
+        error('dynare_instrumentation: unknown command %s', command)
+    end
+end
@@ -58,6 +58,14 @@ elseif options.bytecode
             return
         end
     elseif options.block
+        % Native driver: the recursive blocks are evaluated and the simultaneous blocks
+        % solved by Newton iterations with the dense LU of their Jacobian. The blocks are
+        % solved one at a time in Matlab if it fails.
+        [check, x1] = bytecode('static', x, exo, params);
+        if ~check
+            x = x1;
+            return
+        end
         for b = 1:length(M.block_structure_stat.block)
             if M.block_structure_stat.block(b).Simulation_Type ~= 1 && ...
                     M.block_structure_stat.block(b).Simulation_Type ~= 2
@@ -0,0 +1,64 @@
+function [decomp, variance] = fast_conditional_variance_decomposition(T, B, Steps, rows, number_of_threads)
+
+% Computes the conditional variance decomposition of x(t) = T*x(t-1) + B*e(t),
+% var(e(t)) = I, for one or several draws.
+%
+% INPUTS
+%   T                   [double]    n*n*ndraws transition matrices.
+%   B                   [double]    n*nshocks*ndraws impulse matrices (times
+%                                   the Cholesky factor of the covariance
+%                                   matrix of the shocks).
+%   Steps               [integer]   horizons.
+%   rows                [integer]   rows of x(t) to be decomposed.
+%   number_of_threads   [integer]   ignored (used by the MEX version).
+%
+% OUTPUTS
+%   decomp              [double]    nrows*nsteps*nshocks*ndraws shares of the
+%                                   shocks in the conditional variances.
+%   variance            [double]    conditional variances, same layout.
+%
+% SPECIAL REQUIREMENTS
+%   This is the Matlab version of the MEX file of the same name.
+
+% Copyright (C) 2017 Dynare Team
+%
+% This file is part of Dynare.
+%
+% Dynare is free software: you can redistribute it and/or modify
+% it under the terms of the GNU General Public License as published by
+% the Free Software Foundation, either version 3 of the License, or
+% (at your option) any later version.
+%
+% Dynare is distributed in the hope that it will be useful,
+% but WITHOUT ANY WARRANTY; without even the implied warranty of
+% MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+% GNU General Public License for more details.
+%
+% You should have received a copy of the GNU General Public License
+% along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+
+n = size(T,1);
+nshocks = size(B,2);
+ndraws = size(T,3);
+nsteps = length(Steps);
+nrows = length(rows);
+
+variance = zeros(nrows,nsteps,nshocks,ndraws);
+[junk, order] = sort(Steps);
+for d=1:ndraws
+    X = B(:,:,d);
+    acc = zeros(nrows,nshocks);
+    s = 1;
+    h = 1;
+    while s <= nsteps
+        acc = acc + X(rows,:).^2;
+        while s <= nsteps && Steps(order(s)) == h
+            variance(:,order(s),:,d) = permute(acc,[1 3 2]);
+            s = s+1;
+        end
+        X = T(:,:,d)*X;
+        h = h+1;
+    end
+end
+
+decomp = variance./repmat(sum(variance,3),[1 1 nshocks 1]);
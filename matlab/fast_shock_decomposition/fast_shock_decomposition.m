@@ -0,0 +1,80 @@
+function [z, first] = fast_shock_decomposition(A, B, i_state, epsilon, smoothed, init_state, Af, z_prev, epsilon_prev)
+
+% Computes the shock decomposition of a first order model with
+% maximum_lag = 1, y(t) = A*y(t-1)(i_state) + B*epsilon(t).
+%
+% INPUTS
+%   A             [double]    endo_nbr*nstate matrix, ghx in declaration order.
+%   B             [double]    endo_nbr*nshocks matrix, ghu in declaration order.
+%   i_state       [integer]   nstate vector, rows of z matching the columns of A.
+%   epsilon       [double]    nshocks*T matrix of smoothed shocks (T >= gend,
+%                             the last T-gend periods being forecasts).
+%   smoothed      [double]    endo_nbr*gend matrix of smoothed variables in
+%                             deviation from the mean.
+%   init_state    [integer]   shocks contributions are added for t > init_state.
+%   Af            [double]    transition matrix used in the forecast periods
+%                             (A if omitted or empty).
+%   z_prev        [double]    decomposition of a previous vintage (optional).
+%   epsilon_prev  [double]    smoothed shocks of a previous vintage (optional).
+%
+% OUTPUTS
+%   z             [double]    endo_nbr*(nshocks+2)*T array: contributions of
+%                             the shocks, of the initial condition, and
+%                             smoothed variables.
+%   first         [integer]   first period which was not copied from z_prev.
+%
+% SPECIAL REQUIREMENTS
+%   This is the Matlab version of the MEX file of the same name.
+
+% Copyright (C) 2017 Dynare Team
+%
+% This file is part of Dynare.
+%
+% Dynare is free software: you can redistribute it and/or modify
+% it under the terms of the GNU General Public License as published by
+% the Free Software Foundation, either version 3 of the License, or
+% (at your option) any later version.
+%
+% Dynare is distributed in the hope that it will be useful,
+% but WITHOUT ANY WARRANTY; without even the implied warranty of
+% MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+% GNU General Public License for more details.
+%
+% You should have received a copy of the GNU General Public License
+% along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+
+if nargin < 7 || isempty(Af)
+    Af = A;
+end
+
+[endo_nbr, nshocks] = size(B);
+gend = size(smoothed,2);
+T = size(epsilon,2);
+
+z = zeros(endo_nbr,nshocks+2,T);
+z(:,end,1:gend) = smoothed;
+
+first = 1;
+if nargin > 8 && ~isempty(z_prev)
+    max_reuse = min([size(z_prev,3), size(epsilon_prev,2), gend]);
+    while first <= max_reuse && isequal(epsilon(:,first),epsilon_prev(:,first)) ...
+            && isequal(smoothed(:,first),z_prev(:,end,first))
+        first = first+1;
+    end
+    z(:,:,1:first-1) = z_prev(:,:,1:first-1);
+end
+
+for i=first:T
+    if i > 1
+        if i > gend
+            z(:,nshocks+2,i) = Af*z(i_state,nshocks+2,i-1);
+            z(:,1:nshocks,i) = Af*z(i_state,1:nshocks,i-1);
+        else
+            z(:,1:nshocks,i) = A*z(i_state,1:nshocks,i-1);
+        end
+    end
+    if i > init_state
+        z(:,1:nshocks,i) = z(:,1:nshocks,i) + B.*repmat(epsilon(:,i)',endo_nbr,1);
+    end
+    z(:,nshocks+1,i) = z(:,nshocks+2,i) - sum(z(:,1:nshocks,i),2);
+end
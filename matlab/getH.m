@@ -439,24 +439,11 @@ else % generalized sylvester equation
     inva = inv(a);
     b = -GAM1;
     c = A;
-    elem = zeros(m,m,param_nbr);
-    d = elem;
-    for j=1:param_nbr
-        elem(:,:,j) = (Dg0(:,:,j)-Dg1(:,:,j)*A);
-        d(:,:,j) = Dg2(:,:,j)-elem(:,:,j)*A;
-    end
-    xx=sylvester3(a,b,c,d);
-    flag=1;
-    icount=0;
-    while flag && icount<4
-        [xx, flag]=sylvester3a(xx,a,b,c,d);
-        icount=icount+1;
-    end
+    [xx, dB, yy] = identification_derivatives(GAM0,GAM1,A,B,M_.Sigma_e,Dg0,Dg1,Dg2,Dg3,options_.threads.identification_derivatives);
     H=zeros(m1*m1+m1*(m1+1)/2,param_nbr+length(indexo));
     if nargout>1
         dOm = zeros(m1,m1,param_nbr+length(indexo));
         dA=zeros(m1,m1,param_nbr+length(indexo));
-        dB=zeros(m,n,param_nbr);
     end
     if ~isempty(indexo)
         dSig = zeros(M_.exo_nbr,M_.exo_nbr,length(indexo));
@@ -474,11 +461,7 @@ else % generalized sylvester equation
     end
     for j=1:param_nbr
         x = xx(:,:,j);
-        y = inva * (Dg3(:,:,j)-(elem(:,:,j)-GAM1*x)*B);
-        if nargout>1
-            dB(:,:,j) = y;
-        end
-        y = y*M_.Sigma_e*B'+B*M_.Sigma_e*y';
+        y = yy(:,:,j);
         %         x = x(nauxe+1:end,nauxe+1:end);
         %         y = y(nauxe+1:end,nauxe+1:end);
         if nargout>1
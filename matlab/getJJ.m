@@ -115,57 +115,87 @@ else
     %     BB(:,:,j)= dA(:,:,j)*GAM*A'+A*GAM*dA(:,:,j)'+dOm(:,:,j);
     %   end
     %   XX =  lyapunov_symm_mr(A,BB,options_.qz_criterium,options_.lyapunov_complex_threshold,0);
-    for j=1:length(indexo)
-        dum =  lyapunov_symm(A,dOm(:,:,j),options_.lyapunov_fixed_point_tol,options_.qz_criterium,options_.lyapunov_complex_threshold,2,options_.debug);
-        %     dum =  XX(:,:,j);
-        k = find(abs(dum) < 1e-12);
-        dum(k) = 0;
-        if useautocorr
-            dsy = 1/2./sdy.*diag(dum);
-            dsy = dsy*sdy'+sdy*dsy';
-            dum1=dum;
-            dum1 = (dum1.*sy-dsy.*GAM)./(sy.*sy);
-            dum1 = dum1-diag(diag(dum1))+diag(diag(dum));
-            dumm = dyn_vech(dum1(mf,mf));
-        else
-            dumm = dyn_vech(dum(mf,mf));
-        end
-        for i=1:nlags
-            dum1 = A^i*dum;
+    nexo = length(indexo);
+    info = 1;
+    if size(dA,3) == nexo+length(indx)
+        [dGAM, info] = identification_moments_derivatives(A,GAM,dA,dOm,nlags,options_.threads.identification_derivatives);
+    end
+    if ~info
+        for j=1:nexo+length(indx)
+            dum = dGAM(:,:,1,j);
             if useautocorr
-                dum1 = (dum1.*sy-dsy.*(A^i*GAM))./(sy.*sy);
+                dsy = 1/2./sdy.*diag(dum);
+                dsy = dsy*sdy'+sdy*dsy';
+                dum1=dum;
+                dum1 = (dum1.*sy-dsy.*GAM)./(sy.*sy);
+                dum1 = dum1-diag(diag(dum1))+diag(diag(dum));
+                dumm = dyn_vech(dum1(mf,mf));
+            else
+                dumm = dyn_vech(dum(mf,mf));
             end
-            dumm = [dumm; vec(dum1(mf,mf))];
-        end
-        JJ(:,j) = dumm;
-    end
-    nexo = length(indexo);
-    for j=1:length(indx)
-        dum =  lyapunov_symm(A,dA(:,:,j+nexo)*GAM*A'+A*GAM*dA(:,:,j+nexo)'+dOm(:,:,j+nexo),options_.lyapunov_fixed_point_tol,options_.qz_criterium,options_.lyapunov_complex_threshold,2,options_.debug);
-        %     dum =  XX(:,:,j);
-        k = find(abs(dum) < 1e-12);
-        dum(k) = 0;
-        if useautocorr
-            dsy = 1/2./sdy.*diag(dum);
-            dsy = dsy*sdy'+sdy*dsy';
-            dum1=dum;
-            dum1 = (dum1.*sy-dsy.*GAM)./(sy.*sy);
-            dum1 = dum1-diag(diag(dum1))+diag(diag(dum));
-            dumm = dyn_vech(dum1(mf,mf));
-        else
-            dumm = dyn_vech(dum(mf,mf));
+            AiGAM = GAM;
+            for i=1:nlags
+                dum1 = dGAM(:,:,i+1,j);
+                AiGAM = A*AiGAM;
+                if useautocorr
+                    dum1 = (dum1.*sy-dsy.*AiGAM)./(sy.*sy);
+                end
+                dumm = [dumm; vec(dum1(mf,mf))];
+            end
+            JJ(:,j) = dumm;
         end
-        for i=1:nlags
-            dum1 = A^i*dum;
-            for ii=1:i
-                dum1 = dum1 + A^(ii-1)*dA(:,:,j+nexo)*A^(i-ii)*GAM;
+    else
+        for j=1:length(indexo)
+            dum =  lyapunov_symm(A,dOm(:,:,j),options_.lyapunov_fixed_point_tol,options_.qz_criterium,options_.lyapunov_complex_threshold,2,options_.debug);
+            %     dum =  XX(:,:,j);
+            k = find(abs(dum) < 1e-12);
+            dum(k) = 0;
+            if useautocorr
+                dsy = 1/2./sdy.*diag(dum);
+                dsy = dsy*sdy'+sdy*dsy';
+                dum1=dum;
+                dum1 = (dum1.*sy-dsy.*GAM)./(sy.*sy);
+                dum1 = dum1-diag(diag(dum1))+diag(diag(dum));
+                dumm = dyn_vech(dum1(mf,mf));
+            else
+                dumm = dyn_vech(dum(mf,mf));
             end
+            for i=1:nlags
+                dum1 = A^i*dum;
+                if useautocorr
+                    dum1 = (dum1.*sy-dsy.*(A^i*GAM))./(sy.*sy);
+                end
+                dumm = [dumm; vec(dum1(mf,mf))];
+            end
+            JJ(:,j) = dumm;
+        end
+        for j=1:length(indx)
+            dum =  lyapunov_symm(A,dA(:,:,j+nexo)*GAM*A'+A*GAM*dA(:,:,j+nexo)'+dOm(:,:,j+nexo),options_.lyapunov_fixed_point_tol,options_.qz_criterium,options_.lyapunov_complex_threshold,2,options_.debug);
+            %     dum =  XX(:,:,j);
+            k = find(abs(dum) < 1e-12);
+            dum(k) = 0;
             if useautocorr
-                dum1 = (dum1.*sy-dsy.*(A^i*GAM))./(sy.*sy);
+                dsy = 1/2./sdy.*diag(dum);
+                dsy = dsy*sdy'+sdy*dsy';
+                dum1=dum;
+                dum1 = (dum1.*sy-dsy.*GAM)./(sy.*sy);
+                dum1 = dum1-diag(diag(dum1))+diag(diag(dum));
+                dumm = dyn_vech(dum1(mf,mf));
+            else
+                dumm = dyn_vech(dum(mf,mf));
+            end
+            for i=1:nlags
+                dum1 = A^i*dum;
+                for ii=1:i
+                    dum1 = dum1 + A^(ii-1)*dA(:,:,j+nexo)*A^(i-ii)*GAM;
+                end
+                if useautocorr
+                    dum1 = (dum1.*sy-dsy.*(A^i*GAM))./(sy.*sy);
+                end
+                dumm = [dumm; vec(dum1(mf,mf))];
             end
-            dumm = [dumm; vec(dum1(mf,mf))];
+            JJ(:,j+nexo) = dumm;
         end
-        JJ(:,j+nexo) = dumm;
     end
 
     JJ = [ [zeros(length(mf),nexo) dYss(mf,:)]; JJ];
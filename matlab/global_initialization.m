@@ -61,9 +61,12 @@ options_.solve_tolx = eps^(2/3);
 options_.dr_display_tol=1e-6;
 options_.minimal_workspace = 0;
 options_.dp.maxit = 3000;
+options_.dp.anderson_depth = 0;
 options_.steady.maxit = 50;
 options_.simul.maxit = 50;
 options_.simul.robust_lin_solve = 0;
+options_.simul.simplified_newton = 0;
+options_.simul.sparse_backend = 'umfpack';
 
 options_.mode_check.status = 0;
 options_.mode_check.neighbourhood_size = .5;
@@ -77,6 +80,24 @@ options_.huge_number = 1e7;
 options_.threads.kronecker.A_times_B_kronecker_C = 1;
 options_.threads.kronecker.sparse_hessian_times_B_kronecker_C = 1;
 options_.threads.local_state_space_iteration_2 = 1;
+options_.threads.local_state_space_iteration_3 = 1;
+options_.threads.particle_filter_step = 1;
+options_.threads.mjdgges = 1;
+options_.threads.logposterior = 1;
+options_.threads.logMHMCMCposterior = 1;
+options_.threads.smc_posterior = 1;
+options_.threads.kalman_smoother = 1;
+options_.threads.posterior_irf_moments = 1;
+options_.threads.first_order_solutions = 1;
+options_.threads.gsa_sample_evaluation = 1;
+options_.threads.particle_filter_likelihood = 1;
+options_.threads.identification_derivatives = 1;
+options_.threads.conditional_variance_decomposition = 1;
+options_.threads.perfect_foresight_newton = 1;
+options_.threads.osr_objective = 1;
+options_.threads.bytecode = 1;
+options_.threads.bvar_engine = 1;
+options_.threads.conditional_forecast_engine = 1;
 
 % steady state
 options_.jacobian_flag = 1;
@@ -189,6 +210,13 @@ ep.use_bytecode = 0;
 % * init=1, a path generated with the first order reduced form is used.
 % * init=2, mix of cases 0 and 1.
 ep.init = 0;
+% In the extended path of bytecode, use the expected path computed in the
+% previous period, shifted by one period, as initial guess.
+ep.warm_start = 0;
+% In the extended path of bytecode, impose the complementarity conditions
+% given by the mcp equation tags, with a semismooth Newton method on their
+% Fischer-Burmeister reformulation.
+ep.complementarity = 0;
 % Maximum number of iterations for the deterministic solver.
 ep.maxit = 500;
 % Number of periods for the perfect foresight model.
@@ -340,6 +368,7 @@ else
 end
 options_.aim_solver = 0; % i.e. by default do not use G.Anderson's AIM solver, use mjdgges instead
 options_.k_order_solver=0; % by default do not use k_order_perturbation but mjdgges
+options_.k_order_reuse_sylvester=0; % k_order_perturbation keeps the Sylvester decompositions between calls
 options_.partial_information = 0;
 options_.ACES_solver = 0;
 options_.conditional_variance_decomposition = [];
@@ -420,6 +449,7 @@ options_.first_obs = NaN;
 options_.nobs = NaN;
 options_.kalman_algo = 0;
 options_.fast_kalman_filter = 0;
+options_.sqrt_kalman_filter = 0;
 options_.kalman_tol = 1e-10;
 options_.kalman.keep_kalman_algo_if_singularity_is_detected = 0;
 options_.diffuse_kalman_tol = 1e-6;
@@ -440,6 +470,9 @@ options_.mh_jscale = 0.2;
 options_.mh_init_scale = 2*options_.mh_jscale;
 options_.mh_mode = 1;
 options_.mh_nblck = 2;
+% Binary draws files of the C++ Metropolis-Hastings sampler
+options_.mh_dump.thinning = 1;
+options_.mh_dump.flush_interval = 10000;
 options_.mh_recover = 0;
 options_.mh_replic = 20000;
 options_.recursive_estimation_restart = 0;
@@ -477,6 +510,8 @@ options_.posterior_sampler_options.rwmh.proposal_distribution = 'rand_multivaria
 options_.posterior_sampler_options.rwmh.student_degrees_of_freedom = 3;
 options_.posterior_sampler_options.rwmh.use_mh_covariance_matrix=0;
 options_.posterior_sampler_options.rwmh.save_tmp_file=0;
+options_.posterior_sampler_options.rwmh.adaptive=0; %adaptive Metropolis proposal (C++ sampler)
+options_.posterior_sampler_options.rwmh.adaptation_prior_weight=100; %number of draws the initial proposal covariance is worth
 % Tailored Random Block Metropolis-Hastings
 options_.posterior_sampler_options.tarb.proposal_distribution = 'rand_multivariate_normal';
 options_.posterior_sampler_options.tarb.student_degrees_of_freedom = 3;
@@ -484,6 +519,11 @@ options_.posterior_sampler_options.tarb.mode_compute=4;
 options_.posterior_sampler_options.tarb.new_block_probability=0.25; %probability that next parameter belongs to new block
 options_.posterior_sampler_options.tarb.optim_opt=''; %probability that next parameter belongs to new block
 options_.posterior_sampler_options.tarb.save_tmp_file=1;
+% Sequential Monte Carlo (smc_posterior MEX file)
+options_.posterior_sampler_options.smc.number_of_particles=2000;
+options_.posterior_sampler_options.smc.conditional_ess_ratio=0.95; %the next temperature keeps this fraction of the effective sample size
+options_.posterior_sampler_options.smc.resampling_threshold=0.5; %resample when the effective sample size falls under this fraction of the particles
+options_.posterior_sampler_options.smc.mutation_steps=2; %number of Metropolis-Hastings steps by stage
 % Slice
 options_.posterior_sampler_options.slice.proposal_distribution = '';
 options_.posterior_sampler_options.slice.rotated=0;
@@ -507,6 +547,8 @@ options_.parallel = 0;
 options_.parallel_info.isHybridMatlabOctave = false;
 options_.parallel_info.leaveSlaveOpen = 0;
 options_.parallel_info.RemoteTmpFolder = '';
+options_.parallel_info.balancing = 'static';
+options_.parallel_threads = struct('Threads', 1, 'Affinity', 'none');
 options_.number_of_grid_points_for_kde = 2^9;
 quarter = 1;
 years = [1 2 3 4 5 10 20 30 40 50];
@@ -795,6 +837,9 @@ options_.endogenous_prior_restrictions.moment={};
 
 % OSR Optimal Simple Rules
 options_.osr.opt_algo=4;
+% gradient of the osr_objective MEX used by csminwel (0: numerical gradient
+% of csminwel, 1: derivatives of the decision rules, 2: parallel central differences)
+options_.osr.native_gradient=0;
 
 % use GPU
 options_.gpu = 0;
@@ -296,7 +296,6 @@ if fload==0
         end
     end
     %
-    h = dyn_waitbar(0,'Please wait...');
     istable=[1:Nsam];
     jstab=0;
     iunstable=[1:Nsam];
@@ -305,103 +304,136 @@ if fload==0
     inorestriction=zeros(1,Nsam);
     irestriction=zeros(1,Nsam);
     infox=zeros(Nsam,1);
-    for j=1:Nsam
-        M_ = set_all_parameters([lpmat0(j,:) lpmat(j,:)]',estim_params_,M_);
-        %try stoch_simul([]);
-        try
-            if ~ isempty(options_.endogenous_prior_restrictions.moment)
-                [Tt,Rr,SteadyState,info,M_,options_,oo_] = dynare_resolve(M_,options_,oo_);
-            else
-                [Tt,Rr,SteadyState,info,M_,options_,oo_] = dynare_resolve(M_,options_,oo_,'restrict');
-            end
-            infox(j,1)=info(1);
-            if infox(j,1)==0 && ~exist('T','var')
-                dr_=oo_.dr;
-                if prepSA
-                    try
-                        T=zeros(size(dr_.ghx,1),size(dr_.ghx,2)+size(dr_.ghu,2),Nsam);
-                    catch
-                        ME = lasterror();
-                        if strcmp('MATLAB:nomem',ME.identifier)
-                            prepSA=0;
-                            disp('The model is too large for storing state space matrices ...')
-                            disp('for mapping reduced form or for identification')
+    % With the DLL of the model, the first order solutions of all the
+    % samples are computed by the gsa_sample_evaluation MEX, in parallel
+    % (options_.threads.gsa_sample_evaluation threads). The eigenvalues are
+    % not returned (egg is NaN), so the Matlab loop is used when the
+    % transition matrices or the endogenous prior restrictions are needed.
+    native = ~prepSA && options_.use_dll && options_.order==1 && ~options_.loglinear ...
+             && ~options_.steadystate_flag && M_.exo_det_nbr==0 && size(M_.lead_lag_incidence,1)==3 ...
+             && isempty(options_.endogenous_prior_restrictions.irf) ...
+             && isempty(options_.endogenous_prior_restrictions.moment) ...
+             && exist('gsa_sample_evaluation')==3;
+    if native
+        params = repmat(M_.params,1,Nsam);
+        Sigma_e = repmat(M_.Sigma_e,[1 1 Nsam]);
+        for j=1:Nsam
+            M_ = set_all_parameters([lpmat0(j,:) lpmat(j,:)]',estim_params_,M_);
+            params(:,j) = M_.params;
+            Sigma_e(:,:,j) = M_.Sigma_e;
+        end
+        [infox, yys] = gsa_sample_evaluation(params, Sigma_e, oo_.steady_state, options_, M_, [], 0);
+        infox = infox';
+        % the variances are not needed here
+        infox(infox==30) = 0;
+        istable = istable.*(infox'==0);
+        iunstable = iunstable.*(infox'~=0);
+        iindeterm = (1:Nsam).*(infox'==4 | infox'==5);
+        iwrong = (1:Nsam).*(infox'~=0 & infox'~=3 & infox'~=4 & infox'~=5);
+        irestriction = istable;
+        if exist('egg','var')
+            egg(:) = NaN;
+        end
+    else
+        h = dyn_waitbar(0,'Please wait...');
+        for j=1:Nsam
+            M_ = set_all_parameters([lpmat0(j,:) lpmat(j,:)]',estim_params_,M_);
+            %try stoch_simul([]);
+            try
+                if ~ isempty(options_.endogenous_prior_restrictions.moment)
+                    [Tt,Rr,SteadyState,info,M_,options_,oo_] = dynare_resolve(M_,options_,oo_);
+                else
+                    [Tt,Rr,SteadyState,info,M_,options_,oo_] = dynare_resolve(M_,options_,oo_,'restrict');
+                end
+                infox(j,1)=info(1);
+                if infox(j,1)==0 && ~exist('T','var')
+                    dr_=oo_.dr;
+                    if prepSA
+                        try
+                            T=zeros(size(dr_.ghx,1),size(dr_.ghx,2)+size(dr_.ghu,2),Nsam);
+                        catch
+                            ME = lasterror();
+                            if strcmp('MATLAB:nomem',ME.identifier)
+                                prepSA=0;
+                                disp('The model is too large for storing state space matrices ...')
+                                disp('for mapping reduced form or for identification')
+                            end
+                            T=[];
                         end
+                    else
                         T=[];
                     end
-                else
-                    T=[];
+                    egg=zeros(length(dr_.eigval),Nsam);
                 end
-                egg=zeros(length(dr_.eigval),Nsam);
-            end
-            if infox(j,1)
-                %                 disp('no solution'),
-                if isfield(oo_.dr,'ghx')
-                    oo_.dr=rmfield(oo_.dr,'ghx');
+                if infox(j,1)
+                    %                 disp('no solution'),
+                    if isfield(oo_.dr,'ghx')
+                        oo_.dr=rmfield(oo_.dr,'ghx');
+                    end
+                    if (infox(j,1)<3 || infox(j,1)>5) && isfield(oo_.dr,'eigval')
+                        oo_.dr=rmfield(oo_.dr,'eigval');
+                    end
                 end
-                if (infox(j,1)<3 || infox(j,1)>5) && isfield(oo_.dr,'eigval')
+            catch ME
+                if isfield(oo_.dr,'eigval')
                     oo_.dr=rmfield(oo_.dr,'eigval');
                 end
+                if isfield(oo_.dr,'ghx')
+                    oo_.dr=rmfield(oo_.dr,'ghx');
+                end
+                disp('No solution could be found')
             end
-        catch ME
-            if isfield(oo_.dr,'eigval')
-                oo_.dr=rmfield(oo_.dr,'eigval');
-            end
-            if isfield(oo_.dr,'ghx')
-                oo_.dr=rmfield(oo_.dr,'ghx');
-            end
-            disp('No solution could be found')
-        end
-        dr_ = oo_.dr;
-        if isfield(dr_,'ghx')
-            egg(:,j) = sort(dr_.eigval);
-            if prepSA
-                jstab=jstab+1;
-                T(:,:,jstab) = [dr_.ghx dr_.ghu];
-                %         [A,B] = ghx2transition(squeeze(T(:,:,jstab)), ...
-                %           bayestopt_.restrict_var_list, ...
-                %           bayestopt_.restrict_columns, ...
-                %           bayestopt_.restrict_aux);
-            end
-            if ~exist('nspred','var')
-                nspred = dr_.nspred; %size(dr_.ghx,2);
-                nboth = dr_.nboth;
-                nfwrd = dr_.nfwrd;
-            end
-            info=endogenous_prior_restrictions(Tt,Rr,M_,options_,oo_);
-            infox(j,1)=info(1);
-            if info(1)
-                inorestriction(j)=j;
-            else
-                iunstable(j)=0;
-                irestriction(j)=j;
-            end
-        else
-            istable(j)=0;
-            if isfield(dr_,'eigval')
+            dr_ = oo_.dr;
+            if isfield(dr_,'ghx')
                 egg(:,j) = sort(dr_.eigval);
-                if exist('nspred','var')
-                    if any(isnan(egg(1:nspred,j)))
-                        iwrong(j)=j;
-                    else
-                        if (nboth || nfwrd) && abs(egg(nspred+1,j))<=options_.qz_criterium
-                            iindeterm(j)=j;
-                        end
-                    end
+                if prepSA
+                    jstab=jstab+1;
+                    T(:,:,jstab) = [dr_.ghx dr_.ghu];
+                    %         [A,B] = ghx2transition(squeeze(T(:,:,jstab)), ...
+                    %           bayestopt_.restrict_var_list, ...
+                    %           bayestopt_.restrict_columns, ...
+                    %           bayestopt_.restrict_aux);
+                end
+                if ~exist('nspred','var')
+                    nspred = dr_.nspred; %size(dr_.ghx,2);
+                    nboth = dr_.nboth;
+                    nfwrd = dr_.nfwrd;
+                end
+                info=endogenous_prior_restrictions(Tt,Rr,M_,options_,oo_);
+                infox(j,1)=info(1);
+                if info(1)
+                    inorestriction(j)=j;
+                else
+                    iunstable(j)=0;
+                    irestriction(j)=j;
                 end
             else
-                if exist('egg','var')
-                    egg(:,j)=ones(size(egg,1),1).*NaN;
+                istable(j)=0;
+                if isfield(dr_,'eigval')
+                    egg(:,j) = sort(dr_.eigval);
+                    if exist('nspred','var')
+                        if any(isnan(egg(1:nspred,j)))
+                            iwrong(j)=j;
+                        else
+                            if (nboth || nfwrd) && abs(egg(nspred+1,j))<=options_.qz_criterium
+                                iindeterm(j)=j;
+                            end
+                        end
+                    end
+                else
+                    if exist('egg','var')
+                        egg(:,j)=ones(size(egg,1),1).*NaN;
+                    end
+                    iwrong(j)=j;
                 end
-                iwrong(j)=j;
             end
+            ys_=real(dr_.ys);
+            yys(:,j) = ys_;
+            ys_=yys(:,1);
+            dyn_waitbar(j/Nsam,h,['MC iteration ',int2str(j),'/',int2str(Nsam)])
         end
-        ys_=real(dr_.ys);
-        yys(:,j) = ys_;
-        ys_=yys(:,1);
-        dyn_waitbar(j/Nsam,h,['MC iteration ',int2str(j),'/',int2str(Nsam)])
+        dyn_waitbar_close(h);
     end
-    dyn_waitbar_close(h);
     if prepSA && jstab
         T=T(:,:,1:jstab);
     else
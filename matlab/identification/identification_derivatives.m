@@ -0,0 +1,71 @@
+function [dA, dB, dOm, info] = identification_derivatives(GAM0, GAM1, A, B, Sigma_e, Dg0, Dg1, Dg2, Dg3, number_of_threads)
+
+% Computes the derivatives of the first order solution y(t) = A*y(t-1) + B*e(t)
+% of GAM0*y(t) = GAM1*y(t+1) + GAM2*y(t-1) + GAM3*e(t) with respect to the
+% parameters, by solving the generalized Sylvester equations
+% (GAM0-GAM1*A)*dA - GAM1*dA*A = Dg2 - (Dg0-Dg1*A)*A.
+%
+% INPUTS
+%   GAM0, GAM1          [double]    m*m matrices.
+%   A                   [double]    m*m transition matrix.
+%   B                   [double]    m*n matrix.
+%   Sigma_e             [double]    n*n covariance matrix of the shocks.
+%   Dg0, Dg1, Dg2       [double]    m*m*p derivatives of GAM0, GAM1, GAM2.
+%   Dg3                 [double]    m*n*p derivatives of GAM3.
+%   number_of_threads   [integer]   ignored (used by the MEX version).
+%
+% OUTPUTS
+%   dA                  [double]    m*m*p derivatives of A.
+%   dB                  [double]    m*n*p derivatives of B.
+%   dOm                 [double]    m*m*p derivatives of B*Sigma_e*B'.
+%   info                [integer]   0 on success, 1 if a solution is not finite.
+%
+% SPECIAL REQUIREMENTS
+%   This is the Matlab version of the MEX file of the same name.
+
+% Copyright (C) 2017 Dynare Team
+%
+% This file is part of Dynare.
+%
+% Dynare is free software: you can redistribute it and/or modify
+% it under the terms of the GNU General Public License as published by
+% the Free Software Foundation, either version 3 of the License, or
+% (at your option) any later version.
+%
+% Dynare is distributed in the hope that it will be useful,
+% but WITHOUT ANY WARRANTY; without even the implied warranty of
+% MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+% GNU General Public License for more details.
+%
+% You should have received a copy of the GNU General Public License
+% along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+
+m = size(A,1);
+n = size(B,2);
+p = size(Dg0,3);
+
+a = (GAM0-GAM1*A);
+b = -GAM1;
+c = A;
+elem = zeros(m,m,p);
+d = elem;
+for j=1:p
+    elem(:,:,j) = (Dg0(:,:,j)-Dg1(:,:,j)*A);
+    d(:,:,j) = Dg2(:,:,j)-elem(:,:,j)*A;
+end
+dA = sylvester3(a,b,c,d);
+flag = 1;
+icount = 0;
+while flag && icount<4
+    [dA, flag] = sylvester3a(dA,a,b,c,d);
+    icount = icount+1;
+end
+
+dB = zeros(m,n,p);
+dOm = zeros(m,m,p);
+for j=1:p
+    dB(:,:,j) = a\(Dg3(:,:,j)-(elem(:,:,j)-GAM1*dA(:,:,j))*B);
+    dOm(:,:,j) = dB(:,:,j)*Sigma_e*B'+B*Sigma_e*dB(:,:,j)';
+end
+
+info = ~all(isfinite(dA(:))) || ~all(isfinite(dOm(:)));
@@ -0,0 +1,58 @@
+function [dGAM, info] = identification_moments_derivatives(A, GAM, dA, dOm, nlags, number_of_threads)
+
+% Computes the derivatives of the autocovariances of y(t) = A*y(t-1) + e(t),
+% var(e(t)) = Om, with respect to the parameters.
+%
+% INPUTS
+%   A                   [double]    m*m transition matrix.
+%   GAM                 [double]    m*m variance of y.
+%   dA, dOm             [double]    m*m*p derivatives of A and Om.
+%   nlags               [integer]   number of autocovariances.
+%   number_of_threads   [integer]   ignored (used by the MEX version).
+%
+% OUTPUTS
+%   dGAM                [double]    m*m*(nlags+1)*p array, dGAM(:,:,1,j) is the
+%                                   derivative of the variance and
+%                                   dGAM(:,:,i+1,j) the one of A^i*GAM.
+%   info                [integer]   0 on success, 1 if a solution is not finite.
+%
+% SPECIAL REQUIREMENTS
+%   This is the Matlab version of the MEX file of the same name.
+
+% Copyright (C) 2017 Dynare Team
+%
+% This file is part of Dynare.
+%
+% Dynare is free software: you can redistribute it and/or modify
+% it under the terms of the GNU General Public License as published by
+% the Free Software Foundation, either version 3 of the License, or
+% (at your option) any later version.
+%
+% Dynare is distributed in the hope that it will be useful,
+% but WITHOUT ANY WARRANTY; without even the implied warranty of
+% MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+% GNU General Public License for more details.
+%
+% You should have received a copy of the GNU General Public License
+% along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+
+m = size(A,1);
+p = size(dA,3);
+dGAM = zeros(m,m,nlags+1,p);
+info = 0;
+for j=1:p
+    % The Schur decomposition of A is computed once, and reused for the other parameters
+    dum = lyapunov_symm(A,dA(:,:,j)*GAM*A'+A*GAM*dA(:,:,j)'+dOm(:,:,j),1e-10,1+1e-6,1e-15,1+(j>1),0);
+    if size(dum,1) < m || ~all(isfinite(dum(:)))
+        % unit roots, left to the caller
+        info = 1;
+        return
+    end
+    dum(abs(dum) < 1e-12) = 0;
+    dGAM(:,:,1,j) = dum;
+    AiGAM = GAM;
+    for i=1:nlags
+        dGAM(:,:,i+1,j) = A*dGAM(:,:,i,j)+dA(:,:,j)*AiGAM;
+        AiGAM = A*AiGAM;
+    end
+end
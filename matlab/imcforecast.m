@@ -247,11 +247,20 @@ FORCS1_shocks = zeros(n1,cL,options_cond_fcst.replic);
 
 %randn('state',0);
 
-for b=1:options_cond_fcst.replic %conditional forecast using cL set to constrained values
-    shocks = sQ*randn(ExoSize,options_cond_fcst.periods);
-    shocks(jdx,:) = zeros(length(jdx),options_cond_fcst.periods);
-    [FORCS1(:,:,b), FORCS1_shocks(:,:,b)] = mcforecast3(cL,options_cond_fcst.periods,constrained_paths,shocks,FORCS1(:,:,b),T,R,mv, mu);
-    FORCS1(:,:,b)=FORCS1(:,:,b)+trend; %add trend
+if exist('conditional_forecast_engine', 'file') == 3
+    % Native engine, solving for the controlled shocks of all the replications with a single factorization
+    % (the shocks are drawn in the same order as in the loop below)
+    shocks = reshape(sQ*randn(ExoSize,options_cond_fcst.periods*options_cond_fcst.replic), ExoSize, options_cond_fcst.periods, options_cond_fcst.replic);
+    shocks(jdx,:,:) = 0;
+    [FORCS1, FORCS1_shocks] = conditional_forecast_engine(cL, constrained_paths, shocks, InitState, T, R, idx, jdx, options_);
+    FORCS1 = bsxfun(@plus, FORCS1, trend); %add trend
+else
+    for b=1:options_cond_fcst.replic %conditional forecast using cL set to constrained values
+        shocks = sQ*randn(ExoSize,options_cond_fcst.periods);
+        shocks(jdx,:) = zeros(length(jdx),options_cond_fcst.periods);
+        [FORCS1(:,:,b), FORCS1_shocks(:,:,b)] = mcforecast3(cL,options_cond_fcst.periods,constrained_paths,shocks,FORCS1(:,:,b),T,R,mv, mu);
+        FORCS1(:,:,b)=FORCS1(:,:,b)+trend; %add trend
+    end
 end
 
 mFORCS1 = mean(FORCS1,3);
@@ -283,10 +292,16 @@ FORCS2(:,1,:) = repmat(InitState,1,options_cond_fcst.replic); %set initial stead
 
 %randn('state',0);
 
-for b=1:options_cond_fcst.replic %conditional forecast using cL set to 0
-    shocks = sQ*randn(ExoSize,options_cond_fcst.periods);
-    shocks(jdx,:) = zeros(length(jdx),options_cond_fcst.periods);
-    FORCS2(:,:,b) = mcforecast3(0,options_cond_fcst.periods,constrained_paths,shocks,FORCS2(:,:,b),T,R,mv, mu)+trend;
+if exist('conditional_forecast_engine', 'file') == 3
+    shocks = reshape(sQ*randn(ExoSize,options_cond_fcst.periods*options_cond_fcst.replic), ExoSize, options_cond_fcst.periods, options_cond_fcst.replic);
+    shocks(jdx,:,:) = 0;
+    FORCS2 = bsxfun(@plus, conditional_forecast_engine(0, constrained_paths, shocks, InitState, T, R, idx, jdx, options_), trend);
+else
+    for b=1:options_cond_fcst.replic %conditional forecast using cL set to 0
+        shocks = sQ*randn(ExoSize,options_cond_fcst.periods);
+        shocks(jdx,:) = zeros(length(jdx),options_cond_fcst.periods);
+        FORCS2(:,:,b) = mcforecast3(0,options_cond_fcst.periods,constrained_paths,shocks,FORCS2(:,:,b),T,R,mv, mu)+trend;
+    end
 end
 
 mFORCS2 = mean(FORCS2,3);
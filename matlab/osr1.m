@@ -98,8 +98,21 @@ inv_order_var = oo_.dr.inv_order_var;
 
 %extract unique entries of covariance
 i_var=unique(i_var);
+
+% With use_dll, the loss is computed by the osr_objective MEX (osr_obj.m
+% falls back on resol for the parameter values where it fails)
+native_i_var = [];
+if options_.use_dll && exist('osr_objective','file') == 3 && size(M_.lead_lag_incidence,1) == 3 ...
+        && M_.exo_det_nbr == 0 && ~any(oo_.exo_steady_state)
+    native_i_var = i_var;
+end
+native_gradient = 0;
+if ~isempty(native_i_var) && isequal(options_.osr.opt_algo,4)
+    native_gradient = options_.osr.native_gradient;
+end
+
 %% do initial checks
-[loss,info,exit_flag,vx]=osr_obj(t0,i_params,inv_order_var(i_var),weights(i_var,i_var));
+[loss,info,exit_flag,vx]=osr_obj(t0,i_params,inv_order_var(i_var),weights(i_var,i_var),native_i_var);
 if info~=0
     print_info(info, options_.noprint, options_);
 else
@@ -129,8 +142,13 @@ else
         error('OSR: OSR with bounds on parameters requires a constrained optimizer, i.e. 1,2,5, or 9.')
     end
     %%do actual optimization
-    [p, f, exitflag] = dynare_minimize_objective(str2func('osr_obj'),t0,options_.osr.opt_algo,options_,M_.osr.param_bounds,cellstr(M_.param_names(i_params,:)),[],[], i_params,...
-                                                 inv_order_var(i_var),weights(i_var,i_var));
+    optim_options = options_;
+    if native_gradient
+        % csminwel then uses the fourth output of osr_obj as the gradient
+        optim_options.analytic_derivation = 1;
+    end
+    [p, f, exitflag] = dynare_minimize_objective(str2func('osr_obj'),t0,options_.osr.opt_algo,optim_options,M_.osr.param_bounds,cellstr(M_.param_names(i_params,:)),[],[], i_params,...
+                                                 inv_order_var(i_var),weights(i_var,i_var),native_i_var,native_gradient);
 end
 
 osr_res.objective_function = f;
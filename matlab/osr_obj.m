@@ -1,4 +1,4 @@
-function [loss,info,exit_flag,vx,junk]=osr_obj(x,i_params,i_var,weights)
+function [loss,info,exit_flag,vx,junk]=osr_obj(x,i_params,i_var,weights,native_i_var,native_gradient)
 % objective function for optimal simple rules (OSR)
 % INPUTS
 %   x                         vector           values of the parameters
@@ -6,12 +6,19 @@ function [loss,info,exit_flag,vx,junk]=osr_obj(x,i_params,i_var,weights)
 %   i_params                  vector           index of optimizing parameters in M_.params
 %   i_var                     vector           variables indices
 %   weights                   vector           weights in the OSRs
+%   native_i_var              vector           variables indices in declaration order, if
+%                                              the loss is computed by the osr_objective
+%                                              MEX (optional)
+%   native_gradient           scalar           gradient method of osr_objective, or 0
+%                                              (optional)
 %
 % OUTPUTS
 %   loss                      scalar           loss function returned to solver
 %   info                      vector           info vector returned by resol
 %   exit_flag                 scalar           exit flag returned to solver
-%   vx                        vector           variances of the endogenous variables
+%   vx                        vector           variances of the endogenous variables,
+%                                              or gradient of the loss if native_gradient
+%                                              is nonzero
 %   junk                      empty            dummy output for conformable
 %                                              header
 %
@@ -45,6 +52,24 @@ loss=[];
 % set parameters of the policiy rule
 M_.params(i_params) = x;
 
+if nargin > 4 && ~isempty(native_i_var)
+    if nargin < 6
+        native_gradient = 0;
+    end
+    [loss_mex,info_mex,vx,grad] = osr_objective(x,i_params,native_i_var,weights,M_,options_,oo_.steady_state,native_gradient);
+    if info_mex
+        % The loss (or the penalty) is computed by resol and lyapunov_symm
+        [loss,info,exit_flag,vx] = osr_obj(x,i_params,i_var,weights);
+        grad = zeros(length(x),1);
+    else
+        loss = loss_mex;
+    end
+    if native_gradient
+        vx = grad;
+    end
+    return
+end
+
 % don't change below until the part where the loss function is computed
 it_ = M_.maximum_lag+1;
 [dr,info,M_,options_,oo_] = resol(0,M_,options_,oo_);
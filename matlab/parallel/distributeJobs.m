@@ -1,4 +1,4 @@
-function [nCPU, totCPU, nBlockPerCPU, totSLAVES] = distributeJobs(Parallel, fBlock, nBlock)
+function [nCPU, totCPU, nBlockPerCPU, totSLAVES] = distributeJobs(Parallel, fBlock, nBlock, Parallel_info)
 % PARALLEL CONTEXT
 % In parallel context this function is used to determine the total number of available CPUs,
 % and the number of threads to run on each CPU.
@@ -8,6 +8,11 @@ function [nCPU, totCPU, nBlockPerCPU, totSLAVES] = distributeJobs(Parallel, fBlo
 %  o fBlock [int]               index number of the first job (e.g. MC iteration or MH block)
 %                               (between 1 and nBlock)
 %  o nBlock [int]               index number of the last job.
+%  o Parallel_info [struct]     copy of options_.parallel_info (optional). If
+%                               Parallel_info.balancing is 'measured', the jobs
+%                               are split in proportion to the throughput of
+%                               the nodes measured by previous calls to
+%                               masterParallel, instead of the NodeWeights.
 %
 % OUTPUT
 %  o nBlockPerCPU [int vector]  for each CPU used, indicates the number of
@@ -80,6 +85,14 @@ JobsForNode=zeros(1,nC);
 for j=1:lP
     CPUWeight(j)=str2num(Parallel(j).NodeWeight)*nCPUoriginal(j);
 end
+if nargin>3 && isfield(Parallel_info,'balancing') && strcmp(Parallel_info.balancing,'measured')
+    % Use the throughput per CPU measured on each node, once all the nodes
+    % have been measured.
+    throughput = parallelNodeThroughput(Parallel);
+    if all(isfinite(throughput) & throughput>0)
+        CPUWeight=throughput.*nCPUoriginal;
+    end
+end
 CPUWeight=CPUWeight./sum(CPUWeight);
 
 % Redistributing the jobs among the cluster nodes according to the
@@ -183,7 +183,7 @@ end
 % Determine the total number of available CPUs, and the number of threads
 % to run on each CPU.
 
-[nCPU, totCPU, nBlockPerCPU, totSlaves] = distributeJobs(Parallel, fBlock, nBlock);
+[nCPU, totCPU, nBlockPerCPU, totSlaves] = distributeJobs(Parallel, fBlock, nBlock, Parallel_info);
 for j=1:totSlaves
     PRCDirSnapshot{j}={};
 end
@@ -652,6 +652,10 @@ ForEver=1;
 statusString = '';
 flag_CloseAllSlaves=0;
 
+% Elapsed time at which each job finishes, to measure the throughput of the nodes
+tStart = clock;
+tDone = NaN(1,totCPU);
+
 while (ForEver)
 
     waitbarString = '';
@@ -680,6 +684,9 @@ while (ForEver)
             end
             pcerdone(j) = prtfrc;
             idCPU(j) = njob;
+            if prtfrc>=1 && isnan(tDone(j))
+                tDone(j) = etime(clock,tStart);
+            end
             if isoctave || options_.console_mode
                 if (~ispc || strcmpi('unix',Parallel(indPC).OperatingSystem))
                     statusString = [statusString, int2str(j), ' %3.f%% done! '];
@@ -770,6 +777,22 @@ while (ForEver)
 end
 
 
+% Measure the throughput of the nodes (in jobs per second and per CPU), used
+% by distributeJobs when options_.parallel_info.balancing is 'measured'.
+tDone(isnan(tDone)) = etime(clock,tStart);
+throughput = NaN(1,length(Parallel));
+for indPC=1:totSlaves
+    jobs = find(arrayfun(@(j) min(find(nCPU>=j)), 1:totCPU)==indPC);
+    if ~isempty(jobs)
+        throughput(indPC) = mean(nBlockPerCPU(jobs)./max(tDone(jobs),eps));
+        if options_.console_mode || isoctave
+            fprintf('Node %d (%s): %d jobs on %d CPU(s), %.3g jobs/s per CPU\n', indPC, Parallel(indPC).ComputerName, ...
+                    sum(nBlockPerCPU(jobs)), length(jobs), throughput(indPC));
+        end
+    end
+end
+parallelNodeThroughput(Parallel, throughput);
+
 % Load and format remote output.
 iscrash = 0;
 PRCDirSnapshot=dynareParallelGetNewFiles(PRCDir,Parallel(1:totSlaves),PRCDirSnapshot);
@@ -0,0 +1,60 @@
+function throughput = parallelNodeThroughput(Parallel, measured)
+% PARALLEL CONTEXT
+% Keeps track of the throughput of the nodes of the cluster (number of jobs
+% computed per second and per CPU), as measured by masterParallel, for the
+% 'measured' balancing strategy of distributeJobs.
+%
+% INPUTS
+%  o Parallel [struct vector]   copy of options_.parallel
+%  o measured [double vector]   (optional) throughput measured on each node
+%                               of Parallel, NaN for the unused nodes.
+%
+% OUTPUTS
+%  o throughput [double vector] throughput of each node of Parallel, NaN
+%                               if the node has not been measured yet.
+%
+% Successive measures of a node are averaged, giving the same weight to the
+% last measure and to the previous ones.
+
+% Copyright (C) 2017 Dynare Team
+%
+% This file is part of Dynare.
+%
+% Dynare is free software: you can redistribute it and/or modify
+% it under the terms of the GNU General Public License as published by
+% the Free Software Foundation, either version 3 of the License, or
+% (at your option) any later version.
+%
+% Dynare is distributed in the hope that it will be useful,
+% but WITHOUT ANY WARRANTY; without even the implied warranty of
+% MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+% GNU General Public License for more details.
+%
+% You should have received a copy of the GNU General Public License
+% along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+
+persistent nodes values
+
+if isempty(nodes)
+    nodes = {};
+    values = [];
+end
+
+throughput = NaN(1,length(Parallel));
+for j=1:length(Parallel)
+    % A node is identified by its machine and its CPUs
+    key = [Parallel(j).ComputerName ':' Parallel(j).Port ':' mat2str(Parallel(j).CPUnbr)];
+    i = find(strcmp(key,nodes));
+    if nargin>1 && isfinite(measured(j))
+        if isempty(i)
+            nodes{end+1} = key;
+            values(end+1) = measured(j);
+            i = length(nodes);
+        else
+            values(i) = (values(i)+measured(j))/2;
+        end
+    end
+    if ~isempty(i)
+        throughput(j) = values(i);
+    end
+end
@@ -89,6 +89,15 @@ else
                 if options_.linear_approximation
                     [oo_.endo_simul, oo_.deterministic_simulation] = ...
                         sim1_linear(oo_.endo_simul, oo_.exo_simul, oo_.steady_state, oo_.exo_steady_state, M_, options_);
+                elseif options_.use_dll && size(M_.lead_lag_incidence,1) == 3 && M_.maximum_lag == 1 && M_.maximum_lead == 1 ...
+                        && ~options_.endogenous_terminal_period && ~options_.simul.robust_lin_solve
+                    % Stacked Newton method with the compiled dynamic model
+                    [oo_.endo_simul, status, err, iterations] = ...
+                        perfect_foresight_newton(oo_.endo_simul, oo_.exo_simul, oo_.steady_state, M_, options_);
+                    oo_.deterministic_simulation.status = status;
+                    oo_.deterministic_simulation.error = err;
+                    oo_.deterministic_simulation.iterations = iterations;
+                    oo_.deterministic_simulation.periods = options_.periods*ones(1,iterations);
                 else
                     [oo_.endo_simul, oo_.deterministic_simulation] = ...
                         sim1(oo_.endo_simul, oo_.exo_simul, oo_.steady_state, M_, options_);
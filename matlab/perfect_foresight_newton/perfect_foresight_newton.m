@@ -0,0 +1,44 @@
+function [endo_simul, status, err, iterations] = perfect_foresight_newton(endo_simul, exo_simul, steady_state, M_, options_)
+
+% Solves the perfect foresight problem of a model with one lag and one lead
+% by a Newton method on the stacked system.
+%
+% INPUTS
+%   endo_simul    [double]    endo_nbr*(periods+2) matrix: initial guess,
+%                             initial and terminal conditions.
+%   exo_simul     [double]    (periods+2)*exo_nbr matrix of exogenous variables.
+%   steady_state  [double]    endo_nbr vector, steady state.
+%   M_            [struct]    model description.
+%   options_      [struct]    options.
+%
+% OUTPUTS
+%   endo_simul    [double]    endo_nbr*(periods+2) matrix, solution.
+%   status        [logical]   true if the Newton iterations converged.
+%   err           [double]    largest absolute residual at the last iteration.
+%   iterations    [integer]   number of iterations.
+%
+% SPECIAL REQUIREMENTS
+%   This is the Matlab version of the MEX file of the same name, which
+%   calls the dynamic model compiled with the use_dll option.
+
+% Copyright (C) 2017 Dynare Team
+%
+% This file is part of Dynare.
+%
+% Dynare is free software: you can redistribute it and/or modify
+% it under the terms of the GNU General Public License as published by
+% the Free Software Foundation, either version 3 of the License, or
+% (at your option) any later version.
+%
+% Dynare is distributed in the hope that it will be useful,
+% but WITHOUT ANY WARRANTY; without even the implied warranty of
+% MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+% GNU General Public License for more details.
+%
+% You should have received a copy of the GNU General Public License
+% along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+
+[endo_simul, info] = sim1(endo_simul, exo_simul, steady_state, M_, options_);
+status = info.status;
+err = info.error;
+iterations = info.iterations;
@@ -1,20 +1,21 @@
-function [err,ss,tt,w,sdim,eigval,info] = mjdgges(e,d,qz_criterium, fake)
+function [err,ss,tt,w,sdim,eigval,info] = mjdgges(e,d,qz_criterium, fake, numthreads)
 %function [err,ss,tt,w,sdim,eigval,info] = mjdgges(e,d,qz_criterium)
 % QZ decomposition, Sims' codes are used.
 %
 % INPUTS
-%   e            [double] real square (n*n) matrix.
-%   d            [double] real square (n*n) matrix.
+%   e            [double] real square (n*n) matrix, or (n*n*N) array of N matrices.
+%   d            [double] real square (n*n) matrix, or (n*n*N) array of N matrices.
 %   qz_criterium [double] scalar (1+epsilon).
+%   numthreads   [integer] scalar, number of threads used by the mex file for a batch of pencils (ignored here).
 %
 % OUTPUTS
 %   err          [double]  scalar: 1 indicates failure, 0 indicates success
-%   ss           [complex] (n*n) matrix.
-%   tt           [complex] (n*n) matrix.
-%   w            [complex] (n*n) matrix.
-%   sdim         [integer] scalar.
-%   eigval       [complex] (n*1) vector.
-%   info         [integer] scalar.
+%   ss           [complex] (n*n) matrix, or (n*n*N) array for a batch of pencils.
+%   tt           [complex] (n*n) matrix, or (n*n*N) array.
+%   w            [complex] (n*n) matrix, or (n*n*N) array.
+%   sdim         [integer] scalar, or (1*N) vector.
+%   eigval       [complex] (n*1) vector, or (n*N) matrix.
+%   info         [integer] scalar, or (1*N) vector.
 %
 % ALGORITHM
 %   Sims's qzdiv routine is used.
@@ -40,8 +41,31 @@ function [err,ss,tt,w,sdim,eigval,info] = mjdgges(e,d,qz_criterium, fake)
 % along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
 
 % Check number of inputs and outputs.
-if nargin>4 || nargin<2 || nargout>7 || nargout==0
-    error('MJDGGES: takes 2 or 3 input arguments and between 1 and 7 output arguments.')
+if nargin>5 || nargin<2 || nargout>7 || nargout==0
+    error('MJDGGES: takes between 2 and 5 input arguments and between 1 and 7 output arguments.')
+end
+
+% Set default value of qz_criterium.
+if nargin <3 || isempty(qz_criterium)
+    qz_criterium = 1 + 1e-6;
+end
+
+% Batch of pencils, solved one by one.
+if ndims(e)==3
+    if ~isequal(size(e),size(d))
+        error('MJDGGES requires two square real matrices (or two n*n*N arrays of square real matrices) of the same dimension.')
+    end
+    [n,n,N] = size(e);
+    ss = zeros(n,n,N);
+    tt = zeros(n,n,N);
+    w = zeros(n,n,N);
+    sdim = zeros(1,N);
+    eigval = zeros(n,N);
+    info = zeros(1,N);
+    for k=1:N
+        [err,ss(:,:,k),tt(:,:,k),w(:,:,k),sdim(k),eigval(:,k),info(k)] = mjdgges(e(:,:,k),d(:,:,k),qz_criterium);
+    end
+    return
 end
 
 % Check the first two inputs.
@@ -52,11 +76,6 @@ if ( ~isreal(e) || ~isreal(d) || me~=ne || md~=nd || me~=nd)
     error('MJDGGES requires two square real matrices of the same dimension.')
 end
 
-% Set default value of qz_criterium.
-if nargin <3
-    qz_criterium = 1 + 1e-6;
-end
-
 info = 0;
 
 % Initialization of the output arguments.
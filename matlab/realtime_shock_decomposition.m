@@ -95,6 +95,8 @@ options_.selected_variables_only = 0; %make sure all variables are stored
 options_.plot_priors=0;
 init=1;
 nobs = options_.nobs;
+z_prev = [];
+epsilon_prev = [];
 
 if forecast_ && any(forecast_params)
     M1=M_;
@@ -138,36 +140,49 @@ for j=presample+1:nobs
     end
     epsilon=[epsilon zeros(nshocks,forecast_)];
 
-    z = zeros(endo_nbr,nshocks+2,gend+forecast_);
-
-    z(:,end,1:gend) = Smoothed_Variables_deviation_from_mean;
-
     maximum_lag = M_.maximum_lag;
 
     k2 = dr.kstate(find(dr.kstate(:,2) <= maximum_lag+1),[1 2]);
     i_state = order_var(k2(:,1))+(min(i,maximum_lag)+1-k2(:,2))*M_.endo_nbr;
-    for i=1:gend+forecast_
-        if i > 1 && i <= maximum_lag+1
-            lags = min(i-1,maximum_lag):-1:1;
+    if maximum_lag == 1
+        % Single pass, restarted at the first period revised since the previous vintage
+        if forecast_
+            Afd = Af(inv_order_var,:);
+        else
+            Afd = [];
         end
+        z = fast_shock_decomposition(A(inv_order_var,:),B(inv_order_var,:),i_state,epsilon, ...
+                                     Smoothed_Variables_deviation_from_mean,1,Afd,z_prev,epsilon_prev);
+        z_prev = z(:,:,1:gend);
+        epsilon_prev = epsilon(:,1:gend);
+    else
+        z = zeros(endo_nbr,nshocks+2,gend+forecast_);
 
-        if i > 1
-            tempx = permute(z(:,1:nshocks,lags),[1 3 2]);
-            m = min(i-1,maximum_lag);
-            tempx = [reshape(tempx,endo_nbr*m,nshocks); zeros(endo_nbr*(maximum_lag-i+1),nshocks)];
-            if i > gend
-                z(:,nshocks+2,i) = Af(inv_order_var,:)*z(i_state,nshocks+2,lags);
-                %             z(:,nshocks+2,i) = A(inv_order_var,:)*permute(z(i_state,nshocks+2,lags),[1 3 2]);
-                z(:,1:nshocks,i) = Af(inv_order_var,:)*tempx(i_state,:);
-            else
-                z(:,1:nshocks,i) = A(inv_order_var,:)*tempx(i_state,:);
+        z(:,end,1:gend) = Smoothed_Variables_deviation_from_mean;
+
+        for i=1:gend+forecast_
+            if i > 1 && i <= maximum_lag+1
+                lags = min(i-1,maximum_lag):-1:1;
             end
-            lags = lags+1;
-            z(:,1:nshocks,i) = z(:,1:nshocks,i) + B(inv_order_var,:).*repmat(epsilon(:,i)',endo_nbr,1);
-        end
 
-        %         z(:,1:nshocks,i) = z(:,1:nshocks,i) + B(inv_order_var,:).*repmat(epsilon(:,i)',endo_nbr,1);
-        z(:,nshocks+1,i) = z(:,nshocks+2,i) - sum(z(:,1:nshocks,i),2);
+            if i > 1
+                tempx = permute(z(:,1:nshocks,lags),[1 3 2]);
+                m = min(i-1,maximum_lag);
+                tempx = [reshape(tempx,endo_nbr*m,nshocks); zeros(endo_nbr*(maximum_lag-i+1),nshocks)];
+                if i > gend
+                    z(:,nshocks+2,i) = Af(inv_order_var,:)*z(i_state,nshocks+2,lags);
+                    %             z(:,nshocks+2,i) = A(inv_order_var,:)*permute(z(i_state,nshocks+2,lags),[1 3 2]);
+                    z(:,1:nshocks,i) = Af(inv_order_var,:)*tempx(i_state,:);
+                else
+                    z(:,1:nshocks,i) = A(inv_order_var,:)*tempx(i_state,:);
+                end
+                lags = lags+1;
+                z(:,1:nshocks,i) = z(:,1:nshocks,i) + B(inv_order_var,:).*repmat(epsilon(:,i)',endo_nbr,1);
+            end
+
+            %         z(:,1:nshocks,i) = z(:,1:nshocks,i) + B(inv_order_var,:).*repmat(epsilon(:,i)',endo_nbr,1);
+            z(:,nshocks+1,i) = z(:,nshocks+2,i) - sum(z(:,1:nshocks,i),2);
+        end
     end
 
     %% conditional shock decomp 1 step ahead
@@ -0,0 +1,194 @@
+function [y,y_f,y_s,y_rd] = local_state_space_iteration_3(yhat,a,b,c,d,e,f)%[yhat_s,yhat_rd,]epsilon,derivs,ss,numthreads
+
+%@info:
+%! @deftypefn {Function File} {@var{y}, @var{y_f}, @var{y_s}, @var{y_rd} =} local_state_space_iteration_3 (@var{yhat}, [@var{yhat_s}, @var{yhat_rd},] @var{epsilon}, @var{derivs}, @var{ss}, @var{numthreads})
+%! @anchor{particle/local_state_space_iteration_3}
+%! @sp 1
+%! Given the states (y) and structural innovations (epsilon), this routine computes the level of selected endogenous variables when the
+%! model is approximated by an order three taylor expansion around the deterministic steady state. Depending on the number of input/output
+%! argument the pruning algorithm of Andreasen, Fernández-Villaverde and Rubio-Ramírez (2018) is used or not.
+%!
+%! @sp 2
+%! @strong{Inputs}
+%! @sp 1
+%! @table @ @var
+%! @item yhat
+%! n*s matrix of doubles, initial condition (deviations from the steady state), where n is the number of state variables and s the number of particles. With pruning, first order part of the states.
+%! @item yhat_s
+%! n*s matrix of doubles, second order part of the states (pruning version only).
+%! @item yhat_rd
+%! n*s matrix of doubles, third order part of the states (pruning version only).
+%! @item epsilon
+%! q*s matrix of doubles, structural innovations.
+%! @item derivs
+%! structure of the folded derivatives of the decision rules (fields gy, gu, gyy, gyu, guu, gss, gyyy, gyyu, gyuu, guuu, gyss and guss), as returned by k_order_perturbation, where we only consider the lines corresponding to a subset of m endogenous variables.
+%! @item ss
+%! m*1 vector of doubles, steady state for the subset of endogenous variables.
+%! @item numthreads
+%! integer scalar, number of threads used by the mex file.
+%! @end table
+%! @sp 2
+%! @strong{Outputs}
+%! @sp 1
+%! @table @ @var
+%! @item y
+%! m*s matrix of doubles, selected endogenous variables.
+%! @item y_f
+%! m*s matrix of doubles, first order part of the selected endogenous variables (pruning version only).
+%! @item y_s
+%! m*s matrix of doubles, second order part of the selected endogenous variables (pruning version only).
+%! @item y_rd
+%! m*s matrix of doubles, third order part of the selected endogenous variables (pruning version only).
+%! @end table
+%! @sp 2
+%! @strong{Remarks}
+%! @sp 1
+%! [1] If the function has 7 input arguments then it must have 4 output arguments (pruning version).
+%! @sp 1
+%! [2] If the function has 5 input arguments then it must have 1 output argument.
+%! @sp 1
+%! [3] The columns of the folded derivatives correspond to the monomials with sorted indices (e.g. x(i)*x(j)*u(k) with i<=j for gyyu).
+%! @sp 2
+%! @strong{This function is called by:}
+%! @sp 2
+%! @strong{This function calls:}
+%!
+%!
+%! @end deftypefn
+%@eod:
+
+% Copyright (C) 2017 Dynare Team
+%
+% This file is part of Dynare.
+%
+% Dynare is free software: you can redistribute it and/or modify
+% it under the terms of the GNU General Public License as published by
+% the Free Software Foundation, either version 3 of the License, or
+% (at your option) any later version.
+%
+% Dynare is distributed in the hope that it will be useful,
+% but WITHOUT ANY WARRANTY; without even the implied warranty of
+% MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+% GNU General Public License for more details.
+%
+% You should have received a copy of the GNU General Public License
+% along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+
+if nargin==5
+    pruning = 0; epsilon = a; derivs = b; ss = c;
+    if nargout>1
+        error('local_state_space_iteration_3:: Numbers of input and output argument are inconsistent!')
+    end
+elseif nargin==7
+    pruning = 1; yhat_s = a; yhat_rd = b; epsilon = c; derivs = d; ss = e;
+    if nargout~=4
+        error('local_state_space_iteration_3:: Numbers of input and output argument are inconsistent!')
+    end
+else
+    error('local_state_space_iteration_3:: Wrong number of input arguments!')
+end
+
+x = yhat;
+u = epsilon;
+switch pruning
+  case 0
+    y = bsxfun(@plus, derivs.gy*x + derivs.gu*u + .5*(derivs.gyss*x + derivs.guss*u) ...
+               + derivs.gyy*monomials2(x) + derivs.gyu*kronecker(x,u) + derivs.guu*monomials2(u) ...
+               + derivs.gyyy*monomials3(x) + derivs.gyyu*monomials21(x,u) + derivs.gyuu*monomials12(x,u) ...
+               + derivs.guuu*monomials3(u), ss+.5*derivs.gss);
+  case 1
+    y_f = derivs.gy*x + derivs.gu*u;
+    y_s = bsxfun(@plus, derivs.gy*yhat_s + derivs.gyy*monomials2(x) + derivs.gyu*kronecker(x,u) ...
+                 + derivs.guu*monomials2(u), .5*derivs.gss);
+    y_rd = derivs.gy*yhat_rd + derivs.gyy*symmetric_product(x,yhat_s) + derivs.gyu*kronecker(yhat_s,u) ...
+           + derivs.gyyy*monomials3(x) + derivs.gyyu*monomials21(x,u) + derivs.gyuu*monomials12(x,u) ...
+           + derivs.guuu*monomials3(u) + .5*(derivs.gyss*x + derivs.guss*u);
+    y = bsxfun(@plus, y_f + y_s + y_rd, ss);
+end
+
+% The monomials below are weighted by their multiplicity divided by the factorial of their degree,
+% and ordered as the columns of the folded derivatives.
+
+function m = monomials2(x)
+n = size(x,1);
+m = zeros(n*(n+1)/2,size(x,2));
+l = 1;
+for i=1:n
+    for j=i:n
+        m(l,:) = (1-.5*(i==j))*x(i,:).*x(j,:);
+        l = l+1;
+    end
+end
+
+function m = monomials3(x)
+n = size(x,1);
+m = zeros(n*(n+1)*(n+2)/6,size(x,2));
+l = 1;
+for i=1:n
+    for j=i:n
+        for k=j:n
+            if i==k
+                w = 1/6;
+            elseif i==j || j==k
+                w = .5;
+            else
+                w = 1;
+            end
+            m(l,:) = w*x(i,:).*x(j,:).*x(k,:);
+            l = l+1;
+        end
+    end
+end
+
+function m = kronecker(x,u)
+[n,s] = size(x);
+q = size(u,1);
+m = reshape(bsxfun(@times, reshape(u,q,1,s), reshape(x,1,n,s)), n*q, s);
+
+function m = monomials21(x,u)
+m = kronecker(monomials2(x),u);
+
+function m = monomials12(x,u)
+m = kronecker(x,monomials2(u));
+
+function m = symmetric_product(x,z)
+n = size(x,1);
+m = zeros(n*(n+1)/2,size(x,2));
+l = 1;
+for i=1:n
+    for j=i:n
+        if i==j
+            m(l,:) = x(i,:).*z(i,:);
+        else
+            m(l,:) = x(i,:).*z(j,:)+x(j,:).*z(i,:);
+        end
+        l = l+1;
+    end
+end
+
+%@test:1
+%$ n = 2;
+%$ q = 3;
+%$ m = 4;
+%$ s = 5;
+%$
+%$ derivs.gy = rand(m,n); derivs.gu = rand(m,q);
+%$ derivs.gyy = rand(m,n*(n+1)/2); derivs.gyu = rand(m,n*q); derivs.guu = rand(m,q*(q+1)/2); derivs.gss = rand(m,1);
+%$ derivs.gyyy = rand(m,n*(n+1)*(n+2)/6); derivs.gyyu = rand(m,n*(n+1)/2*q); derivs.gyuu = rand(m,n*q*(q+1)/2);
+%$ derivs.guuu = rand(m,q*(q+1)*(q+2)/6); derivs.gyss = rand(m,n); derivs.guss = rand(m,q);
+%$ ss = ones(m,1);
+%$ yhat = zeros(n,s);
+%$ epsilon = zeros(q,s);
+%$
+%$ % Call the tested routine.
+%$ y1 = local_state_space_iteration_3(yhat,epsilon,derivs,ss,1);
+%$ [y2,y2_f,y2_s,y2_rd] = local_state_space_iteration_3(yhat,yhat,yhat,epsilon,derivs,ss,1);
+%$
+%$ % Check the results.
+%$ t(1) = dassert(y1,repmat(ss+.5*derivs.gss,1,s),1e-14);
+%$ t(2) = dassert(y2,y1,1e-14);
+%$ t(3) = dassert(y2_f,zeros(m,s));
+%$ t(4) = dassert(y2_s,repmat(.5*derivs.gss,1,s),1e-14);
+%$ t(5) = dassert(y2_rd,zeros(m,s));
+%$ T = all(t);
+%@eof:1
@@ -0,0 +1,144 @@
+function [yhat,weights,lik,resampled] = particle_filter_step(yhat,epsilon,ghx,ghu,constant,ghxx,ghuu,ghxu,weights,Y,mf0,mf1,H,ss,u,threshold,numthreads)
+
+%@info:
+%! @deftypefn {Function File} {@var{yhat}, @var{weights}, @var{lik}, @var{resampled} =} particle_filter_step (@var{yhat}, @var{epsilon}, @var{ghx}, @var{ghu}, @var{constant}, @var{ghxx}, @var{ghuu}, @var{ghxu}, @var{weights}, @var{Y}, @var{mf0}, @var{mf1}, @var{H}, @var{ss}, @var{u}, @var{threshold}, @var{numthreads})
+%! @anchor{particle/particle_filter_step}
+%! @sp 1
+%! Performs one period of a sequential importance particle filter, when the model is approximated by an order two taylor expansion around
+%! the deterministic steady state: propagation of the particles (see local_state_space_iteration_2), update and normalization of the weights
+%! with the Gaussian density of the measurement errors, and resampling of the particles if the effective sample size is too small.
+%!
+%! @sp 2
+%! @strong{Inputs}
+%! @sp 1
+%! @table @ @var
+%! @item yhat
+%! n*s matrix of doubles, time t particles (deviations from the steady state), where n is the number of state variables and s the number of particles.
+%! @item epsilon
+%! q*s matrix of doubles, structural innovations.
+%! @item ghx
+%! m*n matrix of doubles, restricted dr.ghx where we only consider the lines corresponding to a subset of the endogenous variables.
+%! @item ghu
+%! m*q matrix of doubles, restricted dr.ghu where we only consider the lines corresponding to a subset of the endogenous variables.
+%! @item constant
+%! m*1 vector of doubles, deterministic steady state plus second order correction for the union of the states and observed variables.
+%! @item ghxx
+%! m*n^2 matrix of doubles, restricted dr.ghxx where we only consider the lines corresponding to a subset of the endogenous variables.
+%! @item ghuu
+%! m*q^2 matrix of doubles, restricted dr.ghuu where we only consider the lines corresponding to a subset of the endogenous variables.
+%! @item ghxu
+%! m*nq matrix of doubles, subset of dr.ghxu where we only consider the lines corresponding to a subset of the endogenous variables.
+%! @item weights
+%! 1*s vector of doubles, time t weights of the particles.
+%! @item Y
+%! p*1 vector of doubles, time t+1 observations.
+%! @item mf0
+%! n*1 vector of integers, indices of the states in the union of the states and observed variables.
+%! @item mf1
+%! p*1 vector of integers, indices of the observed variables in the union of the states and observed variables.
+%! @item H
+%! p*p matrix of doubles, covariance matrix of the measurement errors (positive definite).
+%! @item ss
+%! n*1 vector of doubles, steady state of the states.
+%! @item u
+%! scalar (systematic resampling) or 1*s vector (stratified resampling) of uniform draws in [0,1).
+%! @item threshold
+%! scalar double, the particles are resampled if the effective sample size is below threshold*s.
+%! @item numthreads
+%! integer scalar, number of threads used by the mex file.
+%! @end table
+%! @sp 2
+%! @strong{Outputs}
+%! @sp 1
+%! @table @ @var
+%! @item yhat
+%! n*s matrix of doubles, time t+1 particles (deviations from the steady state).
+%! @item weights
+%! 1*s vector of doubles, time t+1 normalized weights of the particles.
+%! @item lik
+%! scalar double, log-likelihood of the time t+1 observations.
+%! @item resampled
+%! scalar double, 1 if the particles have been resampled, 0 otherwise.
+%! @end table
+%! @sp 2
+%! @strong{This function is called by:}
+%! @sp 2
+%! @strong{This function calls:}
+%! local_state_space_iteration_2
+%!
+%! @end deftypefn
+%@eod:
+
+% Copyright (C) 2017 Dynare Team
+%
+% This file is part of Dynare.
+%
+% Dynare is free software: you can redistribute it and/or modify
+% it under the terms of the GNU General Public License as published by
+% the Free Software Foundation, either version 3 of the License, or
+% (at your option) any later version.
+%
+% Dynare is distributed in the hope that it will be useful,
+% but WITHOUT ANY WARRANTY; without even the implied warranty of
+% MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+% GNU General Public License for more details.
+%
+% You should have received a copy of the GNU General Public License
+% along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+
+[L,info] = chol(H,'lower');
+if info
+    error('particle_filter_step:: The covariance matrix of the measurement errors is not positive definite!')
+end
+
+% Propagation of the particles
+y = local_state_space_iteration_2(yhat,epsilon,ghx,ghu,constant,ghxx,ghuu,ghxu,numthreads);
+
+% Update and normalization of the weights
+z = L\bsxfun(@minus,y(mf1,:),Y(:));
+lnw = log(weights(:)') - .5*(length(mf1)*log(2*pi) + 2*sum(log(diag(L))) + sum(z.*z,1));
+lnw_max = max(lnw);
+w = exp(lnw-lnw_max);
+lik = log(sum(w))+lnw_max;
+weights = w/sum(w);
+
+% Resampling of the particles if the effective sample size is too small
+s = size(yhat,2);
+resampled = 1/sum(weights.^2)<threshold*s;
+if resampled
+    positions = ((0:s-1)+u(:)')/s;
+    cumulated = cumsum(weights);
+    cumulated(end) = Inf;
+    indices = zeros(1,s);
+    i = 1;
+    for j=1:s
+        while cumulated(i)<positions(j)
+            i = i+1;
+        end
+        indices(j) = i;
+    end
+    y = y(:,indices);
+    weights = ones(1,s)/s;
+end
+yhat = bsxfun(@minus,y(mf0,:),ss(:));
+
+%@test:1
+%$ n = 2;
+%$ q = 2;
+%$ s = 100;
+%$
+%$ ghx = .5*eye(n); ghu = eye(q); constant = zeros(n,1);
+%$ ghxx = zeros(n,n*n); ghuu = zeros(n,q*q); ghxu = zeros(n,n*q);
+%$ yhat = zeros(n,s); epsilon = zeros(q,s);
+%$ weights = ones(1,s)/s;
+%$
+%$ % Call the tested routine.
+%$ [yhat1,weights1,lik1,resampled1] = particle_filter_step(yhat,epsilon,ghx,ghu,constant,ghxx,ghuu,ghxu,weights,[0;0],[1;2],[1;2],eye(2),zeros(n,1),.5,.5,1);
+%$
+%$ % Check the results: all the particles are at the steady state and have the same weight.
+%$ t(1) = dassert(yhat1,zeros(n,s));
+%$ t(2) = dassert(weights1,weights,1e-14);
+%$ t(3) = dassert(lik1,-log(2*pi),1e-14);
+%$ t(4) = dassert(resampled1,false);
+%$ T = all(t);
+%@eof:1
@@ -4,13 +4,13 @@ function set_dynare_threads(mexname,n)
 % other parallel library.
 %
 % INPUTS
-%  o mexname  [string]    Name of the mex file.
+%  o mexname  [string]    Name of the mex file, or 'all' for all the threaded mex files.
 %  o n        [integer]   scalar specifying the number of threads to be used.
 %
 % OUTPUTS
 %  none.
 
-% Copyright (C) 2009-2012 Dynare Team
+% Copyright (C) 2009-2017 Dynare Team
 %
 % This file is part of Dynare.
 %
@@ -37,12 +37,49 @@ if ~isint(n)
 end
 
 switch mexname
+  case 'all'
+    options_.threads.kronecker.A_times_B_kronecker_C = n;
+    options_.threads.kronecker.sparse_hessian_times_B_kronecker_C = n;
+    options_.threads.local_state_space_iteration_2 = n;
+    options_.threads.local_state_space_iteration_3 = n;
+    options_.threads.particle_filter_step = n;
+    options_.threads.mjdgges = n;
+    options_.threads.logposterior = n;
+    options_.threads.logMHMCMCposterior = n;
+    options_.threads.smc_posterior = n;
+    options_.threads.first_order_solutions = n;
+    options_.threads.particle_filter_likelihood = n;
+    options_.threads.bytecode = n;
+    options_.threads.bvar_engine = n;
+    options_.threads.conditional_forecast_engine = n;
   case 'A_times_B_kronecker_C'
     options_.threads.kronecker.A_times_B_kronecker_C = n;
   case 'sparse_hessian_times_B_kronecker_C'
     options_.threads.kronecker.sparse_hessian_times_B_kronecker_C = n;
   case 'local_state_space_iteration_2'
     options_.threads.local_state_space_iteration_2 = n;
+  case 'local_state_space_iteration_3'
+    options_.threads.local_state_space_iteration_3 = n;
+  case 'particle_filter_step'
+    options_.threads.particle_filter_step = n;
+  case 'mjdgges'
+    options_.threads.mjdgges = n;
+  case 'logposterior'
+    options_.threads.logposterior = n;
+  case 'logMHMCMCposterior'
+    options_.threads.logMHMCMCposterior = n;
+  case 'smc_posterior'
+    options_.threads.smc_posterior = n;
+  case 'first_order_solutions'
+    options_.threads.first_order_solutions = n;
+  case 'particle_filter_likelihood'
+    options_.threads.particle_filter_likelihood = n;
+  case 'bytecode'
+    options_.threads.bytecode = n;
+  case 'bvar_engine'
+    options_.threads.bvar_engine = n;
+  case 'conditional_forecast_engine'
+    options_.threads.conditional_forecast_engine = n;
   otherwise
     message = [ mexname ' is not a known parallel mex file.' ];
     message_id  = 'Dynare:Threads:UnknownParallelMex';
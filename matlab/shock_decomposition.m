@@ -93,31 +93,36 @@ for i=1:nshocks
     epsilon(i,:) = oo_.SmoothedShocks.(deblank(M_.exo_names(i,:)));
 end
 
-z = zeros(endo_nbr,nshocks+2,gend);
-
-z(:,end,:) = Smoothed_Variables_deviation_from_mean;
-
 maximum_lag = M_.maximum_lag;
 
 k2 = dr.kstate(find(dr.kstate(:,2) <= maximum_lag+1),[1 2]);
 i_state = order_var(k2(:,1))+(min(i,maximum_lag)+1-k2(:,2))*M_.endo_nbr;
-for i=1:gend
-    if i > 1 && i <= maximum_lag+1
-        lags = min(i-1,maximum_lag):-1:1;
-    end
-
-    if i > 1
-        tempx = permute(z(:,1:nshocks,lags),[1 3 2]);
-        m = min(i-1,maximum_lag);
-        tempx = [reshape(tempx,endo_nbr*m,nshocks); zeros(endo_nbr*(maximum_lag-i+1),nshocks)];
-        z(:,1:nshocks,i) = A(inv_order_var,:)*tempx(i_state,:);
-        lags = lags+1;
-    end
 
-    if i > options_.shock_decomp.init_state
-        z(:,1:nshocks,i) = z(:,1:nshocks,i) + B(inv_order_var,:).*repmat(epsilon(:,i)',endo_nbr,1);
+if maximum_lag == 1
+    z = fast_shock_decomposition(A(inv_order_var,:),B(inv_order_var,:),i_state,epsilon, ...
+                                 Smoothed_Variables_deviation_from_mean, ...
+                                 options_.shock_decomp.init_state);
+else
+    z = zeros(endo_nbr,nshocks+2,gend);
+    z(:,end,:) = Smoothed_Variables_deviation_from_mean;
+    for i=1:gend
+        if i > 1 && i <= maximum_lag+1
+            lags = min(i-1,maximum_lag):-1:1;
+        end
+
+        if i > 1
+            tempx = permute(z(:,1:nshocks,lags),[1 3 2]);
+            m = min(i-1,maximum_lag);
+            tempx = [reshape(tempx,endo_nbr*m,nshocks); zeros(endo_nbr*(maximum_lag-i+1),nshocks)];
+            z(:,1:nshocks,i) = A(inv_order_var,:)*tempx(i_state,:);
+            lags = lags+1;
+        end
+
+        if i > options_.shock_decomp.init_state
+            z(:,1:nshocks,i) = z(:,1:nshocks,i) + B(inv_order_var,:).*repmat(epsilon(:,i)',endo_nbr,1);
+        end
+        z(:,nshocks+1,i) = z(:,nshocks+2,i) - sum(z(:,1:nshocks,i),2);
     end
-    z(:,nshocks+1,i) = z(:,nshocks+2,i) - sum(z(:,1:nshocks,i),2);
 end
 
 oo_.shock_decomposition = z;
@@ -17,6 +17,7 @@
  * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include <cstring>
+#include <cstdlib>
 #include <cmath>
 #include <iostream>
 #include <fstream>
@@ -26,13 +27,34 @@
 #endif
 #include "block_kalman_filter.h"
 using namespace std;
-#define BLAS
-//#define CUBLAS
+
+#ifdef USE_OMP
+/* Number of threads given by the DYNARE_NUM_THREADS environment variable (by default, all the available threads) */
+int
+number_of_threads()
+{
+  const char *s = getenv("DYNARE_NUM_THREADS");
+  return s ? atoi(s) : omp_get_max_threads();
+}
+#endif
 
 #ifdef CUBLAS
-# include <cuda_runtime.h>
-# include <cublas_v2.h>
+/* Minimal number of state variables for which the covariance prediction is
+   done on the GPU (can be changed with the DYNARE_CUBLAS_MIN_STATES
+   environment variable) */
+const int default_cublas_min_states = 300;
 #endif
+
+/* The covariance prediction uses the sparse products when the density of the
+   columns of T associated to the state variables is below this value (can be
+   changed with the DYNARE_SPARSE_MAX_DENSITY environment variable) */
+double
+sparse_max_density()
+{
+  const char *s = getenv("DYNARE_SPARSE_MAX_DENSITY");
+  return s ? atof(s) : sparse_transition_max_density;
+}
+
 void
 mexDisp(mxArray *P)
 {
@@ -164,7 +186,7 @@ BlockKalmanFilter::BlockKalmanFilter(int nlhs, mxArray *plhs[], int nrhs, const
       if (!mxIsDouble(prhs[2]))
         DYN_MEX_FUNC_ERR_MSG_TXT("the third input argument of block_missing_observations_kalman_filter must be a scalar.");
       no_more_missing_observations = ceil(mxGetScalar(prhs[2]));
-      pT = mxDuplicateArray(prhs[3]);
+      pT = dense_copy(prhs[3]);
       pR = mxDuplicateArray(prhs[4]);
       pQ = mxDuplicateArray(prhs[5]);
       pH = mxDuplicateArray(prhs[6]);
@@ -181,7 +203,7 @@ BlockKalmanFilter::BlockKalmanFilter(int nlhs, mxArray *plhs[], int nrhs, const
   else
     {
       no_more_missing_observations = 0;
-      pT = mxDuplicateArray(prhs[0]);
+      pT = dense_copy(prhs[0]);
       pR = mxDuplicateArray(prhs[1]);
       pQ = mxDuplicateArray(prhs[2]);
       pH = mxDuplicateArray(prhs[3]);
@@ -248,27 +270,32 @@ BlockKalmanFilter::BlockKalmanFilter(int nlhs, mxArray *plhs[], int nrhs, const
   pi = atan2((double) 0.0, (double) -1.0);
 
   /*compute QQ = R*Q*transpose(R)*/                        // Variance of R times the vector of structural innovations.;
-  // tmp = R * Q;
-  for (int i = 0; i < n; i++)
-    for (int j = 0; j < n_shocks; j++)
-      {
-        double res = 0.0;
-        for (int k = 0; k < n_shocks; k++)
-          res += R[i + k * n] * Q[j * n_shocks + k];
-        tmp1[i + j * n] = res;
-      }
-
-  // QQ = tmp * transpose(R)
   pQQ = mxCreateDoubleMatrix(n, n, mxREAL);
   QQ = mxGetPr(pQQ);
+  double one = 1.0;
+  double zero = 0.0;
+  blas_int n_b = n, n_shocks_b = n_shocks;
+  lapack_int n_shocks_l = n_shocks, chol_info;
+  double *L = (double *) mxMalloc(n_shocks * n_shocks * sizeof(double));
+  memcpy(L, Q, n_shocks * n_shocks * sizeof(double));
+  dpotrf("L", &n_shocks_l, L, &n_shocks_l, &chol_info);
+  if (chol_info == 0)
+    {
+      // Q = L*transpose(L), hence QQ = (R*L)*transpose(R*L) is a symmetric rank-n_shocks product
+      memcpy(tmp1, R, n * n_shocks * sizeof(double));
+      dtrmm("R", "L", "N", "N", &n_b, &n_shocks_b, &one, L, &n_shocks_b, tmp1, &n_b);
+      dsyrk("U", "N", &n_b, &n_shocks_b, &one, tmp1, &n_b, &zero, QQ, &n_b);
+    }
+  else
+    {
+      // Q is only positive semidefinite: tmp = R * Q; QQ = tmp * transpose(R)
+      dsymm("R", "U", &n_b, &n_shocks_b, &one, Q, &n_shocks_b, R, &n_b, &zero, tmp1, &n_b);
+      dgemm("N", "T", &n_b, &n_b, &n_shocks_b, &one, tmp1, &n_b, R, &n_b, &zero, QQ, &n_b);
+    }
   for (int i = 0; i < n; i++)
-    for (int j = i; j < n; j++)
-      {
-        double res = 0.0;
-        for (int k = 0; k < n_shocks; k++)
-          res += tmp1[i + k * n] * R[k * n + j];
-        QQ[i + j * n] = QQ[j + i * n] = res;
-      }
+    for (int j = i + 1; j < n; j++)
+      QQ[j + i * n] = QQ[i + j * n];
+  mxFree(L);
   mxDestroyArray(p_tmp1);
 
   pv = mxCreateDoubleMatrix(pp, 1, mxREAL);
@@ -282,20 +309,6 @@ BlockKalmanFilter::BlockKalmanFilter(int nlhs, mxArray *plhs[], int nrhs, const
   iw = (lapack_int *) mxMalloc(pp * sizeof(lapack_int));
   ipiv = (lapack_int *) mxMalloc(pp * sizeof(lapack_int));
   info = 0;
-#if defined(BLAS) || defined(CUBLAS)
-  p_tmp = mxCreateDoubleMatrix(n, n, mxREAL);
-  *tmp = mxGetPr(p_tmp);
-  p_P_t_t1 = mxCreateDoubleMatrix(n, n, mxREAL);
-  *P_t_t1 = mxGetPr(p_P_t_t1);
-  pK = mxCreateDoubleMatrix(n, n, mxREAL);
-  *K = mxGetPr(pK);
-  p_K_P = mxCreateDoubleMatrix(n, n, mxREAL);
-  *K_P = mxGetPr(p_K_P);
-  oldK  = (double *) mxMalloc(n * n * sizeof(double));
-  *P_mf = (double *) mxMalloc(n * n * sizeof(double));
-  for (int i = 0; i < n  * n; i++)
-    oldK[i] = Inf;
-#else
   p_tmp = mxCreateDoubleMatrix(n, n_state, mxREAL);
   *tmp = mxGetPr(p_tmp);
   p_P_t_t1 = mxCreateDoubleMatrix(n_state, n_state, mxREAL);
@@ -308,14 +321,149 @@ BlockKalmanFilter::BlockKalmanFilter(int nlhs, mxArray *plhs[], int nrhs, const
   *P_mf = (double *) mxMalloc(n * pp * sizeof(double));
   for (int i = 0; i < n  * pp; i++)
     oldK[i] = Inf;
+
+  /* The columns of T associated to the pure observed variables are zero, and
+     the other ones are block sparse in large models */
+  T_sparse.compress(T + pure_obs * n, n, n, n_state);
+  sparse_T = T_sparse.isSparse(sparse_max_density());
+
+#ifdef CUBLAS
+  use_cublas = false;
+  const char *min_states = getenv("DYNARE_CUBLAS_MIN_STATES");
+  int device_count = 0;
+  if (!sparse_T && n_state >= (min_states ? atoi(min_states) : default_cublas_min_states)
+      && cudaGetDeviceCount(&device_count) == cudaSuccess && device_count > 0)
+    use_cublas = init_cublas();
 #endif
 }
 
+/* Returns a full copy of A, which can be a sparse matrix */
+mxArray *
+BlockKalmanFilter::dense_copy(const mxArray *A)
+{
+  if (!mxIsSparse(A))
+    return mxDuplicateArray(A);
+  size_t m = mxGetM(A), nc = mxGetN(A);
+  mxArray *B = mxCreateDoubleMatrix(m, nc, mxREAL);
+  double *b = mxGetPr(B), *a = mxGetPr(A);
+  mwIndex *ir = mxGetIr(A), *jc = mxGetJc(A);
+  for (size_t j = 0; j < nc; j++)
+    for (mwIndex k = jc[j]; k < jc[j+1]; k++)
+      b[ir[k] + j * m] = a[k];
+  return B;
+}
+
+void
+BlockKalmanFilter::update_covariance(const double *K, const double *P_mf, double *P_t_t1, const double *P)
+{
+  //P_t_t1 = P(s,s) - K(s,:)*P(mf,s), where s are the state variables
+  for (int j = 0; j < n_state; j++)
+    memcpy(P_t_t1 + j * n_state, P + pure_obs + (j + pure_obs) * n, n_state * sizeof(double));
+  double one = 1.0;
+  double minus_one = -1.0;
+  blas_int n_b = n, n_state_b = n_state, size_d_index_b = size_d_index;
+  dgemm("N", "N", &n_state_b, &n_state_b, &size_d_index_b, &minus_one, K + pure_obs, &n_b,
+        P_mf + pure_obs * size_d_index, &size_d_index_b, &one, P_t_t1, &n_state_b);
+}
+
+void
+BlockKalmanFilter::predict_covariance(const double *P_t_t1, double *tmp, double *P)
+{
+  //P = T*P_t_t1*transpose(T)+QQ, where only the columns of T corresponding to the state variables are non zero
+  bool done = false;
+  if (sparse_T)
+    {
+#ifdef USE_OMP
+      int numthreads = number_of_threads();
+#else
+      int numthreads = 1;
+#endif
+      T_sparse.symmetricProduct(P_t_t1, n_state, QQ, n, P, n, tmp, numthreads);
+      return;
+    }
+#ifdef CUBLAS
+  if (use_cublas)
+    {
+      done = predict_covariance_cublas(P_t_t1, P);
+      if (!done)
+        {
+          mexPrintf("block_kalman_filter: cuBLAS failure, falling back on BLAS\n");
+          free_cublas();
+          use_cublas = false;
+        }
+    }
+#endif
+  if (!done)
+    {
+      double one = 1.0;
+      double zero = 0.0;
+      blas_int n_b = n, n_state_b = n_state;
+      const double *T_s = T + pure_obs * n;
+      dsymm("R", "U", &n_b, &n_state_b, &one, P_t_t1, &n_state_b, T_s, &n_b, &zero, tmp, &n_b);
+      memcpy(P, QQ, n * n * sizeof(double));
+      dgemm("N", "T", &n_b, &n_b, &n_state_b, &one, tmp, &n_b, T_s, &n_b, &one, P, &n_b);
+    }
+  for (int i = 0; i < n; i++)
+    for (int j = i + 1; j < n; j++)
+      P[j + i * n] = P[i + j * n];
+}
+
+#ifdef CUBLAS
+bool
+BlockKalmanFilter::init_cublas()
+{
+  d_T = d_QQ = d_P = d_tmp = d_P_t_t1 = NULL;
+  if (cublasCreate(&cublas_handle) != CUBLAS_STATUS_SUCCESS)
+    return false;
+  if (cudaMalloc((void **) &d_T, n * n * sizeof(double)) != cudaSuccess
+      || cudaMalloc((void **) &d_QQ, n * n * sizeof(double)) != cudaSuccess
+      || cudaMalloc((void **) &d_P, n * n * sizeof(double)) != cudaSuccess
+      || cudaMalloc((void **) &d_tmp, n * n_state * sizeof(double)) != cudaSuccess
+      || cudaMalloc((void **) &d_P_t_t1, n_state * n_state * sizeof(double)) != cudaSuccess
+      || cublasSetMatrix(n, n, sizeof(double), T, n, d_T, n) != CUBLAS_STATUS_SUCCESS
+      || cublasSetMatrix(n, n, sizeof(double), QQ, n, d_QQ, n) != CUBLAS_STATUS_SUCCESS)
+    {
+      free_cublas();
+      return false;
+    }
+  return true;
+}
+
+void
+BlockKalmanFilter::free_cublas()
+{
+  cudaFree(d_T);
+  cudaFree(d_QQ);
+  cudaFree(d_P);
+  cudaFree(d_tmp);
+  cudaFree(d_P_t_t1);
+  cublasDestroy(cublas_handle);
+}
+
+bool
+BlockKalmanFilter::predict_covariance_cublas(const double *P_t_t1, double *P)
+{
+  // T and QQ are kept on the device, only P_t_t1 and P are transferred at each period
+  double one = 1.0;
+  double zero = 0.0;
+  double *d_T_s = d_T + pure_obs * n;
+  return cublasSetMatrix(n_state, n_state, sizeof(double), P_t_t1, n_state, d_P_t_t1, n_state) == CUBLAS_STATUS_SUCCESS
+    && cudaMemcpy(d_P, d_QQ, n * n * sizeof(double), cudaMemcpyDeviceToDevice) == cudaSuccess
+    && cublasDsymm(cublas_handle, CUBLAS_SIDE_RIGHT, CUBLAS_FILL_MODE_UPPER, n, n_state,
+                   &one, d_P_t_t1, n_state, d_T_s, n, &zero, d_tmp, n) == CUBLAS_STATUS_SUCCESS
+    && cublasDgemm(cublas_handle, CUBLAS_OP_N, CUBLAS_OP_T, n, n, n_state,
+                   &one, d_tmp, n, d_T_s, n, &one, d_P, n) == CUBLAS_STATUS_SUCCESS
+    && cublasGetMatrix(n, n, sizeof(double), d_P, n, P, n) == CUBLAS_STATUS_SUCCESS;
+}
+#endif
+
 void
 BlockKalmanFilter::block_kalman_filter_ss(double *P_mf, double *v_pp, double *K, double *v_n, double *a, double *K_P, double *P_t_t1, double *tmp, double *P)
 {
   if (t+1 < smpl)
     {
+      INSTRUMENT_SCOPE("steady_state");
+      INSTRUMENT_COUNT("steady_state_periods", smpl-t);
       while (t < smpl)
         {
           //v = Y(:,t)-a(mf);
@@ -362,6 +510,9 @@ BlockKalmanFilter::block_kalman_filter_ss(double *P_mf, double *v_pp, double *K,
 bool
 BlockKalmanFilter::block_kalman_filter(int nlhs, mxArray *plhs[], double *P_mf, double *v_pp, double *K, double *v_n, double *a, double *K_P, double *P_t_t1, double *tmp, double *P)
 {
+  // The time spent in the steady state iterations is recorded in a nested scope
+  INSTRUMENT_SCOPE("filter");
+  int t0 = t;
   while (notsteady && t < smpl)
     {
       if (missing_observations)
@@ -379,7 +530,7 @@ BlockKalmanFilter::block_kalman_filter(int nlhs, mxArray *plhs[], double *P_mf,
 
           //v = Y(:,t) - a(mf)
           int i_i = 0;
-          //#pragma omp parallel for shared(v, i_i, d_index) num_threads(atoi(getenv("DYNARE_NUM_THREADS")))
+          //#pragma omp parallel for shared(v, i_i, d_index) num_threads(number_of_threads())
           for (vector<int>::const_iterator i = d_index.begin(); i != d_index.end(); i++)
             {
               //mexPrintf("i_i=%d, omp_get_max_threads()=%d\n",i_i,omp_get_max_threads());
@@ -391,7 +542,7 @@ BlockKalmanFilter::block_kalman_filter(int nlhs, mxArray *plhs[], double *P_mf,
           i_i = 0;
           if (H_size == 1)
             {
-              //#pragma omp parallel for shared(iF, F, i_i) num_threads(atoi(getenv("DYNARE_NUM_THREADS")))
+              //#pragma omp parallel for shared(iF, F, i_i) num_threads(number_of_threads())
               for (vector<int>::const_iterator i = d_index.begin(); i != d_index.end(); i++, i_i++)
                 {
                   int j_j = 0;
@@ -401,7 +552,7 @@ BlockKalmanFilter::block_kalman_filter(int nlhs, mxArray *plhs[], double *P_mf,
             }
           else
             {
-              //#pragma omp parallel for shared(iF, F, P, H, mf, i_i) num_threads(atoi(getenv("DYNARE_NUM_THREADS")))
+              //#pragma omp parallel for shared(iF, F, P, H, mf, i_i) num_threads(number_of_threads())
               for (vector<int>::const_iterator i = d_index.begin(); i != d_index.end(); i++, i_i++)
                 {
                   int j_j = 0;
@@ -477,36 +628,9 @@ BlockKalmanFilter::block_kalman_filter(int nlhs, mxArray *plhs[], double *P_mf,
             memcpy(a, tmp_a, n * sizeof(double));
 
             //P = T*P*transpose(T)+QQ;
-            memset(tmp, 0, n * n_state * sizeof(double));
-
-            for (int i = 0; i < n; i++)
-              for (int j = pure_obs; j < n; j++)
-                {
-                  int j1 = j - pure_obs;
-                  int j1_n_state = j1 * n_state - pure_obs;
-                  for (int k = pure_obs; k < i_nz_state_var[i]; k++)
-                    tmp[i + j1 * n ] += T[i + k * n] * P[k + j1_n_state];
-                }
-
-            memset(P, 0, n * n * sizeof(double));
-            int n_n_obs = n * pure_obs;
-            for (int i = 0; i < n; i++)
-              for (int j = i; j < n; j++)
-                {
-                  for (int k = pure_obs; k < i_nz_state_var[j]; k++)
-                    {
-                      int k_n = k * n;
-                      P[i * n + j] += tmp[i + k_n - n_n_obs] * T[j + k_n];
-                    }
-                }
-
-            for (int i = 0; i < n; i++)
-              {
-                for (int j = i; j < n; j++)
-                  P[j + i * n] += QQ[j + i * n];
-                for (int j = i + 1; j < n; j++)
-                  P[i + j * n] = P[j + i * n];
-              }
+            for (int j = 0; j < n_state; j++)
+              memcpy(P_t_t1 + j * n_state, P + pure_obs + (j + pure_obs) * n, n_state * sizeof(double));
+            predict_covariance(P_t_t1, tmp, P);
           }
       else
         {
@@ -523,7 +647,7 @@ BlockKalmanFilter::block_kalman_filter(int nlhs, mxArray *plhs[], double *P_mf,
 
           //lik(t) = log(dF)+transpose(v)*iF*v;
 #ifdef USE_OMP
-# pragma omp parallel for shared(v_pp) num_threads(atoi(getenv("DYNARE_NUM_THREADS")))
+# pragma omp parallel for shared(v_pp) num_threads(number_of_threads())
 #endif
           for (int i = 0; i < size_d_index; i++)
             {
@@ -544,7 +668,7 @@ BlockKalmanFilter::block_kalman_filter(int nlhs, mxArray *plhs[], double *P_mf,
             {
               //K      = P(:,mf)*iF;
 #ifdef USE_OMP
-# pragma omp parallel for shared(P_mf) num_threads(atoi(getenv("DYNARE_NUM_THREADS")))
+# pragma omp parallel for shared(P_mf) num_threads(number_of_threads())
 #endif
               for (int i = 0; i < n; i++)
                 {
@@ -562,22 +686,14 @@ BlockKalmanFilter::block_kalman_filter(int nlhs, mxArray *plhs[], double *P_mf,
                   P_mf[i + j * n] = P[i + mf[j] * n];
             }
 
-#ifdef USE_OMP
-# pragma omp parallel for shared(K) num_threads(atoi(getenv("DYNARE_NUM_THREADS")))
-#endif
-          for (int i = 0; i < n; i++)
-            for (int j = 0; j < size_d_index; j++)
-              {
-                double res = 0.0;
-                int j_pp = j * size_d_index;
-                for (int k = 0; k < size_d_index; k++)
-                  res += P_mf[i + k * n] * iF[j_pp + k];
-                K[i + j * n] = res;
-              }
+          double one = 1.0;
+          double zero = 0.0;
+          blas_int n_b = n;
+          dgemm("N", "N", &n_b, &size_d_index, &size_d_index, &one, P_mf, &n_b, iF, &size_d_index, &zero, K, &n_b);
 
           //a      = T*(a+K*v);
 #ifdef USE_OMP
-# pragma omp parallel for shared(v_n) num_threads(atoi(getenv("DYNARE_NUM_THREADS")))
+# pragma omp parallel for shared(v_n) num_threads(number_of_threads())
 #endif
           for (int i = pure_obs; i < n; i++)
             {
@@ -588,7 +704,7 @@ BlockKalmanFilter::block_kalman_filter(int nlhs, mxArray *plhs[], double *P_mf,
             }
 
 #ifdef USE_OMP
-# pragma omp parallel for shared(a) num_threads(atoi(getenv("DYNARE_NUM_THREADS")))
+# pragma omp parallel for shared(a) num_threads(number_of_threads())
 #endif
           for (int i = 0; i < n; i++)
             {
@@ -602,7 +718,7 @@ BlockKalmanFilter::block_kalman_filter(int nlhs, mxArray *plhs[], double *P_mf,
             {
               //P      = T*(P-K*P(mf,:))*transpose(T)+QQ;
               int i_i = 0;
-              //#pragma omp parallel for shared(P_mf) num_threads(atoi(getenv("DYNARE_NUM_THREADS")))
+              //#pragma omp parallel for shared(P_mf) num_threads(number_of_threads())
               for (vector<int>::const_iterator i = d_index.begin(); i != d_index.end(); i++, i_i++)
                 for (int j = pure_obs; j < n; j++)
                   P_mf[i_i + j * size_d_index] = P[mf[*i] + j * n];
@@ -611,238 +727,15 @@ BlockKalmanFilter::block_kalman_filter(int nlhs, mxArray *plhs[], double *P_mf,
             {
               //P      = T*(P-K*P(mf,:))*transpose(T)+QQ;
 #ifdef USE_OMP
-# pragma omp parallel for shared(P_mf) num_threads(atoi(getenv("DYNARE_NUM_THREADS")))
+# pragma omp parallel for shared(P_mf) num_threads(number_of_threads())
 #endif
               for (int i = 0; i < pp; i++)
                 for (int j = pure_obs; j < n; j++)
                   P_mf[i + j * pp] = P[mf[i] + j * n];
             }
 
-#ifdef BLAS
-# ifdef USE_OMP
-#  pragma omp parallel for shared(K_P) num_threads(atoi(getenv("DYNARE_NUM_THREADS")))
-# endif
-          for (int i = 0; i < n; i++)
-            for (int j = i; j < n; j++)
-              {
-                double res = 0.0;
-                //int j_pp = j * pp;
-                for (int k = 0; k < size_d_index; k++)
-                  res += K[i + k * n] * P_mf[k + j * size_d_index];
-                K_P[i * n + j] = K_P[j * n + i] = res;
-              }
-          //#pragma omp parallel for shared(P, K_P, P_t_t1)
-          for (int i = size_d_index; i < n; i++)
-            for (int j = i; j < n; j++)
-              {
-                unsigned int k = i * n + j;
-                P_t_t1[j * n + i] = P_t_t1[k] = P[k] - K_P[k];
-              }
-          double one  = 1.0;
-          double zero = 0.0;
-          memcpy(P, QQ, n * n *sizeof(double));
-          blas_int n_b = n;
-          /*mexPrintf("sizeof(n_b)=%d, n_b=%d, sizeof(n)=%d, n=%d\n",sizeof(n_b),n_b,sizeof(n),n);
-            mexEvalString("drawnow;");*/
-          dsymm("R", "U", &n_b, &n_b,
-                &one, P_t_t1, &n_b,
-                T, &n_b, &zero,
-                tmp, &n_b);
-          dgemm("N", "T", &n_b, &n_b,
-                &n_b, &one, tmp, &n_b,
-                T, &n_b, &one,
-                P, &n_b);
-#else
-# ifdef CUBLAS
-          for (int i = 0; i < n; i++)
-            for (int j = i; j < n; j++)
-              {
-                double res = 0.0;
-                //int j_pp = j * pp;
-                for (int k = 0; k < size_d_index; k++)
-                  res += K[i + k * n] * P_mf[k + j * size_d_index];
-                K_P[i * n + j] = K_P[j * n + i] = res;
-              }
-          //#pragma omp parallel for shared(P, K_P, P_t_t1)
-          for (int i = size_d_index; i < n; i++)
-            for (int j = i; j < n; j++)
-              {
-                unsigned int k = i * n + j;
-                P_t_t1[j * n + i] = P_t_t1[k] = P[k] - K_P[k];
-              }
-          mexPrintf("CudaBLAS\n");
-          mexEvalString("drawnow;");
-          double one  = 1.0;
-          double zero = 0.0;
-          cublasStatus_t status;
-          cublasHandle_t handle;
-          status = cublasCreate(&handle);
-          if (status != CUBLAS_STATUS_SUCCESS)
-            {
-              mexPrintf("!!!! CUBLAS initialization error\n");
-              return false;
-            }
-          /*int device;
-            cudaGetDevice(&device);*/
-          int n2 = n * n;
-          double *d_A = 0;
-          double *d_B = 0;
-          double *d_C = 0;
-          double *d_D = 0;
-          // Allocate device memory for the matrices
-          if (cudaMalloc((void **) &d_A, n2 * sizeof(double)) != cudaSuccess)
-            {
-              mexPrintf("!!!! device memory allocation error (allocate A)\n");
-              return false;
-            }
-          if (cudaMalloc((void **) &d_B, n2 * sizeof(d_B[0])) != cudaSuccess)
-            {
-              mexPrintf("!!!! device memory allocation error (allocate B)\n");
-              return false;
-            }
-          if (cudaMalloc((void **) &d_C, n2 * sizeof(d_C[0])) != cudaSuccess)
-            {
-              mexPrintf("!!!! device memory allocation error (allocate C)\n");
-              return false;
-            }
-          if (cudaMalloc((void **) &d_D, n2 * sizeof(d_D[0])) != cudaSuccess)
-            {
-              mexPrintf("!!!! device memory allocation error (allocate D)\n");
-              return false;
-            }
-          // Initialize the device matrices with the host matrices
-          status = cublasSetVector(n2, sizeof(P_t_t1[0]), P_t_t1, 1, d_A, 1);
-          if (status != CUBLAS_STATUS_SUCCESS)
-            {
-              mexPrintf("!!!! device access error (write A)\n");
-              return false;
-            }
-          status = cublasSetVector(n2, sizeof(T[0]), T, 1, d_B, 1);
-          if (status != CUBLAS_STATUS_SUCCESS)
-            {
-              mexPrintf("!!!! device access error (write B)\n");
-              return false;
-            }
-          status = cublasSetVector(n2, sizeof(tmp[0]), tmp, 1, d_C, 1);
-          if (status != CUBLAS_STATUS_SUCCESS)
-            {
-              mexPrintf("!!!! device access error (write C)\n");
-              return false;
-            }
-          mexPrintf("just before calling\n");
-          mexEvalString("drawnow;");
-          status = cublasSetVector(n2, sizeof(QQ[0]), QQ, 1, d_D, 1);
-          if (status != CUBLAS_STATUS_SUCCESS)
-            {
-              mexPrintf("!!!! device access error (write D)\n");
-              return false;
-            }
-
-          // Performs operation using plain C code
-
-          cublasDsymm(handle, CUBLAS_SIDE_RIGHT, CUBLAS_FILL_MODE_UPPER, n, n,
-                      &one, d_A, n,
-                      d_B, n, &zero,
-                      d_C, n);
-          /*dgemm("N", "T", &n_b, &n_b,
-            &n_b, &one, tmp, &n_b,
-            T, &n_b, &one,
-            P, &n_b);*/
-          cublasDgemm(handle, CUBLAS_OP_N, CUBLAS_OP_T, n, n,
-                      n, &one, d_C, n,
-                      d_B, n, &one,
-                      d_D, n);
-          //double_symm(n, &one, h_A, h_B, &zero, h_C);
-
-          status = cublasGetVector(n2, sizeof(P[0]), d_D, 1, P, 1);
-          if (status != CUBLAS_STATUS_SUCCESS)
-            {
-              mexPrintf("!!!! device access error (read P)\n");
-              return false;
-            }
-
-# else
-#  ifdef USE_OMP
-#   pragma omp parallel for shared(K_P) num_threads(atoi(getenv("DYNARE_NUM_THREADS")))
-#  endif
-          for (int i = pure_obs; i < n; i++)
-            {
-              unsigned int i1 = i - pure_obs;
-              for (int j = i; j < n; j++)
-                {
-                  unsigned int j1 = j - pure_obs;
-                  double res = 0.0;
-                  int j_pp = j * size_d_index;
-                  for (int k = 0; k < size_d_index; k++)
-                    res += K[i + k * n] * P_mf[k + j_pp];
-                  K_P[i1 * n_state + j1] = K_P[j1 * n_state + i1] = res;
-                }
-            }
-
-#  ifdef USE_OMP
-#   pragma omp parallel for shared(P_t_t1) num_threads(atoi(getenv("DYNARE_NUM_THREADS")))
-#  endif
-          for (int i = pure_obs; i < n; i++)
-            {
-              unsigned int i1 = i - pure_obs;
-              for (int j = i; j < n; j++)
-                {
-                  unsigned int j1 = j - pure_obs;
-                  unsigned int k1 = i1 * n_state + j1;
-                  P_t_t1[j1 * n_state + i1] = P_t_t1[k1] = P[i * n + j] - K_P[k1];
-                }
-            }
-
-          memset(tmp, 0, n * n_state * sizeof(double));
-
-#  ifdef USE_OMP
-#   pragma omp parallel for shared(tmp) num_threads(atoi(getenv("DYNARE_NUM_THREADS")))
-#  endif
-          for (int i = 0; i < n; i++)
-            {
-              int max_k = i_nz_state_var[i];
-              for (int j = pure_obs; j < n; j++)
-                {
-                  int j1 = j - pure_obs;
-                  int j1_n_state = j1 * n_state - pure_obs;
-                  int indx_tmp = i + j1 * n;
-                  for (int k = pure_obs; k < max_k; k++)
-                    tmp[indx_tmp] += T[i + k * n] * P_t_t1[k + j1_n_state];
-                }
-            }
-
-          memset(P, 0, n * n * sizeof(double));
-
-          int n_n_obs = -n * pure_obs;
-#  ifdef USE_OMP
-#   pragma omp parallel for shared(P) num_threads(atoi(getenv("DYNARE_NUM_THREADS")))
-#  endif
-          for (int i = 0; i < n; i++)
-            {
-              for (int j = i; j < n; j++)
-                {
-                  int max_k = i_nz_state_var[j];
-                  int P_indx = i * n + j;
-                  for (int k = pure_obs; k < max_k; k++)
-                    {
-                      int k_n = k * n;
-                      P[P_indx] += tmp[i + k_n + n_n_obs] * T[j + k_n];
-                    }
-                }
-            }
-
-#  ifdef USE_OMP
-#   pragma omp parallel for shared(P) num_threads(atoi(getenv("DYNARE_NUM_THREADS")))
-#  endif
-          for (int i = 0; i < n; i++)
-            {
-              for (int j = i; j < n; j++)
-                P[j + i * n] += QQ[j + i * n];
-              for (int j = i + 1; j < n; j++)
-                P[i + j * n] = P[j + i * n];
-            }
-# endif
-#endif
+          update_covariance(K, P_mf, P_t_t1, P);
+          predict_covariance(P_t_t1, tmp, P);
           if (t >= no_more_missing_observations)
             {
               double max_abs = 0.0;
@@ -861,6 +754,7 @@ BlockKalmanFilter::block_kalman_filter(int nlhs, mxArray *plhs[], double *P_mf,
         }
       t++;
     }
+  INSTRUMENT_COUNT("riccati_periods", t-t0);
 
   if (F_singular)
     mexErrMsgTxt("The variance of the forecast error remains singular until the end of the sample\n");
@@ -906,11 +800,19 @@ BlockKalmanFilter::return_results_and_clean(int nlhs, mxArray *plhs[], double *P
   mxDestroyArray(p_P_t_t1);
   mxDestroyArray(pK);
   mxDestroyArray(p_K_P);
+#ifdef CUBLAS
+  if (use_cublas)
+    free_cublas();
+#endif
 }
 
 void
 mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 {
+  if (Instrumentation::mexCommand("block_kalman_filter", nlhs, plhs, nrhs, prhs))
+    return;
+  INSTRUMENT_SCOPE("block_kalman_filter");
+
   double *P_mf, *v_pp, *v_n, *a, *K, *K_P, *P_t_t1, *tmp, *P;
   BlockKalmanFilter block_kalman_filter(nlhs, plhs, nrhs, prhs, &P_mf, &v_pp, &K, &v_n, &a, &K_P, &P_t_t1, &tmp, &P);
   if (block_kalman_filter.block_kalman_filter(nlhs, plhs, P_mf, v_pp, K, K_P, a, K_P, P_t_t1, tmp, P))
@@ -28,6 +28,13 @@
 
 #include <dynblas.h>
 #include <dynlapack.h>
+#include <sparse_transition.hh>
+#include <instrumentation.hh>
+
+#ifdef CUBLAS
+# include <cuda_runtime.h>
+# include <cublas_v2.h>
+#endif
 using namespace std;
 
 class BlockKalmanFilter
@@ -54,6 +61,23 @@ public:
   vector<int> d_index;
   const mxArray *pd_index;
   double *dd_index;
+  SparseTransition T_sparse;
+  bool sparse_T;
+#ifdef CUBLAS
+  bool use_cublas;
+  cublasHandle_t cublas_handle;
+  double *d_T, *d_QQ, *d_P, *d_tmp, *d_P_t_t1;
+#endif
+
+private:
+  mxArray *dense_copy(const mxArray *A);
+  void update_covariance(const double *K, const double *P_mf, double *P_t_t1, const double *P);
+  void predict_covariance(const double *P_t_t1, double *tmp, double *P);
+#ifdef CUBLAS
+  bool init_cublas();
+  void free_cublas();
+  bool predict_covariance_cublas(const double *P_t_t1, double *P);
+#endif
 
 public:
   BlockKalmanFilter(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[], double *P_mf[], double *v_pp[], double *K[], double *v_n[], double *a[], double *K_P[], double *P_t_t1[], double *tmp[], double *P[]);
@@ -326,7 +326,9 @@ public:
   map<pair<unsigned int, unsigned int>, double > TEFD;
   map<pair<unsigned int, pair<unsigned int, unsigned int> >, double > TEFDD;
 
+  //! Location of the expression being evaluated, decoded from it_code_expr by decode_expression_location()
   ExpressionType EQN_type;
+  //! FNUMEXPR instruction of the expression being evaluated, the only location kept by the interpreters
   it_code_type it_code_expr;
   /*unsigned int*/ size_t nb_endo, nb_exo, nb_param;
   char *P_endo_names, *P_exo_names, *P_param_names;
@@ -338,7 +340,7 @@ public:
   inline
   ErrorMsg()
   {
-    mxArray *M_ = mexGetVariable("global", "M_");
+    mxArray *M_ = const_cast<mxArray *>(mexGetVariablePtr("global", "M_"));
     if (mxGetFieldNumber(M_, "endo_names") == -1)
       {
         nb_endo = 0;
@@ -497,9 +499,24 @@ public:
     return (res.str());
   }
 
+  //! Decodes the FNUMEXPR instruction it_code_expr of the expression being evaluated
+  inline void
+  decode_expression_location()
+  {
+    if (it_code_expr->first != FNUMEXPR)
+      return;
+    FNUMEXPR_ *expr = (FNUMEXPR_ *) it_code_expr->second;
+    EQN_type = expr->get_expression_type();
+    EQN_equation = expr->get_equation();
+    EQN_dvar1 = expr->get_dvariable1();
+    EQN_dvar2 = expr->get_dvariable2();
+    EQN_dvar3 = expr->get_dvariable3();
+  }
+
   inline string
   error_location(bool evaluate, bool steady_state, int size, int block_num, int it_, int Per_u_)
   {
+    decode_expression_location();
     stringstream Error_loc("");
     if (!steady_state)
       switch (EQN_type)
@@ -767,6 +784,42 @@ public:
                 mexPrintf("FLDV: Unknown variable type\n");
               }
             break;
+          case FLDY:
+            var = ((FLDY_ *) it_code->second)->get_pos();
+            lag = (((FLDY_ *) it_code->second)->get_offset() - var) / y_size;
+            tmp_out.str("");
+            if (lag > 0)
+              tmp_out << get_variable(eEndogenous, var) << "(+" << lag << ")";
+            else if (lag < 0)
+              tmp_out << get_variable(eEndogenous, var) << "(" << lag << ")";
+            else
+              tmp_out << get_variable(eEndogenous, var);
+            Stack.push(tmp_out.str());
+            if (compute)
+              {
+                if (evaluate)
+                  Stackf.push(ya[(it_+lag)*y_size+var]);
+                else
+                  Stackf.push(y[(it_+lag)*y_size+var]);
+              }
+            break;
+          case FLDX:
+          case FLDXD:
+            {
+              SymbolType type = it_code->first == FLDX ? eExogenous : eExogenousDet;
+              int nb_row = it_code->first == FLDX ? nb_row_x : nb_row_xd;
+              var = ((FLDX_ *) it_code->second)->get_pos();
+              lag = ((FLDX_ *) it_code->second)->get_offset() - var*nb_row;
+              tmp_out.str("");
+              if (lag != 0)
+                tmp_out << get_variable(type, var) << "(" << lag << ")";
+              else
+                tmp_out << get_variable(type, var);
+              Stack.push(tmp_out.str());
+              if (compute)
+                Stackf.push(x[it_+lag+var*nb_row]);
+            }
+            break;
           case FLDSV:
           case FLDVS:
             //load a variable in the processor
@@ -1238,6 +1291,32 @@ public:
             tmp_out.str("");
 #endif
             break;
+          case FBINARYC:
+          case FBINARYT:
+          case FBINARYST:
+            tmp_out.str("");
+            switch (it_code->first)
+              {
+              case FBINARYC:
+                ll = ((FBINARYC_ *) it_code->second)->get_value();
+                tmp_out << ll;
+                if (compute)
+                  Stackf.push(ll);
+                break;
+              case FBINARYT:
+                var = ((FBINARYT_ *) it_code->second)->get_pos();
+                tmp_out << "T" << var+1;
+                if (compute)
+                  Stackf.push(T[var*(periods+y_kmin+y_kmax)+it_]);
+                break;
+              default:
+                var = ((FBINARYST_ *) it_code->second)->get_pos();
+                tmp_out << "T" << var+1;
+                if (compute)
+                  Stackf.push(T[var]);
+              }
+            Stack.push(tmp_out.str());
+            /* fall through */
           case FBINARY:
             op = ((FBINARY_ *) it_code->second)->get_op_type();
             v2 = Stack.top();
@@ -2212,6 +2291,17 @@ public:
             tmp_out << v1 << " + " << v2;
             Stack.push(tmp_out.str());
             break;
+          case FPATTERN:
+            {
+              // The code which follows is the one of the first equation
+              FPATTERN_ *fpattern = (FPATTERN_ *) it_code->second;
+              tmp_out.str("");
+              tmp_out << "for equations";
+              for (unsigned int row = 0; row < fpattern->get_nb_rows(); row++)
+                tmp_out << " " << fpattern->get_equations()[row]+1;
+              go_on = false;
+            }
+            break;
           case FENDBLOCK:
           case FENDEQU:
             go_on = false;
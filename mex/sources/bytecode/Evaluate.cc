@@ -21,6 +21,9 @@
 #include <sstream>
 #include <math.h>
 #include "Evaluate.hh"
+#ifdef USE_OMP
+# include <omp.h>
+#endif
 
 #ifdef MATLAB_MEX_FILE
 extern "C" bool utIsInterruptPending();
@@ -33,6 +36,9 @@ Evaluate::Evaluate()
   Block_List_Max_Lead = 0;
   u_count_int = 0;
   block = -1;
+  profile = false;
+  period_threads = 1;
+  period_worker = false;
 }
 
 Evaluate::Evaluate(const int y_size_arg, const int y_kmin_arg, const int y_kmax_arg, const bool print_it_arg, const bool steady_state_arg, const int periods_arg, const int minimal_solving_periods_arg, const double slowc_arg) :
@@ -43,6 +49,9 @@ Evaluate::Evaluate(const int y_size_arg, const int y_kmin_arg, const int y_kmax_
   Block_List_Max_Lead = 0;
   u_count_int = 0;
   block = -1;
+  profile = false;
+  period_threads = 1;
+  period_worker = false;
   y_size = y_size_arg;
   y_kmin = y_kmin_arg;
   y_kmax  = y_kmax_arg;
@@ -112,15 +121,24 @@ Evaluate::compute_block_time(const int Per_u_, const bool evaluate, /*const int
 {
   int var = 0, lag = 0, op;
   unsigned int eq, pos_col;
+#ifdef DEBUG
   ostringstream tmp_out;
+#endif
   double v1, v2, v3;
   bool go_on = true;
   double ll;
   double rr;
   double *jacob = NULL, *jacob_other_endo = NULL, *jacob_exo = NULL, *jacob_exo_det = NULL;
   EQN_block = block_num;
-  stack<double> Stack;
+  stack<double, vector<double> > &Stack = operand_stack;
   external_function_type function_type = ExternalFunctionWithoutDerivative;
+  long int nb_instructions = 0;
+  clock_t t0 = profile ? clock() : 0;
+
+  // The stack is not empty if the previous evaluation has been interrupted by an exception
+  while (!Stack.empty())
+    Stack.pop();
+  it_code_expr = it_code;
 
 #ifdef DEBUG
   mexPrintf("compute_block_time\n");
@@ -136,7 +154,7 @@ Evaluate::compute_block_time(const int Per_u_, const bool evaluate, /*const int
         }
     }
 #ifdef MATLAB_MEX_FILE
-  if (utIsInterruptPending())
+  if (!period_worker && utIsInterruptPending())
     throw UserExceptionHandling();
 #endif
 
@@ -148,165 +166,8 @@ Evaluate::compute_block_time(const int Per_u_, const bool evaluate, /*const int
       switch (it_code->first)
         {
         case FNUMEXPR:
-#ifdef DEBUG
-          mexPrintf("FNUMEXPR\n");
-#endif
+          // The expression is only decoded if an error has to be reported (see ErrorMsg::error_location())
           it_code_expr = it_code;
-          switch (((FNUMEXPR_ *) it_code->second)->get_expression_type())
-            {
-            case TemporaryTerm:
-#ifdef DEBUG
-              mexPrintf("TemporaryTerm\n");
-#endif
-              EQN_type = TemporaryTerm;
-              EQN_equation = ((FNUMEXPR_ *) it_code->second)->get_equation();
-#ifdef DEBUG
-              mexPrintf("EQN_equation=%d\n", EQN_equation); mexEvalString("drawnow;");
-#endif
-              break;
-            case ModelEquation:
-#ifdef DEBUG
-              mexPrintf("ModelEquation\n");
-#endif
-              EQN_type = ModelEquation;
-              EQN_equation = ((FNUMEXPR_ *) it_code->second)->get_equation();
-              break;
-            case FirstEndoDerivative:
-#ifdef DEBUG
-              mexPrintf("FirstEndoDerivative\n");
-#endif
-              EQN_type = FirstEndoDerivative;
-              EQN_equation = ((FNUMEXPR_ *) it_code->second)->get_equation();
-              EQN_dvar1 = ((FNUMEXPR_ *) it_code->second)->get_dvariable1();
-              EQN_lag1 = ((FNUMEXPR_ *) it_code->second)->get_lag1();
-              break;
-            case FirstOtherEndoDerivative:
-#ifdef DEBUG
-              mexPrintf("FirstOtherEndoDerivative\n");
-#endif
-              EQN_type = FirstOtherEndoDerivative;
-              EQN_equation = ((FNUMEXPR_ *) it_code->second)->get_equation();
-              EQN_dvar1 = ((FNUMEXPR_ *) it_code->second)->get_dvariable1();
-              EQN_lag1 = ((FNUMEXPR_ *) it_code->second)->get_lag1();
-              break;
-            case FirstExoDerivative:
-#ifdef DEBUG
-              mexPrintf("FirstExoDerivative\n");
-#endif
-              EQN_type = FirstExoDerivative;
-              EQN_equation = ((FNUMEXPR_ *) it_code->second)->get_equation();
-              EQN_dvar1 = ((FNUMEXPR_ *) it_code->second)->get_dvariable1();
-              EQN_lag1 = ((FNUMEXPR_ *) it_code->second)->get_lag1();
-              break;
-            case FirstExodetDerivative:
-#ifdef DEBUG
-              mexPrintf("FirstExodetDerivative\n");
-#endif
-              EQN_type = FirstExodetDerivative;
-              EQN_equation = ((FNUMEXPR_ *) it_code->second)->get_equation();
-              EQN_dvar1 = ((FNUMEXPR_ *) it_code->second)->get_dvariable1();
-              EQN_lag1 = ((FNUMEXPR_ *) it_code->second)->get_lag1();
-              break;
-            case FirstParamDerivative:
-#ifdef DEBUG
-              mexPrintf("FirstParamDerivative\n");
-#endif
-              EQN_type = FirstParamDerivative;
-              EQN_equation = ((FNUMEXPR_ *) it_code->second)->get_equation();
-              EQN_dvar1 = ((FNUMEXPR_ *) it_code->second)->get_dvariable1();
-              break;
-            case SecondEndoDerivative:
-#ifdef DEBUG
-              mexPrintf("SecondEndoDerivative\n");
-#endif
-              EQN_type = SecondEndoDerivative;
-              EQN_equation = ((FNUMEXPR_ *) it_code->second)->get_equation();
-              EQN_dvar1 = ((FNUMEXPR_ *) it_code->second)->get_dvariable1();
-              EQN_lag1 = ((FNUMEXPR_ *) it_code->second)->get_lag1();
-              EQN_dvar2 = ((FNUMEXPR_ *) it_code->second)->get_dvariable2();
-              EQN_lag2 = ((FNUMEXPR_ *) it_code->second)->get_lag2();
-              break;
-            case SecondExoDerivative:
-#ifdef DEBUG
-              mexPrintf("SecondExoDerivative\n");
-#endif
-              EQN_type = SecondExoDerivative;
-              EQN_equation = ((FNUMEXPR_ *) it_code->second)->get_equation();
-              EQN_dvar1 = ((FNUMEXPR_ *) it_code->second)->get_dvariable1();
-              EQN_lag1 = ((FNUMEXPR_ *) it_code->second)->get_lag1();
-              EQN_dvar2 = ((FNUMEXPR_ *) it_code->second)->get_dvariable2();
-              EQN_lag2 = ((FNUMEXPR_ *) it_code->second)->get_lag2();
-              break;
-            case SecondExodetDerivative:
-#ifdef DEBUG
-              mexPrintf("SecondExodetDerivative\n");
-#endif
-              EQN_type = SecondExodetDerivative;
-              EQN_equation = ((FNUMEXPR_ *) it_code->second)->get_equation();
-              EQN_dvar1 = ((FNUMEXPR_ *) it_code->second)->get_dvariable1();
-              EQN_lag1 = ((FNUMEXPR_ *) it_code->second)->get_lag1();
-              EQN_dvar2 = ((FNUMEXPR_ *) it_code->second)->get_dvariable2();
-              EQN_lag2 = ((FNUMEXPR_ *) it_code->second)->get_lag2();
-              break;
-            case SecondParamDerivative:
-#ifdef DEBUG
-              mexPrintf("SecondParamDerivative\n");
-#endif
-              EQN_type = SecondParamDerivative;
-              EQN_equation = ((FNUMEXPR_ *) it_code->second)->get_equation();
-              EQN_dvar1 = ((FNUMEXPR_ *) it_code->second)->get_dvariable1();
-              EQN_dvar2 = ((FNUMEXPR_ *) it_code->second)->get_dvariable2();
-              break;
-            case ThirdEndoDerivative:
-#ifdef DEBUG
-              mexPrintf("ThirdEndoDerivative\n");
-#endif
-              EQN_type = ThirdEndoDerivative;
-              EQN_equation = ((FNUMEXPR_ *) it_code->second)->get_equation();
-              EQN_dvar1 = ((FNUMEXPR_ *) it_code->second)->get_dvariable1();
-              EQN_lag1 = ((FNUMEXPR_ *) it_code->second)->get_lag1();
-              EQN_dvar2 = ((FNUMEXPR_ *) it_code->second)->get_dvariable2();
-              EQN_lag2 = ((FNUMEXPR_ *) it_code->second)->get_lag2();
-              EQN_dvar3 = ((FNUMEXPR_ *) it_code->second)->get_dvariable3();
-              EQN_lag3 = ((FNUMEXPR_ *) it_code->second)->get_lag3();
-              break;
-            case ThirdExoDerivative:
-#ifdef DEBUG
-              mexPrintf("ThirdExoDerivative\n");
-#endif
-              EQN_type = ThirdExoDerivative;
-              EQN_equation = ((FNUMEXPR_ *) it_code->second)->get_equation();
-              EQN_dvar1 = ((FNUMEXPR_ *) it_code->second)->get_dvariable1();
-              EQN_lag1 = ((FNUMEXPR_ *) it_code->second)->get_lag1();
-              EQN_dvar2 = ((FNUMEXPR_ *) it_code->second)->get_dvariable2();
-              EQN_lag2 = ((FNUMEXPR_ *) it_code->second)->get_lag2();
-              EQN_dvar3 = ((FNUMEXPR_ *) it_code->second)->get_dvariable3();
-              EQN_lag3 = ((FNUMEXPR_ *) it_code->second)->get_lag3();
-              break;
-            case ThirdExodetDerivative:
-#ifdef DEBUG
-              mexPrintf("ThirdExodetDerivative\n");
-#endif
-              EQN_type = ThirdExodetDerivative;
-              EQN_equation = ((FNUMEXPR_ *) it_code->second)->get_equation();
-              EQN_dvar1 = ((FNUMEXPR_ *) it_code->second)->get_dvariable1();
-              EQN_lag1 = ((FNUMEXPR_ *) it_code->second)->get_lag1();
-              EQN_dvar2 = ((FNUMEXPR_ *) it_code->second)->get_dvariable2();
-              EQN_lag2 = ((FNUMEXPR_ *) it_code->second)->get_lag2();
-              EQN_dvar3 = ((FNUMEXPR_ *) it_code->second)->get_dvariable3();
-              EQN_lag3 = ((FNUMEXPR_ *) it_code->second)->get_lag3();
-              break;
-            case ThirdParamDerivative:
-#ifdef DEBUG
-              mexPrintf("ThirdParamDerivative\n");
-#endif
-              EQN_type = ThirdParamDerivative;
-              EQN_equation = ((FNUMEXPR_ *) it_code->second)->get_equation();
-              EQN_dvar1 = ((FNUMEXPR_ *) it_code->second)->get_dvariable1();
-              EQN_dvar2 = ((FNUMEXPR_ *) it_code->second)->get_dvariable2();
-              EQN_dvar3 = ((FNUMEXPR_ *) it_code->second)->get_dvariable3();
-              break;
-            }
           break;
         case FLDV:
           //load a variable in the processor
@@ -361,6 +222,21 @@ Evaluate::compute_block_time(const int Per_u_, const bool evaluate, /*const int
               mexPrintf("FLDV: Unknown variable type\n");
             }
           break;
+        case FLDY:
+          //load an endogenous variable at a resolved offset
+          if (evaluate)
+            Stack.push(ya[it_*y_size+((FLDY_ *) it_code->second)->get_offset()]);
+          else
+            Stack.push(y[it_*y_size+((FLDY_ *) it_code->second)->get_offset()]);
+          break;
+        case FLDX:
+          //load an exogenous variable at a resolved offset
+          Stack.push(x[it_+((FLDX_ *) it_code->second)->get_offset()]);
+          break;
+        case FLDXD:
+          //load an exogenous deterministic variable at a resolved offset
+          Stack.push(x[it_+((FLDXD_ *) it_code->second)->get_offset()]);
+          break;
         case FLDSV:
           //load a variable in the processor
           switch (((FLDSV_ *) it_code->second)->get_type())
@@ -701,10 +577,10 @@ Evaluate::compute_block_time(const int Per_u_, const bool evaluate, /*const int
         case FSTPG2:
           //store in the jacobian matrix
           rr = Stack.top();
-          if (EQN_type != FirstEndoDerivative)
+          if (((FNUMEXPR_ *) it_code_expr->second)->get_expression_type() != FirstEndoDerivative)
             {
               ostringstream tmp;
-              tmp << " in compute_block_time, impossible case " << EQN_type << " not implement in static jacobian\n";
+              tmp << " in compute_block_time, impossible case " << ((FNUMEXPR_ *) it_code_expr->second)->get_expression_type() << " not implement in static jacobian\n";
               throw FatalExceptionHandling(tmp.str());
             }
           eq = ((FSTPG2_ *) it_code->second)->get_row();
@@ -728,7 +604,7 @@ Evaluate::compute_block_time(const int Per_u_, const bool evaluate, /*const int
 
 #endif
           rr = Stack.top();
-          switch (EQN_type)
+          switch (((FNUMEXPR_ *) it_code_expr->second)->get_expression_type())
             {
             case FirstEndoDerivative:
               eq = ((FSTPG3_ *) it_code->second)->get_row();
@@ -743,7 +619,7 @@ Evaluate::compute_block_time(const int Per_u_, const bool evaluate, /*const int
               break;
             case FirstOtherEndoDerivative:
               //eq = ((FSTPG3_ *) it_code->second)->get_row();
-              eq = EQN_equation;
+              eq = ((FNUMEXPR_ *) it_code_expr->second)->get_equation();
               var = ((FSTPG3_ *) it_code->second)->get_col();
               lag = ((FSTPG3_ *) it_code->second)->get_lag();
               pos_col = ((FSTPG3_ *) it_code->second)->get_col_pos();
@@ -755,7 +631,7 @@ Evaluate::compute_block_time(const int Per_u_, const bool evaluate, /*const int
               break;
             case FirstExoDerivative:
               //eq = ((FSTPG3_ *) it_code->second)->get_row();
-              eq = EQN_equation;
+              eq = ((FNUMEXPR_ *) it_code_expr->second)->get_equation();
               var = ((FSTPG3_ *) it_code->second)->get_col();
               lag = ((FSTPG3_ *) it_code->second)->get_lag();
               pos_col = ((FSTPG3_ *) it_code->second)->get_col_pos();
@@ -767,7 +643,7 @@ Evaluate::compute_block_time(const int Per_u_, const bool evaluate, /*const int
               break;
             case FirstExodetDerivative:
               //eq = ((FSTPG3_ *) it_code->second)->get_row();
-              eq = EQN_equation;
+              eq = ((FNUMEXPR_ *) it_code_expr->second)->get_equation();
               var = ((FSTPG3_ *) it_code->second)->get_col();
               lag = ((FSTPG3_ *) it_code->second)->get_lag();
               pos_col = ((FSTPG3_ *) it_code->second)->get_col_pos();
@@ -780,7 +656,7 @@ Evaluate::compute_block_time(const int Per_u_, const bool evaluate, /*const int
               break;
             default:
               ostringstream tmp;
-              tmp << " in compute_block_time, variable " << EQN_type << " not used yet\n";
+              tmp << " in compute_block_time, variable " << ((FNUMEXPR_ *) it_code_expr->second)->get_expression_type() << " not used yet\n";
               throw FatalExceptionHandling(tmp.str());
             }
 #ifdef DEBUG
@@ -791,6 +667,24 @@ Evaluate::compute_block_time(const int Per_u_, const bool evaluate, /*const int
           Stack.pop();
           break;
 
+        case FBINARYC:
+        case FBINARYT:
+        case FBINARYST:
+          //load the second operand of the binary operator, which is then computed as FBINARY
+          switch (it_code->first)
+            {
+            case FBINARYC:
+              Stack.push(((FBINARYC_ *) it_code->second)->get_value());
+              break;
+            case FBINARYT:
+              var = ((FBINARYT_ *) it_code->second)->get_pos();
+              Stack.push(T[var*(periods+y_kmin+y_kmax)+it_]);
+              break;
+            default:
+              var = ((FBINARYST_ *) it_code->second)->get_pos();
+              Stack.push(T[var]);
+            }
+          /* fall through */
         case FBINARY:
           op = ((FBINARY_ *) it_code->second)->get_op_type();
 #ifdef DEBUG
@@ -1442,6 +1336,12 @@ Evaluate::compute_block_time(const int Per_u_, const bool evaluate, /*const int
           Stack.pop();
           Stack.push(v1+v2);
           break;
+        case FPATTERN:
+          //evaluate at once the residuals of the equations sharing the code which follows
+          if (!evaluate_pattern(it_code, Per_u_, evaluate))
+            go_on = false;
+          it_code += ((FPATTERN_ *) it_code->second)->get_nb_instructions();
+          break;
         case FENDBLOCK:
           //it's the block end
 #ifdef DEBUG
@@ -1491,6 +1391,14 @@ Evaluate::compute_block_time(const int Per_u_, const bool evaluate, /*const int
       mexPrintf("it_code++=%d\n", it_code);
 #endif
       it_code++;
+      nb_instructions++;
+    }
+  if (profile)
+    {
+      t_block_profile &p = get_block_profile(block_num);
+      p.nb_evaluations++;
+      p.nb_instructions += nb_instructions;
+      p.evaluation_time += elapsed_ms(t0);
     }
 #ifdef DEBUG
   mexPrintf("==> end of compute_block_time Block = %d\n", block_num);
@@ -1498,17 +1406,818 @@ Evaluate::compute_block_time(const int Per_u_, const bool evaluate, /*const int
 #endif
 }
 
+double *
+Evaluate::strip_push(int &sp)
+{
+  if ((unsigned int) (sp+1)*PERIOD_STRIP > strip_stack.size())
+    strip_stack.resize((sp+1)*PERIOD_STRIP);
+  return strip(sp++);
+}
+
+void
+Evaluate::strip_binary(const int op, int &sp, const int n)
+{
+  /* Applies a binary operator to the two strips on top of the stack of
+     evaluate_strip() and evaluate_pattern() */
+  double *s1 = strip(sp-2), *s2 = strip(sp-1), *s3;
+  int k;
+  sp--;
+  switch (op)
+    {
+    case oPlus:
+      for (k = 0; k < n; k++)
+        s1[k] += s2[k];
+      break;
+    case oMinus:
+      for (k = 0; k < n; k++)
+        s1[k] -= s2[k];
+      break;
+    case oTimes:
+      for (k = 0; k < n; k++)
+        s1[k] *= s2[k];
+      break;
+    case oDivide:
+      for (k = 0; k < n; k++)
+        s1[k] = divide(s1[k], s2[k]);
+      break;
+    case oLess:
+      for (k = 0; k < n; k++)
+        s1[k] = double (s1[k] < s2[k]);
+      break;
+    case oGreater:
+      for (k = 0; k < n; k++)
+        s1[k] = double (s1[k] > s2[k]);
+      break;
+    case oLessEqual:
+      for (k = 0; k < n; k++)
+        s1[k] = double (s1[k] <= s2[k]);
+      break;
+    case oGreaterEqual:
+      for (k = 0; k < n; k++)
+        s1[k] = double (s1[k] >= s2[k]);
+      break;
+    case oEqualEqual:
+      for (k = 0; k < n; k++)
+        s1[k] = double (s1[k] == s2[k]);
+      break;
+    case oDifferent:
+      for (k = 0; k < n; k++)
+        s1[k] = double (s1[k] != s2[k]);
+      break;
+    case oPower:
+      for (k = 0; k < n; k++)
+        s1[k] = pow1(s1[k], s2[k]);
+      break;
+    case oPowerDeriv:
+      s3 = strip(--sp - 1);
+      for (k = 0; k < n; k++)
+        {
+          int derivOrder = int (nearbyint(s3[k]));
+          double v2 = s2[k];
+          if (fabs(s1[k]) < NEAR_ZERO && v2 > 0
+              && derivOrder > v2
+              && fabs(v2-nearbyint(v2)) < NEAR_ZERO)
+            s3[k] = 0.0;
+          else
+            {
+              double dxp = pow1(s1[k], v2-derivOrder);
+              for (int i = 0; i < derivOrder; i++)
+                dxp *= v2--;
+              s3[k] = dxp;
+            }
+        }
+      break;
+    case oMax:
+      for (k = 0; k < n; k++)
+        s1[k] = max(s1[k], s2[k]);
+      break;
+    case oMin:
+      for (k = 0; k < n; k++)
+        s1[k] = min(s1[k], s2[k]);
+      break;
+    case oEqual:
+      sp--;
+      break;
+    default:
+      {
+        ostringstream tmp;
+        tmp << " in strip_binary, unknown binary operator " << op << "\n";
+        throw FatalExceptionHandling(tmp.str());
+      }
+    }
+}
+
+void
+Evaluate::strip_unary(const int op, int &sp, const int n)
+{
+  double *s1 = strip(sp-1);
+  int k;
+  switch (op)
+    {
+    case oUminus:
+      for (k = 0; k < n; k++)
+        s1[k] = -s1[k];
+      break;
+    case oExp:
+      for (k = 0; k < n; k++)
+        s1[k] = exp(s1[k]);
+      break;
+    case oLog:
+      for (k = 0; k < n; k++)
+        s1[k] = log1(s1[k]);
+      break;
+    case oLog10:
+      for (k = 0; k < n; k++)
+        s1[k] = log10_1(s1[k]);
+      break;
+    case oCos:
+      for (k = 0; k < n; k++)
+        s1[k] = cos(s1[k]);
+      break;
+    case oSin:
+      for (k = 0; k < n; k++)
+        s1[k] = sin(s1[k]);
+      break;
+    case oTan:
+      for (k = 0; k < n; k++)
+        s1[k] = tan(s1[k]);
+      break;
+    case oAcos:
+      for (k = 0; k < n; k++)
+        s1[k] = acos(s1[k]);
+      break;
+    case oAsin:
+      for (k = 0; k < n; k++)
+        s1[k] = asin(s1[k]);
+      break;
+    case oAtan:
+      for (k = 0; k < n; k++)
+        s1[k] = atan(s1[k]);
+      break;
+    case oCosh:
+      for (k = 0; k < n; k++)
+        s1[k] = cosh(s1[k]);
+      break;
+    case oSinh:
+      for (k = 0; k < n; k++)
+        s1[k] = sinh(s1[k]);
+      break;
+    case oTanh:
+      for (k = 0; k < n; k++)
+        s1[k] = tanh(s1[k]);
+      break;
+    case oAcosh:
+      for (k = 0; k < n; k++)
+        s1[k] = acosh(s1[k]);
+      break;
+    case oAsinh:
+      for (k = 0; k < n; k++)
+        s1[k] = asinh(s1[k]);
+      break;
+    case oAtanh:
+      for (k = 0; k < n; k++)
+        s1[k] = atanh(s1[k]);
+      break;
+    case oSqrt:
+      for (k = 0; k < n; k++)
+        s1[k] = sqrt(s1[k]);
+      break;
+    case oErf:
+      for (k = 0; k < n; k++)
+        s1[k] = erf(s1[k]);
+      break;
+    default:
+      {
+        ostringstream tmp;
+        tmp << " in strip_unary, unknown unary operator " << op << "\n";
+        throw FatalExceptionHandling(tmp.str());
+      }
+    }
+}
+
+void
+Evaluate::strip_trinary(const int op, int &sp, const int n)
+{
+  double *s1 = strip(sp-3), *s2 = strip(sp-2), *s3 = strip(sp-1);
+  int k;
+  sp -= 2;
+  switch (op)
+    {
+    case oNormcdf:
+      for (k = 0; k < n; k++)
+        s1[k] = 0.5*(1+erf((s1[k]-s2[k])/s3[k]/M_SQRT2));
+      break;
+    case oNormpdf:
+      for (k = 0; k < n; k++)
+        s1[k] = 1/(s3[k]*sqrt(2*M_PI)*exp(pow((s1[k]-s2[k])/s3[k], 2)/2));
+      break;
+    default:
+      {
+        ostringstream tmp;
+        tmp << " in strip_trinary, unknown trinary operator " << op << "\n";
+        throw FatalExceptionHandling(tmp.str());
+      }
+    }
+}
+
+bool
+Evaluate::strip_evaluable(const bool forward)
+{
+  /* The block can be evaluated on a strip of periods if it gives the same result as the
+     period by period evaluation: the endogenous variables of the block are stored at the
+     current period, are never read before being stored, and are read afterwards only at
+     periods that the scalar interpreter has already computed */
+  set<int> stored, read;
+  int var, lag;
+  for (it_code_type it = it_code;; it++)
+    {
+      switch (it->first)
+        {
+        case FNUMEXPR:
+        case FLDX:
+        case FLDXD:
+        case FLDT:
+        case FLDZ:
+        case FLDC:
+        case FSTPT:
+        case FBINARYC:
+        case FBINARYT:
+        case FBINARY:
+        case FUNARY:
+        case FTRINARY:
+        case FPUSH:
+        case FCUML:
+        case FENDEQU:
+        case FJMPIFEVAL:
+        case FOK:
+          break;
+        case FJMP:
+          it += ((FJMP_ *) it->second)->get_pos();
+          break;
+        case FENDBLOCK:
+          return true;
+        case FLDV:
+          if (((FLDV_ *) it->second)->get_type() != eEndogenous)
+            break;
+          var = ((FLDV_ *) it->second)->get_pos();
+          lag = ((FLDV_ *) it->second)->get_lead_lag();
+          if (stored.find(var) == stored.end())
+            read.insert(var);
+          else if (forward ? lag > 0 : lag < 0)
+            return false;
+          break;
+        case FLDY:
+          var = ((FLDY_ *) it->second)->get_pos();
+          lag = (((FLDY_ *) it->second)->get_offset() - var) / y_size;
+          if (stored.find(var) == stored.end())
+            read.insert(var);
+          else if (forward ? lag > 0 : lag < 0)
+            return false;
+          break;
+        case FSTPV:
+          if (((FSTPV_ *) it->second)->get_type() != eEndogenous
+              || ((FSTPV_ *) it->second)->get_lead_lag() != 0)
+            return false;
+          var = ((FSTPV_ *) it->second)->get_pos();
+          if (read.find(var) != read.end())
+            return false;
+          stored.insert(var);
+          break;
+        default:
+          return false;
+        }
+    }
+}
+
+bool
+Evaluate::evaluate_strip(const it_code_type &begining, const int first, const int n)
+{
+  /* Evaluates the block for the periods first, ..., first+n-1: each instruction is applied
+     to the whole strip of periods. Returns false if a floating point error occurs. */
+  int var, lag, k, sp = 0;
+  double *s1, *s2;
+  const double *p;
+  int T_nrows = periods+y_kmin+y_kmax;
+  long int nb_instructions = 0;
+  clock_t t0 = profile ? clock() : 0;
+#ifdef MATLAB_MEX_FILE
+  if (utIsInterruptPending())
+    throw UserExceptionHandling();
+#endif
+  try
+    {
+      for (it_code = begining;; it_code++, nb_instructions++)
+        {
+          switch (it_code->first)
+            {
+            case FNUMEXPR:
+              it_code_expr = it_code;
+              break;
+            case FLDV:
+              var = ((FLDV_ *) it_code->second)->get_pos();
+              lag = ((FLDV_ *) it_code->second)->get_lead_lag();
+              switch (((FLDV_ *) it_code->second)->get_type())
+                {
+                case eParameter:
+                  s1 = strip_push(sp);
+                  for (k = 0; k < n; k++)
+                    s1[k] = params[var];
+                  break;
+                case eEndogenous:
+                  s1 = strip_push(sp);
+                  p = y + (first+lag)*y_size + var;
+                  for (k = 0; k < n; k++)
+                    s1[k] = p[k*y_size];
+                  break;
+                case eExogenous:
+                  s1 = strip_push(sp);
+                  memcpy(s1, x + first+lag+var*nb_row_x, n*sizeof(double));
+                  break;
+                case eExogenousDet:
+                  s1 = strip_push(sp);
+                  memcpy(s1, x + first+lag+var*nb_row_xd, n*sizeof(double));
+                  break;
+                default:
+                  break;
+                }
+              break;
+            case FLDY:
+              s1 = strip_push(sp);
+              p = y + first*y_size + ((FLDY_ *) it_code->second)->get_offset();
+              for (k = 0; k < n; k++)
+                s1[k] = p[k*y_size];
+              break;
+            case FLDX:
+              s1 = strip_push(sp);
+              memcpy(s1, x + first + ((FLDX_ *) it_code->second)->get_offset(), n*sizeof(double));
+              break;
+            case FLDXD:
+              s1 = strip_push(sp);
+              memcpy(s1, x + first + ((FLDXD_ *) it_code->second)->get_offset(), n*sizeof(double));
+              break;
+            case FLDT:
+              s1 = strip_push(sp);
+              memcpy(s1, T + ((FLDT_ *) it_code->second)->get_pos()*T_nrows + first, n*sizeof(double));
+              break;
+            case FLDZ:
+              s1 = strip_push(sp);
+              for (k = 0; k < n; k++)
+                s1[k] = 0.0;
+              break;
+            case FLDC:
+              s1 = strip_push(sp);
+              for (k = 0; k < n; k++)
+                s1[k] = ((FLDC_ *) it_code->second)->get_value();
+              break;
+            case FSTPV:
+              s1 = strip(--sp);
+              var = ((FSTPV_ *) it_code->second)->get_pos();
+              for (k = 0; k < n; k++)
+                y[(first+k)*y_size+var] = s1[k];
+              break;
+            case FSTPT:
+              s1 = strip(--sp);
+              memcpy(T + ((FSTPT_ *) it_code->second)->get_pos()*T_nrows + first, s1, n*sizeof(double));
+              break;
+            case FBINARYC:
+            case FBINARYT:
+              s1 = strip_push(sp);
+              if (it_code->first == FBINARYC)
+                for (k = 0; k < n; k++)
+                  s1[k] = ((FBINARYC_ *) it_code->second)->get_value();
+              else
+                memcpy(s1, T + ((FBINARYT_ *) it_code->second)->get_pos()*T_nrows + first, n*sizeof(double));
+              /* fall through */
+            case FBINARY:
+              strip_binary(((FBINARY_ *) it_code->second)->get_op_type(), sp, n);
+              break;
+            case FUNARY:
+              strip_unary(((FUNARY_ *) it_code->second)->get_op_type(), sp, n);
+              break;
+            case FTRINARY:
+              strip_trinary(((FTRINARY_ *) it_code->second)->get_op_type(), sp, n);
+              break;
+            case FPUSH:
+            case FENDEQU:
+            case FJMPIFEVAL:
+              break;
+            case FCUML:
+              s1 = strip(sp-2);
+              s2 = strip(sp-1);
+              sp--;
+              for (k = 0; k < n; k++)
+                s1[k] += s2[k];
+              break;
+            case FJMP:
+              it_code += ((FJMP_ *) it_code->second)->get_pos();
+              break;
+            case FENDBLOCK:
+              if (profile)
+                {
+                  t_block_profile &prof = get_block_profile(block_num);
+                  prof.nb_evaluations += n;
+                  prof.nb_instructions += nb_instructions+1;
+                  prof.evaluation_time += elapsed_ms(t0);
+                }
+              return true;
+            case FOK:
+              if (sp > 0)
+                {
+                  ostringstream tmp;
+                  tmp << " in evaluate_strip, stack not empty\n";
+                  throw FatalExceptionHandling(tmp.str());
+                }
+              break;
+            default:
+              ostringstream tmp;
+              tmp << " in evaluate_strip, unknown opcode " << it_code->first << "\n";
+              throw FatalExceptionHandling(tmp.str());
+            }
+        }
+    }
+  catch (FloatingPointExceptionHandling &fpeh)
+    {
+      return false;
+    }
+}
+
+void
+Evaluate::evaluate_pattern_rows(const it_code_type &pattern, const int first, const int n, const bool evaluate)
+{
+  /* Evaluates the rows first, ..., first+n-1 of an FPATTERN at the current period: each
+     instruction of its body is applied to the strip of rows, with the operands of the rows */
+  FPATTERN_ *fpattern = (FPATTERN_ *) pattern->second;
+  const double *yy = evaluate ? ya : y;
+  int T_nrows = periods+y_kmin+y_kmax;
+  int offset, lag, k, sp = 0;
+  unsigned int operand = 0;
+  const unsigned int *v;
+  double *s1;
+  it_code_type end = pattern + fpattern->get_nb_instructions() + 1;
+  for (it_code_type it = pattern + 1; it != end; it++)
+    {
+      switch (it->first)
+        {
+        case FNUMEXPR:
+          break;
+        case FLDV:
+          v = fpattern->get_operands(operand++) + first;
+          lag = ((FLDV_ *) it->second)->get_lead_lag();
+          s1 = strip_push(sp);
+          switch (((FLDV_ *) it->second)->get_type())
+            {
+            case eParameter:
+              for (k = 0; k < n; k++)
+                s1[k] = params[v[k]];
+              break;
+            case eEndogenous:
+              for (k = 0; k < n; k++)
+                s1[k] = yy[(it_+lag)*y_size+v[k]];
+              break;
+            case eExogenous:
+              for (k = 0; k < n; k++)
+                s1[k] = x[it_+lag+v[k]*nb_row_x];
+              break;
+            default:
+              for (k = 0; k < n; k++)
+                s1[k] = x[it_+lag+v[k]*nb_row_xd];
+            }
+          break;
+        case FLDY:
+          // The offset of the body is the one of the first row
+          v = fpattern->get_operands(operand++) + first;
+          offset = ((FLDY_ *) it->second)->get_offset() - (int) ((FLDY_ *) it->second)->get_pos();
+          s1 = strip_push(sp);
+          for (k = 0; k < n; k++)
+            s1[k] = yy[it_*y_size+offset+v[k]];
+          break;
+        case FLDX:
+          v = fpattern->get_operands(operand++) + first;
+          offset = ((FLDX_ *) it->second)->get_offset() - (int) ((FLDX_ *) it->second)->get_pos()*nb_row_x;
+          s1 = strip_push(sp);
+          for (k = 0; k < n; k++)
+            s1[k] = x[it_+offset+v[k]*nb_row_x];
+          break;
+        case FLDXD:
+          v = fpattern->get_operands(operand++) + first;
+          offset = ((FLDXD_ *) it->second)->get_offset() - (int) ((FLDXD_ *) it->second)->get_pos()*nb_row_xd;
+          s1 = strip_push(sp);
+          for (k = 0; k < n; k++)
+            s1[k] = x[it_+offset+v[k]*nb_row_xd];
+          break;
+        case FLDSV:
+          v = fpattern->get_operands(operand++) + first;
+          s1 = strip_push(sp);
+          switch (((FLDSV_ *) it->second)->get_type())
+            {
+            case eParameter:
+              for (k = 0; k < n; k++)
+                s1[k] = params[v[k]];
+              break;
+            case eEndogenous:
+              for (k = 0; k < n; k++)
+                s1[k] = yy[v[k]];
+              break;
+            default:
+              for (k = 0; k < n; k++)
+                s1[k] = x[v[k]];
+            }
+          break;
+        case FLDT:
+          v = fpattern->get_operands(operand++) + first;
+          s1 = strip_push(sp);
+          for (k = 0; k < n; k++)
+            s1[k] = T[v[k]*T_nrows+it_];
+          break;
+        case FLDST:
+          v = fpattern->get_operands(operand++) + first;
+          s1 = strip_push(sp);
+          for (k = 0; k < n; k++)
+            s1[k] = T[v[k]];
+          break;
+        case FLDZ:
+          s1 = strip_push(sp);
+          for (k = 0; k < n; k++)
+            s1[k] = 0.0;
+          break;
+        case FLDC:
+          s1 = strip_push(sp);
+          for (k = 0; k < n; k++)
+            s1[k] = ((FLDC_ *) it->second)->get_value();
+          break;
+        case FBINARYC:
+        case FBINARYT:
+        case FBINARYST:
+          s1 = strip_push(sp);
+          if (it->first == FBINARYC)
+            for (k = 0; k < n; k++)
+              s1[k] = ((FBINARYC_ *) it->second)->get_value();
+          else
+            {
+              v = fpattern->get_operands(operand++) + first;
+              if (it->first == FBINARYT)
+                for (k = 0; k < n; k++)
+                  s1[k] = T[v[k]*T_nrows+it_];
+              else
+                for (k = 0; k < n; k++)
+                  s1[k] = T[v[k]];
+            }
+          /* fall through */
+        case FBINARY:
+          strip_binary(((FBINARY_ *) it->second)->get_op_type(), sp, n);
+          break;
+        case FUNARY:
+          strip_unary(((FUNARY_ *) it->second)->get_op_type(), sp, n);
+          break;
+        case FTRINARY:
+          strip_trinary(((FTRINARY_ *) it->second)->get_op_type(), sp, n);
+          break;
+        case FSTPR:
+          v = fpattern->get_operands(operand++) + first;
+          s1 = strip(--sp);
+          for (k = 0; k < n; k++)
+            r[v[k]] = s1[k];
+          break;
+        default:
+          ostringstream tmp;
+          tmp << " in evaluate_pattern, unknown opcode " << it->first << "\n";
+          throw FatalExceptionHandling(tmp.str());
+        }
+    }
+}
+
+void
+Evaluate::set_pattern_row(const it_code_type &pattern, const int row)
+{
+  /* Writes the operands of a row in the body of an FPATTERN, so that it can be printed
+     as the code of the equation of this row */
+  FPATTERN_ *fpattern = (FPATTERN_ *) pattern->second;
+  unsigned int operand = 0, v;
+  it_code_type end = pattern + fpattern->get_nb_instructions() + 1;
+  for (it_code_type it = pattern + 1; it != end; it++)
+    {
+      if (it->first == FNUMEXPR)
+        {
+          *((FNUMEXPR_ *) it->second) = FNUMEXPR_(ModelEquation, fpattern->get_equations()[row]);
+          continue;
+        }
+      if (it->first != FLDV && it->first != FLDY && it->first != FLDX && it->first != FLDXD
+          && it->first != FLDSV && it->first != FLDT && it->first != FLDST
+          && it->first != FBINARYT && it->first != FBINARYST && it->first != FSTPR)
+        continue;
+      v = fpattern->get_operands(operand++)[row];
+      switch (it->first)
+        {
+        case FLDV:
+          *((FLDV_ *) it->second) = FLDV_(((FLDV_ *) it->second)->get_type(), v, ((FLDV_ *) it->second)->get_lead_lag());
+          break;
+        case FLDY:
+          *((FLDY_ *) it->second) = FLDY_(((FLDY_ *) it->second)->get_offset() - (int) ((FLDY_ *) it->second)->get_pos() + (int) v, v);
+          break;
+        case FLDX:
+          *((FLDX_ *) it->second) = FLDX_(((FLDX_ *) it->second)->get_offset() + ((int) v - (int) ((FLDX_ *) it->second)->get_pos())*nb_row_x, v);
+          break;
+        case FLDXD:
+          *((FLDXD_ *) it->second) = FLDXD_(((FLDXD_ *) it->second)->get_offset() + ((int) v - (int) ((FLDXD_ *) it->second)->get_pos())*nb_row_xd, v);
+          break;
+        case FLDSV:
+          *((FLDSV_ *) it->second) = FLDSV_(((FLDSV_ *) it->second)->get_type(), v);
+          break;
+        case FLDT:
+          *((FLDT_ *) it->second) = FLDT_(v);
+          break;
+        case FLDST:
+          *((FLDST_ *) it->second) = FLDST_(v);
+          break;
+        case FBINARYT:
+          *((FBINARYT_ *) it->second) = FBINARYT_(((FBINARYT_ *) it->second)->get_op_type(), v);
+          break;
+        case FBINARYST:
+          *((FBINARYST_ *) it->second) = FBINARYST_(((FBINARYST_ *) it->second)->get_op_type(), v);
+          break;
+        default:
+          *((FSTPR_ *) it->second) = FSTPR_(v);
+        }
+    }
+}
+
+bool
+Evaluate::evaluate_pattern(const it_code_type &pattern, const int Per_u_, const bool evaluate)
+{
+  /* Evaluates all the rows of an FPATTERN, by strips of PERIOD_STRIP rows. If a floating
+     point error occurs, the rows of the strip are evaluated one by one to report the
+     error on the right equation, and false is returned */
+  FPATTERN_ *fpattern = (FPATTERN_ *) pattern->second;
+  int nb_rows = fpattern->get_nb_rows(), first, n = 0;
+  for (first = 0; first < nb_rows; first += n)
+    {
+      n = min(PERIOD_STRIP, nb_rows-first);
+      try
+        {
+          evaluate_pattern_rows(pattern, first, n, evaluate);
+        }
+      catch (FloatingPointExceptionHandling &fpeh)
+        {
+          for (int row = first; row < first+n; row++)
+            try
+              {
+                evaluate_pattern_rows(pattern, row, 1, evaluate);
+              }
+            catch (FloatingPointExceptionHandling &fpeh_row)
+              {
+                set_pattern_row(pattern, row);
+                it_code_expr = pattern + 1;
+                mexPrintf("%s      %s\n", fpeh_row.GetErrorMsg().c_str(), error_location(evaluate, steady_state, size, block_num, it_, Per_u_).c_str());
+                set_pattern_row(pattern, 0);
+                return false;
+              }
+          mexPrintf("%s\n", fpeh.GetErrorMsg().c_str());
+          return false;
+        }
+    }
+  return true;
+}
+
+t_block_profile &
+Evaluate::get_block_profile(const int block_num)
+{
+  if ((unsigned int) block_num >= block_profile.size())
+    block_profile.resize(block_num+1);
+  return block_profile[block_num];
+}
+
+void
+Evaluate::print_profile() const
+{
+  mexPrintf("Block  Evaluations   Instructions  Iterations Evaluation  Assembly Factorization     Solve Line search    nnz(A)  nnz(L+U)\n");
+  mexPrintf("                                                    (ms)      (ms)          (ms)      (ms)        (ms)\n");
+  for (unsigned int i = 0; i < block_profile.size(); i++)
+    {
+      const t_block_profile &p = block_profile[i];
+      if (!p.nb_evaluations && !p.nb_iterations)
+        continue;
+      mexPrintf("%5d %12ld %14ld %11ld %10.3f %9.3f %13.3f %9.3f %11.3f %9.0f %9.0f\n", i+1,
+                p.nb_evaluations, p.nb_instructions, p.nb_iterations, p.evaluation_time, p.assembly_time,
+                p.factorization_time, p.solve_time, p.line_search_time, p.nnz_A, p.nnz_LU);
+    }
+  mexEvalString("drawnow;");
+}
+
+void
+Evaluate::report_profile() const
+{
+  for (unsigned int i = 0; i < block_profile.size(); i++)
+    {
+      const t_block_profile &p = block_profile[i];
+      if (!p.nb_evaluations && !p.nb_iterations)
+        continue;
+      char prefix[32];
+      sprintf(prefix, "block_%u/", i+1);
+      string name(prefix);
+      INSTRUMENT_COUNT((name + "evaluations").c_str(), p.nb_evaluations);
+      INSTRUMENT_COUNT((name + "instructions").c_str(), p.nb_instructions);
+      INSTRUMENT_COUNT((name + "iterations").c_str(), p.nb_iterations);
+      INSTRUMENT_COUNT((name + "evaluation_seconds").c_str(), p.evaluation_time/1000);
+      INSTRUMENT_COUNT((name + "assembly_seconds").c_str(), p.assembly_time/1000);
+      INSTRUMENT_COUNT((name + "factorization_seconds").c_str(), p.factorization_time/1000);
+      INSTRUMENT_COUNT((name + "solve_seconds").c_str(), p.solve_time/1000);
+      INSTRUMENT_COUNT((name + "line_search_seconds").c_str(), p.line_search_time/1000);
+    }
+}
+
+bool
+Evaluate::evaluate_native(const bool forward)
+{
+  if (profile || block >= 0 || block_num >= (int) native_blocks.size() || native_blocks[block_num] == NULL)
+    return false;
+  NativeCode::block_function f = native_blocks[block_num];
+  it_code_type begining = it_code;
+  int error = 0;
+  /* A period in which the native code meets a floating point error is computed again by
+     compute_block_time(), which reports the error as without native code */
+  if (steady_state)
+    {
+      f(y, x, params, T, &error);
+      if (error)
+        compute_block_time(0, false, false);
+    }
+  else if (forward)
+    for (it_ = y_kmin; it_ < periods+y_kmin; it_++)
+      {
+        error = 0;
+        f(y+it_*y_size, x+it_, params, T+it_, &error);
+        if (error)
+          {
+            it_code = begining;
+            compute_block_time(0, false, false);
+          }
+      }
+  else
+    for (it_ = periods+y_kmin-1; it_ >= y_kmin; it_--)
+      {
+        error = 0;
+        f(y+it_*y_size, x+it_, params, T+it_, &error);
+        if (error)
+          {
+            it_code = begining;
+            compute_block_time(0, false, false);
+          }
+      }
+  // Leave it_code after the end of the block, as compute_block_time() does
+  it_code = begining + native_block_length[block_num];
+  return true;
+}
+
 void
 Evaluate::evaluate_over_periods(const bool forward)
 {
+  if (evaluate_native(forward))
+    return;
   if (steady_state)
     compute_block_time(0, false, false);
   else
     {
       it_code_type begining = it_code;
+      if (periods > 1 && strip_evaluable(forward))
+        {
+          /* If a floating point error occurs in a strip, the remaining periods are
+             evaluated one by one, so that the error is reported by compute_block_time() */
+          bool ok = true;
+          if (forward)
+            {
+              for (it_ = y_kmin; ok && it_ < periods+y_kmin; it_ += PERIOD_STRIP)
+                ok = evaluate_strip(begining, it_, min(PERIOD_STRIP, periods+y_kmin-it_));
+              if (ok)
+                it_ = periods+y_kmin;
+              else
+                it_ -= PERIOD_STRIP;
+            }
+          else
+            {
+              for (it_ = periods+y_kmin-1; ok && it_ >= y_kmin; it_ -= PERIOD_STRIP)
+                {
+                  int n = min(PERIOD_STRIP, it_-y_kmin+1);
+                  ok = evaluate_strip(begining, it_-n+1, n);
+                }
+              if (ok)
+                it_ = y_kmin-1;
+              else
+                it_ += PERIOD_STRIP;
+            }
+          if (ok)
+            {
+              // Leave it_code after the end of the block, as compute_block_time() does
+              it_code++;
+              return;
+            }
+        }
+      else if (forward)
+        it_ = y_kmin;
+      else
+        it_ = periods+y_kmin-1;
       if (forward)
         {
-          for (it_ = y_kmin; it_ < periods+y_kmin; it_++)
+          for (; it_ < periods+y_kmin; it_++)
             {
               it_code = begining;
               compute_block_time(0, false, false);
@@ -1516,7 +2225,7 @@ Evaluate::evaluate_over_periods(const bool forward)
         }
       else
         {
-          for (it_ = periods+y_kmin-1; it_ >= y_kmin; it_--)
+          for (; it_ >= y_kmin; it_--)
             {
               it_code = begining;
               compute_block_time(0, false, false);
@@ -1607,7 +2316,7 @@ Evaluate::solve_simple_over_periods(const bool forward)
 }
 
 void
-Evaluate::set_block(const int size_arg, const int type_arg, string file_name_arg, string bin_base_name_arg, const int block_num_arg,
+Evaluate::set_block(const int size_arg, const int type_arg, const string &file_name_arg, const string &bin_base_name_arg, const int block_num_arg,
                     const bool is_linear_arg, const int symbol_table_endo_nbr_arg, const int Block_List_Max_Lag_arg, const int Block_List_Max_Lead_arg, const int u_count_int_arg, const int block_arg)
 {
   size = size_arg;
@@ -1630,6 +2339,108 @@ Evaluate::evaluate_complete(const bool no_derivatives)
   compute_block_time(0, false, no_derivatives);
 }
 
+bool
+Evaluate::periods_independent() const
+{
+  for (it_code_type it = start_code; it->first != FENDBLOCK; it++)
+    switch (it->first)
+      {
+      case FSTPV:
+      case FSTPSV:
+      case FSTPG:
+      case FSTPG2:
+      case FSTPG3:
+      case FCALL:
+      case FSTPTEF:
+      case FSTPTEFD:
+      case FSTPTEFDD:
+        return false;
+      default:
+        break;
+      }
+  return true;
+}
+
+bool
+Evaluate::compute_periods_parallel(const bool no_derivatives)
+{
+#ifdef USE_OMP
+  /* Each thread evaluates its periods with its own copy of the interpreter state (operand
+     stack, current period, residual vector), and writes the elements of the stacked Jacobian
+     and of the residuals that belong to these periods. The copies do not report the errors:
+     if one occurs, the block is evaluated again period by period */
+  int nb_threads = min(period_threads, periods);
+  vector<Evaluate> workers(nb_threads, *this);
+  vector<double> r_workers(nb_threads*size);
+  vector<char> failed(periods, 0);
+  it_code_type end_block = start_code;
+  for (int i = 0; i < nb_threads; i++)
+    {
+      workers[i].r = &r_workers[i*size];
+      workers[i].period_worker = true;
+      workers[i].print_error = false;
+    }
+#pragma omp parallel for num_threads(nb_threads) schedule(static)
+  for (int t = 0; t < periods; t++)
+    {
+      Evaluate &worker = workers[omp_get_thread_num()];
+      worker.it_ = t+y_kmin;
+      worker.Per_u_ = t*u_count_int;
+      worker.Per_y_ = worker.it_*y_size;
+      worker.it_code = start_code;
+      worker.res1 = 0;
+      try
+        {
+          worker.compute_block_time(worker.Per_u_, false, no_derivatives);
+          failed[t] = isnan(worker.res1) || isinf(worker.res1);
+        }
+      catch (...)
+        {
+          failed[t] = true;
+        }
+      if (!failed[t])
+        memcpy(&res[t*size], worker.r, size*sizeof(double));
+      if (t == periods-1)
+        end_block = worker.it_code;
+    }
+  for (int t = 0; t < periods; t++)
+    if (failed[t])
+      return false;
+  // State left by the evaluation of the last period
+  it_ = periods+y_kmin;
+  Per_u_ = (periods-1)*u_count_int;
+  Per_y_ = (periods+y_kmin-1)*y_size;
+  it_code = end_block;
+  memcpy(r, &res[(periods-1)*size], size*sizeof(double));
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool
+Evaluate::evaluate_block_copy(FBEGINBLOCK_ *fb, const it_code_type &begining, const int block_num_arg)
+{
+  /* As in compute_periods_parallel(), the copy neither polls MATLAB nor reports the
+     errors: the block is then computed again by the interpreter itself */
+  period_worker = true;
+  print_error = false;
+  size = fb->get_size();
+  type = fb->get_type();
+  block_num = block_num_arg;
+  it_code = begining;
+  res1 = 0;
+  try
+    {
+      evaluate_over_periods(type == EVALUATE_FORWARD);
+    }
+  catch (...)
+    {
+      return false;
+    }
+  return !(isnan(res1) || isinf(res1));
+}
+
 void
 Evaluate::compute_complete_2b(const bool no_derivatives, double *_res1, double *_res2, double *_max_res, int *_max_res_idx)
 {
@@ -1637,6 +2448,24 @@ Evaluate::compute_complete_2b(const bool no_derivatives, double *_res1, double *
   *_res1 = 0;
   *_res2 = 0;
   *_max_res = 0;
+  if (period_threads > 1 && periods > 1 && !profile && periods_independent()
+      && compute_periods_parallel(no_derivatives))
+    {
+      if (!block_complementarity.empty())
+        complementarity_2b(no_derivatives);
+      for (int i = 0; i < size*periods; i++)
+        {
+          double rr = res[i];
+          if (max_res < fabs(rr))
+            {
+              *_max_res = fabs(rr);
+              *_max_res_idx = i % size;
+            }
+          *_res2 += rr*rr;
+          *_res1 += fabs(rr);
+        }
+      return;
+    }
   for (it_ = y_kmin; it_ < periods+y_kmin; it_++)
     {
       Per_u_ = (it_-y_kmin)*u_count_int;
@@ -1665,9 +2494,69 @@ Evaluate::compute_complete_2b(const bool no_derivatives, double *_res1, double *
       else
         return;
     }
+  if (!block_complementarity.empty())
+    {
+      complementarity_2b(no_derivatives);
+      *_res1 = 0;
+      *_res2 = 0;
+      *_max_res = 0;
+      for (int i = 0; i < size*periods; i++)
+        {
+          double rr = res[i];
+          if (*_max_res < fabs(rr))
+            {
+              *_max_res = fabs(rr);
+              *_max_res_idx = i % size;
+            }
+          *_res2 += rr*rr;
+          *_res1 += fabs(rr);
+        }
+    }
   return;
 }
 
+double
+Evaluate::complementarity_residual(const t_block_complementarity &c, const int t, const double F, double *dphi_dF, double *dphi_dx) const
+{
+  double x = y[index_vara[c.variable+size*(t+y_kmin)]];
+  double a = c.upper ? c.bound-x : x-c.bound;
+  double b = c.upper ? -F : F;
+  double norm = sqrt(a*a+b*b);
+  // phi is not differentiable at the origin, where any element of its generalized Jacobian can be used
+  double da = norm > 0 ? 1-a/norm : 1-M_SQRT1_2;
+  double db = norm > 0 ? 1-b/norm : 1-M_SQRT1_2;
+  *dphi_dF = c.upper ? -db : db;
+  *dphi_dx = c.upper ? -da : da;
+  return a+b-norm;
+}
+
+void
+Evaluate::complementarity_2b(const bool no_derivatives)
+{
+  for (int t = 0; t < periods; t++)
+    for (vector<t_block_complementarity>::const_iterator it = block_complementarity.begin(); it != block_complementarity.end(); it++)
+      {
+        double &F = res[it->equation+t*size];
+        double dphi_dF, dphi_dx;
+        double phi = complementarity_residual(*it, t, F, &dphi_dF, &dphi_dx);
+        if (!no_derivatives)
+          {
+            /* The right hand side stored in u is F-J*y, where J is the row of
+               the equation in the stacked Jacobian. The row of phi is
+               dphi_dF*J+dphi_dx*e, where e selects the variable, so that the
+               pattern of the Jacobian (and its symbolic factorization) is kept */
+            int Per_u = t*u_count_int;
+            double x = y[index_vara[it->variable+size*(t+y_kmin)]];
+            double &rhs = u[it->equation+Per_u];
+            rhs = phi - dphi_dF*(F-rhs) - dphi_dx*x;
+            for (vector<int>::const_iterator it1 = it->row_u.begin(); it1 != it->row_u.end(); it1++)
+              u[*it1+Per_u] *= dphi_dF;
+            u[it->own_u+Per_u] += dphi_dx;
+          }
+        F = phi;
+      }
+}
+
 bool
 Evaluate::compute_complete(const bool no_derivatives, double &_res1, double &_res2, double &_max_res, int &_max_res_idx)
 {
@@ -1746,6 +2635,14 @@ Evaluate::compute_complete(double lambda, double *crit)
           Per_y_ = it_*y_size;
           if (compute_complete(true, res1, res2, max_res, max_res_idx))
             {
+              // The complementarity equations enter the criterion through their reformulation
+              for (vector<t_block_complementarity>::const_iterator it = block_complementarity.begin(); it != block_complementarity.end(); it++)
+                {
+                  double F = r[it->equation], dphi_dF, dphi_dx;
+                  double phi = complementarity_residual(*it, it_-y_kmin, F, &dphi_dF, &dphi_dx);
+                  res2 += phi*phi - F*F;
+                  res1 += fabs(phi) - fabs(F);
+                }
               res2_ += res2;
               res1_ += res1;
               if (max_res > max_res_)
@@ -21,9 +21,11 @@
 #define EVALUATE_HH_INCLUDED
 
 #include <stack>
+#include <set>
 #include <vector>
 #include <string>
 #include <cmath>
+#include <ctime>
 #define BYTE_CODE
 #include "CodeInterpreter.hh"
 #ifdef LINBCG
@@ -35,15 +37,99 @@
 # include "mex_interface.hh"
 #endif
 #include "ErrorHandling.hh"
+#include "NativeCode.hh"
+#include <instrumentation.hh>
 
 #define pow_ pow
 
+//! Number of periods processed by each instruction in evaluate_strip()
+#define PERIOD_STRIP 64
+
+//! Counters of a block, accumulated when the profile option is used
+struct t_block_profile
+{
+  long int nb_evaluations, nb_instructions, nb_iterations;
+  double evaluation_time, assembly_time, factorization_time, solve_time, line_search_time;
+  //! Number of nonzero elements of the Jacobian and of its LU factors, at the last factorization
+  double nnz_A, nnz_LU;
+  t_block_profile() : nb_evaluations(0), nb_instructions(0), nb_iterations(0),
+                      evaluation_time(0), assembly_time(0), factorization_time(0), solve_time(0), line_search_time(0),
+                      nnz_A(0), nnz_LU(0)
+  {
+  };
+};
+
+//! Complementarity condition of an equation tagged mcp, between a bound on a variable and the residual of the equation
+/*! With a lower bound, either the variable is at the bound and the residual
+  is non-negative, or the residual is zero; with an upper bound, the residual
+  is non-positive when the variable is at the bound */
+struct t_complementarity
+{
+  int variable;
+  double bound;
+  bool upper;
+};
+
+//! Complementarity condition of an equation of the current two boundaries block
+struct t_block_complementarity
+{
+  //! Equation and variable in the block
+  int equation, variable;
+  double bound;
+  bool upper;
+  //! Positions in u (in the first period) of the derivative of the equation with respect to the variable, and of all the derivatives of the equation
+  int own_u;
+  vector<int> row_u;
+};
+
 class Evaluate : public ErrorMsg
 {
 private:
-  unsigned int EQN_dvar1, EQN_dvar2, EQN_dvar3;
-  int EQN_lag1, EQN_lag2, EQN_lag3;
+  //! Operand stack of compute_block_time(), kept across calls so that its storage is allocated only once
+  stack<double, vector<double> > operand_stack;
+  //! Operand stack of evaluate_strip() and evaluate_pattern(), one strip of PERIOD_STRIP periods (or rows) per operand
+  vector<double> strip_stack;
+  inline double *
+  strip(const int i)
+  {
+    return &strip_stack[i*PERIOD_STRIP];
+  };
+  double *strip_push(int &sp);
+  bool strip_evaluable(const bool forward);
+  bool evaluate_strip(const it_code_type &begining, const int first, const int n);
+  void strip_binary(const int op, int &sp, const int n);
+  void strip_unary(const int op, int &sp, const int n);
+  void strip_trinary(const int op, int &sp, const int n);
+  void evaluate_pattern_rows(const it_code_type &pattern, const int first, const int n, const bool evaluate);
+  void set_pattern_row(const it_code_type &pattern, const int row);
+  bool evaluate_pattern(const it_code_type &pattern, const int Per_u_, const bool evaluate);
+  //! True for the copies evaluating periods in compute_periods_parallel(), which must not poll MATLAB
+  bool period_worker;
+  //! True if the periods of the current block only write their own residuals, Jacobian elements and temporary terms
+  bool periods_independent() const;
+  //! Computes the residuals and the Jacobian of all the periods of a two boundaries block on period_threads threads, returns false on error
+  bool compute_periods_parallel(const bool no_derivatives);
+  //! Replaces the residuals (and if derivatives are computed, the Jacobian) of the complementarity equations by those of their Fischer-Burmeister reformulation
+  void complementarity_2b(const bool no_derivatives);
+  //! Computes the current evaluated block over the periods with its native code, returns false if it has none
+  bool evaluate_native(const bool forward);
 protected:
+  //! Native code of each block, NULL if the block is interpreted (see Interpreter::compile_native_blocks())
+  vector<NativeCode::block_function> native_blocks;
+  //! Number of instructions of each block after its FBEGINBLOCK, up to its FENDBLOCK included
+  vector<size_t> native_block_length;
+  //! Complementarity conditions of the current block, set by Read_SparseMatrix()
+  vector<t_block_complementarity> block_complementarity;
+  //! Fischer-Burmeister function phi(a, b) = a+b-sqrt(a²+b²) of condition c in period t, where F is the residual of the equation
+  double complementarity_residual(const t_block_complementarity &c, const int t, const double F, double *dphi_dF, double *dphi_dx) const;
+  vector<t_block_profile> block_profile;
+  t_block_profile &get_block_profile(const int block_num);
+  //! Time elapsed since t0, in milliseconds
+  inline double
+  elapsed_ms(const clock_t t0) const
+  {
+    return 1000.0*(double (clock())-double (t0))/double (CLOCKS_PER_SEC);
+  };
   mxArray *GlobalTemporaryTerms;
   it_code_type start_code, end_code;
   double pow1(double a, double b);
@@ -82,11 +168,22 @@ protected:
   bool Gaussian_Elimination, is_linear;
 public:
   bool steady_state;
+  //! Accumulates the counters of each block, printed by print_profile()
+  bool profile;
+  void print_profile() const;
+  //! Adds the counters of each block to the instrumentation profile
+  void report_profile() const;
+  //! Number of threads evaluating the periods of two boundaries blocks, and the independent evaluated blocks (options_.threads.bytecode)
+  int period_threads;
+  //! Evaluates an EVALUATE_FORWARD or EVALUATE_BACKWARD block in a copy of the interpreter state made by Interpreter::evaluate_concurrent_blocks(), returns false on error
+  bool evaluate_block_copy(FBEGINBLOCK_ *fb, const it_code_type &begining, const int block_num_arg);
+  //! Complementarity conditions of the equations tagged mcp, by equation, imposed in the two boundaries blocks
+  map<int, t_complementarity> complementarity_conditions;
   double slowc;
   Evaluate();
   Evaluate(const int y_size_arg, const int y_kmin_arg, const int y_kmax_arg, const bool print_it_arg, const bool steady_state_arg, const int periods_arg, const int minimal_solving_periods_arg, const double slowc);
   //typedef  void (Interpreter::*InterfpreterMemFn)(const int block_num, const int size, const bool steady_state, int it);
-  void set_block(const int size_arg, const int type_arg, string file_name_arg, string bin_base_name_arg, const int block_num_arg,
+  void set_block(const int size_arg, const int type_arg, const string &file_name_arg, const string &bin_base_name_arg, const int block_num_arg,
                  const bool is_linear_arg, const int symbol_table_endo_nbr_arg, const int Block_List_Max_Lag_arg, const int Block_List_Max_Lead_arg, const int u_count_int_arg, const int block_arg);
   void evaluate_complete(const bool no_derivatives);
   bool compute_complete(const bool no_derivatives, double &res1, double &res2, double &max_res, int &max_res_idx);
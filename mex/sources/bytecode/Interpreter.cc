@@ -20,7 +20,11 @@
 #include <cstring>
 #include <sstream>
 #include <algorithm>
+#include <set>
 #include "Interpreter.hh"
+#ifdef USE_OMP
+# include <omp.h>
+#endif
 #define BIG 1.0e+8;
 #define SMALL 1.0e-5;
 ///#define DEBUG
@@ -68,8 +72,11 @@ Interpreter::Interpreter(double *params_arg, double *y_arg, double *ya_arg, doub
   markowitz_c = markowitz_c_arg;
   filename = filename_arg;
   T = NULL;
+  warm_start = false;
   minimal_solving_periods = minimal_solving_periods_arg;
-  stack_solve_algo = stack_solve_algo_arg;
+  // stack_solve_algo=8: the solver of each two boundaries block is selected by timing, the structures are those of stack_solve_algo=0
+  auto_stack_solve_algo = stack_solve_algo_arg == 8 && !steady_state_arg;
+  stack_solve_algo = auto_stack_solve_algo ? 0 : stack_solve_algo_arg;
   solve_algo = solve_algo_arg;
   global_temporary_terms = global_temporary_terms_arg;
   print = print_arg;
@@ -85,6 +92,7 @@ Interpreter::Interpreter(double *params_arg, double *y_arg, double *ya_arg, doub
 void
 Interpreter::evaluate_a_block(bool initialization)
 {
+  INSTRUMENT_SCOPE("evaluate_a_block");
   it_code_type begining;
 
   switch (type)
@@ -318,8 +326,9 @@ Interpreter::evaluate_a_block(bool initialization)
 }
 
 int
-Interpreter::simulate_a_block(vector_table_conditional_local_type vector_table_conditional_local)
+Interpreter::simulate_a_block(const vector_table_conditional_local_type &vector_table_conditional_local)
 {
+  INSTRUMENT_SCOPE("simulate_a_block");
   it_code_type begining;
   max_res = 0;
   max_res_idx = 0;
@@ -444,7 +453,8 @@ Interpreter::simulate_a_block(vector_table_conditional_local_type vector_table_c
       test_mxMalloc(y_save, __LINE__, __FILE__, __func__, y_size*sizeof(double)*(periods+y_kmax+y_kmin));
       start_code = it_code;
       iter = 0;
-      if (!is_linear)
+      // The reformulation of the complementarity conditions makes the block nonlinear
+      if (!is_linear || !block_complementarity.empty())
         {
           cvg = false;
           glambda2 = g0 = very_big;
@@ -459,7 +469,7 @@ Interpreter::simulate_a_block(vector_table_conditional_local_type vector_table_c
               memcpy(y_save, y, y_size*sizeof(double)*(periods+y_kmax+y_kmin));
               if (vector_table_conditional_local.size())
                 {
-                  for (vector_table_conditional_local_type::iterator it1 = vector_table_conditional_local.begin(); it1 != vector_table_conditional_local.end(); it1++)
+                  for (vector_table_conditional_local_type::const_iterator it1 = vector_table_conditional_local.begin(); it1 != vector_table_conditional_local.end(); it1++)
                     {
                       if (it1->is_cond)
                         {
@@ -540,6 +550,14 @@ Interpreter::print_a_block()
     mexPrintf("\nBlock %d\n", block_num+1);
   else
     mexPrintf("\nBlock %d\n", block+1);
+  int b = block < 0 ? block_num : block;
+  if (b < (int) block_level.size())
+    {
+      mexPrintf("level %d, depends on blocks:", block_level[b]+1);
+      for (vector<unsigned int>::const_iterator it = block_dependencies[b].begin(); it != block_dependencies[b].end(); it++)
+        mexPrintf(" %d", *it+1);
+      mexPrintf("\n");
+    }
   mexPrintf("----------\n");
   if (steady_state)
     residual = vector<double>(size);
@@ -596,15 +614,257 @@ Interpreter::ReadCodeFile(string file_name, CodeLoad &code)
       tmp << " in compute_blocks, input argument block = " << block+1 << " is greater than the number of blocks in the model (" << code.get_block_number() << " see M_.block_structure_stat.block)\n";
       throw FatalExceptionHandling(tmp.str());
     }
+  code.resolve_variables(code_liste, y_size, nb_row_x, nb_row_xd);
+  compute_block_levels();
+  compile_native_blocks();
+}
+
+void
+Interpreter::compile_native_blocks()
+{
+  native_code.clear();
+  native_blocks.assign(block_begin.size(), NULL);
+  native_block_length.assign(block_begin.size(), 0);
+  if (!NativeCode::available())
+    return;
+  vector<unsigned int> compiled;
+  for (unsigned int b = 0; b < block_begin.size(); b++)
+    {
+      FBEGINBLOCK_ *fb = (FBEGINBLOCK_ *) code_liste[block_begin[b]].second;
+      if ((fb->get_type() == EVALUATE_FORWARD || fb->get_type() == EVALUATE_BACKWARD)
+          && native_code.add_block(b, code_liste.begin() + block_begin[b] + 1, steady_state,
+                                   y_size, nb_row_x, nb_row_xd, periods+y_kmin+y_kmax))
+        compiled.push_back(b);
+    }
+  // If the memory cannot be made executable, all the blocks are interpreted
+  if (compiled.size() && native_code.finalize())
+    for (vector<unsigned int>::const_iterator it = compiled.begin(); it != compiled.end(); it++)
+      {
+        native_blocks[*it] = native_code.get_function(*it);
+        native_block_length[*it] = block_end[*it] - block_begin[*it] - 1;
+      }
+}
+
+/* Checks that the code of a block, as executed in a simulation, only loads values and
+   stores endogenous variables and temporary terms, and collects the temporary terms that
+   it reads and stores */
+static bool
+concurrent_block_code(it_code_type it, vector<unsigned int> &read, vector<unsigned int> &stored)
+{
+  set<unsigned int> r, s;
+  for (;; it++)
+    switch (it->first)
+      {
+      case FNUMEXPR:
+      case FLDV:
+      case FLDSV:
+      case FLDVS:
+      case FLDY:
+      case FLDX:
+      case FLDXD:
+      case FLDZ:
+      case FLDC:
+      case FBINARYC:
+      case FBINARY:
+      case FUNARY:
+      case FTRINARY:
+      case FENDEQU:
+      case FJMPIFEVAL:
+      case FOK:
+        break;
+      case FJMP:
+        it += ((FJMP_ *) it->second)->get_pos();
+        break;
+      case FLDT:
+        r.insert(((FLDT_ *) it->second)->get_pos());
+        break;
+      case FLDST:
+        r.insert(((FLDST_ *) it->second)->get_pos());
+        break;
+      case FBINARYT:
+        r.insert(((FBINARYT_ *) it->second)->get_pos());
+        break;
+      case FBINARYST:
+        r.insert(((FBINARYST_ *) it->second)->get_pos());
+        break;
+      case FSTPT:
+        s.insert(((FSTPT_ *) it->second)->get_pos());
+        break;
+      case FSTPST:
+        s.insert(((FSTPST_ *) it->second)->get_pos());
+        break;
+      case FSTPV:
+        if (((FSTPV_ *) it->second)->get_type() != eEndogenous)
+          return false;
+        break;
+      case FSTPSV:
+        if (((FSTPSV_ *) it->second)->get_type() != eEndogenous)
+          return false;
+        break;
+      case FENDBLOCK:
+        read.assign(r.begin(), r.end());
+        stored.assign(s.begin(), s.end());
+        return true;
+      default:
+        return false;
+      }
+}
+
+static bool
+intersects(const vector<unsigned int> &a, const vector<unsigned int> &b)
+{
+  vector<unsigned int>::const_iterator it_a = a.begin(), it_b = b.begin();
+  while (it_a != a.end() && it_b != b.end())
+    if (*it_a < *it_b)
+      it_a++;
+    else if (*it_b < *it_a)
+      it_b++;
+    else
+      return true;
+  return false;
+}
+
+void
+Interpreter::compute_block_levels()
+{
+  block_dependencies.clear();
+  block_level.clear();
+  block_begin.clear();
+  block_end.clear();
+  vector<bool> evaluated;
+  vector<vector<unsigned int> > read, stored;
+  for (it_code_type it = code_liste.begin(); it != code_liste.end(); it++)
+    if (it->first == FBEGINBLOCK)
+      {
+        FBEGINBLOCK_ *fb = (FBEGINBLOCK_ *) it->second;
+        vector<unsigned int> dependencies = fb->get_dependencies();
+        unsigned int level = 0;
+        for (vector<unsigned int>::const_iterator it1 = dependencies.begin(); it1 != dependencies.end(); it1++)
+          if (*it1 < block_level.size())
+            level = max(level, block_level[*it1]+1);
+        block_dependencies.push_back(dependencies);
+        block_level.push_back(level);
+        block_begin.push_back(it - code_liste.begin());
+        vector<unsigned int> r, s;
+        evaluated.push_back((fb->get_type() == EVALUATE_FORWARD || fb->get_type() == EVALUATE_BACKWARD)
+                            && concurrent_block_code(it+1, r, s));
+        read.push_back(r);
+        stored.push_back(s);
+      }
+    else if (it->first == FENDBLOCK)
+      block_end.push_back(it - code_liste.begin() + 1);
+
+  /* Consecutive evaluated blocks form a run. The level of a block in its run is one more
+     than the highest level of the previous blocks of the run with which it conflicts: those
+     on which it depends, those which depend on it (through a lead or a lag), and those which
+     store temporary terms that it reads or stores, or read temporary terms that it stores.
+     The blocks of a run with the same level can then be computed in any order, the levels
+     being computed one after the other */
+  unsigned int nb_blocks = block_begin.size();
+  concurrent_level = vector<int>(nb_blocks, -1);
+  concurrent_run_end = vector<unsigned int>(nb_blocks, 0);
+  if (block_end.size() != nb_blocks)
+    return;
+  for (unsigned int first = 0; first < nb_blocks; first++)
+    {
+      unsigned int last = first;
+      while (last < nb_blocks && evaluated[last])
+        last++;
+      if (last == first)
+        continue;
+      int nb_levels = 0;
+      for (unsigned int b = first; b < last; b++)
+        {
+          int level = 0;
+          for (unsigned int a = first; a < b; a++)
+            if (concurrent_level[a] >= level
+                && (binary_search(block_dependencies[b].begin(), block_dependencies[b].end(), a)
+                    || binary_search(block_dependencies[a].begin(), block_dependencies[a].end(), b)
+                    || intersects(stored[a], read[b]) || intersects(stored[a], stored[b])
+                    || intersects(read[a], stored[b])))
+              level = concurrent_level[a]+1;
+          concurrent_level[b] = level;
+          concurrent_run_end[b] = last;
+          nb_levels = max(nb_levels, level+1);
+        }
+      // Nothing can be computed concurrently in a chain
+      if (nb_levels == (int) (last-first))
+        for (unsigned int b = first; b < last; b++)
+          concurrent_level[b] = -1;
+      first = last;
+    }
+}
+
+bool
+Interpreter::evaluate_concurrent_blocks(const unsigned int first, const string &bin_basename, const bool last_call)
+{
+#ifdef USE_OMP
+  unsigned int last = concurrent_run_end[first];
+  int nb_levels = 0;
+  for (unsigned int b = first; b < last; b++)
+    nb_levels = max(nb_levels, concurrent_level[b]+1);
+
+  /* Each thread computes its blocks in its own copy of the interpreter state (operand
+     stack, current period, error location), the code, the variables and the temporary
+     terms being shared. The code is moved out of the object while it is copied. */
+  code_liste_type code;
+  code.swap(code_liste);
+  vector<Evaluate> workers(period_threads, *this);
+  code.swap(code_liste);
+
+  int failed_level = nb_levels;
+  for (int level = 0; level < nb_levels && failed_level == nb_levels; level++)
+    {
+      vector<unsigned int> blocks;
+      for (unsigned int b = first; b < last; b++)
+        if (concurrent_level[b] == level)
+          blocks.push_back(b);
+      vector<char> failed(blocks.size(), 0);
+#pragma omp parallel for num_threads(min(period_threads, (int) blocks.size())) schedule(dynamic)
+      for (int i = 0; i < (int) blocks.size(); i++)
+        {
+          it_code_type begining = code_liste.begin() + block_begin[blocks[i]];
+          failed[i] = !workers[omp_get_thread_num()].evaluate_block_copy((FBEGINBLOCK_ *) begining->second, begining+1, blocks[i]);
+        }
+      for (unsigned int i = 0; i < blocks.size(); i++)
+        if (failed[i])
+          failed_level = level;
+    }
 
+  /* After an error, the blocks of the failed level and of the following ones are computed
+     one by one in their order, so that the error is reported: each of them conflicts only
+     with blocks of lower levels, which have been computed, or with blocks that are computed
+     after it in the serial order too */
+  for (unsigned int b = first; b < last; b++)
+    {
+      FBEGINBLOCK_ *fb = (FBEGINBLOCK_ *) code_liste[block_begin[b]].second;
+      if (concurrent_level[b] >= failed_level || b == last-1)
+        {
+          Block_Count = b;
+          Block_Contain = fb->get_Block_Contain();
+          set_block(fb->get_size(), fb->get_type(), file_name, bin_basename, Block_Count, fb->get_is_linear(), fb->get_endo_nbr(), fb->get_Max_Lag(), fb->get_Max_Lead(), fb->get_u_count_int(), block);
+        }
+      if (concurrent_level[b] >= failed_level)
+        {
+          it_code = code_liste.begin() + block_begin[b] + 1;
+          simulate_a_block(vector_table_conditional_local_type());
+        }
+      if (last_call)
+        delete fb;
+    }
+  it_code = code_liste.begin() + block_end[last-1];
+  return true;
+#else
+  return false;
+#endif
 }
 
 void
-Interpreter::check_for_controlled_exo_validity(FBEGINBLOCK_ *fb, vector<s_plan> sconstrained_extended_path)
+Interpreter::check_for_controlled_exo_validity(FBEGINBLOCK_ *fb, const vector<s_plan> &sconstrained_extended_path)
 {
   vector<unsigned int> exogenous = fb->get_exogenous();
   vector<int> endogenous = fb->get_endogenous();
-  for (vector<s_plan>::iterator it = sconstrained_extended_path.begin(); it != sconstrained_extended_path.end(); it++)
+  for (vector<s_plan>::const_iterator it = sconstrained_extended_path.begin(); it != sconstrained_extended_path.end(); it++)
     {
       if ((find(endogenous.begin(), endogenous.end(), it->exo_num) != endogenous.end()) &&  (find(exogenous.begin(), exogenous.end(), it->var_num) == exogenous.end()))
         {
@@ -630,7 +890,7 @@ Interpreter::check_for_controlled_exo_validity(FBEGINBLOCK_ *fb, vector<s_plan>
 }
 
 bool
-Interpreter::MainLoop(string bin_basename, CodeLoad code, bool evaluate, int block, bool last_call, bool constrained, vector<s_plan> sconstrained_extended_path, vector_table_conditional_local_type vector_table_conditional_local)
+Interpreter::MainLoop(const string &bin_basename, const CodeLoad &code, bool evaluate, int block, bool last_call, bool constrained, const vector<s_plan> &sconstrained_extended_path, const vector_table_conditional_local_type &vector_table_conditional_local)
 {
   int var;
   Block_Count = -1;
@@ -651,6 +911,13 @@ Interpreter::MainLoop(string bin_basename, CodeLoad code, bool evaluate, int blo
       switch (it_code->first)
         {
         case FBEGINBLOCK:
+          /* In a simulation, the runs of independent evaluated blocks are computed
+             concurrently (see compute_block_levels()) */
+          if (block < 0 && !print && !evaluate && !constrained && !sconstrained_extended_path.size()
+              && !vector_table_conditional_local.size() && !profile && period_threads > 1
+              && Block_Count+1 < (int) concurrent_level.size() && concurrent_level[Block_Count+1] >= 0
+              && evaluate_concurrent_blocks(Block_Count+1, bin_basename, last_call))
+            break;
           Block_Count++;
 #ifdef DEBUG
           mexPrintf("---------------------------------------------------------\n");
@@ -847,7 +1114,7 @@ Interpreter::elastic(string str, unsigned int len, bool left)
 }
 
 bool
-Interpreter::extended_path(string file_name, string bin_basename, bool evaluate, int block, int &nb_blocks, int nb_periods, vector<s_plan> sextended_path, vector<s_plan> sconstrained_extended_path, vector<string> dates, table_conditional_global_type table_conditional_global)
+Interpreter::extended_path(const string &file_name, const string &bin_basename, bool evaluate, int block, int &nb_blocks, int nb_periods, const vector<s_plan> &sextended_path, const vector<s_plan> &sconstrained_extended_path, const vector<string> &dates, const table_conditional_global_type &table_conditional_global)
 {
   CodeLoad code;
 
@@ -863,8 +1130,8 @@ Interpreter::extended_path(string file_name, string bin_basename, bool evaluate,
   double *x_save = (double *) mxMalloc(nb_row_x * col_x *sizeof(double));
   test_mxMalloc(x_save, __LINE__, __FILE__, __func__, nb_row_x * col_x *sizeof(double));
 
-  vector_table_conditional_local_type vector_table_conditional_local;
-  vector_table_conditional_local.clear();
+  // Used for the periods without conditional forecast
+  const vector_table_conditional_local_type no_conditional_local;
 
   int endo_name_length_l = endo_name_length;
   for (int j = 0; j < col_x* nb_row_x; j++)
@@ -912,9 +1179,8 @@ Interpreter::extended_path(string file_name, string bin_basename, bool evaluate,
         }
 
       it_code = Init_Code;
-      vector_table_conditional_local.clear();
-      if (table_conditional_global.size())
-        vector_table_conditional_local = table_conditional_global[t];
+      table_conditional_global_type::const_iterator it_conditional = table_conditional_global.find(t);
+      const vector_table_conditional_local_type &vector_table_conditional_local = it_conditional != table_conditional_global.end() ? it_conditional->second : no_conditional_local;
       if (t < nb_periods)
         MainLoop(bin_basename, code, evaluate, block, false, true, sconstrained_extended_path, vector_table_conditional_local);
       else
@@ -925,6 +1191,10 @@ Interpreter::extended_path(string file_name, string bin_basename, bool evaluate,
           if (y_kmin > 0)
             y[j ] = y[ j +  (y_kmin) * y_size];
         }
+      if (warm_start && periods > 1)
+        /* The expected path computed in this period, shifted by one period, is
+           the initial guess of the next one (the last period is kept) */
+        memmove(y + y_kmin * y_size, y + (y_kmin + 1) * y_size, (periods - 1) * y_size * sizeof(double));
       for (int j = 0; j < col_x; j++)
         {
           x_save[t + y_kmin + j * nb_row_x] = x[y_kmin + j * nb_row_x];
@@ -961,13 +1231,20 @@ Interpreter::extended_path(string file_name, string bin_basename, bool evaluate,
   if (x_save)
     mxFree(x_save);
   nb_blocks = Block_Count+1;
+  Free_ILU_Cache();
+#ifdef CUDA
+  Free_CUDA_Buffers();
+#endif
   if (T && !global_temporary_terms)
-    mxFree(T);
+    {
+      mxFree(T);
+      T = NULL;
+    }
   return true;
 }
 
 bool
-Interpreter::compute_blocks(string file_name, string bin_basename, bool evaluate, int block, int &nb_blocks)
+Interpreter::compute_blocks(const string &file_name, const string &bin_basename, bool evaluate, int block, int &nb_blocks)
 {
   CodeLoad code;
   ReadCodeFile(file_name, code);
@@ -982,7 +1259,110 @@ Interpreter::compute_blocks(string file_name, string bin_basename, bool evaluate
 
   mxFree(Init_Code->second);
   nb_blocks = Block_Count+1;
+  Free_ILU_Cache();
+#ifdef CUDA
+  Free_CUDA_Buffers();
+#endif
   if (T && !global_temporary_terms)
-    mxFree(T);
+    {
+      mxFree(T);
+      T = NULL;
+    }
   return true;
 }
+
+void
+Interpreter::steady_state_sweep(const string &file_name, const string &bin_basename, int nb_params, const double *params_grid, int nb_points, double *ys, double *info)
+{
+  CodeLoad code;
+  ReadCodeFile(file_name, code);
+  it_code_type Init_Code = code_liste.begin();
+  vector<s_plan> s_plan_junk;
+  vector_table_conditional_local_type vector_table_conditional_local_junk;
+  vector<double> y_init(y, y+y_size);
+  keep_sparse_structures = true;
+
+  // The distance between two sets of parameters scales each parameter by its range over the grid
+  vector<double> scale(nb_params, 0.0);
+  for (int k = 0; k < nb_params; k++)
+    {
+      double min_p = params_grid[k], max_p = params_grid[k];
+      for (int j = 1; j < nb_points; j++)
+        {
+          min_p = min(min_p, params_grid[k+j*nb_params]);
+          max_p = max(max_p, params_grid[k+j*nb_params]);
+        }
+      if (max_p > min_p)
+        scale[k] = 1/(max_p-min_p);
+    }
+
+  /* Continuation: the next point is the unsolved one that is the nearest to a
+     point already solved, and it starts from the steady state of this neighbour */
+  vector<double> distance(nb_points, very_big);
+  vector<int> neighbour(nb_points, -1);
+  vector<bool> solved(nb_points, false);
+  int next = 0;
+  for (int n = 0; n < nb_points; n++)
+    {
+      int j = next;
+      solved[j] = true;
+      memcpy(params, params_grid + j*nb_params, nb_params*sizeof(double));
+      if (neighbour[j] >= 0)
+        memcpy(y, ys + neighbour[j]*y_size, y_size*sizeof(double));
+      else
+        memcpy(y, &y_init[0], y_size*sizeof(double));
+      memcpy(ya, y, y_size*sizeof(double));
+      bool cvg = true;
+      try
+        {
+          it_code = Init_Code;
+          MainLoop(bin_basename, code, false, -1, false, false, s_plan_junk, vector_table_conditional_local_junk);
+        }
+      catch (GeneralExceptionHandling &feh)
+        {
+          cvg = false;
+          Close_SaveCode();
+          End_Solver();
+          if (print_it)
+            mexPrintf("Set of parameters %d:%s", j+1, feh.GetErrorMsg().c_str());
+        }
+      for (int i = 0; i < y_size && cvg; i++)
+        cvg = isfinite(y[i]);
+      info[j] = (cvg ? 0 : 1);
+      if (cvg)
+        memcpy(ys + j*y_size, y, y_size*sizeof(double));
+      else
+        for (int i = 0; i < y_size; i++)
+          ys[i + j*y_size] = mxGetNaN();
+
+      next = -1;
+      for (int k = 0; k < nb_points; k++)
+        if (!solved[k])
+          {
+            if (cvg)
+              {
+                double d = 0;
+                for (int l = 0; l < nb_params; l++)
+                  {
+                    double dl = (params_grid[l+k*nb_params] - params_grid[l+j*nb_params]) * scale[l];
+                    d += dl*dl;
+                  }
+                if (d < distance[k])
+                  {
+                    distance[k] = d;
+                    neighbour[k] = j;
+                  }
+              }
+            if (next < 0 || distance[k] < distance[next])
+              next = k;
+          }
+    }
+  keep_sparse_structures = false;
+  mxFree(Init_Code->second);
+  Free_ILU_Cache();
+  if (T && !global_temporary_terms)
+    {
+      mxFree(T);
+      T = NULL;
+    }
+}
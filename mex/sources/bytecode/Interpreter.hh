@@ -45,12 +45,33 @@ class Interpreter : public dynSparseMatrix
 {
 private:
   vector<int> previous_block_exogenous;
+  //! Blocks on which each block depends, and position of each block in the dependency graph
+  /*! Blocks with the same level do not depend on each other */
+  vector<vector<unsigned int> > block_dependencies;
+  vector<unsigned int> block_level;
+  //! Positions in code_liste of the FBEGINBLOCK of each block, and of the instruction following its FENDBLOCK
+  vector<size_t> block_begin, block_end;
+  //! Level of each block in its run of consecutive evaluated blocks, -1 if the block is computed alone
+  /*! The blocks of a run with the same level can be evaluated concurrently (see compute_block_levels()) */
+  vector<int> concurrent_level;
+  //! End (last block + 1) of the run of each block
+  vector<unsigned int> concurrent_run_end;
+  void compute_block_levels();
+  //! Computes the run of blocks starting at block first, level by level on period_threads threads
+  /*! Returns false if the run is not worth evaluating concurrently, in which case nothing is computed */
+  bool evaluate_concurrent_blocks(const unsigned int first, const string &bin_basename, const bool last_call);
+  //! Native code of the evaluated blocks of the model
+  NativeCode native_code;
+  //! Compiles the evaluated blocks to native code, the other ones being interpreted
+  void compile_native_blocks();
 protected:
   void evaluate_a_block(bool initialization);
-  int simulate_a_block(vector_table_conditional_local_type vector_table_conditional_local);
+  int simulate_a_block(const vector_table_conditional_local_type &vector_table_conditional_local);
   void print_a_block();
   string elastic(string str, unsigned int len, bool left);
 public:
+  //! In an extended path, use the expected path computed in the previous period as initial guess
+  bool warm_start;
   ~Interpreter();
   Interpreter(double *params_arg, double *y_arg, double *ya_arg, double *x_arg, double *steady_y_arg, double *steady_x_arg,
               double *direction_arg, size_t y_size_arg,
@@ -63,10 +84,15 @@ public:
               , const int CUDA_device, cublasHandle_t cublas_handle_arg, cusparseHandle_t cusparse_handle_arg, cusparseMatDescr_t descr_arg
 #endif
               );
-  bool extended_path(string file_name, string bin_basename, bool evaluate, int block, int &nb_blocks, int nb_periods, vector<s_plan> sextended_path, vector<s_plan> sconstrained_extended_path, vector<string> dates, table_conditional_global_type table_conditional_global);
-  bool compute_blocks(string file_name, string bin_basename, bool evaluate, int block, int &nb_blocks);
-  void check_for_controlled_exo_validity(FBEGINBLOCK_ *fb, vector<s_plan> sconstrained_extended_path);
-  bool MainLoop(string bin_basename, CodeLoad code, bool evaluate, int block, bool last_call, bool constrained, vector<s_plan> sconstrained_extended_path, vector_table_conditional_local_type vector_table_conditional_local);
+  bool extended_path(const string &file_name, const string &bin_basename, bool evaluate, int block, int &nb_blocks, int nb_periods, const vector<s_plan> &sextended_path, const vector<s_plan> &sconstrained_extended_path, const vector<string> &dates, const table_conditional_global_type &table_conditional_global);
+  bool compute_blocks(const string &file_name, const string &bin_basename, bool evaluate, int block, int &nb_blocks);
+  //! Computes the steady state for each of the nb_points sets of parameters stored by column in params_grid
+  /*! The code and the sparsity structures are loaded once. Each point starts from
+    the steady state of the nearest point already solved. The steady states are
+    stored by column in ys, and info is set to 0 for the points that converged, to 1 otherwise */
+  void steady_state_sweep(const string &file_name, const string &bin_basename, int nb_params, const double *params_grid, int nb_points, double *ys, double *info);
+  void check_for_controlled_exo_validity(FBEGINBLOCK_ *fb, const vector<s_plan> &sconstrained_extended_path);
+  bool MainLoop(const string &bin_basename, const CodeLoad &code, bool evaluate, int block, bool last_call, bool constrained, const vector<s_plan> &sconstrained_extended_path, const vector_table_conditional_local_type &vector_table_conditional_local);
   void ReadCodeFile(string file_name, CodeLoad &code);
 
   inline mxArray *
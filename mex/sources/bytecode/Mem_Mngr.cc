@@ -21,8 +21,8 @@
 
 Mem_Mngr::Mem_Mngr()
 {
-  swp_f = false;
-  swp_f_b = 0;
+  CHUNK_BLCK_SIZE = 0;
+  init_Mem();
 }
 /*void
   Mem_Mngr::Print_heap()
@@ -39,12 +39,10 @@ void
 Mem_Mngr::init_Mem()
 {
   Chunk_Stack.clear();
-  CHUNK_SIZE = 0;
-  Nb_CHUNK = 0;
-  NZE_Mem = NULL;
-  NZE_Mem_add = NULL;
+  Current_CHUNK = 0;
   CHUNK_heap_pos = 0;
   NZE_Mem_Allocated.clear();
+  NZE_Mem_Size.clear();
 }
 
 void
@@ -62,58 +60,33 @@ Mem_Mngr::init_CHUNK_BLCK_SIZE(int u_count)
 NonZeroElem *
 Mem_Mngr::mxMalloc_NZE()
 {
-  long unsigned int i;
   if (!Chunk_Stack.empty())           /*An unused block of memory available inside the heap*/
     {
       NonZeroElem *p1 = Chunk_Stack.back();
       Chunk_Stack.pop_back();
       return (p1);
     }
-  else if (CHUNK_heap_pos < CHUNK_SIZE) /*there is enough allocated memory space available we keep it at the top of the heap*/
+  while (Current_CHUNK < NZE_Mem_Allocated.size() && CHUNK_heap_pos >= NZE_Mem_Size[Current_CHUNK])
     {
-      i = CHUNK_heap_pos++;
-      return (NZE_Mem_add[i]);
+      Current_CHUNK++;
+      CHUNK_heap_pos = 0;
     }
-  else                                /*We have to allocate extra memory space*/
+  if (Current_CHUNK == NZE_Mem_Allocated.size()) /*We have to allocate extra memory space*/
     {
-      CHUNK_SIZE += CHUNK_BLCK_SIZE;
-      Nb_CHUNK++;
-      NZE_Mem = (NonZeroElem *) mxMalloc(CHUNK_BLCK_SIZE*sizeof(NonZeroElem));      /*The block of memory allocated*/
-      error_msg.test_mxMalloc(NZE_Mem, __LINE__, __FILE__, __func__, CHUNK_BLCK_SIZE*sizeof(NonZeroElem));
-      NZE_Mem_Allocated.push_back(NZE_Mem);
+      unsigned int size = max(CHUNK_BLCK_SIZE, 1U);
+      NonZeroElem *NZE_Mem = (NonZeroElem *) mxMalloc(size*sizeof(NonZeroElem));      /*The block of memory allocated*/
+      error_msg.test_mxMalloc(NZE_Mem, __LINE__, __FILE__, __func__, size*sizeof(NonZeroElem));
       if (!NZE_Mem)
         mexPrintf("Not enough memory available\n");
-      if (NZE_Mem_add)
-        {
-          NZE_Mem_add = (NonZeroElem **) mxRealloc(NZE_Mem_add, CHUNK_SIZE*sizeof(NonZeroElem *));                                                                                                     /*We have to redefine the size of pointer on the memory*/
-          error_msg.test_mxMalloc(NZE_Mem_add, __LINE__, __FILE__, __func__, CHUNK_SIZE*sizeof(NonZeroElem *));
-        }
-      else
-        {
-          NZE_Mem_add = (NonZeroElem **) mxMalloc(CHUNK_SIZE*sizeof(NonZeroElem *));                                                                                       /*We have to define the size of pointer on the memory*/
-          error_msg.test_mxMalloc(NZE_Mem_add, __LINE__, __FILE__, __func__, CHUNK_SIZE*sizeof(NonZeroElem *));
-        }
-
-      if (!NZE_Mem_add)
-        mexPrintf("Not enough memory available\n");
-      for (i = CHUNK_heap_pos; i < CHUNK_SIZE; i++)
-        NZE_Mem_add[i] = (NonZeroElem *) (NZE_Mem+(i-CHUNK_heap_pos));
-      i = CHUNK_heap_pos++;
-      return (NZE_Mem_add[i]);
+      NZE_Mem_Allocated.push_back(NZE_Mem);
+      NZE_Mem_Size.push_back(size);
     }
+  return NZE_Mem_Allocated[Current_CHUNK] + CHUNK_heap_pos++;
 }
 
 void
 Mem_Mngr::mxFree_NZE(void *pos)
 {
-  unsigned int i;
-  size_t gap;
-  for (i = 0; i < Nb_CHUNK; i++)
-    {
-      gap = ((size_t) (pos)-(size_t) (NZE_Mem_add[i*CHUNK_BLCK_SIZE]))/sizeof(NonZeroElem);
-      if ((gap < CHUNK_BLCK_SIZE) && (gap >= 0))
-        break;
-    }
   Chunk_Stack.push_back((NonZeroElem *) pos);
 }
 
@@ -125,7 +98,13 @@ Mem_Mngr::Free_All()
       mxFree(NZE_Mem_Allocated.back());
       NZE_Mem_Allocated.pop_back();
     }
-  if (NZE_Mem_add)
-    mxFree(NZE_Mem_add);
   init_Mem();
 }
+
+void
+Mem_Mngr::Reset_All()
+{
+  Chunk_Stack.clear();
+  Current_CHUNK = 0;
+  CHUNK_heap_pos = 0;
+}
@@ -39,6 +39,9 @@ struct NonZeroElem
 
 typedef vector<NonZeroElem *> v_NonZeroElem;
 
+//! Pool allocator for the elements of the sparse matrices
+/*! The elements are allocated in chunks, which are filled sequentially; the
+  freed elements are kept in a free list and reused first. */
 class Mem_Mngr
 {
 public:
@@ -47,20 +50,21 @@ public:
   void mxFree_NZE(void *pos);
   NonZeroElem *mxMalloc_NZE();
   void init_CHUNK_BLCK_SIZE(int u_count);
+  //! Frees all the chunks
   void Free_All();
+  //! Makes all the elements available again, keeping the chunks allocated
+  void Reset_All();
   Mem_Mngr();
   void fixe_file_name(string filename_arg);
-  bool swp_f;
   ErrorMsg error_msg;
 private:
+  //! Freed elements
   v_NonZeroElem Chunk_Stack;
-  unsigned int CHUNK_SIZE, CHUNK_BLCK_SIZE, Nb_CHUNK;
-  unsigned int CHUNK_heap_pos;
-  NonZeroElem **NZE_Mem_add;
-  NonZeroElem *NZE_Mem;
+  unsigned int CHUNK_BLCK_SIZE;
+  //! Chunk being filled, and position of the next free element in it
+  unsigned int Current_CHUNK, CHUNK_heap_pos;
   vector<NonZeroElem *> NZE_Mem_Allocated;
-  int swp_f_b;
-  fstream  SaveCode_swp;
+  vector<unsigned int> NZE_Mem_Size;
   string filename_mem;
 };
 
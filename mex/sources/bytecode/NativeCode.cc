@@ -0,0 +1,789 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "NativeCode.hh"
+#ifdef NATIVE_CODE
+# include <sys/mman.h>
+#endif
+
+// Registers holding the arguments of the generated function, and the base of its operand slots
+#define REG_Y 3      // rbx
+#define REG_SLOTS 5  // rbp
+#define REG_X 12     // r12
+#define REG_PARAMS 13 // r13
+#define REG_T 14     // r14
+
+// Operators called by the generated code, computed as in Evaluate::compute_block_time()
+
+static double
+native_exp(double a)
+{
+  return exp(a);
+}
+
+static double
+native_log(double a)
+{
+  return log(a);
+}
+
+static double
+native_log10(double a)
+{
+  return log10(a);
+}
+
+static double
+native_cos(double a)
+{
+  return cos(a);
+}
+
+static double
+native_sin(double a)
+{
+  return sin(a);
+}
+
+static double
+native_tan(double a)
+{
+  return tan(a);
+}
+
+static double
+native_acos(double a)
+{
+  return acos(a);
+}
+
+static double
+native_asin(double a)
+{
+  return asin(a);
+}
+
+static double
+native_atan(double a)
+{
+  return atan(a);
+}
+
+static double
+native_cosh(double a)
+{
+  return cosh(a);
+}
+
+static double
+native_sinh(double a)
+{
+  return sinh(a);
+}
+
+static double
+native_tanh(double a)
+{
+  return tanh(a);
+}
+
+static double
+native_acosh(double a)
+{
+  return acosh(a);
+}
+
+static double
+native_asinh(double a)
+{
+  return asinh(a);
+}
+
+static double
+native_atanh(double a)
+{
+  return atanh(a);
+}
+
+static double
+native_sqrt(double a)
+{
+  return sqrt(a);
+}
+
+static double
+native_erf(double a)
+{
+  return erf(a);
+}
+
+static double
+native_less(double a, double b)
+{
+  return double (a < b);
+}
+
+static double
+native_greater(double a, double b)
+{
+  return double (a > b);
+}
+
+static double
+native_less_equal(double a, double b)
+{
+  return double (a <= b);
+}
+
+static double
+native_greater_equal(double a, double b)
+{
+  return double (a >= b);
+}
+
+static double
+native_equal_equal(double a, double b)
+{
+  return double (a == b);
+}
+
+static double
+native_different(double a, double b)
+{
+  return double (a != b);
+}
+
+static double
+native_max(double a, double b)
+{
+  return max(a, b);
+}
+
+static double
+native_min(double a, double b)
+{
+  return min(a, b);
+}
+
+static double
+native_pow(double a, double b)
+{
+  return pow(a, b);
+}
+
+static double
+native_power_deriv(double order, double v1, double v2)
+{
+  int derivOrder = int (nearbyint(order));
+  if (fabs(v1) < NEAR_ZERO && v2 > 0
+      && derivOrder > v2
+      && fabs(v2-nearbyint(v2)) < NEAR_ZERO)
+    return 0.0;
+  double dxp = pow(v1, v2-derivOrder);
+  for (int i = 0; i < derivOrder; i++)
+    dxp *= v2--;
+  return dxp;
+}
+
+static double
+native_normcdf(double v1, double v2, double v3)
+{
+  return 0.5*(1+erf((v1-v2)/v3/M_SQRT2));
+}
+
+static double
+native_normpdf(double v1, double v2, double v3)
+{
+  return 1/(v3*sqrt(2*M_PI)*exp(pow((v1-v2)/v3, 2)/2));
+}
+
+NativeCode::NativeCode() : mapping(NULL), mapping_size(0), sp(0), max_sp(0), invalid(false)
+{
+}
+
+NativeCode::~NativeCode()
+{
+  clear();
+}
+
+bool
+NativeCode::available()
+{
+#ifdef NATIVE_CODE
+  return true;
+#else
+  return false;
+#endif
+}
+
+void
+NativeCode::clear()
+{
+#ifdef NATIVE_CODE
+  if (mapping)
+    munmap(mapping, mapping_size);
+#endif
+  mapping = NULL;
+  mapping_size = 0;
+  vector<uint8_t>().swap(code);
+  entry.clear();
+}
+
+void
+NativeCode::emit(const uint8_t b)
+{
+  code.push_back(b);
+}
+
+void
+NativeCode::emit_int32(const int32_t v)
+{
+  for (int i = 0; i < 4; i++)
+    emit(uint8_t ((uint32_t) v >> (8*i)));
+}
+
+void
+NativeCode::emit_int64(const uint64_t v)
+{
+  for (int i = 0; i < 8; i++)
+    emit(uint8_t (v >> (8*i)));
+}
+
+void
+NativeCode::patch_int32(const size_t pos, const int32_t v)
+{
+  for (int i = 0; i < 4; i++)
+    code[pos+i] = uint8_t ((uint32_t) v >> (8*i));
+}
+
+/* Scalar SSE2 instruction between xmm and [base+disp32]: prefix (0xF2 for movsd), REX if a
+   register is numbered above 7, 0x0F, opcode, ModRM with mod=10 and a SIB byte if the base
+   is rsp or r12 */
+void
+NativeCode::emit_sse_mem(const uint8_t prefix, const uint8_t opcode, const int xmm, const int base, const int32_t disp)
+{
+  emit(prefix);
+  uint8_t rex = 0x40 | ((xmm >> 3) << 2) | (base >> 3);
+  if (rex != 0x40)
+    emit(rex);
+  emit(0x0F);
+  emit(opcode);
+  emit(0x80 | ((xmm & 7) << 3) | (base & 7));
+  if ((base & 7) == 4)
+    emit(0x24);
+  emit_int32(disp);
+}
+
+void
+NativeCode::emit_mov_rax(const uint64_t v)
+{
+  // mov rax, imm64
+  emit(0x48); emit(0xB8);
+  emit_int64(v);
+}
+
+void
+NativeCode::emit_call(const uint64_t f)
+{
+  // mov rax, f; call rax
+  emit_mov_rax(f);
+  emit(0xFF); emit(0xD0);
+}
+
+void
+NativeCode::emit_check_finite()
+{
+  // movq rax, xmm0; mov rcx, 0x7FF0000000000000; and rax, rcx; cmp rax, rcx
+  emit(0x66); emit(0x48); emit(0x0F); emit(0x7E); emit(0xC0);
+  emit(0x48); emit(0xB9);
+  emit_int64(0x7FF0000000000000ULL);
+  emit(0x48); emit(0x21); emit(0xC8);
+  emit(0x48); emit(0x39); emit(0xC8);
+  // jne +7; mov dword [r15], 1
+  emit(0x75); emit(0x07);
+  emit(0x41); emit(0xC7); emit(0x07);
+  emit_int32(1);
+}
+
+void
+NativeCode::emit_spill_top()
+{
+  // movsd [rbp+8*(sp-1)], xmm0
+  if (sp > 0)
+    emit_sse_mem(0xF2, 0x11, 0, REG_SLOTS, 8*(sp-1));
+}
+
+void
+NativeCode::emit_reload_top()
+{
+  // movsd xmm0, [rbp+8*(sp-1)]
+  if (sp > 0)
+    emit_sse_mem(0xF2, 0x10, 0, REG_SLOTS, 8*(sp-1));
+}
+
+void
+NativeCode::push_mem(const int base, const long int disp)
+{
+  if (disp > 2147483647L || disp < -2147483647L)
+    {
+      invalid = true;
+      return;
+    }
+  emit_spill_top();
+  emit_sse_mem(0xF2, 0x10, 0, base, int32_t (disp));
+  sp++;
+  max_sp = max(max_sp, sp);
+}
+
+void
+NativeCode::push_constant(const double v)
+{
+  uint64_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  emit_spill_top();
+  // mov rax, v; movq xmm0, rax
+  emit_mov_rax(bits);
+  emit(0x66); emit(0x48); emit(0x0F); emit(0x6E); emit(0xC0);
+  sp++;
+  max_sp = max(max_sp, sp);
+}
+
+void
+NativeCode::pop_mem(const int base, const long int disp)
+{
+  if (sp < 1 || disp > 2147483647L || disp < -2147483647L)
+    {
+      invalid = true;
+      return;
+    }
+  emit_sse_mem(0xF2, 0x11, 0, base, int32_t (disp));
+  sp--;
+  emit_reload_top();
+}
+
+void
+NativeCode::binary_inline(const uint8_t opcode)
+{
+  // movapd xmm1, xmm0; movsd xmm0, [first operand]; op xmm0, xmm1
+  emit(0x66); emit(0x0F); emit(0x28); emit(0xC8);
+  emit_sse_mem(0xF2, 0x10, 0, REG_SLOTS, 8*(sp-2));
+  emit(0xF2); emit(0x0F); emit(opcode); emit(0xC1);
+  sp--;
+}
+
+void
+NativeCode::binary_call(const uint64_t f)
+{
+  // The operands are passed in xmm0 and xmm1, the result returned in xmm0
+  emit(0x66); emit(0x0F); emit(0x28); emit(0xC8);
+  emit_sse_mem(0xF2, 0x10, 0, REG_SLOTS, 8*(sp-2));
+  emit_call(f);
+  sp--;
+}
+
+void
+NativeCode::trinary_call(const uint64_t f)
+{
+  // movapd xmm2, xmm0; movsd xmm1, [second operand]; movsd xmm0, [first operand]
+  emit(0x66); emit(0x0F); emit(0x28); emit(0xD0);
+  emit_sse_mem(0xF2, 0x10, 1, REG_SLOTS, 8*(sp-2));
+  emit_sse_mem(0xF2, 0x10, 0, REG_SLOTS, 8*(sp-3));
+  emit_call(f);
+  sp -= 2;
+}
+
+bool
+NativeCode::binary(const int op)
+{
+  if (sp < 2)
+    return false;
+  switch (op)
+    {
+    case oPlus:
+      binary_inline(0x58);
+      break;
+    case oMinus:
+      binary_inline(0x5C);
+      break;
+    case oTimes:
+      binary_inline(0x59);
+      break;
+    case oDivide:
+      binary_inline(0x5E);
+      emit_check_finite();
+      break;
+    case oLess:
+      binary_call((uint64_t) &native_less);
+      break;
+    case oGreater:
+      binary_call((uint64_t) &native_greater);
+      break;
+    case oLessEqual:
+      binary_call((uint64_t) &native_less_equal);
+      break;
+    case oGreaterEqual:
+      binary_call((uint64_t) &native_greater_equal);
+      break;
+    case oEqualEqual:
+      binary_call((uint64_t) &native_equal_equal);
+      break;
+    case oDifferent:
+      binary_call((uint64_t) &native_different);
+      break;
+    case oPower:
+      binary_call((uint64_t) &native_pow);
+      emit_check_finite();
+      break;
+    case oPowerDeriv:
+      // The derivation order is below the two operands
+      if (sp < 3)
+        return false;
+      trinary_call((uint64_t) &native_power_deriv);
+      emit_check_finite();
+      break;
+    case oMax:
+      binary_call((uint64_t) &native_max);
+      break;
+    case oMin:
+      binary_call((uint64_t) &native_min);
+      break;
+    case oEqual:
+      sp -= 2;
+      emit_reload_top();
+      break;
+    default:
+      return false;
+    }
+  return true;
+}
+
+bool
+NativeCode::unary(const int op)
+{
+  if (sp < 1)
+    return false;
+  double (*f)(double);
+  switch (op)
+    {
+    case oUminus:
+      // mov rax, sign bit; movq xmm1, rax; xorpd xmm0, xmm1
+      emit_mov_rax(0x8000000000000000ULL);
+      emit(0x66); emit(0x48); emit(0x0F); emit(0x6E); emit(0xC8);
+      emit(0x66); emit(0x0F); emit(0x57); emit(0xC1);
+      return true;
+    case oLog:
+      emit_call((uint64_t) &native_log);
+      emit_check_finite();
+      return true;
+    case oLog10:
+      emit_call((uint64_t) &native_log10);
+      emit_check_finite();
+      return true;
+    case oExp:
+      f = native_exp;
+      break;
+    case oCos:
+      f = native_cos;
+      break;
+    case oSin:
+      f = native_sin;
+      break;
+    case oTan:
+      f = native_tan;
+      break;
+    case oAcos:
+      f = native_acos;
+      break;
+    case oAsin:
+      f = native_asin;
+      break;
+    case oAtan:
+      f = native_atan;
+      break;
+    case oCosh:
+      f = native_cosh;
+      break;
+    case oSinh:
+      f = native_sinh;
+      break;
+    case oTanh:
+      f = native_tanh;
+      break;
+    case oAcosh:
+      f = native_acosh;
+      break;
+    case oAsinh:
+      f = native_asinh;
+      break;
+    case oAtanh:
+      f = native_atanh;
+      break;
+    case oSqrt:
+      f = native_sqrt;
+      break;
+    case oErf:
+      f = native_erf;
+      break;
+    default:
+      return false;
+    }
+  emit_call((uint64_t) f);
+  return true;
+}
+
+bool
+NativeCode::trinary(const int op)
+{
+  if (sp < 3)
+    return false;
+  switch (op)
+    {
+    case oNormcdf:
+      trinary_call((uint64_t) &native_normcdf);
+      break;
+    case oNormpdf:
+      trinary_call((uint64_t) &native_normpdf);
+      break;
+    default:
+      return false;
+    }
+  return true;
+}
+
+bool
+NativeCode::add_block(const int block_num, it_code_type begining, const bool steady_state,
+                      const int y_size, const int nb_row_x, const int nb_row_xd, const int T_nrows)
+{
+#ifdef NATIVE_CODE
+  size_t start = code.size();
+  sp = max_sp = 0;
+  invalid = false;
+
+  // push rbp; push rbx; push r12; push r13; push r14; push r15; sub rsp, frame
+  emit(0x55); emit(0x53);
+  emit(0x41); emit(0x54); emit(0x41); emit(0x55); emit(0x41); emit(0x56); emit(0x41); emit(0x57);
+  emit(0x48); emit(0x81); emit(0xEC);
+  size_t frame_sub = code.size();
+  emit_int32(0);
+  // mov rbp, rsp; mov rbx, rdi; mov r12, rsi; mov r13, rdx; mov r14, rcx; mov r15, r8
+  emit(0x48); emit(0x89); emit(0xE5);
+  emit(0x48); emit(0x89); emit(0xFB);
+  emit(0x49); emit(0x89); emit(0xF4);
+  emit(0x49); emit(0x89); emit(0xD5);
+  emit(0x49); emit(0x89); emit(0xCE);
+  emit(0x4D); emit(0x89); emit(0xC7);
+
+  /* The code is followed as compute_block_time() executes it in a simulation: the derivatives
+     following FJMPIFEVAL are skipped by the FJMP */
+  bool ok = true, go_on = true;
+  int var, lag;
+  for (it_code_type it = begining; ok && go_on && !invalid; it++)
+    switch (it->first)
+      {
+      case FNUMEXPR:
+      case FENDEQU:
+      case FJMPIFEVAL:
+        break;
+      case FOK:
+        ok = sp == 0;
+        break;
+      case FJMP:
+        it += ((FJMP_ *) it->second)->get_pos();
+        break;
+      case FLDZ:
+        push_constant(0.0);
+        break;
+      case FLDC:
+        push_constant(((FLDC_ *) it->second)->get_value());
+        break;
+      case FLDV:
+        var = ((FLDV_ *) it->second)->get_pos();
+        lag = ((FLDV_ *) it->second)->get_lead_lag();
+        switch (((FLDV_ *) it->second)->get_type())
+          {
+          case eParameter:
+            push_mem(REG_PARAMS, 8L*var);
+            break;
+          case eEndogenous:
+            push_mem(REG_Y, 8L*(long int) lag*y_size + 8L*var);
+            break;
+          case eExogenous:
+            push_mem(REG_X, 8L*lag + 8L*(long int) var*nb_row_x);
+            break;
+          case eExogenousDet:
+            push_mem(REG_X, 8L*lag + 8L*(long int) var*nb_row_xd);
+            break;
+          case eModelLocalVariable:
+            break;
+          default:
+            ok = false;
+          }
+        ok = ok && !steady_state;
+        break;
+      case FLDY:
+        push_mem(REG_Y, 8L*((FLDY_ *) it->second)->get_offset());
+        ok = !steady_state;
+        break;
+      case FLDX:
+        push_mem(REG_X, 8L*((FLDX_ *) it->second)->get_offset());
+        ok = !steady_state;
+        break;
+      case FLDXD:
+        push_mem(REG_X, 8L*((FLDXD_ *) it->second)->get_offset());
+        ok = !steady_state;
+        break;
+      case FLDSV:
+        var = ((FLDSV_ *) it->second)->get_pos();
+        switch (((FLDSV_ *) it->second)->get_type())
+          {
+          case eParameter:
+            push_mem(REG_PARAMS, 8L*var);
+            break;
+          case eEndogenous:
+            push_mem(REG_Y, 8L*var);
+            break;
+          case eExogenous:
+          case eExogenousDet:
+            push_mem(REG_X, 8L*var);
+            break;
+          case eModelLocalVariable:
+            break;
+          default:
+            ok = false;
+          }
+        ok = ok && steady_state;
+        break;
+      case FLDT:
+        push_mem(REG_T, 8L*(long int) ((FLDT_ *) it->second)->get_pos()*T_nrows);
+        ok = !steady_state;
+        break;
+      case FLDST:
+        push_mem(REG_T, 8L*((FLDST_ *) it->second)->get_pos());
+        ok = steady_state;
+        break;
+      case FSTPT:
+        pop_mem(REG_T, 8L*(long int) ((FSTPT_ *) it->second)->get_pos()*T_nrows);
+        ok = !steady_state;
+        break;
+      case FSTPST:
+        pop_mem(REG_T, 8L*((FSTPST_ *) it->second)->get_pos());
+        ok = steady_state;
+        break;
+      case FSTPV:
+        var = ((FSTPV_ *) it->second)->get_pos();
+        lag = ((FSTPV_ *) it->second)->get_lead_lag();
+        ok = !steady_state && ((FSTPV_ *) it->second)->get_type() == eEndogenous;
+        if (ok)
+          pop_mem(REG_Y, 8L*(long int) lag*y_size + 8L*var);
+        break;
+      case FSTPSV:
+        ok = steady_state && ((FSTPSV_ *) it->second)->get_type() == eEndogenous;
+        if (ok)
+          pop_mem(REG_Y, 8L*((FSTPSV_ *) it->second)->get_pos());
+        break;
+      case FBINARYC:
+        push_constant(((FBINARYC_ *) it->second)->get_value());
+        ok = binary(((FBINARY_ *) it->second)->get_op_type());
+        break;
+      case FBINARYT:
+        push_mem(REG_T, 8L*(long int) ((FBINARYT_ *) it->second)->get_pos()*T_nrows);
+        ok = !steady_state && binary(((FBINARY_ *) it->second)->get_op_type());
+        break;
+      case FBINARYST:
+        push_mem(REG_T, 8L*((FBINARYST_ *) it->second)->get_pos());
+        ok = steady_state && binary(((FBINARY_ *) it->second)->get_op_type());
+        break;
+      case FBINARY:
+        ok = binary(((FBINARY_ *) it->second)->get_op_type());
+        break;
+      case FUNARY:
+        ok = unary(((FUNARY_ *) it->second)->get_op_type());
+        break;
+      case FTRINARY:
+        ok = trinary(((FTRINARY_ *) it->second)->get_op_type());
+        break;
+      case FENDBLOCK:
+        ok = sp == 0;
+        go_on = false;
+        break;
+      default:
+        ok = false;
+      }
+  if (!ok || invalid)
+    {
+      code.resize(start);
+      return false;
+    }
+
+  // The frame keeps the stack aligned on 16 bytes at the calls, after the return address and the six pushes
+  int nb_slots = max(max_sp, 1);
+  int32_t frame = 8*nb_slots + (nb_slots % 2 == 0 ? 8 : 0);
+  patch_int32(frame_sub, frame);
+  // add rsp, frame; pop r15; pop r14; pop r13; pop r12; pop rbx; pop rbp; ret
+  emit(0x48); emit(0x81); emit(0xC4);
+  emit_int32(frame);
+  emit(0x41); emit(0x5F); emit(0x41); emit(0x5E); emit(0x41); emit(0x5D); emit(0x41); emit(0x5C);
+  emit(0x5B); emit(0x5D);
+  emit(0xC3);
+  entry[block_num] = start;
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool
+NativeCode::finalize()
+{
+#ifdef NATIVE_CODE
+  if (mapping || code.empty())
+    return mapping != NULL;
+  mapping_size = code.size();
+  mapping = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+  if (mapping == MAP_FAILED)
+    {
+      mapping = NULL;
+      clear();
+      return false;
+    }
+  memcpy(mapping, &code[0], mapping_size);
+  // The memory is never writable and executable at the same time
+  if (mprotect(mapping, mapping_size, PROT_READ | PROT_EXEC) != 0)
+    {
+      clear();
+      return false;
+    }
+  vector<uint8_t>().swap(code);
+  return true;
+#else
+  return false;
+#endif
+}
+
+NativeCode::block_function
+NativeCode::get_function(const int block_num) const
+{
+  map<int, size_t>::const_iterator it = entry.find(block_num);
+  if (mapping == NULL || it == entry.end())
+    return NULL;
+  return (block_function) ((uint8_t *) mapping + it->second);
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NATIVE_CODE_HH_INCLUDED
+#define NATIVE_CODE_HH_INCLUDED
+
+#include <vector>
+#include <map>
+#include <cstddef>
+#include <stdint.h>
+#include "ErrorHandling.hh"
+
+/* The native code follows the System V calling convention of x86-64: it is not generated on
+   other processors, nor under Windows */
+#if defined(__x86_64__) && !defined(_WIN32)
+# define NATIVE_CODE
+#endif
+
+using namespace std;
+
+//! Compiles the simulation code of the evaluated blocks to x86-64 machine code, run without the interpreter loop
+/*! The code of a block is compiled to a function computing one period. The function receives
+  the endogenous variables, the exogenous variables and the temporary terms from the period on
+  (or from their start in a static model), so that the offsets of the instructions become
+  displacements. The top of the operand stack is kept in a register, the other operands in the
+  stack frame of the function. The operators that are not computed inline call functions
+  reproducing the interpreter exactly.
+
+  A block using an instruction which is not compiled (external functions, FLDVS, FPATTERN...)
+  is left to the interpreter. If a division, a power or a logarithm of a period does not give a
+  finite number, the function sets its error flag: the period is then computed again by the
+  interpreter, which reports the error. */
+class NativeCode
+{
+public:
+  //! Function computing the block in one period, error is set to 1 on a floating point error
+  typedef void (*block_function)(double *y, const double *x, const double *params, double *T, int *error);
+  NativeCode();
+  ~NativeCode();
+  //! True if native code can be generated on this platform
+  static bool available();
+  //! Generates the code of the block starting after the FBEGINBLOCK at begining
+  /*! T_nrows is the number of periods of the temporary terms in a dynamic model. Returns false,
+    without generating anything, if the block uses an instruction which is not compiled */
+  bool add_block(const int block_num, it_code_type begining, const bool steady_state,
+                 const int y_size, const int nb_row_x, const int nb_row_xd, const int T_nrows);
+  //! Copies the generated code to executable memory, returns false if it cannot be mapped
+  bool finalize();
+  //! Function of the block, NULL if it has not been compiled
+  block_function get_function(const int block_num) const;
+  //! Releases the executable memory and the generated code
+  void clear();
+private:
+  NativeCode(const NativeCode &);
+  NativeCode &operator=(const NativeCode &);
+  vector<uint8_t> code;
+  //! Position in code of the function of each compiled block
+  map<int, size_t> entry;
+  void *mapping;
+  size_t mapping_size;
+  //! Number of operands of the block being compiled, the last one being kept in xmm0
+  int sp, max_sp;
+  //! Set if the block being compiled cannot be (a displacement does not fit in 32 bits, a missing operand)
+  bool invalid;
+  void emit(const uint8_t b);
+  void emit_int32(const int32_t v);
+  void emit_int64(const uint64_t v);
+  void patch_int32(const size_t pos, const int32_t v);
+  void emit_sse_mem(const uint8_t prefix, const uint8_t opcode, const int xmm, const int base, const int32_t disp);
+  void emit_mov_rax(const uint64_t v);
+  void emit_call(const uint64_t f);
+  void emit_check_finite();
+  void emit_spill_top();
+  void emit_reload_top();
+  void push_mem(const int base, const long int disp);
+  void push_constant(const double v);
+  void pop_mem(const int base, const long int disp);
+  void binary_inline(const uint8_t opcode);
+  void binary_call(const uint64_t f);
+  void trinary_call(const uint64_t f);
+  bool binary(const int op);
+  bool unary(const int op);
+  bool trinary(const int op);
+};
+
+#endif
@@ -20,7 +20,9 @@
 //define _GLIBCXX_USE_C99_FENV_TR1 1
 //include <cfenv>
 
+#include <algorithm>
 #include <cstring>
+#include <climits>
 #include <ctime>
 #include <sstream>
 //#include <gsl/gsl_min.h>
@@ -43,6 +45,9 @@ HINSTANCE hinstLib;
 /* returned by all routines that use Info: */
 # define UMFPACK_OK (0)
 # define UMFPACK_STATUS 0        /* UMFPACK_OK, or other result */
+/* number of nonzeros in the LU factors, returned by umfpack_dl_numeric: */
+# define UMFPACK_LNZ 43
+# define UMFPACK_UNZ 44
 
 typedef void (*t_umfpack_dl_free_numeric)(void **Numeric);
 t_umfpack_dl_free_numeric umfpack_dl_free_numeric;
@@ -92,6 +97,12 @@ dynSparseMatrix::dynSparseMatrix()
   g_save_op = NULL;
   g_nop_all = 0;
   mem_mngr.init_Mem();
+#ifdef CUDA
+  CUDA_Host_Ap = NULL;
+  CUDA_Host_Ai = NULL;
+  CUDA_n = 0;
+  CUDA_nnz = 0;
+#endif
   symbolic = true;
   alt_symbolic = false;
   alt_symbolic_count = 0;
@@ -105,6 +116,20 @@ dynSparseMatrix::dynSparseMatrix()
   lu_inc_tol = 1e-10;
   Symbolic = NULL;
   Numeric = NULL;
+#ifdef HAVE_KLU
+  klu_l_defaults(&KLU_Common);
+  KLU_Symbolic = NULL;
+  KLU_Numeric = NULL;
+#endif
+  sparse_backend = UMFPACK_backend;
+  keep_sparse_structures = false;
+  auto_stack_solve_algo = false;
+  sparse_read_pos = 0;
+  numeric_reuse_count = 0;
+  numeric_res1 = 0;
+  simplified_newton = 0;
+  csc_periods = 0;
+  csc_Size = 0;
 #ifdef _MSC_VER
   // Get a handle to the DLL module.
   hinstLib = LoadLibrary(TEXT("libmwumfpack.dll"));
@@ -191,6 +216,12 @@ dynSparseMatrix::dynSparseMatrix(const int y_size_arg, const int y_kmin_arg, con
   g_save_op = NULL;
   g_nop_all = 0;
   mem_mngr.init_Mem();
+#ifdef CUDA
+  CUDA_Host_Ap = NULL;
+  CUDA_Host_Ai = NULL;
+  CUDA_n = 0;
+  CUDA_nnz = 0;
+#endif
   symbolic = true;
   alt_symbolic = false;
   alt_symbolic_count = 0;
@@ -204,6 +235,20 @@ dynSparseMatrix::dynSparseMatrix(const int y_size_arg, const int y_kmin_arg, con
   lu_inc_tol = 1e-10;
   Symbolic = NULL;
   Numeric = NULL;
+#ifdef HAVE_KLU
+  klu_l_defaults(&KLU_Common);
+  KLU_Symbolic = NULL;
+  KLU_Numeric = NULL;
+#endif
+  sparse_backend = UMFPACK_backend;
+  keep_sparse_structures = false;
+  auto_stack_solve_algo = false;
+  sparse_read_pos = 0;
+  numeric_reuse_count = 0;
+  numeric_res1 = 0;
+  simplified_newton = 0;
+  csc_periods = 0;
+  csc_Size = 0;
 #ifdef CUDA
   CUDA_device = CUDA_device_arg;
   cublas_handle = cublas_handle_arg;
@@ -516,11 +561,22 @@ dynSparseMatrix::Insert(const int r, const int c, const int u_index, const int l
 void
 dynSparseMatrix::Close_SaveCode()
 {
-  SaveCode.close();
+  if (SaveCode.is_open())
+    SaveCode.close();
+  sparse_read_pos = 0;
+}
+
+void
+dynSparseMatrix::Read_Nonzero_Records(int nb_records, vector<int> &records)
+{
+  // Each record stores the equation, the variable, the lag and the index of a nonzero element
+  records.resize(4*max(nb_records, 0));
+  if (nb_records > 0)
+    SaveCode.read(reinterpret_cast<char *>(&records[0]), records.size()*sizeof(int));
 }
 
 void
-dynSparseMatrix::Read_SparseMatrix(string file_name, const int Size, int periods, int y_kmin, int y_kmax, bool two_boundaries, int stack_solve_algo, int solve_algo)
+dynSparseMatrix::Read_SparseMatrix(const string &file_name, const int Size, int periods, int y_kmin, int y_kmax, bool two_boundaries, int stack_solve_algo, int solve_algo)
 {
   unsigned int eq, var;
   int lag;
@@ -528,6 +584,24 @@ dynSparseMatrix::Read_SparseMatrix(string file_name, const int Size, int periods
   mem_mngr.fixe_file_name(file_name);
   /*mexPrintf("steady_state=%d, size=%d, solve_algo=%d, stack_solve_algo=%d, two_boundaries=%d\n",steady_state, Size, solve_algo, stack_solve_algo, two_boundaries);
     mexEvalString("drawnow;");*/
+  int nb_index_vara = Size*(periods+y_kmin+y_kmax);
+  if (keep_sparse_structures && !two_boundaries)
+    {
+      map<int, t_sparse_structure>::const_iterator it = sparse_structures.find(block_num);
+      if (it != sparse_structures.end())
+        {
+          IM_i = it->second.IM;
+          index_vara = (int *) mxMalloc(nb_index_vara*sizeof(int));
+          test_mxMalloc(index_vara, __LINE__, __FILE__, __func__, nb_index_vara*sizeof(int));
+          memcpy(index_vara, &it->second.index_vara[0], nb_index_vara*sizeof(int));
+          index_equa = (int *) mxMalloc(Size*sizeof(int));
+          test_mxMalloc(index_equa, __LINE__, __FILE__, __func__, Size*sizeof(int));
+          memcpy(index_equa, &it->second.index_equa[0], Size*sizeof(int));
+          sparse_read_pos = it->second.end_pos;
+          csc_periods = 0;
+          return;
+        }
+    }
   if (!SaveCode.is_open())
     {
       if (steady_state)
@@ -544,32 +618,36 @@ dynSparseMatrix::Read_SparseMatrix(string file_name, const int Size, int periods
           throw FatalExceptionHandling(tmp.str());
         }
     }
+  // The structures of the previous blocks may have been taken from sparse_structures
+  if (keep_sparse_structures)
+    SaveCode.seekg(sparse_read_pos);
   IM_i.clear();
+  vector<int> records;
   if (two_boundaries)
     {
       if (stack_solve_algo == 5)
         {
+          Read_Nonzero_Records(u_count_init-Size, records);
           for (int i = 0; i < u_count_init-Size; i++)
             {
-              int val;
-              SaveCode.read(reinterpret_cast<char *>(&eq), sizeof(eq));
-              SaveCode.read(reinterpret_cast<char *>(&var), sizeof(var));
-              SaveCode.read(reinterpret_cast<char *>(&lag), sizeof(lag));
-              SaveCode.read(reinterpret_cast<char *>(&val), sizeof(val));
+              eq = records[4*i];
+              var = records[4*i+1];
+              lag = records[4*i+2];
+              int val = records[4*i+3];
               IM_i[make_pair(make_pair(eq, var), lag)] = val;
             }
           for (int j = 0; j < Size; j++)
             IM_i[make_pair(make_pair(j, Size*(periods+y_kmax)), 0)] = j;
         }
-      else if (stack_solve_algo >= 0 && stack_solve_algo <= 4)
+      else if ((stack_solve_algo >= 0 && stack_solve_algo <= 4) || stack_solve_algo == 6)
         {
+          Read_Nonzero_Records(u_count_init-Size, records);
           for (int i = 0; i < u_count_init-Size; i++)
             {
-              int val;
-              SaveCode.read(reinterpret_cast<char *>(&eq), sizeof(eq));
-              SaveCode.read(reinterpret_cast<char *>(&var), sizeof(var));
-              SaveCode.read(reinterpret_cast<char *>(&lag), sizeof(lag));
-              SaveCode.read(reinterpret_cast<char *>(&val), sizeof(val));
+              eq = records[4*i];
+              var = records[4*i+1];
+              lag = records[4*i+2];
+              int val = records[4*i+3];
               IM_i[make_pair(make_pair(var - lag*Size, -lag), eq)] = val;
             }
           for (int j = 0; j < Size; j++)
@@ -577,13 +655,13 @@ dynSparseMatrix::Read_SparseMatrix(string file_name, const int Size, int periods
         }
       else if (stack_solve_algo == 7)
         {
+          Read_Nonzero_Records(u_count_init-Size, records);
           for (int i = 0; i < u_count_init-Size; i++)
             {
-              int val;
-              SaveCode.read(reinterpret_cast<char *>(&eq), sizeof(eq));
-              SaveCode.read(reinterpret_cast<char *>(&var), sizeof(var));
-              SaveCode.read(reinterpret_cast<char *>(&lag), sizeof(lag));
-              SaveCode.read(reinterpret_cast<char *>(&val), sizeof(val));
+              eq = records[4*i];
+              var = records[4*i+1];
+              lag = records[4*i+2];
+              int val = records[4*i+3];
               IM_i[make_pair(make_pair(eq, lag), var - lag * Size)] = val;
             }
           for (int j = 0; j < Size; j++)
@@ -594,25 +672,25 @@ dynSparseMatrix::Read_SparseMatrix(string file_name, const int Size, int periods
     {
       if ((stack_solve_algo == 5 && !steady_state) || (solve_algo == 5 && steady_state))
         {
+          Read_Nonzero_Records(u_count_init, records);
           for (int i = 0; i < u_count_init; i++)
             {
-              int val;
-              SaveCode.read(reinterpret_cast<char *>(&eq), sizeof(eq));
-              SaveCode.read(reinterpret_cast<char *>(&var), sizeof(var));
-              SaveCode.read(reinterpret_cast<char *>(&lag), sizeof(lag));
-              SaveCode.read(reinterpret_cast<char *>(&val), sizeof(val));
+              eq = records[4*i];
+              var = records[4*i+1];
+              lag = records[4*i+2];
+              int val = records[4*i+3];
               IM_i[make_pair(make_pair(eq, var), lag)] = val;
             }
         }
       else if (((stack_solve_algo >= 0 || stack_solve_algo <= 4) && !steady_state) || ((solve_algo >= 6 || solve_algo <= 8) && steady_state))
         {
+          Read_Nonzero_Records(u_count_init, records);
           for (int i = 0; i < u_count_init; i++)
             {
-              int val;
-              SaveCode.read(reinterpret_cast<char *>(&eq), sizeof(eq));
-              SaveCode.read(reinterpret_cast<char *>(&var), sizeof(var));
-              SaveCode.read(reinterpret_cast<char *>(&lag), sizeof(lag));
-              SaveCode.read(reinterpret_cast<char *>(&val), sizeof(val));
+              eq = records[4*i];
+              var = records[4*i+1];
+              lag = records[4*i+2];
+              int val = records[4*i+3];
               IM_i[make_pair(make_pair(var - lag*Size, -lag), eq)] = val;
             }
         }
@@ -631,6 +709,51 @@ dynSparseMatrix::Read_SparseMatrix(string file_name, const int Size, int periods
   test_mxMalloc(index_equa, __LINE__, __FILE__, __func__, Size*sizeof(int));
   for (int j = 0; j < Size; j++)
     SaveCode.read(reinterpret_cast<char *>(&index_equa[j]), sizeof(*index_equa));
+  block_complementarity.clear();
+  if (two_boundaries)
+    for (int i = 0; i < Size; i++)
+      {
+        map<int, t_complementarity>::const_iterator it = complementarity_conditions.find(index_equa[i]);
+        if (it == complementarity_conditions.end())
+          continue;
+        t_block_complementarity c;
+        c.equation = i;
+        c.variable = -1;
+        for (int j = 0; j < Size; j++)
+          if (index_vara[j] == it->second.variable)
+            c.variable = j;
+        c.bound = it->second.bound;
+        c.upper = it->second.upper;
+        c.own_u = -1;
+        for (size_t k = 0; k < records.size()/4; k++)
+          if (records[4*k] == i)
+            {
+              c.row_u.push_back(records[4*k+3]);
+              if (records[4*k+1] == c.variable && records[4*k+2] == 0)
+                c.own_u = records[4*k+3];
+            }
+        if (c.own_u < 0)
+          {
+            ostringstream tmp;
+            tmp << " in Read_SparseMatrix, the variable " << get_variable(eEndogenous, it->second.variable)
+                << " of the complementarity condition of equation " << index_equa[i]+1
+                << " does not appear at the current period in this equation, or not in the same block\n";
+            throw FatalExceptionHandling(tmp.str());
+          }
+        block_complementarity.push_back(c);
+      }
+  if (keep_sparse_structures && !two_boundaries)
+    {
+      sparse_read_pos = SaveCode.tellg();
+      t_sparse_structure &structure = sparse_structures[block_num];
+      structure.IM = IM_i;
+      structure.index_vara.assign(index_vara, index_vara+nb_index_vara);
+      structure.index_equa.assign(index_equa, index_equa+Size);
+      structure.end_pos = sparse_read_pos;
+    }
+  csc_periods = 0;
+  if (two_boundaries && ((stack_solve_algo >= 0 && stack_solve_algo <= 4) || stack_solve_algo == 6))
+    Compute_CSC_Pattern(periods, y_kmin, y_kmax, Size, IM_i);
 }
 
 void
@@ -967,11 +1090,11 @@ dynSparseMatrix::Init_UMFPACK_Sparse_Simple(int Size, map<pair<pair<int, int>, i
 }
 
 int
-dynSparseMatrix::find_exo_num(vector<s_plan> sconstrained_extended_path, int value)
+dynSparseMatrix::find_exo_num(const vector<s_plan> &sconstrained_extended_path, int value)
 {
   int res = -1;
   int i = 0;
-  for (vector<s_plan>::iterator it = sconstrained_extended_path.begin(); it != sconstrained_extended_path.end(); it++, i++)
+  for (vector<s_plan>::const_iterator it = sconstrained_extended_path.begin(); it != sconstrained_extended_path.end(); it++, i++)
     if (it->exo_num == value)
       {
         res = i;
@@ -995,7 +1118,88 @@ dynSparseMatrix::find_int_date(vector<pair<int, double> > per_value, int value)
 }
 
 void
-dynSparseMatrix::Init_UMFPACK_Sparse(int periods, int y_kmin, int y_kmax, int Size, map<pair<pair<int, int>, int>, int> &IM, SuiteSparse_long **Ap, SuiteSparse_long **Ai, double **Ax, double **b, mxArray *x0_m, vector_table_conditional_local_type vector_table_conditional_local, int block_num)
+dynSparseMatrix::Compute_CSC_Pattern(int periods, int y_kmin, int y_kmax, int Size, const map<pair<pair<int, int>, int>, int> &IM)
+{
+  /* Walks IM as Init_UMFPACK_Sparse() and Init_Matlab_Sparse() do, but records the
+     positions in u instead of the values, so that the Jacobian and the right hand side
+     of the next Newton iterations are filled without walking the map again */
+  int n = periods*Size;
+  csc_Ap.assign(n+1, -1);
+  csc_Ai.clear();
+  csc_u.clear();
+  csc_b_row.clear();
+  csc_b_u.clear();
+  csc_b_y.clear();
+  csc_Ap[0] = 0;
+  for (int t = 0; t < periods; t++)
+    {
+      int last_var = -1;
+      for (map<pair<pair<int, int>, int>, int>::const_iterator it4 = IM.begin(); it4 != IM.end(); it4++)
+        {
+          int var = it4->first.first.first;
+          int eq = it4->first.second+Size*t;
+          int lag = -it4->first.first.second;
+          int index = it4->second+ (t-lag) * u_count_init;
+          if (var != last_var)
+            {
+              if (1+last_var + t * Size <= n)
+                csc_Ap[1+last_var + t * Size] = csc_Ai.size();
+              last_var = var;
+            }
+          if (var < (periods+y_kmax)*Size)
+            {
+              int ti_y_kmin = -min(t, y_kmin);
+              int ti_y_kmax = min(periods-(t +1), y_kmax);
+              int ti_new_y_kmax = min(t, y_kmax);
+              int ti_new_y_kmin = -min(periods-(t+1), y_kmin);
+              if (lag <= ti_new_y_kmax && lag >= ti_new_y_kmin)
+                {
+                  csc_u.push_back(index);
+                  csc_Ai.push_back(eq - lag * Size);
+                }
+              if (lag > ti_y_kmax || lag < ti_y_kmin)
+                {
+                  csc_b_row.push_back(eq);
+                  csc_b_u.push_back(index+lag*u_count_init);
+                  csc_b_y.push_back(index_vara[var+Size*(y_kmin+t+lag)]);
+                }
+            }
+          else
+            {
+              csc_b_row.push_back(eq);
+              csc_b_u.push_back(index);
+              csc_b_y.push_back(-1);
+            }
+        }
+    }
+  csc_Ap[n] = csc_Ai.size();
+  // Columns without any nonzero element start where the previous one ends
+  for (int j = 1; j < n; j++)
+    if (csc_Ap[j] < 0)
+      csc_Ap[j] = csc_Ap[j-1];
+  csc_periods = periods;
+  csc_Size = Size;
+}
+
+void
+dynSparseMatrix::Fill_CSC_b(int periods, int y_kmin, int Size, double *b, double *x0)
+{
+  for (int i = 0; i < y_size*(periods+y_kmin); i++)
+    ya[i] = y[i];
+  for (int i = 0; i < periods*Size; i++)
+    {
+      b[i] = 0;
+      x0[i] = y[index_vara[Size*y_kmin+i]];
+    }
+  for (size_t k = 0; k < csc_b_row.size(); k++)
+    if (csc_b_y[k] < 0)
+      b[csc_b_row[k]] += u[csc_b_u[k]];
+    else
+      b[csc_b_row[k]] += u[csc_b_u[k]]*y[csc_b_y[k]];
+}
+
+void
+dynSparseMatrix::Init_UMFPACK_Sparse(int periods, int y_kmin, int y_kmax, int Size, map<pair<pair<int, int>, int>, int> &IM, SuiteSparse_long **Ap, SuiteSparse_long **Ai, double **Ax, double **b, mxArray *x0_m, const vector_table_conditional_local_type &vector_table_conditional_local, int block_num)
 {
   int t, eq, var, lag, ti_y_kmin, ti_y_kmax;
   double *jacob_exo;
@@ -1043,6 +1247,18 @@ dynSparseMatrix::Init_UMFPACK_Sparse(int periods, int y_kmin, int y_kmax, int Si
       tmp << " in Init_UMFPACK_Sparse, can't retrieve Ax matrix\n";
       throw FatalExceptionHandling(tmp.str());
     }
+  if (!vector_table_conditional_local.size() && csc_periods == periods && csc_Size == Size)
+    {
+      // The pattern has been computed in Read_SparseMatrix(): only the values are filled
+      Fill_CSC_b(periods, y_kmin, Size, *b, x0);
+      memcpy(*Ap, &csc_Ap[0], (n+1)*sizeof(SuiteSparse_long));
+      for (size_t k = 0; k < csc_u.size(); k++)
+        {
+          (*Ai)[k] = csc_Ai[k];
+          (*Ax)[k] = u[csc_u[k]];
+        }
+      return;
+    }
   map<pair<pair<int, int>, int>, int>::iterator it4, it5;
   for (int i = 0; i < y_size*(periods+y_kmin); i++)
     ya[i] = y[i];
@@ -1436,7 +1652,6 @@ dynSparseMatrix::Init_CUDA_Sparse(int periods, int y_kmin, int y_kmax, int Size,
 
   double *Host_b = (double *) mxMalloc(n * sizeof(double));
   test_mxMalloc(Host_b, __LINE__, __FILE__, __func__, n * sizeof(double));
-  cudaChk(cudaMalloc((void **) b, n * sizeof(double)), " in Init_Cuda_Sparse, not enought memory to allocate b vector on the graphic card\n");
 
   double *Host_x0 = mxGetPr(x0_m);
   if (!Host_x0)
@@ -1445,7 +1660,6 @@ dynSparseMatrix::Init_CUDA_Sparse(int periods, int y_kmin, int y_kmax, int Size,
       tmp << " in Init_Cuda_Sparse, can't retrieve x0 vector\n";
       throw FatalExceptionHandling(tmp.str());
     }
-  cudaChk(cudaMalloc((void **) x0, n * sizeof(double)), " in Init_Cuda_Sparse, not enought memory to allocate x0 vector on the graphic card\n");
 
   int *Host_Ap = (int *) mxMalloc((n+1) * sizeof(int));
   test_mxMalloc(Host_Ap, __LINE__, __FILE__, __func__, (n+1) * sizeof(int));
@@ -1671,9 +1885,35 @@ dynSparseMatrix::Init_CUDA_Sparse(int periods, int y_kmin, int y_kmax, int Size,
     mexPrintf("%d ", Host_Ai[i]);
   mexPrintf("]\n");
 # endif
-  cudaChk(cudaMalloc((void **) Ai, NZE * sizeof(int)), " in Init_Cuda_Sparse, can't allocate Ai index vector on the graphic card\n");
-  cudaChk(cudaMalloc((void **) Ax, NZE * sizeof(double)), "  in Init_Cuda_Sparse, can't allocate Ax on the graphic card\n");
-  cudaChk(cudaMalloc((void **) Ap, (n+1) * sizeof(int)), " in Init_Cuda_Sparse, can't allocate Ap index vector on the graphic card\n");
+  /* The structure of the matrix and the vectors are kept on the graphic card
+     between the Newton iterations: only the values are sent once the
+     structure has been transferred */
+  if (!CUDA_Host_Ap || CUDA_n != n || CUDA_nnz != (int) NZE
+      || memcmp(CUDA_Host_Ap, Host_Ap, (n + 1) * sizeof(int)) || memcmp(CUDA_Host_Ai, Host_Ai, NZE * sizeof(int)))
+    {
+      Free_CUDA_Buffers();
+      cudaChk(cudaMalloc((void **) &CUDA_b, n * sizeof(double)), " in Init_Cuda_Sparse, not enought memory to allocate b vector on the graphic card\n");
+      cudaChk(cudaMalloc((void **) &CUDA_x0, n * sizeof(double)), " in Init_Cuda_Sparse, not enought memory to allocate x0 vector on the graphic card\n");
+      cudaChk(cudaMalloc((void **) &CUDA_Ai, NZE * sizeof(int)), " in Init_Cuda_Sparse, can't allocate Ai index vector on the graphic card\n");
+      cudaChk(cudaMalloc((void **) &CUDA_Ax, NZE * sizeof(double)), "  in Init_Cuda_Sparse, can't allocate Ax on the graphic card\n");
+      cudaChk(cudaMalloc((void **) &CUDA_Ap, (n+1) * sizeof(int)), " in Init_Cuda_Sparse, can't allocate Ap index vector on the graphic card\n");
+      cudaChk(cudaMemcpy(CUDA_Ap, Host_Ap, (n + 1) * sizeof(int), cudaMemcpyHostToDevice), " in Init_CUDA_Sparse, cudaMemcpy Ap = Host_Ap failed");
+      cudaChk(cudaMemcpy(CUDA_Ai, Host_Ai, NZE * sizeof(int), cudaMemcpyHostToDevice), " in Init_CUDA_Sparse, cudaMemcpy Ai = Host_Ai failed");
+      CUDA_Host_Ap = Host_Ap;
+      CUDA_Host_Ai = Host_Ai;
+      CUDA_n = n;
+      CUDA_nnz = NZE;
+    }
+  else
+    {
+      mxFree(Host_Ap);
+      mxFree(Host_Ai);
+    }
+  *b = CUDA_b;
+  *x0 = CUDA_x0;
+  *Ai = CUDA_Ai;
+  *Ax = CUDA_Ax;
+  *Ap = CUDA_Ap;
   if (preconditioner == 3)
     {
       cudaChk(cudaMalloc((void **) Ai_tild, NZE_tild * sizeof(int)), " in Init_Cuda_Sparse, can't allocate Ai_tild index vector on the graphic card\n");
@@ -1683,8 +1923,6 @@ dynSparseMatrix::Init_CUDA_Sparse(int periods, int y_kmin, int y_kmax, int Size,
 
   cudaChk(cudaMemcpy(*x0,     Host_x0,     n *                   sizeof(double), cudaMemcpyHostToDevice), " in Init_CUDA_Sparse, cudaMemcpy x0 = Host_x0 failed");
   cudaChk(cudaMemcpy(*b,      Host_b,      n *                   sizeof(double), cudaMemcpyHostToDevice), " in Init_CUDA_Sparse, cudaMemcpy b = Host_b failed");
-  cudaChk(cudaMemcpy(*Ap,     Host_Ap,     (n + 1) *             sizeof(int),    cudaMemcpyHostToDevice), " in Init_CUDA_Sparse, cudaMemcpy Ap = Host_Ap failed");
-  cudaChk(cudaMemcpy(*Ai,     Host_Ai,     NZE *                 sizeof(int),    cudaMemcpyHostToDevice), " in Init_CUDA_Sparse, cudaMemcpy Ai = Host_Ai failed");
   cudaChk(cudaMemcpy(*Ax,     Host_Ax,     NZE *                 sizeof(double), cudaMemcpyHostToDevice), " in Init_CUDA_Sparse, cudaMemcpy Ax = Host_Ax failed");
   if (preconditioner == 3)
     {
@@ -1692,6 +1930,32 @@ dynSparseMatrix::Init_CUDA_Sparse(int periods, int y_kmin, int y_kmax, int Size,
       cudaChk(cudaMemcpy(*Ai_tild,     Host_Ai_tild,     NZE_tild *                 sizeof(int),    cudaMemcpyHostToDevice), " in Init_CUDA_Sparse, cudaMemcpy Ai_tild = Host_Ai_til failed");
     }
   cudaChk(cudaMemcpy(*A_tild, Host_A_tild, preconditioner_size * sizeof(double), cudaMemcpyHostToDevice), " in Init_CUDA_Sparse, cudaMemcpy A_tild = Host_A_tild failed");
+  mxFree(Host_b);
+  mxFree(Host_Ax);
+  mxFree(Host_A_tild);
+  if (preconditioner == 3)
+    {
+      mxFree(Host_Ap_tild);
+      mxFree(Host_Ai_tild);
+    }
+}
+
+void
+dynSparseMatrix::Free_CUDA_Buffers()
+{
+  if (!CUDA_Host_Ap)
+    return;
+  cudaChk(cudaFree(CUDA_Ai), "  in Free_CUDA_Buffers, can't free Ai\n");
+  cudaChk(cudaFree(CUDA_Ax), "  in Free_CUDA_Buffers, can't free Ax\n");
+  cudaChk(cudaFree(CUDA_Ap), "  in Free_CUDA_Buffers, can't free Ap\n");
+  cudaChk(cudaFree(CUDA_x0), "  in Free_CUDA_Buffers, can't free x0\n");
+  cudaChk(cudaFree(CUDA_b), "  in Free_CUDA_Buffers, can't free b\n");
+  mxFree(CUDA_Host_Ap);
+  mxFree(CUDA_Host_Ai);
+  CUDA_Host_Ap = NULL;
+  CUDA_Host_Ai = NULL;
+  CUDA_n = 0;
+  CUDA_nnz = 0;
 }
 #endif
 
@@ -1765,6 +2029,19 @@ dynSparseMatrix::Init_Matlab_Sparse(int periods, int y_kmin, int y_kmax, int Siz
       tmp << " in Init_Matlab_Sparse, can't retrieve A matrix\n";
       throw FatalExceptionHandling(tmp.str());
     }
+  if (csc_periods == periods && csc_Size == Size && csc_u.size() <= mxGetNzmax(A_m))
+    {
+      // The pattern has been computed in Read_SparseMatrix(): only the values are filled
+      Fill_CSC_b(periods, y_kmin, Size, b, x0);
+      for (int j = 0; j <= periods*Size; j++)
+        Aj[j] = csc_Ap[j];
+      for (size_t k = 0; k < csc_u.size(); k++)
+        {
+          Ai[k] = csc_Ai[k];
+          A[k] = u[csc_u[k]];
+        }
+      return;
+    }
 
   map<pair<pair<int, int>, int>, int>::iterator it4;
   for (int i = 0; i < y_size*(periods+y_kmin); i++)
@@ -2048,7 +2325,8 @@ dynSparseMatrix::Print_u()
 void
 dynSparseMatrix::End_GE(int Size)
 {
-  mem_mngr.Free_All();
+  // The elements are released, but their memory is kept for the next iterations
+  mem_mngr.Reset_All();
   mxFree(FNZE_R);
   mxFree(FNZE_C);
   mxFree(NbNZRow);
@@ -2063,43 +2341,41 @@ dynSparseMatrix::End_GE(int Size)
 }
 
 bool
-dynSparseMatrix::compare(int *save_op, int *save_opa, int *save_opaa, int beg_t, int periods, long int nop4,  int Size)
+dynSparseMatrix::compare(int *save_op, int *save_opa, int *save_opaa, int beg_t, int periods, long int nop4,  int Size, int Block_number)
 {
-  long int i, j, nop = nop4/2;
-  double r = 0.0;
+  long int i = 0;
   bool OK = true;
   t_save_op_s *save_op_s, *save_opa_s, *save_opaa_s;
-  int *diff1, *diff2;
-  diff1 = (int *) mxMalloc(nop*sizeof(int));
-  test_mxMalloc(diff1, __LINE__, __FILE__, __func__, nop*sizeof(int));
-  diff2 = (int *) mxMalloc(nop*sizeof(int));
-  test_mxMalloc(diff2, __LINE__, __FILE__, __func__, nop*sizeof(int));
-  int max_save_ops_first = -1;
-  j = i = 0;
+  t_compiled_elimination prog;
+  prog.Size = Size;
+  prog.beg_t = beg_t;
+  prog.nop4 = nop4;
+  prog.operat.reserve(nop4/2);
+  prog.lag.reserve(nop4/2);
+  prog.first.reserve(nop4/2);
+  prog.first_stride.reserve(nop4/2);
+  prog.second.reserve(nop4/2);
+  prog.second_stride.reserve(nop4/2);
   while (i < nop4 && OK)
     {
       save_op_s = (t_save_op_s *) &(save_op[i]);
       save_opa_s = (t_save_op_s *) &(save_opa[i]);
       save_opaa_s = (t_save_op_s *) &(save_opaa[i]);
-      diff1[j] = save_op_s->first-save_opa_s->first;
-      if (max_save_ops_first < save_op_s->first+diff1[j]*(periods-beg_t))
-        {
-          max_save_ops_first = save_op_s->first+diff1[j]*(periods-beg_t);
-        }
+      int diff1 = save_op_s->first-save_opa_s->first, diff2 = 0;
       switch (save_op_s->operat)
         {
         case IFLD:
         case IFDIV:
           OK = (save_op_s->operat == save_opa_s->operat && save_opa_s->operat == save_opaa_s->operat
-                && diff1[j] == (save_opa_s->first-save_opaa_s->first));
+                && diff1 == (save_opa_s->first-save_opaa_s->first));
           i += 2;
           break;
         case IFLESS:
         case IFSUB:
-          diff2[j] = save_op_s->second-save_opa_s->second;
+          diff2 = save_op_s->second-save_opa_s->second;
           OK = (save_op_s->operat == save_opa_s->operat && save_opa_s->operat == save_opaa_s->operat
-                && diff1[j] == (save_opa_s->first-save_opaa_s->first)
-                && diff2[j] == (save_opa_s->second-save_opaa_s->second));
+                && diff1 == (save_opa_s->first-save_opaa_s->first)
+                && diff2 == (save_opa_s->second-save_opaa_s->second));
           i += 3;
           break;
         default:
@@ -2107,110 +2383,105 @@ dynSparseMatrix::compare(int *save_op, int *save_opa, int *save_opaa, int beg_t,
           tmp << " in compare, unknown operator = " << save_op_s->operat << "\n";
           throw FatalExceptionHandling(tmp.str());
         }
-      j++;
+      prog.operat.push_back((unsigned char) save_op_s->operat);
+      prog.lag.push_back(save_op_s->lag);
+      prog.first.push_back(save_op_s->first);
+      prog.first_stride.push_back(diff1);
+      prog.second.push_back(save_op_s->operat == IFLESS || save_op_s->operat == IFSUB ? save_op_s->second : 0);
+      prog.second_stride.push_back(diff2);
     }
-  // the same pivot for all remaining periods
+  // the same pivot and the same operations for all remaining periods
   if (OK)
     {
-      for (int i = beg_t; i < periods; i++)
-        {
-          for (int j = 0; j < Size; j++)
-            pivot[i*Size+j] = pivot[(i-1)*Size+j]+Size;
-        }
-      if (max_save_ops_first >= u_count_alloc)
-        {
-          u_count_alloc += max_save_ops_first;
-          u = (double *) mxRealloc(u, u_count_alloc*sizeof(double));
-          if (!u)
-            {
-              ostringstream tmp;
-              tmp << " in compare, memory exhausted (realloc(" << u_count_alloc*sizeof(double) << "))\n";
-              throw FatalExceptionHandling(tmp.str());
-            }
+      replay_elimination(prog, 0, beg_t, periods, Size);
+      elimination_cache()[make_pair(filename, Block_number)] = prog;
+    }
+  return OK;
+}
+
+bool
+dynSparseMatrix::replay_cached_elimination(int *save_op, int beg_t, int periods, long int nop4, int Size, int Block_number)
+{
+  map<pair<string, int>, t_compiled_elimination>::const_iterator it = elimination_cache().find(make_pair(filename, Block_number));
+  if (it == elimination_cache().end() || it->second.Size != Size || it->second.nop4 != nop4)
+    return false;
+  const t_compiled_elimination &prog = it->second;
+  int shift = beg_t-prog.beg_t;
+  long int i = 0;
+  for (size_t k = 0; k < prog.operat.size(); k++)
+    {
+      t_save_op_s *save_op_s = (t_save_op_s *) &(save_op[i]);
+      if (save_op_s->operat != prog.operat[k] || save_op_s->lag != prog.lag[k]
+          || save_op_s->first != prog.first[k]+shift*prog.first_stride[k])
+        return false;
+      if (save_op_s->operat == IFLESS || save_op_s->operat == IFSUB)
+        {
+          if (save_op_s->second != prog.second[k]+shift*prog.second_stride[k])
+            return false;
+          i += 3;
         }
-      for (int t = 1; t < periods-beg_t-y_kmax; t++)
+      else
+        i += 2;
+    }
+  replay_elimination(prog, shift, beg_t, periods, Size);
+  return true;
+}
+
+void
+dynSparseMatrix::replay_elimination(const t_compiled_elimination &prog, int shift, int beg_t, int periods, int Size)
+{
+  int nop = prog.operat.size();
+  int periods_beg_t = periods-beg_t;
+  for (int i = beg_t; i < periods; i++)
+    for (int j = 0; j < Size; j++)
+      pivot[i*Size+j] = pivot[(i-1)*Size+j]+Size;
+  int max_save_ops_first = -1;
+  for (int k = 0; k < nop; k++)
+    max_save_ops_first = max(max_save_ops_first, prog.first[k]+prog.first_stride[k]*(shift+periods_beg_t));
+  if (max_save_ops_first >= u_count_alloc)
+    {
+      u_count_alloc += max_save_ops_first;
+      u = (double *) mxRealloc(u, u_count_alloc*sizeof(double));
+      if (!u)
         {
-          int i = j = 0;
-          double *up;
-          while (i < nop4)
-            {
-              t_save_op_s *save_op_s = (t_save_op_s *) (&(save_op[i]));
-              up = &u[save_op_s->first+t*diff1[j]];
-              switch (save_op_s->operat)
-                {
-                case IFLD:
-                  r = *up;
-                  i += 2;
-                  break;
-                case IFDIV:
-                  *up /= r;
-                  i += 2;
-                  break;
-                case IFSUB:
-                  *up -= u[save_op_s->second+t*diff2[j]]*r;;
-                  i += 3;
-                  break;
-                case IFLESS:
-                  *up = -u[save_op_s->second+t*diff2[j]]*r;
-                  i += 3;
-                  break;
-                }
-              j++;
-            }
+          ostringstream tmp;
+          tmp << " in replay_elimination, memory exhausted (realloc(" << u_count_alloc*sizeof(double) << "))\n";
+          throw FatalExceptionHandling(tmp.str());
         }
-      int t1 = max(1, periods-beg_t-y_kmax);
-      int periods_beg_t = periods-beg_t;
-      for (int t = t1; t < periods_beg_t; t++)
-        {
-          int i = j = 0;
-          int gap = periods_beg_t-t;
-          while (i < nop4)
+    }
+  const unsigned char *operat = &prog.operat[0];
+  const int *lag = &prog.lag[0];
+  const int *first = &prog.first[0], *first_stride = &prog.first_stride[0];
+  const int *second = &prog.second[0], *second_stride = &prog.second_stride[0];
+  double r = 0.0;
+  // In the last y_kmax periods, the operations involving leads beyond the horizon are skipped
+  int t1 = max(1, periods_beg_t-y_kmax);
+  for (int t = 1; t < periods_beg_t; t++)
+    {
+      int ts = t+shift;
+      int gap = (t < t1 ? INT_MAX : periods_beg_t-t);
+      for (int k = 0; k < nop; k++)
+        {
+          if (lag[k] >= gap)
+            continue;
+          double *up = &u[first[k]+ts*first_stride[k]];
+          switch (operat[k])
             {
-              t_save_op_s *save_op_s = (t_save_op_s *) (&(save_op[i]));
-              if (save_op_s->lag < gap)
-                {
-                  double *up = &u[save_op_s->first+t*diff1[j]];
-                  switch (save_op_s->operat)
-                    {
-                    case IFLD:
-                      r = *up;
-                      i += 2;
-                      break;
-                    case IFDIV:
-                      *up /= r;
-                      i += 2;
-                      break;
-                    case IFSUB:
-                      *up -= u[save_op_s->second+t*diff2[j]]*r;
-                      i += 3;
-                      break;
-                    case IFLESS:
-                      *up = -u[save_op_s->second+t*diff2[j]]*r;
-                      i += 3;
-                      break;
-                    }
-                }
-              else
-                {
-                  switch (save_op_s->operat)
-                    {
-                    case IFLD:
-                    case IFDIV:
-                      i += 2;
-                      break;
-                    case IFSUB:
-                    case IFLESS:
-                      i += 3;
-                      break;
-                    }
-                }
-              j++;
+            case IFLD:
+              r = *up;
+              break;
+            case IFDIV:
+              *up /= r;
+              break;
+            case IFSUB:
+              *up -= u[second[k]+ts*second_stride[k]]*r;
+              break;
+            case IFLESS:
+              *up = -u[second[k]+ts*second_stride[k]]*r;
+              break;
             }
         }
     }
-  mxFree(diff1);
-  mxFree(diff2);
-  return OK;
 }
 
 int
@@ -3293,13 +3564,22 @@ dynSparseMatrix::End_Matlab_LU_UMFPack()
     umfpack_dl_free_symbolic(&Symbolic);
   if (Numeric)
     umfpack_dl_free_numeric(&Numeric);
+#ifdef HAVE_KLU
+  if (KLU_Numeric)
+    klu_l_free_numeric(&KLU_Numeric, &KLU_Common);
+  if (KLU_Symbolic)
+    klu_l_free_symbolic(&KLU_Symbolic, &KLU_Common);
+#endif
+  Symbolic_Ap.clear();
+  Symbolic_Ai.clear();
 }
 
 void
 dynSparseMatrix::End_Solver()
 {
-  if (((stack_solve_algo == 0 || stack_solve_algo == 4) && !steady_state) || (solve_algo == 6 && steady_state))
+  if (((stack_solve_algo == 0 || stack_solve_algo == 4 || stack_solve_algo == 6) && !steady_state) || ((solve_algo == 6 || solve_algo == 9) && steady_state))
     End_Matlab_LU_UMFPack();
+  mem_mngr.Free_All();
 }
 
 void
@@ -3330,26 +3610,18 @@ dynSparseMatrix::Print_UMFPack(SuiteSparse_long *Ap, SuiteSparse_long *Ai, doubl
 }
 
 void
-dynSparseMatrix::Solve_LU_UMFPack(SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax, double *b, int n, int Size, double slowc_l, bool is_two_boundaries, int  it_, vector_table_conditional_local_type vector_table_conditional_local)
+dynSparseMatrix::Factorize_LU_UMFPack(SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax, int n, double *Control, double *Info, bool simplified_newton_step)
 {
-  SuiteSparse_long status, sys = 0;
-#ifndef _MSC_VER
-  double Control [UMFPACK_CONTROL], Info [UMFPACK_INFO], res [n];
-#else
-  double *Control, *Info, *res;
-  Control = (double *) mxMalloc(UMFPACK_CONTROL * sizeof(double));
-  test_mxMalloc(Control, __LINE__, __FILE__, __func__, UMFPACK_CONTROL * sizeof(double));
-  Info = (double *) mxMalloc(UMFPACK_INFO * sizeof(double));
-  test_mxMalloc(Info, __LINE__, __FILE__, __func__, UMFPACK_INFO * sizeof(double));
-  res = (double *) mxMalloc(n * sizeof(double));
-  test_mxMalloc(res, __LINE__, __FILE__, __func__, n * sizeof(double));
-#endif
-
-  umfpack_dl_defaults(Control);
-  Control [UMFPACK_PRL] = 5;
-  status = 0;
-  if (iter == 0)
-    {
+  SuiteSparse_long status;
+  clock_t t0 = clock();
+  /* The symbolic analysis only depends on the sparsity pattern: it is kept as
+     long as the pattern does not change (across Newton iterations and periods) */
+  bool same_pattern = Symbolic && Symbolic_Ap.size() == (size_t) n+1
+    && equal(Ap, Ap+n+1, Symbolic_Ap.begin()) && equal(Ai, Ai+Ap[n], Symbolic_Ai.begin());
+  if (!same_pattern)
+    {
+      if (Symbolic)
+        umfpack_dl_free_symbolic(&Symbolic);
       status = umfpack_dl_symbolic(n, n, Ap, Ai, Ax, &Symbolic, Control, Info);
       if (status < 0)
         {
@@ -3359,8 +3631,19 @@ dynSparseMatrix::Solve_LU_UMFPack(SuiteSparse_long *Ap, SuiteSparse_long *Ai, do
           Error << " umfpack_dl_symbolic failed\n";
           throw FatalExceptionHandling(Error.str());
         }
+      Symbolic_Ap.assign(Ap, Ap+n+1);
+      Symbolic_Ai.assign(Ai, Ai+Ap[n]);
     }
-  if (iter > 0)
+  /* Simplified Newton method: the previous factorization is kept while the
+     residuals are at least halved from one iteration to the next */
+  if (simplified_newton_step && same_pattern && Numeric && iter > 0
+      && numeric_reuse_count < simplified_newton && res1 < 0.5*numeric_res1)
+    {
+      numeric_reuse_count++;
+      numeric_res1 = res1;
+      return;
+    }
+  if (Numeric)
     umfpack_dl_free_numeric(&Numeric);
   status = umfpack_dl_numeric(Ap, Ai, Ax, Symbolic, &Numeric, Control, Info);
   if (status < 0)
@@ -3371,15 +3654,143 @@ dynSparseMatrix::Solve_LU_UMFPack(SuiteSparse_long *Ap, SuiteSparse_long *Ai, do
       Error << " umfpack_dl_numeric failed\n";
       throw FatalExceptionHandling(Error.str());
     }
-  status = umfpack_dl_solve(sys, Ap, Ai, Ax, res, b, Numeric, Control, Info);
-  if (status != UMFPACK_OK)
+  numeric_reuse_count = 0;
+  numeric_res1 = res1;
+  if (profile)
     {
-      umfpack_dl_report_info(Control, Info);
-      umfpack_dl_report_status(Control, status);
-      ostringstream  Error;
-      Error << " umfpack_dl_solve failed\n";
-      throw FatalExceptionHandling(Error.str());
+      t_block_profile &p = get_block_profile(block_num);
+      p.factorization_time += elapsed_ms(t0);
+      p.nnz_A = Ap[n];
+      p.nnz_LU = Info[UMFPACK_LNZ] + Info[UMFPACK_UNZ];
+    }
+}
+
+#ifdef HAVE_KLU
+void
+dynSparseMatrix::Factorize_LU_KLU(SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax, int n, bool simplified_newton_step)
+{
+  clock_t t0 = clock();
+  // As with UMFPACK, the ordering is kept as long as the sparsity pattern does not change
+  bool same_pattern = KLU_Symbolic && Symbolic_Ap.size() == (size_t) n+1
+    && equal(Ap, Ap+n+1, Symbolic_Ap.begin()) && equal(Ai, Ai+Ap[n], Symbolic_Ai.begin());
+  if (!same_pattern)
+    {
+      if (KLU_Numeric)
+        klu_l_free_numeric(&KLU_Numeric, &KLU_Common);
+      if (KLU_Symbolic)
+        klu_l_free_symbolic(&KLU_Symbolic, &KLU_Common);
+      KLU_Symbolic = klu_l_analyze(n, Ap, Ai, &KLU_Common);
+      if (!KLU_Symbolic)
+        {
+          ostringstream  Error;
+          Error << " klu_l_analyze failed (status = " << KLU_Common.status << ")\n";
+          throw FatalExceptionHandling(Error.str());
+        }
+      Symbolic_Ap.assign(Ap, Ap+n+1);
+      Symbolic_Ai.assign(Ai, Ai+Ap[n]);
+    }
+  if (simplified_newton_step && same_pattern && KLU_Numeric && iter > 0
+      && numeric_reuse_count < simplified_newton && res1 < 0.5*numeric_res1)
+    {
+      numeric_reuse_count++;
+      numeric_res1 = res1;
+      return;
+    }
+  /* With an unchanged pattern, the pivot sequence of the previous factorization is
+     reused, unless the resulting factors are badly conditioned */
+  bool refactored = false;
+  if (same_pattern && KLU_Numeric
+      && klu_l_refactor(Ap, Ai, Ax, KLU_Symbolic, KLU_Numeric, &KLU_Common)
+      && klu_l_rcond(KLU_Symbolic, KLU_Numeric, &KLU_Common))
+    refactored = KLU_Common.rcond >= klu_refactor_rcond;
+  if (!refactored)
+    {
+      if (KLU_Numeric)
+        klu_l_free_numeric(&KLU_Numeric, &KLU_Common);
+      KLU_Numeric = klu_l_factor(Ap, Ai, Ax, KLU_Symbolic, &KLU_Common);
+      if (!KLU_Numeric)
+        {
+          ostringstream  Error;
+          Error << " klu_l_factor failed (status = " << KLU_Common.status << ")\n";
+          throw FatalExceptionHandling(Error.str());
+        }
+    }
+  numeric_reuse_count = 0;
+  numeric_res1 = res1;
+  if (profile)
+    {
+      t_block_profile &p = get_block_profile(block_num);
+      p.factorization_time += elapsed_ms(t0);
+      p.nnz_A = Ap[n];
+      p.nnz_LU = KLU_Numeric->lnz + KLU_Numeric->unz;
+    }
+}
+#endif
+
+void
+dynSparseMatrix::Factorize_LU(SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax, int n, double *Control, double *Info, bool simplified_newton_step)
+{
+  switch (sparse_backend)
+    {
+#ifdef HAVE_KLU
+    case KLU_backend:
+      Factorize_LU_KLU(Ap, Ai, Ax, n, simplified_newton_step);
+      break;
+#endif
+    default:
+      Factorize_LU_UMFPack(Ap, Ai, Ax, n, Control, Info, simplified_newton_step);
+    }
+}
+
+void
+dynSparseMatrix::Solve_Factorized_LU(SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax, double *b, double *res, int n, double *Control, double *Info)
+{
+  SuiteSparse_long status, sys = 0;
+  switch (sparse_backend)
+    {
+#ifdef HAVE_KLU
+    case KLU_backend:
+      memcpy(res, b, n*sizeof(double));
+      if (!klu_l_solve(KLU_Symbolic, KLU_Numeric, n, 1, res, &KLU_Common))
+        {
+          ostringstream  Error;
+          Error << " klu_l_solve failed (status = " << KLU_Common.status << ")\n";
+          throw FatalExceptionHandling(Error.str());
+        }
+      break;
+#endif
+    default:
+      status = umfpack_dl_solve(sys, Ap, Ai, Ax, res, b, Numeric, Control, Info);
+      if (status != UMFPACK_OK)
+        {
+          umfpack_dl_report_info(Control, Info);
+          umfpack_dl_report_status(Control, status);
+          ostringstream  Error;
+          Error << " umfpack_dl_solve failed\n";
+          throw FatalExceptionHandling(Error.str());
+        }
     }
+}
+
+void
+dynSparseMatrix::Solve_LU_UMFPack(SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax, double *b, int n, int Size, double slowc_l, bool is_two_boundaries, int  it_, const vector_table_conditional_local_type &vector_table_conditional_local)
+{
+#ifndef _MSC_VER
+  double Control [UMFPACK_CONTROL], Info [UMFPACK_INFO], res [n];
+#else
+  double *Control, *Info, *res;
+  Control = (double *) mxMalloc(UMFPACK_CONTROL * sizeof(double));
+  test_mxMalloc(Control, __LINE__, __FILE__, __func__, UMFPACK_CONTROL * sizeof(double));
+  Info = (double *) mxMalloc(UMFPACK_INFO * sizeof(double));
+  test_mxMalloc(Info, __LINE__, __FILE__, __func__, UMFPACK_INFO * sizeof(double));
+  res = (double *) mxMalloc(n * sizeof(double));
+  test_mxMalloc(res, __LINE__, __FILE__, __func__, n * sizeof(double));
+#endif
+
+  umfpack_dl_defaults(Control);
+  Control [UMFPACK_PRL] = 5;
+  Factorize_LU(Ap, Ai, Ax, n, Control, Info, is_two_boundaries && simplified_newton > 0);
+  Solve_Factorized_LU(Ap, Ai, Ax, b, res, n, Control, Info);
 
   if (vector_table_conditional_local.size())
     {
@@ -3460,7 +3871,6 @@ dynSparseMatrix::Solve_LU_UMFPack(SuiteSparse_long *Ap, SuiteSparse_long *Ai, do
 void
 dynSparseMatrix::Solve_LU_UMFPack(SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax, double *b, int n, int Size, double slowc_l, bool is_two_boundaries, int  it_)
 {
-  SuiteSparse_long status, sys = 0;
 #ifndef _MSC_VER
   double Control [UMFPACK_CONTROL], Info [UMFPACK_INFO], res [n];
 #else
@@ -3475,39 +3885,8 @@ dynSparseMatrix::Solve_LU_UMFPack(SuiteSparse_long *Ap, SuiteSparse_long *Ai, do
 
   umfpack_dl_defaults(Control);
   Control [UMFPACK_PRL] = 5;
-  status = 0;
-  if (iter == 0)
-    {
-      status = umfpack_dl_symbolic(n, n, Ap, Ai, Ax, &Symbolic, Control, Info);
-      if (status < 0)
-        {
-          umfpack_dl_report_info(Control, Info);
-          umfpack_dl_report_status(Control, status);
-          ostringstream  Error;
-          Error << " umfpack_dl_symbolic failed\n";
-          throw FatalExceptionHandling(Error.str());
-        }
-    }
-  if (iter > 0)
-    umfpack_dl_free_numeric(&Numeric);
-  status = umfpack_dl_numeric(Ap, Ai, Ax, Symbolic, &Numeric, Control, Info);
-  if (status < 0)
-    {
-      umfpack_dl_report_info(Control, Info);
-      umfpack_dl_report_status(Control, status);
-      ostringstream  Error;
-      Error << " umfpack_dl_numeric failed\n";
-      throw FatalExceptionHandling(Error.str());
-    }
-  status = umfpack_dl_solve(sys, Ap, Ai, Ax, res, b, Numeric, Control, Info);
-  if (status != UMFPACK_OK)
-    {
-      umfpack_dl_report_info(Control, Info);
-      umfpack_dl_report_status(Control, status);
-      ostringstream  Error;
-      Error << " umfpack_dl_solve failed\n";
-      throw FatalExceptionHandling(Error.str());
-    }
+  Factorize_LU(Ap, Ai, Ax, n, Control, Info, false);
+  Solve_Factorized_LU(Ap, Ai, Ax, b, res, n, Control, Info);
 
   if (is_two_boundaries)
     for (int i = 0; i < n; i++)
@@ -3536,6 +3915,131 @@ dynSparseMatrix::Solve_LU_UMFPack(SuiteSparse_long *Ap, SuiteSparse_long *Ai, do
 #endif
 }
 
+bool
+dynSparseMatrix::Solve_Dense_LU(int Size, map<pair<pair<int, int>, int>, int> &IM, double slowc_l)
+{
+  /* The blocks of the minimum feedback set decomposition of the static model
+     are small, so that a dense factorization is cheaper than a sparse one.
+     As in Init_UMFPACK_Sparse_Simple(), the right hand side is u[0..Size-1],
+     and the solution is minus the new value of the variables. */
+  vector<double> A(Size*Size, 0.0), res(Size);
+  double cum_abs_sum = 0;
+  for (int i = 0; i < Size; i++)
+    {
+      int eq = index_vara[i];
+      ya[eq+it_*y_size] = y[eq+it_*y_size];
+      res[i] = u[i];
+      cum_abs_sum += fabs(u[i]);
+    }
+  if (cum_abs_sum < 1e-20)
+    {
+      for (int i = 0; i < Size; i++)
+        {
+          int eq = index_vara[i];
+          double yy = -(y[eq+it_*y_size]);
+          direction[eq] = yy;
+          y[eq+it_*y_size] += slowc_l * yy;
+        }
+      return false;
+    }
+  for (map<pair<pair<int, int>, int>, int>::const_iterator it = IM.begin(); it != IM.end(); it++)
+    A[it->first.second + it->first.first.first*Size] += u[it->second];
+
+  vector<lapack_int> ipiv(Size);
+  lapack_int m = Size, one = 1, info;
+  dgetrf(&m, &m, &A[0], &m, &ipiv[0], &info);
+  if (info > 0)
+    return true;
+  dgetrs("N", &m, &one, &A[0], &m, &ipiv[0], &res[0], &m, &info);
+  for (int i = 0; i < Size; i++)
+    {
+      int eq = index_vara[i];
+      double yy = -(res[i] + y[eq+it_*y_size]);
+      direction[eq] = yy;
+      y[eq+it_*y_size] += slowc_l * yy;
+    }
+  return false;
+}
+
+void
+dynSparseMatrix::Solve_LU_Block_Banded(SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax, double *b, int n, int Size, double slowc_l, const vector_table_conditional_local_type &vector_table_conditional_local)
+{
+  /* The stacked Jacobian of a two-boundary block has one block row and one block
+     column of size Size per period, and only the blocks within p periods below
+     and q periods above the diagonal are nonzero. It is solved by a block LU
+     decomposition without pivoting between periods, as in Laffargue (1990) and
+     Boucekkine (1995) and in the algorithm of Juillard (1996): at period k, the
+     diagonal block is factorized (with partial pivoting) and used to eliminate
+     the blocks below it. Only the band is stored, as dense blocks, so that the
+     memory is linear in the number of periods. */
+  if (vector_table_conditional_local.size())
+    throw FatalExceptionHandling(" in Solve_LU_Block_Banded, stack_solve_algo=6 cannot be used with conditional forecasts\n");
+  int nb_periods = n / Size;
+  int p = 0, q = 0;
+  for (int j = 0; j < n; j++)
+    for (SuiteSparse_long k = Ap[j]; k < Ap[j+1]; k++)
+      {
+        int d = int (Ai[k] / Size) - j / Size;
+        p = max(p, d);
+        q = max(q, -d);
+      }
+  int width = p+q+1;
+  size_t block_size = Size*Size;
+  // Block (i, j) of the band, for i-p <= j <= i+q, stored in column-major order
+  vector<double> band(nb_periods*width*block_size, 0.0);
+#define BLOCK(i, j) (&band[((i)*width+(j)-(i)+p)*block_size])
+  for (int j = 0; j < n; j++)
+    for (SuiteSparse_long k = Ap[j]; k < Ap[j+1]; k++)
+      BLOCK(Ai[k] / Size, j / Size)[Ai[k] % Size + (j % Size)*Size] += Ax[k];
+
+  vector<double> res(b, b+n);
+  vector<lapack_int> ipiv(Size);
+  lapack_int m = Size, one = 1, info;
+  blas_int bm = Size, bone = 1;
+  double minus_one = -1.0, plus_one = 1.0;
+  for (int k = 0; k < nb_periods; k++)
+    {
+      int last_col = min(nb_periods-1, k+q), last_row = min(nb_periods-1, k+p);
+      // Factorize the diagonal block, and compute its inverse times the rest of row k
+      double *diag = BLOCK(k, k);
+      dgetrf(&m, &m, diag, &m, &ipiv[0], &info);
+      if (info != 0)
+        {
+          ostringstream tmp;
+          tmp << " in Solve_LU_Block_Banded, the diagonal block of period " << k+1 << " is singular\n";
+          throw FatalExceptionHandling(tmp.str());
+        }
+      for (int j = k+1; j <= last_col; j++)
+        dgetrs("N", &m, &m, diag, &m, &ipiv[0], BLOCK(k, j), &m, &info);
+      dgetrs("N", &m, &one, diag, &m, &ipiv[0], &res[k*Size], &m, &info);
+      // Eliminate the blocks below the diagonal block
+      for (int i = k+1; i <= last_row; i++)
+        {
+          double *l = BLOCK(i, k);
+          for (int j = k+1; j <= last_col; j++)
+            dgemm("N", "N", &bm, &bm, &bm, &minus_one, l, &bm, BLOCK(k, j), &bm, &plus_one, BLOCK(i, j), &bm);
+          dgemm("N", "N", &bm, &bone, &bm, &minus_one, l, &bm, &res[k*Size], &bm, &plus_one, &res[i*Size], &bm);
+        }
+    }
+  // Back substitution
+  for (int k = nb_periods-2; k >= 0; k--)
+    for (int j = k+1; j <= min(nb_periods-1, k+q); j++)
+      dgemm("N", "N", &bm, &bone, &bm, &minus_one, BLOCK(k, j), &bm, &res[j*Size], &bm, &plus_one, &res[k*Size], &bm);
+#undef BLOCK
+
+  for (int i = 0; i < n; i++)
+    {
+      int eq = index_vara[i+Size*y_kmin];
+      double yy = -(res[i] + y[eq]);
+      direction[eq] = yy;
+      y[eq] += slowc_l * yy;
+    }
+  mxFree(Ap);
+  mxFree(Ai);
+  mxFree(Ax);
+  mxFree(b);
+}
+
 void
 dynSparseMatrix::Solve_LU_UMFPack(mxArray *A_m, mxArray *b_m, int Size, double slowc_l, bool is_two_boundaries, int  it_)
 {
@@ -3643,11 +4147,6 @@ dynSparseMatrix::Solve_CUDA_BiCGStab_Free(double *tmp_vect_host, double *p, doub
   cudaChk(cudaFree(y_), "  in Solve_Cuda_BiCGStab, can't free y_\n");
   cudaChk(cudaFree(z), "  in Solve_Cuda_BiCGStab, can't free z\n");
   cudaChk(cudaFree(tmp_), "  in Solve_Cuda_BiCGStab, can't free tmp_\n");
-  cudaChk(cudaFree(Ai), "  in Solve_Cuda_BiCGStab, can't free Ai\n");
-  cudaChk(cudaFree(Ax), "  in Solve_Cuda_BiCGStab, can't free Ax\n");
-  cudaChk(cudaFree(Ap), "  in Solve_Cuda_BiCGStab, can't free Ap\n");
-  cudaChk(cudaFree(x0), "  in Solve_Cuda_BiCGStab, can't free x0\n");
-  cudaChk(cudaFree(b), "  in Solve_Cuda_BiCGStab, can't free b\n");
   /*if (preconditioner == 0)
     {*/
   cudaChk(cudaFree(A_tild), "  in Solve_Cuda_BiCGStab, can't free A_tild (1)\n");
@@ -3790,17 +4289,12 @@ dynSparseMatrix::Solve_CUDA_BiCGStab(int *Ap, int *Ai, double *Ax, int *Ap_tild,
   if (bnorm == 0.0)
     {
       // if b = 0 the A.x = 0 => x = 0
-      cudaChk(cudaFree(Ai), "  in Solve_Cuda_BiCGStab, can't free Ai\n");
-      cudaChk(cudaFree(Ax), "  in Solve_Cuda_BiCGStab, can't free Ax\n");
-      cudaChk(cudaFree(Ap), "  in Solve_Cuda_BiCGStab, can't free Ap\n");
       if (preconditioner == 3)
         {
           cudaChk(cudaFree(Ai_tild), "  in Solve_Cuda_BiCGStab, can't free Ai_tild\n");
           cudaChk(cudaFree(Ap_tild), "  in Solve_Cuda_BiCGStab, can't free Ap_tild\n");
         }
       cudaChk(cudaFree(A_tild), "  in Solve_Cuda_BiCGStab, can't free A_tild\n");
-      cudaChk(cudaFree(x0), "  in Solve_Cuda_BiCGStab, can't free x0\n");
-      cudaChk(cudaFree(b), "  in Solve_Cuda_BiCGStab, can't free b\n");
       if (is_two_boundaries)
         for (int i = 0; i < n; i++)
           {
@@ -3856,17 +4350,12 @@ dynSparseMatrix::Solve_CUDA_BiCGStab(int *Ap, int *Ai, double *Ax, int *Ap_tild,
   if (convergence)
     {
       /* the initial value (x0) is solution of A x = b*/
-      cudaChk(cudaFree(Ai), "  in Solve_Cuda_BiCGStab, can't free Ai\n");
-      cudaChk(cudaFree(Ax), "  in Solve_Cuda_BiCGStab, can't free Ax\n");
-      cudaChk(cudaFree(Ap), "  in Solve_Cuda_BiCGStab, can't free Ap\n");
       if (preconditioner == 3)
         {
           cudaChk(cudaFree(Ai_tild), "  in Solve_Cuda_BiCGStab, can't free Ai_tild\n");
           cudaChk(cudaFree(Ap_tild), "  in Solve_Cuda_BiCGStab, can't free Ap_tild\n");
         }
       cudaChk(cudaFree(A_tild), "  in Solve_Cuda_BiCGStab, can't free A_tild\n");
-      cudaChk(cudaFree(x0), "  in Solve_Cuda_BiCGStab, can't free x0\n");
-      cudaChk(cudaFree(b), "  in Solve_Cuda_BiCGStab, can't free b\n");
       return 0;
     }
 
@@ -4843,19 +5332,25 @@ dynSparseMatrix::Solve_Matlab_GMRES(mxArray *A_m, mxArray *b_m, int Size, double
   throw FatalExceptionHandling(tmp.str());
 #endif
   size_t n = mxGetM(A_m);
-  const char *field_names[] = {"droptol", "type"};
-  mwSize dims[1] = { 1 };
-  mxArray *Setup = mxCreateStructArray(1, dims, 2, field_names);
-  mxSetFieldByNumber(Setup, 0, 0, mxCreateDoubleScalar(lu_inc_tol));
-  mxSetFieldByNumber(Setup, 0, 1, mxCreateString("ilutp"));
-  mxArray *lhs0[2];
-  mxArray *rhs0[2];
-  rhs0[0] = A_m;
-  rhs0[1] = Setup;
-  if (mexCallMATLAB(2, lhs0, 2, rhs0, "ilu"))
-    throw FatalExceptionHandling("In GMRES, the incomplet LU decomposition (ilu) ahs failed.");
-  mxArray *L1 = lhs0[0];
-  mxArray *U1 = lhs0[1];
+  mxArray *L1, *U1;
+  bool cached_ilu = Get_Cached_ILU(block, A_m, &L1, &U1);
+  if (!cached_ilu)
+    {
+      const char *field_names[] = {"droptol", "type"};
+      mwSize dims[1] = { 1 };
+      mxArray *Setup = mxCreateStructArray(1, dims, 2, field_names);
+      mxSetFieldByNumber(Setup, 0, 0, mxCreateDoubleScalar(lu_inc_tol));
+      mxSetFieldByNumber(Setup, 0, 1, mxCreateString("ilutp"));
+      mxArray *lhs0[2];
+      mxArray *rhs0[2];
+      rhs0[0] = A_m;
+      rhs0[1] = Setup;
+      if (mexCallMATLAB(2, lhs0, 2, rhs0, "ilu"))
+        throw FatalExceptionHandling("In GMRES, the incomplet LU decomposition (ilu) ahs failed.");
+      mxDestroyArray(Setup);
+      L1 = lhs0[0];
+      U1 = lhs0[1];
+    }
   /*[za,flag1] = gmres(g1a,b,Blck_size,1e-6,Blck_size*periods,L1,U1);*/
   mxArray *rhs[8];
   rhs[0] = A_m;
@@ -4871,12 +5366,10 @@ dynSparseMatrix::Solve_Matlab_GMRES(mxArray *A_m, mxArray *b_m, int Size, double
   mxArray *z = lhs[0];
   mxArray *flag = lhs[1];
   double *flag1 = mxGetPr(flag);
-  mxDestroyArray(rhs0[1]);
   mxDestroyArray(rhs[2]);
   mxDestroyArray(rhs[3]);
   mxDestroyArray(rhs[4]);
-  mxDestroyArray(rhs[5]);
-  mxDestroyArray(rhs[6]);
+  Release_ILU(block, A_m, L1, U1, cached_ilu, *flag1 == 0);
   if (*flag1 > 0)
     {
       ostringstream tmp;
@@ -4933,6 +5426,7 @@ dynSparseMatrix::Solve_Matlab_BiCGStab(mxArray *A_m, mxArray *b_m, int Size, dou
   L1 = NULL;
   U1 = NULL;
   Diag = NULL;
+  bool cached_ilu = false;
 
   mxArray *rhs0[4];
   if (preconditioner == 0)
@@ -4956,6 +5450,8 @@ dynSparseMatrix::Solve_Matlab_BiCGStab(mxArray *A_m, mxArray *b_m, int Size, dou
       Diag_j[n] = n;
     }
   else if (preconditioner == 1)
+    cached_ilu = Get_Cached_ILU(block, A_m, &L1, &U1);
+  if (preconditioner == 1 && !cached_ilu)
     {
       /*[L1, U1] = ilu(g1a=;*/
       const char *field_names[] = {"type", "droptol", "milu", "udiag", "thresh"};
@@ -5069,10 +5565,10 @@ dynSparseMatrix::Solve_Matlab_BiCGStab(mxArray *A_m, mxArray *b_m, int Size, dou
           mxDestroyArray(flag);
           mxDestroyArray(rhs[2]);
           mxDestroyArray(rhs[3]);
-          mxDestroyArray(rhs[4]);
-          mxDestroyArray(rhs[5]);
         }
     }
+  if (preconditioner == 1)
+    Release_ILU(block, A_m, L1, U1, cached_ilu, flags == 0);
 
   if (flags > 0)
     {
@@ -5119,6 +5615,59 @@ dynSparseMatrix::Solve_Matlab_BiCGStab(mxArray *A_m, mxArray *b_m, int Size, dou
   mxDestroyArray(z);
 }
 
+bool
+dynSparseMatrix::Get_Cached_ILU(int block, mxArray *A_m, mxArray **L1, mxArray **U1)
+{
+  map<int, t_ilu_s>::const_iterator it = ilu_cache.find(block);
+  size_t n = mxGetN(A_m);
+  if (it == ilu_cache.end() || it->second.n != n || it->second.nnz != (size_t) mxGetJc(A_m)[n])
+    return false;
+  *L1 = it->second.L;
+  *U1 = it->second.U;
+  return true;
+}
+
+void
+dynSparseMatrix::Release_ILU(int block, mxArray *A_m, mxArray *L1, mxArray *U1, bool cached, bool success)
+{
+  if (cached && success)
+    return;
+  map<int, t_ilu_s>::iterator it = ilu_cache.find(block);
+  if (it != ilu_cache.end())
+    {
+      // Either the preconditioner has failed, or it is replaced by a new one
+      mxDestroyArray(it->second.L);
+      mxDestroyArray(it->second.U);
+      ilu_cache.erase(it);
+    }
+  if (success)
+    {
+      size_t n = mxGetN(A_m);
+      t_ilu_s ilu;
+      ilu.n = n;
+      ilu.nnz = mxGetJc(A_m)[n];
+      ilu.L = L1;
+      ilu.U = U1;
+      ilu_cache[block] = ilu;
+    }
+  else if (!cached)
+    {
+      mxDestroyArray(L1);
+      mxDestroyArray(U1);
+    }
+}
+
+void
+dynSparseMatrix::Free_ILU_Cache()
+{
+  for (map<int, t_ilu_s>::iterator it = ilu_cache.begin(); it != ilu_cache.end(); it++)
+    {
+      mxDestroyArray(it->second.L);
+      mxDestroyArray(it->second.U);
+    }
+  ilu_cache.clear();
+}
+
 void
 dynSparseMatrix::Singular_display(int block, int Size)
 {
@@ -6005,9 +6554,15 @@ dynSparseMatrix::Solve_ByteCode_Symbolic_Sparse_GaussianElimination(int Size, bo
                       save_op = NULL;
                     }
                 }
+              else if (replay_cached_elimination(save_op, t, periods, nop, Size, Block_number))
+                {
+                  tbreak = t;
+                  tbreak_g = tbreak;
+                  break;
+                }
               else if (save_opa && save_opaa)
                 {
-                  if (compare(save_op, save_opa, save_opaa, t, periods, nop, Size))
+                  if (compare(save_op, save_opa, save_opaa, t, periods, nop, Size, Block_number))
                     {
                       tbreak = t;
                       tbreak_g = tbreak;
@@ -6101,7 +6656,7 @@ dynSparseMatrix::Grad_f_product(int n, mxArray *b_m, double *vectr, mxArray *A_m
     }
   else
     {
-      if (!((solve_algo == 6 && steady_state) || ((stack_solve_algo == 0 || stack_solve_algo == 1 || stack_solve_algo == 4) && !steady_state)))
+      if (!((solve_algo == 6 && steady_state) || ((stack_solve_algo == 0 || stack_solve_algo == 1 || stack_solve_algo == 4 || stack_solve_algo == 6) && !steady_state)))
         {
           mwIndex *Ai = mxGetIr(A_m);
           if (!Ai)
@@ -6289,6 +6844,8 @@ dynSparseMatrix::Simulate_One_Boundary(int block_num, int y_size, int y_kmin, in
   Clear_u();
   bool singular_system = false;
   u_count_alloc_save = u_count_alloc;
+  if (profile)
+    get_block_profile(block_num).nb_iterations++;
 
   if (isnan(res1) || isinf(res1))
     {
@@ -6334,17 +6891,11 @@ dynSparseMatrix::Simulate_One_Boundary(int block_num, int y_size, int y_kmin, in
           switch (solve_algo)
             {
             case 0:
-              mexPrintf("MODEL STEADY STATE: MATLAB fsolve\n");
-              break;
             case 1:
-              mexPrintf("MODEL STEADY STATE: MATLAB solve1\n");
-              break;
             case 2:
-            case 4:
-              mexPrintf("MODEL STEADY STATE: block decomposition + MATLAB solve1\n");
-              break;
             case 3:
-              mexPrintf("MODEL STEADY STATE: MATLAB csolve\n");
+            case 4:
+              mexPrintf("MODEL STEADY STATE: (method=Newton with dense LU)\n");
               break;
             case 5:
               mexPrintf("MODEL STEADY STATE: (method=ByteCode own solver)\n");
@@ -6373,7 +6924,15 @@ dynSparseMatrix::Simulate_One_Boundary(int block_num, int y_size, int y_kmin, in
       mexPrintf("-----------------------------------\n");
     }
   bool zero_solution;
+  clock_t t_assembly = clock();
 
+  if (steady_state && solve_algo <= 4)
+    {
+      singular_system = Solve_Dense_LU(size, IM_i, slowc);
+      if (profile)
+        get_block_profile(block_num).solve_time += elapsed_ms(t_assembly);
+      return singular_system;
+    }
   if ((solve_algo == 5 && steady_state) || (stack_solve_algo == 5 && !steady_state))
     Simple_Init(size, IM_i, zero_solution);
   else
@@ -6399,7 +6958,7 @@ dynSparseMatrix::Simulate_One_Boundary(int block_num, int y_size, int y_kmin, in
           tmp << " in Simulate_One_Boundary, can't allocate x0_m vector\n";
           throw FatalExceptionHandling(tmp.str());
         }
-      if (!((solve_algo == 6 && steady_state) || ((stack_solve_algo == 0 || stack_solve_algo == 4) && !steady_state)))
+      if (!((solve_algo == 6 && steady_state) || ((stack_solve_algo == 0 || stack_solve_algo == 4 || stack_solve_algo == 6) && !steady_state)))
         {
           Init_Matlab_Sparse_Simple(size, IM_i, A_m, b_m, zero_solution, x0_m);
           A_m_save = mxDuplicateArray(A_m);
@@ -6423,6 +6982,9 @@ dynSparseMatrix::Simulate_One_Boundary(int block_num, int y_size, int y_kmin, in
           memcpy(b_save, b, size * sizeof(double));
         }
     }
+  if (profile)
+    get_block_profile(block_num).assembly_time += elapsed_ms(t_assembly);
+  clock_t t_solve = clock();
   if (zero_solution)
     {
       for (int i = 0; i < size; i++)
@@ -6441,9 +7003,11 @@ dynSparseMatrix::Simulate_One_Boundary(int block_num, int y_size, int y_kmin, in
         Solve_Matlab_GMRES(A_m, b_m, size, slowc, block_num, false, it_, x0_m);
       else if ((solve_algo == 8 && steady_state) || (stack_solve_algo == 3 && !steady_state))
         Solve_Matlab_BiCGStab(A_m, b_m, size, slowc, block_num, false, it_, x0_m, preconditioner);
-      else if ((solve_algo == 6 && steady_state) || ((stack_solve_algo == 0 || stack_solve_algo == 1 || stack_solve_algo == 4) && !steady_state))
+      else if ((solve_algo == 6 && steady_state) || ((stack_solve_algo == 0 || stack_solve_algo == 1 || stack_solve_algo == 4 || stack_solve_algo == 6) && !steady_state))
         Solve_LU_UMFPack(Ap, Ai, Ax, b, size, size, slowc, true, 0);
     }
+  if (profile)
+    get_block_profile(block_num).solve_time += elapsed_ms(t_solve);
   return singular_system;
 }
 
@@ -6491,6 +7055,303 @@ dynSparseMatrix::solve_non_linear(const int block_num, const int y_size, const i
     }
 }
 
+void
+dynSparseMatrix::Fill_Jacobian_CSC(int Size, map<pair<pair<int, int>, int>, int> &IM, SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax)
+{
+  SuiteSparse_long NZE = 0;
+  int last_var = 0;
+  Ap[0] = 0;
+  for (map<pair<pair<int, int>, int>, int>::const_iterator it = IM.begin(); it != IM.end(); it++)
+    {
+      int var = it->first.first.first;
+      while (last_var < var)
+        Ap[++last_var] = NZE;
+      Ai[NZE] = it->first.second;
+      Ax[NZE] = u[it->second];
+      NZE++;
+    }
+  while (last_var < Size)
+    Ap[++last_var] = NZE;
+}
+
+void
+dynSparseMatrix::Broyden_product(int n, const SuiteSparse_long *Ap, const SuiteSparse_long *Ai, const double *Ax, const double *v, double *res, bool transpose)
+{
+  if (transpose)
+    for (int j = 0; j < n; j++)
+      {
+        double sum = 0;
+        for (SuiteSparse_long k = Ap[j]; k < Ap[j+1]; k++)
+          sum += Ax[k] * v[Ai[k]];
+        res[j] = sum;
+      }
+  else
+    {
+      memset(res, 0, n * sizeof(double));
+      for (int j = 0; j < n; j++)
+        for (SuiteSparse_long k = Ap[j]; k < Ap[j+1]; k++)
+          res[Ai[k]] += Ax[k] * v[j];
+    }
+  for (int l = 0; l < broyden_nb; l++)
+    {
+      const double *a = &broyden_a[l*n], *s = &broyden_s[l*n];
+      double prod = 0;
+      if (transpose)
+        {
+          for (int i = 0; i < n; i++)
+            prod += a[i] * v[i];
+          for (int i = 0; i < n; i++)
+            res[i] += s[i] * prod;
+        }
+      else
+        {
+          for (int i = 0; i < n; i++)
+            prod += s[i] * v[i];
+          for (int i = 0; i < n; i++)
+            res[i] += a[i] * prod;
+        }
+    }
+}
+
+void
+dynSparseMatrix::Broyden_solve(int n, SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax, double *v, double *res, double *Control, double *Info)
+{
+  Solve_Factorized_LU(Ap, Ai, Ax, v, res, n, Control, Info);
+  for (int l = 0; l < broyden_nb; l++)
+    {
+      const double *s = &broyden_s[l*n], *z = &broyden_z[l*n];
+      double prod = 0;
+      for (int i = 0; i < n; i++)
+        prod += s[i] * res[i];
+      prod /= broyden_d[l];
+      for (int i = 0; i < n; i++)
+        res[i] -= z[i] * prod;
+    }
+}
+
+bool
+dynSparseMatrix::Broyden_update(int n, SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax, const double *s, const double *df, double *Control, double *Info)
+{
+  double ss = 0;
+  for (int i = 0; i < n; i++)
+    ss += s[i] * s[i];
+  if (ss == 0)
+    return false;
+  broyden_a.resize((broyden_nb+1)*n);
+  broyden_s.resize((broyden_nb+1)*n);
+  broyden_z.resize((broyden_nb+1)*n);
+  broyden_d.resize(broyden_nb+1);
+  double *a = &broyden_a[broyden_nb*n], *z = &broyden_z[broyden_nb*n];
+  // a = (df - B s) / s's
+  Broyden_product(n, Ap, Ai, Ax, s, a, false);
+  for (int i = 0; i < n; i++)
+    a[i] = (df[i] - a[i]) / ss;
+  Broyden_solve(n, Ap, Ai, Ax, a, z, Control, Info);
+  double d = 1;
+  for (int i = 0; i < n; i++)
+    d += s[i] * z[i];
+  if (fabs(d) < 1e-10 || !isfinite(d))
+    return false;
+  memcpy(&broyden_s[broyden_nb*n], s, n * sizeof(double));
+  broyden_d[broyden_nb] = d;
+  broyden_nb++;
+  return true;
+}
+
+void
+dynSparseMatrix::solve_trust_region(const int block_num, const int y_size, const int size)
+{
+  /* Powell's dogleg method, with the scaling of MINPACK's hybrj. The Jacobian is
+     evaluated and factorized once, then updated with Broyden's formula after
+     each trial step: a rejected step only costs one evaluation of the residuals.
+     The Jacobian is evaluated again after trust_region_max_updates updates, or
+     when two successive steps fail to decrease the residuals */
+  it_ = 0;
+  Per_u_ = 0;
+  Per_y_ = 0;
+  vector<double> Control(UMFPACK_CONTROL), Info(UMFPACK_INFO);
+  umfpack_dl_defaults(&Control[0]);
+  size_t nnz = IM_i.size();
+  vector<SuiteSparse_long> Ap(size+1), Ai(max(nnz, (size_t) 1));
+  vector<double> Ax(max(nnz, (size_t) 1));
+  vector<double> x(size), f(size), minus_f(size), p_n(size), g(size), d(size), bd(size), p(size), bp(size), diag(size, 0.0), f_new(size);
+  if (!compute_complete(false, res1, res2, max_res, max_res_idx))
+    {
+      ostringstream tmp;
+      tmp << " in solve_trust_region, the initial values of endogenous variables are too far from the solution in block " << block_num+1 << "\n";
+      throw FatalExceptionHandling(tmp.str());
+    }
+  for (int i = 0; i < size; i++)
+    {
+      x[i] = y[index_vara[i]];
+      f[i] = r[i];
+    }
+  double fnorm2 = res2, delta = 0;
+  bool cvg = (max_res < solve_tolf), derivatives_at_x = true, jacobian_at_x = false;
+  int nb_failures = 0, nb_steps = 0;
+  iter = 0;
+  while (!cvg)
+    {
+      if (!jacobian_at_x && (broyden_nb == trust_region_max_updates || nb_failures >= 2 || iter == 0))
+        {
+          if (iter == maxit_)
+            break;
+          if (!derivatives_at_x)
+            {
+              compute_complete(false, res1, res2, max_res, max_res_idx);
+              derivatives_at_x = true;
+            }
+          Fill_Jacobian_CSC(size, IM_i, &Ap[0], &Ai[0], &Ax[0]);
+          Factorize_LU(&Ap[0], &Ai[0], &Ax[0], size, &Control[0], &Info[0], false);
+          iter++;
+          if (profile)
+            get_block_profile(block_num).nb_iterations++;
+          broyden_nb = 0;
+          nb_failures = 0;
+          jacobian_at_x = true;
+          for (int j = 0; j < size; j++)
+            {
+              double col_norm = 0;
+              for (SuiteSparse_long k = Ap[j]; k < Ap[j+1]; k++)
+                col_norm += Ax[k] * Ax[k];
+              diag[j] = max(diag[j], sqrt(col_norm));
+              if (diag[j] == 0)
+                diag[j] = 1;
+            }
+          if (delta == 0)
+            {
+              double x_norm = 0;
+              for (int j = 0; j < size; j++)
+                x_norm += diag[j] * diag[j] * x[j] * x[j];
+              x_norm = sqrt(x_norm);
+              delta = (x_norm > 0 ? trust_region_factor * x_norm : trust_region_factor);
+            }
+        }
+      else if (jacobian_at_x && (broyden_nb == trust_region_max_updates || nb_failures >= 2))
+        {
+          // The Jacobian is exact at x: restart from it rather than evaluating it again
+          broyden_nb = 0;
+          nb_failures = 0;
+        }
+
+      // Dogleg step in the variables scaled by diag
+      for (int i = 0; i < size; i++)
+        minus_f[i] = -f[i];
+      Broyden_solve(size, &Ap[0], &Ai[0], &Ax[0], &minus_f[0], &p_n[0], &Control[0], &Info[0]);
+      double pn_norm = 0;
+      for (int j = 0; j < size; j++)
+        pn_norm += diag[j] * diag[j] * p_n[j] * p_n[j];
+      pn_norm = sqrt(pn_norm);
+      if (pn_norm <= delta)
+        p = p_n;
+      else
+        {
+          Broyden_product(size, &Ap[0], &Ai[0], &Ax[0], &f[0], &g[0], true);
+          double gs_norm = 0;
+          for (int j = 0; j < size; j++)
+            {
+              d[j] = -g[j] / (diag[j] * diag[j]);
+              gs_norm += g[j] * g[j] / (diag[j] * diag[j]);
+            }
+          gs_norm = sqrt(gs_norm);
+          Broyden_product(size, &Ap[0], &Ai[0], &Ax[0], &d[0], &bd[0], false);
+          double bd_norm2 = 0;
+          for (int i = 0; i < size; i++)
+            bd_norm2 += bd[i] * bd[i];
+          if (gs_norm == 0 || bd_norm2 == 0)
+            for (int j = 0; j < size; j++)
+              p[j] = delta / pn_norm * p_n[j];
+          else
+            {
+              // Cauchy point along the scaled gradient
+              double t = gs_norm * gs_norm / bd_norm2;
+              if (t * gs_norm >= delta)
+                for (int j = 0; j < size; j++)
+                  p[j] = delta / gs_norm * d[j];
+              else
+                {
+                  double a = 0, b = 0, c = t * t * gs_norm * gs_norm - delta * delta;
+                  for (int j = 0; j < size; j++)
+                    {
+                      double w = diag[j] * (p_n[j] - t * d[j]);
+                      a += w * w;
+                      b += 2 * diag[j] * t * d[j] * w;
+                    }
+                  double tau = (-b + sqrt(b * b - 4 * a * c)) / (2 * a);
+                  for (int j = 0; j < size; j++)
+                    p[j] = t * d[j] + tau * (p_n[j] - t * d[j]);
+                }
+            }
+        }
+      double p_norm = 0;
+      for (int j = 0; j < size; j++)
+        p_norm += diag[j] * diag[j] * p[j] * p[j];
+      p_norm = sqrt(p_norm);
+      Broyden_product(size, &Ap[0], &Ai[0], &Ax[0], &p[0], &bp[0], false);
+      double predicted = fnorm2;
+      for (int i = 0; i < size; i++)
+        predicted -= (f[i] + bp[i]) * (f[i] + bp[i]);
+
+      // Trial step
+      for (int i = 0; i < size; i++)
+        y[index_vara[i]] = x[i] + p[i];
+      bool finite = compute_complete(true, res1, res2, max_res, max_res_idx) && isfinite(res2);
+      nb_steps++;
+      double ratio = -1;
+      bool updated = false;
+      if (finite)
+        {
+          for (int i = 0; i < size; i++)
+            {
+              f_new[i] = r[i];
+              g[i] = f_new[i] - f[i];
+            }
+          if (predicted > 0)
+            ratio = (fnorm2 - res2) / predicted;
+          updated = Broyden_update(size, &Ap[0], &Ai[0], &Ax[0], &p[0], &g[0], &Control[0], &Info[0]);
+        }
+      if (print_it)
+        mexPrintf("  trust region step %d: sqr. error=%.10e, radius=%e, ratio=%f\n", nb_steps, double (finite ? res2 : fnorm2), delta, ratio);
+
+      if (!finite)
+        delta = 0.25 * p_norm;
+      else if (ratio < 0.25)
+        delta = 0.5 * p_norm;
+      else if (ratio > 0.75)
+        delta = max(delta, 2 * p_norm);
+      if (ratio > 1e-4)
+        {
+          for (int i = 0; i < size; i++)
+            x[i] += p[i];
+          f = f_new;
+          fnorm2 = res2;
+          cvg = (max_res < solve_tolf);
+          derivatives_at_x = jacobian_at_x = false;
+          nb_failures = 0;
+        }
+      else
+        {
+          for (int i = 0; i < size; i++)
+            y[index_vara[i]] = x[i];
+          nb_failures++;
+        }
+      // A singular update is dropped, and the Jacobian is evaluated again
+      if (finite && !updated)
+        nb_failures = 2;
+      double x_norm = 0;
+      for (int j = 0; j < size; j++)
+        x_norm += diag[j] * diag[j] * x[j] * x[j];
+      if (!cvg && delta <= eps * (1 + sqrt(x_norm)))
+        break;
+    }
+  if (!cvg)
+    {
+      ostringstream tmp;
+      tmp << " in solve_trust_region, convergence not achieved in block " << block_num+1 << ", after " << iter << " Jacobian evaluations and " << nb_steps << " trial steps\n";
+      throw FatalExceptionHandling(tmp.str());
+    }
+}
+
 void
 dynSparseMatrix::Simulate_Newton_One_Boundary(const bool forward)
 {
@@ -6499,7 +7360,7 @@ dynSparseMatrix::Simulate_Newton_One_Boundary(const bool forward)
   r = (double *) mxMalloc(size*sizeof(double));
   test_mxMalloc(r, __LINE__, __FILE__, __func__, size*sizeof(double));
   iter = 0;
-  if ((solve_algo == 6 && steady_state) || ((stack_solve_algo == 0 || stack_solve_algo == 1 || stack_solve_algo == 4) && !steady_state))
+  if ((solve_algo == 6 && steady_state) || ((stack_solve_algo == 0 || stack_solve_algo == 1 || stack_solve_algo == 4 || stack_solve_algo == 6) && !steady_state))
     {
       Ap_save = (SuiteSparse_long *) mxMalloc((size + 1) * sizeof(SuiteSparse_long));
       test_mxMalloc(Ap_save, __LINE__, __FILE__, __func__, (size + 1) * sizeof(SuiteSparse_long));
@@ -6514,7 +7375,9 @@ dynSparseMatrix::Simulate_Newton_One_Boundary(const bool forward)
   if (steady_state)
     {
       it_ = 0;
-      if (!is_linear)
+      if (solve_algo == 9)
+        solve_trust_region(block_num, y_size, size);
+      else if (!is_linear)
         solve_non_linear(block_num, y_size, 0, 0, size);
       else
         solve_linear(block_num, y_size, 0, 0, size, 0);
@@ -6545,7 +7408,7 @@ dynSparseMatrix::Simulate_Newton_One_Boundary(const bool forward)
             solve_linear(block_num, y_size, y_kmin, y_kmax, size, 0);
         }
     }
-  if ((solve_algo == 6 && steady_state) || ((stack_solve_algo == 0 || stack_solve_algo == 1 || stack_solve_algo == 4) && !steady_state))
+  if ((solve_algo == 6 && steady_state) || ((stack_solve_algo == 0 || stack_solve_algo == 1 || stack_solve_algo == 4 || stack_solve_algo == 6) && !steady_state))
     {
       mxFree(Ap_save);
       mxFree(Ai_save);
@@ -6587,26 +7450,18 @@ dynSparseMatrix::preconditioner_print_out(string s, int preconditioner, bool ss)
 }
 
 void
-dynSparseMatrix::Simulate_Newton_Two_Boundaries(int blck, int y_size, int y_kmin, int y_kmax, int Size, int periods, bool cvg, int minimal_solving_periods, int stack_solve_algo, unsigned int endo_name_length, char *P_endo_names, vector_table_conditional_local_type vector_table_conditional_local)
+dynSparseMatrix::Simulate_Newton_Two_Boundaries(int blck, int y_size, int y_kmin, int y_kmax, int Size, int periods, bool cvg, int minimal_solving_periods, int stack_solve_algo, unsigned int endo_name_length, char *P_endo_names, const vector_table_conditional_local_type &vector_table_conditional_local)
 {
   double top = 0.5;
   double bottom = 0.1;
-#ifdef CUDA
-  int nnz, nnz_tild;
-  int *Ap_i, *Ai_i;
-  int *Ap_i_tild, *Ai_i_tild;
-  double *x0, *A_tild;
-
-#endif
   int preconditioner = 2;
   if (start_compare == 0)
     start_compare = y_kmin;
   u_count_alloc_save = u_count_alloc;
   clock_t t1 = clock();
   nop1 = 0;
-  mxArray *b_m = NULL, *A_m = NULL, *x0_m = NULL;
-  double *Ax = NULL, *b;
-  SuiteSparse_long *Ap = NULL, *Ai = NULL;
+  if (profile)
+    get_block_profile(blck).nb_iterations++;
 
   if (iter > 0)
     {
@@ -6752,6 +7607,9 @@ dynSparseMatrix::Simulate_Newton_Two_Boundaries(int blck, int y_size, int y_kmin
             case 5:
               mexPrintf("MODEL SIMULATION: (method=ByteCode own solver)\n");
               break;
+            case 6:
+              mexPrintf("MODEL SIMULATION: (method=Block-banded LU)\n");
+              break;
             case 7:
               mexPrintf(preconditioner_print_out("MODEL SIMULATION: (method=GPU BiCGStab)\n", preconditioner, false).c_str());
               break;
@@ -6771,61 +7629,16 @@ dynSparseMatrix::Simulate_Newton_Two_Boundaries(int blck, int y_size, int y_kmin
     {
       return;
     }
-  else
+  // The conditional forecasts modify the system, they are solved with stack_solve_algo=0
+  else if (auto_stack_solve_algo && vector_table_conditional_local.empty())
     {
-      if (stack_solve_algo == 5)
-        Init_GE(periods, y_kmin, y_kmax, Size, IM_i);
+      if (stack_solve_algo_ranking().count(make_pair(filename, blck)))
+        Solve_Stacked_System_Auto(blck, periods, y_kmin, y_kmax, Size, preconditioner, vector_table_conditional_local);
       else
-        {
-          b_m = mxCreateDoubleMatrix(periods*Size, 1, mxREAL);
-          if (!b_m)
-            {
-              ostringstream tmp;
-              tmp << " in Simulate_Newton_Two_Boundaries, can't allocate b_m vector\n";
-              throw FatalExceptionHandling(tmp.str());
-            }
-          x0_m = mxCreateDoubleMatrix(periods*Size, 1, mxREAL);
-          if (!x0_m)
-            {
-              ostringstream tmp;
-              tmp << " in Simulate_Newton_Two_Boundaries, can't allocate x0_m vector\n";
-              throw FatalExceptionHandling(tmp.str());
-            }
-          if (stack_solve_algo != 0 && stack_solve_algo != 4 && stack_solve_algo != 7)
-            {
-              A_m = mxCreateSparse(periods*Size, periods*Size, IM_i.size()* periods*2, mxREAL);
-              if (!A_m)
-                {
-                  ostringstream tmp;
-                  tmp << " in Simulate_Newton_Two_Boundaries, can't allocate A_m matrix\n";
-                  throw FatalExceptionHandling(tmp.str());
-                }
-            }
-          if (stack_solve_algo == 0 || stack_solve_algo == 4)
-            Init_UMFPACK_Sparse(periods, y_kmin, y_kmax, Size, IM_i, &Ap, &Ai, &Ax, &b, x0_m, vector_table_conditional_local, blck);
-#ifdef CUDA
-          else if (stack_solve_algo == 7)
-            Init_CUDA_Sparse(periods, y_kmin, y_kmax, Size, IM_i, &Ap_i, &Ai_i, &Ax, &Ap_i_tild, &Ai_i_tild, &A_tild, &b, &x0, x0_m, &nnz, &nnz_tild, preconditioner);
-#endif
-          else
-            Init_Matlab_Sparse(periods, y_kmin, y_kmax, Size, IM_i, A_m, b_m, x0_m);
-
-        }
-      if (stack_solve_algo == 0 || stack_solve_algo == 4)
-        Solve_LU_UMFPack(Ap, Ai, Ax, b, Size * periods, Size, slowc, true, 0, vector_table_conditional_local);
-      else if (stack_solve_algo == 1)
-        Solve_Matlab_Relaxation(A_m, b_m, Size, slowc, true, 0);
-      else if (stack_solve_algo == 2)
-        Solve_Matlab_GMRES(A_m, b_m, Size, slowc, blck, true, 0, x0_m);
-      else if (stack_solve_algo == 3)
-        Solve_Matlab_BiCGStab(A_m, b_m, Size, slowc, blck, true, 0, x0_m, 1);
-      else if (stack_solve_algo == 5)
-        Solve_ByteCode_Symbolic_Sparse_GaussianElimination(Size, symbolic, blck);
-#ifdef CUDA
-      else if (stack_solve_algo == 7)
-        Solve_CUDA_BiCGStab(Ap_i, Ai_i, Ax, Ap_i_tild, Ai_i_tild, A_tild, b, x0, Size * periods, Size, slowc, true, 0, nnz, nnz_tild, preconditioner, Size * periods, blck);
-#endif
+        Select_Stack_Solve_Algo(blck, periods, y_kmin, y_kmax, Size, preconditioner, vector_table_conditional_local);
     }
+  else
+    Solve_Stacked_System(stack_solve_algo, blck, periods, y_kmin, y_kmax, Size, preconditioner, vector_table_conditional_local);
   if (print_it)
     {
       clock_t t2 = clock();
@@ -6837,10 +7650,11 @@ dynSparseMatrix::Simulate_Newton_Two_Boundaries(int blck, int y_size, int y_kmin
       clock_t t2 = clock();
       double ax = -0.1, bx = 1.1, cx = 0.5, fa, fb, fc, xmin;
 
-      if (!mnbrak(&ax, &bx, &cx, &fa, &fb, &fc))
-        return;
-      //mexPrintf("ax= %f, bx=%f, cx=%f, fa=%f, fb=%f, fc=%d\n", ax, bx, cx, fa, fb, fc);
-      if (!golden(ax, bx, cx, 1e-1, solve_tolf, &xmin))
+      bool found = mnbrak(&ax, &bx, &cx, &fa, &fb, &fc)
+        && golden(ax, bx, cx, 1e-1, solve_tolf, &xmin);
+      if (profile)
+        get_block_profile(blck).line_search_time += elapsed_ms(t2);
+      if (!found)
         return;
       slowc = xmin;
       clock_t t3 = clock();
@@ -6853,6 +7667,185 @@ dynSparseMatrix::Simulate_Newton_Two_Boundaries(int blck, int y_size, int y_kmin
   return;
 }
 
+void
+dynSparseMatrix::Solve_Stacked_System(int stack_solve_algo, int blck, int periods, int y_kmin, int y_kmax, int Size, int preconditioner, const vector_table_conditional_local_type &vector_table_conditional_local)
+{
+#ifdef CUDA
+  int nnz, nnz_tild;
+  int *Ap_i, *Ai_i;
+  int *Ap_i_tild, *Ai_i_tild;
+  double *x0, *A_tild;
+#endif
+  mxArray *b_m = NULL, *A_m = NULL, *x0_m = NULL;
+  double *Ax = NULL, *b;
+  SuiteSparse_long *Ap = NULL, *Ai = NULL;
+  clock_t t_assembly = clock();
+  if (stack_solve_algo == 5)
+    Init_GE(periods, y_kmin, y_kmax, Size, IM_i);
+  else
+    {
+      b_m = mxCreateDoubleMatrix(periods*Size, 1, mxREAL);
+      if (!b_m)
+        {
+          ostringstream tmp;
+          tmp << " in Simulate_Newton_Two_Boundaries, can't allocate b_m vector\n";
+          throw FatalExceptionHandling(tmp.str());
+        }
+      x0_m = mxCreateDoubleMatrix(periods*Size, 1, mxREAL);
+      if (!x0_m)
+        {
+          ostringstream tmp;
+          tmp << " in Simulate_Newton_Two_Boundaries, can't allocate x0_m vector\n";
+          throw FatalExceptionHandling(tmp.str());
+        }
+      if (stack_solve_algo != 0 && stack_solve_algo != 4 && stack_solve_algo != 6 && stack_solve_algo != 7)
+        {
+          A_m = mxCreateSparse(periods*Size, periods*Size, IM_i.size()* periods*2, mxREAL);
+          if (!A_m)
+            {
+              ostringstream tmp;
+              tmp << " in Simulate_Newton_Two_Boundaries, can't allocate A_m matrix\n";
+              throw FatalExceptionHandling(tmp.str());
+            }
+        }
+      if (stack_solve_algo == 0 || stack_solve_algo == 4 || stack_solve_algo == 6)
+        Init_UMFPACK_Sparse(periods, y_kmin, y_kmax, Size, IM_i, &Ap, &Ai, &Ax, &b, x0_m, vector_table_conditional_local, blck);
+#ifdef CUDA
+      else if (stack_solve_algo == 7)
+        Init_CUDA_Sparse(periods, y_kmin, y_kmax, Size, IM_i, &Ap_i, &Ai_i, &Ax, &Ap_i_tild, &Ai_i_tild, &A_tild, &b, &x0, x0_m, &nnz, &nnz_tild, preconditioner);
+#endif
+      else
+        Init_Matlab_Sparse(periods, y_kmin, y_kmax, Size, IM_i, A_m, b_m, x0_m);
+
+    }
+  if (profile)
+    get_block_profile(blck).assembly_time += elapsed_ms(t_assembly);
+  clock_t t_solve = clock();
+  if (stack_solve_algo == 0 || stack_solve_algo == 4)
+    Solve_LU_UMFPack(Ap, Ai, Ax, b, Size * periods, Size, slowc, true, 0, vector_table_conditional_local);
+  else if (stack_solve_algo == 1)
+    Solve_Matlab_Relaxation(A_m, b_m, Size, slowc, true, 0);
+  else if (stack_solve_algo == 2)
+    Solve_Matlab_GMRES(A_m, b_m, Size, slowc, blck, true, 0, x0_m);
+  else if (stack_solve_algo == 3)
+    Solve_Matlab_BiCGStab(A_m, b_m, Size, slowc, blck, true, 0, x0_m, 1);
+  else if (stack_solve_algo == 5)
+    Solve_ByteCode_Symbolic_Sparse_GaussianElimination(Size, symbolic, blck);
+  else if (stack_solve_algo == 6)
+    Solve_LU_Block_Banded(Ap, Ai, Ax, b, Size * periods, Size, slowc, vector_table_conditional_local);
+#ifdef CUDA
+  else if (stack_solve_algo == 7)
+    Solve_CUDA_BiCGStab(Ap_i, Ai_i, Ax, Ap_i_tild, Ai_i_tild, A_tild, b, x0, Size * periods, Size, slowc, true, 0, nnz, nnz_tild, preconditioner, Size * periods, blck);
+#endif
+  if (profile)
+    get_block_profile(blck).solve_time += elapsed_ms(t_solve);
+}
+
+bool
+dynSparseMatrix::Try_Stacked_System(int algo, int blck, int periods, int y_kmin, int y_kmax, int Size, int preconditioner, const vector_table_conditional_local_type &vector_table_conditional_local)
+{
+  /* The iterative solvers only issue a warning when they fail, leaving the
+     direction unchanged: it is set to NaN beforehand to detect it */
+  for (int i = 0; i < Size*periods; i++)
+    direction[index_vara[i+Size*y_kmin]] = NAN;
+  try
+    {
+      Solve_Stacked_System(algo, blck, periods, y_kmin, y_kmax, Size, preconditioner, vector_table_conditional_local);
+    }
+  catch (GeneralExceptionHandling &)
+    {
+      return false;
+    }
+  for (int i = 0; i < Size*periods; i++)
+    if (!isfinite(direction[index_vara[i+Size*y_kmin]]))
+      return false;
+  return true;
+}
+
+void
+dynSparseMatrix::Select_Stack_Solve_Algo(int blck, int periods, int y_kmin, int y_kmax, int Size, int preconditioner, const vector_table_conditional_local_type &vector_table_conditional_local)
+{
+  /* The solvers whose stacked system is assembled from the same sparse
+     structure (see Read_SparseMatrix): the symbolic Gaussian elimination (5)
+     and the GPU (7) are never selected */
+  const int candidates[] = { 0, 6, 3,
+#ifndef OCTAVE_MEX_FILE
+                             2
+#endif
+  };
+  const int nb_candidates = sizeof(candidates)/sizeof(candidates[0]);
+  int n = size_of_direction/sizeof(double);
+  vector<double> y_save(y, y+n), direction_save(direction, direction+n);
+  vector<double> y_best, direction_best;
+  vector<pair<double, int> > timings;
+  double best_time = 0;
+  for (int k = 0; k < nb_candidates; k++)
+    {
+      if (k > 0)
+        {
+          copy(y_save.begin(), y_save.end(), y);
+          copy(direction_save.begin(), direction_save.end(), direction);
+        }
+      clock_t t0 = clock();
+      bool success = Try_Stacked_System(candidates[k], blck, periods, y_kmin, y_kmax, Size, preconditioner, vector_table_conditional_local);
+      double t = elapsed_ms(t0);
+      if (print_it)
+        {
+          if (success)
+            mexPrintf("stack_solve_algo=%d: %f milliseconds\n", candidates[k], t);
+          else
+            mexPrintf("stack_solve_algo=%d: failure\n", candidates[k]);
+        }
+      if (!success)
+        continue;
+      if (timings.empty() || t < best_time)
+        {
+          best_time = t;
+          y_best.assign(y, y+n);
+          direction_best.assign(direction, direction+n);
+        }
+      timings.push_back(make_pair(t, candidates[k]));
+    }
+  if (timings.empty())
+    {
+      ostringstream tmp;
+      tmp << " in Select_Stack_Solve_Algo, none of the solvers of the stacked system succeeded in block " << blck+1 << "\n";
+      throw FatalExceptionHandling(tmp.str());
+    }
+  sort(timings.begin(), timings.end());
+  vector<int> &ranking = stack_solve_algo_ranking()[make_pair(filename, blck)];
+  ranking.clear();
+  for (vector<pair<double, int> >::const_iterator it = timings.begin(); it != timings.end(); it++)
+    ranking.push_back(it->second);
+  copy(y_best.begin(), y_best.end(), y);
+  copy(direction_best.begin(), direction_best.end(), direction);
+  if (print_it)
+    mexPrintf("stack_solve_algo=%d selected for block %d\n", ranking.front(), blck+1);
+}
+
+void
+dynSparseMatrix::Solve_Stacked_System_Auto(int blck, int periods, int y_kmin, int y_kmax, int Size, int preconditioner, const vector_table_conditional_local_type &vector_table_conditional_local)
+{
+  vector<int> &ranking = stack_solve_algo_ranking()[make_pair(filename, blck)];
+  int n = size_of_direction/sizeof(double);
+  vector<double> y_save(y, y+n), direction_save(direction, direction+n);
+  while (!ranking.empty())
+    {
+      if (Try_Stacked_System(ranking.front(), blck, periods, y_kmin, y_kmax, Size, preconditioner, vector_table_conditional_local))
+        return;
+      // The solver is discarded for this block, for the rest of the session
+      if (print_it)
+        mexPrintf("stack_solve_algo=%d failed in block %d\n", ranking.front(), blck+1);
+      ranking.erase(ranking.begin());
+      copy(y_save.begin(), y_save.end(), y);
+      copy(direction_save.begin(), direction_save.end(), direction);
+    }
+  stack_solve_algo_ranking().erase(make_pair(filename, blck));
+  ostringstream tmp;
+  tmp << " in Solve_Stacked_System_Auto, none of the solvers of the stacked system succeeded in block " << blck+1 << "\n";
+  throw FatalExceptionHandling(tmp.str());
+}
+
 void
 dynSparseMatrix::fixe_u(double **u, int u_count_int, int max_lag_plus_max_lead_plus_1)
 {
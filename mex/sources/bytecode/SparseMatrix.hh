@@ -26,9 +26,13 @@
 #include <map>
 #include <ctime>
 #include "dynblas.h"
+#include "dynlapack.h"
 #if !(defined _MSC_VER)
 # include "dynumfpack.h"
 #endif
+#ifdef HAVE_KLU
+# include <klu.h>
+#endif
 
 #ifdef CUDA
 # include "cuda.h"
@@ -86,6 +90,35 @@ struct t_save_op_s
   int first, second;
 };
 
+//! Sparsity structure of a one boundary block, as read by Read_SparseMatrix()
+struct t_sparse_structure
+{
+  map<pair<pair<int, int>, int>, int> IM;
+  vector<int> index_vara, index_equa;
+  //! Position in the .bin file after the structure of the block
+  streampos end_pos;
+};
+
+//! Incomplete LU decomposition of a block Jacobian, used as preconditioner
+struct t_ilu_s
+{
+  size_t n, nnz;
+  mxArray *L, *U;
+};
+
+//! Elimination program of a two boundaries block, compiled by compare() from the operations recorded in one period
+/*! Operation k of period beg_t+t applies operat[k] to u[first[k]+t*first_stride[k]], with
+  u[second[k]+t*second_stride[k]] as second operand for IFLESS and IFSUB; it is skipped in
+  the last periods if lag[k] reaches beyond the horizon */
+struct t_compiled_elimination
+{
+  int Size, beg_t;
+  //! Length of the recorded program, in int
+  long int nop4;
+  vector<unsigned char> operat;
+  vector<int> lag, first, first_stride, second, second_stride;
+};
+
 const int IFLD  = 0;
 const int IFDIV = 1;
 const int IFLESS = 2;
@@ -98,6 +131,19 @@ const double eps = 1e-15;
 const double very_big = 1e24;
 const int alt_symbolic_count_max = 1;
 const double mem_increasing_factor = 1.1;
+//! Below this reciprocal condition number estimate, a KLU refactorization is replaced by a factorization with pivoting
+const double klu_refactor_rcond = 1e-12;
+//! Maximum number of Broyden updates of the Jacobian between two evaluations in the trust-region steady state solver
+const int trust_region_max_updates = 10;
+//! Initial radius of the trust region, relative to the scaled norm of the initial guess
+const double trust_region_factor = 100;
+
+//! Sparse direct solvers of the stacked systems (options_.simul.sparse_backend)
+enum sparse_backend_type
+  {
+    UMFPACK_backend,                 //!< UMFPACK, the default
+    KLU_backend                      //!< KLU, available if bytecode has been compiled with HAVE_KLU
+  };
 
 class dynSparseMatrix : public Evaluate
 {
@@ -111,24 +157,43 @@ public:
                   , const int CUDA_device_arg, cublasHandle_t cublas_handle_arg, cusparseHandle_t cusparse_handle_arg, cusparseMatDescr_t descr_arg
 #endif
                   );
-  void Simulate_Newton_Two_Boundaries(int blck, int y_size, int y_kmin, int y_kmax, int Size, int periods, bool cvg, int minimal_solving_periods, int stack_solve_algo, unsigned int endo_name_length, char *P_endo_names, vector_table_conditional_local_type vector_table_conditional_local);
+  void Simulate_Newton_Two_Boundaries(int blck, int y_size, int y_kmin, int y_kmax, int Size, int periods, bool cvg, int minimal_solving_periods, int stack_solve_algo, unsigned int endo_name_length, char *P_endo_names, const vector_table_conditional_local_type &vector_table_conditional_local);
   void Simulate_Newton_One_Boundary(bool forward);
   void fixe_u(double **u, int u_count_int, int max_lag_plus_max_lead_plus_1);
-  void Read_SparseMatrix(string file_name, const int Size, int periods, int y_kmin, int y_kmax, bool two_boundaries, int stack_solve_algo, int solve_algo);
+  void Read_SparseMatrix(const string &file_name, const int Size, int periods, int y_kmin, int y_kmax, bool two_boundaries, int stack_solve_algo, int solve_algo);
   void Close_SaveCode();
+  void Read_Nonzero_Records(int nb_records, vector<int> &records);
   void Read_file(string file_name, int periods, int u_size1, int y_size, int y_kmin, int y_kmax, int &nb_endo, int &u_count, int &u_count_init, double *u);
   void Singular_display(int block, int Size);
   void End_Solver();
+  //! Frees the preconditioners kept between the calls to the iterative solvers
+  void Free_ILU_Cache();
   double g0, gp0, glambda2;
   int try_at_iteration;
-  int find_exo_num(vector<s_plan> sconstrained_extended_path, int value);
+  //! Maximum number of Newton iterations reusing the same LU factorization (simplified Newton method)
+  int simplified_newton;
+  sparse_backend_type sparse_backend;
+  //! Keeps the sparsity structures of the one boundary blocks across the calls of Read_SparseMatrix()
+  bool keep_sparse_structures;
+  //! Selects the solver of the stacked system of each two boundaries block by timing the candidates (stack_solve_algo=8)
+  bool auto_stack_solve_algo;
+  int find_exo_num(const vector<s_plan> &sconstrained_extended_path, int value);
   int find_int_date(vector<pair<int, double> > per_value, int value);
 
 private:
+  /* Broyden updates B = J + sum_l a_l s_l' of the Jacobian J used by solve_trust_region(),
+     stored by columns of size n, with z_l = B_l^{-1} a_l and d_l = 1 + s_l' z_l */
+  vector<double> broyden_a, broyden_s, broyden_z, broyden_d;
+  int broyden_nb;
   void Init_GE(int periods, int y_kmin, int y_kmax, int Size, map<pair<pair<int, int>, int>, int> &IM);
+  //! Computes the compressed column pattern of the stacked Jacobian of a two boundaries block from IM
+  void Compute_CSC_Pattern(int periods, int y_kmin, int y_kmax, int Size, const map<pair<pair<int, int>, int>, int> &IM);
+  //! Fills b and x0 from the pattern computed by Compute_CSC_Pattern()
+  void Fill_CSC_b(int periods, int y_kmin, int Size, double *b, double *x0);
   void Init_Matlab_Sparse(int periods, int y_kmin, int y_kmax, int Size, map<pair<pair<int, int>, int>, int> &IM, mxArray *A_m, mxArray *b_m, mxArray *x0_m);
-  void Init_UMFPACK_Sparse(int periods, int y_kmin, int y_kmax, int Size, map<pair<pair<int, int>, int>, int> &IM, SuiteSparse_long **Ap, SuiteSparse_long **Ai, double **Ax, double **b, mxArray *x0_m, vector_table_conditional_local_type vector_table_conditional_local, int block_num);
+  void Init_UMFPACK_Sparse(int periods, int y_kmin, int y_kmax, int Size, map<pair<pair<int, int>, int>, int> &IM, SuiteSparse_long **Ap, SuiteSparse_long **Ai, double **Ax, double **b, mxArray *x0_m, const vector_table_conditional_local_type &vector_table_conditional_local, int block_num);
 #ifdef CUDA
+  void Free_CUDA_Buffers();
   void Init_CUDA_Sparse(int periods, int y_kmin, int y_kmax, int Size, map<pair<pair<int, int>, int>, int> &IM, int **Ap, int **Ai, double **Ax, int **Ap_tild, int **Ai_tild, double **A_tild, double **b, double **x0, mxArray *x0_m, int *nnz, int *nnz_tild, int preconditioner);
 #endif
   void Init_Matlab_Sparse_Simple(int Size, map<pair<pair<int, int>, int>, int> &IM, mxArray *A_m, mxArray *b_m, bool &zero_solution, mxArray *x0_m);
@@ -146,8 +211,19 @@ private:
   void Printfull_UMFPack(SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax, double *b, int n);
   void PrintM(int n, double *Ax, mwIndex *Ap, mwIndex *Ai);
   void Solve_LU_UMFPack(mxArray *A_m, mxArray *b_m, int Size, double slowc_l, bool is_two_boundaries, int  it_);
-  void Solve_LU_UMFPack(SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax, double *b, int n, int Size, double slowc_l, bool is_two_boundaries, int  it_, vector_table_conditional_local_type vector_table_conditional_local);
+  void Solve_LU_UMFPack(SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax, double *b, int n, int Size, double slowc_l, bool is_two_boundaries, int  it_, const vector_table_conditional_local_type &vector_table_conditional_local);
   void Solve_LU_UMFPack(SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax, double *b, int n, int Size, double slowc_l, bool is_two_boundaries, int  it_);
+  //! Newton step of a static block with the dense LU of its Jacobian (steady state with solve_algo <= 4); returns true if the Jacobian is singular
+  bool Solve_Dense_LU(int Size, map<pair<pair<int, int>, int>, int> &IM, double slowc_l);
+  void Solve_LU_Block_Banded(SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax, double *b, int n, int Size, double slowc_l, const vector_table_conditional_local_type &vector_table_conditional_local);
+  void Factorize_LU_UMFPack(SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax, int n, double *Control, double *Info, bool simplified_newton_step);
+  //! Factorizes the matrix with the backend selected by sparse_backend
+  void Factorize_LU(SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax, int n, double *Control, double *Info, bool simplified_newton_step);
+  //! Solves the system with the factorization computed by Factorize_LU()
+  void Solve_Factorized_LU(SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax, double *b, double *res, int n, double *Control, double *Info);
+#ifdef HAVE_KLU
+  void Factorize_LU_KLU(SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax, int n, bool simplified_newton_step);
+#endif
 
   void End_Matlab_LU_UMFPack();
 #ifdef CUDA
@@ -159,16 +235,59 @@ private:
 #endif
   void Solve_Matlab_GMRES(mxArray *A_m, mxArray *b_m, int Size, double slowc, int block, bool is_two_boundaries, int it_, mxArray *x0_m);
   void Solve_Matlab_BiCGStab(mxArray *A_m, mxArray *b_m, int Size, double slowc, int block, bool is_two_boundaries, int it_, mxArray *x0_m, int precond);
+  //! Returns the preconditioner kept for the block, if A_m has the same size and number of nonzero elements
+  bool Get_Cached_ILU(int block, mxArray *A_m, mxArray **L1, mxArray **U1);
+  //! Keeps the preconditioner of the block if it has been successfully used, and frees it otherwise
+  void Release_ILU(int block, mxArray *A_m, mxArray *L1, mxArray *U1, bool cached, bool success);
   void Check_and_Correct_Previous_Iteration(int block_num, int y_size, int size, double crit_opt_old);
   bool Simulate_One_Boundary(int blck, int y_size, int y_kmin, int y_kmax, int Size, bool cvg);
   bool solve_linear(const int block_num, const int y_size, const int y_kmin, const int y_kmax, const int size, const int iter);
   void solve_non_linear(const int block_num, const int y_size, const int y_kmin, const int y_kmax, const int size);
+  //! Solves a one boundary block in steady state with Powell's dogleg trust-region method (solve_algo=9)
+  void solve_trust_region(const int block_num, const int y_size, const int size);
+  //! Fills the compressed column Jacobian of a one boundary block in steady state from u
+  void Fill_Jacobian_CSC(int Size, map<pair<pair<int, int>, int>, int> &IM, SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax);
+  //! Computes res = B v (or B' v if transpose), B being the factorized Jacobian plus its Broyden updates
+  void Broyden_product(int n, const SuiteSparse_long *Ap, const SuiteSparse_long *Ai, const double *Ax, const double *v, double *res, bool transpose);
+  //! Solves B res = v with the factorized Jacobian and the Sherman-Morrison formula for the Broyden updates
+  void Broyden_solve(int n, SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax, double *v, double *res, double *Control, double *Info);
+  //! Adds the Broyden update of B for the step s and the change of the residuals df, returns false if B+update is singular
+  bool Broyden_update(int n, SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax, const double *s, const double *df, double *Control, double *Info);
   string preconditioner_print_out(string s, int preconditioner, bool ss);
-  bool compare(int *save_op, int *save_opa, int *save_opaa, int beg_t, int periods, long int nop4,  int Size
+  bool compare(int *save_op, int *save_opa, int *save_opaa, int beg_t, int periods, long int nop4,  int Size, int Block_number
 #ifdef PROFILER
                , long int *ndiv, long int *nsub
 #endif
                );
+  //! Eliminates the periods after beg_t with the program compiled for the block in a previous iteration or call, if the operations recorded in period beg_t are its own
+  bool replay_cached_elimination(int *save_op, int beg_t, int periods, long int nop4, int Size, int Block_number);
+  //! Eliminates the periods after beg_t with prog, shifted by shift periods
+  void replay_elimination(const t_compiled_elimination &prog, int shift, int beg_t, int periods, int Size);
+  //! Elimination programs compiled by the current process, indexed by file name and block
+  /*! They outlive the dynSparseMatrix object, so that the Newton iterations and the calls after the
+    first one only eliminate the periods until the pattern is recognized */
+  static inline map<pair<string, int>, t_compiled_elimination> &
+  elimination_cache()
+  {
+    static map<pair<string, int>, t_compiled_elimination> cache;
+    return cache;
+  };
+  //! Solves the stacked system of a two boundaries block with the given stack_solve_algo
+  void Solve_Stacked_System(int stack_solve_algo, int blck, int periods, int y_kmin, int y_kmax, int Size, int preconditioner, const vector_table_conditional_local_type &vector_table_conditional_local);
+  //! Same as Solve_Stacked_System(), returns false if the solver fails or gives a non finite direction
+  bool Try_Stacked_System(int algo, int blck, int periods, int y_kmin, int y_kmax, int Size, int preconditioner, const vector_table_conditional_local_type &vector_table_conditional_local);
+  //! Tries all the candidate solvers on the stacked system, ranks them by solving time and keeps the result of the fastest one
+  void Select_Stack_Solve_Algo(int blck, int periods, int y_kmin, int y_kmax, int Size, int preconditioner, const vector_table_conditional_local_type &vector_table_conditional_local);
+  //! Solves the stacked system with the fastest solver of the ranking, falling back on the next ones if it fails
+  void Solve_Stacked_System_Auto(int blck, int periods, int y_kmin, int y_kmax, int Size, int preconditioner, const vector_table_conditional_local_type &vector_table_conditional_local);
+  //! Solvers of the stacked system ranked by Select_Stack_Solve_Algo(), indexed by file name and block
+  /*! They outlive the dynSparseMatrix object, so that the selection is done once per block and session */
+  static inline map<pair<string, int>, vector<int> > &
+  stack_solve_algo_ranking()
+  {
+    static map<pair<string, int>, vector<int> > ranking;
+    return ranking;
+  };
   void Grad_f_product(int n, mxArray *b_m, double *vectr, mxArray *A_m, SuiteSparse_long *Ap, SuiteSparse_long *Ai, double *Ax, double *b);
   void Insert(const int r, const int c, const int u_index, const int lag_index);
   void Delete(const int r, const int c);
@@ -185,6 +304,17 @@ private:
   void Clear_u();
   void Print_u();
   void *Symbolic, *Numeric;
+  //! Sparsity pattern of the matrix analyzed in Symbolic
+  vector<SuiteSparse_long> Symbolic_Ap, Symbolic_Ai;
+#ifdef HAVE_KLU
+  //! KLU counterparts of Symbolic and Numeric
+  klu_l_common KLU_Common;
+  klu_l_symbolic *KLU_Symbolic;
+  klu_l_numeric *KLU_Numeric;
+#endif
+  //! Number of iterations for which Numeric has been reused, and absolute error when it was last used
+  int numeric_reuse_count;
+  double numeric_res1;
   void CheckIt(int y_size, int y_kmin, int y_kmax, int Size, int periods);
   void Check_the_Solution(int periods, int y_kmin, int y_kmax, int Size, double *u, int *pivot, int *b);
   int complete(int beg_t, int Size, int periods, int *b);
@@ -202,6 +332,10 @@ private:
   mxArray *Sparse_substract_A_SB(mxArray *A_m, mxArray *B_m);
   mxArray *substract_A_B(mxArray *A_m, mxArray *B_m);
 #ifdef CUDA
+  //! Matrix structure and vectors kept on the graphic card between the iterations, and host copy of the structure
+  int *CUDA_Ap, *CUDA_Ai, *CUDA_Host_Ap, *CUDA_Host_Ai;
+  double *CUDA_Ax, *CUDA_b, *CUDA_x0;
+  int CUDA_n, CUDA_nnz;
   int CUDA_device;
   cublasHandle_t cublas_handle;
   cusparseHandle_t cusparse_handle;
@@ -214,6 +348,10 @@ protected:
   int middle_count_loop;
   //char type;
   fstream SaveCode;
+  //! Sparsity structures kept if keep_sparse_structures is set, by block
+  map<int, t_sparse_structure> sparse_structures;
+  //! Position in SaveCode of the structure of the next block
+  streampos sparse_read_pos;
   string filename;
   int max_u, min_u;
   clock_t time00;
@@ -252,6 +390,16 @@ protected:
   int restart;
   double g_lambda1, g_lambda2, gp_0;
   double lu_inc_tol;
+  map<int, t_ilu_s> ilu_cache;
+  /*! Compressed column pattern of the stacked Jacobian of the current two boundaries block,
+    and position in u of each nonzero element */
+  vector<SuiteSparse_long> csc_Ap, csc_Ai;
+  vector<int> csc_u;
+  /*! Contributions to the right hand side: b[csc_b_row[k]] += u[csc_b_u[k]]*y[csc_b_y[k]],
+    or b[csc_b_row[k]] += u[csc_b_u[k]] if csc_b_y[k] < 0 */
+  vector<int> csc_b_row, csc_b_u, csc_b_y;
+  //! Number of periods and size of the block for which the pattern has been computed, 0 if there is none
+  int csc_periods, csc_Size;
   //private:
   SuiteSparse_long *Ap_save, *Ai_save;
   double *Ax_save, *b_save;
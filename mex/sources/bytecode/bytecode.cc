@@ -255,6 +255,56 @@ deblank(string x)
   return x;
 }
 
+string
+cell_string(const mxArray *cell)
+{
+  vector<char> buf(mxGetNumberOfElements(cell)+1);
+  mxGetString(cell, &buf[0], buf.size());
+  return string(&buf[0]);
+}
+
+/* Reads the complementarity conditions of the equations tagged mcp in
+   M_.equations_tags, which are of the form 'x > lower bound' or 'x < upper
+   bound' (as in get_complementarity_conditions.m) */
+void
+Get_Complementarity_Conditions(const mxArray *M_, map<int, t_complementarity> &complementarity_conditions)
+{
+  const mxArray *tags = mxGetField(M_, 0, "equations_tags");
+  const mxArray *names = mxGetField(M_, 0, "endo_names");
+  if (tags == NULL || names == NULL || !mxIsCell(tags))
+    return;
+  size_t nb_tags = mxGetM(tags), nb_endo = mxGetM(names), name_length = mxGetN(names);
+  const char *P_names = (const char *) mxGetPr(names);
+  for (size_t i = 0; i < nb_tags; i++)
+    {
+      if (cell_string(mxGetCell(tags, i+nb_tags)) != "mcp")
+        continue;
+      string condition = cell_string(mxGetCell(tags, i+2*nb_tags));
+      size_t pos = condition.find_first_of("<>");
+      if (pos == string::npos)
+        throw FatalExceptionHandling(" in main, the complementarity condition " + condition + " cannot be parsed\n");
+      string name = deblank(condition.substr(0, pos));
+      t_complementarity c;
+      c.upper = condition[pos] == '<';
+      if (pos+1 < condition.length() && condition[pos+1] == '=')
+        pos++;
+      c.bound = atof(condition.substr(pos+1).c_str());
+      c.variable = -1;
+      for (size_t j = 0; j < nb_endo && c.variable < 0; j++)
+        {
+          string endo_name;
+          for (size_t k = 0; k < name_length; k++)
+            if (P_names[CHAR_LENGTH*(j+k*nb_endo)] != ' ')
+              endo_name += P_names[CHAR_LENGTH*(j+k*nb_endo)];
+          if (endo_name == name)
+            c.variable = j;
+        }
+      if (c.variable < 0)
+        throw FatalExceptionHandling(" in main, the variable " + name + " of the complementarity condition " + condition + " is not recognized\n");
+      complementarity_conditions[int (*mxGetPr(mxGetCell(tags, i)))-1] = c;
+    }
+}
+
 void
 Get_Arguments_and_global_variables(int nrhs,
 #ifndef DEBUG_EX
@@ -265,7 +315,7 @@ Get_Arguments_and_global_variables(int nrhs,
                                    int &count_array_argument,
                                    double *yd[], size_t &row_y, size_t &col_y,
                                    double *xd[], size_t &row_x, size_t &col_x,
-                                   double *params[],
+                                   double *params[], size_t &row_params, size_t &col_params,
                                    double *steady_yd[], size_t &steady_row_y, size_t &steady_col_y,
                                    unsigned int &periods,
 #ifndef DEBUG_EX
@@ -275,6 +325,7 @@ Get_Arguments_and_global_variables(int nrhs,
                                    mxArray *M_[], mxArray *oo_[], mxArray *options_[], bool &global_temporary_terms,
                                    bool &print,
                                    bool &print_error,
+                                   bool &profile,
                                    mxArray *GlobalTemporaryTerms[],
                                    string *plan_struct_name, string *pfplan_struct_name, bool *extended_path, mxArray *ep_struct[])
 {
@@ -303,6 +354,8 @@ Get_Arguments_and_global_variables(int nrhs,
                 break;
               case 2:
                 *params = mxGetPr(prhs[i]);
+                row_params = mxGetM(prhs[i]);
+                col_params = mxGetN(prhs[i]);
                 break;
               case 3:
                 *steady_yd = mxGetPr(prhs[i]);
@@ -339,6 +392,8 @@ Get_Arguments_and_global_variables(int nrhs,
             print = true;
           else if (Get_Argument(prhs[i]) == "no_print_error")
             print_error = false;
+          else if (Get_Argument(prhs[i]) == "profile")
+            profile = true;
           else
             {
               pos = 0;
@@ -399,7 +454,9 @@ Get_Arguments_and_global_variables(int nrhs,
           throw FatalExceptionHandling(tmp.str());
         }
     }
-  *M_ = mexGetVariable("global", "M_");
+  /* The global structures are only read: they are accessed in place rather than
+     copied, which would otherwise be done on each call of the MEX */
+  *M_ = const_cast<mxArray *>(mexGetVariablePtr("global", "M_"));
   if (*M_ == NULL)
     {
       ostringstream tmp;
@@ -407,14 +464,14 @@ Get_Arguments_and_global_variables(int nrhs,
       throw FatalExceptionHandling(tmp.str());
     }
   /* Gets variables and parameters from global workspace of Matlab */
-  *oo_ = mexGetVariable("global", "oo_");
+  *oo_ = const_cast<mxArray *>(mexGetVariablePtr("global", "oo_"));
   if (*oo_ == NULL)
     {
       ostringstream tmp;
       tmp << " in main, global variable not found: oo_\n";
       throw FatalExceptionHandling(tmp.str());
     }
-  *options_ = mexGetVariable("global", "options_");
+  *options_ = const_cast<mxArray *>(mexGetVariablePtr("global", "options_"));
   if (*options_ == NULL)
     {
       ostringstream tmp;
@@ -432,6 +489,13 @@ main(int nrhs, const char *prhs[])
   mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 #endif
 {
+#ifndef DEBUG_EX
+  if (Instrumentation::mexCommand("bytecode", nlhs, plhs, nrhs, prhs)
+      || SharedCache::mexCommand(nlhs, plhs, nrhs, prhs))
+    return;
+#endif
+  INSTRUMENT_SCOPE("bytecode");
+
   mxArray *M_, *oo_, *options_;
   mxArray *GlobalTemporaryTerms;
 #ifndef DEBUG_EX
@@ -443,7 +507,7 @@ main(int nrhs, const char *prhs[])
 #endif
   mxArray *pfplan_struct = NULL;
   ErrorMsg error_msg;
-  size_t i, row_y = 0, col_y = 0, row_x = 0, col_x = 0, nb_row_xd = 0;
+  size_t i, row_y = 0, col_y = 0, row_x = 0, col_x = 0, nb_row_xd = 0, row_params = 0, col_params = 0;
   size_t steady_row_y, steady_col_y;
   int y_kmin = 0, y_kmax = 0, y_decal = 0;
   unsigned int periods = 1;
@@ -455,7 +519,7 @@ main(int nrhs, const char *prhs[])
   double *yd = NULL, *xd = NULL;
   int count_array_argument = 0;
   bool global_temporary_terms = false;
-  bool print = false, print_error = true, print_it = false;
+  bool print = false, print_error = true, print_it = false, profile = false;
   double *steady_yd = NULL, *steady_xd = NULL;
   string plan, pfplan;
   bool extended_path;
@@ -467,6 +531,10 @@ main(int nrhs, const char *prhs[])
   table_conditional_global_type table_conditional_global;
 
   int max_periods = 0;
+  int nb_scenarios = 0;
+  double *shock_scenarios = NULL, *scenario_y = NULL, *scenario_x = NULL;
+  int nb_points = 0;
+  double *params_grid = NULL, *sweep_y = NULL, *sweep_info = NULL;
 
 #ifdef CUDA
   int CUDA_device = -1;
@@ -479,7 +547,7 @@ main(int nrhs, const char *prhs[])
       Get_Arguments_and_global_variables(nrhs, prhs, count_array_argument,
                                          &yd, row_y, col_y,
                                          &xd, row_x, col_x,
-                                         &params,
+                                         &params, row_params, col_params,
                                          &steady_yd, steady_row_y, steady_col_y,
                                          periods,
 #ifndef DEBUG_EX
@@ -487,7 +555,7 @@ main(int nrhs, const char *prhs[])
 #endif
                                          steady_state, evaluate, block,
                                          &M_, &oo_, &options_, global_temporary_terms,
-                                         print, print_error, &GlobalTemporaryTerms,
+                                         print, print_error, profile, &GlobalTemporaryTerms,
                                          &plan, &pfplan, &extended_path, &extended_path_struct);
     }
   catch (GeneralExceptionHandling &feh)
@@ -499,7 +567,25 @@ main(int nrhs, const char *prhs[])
       int field = mxGetFieldNumber(M_, "params");
       if (field < 0)
         DYN_MEX_FUNC_ERR_MSG_TXT("params is not a field of M_");
-      params = mxGetPr(mxGetFieldByNumber(M_, 0, field));
+      /* The parameters can be modified by the model: work on a copy, since M_ is
+         accessed in place */
+      mxArray *params_arr = mxGetFieldByNumber(M_, 0, field);
+      size_t nb_params = mxGetM(params_arr)*mxGetN(params_arr);
+      params = (double *) mxMalloc(nb_params*sizeof(double));
+      error_msg.test_mxMalloc(params, __LINE__, __FILE__, __func__, nb_params*sizeof(double));
+      memcpy(params, mxGetPr(params_arr), nb_params*sizeof(double));
+    }
+  else if (row_params > 1 && col_params > 1)
+    {
+      /* A matrix of parameters holds one set of parameters by column: the steady
+         state is computed for each of them */
+      if (!steady_state || evaluate || block >= 0 || extended_path)
+        DYN_MEX_FUNC_ERR_MSG_TXT("a matrix of parameters can only be used to compute the steady state of the whole model");
+      nb_points = col_params;
+      params_grid = params;
+      params = (double *) mxMalloc(row_params*sizeof(double));
+      error_msg.test_mxMalloc(params, __LINE__, __FILE__, __func__, row_params*sizeof(double));
+      memcpy(params, params_grid, row_params*sizeof(double));
     }
 
   ErrorMsg emsg;
@@ -694,6 +780,21 @@ main(int nrhs, const char *prhs[])
                 max_periods = int (specific_shock_int_date_[j]);
             }
         }
+      /* Optional set of scenarios for the shocks (periods × shocks × scenarios):
+         the extended path is computed for each of them, replacing the values of shock_paths_ */
+      mxArray *shock_scenarios_ = mxGetField(extended_path_struct, 0, "shock_scenarios_");
+      if (shock_scenarios_ != NULL)
+        {
+          const mwSize *dims = mxGetDimensions(shock_scenarios_);
+          mwSize nb_dims = mxGetNumberOfDimensions(shock_scenarios_);
+          if (nb_dims > 3 || dims[0] != (mwSize) nb_periods || dims[1] != (mwSize) nb_shocks)
+            DYN_MEX_FUNC_ERR_MSG_TXT("shock_scenarios_ should be an array of size (number of periods) × (number of shocks) × (number of scenarios)");
+          if (block >= 0 || evaluate)
+            DYN_MEX_FUNC_ERR_MSG_TXT("shock_scenarios_ cannot be used with the block and evaluate options");
+          nb_scenarios = nb_dims == 3 ? dims[2] : 1;
+          shock_scenarios = mxGetPr(shock_scenarios_);
+          max_periods = nb_periods;
+        }
       for (int i = 0; i < nb_periods; i++)
         {
           int buflen = mxGetNumberOfElements(mxGetCell(date_str, i)) + 1;
@@ -974,6 +1075,31 @@ main(int nrhs, const char *prhs[])
         DYN_MEX_FUNC_ERR_MSG_TXT("maxit is not a field of options_.steady");
     }
   int maxit_ = int (floor(*(mxGetPr(mxGetFieldByNumber(temporaryfield, 0, field)))));
+  int simplified_newton = 0;
+  sparse_backend_type sparse_backend = UMFPACK_backend;
+  if (!steady_state)
+    {
+      field = mxGetFieldNumber(temporaryfield, "simplified_newton");
+      if (field >= 0)
+        simplified_newton = int (floor(*(mxGetPr(mxGetFieldByNumber(temporaryfield, 0, field)))));
+      field = mxGetFieldNumber(temporaryfield, "sparse_backend");
+      if (field >= 0 && mxIsChar(mxGetFieldByNumber(temporaryfield, 0, field)))
+        {
+          char *backend = mxArrayToString(mxGetFieldByNumber(temporaryfield, 0, field));
+          string backend_name(backend);
+          mxFree(backend);
+          if (backend_name == "klu")
+            {
+#ifdef HAVE_KLU
+              sparse_backend = KLU_backend;
+#else
+              DYN_MEX_FUNC_ERR_MSG_TXT("bytecode has been compiled without KLU, sparse_backend=klu is not available");
+#endif
+            }
+          else if (backend_name != "umfpack")
+            DYN_MEX_FUNC_ERR_MSG_TXT(("unknown sparse_backend: " + backend_name).c_str());
+        }
+    }
   field = mxGetFieldNumber(options_, "slowc");
   if (field < 0)
     DYN_MEX_FUNC_ERR_MSG_TXT("slows is not a field of options_");
@@ -1081,6 +1207,32 @@ main(int nrhs, const char *prhs[])
                          , CUDA_device, cublas_handle, cusparse_handle, descr
 #endif
                          );
+  interprete.simplified_newton = simplified_newton;
+  interprete.sparse_backend = sparse_backend;
+  field = mxGetFieldNumber(options_, "threads");
+  if (field >= 0)
+    {
+      mxArray *threads = mxGetFieldByNumber(options_, 0, field);
+      int field_bytecode = mxGetFieldNumber(threads, "bytecode");
+      if (field_bytecode >= 0)
+        interprete.period_threads = max(1, int (floor(*(mxGetPr(mxGetFieldByNumber(threads, 0, field_bytecode))))));
+    }
+  // The counters of the blocks are also collected when instrumentation is on
+  interprete.profile = profile || Instrumentation::instance().enabled;
+  if (extended_path)
+    {
+      field = mxGetFieldNumber(options_, "ep");
+      if (field >= 0)
+        {
+          mxArray *ep = mxGetFieldByNumber(options_, 0, field);
+          int field_warm_start = mxGetFieldNumber(ep, "warm_start");
+          if (field_warm_start >= 0)
+            interprete.warm_start = *mxGetPr(mxGetFieldByNumber(ep, 0, field_warm_start));
+          int field_complementarity = mxGetFieldNumber(ep, "complementarity");
+          if (field_complementarity >= 0 && *mxGetPr(mxGetFieldByNumber(ep, 0, field_complementarity)))
+            Get_Complementarity_Conditions(M_, interprete.complementarity_conditions);
+        }
+    }
   string f(fname);
   mxFree(fname);
   int nb_blocks = 0;
@@ -1091,7 +1243,47 @@ main(int nrhs, const char *prhs[])
     {
       try
         {
-          interprete.extended_path(f, f, evaluate, block, nb_blocks, max_periods, sextended_path, sconditional_extended_path, dates, table_conditional_global);
+          INSTRUMENT_SCOPE("extended_path");
+          if (nb_scenarios)
+            {
+              size_t out_y_size = row_y*(max_periods+y_kmin), out_x_size = row_x*col_x;
+              scenario_y = (double *) mxMalloc(out_y_size*nb_scenarios*sizeof(double));
+              error_msg.test_mxMalloc(scenario_y, __LINE__, __FILE__, __func__, out_y_size*nb_scenarios*sizeof(double));
+              scenario_x = (double *) mxMalloc(out_x_size*nb_scenarios*sizeof(double));
+              error_msg.test_mxMalloc(scenario_x, __LINE__, __FILE__, __func__, out_x_size*nb_scenarios*sizeof(double));
+              int nb_periods = dates.size();
+              for (int s = 0; s < nb_scenarios; s++)
+                {
+                  // Each scenario starts from the initial paths
+                  memcpy(y, yd, row_y*col_y*sizeof(double));
+                  memcpy(ya, yd, row_y*col_y*sizeof(double));
+                  memcpy(x, xd, row_x*col_x*sizeof(double));
+                  for (unsigned int k = 0; k < sextended_path.size(); k++)
+                    for (int j = 0; j < nb_periods; j++)
+                      sextended_path[k].value[j] = shock_scenarios[j + nb_periods*(k + sextended_path.size()*s)];
+                  interprete.extended_path(f, f, evaluate, block, nb_blocks, max_periods, sextended_path, sconditional_extended_path, dates, table_conditional_global);
+                  memcpy(scenario_y + s*out_y_size, y, out_y_size*sizeof(double));
+                  memcpy(scenario_x + s*out_x_size, x, out_x_size*sizeof(double));
+                }
+            }
+          else
+            interprete.extended_path(f, f, evaluate, block, nb_blocks, max_periods, sextended_path, sconditional_extended_path, dates, table_conditional_global);
+        }
+      catch (GeneralExceptionHandling &feh)
+        {
+          DYN_MEX_FUNC_ERR_MSG_TXT(feh.GetErrorMsg().c_str());
+        }
+    }
+  else if (nb_points)
+    {
+      sweep_y = (double *) mxMalloc(row_y*nb_points*sizeof(double));
+      error_msg.test_mxMalloc(sweep_y, __LINE__, __FILE__, __func__, row_y*nb_points*sizeof(double));
+      sweep_info = (double *) mxMalloc(nb_points*sizeof(double));
+      error_msg.test_mxMalloc(sweep_info, __LINE__, __FILE__, __func__, nb_points*sizeof(double));
+      try
+        {
+          INSTRUMENT_SCOPE("steady_state_sweep");
+          interprete.steady_state_sweep(f, f, row_params, params_grid, nb_points, sweep_y, sweep_info);
         }
       catch (GeneralExceptionHandling &feh)
         {
@@ -1102,6 +1294,7 @@ main(int nrhs, const char *prhs[])
     {
       try
         {
+          INSTRUMENT_SCOPE("compute_blocks");
           interprete.compute_blocks(f, f, evaluate, block, nb_blocks);
         }
       catch (GeneralExceptionHandling &feh)
@@ -1118,16 +1311,29 @@ main(int nrhs, const char *prhs[])
   clock_t t1 = clock();
   if (!steady_state && !evaluate && no_error && print)
     mexPrintf("Simulation Time=%f milliseconds\n", 1000.0*(double (t1)-double (t0))/double (CLOCKS_PER_SEC));
+  if (profile)
+    interprete.print_profile();
+  if (Instrumentation::instance().enabled)
+    interprete.report_profile();
 #ifndef DEBUG_EX
   bool dont_store_a_structure = false;
   if (nlhs > 0)
     {
-      plhs[0] = mxCreateDoubleMatrix(1, 1, mxREAL);
-      pind = mxGetPr(plhs[0]);
-      if (no_error)
-        pind[0] = 0;
+      if (nb_points)
+        {
+          // One convergence flag by set of parameters
+          plhs[0] = mxCreateDoubleMatrix(1, nb_points, mxREAL);
+          memcpy(mxGetPr(plhs[0]), sweep_info, nb_points*sizeof(double));
+        }
       else
-        pind[0] = 1;
+        {
+          plhs[0] = mxCreateDoubleMatrix(1, 1, mxREAL);
+          pind = mxGetPr(plhs[0]);
+          if (no_error)
+            pind[0] = 0;
+          else
+            pind[0] = 1;
+        }
       if (nlhs > 1)
         {
           if (block >= 0)
@@ -1158,11 +1364,23 @@ main(int nrhs, const char *prhs[])
               int out_periods;
               if (extended_path)
                 out_periods = max_periods + y_kmin;
+              else if (nb_points)
+                out_periods = nb_points;
               else
                 out_periods = col_y;
-              plhs[1] = mxCreateDoubleMatrix(int (row_y), out_periods, mxREAL);
+              if (nb_scenarios)
+                {
+                  mwSize dims[3] = {(mwSize) row_y, (mwSize) out_periods, (mwSize) nb_scenarios };
+                  plhs[1] = mxCreateNumericArray(3, dims, mxDOUBLE_CLASS, mxREAL);
+                }
+              else
+                plhs[1] = mxCreateDoubleMatrix(int (row_y), out_periods, mxREAL);
               pind = mxGetPr(plhs[1]);
-              if (evaluate)
+              if (nb_scenarios)
+                memcpy(pind, scenario_y, row_y*out_periods*nb_scenarios*sizeof(double));
+              else if (nb_points)
+                memcpy(pind, sweep_y, row_y*nb_points*sizeof(double));
+              else if (evaluate)
                 {
                   vector<double> residual = interprete.get_residual();
                   for (i = 0; i < residual.size(); i++)
@@ -1223,6 +1441,12 @@ main(int nrhs, const char *prhs[])
                         }
                     }
                 }
+              else if (nb_scenarios)
+                {
+                  mwSize dims[3] = {(mwSize) row_x, (mwSize) col_x, (mwSize) nb_scenarios };
+                  plhs[2] = mxCreateNumericArray(3, dims, mxDOUBLE_CLASS, mxREAL);
+                  memcpy(mxGetPr(plhs[2]), scenario_x, row_x*col_x*nb_scenarios*sizeof(double));
+                }
               else
                 {
                   plhs[2] = mxCreateDoubleMatrix(int (row_x), int (col_x), mxREAL);
@@ -1265,6 +1489,18 @@ main(int nrhs, const char *prhs[])
     mxFree(ya);
   if (direction)
     mxFree(direction);
+  if (scenario_y)
+    mxFree(scenario_y);
+  if (scenario_x)
+    mxFree(scenario_x);
+  if (sweep_y)
+    mxFree(sweep_y);
+  if (sweep_info)
+    mxFree(sweep_info);
+  if (params_grid)
+    mxFree(params);
+  if (!count_array_argument && params)
+    mxFree(params);
 #ifdef _MSC_VER_
   /*fFreeResult =*/ FreeLibrary(hinstLib);
 #endif
@@ -220,6 +220,14 @@ mexGetVariable(const char *space_name, const char *matrix_name)
   return mxglobal[matrix_name];
 }
 
+const mxArray *
+mexGetVariablePtr(const char *space_name, const char *matrix_name)
+{
+  if (strncmp(space_name, "global", 6) != 0)
+    mexErrMsgTxt("space_name not handle in mexGetVariablePtr\n");
+  return mxglobal[matrix_name];
+}
+
 int
 mxGetFieldNumber(const mxArray *Struct, const char *field_name)
 {
@@ -148,6 +148,7 @@ mxArray *read_struct(FILE *fid);
 mxArray *read_Array(FILE *fid);
 mxArray *read_double_array(FILE *fid);
 mxArray *mexGetVariable(const char *space_name, const char *matrix_name);
+const mxArray *mexGetVariablePtr(const char *space_name, const char *matrix_name);
 int mxGetFieldNumber(const mxArray *Struct, const char *field_name);
 mxArray *mxGetFieldByNumber(mxArray *Struct, unsigned int pos, unsigned int field_number);
 void mxSetFieldByNumber(mxArray *Struct, mwIndex index, unsigned int field_number, mxArray *pvalue);
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * [decomp, variance] = fast_conditional_variance_decomposition(T, B, Steps, rows, number_of_threads)
+ *
+ * Computes the conditional variance decomposition of the state space model
+ * x(t) = T*x(t-1) + B*e(t), var(e(t)) = I, for one or several draws of the
+ * parameters, with libmat's ConditionalVarianceDecomposition (the algorithm
+ * of conditional_variance_decomposition.m).
+ *
+ * T is n*n*ndraws and B n*nshocks*ndraws (B is the impulse matrix times the
+ * Cholesky factor of the covariance matrix of the shocks). Steps are the
+ * horizons, and rows the (1-based) rows of x(t) to be decomposed.
+ *
+ * decomp is nrows*nsteps*nshocks*ndraws, decomp(r,s,k,d) being the share of
+ * shock k in the conditional variance of x(rows(r)) at horizon Steps(s) for
+ * draw d, and variance gives the conditional variances with the same layout.
+ *
+ * The draws are processed in parallel if compiled with OpenMP.
+ */
+
+#include <vector>
+
+#include <dynmex.h>
+
+#include "ConditionalVarianceDecomposition.hh"
+
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
+void
+mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+  if (nrhs != 5)
+    DYN_MEX_FUNC_ERR_MSG_TXT("fast_conditional_variance_decomposition: exactly five input arguments are required.");
+  if (nlhs > 2)
+    DYN_MEX_FUNC_ERR_MSG_TXT("fast_conditional_variance_decomposition: at most two output arguments are returned.");
+
+  for (int i = 0; i < 2; i++)
+    if (!mxIsDouble(prhs[i]) || mxIsComplex(prhs[i]) || mxIsSparse(prhs[i]))
+      DYN_MEX_FUNC_ERR_MSG_TXT("fast_conditional_variance_decomposition: T and B must be real dense arrays.");
+
+  const size_t n = mxGetM(prhs[0]);
+  const mwSize *dims_B = mxGetDimensions(prhs[1]);
+  const size_t nshocks = mxGetNumberOfDimensions(prhs[1]) > 1 ? dims_B[1] : 1;
+  const size_t ndraws = n > 0 ? mxGetNumberOfElements(prhs[0])/(n*n) : 0;
+  if (mxGetNumberOfElements(prhs[0]) != n*n*ndraws)
+    DYN_MEX_FUNC_ERR_MSG_TXT("fast_conditional_variance_decomposition: T must be an n*n*ndraws array.");
+  if (mxGetM(prhs[1]) != n || mxGetNumberOfElements(prhs[1]) != n*nshocks*ndraws)
+    DYN_MEX_FUNC_ERR_MSG_TXT("fast_conditional_variance_decomposition: B must be an n*nshocks*ndraws array.");
+
+  const size_t nsteps = mxGetNumberOfElements(prhs[2]);
+  const double *steps_d = mxGetPr(prhs[2]);
+  std::vector<size_t> steps(nsteps);
+  for (size_t s = 0; s < nsteps; s++)
+    {
+      if (steps_d[s] < 1)
+        DYN_MEX_FUNC_ERR_MSG_TXT("fast_conditional_variance_decomposition: all periods must be strictly positive.");
+      steps[s] = static_cast<size_t>(steps_d[s]);
+    }
+
+  const size_t nrows = mxGetNumberOfElements(prhs[3]);
+  const double *rows_d = mxGetPr(prhs[3]);
+  std::vector<size_t> rows(nrows);
+  for (size_t r = 0; r < nrows; r++)
+    {
+      if (rows_d[r] < 1 || rows_d[r] > n)
+        DYN_MEX_FUNC_ERR_MSG_TXT("fast_conditional_variance_decomposition: the rows must be between 1 and the number of states.");
+      rows[r] = static_cast<size_t>(rows_d[r]) - 1;
+    }
+
+  int number_of_threads = static_cast<int>(mxGetScalar(prhs[4]));
+  if (number_of_threads < 1)
+    number_of_threads = 1;
+
+  mwSize dims[4] = { (mwSize) nrows, (mwSize) nsteps, (mwSize) nshocks, (mwSize) ndraws };
+  plhs[0] = mxCreateNumericArray(4, dims, mxDOUBLE_CLASS, mxREAL);
+  double *decomp = mxGetPr(plhs[0]);
+  double *variance = NULL;
+  if (nlhs > 1)
+    {
+      plhs[1] = mxCreateNumericArray(4, dims, mxDOUBLE_CLASS, mxREAL);
+      variance = mxGetPr(plhs[1]);
+    }
+
+  const double *T = mxGetPr(prhs[0]);
+  const double *B = mxGetPr(prhs[1]);
+  const size_t out_size = nrows*nsteps*nshocks;
+
+#ifdef USE_OMP
+# pragma omp parallel num_threads(number_of_threads)
+#endif
+  {
+    ConditionalVarianceDecomposition CVD(n, nshocks, steps, rows);
+
+#ifdef USE_OMP
+# pragma omp for schedule(dynamic)
+#endif
+    for (int d = 0; d < static_cast<int>(ndraws); d++)
+      {
+        MatrixConstView Td(T + d*n*n, n, n, n), Bd(B + d*n*nshocks, n, nshocks, n);
+        MatrixView decomp_d(decomp + d*out_size, nrows, nsteps*nshocks, nrows);
+        if (variance != NULL)
+          {
+            MatrixView variance_d(variance + d*out_size, nrows, nsteps*nshocks, nrows);
+            CVD.compute(Td, Bd, decomp_d, &variance_d);
+          }
+        else
+          CVD.compute(Td, Bd, decomp_d);
+      }
+  }
+}
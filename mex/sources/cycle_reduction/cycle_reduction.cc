@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * MEX version of matlab/cycle_reduction/cycle_reduction.m:
+ *
+ *   [X, info] = cycle_reduction(A0, A1, A2, cvg_tol[, ch])
+ *
+ * solves A0 + A1*X + A2*X*X = 0. info is 0 on success, and [3 log(norm(A1,1))]
+ * or [4 log(norm(A2,1))] if the algorithm failed, in which case X is empty.
+ * If ch is given and not empty, the residual of the solution is checked.
+ *
+ * The workspace is kept between calls, and only reallocated when the size of
+ * the problem or the tolerance change.
+ */
+
+#include <cmath>
+
+#include <dynmex.h>
+
+#include "CycleReduction.hh"
+
+static CycleReduction *cr = NULL;
+static size_t cr_n = 0;
+static double cr_tol = 0.0;
+
+static void
+freeWorkspace()
+{
+  delete cr;
+  cr = NULL;
+}
+
+void
+mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+  if (nrhs != 4 && nrhs != 5)
+    DYN_MEX_FUNC_ERR_MSG_TXT("cycle_reduction: four or five input arguments are required.");
+  if (nlhs > 2)
+    DYN_MEX_FUNC_ERR_MSG_TXT("cycle_reduction: at most two output arguments are allowed.");
+
+  const size_t n = mxGetM(prhs[0]);
+  for (int i = 0; i < 3; i++)
+    if (!mxIsDouble(prhs[i]) || mxIsComplex(prhs[i]) || mxIsSparse(prhs[i])
+        || mxGetM(prhs[i]) != n || mxGetN(prhs[i]) != n)
+      DYN_MEX_FUNC_ERR_MSG_TXT("cycle_reduction: A0, A1 and A2 must be real dense square matrices of the same size.");
+  if (!mxIsDouble(prhs[3]) || mxGetNumberOfElements(prhs[3]) != 1)
+    DYN_MEX_FUNC_ERR_MSG_TXT("cycle_reduction: cvg_tol must be a scalar.");
+  const double tol = *mxGetPr(prhs[3]);
+  const bool check = nrhs == 5 && !mxIsEmpty(prhs[4]);
+
+  MatrixConstView A0(mxGetPr(prhs[0]), n, n, n), A1(mxGetPr(prhs[1]), n, n, n), A2(mxGetPr(prhs[2]), n, n, n);
+
+  if (cr == NULL || cr_n != n || cr_tol != tol)
+    {
+      if (cr == NULL)
+        mexAtExit(freeWorkspace);
+      delete cr;
+      cr = new CycleReduction(n, tol);
+      cr_n = n;
+      cr_tol = tol;
+    }
+
+  plhs[0] = mxCreateDoubleMatrix(n, n, mxREAL);
+  MatrixView X(mxGetPr(plhs[0]), n, n, n);
+  try
+    {
+      cr->compute(A0, A1, A2, X);
+    }
+  catch (CycleReduction::CRException &e)
+    {
+      mxDestroyArray(plhs[0]);
+      plhs[0] = mxCreateDoubleMatrix(0, 0, mxREAL);
+      if (nlhs > 1)
+        {
+          plhs[1] = mxCreateDoubleMatrix(1, 2, mxREAL);
+          mxGetPr(plhs[1])[0] = e.info;
+          mxGetPr(plhs[1])[1] = e.value;
+        }
+      return;
+    }
+
+  if (check)
+    {
+      // res = A0 + A1*X + A2*X*X
+      Matrix res(n, n), A2X(n, n);
+      res = A0;
+      blas::gemm("N", "N", 1.0, A1, X, 1.0, res);
+      blas::gemm("N", "N", 1.0, A2, X, 0.0, A2X);
+      blas::gemm("N", "N", 1.0, A2X, X, 1.0, res);
+      double sum = 0.0;
+      for (size_t j = 0; j < n; j++)
+        for (size_t i = 0; i < n; i++)
+          sum += fabs(res(i, j));
+      if (sum > tol)
+        mexPrintf("the norm residual of the residu %g compare to the tolerance criterion %g\n", sum, tol);
+    }
+
+  if (nlhs > 1)
+    plhs[1] = mxCreateDoubleScalar(0);
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * [X, Gamma, info] = disclyap_autocovariances(G, V, tol[, nar[, fp_tol]])
+ *
+ * Solves the discrete Lyapunov equation X = G*X*G' + V with the doubling
+ * algorithm of libmat's DiscLyapFast (as disclyap_fast.m and
+ * InitializeKalmanFilter::setPstar), and computes the autocovariances
+ * Gamma(:,:,k) = G^k*X for k = 1..nar of the process x(t) = G*x(t-1) + e(t),
+ * var(e(t)) = V.
+ *
+ * If fp_tol is positive, the solution is first sought by fixed point
+ * iterations started from the solution of the previous call of the same
+ * size (the lyapunov_fp option), the doubling algorithm with tolerance tol
+ * being used if they do not converge fast enough.
+ *
+ * info is 0 on success, and 1 if the solution is not finite (e.g. if G has
+ * eigenvalues outside the unit circle), in which case X and Gamma are NaN.
+ *
+ * The workspace is kept between calls, and only reallocated when the size of
+ * the problem changes.
+ */
+
+#include <dynmex.h>
+
+#include "DiscLyapFast.hh"
+
+static DiscLyapFast *dlf = NULL;
+static size_t dlf_n = 0;
+
+static void
+freeWorkspace()
+{
+  delete dlf;
+  dlf = NULL;
+}
+
+void
+mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+  if (nrhs < 3 || nrhs > 5)
+    DYN_MEX_FUNC_ERR_MSG_TXT("disclyap_autocovariances: between three and five input arguments are required.");
+  if (nlhs > 3)
+    DYN_MEX_FUNC_ERR_MSG_TXT("disclyap_autocovariances: at most three output arguments are allowed.");
+
+  const size_t n = mxGetM(prhs[0]);
+  for (int i = 0; i < 2; i++)
+    if (!mxIsDouble(prhs[i]) || mxIsComplex(prhs[i]) || mxIsSparse(prhs[i])
+        || mxGetM(prhs[i]) != n || mxGetN(prhs[i]) != n)
+      DYN_MEX_FUNC_ERR_MSG_TXT("disclyap_autocovariances: G and V must be real dense square matrices of the same size.");
+  const double tol = mxGetScalar(prhs[2]);
+  const size_t nar = nrhs > 3 ? (size_t) mxGetScalar(prhs[3]) : 0;
+  const double fp_tol = nrhs > 4 ? mxGetScalar(prhs[4]) : 0.0;
+
+  MatrixConstView G(mxGetPr(prhs[0]), n, n, n), V(mxGetPr(prhs[1]), n, n, n);
+
+  if (dlf == NULL || dlf_n != n)
+    {
+      if (dlf == NULL)
+        mexAtExit(freeWorkspace);
+      delete dlf;
+      dlf = new DiscLyapFast(n);
+      dlf_n = n;
+    }
+
+  plhs[0] = mxCreateDoubleMatrix(n, n, mxREAL);
+  MatrixView X(mxGetPr(plhs[0]), n, n, n);
+  bool failed = false;
+  try
+    {
+      if (fp_tol > 0.0)
+        dlf->solve_lyap_warm(G, V, X, fp_tol, tol);
+      else
+        dlf->solve_lyap(G, V, X, tol, 0);
+    }
+  catch (DiscLyapFast::DLPException &e)
+    {
+      failed = true;
+    }
+  for (size_t i = 0; i < n*n && !failed; i++)
+    if (!mxIsFinite(mxGetPr(plhs[0])[i]))
+      failed = true;
+  if (failed)
+    {
+      // Do not warm-start the next call from a meaningless solution
+      dlf->reset();
+      X.setAll(mxGetNaN());
+    }
+
+  if (nlhs > 1)
+    {
+      mwSize dims[3] = { (mwSize) n, (mwSize) n, (mwSize) nar };
+      plhs[1] = mxCreateNumericArray(3, dims, mxDOUBLE_CLASS, mxREAL);
+      for (size_t k = 0; k < nar; k++)
+        {
+          MatrixView Gamma_k(mxGetPr(plhs[1]) + k*n*n, n, n, n);
+          if (failed)
+            Gamma_k.setAll(mxGetNaN());
+          else if (k == 0)
+            blas::symm("R", "U", 1.0, X, G, 0.0, Gamma_k); // G*X, X being symmetric
+          else
+            {
+              MatrixView Gamma_km1(mxGetPr(plhs[1]) + (k-1)*n*n, n, n, n);
+              blas::gemm("N", "N", 1.0, G, Gamma_km1, 0.0, Gamma_k);
+            }
+        }
+    }
+
+  if (nlhs > 2)
+    plhs[2] = mxCreateDoubleScalar(failed ? 1 : 0);
+}
@@ -0,0 +1,370 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * [H1, F1, H2, F2, rcode, iter] = discretionary_policy_fixed_point(A0, A1, A2, A3, A4, A5, W, Q, beta, H10, F10, maxit, tol[, anderson_depth])
+ *
+ * Solves the discretionary policy problem of the model
+ *   A0*y(t) = A1*y(t-1) + A2*y(t+1) + A3*x(t) + A4*x(t+1) + A5*e(t)
+ * with the loss weights W (on y) and Q (on the instruments x), by the fixed
+ * point iteration of Dennis (2007) used in discretionary_policy_engine.m,
+ * started from H10 and F10:
+ *
+ *   P solves P = W + beta*F1'*Q*F1 + beta*H1'*P*H1 (doubling algorithm)
+ *   D = A0 - A2*H1 - A4*F1
+ *   F1 = -(Q + A3'*D'^(-1)*P*D^(-1)*A3) \ (A3'*D'^(-1)*P*D^(-1)*A1)
+ *   H1 = D^(-1)*(A1 + A3*F1)
+ *
+ * until the largest change of [H1;F1] is below tol. The shock coefficients
+ * H2 and F2 are those of the last iteration.
+ *
+ * If anderson_depth is positive, the iterates are combined with those of the
+ * anderson_depth previous iterations (Anderson mixing): the least squares
+ * problem is solved by a QR decomposition, and the history is discarded
+ * whenever it is badly conditioned or when the change of [H1;F1] increases,
+ * in which case a plain iteration is done. With anderson_depth = 0 (the
+ * default), the iterates are those of discretionary_policy_engine.m.
+ *
+ * rcode is 1 on convergence, 2 if the maximum number of iterations is
+ * reached, 3 if the iterates are not finite or D is singular, and 4 if the
+ * doubling algorithm failed (discretionary_policy_engine.m then uses its
+ * Hessenberg-Schur solver).
+ */
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include <dynmex.h>
+
+#include "Matrix.hh"
+#include "BlasBindings.hh"
+#include "LUSolver.hh"
+#include "QRDecomposition.hh"
+
+/*
+ * One step of the fixed point iteration, with its workspace
+ */
+class DennisIteration
+{
+public:
+  DennisIteration(const MatrixConstView &A0_arg, const MatrixConstView &A1_arg, const MatrixConstView &A2_arg,
+                  const MatrixConstView &A3_arg, const MatrixConstView &A4_arg, const MatrixConstView &A5_arg,
+                  const MatrixConstView &W_arg, const MatrixConstView &Q_arg, double beta_arg,
+                  size_t maxit_arg, double tol_arg) :
+    m(A0_arg.getRows()), ni(A3_arg.getCols()), nx(A5_arg.getCols()),
+    A0(A0_arg), A2(A2_arg), A4(A4_arg), W(W_arg), Q(Q_arg), beta(beta_arg), maxit(maxit_arg), tol(tol_arg),
+    P(m), Vadd(m), G(m), Hp(m), Tmp(m), D(m), FQ(ni, m),
+    RHS(m, m+ni+nx), RHSinit(m, m+ni+nx), Y(ni, m), M(ni), RHS2(ni, m+nx),
+    LUm(m), LUni(ni)
+  {
+    MatrixView A1_block(RHSinit, 0, 0, m, m), A3_block(RHSinit, 0, m, m, ni), A5_block(RHSinit, 0, m+ni, m, nx);
+    A1_block = A1_arg;
+    A3_block = A3_arg;
+    if (nx > 0)
+      A5_block = A5_arg;
+  }
+
+  //! Computes (Hn, Fn) = T(H, F), and the shock coefficients H2 and F2. Returns 0, 3 or 4 (see rcode)
+  template<class Mat1, class Mat2, class Mat3, class Mat4>
+  int
+  step(const Mat1 &H, const Mat2 &F, Mat3 &Hn, Mat4 &Fn, Matrix &H2, Matrix &F2)
+  {
+    // P = d + beta*H'*P*H with d = W + beta*F'*Q*F, by doubling
+    blas::gemm("N", "N", 1.0, Q, F, 0.0, FQ);
+    P = W;
+    blas::gemm("T", "N", beta, F, FQ, 1.0, P);
+    for (size_t j = 0; j < m; j++)
+      for (size_t i = 0; i < m; i++)
+        G(i, j) = beta*H(j, i);
+    Hp = H;
+    for (size_t i = 0; i < maxit; i++)
+      {
+        blas::gemm("N", "N", 1.0, G, P, 0.0, Tmp);
+        blas::gemm("N", "N", 1.0, Tmp, Hp, 0.0, Vadd);
+        mat::add(P, Vadd);
+        if (norm1(Vadd) <= tol*norm1(P))
+          break;
+        Tmp = G;
+        blas::gemm("N", "N", 1.0, Tmp, Tmp, 0.0, G);
+        Tmp = Hp;
+        blas::gemm("N", "N", 1.0, Tmp, Tmp, 0.0, Hp);
+      }
+    if (!finite(P))
+      return 4;
+
+    // [Z X E] = D \ [A1 A3 A5]
+    D = A0;
+    blas::gemm("N", "N", -1.0, A2, H, 1.0, D);
+    blas::gemm("N", "N", -1.0, A4, F, 1.0, D);
+    RHS = RHSinit;
+    try
+      {
+        LUm.invMult("N", D, RHS);
+      }
+    catch (LUSolver::LUException &e)
+      {
+        return 3;
+      }
+    MatrixView Z(RHS, 0, 0, m, m), X(RHS, 0, m, m, ni), E(RHS, 0, m+ni, m, nx);
+
+    // Y = X'*P, M = Q + Y*X, and [-Fn -F2] = M \ [Y*Z Y*E]
+    blas::gemm("T", "N", 1.0, X, P, 0.0, Y);
+    M = Q;
+    blas::gemm("N", "N", 1.0, Y, X, 1.0, M);
+    MatrixView YZ(RHS2, 0, 0, ni, m), YE(RHS2, 0, m, ni, nx);
+    blas::gemm("N", "N", 1.0, Y, Z, 0.0, YZ);
+    if (nx > 0)
+      blas::gemm("N", "N", 1.0, Y, E, 0.0, YE);
+    try
+      {
+        LUni.invMult("N", M, RHS2);
+      }
+    catch (LUSolver::LUException &e)
+      {
+        return 3;
+      }
+    Fn = YZ;
+    mat::negate(Fn);
+    F2 = YE;
+    mat::negate(F2);
+
+    // Hn = Z + X*Fn, H2 = E + X*F2
+    Hn = Z;
+    blas::gemm("N", "N", 1.0, X, Fn, 1.0, Hn);
+    H2 = E;
+    if (nx > 0)
+      blas::gemm("N", "N", 1.0, X, F2, 1.0, H2);
+    return 0;
+  }
+
+private:
+  const size_t m, ni, nx;
+  const MatrixConstView &A0, &A2, &A4, &W, &Q;
+  const double beta;
+  const size_t maxit;
+  const double tol;
+  Matrix P, Vadd, G, Hp, Tmp, D, FQ; // m*m, except FQ ni*m
+  Matrix RHS, RHSinit, Y, M, RHS2; // m*(m+ni+nx), ni*m, ni*ni, ni*(m+nx)
+  LUSolver LUm, LUni;
+
+  //! Maximum absolute column sum, as norm(X, 1)
+  static double
+  norm1(const Matrix &X)
+  {
+    double n = 0.0;
+    for (size_t j = 0; j < X.getCols(); j++)
+      {
+        double s = 0.0;
+        for (size_t i = 0; i < X.getRows(); i++)
+          s += fabs(X(i, j));
+        n = std::max(n, s);
+      }
+    return n;
+  }
+  static bool
+  finite(const Matrix &X)
+  {
+    for (size_t j = 0; j < X.getCols(); j++)
+      for (size_t i = 0; i < X.getRows(); i++)
+        if (!mxIsFinite(X(i, j)))
+          return false;
+    return true;
+  }
+};
+
+void
+mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+  if (nrhs != 13 && nrhs != 14)
+    DYN_MEX_FUNC_ERR_MSG_TXT("discretionary_policy_fixed_point: 13 or 14 input arguments are required.");
+  if (nlhs > 6)
+    DYN_MEX_FUNC_ERR_MSG_TXT("discretionary_policy_fixed_point: at most six output arguments are returned.");
+  for (int i = 0; i < nrhs; i++)
+    if (!mxIsDouble(prhs[i]) || mxIsComplex(prhs[i]) || mxIsSparse(prhs[i]))
+      DYN_MEX_FUNC_ERR_MSG_TXT("discretionary_policy_fixed_point: all the arguments must be real dense matrices.");
+
+  const size_t m = mxGetM(prhs[0]), ni = mxGetN(prhs[3]), nx = mxGetN(prhs[5]);
+  if (mxGetN(prhs[0]) != m)
+    DYN_MEX_FUNC_ERR_MSG_TXT("discretionary_policy_fixed_point: A0 must be square.");
+  for (int i = 1; i < 7; i++)
+    if (mxGetM(prhs[i]) != m || ((i < 3 || i == 6) && mxGetN(prhs[i]) != m) || (i == 4 && mxGetN(prhs[i]) != ni))
+      DYN_MEX_FUNC_ERR_MSG_TXT("discretionary_policy_fixed_point: A1, A2, W must be of the size of A0, A3 and A4 of the same size, and A5 must have as many rows as A0.");
+  if (mxGetM(prhs[7]) != ni || mxGetN(prhs[7]) != ni)
+    DYN_MEX_FUNC_ERR_MSG_TXT("discretionary_policy_fixed_point: Q must be square, with one row per column of A3.");
+  if (mxGetM(prhs[9]) != m || mxGetN(prhs[9]) != m || mxGetM(prhs[10]) != ni || mxGetN(prhs[10]) != m)
+    DYN_MEX_FUNC_ERR_MSG_TXT("discretionary_policy_fixed_point: H10 must be of the size of A0, and F10 of the size of A3'.");
+
+  MatrixConstView A0(mxGetPr(prhs[0]), m, m, m), A1(mxGetPr(prhs[1]), m, m, m), A2(mxGetPr(prhs[2]), m, m, m),
+    A3(mxGetPr(prhs[3]), m, ni, m), A4(mxGetPr(prhs[4]), m, ni, m), A5(mxGetPr(prhs[5]), m, nx, m),
+    W(mxGetPr(prhs[6]), m, m, m), Q(mxGetPr(prhs[7]), ni, ni, ni);
+  const double beta = mxGetScalar(prhs[8]);
+  const double maxit_d = mxGetScalar(prhs[11]);
+  const size_t maxit = maxit_d > 0 ? (size_t) maxit_d : 0;
+  const double tol = mxGetScalar(prhs[12]);
+  size_t depth = 0;
+  if (nrhs > 13 && mxGetScalar(prhs[13]) > 0)
+    depth = (size_t) mxGetScalar(prhs[13]);
+
+  // The iterate x = [H(:); F(:)] and its image T(x)
+  const size_t N = m*m + ni*m;
+  depth = std::min(depth, N);
+  std::vector<double> x(N), gx(N), f(N), gx_prev(N), f_prev(N);
+  std::copy(mxGetPr(prhs[9]), mxGetPr(prhs[9]) + m*m, x.begin());
+  std::copy(mxGetPr(prhs[10]), mxGetPr(prhs[10]) + ni*m, x.begin() + m*m);
+  MatrixView H(&x[0], m, m, m), F(&x[0] + m*m, ni, m, ni), Hn(&gx[0], m, m, m), Fn(&gx[0] + m*m, ni, m, ni);
+  Matrix H2(m, nx), F2(ni, nx);
+
+  DennisIteration iteration(A0, A1, A2, A3, A4, A5, W, Q, beta, maxit, tol);
+
+  // Anderson mixing: differences of the last images and residuals, and the QR decompositions of each size
+  Matrix dG(N, std::max(depth, (size_t) 1)), dF(N, std::max(depth, (size_t) 1)), R(N, std::max(depth, (size_t) 1));
+  std::vector<double> rhs(N), gamma(depth);
+  std::vector<QRDecomposition *> qr(depth);
+  for (size_t k = 0; k < depth; k++)
+    qr[k] = new QRDecomposition(N, k+1, 1);
+  size_t nhist = 0;
+  double NQprev = 0.0;
+
+  int rcode = 0;
+  size_t iter = 0;
+  while (rcode == 0)
+    {
+      iter++;
+      int status = iteration.step(H, F, Hn, Fn, H2, F2);
+      if (status != 0)
+        {
+          rcode = status;
+          break;
+        }
+
+      // NQ = max(max(abs([H1;F1]-[H10;F10])))
+      double NQ = 0.0;
+      bool isnan_NQ = false;
+      for (size_t i = 0; i < N; i++)
+        {
+          f[i] = gx[i] - x[i];
+          if (mxIsNaN(f[i]))
+            isnan_NQ = true;
+          NQ = std::max(NQ, fabs(f[i]));
+        }
+      if (isnan_NQ)
+        rcode = 3;
+      else if (iter > maxit)
+        rcode = 2;
+      else if (NQ < tol)
+        rcode = 1;
+      if (rcode != 0)
+        break;
+
+      if (depth == 0)
+        {
+          x = gx;
+          continue;
+        }
+
+      if (iter > 1 && NQ > NQprev)
+        nhist = 0; // The history does not help: restart from a plain iteration
+      else if (iter > 1)
+        {
+          if (nhist == depth)
+            {
+              // Drop the oldest differences
+              memmove(dG.getData(), dG.getData() + N, N*(depth-1)*sizeof(double));
+              memmove(dF.getData(), dF.getData() + N, N*(depth-1)*sizeof(double));
+              nhist--;
+            }
+          for (size_t i = 0; i < N; i++)
+            {
+              dG(i, nhist) = gx[i] - gx_prev[i];
+              dF(i, nhist) = f[i] - f_prev[i];
+            }
+          nhist++;
+        }
+      gx_prev = gx;
+      f_prev = f;
+      NQprev = NQ;
+
+      bool mixed = false;
+      if (nhist > 0)
+        {
+          // gamma = argmin ||f - dF*gamma||, by QR decomposition of dF
+          MatrixView Rk(R, 0, 0, N, nhist);
+          Rk = MatrixConstView(dF, 0, 0, N, nhist);
+          rhs = f;
+          MatrixView rhs_v(&rhs[0], N, 1, N);
+          qr[nhist-1]->computeAndLeftMultByQ(Rk, "T", rhs_v);
+          double maxdiag = 0.0;
+          for (size_t k = 0; k < nhist; k++)
+            maxdiag = std::max(maxdiag, fabs(Rk(k, k)));
+          bool wellConditioned = maxdiag > 0.0 && mxIsFinite(maxdiag);
+          for (size_t k = nhist; k-- > 0 && wellConditioned; )
+            {
+              if (fabs(Rk(k, k)) <= 1e-12*maxdiag)
+                wellConditioned = false;
+              else
+                {
+                  double s = rhs[k];
+                  for (size_t l = k+1; l < nhist; l++)
+                    s -= Rk(k, l)*gamma[l];
+                  gamma[k] = s/Rk(k, k);
+                }
+            }
+          if (wellConditioned)
+            {
+              // x = T(x) - dG*gamma
+              x = gx;
+              for (size_t k = 0; k < nhist; k++)
+                for (size_t i = 0; i < N; i++)
+                  x[i] -= dG(i, k)*gamma[k];
+              mixed = true;
+            }
+          else
+            nhist = 0;
+        }
+      if (!mixed)
+        x = gx;
+    }
+
+  for (size_t k = 0; k < depth; k++)
+    delete qr[k];
+
+  plhs[0] = mxCreateDoubleMatrix(m, m, mxREAL);
+  std::copy(gx.begin(), gx.begin() + m*m, mxGetPr(plhs[0]));
+  if (nlhs > 1)
+    {
+      plhs[1] = mxCreateDoubleMatrix(ni, m, mxREAL);
+      std::copy(gx.begin() + m*m, gx.end(), mxGetPr(plhs[1]));
+    }
+  if (nlhs > 2)
+    {
+      plhs[2] = mxCreateDoubleMatrix(m, nx, mxREAL);
+      std::copy(H2.getData(), H2.getData() + m*nx, mxGetPr(plhs[2]));
+    }
+  if (nlhs > 3)
+    {
+      plhs[3] = mxCreateDoubleMatrix(ni, nx, mxREAL);
+      std::copy(F2.getData(), F2.getData() + ni*nx, mxGetPr(plhs[3]));
+    }
+  if (nlhs > 4)
+    plhs[4] = mxCreateDoubleScalar(rcode);
+  if (nlhs > 5)
+    plhs[5] = mxCreateDoubleScalar(iter);
+}
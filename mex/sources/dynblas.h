@@ -129,6 +129,11 @@ extern "C" {
   void dsyr(BLCHAR uplo, CONST_BLINT n, CONST_BLDOU alpha, CONST_BLDOU x,
             CONST_BLINT incx, BLDOU a, CONST_BLINT lda);
 
+#define dsyrk FORTRAN_WRAPPER(dsyrk)
+  void dsyrk(BLCHAR uplo, BLCHAR trans, CONST_BLINT n, CONST_BLINT k,
+             CONST_BLDOU alpha, CONST_BLDOU a, CONST_BLINT lda,
+             CONST_BLDOU beta, BLDOU c, CONST_BLINT ldc);
+
 #define dtrmm FORTRAN_WRAPPER(dtrmm)
   void dtrmm(BLCHAR side, BLCHAR uplo, BLCHAR transa, BLCHAR diag, CONST_BLINT m,
              CONST_BLINT n, CONST_BLDOU alpha, CONST_BLDOU a, CONST_BLINT lda,
@@ -42,6 +42,9 @@ extern "C" {
   /* returned by all routines that use Info: */
 #define UMFPACK_OK (0)
 #define UMFPACK_STATUS 0        /* UMFPACK_OK, or other result */
+/* number of nonzeros in the LU factors, returned by umfpack_dl_numeric: */
+#define UMFPACK_LNZ 43
+#define UMFPACK_UNZ 44
 
 #ifdef _WIN64
   typedef long long int SuiteSparse_long;
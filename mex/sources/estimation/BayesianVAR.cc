@@ -0,0 +1,414 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <cfloat>
+#include <limits>
+#include <algorithm>
+
+#include <boost/random/normal_distribution.hpp>
+#include <boost/random/gamma_distribution.hpp>
+
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
+#include "BayesianVAR.hh"
+#include "BlasBindings.hh"
+#include "LapackBindings.hh"
+#include "RandomEngine.hh"
+
+BayesianVAR::BayesianVAR(const Matrix &data_arg, size_t first_arg, size_t last_arg, size_t train_arg, size_t maxLags_arg,
+                         bool constant, bool prefilter_arg, const PriorOptions &prior_arg) throw (std::invalid_argument) :
+  ny(data_arg.getCols()), nx(constant && !prefilter_arg ? 1 : 0), maxLags(maxLags_arg),
+  first(first_arg), last(last_arg), train(train_arg), prefilter(prefilter_arg), prior(prior_arg),
+  data(last_arg >= first_arg && first_arg >= train_arg + maxLags_arg ? last_arg - first_arg + 1 + train_arg + maxLags_arg : 1, ny),
+  zzTrain((maxLags_arg+1)*ny + nx), zzRest((maxLags_arg+1)*ny + nx),
+  zTrain((maxLags_arg+1)*ny + nx), zRest((maxLags_arg+1)*ny + nx)
+{
+  if (maxLags == 0)
+    throw std::invalid_argument("BayesianVAR: the number of lags must be positive");
+  if (last >= data_arg.getRows() || last < first)
+    throw std::invalid_argument("BayesianVAR: the estimation sample is empty or exceeds the data");
+  if (first < train + maxLags)
+    throw std::invalid_argument("BayesianVAR: first_obs+presample-train should be > nlags (for initializing the VAR)");
+
+  data = MatrixConstView(data_arg, first - train - maxLags, 0, data.getRows(), ny);
+
+  // Cross products of the observations and of their lags
+  size_t nz = zzTrain.getRows();
+  Vector z(nz);
+  zzTrain.setAll(0.0);
+  zzRest.setAll(0.0);
+  zTrain.setAll(0.0);
+  zRest.setAll(0.0);
+  for (size_t t = maxLags; t < data.getRows(); t++)
+    {
+      for (size_t lag = 0; lag <= maxLags; lag++)
+        for (size_t i = 0; i < ny; i++)
+          z(zIndex(lag)+i) = data(t-lag, i);
+      if (nx)
+        z(nz-1) = 1.0;
+      Matrix &zz = t < maxLags + train ? zzTrain : zzRest;
+      blas::syr("L", 1.0, VectorView(z, 0, nz), MatrixView(zz.getData(), nz, nz, nz));
+      vec::add(t < maxLags + train ? zTrain : zRest, z);
+    }
+  mat::copy_lower_to_upper(zzTrain);
+  mat::copy_lower_to_upper(zzRest);
+}
+
+void
+BayesianVAR::addObservation(const Vector &y, const Vector &x, Matrix &XX, Matrix &XY, Matrix &YY)
+{
+  for (size_t j = 0; j < x.getSize(); j++)
+    {
+      for (size_t i = 0; i < x.getSize(); i++)
+        XX(i, j) += x(i)*x(j);
+      for (size_t i = 0; i < y.getSize(); i++)
+        XY(j, i) += x(j)*y(i);
+    }
+  for (size_t j = 0; j < y.getSize(); j++)
+    for (size_t i = 0; i < y.getSize(); i++)
+      YY(i, j) += y(i)*y(j);
+}
+
+void
+BayesianVAR::leastSquares(Matrix &XX, const Matrix &XY, const Matrix &YY, NormalInverseWishart &niw) throw (std::runtime_error)
+{
+  niw.XXi = XX;
+  if (lapack::choleskyInverse(niw.XXi) != 0)
+    throw std::runtime_error("BayesianVAR: the regressors of the VAR are collinear");
+  blas::symm("L", "L", 1.0, niw.XXi, XY, 0.0, niw.PhiHat);
+  // S = u'*u = Y'*Y - (X'*Y)'*PhiHat
+  niw.S = YY;
+  blas::gemm("T", "N", -1.0, XY, niw.PhiHat, 1.0, niw.S);
+  for (size_t j = 0; j < niw.S.getCols(); j++)
+    for (size_t i = 0; i < j; i++)
+      niw.S(i, j) = niw.S(j, i) = 0.5*(niw.S(i, j) + niw.S(j, i));
+}
+
+void
+BayesianVAR::compute(size_t nlags, NormalInverseWishart &posterior, NormalInverseWishart &priorDist) const throw (std::runtime_error)
+{
+  assert(nlags >= 1 && nlags <= maxLags);
+  size_t k = getNumberOfRegressors(nlags);
+  assert(posterior.PhiHat.getRows() == k && priorDist.PhiHat.getRows() == k);
+
+  // Positions in z_t of y_t and of the regressors
+  std::vector<size_t> cols;
+  for (size_t i = 0; i < ny*(nlags+1); i++)
+    cols.push_back(i);
+  if (nx)
+    cols.push_back(zzTrain.getRows()-1);
+
+  // Mean of the observations of the VAR (the training sample, the estimation sample and its initial lags)
+  Vector mean(ny);
+  mean.setAll(0.0);
+  if (prefilter)
+    {
+      for (size_t t = maxLags - nlags; t < data.getRows(); t++)
+        for (size_t i = 0; i < ny; i++)
+          mean(i) += data(t, i);
+      for (size_t i = 0; i < ny; i++)
+        mean(i) /= (double) (data.getRows() - maxLags + nlags);
+    }
+
+  // Standard deviations of the observations from first-nlags to first
+  Vector sig(ny);
+  size_t firstRow = maxLags + train;
+  for (size_t i = 0; i < ny; i++)
+    {
+      double m = 0.0, v = 0.0;
+      for (size_t t = firstRow - nlags; t <= firstRow; t++)
+        m += data(t, i);
+      m /= (double) (nlags + 1);
+      for (size_t t = firstRow - nlags; t <= firstRow; t++)
+        v += (data(t, i) - m)*(data(t, i) - m);
+      sig(i) = sqrt(v / (double) nlags);
+    }
+
+  // Mean of the initial lags of the training sample
+  Vector ybar(ny);
+  for (size_t i = 0; i < ny; i++)
+    {
+      double m = 0.0;
+      for (size_t t = maxLags - nlags; t < maxLags; t++)
+        m += data(t, i);
+      ybar(i) = m / (double) nlags - mean(i);
+    }
+
+  Vector y(ny), x(k);
+  for (int posteriorPass = 0; posteriorPass < 2; posteriorPass++)
+    {
+      NormalInverseWishart &niw = posteriorPass ? posterior : priorDist;
+      size_t n = posteriorPass ? data.getRows() - maxLags : train;
+
+      // Cross products of the observations, demeaned if requested
+      Matrix M(ny + k);
+      Vector s(ny + k), c(ny + k);
+      for (size_t j = 0; j < ny + k; j++)
+        {
+          s(j) = zTrain(cols[j]) + (posteriorPass ? zRest(cols[j]) : 0.0);
+          c(j) = cols[j] < ny*(maxLags+1) ? mean(cols[j] % ny) : 0.0;
+          for (size_t i = 0; i < ny + k; i++)
+            M(i, j) = zzTrain(cols[i], cols[j]) + (posteriorPass ? zzRest(cols[i], cols[j]) : 0.0);
+        }
+      if (prefilter)
+        for (size_t j = 0; j < ny + k; j++)
+          for (size_t i = 0; i < ny + k; i++)
+            M(i, j) += -s(i)*c(j) - c(i)*s(j) + (double) n*c(i)*c(j);
+      Matrix XX(k), XY(k, ny), YY(ny);
+      XX = MatrixConstView(M, ny, ny, k, k);
+      XY = MatrixConstView(M, ny, 0, k, ny);
+      YY = MatrixConstView(M, 0, 0, ny, ny);
+
+      // Dummy observations of the Minnesota prior
+      for (size_t i = 0; i < ny; i++)
+        for (size_t lag = 1; lag <= nlags; lag++)
+          {
+            y.setAll(0.0);
+            x.setAll(0.0);
+            if (lag == 1)
+              y(i) = prior.tau*sig(i);
+            x((lag-1)*ny + i) = prior.tau*pow((double) lag, prior.decay)*sig(i);
+            addObservation(y, x, XX, XY, YY);
+          }
+      n += ny*nlags;
+
+      // Dummy observations for the covariance matrix
+      for (int w = 0; w < prior.omega; w++)
+        for (size_t i = 0; i < ny; i++)
+          {
+            y.setAll(0.0);
+            x.setAll(0.0);
+            y(i) = sig(i);
+            addObservation(y, x, XX, XY, YY);
+          }
+      if (prior.omega > 0)
+        n += prior.omega*ny;
+
+      // Sum of coefficients and co-persistence dummy observations
+      if (prior.lambda != 0)
+        {
+          double lambda = fabs(prior.lambda);
+          for (size_t i = 0; i < ny; i++)
+            {
+              y(i) = lambda*ybar(i);
+              for (size_t lag = 0; lag < nlags; lag++)
+                x(lag*ny + i) = lambda*ybar(i);
+            }
+          if (nx)
+            x(k-1) = prior.lambda > 0 ? lambda : 0.0;
+          addObservation(y, x, XX, XY, YY);
+          n++;
+        }
+      if (prior.mu > 0)
+        for (size_t i = 0; i < ny; i++)
+          {
+            y.setAll(0.0);
+            x.setAll(0.0);
+            y(i) = prior.mu*ybar(i);
+            for (size_t lag = 0; lag < nlags; lag++)
+              x(lag*ny + i) = prior.mu*ybar(i);
+            addObservation(y, x, XX, XY, YY);
+            n++;
+          }
+
+      leastSquares(XX, XY, YY, niw);
+      niw.df = (double) n - (double) k - (double) (prior.flat*(ny+1));
+    }
+
+  if (priorDist.df < ny)
+    throw std::runtime_error("Too few degrees of freedom in the inverse-Wishart part of prior distribution. You should increase training sample size.");
+}
+
+double
+BayesianVAR::logKernelIntegral(const Matrix &S, double df, const Matrix &XXi) throw (std::runtime_error)
+{
+  size_t k = XXi.getRows(), m = S.getRows();
+  Matrix cx(XXi), cs(S);
+  if (lapack::choleskyDecomp(cx, "L") != 0)
+    throw std::runtime_error("singular XXi");
+  if (lapack::choleskyDecomp(cs, "L") != 0)
+    throw std::runtime_error("singular S");
+  double logdet_cx = 0.0, logdet_cs = 0.0;
+  for (size_t i = 0; i < k; i++)
+    {
+      if (cx(i, i) < 100*DBL_EPSILON)
+        throw std::runtime_error("singular XXi");
+      logdet_cx += log(cx(i, i));
+    }
+  for (size_t i = 0; i < m; i++)
+    {
+      if (cs(i, i) < 100*DBL_EPSILON)
+        throw std::runtime_error("singular S");
+      logdet_cs += log(cs(i, i));
+    }
+  if (df <= (double) m - 1)
+    throw std::runtime_error("too few df in ggammaln");
+  double lgg = 0.0;
+  for (size_t i = 0; i < m; i++)
+    lgg += lgamma(0.5*(df - (double) i));
+
+  // Matrix-normal component
+  double w1 = 0.5*k*m*log(2*M_PI) + m*logdet_cx;
+  // Inverse-Wishart component
+  double w2 = -df*logdet_cs + 0.5*df*m*log(2.0) + m*(m-1)*0.25*log(M_PI) + lgg;
+  return w1 + w2;
+}
+
+double
+BayesianVAR::logMarginalDensity(const NormalInverseWishart &posterior, const NormalInverseWishart &priorDist) throw (std::runtime_error)
+{
+  size_t m = posterior.S.getRows();
+  double lik_nobs = posterior.df - priorDist.df;
+  return logKernelIntegral(posterior.S, posterior.df, posterior.XXi)
+    - logKernelIntegral(priorDist.S, priorDist.df, priorDist.XXi)
+    - 0.5*m*lik_nobs*log(2*M_PI);
+}
+
+size_t
+BayesianVAR::forecast(const NormalInverseWishart &posterior, size_t nlags, const Matrix &initval, const Matrix &xdata,
+                      size_t draws, uint64_t seed, int number_of_threads, Matrix &simsNoShock, Matrix &simsWithShocks)
+  throw (std::runtime_error)
+{
+  size_t m = posterior.S.getRows(), k = posterior.PhiHat.getRows(), horizon = xdata.getRows();
+  size_t nx = k - m*nlags, np = m*nlags;
+  assert(initval.getRows() == nlags && initval.getCols() == m && xdata.getCols() == nx);
+  assert(simsNoShock.getRows() == horizon*m && simsNoShock.getCols() == draws);
+  assert(simsWithShocks.getRows() == horizon*m && simsWithShocks.getCols() == draws);
+  if (posterior.df <= (double) m - 1)
+    throw std::runtime_error("BayesianVAR: too few degrees of freedom in the posterior");
+
+  // Lower Cholesky factors of S^(-1) and of XXi
+  Matrix S_inv_chol(posterior.S), XXi_chol(posterior.XXi);
+  if (lapack::choleskyInverse(S_inv_chol) != 0 || lapack::choleskyDecomp(S_inv_chol, "L") != 0)
+    throw std::runtime_error("BayesianVAR: the posterior S is not positive definite");
+  if (lapack::choleskyDecomp(XXi_chol, "L") != 0)
+    throw std::runtime_error("BayesianVAR: the posterior XXi is not positive definite");
+  for (size_t j = 0; j < m; j++)
+    for (size_t i = 0; i < j; i++)
+      S_inv_chol(i, j) = 0.0;
+  for (size_t j = 0; j < k; j++)
+    for (size_t i = 0; i < j; i++)
+      XXi_chol(i, j) = 0.0;
+
+  // One random stream by draw
+  std::vector<Xoshiro256StarStar> rngs;
+  Xoshiro256StarStar g(seed);
+  for (size_t d = 0; d < draws; d++)
+    rngs.push_back(g.split());
+
+  size_t explosive = 0;
+#ifdef USE_OMP
+# pragma omp parallel num_threads(number_of_threads) reduction(+:explosive)
+#endif
+  {
+    Matrix A(m), Sigma(m), Z(k, m), ZS(k, m), Phi(k, m), companion(np);
+    Vector X(k), y(m), e(m), shock(m), wr(np), wi(np);
+    lapack_int lnp = np, lwork = 4*np, info;
+    std::vector<double> work(lwork);
+    boost::normal_distribution<double> normal;
+
+#ifdef USE_OMP
+# pragma omp for schedule(dynamic)
+#endif
+    for (int d = 0; d < (int) draws; d++)
+      {
+        Xoshiro256StarStar &rng = rngs[d];
+
+        // Sigma ~ IW(S, df): Sigma^(-1) = (L*A)*(L*A)' with S^(-1) = L*L' (Bartlett decomposition)
+        A.setAll(0.0);
+        for (size_t i = 0; i < m; i++)
+          {
+            boost::gamma_distribution<double> gamma(0.5*(posterior.df - (double) i));
+            A(i, i) = sqrt(2.0*gamma(rng));
+            for (size_t j = 0; j < i; j++)
+              A(i, j) = normal(rng);
+          }
+        blas::gemm("N", "N", 1.0, S_inv_chol, A, 0.0, Sigma);
+        lapack_int lm = m, ld = Sigma.getLd();
+        dtrtri("L", "N", &lm, Sigma.getData(), &ld, &info);
+        for (size_t j = 0; j < m; j++)
+          for (size_t i = 0; i < j; i++)
+            Sigma(i, j) = 0.0;
+        A = Sigma;
+        blas::gemm("T", "N", 1.0, A, A, 0.0, Sigma);
+        if (info != 0 || lapack::choleskyDecomp(Sigma, "L") != 0)
+          {
+            mat::col_set(simsNoShock, d, 0, horizon*m, std::numeric_limits<double>::quiet_NaN());
+            mat::col_set(simsWithShocks, d, 0, horizon*m, std::numeric_limits<double>::quiet_NaN());
+            continue;
+          }
+        for (size_t j = 0; j < m; j++)
+          for (size_t i = 0; i < j; i++)
+            Sigma(i, j) = 0.0;
+
+        // Phi ~ MN(PhiHat, Sigma, XXi)
+        for (size_t j = 0; j < m; j++)
+          for (size_t i = 0; i < k; i++)
+            Z(i, j) = normal(rng);
+        blas::gemm("N", "T", 1.0, Z, Sigma, 0.0, ZS);
+        Phi = posterior.PhiHat;
+        blas::gemm("N", "N", 1.0, XXi_chol, ZS, 1.0, Phi);
+
+        // All the eigenvalues of the companion matrix have to be on or inside the unit circle
+        companion.setAll(0.0);
+        for (size_t j = 0; j < np; j++)
+          for (size_t i = 0; i < m; i++)
+            companion(i, j) = Phi(j, i);
+        for (size_t i = m; i < np; i++)
+          companion(i, i-m) = 1.0;
+        dgeev("N", "N", &lnp, companion.getData(), &lnp, wr.getData(), wi.getData(),
+              NULL, &lnp, NULL, &lnp, &work[0], &lwork, &info);
+        for (size_t i = 0; i < np; i++)
+          if (info == 0 && sqrt(wr(i)*wr(i) + wi(i)*wi(i)) > 1.0000000000001)
+            {
+              explosive++;
+              break;
+            }
+
+        // Paths without and with shocks
+        for (int withShocks = 0; withShocks < 2; withShocks++)
+          {
+            Matrix &sims = withShocks ? simsWithShocks : simsNoShock;
+            for (size_t t = 0; t < horizon; t++)
+              {
+                // X = [y_t-1' ... y_t-nlags' x_t']
+                for (size_t lag = 1; lag <= nlags; lag++)
+                  for (size_t i = 0; i < m; i++)
+                    X((lag-1)*m + i) = lag <= t ? sims(t-lag + i*horizon, d) : initval(nlags - lag + t, i);
+                for (size_t i = 0; i < nx; i++)
+                  X(np + i) = xdata(t, i);
+                blas::gemv("T", 1.0, Phi, X, 0.0, y);
+                if (withShocks)
+                  {
+                    for (size_t i = 0; i < m; i++)
+                      e(i) = normal(rng);
+                    blas::gemv("N", 1.0, Sigma, e, 0.0, shock);
+                    vec::add(y, shock);
+                  }
+                for (size_t i = 0; i < m; i++)
+                  sims(t + i*horizon, d) = y(i);
+              }
+          }
+      }
+  }
+  return explosive;
+}
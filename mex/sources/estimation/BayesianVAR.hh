@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if !defined(BAYESIAN_VAR_HH_INCLUDED)
+#define BAYESIAN_VAR_HH_INCLUDED
+
+#include <vector>
+#include <stdexcept>
+
+#include <stdint.h>
+
+#include "Vector.hh"
+#include "Matrix.hh"
+
+/**
+ * Bayesian VAR with the prior of Sims and Zha (1998), made of dummy
+ * observations and of a training sample, as in bvar_toolbox.m.
+ *
+ * The VAR with p lags is y_t' = [y_t-1' ... y_t-p' x_t']*Phi + e_t', with
+ * x_t = 1 (or nothing without constant) and e_t ~ N(0, Sigma). Its prior and
+ * posterior are normal-inverse-Wishart: Sigma ~ IW(S, df) and
+ * vec(Phi) ~ N(vec(PhiHat), Sigma kron XXi), obtained by least squares on the
+ * dummy observations plus the training sample (prior) or plus the whole
+ * sample (posterior).
+ *
+ * The estimation sample starts at the same observation for all the lag
+ * orders (the lags are taken before it), so that the cross products of the
+ * observations and of their lags up to the largest lag order are computed
+ * once, by the constructor, for the training sample and for the rest of the
+ * sample. Those of a given lag order are extracted from them, corrected for
+ * the demeaning of the data if requested, and complemented with the dummy
+ * observations of the lag order.
+ *
+ * Forecasts are simulated by drawing (Sigma, Phi) from the posterior, the
+ * inverse-Wishart draws using the Bartlett decomposition. The draws are
+ * simulated in parallel, each one using its own random stream, so that the
+ * results do not depend on the number of threads.
+ */
+class BayesianVAR
+{
+public:
+  //! Hyperparameters of the prior, see the bvar_prior_* options
+  struct PriorOptions
+  {
+    double tau, decay, lambda, mu;
+    int omega, flat;
+    PriorOptions() : tau(3), decay(0.5), lambda(5), mu(2), omega(1), flat(0)
+    {
+    };
+  };
+
+  //! Normal-inverse-Wishart distribution of (Sigma, Phi)
+  struct NormalInverseWishart
+  {
+    double df;
+    Matrix S, XXi, PhiHat;
+    NormalInverseWishart(size_t ny, size_t k) : df(0), S(ny), XXi(k), PhiHat(k, ny)
+    {
+    };
+  };
+
+  /*!
+    \param data The observations (in rows) of the ny variables, already transformed
+    \param first Index of the first observation of the estimation sample, after the training sample
+    \param last Index of the last observation of the estimation sample
+    \param train Number of observations of the training sample, just before first
+    \param maxLags Largest number of lags
+    \param constant Whether the VAR has a constant
+    \param prefilter Whether the data is demeaned
+  */
+  BayesianVAR(const Matrix &data, size_t first, size_t last, size_t train, size_t maxLags,
+              bool constant, bool prefilter, const PriorOptions &prior) throw (std::invalid_argument);
+  virtual ~BayesianVAR()
+  {
+  };
+
+  size_t
+  getNumberOfVariables() const
+  {
+    return ny;
+  };
+  //! Number of regressors of the VAR with nlags lags
+  size_t
+  getNumberOfRegressors(size_t nlags) const
+  {
+    return ny*nlags + nx;
+  };
+
+  //! Computes the prior and the posterior of the VAR with nlags lags, which must have been constructed with the size of getNumberOfRegressors(nlags)
+  void compute(size_t nlags, NormalInverseWishart &posterior, NormalInverseWishart &prior) const throw (std::runtime_error);
+
+  //! Log of the marginal density of the data, given the prior and posterior computed by compute()
+  static double logMarginalDensity(const NormalInverseWishart &posterior, const NormalInverseWishart &prior) throw (std::runtime_error);
+
+  //! Log of the integral over (Phi, Sigma) of the kernel of the normal-inverse-Wishart density (matrictint in bvar_density.m)
+  static double logKernelIntegral(const Matrix &S, double df, const Matrix &XXi) throw (std::runtime_error);
+
+  /*!
+    \param posterior Posterior of the VAR with nlags lags
+    \param initval nlags*ny, the last observations (the oldest first)
+    \param xdata horizon*nx, the exogenous regressors of the forecast periods
+    \param draws Number of draws of the parameters
+    \param[out] simsNoShock,simsWithShocks (horizon*ny)*draws, the forecasts of the draws without and with shocks (periods first, then variables)
+    \return The number of draws whose companion matrix has an eigenvalue outside the unit circle
+  */
+  static size_t forecast(const NormalInverseWishart &posterior, size_t nlags, const Matrix &initval, const Matrix &xdata,
+                         size_t draws, uint64_t seed, int number_of_threads, Matrix &simsNoShock, Matrix &simsWithShocks)
+    throw (std::runtime_error);
+
+private:
+  const size_t ny, nx, maxLags;
+  const size_t first, last, train;
+  const bool prefilter;
+  const PriorOptions prior;
+  //! Observations from first-train-maxLags to last
+  Matrix data;
+  /*! Cross products z_t*z_t' over the training sample, and over the rest of the estimation sample,
+    with z_t = [y_t' y_t-1' ... y_t-maxLags' x_t']', and sums of z_t */
+  Matrix zzTrain, zzRest;
+  Vector zTrain, zRest;
+
+  //! Index in z_t of y_t-lag
+  size_t
+  zIndex(size_t lag) const
+  {
+    return lag*ny;
+  };
+  //! Adds the cross products of the dummy observation (y, x) to XX, XY and YY
+  static void addObservation(const Vector &y, const Vector &x, Matrix &XX, Matrix &XY, Matrix &YY);
+  //! Computes S, XXi and PhiHat of niw by least squares, from the cross products of the regressors X and of the observations Y
+  static void leastSquares(Matrix &XX, const Matrix &XY, const Matrix &YY, NormalInverseWishart &niw) throw (std::runtime_error);
+};
+
+#endif // !defined(BAYESIAN_VAR_HH_INCLUDED)
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdexcept>
+
+#include "ChandrasekharFilter.hh"
+#include "LapackBindings.hh"
+
+ChandrasekharFilter::~ChandrasekharFilter()
+{
+
+}
+
+ChandrasekharFilter::ChandrasekharFilter(const std::string &basename, size_t n_endo, size_t n_exo,
+                                         const std::vector<size_t> &zeta_fwrd_arg, const std::vector<size_t> &zeta_back_arg,
+                                         const std::vector<size_t> &zeta_mixed_arg, const std::vector<size_t> &zeta_static_arg,
+                                         double qz_criterium_arg, const std::vector<size_t> &varobs_arg,
+                                         double riccati_tol_arg, double lyapunov_tol_arg,
+                                         bool noconstant_arg, double lyapunov_fixed_point_tol_arg) :
+  zeta_varobs_back_mixed(KalmanFilter::compute_zeta_varobs_back_mixed(zeta_back_arg, zeta_mixed_arg, varobs_arg)),
+  varobs_state(varobs_arg.size()), T(zeta_varobs_back_mixed.size()), R(zeta_varobs_back_mixed.size(), n_exo),
+  Pstar(zeta_varobs_back_mixed.size(), zeta_varobs_back_mixed.size()), Pinf(zeta_varobs_back_mixed.size(), zeta_varobs_back_mixed.size()),
+  RQRt(zeta_varobs_back_mixed.size(), zeta_varobs_back_mixed.size()), F(varobs_arg.size(), varobs_arg.size()),
+  Finv(varobs_arg.size(), varobs_arg.size()), K(zeta_varobs_back_mixed.size(), varobs_arg.size()), oldK(zeta_varobs_back_mixed.size(), varobs_arg.size()),
+  Kg(zeta_varobs_back_mixed.size(), varobs_arg.size()), W(zeta_varobs_back_mixed.size(), varobs_arg.size()),
+  Wtmp(zeta_varobs_back_mixed.size(), varobs_arg.size()), M(varobs_arg.size(), varobs_arg.size()), ZW(varobs_arg.size(), varobs_arg.size()),
+  ZWM(varobs_arg.size(), varobs_arg.size()), ZWMtFinv(varobs_arg.size(), varobs_arg.size()), ZWMWt(varobs_arg.size(), zeta_varobs_back_mixed.size()),
+  a_init(zeta_varobs_back_mixed.size()), a_new(zeta_varobs_back_mixed.size()), vt(varobs_arg.size()), vtFinv(varobs_arg.size()),
+  observationConstant(varobs_arg.size()), riccati_tol(riccati_tol_arg),
+  initKalmanFilter(basename, n_endo, n_exo, zeta_fwrd_arg, zeta_back_arg, zeta_mixed_arg,
+                   zeta_static_arg, zeta_varobs_back_mixed, varobs_arg, qz_criterium_arg, lyapunov_tol_arg, noconstant_arg,
+                   lyapunov_fixed_point_tol_arg),
+  FUTP(varobs_arg.size()*(varobs_arg.size()+1)/2)
+{
+  for (size_t i = 0; i < varobs_arg.size(); ++i)
+    varobs_state[i] = find(zeta_varobs_back_mixed.begin(), zeta_varobs_back_mixed.end(),
+                           varobs_arg[i]) - zeta_varobs_back_mixed.begin();
+}
+
+double
+ChandrasekharFilter::invertF()
+{
+  size_t p = F.getRows();
+
+  // Finv=inv(F)
+  mat::set_identity(Finv);
+  // Pack F upper trinagle as vector
+  for (size_t i = 1; i <= p; ++i)
+    for (size_t j = i; j <= p; ++j)
+      FUTP(i + (j-1)*j/2 -1) = F(i-1, j-1);
+
+  int info = lapack::choleskySolver(FUTP, Finv, "U"); // FUTP now contains the Chol decomposition of F
+  assert(info >= 0);
+  if (info > 0)
+    throw std::runtime_error("ChandrasekharFilter::filter: F is singular");
+
+  // log of the determinant of F
+  double logFdet = 0.0;
+  for (size_t d = 1; d <= p; ++d)
+    logFdet += 2*log(fabs(FUTP(d + (d-1)*d/2 -1)));
+
+  return -0.5*(p*log(2*M_PI)+logFdet);
+}
+
+/**
+ * Multi-variate Kalman Filter with Chandrasekhar recursions
+ */
+double
+ChandrasekharFilter::filter(const MatrixConstView &dataView,  const Matrix &H, VectorView &vll, size_t start)
+{
+  double loglik = 0.0, ll, llconst;
+  size_t p = F.getRows(), n = a_init.getSize();
+  bool nonstationary = true;
+  a_init.setAll(0.0);
+
+  for (size_t t = 0; t < dataView.getCols(); ++t)
+    for (size_t i = 0; i < p; ++i)
+      if (dataView(i, t) != dataView(i, t))
+        throw std::runtime_error("ChandrasekharFilter::filter: missing observations are not supported, use the Kalman filter");
+
+  // PZ' is stored in Wtmp (only the upper triangle of Pstar is used)
+  for (size_t i = 0; i < n; ++i)
+    for (size_t j = 0; j < p; ++j)
+      {
+        size_t k = varobs_state[j];
+        Wtmp(i, j) = (i <= k ? Pstar(i, k) : Pstar(k, i));
+      }
+  // K=TPZ'
+  blas::gemm("N", "N", 1.0, T, Wtmp, 0.0, K);
+  // F=ZPZ'+H
+  for (size_t i = 0; i < p; ++i)
+    for (size_t j = 0; j < p; ++j)
+      F(i, j) = Wtmp(varobs_state[i], j) + H(i, j);
+  llconst = invertF();
+  // Kg=K*Finv
+  blas::symm("R", "U", 1.0, Finv, K, 0.0, Kg);
+  // Since Pstar solves the Lyapunov equation, P1-P0=-K*Finv*K', hence W=K and M=-Finv
+  W = K;
+  M = Finv;
+  mat::negate(M);
+  oldK = K;
+
+  for (size_t t = 0; t < dataView.getCols(); ++t)
+    {
+      // err= Yt - constant - Za
+      for (size_t i = 0; i < p; ++i)
+        vt(i) = dataView(i, t) - observationConstant(i) - a_init(varobs_state[i]);
+
+      blas::symv("U", 1.0, Finv, vt, 0.0, vtFinv);
+      ll = llconst-0.5*blas::dot(vtFinv, vt);
+
+      // at+1= T*at + Kg*err
+      blas::gemv("N", 1.0, T, a_init, 0.0, a_new);
+      blas::gemv("N", 1.0, Kg, vt, 1.0, a_new);
+      a_init = a_new;
+
+      if (nonstationary)
+        {
+          // ZW=W(Z,:)
+          for (size_t i = 0; i < p; ++i)
+            for (size_t j = 0; j < p; ++j)
+              ZW(i, j) = W(varobs_state[i], j);
+          // ZWM=ZW*M and ZWMWt=ZWM*W'
+          blas::gemm("N", "N", 1.0, ZW, M, 0.0, ZWM);
+          blas::gemm("N", "T", 1.0, ZWM, W, 0.0, ZWMWt);
+          // M=M+ZWM'*Finv*ZWM
+          blas::gemm("T", "N", 1.0, ZWM, Finv, 0.0, ZWMtFinv);
+          blas::gemm("N", "N", 1.0, ZWMtFinv, ZWM, 1.0, M);
+          // F=F+ZWMWt*Z'
+          for (size_t i = 0; i < p; ++i)
+            for (size_t j = 0; j < p; ++j)
+              F(i, j) += ZWMWt(i, varobs_state[j]);
+          // K=K+T*ZWMWt'
+          blas::gemm("N", "T", 1.0, T, ZWMWt, 1.0, K);
+          llconst = invertF();
+          blas::symm("R", "U", 1.0, Finv, K, 0.0, Kg);
+          // W=T*W-Kg*ZW
+          blas::gemm("N", "N", 1.0, T, W, 0.0, Wtmp);
+          blas::gemm("N", "N", -1.0, Kg, ZW, 1.0, Wtmp);
+          W = Wtmp;
+
+          // Once K has converged, F and the gain are kept for the remaining periods
+          nonstationary = mat::isDiff(K, oldK, riccati_tol);
+          oldK = K;
+        }
+
+      vll(t) = ll;
+      if (t >= start)
+        loglik += ll;
+    }
+
+  return loglik;
+}
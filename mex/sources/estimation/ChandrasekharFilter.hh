@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if !defined(CHANDRASEKHAR_FILTER_HH_INCLUDED)
+#define CHANDRASEKHAR_FILTER_HH_INCLUDED
+
+#include "KalmanFilter.hh"
+
+/**
+ * Kalman filter using the Chandrasekhar recursions: instead of the Riccati
+ * update of P, which costs O(mm^3) per period, the increment of P is
+ * factorized as W*M*W' (W is mm*nob, M is nob*nob), and only W, M, the gain and F are
+ * updated, at a O(mm^2*nob) cost. This pays off for models with many states
+ * and few observables.
+ *
+ * The recursions require P to start from the stationary solution of the
+ * Lyapunov equation, so Pstar is recomputed at the beginning of every
+ * sub-sample (the fast_kalman_filter option of the Matlab code).
+ *
+ * REFERENCES
+ *   "Using the ``Chandrasekhar Recursions'' for Likelihood Evaluation of DSGE
+ *   Models", E. Herbst (2015, in Computational Economics, vol. 45(4),
+ *   pp. 693-705).
+ */
+
+class ChandrasekharFilter
+{
+
+public:
+  virtual
+  ~ChandrasekharFilter();
+  ChandrasekharFilter(const std::string &basename, size_t n_endo, size_t n_exo, const std::vector<size_t> &zeta_fwrd_arg,
+                      const std::vector<size_t> &zeta_back_arg, const std::vector<size_t> &zeta_mixed_arg, const std::vector<size_t> &zeta_static_arg,
+                      double qz_criterium_arg, const std::vector<size_t> &varobs_arg,
+                      double riccati_tol_arg, double lyapunov_tol_arg,
+                      bool noconstant_arg, double lyapunov_fixed_point_tol_arg = 0.0);
+
+  template <class Vec1, class Vec2, class Mat1>
+  double
+  compute(const MatrixConstView &dataView, Vec1 &steadyState,
+          const Mat1 &Q, const Matrix &H, const Vec2 &deepParams,
+          VectorView &vll, size_t start, size_t period)
+  {
+    initKalmanFilter.initialize(steadyState, deepParams, R, Q, RQRt, T, Pstar, Pinf,
+                                observationConstant);
+
+    // The steady state is subtracted from the observations as they are read
+    return filter(dataView, H, vll, start);
+  }
+
+private:
+  const std::vector<size_t> zeta_varobs_back_mixed;
+  std::vector<size_t> varobs_state; // position in the state vector of each observed variable
+  Matrix T;   //mm*mm transition matrix of the state equation.
+  Matrix R;   //mm*rr matrix, mapping structural innovations to state variables.
+  Matrix Pstar; //mm*mm variance-covariance matrix of stationary variables
+  Matrix Pinf;  //mm*mm variance-covariance matrix of diffuse variables
+  Matrix RQRt;  //mm*mm variance-covariance matrix of variable disturbances
+  Matrix F, Finv;  // nob*nob F=ZPZt +H an inv(F)
+  Matrix K, oldK, Kg; // mm*nob K=TPZt, its value in the previous period and the gain Kg=K*Finv
+  Matrix W, Wtmp; // mm*nob factor of the increment of P
+  Matrix M, ZW, ZWM, ZWMtFinv; // nob*nob middle factor of the increment of P and intermediary matrices
+  Matrix ZWMWt; // nob*mm intermediary matrix
+  Vector a_init, a_new; // state vector
+  Vector vt; // current observation error vectors
+  Vector vtFinv; // intermediate observation error *Finv vector
+  Vector observationConstant; // nob constant (steady state) subtracted from the observations
+  double riccati_tol;
+  InitializeKalmanFilter initKalmanFilter; //Initialise KF matrices
+  Vector FUTP; // F upper triangle packed as vector FUTP(i + (j-1)*j/2) = F(i,j) for 1<=i<=j;
+
+  // Methods
+  double filter(const MatrixConstView &dataView,  const Matrix &H, VectorView &vll, size_t start);
+  // Computes Finv and returns the constant part of the period likelihood
+  double invertF();
+
+};
+
+#endif // !defined(CHANDRASEKHAR_FILTER_HH_INCLUDED)
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
+#include "ConditionalForecast.hh"
+#include "BlasBindings.hh"
+#include "QRDecomposition.hh"
+
+ConditionalForecast::ConditionalForecast(const Matrix &T_arg, const Matrix &R_arg, const std::vector<size_t> &constrainedVars,
+                                         const std::vector<size_t> &controlledShocks) throw (std::invalid_argument, std::runtime_error) :
+  n(T_arg.getRows()), nexo(R_arg.getCols()), nc(constrainedVars.size()), T(T_arg), R(R_arg),
+  Qt(nc), QR(nc), Tv(nc, n), Rv(nc, nexo), Rmu(n, nc)
+{
+  if (T.getCols() != n || R.getRows() != n)
+    throw std::invalid_argument("ConditionalForecast: T and R have inconsistent dimensions");
+  if (controlledShocks.size() != nc)
+    throw std::invalid_argument("ConditionalForecast: the number of constrained variables doesn't match the number of controlled shocks");
+
+  for (size_t i = 0; i < nc; i++)
+    {
+      if (constrainedVars[i] >= n || controlledShocks[i] >= nexo)
+        throw std::invalid_argument("ConditionalForecast: index of a constrained variable or of a controlled shock out of range");
+      for (size_t j = 0; j < n; j++)
+        Tv(i, j) = T(constrainedVars[i], j);
+      for (size_t j = 0; j < nexo; j++)
+        Rv(i, j) = R(constrainedVars[i], j);
+      for (size_t j = 0; j < n; j++)
+        Rmu(j, i) = R(j, controlledShocks[i]);
+      for (size_t j = 0; j < nc; j++)
+        QR(i, j) = R(constrainedVars[i], controlledShocks[j]);
+    }
+
+  if (nc == 0)
+    return;
+
+  // R(constrainedVars, controlledShocks) = Q*U, computed once for all the periods and replications
+  double norm = mat::nrminf(QR);
+  QRDecomposition qr(nc, nc, nc);
+  Qt.setAll(0.0);
+  for (size_t i = 0; i < nc; i++)
+    Qt(i, i) = 1.0;
+  qr.computeAndLeftMultByQ(QR, "T", Qt);
+  for (size_t i = 0; i < nc; i++)
+    if (fabs(QR(i, i)) <= nc*DBL_EPSILON*norm)
+      throw std::runtime_error("ConditionalForecast: the controlled shocks have a singular impact on the constrained variables");
+}
+
+void
+ConditionalForecast::simulate(size_t cL, size_t periods, size_t replic, const MatrixConstView &paths,
+                              const MatrixConstView &shocks, MatrixView &forcs, MatrixView &controlled,
+                              int number_of_threads) const
+{
+  assert(cL <= periods && paths.getRows() == nc && paths.getCols() >= cL);
+  assert(shocks.getRows() == nexo && shocks.getCols() == periods*replic);
+  assert(forcs.getRows() == n && forcs.getCols() == (periods+1)*replic);
+  assert(controlled.getRows() == nc && controlled.getCols() == cL*replic);
+  if (nc == 0)
+    cL = 0;
+
+  size_t nblocks = (replic + blockSize - 1)/blockSize;
+  const size_t ldf = forcs.getLd(), lds = shocks.getLd(), lde = controlled.getLd();
+#ifdef USE_OMP
+# pragma omp parallel num_threads(number_of_threads)
+#endif
+  {
+    Matrix tmp(nc, blockSize);
+
+#ifdef USE_OMP
+# pragma omp for schedule(dynamic)
+#endif
+    for (int blk = 0; blk < (int) nblocks; blk++)
+      {
+        // The replications of the block are the columns of strided views of the arrays
+        size_t b0 = blk*blockSize, nb = std::min(blockSize, replic - b0);
+        for (size_t t = 0; t < periods; t++)
+          {
+            MatrixConstView y0(forcs.getData() + (b0*(periods+1) + t)*ldf, n, nb, (periods+1)*ldf);
+            MatrixView y1(forcs.getData() + (b0*(periods+1) + t + 1)*ldf, n, nb, (periods+1)*ldf);
+            MatrixConstView u(shocks.getData() + (b0*periods + t)*lds, nexo, nb, periods*lds);
+
+            // y_t = T*y_t-1 + R*u_t
+            blas::gemm("N", "N", 1.0, T, y0, 0.0, y1);
+            blas::gemm("N", "N", 1.0, R, u, 1.0, y1);
+            if (t >= cL)
+              continue;
+
+            // e_t = inv(U)*Q'*(path_t - mv*T*y_t-1 - mv*R*u_t), and y_t += R*mu*e_t
+            MatrixView rhs(tmp, 0, 0, nc, nb);
+            MatrixView e(controlled.getData() + (b0*cL + t)*lde, nc, nb, cL*lde);
+            for (size_t j = 0; j < nb; j++)
+              for (size_t i = 0; i < nc; i++)
+                rhs(i, j) = paths(i, t);
+            blas::gemm("N", "N", -1.0, Tv, y0, 1.0, rhs);
+            blas::gemm("N", "N", -1.0, Rv, u, 1.0, rhs);
+            blas::gemm("N", "N", 1.0, Qt, rhs, 0.0, e);
+            blas::trsm("L", "U", "N", "N", 1.0, QR, e);
+            blas::gemm("N", "N", 1.0, Rmu, e, 1.0, y1);
+          }
+      }
+  }
+}
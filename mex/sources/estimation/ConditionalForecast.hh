@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if !defined(CONDITIONAL_FORECAST_HH_INCLUDED)
+#define CONDITIONAL_FORECAST_HH_INCLUDED
+
+#include <vector>
+#include <stdexcept>
+
+#include "Vector.hh"
+#include "Matrix.hh"
+
+/**
+ * Conditional forecasts of the state space model y_t = T*y_t-1 + R*u_t, as
+ * in mcforecast3.m: during the first periods, the controlled shocks are
+ * chosen so that the constrained variables follow given paths.
+ *
+ * With mv selecting the constrained variables and mu the controlled shocks,
+ * the controlled shocks of period t are
+ *   e_t = inv(mv*R*mu)*(path_t - mv*T*y_t-1 - mv*R*u_t)
+ * The square matrix mv*R*mu does not depend on the period nor on the
+ * replication, so its QR decomposition is computed once, and the controlled
+ * shocks of a block of replications are obtained by a single solve with
+ * multiple right hand sides. The blocks of replications are processed in
+ * parallel.
+ */
+class ConditionalForecast
+{
+public:
+  /*!
+    \param T n*n transition matrix
+    \param R n*nexo impact matrix of the shocks
+    \param constrainedVars Indices (0-based) of the constrained variables
+    \param controlledShocks Indices (0-based) of the controlled shocks, as many as the constrained variables
+  */
+  ConditionalForecast(const Matrix &T, const Matrix &R, const std::vector<size_t> &constrainedVars,
+                      const std::vector<size_t> &controlledShocks) throw (std::invalid_argument, std::runtime_error);
+  virtual ~ConditionalForecast()
+  {
+  };
+
+  /*!
+    \param cL Number of constrained periods (0 for unconditional forecasts)
+    \param periods Number of forecast periods H
+    \param replic Number of replications
+    \param paths nc*cL, the paths of the constrained variables
+    \param shocks nexo*(H*replic), the shocks of the periods 1 to H of each replication (replication b in columns b*H to b*H+H-1), with zeros for the controlled shocks
+    \param[in,out] forcs n*((H+1)*replic), the forecasts (replication b in columns b*(H+1) to b*(H+1)+H); on input, the first column of each replication holds the initial state
+    \param[out] controlled nc*(cL*replic), the controlled shocks of the constrained periods (replication b in columns b*cL to b*cL+cL-1)
+  */
+  void simulate(size_t cL, size_t periods, size_t replic, const MatrixConstView &paths,
+                const MatrixConstView &shocks, MatrixView &forcs, MatrixView &controlled,
+                int number_of_threads) const;
+
+private:
+  const size_t n, nexo, nc;
+  const Matrix T, R;
+  //! QR decomposition of R(constrainedVars, controlledShocks): Q' and the upper triangle of QR
+  Matrix Qt, QR;
+  //! T(constrainedVars, :) and R(constrainedVars, :)
+  Matrix Tv, Rv;
+  //! R(:, controlledShocks)
+  Matrix Rmu;
+  //! Number of replications solved together
+  static const size_t blockSize = 64;
+};
+
+#endif // !defined(CONDITIONAL_FORECAST_HH_INCLUDED)
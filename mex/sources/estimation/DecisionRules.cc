@@ -23,12 +23,14 @@
 
 #include "DecisionRules.hh"
 
+const double DecisionRules::stein_tol = 1e-15;
+
 DecisionRules::DecisionRules(size_t n_arg, size_t p_arg,
                              const std::vector<size_t> &zeta_fwrd_arg,
                              const std::vector<size_t> &zeta_back_arg,
                              const std::vector<size_t> &zeta_mixed_arg,
                              const std::vector<size_t> &zeta_static_arg,
-                             double qz_criterium) :
+                             double qz_criterium, double cycle_reduction_tol) :
   n(n_arg), p(p_arg), zeta_fwrd(zeta_fwrd_arg), zeta_back(zeta_back_arg),
   zeta_mixed(zeta_mixed_arg), zeta_static(zeta_static_arg),
   n_fwrd(zeta_fwrd.size()), n_back(zeta_back.size()),
@@ -55,7 +57,16 @@ DecisionRules::DecisionRules(size_t n_arg, size_t p_arg,
   g_y_static_tmp(n_fwrd_mixed, n_back_mixed),
   g_u_tmp1(n, n_back_mixed),
   g_u_tmp2(n),
-  LU4(n)
+  LU4(n),
+  X(n), X_lu(n), K_d(n, n_fwrd_mixed), M_d(n, n_back_mixed), W_d(n_fwrd_mixed, n_back_mixed),
+  W_tmp(n_fwrd_mixed, n_back_mixed), A_d(n_fwrd_mixed), A_tmp(n_fwrd_mixed), B_d(n_back_mixed),
+  B_tmp(n_back_mixed), AW_d(n_fwrd_mixed, n_back_mixed), g_y_fwrd_d(n_fwrd_mixed, n_back_mixed),
+  g_y_back_d(n_back_mixed), dA_g(n, n_back_mixed), dX(n),
+  LU5(n),
+  use_cycle_reduction(cycle_reduction_tol > 0.0),
+  A0_cr(use_cycle_reduction ? n_dynamic : 0), A1_cr(use_cycle_reduction ? n_dynamic : 0),
+  A2_cr(use_cycle_reduction ? n_dynamic : 0), g_y_dynamic_cr(use_cycle_reduction ? n_dynamic : 0),
+  CR(use_cycle_reduction ? n_dynamic : 0, cycle_reduction_tol)
 {
   assert(n == n_back + n_fwrd + n_mixed + n_static);
 
@@ -84,6 +95,14 @@ DecisionRules::DecisionRules(size_t n_arg, size_t p_arg,
       pi_fwrd.push_back(i);
     else
       beta_fwrd.push_back(i);
+
+  // zeta_dynamic is sorted, and contains zeta_back_mixed and zeta_fwrd_mixed
+  for (size_t i = 0; i < n_back_mixed; i++)
+    back_in_dynamic.push_back(lower_bound(zeta_dynamic.begin(), zeta_dynamic.end(), zeta_back_mixed[i])
+                              - zeta_dynamic.begin());
+  for (size_t i = 0; i < n_fwrd_mixed; i++)
+    fwrd_in_dynamic.push_back(lower_bound(zeta_dynamic.begin(), zeta_dynamic.end(), zeta_fwrd_mixed[i])
+                              - zeta_dynamic.begin());
 }
 
 void
@@ -104,6 +123,51 @@ DecisionRules::compute(const Matrix &jacobian, Matrix &g_y, Matrix &g_u) throw (
       QR.computeAndLeftMultByQ(S, "T", A);
     }
 
+  if (use_cycle_reduction)
+    computeByCycleReduction(g_y);
+  else
+    computeByGeneralizedSchur(g_y);
+  const Matrix &g_y_fwrd = Z21;
+
+  // Compute DR for static variables w.r. to endogenous
+  if (n_static > 0)
+    {
+      g_y_static = MatrixView(A, 0, 0, n_static, n_back_mixed);
+      for (size_t i = 0; i < n_dynamic; i++)
+        {
+          mat::row_copy(g_y, zeta_dynamic[i], g_y_dynamic, i);
+          mat::col_copy(A, n_back_mixed + zeta_dynamic[i], 0, n_static, A0d, i, 0);
+        }
+      blas::gemm("N", "N", 1.0, A0d, g_y_dynamic, 1.0, g_y_static);
+      blas::gemm("N", "N", 1.0, g_y_fwrd, g_y_back, 0.0, g_y_static_tmp);
+      blas::gemm("N", "N", 1.0, MatrixView(A, 0, n_back_mixed + n, n_static, n_fwrd_mixed),
+                 g_y_static_tmp, 1.0, g_y_static);
+      for (size_t i = 0; i < n_static; i++)
+        mat::col_copy(A, n_back_mixed + zeta_static[i], 0, n_static, A0s, i, 0);
+      LU3.invMult("N", A0s, g_y_static);
+      mat::negate(g_y_static);
+
+      for (size_t i = 0; i < n_static; i++)
+        mat::row_copy(g_y_static, i, g_y, zeta_static[i]);
+    }
+
+  // Compute DR for all endogenous w.r. to shocks
+  blas::gemm("N", "N", 1.0, MatrixConstView(jacobian, 0, n_back_mixed + n, n, n_fwrd_mixed), g_y_fwrd, 0.0, g_u_tmp1);
+  g_u_tmp2 = MatrixConstView(jacobian, 0, n_back_mixed, n, n);
+  for (size_t i = 0; i < n_back_mixed; i++)
+    {
+      VectorView c1 = mat::get_col(g_u_tmp2, zeta_back_mixed[i]),
+        c2 = mat::get_col(g_u_tmp1, i);
+      vec::add(c1, c2);
+    }
+  g_u = MatrixConstView(jacobian, 0, n_back_mixed + n + n_fwrd_mixed, n, p);
+  LU4.invMult("N", g_u_tmp2, g_u);
+  mat::negate(g_u);
+}
+
+void
+DecisionRules::computeByGeneralizedSchur(Matrix &g_y) throw (BlanchardKahnException, GeneralizedSchurDecomposition::GSDException)
+{
   // Construct matrix D
   D.setAll(0.0);
   for (size_t i = 0; i < n_mixed; i++)
@@ -146,10 +210,9 @@ DecisionRules::compute(const Matrix &jacobian, Matrix &g_y, Matrix &g_u) throw (
       throw BlanchardKahnException(false, n_fwrd_mixed, n_fwrd + n_back + 2*n_mixed - sdim);
     }
   mat::negate(Z21);
-  const Matrix &g_y_fwrd = Z21;
 
   for (size_t i = 0; i < n_fwrd_mixed; i++)
-    mat::row_copy(g_y_fwrd, i, g_y, zeta_fwrd_mixed[i]);
+    mat::row_copy(Z21, i, g_y, zeta_fwrd_mixed[i]);
 
   // Compute DR for backward variables w.r. to endogenous
   MatrixView Z11_prime(Z_prime, 0, 0, n_back_mixed, n_back_mixed),
@@ -167,47 +230,144 @@ DecisionRules::compute(const Matrix &jacobian, Matrix &g_y, Matrix &g_u) throw (
   // TODO: avoid to copy mixed variables again, rather test it...
   for (size_t i = 0; i < n_back_mixed; i++)
     mat::row_copy(g_y_back, i, g_y, zeta_back_mixed[i]);
+}
 
-  // Compute DR for static variables w.r. to endogenous
-  if (n_static > 0)
+void
+DecisionRules::computeByCycleReduction(Matrix &g_y) throw (BlanchardKahnException)
+{
+  /* Solve A0 + A1*X + A2*X^2 = 0 on the dynamic equations, where X is the
+     decision rule of the dynamic variables w.r.t. their lagged values (see
+     dyn_first_order_solver.m) */
+  A0_cr.setAll(0.0);
+  for (size_t j = 0; j < n_back_mixed; j++)
+    mat::col_copy(A, j, n_static, n_dynamic, A0_cr, back_in_dynamic[j], 0);
+  for (size_t j = 0; j < n_dynamic; j++)
+    mat::col_copy(A, n_back_mixed + zeta_dynamic[j], n_static, n_dynamic, A1_cr, j, 0);
+  A2_cr.setAll(0.0);
+  for (size_t j = 0; j < n_fwrd_mixed; j++)
+    mat::col_copy(A, n_back_mixed + n + j, n_static, n_dynamic, A2_cr, fwrd_in_dynamic[j], 0);
+
+  try
     {
-      g_y_static = MatrixView(A, 0, 0, n_static, n_back_mixed);
-      for (size_t i = 0; i < n_dynamic; i++)
-        {
-          mat::row_copy(g_y, zeta_dynamic[i], g_y_dynamic, i);
-          mat::col_copy(A, n_back_mixed + zeta_dynamic[i], 0, n_static, A0d, i, 0);
-        }
-      blas::gemm("N", "N", 1.0, A0d, g_y_dynamic, 1.0, g_y_static);
-      blas::gemm("N", "N", 1.0, g_y_fwrd, g_y_back, 0.0, g_y_static_tmp);
-      blas::gemm("N", "N", 1.0, MatrixView(A, 0, n_back_mixed + n, n_static, n_fwrd_mixed),
-                 g_y_static_tmp, 1.0, g_y_static);
-      for (size_t i = 0; i < n_static; i++)
-        mat::col_copy(A, n_back_mixed + zeta_static[i], 0, n_static, A0s, i, 0);
-      LU3.invMult("N", A0s, g_y_static);
-      mat::negate(g_y_static);
+      CR.compute(A0_cr, A1_cr, A2_cr, g_y_dynamic_cr);
+    }
+  catch (CycleReduction::CRException &e)
+    {
+      throw BlanchardKahnException(e.info == 3, n_fwrd_mixed, -1);
+    }
 
-      for (size_t i = 0; i < n_static; i++)
-        mat::row_copy(g_y_static, i, g_y, zeta_static[i]);
+  // Only the columns of the backward and mixed variables are nonzero
+  for (size_t j = 0; j < n_back_mixed; j++)
+    {
+      for (size_t i = 0; i < n_fwrd_mixed; i++)
+        Z21(i, j) = g_y_dynamic_cr(fwrd_in_dynamic[i], back_in_dynamic[j]);
+      for (size_t i = 0; i < n_back_mixed; i++)
+        g_y_back(i, j) = g_y_dynamic_cr(back_in_dynamic[i], back_in_dynamic[j]);
     }
 
-  // Compute DR for all endogenous w.r. to shocks
-  blas::gemm("N", "N", 1.0, MatrixConstView(jacobian, 0, n_back_mixed + n, n, n_fwrd_mixed), g_y_fwrd, 0.0, g_u_tmp1);
-  g_u_tmp2 = MatrixConstView(jacobian, 0, n_back_mixed, n, n);
+  for (size_t i = 0; i < n_fwrd_mixed; i++)
+    mat::row_copy(Z21, i, g_y, zeta_fwrd_mixed[i]);
+  for (size_t i = 0; i < n_back_mixed; i++)
+    mat::row_copy(g_y_back, i, g_y, zeta_back_mixed[i]);
+}
+
+void
+DecisionRules::computeDerivatives(const Matrix &jacobian, const Matrix &d_jacobian, const Matrix &g_y, const Matrix &g_u,
+                                  Matrix &d_g_y, Matrix &d_g_u) throw (BlanchardKahnException)
+{
+  assert(d_jacobian.getRows() == n && d_jacobian.getCols() == jacobian.getCols());
+  assert(d_g_y.getRows() == n && d_g_y.getCols() == n_back_mixed);
+  assert(d_g_u.getRows() == n && d_g_u.getCols() == p);
+
+  MatrixConstView A_p(jacobian, 0, n_back_mixed + n, n, n_fwrd_mixed),
+    dA_m(d_jacobian, 0, 0, n, n_back_mixed), dA_0(d_jacobian, 0, n_back_mixed, n, n),
+    dA_p(d_jacobian, 0, n_back_mixed + n, n, n_fwrd_mixed), dA_u(d_jacobian, 0, n_back_mixed + n + n_fwrd_mixed, n, p);
+
+  for (size_t i = 0; i < n_fwrd_mixed; i++)
+    mat::row_copy(g_y, zeta_fwrd_mixed[i], g_y_fwrd_d, i);
+  for (size_t i = 0; i < n_back_mixed; i++)
+    mat::row_copy(g_y, zeta_back_mixed[i], g_y_back_d, i);
+
+  // X = A_0 + A_p*g_y_fwrd*S_back (as in compute())
+  X = MatrixConstView(jacobian, 0, n_back_mixed, n, n);
+  blas::gemm("N", "N", 1.0, A_p, g_y_fwrd_d, 0.0, dA_g);
   for (size_t i = 0; i < n_back_mixed; i++)
     {
-      VectorView c1 = mat::get_col(g_u_tmp2, zeta_back_mixed[i]),
-        c2 = mat::get_col(g_u_tmp1, i);
+      VectorView c1 = mat::get_col(X, zeta_back_mixed[i]), c2 = mat::get_col(dA_g, i);
       vec::add(c1, c2);
     }
-  g_u = MatrixConstView(jacobian, 0, n_back_mixed + n + n_fwrd_mixed, n, p);
-  LU4.invMult("N", g_u_tmp2, g_u);
-  mat::negate(g_u);
+
+  // M = -X^(-1)*(dA_m + dA_0*g_y + dA_p*g_y_fwrd*g_y_back), K = X^(-1)*A_p
+  M_d = dA_m;
+  blas::gemm("N", "N", 1.0, dA_0, g_y, 1.0, M_d);
+  blas::gemm("N", "N", 1.0, dA_p, g_y_fwrd_d, 0.0, dA_g);
+  blas::gemm("N", "N", 1.0, dA_g, g_y_back_d, 1.0, M_d);
+  mat::negate(M_d);
+  K_d = A_p;
+  try
+    {
+      X_lu = X;
+      LU5.invMult("N", X_lu, M_d);
+      X_lu = X;
+      LU5.invMult("N", X_lu, K_d);
+    }
+  catch (LUSolver::LUException &e)
+    {
+      throw BlanchardKahnException(false, n_fwrd_mixed, 0);
+    }
+
+  // Stein equation for the forward+mixed rows: W = M_fwrd - K_fwrd*W*g_y_back,
+  // i.e. W = sum_k (-K_fwrd)^k M_fwrd g_y_back^k, computed by doubling
+  for (size_t i = 0; i < n_fwrd_mixed; i++)
+    {
+      mat::row_copy(M_d, zeta_fwrd_mixed[i], W_d, i);
+      mat::row_copy(K_d, zeta_fwrd_mixed[i], A_d, i);
+    }
+  mat::negate(A_d);
+  B_d = g_y_back_d;
+  size_t k;
+  for (k = 0; k < stein_max_doublings; k++)
+    {
+      blas::gemm("N", "N", 1.0, A_d, W_d, 0.0, AW_d);
+      blas::gemm("N", "N", 1.0, AW_d, B_d, 0.0, W_tmp);
+      mat::add(W_d, W_tmp);
+      if (mat::nrminf(W_tmp) <= stein_tol*std::max(1.0, mat::nrminf(W_d)))
+        break;
+      blas::gemm("N", "N", 1.0, A_d, A_d, 0.0, A_tmp);
+      A_d = A_tmp;
+      blas::gemm("N", "N", 1.0, B_d, B_d, 0.0, B_tmp);
+      B_d = B_tmp;
+    }
+  if (k == stein_max_doublings)
+    throw BlanchardKahnException(false, n_fwrd_mixed, 0);
+
+  // d_g_y = M - K*W*g_y_back
+  d_g_y = M_d;
+  blas::gemm("N", "N", 1.0, W_d, g_y_back_d, 0.0, W_tmp);
+  blas::gemm("N", "N", -1.0, K_d, W_tmp, 1.0, d_g_y);
+
+  // d_g_u = -X^(-1)*(dA_u + dX*g_u), with dX = dA_0 + (dA_p*g_y_fwrd + A_p*d_g_y_fwrd)*S_back
+  for (size_t i = 0; i < n_fwrd_mixed; i++)
+    mat::row_copy(d_g_y, zeta_fwrd_mixed[i], g_y_fwrd_d, i);
+  blas::gemm("N", "N", 1.0, A_p, g_y_fwrd_d, 1.0, dA_g); // dA_g still contains dA_p*g_y_fwrd
+  dX = dA_0;
+  for (size_t i = 0; i < n_back_mixed; i++)
+    {
+      VectorView c1 = mat::get_col(dX, zeta_back_mixed[i]), c2 = mat::get_col(dA_g, i);
+      vec::add(c1, c2);
+    }
+  d_g_u = dA_u;
+  blas::gemm("N", "N", 1.0, dX, g_u, 1.0, d_g_u);
+  LU5.invMult("N", X, d_g_u);
+  mat::negate(d_g_u);
 }
 
 std::ostream &
 operator<<(std::ostream &out, const DecisionRules::BlanchardKahnException &e)
 {
-  if (e.order)
+  if (e.n_explosive_eigenvals < 0)
+    out << "The cycle reduction did not converge";
+  else if (e.order)
     out << "The Blanchard-Kahn order condition is not satisfied: you have " << e.n_fwrd_vars << " forward variables for " << e.n_explosive_eigenvals << " explosive eigenvalues";
   else
     out << "The Blanchard Kahn rank condition is not satisfied";
@@ -25,6 +25,7 @@
 #include "QRDecomposition.hh"
 #include "GeneralizedSchurDecomposition.hh"
 #include "LUSolver.hh"
+#include "CycleReduction.hh"
 
 class DecisionRules
 {
@@ -42,12 +43,26 @@ private:
   Matrix g_y_static, A0s, A0d, g_y_dynamic, g_y_static_tmp;
   Matrix g_u_tmp1, g_u_tmp2;
   LUSolver LU4;
+  // Work matrices of computeDerivatives()
+  Matrix X, X_lu, K_d, M_d, W_d, W_tmp, A_d, A_tmp, B_d, B_tmp, AW_d, g_y_fwrd_d, g_y_back_d, dA_g, dX;
+  LUSolver LU5;
+  //! Whether compute() uses cycle reduction instead of the generalized Schur decomposition
+  const bool use_cycle_reduction;
+  //! Positions in zeta_dynamic of the elements of zeta_back_mixed and zeta_fwrd_mixed
+  std::vector<size_t> back_in_dynamic, fwrd_in_dynamic;
+  // Work matrices of the cycle reduction (empty if it is not used)
+  Matrix A0_cr, A1_cr, A2_cr, g_y_dynamic_cr;
+  CycleReduction CR;
+  //! Tolerance and maximum number of doublings of the Stein equation solver of computeDerivatives()
+  static const double stein_tol;
+  static const size_t stein_max_doublings = 60;
 public:
   class BlanchardKahnException
   {
   public:
     //! True if the model fails the order condition. False if it fails the rank condition.
     const bool order;
+    //! n_explosive_eigenvals is -1 if the cycle reduction did not converge
     const int n_fwrd_vars, n_explosive_eigenvals;
     BlanchardKahnException(bool order_arg, int n_fwrd_vars_arg, int n_explosive_eigenvals_arg) : order(order_arg), n_fwrd_vars(n_fwrd_vars_arg), n_explosive_eigenvals(n_explosive_eigenvals_arg)
     {
@@ -55,10 +70,15 @@ public:
   };
   /*!
     The zetas are supposed to follow C convention (first vector index is zero).
+    \param cycle_reduction_tol If positive, the decision rules are computed by
+    cycle reduction with this tolerance (as with the dr=cycle_reduction
+    option), instead of the generalized Schur decomposition. The current
+    period jacobian of the dynamic variables must then be invertible.
   */
   DecisionRules(size_t n_arg, size_t p_arg, const std::vector<size_t> &zeta_fwrd_arg,
                 const std::vector<size_t> &zeta_back_arg, const std::vector<size_t> &zeta_mixed_arg,
-                const std::vector<size_t> &zeta_static_arg, double qz_criterium);
+                const std::vector<size_t> &zeta_static_arg, double qz_criterium,
+                double cycle_reduction_tol = 0.0);
   virtual ~DecisionRules()
   {
   };
@@ -67,8 +87,31 @@ public:
     \param jacobian First columns are backetermined vars at t-1 (in the order of zeta_back_mixed), then all vars at t (in the orig order), then forward vars at t+1 (in the order of zeta_fwrd_mixed), then exogenous vars.
   */
   void compute(const Matrix &jacobian, Matrix &g_y, Matrix &g_u) throw (BlanchardKahnException, GeneralizedSchurDecomposition::GSDException);
+  //! Computes the derivatives of the decision rules with respect to a parameter
+  /*!
+    \param jacobian The jacobian given to compute()
+    \param d_jacobian Its derivative with respect to the parameter (with the same layout)
+    \param g_y,g_u The decision rules returned by compute()
+    \param[out] d_g_y,d_g_u Their derivatives
+
+    Differentiating A_m + A_0*g_y + A_p*g_y_fwrd*g_y_back = 0 (where A_m, A_0,
+    A_p are the blocks of the jacobian for lagged, current and leaded variables,
+    and g_y_fwrd, g_y_back the rows of g_y for forward+mixed and backward+mixed
+    variables) gives X*d_g_y + A_p*d_g_y_fwrd*g_y_back = -(dA_m + dA_0*g_y + dA_p*g_y_fwrd*g_y_back),
+    with X = A_0 + A_p*g_y_fwrd*S_back. Its restriction to the forward+mixed
+    rows is a Stein equation, solved by the doubling algorithm, which converges
+    when the Blanchard-Kahn conditions hold.
+  */
+  void computeDerivatives(const Matrix &jacobian, const Matrix &d_jacobian, const Matrix &g_y, const Matrix &g_u,
+                          Matrix &d_g_y, Matrix &d_g_u) throw (BlanchardKahnException);
+  //! Returns the generalized eigenvalues of the last call to compute() (not available with cycle reduction)
   template<class Vec1, class Vec2>
   void getGeneralizedEigenvalues(Vec1 &eig_real, Vec2 &eig_cmplx);
+private:
+  //! Computes the rows of g_y for the dynamic variables, and stores g_y_fwrd in Z21 and g_y_back
+  void computeByGeneralizedSchur(Matrix &g_y) throw (BlanchardKahnException, GeneralizedSchurDecomposition::GSDException);
+  //! Same as computeByGeneralizedSchur(), using cycle reduction
+  void computeByCycleReduction(Matrix &g_y) throw (BlanchardKahnException);
 };
 
 std::ostream &operator<<(std::ostream &out, const DecisionRules::BlanchardKahnException &e);
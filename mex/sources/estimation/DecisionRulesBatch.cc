@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <limits>
+#include <algorithm>
+
+#include "DecisionRulesBatch.hh"
+#include <instrumentation.hh>
+
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
+DecisionRulesBatch::DecisionRulesBatch(size_t n_arg, size_t p_arg, const std::vector<size_t> &zeta_fwrd_arg,
+                                       const std::vector<size_t> &zeta_back_arg, const std::vector<size_t> &zeta_mixed_arg,
+                                       const std::vector<size_t> &zeta_static_arg, double qz_criterium,
+                                       int number_of_threads_arg, double cycle_reduction_tol) :
+  n(n_arg), p(p_arg), n_back_mixed(zeta_back_arg.size() + zeta_mixed_arg.size()),
+  n_jcols(n_arg + zeta_back_arg.size() + zeta_fwrd_arg.size() + 2*zeta_mixed_arg.size() + p_arg),
+  number_of_threads(std::max(number_of_threads_arg, 1)),
+  jacobian(number_of_threads, Matrix(n, n_jcols)), g_y_thread(number_of_threads, Matrix(n, n_back_mixed)),
+  g_u_thread(number_of_threads, Matrix(n, p))
+{
+  for (int t = 0; t < number_of_threads; ++t)
+    decisionRules.push_back(new DecisionRules(n, p, zeta_fwrd_arg, zeta_back_arg, zeta_mixed_arg, zeta_static_arg,
+                                              qz_criterium, cycle_reduction_tol));
+}
+
+DecisionRulesBatch::~DecisionRulesBatch()
+{
+  for (size_t t = 0; t < decisionRules.size(); ++t)
+    delete decisionRules[t];
+}
+
+void
+DecisionRulesBatch::compute(const double *jacobians, size_t ndraws, double *g_y, double *g_u, Info *info)
+{
+  INSTRUMENT_SCOPE("decision_rules_batch");
+
+#ifdef USE_OMP
+# pragma omp parallel for num_threads(number_of_threads) schedule(dynamic)
+#endif
+  for (int d = 0; d < (int) ndraws; ++d)
+    {
+#ifdef USE_OMP
+      int thread = omp_get_thread_num();
+#else
+      int thread = 0;
+#endif
+      Matrix &jac = jacobian[thread], &gy = g_y_thread[thread], &gu = g_u_thread[thread];
+      MatrixView g_y_draw(g_y + d*n*n_back_mixed, n, n_back_mixed, n), g_u_draw(g_u + d*n*p, n, p, n);
+
+      jac = MatrixConstView(jacobians + d*n*n_jcols, n, n_jcols, n);
+      info[d] = success;
+      try
+        {
+          decisionRules[thread]->compute(jac, gy, gu);
+          g_y_draw = gy;
+          g_u_draw = gu;
+        }
+      catch (DecisionRules::BlanchardKahnException &e)
+        {
+          if (!e.order)
+            info[d] = rankCondition;
+          else if (e.n_explosive_eigenvals >= 0 && e.n_explosive_eigenvals < e.n_fwrd_vars)
+            info[d] = indeterminacy;
+          else
+            info[d] = noStableEquilibrium;
+        }
+      catch (GeneralizedSchurDecomposition::GSDException &e)
+        {
+          info[d] = schurFailure;
+        }
+      if (info[d] != success)
+        {
+          g_y_draw.setAll(std::numeric_limits<double>::quiet_NaN());
+          g_u_draw.setAll(std::numeric_limits<double>::quiet_NaN());
+          INSTRUMENT_COUNT("decision_rules_batch_rejections", 1);
+        }
+    }
+}
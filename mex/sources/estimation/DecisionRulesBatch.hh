@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if !defined(DECISION_RULES_BATCH_HH_INCLUDED)
+#define DECISION_RULES_BATCH_HH_INCLUDED
+
+#include <vector>
+
+#include "DecisionRules.hh"
+
+/**
+ * First order decision rules of a batch of jacobians of the same structure,
+ * typically those of a model for many parameter draws (prior sampling,
+ * identification, SMC).
+ *
+ * The draws are processed in parallel, each thread having its own
+ * DecisionRules object, i.e. its own workspace, so that compute() does not
+ * allocate. A draw which fails the Blanchard-Kahn conditions is rejected as
+ * soon as the generalized Schur decomposition (or the cycle reduction) is
+ * done, before the decision rules of the static variables and g_u are
+ * computed.
+ *
+ * The jacobians, g_y and g_u are stacked in 3-D arrays (column-major, the
+ * draws along the last dimension), as Matlab arrays.
+ */
+class DecisionRulesBatch
+{
+public:
+  //! Outcome of each draw, with the codes of Matlab's print_info
+  enum Info
+    {
+      success = 0,
+      schurFailure = 2, //!< The generalized Schur decomposition failed
+      noStableEquilibrium = 3, //!< Too many explosive eigenvalues, or the cycle reduction did not converge
+      indeterminacy = 4, //!< Too few explosive eigenvalues
+      rankCondition = 5 //!< The Blanchard-Kahn rank condition is not satisfied
+    };
+
+  DecisionRulesBatch(size_t n_arg, size_t p_arg, const std::vector<size_t> &zeta_fwrd_arg,
+                     const std::vector<size_t> &zeta_back_arg, const std::vector<size_t> &zeta_mixed_arg,
+                     const std::vector<size_t> &zeta_static_arg, double qz_criterium,
+                     int number_of_threads_arg, double cycle_reduction_tol = 0.0);
+  virtual ~DecisionRulesBatch();
+
+  //! Number of columns of each jacobian (see DecisionRules::compute())
+  size_t
+  getJacobianCols() const
+  {
+    return n_jcols;
+  };
+  //! Number of columns of each g_y
+  size_t
+  getBackMixedNbr() const
+  {
+    return n_back_mixed;
+  };
+
+  /*!
+    \param[in] jacobians n*getJacobianCols()*ndraws array
+    \param[out] g_y n*getBackMixedNbr()*ndraws array
+    \param[out] g_u n*p*ndraws array
+    \param[out] info ndraws outcomes; g_y and g_u are NaN for the draws which failed
+  */
+  void compute(const double *jacobians, size_t ndraws, double *g_y, double *g_u, Info *info);
+
+private:
+  const size_t n, p, n_back_mixed, n_jcols;
+  const int number_of_threads;
+  //! One decision rules object and one set of buffers by thread
+  std::vector<DecisionRules *> decisionRules;
+  std::vector<Matrix> jacobian, g_y_thread, g_u_thread;
+
+  // Forbid copy (the decision rules objects are owned)
+  DecisionRulesBatch(const DecisionRulesBatch &);
+  DecisionRulesBatch &operator=(const DecisionRulesBatch &);
+};
+
+#endif // !defined(DECISION_RULES_BATCH_HH_INCLUDED)
@@ -44,3 +44,17 @@ DetrendData::detrend(const VectorView &SteadyState, const MatrixConstView &dataV
           detrendedDataView(i, j) = dataView(i, j) - SteadyState(varobs[i]);
     }
 };
+
+void
+DetrendData::observationConstant(const VectorView &SteadyState, Vector &constant) const
+{
+  for (size_t i = 0; i < varobs.size(); i++)
+    constant(i) = (noconstant ? 0.0 : SteadyState(varobs[i]));
+}
+
+void
+DetrendData::constantDerivative(const Vector &d_SteadyState, Vector &d_constant)
+{
+  for (size_t i = 0; i < varobs.size(); i++)
+    d_constant(i) = (noconstant ? 0.0 : d_SteadyState(varobs[i]));
+}
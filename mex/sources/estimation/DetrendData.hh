@@ -36,6 +36,10 @@ public:
   };
   DetrendData(const std::vector<size_t> &varobs_arg, bool noconstant_arg);
   void detrend(const VectorView &SteadyState, const MatrixConstView &dataView, MatrixView &detrendedDataView);
+  //! Constant subtracted from each observation by detrend(), for the filters which subtract it on the fly
+  void observationConstant(const VectorView &SteadyState, Vector &constant) const;
+  //! Derivative of the constant subtracted from the observations by detrend(), given that of the steady state
+  void constantDerivative(const Vector &d_SteadyState, Vector &d_constant);
 
 private:
   const std::vector<size_t> varobs;
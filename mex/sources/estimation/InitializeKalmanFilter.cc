@@ -37,8 +37,10 @@ InitializeKalmanFilter::InitializeKalmanFilter(const std::string &basename, size
                                                const std::vector<size_t> &varobs_arg,
                                                double qz_criterium_arg,
                                                double lyapunov_tol_arg,
-                                               bool noconstant_arg) :
+                                               bool noconstant_arg,
+                                               double lyapunov_fixed_point_tol_arg) :
   lyapunov_tol(lyapunov_tol_arg),
+  lyapunov_fixed_point_tol(lyapunov_fixed_point_tol_arg),
   zeta_varobs_back_mixed(zeta_varobs_back_mixed_arg),
   detrendData(varobs_arg, noconstant_arg),
   modelSolution(basename, n_endo_arg, n_exo_arg, zeta_fwrd_arg, zeta_back_arg,
@@ -47,7 +49,13 @@ InitializeKalmanFilter::InitializeKalmanFilter(const std::string &basename, size
   g_x(n_endo_arg, zeta_back_arg.size() + zeta_mixed_arg.size()),
   g_u(n_endo_arg, n_exo_arg),
   Rt(n_exo_arg, zeta_varobs_back_mixed.size()),
-  RQ(zeta_varobs_back_mixed.size(), n_exo_arg)
+  RQ(zeta_varobs_back_mixed.size(), n_exo_arg),
+  d_steadyState(n_endo_arg),
+  d_g_x(n_endo_arg, zeta_back_arg.size() + zeta_mixed_arg.size()),
+  d_g_u(n_endo_arg, n_exo_arg),
+  dR(zeta_varobs_back_mixed.size(), n_exo_arg),
+  dTmp(zeta_varobs_back_mixed.size(), zeta_varobs_back_mixed.size()),
+  dLyapV(zeta_varobs_back_mixed.size(), zeta_varobs_back_mixed.size())
 {
   std::vector<size_t> zeta_back_mixed;
   set_union(zeta_back_arg.begin(), zeta_back_arg.end(),
@@ -70,7 +78,10 @@ void
 InitializeKalmanFilter::setPstar(Matrix &Pstar, Matrix &Pinf, const Matrix &T, const Matrix &RQRt) throw (DiscLyapFast::DLPException)
 {
 
-  discLyapFast.solve_lyap(T, RQRt, Pstar, lyapunov_tol, 0);
+  if (lyapunov_fixed_point_tol > 0.0)
+    discLyapFast.solve_lyap_warm(T, RQRt, Pstar, lyapunov_fixed_point_tol, lyapunov_tol);
+  else
+    discLyapFast.solve_lyap(T, RQRt, Pstar, lyapunov_tol, 0);
 
   Pinf.setAll(0.0);
 }
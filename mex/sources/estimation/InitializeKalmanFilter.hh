@@ -42,13 +42,15 @@ class InitializeKalmanFilter
 public:
   /*!
     \param[in] zeta_varobs_back_mixed_arg The union of indices of observed, backward and mixed variables
+    \param[in] lyapunov_fixed_point_tol_arg If positive, Pstar is computed by fixed point iterations
+    started from its value for the previous parameters, with this tolerance (see DiscLyapFast::solve_lyap_warm)
   */
   InitializeKalmanFilter(const std::string &basename, size_t n_endo, size_t n_exo, const std::vector<size_t> &zeta_fwrd_arg,
                          const std::vector<size_t> &zeta_back_arg, const std::vector<size_t> &zeta_mixed_arg, const std::vector<size_t> &zeta_static_arg,
                          const std::vector<size_t> &zeta_varobs_back_mixed_arg,
                          const std::vector<size_t> &varobs_arg,
                          double qz_criterium_arg, double lyapunov_tol_arg,
-                         bool noconstant_arg);
+                         bool noconstant_arg, double lyapunov_fixed_point_tol_arg = 0.0);
   virtual
   ~InitializeKalmanFilter();
   // initialise parameter dependent KF matrices only but not Ps
@@ -78,8 +80,80 @@ public:
     setPstar(Pstar, Pinf, T, RQRt);
   }
 
+  // initialise parameter dependent KF matrices only, and the constant that
+  // the filter subtracts from the observations instead of detrending them
+  template <class Vec1, class Vec2, class Mat1, class Mat2>
+  void
+  initialize(Vec1 &steadyState, const Vec2 &deepParams, Mat1 &R,
+             const Mat2 &Q, Matrix &RQRt, Matrix &T, Vector &observationConstant)
+  {
+    modelSolution.compute(steadyState, deepParams, g_x, g_u);
+    detrendData.observationConstant(steadyState, observationConstant);
+
+    setT(T);
+    setRQR(R, Q, RQRt);
+  }
+
+  // initialise all KF matrices, and the constant of the observations
+  template <class Vec1, class Vec2, class Mat1, class Mat2>
+  void
+  initialize(Vec1 &steadyState, const Vec2 &deepParams, Mat1 &R,
+             const Mat2 &Q, Matrix &RQRt, Matrix &T, Matrix &Pstar, Matrix &Pinf,
+             Vector &observationConstant)
+  {
+    initialize(steadyState, deepParams, R, Q, RQRt, T, observationConstant);
+    setPstar(Pstar, Pinf, T, RQRt);
+  }
+
+  //! Computes the derivatives of the KF matrices with respect to an estimated parameter
+  /*!
+    Must be called after the initialize() method computing Pstar, with the same arguments and its results.
+    \param[in] deepParamIndex Index of the parameter in the deep parameters, or -1 if it does not enter the model (e.g. a standard deviation)
+    \param[in] dQ Derivative of Q
+    \param[out] dT,dRQRt,dPstar Derivatives of T, RQR' and Pstar
+    \param[out] d_constant Derivative of the constant subtracted from the observations
+  */
+  template <class Vec1, class Vec2, class Mat1, class Mat2>
+  void
+  computeDerivatives(const Vec1 &steadyState, const Vec2 &deepParams, int deepParamIndex, const Mat1 &R, const Mat2 &Q,
+                     const Matrix &dQ, const Matrix &T, const Matrix &Pstar,
+                     Matrix &dT, Matrix &dRQRt, Matrix &dPstar, Vector &d_constant)
+    throw (DecisionRules::BlanchardKahnException, SteadyStateSolver::SteadyStateException, DiscLyapFast::DLPException)
+  {
+    dT.setAll(0.0);
+    if (deepParamIndex >= 0)
+      {
+        modelSolution.computeDerivatives(steadyState, deepParams, deepParamIndex, g_x, g_u, d_steadyState, d_g_x, d_g_u);
+        mat::assignByVectors(dT, mat::nullVec, pi_bm_vbm, d_g_x, zeta_varobs_back_mixed, mat::nullVec);
+        mat::assignByVectors(dR, mat::nullVec, mat::nullVec, d_g_u, zeta_varobs_back_mixed, mat::nullVec);
+        detrendData.constantDerivative(d_steadyState, d_constant);
+      }
+    else
+      {
+        dR.setAll(0.0);
+        d_constant.setAll(0.0);
+      }
+
+    // dRQR' = dR*Q*R' + R*Q*dR' + R*dQ*R'
+    blas::gemm("N", "N", 1.0, R, Q, 0.0, RQ);
+    blas::gemm("N", "T", 1.0, RQ, dR, 0.0, dTmp);
+    mat::transpose(dRQRt, dTmp);
+    mat::add(dRQRt, dTmp);
+    blas::gemm("N", "N", 1.0, R, dQ, 0.0, RQ);
+    blas::gemm("N", "T", 1.0, RQ, R, 1.0, dRQRt);
+
+    // dPstar = T*dPstar*T' + dT*Pstar*T' + T*Pstar*dT' + dRQR'
+    blas::gemm("N", "T", 1.0, Pstar, dT, 0.0, dTmp);
+    blas::gemm("N", "N", 1.0, T, dTmp, 0.0, dLyapV);
+    mat::transpose(dTmp, dLyapV);
+    mat::add(dLyapV, dTmp);
+    mat::add(dLyapV, dRQRt);
+    discLyapFast.solve_lyap(T, dLyapV, dPstar, lyapunov_tol, 0);
+  }
+
 private:
   const double lyapunov_tol;
+  const double lyapunov_fixed_point_tol;
   const std::vector<size_t> zeta_varobs_back_mixed;
   //! Indices of back+mixed zetas inside varobs+back+mixed zetas
   std::vector<size_t> pi_bm_vbm;
@@ -90,6 +164,9 @@ private:
   Matrix g_x;
   Matrix g_u;
   Matrix Rt, RQ;
+  // Work arrays of computeDerivatives()
+  Vector d_steadyState;
+  Matrix d_g_x, d_g_u, dR, dTmp, dLyapV;
   void setT(Matrix &T);
 
   template <class Mat1, class Mat2>
@@ -23,9 +23,16 @@
 //  Created on:      02-Feb-2010 12:44:41
 ///////////////////////////////////////////////////////////
 
+#include <stdexcept>
+#include <algorithm>
+
 #include "KalmanFilter.hh"
 #include "LapackBindings.hh"
 
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
 KalmanFilter::~KalmanFilter()
 {
 
@@ -36,17 +43,26 @@ KalmanFilter::KalmanFilter(const std::string &basename, size_t n_endo, size_t n_
                            const std::vector<size_t> &zeta_mixed_arg, const std::vector<size_t> &zeta_static_arg,
                            double qz_criterium_arg, const std::vector<size_t> &varobs_arg,
                            double riccati_tol_arg, double lyapunov_tol_arg,
-                           bool noconstant_arg) :
+                           bool noconstant_arg, double lyapunov_fixed_point_tol_arg) :
   zeta_varobs_back_mixed(compute_zeta_varobs_back_mixed(zeta_back_arg, zeta_mixed_arg, varobs_arg)),
   Z(varobs_arg.size(), zeta_varobs_back_mixed.size()), Zt(Z.getCols(), Z.getRows()), T(zeta_varobs_back_mixed.size()), R(zeta_varobs_back_mixed.size(), n_exo),
   Pstar(zeta_varobs_back_mixed.size(), zeta_varobs_back_mixed.size()), Pinf(zeta_varobs_back_mixed.size(), zeta_varobs_back_mixed.size()),
   RQRt(zeta_varobs_back_mixed.size(), zeta_varobs_back_mixed.size()), Ptmp(zeta_varobs_back_mixed.size(), zeta_varobs_back_mixed.size()), F(varobs_arg.size(), varobs_arg.size()),
-  Finv(varobs_arg.size(), varobs_arg.size()), K(zeta_varobs_back_mixed.size(), varobs_arg.size()), KFinv(zeta_varobs_back_mixed.size(), varobs_arg.size()),
+  Finv(varobs_arg.size(), varobs_arg.size()), oldF(varobs_arg.size(), varobs_arg.size()), K(zeta_varobs_back_mixed.size(), varobs_arg.size()), KFinv(zeta_varobs_back_mixed.size(), varobs_arg.size()),
   oldKFinv(zeta_varobs_back_mixed.size(), varobs_arg.size()), a_init(zeta_varobs_back_mixed.size()),
-  a_new(zeta_varobs_back_mixed.size()), vt(varobs_arg.size()), vtFinv(varobs_arg.size()), riccati_tol(riccati_tol_arg),
+  a_new(zeta_varobs_back_mixed.size()), vt(varobs_arg.size()), vtFinv(varobs_arg.size()), observationConstant(varobs_arg.size()),
+  riccati_tol(riccati_tol_arg),
   initKalmanFilter(basename, n_endo, n_exo, zeta_fwrd_arg, zeta_back_arg, zeta_mixed_arg,
-                   zeta_static_arg, zeta_varobs_back_mixed, varobs_arg, qz_criterium_arg, lyapunov_tol_arg, noconstant_arg),
-  FUTP(varobs_arg.size()*(varobs_arg.size()+1)/2)
+                   zeta_static_arg, zeta_varobs_back_mixed, varobs_arg, qz_criterium_arg, lyapunov_tol_arg, noconstant_arg,
+                   lyapunov_fixed_point_tol_arg),
+  FUTP(varobs_arg.size()*(varobs_arg.size()+1)/2), varobs_state(varobs_arg.size()),
+  oldPstar(zeta_varobs_back_mixed.size(), zeta_varobs_back_mixed.size()), Kuni(zeta_varobs_back_mixed.size(), varobs_arg.size()),
+  Funi(varobs_arg.size()), Ki(zeta_varobs_back_mixed.size()),
+  Wsparse(zeta_varobs_back_mixed.size(), zeta_varobs_back_mixed.size()),
+  dPZt(zeta_varobs_back_mixed.size(), varobs_arg.size()), FinvdF(varobs_arg.size(), varobs_arg.size()),
+  dFinv(varobs_arg.size(), varobs_arg.size()), PtmpTt(zeta_varobs_back_mixed.size(), zeta_varobs_back_mixed.size()),
+  dTPtmpTt(zeta_varobs_back_mixed.size(), zeta_varobs_back_mixed.size()), a_filt(zeta_varobs_back_mixed.size()),
+  da_filt(zeta_varobs_back_mixed.size()), dvt(varobs_arg.size()), dFvtFinv(varobs_arg.size())
 {
   Z.setAll(0.0);
   Zt.setAll(0.0);
@@ -56,6 +72,7 @@ KalmanFilter::KalmanFilter(const std::string &basename, size_t n_endo, size_t n_
                       varobs_arg[i]) - zeta_varobs_back_mixed.begin();
       Z(i, j) = 1.0;
       Zt(j, i) = 1.0;
+      varobs_state[i] = j;
     }
 }
 
@@ -78,16 +95,45 @@ KalmanFilter::compute_zeta_varobs_back_mixed(const std::vector<size_t> &zeta_bac
  * Multi-variate standard Kalman Filter
  */
 double
-KalmanFilter::filter(const MatrixView &detrendedDataView,  const Matrix &H, VectorView &vll, size_t start)
+KalmanFilter::filter(const MatrixConstView &dataView,  const Matrix &H, VectorView &vll, size_t start)
 {
-  double loglik = 0.0, ll, logFdet = 0.0, Fdet, dvtFinvVt;
+  INSTRUMENT_SCOPE("kalman_filter");
+  INSTRUMENT_COUNT("kalman_filter_periods", dataView.getCols());
+  double loglik = 0.0, ll, logFdet = 0.0, Fdet, dvtFinvVt, llconst = 0.0;
   size_t p = Finv.getRows();
-  bool nonstationary = true;
+  bool nonstationary = true, compare = false;
   a_init.setAll(0.0);
   int info;
 
-  for (size_t t = 0; t < detrendedDataView.getCols(); ++t)
+  findMissingObservations(dataView);
+
+  // The covariance prediction exploits the (block) sparsity of T, if any
+  T_sparse.compress(T.getData(), T.getLd(), T.getRows(), T.getCols());
+  sparse_T = T_sparse.isSparse();
+
+  // With uncorrelated measurement errors, the observations are processed one by one
+  bool diagonal_H = true;
+  for (size_t i = 0; i < p && diagonal_H; ++i)
+    for (size_t j = 0; j < p && diagonal_H; ++j)
+      if (i != j && H(i, j) != 0.0)
+        diagonal_H = false;
+  if (diagonal_H)
+    return univariate_filter(dataView, H, vll, start, 0, 0.0);
+
+  for (size_t t = 0; t < dataView.getCols(); ++t)
     {
+      if (incompletePeriod(t))
+        {
+          // The steady state of the filter, if reached, is left
+          ll = filterIncompletePeriod(dataView, H, t);
+          nonstationary = true;
+          compare = false;
+          vll(t) = ll;
+          if (t >= start)
+            loglik += ll;
+          continue;
+        }
+
       if (nonstationary)
         {
           // K=PZ'
@@ -136,7 +182,9 @@ KalmanFilter::filter(const MatrixView &detrendedDataView,  const Matrix &H, Vect
               info = lapack::choleskySolver(FUTP, Finv, "U"); // F now contains
                                                               // its Chol
                                                               // decomposition!
-              assert(info == 0);
+              assert(info >= 0);
+              if (info > 0)
+                throw std::runtime_error("KalmanFilter::filter: F is singular and the measurement errors are correlated");
             }
           // KFinv gain matrix
           blas::symm("R", "U", 1.0, Finv, K, 0.0, KFinv);
@@ -147,27 +195,28 @@ KalmanFilter::filter(const MatrixView &detrendedDataView,  const Matrix &H, Vect
           Fdet *= Fdet;
 
           logFdet = log(fabs(Fdet));
+          llconst = -0.5*(p*log(2*M_PI)+logFdet);
 
           Ptmp = Pstar;
           // Pt+1= T(Pt - KFinvK')T' +RQR'
           // 1) Ptmp= Pt - K*FinvK'
           blas::gemm("N", "T", -1.0, KFinv, K, 1.0, Ptmp);
-          // 2) Ptmp= T*Ptmp
+          // 2) Pt+1= T*Ptmp*T' +RQR'
           Pstar = Ptmp;
-          //blas::gemm("N", "N", 1.0, T, Pstar, 0.0, Ptmp);
-          blas::symm("R", "U", 1.0, Pstar, T, 0.0, Ptmp);
-          // 3) Pt+1= Ptmp*T' +RQR'
-          Pstar = RQRt;
-          blas::gemm("N", "T", 1.0, Ptmp, T, 1.0, Pstar);
+          predictCovariance();
 
-          if (t > 0)
-            nonstationary = mat::isDiff(KFinv, oldKFinv, riccati_tol);
+          /* Once both the gain and F have converged, P, F, Finv and the gain are
+             kept for the remaining periods (steady state Kalman filter) */
+          if (compare)
+            nonstationary = mat::isDiff(KFinv, oldKFinv, riccati_tol) || mat::isDiff(F, oldF, riccati_tol);
           oldKFinv = KFinv;
+          oldF = F;
+          compare = true;
         }
 
-      // err= Yt - Za
-      VectorConstView yt = mat::get_col(detrendedDataView, t);
-      vt = yt;
+      // err= Yt - constant - Za
+      for (size_t i = 0; i < p; ++i)
+        vt(i) = dataView(i, t) - observationConstant(i);
       blas::gemv("N", -1.0, Z, a_init, 1.0, vt);
 
       // at+1= T(at+ KFinv *err)
@@ -181,12 +230,375 @@ KalmanFilter::filter(const MatrixView &detrendedDataView,  const Matrix &H, Vect
       blas::symv("U", 1.0, Finv, vt, 0.0, vtFinv);
       dvtFinvVt = blas::dot(vtFinv, vt);
 
-      ll = -0.5*(p*log(2*M_PI)+logFdet+dvtFinvVt);
+      ll = llconst-0.5*dvtFinvVt;
+
+      vll(t) = ll;
+      if (t >= start)
+        loglik += ll;
+
+    }
+
+  return loglik;
+}
+
+/**
+ * Periods are grouped by pattern of observed variables, so that the indices of
+ * the observed variables and their positions in the state vector are only
+ * computed once by pattern. Nothing is allocated when the data are complete.
+ */
+bool
+KalmanFilter::findMissingObservations(const MatrixConstView &dataView)
+{
+  size_t p = varobs_state.size(), nper = dataView.getCols();
+  periodPattern.clear();
+  patternObserved.clear();
+  patternStates.clear();
+
+  bool missing = false;
+  for (size_t t = 0; t < nper && !missing; ++t)
+    for (size_t i = 0; i < p && !missing; ++i)
+      if (dataView(i, t) != dataView(i, t))
+        missing = true;
+  if (!missing)
+    return false;
+
+  periodPattern.resize(nper);
+  std::vector<size_t> observed;
+  for (size_t t = 0; t < nper; ++t)
+    {
+      observed.clear();
+      for (size_t i = 0; i < p; ++i)
+        if (dataView(i, t) == dataView(i, t))
+          observed.push_back(i);
+      size_t k = std::find(patternObserved.begin(), patternObserved.end(), observed) - patternObserved.begin();
+      if (k == patternObserved.size())
+        {
+          patternObserved.push_back(observed);
+          patternStates.push_back(std::vector<size_t>(observed.size()));
+          for (size_t i = 0; i < observed.size(); ++i)
+            patternStates.back()[i] = varobs_state[observed[i]];
+        }
+      periodPattern[t] = k;
+    }
+  INSTRUMENT_COUNT("kalman_filter_missing_patterns", patternObserved.size());
+  return true;
+}
+
+/**
+ * Multivariate update with the observed variables of period t only: with W
+ * the selection of the observed rows of Z, F=WZPZ'W'+WHW' is factorized and
+ * the prediction error is Wv. K, F, Finv and KFinv hold the reduced matrices
+ * in their leading elements.
+ */
+double
+KalmanFilter::filterIncompletePeriod(const MatrixConstView &dataView, const Matrix &H, size_t t)
+{
+  const std::vector<size_t> &observed = patternObserved[periodPattern[t]];
+  const std::vector<size_t> &states = patternStates[periodPattern[t]];
+  size_t pw = observed.size(), n = a_init.getSize();
+  double ll = 0.0;
+
+  if (pw > 0)
+    {
+      MatrixView Kw(K.getData(), n, pw, n), Finvw(Finv.getData(), pw, pw, pw), KFinvw(KFinv.getData(), n, pw, n);
+      VectorView vw(vt, 0, pw), vwFinv(vtFinv, 0, pw);
+
+      // Kw=PZ'W' (only the upper triangle of Pstar is up to date)
+      for (size_t j = 0; j < pw; ++j)
+        for (size_t k = 0; k < n; ++k)
+          Kw(k, j) = (k <= states[j] ? Pstar(k, states[j]) : Pstar(states[j], k));
+      // Pack the upper triangle of Fw=WZKw+WHW'
+      for (size_t j = 0; j < pw; ++j)
+        for (size_t i = 0; i <= j; ++i)
+          FUTP(i + j*(j+1)/2) = Kw(states[i], j) + H(observed[i], observed[j]);
+
+      mat::set_identity(Finvw);
+      int info = lapack::choleskySolver(FUTP, Finvw, "U");
+      assert(info >= 0);
+      if (info > 0)
+        throw std::runtime_error("KalmanFilter::filter: F is singular in a period with missing observations");
+
+      double logFdet = 0.0;
+      for (size_t d = 0; d < pw; ++d)
+        logFdet += 2*log(fabs(FUTP(d + d*(d+1)/2)));
+
+      for (size_t i = 0; i < pw; ++i)
+        vw(i) = dataView(observed[i], t) - observationConstant(observed[i]) - a_init(states[i]);
+
+      blas::symm("R", "U", 1.0, Finvw, Kw, 0.0, KFinvw);
+      blas::symv("U", 1.0, Finvw, vw, 0.0, vwFinv);
+      ll = -0.5*(pw*log(2*M_PI) + logFdet + blas::dot(vwFinv, vw));
+
+      // at=at+KFinv v, Pt=Pt-KFinv K'
+      blas::gemv("N", 1.0, KFinvw, vw, 1.0, a_init);
+      Ptmp = Pstar;
+      blas::gemm("N", "T", -1.0, KFinvw, Kw, 1.0, Ptmp);
+      Pstar = Ptmp;
+    }
+
+  // at+1=T at, Pt+1=T Pt T'+RQR'
+  blas::gemv("N", 1.0, T, a_init, 0.0, a_new);
+  a_init = a_new;
+  predictCovariance();
+
+  return ll;
+}
+
+/**
+ * Univariate Kalman filter: the observations of a period are processed one at
+ * a time, which only requires H to be diagonal and does not invert F
+ * (Koopman and Durbin, 2000). An observation whose prediction error has a
+ * variance below kalman_tol does not contribute to the likelihood.
+ */
+double
+KalmanFilter::univariate_filter(const MatrixConstView &dataView, const Matrix &H, VectorView &vll, size_t start, size_t first, double loglik)
+{
+  const double kalman_tol = 1e-10;
+  size_t p = varobs_state.size(), n = a_init.getSize();
+  bool nonstationary = true, incomplete = false, previousIncomplete = false;
+  MatrixView PstarView(Pstar, 0, 0, n, n);
+  VectorView KiView(Ki, 0, n);
+
+  for (size_t t = first; t < dataView.getCols(); ++t)
+    {
+      double ll = 0.0;
+      // The stored gains are those of the complete periods
+      incomplete = incompletePeriod(t);
+      if (incomplete)
+        nonstationary = true;
+      if (nonstationary)
+        oldPstar = Pstar;
+      for (size_t i = 0; i < p; ++i)
+        {
+          if (incomplete && dataView(i, t) != dataView(i, t))
+            continue;
+          size_t j = varobs_state[i];
+          double vi = dataView(i, t) - observationConstant(i) - a_init(j), Fi;
+          if (nonstationary)
+            {
+              // Ki=PZi', Fi=ZiPZi'+Hii (only the upper triangle of Pstar is up to date)
+              for (size_t k = 0; k < n; ++k)
+                Ki(k) = (k <= j ? Pstar(k, j) : Pstar(j, k));
+              Fi = Ki(j) + H(i, i);
+              Funi(i) = Fi;
+              for (size_t k = 0; k < n; ++k)
+                Kuni(k, i) = Ki(k);
+              // Pt=Pt-KiKi'/Fi
+              if (Fi > kalman_tol)
+                blas::syr("U", -1.0/Fi, KiView, PstarView);
+            }
+          else
+            Fi = Funi(i);
+          if (Fi > kalman_tol)
+            {
+              // at=at+Ki*vi/Fi
+              for (size_t k = 0; k < n; ++k)
+                a_init(k) += Kuni(k, i)*vi/Fi;
+              ll -= 0.5*(log(2*M_PI)+log(Fi)+vi*vi/Fi);
+            }
+        }
+
+      // at+1=T at
+      blas::gemv("N", 1.0, T, a_init, 0.0, a_new);
+      a_init = a_new;
+
+      if (nonstationary)
+        {
+          // Pt+1= T Pt T' +RQR'
+          predictCovariance();
+          // Once P has converged, the gains are kept for the remaining periods
+          if (t > first && !incomplete && !previousIncomplete)
+            nonstationary = mat::isDiffSym(Pstar, oldPstar, riccati_tol);
+        }
+      previousIncomplete = incomplete;
 
       vll(t) = ll;
       if (t >= start)
         loglik += ll;
+    }
 
+  return loglik;
+}
+
+void
+KalmanFilter::predictCovariance()
+{
+  if (sparse_T)
+    {
+      // The sparse product needs both triangles of Pstar
+      size_t n = Pstar.getRows();
+      for (size_t j = 0; j < n; ++j)
+        for (size_t i = j+1; i < n; ++i)
+          Pstar(i, j) = Pstar(j, i);
+#ifdef USE_OMP
+      int numthreads = omp_get_max_threads();
+#else
+      int numthreads = 1;
+#endif
+      T_sparse.symmetricProduct(Pstar.getData(), Pstar.getLd(), RQRt.getData(), RQRt.getLd(),
+                                Ptmp.getData(), Ptmp.getLd(), Wsparse.getData(), numthreads);
+      Pstar = Ptmp;
+    }
+  else
+    {
+      // Ptmp= T*Pt, Pt+1= Ptmp*T' +RQR'
+      blas::symm("R", "U", 1.0, Pstar, T, 0.0, Ptmp);
+      Pstar = RQRt;
+      blas::gemm("N", "T", 1.0, Ptmp, T, 1.0, Pstar);
+    }
+}
+
+void
+KalmanFilter::allocateScoreWorkspace(size_t nparams)
+{
+  if (dT.size() == nparams)
+    return;
+  size_t m = T.getRows(), p = varobs_state.size();
+  dT.assign(nparams, Matrix(m, m));
+  dRQRt.assign(nparams, Matrix(m, m));
+  dPstar.assign(nparams, Matrix(m, m));
+  dKFinv.assign(nparams, Matrix(m, p));
+  dF.assign(nparams, Matrix(p, p));
+  da.assign(nparams, Vector(m));
+  d_constant.assign(nparams, Vector(p));
+  trFinvdF.resize(nparams);
+}
+
+/**
+ * Multivariate Kalman filter differentiated with respect to the estimated
+ * parameters, as score.m and computeDKalman.m. From the derivatives dT, dRQR',
+ * dPstar and d_constant of the system matrices, it propagates those of the
+ * state vector (da), of its variance (dPstar), of F (dF) and of the gain (dKFinv):
+ *   dv = -d_constant - Z da
+ *   dlogL_t = -0.5*(tr(Finv dF) + 2 dv'Finv v - v'Finv dF Finv v)
+ *   da_t+1 = dT (a + KFinv v) + T (da + dKFinv v + KFinv dv)
+ *   dP_t+1 = dT Ptmp T' + T Ptmp dT' + T dPtmp T' + dRQR'
+ * where Ptmp = P - KFinv K'. Once the filter has reached its steady state,
+ * the derivatives of F and of the gain are frozen as well.
+ */
+double
+KalmanFilter::filterScore(const MatrixConstView &dataView, const Matrix &H, const std::vector<Matrix> &dH,
+                          VectorView &vll, size_t start, Vector &score)
+{
+  double loglik = 0.0, ll, logFdet = 0.0, Fdet, llconst = 0.0;
+  size_t p = Finv.getRows(), nparams = dT.size();
+  bool nonstationary = true;
+  int info;
+
+  if (findMissingObservations(dataView))
+    throw std::runtime_error("KalmanFilter::filterScore: the score is not available with missing observations");
+
+  a_init.setAll(0.0);
+  score.setAll(0.0);
+  for (size_t i = 0; i < nparams; ++i)
+    da[i].setAll(0.0);
+
+  for (size_t t = 0; t < dataView.getCols(); ++t)
+    {
+      if (nonstationary)
+        {
+          // K=PZ', F=ZK+H
+          blas::gemm("N", "N", 1.0, Pstar, Zt, 0.0, K);
+          F = H;
+          blas::gemm("N", "N", 1.0, Z, K, 1.0, F);
+
+          mat::set_identity(Finv);
+          for (size_t i = 1; i <= p; ++i)
+            for (size_t j = i; j <= p; ++j)
+              FUTP(i + (j-1)*j/2 -1) = F(i-1, j-1);
+          info = lapack::choleskySolver(FUTP, Finv, "U");
+          assert(info >= 0);
+          if (info > 0)
+            throw std::runtime_error("KalmanFilter::filterScore: F is singular");
+
+          blas::gemm("N", "N", 1.0, K, Finv, 0.0, KFinv);
+          Fdet = 1;
+          for (size_t d = 1; d <= p; ++d)
+            Fdet *= FUTP(d + (d-1)*d/2 -1);
+          Fdet *= Fdet;
+          logFdet = log(fabs(Fdet));
+          llconst = -0.5*(p*log(2*M_PI)+logFdet);
+
+          // Ptmp=P-KFinvK', PtmpTt=Ptmp*T'
+          Ptmp = Pstar;
+          blas::gemm("N", "T", -1.0, KFinv, K, 1.0, Ptmp);
+          blas::gemm("N", "T", 1.0, Ptmp, T, 0.0, PtmpTt);
+
+          for (size_t i = 0; i < nparams; ++i)
+            {
+              // dF=Z dP Z'+dH, dFinv=-Finv dF Finv
+              blas::gemm("N", "N", 1.0, dPstar[i], Zt, 0.0, dPZt);
+              dF[i] = dH[i];
+              blas::gemm("N", "N", 1.0, Z, dPZt, 1.0, dF[i]);
+              blas::gemm("N", "N", 1.0, Finv, dF[i], 0.0, FinvdF);
+              trFinvdF[i] = 0.0;
+              for (size_t j = 0; j < p; ++j)
+                trFinvdF[i] += FinvdF(j, j);
+              blas::gemm("N", "N", -1.0, FinvdF, Finv, 0.0, dFinv);
+
+              // dKFinv=dP Z' Finv + K dFinv
+              blas::gemm("N", "N", 1.0, dPZt, Finv, 0.0, dKFinv[i]);
+              blas::gemm("N", "N", 1.0, K, dFinv, 1.0, dKFinv[i]);
+
+              // dPtmp=dP-dKFinv K'-KFinv Z dP, stored in dPstar
+              blas::gemm("N", "T", -1.0, dKFinv[i], K, 1.0, dPstar[i]);
+              blas::gemm("N", "T", -1.0, KFinv, dPZt, 1.0, dPstar[i]);
+
+              // dPt+1 = dT Ptmp T' + (dT Ptmp T')' + T dPtmp T' + dRQR'
+              blas::gemm("N", "N", 1.0, dT[i], PtmpTt, 0.0, dTPtmpTt);
+              blas::gemm("N", "T", 1.0, dPstar[i], T, 0.0, Ptmp);
+              dPstar[i] = dRQRt[i];
+              blas::gemm("N", "N", 1.0, T, Ptmp, 1.0, dPstar[i]);
+              mat::add(dPstar[i], dTPtmpTt);
+              mat::transpose(Ptmp, dTPtmpTt);
+              mat::add(dPstar[i], Ptmp);
+            }
+
+          // Pt+1=T Ptmp T'+RQR'
+          Pstar = RQRt;
+          blas::gemm("N", "N", 1.0, T, PtmpTt, 1.0, Pstar);
+
+          if (t > 0)
+            nonstationary = mat::isDiff(KFinv, oldKFinv, riccati_tol) || mat::isDiff(F, oldF, riccati_tol);
+          oldKFinv = KFinv;
+          oldF = F;
+        }
+
+      // v=Yt-constant-Za, ll=llconst-0.5 v'Finv v
+      for (size_t i = 0; i < p; ++i)
+        vt(i) = dataView(i, t) - observationConstant(i);
+      blas::gemv("N", -1.0, Z, a_init, 1.0, vt);
+      blas::gemv("N", 1.0, Finv, vt, 0.0, vtFinv);
+      ll = llconst-0.5*blas::dot(vtFinv, vt);
+
+      // a+KFinv v
+      a_filt = a_init;
+      blas::gemv("N", 1.0, KFinv, vt, 1.0, a_filt);
+
+      for (size_t i = 0; i < nparams; ++i)
+        {
+          // dv=-d_constant-Z da
+          dvt = d_constant[i];
+          blas::gemv("N", -1.0, Z, da[i], -1.0, dvt);
+
+          blas::gemv("N", 1.0, dF[i], vtFinv, 0.0, dFvtFinv);
+          if (t >= start)
+            score(i) -= 0.5*(trFinvdF[i] + 2*blas::dot(dvt, vtFinv) - blas::dot(vtFinv, dFvtFinv));
+
+          // dat+1 = dT (a+KFinv v) + T (da + dKFinv v + KFinv dv)
+          da_filt = da[i];
+          blas::gemv("N", 1.0, dKFinv[i], vt, 1.0, da_filt);
+          blas::gemv("N", 1.0, KFinv, dvt, 1.0, da_filt);
+          blas::gemv("N", 1.0, dT[i], a_filt, 0.0, da[i]);
+          blas::gemv("N", 1.0, T, da_filt, 1.0, da[i]);
+        }
+
+      // at+1=T(a+KFinv v)
+      blas::gemv("N", 1.0, T, a_filt, 0.0, a_init);
+
+      vll(t) = ll;
+      if (t >= start)
+        loglik += ll;
     }
 
   return loglik;
@@ -27,10 +27,15 @@
 #define KF_213B0417_532B_4027_9EDF_36C004CB4CD1__INCLUDED_
 
 #include "InitializeKalmanFilter.hh"
+#include <sparse_transition.hh>
+#include <instrumentation.hh>
 
 /**
  * Vanilla Kalman filter without constant and with measurement error (use scalar
  * 0 when no measurement error).
+ * Missing observations are NaN in the data: in such periods only the observed
+ * variables enter the update, and only the corresponding sub-block of F is
+ * factorized.
  * If multivariate filter is faster, do as in Matlab: start with multivariate
  * filter and switch to univariate filter only in case of singularity
  *
@@ -54,45 +59,121 @@ public:
                const std::vector<size_t> &zeta_back_arg, const std::vector<size_t> &zeta_mixed_arg, const std::vector<size_t> &zeta_static_arg,
                double qz_criterium_arg, const std::vector<size_t> &varobs_arg,
                double riccati_tol_arg, double lyapunov_tol_arg,
-               bool noconstant_arg);
+               bool noconstant_arg, double lyapunov_fixed_point_tol_arg = 0.0);
 
   template <class Vec1, class Vec2, class Mat1>
   double
   compute(const MatrixConstView &dataView, Vec1 &steadyState,
           const Mat1 &Q, const Matrix &H, const Vec2 &deepParams,
-          VectorView &vll, MatrixView &detrendedDataView, size_t start, size_t period)
+          VectorView &vll, size_t start, size_t period)
   {
     if (period == 0) // initialise all KF matrices
       initKalmanFilter.initialize(steadyState, deepParams, R, Q, RQRt, T, Pstar, Pinf,
-                                  dataView, detrendedDataView);
+                                  observationConstant);
     else                           // initialise parameter dependent KF matrices only but not Ps
       initKalmanFilter.initialize(steadyState, deepParams, R, Q, RQRt, T,
-                                  dataView, detrendedDataView);
+                                  observationConstant);
 
-    return filter(detrendedDataView, H, vll, start);
+    // The steady state is subtracted from the observations as they are read
+    return filter(dataView, H, vll, start);
   }
 
+  //! Computes the log-likelihood and its derivatives (the score) with respect to the estimated parameters
+  /*!
+    \param[in] deepParamIndex For each estimated parameter, its index in deepParams, or -1 if it does not enter the model
+    \param[in] dQ,dH For each estimated parameter, the derivatives of Q and H
+    \param[out] score The derivatives of the log-likelihood
+
+    The matrices and Pstar are always initialized, as for the first subsample.
+    The score is computed by the multivariate filter (whatever H), as in score.m:
+    prediction errors and state vector are differentiated along, with the
+    derivatives of T, RQR' and Pstar given by InitializeKalmanFilter::computeDerivatives.
+  */
+  template <class Vec1, class Vec2, class Mat1>
+  double
+  computeScore(const MatrixConstView &dataView, Vec1 &steadyState,
+               const Mat1 &Q, const Matrix &H, const Vec2 &deepParams,
+               VectorView &vll, size_t start,
+               const std::vector<int> &deepParamIndex, const std::vector<Matrix> &dQ,
+               const std::vector<Matrix> &dH, Vector &score)
+  {
+    size_t nparams = deepParamIndex.size();
+    assert(dQ.size() == nparams && dH.size() == nparams && score.getSize() == nparams);
+    allocateScoreWorkspace(nparams);
+
+    initKalmanFilter.initialize(steadyState, deepParams, R, Q, RQRt, T, Pstar, Pinf,
+                                observationConstant);
+    for (size_t i = 0; i < nparams; ++i)
+      initKalmanFilter.computeDerivatives(steadyState, deepParams, deepParamIndex[i], R, Q, dQ[i], T, Pstar,
+                                          dT[i], dRQRt[i], dPstar[i], d_constant[i]);
+
+    return filterScore(dataView, H, dH, vll, start, score);
+  }
+
+  //! Returns the union of indices of observed, backward and mixed variables, i.e. the state vector
+  static std::vector<size_t> compute_zeta_varobs_back_mixed(const std::vector<size_t> &zeta_back_arg, const std::vector<size_t> &zeta_mixed_arg, const std::vector<size_t> &varobs_arg);
+
 private:
   const std::vector<size_t> zeta_varobs_back_mixed;
-  static std::vector<size_t> compute_zeta_varobs_back_mixed(const std::vector<size_t> &zeta_back_arg, const std::vector<size_t> &zeta_mixed_arg, const std::vector<size_t> &varobs_arg);
   Matrix Z, Zt;   //nob*mm matrix mapping endogeneous variables and observations and its transpose
   Matrix T;   //mm*mm transition matrix of the state equation.
+  SparseTransition T_sparse; // nonzero elements of T, compressed at the beginning of filter()
+  bool sparse_T; // true if T is sparse enough for the sparse covariance prediction
   Matrix R;   //mm*rr matrix, mapping structural innovations to state variables.
   Matrix Pstar; //mm*mm variance-covariance matrix of stationary variables
   Matrix Pinf;  //mm*mm variance-covariance matrix of diffuse variables
   // allocate space for intermediary matrices
   Matrix RQRt, Ptmp;  //mm*mm variance-covariance matrix of variable disturbances
-  Matrix F, Finv;  // nob*nob F=ZPZt +H an inv(F)
+  Matrix F, Finv, oldF;  // nob*nob F=ZPZt +H an inv(F), and F of the previous period
   Matrix K,  KFinv, oldKFinv; // mm*nobs K=PZt and K*Finv gain matrices
   Vector a_init, a_new; // state vector
   Vector vt; // current observation error vectors
   Vector vtFinv; // intermediate observation error *Finv vector
+  Vector observationConstant; // nob constant (steady state) subtracted from the observations
   double riccati_tol;
   InitializeKalmanFilter initKalmanFilter; //Initialise KF matrices
   Vector FUTP; // F upper triangle packed as vector FUTP(i + (j-1)*j/2) = F(i,j) for 1<=i<=j;
+  std::vector<size_t> varobs_state; // position in the state vector of each observed variable
+  Matrix oldPstar; //mm*mm Pstar of the previous period, used by the univariate filter
+  Matrix Kuni; // mm*nob gains of the univariate filter, one column by observation
+  Vector Funi; // nob variances of the prediction errors of the univariate filter
+  Vector Ki; // mm gain of the current observation
+  Matrix Wsparse; // mm*mm workspace of the sparse covariance prediction
+  // Patterns of missing observations, filled by findMissingObservations() (empty if the data are complete)
+  std::vector<size_t> periodPattern; // pattern of each period
+  std::vector<std::vector<size_t> > patternObserved, patternStates; // indices of the observed variables of each pattern, and their positions in the state vector
+  // Derivatives with respect to each estimated parameter, allocated by the first call to computeScore()
+  std::vector<Matrix> dT, dRQRt, dPstar; // mm*mm
+  std::vector<Matrix> dKFinv; // mm*nob
+  std::vector<Matrix> dF; // nob*nob
+  std::vector<Vector> da, d_constant; // mm and nob
+  std::vector<double> trFinvdF; // trace(Finv*dF) for each parameter
+  // Work arrays of filterScore()
+  Matrix dPZt; // mm*nob
+  Matrix FinvdF, dFinv; // nob*nob
+  Matrix PtmpTt, dTPtmpTt; // mm*mm
+  Vector a_filt, da_filt; // mm
+  Vector dvt, dFvtFinv; // nob
 
-  // Method
-  double filter(const MatrixView &detrendedDataView,  const Matrix &H, VectorView &vll, size_t start);
+  // Methods
+  void allocateScoreWorkspace(size_t nparams);
+  // Pstar = T*Pstar*T' + RQR', only the upper triangle of Pstar being referenced on input
+  void predictCovariance();
+  double filterScore(const MatrixConstView &dataView, const Matrix &H, const std::vector<Matrix> &dH,
+                     VectorView &vll, size_t start, Vector &score);
+  double filter(const MatrixConstView &dataView,  const Matrix &H, VectorView &vll, size_t start);
+  // Groups the periods by pattern of observed variables, returns false if no observation is missing
+  bool findMissingObservations(const MatrixConstView &dataView);
+  // True if some observations of period t are missing
+  bool
+  incompletePeriod(size_t t) const
+  {
+    return !patternObserved.empty() && patternObserved[periodPattern[t]].size() < varobs_state.size();
+  }
+  // Update and prediction of a period with missing observations, returns its log-likelihood
+  double filterIncompletePeriod(const MatrixConstView &dataView, const Matrix &H, size_t t);
+  // Univariate filter (observations processed one by one), from period first with a_init and Pstar
+  double univariate_filter(const MatrixConstView &dataView, const Matrix &H, VectorView &vll, size_t start, size_t first, double loglik);
 
 };
 
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdexcept>
+
+#include "KalmanSmoother.hh"
+#include "KalmanFilter.hh"
+#include "LapackBindings.hh"
+
+KalmanSmoother::KalmanSmoother(const std::string &basename, size_t n_endo, size_t n_exo,
+                               const std::vector<size_t> &zeta_fwrd_arg, const std::vector<size_t> &zeta_back_arg,
+                               const std::vector<size_t> &zeta_mixed_arg, const std::vector<size_t> &zeta_static_arg,
+                               double qz_criterium_arg, const std::vector<size_t> &varobs_arg,
+                               double riccati_tol_arg, double lyapunov_tol_arg, bool noconstant_arg) :
+  zeta_varobs_back_mixed(KalmanFilter::compute_zeta_varobs_back_mixed(zeta_back_arg, zeta_mixed_arg, varobs_arg)),
+  varobs_state(varobs_arg.size()),
+  Z(varobs_arg.size(), zeta_varobs_back_mixed.size()),
+  T(zeta_varobs_back_mixed.size()), R(zeta_varobs_back_mixed.size(), n_exo),
+  RQRt(zeta_varobs_back_mixed.size()), QRt(n_exo, zeta_varobs_back_mixed.size()),
+  Pstar(zeta_varobs_back_mixed.size()), Pinf(zeta_varobs_back_mixed.size()), P1(zeta_varobs_back_mixed.size()),
+  PZt(zeta_varobs_back_mixed.size(), varobs_arg.size()), PZtFinv(zeta_varobs_back_mixed.size(), varobs_arg.size()),
+  Ptmp(zeta_varobs_back_mixed.size()), TPtmp(zeta_varobs_back_mixed.size()),
+  F(varobs_arg.size()), Finv(varobs_arg.size()), oldF(varobs_arg.size()),
+  FUTP(varobs_arg.size()*(varobs_arg.size()+1)/2),
+  a(zeta_varobs_back_mixed.size()), a_new(zeta_varobs_back_mixed.size()),
+  r(zeta_varobs_back_mixed.size()), r_new(zeta_varobs_back_mixed.size()),
+  vt(varobs_arg.size()), u(varobs_arg.size()), n_gains(0), riccati_tol(riccati_tol_arg),
+  initKalmanFilter(basename, n_endo, n_exo, zeta_fwrd_arg, zeta_back_arg, zeta_mixed_arg,
+                   zeta_static_arg, zeta_varobs_back_mixed, varobs_arg, qz_criterium_arg, lyapunov_tol_arg, noconstant_arg)
+{
+  Z.setAll(0.0);
+  for (size_t i = 0; i < varobs_arg.size(); ++i)
+    {
+      varobs_state[i] = find(zeta_varobs_back_mixed.begin(), zeta_varobs_back_mixed.end(),
+                             varobs_arg[i]) - zeta_varobs_back_mixed.begin();
+      Z(i, varobs_state[i]) = 1.0;
+    }
+}
+
+KalmanSmoother::~KalmanSmoother()
+{
+}
+
+double
+KalmanSmoother::invertF()
+{
+  size_t p = F.getRows();
+  mat::set_identity(Finv);
+  for (size_t i = 1; i <= p; ++i)
+    for (size_t j = i; j <= p; ++j)
+      FUTP(i + (j-1)*j/2 -1) = F(i-1, j-1);
+
+  int info = lapack::choleskySolver(FUTP, Finv, "U"); // FUTP now contains the Cholesky decomposition of F
+  assert(info >= 0);
+  if (info > 0)
+    throw std::runtime_error("KalmanSmoother: F is singular");
+
+  double logFdet = 0.0;
+  for (size_t d = 1; d <= p; ++d)
+    logFdet += 2*log(fabs(FUTP(d + (d-1)*d/2 -1)));
+  return logFdet;
+}
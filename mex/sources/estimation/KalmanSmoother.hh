@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if !defined(KS_KALMAN_SMOOTHER_HH__INCLUDED_)
+#define KS_KALMAN_SMOOTHER_HH__INCLUDED_
+
+#include <vector>
+
+#include "InitializeKalmanFilter.hh"
+
+/**
+ * Disturbance smoother (Durbin and Koopman, 2001, section 4.4), the C++
+ * counterpart of DsgeSmoother.m for the models handled by KalmanFilter.
+ *
+ * The state vector is the one of KalmanFilter (observed, backward and mixed
+ * variables), initialized as in InitializeKalmanFilter: a(1)=0 and P(1) is the
+ * solution of the Lyapunov equation. Since the latter never has a diffuse part
+ * (Pinf is zero), the diffuse periods of DsgeSmoother.m reduce to the standard
+ * recursions.
+ *
+ * The forward pass only stores what the backward pass needs: F^{-1}v(t) (in the
+ * epsilonhat output) and the gains K(t) = T*P(t)*Z'*F(t)^{-1}, the latter only
+ * until they converge (steady state Kalman filter, with riccati_tol). The
+ * smoothed states are then recovered by a second forward pass (the "fast state
+ * smoother"), so that the covariances P(t) are not stored either.
+ *
+ * The conventions are those of DsgeSmoother.m: the state equation is
+ * alpha(t) = T*alpha(t-1) + R*eta(t), and etahat(:,t) = Q*R'*r(t-1).
+ */
+class KalmanSmoother
+{
+public:
+  KalmanSmoother(const std::string &basename, size_t n_endo, size_t n_exo, const std::vector<size_t> &zeta_fwrd_arg,
+                 const std::vector<size_t> &zeta_back_arg, const std::vector<size_t> &zeta_mixed_arg, const std::vector<size_t> &zeta_static_arg,
+                 double qz_criterium_arg, const std::vector<size_t> &varobs_arg,
+                 double riccati_tol_arg, double lyapunov_tol_arg, bool noconstant_arg);
+  virtual
+  ~KalmanSmoother();
+
+  //! Computes the smoothed variables for the given parameters, and returns the log-likelihood
+  /*!
+    \param[out] alphahat Smoothed state vector, mm*nper (in the order of getStateVariables())
+    \param[out] etahat Smoothed structural shocks, n_exo*nper
+    \param[out] epsilonhat Smoothed measurement errors, nobs*nper
+  */
+  template <class Vec1, class Vec2, class Mat1, class Mat2, class Mat3, class Mat4>
+  double
+  compute(const MatrixConstView &dataView, Vec1 &steadyState, const Mat1 &Q, const Matrix &H, const Vec2 &deepParams,
+          MatrixView &detrendedDataView, Mat2 &alphahat, Mat3 &etahat, Mat4 &epsilonhat)
+  {
+    assert(alphahat.getRows() == T.getRows() && etahat.getRows() == R.getCols() && epsilonhat.getRows() == Z.getRows()
+           && alphahat.getCols() == dataView.getCols() && etahat.getCols() == dataView.getCols()
+           && epsilonhat.getCols() == dataView.getCols());
+
+    initKalmanFilter.initialize(steadyState, deepParams, R, Q, RQRt, T, Pstar, Pinf,
+                                dataView, detrendedDataView);
+    blas::gemm("N", "T", 1.0, Q, R, 0.0, QRt);
+
+    double loglik = filter(detrendedDataView, H, epsilonhat);
+
+    // Backward pass: r(t-1) = Z'u(t) + T'r(t), with u(t) = F^{-1}v(t) - K(t)'r(t)
+    r.setAll(0.0);
+    for (size_t t = detrendedDataView.getCols(); t-- > 0;)
+      {
+        const Matrix &Kt = gains[std::min(t, n_gains-1)];
+        VectorView epst = mat::get_col(epsilonhat, t);
+        u = epst;
+        blas::gemv("T", -1.0, Kt, r, 1.0, u);
+        blas::gemv("N", 1.0, H, u, 0.0, epst);
+        blas::gemv("T", 1.0, T, r, 0.0, r_new);
+        for (size_t i = 0; i < varobs_state.size(); ++i)
+          r_new(varobs_state[i]) += u(i);
+        r = r_new;
+        VectorView etat = mat::get_col(etahat, t);
+        blas::gemv("N", 1.0, QRt, r, 0.0, etat);
+      }
+
+    // alphahat(1) = a(1) + P(1)*r(0), alphahat(t+1) = T*alphahat(t) + R*etahat(t+1)
+    VectorView alpha0 = mat::get_col(alphahat, 0);
+    blas::gemv("N", 1.0, P1, r, 0.0, alpha0);
+    for (size_t t = 1; t < alphahat.getCols(); ++t)
+      {
+        VectorView alphat = mat::get_col(alphahat, t);
+        blas::gemv("N", 1.0, T, mat::get_col(alphahat, t-1), 0.0, alphat);
+        blas::gemv("N", 1.0, R, mat::get_col(etahat, t), 1.0, alphat);
+      }
+
+    return loglik;
+  }
+
+  //! Indices of the endogenous variables in the state vector
+  const std::vector<size_t> &
+  getStateVariables() const
+  {
+    return zeta_varobs_back_mixed;
+  };
+
+private:
+  const std::vector<size_t> zeta_varobs_back_mixed;
+  std::vector<size_t> varobs_state; // position in the state vector of each observed variable
+  Matrix Z; // nob*mm selection matrix of the observed variables
+  Matrix T, R, RQRt, QRt; // transition matrices of the state space model
+  Matrix Pstar, Pinf, P1; // mm*mm, P1 being the initial covariance
+  Matrix PZt, PZtFinv, Ptmp, TPtmp; // mm*nob and mm*mm work arrays
+  Matrix F, Finv, oldF; // nob*nob
+  Vector FUTP; // F upper triangle packed, for the Cholesky decomposition
+  Vector a, a_new, r, r_new; // mm
+  Vector vt, u; // nob
+  // Gains of the forward pass, the last one being used for all the subsequent periods
+  std::vector<Matrix> gains;
+  size_t n_gains;
+  const double riccati_tol;
+  InitializeKalmanFilter initKalmanFilter;
+
+  //! Forward pass, storing F^{-1}v(t) in the columns of FinvV, and filling gains
+  template <class Mat>
+  double filter(const MatrixView &detrendedDataView, const Matrix &H, Mat &FinvV);
+  //! Computes F^{-1} from F, and returns log|F|
+  double invertF();
+};
+
+template <class Mat>
+double
+KalmanSmoother::filter(const MatrixView &detrendedDataView, const Matrix &H, Mat &FinvV)
+{
+  size_t p = Z.getRows(), nper = detrendedDataView.getCols();
+  double loglik = 0.0, llconst = 0.0;
+  bool nonstationary = true;
+  n_gains = 0;
+  a.setAll(0.0);
+  P1 = Pstar;
+
+  for (size_t t = 0; t < nper; ++t)
+    {
+      if (nonstationary)
+        {
+          if (gains.size() <= n_gains)
+            gains.push_back(Matrix(T.getRows(), p));
+          Matrix &Kt = gains[n_gains++];
+
+          // F = ZPZ' + H, K = T*P*Z'*F^{-1}
+          blas::gemm("N", "T", 1.0, Pstar, Z, 0.0, PZt);
+          F = H;
+          blas::gemm("N", "N", 1.0, Z, PZt, 1.0, F);
+          llconst = -0.5*(p*log(2*M_PI) + invertF());
+          blas::gemm("N", "N", 1.0, PZt, Finv, 0.0, PZtFinv);
+          blas::gemm("N", "N", 1.0, T, PZtFinv, 0.0, Kt);
+
+          // P = T*(P - PZ'F^{-1}ZP)*T' + RQR'
+          Ptmp = Pstar;
+          blas::gemm("N", "T", -1.0, PZtFinv, PZt, 1.0, Ptmp);
+          blas::gemm("N", "N", 1.0, T, Ptmp, 0.0, TPtmp);
+          Pstar = RQRt;
+          blas::gemm("N", "T", 1.0, TPtmp, T, 1.0, Pstar);
+
+          if (t > 0)
+            nonstationary = mat::isDiff(Kt, gains[n_gains-2], riccati_tol) || mat::isDiff(F, oldF, riccati_tol);
+          oldF = F;
+        }
+      const Matrix &Kt = gains[n_gains-1];
+
+      // v = y - Za, FinvV = F^{-1}v, a = T*a + K*v
+      for (size_t i = 0; i < p; ++i)
+        vt(i) = detrendedDataView(i, t) - a(varobs_state[i]);
+      VectorView FinvVt = mat::get_col(FinvV, t);
+      blas::gemv("N", 1.0, Finv, vt, 0.0, FinvVt);
+      loglik += llconst - 0.5*blas::dot(vt, FinvVt);
+      blas::gemv("N", 1.0, T, a, 0.0, a_new);
+      blas::gemv("N", 1.0, Kt, vt, 1.0, a_new);
+      a = a_new;
+    }
+
+  return loglik;
+}
+
+#endif // !defined(KS_KALMAN_SMOOTHER_HH__INCLUDED_)
@@ -29,18 +29,33 @@ LogLikelihoodMain::LogLikelihoodMain(const std::string &basename, EstimatedParam
                                      const std::vector<size_t> &zeta_fwrd_arg, const std::vector<size_t> &zeta_back_arg,
                                      const std::vector<size_t> &zeta_mixed_arg, const std::vector<size_t> &zeta_static_arg, const double qz_criterium,
                                      const std::vector<size_t> &varobs, double riccati_tol, double lyapunov_tol,
-                                     bool noconstant_arg)
+                                     bool noconstant_arg, bool fast_kalman_filter_arg, bool sqrt_kalman_filter_arg, double lyapunov_fixed_point_tol,
+                                     int number_of_threads_arg)
 
 : estSubsamples(estiParDesc.estSubsamples),
-  logLikelihoodSubSample(basename, estiParDesc, n_endo, n_exo, zeta_fwrd_arg, zeta_back_arg, zeta_mixed_arg, zeta_static_arg, qz_criterium,
-                         varobs, riccati_tol, lyapunov_tol, noconstant_arg),
   vll(estiParDesc.getNumberOfPeriods()), // time dimension size of data
-  detrendedData(varobs.size(), estiParDesc.getNumberOfPeriods())
+  number_of_threads(number_of_threads_arg),
+  subLogLikelihood(estSubsamples.size()), subFailed(estSubsamples.size())
 {
+  for (size_t i = 0; i < estSubsamples.size(); ++i)
+    logLikelihoodSubSamples.push_back(new LogLikelihoodSubSample(basename, estiParDesc, n_endo, n_exo, zeta_fwrd_arg, zeta_back_arg,
+                                                                 zeta_mixed_arg, zeta_static_arg, qz_criterium, varobs, riccati_tol,
+                                                                 lyapunov_tol, noconstant_arg, fast_kalman_filter_arg, sqrt_kalman_filter_arg,
+                                                                 lyapunov_fixed_point_tol));
 
+  if (estSubsamples.size() > 1)
+    for (size_t i = 0; i < estSubsamples.size(); ++i)
+      {
+        size_t length = estSubsamples[i].endPeriod-estSubsamples[i].startPeriod+1;
+        subSteadyState.push_back(Vector(n_endo));
+        subVll.push_back(Vector(length));
+        subQ.push_back(Matrix(n_exo));
+        subH.push_back(Matrix(varobs.size()));
+      }
 }
 
 LogLikelihoodMain::~LogLikelihoodMain()
 {
-
+  for (size_t i = 0; i < logLikelihoodSubSamples.size(); ++i)
+    delete logLikelihoodSubSamples[i];
 }
@@ -25,15 +25,64 @@
 #if !defined(E126AEF5_AC28_400a_821A_3BCFD1BC4C22__INCLUDED_)
 #define E126AEF5_AC28_400a_821A_3BCFD1BC4C22__INCLUDED_
 
+#include <vector>
+
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
 #include "LogLikelihoodSubSample.hh"
 
+/**
+ * Log-likelihood of the estimation sample, as the sum of those of its
+ * subsamples.
+ *
+ * The subsamples are independent given the parameters: each one has its own
+ * LogLikelihoodSubSample (and thus its own filter and model solution) and its
+ * own copies of the deep parameters, Q, H, steady state and step likelihoods,
+ * so that they can be evaluated concurrently, with
+ * number_of_threads threads. The results are then gathered in the order of
+ * the subsamples, so that they do not depend on the number of threads.
+ */
 class LogLikelihoodMain
 {
 private:
   std::vector<EstimationSubsample> &estSubsamples; // reference to member of EstimatedParametersDescription
-  LogLikelihoodSubSample logLikelihoodSubSample;
+  std::vector<LogLikelihoodSubSample *> logLikelihoodSubSamples;
   Vector vll;  // vector of all KF step likelihoods
-  Matrix detrendedData;
+  const int number_of_threads;
+
+  // Workspaces of the subsamples (only used with more than one subsample)
+  std::vector<double> subDeepParams; // The deep parameters of subsample i start at i*(number of deep parameters)
+  std::vector<Vector> subSteadyState, subVll;
+  std::vector<Matrix> subQ, subH;
+  std::vector<double> subLogLikelihood;
+  std::vector<int> subFailed;
+
+  // Not copyable, since it owns the subsample evaluators
+  LogLikelihoodMain(const LogLikelihoodMain &);
+  LogLikelihoodMain &operator=(const LogLikelihoodMain &);
+
+  size_t
+  subsampleLength(size_t i) const
+  {
+    return estSubsamples[i].endPeriod-estSubsamples[i].startPeriod+1;
+  };
+
+  //! Evaluates subsample i in its workspace, from the steady state given by the caller
+  template <class VEC1, class VEC2>
+  double
+  computeSubsample(size_t i, const VEC1 &steadyState, VEC2 &estParams, size_t n_params, const MatrixConstView &data, size_t start)
+  {
+    MatrixConstView dataView(data, 0, estSubsamples[i].startPeriod, data.getRows(), subsampleLength(i));
+    VectorView deepParams(&subDeepParams[i*n_params], n_params, 1);
+    MatrixView Q(subQ[i].getData(), subQ[i].getRows(), subQ[i].getCols(), subQ[i].getLd());
+    VectorView vllView(subVll[i], 0, subsampleLength(i));
+    VectorView steadyStateView(subSteadyState[i], 0, subSteadyState[i].getSize());
+    steadyStateView = steadyState;
+    return logLikelihoodSubSamples[i]->compute(steadyStateView, dataView, estParams, deepParams,
+                                               Q, subH[i], vllView, start, i);
+  };
 
 public:
   virtual
@@ -42,7 +91,8 @@ public:
                     const std::vector<size_t> &zeta_fwrd_arg, const std::vector<size_t> &zeta_back_arg, const std::vector<size_t> &zeta_mixed_arg,
                     const std::vector<size_t> &zeta_static_arg, const double qz_criterium_arg, const std::vector<size_t> &varobs_arg,
                     double riccati_tol_arg, double lyapunov_tol_arg,
-                    bool noconstant_arg);
+                    bool noconstant_arg, bool fast_kalman_filter_arg, bool sqrt_kalman_filter_arg, double lyapunov_fixed_point_tol,
+                    int number_of_threads_arg = 1);
 
   /**
    * Compute method Inputs:
@@ -58,21 +108,95 @@ public:
   compute(VEC1 &steadyState, VEC2 &estParams, VectorView &deepParams, const MatrixConstView &data,
           MatrixView &Q, Matrix &H, size_t start)
   {
+    const size_t nSubsamples = estSubsamples.size();
+    if (nSubsamples == 1)
+      {
+        MatrixConstView dataView(data, 0, estSubsamples[0].startPeriod, data.getRows(), subsampleLength(0));
+        VectorView vllView(vll, estSubsamples[0].startPeriod, subsampleLength(0));
+        return logLikelihoodSubSamples[0]->compute(steadyState, dataView, estParams, deepParams,
+                                                   Q, H, vllView, start, 0);
+      }
+
+    /* Each subsample starts from the parameters left by the previous ones, as
+       when they were evaluated one after the other. They are set here in
+       sequence, which also raises the penalty of a non positive definite Q or
+       H for the first subsample where it occurs. */
+    const size_t n_params = deepParams.getSize();
+    if (subDeepParams.size() != std::max(nSubsamples*n_params, (size_t) 1))
+      subDeepParams.resize(std::max(nSubsamples*n_params, (size_t) 1));
+    for (size_t i = 0; i < nSubsamples; ++i)
+      {
+        VectorView subDeepParamsView(&subDeepParams[i*n_params], n_params, 1);
+        if (i == 0)
+          {
+            subDeepParamsView = deepParams;
+            subQ[0] = Q;
+            subH[0] = H;
+          }
+        else
+          {
+            subDeepParamsView = VectorView(&subDeepParams[(i-1)*n_params], n_params, 1);
+            subQ[i] = subQ[i-1];
+            subH[i] = subH[i-1];
+          }
+        MatrixView subQView(subQ[i].getData(), subQ[i].getRows(), subQ[i].getCols(), subQ[i].getLd());
+        logLikelihoodSubSamples[i]->updateParams(estParams, subDeepParamsView, subQView, subH[i], i);
+      }
+
+    // A failed subsample is evaluated again below, outside of the parallel region, to raise its exception
+#ifdef USE_OMP
+# pragma omp parallel for num_threads(number_of_threads) schedule(dynamic)
+#endif
+    for (int i = 0; i < (int) nSubsamples; ++i)
+      {
+        subFailed[i] = 0;
+        try
+          {
+            subLogLikelihood[i] = computeSubsample(i, steadyState, estParams, n_params, data, start);
+          }
+        catch (...)
+          {
+            subFailed[i] = 1;
+          }
+      }
+    for (size_t i = 0; i < nSubsamples; ++i)
+      if (subFailed[i])
+        subLogLikelihood[i] = computeSubsample(i, steadyState, estParams, n_params, data, start);
+
+    // Deterministic reduction, in the order of the subsamples
     double logLikelihood = 0;
-    for (size_t i = 0; i < estSubsamples.size(); ++i)
+    for (size_t i = 0; i < nSubsamples; ++i)
       {
-        MatrixConstView dataView(data, 0, estSubsamples[i].startPeriod,
-                                 data.getRows(), estSubsamples[i].endPeriod-estSubsamples[i].startPeriod+1);
-        MatrixView detrendedDataView(detrendedData, 0, estSubsamples[i].startPeriod,
-                                     data.getRows(), estSubsamples[i].endPeriod-estSubsamples[i].startPeriod+1);
-
-        VectorView vllView(vll, estSubsamples[i].startPeriod, estSubsamples[i].endPeriod-estSubsamples[i].startPeriod+1);
-        logLikelihood += logLikelihoodSubSample.compute(steadyState, dataView, estParams, deepParams,
-                                                        Q, H, vllView, detrendedDataView, start, i);
+        logLikelihood += subLogLikelihood[i];
+        VectorView vllView(vll, estSubsamples[i].startPeriod, subsampleLength(i));
+        vllView = subVll[i];
       }
+
+    // The caller gets the parameters and steady state of the last subsample
+    steadyState = subSteadyState[nSubsamples-1];
+    deepParams = VectorView(&subDeepParams[(nSubsamples-1)*n_params], n_params, 1);
+    Q = subQ[nSubsamples-1];
+    H = subH[nSubsamples-1];
     return logLikelihood;
   };
 
+  //! Computes the log-likelihood and its derivatives with respect to the estimated parameters
+  /*! Only available with a single estimation subsample */
+  template <class VEC1, class VEC2>
+  double
+  computeScore(VEC1 &steadyState, VEC2 &estParams, VectorView &deepParams, const MatrixConstView &data,
+               MatrixView &Q, Matrix &H, size_t start, Vector &score)
+  {
+    if (estSubsamples.size() != 1)
+      throw std::runtime_error("LogLikelihoodMain::computeScore: the score is only available with a single estimation subsample");
+
+    MatrixConstView dataView(data, 0, estSubsamples[0].startPeriod,
+                             data.getRows(), estSubsamples[0].endPeriod-estSubsamples[0].startPeriod+1);
+    VectorView vllView(vll, estSubsamples[0].startPeriod, estSubsamples[0].endPeriod-estSubsamples[0].startPeriod+1);
+    return logLikelihoodSubSamples[0]->computeScore(steadyState, dataView, estParams, deepParams,
+                                                    Q, H, vllView, start, score);
+  };
+
   Vector &
   getVll()
   {
@@ -27,14 +27,27 @@
 
 LogLikelihoodSubSample::~LogLikelihoodSubSample()
 {
+  delete kalmanFilter;
+  delete chandrasekharFilter;
+  delete squareRootFilter;
 };
 
 LogLikelihoodSubSample::LogLikelihoodSubSample(const std::string &basename, EstimatedParametersDescription &INestiParDesc, size_t n_endo, size_t n_exo,
                                                const std::vector<size_t> &zeta_fwrd_arg, const std::vector<size_t> &zeta_back_arg,
                                                const std::vector<size_t> &zeta_mixed_arg, const std::vector<size_t> &zeta_static_arg, const double qz_criterium,
-                                               const std::vector<size_t> &varobs, double riccati_tol, double lyapunov_tol, bool noconstant_arg) :
-  estiParDesc(INestiParDesc),
-  kalmanFilter(basename, n_endo, n_exo, zeta_fwrd_arg, zeta_back_arg, zeta_mixed_arg, zeta_static_arg, qz_criterium,
-               varobs, riccati_tol, lyapunov_tol, noconstant_arg), eigQ(n_exo), eigH(varobs.size())
+                                               const std::vector<size_t> &varobs, double riccati_tol, double lyapunov_tol, bool noconstant_arg,
+                                               bool fast_kalman_filter_arg, bool sqrt_kalman_filter_arg, double lyapunov_fixed_point_tol) :
+  estiParDesc(INestiParDesc), kalmanFilter(NULL), chandrasekharFilter(NULL), squareRootFilter(NULL), eigQ(n_exo), eigH(varobs.size()),
+  cholQ(n_exo), cholH(varobs.size()), deepParamIndex(INestiParDesc.estParams.size(), -1),
+  dQ(INestiParDesc.estParams.size(), Matrix(n_exo)), dH(INestiParDesc.estParams.size(), Matrix(varobs.size()))
 {
+  if (fast_kalman_filter_arg)
+    chandrasekharFilter = new ChandrasekharFilter(basename, n_endo, n_exo, zeta_fwrd_arg, zeta_back_arg, zeta_mixed_arg, zeta_static_arg, qz_criterium,
+                                                  varobs, riccati_tol, lyapunov_tol, noconstant_arg, lyapunov_fixed_point_tol);
+  else if (sqrt_kalman_filter_arg)
+    squareRootFilter = new SquareRootKalmanFilter(basename, n_endo, n_exo, zeta_fwrd_arg, zeta_back_arg, zeta_mixed_arg, zeta_static_arg, qz_criterium,
+                                                  varobs, riccati_tol, lyapunov_tol, noconstant_arg, lyapunov_fixed_point_tol);
+  else
+    kalmanFilter = new KalmanFilter(basename, n_endo, n_exo, zeta_fwrd_arg, zeta_back_arg, zeta_mixed_arg, zeta_static_arg, qz_criterium,
+                                    varobs, riccati_tol, lyapunov_tol, noconstant_arg, lyapunov_fixed_point_tol);
 };
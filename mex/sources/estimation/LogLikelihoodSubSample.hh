@@ -27,8 +27,11 @@
 #define DF8B7AF5_8169_4587_9037_2CD2C82E2DDF__INCLUDED_
 
 #include <algorithm>
+#include <stdexcept>
 #include "EstimatedParametersDescription.hh"
 #include "KalmanFilter.hh"
+#include "ChandrasekharFilter.hh"
+#include "SquareRootKalmanFilter.hh"
 #include "VDVEigDecomposition.hh"
 #include "LapackBindings.hh"
 
@@ -39,16 +42,37 @@ public:
   LogLikelihoodSubSample(const std::string &basename, EstimatedParametersDescription &estiParDesc, size_t n_endo, size_t n_exo,
                          const std::vector<size_t> &zeta_fwrd_arg, const std::vector<size_t> &zeta_back_arg,
                          const std::vector<size_t> &zeta_mixed_arg, const std::vector<size_t> &zeta_static_arg, const double qz_criterium,
-                         const std::vector<size_t> &varobs_arg, double riccati_tol_in, double lyapunov_tol, bool noconstant_arg);
+                         const std::vector<size_t> &varobs_arg, double riccati_tol_in, double lyapunov_tol, bool noconstant_arg,
+                         bool fast_kalman_filter_arg, bool sqrt_kalman_filter_arg, double lyapunov_fixed_point_tol);
 
   template <class VEC1, class VEC2>
   double
   compute(VEC1 &steadyState, const MatrixConstView &dataView, VEC2 &estParams, VectorView &deepParams,
-          MatrixView &Q, Matrix &H, VectorView &vll, MatrixView &detrendedDataView, size_t start, size_t period)
+          MatrixView &Q, Matrix &H, VectorView &vll, size_t start, size_t period)
   {
     updateParams(estParams, deepParams, Q, H, period);
 
-    return kalmanFilter.compute(dataView, steadyState,  Q, H, deepParams, vll, detrendedDataView, start, period);
+    if (chandrasekharFilter)
+      return chandrasekharFilter->compute(dataView, steadyState,  Q, H, deepParams, vll, start, period);
+    if (squareRootFilter)
+      return squareRootFilter->compute(dataView, steadyState,  Q, H, deepParams, vll, start, period);
+    return kalmanFilter->compute(dataView, steadyState,  Q, H, deepParams, vll, start, period);
+  }
+
+  //! Computes the log-likelihood and its derivatives with respect to the estimated parameters
+  /*! Only available with the standard Kalman filter, and for the first subsample */
+  template <class VEC1, class VEC2>
+  double
+  computeScore(VEC1 &steadyState, const MatrixConstView &dataView, VEC2 &estParams, VectorView &deepParams,
+               MatrixView &Q, Matrix &H, VectorView &vll, size_t start, Vector &score)
+  {
+    if (kalmanFilter == NULL)
+      throw std::runtime_error("LogLikelihoodSubSample::computeScore: the score is only available with the standard Kalman filter");
+
+    updateParams(estParams, deepParams, Q, H, 0);
+    updateParamDerivatives(estParams, Q, H);
+    return kalmanFilter->computeScore(dataView, steadyState, Q, H, deepParams, vll, start,
+                                      deepParamIndex, dQ, dH, score);
   }
 
   virtual
@@ -65,11 +89,20 @@ public:
 
 private:
   EstimatedParametersDescription &estiParDesc;
-  KalmanFilter kalmanFilter;
+  // Only one of the filters is allocated, depending on the fast_kalman_filter and sqrt_kalman_filter options
+  KalmanFilter *kalmanFilter;
+  ChandrasekharFilter *chandrasekharFilter;
+  SquareRootKalmanFilter *squareRootFilter;
   VDVEigDecomposition eigQ;
   VDVEigDecomposition eigH;
+  Matrix cholQ, cholH; // Buffers for the positive definiteness tests, which must not overwrite Q and H
+  // For each estimated parameter, its index in the deep parameters (-1 if it is not one) and the derivatives of Q and H
+  std::vector<int> deepParamIndex;
+  std::vector<Matrix> dQ, dH;
 
-  // methods
+public:
+  //! Sets the estimated parameters of subsample period in deepParams, Q and H
+  /*! Throws an UpdateParamsException if Q or H is not positive definite */
   template <class VEC>
   void
   updateParams(VEC &estParams, VectorView &deepParams,
@@ -107,7 +140,8 @@ private:
                 Q(k1, k2) = estParams(i)*sqrt(Q(k1, k1)*Q(k2, k2));
                 Q(k2, k1) = Q(k1, k2);
                 //   [CholQ,testQ] = chol(Q);
-                test = lapack::choleskyDecomp(Q, "L");
+                cholQ = Q;
+                test = lapack::choleskyDecomp(cholQ, "L");
                 assert(test >= 0);
 
                 if (test > 0)
@@ -138,7 +172,8 @@ private:
                 H(k2, k1) = H(k1, k2);
 
                 //[CholH,testH] = chol(H);
-                test = lapack::choleskyDecomp(H, "L");
+                cholH = H;
+                test = lapack::choleskyDecomp(cholH, "L");
                 assert(test >= 0);
 
                 if (test > 0)
@@ -172,6 +207,61 @@ private:
       } //end for
   };
 
+private:
+  //! Computes the derivatives of Q and H with respect to the estimated parameters, after updateParams()
+  /*! The variances are the squares of the standard deviations, and the
+      estimated covariances are the products of the correlations and the
+      standard deviations */
+  template <class VEC>
+  void
+  updateParamDerivatives(const VEC &estParams, const MatrixView &Q, const Matrix &H)
+  {
+    size_t nparams = estParams.getSize();
+    for (size_t i = 0; i < nparams; ++i)
+      {
+        const EstimatedParameter &par = estiParDesc.estParams[i];
+        deepParamIndex[i] = (par.ptype == EstimatedParameter::deepPar ? (int) par.ID1 : -1);
+        dQ[i].setAll(0.0);
+        dH[i].setAll(0.0);
+        switch (par.ptype)
+          {
+          case EstimatedParameter::shock_SD:
+            dQ[i](par.ID1, par.ID1) = 2*estParams(i);
+            break;
+          case EstimatedParameter::measureErr_SD:
+            dH[i](par.ID1, par.ID1) = 2*estParams(i);
+            break;
+          case EstimatedParameter::shock_Corr:
+            dQ[i](par.ID1, par.ID2) = dQ[i](par.ID2, par.ID1) = sqrt(Q(par.ID1, par.ID1)*Q(par.ID2, par.ID2));
+            break;
+          case EstimatedParameter::measureErr_Corr:
+            dH[i](par.ID1, par.ID2) = dH[i](par.ID2, par.ID1) = sqrt(H(par.ID1, par.ID1)*H(par.ID2, par.ID2));
+            break;
+          default:
+            break;
+          }
+      }
+
+    // An estimated covariance also depends on the standard deviations of the two variables
+    for (size_t i = 0; i < nparams; ++i)
+      {
+        const EstimatedParameter &corr = estiParDesc.estParams[i];
+        if (corr.ptype != EstimatedParameter::shock_Corr && corr.ptype != EstimatedParameter::measureErr_Corr)
+          continue;
+        bool shock = (corr.ptype == EstimatedParameter::shock_Corr);
+        for (size_t j = 0; j < nparams; ++j)
+          {
+            const EstimatedParameter &sd = estiParDesc.estParams[j];
+            if (sd.ptype != (shock ? EstimatedParameter::shock_SD : EstimatedParameter::measureErr_SD)
+                || (sd.ID1 != corr.ID1 && sd.ID1 != corr.ID2))
+              continue;
+            Matrix &dV = (shock ? dQ[j] : dH[j]);
+            dV(corr.ID1, corr.ID2) = dV(corr.ID2, corr.ID1)
+              = (shock ? Q(corr.ID1, corr.ID2) : H(corr.ID1, corr.ID2))/estParams(j);
+          }
+      }
+  }
+
 };
 
 #endif // !defined(DF8B7AF5_8169_4587_9037_2CD2C82E2DDF__INCLUDED_)
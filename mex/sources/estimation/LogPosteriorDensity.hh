@@ -29,6 +29,7 @@
 #include "EstimatedParametersDescription.hh"
 #include "LogPriorDensity.hh"
 #include "LogLikelihoodMain.hh"
+#include <instrumentation.hh>
 
 /**
  * Class that calculates Log Posterior Density using kalman, based on Dynare
@@ -49,16 +50,49 @@ public:
                       const std::vector<size_t> &zeta_fwrd_arg, const std::vector<size_t> &zeta_back_arg, const std::vector<size_t> &zeta_mixed_arg,
                       const std::vector<size_t> &zeta_static_arg, const double qz_criterium_arg, const std::vector<size_t> &varobs_arg,
                       double riccati_tol_arg, double lyapunov_tol_arg,
-                      bool noconstant_arg);
+                      bool noconstant_arg, bool fast_kalman_filter_arg, bool sqrt_kalman_filter_arg, double lyapunov_fixed_point_tol_arg,
+                      int number_of_threads = 1);
 
   template <class VEC1, class VEC2>
   double
   compute(VEC1 &steadyState, VEC2 &estParams, VectorView &deepParams, const MatrixConstView &data, MatrixView &Q, Matrix &H, size_t presampleStart)
   {
+    INSTRUMENT_SCOPE("log_posterior");
     return -logLikelihoodMain.compute(steadyState, estParams, deepParams, data, Q, H, presampleStart)
       -logPriorDensity.compute(estParams);
   }
 
+  //! Returns minus the log posterior density, and in score its derivatives with respect to the estimated parameters
+  /*! The signs are those of the DLIK output of dsge_likelihood.m */
+  template <class VEC1, class VEC2>
+  double
+  computeScore(VEC1 &steadyState, VEC2 &estParams, VectorView &deepParams, const MatrixConstView &data, MatrixView &Q, Matrix &H,
+               size_t presampleStart, Vector &score)
+  {
+    double logPosterior = logLikelihoodMain.computeScore(steadyState, estParams, deepParams, data, Q, H, presampleStart, score)
+      + logPriorDensity.compute(estParams);
+    logPriorDensity.addDerivatives(estParams, score);
+    for (size_t i = 0; i < score.getSize(); ++i)
+      score(i) = -score(i);
+    return -logPosterior;
+  }
+
+  //! Returns the log likelihood alone, as needed by the tempered posteriors of the SMC sampler
+  template <class VEC1, class VEC2>
+  double
+  computeLogLikelihood(VEC1 &steadyState, VEC2 &estParams, VectorView &deepParams, const MatrixConstView &data, MatrixView &Q, Matrix &H,
+                       size_t presampleStart)
+  {
+    INSTRUMENT_SCOPE("log_likelihood");
+    return logLikelihoodMain.compute(steadyState, estParams, deepParams, data, Q, H, presampleStart);
+  }
+
+  LogPriorDensity &
+  getLogPriorDensity()
+  {
+    return logPriorDensity;
+  }
+
   Vector&getLikVector();
 
 };
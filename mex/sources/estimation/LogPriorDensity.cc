@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2009-2012 Dynare Team
+ * Copyright (C) 2009-2017 Dynare Team
  *
  * This file is part of Dynare.
  *
@@ -23,7 +23,27 @@
 //  Created on:      10-Feb-2010 20:56:08
 ///////////////////////////////////////////////////////////
 
+#include <limits>
+#include <boost/math/special_functions/gamma.hpp>
+
 #include "LogPriorDensity.hh"
+
+namespace
+{
+  //! a*log(z), with the convention that it is null if a is null (even if z is null)
+  inline double
+  xlogy(double a, double z)
+  {
+    return a == 0 ? 0 : a*log(z);
+  }
+
+  inline double
+  lbeta(double a, double b)
+  {
+    return boost::math::lgamma(a) + boost::math::lgamma(b) - boost::math::lgamma(a+b);
+  }
+}
+
 LogPriorDensity::~LogPriorDensity()
 {
 };
@@ -31,8 +51,158 @@ LogPriorDensity::~LogPriorDensity()
 LogPriorDensity::LogPriorDensity(EstimatedParametersDescription &estParsDesc_arg) :
   estParsDesc(estParsDesc_arg)
 {
+  const double inf = std::numeric_limits<double>::infinity();
+  for (size_t i = 0; i < estParsDesc.estParams.size(); ++i)
+    {
+      Prior &prior = *estParsDesc.estParams[i].prior;
+      Prior::pShape shape = prior.getShape();
+      size_t g = 0;
+      while (g < groups.size() && groups[g].shape != shape)
+        g++;
+      if (g == groups.size())
+        {
+          groups.push_back(PriorGroup());
+          groups[g].shape = shape;
+        }
+      PriorGroup &group = groups[g];
+
+      // The gamma distribution used by the inverse gamma priors has shape shp/2 and scale 2/fhp
+      double shift = prior.lower_bound, scale = 1, zLower = 0, zUpper = inf, a = 0, b = 0, logNormaliser = 0;
+      switch (shape)
+        {
+        case Prior::Beta:
+          scale = 1/(prior.upper_bound - prior.lower_bound);
+          zUpper = 1;
+          a = prior.fhp - 1;
+          b = prior.shp - 1;
+          logNormaliser = -lbeta(prior.fhp, prior.shp);
+          break;
+        case Prior::Gamma:
+          a = prior.fhp - 1;
+          b = 1/prior.shp;
+          logNormaliser = -boost::math::lgamma(prior.fhp) - prior.fhp*log(prior.shp);
+          break;
+        case Prior::Inv_gamma_1:
+          a = -(prior.shp + 1);
+          b = prior.fhp/2;
+          logNormaliser = log(2.0) - boost::math::lgamma(prior.shp/2) - prior.shp/2*log(2/prior.fhp);
+          break;
+        case Prior::Inv_gamma_2:
+          a = -(prior.shp/2 + 1);
+          b = prior.fhp/2;
+          logNormaliser = -boost::math::lgamma(prior.shp/2) - prior.shp/2*log(2/prior.fhp);
+          break;
+        case Prior::Gaussian:
+          shift = 0;
+          zLower = prior.lower_bound;
+          zUpper = prior.upper_bound;
+          a = prior.fhp;
+          b = 1/prior.shp;
+          logNormaliser = -log(prior.shp) - 0.5*log(2*M_PI);
+          break;
+        case Prior::Uniform:
+          shift = 0;
+          zLower = prior.lower_bound;
+          zUpper = prior.upper_bound;
+          a = prior.fhp;
+          b = prior.shp;
+          logNormaliser = -log(prior.shp - prior.fhp);
+          break;
+        }
+      group.index.push_back(i);
+      group.shift.push_back(shift);
+      group.scale.push_back(scale);
+      group.zLower.push_back(zLower);
+      group.zUpper.push_back(zUpper);
+      group.a.push_back(a);
+      group.b.push_back(b);
+      group.logNormaliser.push_back(logNormaliser);
+    }
 };
 
+double
+LogPriorDensity::computeFromData(const double *x, size_t stride) const
+{
+  double logPriorDensity = 0;
+  for (size_t g = 0; g < groups.size(); ++g)
+    {
+      logPriorDensity += computeGroup(groups[g], x, stride);
+      if (std::isinf(fabs(logPriorDensity)))
+        return logPriorDensity;
+    }
+  return logPriorDensity;
+}
+
+double
+LogPriorDensity::computeGroup(const PriorGroup &group, const double *x, size_t stride)
+{
+  const double minus_inf = -std::numeric_limits<double>::infinity();
+  const size_t n = group.index.size();
+  const size_t *index = &group.index[0];
+  const double *shift = &group.shift[0], *scale = &group.scale[0], *zLower = &group.zLower[0],
+    *zUpper = &group.zUpper[0], *a = &group.a[0], *b = &group.b[0], *logNormaliser = &group.logNormaliser[0];
+  double sum = 0;
+  switch (group.shape)
+    {
+    case Prior::Beta:
+      for (size_t i = 0; i < n; ++i)
+        {
+          double z = (x[index[i]*stride] - shift[i])*scale[i];
+          if (z < zLower[i] || z > zUpper[i])
+            return minus_inf;
+          sum += xlogy(a[i], z) + xlogy(b[i], 1-z) + logNormaliser[i];
+        }
+      break;
+    case Prior::Gamma:
+      for (size_t i = 0; i < n; ++i)
+        {
+          double z = x[index[i]*stride] - shift[i];
+          if (z < zLower[i])
+            return minus_inf;
+          sum += xlogy(a[i], z) - b[i]*z + logNormaliser[i];
+        }
+      break;
+    case Prior::Inv_gamma_1:
+      for (size_t i = 0; i < n; ++i)
+        {
+          double z = x[index[i]*stride] - shift[i];
+          if (z <= zLower[i])
+            return minus_inf;
+          sum += a[i]*log(z) - b[i]/(z*z) + logNormaliser[i];
+        }
+      break;
+    case Prior::Inv_gamma_2:
+      for (size_t i = 0; i < n; ++i)
+        {
+          double z = x[index[i]*stride] - shift[i];
+          if (z <= zLower[i])
+            return minus_inf;
+          sum += a[i]*log(z) - b[i]/z + logNormaliser[i];
+        }
+      break;
+    case Prior::Gaussian:
+      for (size_t i = 0; i < n; ++i)
+        {
+          double z = x[index[i]*stride];
+          if (z <= zLower[i] || z >= zUpper[i])
+            return minus_inf;
+          double u = (z - a[i])*b[i];
+          sum += -0.5*u*u + logNormaliser[i];
+        }
+      break;
+    case Prior::Uniform:
+      for (size_t i = 0; i < n; ++i)
+        {
+          double z = x[index[i]*stride];
+          if (z <= zLower[i] || z >= zUpper[i] || z < a[i] || z > b[i])
+            return minus_inf;
+          sum += logNormaliser[i];
+        }
+      break;
+    }
+  return sum;
+}
+
 /**
  * Return random number for prior fromits distribution
  */
@@ -27,9 +27,20 @@
 #define LPD_011FD4CF_17CE_4805_882B_046AA07CF443__INCLUDED_
 
 //#include <boost/random/variate_generator.hpp>
+#include <vector>
 #include "Vector.hh"
+#include "Matrix.hh"
 #include "EstimatedParametersDescription.hh"
 
+/**
+ * Log prior density of the estimated parameters.
+ *
+ * The result is the sum of the logs of the Prior::pdf() of the parameters,
+ * but it is computed directly in log space: the parameters are grouped by
+ * distribution family, the normalising constants (beta and gamma functions)
+ * are computed once by the constructor, and each group is evaluated in a
+ * loop without virtual calls.
+ */
 class LogPriorDensity
 {
 
@@ -43,14 +54,28 @@ public:
   compute(VEC &ep)
   {
     assert(estParsDesc.estParams.size() == ep.getSize());
-    double logPriorDensity = 0;
-    for (size_t i = 0; i <  ep.getSize(); ++i)
-      {
-        logPriorDensity += log(((*(estParsDesc.estParams[i]).prior)).pdf(ep(i)));
-        if (std::isinf(fabs(logPriorDensity)))
-          return logPriorDensity;
-      }
-    return logPriorDensity;
+    return computeFromData(ep.getData(), ep.getStride());
+  };
+
+  //! Computes in logPriors the log prior densities of the draws stored in the columns of draws
+  /*! For prior sampling and sequential Monte Carlo */
+  template<class MAT, class VEC>
+  void
+  computeBatch(const MAT &draws, VEC &logPriors)
+  {
+    assert(estParsDesc.estParams.size() == draws.getRows() && draws.getCols() == logPriors.getSize());
+    for (size_t j = 0; j < draws.getCols(); ++j)
+      logPriors(j) = computeFromData(draws.getData() + j*draws.getLd(), 1);
+  };
+
+  //! Adds the derivatives of the log prior density with respect to the parameters to grad
+  template<class VEC>
+  void
+  addDerivatives(const VEC &ep, Vector &grad)
+  {
+    assert(estParsDesc.estParams.size() == ep.getSize() && grad.getSize() == ep.getSize());
+    for (size_t i = 0; i < ep.getSize(); ++i)
+      grad(i) += estParsDesc.estParams[i].prior->logPdfDerivative(ep(i));
   };
 
   void computeNewParams(Vector &newParams);
@@ -58,6 +83,30 @@ public:
 private:
   const EstimatedParametersDescription &estParsDesc;
 
+  /**
+   * Parameters whose priors belong to the same family, with one entry per
+   * parameter in each vector. The density is evaluated at
+   * z = (x - shift)*scale, and is null outside of [zLower, zUpper] (or of
+   * (zLower, zUpper) for the Gaussian and uniform priors, as in Prior::pdf()).
+   * For the beta and gamma priors, a and b are the coefficients of log(z) and
+   * log(1-z) (resp. of log(z) and z); for the inverse gamma priors, those of
+   * log(z) and 1/z^2 (resp. 1/z); for the Gaussian prior, a is the mean and b
+   * the inverse of the standard deviation.
+   */
+  struct PriorGroup
+  {
+    Prior::pShape shape;
+    std::vector<size_t> index;
+    std::vector<double> shift, scale, zLower, zUpper, a, b;
+    //! Log of the normalising constant of the density
+    std::vector<double> logNormaliser;
+  };
+  std::vector<PriorGroup> groups;
+
+  //! Log prior density of the parameters stored at x, x+stride, x+2*stride...
+  double computeFromData(const double *x, size_t stride) const;
+  //! Sum of the log densities of the parameters of a group
+  static double computeGroup(const PriorGroup &group, const double *x, size_t stride);
 };
 
 #endif // !defined(011FD4CF_17CE_4805_882B_046AA07CF443__INCLUDED_)
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cassert>
+#include <stdexcept>
+#include <stdint.h>
+
+#include "MHDrawsFile.hh"
+
+MHDrawsFile::MHDrawsFile(const std::string &filename, size_t npar, size_t ndraws, size_t thinning_arg, size_t flush_interval) :
+  ncols(npar+1), nrows((ndraws+thinning_arg-1)/thinning_arg), thinning(thinning_arg),
+  blockSize(flush_interval), nadded(0), nstored(0), inBlock(0), block(flush_interval*(npar+1))
+{
+  assert(thinning > 0 && blockSize > 0);
+  fd = fopen(filename.c_str(), "wb");
+  if (fd == NULL)
+    throw std::runtime_error("MHDrawsFile: can not open " + filename + " for writing");
+  uint64_t header[2] = { nrows, ncols };
+  if (fwrite(header, sizeof(uint64_t), 2, fd) != 2)
+    throw std::runtime_error("MHDrawsFile: can not write to " + filename);
+}
+
+MHDrawsFile::~MHDrawsFile()
+{
+  if (fd != NULL)
+    {
+      try
+        {
+          flush();
+        }
+      catch (const std::runtime_error &re)
+        {
+        }
+      fclose(fd);
+    }
+}
+
+void
+MHDrawsFile::add(double urand, const Vector &draw)
+{
+  assert(draw.getSize() == ncols-1);
+  if (nadded++ % thinning != 0)
+    return;
+  block[inBlock] = urand;
+  for (size_t c = 1; c < ncols; ++c)
+    block[c*blockSize+inBlock] = draw(c-1);
+  if (++inBlock == blockSize)
+    flush();
+}
+
+void
+MHDrawsFile::flush()
+{
+  if (inBlock == 0)
+    return;
+  const long header_size = 2*sizeof(uint64_t);
+  for (size_t c = 0; c < ncols; ++c)
+    if (fseek(fd, header_size + (long) ((c*nrows+nstored)*sizeof(double)), SEEK_SET) != 0
+        || fwrite(&block[c*blockSize], sizeof(double), inBlock, fd) != inBlock)
+      throw std::runtime_error("MHDrawsFile: error while writing the draws");
+  nstored += inBlock;
+  inBlock = 0;
+}
+
+void
+MHDrawsFile::close()
+{
+  flush();
+  fclose(fd);
+  fd = NULL;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if !defined(MHDRAWSFILE_HH_INCLUDED)
+#define MHDRAWSFILE_HH_INCLUDED
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Vector.hh"
+
+/**
+ * Binary store of the draws of a Metropolis-Hastings sampler, in a columnar
+ * layout: a header made of two uint64 numbers (number of rows and of columns),
+ * followed by the columns stored one after the other as doubles. The first
+ * column holds the uniform draws of the acceptance test, the next ones the
+ * proposed parameters. It can be memory-mapped under Matlab with:
+ *
+ *   m = memmapfile(filename, 'Format', {'uint64', [1 2], 'header'}, 'Repeat', 1);
+ *   h = double(m.Data.header);
+ *   m = memmapfile(filename, 'Offset', 16, 'Format', {'double', h, 'draws'}, 'Repeat', 1);
+ *
+ * The draws are kept in a preallocated block, written to each column once
+ * it is full, so that there is one write by column every flush_interval
+ * stored draws. Only one draw out of thinning is stored.
+ */
+class MHDrawsFile
+{
+public:
+  MHDrawsFile(const std::string &filename, size_t npar, size_t ndraws, size_t thinning_arg, size_t flush_interval);
+  virtual ~MHDrawsFile();
+  //! Stores a draw (if not thinned out)
+  void add(double urand, const Vector &draw);
+  //! Writes the draws which are still in the block and closes the file
+  void close();
+
+private:
+  FILE *fd;
+  const size_t ncols, nrows, thinning, blockSize;
+  size_t nadded, nstored, inBlock;
+  std::vector<double> block; // blockSize*ncols draws, stored by column
+  void flush();
+};
+
+#endif // !defined(MHDRAWSFILE_HH_INCLUDED)
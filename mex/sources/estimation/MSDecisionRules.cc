@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+#include "MSDecisionRules.hh"
+#include <instrumentation.hh>
+
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
+MSDecisionRules::MSDecisionRules(size_t n_arg, size_t p_arg, const std::vector<size_t> &zeta_fwrd_arg,
+                                 const std::vector<size_t> &zeta_back_arg, const std::vector<size_t> &zeta_mixed_arg,
+                                 const std::vector<size_t> &zeta_static_arg, double qz_criterium, size_t number_of_regimes_arg,
+                                 int number_of_threads_arg, double tol_arg, size_t max_iterations_arg) :
+  n(n_arg), p(p_arg), number_of_regimes(number_of_regimes_arg),
+  n_fwrd_mixed(zeta_fwrd_arg.size() + zeta_mixed_arg.size()),
+  n_back_mixed(zeta_back_arg.size() + zeta_mixed_arg.size()),
+  number_of_threads(std::max(number_of_threads_arg, 1)), tol(tol_arg), max_iterations(max_iterations_arg),
+  dr(n_arg, p_arg, zeta_fwrd_arg, zeta_back_arg, zeta_mixed_arg, zeta_static_arg, qz_criterium),
+  meanJacobian(n, n_back_mixed + n + n_fwrd_mixed + p), g_u_mean(n, p), pi(number_of_regimes),
+  g_y_fwrd(number_of_regimes, Matrix(n_fwrd_mixed, n_back_mixed)),
+  expected_g_y_fwrd(number_of_regimes, Matrix(n_fwrd_mixed, n_back_mixed)),
+  A_p_g(number_of_regimes, Matrix(n, n_back_mixed)), X(number_of_regimes, Matrix(n)),
+  g_y_new(number_of_regimes, Matrix(n, n_back_mixed))
+{
+  // Same orderings as in DecisionRules
+  set_union(zeta_fwrd_arg.begin(), zeta_fwrd_arg.end(),
+            zeta_mixed_arg.begin(), zeta_mixed_arg.end(),
+            back_inserter(zeta_fwrd_mixed));
+  set_union(zeta_back_arg.begin(), zeta_back_arg.end(),
+            zeta_mixed_arg.begin(), zeta_mixed_arg.end(),
+            back_inserter(zeta_back_mixed));
+  for (size_t s = 0; s < number_of_regimes; s++)
+    LU.push_back(new LUSolver(n));
+}
+
+MSDecisionRules::~MSDecisionRules()
+{
+  for (size_t s = 0; s < LU.size(); s++)
+    delete LU[s];
+}
+
+void
+MSDecisionRules::ergodicDistribution(const Matrix &P, Vector &pi) throw (LUSolver::LUException)
+{
+  size_t m = P.getRows();
+  assert(P.getCols() == m && pi.getSize() == m);
+
+  // (P'-I)*pi = 0, where the last equation is replaced by sum(pi) = 1
+  Matrix A(m), b(m, 1);
+  mat::transpose(A, P);
+  for (size_t i = 0; i < m; i++)
+    A(i, i) -= 1.0;
+  for (size_t j = 0; j < m; j++)
+    A(m-1, j) = 1.0;
+  b.setAll(0.0);
+  b(m-1, 0) = 1.0;
+  LUSolver LU(m);
+  LU.invMult("N", A, b);
+  for (size_t i = 0; i < m; i++)
+    pi(i) = b(i, 0);
+}
+
+void
+MSDecisionRules::computeX(size_t s, const Matrix &jacobian, const Matrix &P)
+{
+  Matrix &E = expected_g_y_fwrd[s];
+  E.setAll(0.0);
+  for (size_t r = 0; r < number_of_regimes; r++)
+    if (P(s, r) != 0.0)
+      for (size_t j = 0; j < n_back_mixed; j++)
+        for (size_t i = 0; i < n_fwrd_mixed; i++)
+          E(i, j) += P(s, r)*g_y_fwrd[r](i, j);
+
+  // X = A_0 + A_p*E(g_y_fwrd)*S_back
+  MatrixConstView A_p(jacobian, 0, n_back_mixed + n, n, n_fwrd_mixed);
+  X[s] = MatrixConstView(jacobian, 0, n_back_mixed, n, n);
+  blas::gemm("N", "N", 1.0, A_p, E, 0.0, A_p_g[s]);
+  for (size_t i = 0; i < n_back_mixed; i++)
+    {
+      VectorView c1 = mat::get_col(X[s], zeta_back_mixed[i]), c2 = mat::get_col(A_p_g[s], i);
+      vec::add(c1, c2);
+    }
+}
+
+size_t
+MSDecisionRules::compute(const std::vector<Matrix> &jacobians, const Matrix &P, std::vector<Matrix> &g_y, std::vector<Matrix> &g_u)
+  throw (DecisionRules::BlanchardKahnException, GeneralizedSchurDecomposition::GSDException, ConvergenceException)
+{
+  INSTRUMENT_SCOPE("ms_decision_rules");
+
+  assert(jacobians.size() == number_of_regimes && g_y.size() == number_of_regimes && g_u.size() == number_of_regimes);
+  assert(P.getRows() == number_of_regimes && P.getCols() == number_of_regimes);
+
+  // Constant-parameter solution, with the jacobians weighted by the ergodic distribution
+  try
+    {
+      ergodicDistribution(P, pi);
+    }
+  catch (LUSolver::LUException &e)
+    {
+      // The chain is reducible: the regimes are weighted equally
+      pi.setAll(1.0/number_of_regimes);
+    }
+  meanJacobian.setAll(0.0);
+  for (size_t s = 0; s < number_of_regimes; s++)
+    {
+      assert(jacobians[s].getRows() == n && jacobians[s].getCols() == meanJacobian.getCols());
+      for (size_t j = 0; j < meanJacobian.getCols(); j++)
+        for (size_t i = 0; i < n; i++)
+          meanJacobian(i, j) += pi(s)*jacobians[s](i, j);
+    }
+  dr.compute(meanJacobian, g_y[0], g_u_mean);
+  for (size_t s = 0; s < number_of_regimes; s++)
+    {
+      if (s > 0)
+        g_y[s] = g_y[0];
+      for (size_t i = 0; i < n_fwrd_mixed; i++)
+        mat::row_copy(g_y[s], zeta_fwrd_mixed[i], g_y_fwrd[s], i);
+    }
+
+  std::vector<double> change(number_of_regimes);
+  std::vector<char> singular(number_of_regimes);
+  size_t iter;
+  double distance = 0.0;
+  for (iter = 1; iter <= max_iterations; iter++)
+    {
+#ifdef USE_OMP
+# pragma omp parallel for num_threads(number_of_threads)
+#endif
+      for (int s = 0; s < (int) number_of_regimes; s++)
+        {
+          computeX(s, jacobians[s], P);
+          g_y_new[s] = MatrixConstView(jacobians[s], 0, 0, n, n_back_mixed);
+          mat::negate(g_y_new[s]);
+          singular[s] = false;
+          try
+            {
+              LU[s]->invMult("N", X[s], g_y_new[s]);
+            }
+          catch (LUSolver::LUException &e)
+            {
+              singular[s] = true;
+            }
+          change[s] = 0.0;
+          for (size_t j = 0; j < n_back_mixed; j++)
+            for (size_t i = 0; i < n; i++)
+              change[s] = std::max(change[s], fabs(g_y_new[s](i, j) - g_y[s](i, j)));
+        }
+
+      distance = 0.0;
+      double size = 1.0;
+      for (size_t s = 0; s < number_of_regimes; s++)
+        {
+          if (singular[s])
+            throw DecisionRules::BlanchardKahnException(false, n_fwrd_mixed, 0);
+          g_y[s] = g_y_new[s];
+          for (size_t i = 0; i < n_fwrd_mixed; i++)
+            mat::row_copy(g_y[s], zeta_fwrd_mixed[i], g_y_fwrd[s], i);
+          distance = std::max(distance, change[s]);
+          size = std::max(size, mat::nrminf(g_y[s]));
+        }
+      if (!(distance == distance) || distance > 1e10*size)
+        throw ConvergenceException(iter, distance);
+      if (distance <= tol*size)
+        break;
+    }
+  if (iter > max_iterations)
+    throw ConvergenceException(max_iterations, distance);
+
+#ifdef USE_OMP
+# pragma omp parallel for num_threads(number_of_threads)
+#endif
+  for (int s = 0; s < (int) number_of_regimes; s++)
+    {
+      computeX(s, jacobians[s], P);
+      g_u[s] = MatrixConstView(jacobians[s], 0, n_back_mixed + n + n_fwrd_mixed, n, p);
+      mat::negate(g_u[s]);
+      singular[s] = false;
+      try
+        {
+          LU[s]->invMult("N", X[s], g_u[s]);
+        }
+      catch (LUSolver::LUException &e)
+        {
+          singular[s] = true;
+        }
+    }
+  for (size_t s = 0; s < number_of_regimes; s++)
+    if (singular[s])
+      throw DecisionRules::BlanchardKahnException(false, n_fwrd_mixed, 0);
+
+  return iter;
+}
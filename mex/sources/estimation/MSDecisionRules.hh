@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if !defined(MS_DECISION_RULES_HH_INCLUDED)
+#define MS_DECISION_RULES_HH_INCLUDED
+
+#include <vector>
+
+#include "DecisionRules.hh"
+
+/**
+ * First order decision rules of a Markov-switching DSGE model, whose
+ * jacobian depends on the regime s_t, which follows a Markov chain of
+ * transition matrix P (P(i, j) is the probability of moving from regime i to
+ * regime j).
+ *
+ * The minimum state variable solution y_t = g_y(s_t)*y_t-1 + g_u(s_t)*u_t
+ * solves, for each regime s,
+ *   A_m(s) + A_0(s)*g_y(s) + A_p(s)*(sum_j P(s, j)*g_y_fwrd(j))*g_y_back(s) = 0
+ * where A_m, A_0, A_p are the blocks of the jacobian of regime s for lagged,
+ * current and leaded variables (see DecisionRules::compute()), and g_y_fwrd,
+ * g_y_back the rows of g_y for forward+mixed and backward+mixed variables.
+ *
+ * It is computed by functional iteration: given the decision rules of all
+ * the regimes, those of each regime are updated to
+ *   g_y(s) = -X(s)^(-1)*A_m(s), with X(s) = A_0(s) + A_p(s)*(sum_j P(s, j)*g_y_fwrd(j))*S_back,
+ * until they do not change any more. The regimes are updated in parallel
+ * from the decision rules of the previous iteration. The iteration starts
+ * from the constant-parameter solution, i.e. the decision rules of the
+ * average of the jacobians over the ergodic distribution of the chain.
+ * Finally, g_u(s) = -X(s)^(-1)*A_u(s).
+ */
+class MSDecisionRules
+{
+public:
+  class ConvergenceException
+  {
+  public:
+    const size_t iterations;
+    //! Largest change of the decision rules at the last iteration
+    const double distance;
+    ConvergenceException(size_t iterations_arg, double distance_arg) : iterations(iterations_arg), distance(distance_arg)
+    {
+    };
+  };
+
+  /*!
+    \param tol The iteration stops when the largest change of the decision rules is below tol
+  */
+  MSDecisionRules(size_t n_arg, size_t p_arg, const std::vector<size_t> &zeta_fwrd_arg,
+                  const std::vector<size_t> &zeta_back_arg, const std::vector<size_t> &zeta_mixed_arg,
+                  const std::vector<size_t> &zeta_static_arg, double qz_criterium, size_t number_of_regimes_arg,
+                  int number_of_threads_arg = 1, double tol_arg = 1e-12, size_t max_iterations_arg = 10000);
+  virtual ~MSDecisionRules();
+
+  /*!
+    \param jacobians The jacobians of the regimes, with the layout of DecisionRules::compute()
+    \param P Transition matrix of the regimes
+    \param[out] g_y,g_u The decision rules of the regimes
+    \return The number of iterations
+  */
+  size_t compute(const std::vector<Matrix> &jacobians, const Matrix &P, std::vector<Matrix> &g_y, std::vector<Matrix> &g_u)
+    throw (DecisionRules::BlanchardKahnException, GeneralizedSchurDecomposition::GSDException, ConvergenceException);
+
+  //! Computes the ergodic distribution pi of the Markov chain of transition matrix P, i.e. pi = P'*pi with sum(pi) = 1
+  static void ergodicDistribution(const Matrix &P, Vector &pi) throw (LUSolver::LUException);
+
+private:
+  const size_t n, p, number_of_regimes;
+  std::vector<size_t> zeta_fwrd_mixed, zeta_back_mixed;
+  const size_t n_fwrd_mixed, n_back_mixed;
+  const int number_of_threads;
+  const double tol;
+  const size_t max_iterations;
+  //! Solver of the constant-parameter model
+  DecisionRules dr;
+  Matrix meanJacobian, g_u_mean;
+  Vector pi;
+  // Work matrices and LU solvers, one by regime
+  std::vector<Matrix> g_y_fwrd, expected_g_y_fwrd, A_p_g, X, g_y_new;
+  std::vector<LUSolver *> LU;
+
+  //! Computes X of regime s from the current decision rules g_y_fwrd of all the regimes
+  void computeX(size_t s, const Matrix &jacobian, const Matrix &P);
+
+  // Forbid copy (the LU solvers are owned)
+  MSDecisionRules(const MSDecisionRules &);
+  MSDecisionRules &operator=(const MSDecisionRules &);
+};
+
+#endif // !defined(MS_DECISION_RULES_HH_INCLUDED)
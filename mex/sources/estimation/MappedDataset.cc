@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <stdint.h>
+
+#if !defined(_WIN32) && !defined(__CYGWIN32__)
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+#endif
+
+#include "MappedDataset.hh"
+
+const char MappedDataset::magic[8] = { 'D', 'Y', 'N', 'D', 'A', 'T', 'A', '1' };
+
+namespace
+{
+  const size_t header_size = sizeof(MappedDataset::magic) + 3*sizeof(uint64_t);
+  const size_t data_alignment = 64;
+}
+
+MappedDataset::MappedDataset(const std::string &filename) :
+  nvars(0), nobs(0), data(NULL), address(NULL), length(0)
+{
+#if defined(_WIN32) || defined(__CYGWIN32__)
+  file = CreateFile(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    throw std::runtime_error("MappedDataset: can not open " + filename);
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size))
+    {
+      CloseHandle(file);
+      throw std::runtime_error("MappedDataset: can not get the size of " + filename);
+    }
+  length = (size_t) size.QuadPart;
+  mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mapping != NULL)
+    address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (address == NULL)
+    {
+      if (mapping != NULL)
+        CloseHandle(mapping);
+      CloseHandle(file);
+      throw std::runtime_error("MappedDataset: can not map " + filename);
+    }
+#else
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("MappedDataset: can not open " + filename);
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+    {
+      close(fd);
+      throw std::runtime_error("MappedDataset: can not get the size of " + filename);
+    }
+  length = (size_t) st.st_size;
+  if (length > 0)
+    address = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd); // The mapping keeps a reference to the file
+  if (length == 0 || address == MAP_FAILED)
+    {
+      address = NULL;
+      throw std::runtime_error("MappedDataset: can not map " + filename);
+    }
+#endif
+
+  // Parse the header, any inconsistency means that the file is not a dataset
+  const char *base = (const char *) address;
+  uint64_t sizes[3];
+  if (length < header_size || memcmp(base, magic, sizeof(magic)) != 0)
+    {
+      unmap();
+      throw std::runtime_error("MappedDataset: " + filename + " is not a dataset file");
+    }
+  memcpy(sizes, base + sizeof(magic), sizeof(sizes));
+  nvars = (size_t) sizes[0];
+  nobs = (size_t) sizes[1];
+  const size_t data_offset = (size_t) sizes[2];
+  if (data_offset % data_alignment != 0 || data_offset > length
+      || (length - data_offset)/sizeof(double)/(nvars > 0 ? nvars : 1) < nobs)
+    {
+      unmap();
+      throw std::runtime_error("MappedDataset: " + filename + " is truncated or corrupted");
+    }
+  const char *p = base + header_size, *end = base + data_offset;
+  for (size_t i = 0; i < nvars + nobs; i++)
+    {
+      const char *q = (const char *) memchr(p, '\0', end - p);
+      if (q == NULL)
+        {
+          unmap();
+          throw std::runtime_error("MappedDataset: " + filename + " is truncated or corrupted");
+        }
+      (i < nvars ? names : dates).push_back(std::string(p, q));
+      p = q + 1;
+    }
+  data = (const double *) (base + data_offset);
+}
+
+MappedDataset::~MappedDataset()
+{
+  unmap();
+}
+
+void
+MappedDataset::unmap()
+{
+  if (address == NULL)
+    return;
+#if defined(_WIN32) || defined(__CYGWIN32__)
+  UnmapViewOfFile(address);
+  CloseHandle(mapping);
+  CloseHandle(file);
+#else
+  munmap(address, length);
+#endif
+  address = NULL;
+}
+
+int
+MappedDataset::getIndex(const std::string &name) const
+{
+  for (size_t i = 0; i < nvars; i++)
+    if (names[i] == name)
+      return (int) i;
+  return -1;
+}
+
+MatrixConstView
+MappedDataset::getData(size_t first_var, size_t nvars_arg, size_t first_obs, size_t nobs_arg) const
+{
+  assert(first_var + nvars_arg <= nvars && first_obs + nobs_arg <= nobs);
+  return MatrixConstView(data + first_var + first_obs*nvars, nvars_arg, nobs_arg, nvars);
+}
+
+void
+MappedDataset::write(const std::string &filename, const std::vector<std::string> &names,
+                     const std::vector<std::string> &dates, const MatrixConstView &data)
+{
+  const size_t nvars = data.getRows(), nobs = data.getCols();
+  assert(names.size() == nvars && (dates.empty() || dates.size() == nobs));
+
+  std::string strings;
+  for (size_t i = 0; i < nvars; i++)
+    strings.append(names[i].c_str(), names[i].size() + 1);
+  for (size_t t = 0; t < nobs; t++)
+    if (dates.empty())
+      strings.push_back('\0');
+    else
+      strings.append(dates[t].c_str(), dates[t].size() + 1);
+  const size_t data_offset = (header_size + strings.size() + data_alignment - 1)/data_alignment*data_alignment;
+  strings.resize(data_offset - header_size, '\0');
+
+  FILE *fd = fopen(filename.c_str(), "wb");
+  if (fd == NULL)
+    throw std::runtime_error("MappedDataset: can not open " + filename + " for writing");
+  uint64_t sizes[3] = { nvars, nobs, data_offset };
+  bool ok = fwrite(magic, sizeof(magic), 1, fd) == 1
+    && fwrite(sizes, sizeof(uint64_t), 3, fd) == 3
+    && fwrite(strings.data(), 1, strings.size(), fd) == strings.size();
+  if (data.getLd() == nvars)
+    ok = ok && fwrite(data.getData(), sizeof(double), nvars*nobs, fd) == nvars*nobs;
+  else
+    for (size_t t = 0; ok && t < nobs; t++)
+      ok = fwrite(data.getData() + t*data.getLd(), sizeof(double), nvars, fd) == nvars;
+  if (fclose(fd) != 0 || !ok)
+    throw std::runtime_error("MappedDataset: can not write to " + filename);
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if !defined(MAPPEDDATASET_HH_INCLUDED)
+#define MAPPEDDATASET_HH_INCLUDED
+
+#if defined(_WIN32) || defined(__CYGWIN32__)
+# ifndef NOMINMAX
+#  define NOMINMAX // Do not define "min" and "max" macros
+# endif
+# include <windows.h>
+#endif
+
+#include <string>
+#include <vector>
+
+#include "Matrix.hh"
+
+/**
+ * Read-only memory mapping of a binary dataset, whose observations are used
+ * in place as a MatrixConstView, without being parsed nor copied. All the
+ * processes mapping the same file share one physical copy of the data.
+ *
+ * The file is made of (in native byte order):
+ * - the magic string "DYNDATA1" (8 bytes);
+ * - three uint64 numbers: the number of variables, the number of
+ *   observations, and the offset of the data from the beginning of the file
+ *   (a multiple of 64);
+ * - the names of the variables, then the dates of the observations, as
+ *   NUL-terminated strings (the dates may be empty strings);
+ * - the data, stored by period: a column of the nvars*nobs matrix holds the
+ *   observations of all the variables for one period, which is the layout
+ *   expected by the estimation routines.
+ */
+class MappedDataset
+{
+public:
+  //! Maps the file, throws std::runtime_error if it is not a valid dataset
+  MappedDataset(const std::string &filename);
+  virtual ~MappedDataset();
+
+  size_t
+  getNumberOfVariables() const
+  {
+    return nvars;
+  }
+  size_t
+  getNumberOfObservations() const
+  {
+    return nobs;
+  }
+  const std::vector<std::string> &
+  getNames() const
+  {
+    return names;
+  }
+  const std::vector<std::string> &
+  getDates() const
+  {
+    return dates;
+  }
+  //! Returns the index of a variable, or -1 if the dataset does not contain it
+  int getIndex(const std::string &name) const;
+
+  //! The nvars*nobs matrix of the observations
+  MatrixConstView
+  getData() const
+  {
+    return MatrixConstView(data, nvars, nobs, nvars);
+  }
+  //! The observations of nvars_arg consecutive variables in nobs_arg consecutive periods, starting at 0-based indices
+  MatrixConstView getData(size_t first_var, size_t nvars_arg, size_t first_obs, size_t nobs_arg) const;
+
+  //! Writes a dataset in the format read by this class
+  static void write(const std::string &filename, const std::vector<std::string> &names,
+                    const std::vector<std::string> &dates, const MatrixConstView &data);
+
+  static const char magic[8];
+
+private:
+  size_t nvars, nobs;
+  std::vector<std::string> names, dates;
+  const double *data;
+  void *address;
+  size_t length;
+#if defined(_WIN32) || defined(__CYGWIN32__)
+  HANDLE file, mapping;
+#endif
+  MappedDataset(const MappedDataset &);
+  MappedDataset &operator=(const MappedDataset &);
+  void unmap();
+};
+
+#endif // !defined(MAPPEDDATASET_HH_INCLUDED)
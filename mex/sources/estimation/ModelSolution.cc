@@ -27,6 +27,9 @@
 
 #include "ModelSolution.hh"
 
+// Cube root of the machine epsilon, which minimizes the error of central differences
+const double ModelSolution::finite_difference_step = 6e-6;
+
 /**
  * compute the steady state (2nd stage), and computes first order approximation
  */
@@ -39,10 +42,14 @@ ModelSolution::ModelSolution(const std::string &basename,  size_t n_endo_arg, si
   decisionRules(n_endo_arg, n_exo_arg, zeta_fwrd_arg, zeta_back_arg, zeta_mixed_arg, zeta_static_arg, INqz_criterium),
   dynamicDLLp(basename),
   steadyStateSolver(basename, n_endo),
-  llXsteadyState(n_jcols-n_exo)
+  llXsteadyState(n_jcols-n_exo), solutionCached(false), cachedSteadyState(n_endo),
+  cachedGhx(n_endo, zeta_back_arg.size() + zeta_mixed_arg.size()), cachedGhu(n_endo, n_exo),
+  jacobianPert(n_endo, n_jcols), d_jacobian(n_endo, n_jcols), steadyStatePert(n_endo)
 {
   Mx.setAll(0.0);
   jacobian.setAll(0.0);
+  jacobianPert.setAll(0.0);
+  d_jacobian.setAll(0.0);
 
   set_union(zeta_fwrd_arg.begin(), zeta_fwrd_arg.end(),
             zeta_mixed_arg.begin(), zeta_mixed_arg.end(),
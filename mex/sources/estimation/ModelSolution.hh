@@ -26,9 +26,13 @@
 #if !defined(ModelSolution_5ADFF920_9C74_46f5_9FE9_88AD4D4BBF19__INCLUDED_)
 #define ModelSolution_5ADFF920_9C74_46f5_9FE9_88AD4D4BBF19__INCLUDED_
 
+#include <cmath>
+#include <algorithm>
+
 #include "DecisionRules.hh"
 #include "SteadyStateSolver.hh"
 #include "dynamic_dll.hh"
+#include <instrumentation.hh>
 
 /**
  * compute the steady state (2nd stage), and
@@ -49,6 +53,21 @@ public:
   void
   compute(Vec1 &steadyState, const Vec2 &deepParams, Mat1 &ghx, Mat2 &ghu) throw (DecisionRules::BlanchardKahnException, GeneralizedSchurDecomposition::GSDException, SteadyStateSolver::SteadyStateException)
   {
+    /* The estimated standard deviations and correlations only enter Q and H:
+       if none of the deep parameters has changed since the last successful
+       call, the steady state, the jacobian and the decision rules are those
+       of that call, and the QZ decomposition is skipped */
+    if (solutionCached && sameDeepParams(deepParams))
+      {
+        steadyState = cachedSteadyState;
+        ghx = cachedGhx;
+        ghu = cachedGhu;
+        INSTRUMENT_COUNT("model_solution_cache_hits", 1);
+        return;
+      }
+    INSTRUMENT_SCOPE("model_solution");
+    solutionCached = false;
+
     // compute Steady State
     steadyStateSolver.compute(steadyState, Mx, deepParams);
 
@@ -56,6 +75,57 @@ public:
 
     ComputeModelSolution(steadyState, deepParams, ghx, ghu);
 
+    cachedDeepParams.resize(deepParams.getSize());
+    for (size_t i = 0; i < deepParams.getSize(); i++)
+      cachedDeepParams[i] = deepParams(i);
+    cachedSteadyState = steadyState;
+    cachedGhx = ghx;
+    cachedGhu = ghu;
+    solutionCached = true;
+  }
+
+  //! Computes the derivatives of the steady state and of the decision rules with respect to the deep parameter k
+  /*!
+    Must be called after compute(), with the same arguments and its results.
+    The derivatives of the steady state and of the jacobian are central
+    differences of the static and dynamic model DLLs, since the preprocessor
+    writes the derivatives of the model with respect to the parameters for
+    Matlab and Julia only. Those of the decision rules are then analytic (see
+    DecisionRules::computeDerivatives).
+  */
+  template <class Vec1, class Vec2>
+  void
+  computeDerivatives(const Vec1 &steadyState, const Vec2 &deepParams, size_t k, const Matrix &ghx, const Matrix &ghu,
+                     Vector &d_steadyState, Matrix &d_ghx, Matrix &d_ghu)
+    throw (DecisionRules::BlanchardKahnException, SteadyStateSolver::SteadyStateException)
+  {
+    assert(k < deepParams.getSize());
+    Vector deepParamsPert(deepParams.getSize());
+    const double h = finite_difference_step*std::max(1.0, fabs(deepParams(k)));
+
+    for (int sign = 1; sign >= -1; sign -= 2)
+      {
+        deepParamsPert = deepParams;
+        deepParamsPert(k) += sign*h;
+        steadyStatePert = steadyState;
+        steadyStateSolver.compute(steadyStatePert, Mx, deepParamsPert);
+        setExtendedSteadyState(steadyStatePert);
+        // The jacobian at +h is stored in d_jacobian, the one at -h in jacobianPert
+        dynamicDLLp.eval(llXsteadyState, Mx, deepParamsPert, steadyStatePert, residual,
+                         sign == 1 ? &d_jacobian : &jacobianPert, NULL, NULL);
+        if (sign == 1)
+          d_steadyState = steadyStatePert;
+        else
+          vec::sub(d_steadyState, steadyStatePert);
+      }
+    mat::sub(d_jacobian, jacobianPert);
+    for (size_t j = 0; j < n_jcols; j++)
+      for (size_t i = 0; i < n_endo; i++)
+        d_jacobian(i, j) /= 2*h;
+    for (size_t i = 0; i < n_endo; i++)
+      d_steadyState(i) /= 2*h;
+
+    decisionRules.computeDerivatives(jacobian, d_jacobian, ghx, ghu, d_ghx, d_ghu);
   }
 
 private:
@@ -70,15 +140,34 @@ private:
   DynamicModelDLL dynamicDLLp;
   SteadyStateSolver steadyStateSolver;
   Vector llXsteadyState;
-  //Matrix jacobian;
-  template <class Vec1, class Vec2, class Mat1, class Mat2>
-  void
-  ComputeModelSolution(Vec1 &steadyState, const Vec2 &deepParams,
-                       Mat1 &ghx, Mat2 &ghu)
-    throw (DecisionRules::BlanchardKahnException, GeneralizedSchurDecomposition::GSDException)
+  // Solution for the deep parameters of the last successful call to compute()
+  bool solutionCached;
+  std::vector<double> cachedDeepParams;
+  Vector cachedSteadyState;
+  Matrix cachedGhx, cachedGhu;
+  // Work arrays of computeDerivatives()
+  Matrix jacobianPert, d_jacobian;
+  Vector steadyStatePert;
+  //! Relative step of the central differences of computeDerivatives()
+  static const double finite_difference_step;
+
+  template <class Vec1>
+  bool
+  sameDeepParams(const Vec1 &deepParams) const
   {
-    // set extended Steady State
+    if (deepParams.getSize() != cachedDeepParams.size())
+      return false;
+    for (size_t i = 0; i < deepParams.getSize(); i++)
+      if (deepParams(i) != cachedDeepParams[i])
+        return false;
+    return true;
+  }
 
+  // set extended Steady State
+  template <class Vec1>
+  void
+  setExtendedSteadyState(const Vec1 &steadyState)
+  {
     for (size_t i = 0; i < zeta_back_mixed.size(); i++)
       llXsteadyState(i) = steadyState(zeta_back_mixed[i]);
 
@@ -87,6 +176,16 @@ private:
 
     for (size_t i = 0; i < zeta_fwrd_mixed.size(); i++)
       llXsteadyState(zeta_back_mixed.size() + n_endo + i) = steadyState(zeta_fwrd_mixed[i]);
+  }
+
+  //Matrix jacobian;
+  template <class Vec1, class Vec2, class Mat1, class Mat2>
+  void
+  ComputeModelSolution(Vec1 &steadyState, const Vec2 &deepParams,
+                       Mat1 &ghx, Mat2 &ghu)
+    throw (DecisionRules::BlanchardKahnException, GeneralizedSchurDecomposition::GSDException)
+  {
+    setExtendedSteadyState(steadyState);
 
     //get jacobian
     dynamicDLLp.eval(llXsteadyState, Mx, deepParams, steadyState, residual, &jacobian, NULL, NULL);
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if !defined(OSR_OBJECTIVE_HH__INCLUDED_)
+#define OSR_OBJECTIVE_HH__INCLUDED_
+
+#include <vector>
+
+#include "ModelSolution.hh"
+#include "DiscLyapFast.hh"
+
+/**
+ * Loss function of the optimal simple rules, i.e. the weighted sum of the
+ * theoretical (co)variances of a subset of the endogenous variables implied
+ * by the first order solution of the model (what osr_obj.m computes with
+ * resol and get_variance_of_endogenous_variables).
+ *
+ * With s the state variables (zeta_back_mixed) and y = ghx*s(-1) + ghu*e,
+ * the variance of the states solves Sigma = A*Sigma*A' + B*Q*B', with
+ * A = ghx(zeta_back_mixed,:) and B = ghu(zeta_back_mixed,:), and the
+ * variance of y(var_list) is G*Sigma*G' + H*Q*H', with G = ghx(var_list,:)
+ * and H = ghu(var_list,:).
+ *
+ * Since the optimizer moves the rule coefficients by small steps, the
+ * Lyapunov equation can be solved by fixed point iterations started from the
+ * solution of the previous call (see DiscLyapFast::solve_lyap_warm).
+ */
+class OsrObjective
+{
+public:
+  /*!
+    \param[in] var_list_arg Indices of the target variables (in declaration order)
+    \param[in] lyapunov_fp_tol_arg Tolerance of the warm-started fixed point iterations (0 to always use the doubling algorithm)
+  */
+  OsrObjective(const std::string &basename, size_t n_endo, size_t n_exo, const std::vector<size_t> &zeta_fwrd_arg,
+               const std::vector<size_t> &zeta_back_arg, const std::vector<size_t> &zeta_mixed_arg,
+               const std::vector<size_t> &zeta_static_arg, double qz_criterium, double lyapunov_tol_arg,
+               double lyapunov_fp_tol_arg, const std::vector<size_t> &var_list_arg);
+  virtual
+  ~OsrObjective();
+
+  //! Computes the loss for the given parameters
+  /*!
+    \param[in] W Weights of the loss, nvar*nvar
+    \param[out] vx Variance of the variables of var_list, nvar*nvar
+    \return sum(sum(W.*vx))
+  */
+  template <class Vec1, class Vec2, class Mat1, class Mat2, class Mat3>
+  double
+  compute(Vec1 &steadyState, const Vec2 &deepParams, const Mat1 &Q_arg, const Mat2 &W, Mat3 &vx)
+    throw (DecisionRules::BlanchardKahnException, GeneralizedSchurDecomposition::GSDException,
+           SteadyStateSolver::SteadyStateException, DiscLyapFast::DLPException)
+  {
+    assert(W.getRows() == var_list.size() && W.getCols() == var_list.size()
+           && vx.getRows() == var_list.size() && vx.getCols() == var_list.size());
+
+    modelSolution.compute(steadyState, deepParams, ghx, ghu);
+    Q = Q_arg;
+    mat::assignByVectors(A, mat::nullVec, mat::nullVec, ghx, zeta_back_mixed, mat::nullVec);
+    mat::assignByVectors(B, mat::nullVec, mat::nullVec, ghu, zeta_back_mixed, mat::nullVec);
+    mat::assignByVectors(G, mat::nullVec, mat::nullVec, ghx, var_list, mat::nullVec);
+    mat::assignByVectors(H, mat::nullVec, mat::nullVec, ghu, var_list, mat::nullVec);
+
+    // Sigma = A*Sigma*A' + B*Q*B'
+    if (n_state > 0)
+      {
+        blas::gemm("N", "N", 1.0, B, Q, 0.0, BQ);
+        blas::gemm("N", "T", 1.0, BQ, B, 0.0, V);
+        if (lyapunov_fp_tol > 0.0)
+          discLyapFast.solve_lyap_warm(A, V, Sigma, lyapunov_fp_tol, lyapunov_tol);
+        else
+          discLyapFast.solve_lyap(A, V, Sigma, lyapunov_tol, 0);
+      }
+
+    // vx = G*Sigma*G' + H*Q*H'
+    Vx.setAll(0.0);
+    if (n_state > 0)
+      {
+        blas::gemm("N", "N", 1.0, G, Sigma, 0.0, GSigma);
+        blas::gemm("N", "T", 1.0, GSigma, G, 0.0, Vx);
+      }
+    blas::gemm("N", "N", 1.0, H, Q, 0.0, HQ);
+    blas::gemm("N", "T", 1.0, HQ, H, 1.0, Vx);
+    vx = Vx;
+
+    return weightedSum(W, Vx);
+  }
+
+  //! Computes the derivative of the loss with respect to the deep parameter k
+  /*!
+    Must be called after compute(), with the same arguments. The derivatives
+    of the decision rules are given by ModelSolution::computeDerivatives, and
+    that of Sigma solves
+      dSigma = A*dSigma*A' + dA*Sigma*A' + A*Sigma*dA' + dB*Q*B' + B*Q*dB'
+  */
+  template <class Vec1, class Vec2, class Mat>
+  double
+  computeDerivative(const Vec1 &steadyState, const Vec2 &deepParams, size_t k, const Mat &W)
+    throw (DecisionRules::BlanchardKahnException, SteadyStateSolver::SteadyStateException, DiscLyapFast::DLPException)
+  {
+    modelSolution.computeDerivatives(steadyState, deepParams, k, ghx, ghu, d_steadyState, d_ghx, d_ghu);
+    mat::assignByVectors(dG, mat::nullVec, mat::nullVec, d_ghx, var_list, mat::nullVec);
+    mat::assignByVectors(dH, mat::nullVec, mat::nullVec, d_ghu, var_list, mat::nullVec);
+
+    // dvx = dG*Sigma*G' + G*Sigma*dG' + G*dSigma*G' + dH*Q*H' + H*Q*dH'
+    blas::gemm("N", "T", 1.0, dH, HQ, 0.0, dVxTmp);
+    if (n_state > 0)
+      {
+        mat::assignByVectors(dA, mat::nullVec, mat::nullVec, d_ghx, zeta_back_mixed, mat::nullVec);
+        mat::assignByVectors(dB, mat::nullVec, mat::nullVec, d_ghu, zeta_back_mixed, mat::nullVec);
+
+        blas::gemm("N", "T", 1.0, Sigma, A, 0.0, dSigma);
+        blas::gemm("N", "N", 1.0, dA, dSigma, 0.0, dVTmp);
+        blas::gemm("N", "T", 1.0, dB, BQ, 1.0, dVTmp);
+        mat::transpose(dV, dVTmp);
+        mat::add(dV, dVTmp);
+        discLyapFast.solve_lyap(A, dV, dSigma, lyapunov_tol, 0);
+
+        blas::gemm("N", "T", 1.0, dG, GSigma, 1.0, dVxTmp);
+        blas::gemm("N", "N", 1.0, G, dSigma, 0.0, GdSigma);
+        blas::gemm("N", "T", 1.0, GdSigma, G, 0.0, dVx);
+      }
+    else
+      dVx.setAll(0.0);
+    mat::add(dVx, dVxTmp);
+    mat::transpose(dVxTmp);
+    mat::add(dVx, dVxTmp);
+
+    return weightedSum(W, dVx);
+  }
+
+private:
+  const size_t n_state;
+  const double lyapunov_tol, lyapunov_fp_tol;
+  const std::vector<size_t> var_list;
+  std::vector<size_t> zeta_back_mixed;
+  ModelSolution modelSolution;
+  DiscLyapFast discLyapFast;
+  Matrix ghx, ghu, Q; // n_endo*n_state, n_endo*n_exo, n_exo*n_exo
+  Matrix A, B, BQ, V, Sigma; // n_state*n_state, except B and BQ n_state*n_exo
+  Matrix G, H, GSigma, HQ, Vx; // nvar*n_state, nvar*n_exo, nvar*n_state, nvar*n_exo, nvar*nvar
+  // Work arrays of computeDerivative()
+  Vector d_steadyState;
+  Matrix d_ghx, d_ghu, dA, dB, dV, dVTmp, dSigma, dG, dH, GdSigma, dVx, dVxTmp;
+
+  template <class Mat1, class Mat2>
+  static double
+  weightedSum(const Mat1 &W, const Mat2 &X)
+  {
+    double s = 0.0;
+    for (size_t j = 0; j < X.getCols(); ++j)
+      for (size_t i = 0; i < X.getRows(); ++i)
+        s += W(i, j)*X(i, j);
+    return s;
+  }
+};
+
+#endif // !defined(OSR_OBJECTIVE_HH__INCLUDED_)
@@ -0,0 +1,398 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <algorithm>
+
+#include <boost/random/normal_distribution.hpp>
+
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
+#include "ParticleFilter.hh"
+#include "BlasBindings.hh"
+#include "LapackBindings.hh"
+#include "ss2_iteration.hh"
+
+ParticleFilter::ParticleFilter(size_t m_arg, size_t q_arg, const std::vector<size_t> &mf0_arg, const std::vector<size_t> &mf1_arg,
+                               size_t number_of_particles, Algorithm algorithm_arg, bool pruning_arg, double resampling_threshold_arg,
+                               bool stratified_arg, double lyapunov_tol_arg, int number_of_threads_arg) :
+  m(m_arg), q(q_arg), n(mf0_arg.size()), p(mf1_arg.size()), s(number_of_particles), mf0(mf0_arg), mf1(mf1_arg),
+  algorithm(algorithm_arg), pruning(pruning_arg), stratified(stratified_arg),
+  resampling_threshold(resampling_threshold_arg), lyapunov_tol(lyapunov_tol_arg),
+  number_of_threads(std::max(number_of_threads_arg, 1)), particleRngs(number_of_particles),
+  initialParticleRngs(number_of_particles), fixedSeed(false),
+  Ts(n), Rs(n, q), RQf(n, q), RQRs(n), Pstar(n), Pf(n), Qf(q), Hchol(p), Zu(p, q), ZuQf(p, q), Fchol(p), discLyapFast(n), eigP(n), eigQ(q),
+  yhat(n, s), yhat_(pruning_arg ? n : 0, s), parents(n, s), parents_(pruning_arg ? n : 0, s),
+  y(m, s), y_(pruning_arg ? m : 0, s), ymu(algorithm_arg == auxiliary ? m : 0, s),
+  epsilon(q, s), zeroInnovations(algorithm_arg == auxiliary ? q : 0, s),
+  z(std::max(std::max(n, q), p), number_of_threads), logWeights(s), weights(s), logDensities(s),
+  predictionLogDensities(s), indices(s), uniforms(s)
+{
+  if (s < 2)
+    throw std::runtime_error("ParticleFilter: at least two particles are needed");
+  for (size_t i = 0; i < n; ++i)
+    if (mf0[i] >= m)
+      throw std::runtime_error("ParticleFilter: the indices of the states are out of bounds");
+  for (size_t i = 0; i < p; ++i)
+    if (mf1[i] >= m)
+      throw std::runtime_error("ParticleFilter: the indices of the observed variables are out of bounds");
+  if (algorithm == auxiliary)
+    zeroInnovations.setAll(0.0);
+  seed(0, false);
+}
+
+ParticleFilter::~ParticleFilter()
+{
+}
+
+void
+ParticleFilter::seed(uint64_t seed_arg, bool fixed)
+{
+  // The streams of the particles follow the one of the resampling
+  rng.seed(seed_arg);
+  Xoshiro256StarStar g(rng);
+  g.jump();
+  for (size_t i = 0; i < s; ++i)
+    particleRngs[i] = g.split();
+  fixedSeed = fixed;
+  if (fixed)
+    {
+      initialRng = rng;
+      initialParticleRngs = particleRngs;
+    }
+}
+
+double
+ParticleFilter::uniform(Xoshiro256StarStar &g)
+{
+  // 53 random bits, in the open interval (0, 1)
+  return ((g() >> 11) + 0.5)*(1.0/9007199254740992.0);
+}
+
+double
+ParticleFilter::logSumExp(const Vector &x)
+{
+  double x_max = -INFINITY;
+  for (size_t i = 0; i < x.getSize(); ++i)
+    x_max = std::max(x_max, x(i));
+  if (!(x_max > -INFINITY))
+    return -INFINITY;
+  double sum = 0.0;
+  for (size_t i = 0; i < x.getSize(); ++i)
+    sum += exp(x(i) - x_max);
+  return log(sum) + x_max;
+}
+
+void
+ParticleFilter::factorize(VDVEigDecomposition &eig, const Matrix &V, Matrix &Vf)
+{
+  eig.calculate(V);
+  if (!eig.hasConverged())
+    throw std::runtime_error("ParticleFilter: the eigen decomposition of a covariance matrix did not converge");
+  const Matrix &vectors = eig.getV();
+  const Vector &values = eig.getD();
+  for (size_t j = 0; j < Vf.getCols(); ++j)
+    {
+      double d = sqrt(std::max(values(j), 0.0));
+      for (size_t i = 0; i < Vf.getRows(); ++i)
+        Vf(i, j) = vectors(i, j)*d;
+    }
+}
+
+void
+ParticleFilter::drawInitialParticles()
+{
+#ifdef USE_OMP
+# pragma omp parallel for num_threads(number_of_threads)
+#endif
+  for (int j = 0; j < (int) s; ++j)
+    {
+#ifdef USE_OMP
+      double *zj = &z(0, omp_get_thread_num());
+#else
+      double *zj = &z(0, 0);
+#endif
+      boost::normal_distribution<double> normal;
+      for (size_t i = 0; i < n; ++i)
+        zj[i] = normal(particleRngs[j]);
+      for (size_t i = 0; i < n; ++i)
+        {
+          double x = 0.0;
+          for (size_t k = 0; k < n; ++k)
+            x += Pf(i, k)*zj[k];
+          yhat(i, j) = x;
+          if (pruning)
+            yhat_(i, j) = x;
+        }
+    }
+}
+
+void
+ParticleFilter::drawInnovations()
+{
+#ifdef USE_OMP
+# pragma omp parallel for num_threads(number_of_threads)
+#endif
+  for (int j = 0; j < (int) s; ++j)
+    {
+#ifdef USE_OMP
+      double *zj = &z(0, omp_get_thread_num());
+#else
+      double *zj = &z(0, 0);
+#endif
+      boost::normal_distribution<double> normal;
+      for (size_t i = 0; i < q; ++i)
+        zj[i] = normal(particleRngs[j]);
+      for (size_t i = 0; i < q; ++i)
+        {
+          double e = 0.0;
+          for (size_t k = 0; k < q; ++k)
+            e += Qf(i, k)*zj[k];
+          epsilon(i, j) = e;
+        }
+    }
+}
+
+void
+ParticleFilter::measurementLogDensities(const Matrix &x, const MatrixConstView &data, size_t t, const Matrix &L, Vector &ld)
+{
+  double logdet = 0.0;
+  for (size_t i = 0; i < p; ++i)
+    logdet += 2*log(L(i, i));
+  const double c = -.5*(p*log(2*M_PI) + logdet);
+
+#ifdef USE_OMP
+# pragma omp parallel for num_threads(number_of_threads)
+#endif
+  for (int j = 0; j < (int) s; ++j)
+    {
+#ifdef USE_OMP
+      double *zj = &z(0, omp_get_thread_num());
+#else
+      double *zj = &z(0, 0);
+#endif
+      // Solves L*z = y-Y by forward substitution
+      double zz = 0.0;
+      for (size_t i = 0; i < p; ++i)
+        {
+          double zi = x(mf1[i], j) - data(i, t);
+          for (size_t k = 0; k < i; ++k)
+            zi -= L(i, k)*zj[k];
+          zj[i] = zi/L(i, i);
+          zz += zj[i]*zj[i];
+        }
+      ld(j) = c - .5*zz;
+    }
+}
+
+double
+ParticleFilter::updateWeights(const Vector &ld)
+{
+  for (size_t j = 0; j < s; ++j)
+    logWeights(j) += ld(j);
+  double lik = logSumExp(logWeights);
+  if (!(lik > -INFINITY))
+    return -INFINITY;
+  for (size_t j = 0; j < s; ++j)
+    {
+      logWeights(j) -= lik;
+      weights(j) = exp(logWeights(j));
+    }
+  return lik;
+}
+
+void
+ParticleFilter::resamplingIndices()
+{
+  // The j-th particle is drawn at the position (j+u_j)/s of the cumulated weights
+  if (stratified)
+    for (size_t j = 0; j < s; ++j)
+      uniforms[j] = uniform(rng);
+  else
+    uniforms[0] = uniform(rng);
+  double cumulated = weights(0);
+  size_t i = 0;
+  for (size_t j = 0; j < s; ++j)
+    {
+      const double position = (j + uniforms[stratified ? j : 0])/s;
+      while (cumulated < position && i < s - 1)
+        cumulated += weights(++i);
+      indices[j] = i;
+    }
+  INSTRUMENT_COUNT("particle_filter_resamplings", 1);
+}
+
+void
+ParticleFilter::extractStates(const Matrix &x, const double *ss, bool resample, Matrix &states)
+{
+#ifdef USE_OMP
+# pragma omp parallel for num_threads(number_of_threads)
+#endif
+  for (int j = 0; j < (int) s; ++j)
+    {
+      size_t k = resample ? indices[j] : j;
+      for (size_t i = 0; i < n; ++i)
+        states(i, j) = x(mf0[i], k) - ss[mf0[i]];
+    }
+}
+
+double
+ParticleFilter::filter(const MatrixConstView &data, const double *ghx, const double *ghu, const double *constant,
+                       const double *ghxx, const double *ghuu, const double *ghxu, const double *ss,
+                       const Matrix &Q, const Matrix &H, VectorView &vll, size_t start)
+{
+  INSTRUMENT_SCOPE("particle_filter");
+  const size_t T = data.getCols();
+
+  for (size_t t = 0; t < T; ++t)
+    for (size_t i = 0; i < p; ++i)
+      if (data(i, t) != data(i, t))
+        throw std::runtime_error("ParticleFilter: missing observations are not supported");
+
+  if (fixedSeed)
+    {
+      rng = initialRng;
+      particleRngs = initialParticleRngs;
+    }
+
+  // Measurement errors and innovations
+  Hchol = H;
+  if (lapack::choleskyDecomp(Hchol, "L") != 0)
+    throw std::runtime_error("ParticleFilter: the covariance matrix of the measurement errors is not positive definite");
+  factorize(eigQ, Q, Qf);
+
+  // Ergodic distribution of the first order approximation of the states: Pstar = Ts*Pstar*Ts' + Rs*Q*Rs'
+  for (size_t i = 0; i < n; ++i)
+    {
+      for (size_t k = 0; k < n; ++k)
+        Ts(i, k) = ghx[mf0[i] + k*m];
+      for (size_t k = 0; k < q; ++k)
+        Rs(i, k) = ghu[mf0[i] + k*m];
+    }
+  blas::gemm("N", "N", 1.0, Rs, Qf, 0.0, RQf);
+  blas::gemm("N", "T", 1.0, RQf, RQf, 0.0, RQRs);
+  discLyapFast.solve_lyap(Ts, RQRs, Pstar, lyapunov_tol, 0);
+  factorize(eigP, Pstar, Pf);
+
+  /* The first stage of the auxiliary particle filter weights the predictions
+     with the covariance of the observations given the states at the first
+     order, i.e. H plus the variance due to the innovations */
+  if (algorithm == auxiliary)
+    {
+      for (size_t i = 0; i < p; ++i)
+        for (size_t k = 0; k < q; ++k)
+          Zu(i, k) = ghu[mf1[i] + k*m];
+      blas::gemm("N", "N", 1.0, Zu, Qf, 0.0, ZuQf);
+      Fchol = H;
+      blas::gemm("N", "T", 1.0, ZuQf, ZuQf, 1.0, Fchol);
+      if (lapack::choleskyDecomp(Fchol, "L") != 0)
+        throw std::runtime_error("ParticleFilter: the covariance matrix of the predicted observations is not positive definite");
+    }
+
+  drawInitialParticles();
+  logWeights.setAll(-log((double) s));
+  weights.setAll(1.0/s);
+
+  double loglik = 0.0;
+  for (size_t t = 0; t < T; ++t)
+    {
+      double lik;
+      if (algorithm == auxiliary)
+        {
+          // First stage: resampling with the likelihoods of the predictions without innovations
+          ss2Iteration(ymu.getData(), NULL, yhat.getData(), pruning ? yhat_.getData() : yhat.getData(),
+                       zeroInnovations.getData(), ghx, ghu, constant, ghxx, ghuu, ghxu, NULL,
+                       (int) m, (int) n, (int) q, (int) s, number_of_threads);
+          measurementLogDensities(ymu, data, t, Fchol, predictionLogDensities);
+          double firstStage = updateWeights(predictionLogDensities);
+          if (!(firstStage > -INFINITY))
+            {
+              lik = -INFINITY;
+              vll(t) = lik;
+              loglik = -INFINITY;
+              break;
+            }
+          resamplingIndices();
+#ifdef USE_OMP
+# pragma omp parallel for num_threads(number_of_threads)
+#endif
+          for (int j = 0; j < (int) s; ++j)
+            {
+              size_t k = indices[j];
+              for (size_t i = 0; i < n; ++i)
+                {
+                  parents(i, j) = yhat(i, k);
+                  if (pruning)
+                    parents_(i, j) = yhat_(i, k);
+                }
+              logWeights(j) = -predictionLogDensities(k);
+            }
+
+          // Second stage: propagation of the resampled particles
+          drawInnovations();
+          ss2Iteration(y.getData(), pruning ? y_.getData() : NULL, parents.getData(),
+                       pruning ? parents_.getData() : parents.getData(), epsilon.getData(),
+                       ghx, ghu, constant, ghxx, ghuu, ghxu, ss, (int) m, (int) n, (int) q, (int) s, number_of_threads);
+          measurementLogDensities(y, data, t, Hchol, logDensities);
+          lik = updateWeights(logDensities);
+          lik += firstStage - log((double) s);
+          extractStates(y, ss, false, yhat);
+          if (pruning)
+            extractStates(y_, ss, false, yhat_);
+        }
+      else
+        {
+          drawInnovations();
+          ss2Iteration(y.getData(), pruning ? y_.getData() : NULL, yhat.getData(),
+                       pruning ? yhat_.getData() : yhat.getData(), epsilon.getData(),
+                       ghx, ghu, constant, ghxx, ghuu, ghxu, ss, (int) m, (int) n, (int) q, (int) s, number_of_threads);
+          measurementLogDensities(y, data, t, Hchol, logDensities);
+          lik = updateWeights(logDensities);
+
+          // Resampling if the effective sample size 1/sum(w.^2) is too small
+          double sum2 = 0.0;
+          for (size_t j = 0; j < s; ++j)
+            sum2 += weights(j)*weights(j);
+          bool resample = (lik > -INFINITY) && 1.0 < resampling_threshold*s*sum2;
+          if (resample)
+            {
+              resamplingIndices();
+              logWeights.setAll(-log((double) s));
+              weights.setAll(1.0/s);
+            }
+          extractStates(y, ss, resample, yhat);
+          if (pruning)
+            extractStates(y_, ss, resample, yhat_);
+        }
+
+      vll(t) = lik;
+      if (!(lik > -INFINITY))
+        {
+          loglik = -INFINITY;
+          break;
+        }
+      if (t >= start)
+        loglik += lik;
+    }
+  INSTRUMENT_COUNT("particles", s*T);
+
+  return loglik;
+}
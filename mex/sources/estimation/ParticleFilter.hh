@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if !defined(PARTICLE_FILTER_HH_INCLUDED)
+#define PARTICLE_FILTER_HH_INCLUDED
+
+#include <vector>
+#include <stdexcept>
+
+#include "Vector.hh"
+#include "Matrix.hh"
+#include "VDVEigDecomposition.hh"
+#include "DiscLyapFast.hh"
+#include "RandomEngine.hh"
+#include <instrumentation.hh>
+
+/**
+ * Likelihood of a second order approximation of a nonlinear state space
+ * model, estimated by a particle filter, with all the periods in C++.
+ *
+ * The reduced form is restricted to the union of the states and observed
+ * variables, as for local_state_space_iteration_2: the m variables are
+ *   y_t = constant + ghx*yhat + ghu*e + .5*ghxx*kron(yhat,yhat)
+ *         + .5*ghuu*kron(e,e) + ghxu*kron(yhat,e)
+ * where yhat are the states mf0 of y_t-1 in deviation from the steady state
+ * ss, and the observations are the variables mf1 of y_t plus Gaussian
+ * measurement errors of covariance H (positive definite). With pruning, the
+ * second order terms are those of the first order states (Kim et al., 2008),
+ * which are propagated along.
+ *
+ * The initial particles are drawn from the ergodic distribution of the first
+ * order approximation of the states. Two algorithms are available:
+ * - the sequential importance resampling (bootstrap) filter, where the
+ *   particles are resampled when the effective sample size falls below
+ *   resampling_threshold times the number of particles;
+ * - the auxiliary particle filter (Pitt and Shephard, 1999), where the
+ *   particles are resampled every period with the likelihoods of their
+ *   predictions without innovations, before being propagated. These
+ *   likelihoods use the covariance of the observations given the states at
+ *   the first order (H plus the variance due to the innovations), since
+ *   with H alone they are far too concentrated.
+ *
+ * The propagation (see ss2Iteration()), the draws of the innovations and the
+ * measurement densities run in parallel. Each particle slot has its own
+ * random stream, so that the likelihood does not depend on the number of
+ * threads; with a fixed seed, all the streams are reset at each evaluation,
+ * which gives common random numbers across parameter draws.
+ */
+class ParticleFilter
+{
+public:
+  enum Algorithm
+    {
+      sequentialImportanceResampling,
+      auxiliary
+    };
+
+  /*!
+    \param mf0,mf1 Indices (zero-based) of the states and observed variables in the m variables of the reduced form
+    \param resampling_threshold The bootstrap filter resamples when the effective sample size is below resampling_threshold*number_of_particles
+    \param stratified Stratified instead of systematic resampling
+    \param lyapunov_tol Tolerance of the Lyapunov equation of the initial distribution
+  */
+  ParticleFilter(size_t m_arg, size_t q_arg, const std::vector<size_t> &mf0_arg, const std::vector<size_t> &mf1_arg,
+                 size_t number_of_particles, Algorithm algorithm_arg, bool pruning_arg, double resampling_threshold_arg,
+                 bool stratified_arg, double lyapunov_tol_arg, int number_of_threads_arg = 1);
+  virtual ~ParticleFilter();
+
+  //! Seeds the random streams; if fixed, each compute() starts from this seed
+  void seed(uint64_t seed_arg, bool fixed);
+
+  /*!
+    \param[in] data p*T observations (in levels)
+    \param[in] ghx,ghu,ghxx,ghuu,ghxu,constant The reduced form, with m rows
+    \param[in] ss m steady state
+    \param[in] Q,H Covariance matrices of the structural innovations and of the measurement errors
+    \param[out] vll Log-likelihood of each period
+    \param[in] start First period entering the returned log-likelihood
+    \return The log-likelihood, -INFINITY if all the particles have a null density
+  */
+  template<class Mat1, class Mat2, class Mat3, class Mat4, class Mat5, class Vec1, class Vec2>
+  double
+  compute(const MatrixConstView &data, const Mat1 &ghx, const Mat2 &ghu, const Vec1 &constant,
+          const Mat3 &ghxx, const Mat4 &ghuu, const Mat5 &ghxu, const Vec2 &ss,
+          const Matrix &Q, const Matrix &H, VectorView &vll, size_t start)
+  {
+    assert(ghx.getRows() == m && ghx.getCols() == n && ghx.getLd() == m);
+    assert(ghu.getRows() == m && ghu.getCols() == q && ghu.getLd() == m);
+    assert(ghxx.getRows() == m && ghxx.getCols() == n*n && ghxx.getLd() == m);
+    assert(ghuu.getRows() == m && ghuu.getCols() == q*q && ghuu.getLd() == m);
+    assert(ghxu.getRows() == m && ghxu.getCols() == n*q && ghxu.getLd() == m);
+    assert(constant.getSize() == m && constant.getStride() == 1);
+    assert(ss.getSize() == m && ss.getStride() == 1);
+    assert(data.getRows() == p && vll.getSize() == data.getCols());
+
+    return filter(data, ghx.getData(), ghu.getData(), constant.getData(), ghxx.getData(), ghuu.getData(),
+                  ghxu.getData(), ss.getData(), Q, H, vll, start);
+  }
+
+private:
+  const size_t m, q, n, p, s;
+  const std::vector<size_t> mf0, mf1;
+  const Algorithm algorithm;
+  const bool pruning, stratified;
+  const double resampling_threshold, lyapunov_tol;
+  const int number_of_threads;
+
+  //! Stream of the resampling, and streams of the particle slots, with their initial states in fixed seed mode
+  Xoshiro256StarStar rng, initialRng;
+  std::vector<Xoshiro256StarStar> particleRngs, initialParticleRngs;
+  bool fixedSeed;
+
+  // Initial distribution, factors of Q and H, and lower Cholesky factor of the covariance of the observations given the states
+  Matrix Ts, Rs, RQf, RQRs, Pstar, Pf, Qf, Hchol, Zu, ZuQf, Fchol;
+  DiscLyapFast discLyapFast;
+  VDVEigDecomposition eigP, eigQ;
+
+  // Particles
+  Matrix yhat, yhat_, parents, parents_; // n*s states (and first order states with pruning), and those of the resampled particles
+  Matrix y, y_, ymu; // m*s propagated particles (and first order ones), and predictions without innovations
+  Matrix epsilon, zeroInnovations; // q*s
+  Matrix z; // max(n, q, p)*number_of_threads workspace of the draws and measurement densities
+  Vector logWeights, weights, logDensities, predictionLogDensities;
+  std::vector<size_t> indices;
+  std::vector<double> uniforms;
+
+  double filter(const MatrixConstView &data, const double *ghx, const double *ghu, const double *constant,
+                const double *ghxx, const double *ghuu, const double *ghxu, const double *ss,
+                const Matrix &Q, const Matrix &H, VectorView &vll, size_t start);
+  //! Draws the initial particles from N(0, Pstar)
+  void drawInitialParticles();
+  //! Draws the innovations of all the particles from N(0, Q)
+  void drawInnovations();
+  //! Log-densities of the observations of period t given the particles x (m*s), for the covariance LL'
+  void measurementLogDensities(const Matrix &x, const MatrixConstView &data, size_t t, const Matrix &L, Vector &ld);
+  /*!
+    Adds ld to the log-weights, normalizes the weights, and returns the log of
+    the sum of the weights before normalization, i.e. the log-likelihood
+  */
+  double updateWeights(const Vector &ld);
+  //! Resampling indices from the normalized weights
+  void resamplingIndices();
+  //! Deviations from the steady state of the states of the particles x (m*s), in the order given by indices if resample is true
+  void extractStates(const Matrix &x, const double *ss, bool resample, Matrix &states);
+
+  //! Fills the columns of Vf with the eigenvectors of V scaled by the square roots of the (non-negative) eigenvalues, so that V=Vf*Vf'
+  static void factorize(VDVEigDecomposition &eig, const Matrix &V, Matrix &Vf);
+  //! Uniform draw in (0, 1)
+  static double uniform(Xoshiro256StarStar &g);
+  static double logSumExp(const Vector &x);
+
+  // Not copyable
+  ParticleFilter(const ParticleFilter &);
+  ParticleFilter &operator=(const ParticleFilter &);
+};
+
+#endif // !defined(PARTICLE_FILTER_HH_INCLUDED)
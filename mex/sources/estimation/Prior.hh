@@ -26,7 +26,9 @@
 #if !defined(Prior_8D5F562F_C831_43f3_B390_5C4EF4433756__INCLUDED_)
 #define Prior_8D5F562F_C831_43f3_B390_5C4EF4433756__INCLUDED_
 
-#include <boost/random/linear_congruential.hpp>
+#include <algorithm>
+#include <cmath>
+
 #include <boost/random/normal_distribution.hpp>
 #include <boost/random/uniform_real.hpp>
 #include <boost/random/variate_generator.hpp>
@@ -36,10 +38,9 @@
 #include <boost/math/distributions/normal.hpp> // for normal_distribution.
 #include <boost/math/distributions/uniform.hpp> // for uniform_distribution.
 
-// typedef for base_uniform_generator_type
-// rend48 seems better than the basic minstd_rand  but
-// one my later try ecuyer1988 or taus88 which are better but not yet supported in the Boost versionwe use
-typedef boost::rand48 base_uniform_generator_type;
+#include "RandomEngine.hh"
+
+typedef Xoshiro256StarStar base_uniform_generator_type;
 
 struct Prior
 {
@@ -81,6 +82,15 @@ public:
     return 0.0;
   };
 
+  //! Derivative of the log of the density at x, used by the score of the posterior
+  /*! By default a central difference of the log density; x must be in the interior of the support */
+  virtual double
+  logPdfDerivative(double x)
+  {
+    double h = 1e-6*std::max(1.0, std::fabs(x));
+    return (log(pdf(x+h)) - log(pdf(x-h)))/(2*h);
+  };
+
   virtual double
   drand() // rand for density
   {
@@ -88,6 +98,14 @@ public:
     return 0.0;
   };
 
+  //! Inverse of the cumulative distribution function, used to draw from the prior
+  virtual double
+  quantile(double p)
+  {
+    std::cout << "Parent quantile undefined at parent level" << std::endl;
+    return 0.0;
+  };
+
   static Prior *constructPrior(pShape shape, double mean, double standard, double lower_bound, double upper_bound, double fhp, double shp);
 };
 
@@ -124,6 +142,11 @@ public:
   {
     return 0.0;
   };
+  virtual double
+  quantile(double p)
+  {
+    return lower_bound + (upper_bound-lower_bound)*boost::math::quantile(distribution, p);
+  };
 };
 
 struct GammaPrior : public Prior
@@ -155,6 +178,11 @@ public:
   {
     return 0.0;
   };
+  virtual double
+  quantile(double p)
+  {
+    return lower_bound + boost::math::quantile(distribution, p);
+  };
 };
 
 //  X ~ IG1(s,nu) if X = sqrt(Y) where Y ~ IG2(s,nu) and Y = inv(Z) with Z ~ G(nu/2,2/s) (Gamma distribution)
@@ -191,6 +219,11 @@ public:
   {
     return 0.0;
   };
+  virtual double
+  quantile(double p)
+  {
+    return lower_bound + 1/sqrt(boost::math::quantile(boost::math::complement(distribution, p)));
+  };
 };
 
 // If x~InvGamma(a,b) , then  1/x ~Gamma(a,1/b) distribution
@@ -229,6 +262,11 @@ public:
   {
     return 0.0;
   };
+  virtual double
+  quantile(double p)
+  {
+    return lower_bound + 1/boost::math::quantile(boost::math::complement(distribution, p));
+  };
 };
 
 struct GaussianPrior : public Prior
@@ -265,10 +303,20 @@ public:
       return 0;
   };
   virtual double
+  logPdfDerivative(double x)
+  {
+    return -(x-fhp)/(shp*shp);
+  };
+  virtual double
   drand() // rand for density
   {
     return vrng();
   };
+  virtual double
+  quantile(double p)
+  {
+    return boost::math::quantile(distribution, p);
+  };
 };
 
 struct UniformPrior : public Prior
@@ -305,10 +353,20 @@ public:
       return 0;
   };
   virtual double
+  logPdfDerivative(double x)
+  {
+    return 0.0;
+  };
+  virtual double
   drand() // rand for density
   {
     return vrng();
   };
+  virtual double
+  quantile(double p)
+  {
+    return boost::math::quantile(distribution, p);
+  };
 
 };
 
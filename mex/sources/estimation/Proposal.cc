@@ -23,6 +23,9 @@
 //  Created on:      15-Dec-2010 12:43:49
 ///////////////////////////////////////////////////////////
 
+#include <cmath>
+#include <algorithm>
+
 #include "Proposal.hh"
 
 Proposal::Proposal(const VectorConstView &vJscale, const MatrixConstView &covariance) :
@@ -32,13 +35,22 @@ Proposal::Proposal(const VectorConstView &vJscale, const MatrixConstView &covari
   uniform_rng_type(0, 1), // uniform random number generator distribution type
   uniformVrng(base_rng, uniform_rng_type), // uniform random variate_generator
   normal_rng_type(0, 1), // normal random number generator distribution type (mean, standard)
-  normalVrng(base_rng, normal_rng_type) // normal random variate_generator
+  normalVrng(base_rng, normal_rng_type), // normal random variate_generator
+  curSeed(0),
+  adaptive(false), adaptationPriorWeight(0), adaptationCount(0), logScale(0.0),
+  adaptationMean(len), adaptationDeviation(len),
+  blocked(false), newBlockProbability(1.0), precision(len),
+  blockCholesky(len), blockDraw(len)
 {
   Matrix Jscale(len);
   Matrix DD(len);
   DD = covariance;
 
   lapack::choleskyDecomp(DD, "U");
+  // dpotrf leaves the strict lower triangle untouched
+  for (size_t j = 0; j < len; j++)
+    for (size_t i = j+1; i < len; i++)
+      DD(i, j) = 0.0;
   Jscale.setAll(0.0);
   for (size_t i = 0; i < len; i++)
     Jscale(i, i) = vJscale(i);
@@ -54,7 +66,7 @@ Proposal::draw(Vector &mean, Vector &draw)
   draw = mean;
   for (size_t i = 0; i < len; ++i)
     newDraw(i) =  normalVrng();
-  blas::gemv("T", 1.0, covarianceCholeskyDecomposition, newDraw, 1.0, draw);
+  blas::gemv("T", adaptive ? exp(logScale) : 1.0, covarianceCholeskyDecomposition, newDraw, 1.0, draw);
 
 }
 
@@ -80,6 +92,14 @@ Proposal::seed(int newSeed)
   base_rng.seed(curSeed);
 }
 
+void
+Proposal::seed(int newSeed, size_t stream)
+{
+  seed(newSeed);
+  for (size_t i = 0; i < stream; i++)
+    base_rng.jump();
+}
+
 /**
  * currently returns uniform for MH sampler,
  */
@@ -88,3 +108,140 @@ Proposal::selectionTestDraw()
 {
   return uniformVrng();
 }
+
+void
+Proposal::setAdaptive(size_t priorWeight)
+{
+  adaptive = true;
+  adaptationPriorWeight = std::max(priorWeight, (size_t) 1);
+  adaptationCount = 0;
+  logScale = 0.0;
+}
+
+/**
+ * With gain g = 1/(k+priorWeight), the estimates are updated as
+ *   mu_k = mu_{k-1} + g (x_k - mu_{k-1})
+ *   Sigma_k = (1-g) Sigma_{k-1} + g (x_k - mu_{k-1}) (x_k - mu_{k-1})'
+ * so that the Cholesky factor of Sigma_k is sqrt(1-g) times the rank one
+ * update of the one of Sigma_{k-1} by sqrt(g/(1-g)) (x_k - mu_{k-1}). The log
+ * of the scale moves by g (acceptanceProbability - 0.234).
+ */
+void
+Proposal::adapt(const Vector &state, double acceptanceProbability)
+{
+  assert(adaptive);
+  assert(state.getSize() == len);
+
+  if (adaptationCount++ == 0)
+    {
+      adaptationMean = state;
+      return;
+    }
+
+  double gain = 1.0/(adaptationCount + adaptationPriorWeight);
+  for (size_t i = 0; i < len; i++)
+    {
+      adaptationDeviation(i) = state(i) - adaptationMean(i);
+      adaptationMean(i) += gain*adaptationDeviation(i);
+    }
+
+  double c = sqrt(gain/(1-gain));
+  for (size_t i = 0; i < len; i++)
+    adaptationDeviation(i) *= c;
+  choleskyUpdate(covarianceCholeskyDecomposition, adaptationDeviation);
+  c = sqrt(1-gain);
+  for (size_t j = 0; j < len; j++)
+    for (size_t i = 0; i <= j; i++)
+      covarianceCholeskyDecomposition(i, j) *= c;
+
+  if (std::isfinite(acceptanceProbability))
+    logScale += gain*(std::min(acceptanceProbability, 1.0) - 0.234);
+}
+
+void
+Proposal::choleskyUpdate(Matrix &R, Vector &x)
+{
+  size_t n = R.getCols();
+  for (size_t k = 0; k < n; k++)
+    {
+      double r = hypot(R(k, k), x(k));
+      double c = r/R(k, k), s = x(k)/R(k, k);
+      R(k, k) = r;
+      for (size_t j = k+1; j < n; j++)
+        {
+          R(k, j) = (R(k, j) + s*x(j))/c;
+          x(j) = c*x(j) - s*R(k, j);
+        }
+    }
+}
+
+void
+Proposal::setRandomBlocks(double newBlockProbabilityArg)
+{
+  blocked = true;
+  newBlockProbability = newBlockProbabilityArg;
+  permutation.resize(len);
+  for (size_t i = 0; i < len; i++)
+    permutation[i] = i;
+
+  // The proposal covariance is C'C, with C upper triangular
+  blas::gemm("T", "N", 1.0, covarianceCholeskyDecomposition, covarianceCholeskyDecomposition, 0.0, precision);
+  lapack::choleskyInverse(precision);
+}
+
+void
+Proposal::drawBlocks()
+{
+  assert(blocked);
+
+  // Fisher-Yates shuffle
+  for (size_t i = len; i > 1; i--)
+    {
+      size_t j = std::min((size_t) (uniformVrng()*i), i-1);
+      std::swap(permutation[i-1], permutation[j]);
+    }
+
+  blocks.clear();
+  for (size_t i = 0; i < len; i++)
+    {
+      if (i == 0 || uniformVrng() < newBlockProbability)
+        blocks.push_back(std::vector<size_t>());
+      blocks.back().push_back(permutation[i]);
+    }
+}
+
+/**
+ * The conditional of N(m, P^{-1}) for the block B given the other
+ * parameters has covariance (P_BB)^{-1}. Since the random walk scale is
+ * tuned for the whole parameter vector, the covariance is inflated by
+ * len/size(B), as the optimal scale of a random walk proposal goes like
+ * 1/sqrt(dimension). With P_BB = LL', the draw is m_B + L^{-T} z.
+ */
+void
+Proposal::drawBlock(const std::vector<size_t> &block, const Vector &mean, Vector &draw)
+{
+  assert(blocked);
+  assert(len == draw.getSize());
+  assert(len == mean.getSize());
+
+  size_t n = block.size();
+  MatrixView L(blockCholesky.getData(), n, n, len);
+  for (size_t j = 0; j < n; j++)
+    for (size_t i = j; i < n; i++)
+      L(i, j) = precision(block[i], block[j]);
+  lapack::choleskyDecomp(L, "L");
+
+  for (size_t i = 0; i < n; i++)
+    blockDraw(i) = normalVrng();
+  for (size_t i = n; i-- > 0;)
+    {
+      for (size_t j = i+1; j < n; j++)
+        blockDraw(i) -= L(j, i)*blockDraw(j);
+      blockDraw(i) /= L(i, i);
+    }
+
+  double scale = sqrt((double) len/n);
+  draw = mean;
+  for (size_t i = 0; i < n; i++)
+    draw(block[i]) += scale*blockDraw(i);
+}
@@ -28,7 +28,7 @@
 
 /**
  * Proposal class will then have the common, seed initialised base generator
- * (currently congruental rand48) and member functions such as seed, reset (to
+ * (currently xoshiro256**, see RandomEngine.hh) and member functions such as seed, reset (to
  * initial,default value) and have all rand generators we need that generate from
  * that common base: single uniform and normal (either single or multivariate
  * determined by  the size of the variance matrix)  for now.
@@ -40,20 +40,29 @@
  * matrix) , as core members  .This class will handle the main boost random rng
  * intricacies. See enclosed updated diagram (if ok I will upload it)
  *
+ * Two refinements of the random walk proposal are available:
+ * - the adaptive Metropolis proposal (Haario et al., Andrieu and Thoms),
+ *   where the mean and covariance of the chain are estimated online, with
+ *   a rank one update of the Cholesky factor of the proposal covariance,
+ *   and the scale of the proposal is tuned towards an acceptance rate of
+ *   0.234;
+ * - the randomized blocks of the TaRB sampler (Chib and Ramamurthy), where
+ *   at each iteration the parameters are randomly split into blocks that
+ *   are updated one after the other, each one being drawn from the
+ *   conditional of the proposal given the other parameters.
  */
 
 #include "Matrix.hh"
 #include "BlasBindings.hh"
 #include "LapackBindings.hh"
-#include <boost/random/linear_congruential.hpp>
 #include <boost/random/normal_distribution.hpp>
 #include <boost/random/uniform_real.hpp>
 #include <boost/random/variate_generator.hpp>
+#include <vector>
 
-// typedef for base_uniform_generator_type
-// rend48 seems better than the basic minstd_rand  but
-// one my later try ecuyer1988 or taus88 which are better but not yet supported in the Boost versionwe use
-typedef boost::rand48 base_uniform_generator_type;
+#include "RandomEngine.hh"
+
+typedef Xoshiro256StarStar base_uniform_generator_type;
 
 class Proposal
 {
@@ -70,10 +79,46 @@ public:
   virtual Matrix&getVar();
   virtual int seed();
   virtual void seed(int seedInit);
+  //! Seeds the generator on the given stream of the seed, so that the chains do not overlap
+  virtual void seed(int seedInit, size_t stream);
   virtual double selectionTestDraw();
 
+  //! Turns on the adaptation of the proposal
+  /*!
+    \param[in] priorWeight  number of draws which the initial covariance is worth, the gain of the adaptation being 1/(k+priorWeight) at draw k
+  */
+  void setAdaptive(size_t priorWeight);
+  bool
+  isAdaptive() const
+  {
+    return adaptive;
+  };
+  //! Updates the mean, covariance and scale of the proposal with the current state of the chain
+  void adapt(const Vector &state, double acceptanceProbability);
+
+  //! Turns on the randomized blocks
+  /*!
+    \param[in] newBlockProbability  probability that the next parameter of the random permutation starts a new block
+  */
+  void setRandomBlocks(double newBlockProbability);
+  bool
+  isBlocked() const
+  {
+    return blocked;
+  };
+  //! Draws a new random partition of the parameters, accessed with getBlocks()
+  void drawBlocks();
+  const std::vector<std::vector<size_t> > &
+  getBlocks() const
+  {
+    return blocks;
+  };
+  //! Draws the parameters of a block, given the other parameters which are copied from mean
+  void drawBlock(const std::vector<size_t> &block, const Vector &mean, Vector &draw);
+
 private:
   size_t len;
+  //! Upper Cholesky factor of the proposal covariance
   Matrix covarianceCholeskyDecomposition;
   /**
    * Vector of new draws
@@ -89,6 +134,23 @@ private:
 
   int curSeed;
 
+  bool adaptive;
+  size_t adaptationPriorWeight, adaptationCount;
+  double logScale;
+  Vector adaptationMean, adaptationDeviation;
+
+  bool blocked;
+  double newBlockProbability;
+  //! Inverse of the proposal covariance, whose diagonal blocks give the conditional proposals
+  Matrix precision;
+  std::vector<size_t> permutation;
+  std::vector<std::vector<size_t> > blocks;
+  //! Work space of the draws of the blocks
+  Matrix blockCholesky;
+  Vector blockDraw;
+
+  //! Rank one update of the upper Cholesky factor: R'R+xx' = R1'R1, x is overwritten
+  static void choleskyUpdate(Matrix &R, Vector &x);
 };
 
 #endif // !defined(CABFAB46_2FA5_4178_8D1C_05DFEAFB4570__INCLUDED_)
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if !defined(RANDOMENGINE_HH_INCLUDED)
+#define RANDOMENGINE_HH_INCLUDED
+
+#include <stdint.h>
+
+#include <boost/config.hpp>
+
+/**
+ * The xoshiro256** generator of Blackman and Vigna, seeded with splitmix64.
+ *
+ * It has a period of 2^256-1, passes the usual statistical test suites, and
+ * is splittable: jump() advances the state by 2^128 draws, so that the
+ * generators obtained by successive jumps from the same seed produce
+ * non-overlapping streams (one by Metropolis-Hastings chain, for instance).
+ *
+ * It models the Boost uniform random number generator concept, so that it
+ * can be used with boost::variate_generator and the Boost distributions.
+ */
+class Xoshiro256StarStar
+{
+public:
+  typedef uint64_t result_type;
+  BOOST_STATIC_CONSTANT(bool, has_fixed_range = false);
+
+  explicit Xoshiro256StarStar(uint64_t seed_arg = 0)
+  {
+    seed(seed_arg);
+  };
+
+  void
+  seed(uint64_t seed_arg)
+  {
+    // splitmix64, so that close seeds give unrelated states
+    uint64_t x = seed_arg;
+    for (int i = 0; i < 4; i++)
+      {
+        uint64_t z = (x += UINT64_C(0x9e3779b97f4a7c15));
+        z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+        z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+        s[i] = z ^ (z >> 31);
+      }
+  };
+
+  static result_type (min)()
+  {
+    return 0;
+  };
+  static result_type (max)()
+  {
+    return ~(uint64_t) 0;
+  };
+
+  result_type
+  operator()()
+  {
+    const uint64_t result = rotl(s[1] * 5, 7) * 9;
+    const uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+  };
+
+  //! Advances the state by 2^128 draws
+  void
+  jump()
+  {
+    static const uint64_t coefs[] = { UINT64_C(0x180ec6d33cfd0aba), UINT64_C(0xd5a61266f0c9392c),
+                                      UINT64_C(0xa9582618e03fc9aa), UINT64_C(0x39abdc4529b1661c) };
+    uint64_t t[4] = { 0, 0, 0, 0 };
+    for (int i = 0; i < 4; i++)
+      for (int b = 0; b < 64; b++)
+        {
+          if (coefs[i] & (UINT64_C(1) << b))
+            for (int j = 0; j < 4; j++)
+              t[j] ^= s[j];
+          (*this)();
+        }
+    for (int j = 0; j < 4; j++)
+      s[j] = t[j];
+  };
+
+  //! Returns a generator for the current stream, and jumps to the next stream
+  Xoshiro256StarStar
+  split()
+  {
+    Xoshiro256StarStar child(*this);
+    jump();
+    return child;
+  };
+
+  bool
+  operator==(const Xoshiro256StarStar &other) const
+  {
+    return s[0] == other.s[0] && s[1] == other.s[1] && s[2] == other.s[2] && s[3] == other.s[3];
+  };
+  bool
+  operator!=(const Xoshiro256StarStar &other) const
+  {
+    return !(*this == other);
+  };
+
+private:
+  uint64_t s[4];
+
+  static uint64_t
+  rotl(uint64_t x, int k)
+  {
+    return (x << k) | (x >> (64 - k));
+  };
+};
+
+#endif // !defined(RANDOMENGINE_HH_INCLUDED)
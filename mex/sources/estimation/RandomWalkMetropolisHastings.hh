@@ -26,20 +26,25 @@
 #if !defined(A6BBC5E0_598E_4863_B7FF_E87320056B80__INCLUDED_)
 #define A6BBC5E0_598E_4863_B7FF_E87320056B80__INCLUDED_
 
-#include <iostream>
-#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
 #include "LogPosteriorDensity.hh"
 #include "Proposal.hh"
+#include "MHDrawsFile.hh"
+#include <instrumentation.hh>
 
 class RandomWalkMetropolisHastings
 {
 
 private:
   Vector parDraw, newParDraw;
+  size_t block; // number of the chain, used to name its output files
+  size_t thinning, flush_interval; // of the draws file
 
 public:
-  RandomWalkMetropolisHastings(size_t size) :
-    parDraw(size), newParDraw(size)
+  RandomWalkMetropolisHastings(size_t size, size_t block_arg = 1, size_t thinning_arg = 1, size_t flush_interval_arg = 10000) :
+    parDraw(size), newParDraw(size), block(block_arg), thinning(thinning_arg), flush_interval(flush_interval_arg)
   {
   };
   virtual ~RandomWalkMetropolisHastings()
@@ -53,66 +58,91 @@ public:
           const size_t presampleStart, const size_t startDraw, size_t nMHruns,
           LogPosteriorDensity &lpd, Proposal &pDD, EstimatedParametersDescription &epd)
   {
-    //streambuf *likbuf, *drawbuf *backup;
-    std::ofstream urandfilestr, drawfilestr;
-    urandfilestr.open("urand.csv");
-    drawfilestr.open("paramdraws.csv");
-
-    bool overbound;
-    double newLogpost, logpost, urand;
-    size_t count, accepted = 0;
+    INSTRUMENT_SCOPE("metropolis_hastings");
+    std::ostringstream drawfilename;
+    drawfilename << "paramdraws_blck" << block << ".bin";
+    MHDrawsFile drawfile(drawfilename.str(), parDraw.getSize(), nMHruns-startDraw+1, thinning, flush_interval);
+
+    double newLogpost, logpost, urand = 0.0;
+    size_t accepted = 0, proposed = 0;
     parDraw = estParams;
 
     logpost = -lpd.compute(steadyState, estParams, deepParams, data, Q, H, presampleStart);
 
     for (size_t run = startDraw - 1; run < nMHruns; ++run)
       {
-        overbound = false;
-        pDD.draw(parDraw, newParDraw);
-        for (count = 0; count < parDraw.getSize(); ++count)
+        if (pDD.isBlocked())
           {
-            overbound = (newParDraw(count) < epd.estParams[count].lower_bound || newParDraw(count) > epd.estParams[count].upper_bound);
-            if (overbound)
+            pDD.drawBlocks();
+            const std::vector<std::vector<size_t> > &blocks = pDD.getBlocks();
+            for (size_t b = 0; b < blocks.size(); ++b)
               {
-                newLogpost = -INFINITY;
-                break;
+                pDD.drawBlock(blocks[b], parDraw, newParDraw);
+                newLogpost = proposalLogPosterior(steadyState, deepParams, data, Q, H, presampleStart, lpd, epd);
+                urand = pDD.selectionTestDraw();
+                accepted += acceptOrReject(newLogpost, logpost, urand);
+                proposed++;
               }
           }
-        if (!overbound)
+        else
           {
-            try
-              {
-                newLogpost = -lpd.compute(steadyState, newParDraw, deepParams, data, Q, H, presampleStart);
-              }
-            catch (const std::exception &e)
-              {
-                throw; // for now handle the system and other errors higher-up
-              }
-            catch (...)
-              {
-                newLogpost = -INFINITY;
-              }
-          }
-        urand = pDD.selectionTestDraw();
-        if ((newLogpost > -INFINITY) && log(urand) < newLogpost-logpost)
-          {
-            parDraw = newParDraw;
-            logpost = newLogpost;
-            accepted++;
+            pDD.draw(parDraw, newParDraw);
+            newLogpost = proposalLogPosterior(steadyState, deepParams, data, Q, H, presampleStart, lpd, epd);
+            urand = pDD.selectionTestDraw();
+            double logRatio = newLogpost-logpost;
+            accepted += acceptOrReject(newLogpost, logpost, urand);
+            proposed++;
+            if (pDD.isAdaptive())
+              pDD.adapt(parDraw, newLogpost > -INFINITY ? exp(std::min(logRatio, 0.0)) : 0.0);
           }
         mat::get_row(mhParams, run) = parDraw;
         mhLogPostDens(run) = logpost;
 
-        urandfilestr << urand << "\n"; //","
-        for (size_t c = 0; c < newParDraw.getSize()-1; ++c)
-          drawfilestr << newParDraw(c) << ",";
-        drawfilestr <<  newParDraw(newParDraw.getSize()-1) << "\n";
+        drawfile.add(urand, newParDraw);
       }
 
-    urandfilestr.close();
-    drawfilestr.close();
+    drawfile.close();
+    INSTRUMENT_COUNT("mh_draws", nMHruns-startDraw+1);
+    INSTRUMENT_COUNT("mh_accepted_draws", accepted);
+
+    return (double) accepted/proposed;
+  };
+
+private:
+  //! Log posterior density of newParDraw, -INFINITY if it is out of bounds or if it cannot be computed
+  template<class VEC1>
+  double
+  proposalLogPosterior(VEC1 &steadyState, VectorView &deepParams, const MatrixConstView &data, MatrixView &Q, Matrix &H,
+                       const size_t presampleStart, LogPosteriorDensity &lpd, EstimatedParametersDescription &epd)
+  {
+    for (size_t count = 0; count < newParDraw.getSize(); ++count)
+      if (newParDraw(count) < epd.estParams[count].lower_bound || newParDraw(count) > epd.estParams[count].upper_bound)
+        return -INFINITY;
+    try
+      {
+        return -lpd.compute(steadyState, newParDraw, deepParams, data, Q, H, presampleStart);
+      }
+    catch (const std::exception &e)
+      {
+        throw; // for now handle the system and other errors higher-up
+      }
+    catch (...)
+      {
+        return -INFINITY;
+      }
+  };
 
-    return (double) accepted/(nMHruns-startDraw+1);
+  //! Metropolis-Hastings acceptance test, moves the chain to newParDraw if it succeeds
+  bool
+  acceptOrReject(double newLogpost, double &logpost, double urand)
+  {
+    if ((newLogpost > -INFINITY) && log(urand) < newLogpost-logpost)
+      {
+        parDraw = newParDraw;
+        logpost = newLogpost;
+        return true;
+      }
+    return false;
   };
 
 };
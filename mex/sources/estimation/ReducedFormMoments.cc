@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "ReducedFormMoments.hh"
+
+ReducedFormMoments::ReducedFormMoments(const std::string &basename, size_t n_endo, size_t n_exo_arg,
+                                       const std::vector<size_t> &zeta_fwrd_arg, const std::vector<size_t> &zeta_back_arg,
+                                       const std::vector<size_t> &zeta_mixed_arg, const std::vector<size_t> &zeta_static_arg,
+                                       double qz_criterium, double lyapunov_tol_arg,
+                                       const std::vector<size_t> &var_list_arg, size_t irf_periods_arg) :
+  n_exo(n_exo_arg), n_state(zeta_back_arg.size() + zeta_mixed_arg.size()), lyapunov_tol(lyapunov_tol_arg),
+  var_list(var_list_arg), irf_periods(irf_periods_arg),
+  modelSolution(basename, n_endo, n_exo, zeta_fwrd_arg, zeta_back_arg, zeta_mixed_arg, zeta_static_arg, qz_criterium),
+  discLyapFast(n_state),
+  ghx(n_endo, n_state), ghu(n_endo, n_exo), ghxSigma(n_endo, n_state),
+  cs(n_exo), ghu_cs(n_endo, n_exo),
+  A(n_state), BBt(n_state), Sigma(n_state),
+  y(n_endo), y_new(n_endo)
+{
+  set_union(zeta_back_arg.begin(), zeta_back_arg.end(),
+            zeta_mixed_arg.begin(), zeta_mixed_arg.end(),
+            back_inserter(zeta_back_mixed));
+}
+
+ReducedFormMoments::~ReducedFormMoments()
+{
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if !defined(RFM_REDUCED_FORM_MOMENTS_HH__INCLUDED_)
+#define RFM_REDUCED_FORM_MOMENTS_HH__INCLUDED_
+
+#include <vector>
+
+#include "ModelSolution.hh"
+#include "DiscLyapFast.hh"
+#include "LapackBindings.hh"
+
+/**
+ * Impulse responses, theoretical variances and variance decompositions of a
+ * subset of the endogenous variables, implied by the first order solution of
+ * the model for given parameters (what PosteriorIRF_core1.m and
+ * dsge_simulated_theoretical_variance.m compute for each posterior draw).
+ *
+ * As in the Matlab code, the shocks are orthogonalized with the lower
+ * Cholesky factor of Q + 1e-14*I (for the variance decomposition and the
+ * IRFs), so that a shock with a zero variance gives zero responses.
+ */
+class ReducedFormMoments
+{
+public:
+  /*!
+    \param[in] var_list_arg Indices of the endogenous variables for which the moments are computed
+    \param[in] irf_periods_arg Number of periods of the IRFs (0 if they are not needed)
+  */
+  ReducedFormMoments(const std::string &basename, size_t n_endo, size_t n_exo, const std::vector<size_t> &zeta_fwrd_arg,
+                     const std::vector<size_t> &zeta_back_arg, const std::vector<size_t> &zeta_mixed_arg,
+                     const std::vector<size_t> &zeta_static_arg, double qz_criterium, double lyapunov_tol_arg,
+                     const std::vector<size_t> &var_list_arg, size_t irf_periods_arg);
+  virtual
+  ~ReducedFormMoments();
+
+  //! Computes the moments for the given parameters
+  /*!
+    \param[out] irf Responses of the variables of var_list, nvar*(irf_periods*n_exo): the block of columns j*irf_periods..(j+1)*irf_periods-1 is for shock j
+    \param[out] variance Theoretical variances of the variables of var_list
+    \param[out] decomposition Variance decomposition (shares between 0 and 1), nvar*n_exo
+  */
+  template <class Vec1, class Vec2, class Mat1, class Mat2, class Vec3, class Mat3>
+  void
+  compute(Vec1 &steadyState, const Vec2 &deepParams, const Mat1 &Q, Mat2 &irf, Vec3 &variance, Mat3 &decomposition)
+    throw (DecisionRules::BlanchardKahnException, GeneralizedSchurDecomposition::GSDException,
+           SteadyStateSolver::SteadyStateException, DiscLyapFast::DLPException)
+  {
+    assert(irf.getRows() == var_list.size() && irf.getCols() == irf_periods*n_exo
+           && variance.getSize() == var_list.size()
+           && decomposition.getRows() == var_list.size() && decomposition.getCols() == n_exo);
+
+    modelSolution.compute(steadyState, deepParams, ghx, ghu);
+    computeCholesky(Q);
+
+    // ghu_cs = ghu*cs, and the transition of the state variables A = ghx(zeta_back_mixed,:)
+    blas::gemm("N", "N", 1.0, ghu, cs, 0.0, ghu_cs);
+    for (size_t j = 0; j < n_state; ++j)
+      for (size_t i = 0; i < n_state; ++i)
+        A(i, j) = ghx(zeta_back_mixed[i], j);
+
+    computeIRF(irf);
+
+    // For each shock j, Sigma_j = A*Sigma_j*A' + b_j*b_j' where b_j = ghu_cs(zeta_back_mixed,j),
+    // and the variance of y due to shock j is diag(ghx*Sigma_j*ghx') + ghu_cs(:,j).^2
+    variance.setAll(0.0);
+    for (size_t j = 0; j < n_exo; ++j)
+      {
+        for (size_t l = 0; l < n_state; ++l)
+          for (size_t k = 0; k < n_state; ++k)
+            BBt(k, l) = ghu_cs(zeta_back_mixed[k], j)*ghu_cs(zeta_back_mixed[l], j);
+        if (n_state > 0)
+          {
+            discLyapFast.solve_lyap(A, BBt, Sigma, lyapunov_tol, 0);
+            blas::gemm("N", "N", 1.0, ghx, Sigma, 0.0, ghxSigma);
+          }
+        for (size_t i = 0; i < var_list.size(); ++i)
+          {
+            size_t v = var_list[i];
+            double var = ghu_cs(v, j)*ghu_cs(v, j);
+            for (size_t k = 0; k < n_state; ++k)
+              var += ghxSigma(v, k)*ghx(v, k);
+            decomposition(i, j) = var;
+            variance(i) += var;
+          }
+      }
+    for (size_t j = 0; j < n_exo; ++j)
+      for (size_t i = 0; i < var_list.size(); ++i)
+        decomposition(i, j) = variance(i) > 0.0 ? decomposition(i, j)/variance(i) : 0.0;
+  }
+
+private:
+  const size_t n_exo;
+  const size_t n_state;
+  const double lyapunov_tol;
+  const std::vector<size_t> var_list;
+  const size_t irf_periods;
+  std::vector<size_t> zeta_back_mixed;
+  ModelSolution modelSolution;
+  DiscLyapFast discLyapFast;
+  Matrix ghx, ghu, ghxSigma; // n_endo*n_state, n_endo*n_exo and n_endo*n_state
+  Matrix cs, ghu_cs; // n_exo*n_exo lower Cholesky factor of Q, n_endo*n_exo
+  Matrix A, BBt, Sigma; // n_state*n_state
+  Vector y, y_new; // n_endo
+
+  //! Sets cs to the lower Cholesky factor of Q + 1e-14*I
+  template <class Mat>
+  void
+  computeCholesky(const Mat &Q)
+  {
+    cs = Q;
+    for (size_t i = 0; i < n_exo; ++i)
+      cs(i, i) += 1e-14;
+    if (lapack::choleskyDecomp(cs, "L") != 0)
+      throw DiscLyapFast::DLPException(0, "ReducedFormMoments: the covariance matrix of the shocks is not positive definite");
+    for (size_t j = 0; j < n_exo; ++j)
+      for (size_t i = 0; i < j; ++i)
+        cs(i, j) = 0.0;
+  }
+  //! y(1) = ghu*cs(:,j), y(t) = ghx*y(t-1)(zeta_back_mixed)
+  template <class Mat>
+  void
+  computeIRF(Mat &irf)
+  {
+    for (size_t j = 0; j < n_exo && irf_periods > 0; ++j)
+      {
+        for (size_t i = 0; i < y.getSize(); ++i)
+          y_new(i) = ghu_cs(i, j);
+        for (size_t t = 0; t < irf_periods; ++t)
+          {
+            if (t > 0)
+              for (size_t i = 0; i < y.getSize(); ++i)
+                {
+                  double s = 0.0;
+                  for (size_t k = 0; k < n_state; ++k)
+                    s += ghx(i, k)*y(zeta_back_mixed[k]);
+                  y_new(i) = s;
+                }
+            y = y_new;
+            for (size_t i = 0; i < var_list.size(); ++i)
+              irf(i, j*irf_periods + t) = y(var_list[i]);
+          }
+      }
+  }
+};
+
+#endif // !defined(RFM_REDUCED_FORM_MOMENTS_HH__INCLUDED_)
@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include <boost/random/normal_distribution.hpp>
+
+#include "SequentialMonteCarlo.hh"
+#include "LapackBindings.hh"
+
+SequentialMonteCarlo::SequentialMonteCarlo(EstimatedParametersDescription &epd_arg, size_t nParticles_arg, int seed,
+                                           double conditionalESSRatio_arg, double resamplingThreshold_arg, size_t nMutationSteps_arg) :
+  epd(epd_arg), logPriorDensity(epd_arg), npar(epd_arg.estParams.size()), nParticles(nParticles_arg),
+  conditionalESSRatio(conditionalESSRatio_arg), resamplingThreshold(resamplingThreshold_arg), nMutationSteps(nMutationSteps_arg),
+  particles(npar, nParticles), proposals(npar, nParticles),
+  logLikelihoods(nParticles), logPriors(nParticles), proposalLogLikelihoods(nParticles), proposalLogPriors(nParticles),
+  logWeights(nParticles), proposalCholesky(npar), scale(2.38/sqrt((double) npar)), particleMean(npar),
+  rng(seed)
+{
+  if (nParticles < 2)
+    throw std::runtime_error("SMC: at least two particles are needed");
+  if (conditionalESSRatio <= 0 || conditionalESSRatio >= 1)
+    throw std::runtime_error("SMC: the conditional ESS ratio must be strictly between 0 and 1");
+
+  // The streams of the particles follow the one of the resampling
+  base_uniform_generator_type g(rng);
+  g.jump();
+  particleRngs.reserve(nParticles);
+  for (size_t i = 0; i < nParticles; ++i)
+    particleRngs.push_back(g.split());
+}
+
+double
+SequentialMonteCarlo::uniform(base_uniform_generator_type &g)
+{
+  // 53 random bits, in the open interval (0, 1)
+  return ((g() >> 11) + 0.5)*(1.0/9007199254740992.0);
+}
+
+bool
+SequentialMonteCarlo::inBounds(const double *x) const
+{
+  for (size_t j = 0; j < npar; ++j)
+    if (x[j] < epd.estParams[j].lower_bound || x[j] > epd.estParams[j].upper_bound)
+      return false;
+  return true;
+}
+
+void
+SequentialMonteCarlo::drawFromPrior()
+{
+  const size_t maxTries = 1000;
+
+  for (size_t i = 0; i < nParticles; ++i)
+    {
+      VectorView particle = mat::get_col(particles, i);
+      double *x = particle.getData();
+      size_t tries = 0;
+      do
+        {
+          if (tries++ == maxTries)
+            throw std::runtime_error("SMC: cannot draw from the prior within the bounds of the estimated parameters");
+          for (size_t j = 0; j < npar; ++j)
+            x[j] = epd.estParams[j].prior->quantile(uniform(particleRngs[i]));
+        }
+      while (!inBounds(x) || !(logPriorDensity.compute(particle) > -INFINITY));
+    }
+  logPriorDensity.computeBatch(particles, logPriors);
+  logWeights.setAll(-log((double) nParticles));
+}
+
+double
+SequentialMonteCarlo::logIncrementalWeight(double deltaPhi) const
+{
+  double maxLogLikelihood = -INFINITY;
+  for (size_t i = 0; i < nParticles; ++i)
+    if (logWeights(i) > -INFINITY)
+      maxLogLikelihood = std::max(maxLogLikelihood, logLikelihoods(i));
+  if (!(maxLogLikelihood > -INFINITY))
+    throw std::runtime_error("SMC: the likelihood is null for all the particles");
+
+  double sum = 0.0;
+  for (size_t i = 0; i < nParticles; ++i)
+    if (logLikelihoods(i) > -INFINITY)
+      sum += exp(logWeights(i) + deltaPhi*(logLikelihoods(i) - maxLogLikelihood));
+  return log(sum) + deltaPhi*maxLogLikelihood;
+}
+
+/**
+ * With normalized weights W and incremental weights w, the conditional
+ * effective sample size (Zhou, Johansen and Aston, 2016) is
+ *   N (sum W w)^2 / sum W w^2
+ * which is decreasing in the temperature increment.
+ */
+double
+SequentialMonteCarlo::nextTemperature(double phi) const
+{
+  double target = log(conditionalESSRatio);
+  // log(CESS/N) = 2 log(sum W w(delta)) - log(sum W w(2 delta))
+  double lo = 0.0, hi = 1.0 - phi;
+  if (2*logIncrementalWeight(hi) - logIncrementalWeight(2*hi) >= target)
+    return 1.0;
+  for (int k = 0; k < 100 && hi - lo > 1e-12*(1-phi); ++k)
+    {
+      double mid = 0.5*(lo + hi);
+      if (2*logIncrementalWeight(mid) - logIncrementalWeight(2*mid) >= target)
+        lo = mid;
+      else
+        hi = mid;
+    }
+  return phi + std::max(lo, 1e-12*(1-phi));
+}
+
+double
+SequentialMonteCarlo::reweight(double deltaPhi)
+{
+  double logIncrement = logIncrementalWeight(deltaPhi);
+  for (size_t i = 0; i < nParticles; ++i)
+    if (logLikelihoods(i) > -INFINITY)
+      logWeights(i) += deltaPhi*logLikelihoods(i) - logIncrement;
+    else
+      logWeights(i) = -INFINITY;
+  return logIncrement;
+}
+
+double
+SequentialMonteCarlo::effectiveSampleSize() const
+{
+  double sum = 0.0;
+  for (size_t i = 0; i < nParticles; ++i)
+    sum += exp(2*logWeights(i));
+  return 1.0/sum;
+}
+
+void
+SequentialMonteCarlo::resample()
+{
+  INSTRUMENT_SCOPE("smc_resample");
+
+  // Systematic resampling: particle i is copied for each of the points
+  // (u+k)/N that fall in its slice of the cumulated weights
+  std::vector<size_t> ancestors(nParticles);
+  double u = uniform(rng), cumulated = 0.0;
+  size_t i = 0;
+  for (size_t k = 0; k < nParticles; ++k)
+    {
+      double point = (u + k)/nParticles;
+      while (i < nParticles-1 && cumulated + exp(logWeights(i)) < point)
+        cumulated += exp(logWeights(i++));
+      ancestors[k] = i;
+    }
+
+  proposals = particles;
+  proposalLogPriors = logPriors;
+  proposalLogLikelihoods = logLikelihoods;
+  for (size_t k = 0; k < nParticles; ++k)
+    {
+      mat::get_col(particles, k) = mat::get_col(proposals, ancestors[k]);
+      logPriors(k) = proposalLogPriors(ancestors[k]);
+      logLikelihoods(k) = proposalLogLikelihoods(ancestors[k]);
+    }
+  logWeights.setAll(-log((double) nParticles));
+  INSTRUMENT_COUNT("smc_resamplings", 1);
+}
+
+void
+SequentialMonteCarlo::computeProposal()
+{
+  particleMean.setAll(0.0);
+  for (size_t i = 0; i < nParticles; ++i)
+    {
+      double w = exp(logWeights(i));
+      for (size_t j = 0; j < npar; ++j)
+        particleMean(j) += w*particles(j, i);
+    }
+
+  proposalCholesky.setAll(0.0);
+  for (size_t i = 0; i < nParticles; ++i)
+    {
+      double w = exp(logWeights(i));
+      if (w == 0.0)
+        continue;
+      for (size_t c = 0; c < npar; ++c)
+        {
+          double dc = particles(c, i) - particleMean(c);
+          for (size_t r = c; r < npar; ++r)
+            proposalCholesky(r, c) += w*(particles(r, i) - particleMean(r))*dc;
+        }
+    }
+
+  // If the particles are degenerate, only keep the variances
+  Matrix covariance(proposalCholesky);
+  if (lapack::choleskyDecomp(proposalCholesky, "L") != 0)
+    {
+      proposalCholesky.setAll(0.0);
+      for (size_t j = 0; j < npar; ++j)
+        proposalCholesky(j, j) = sqrt(std::max(covariance(j, j), 1e-12));
+    }
+  for (size_t c = 1; c < npar; ++c)
+    for (size_t r = 0; r < c; ++r)
+      proposalCholesky(r, c) = 0.0;
+}
+
+void
+SequentialMonteCarlo::adaptScale(double acceptanceRate)
+{
+  // Herbst and Schorfheide (2014), with a target acceptance rate of 0.25
+  double e = exp(16*(acceptanceRate - 0.25));
+  scale *= 0.95 + 0.10*e/(1+e);
+}
+
+void
+SequentialMonteCarlo::drawProposals()
+{
+  std::vector<double> z(npar);
+  boost::normal_distribution<double> normal(0, 1);
+  for (size_t i = 0; i < nParticles; ++i)
+    {
+      for (size_t j = 0; j < npar; ++j)
+        z[j] = normal(particleRngs[i]);
+      for (size_t r = 0; r < npar; ++r)
+        {
+          double s = 0.0;
+          for (size_t c = 0; c <= r; ++c)
+            s += proposalCholesky(r, c)*z[c];
+          proposals(r, i) = particles(r, i) + scale*s;
+        }
+    }
+
+  logPriorDensity.computeBatch(proposals, proposalLogPriors);
+  for (size_t i = 0; i < nParticles; ++i)
+    if (!inBounds(proposals.getData() + i*proposals.getLd()))
+      proposalLogPriors(i) = -INFINITY;
+}
@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if !defined(SEQUENTIALMONTECARLO_HH_INCLUDED)
+#define SEQUENTIALMONTECARLO_HH_INCLUDED
+
+#include <cmath>
+#include <vector>
+#include <string>
+#include <stdexcept>
+
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
+#include "Vector.hh"
+#include "Matrix.hh"
+#include "LogPriorDensity.hh"
+#include "EstimatedParametersDescription.hh"
+#include "RandomEngine.hh"
+#include <instrumentation.hh>
+
+/**
+ * Tempered sequential Monte Carlo sampler of the posterior (Herbst and
+ * Schorfheide, 2014).
+ *
+ * A population of particles is drawn from the prior, and moved through the
+ * sequence of posteriors prior*likelihood^phi as phi goes from 0 to 1. At
+ * each stage:
+ * - phi is chosen so that the conditional effective sample size of the
+ *   reweighted particles is a fixed fraction of the number of particles;
+ * - the particles are resampled (systematic resampling) when the effective
+ *   sample size falls under a threshold;
+ * - they are moved by a few random walk Metropolis-Hastings steps, whose
+ *   proposal covariance is the covariance of the particles, and whose scale
+ *   is tuned towards an acceptance rate of 0.25.
+ *
+ * The log prior densities of a population are computed at once by
+ * LogPriorDensity::computeBatch(), and the log likelihoods are computed in
+ * parallel, each thread using its own worker. A WORKER must provide
+ *   double logLikelihood(VectorView &params)
+ * which may throw a std::exception for fatal errors; other exceptions and non
+ * finite values make the particle have a null likelihood. Since each particle
+ * has its own random stream, the draws do not depend on the number of
+ * threads.
+ */
+class SequentialMonteCarlo
+{
+public:
+  SequentialMonteCarlo(EstimatedParametersDescription &epd, size_t nParticles, int seed,
+                       double conditionalESSRatio = 0.95, double resamplingThreshold = 0.5, size_t nMutationSteps = 2);
+  virtual ~SequentialMonteCarlo()
+  {
+  };
+
+  //! Runs the sampler with one worker by thread, returns the log of the marginal data density
+  template<class WORKER>
+  double
+  compute(std::vector<WORKER *> &workers)
+  {
+    INSTRUMENT_SCOPE("smc");
+    assert(workers.size() > 0);
+
+    drawFromPrior();
+    computeLogLikelihoods(workers, particles, logPriors, logLikelihoods);
+
+    double logMarginalDensity = 0.0, phi = 0.0;
+    temperatures.clear();
+    acceptanceRates.clear();
+    while (phi < 1.0)
+      {
+        double newPhi = nextTemperature(phi);
+        logMarginalDensity += reweight(newPhi - phi);
+        phi = newPhi;
+        temperatures.push_back(phi);
+
+        if (effectiveSampleSize() < resamplingThreshold*nParticles)
+          resample();
+
+        computeProposal();
+        size_t accepted = 0;
+        for (size_t k = 0; k < nMutationSteps; ++k)
+          accepted += mutate(workers, phi);
+        double acceptanceRate = (double) accepted/(nMutationSteps*nParticles);
+        acceptanceRates.push_back(acceptanceRate);
+        adaptScale(acceptanceRate);
+        INSTRUMENT_COUNT("smc_stages", 1);
+      }
+
+    // Return equally weighted particles
+    if (effectiveSampleSize() < nParticles*(1-1e-12))
+      resample();
+
+    return logMarginalDensity;
+  };
+
+  //! Particles in the columns
+  const Matrix &
+  getParticles() const
+  {
+    return particles;
+  };
+  const Vector &
+  getLogLikelihoods() const
+  {
+    return logLikelihoods;
+  };
+  const Vector &
+  getLogPriors() const
+  {
+    return logPriors;
+  };
+  //! Values of phi at the end of each stage
+  const std::vector<double> &
+  getTemperatures() const
+  {
+    return temperatures;
+  };
+  //! Acceptance rates of the mutation steps of each stage
+  const std::vector<double> &
+  getAcceptanceRates() const
+  {
+    return acceptanceRates;
+  };
+
+private:
+  EstimatedParametersDescription &epd;
+  LogPriorDensity logPriorDensity;
+  const size_t npar, nParticles;
+  const double conditionalESSRatio, resamplingThreshold;
+  const size_t nMutationSteps;
+
+  Matrix particles, proposals;
+  Vector logLikelihoods, logPriors, proposalLogLikelihoods, proposalLogPriors;
+  //! Normalized log weights
+  Vector logWeights;
+  //! Lower Cholesky factor of the covariance of the particles, and scale of the mutation proposal
+  Matrix proposalCholesky;
+  double scale;
+  Vector particleMean;
+
+  //! One random stream by particle, and one for the resampling
+  std::vector<base_uniform_generator_type> particleRngs;
+  base_uniform_generator_type rng;
+
+  std::vector<double> temperatures, acceptanceRates;
+
+  void drawFromPrior();
+  //! Next temperature, solving CESS(newPhi) = conditionalESSRatio*nParticles by bisection
+  double nextTemperature(double phi) const;
+  //! Log of the mean of the incremental weights under the current weights
+  double logIncrementalWeight(double deltaPhi) const;
+  //! Updates the weights, returns the log of the incremental marginal density
+  double reweight(double deltaPhi);
+  double effectiveSampleSize() const;
+  void resample();
+  void computeProposal();
+  void adaptScale(double acceptanceRate);
+  //! Fills the columns of proposals by a random walk from the particles, and computes their log prior densities
+  void drawProposals();
+  bool inBounds(const double *x) const;
+  static double uniform(base_uniform_generator_type &g);
+
+  //! One Metropolis-Hastings step for all the particles, returns the number of accepted moves
+  template<class WORKER>
+  size_t
+  mutate(std::vector<WORKER *> &workers, double phi)
+  {
+    drawProposals();
+    computeLogLikelihoods(workers, proposals, proposalLogPriors, proposalLogLikelihoods);
+
+    size_t accepted = 0;
+    for (size_t i = 0; i < nParticles; ++i)
+      {
+        if (!(proposalLogPriors(i) > -INFINITY && proposalLogLikelihoods(i) > -INFINITY))
+          continue;
+        double logRatio = proposalLogPriors(i) + phi*proposalLogLikelihoods(i)
+          - logPriors(i) - phi*logLikelihoods(i);
+        if (log(uniform(particleRngs[i])) < logRatio)
+          {
+            mat::get_col(particles, i) = mat::get_col(proposals, i);
+            logPriors(i) = proposalLogPriors(i);
+            logLikelihoods(i) = proposalLogLikelihoods(i);
+            accepted++;
+          }
+      }
+    return accepted;
+  };
+
+  //! Log likelihoods of the columns of draws, in parallel; those with a null prior density are skipped
+  template<class WORKER>
+  void
+  computeLogLikelihoods(std::vector<WORKER *> &workers, Matrix &draws, const Vector &drawLogPriors, Vector &drawLogLikelihoods)
+  {
+    bool failed = false;
+    std::string errMsg;
+#ifdef USE_OMP
+# pragma omp parallel for num_threads(workers.size()) schedule(dynamic)
+#endif
+    for (int i = 0; i < (int) draws.getCols(); ++i)
+      {
+#ifdef USE_OMP
+        WORKER &worker = *workers[omp_get_thread_num()];
+#else
+        WORKER &worker = *workers[0];
+#endif
+        double logLikelihood = -INFINITY;
+        if (drawLogPriors(i) > -INFINITY)
+          {
+            VectorView draw = mat::get_col(draws, i);
+            try
+              {
+                logLikelihood = worker.logLikelihood(draw);
+              }
+            catch (const std::exception &e)
+              {
+#ifdef USE_OMP
+# pragma omp critical (smc_error)
+#endif
+                {
+                  failed = true;
+                  errMsg = e.what();
+                }
+              }
+            catch (...)
+              {
+                logLikelihood = -INFINITY;
+              }
+            if (!(logLikelihood < INFINITY && logLikelihood > -INFINITY))
+              logLikelihood = -INFINITY;
+          }
+        drawLogLikelihoods(i) = logLikelihood;
+      }
+    if (failed)
+      throw std::runtime_error(errMsg);
+    INSTRUMENT_COUNT("smc_likelihood_evaluations", draws.getCols());
+  };
+};
+
+#endif // !defined(SEQUENTIALMONTECARLO_HH_INCLUDED)
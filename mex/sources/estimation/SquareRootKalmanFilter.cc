@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdexcept>
+#include <algorithm>
+
+#include "SquareRootKalmanFilter.hh"
+
+SquareRootKalmanFilter::~SquareRootKalmanFilter()
+{
+
+}
+
+SquareRootKalmanFilter::SquareRootKalmanFilter(const std::string &basename, size_t n_endo, size_t n_exo,
+                                               const std::vector<size_t> &zeta_fwrd_arg, const std::vector<size_t> &zeta_back_arg,
+                                               const std::vector<size_t> &zeta_mixed_arg, const std::vector<size_t> &zeta_static_arg,
+                                               double qz_criterium_arg, const std::vector<size_t> &varobs_arg,
+                                               double riccati_tol_arg, double lyapunov_tol_arg,
+                                               bool noconstant_arg, double lyapunov_fixed_point_tol_arg) :
+  zeta_varobs_back_mixed(KalmanFilter::compute_zeta_varobs_back_mixed(zeta_back_arg, zeta_mixed_arg, varobs_arg)),
+  varobs_state(varobs_arg.size()), T(zeta_varobs_back_mixed.size()), R(zeta_varobs_back_mixed.size(), n_exo),
+  Pstar(zeta_varobs_back_mixed.size(), zeta_varobs_back_mixed.size()), Pinf(zeta_varobs_back_mixed.size(), zeta_varobs_back_mixed.size()),
+  RQRt(zeta_varobs_back_mixed.size(), zeta_varobs_back_mixed.size()), S(zeta_varobs_back_mixed.size(), zeta_varobs_back_mixed.size()),
+  Qf(n_exo, n_exo), RQf(zeta_varobs_back_mixed.size(), n_exo), Hf(varobs_arg.size(), varobs_arg.size()),
+  preArray(varobs_arg.size()+zeta_varobs_back_mixed.size()+n_exo, varobs_arg.size()+zeta_varobs_back_mixed.size()),
+  Fchol(varobs_arg.size(), varobs_arg.size()), oldFchol(varobs_arg.size(), varobs_arg.size()),
+  Kbar(zeta_varobs_back_mixed.size(), varobs_arg.size()), oldKbar(zeta_varobs_back_mixed.size(), varobs_arg.size()),
+  a_init(zeta_varobs_back_mixed.size()), a_new(zeta_varobs_back_mixed.size()), vt(varobs_arg.size()),
+  observationConstant(varobs_arg.size()), riccati_tol(riccati_tol_arg),
+  initKalmanFilter(basename, n_endo, n_exo, zeta_fwrd_arg, zeta_back_arg, zeta_mixed_arg,
+                   zeta_static_arg, zeta_varobs_back_mixed, varobs_arg, qz_criterium_arg, lyapunov_tol_arg, noconstant_arg,
+                   lyapunov_fixed_point_tol_arg),
+  eigP(zeta_varobs_back_mixed.size()), eigQ(n_exo), eigH(varobs_arg.size()),
+  qr(preArray.getRows(), preArray.getCols(), 0)
+{
+  for (size_t i = 0; i < varobs_arg.size(); ++i)
+    varobs_state[i] = find(zeta_varobs_back_mixed.begin(), zeta_varobs_back_mixed.end(),
+                           varobs_arg[i]) - zeta_varobs_back_mixed.begin();
+}
+
+double
+SquareRootKalmanFilter::filter(const MatrixConstView &dataView,  const Matrix &H, VectorView &vll, size_t start)
+{
+  INSTRUMENT_SCOPE("square_root_kalman_filter");
+  double loglik = 0.0, ll, logFdet = 0.0;
+  size_t p = Fchol.getRows(), n = a_init.getSize(), r = RQf.getCols();
+  bool nonstationary = true;
+  a_init.setAll(0.0);
+
+  for (size_t t = 0; t < dataView.getCols(); ++t)
+    for (size_t i = 0; i < p; ++i)
+      if (dataView(i, t) != dataView(i, t))
+        throw std::runtime_error("SquareRootKalmanFilter::filter: missing observations are not supported, use the Kalman filter");
+
+  // Pstar=S*S', H=Hf*Hf'
+  factorize(eigP, Pstar, S);
+  factorize(eigH, H, Hf);
+
+  MatrixView TSt(preArray, p, p, n, n);
+
+  for (size_t t = 0; t < dataView.getCols(); ++t)
+    {
+      if (nonstationary)
+        {
+          // Transposed pre-array, whose blocks are Hf', (Z*S)', (T*S)' and RQf'
+          preArray.setAll(0.0);
+          for (size_t i = 0; i < p; ++i)
+            {
+              for (size_t j = 0; j < p; ++j)
+                preArray(j, i) = Hf(i, j);
+              for (size_t k = 0; k < n; ++k)
+                preArray(p+k, i) = S(varobs_state[i], k);
+            }
+          for (size_t i = 0; i < n; ++i)
+            for (size_t j = 0; j < r; ++j)
+              preArray(p+n+j, p+i) = RQf(i, j);
+          blas::gemm("T", "T", 1.0, S, T, 0.0, TSt);
+
+          // The post-array is R', made unique by a positive diagonal
+          qr.compute(preArray);
+          for (size_t j = 0; j < p+n; ++j)
+            if (preArray(j, j) < 0)
+              for (size_t k = j; k < p+n; ++k)
+                preArray(j, k) = -preArray(j, k);
+
+          logFdet = 0.0;
+          for (size_t i = 0; i < p; ++i)
+            {
+              if (preArray(i, i) == 0.0)
+                throw std::runtime_error("SquareRootKalmanFilter::filter: F is singular");
+              logFdet += 2*log(preArray(i, i));
+              for (size_t j = 0; j < p; ++j)
+                Fchol(i, j) = (j <= i ? preArray(j, i) : 0.0);
+            }
+          for (size_t k = 0; k < n; ++k)
+            {
+              for (size_t j = 0; j < p; ++j)
+                Kbar(k, j) = preArray(j, p+k);
+              for (size_t l = 0; l < n; ++l)
+                S(k, l) = (l <= k ? preArray(p+l, p+k) : 0.0);
+            }
+
+          if (t > 0)
+            nonstationary = mat::isDiff(Kbar, oldKbar, riccati_tol) || mat::isDiff(Fchol, oldFchol, riccati_tol);
+          oldKbar = Kbar;
+          oldFchol = Fchol;
+        }
+
+      // err= Yt - constant - Za, then inv(Fchol)*err
+      for (size_t i = 0; i < p; ++i)
+        vt(i) = dataView(i, t) - observationConstant(i) - a_init(varobs_state[i]);
+      blas::trsv("L", "N", "N", Fchol, vt);
+
+      // at+1= T at + Kbar inv(Fchol) err
+      blas::gemv("N", 1.0, T, a_init, 0.0, a_new);
+      blas::gemv("N", 1.0, Kbar, vt, 1.0, a_new);
+      a_init = a_new;
+
+      ll = -0.5*(p*log(2*M_PI) + logFdet + blas::dot(vt, vt));
+      vll(t) = ll;
+      if (t >= start)
+        loglik += ll;
+    }
+
+  // Pstar=S*S', for the next subsample
+  blas::gemm("N", "T", 1.0, S, S, 0.0, Pstar);
+
+  return loglik;
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if !defined(SQUARE_ROOT_KALMAN_FILTER_HH_INCLUDED)
+#define SQUARE_ROOT_KALMAN_FILTER_HH_INCLUDED
+
+#include "KalmanFilter.hh"
+#include "QRDecomposition.hh"
+#include "VDVEigDecomposition.hh"
+
+/**
+ * Square-root Kalman filter: instead of P, a factor S with P=SS' is
+ * propagated, so that P stays symmetric positive semi-definite by
+ * construction. Each period, the pre-array
+ *   [ H^(1/2)  Z*S  0         ]
+ *   [ 0        T*S  R*Q^(1/2) ]
+ * is triangularized by an orthogonal transformation (a QR decomposition of
+ * its transpose), which gives the post-array
+ *   [ F^(1/2)  0      0 ]
+ *   [ Kbar     S_t+1  0 ]
+ * where F^(1/2) is the lower Cholesky factor of F and Kbar=T*P*Z'*F^(-1/2)',
+ * so that a_t+1 = T*a_t + Kbar*F^(-1/2)*v_t. F is never formed nor inverted.
+ * Once F^(1/2) and Kbar have converged, they are kept for the remaining
+ * periods (steady state Kalman filter).
+ *
+ * The factors of Pstar, Q and H are computed from their eigen decompositions,
+ * which only requires them to be positive semi-definite.
+ *
+ * REFERENCES
+ *   "Linear Estimation", T. Kailath, A.H. Sayed and B. Hassibi (2000,
+ *   Prentice Hall), Ch. 12.
+ */
+
+class SquareRootKalmanFilter
+{
+
+public:
+  virtual
+  ~SquareRootKalmanFilter();
+  SquareRootKalmanFilter(const std::string &basename, size_t n_endo, size_t n_exo, const std::vector<size_t> &zeta_fwrd_arg,
+                         const std::vector<size_t> &zeta_back_arg, const std::vector<size_t> &zeta_mixed_arg, const std::vector<size_t> &zeta_static_arg,
+                         double qz_criterium_arg, const std::vector<size_t> &varobs_arg,
+                         double riccati_tol_arg, double lyapunov_tol_arg,
+                         bool noconstant_arg, double lyapunov_fixed_point_tol_arg = 0.0);
+
+  template <class Vec1, class Vec2, class Mat1>
+  double
+  compute(const MatrixConstView &dataView, Vec1 &steadyState,
+          const Mat1 &Q, const Matrix &H, const Vec2 &deepParams,
+          VectorView &vll, size_t start, size_t period)
+  {
+    if (period == 0) // initialise all KF matrices
+      initKalmanFilter.initialize(steadyState, deepParams, R, Q, RQRt, T, Pstar, Pinf,
+                                  observationConstant);
+    else                           // initialise parameter dependent KF matrices only but not Ps
+      initKalmanFilter.initialize(steadyState, deepParams, R, Q, RQRt, T,
+                                  observationConstant);
+
+    // RQf=R*Q^(1/2)
+    factorize(eigQ, Q, Qf);
+    blas::gemm("N", "N", 1.0, R, Qf, 0.0, RQf);
+
+    // The steady state is subtracted from the observations as they are read
+    return filter(dataView, H, vll, start);
+  }
+
+private:
+  const std::vector<size_t> zeta_varobs_back_mixed;
+  std::vector<size_t> varobs_state; // position in the state vector of each observed variable
+  Matrix T;   //mm*mm transition matrix of the state equation.
+  Matrix R;   //mm*rr matrix, mapping structural innovations to state variables.
+  Matrix Pstar; //mm*mm variance-covariance matrix of stationary variables
+  Matrix Pinf;  //mm*mm variance-covariance matrix of diffuse variables
+  Matrix RQRt;  //mm*mm variance-covariance matrix of variable disturbances
+  Matrix S; // mm*mm factor of Pstar
+  Matrix Qf, RQf, Hf; // rr*rr factor of Q, mm*rr factor R*Qf of RQR', nob*nob factor of H
+  Matrix preArray; // (nob+mm+rr)*(nob+mm) transpose of the pre-array, overwritten by the QR decomposition
+  Matrix Fchol, oldFchol; // nob*nob lower Cholesky factor of F, and its value in the previous period
+  Matrix Kbar, oldKbar; // mm*nob gain T*P*Z'*inv(Fchol)', and its value in the previous period
+  Vector a_init, a_new; // state vector
+  Vector vt; // current observation error vectors, then inv(Fchol)*vt
+  Vector observationConstant; // nob constant (steady state) subtracted from the observations
+  double riccati_tol;
+  InitializeKalmanFilter initKalmanFilter; //Initialise KF matrices
+  VDVEigDecomposition eigP, eigQ, eigH;
+  QRDecomposition qr;
+
+  // Methods
+  double filter(const MatrixConstView &dataView,  const Matrix &H, VectorView &vll, size_t start);
+  // Fills the columns of Vf with the eigenvectors of V scaled by the square roots of the (non-negative) eigenvalues, so that V=Vf*Vf'
+  template <class Mat>
+  static void factorize(VDVEigDecomposition &eig, const Mat &V, Matrix &Vf);
+
+};
+
+template <class Mat>
+void
+SquareRootKalmanFilter::factorize(VDVEigDecomposition &eig, const Mat &V, Matrix &Vf)
+{
+  eig.calculate(V);
+  if (!eig.hasConverged())
+    throw std::runtime_error("SquareRootKalmanFilter: the eigen decomposition of a covariance matrix did not converge");
+  const Matrix &vectors = eig.getV();
+  const Vector &values = eig.getD();
+  for (size_t j = 0; j < Vf.getCols(); ++j)
+    {
+      double d = sqrt(std::max(values(j), 0.0));
+      for (size_t i = 0; i < Vf.getRows(); ++i)
+        Vf(i, j) = vectors(i, j)*d;
+    }
+}
+
+#endif // !defined(SQUARE_ROOT_KALMAN_FILTER_HH_INCLUDED)
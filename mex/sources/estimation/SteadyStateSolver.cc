@@ -17,64 +17,372 @@
  * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cmath>
+#include <algorithm>
+
 #include "SteadyStateSolver.hh"
+#include <instrumentation.hh>
 
 const double SteadyStateSolver::tolerance = 1e-7;
 
+namespace
+{
+  // Kuhn's augmenting path search for a matching of the equations with the variables
+  bool
+  augment(size_t eq, size_t n, const std::vector<bool> &structure, std::vector<bool> &visited,
+          std::vector<int> &varEquation)
+  {
+    for (size_t v = 0; v < n; v++)
+      if (structure[eq + v*n] && !visited[v])
+        {
+          visited[v] = true;
+          if (varEquation[v] < 0 || augment(varEquation[v], n, structure, visited, varEquation))
+            {
+              varEquation[v] = eq;
+              return true;
+            }
+        }
+    return false;
+  }
+
+  // Tarjan's algorithm on the graph where equation e points to the equations
+  // determining the variables of e: the components come out in solving order
+  struct Tarjan
+  {
+    const std::vector<std::vector<size_t> > &successors;
+    std::vector<int> index, lowlink;
+    std::vector<bool> onStack;
+    std::vector<size_t> stack;
+    std::vector<std::vector<size_t> > components;
+    int counter;
+
+    Tarjan(const std::vector<std::vector<size_t> > &successors_arg) :
+      successors(successors_arg), index(successors_arg.size(), -1), lowlink(successors_arg.size(), 0),
+      onStack(successors_arg.size(), false), counter(0)
+    {
+      for (size_t e = 0; e < successors.size(); e++)
+        if (index[e] < 0)
+          visit(e);
+    };
+
+    void
+    visit(size_t e)
+    {
+      index[e] = lowlink[e] = counter++;
+      stack.push_back(e);
+      onStack[e] = true;
+      for (size_t k = 0; k < successors[e].size(); k++)
+        {
+          size_t f = successors[e][k];
+          if (index[f] < 0)
+            {
+              visit(f);
+              lowlink[e] = std::min(lowlink[e], lowlink[f]);
+            }
+          else if (onStack[f])
+            lowlink[e] = std::min(lowlink[e], index[f]);
+        }
+      if (lowlink[e] == index[e])
+        {
+          components.push_back(std::vector<size_t>());
+          size_t f;
+          do
+            {
+              f = stack.back();
+              stack.pop_back();
+              onStack[f] = false;
+              components.back().push_back(f);
+            }
+          while (f != e);
+        }
+    };
+  };
+}
+
 SteadyStateSolver::SteadyStateSolver(const std::string &basename, size_t n_endo_arg)
-  : static_dll(basename), n_endo(n_endo_arg), residual(n_endo), g1(n_endo)
+  : static_dll(basename), n_endo(n_endo_arg), residual(n_endo), trialResidual(n_endo), g1(n_endo),
+    step(n_endo), trialPoint(n_endo), rhs(n_endo), work(n_endo), ipiv(n_endo),
+    haveLastSolution(false), lastSolution(n_endo), blocksComputed(false), useBlocks(false),
+    variableBlock(n_endo)
 {
   g1.setAll(0.0); // The static file does not initialize zero elements
 }
 
-int
-SteadyStateSolver::static_f(const gsl_vector *yy, void *p, gsl_vector *F)
+bool
+SteadyStateSolver::eval(const double *y, const ModelArgs &args, Vector &res, Matrix *jacobian)
+{
+  VectorConstView yv(y, n_endo, 1), deepParams(args.deepParams, args.n_params, 1);
+  MatrixConstView x(args.x, 1, args.n_exo, 1);
+  static_dll.eval(yv, x, deepParams, res, jacobian, NULL);
+  for (size_t i = 0; i < n_endo; i++)
+    if (!(res(i) < INFINITY && res(i) > -INFINITY))
+      return false;
+  return true;
+}
+
+double
+SteadyStateSolver::sumAbs(const Vector &v)
+{
+  double s = 0.0;
+  for (size_t i = 0; i < v.getSize(); i++)
+    s += fabs(v(i));
+  return s;
+}
+
+void
+SteadyStateSolver::computeBlocks(const double *y, const ModelArgs &args)
 {
-  params *pp = (params *) p;
-  VectorConstView deepParams(pp->deepParams, pp->n_params, 1);
-  MatrixConstView x(pp->x, 1, pp->n_exo, 1);
+  blocksComputed = true;
+  useBlocks = false;
+
+  /* An element of the jacobian may vanish at a particular point, so the
+     structure is that of the jacobians at y and at a perturbed point */
+  const size_t n = n_endo;
+  std::vector<bool> structure(n*n, false);
+  for (int pass = 0; pass < 2; pass++)
+    {
+      for (size_t i = 0; i < n; i++)
+        trialPoint(i) = pass == 0 ? y[i] : y[i] + 1e-3*(1 + fabs(y[i]))*(1 + (i % 7)/7.0);
+      eval(trialPoint.getData(), args, trialResidual, &g1);
+      for (size_t j = 0; j < n; j++)
+        for (size_t i = 0; i < n; i++)
+          if (g1(i, j) != 0.0) // Also true for NaN
+            structure[i + j*n] = true;
+    }
 
-  VectorView y(yy->data, yy->size, yy->stride);
-  VectorView residual(F->data, F->size, F->stride);
+  // Normalization: each equation is matched with a variable
+  std::vector<int> varEquation(n, -1);
+  for (size_t eq = 0; eq < n; eq++)
+    {
+      std::vector<bool> visited(n, false);
+      if (!augment(eq, n, structure, visited, varEquation))
+        return; // Structurally singular, solve the whole system at once
+    }
+  std::vector<size_t> eqVariable(n);
+  for (size_t v = 0; v < n; v++)
+    eqVariable[varEquation[v]] = v;
 
-  pp->static_dll->eval(y, x, deepParams, residual, NULL, NULL);
+  std::vector<std::vector<size_t> > successors(n);
+  for (size_t eq = 0; eq < n; eq++)
+    for (size_t v = 0; v < n; v++)
+      if (structure[eq + v*n] && (size_t) varEquation[v] != eq)
+        successors[eq].push_back(varEquation[v]);
 
-  return GSL_SUCCESS;
+  Tarjan tarjan(successors);
+  if (tarjan.components.size() < 2)
+    return;
+
+  blockEquations = tarjan.components;
+  blockVariables.resize(blockEquations.size());
+  for (size_t b = 0; b < blockEquations.size(); b++)
+    {
+      blockVariables[b].clear();
+      for (size_t k = 0; k < blockEquations[b].size(); k++)
+        {
+          size_t v = eqVariable[blockEquations[b][k]];
+          blockVariables[b].push_back(v);
+          variableBlock[v] = b;
+        }
+    }
+  useBlocks = true;
 }
 
-int
-SteadyStateSolver::static_df(const gsl_vector *yy, void *p, gsl_matrix *J)
+bool
+SteadyStateSolver::luSolve(size_t m)
 {
-  params *pp = (params *) p;
-  VectorConstView deepParams(pp->deepParams, pp->n_params, 1);
-  MatrixConstView x(pp->x, 1, pp->n_exo, 1);
+  lapack_int mm = m, lda = work.getLd(), nrhs = 1, ldb = rhs.getSize(), info;
+  dgetrf(&mm, &mm, work.getData(), &lda, &ipiv[0], &info);
+  if (info != 0)
+    return false;
+  dgetrs("N", &mm, &nrhs, work.getData(), &lda, &ipiv[0], rhs.getData(), &ldb, &info);
+  for (size_t i = 0; i < m; i++)
+    if (!(rhs(i) < INFINITY && rhs(i) > -INFINITY))
+      return false;
+  return info == 0;
+}
 
-  VectorView y(yy->data, yy->size, yy->stride);
+bool
+SteadyStateSolver::fullNewtonStep()
+{
+  work = g1;
+  for (size_t i = 0; i < n_endo; i++)
+    rhs(i) = -residual(i);
+  if (!luSolve(n_endo))
+    return false;
+  step = rhs;
+  return true;
+}
+
+bool
+SteadyStateSolver::blockNewtonStep()
+{
+  // The decomposition only holds if the jacobian is block lower triangular
+  for (size_t b = 0; b < blockEquations.size(); b++)
+    for (size_t k = 0; k < blockEquations[b].size(); k++)
+      for (size_t v = 0; v < n_endo; v++)
+        if (variableBlock[v] > b && g1(blockEquations[b][k], v) != 0.0)
+          {
+            useBlocks = false;
+            return fullNewtonStep();
+          }
 
-  pp->static_dll->eval(y, x, deepParams, *pp->residual, pp->g1, NULL);
+  for (size_t b = 0; b < blockEquations.size(); b++)
+    {
+      const std::vector<size_t> &eqs = blockEquations[b], &vars = blockVariables[b];
+      const size_t m = eqs.size();
+      // Right hand side, given the steps of the variables of the previous blocks
+      for (size_t k = 0; k < m; k++)
+        {
+          double r = -residual(eqs[k]);
+          for (size_t v = 0; v < n_endo; v++)
+            if (variableBlock[v] < b)
+              r -= g1(eqs[k], v)*step(v);
+          rhs(k) = r;
+        }
 
-  assert(J->size1 == J->size2 && J->size1 == J->tda);
-  MatrixView g1t(J->data, J->size1, J->size2, J->tda);
-  mat::transpose(g1t, *pp->g1); // GSL wants row-major order
+      if (m == 1)
+        {
+          // Recursive block: the variable is given by its equation
+          double d = g1(eqs[0], vars[0]);
+          if (d == 0.0)
+            return false;
+          step(vars[0]) = rhs(0)/d;
+          if (!(step(vars[0]) < INFINITY && step(vars[0]) > -INFINITY))
+            return false;
+        }
+      else
+        {
+          for (size_t l = 0; l < m; l++)
+            for (size_t k = 0; k < m; k++)
+              work(k, l) = g1(eqs[k], vars[l]);
+          if (!luSolve(m))
+            return false;
+          for (size_t l = 0; l < m; l++)
+            step(vars[l]) = rhs(l);
+        }
+    }
+  return true;
+}
 
-  return GSL_SUCCESS;
+bool
+SteadyStateSolver::newtonStep()
+{
+  return useBlocks ? blockNewtonStep() : fullNewtonStep();
 }
 
-int
-SteadyStateSolver::static_fdf(const gsl_vector *yy, void *p, gsl_vector *F, gsl_matrix *J)
+/**
+ * Solves (J'J + mu I) step = -J'F, with mu small relative to the diagonal of J'J
+ */
+bool
+SteadyStateSolver::levenbergMarquardtStep()
 {
-  params *pp = (params *) p;
-  VectorConstView deepParams(pp->deepParams, pp->n_params, 1);
-  MatrixConstView x(pp->x, 1, pp->n_exo, 1);
+  double maxDiag = 0.0;
+  for (size_t j = 0; j < n_endo; j++)
+    {
+      for (size_t i = 0; i <= j; i++)
+        {
+          double s = 0.0;
+          for (size_t k = 0; k < n_endo; k++)
+            s += g1(k, i)*g1(k, j);
+          work(i, j) = work(j, i) = s;
+        }
+      maxDiag = std::max(maxDiag, work(j, j));
+      double s = 0.0;
+      for (size_t k = 0; k < n_endo; k++)
+        s -= g1(k, j)*residual(k);
+      rhs(j) = s;
+    }
+  double mu = 1e-6*std::max(maxDiag, 1.0);
+  for (size_t j = 0; j < n_endo; j++)
+    work(j, j) += mu;
+  if (!luSolve(n_endo))
+    return false;
+  step = rhs;
+  return true;
+}
+
+void
+SteadyStateSolver::solve(double *y, const ModelArgs &args) throw (SteadyStateException)
+{
+  const size_t n = n_endo;
+  VectorView yv(y, n, 1);
+
+  if (!blocksComputed)
+    computeBlocks(y, args);
+
+  // Warm start from the last solution if it is closer to a solution
+  if (haveLastSolution)
+    {
+      double f = eval(y, args, residual, NULL) ? sumAbs(residual) : INFINITY;
+      if (f >= tolerance && eval(lastSolution.getData(), args, trialResidual, NULL)
+          && sumAbs(trialResidual) < f)
+        {
+          yv = lastSolution;
+          INSTRUMENT_COUNT("steady_state_warm_starts", 1);
+        }
+    }
+
+  // Maximal length of a step, as in Numerical Recipes
+  double yNorm = 0.0;
+  for (size_t i = 0; i < n; i++)
+    yNorm += y[i]*y[i];
+  const double maxStep = 100*std::max(sqrt(yNorm), sqrt((double) n));
+
+  size_t iter = 0;
+  while (true)
+    {
+      if (!eval(y, args, residual, &g1))
+        throw SteadyStateException("the static model cannot be evaluated");
+      if (sumAbs(residual) < tolerance)
+        break;
+      if (iter++ == max_iterations)
+        throw SteadyStateException("the maximum number of iterations has been reached");
+
+      if (!newtonStep() && !levenbergMarquardtStep())
+        throw SteadyStateException("the jacobian of the static model is singular");
 
-  VectorView y(yy->data, yy->size, yy->stride);
-  VectorView residual(F->data, F->size, F->stride);
+      double stepNorm = 0.0;
+      for (size_t i = 0; i < n; i++)
+        stepNorm += step(i)*step(i);
+      stepNorm = sqrt(stepNorm);
+      if (stepNorm > maxStep)
+        for (size_t i = 0; i < n; i++)
+          step(i) *= maxStep/stepNorm;
 
-  pp->static_dll->eval(y, x, deepParams, residual, pp->g1, NULL);
+      // Backtracking on half the sum of squared residuals, whose slope along the step is F'J*step
+      double phi = 0.0, slope = 0.0;
+      for (size_t i = 0; i < n; i++)
+        {
+          double jStep = 0.0;
+          for (size_t j = 0; j < n; j++)
+            jStep += g1(i, j)*step(j);
+          phi += 0.5*residual(i)*residual(i);
+          slope += residual(i)*jStep;
+        }
+      if (!(slope < 0.0))
+        throw SteadyStateException("the Newton step is not a descent direction");
 
-  assert(J->size1 == J->size2 && J->size1 == J->tda);
-  MatrixView g1t(J->data, J->size1, J->size2, J->tda);
-  mat::transpose(g1t, *pp->g1); // GSL wants row-major order
+      double lambda = 1.0;
+      while (true)
+        {
+          for (size_t i = 0; i < n; i++)
+            trialPoint(i) = y[i] + lambda*step(i);
+          if (eval(trialPoint.getData(), args, trialResidual, NULL))
+            {
+              double trialPhi = 0.0;
+              for (size_t i = 0; i < n; i++)
+                trialPhi += 0.5*trialResidual(i)*trialResidual(i);
+              if (trialPhi <= phi + 1e-4*lambda*slope)
+                break;
+            }
+          lambda *= 0.5;
+          if (lambda < 1e-10)
+            throw SteadyStateException("the line search has failed");
+        }
+      yv = trialPoint;
+    }
 
-  return GSL_SUCCESS;
+  lastSolution = yv;
+  haveLastSolution = true;
+  INSTRUMENT_COUNT("steady_state_iterations", iter);
 }
@@ -18,50 +18,105 @@
  */
 
 #include <string>
+#include <vector>
+
+#include <dynlapack.h>
 
 #include "Vector.hh"
+#include "Matrix.hh"
 #include "static_dll.hh"
 
-#include <gsl/gsl_vector.h>
-#include <gsl/gsl_multiroots.h>
-
+/**
+ * Solves the static model by a Newton method, working directly on the
+ * buffers of the caller.
+ *
+ * The Newton step is safeguarded by a maximal length (relative to the norm of
+ * the point) and by a backtracking line search on the sum of squared
+ * residuals; when the jacobian is singular, a Levenberg-Marquardt step is taken
+ * instead.
+ *
+ * On the first call, the model is decomposed into blocks: the equations are
+ * matched with the variables, and the strongly connected components of the
+ * resulting dependency graph make the static jacobian block lower triangular
+ * (this is the decomposition the preprocessor does with the "block" option,
+ * which cannot be combined with "use_dll"). The Newton step is then obtained
+ * block by block: recursive blocks (a single equation) are solved by
+ * evaluation, the others by an LU decomposition of their own jacobian. If the
+ * jacobian turns out to have an element above the block diagonal, the
+ * decomposition is dropped and the full jacobian is used.
+ *
+ * The solution of the last successful call is kept: if it has a smaller
+ * residual than the initial point given by the caller, the next call starts
+ * from it, so that in MCMC the steady state of a draw starts from the one of
+ * the previous draw.
+ */
 class SteadyStateSolver
 {
+public:
+  class SteadyStateException
+  {
+  public:
+    std::string message;
+    SteadyStateException(const std::string &message_arg) : message(message_arg)
+    {
+    }
+  };
+
 private:
   StaticModelDLL static_dll;
   size_t n_endo;
-  Vector residual; // Will be discarded, only used by df()
-  Matrix g1; // Temporary buffer for computing transpose
+  Vector residual, trialResidual;
+  Matrix g1;
+  //! Newton step, trial point and work arrays of the linear solves
+  Vector step, trialPoint, rhs;
+  Matrix work;
+  std::vector<lapack_int> ipiv;
+  //! Solution of the last successful call
+  bool haveLastSolution;
+  Vector lastSolution;
+
+  //! Block decomposition: variables and equations of each block, in solving order
+  bool blocksComputed, useBlocks;
+  std::vector<std::vector<size_t> > blockEquations, blockVariables;
+  //! Block of each variable
+  std::vector<size_t> variableBlock;
+
+  const static double tolerance;
+  const static size_t max_iterations = 1000;
+
+  // Not copyable, since it owns the static DLL
+  SteadyStateSolver(const SteadyStateSolver &);
+  SteadyStateSolver &operator=(const SteadyStateSolver &);
 
-  struct params
+  struct ModelArgs
   {
-    StaticModelDLL *static_dll;
-    const double *deepParams;
-    size_t n_params;
     const double *x;
     size_t n_exo;
-    Vector *residual;
-    Matrix *g1;
+    const double *deepParams;
+    size_t n_params;
   };
 
-  static int static_f(const gsl_vector *yy, void *p, gsl_vector *F);
-  static int static_df(const gsl_vector *yy, void *p, gsl_matrix *J);
-  static int static_fdf(const gsl_vector *yy, void *p, gsl_vector *F, gsl_matrix *J);
-
-  const static double tolerance;
-  const static size_t max_iterations = 1000;
+  //! Evaluates the residuals, and the jacobian if it is not NULL; returns false if a residual is not finite
+  bool eval(const double *y, const ModelArgs &args, Vector &res, Matrix *jacobian);
+  //! Sum of the absolute values of the residuals, the convergence criterion
+  static double sumAbs(const Vector &v);
+  //! Computes the block decomposition from the sparsity of the jacobian at y
+  void computeBlocks(const double *y, const ModelArgs &args);
+  //! Computes the Newton step; returns false if the jacobian is singular
+  bool newtonStep();
+  bool blockNewtonStep();
+  bool fullNewtonStep();
+  //! Levenberg-Marquardt step, used when the jacobian is singular
+  bool levenbergMarquardtStep();
+  //! Solves work(0:m-1, 0:m-1)*x = rhs(0:m-1) in place in rhs, destroying work; returns false if singular
+  bool luSolve(size_t m);
+  void solve(double *y, const ModelArgs &args) throw (SteadyStateException);
 public:
-  class SteadyStateException
+  SteadyStateSolver(const std::string &basename, size_t n_endo_arg);
+  virtual ~SteadyStateSolver()
   {
-  public:
-    std::string message;
-    SteadyStateException(const std::string &message_arg) : message(message_arg)
-    {
-    }
   };
 
-  SteadyStateSolver(const std::string &basename, size_t n_endo_arg);
-
   template <class Vec1, class Mat, class Vec2>
   void
   compute(Vec1 &steadyState, const Mat &Mx, const Vec2 &deepParams) throw (SteadyStateException)
@@ -72,39 +127,14 @@ public:
 
     assert(steadyState.getSize() == n_endo);
 
-    gsl_vector_view ss = gsl_vector_view_array(steadyState.getData(), n_endo);
-
-    params p = { &static_dll, deepParams.getData(), deepParams.getSize(), Mx.getData(), Mx.getCols(), &residual, &g1 };
-
-    gsl_multiroot_function_fdf f = {&static_f, &static_df, &static_fdf,
-                                    n_endo, &p};
-
-    const gsl_multiroot_fdfsolver_type *T = gsl_multiroot_fdfsolver_hybridsj;
-    gsl_multiroot_fdfsolver *s = gsl_multiroot_fdfsolver_alloc(T, n_endo);
-
-    gsl_multiroot_fdfsolver_set(s, &f, &ss.vector);
-
-    int status;
-    size_t iter = 0;
-
-    do
-      {
-        iter++;
-
-        status = gsl_multiroot_fdfsolver_iterate(s);
-
-        if (status)
-          break;
-
-        status = gsl_multiroot_test_residual(s->f, tolerance);
-      }
-    while (status == GSL_CONTINUE && iter < max_iterations);
-
-    if (status != GSL_SUCCESS)
-      throw SteadyStateException(std::string(gsl_strerror(status)));
-
-    gsl_vector_memcpy(&ss.vector, gsl_multiroot_fdfsolver_root(s));
-
-    gsl_multiroot_fdfsolver_free(s);
+    ModelArgs args = { Mx.getData(), Mx.getCols(), deepParams.getData(), deepParams.getSize() };
+    solve(steadyState.getData(), args);
   }
+
+  //! Forgets the solution of the last call, so that the next call starts from the point given by the caller
+  void
+  resetWarmStart()
+  {
+    haveLastSolution = false;
+  };
 };
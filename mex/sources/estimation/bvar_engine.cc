@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Native engine of bvar_density and bvar_forecast (see BayesianVAR.hh).
+ *
+ * [log_density, posterior, prior] = bvar_engine('density', dataset, maxnlags, options_)
+ *
+ * computes the log marginal data densities of the BVARs with 1 to maxnlags
+ * lags (column vector), and their posterior and prior distributions (cell
+ * arrays of structures with fields df, S, XXi and PhiHat, as returned by
+ * bvar_toolbox). dataset contains the observations in rows, already
+ * transformed (logs). The sample and the prior are given by the fields
+ * first_obs, presample, nobs, prefilter, noconstant and bvar_prior_* of
+ * options_.
+ *
+ * [sims_no_shock, sims_with_shocks, nexplosive] = bvar_engine('forecast', posterior, initval, xdata, replic, seed, options_)
+ *
+ * simulates the forecasts of replic draws of the parameters from the
+ * posterior of a BVAR whose lag order is the number of rows of initval (the
+ * last observations), xdata containing the exogenous regressors of the
+ * forecast periods. It returns the forecasts without and with shocks
+ * (forecast periods*variables*replic arrays) and the number of draws whose
+ * companion matrix has an eigenvalue outside the unit circle. The draws are
+ * processed with options_.threads.bvar_engine threads.
+ */
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "BayesianVAR.hh"
+
+#include <dynmex.h>
+#include <instrumentation.hh>
+
+static double
+getScalarField(const mxArray *s, const char *name)
+{
+  const mxArray *f = mxGetField(s, 0, name);
+  if (f == NULL || mxIsEmpty(f))
+    mexErrMsgTxt((std::string("bvar_engine: missing option ") + name).c_str());
+  return mxGetScalar(f);
+}
+
+static const char *niw_fields[] = { "df", "S", "XXi", "PhiHat" };
+
+static mxArray *
+createNIWStruct(const BayesianVAR::NormalInverseWishart &niw)
+{
+  mxArray *s = mxCreateStructMatrix(1, 1, 4, niw_fields);
+  mxSetField(s, 0, "df", mxCreateDoubleScalar(niw.df));
+  const Matrix *m[] = { &niw.S, &niw.XXi, &niw.PhiHat };
+  for (int i = 0; i < 3; i++)
+    {
+      mxArray *a = mxCreateDoubleMatrix(m[i]->getRows(), m[i]->getCols(), mxREAL);
+      MatrixView(mxGetPr(a), m[i]->getRows(), m[i]->getCols(), m[i]->getRows()) = *m[i];
+      mxSetField(s, 0, niw_fields[i+1], a);
+    }
+  return s;
+}
+
+static void
+density(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+  if (nrhs != 4 || !mxIsDouble(prhs[1]) || !mxIsStruct(prhs[3]))
+    mexErrMsgTxt("bvar_engine: the arguments must be 'density', dataset, maxnlags, options_");
+  size_t T = mxGetM(prhs[1]), ny = mxGetN(prhs[1]);
+  size_t maxnlags = (size_t) mxGetScalar(prhs[2]);
+  const mxArray *options_ = prhs[3];
+
+  size_t first_obs = (size_t) getScalarField(options_, "first_obs");
+  size_t presample = (size_t) getScalarField(options_, "presample");
+  size_t nobs = (size_t) getScalarField(options_, "nobs");
+  size_t train = (size_t) getScalarField(options_, "bvar_prior_train");
+  bool prefilter = getScalarField(options_, "prefilter") != 0;
+  bool noconstant = getScalarField(options_, "noconstant") != 0;
+  BayesianVAR::PriorOptions prior;
+  prior.tau = getScalarField(options_, "bvar_prior_tau");
+  prior.decay = getScalarField(options_, "bvar_prior_decay");
+  prior.lambda = getScalarField(options_, "bvar_prior_lambda");
+  prior.mu = getScalarField(options_, "bvar_prior_mu");
+  prior.omega = (int) getScalarField(options_, "bvar_prior_omega");
+  prior.flat = (int) getScalarField(options_, "bvar_prior_flat");
+
+  if (first_obs < 1 || first_obs + nobs - 1 > T)
+    mexErrMsgTxt("bvar_engine: inconsistent number of observations");
+  if (first_obs + presample <= maxnlags)
+    mexErrMsgTxt("bvar_engine: first_obs+presample should be > nlags (for initializing the VAR)");
+
+  MatrixConstView dataset(mxGetPr(prhs[1]), T, ny, T);
+  Matrix data(T, ny);
+  data = dataset;
+
+  std::string errMsg;
+  plhs[0] = mxCreateDoubleMatrix(maxnlags, 1, mxREAL);
+  if (nlhs > 1)
+    plhs[1] = mxCreateCellMatrix(1, maxnlags);
+  if (nlhs > 2)
+    plhs[2] = mxCreateCellMatrix(1, maxnlags);
+  try
+    {
+      // The first observation of the estimation sample (after the presample) is first_obs+presample
+      BayesianVAR bvar(data, first_obs + presample - 1, first_obs + nobs - 2, train, maxnlags, !noconstant, prefilter, prior);
+      for (size_t nlags = 1; nlags <= maxnlags; nlags++)
+        {
+          size_t k = bvar.getNumberOfRegressors(nlags);
+          BayesianVAR::NormalInverseWishart posterior(ny, k), prior_dist(ny, k);
+          bvar.compute(nlags, posterior, prior_dist);
+          mxGetPr(plhs[0])[nlags-1] = BayesianVAR::logMarginalDensity(posterior, prior_dist);
+          if (nlhs > 1)
+            mxSetCell(plhs[1], nlags-1, createNIWStruct(posterior));
+          if (nlhs > 2)
+            mxSetCell(plhs[2], nlags-1, createNIWStruct(prior_dist));
+        }
+    }
+  catch (std::exception &e)
+    {
+      errMsg = e.what();
+    }
+  if (!errMsg.empty())
+    mexErrMsgTxt(("bvar_engine: " + errMsg).c_str());
+}
+
+static void
+forecast(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+  if (nrhs != 7 || !mxIsStruct(prhs[1]) || !mxIsDouble(prhs[2]) || !mxIsDouble(prhs[3]) || !mxIsStruct(prhs[6]))
+    mexErrMsgTxt("bvar_engine: the arguments must be 'forecast', posterior, initval, xdata, replic, seed, options_");
+  const mxArray *posterior_mx = prhs[1];
+  size_t nlags = mxGetM(prhs[2]), ny = mxGetN(prhs[2]);
+  size_t horizon = mxGetM(prhs[3]), nx = mxGetN(prhs[3]);
+  size_t replic = (size_t) mxGetScalar(prhs[4]);
+  uint64_t seed = (uint64_t) mxGetScalar(prhs[5]);
+  size_t k = ny*nlags + nx;
+
+  const mxArray *S_mx = mxGetField(posterior_mx, 0, "S"), *XXi_mx = mxGetField(posterior_mx, 0, "XXi"),
+    *PhiHat_mx = mxGetField(posterior_mx, 0, "PhiHat");
+  if (S_mx == NULL || XXi_mx == NULL || PhiHat_mx == NULL || mxGetField(posterior_mx, 0, "df") == NULL)
+    mexErrMsgTxt("bvar_engine: the posterior must have fields df, S, XXi and PhiHat");
+  if (mxGetM(S_mx) != ny || mxGetN(S_mx) != ny || mxGetM(XXi_mx) != k || mxGetN(XXi_mx) != k
+      || mxGetM(PhiHat_mx) != k || mxGetN(PhiHat_mx) != ny)
+    mexErrMsgTxt("bvar_engine: input dimension mismatch");
+
+  int number_of_threads = 1;
+  const mxArray *threads_mx = mxGetField(prhs[6], 0, "threads");
+  if (threads_mx != NULL)
+    threads_mx = mxGetField(threads_mx, 0, "bvar_engine");
+  if (threads_mx != NULL)
+    number_of_threads = (int) mxGetScalar(threads_mx);
+
+  BayesianVAR::NormalInverseWishart posterior(ny, k);
+  posterior.df = mxGetScalar(mxGetField(posterior_mx, 0, "df"));
+  posterior.S = MatrixConstView(mxGetPr(S_mx), ny, ny, ny);
+  posterior.XXi = MatrixConstView(mxGetPr(XXi_mx), k, k, k);
+  posterior.PhiHat = MatrixConstView(mxGetPr(PhiHat_mx), k, ny, k);
+  Matrix initval(nlags, ny), xdata(horizon, nx);
+  initval = MatrixConstView(mxGetPr(prhs[2]), nlags, ny, nlags);
+  xdata = MatrixConstView(mxGetPr(prhs[3]), horizon, nx, horizon);
+
+  Matrix simsNoShock(horizon*ny, replic), simsWithShocks(horizon*ny, replic);
+  size_t explosive = 0;
+  std::string errMsg;
+  try
+    {
+      explosive = BayesianVAR::forecast(posterior, nlags, initval, xdata, replic, seed, number_of_threads,
+                                        simsNoShock, simsWithShocks);
+    }
+  catch (std::exception &e)
+    {
+      errMsg = e.what();
+    }
+  if (!errMsg.empty())
+    mexErrMsgTxt(("bvar_engine: " + errMsg).c_str());
+
+  mwSize dims[3] = { (mwSize) horizon, (mwSize) ny, (mwSize) replic };
+  const Matrix *sims[] = { &simsNoShock, &simsWithShocks };
+  for (int i = 0; i < 2 && i < std::max(nlhs, 1); i++)
+    {
+      plhs[i] = mxCreateNumericArray(3, dims, mxDOUBLE_CLASS, mxREAL);
+      MatrixView(mxGetPr(plhs[i]), horizon*ny, replic, horizon*ny) = *sims[i];
+    }
+  if (nlhs > 2)
+    plhs[2] = mxCreateDoubleScalar((double) explosive);
+}
+
+void
+mexFunction(int nlhs, mxArray *plhs[],
+            int nrhs, const mxArray *prhs[])
+{
+  if (Instrumentation::mexCommand("bvar_engine", nlhs, plhs, nrhs, prhs))
+    return;
+  INSTRUMENT_SCOPE("bvar_engine");
+
+  if (nrhs < 1 || !mxIsChar(prhs[0]))
+    mexErrMsgTxt("bvar_engine: the first argument must be 'density' or 'forecast'");
+  char *command_name = mxArrayToString(prhs[0]);
+  std::string command(command_name);
+  mxFree(command_name);
+  if (command == "density")
+    density(nlhs, plhs, nrhs, prhs);
+  else if (command == "forecast")
+    forecast(nlhs, plhs, nrhs, prhs);
+  else
+    mexErrMsgTxt("bvar_engine: the first argument must be 'density' or 'forecast'");
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Native engine of imcforecast (see ConditionalForecast.hh).
+ *
+ * [forcs, controlled_shocks] = conditional_forecast_engine(cL, constrained_paths, shocks, init_state, T, R, idx, jdx, options_)
+ *
+ * computes the forecasts of replic replications over H periods, the
+ * endogenous variables idx (in decision rule order) following the paths
+ * constrained_paths (nc*cL, in deviations from the steady state) during the
+ * first cL periods thanks to the shocks jdx. shocks (nexo*H*replic) contains
+ * the other shocks, with zeros for the shocks jdx, and init_state the
+ * initial state. It returns the forecasts (n*(H+1)*replic, the first period
+ * being the initial state) and the controlled shocks (nc*cL*replic). The
+ * replications are processed with options_.threads.conditional_forecast_engine
+ * threads.
+ */
+
+#include <string>
+#include <vector>
+
+#include "ConditionalForecast.hh"
+
+#include <dynmex.h>
+#include <instrumentation.hh>
+
+static std::vector<size_t>
+getIndices(const mxArray *m)
+{
+  std::vector<size_t> v;
+  for (size_t i = 0; i < mxGetNumberOfElements(m); i++)
+    v.push_back((size_t) mxGetPr(m)[i] - 1);
+  return v;
+}
+
+void
+mexFunction(int nlhs, mxArray *plhs[],
+            int nrhs, const mxArray *prhs[])
+{
+  if (Instrumentation::mexCommand("conditional_forecast_engine", nlhs, plhs, nrhs, prhs))
+    return;
+  INSTRUMENT_SCOPE("conditional_forecast_engine");
+
+  if (nrhs != 9)
+    mexErrMsgTxt("conditional_forecast_engine: the arguments must be cL, constrained_paths, shocks, init_state, T, R, idx, jdx, options_");
+  for (int i = 0; i < 8; i++)
+    if (!mxIsDouble(prhs[i]) || mxIsComplex(prhs[i]) || mxIsSparse(prhs[i]))
+      mexErrMsgTxt("conditional_forecast_engine: the first eight arguments must be real dense matrices");
+  if (!mxIsStruct(prhs[8]))
+    mexErrMsgTxt("conditional_forecast_engine: the last argument must be options_");
+
+  size_t cL = (size_t) mxGetScalar(prhs[0]);
+  size_t n = mxGetM(prhs[4]), nexo = mxGetN(prhs[5]);
+  size_t nc = mxGetNumberOfElements(prhs[6]);
+  const mwSize *dims = mxGetDimensions(prhs[2]);
+  size_t periods = mxGetNumberOfDimensions(prhs[2]) > 1 ? dims[1] : 1;
+  size_t replic = mxGetNumberOfDimensions(prhs[2]) > 2 ? dims[2] : 1;
+  if (mxGetN(prhs[4]) != n || mxGetM(prhs[5]) != n || mxGetNumberOfElements(prhs[3]) != n
+      || dims[0] != nexo || cL > periods || mxGetNumberOfElements(prhs[7]) != nc
+      || (cL > 0 && (mxGetM(prhs[1]) != nc || mxGetN(prhs[1]) < cL)))
+    mexErrMsgTxt("conditional_forecast_engine: input dimension mismatch");
+
+  int number_of_threads = 1;
+  const mxArray *threads_mx = mxGetField(prhs[8], 0, "threads");
+  if (threads_mx != NULL)
+    threads_mx = mxGetField(threads_mx, 0, "conditional_forecast_engine");
+  if (threads_mx != NULL)
+    number_of_threads = (int) mxGetScalar(threads_mx);
+
+  Matrix T(n), R(n, nexo);
+  T = MatrixConstView(mxGetPr(prhs[4]), n, n, n);
+  R = MatrixConstView(mxGetPr(prhs[5]), n, nexo, n);
+
+  mwSize forcs_dims[3] = { (mwSize) n, (mwSize) (periods+1), (mwSize) replic };
+  mwSize controlled_dims[3] = { (mwSize) nc, (mwSize) cL, (mwSize) replic };
+  plhs[0] = mxCreateNumericArray(3, forcs_dims, mxDOUBLE_CLASS, mxREAL);
+  mxArray *controlled_mx = mxCreateNumericArray(3, controlled_dims, mxDOUBLE_CLASS, mxREAL);
+  MatrixView forcs(mxGetPr(plhs[0]), n, (periods+1)*replic, n);
+  MatrixView controlled(mxGetPr(controlled_mx), nc, cL*replic, nc);
+  for (size_t b = 0; b < replic; b++)
+    for (size_t i = 0; i < n; i++)
+      forcs(i, b*(periods+1)) = mxGetPr(prhs[3])[i];
+
+  std::string errMsg;
+  try
+    {
+      ConditionalForecast cf(T, R, getIndices(prhs[6]), getIndices(prhs[7]));
+      cf.simulate(cL, periods, replic, MatrixConstView(mxGetPr(prhs[1]), nc, cL, nc),
+                  MatrixConstView(mxGetPr(prhs[2]), nexo, periods*replic, nexo), forcs, controlled,
+                  number_of_threads);
+    }
+  catch (std::exception &e)
+    {
+      errMsg = e.what();
+    }
+  if (!errMsg.empty())
+    {
+      mxDestroyArray(controlled_mx);
+      mexErrMsgTxt(errMsg.c_str());
+    }
+
+  if (nlhs > 1)
+    plhs[1] = controlled_mx;
+  else
+    mxDestroyArray(controlled_mx);
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * [g_y, g_u, info] = first_order_solutions(jacobians, options_, M_)
+ *
+ * Computes the first order decision rules of a batch of jacobians of the
+ * dynamic model, typically evaluated at many parameter draws.
+ *
+ * Inputs:
+ *   jacobians  endo_nbr*ncols*ndraws array of first order derivatives of the
+ *              dynamic model, with the columns of the dynamic file (lagged,
+ *              current and leaded endogenous as in M_.lead_lag_incidence, then
+ *              exogenous)
+ *
+ * Outputs:
+ *   g_y   endo_nbr*nspred*ndraws array, the derivatives of the policy
+ *         functions with respect to the lagged state variables (in declaration
+ *         order, the rows being in declaration order too)
+ *   g_u   endo_nbr*exo_nbr*ndraws array, the derivatives with respect to the
+ *         shocks
+ *   info  1*ndraws, 0 or the error code of print_info (2, 3, 4 or 5) of each
+ *         draw; g_y and g_u are NaN for the draws that failed
+ *
+ * The draws are processed in parallel with options_.threads.first_order_solutions
+ * threads. Options dr=cycle_reduction and dr_cycle_reduction_tol are honoured.
+ */
+
+#include <vector>
+#include <algorithm>
+
+#include "DecisionRulesBatch.hh"
+
+#include <dynmex.h>
+#include <instrumentation.hh>
+
+void
+mexFunction(int nlhs, mxArray *plhs[],
+            int nrhs, const mxArray *prhs[])
+{
+  if (Instrumentation::mexCommand("first_order_solutions", nlhs, plhs, nrhs, prhs))
+    return;
+  INSTRUMENT_SCOPE("first_order_solutions");
+
+  if (nrhs != 3)
+    DYN_MEX_FUNC_ERR_MSG_TXT("first_order_solutions: exactly 3 input arguments are required.");
+  if (nlhs > 3)
+    DYN_MEX_FUNC_ERR_MSG_TXT("first_order_solutions returns 3 output arguments at the most.");
+  if (!mxIsDouble(prhs[0]) || mxIsComplex(prhs[0]) || mxIsSparse(prhs[0]))
+    DYN_MEX_FUNC_ERR_MSG_TXT("first_order_solutions: jacobians must be a real dense array");
+  if (!mxIsStruct(prhs[1]) || !mxIsStruct(prhs[2]))
+    DYN_MEX_FUNC_ERR_MSG_TXT("first_order_solutions: the second and third arguments must be options_ and M_");
+
+  const mxArray *options_ = prhs[1];
+  const mxArray *M_ = prhs[2];
+
+  size_t n_endo = (size_t) *mxGetPr(mxGetField(M_, 0, "endo_nbr"));
+  size_t n_exo = (size_t) *mxGetPr(mxGetField(M_, 0, "exo_nbr"));
+
+  std::vector<size_t> zeta_fwrd, zeta_back, zeta_mixed, zeta_static;
+  const mxArray *lli_mx = mxGetField(M_, 0, "lead_lag_incidence");
+  MatrixConstView lli(mxGetPr(lli_mx), mxGetM(lli_mx), mxGetN(lli_mx), mxGetM(lli_mx));
+  if (lli.getRows() != 3)
+    DYN_MEX_FUNC_ERR_MSG_TXT("first_order_solutions: purely backward or purely forward models are not supported");
+  if (lli.getCols() != n_endo)
+    DYN_MEX_FUNC_ERR_MSG_TXT("first_order_solutions: incorrect lead/lag incidence matrix");
+  for (size_t i = 0; i < n_endo; i++)
+    {
+      if (lli(1, i) == 0)
+        DYN_MEX_FUNC_ERR_MSG_TXT("first_order_solutions: all the endogenous variables must appear at the current period");
+      if (lli(0, i) == 0 && lli(2, i) == 0)
+        zeta_static.push_back(i);
+      else if (lli(0, i) != 0 && lli(2, i) == 0)
+        zeta_back.push_back(i);
+      else if (lli(0, i) == 0 && lli(2, i) != 0)
+        zeta_fwrd.push_back(i);
+      else
+        zeta_mixed.push_back(i);
+    }
+
+  double qz_criterium = *mxGetPr(mxGetField(options_, 0, "qz_criterium"));
+  double cycle_reduction_tol = 0.0;
+  const mxArray *dr_mx = mxGetField(options_, 0, "dr_cycle_reduction");
+  if (dr_mx != NULL && mxGetScalar(dr_mx) != 0)
+    cycle_reduction_tol = *mxGetPr(mxGetField(options_, 0, "dr_cycle_reduction_tol"));
+
+  int number_of_threads = 1;
+  const mxArray *threads_mx = mxGetField(options_, 0, "threads");
+  if (threads_mx != NULL)
+    threads_mx = mxGetField(threads_mx, 0, "first_order_solutions");
+  if (threads_mx != NULL)
+    number_of_threads = (int) mxGetScalar(threads_mx);
+
+  DecisionRulesBatch drb(n_endo, n_exo, zeta_fwrd, zeta_back, zeta_mixed, zeta_static,
+                         qz_criterium, number_of_threads, cycle_reduction_tol);
+
+  const mxArray *jacobians_mx = prhs[0];
+  size_t n_jcols = drb.getJacobianCols();
+  if (mxGetM(jacobians_mx) != n_endo || mxGetNumberOfElements(jacobians_mx) % (n_endo*n_jcols) != 0)
+    DYN_MEX_FUNC_ERR_MSG_TXT("first_order_solutions: jacobians must be endo_nbr*ncols*ndraws, with the columns of the dynamic file");
+  size_t ndraws = mxGetNumberOfElements(jacobians_mx)/(n_endo*n_jcols);
+
+  mwSize dims[3];
+  dims[0] = n_endo;
+  dims[1] = drb.getBackMixedNbr();
+  dims[2] = ndraws;
+  plhs[0] = mxCreateNumericArray(3, dims, mxDOUBLE_CLASS, mxREAL);
+  dims[1] = n_exo;
+  mxArray *g_u_mx = mxCreateNumericArray(3, dims, mxDOUBLE_CLASS, mxREAL);
+  std::vector<DecisionRulesBatch::Info> info(ndraws);
+
+  drb.compute(mxGetPr(jacobians_mx), ndraws, mxGetPr(plhs[0]), mxGetPr(g_u_mx), ndraws > 0 ? &info[0] : NULL);
+
+  if (nlhs > 1)
+    plhs[1] = g_u_mx;
+  else
+    mxDestroyArray(g_u_mx);
+  if (nlhs > 2)
+    {
+      plhs[2] = mxCreateDoubleMatrix(1, ndraws, mxREAL);
+      std::copy(info.begin(), info.end(), mxGetPr(plhs[2]));
+    }
+}
@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * [info, ys, variance, irf] = gsa_sample_evaluation(params, Sigma_e, steady_state, options_, M_, var_list, irf_periods)
+ *
+ * Solves the model at first order for each parameter vector of a global
+ * sensitivity analysis sample (dynare_sensitivity), and returns the outcome of
+ * each solution together with the steady state, the theoretical variances
+ * and the IRFs of the endogenous variables var_list.
+ *
+ * Inputs:
+ *   params        param_nbr*nsam matrix of deep parameters
+ *   Sigma_e       exo_nbr*exo_nbr matrix, or exo_nbr*exo_nbr*nsam array
+ *   steady_state  endo_nbr*1 initial value of the steady state, for all samples
+ *   var_list      indices of the endogenous variables (in declaration order),
+ *                 or [] for all of them
+ *   irf_periods   number of periods of the IRFs (can be 0)
+ *
+ * Outputs:
+ *   info          1*nsam, with the codes of print_info: 0 for a unique stable
+ *                 solution, 2 if the QZ decomposition failed, 3 if there is no
+ *                 stable equilibrium, 4 and 5 for indeterminacy, 20 if the
+ *                 steady state could not be computed, 30 if the variances
+ *                 could not be computed
+ *   ys            endo_nbr*nsam steady states (NaN if info is 20)
+ *   variance      nvar*nsam, NaN for the samples with a nonzero info
+ *   irf           nvar*irf_periods*exo_nbr*nsam, NaN for the samples with a
+ *                 nonzero info
+ *
+ * The samples are processed in parallel with
+ * options_.threads.gsa_sample_evaluation threads, each thread having its own
+ * copy of the model solution. Every sample starts the steady state
+ * computation from steady_state, so that the results do not depend on the
+ * number of threads.
+ */
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "Vector.hh"
+#include "Matrix.hh"
+#include "ReducedFormMoments.hh"
+
+#include <dynmex.h>
+#include <instrumentation.hh>
+
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
+void
+mexFunction(int nlhs, mxArray *plhs[],
+            int nrhs, const mxArray *prhs[])
+{
+  if (Instrumentation::mexCommand("gsa_sample_evaluation", nlhs, plhs, nrhs, prhs))
+    return;
+  INSTRUMENT_SCOPE("gsa_sample_evaluation");
+
+  if (nrhs != 7)
+    DYN_MEX_FUNC_ERR_MSG_TXT("gsa_sample_evaluation: exactly 7 input arguments are required.");
+  if (nlhs > 4)
+    DYN_MEX_FUNC_ERR_MSG_TXT("gsa_sample_evaluation returns 4 output arguments at the most.");
+  for (int i = 0; i < 7; ++i)
+    if (i != 3 && i != 4 && (!mxIsDouble(prhs[i]) || mxIsComplex(prhs[i]) || mxIsSparse(prhs[i])))
+      DYN_MEX_FUNC_ERR_MSG_TXT("gsa_sample_evaluation: all the arguments but options_ and M_ must be real dense arrays");
+  if (!mxIsStruct(prhs[3]) || !mxIsStruct(prhs[4]))
+    DYN_MEX_FUNC_ERR_MSG_TXT("gsa_sample_evaluation: the fourth and fifth arguments must be options_ and M_");
+
+  const mxArray *options_ = prhs[3];
+  const mxArray *M_ = prhs[4];
+
+  char *fName = mxArrayToString(mxGetField(M_, 0, "fname"));
+  std::string basename(fName);
+  mxFree(fName);
+
+  size_t n_endo = (size_t) *mxGetPr(mxGetField(M_, 0, "endo_nbr"));
+  size_t n_exo = (size_t) *mxGetPr(mxGetField(M_, 0, "exo_nbr"));
+  size_t param_nbr = (size_t) *mxGetPr(mxGetField(M_, 0, "param_nbr"));
+
+  std::vector<size_t> zeta_fwrd, zeta_back, zeta_mixed, zeta_static;
+  const mxArray *lli_mx = mxGetField(M_, 0, "lead_lag_incidence");
+  MatrixConstView lli(mxGetPr(lli_mx), mxGetM(lli_mx), mxGetN(lli_mx), mxGetM(lli_mx));
+  if (lli.getRows() != 3)
+    DYN_MEX_FUNC_ERR_MSG_TXT("gsa_sample_evaluation: purely backward or purely forward models are not supported");
+  if (lli.getCols() != n_endo)
+    DYN_MEX_FUNC_ERR_MSG_TXT("gsa_sample_evaluation: incorrect lead/lag incidence matrix");
+  for (size_t i = 0; i < n_endo; i++)
+    {
+      if (lli(0, i) == 0 && lli(2, i) == 0)
+        zeta_static.push_back(i);
+      else if (lli(0, i) != 0 && lli(2, i) == 0)
+        zeta_back.push_back(i);
+      else if (lli(0, i) == 0 && lli(2, i) != 0)
+        zeta_fwrd.push_back(i);
+      else
+        zeta_mixed.push_back(i);
+    }
+
+  double qz_criterium = *mxGetPr(mxGetField(options_, 0, "qz_criterium"));
+  double lyapunov_tol = *mxGetPr(mxGetField(options_, 0, "lyapunov_complex_threshold"));
+
+  int number_of_threads = 1;
+  const mxArray *threads_mx = mxGetField(options_, 0, "threads");
+  if (threads_mx != NULL)
+    threads_mx = mxGetField(threads_mx, 0, "gsa_sample_evaluation");
+  if (threads_mx != NULL)
+    number_of_threads = (int) mxGetScalar(threads_mx);
+
+  const mxArray *params_mx = prhs[0], *Q_mx = prhs[1], *ss_mx = prhs[2];
+  if (mxGetM(params_mx) != param_nbr)
+    DYN_MEX_FUNC_ERR_MSG_TXT("gsa_sample_evaluation: params must have param_nbr rows");
+  size_t nsam = mxGetN(params_mx);
+  if (mxGetM(Q_mx) != n_exo || (mxGetNumberOfElements(Q_mx) != n_exo*n_exo
+                               && mxGetNumberOfElements(Q_mx) != n_exo*n_exo*nsam))
+    DYN_MEX_FUNC_ERR_MSG_TXT("gsa_sample_evaluation: Sigma_e must be exo_nbr*exo_nbr or exo_nbr*exo_nbr*nsam");
+  size_t Q_stride = mxGetNumberOfElements(Q_mx) == n_exo*n_exo ? 0 : n_exo*n_exo;
+  if (mxGetNumberOfElements(ss_mx) != n_endo)
+    DYN_MEX_FUNC_ERR_MSG_TXT("gsa_sample_evaluation: steady_state must have endo_nbr elements");
+
+  std::vector<size_t> var_list;
+  for (size_t i = 0; i < mxGetNumberOfElements(prhs[5]); ++i)
+    {
+      double v = mxGetPr(prhs[5])[i];
+      if (v < 1 || v > n_endo)
+        DYN_MEX_FUNC_ERR_MSG_TXT("gsa_sample_evaluation: var_list must contain indices of endogenous variables");
+      var_list.push_back((size_t) v - 1);
+    }
+  if (var_list.empty())
+    for (size_t i = 0; i < n_endo; ++i)
+      var_list.push_back(i);
+  size_t nvar = var_list.size();
+  // The IRFs are not computed if they are not returned
+  size_t irf_periods = nlhs > 3 ? (size_t) mxGetScalar(prhs[6]) : 0;
+  const size_t irf_size = nvar*irf_periods*n_exo;
+
+  // The outputs are filled in place by the threads
+  plhs[0] = mxCreateDoubleMatrix(1, nsam, mxREAL);
+  mxArray *ys_mx = mxCreateDoubleMatrix(n_endo, nsam, mxREAL);
+  mxArray *variance_mx = mxCreateDoubleMatrix(nvar, nsam, mxREAL);
+  mwSize dims[4];
+  dims[0] = nvar;
+  dims[1] = irf_periods;
+  dims[2] = n_exo;
+  dims[3] = nsam;
+  mxArray *irf_mx = mxCreateNumericArray(4, dims, mxDOUBLE_CLASS, mxREAL);
+  double *info = mxGetPr(plhs[0]);
+  std::vector<std::string> errMsgs(nsam);
+  std::string initErrMsg;
+
+#ifdef USE_OMP
+# pragma omp parallel num_threads(number_of_threads)
+#endif
+  {
+    ReducedFormMoments *rfm = NULL;
+    try
+      {
+        rfm = new ReducedFormMoments(basename, n_endo, n_exo, zeta_fwrd, zeta_back, zeta_mixed, zeta_static,
+                                     qz_criterium, lyapunov_tol, var_list, irf_periods);
+      }
+    catch (const TSException &e)
+      {
+#ifdef USE_OMP
+# pragma omp critical
+#endif
+        initErrMsg = e.getMessage();
+      }
+    Vector deepParams(param_nbr);
+    Matrix Q(n_exo), decomposition(nvar, n_exo);
+
+#ifdef USE_OMP
+# pragma omp for schedule(dynamic)
+#endif
+    for (int j = 0; j < (int) nsam; ++j)
+      {
+        VectorView steadyState(mxGetPr(ys_mx) + j*n_endo, n_endo, 1);
+        VectorView variance(mxGetPr(variance_mx) + j*nvar, nvar, 1);
+        MatrixView irf(mxGetPr(irf_mx) + j*irf_size, nvar, irf_periods*n_exo, nvar);
+        info[j] = 0;
+        if (rfm == NULL)
+          info[j] = -1;
+        else
+          try
+            {
+              steadyState = VectorConstView(mxGetPr(ss_mx), n_endo, 1);
+              deepParams = VectorConstView(mxGetPr(params_mx) + j*param_nbr, param_nbr, 1);
+              Q = MatrixConstView(mxGetPr(Q_mx) + j*Q_stride, n_exo, n_exo, n_exo);
+              rfm->compute(steadyState, deepParams, Q, irf, variance, decomposition);
+            }
+          catch (DecisionRules::BlanchardKahnException &e)
+            {
+              if (!e.order)
+                info[j] = 5;
+              else if (e.n_explosive_eigenvals >= 0 && e.n_explosive_eigenvals < e.n_fwrd_vars)
+                info[j] = 4;
+              else
+                info[j] = 3;
+            }
+          catch (GeneralizedSchurDecomposition::GSDException &e)
+            {
+              info[j] = 2;
+            }
+          catch (SteadyStateSolver::SteadyStateException &e)
+            {
+              info[j] = 20;
+              steadyState.setAll(std::numeric_limits<double>::quiet_NaN());
+            }
+          catch (DiscLyapFast::DLPException &e)
+            {
+              info[j] = 30;
+            }
+          catch (std::exception &e)
+            {
+              info[j] = 20;
+              errMsgs[j] = e.what();
+              steadyState.setAll(std::numeric_limits<double>::quiet_NaN());
+            }
+        if (info[j] != 0)
+          {
+            variance.setAll(std::numeric_limits<double>::quiet_NaN());
+            irf.setAll(std::numeric_limits<double>::quiet_NaN());
+            INSTRUMENT_COUNT("gsa_sample_evaluation_rejections", 1);
+          }
+      }
+
+    delete rfm;
+  }
+
+  if (!initErrMsg.empty())
+    {
+      mxDestroyArray(ys_mx);
+      mxDestroyArray(variance_mx);
+      mxDestroyArray(irf_mx);
+      mxDestroyArray(plhs[0]);
+      DYN_MEX_FUNC_ERR_MSG_TXT(("gsa_sample_evaluation: " + initErrMsg).c_str());
+    }
+
+  for (size_t j = 0; j < nsam; ++j)
+    if (!errMsgs[j].empty())
+      mexPrintf("gsa_sample_evaluation: sample %d: %s\n", (int) j+1, errMsgs[j].c_str());
+
+  if (nlhs > 1)
+    plhs[1] = ys_mx;
+  else
+    mxDestroyArray(ys_mx);
+  if (nlhs > 2)
+    plhs[2] = variance_mx;
+  else
+    mxDestroyArray(variance_mx);
+  if (nlhs > 3)
+    plhs[3] = irf_mx;
+  else
+    mxDestroyArray(irf_mx);
+}
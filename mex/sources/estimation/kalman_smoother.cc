@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * [alphahat, etahat, epsilonhat, loglik, state_var, info] = kalman_smoother(params, Sigma_e, H, steady_state, data, options_, M_)
+ *
+ * Smoothes the data for one or several parameter draws (the columns of
+ * params), with the conventions of DsgeSmoother.m (stationary initialization).
+ *
+ * Inputs:
+ *   params        param_nbr*ndraws matrix of deep parameters
+ *   Sigma_e       exo_nbr*exo_nbr matrix, or exo_nbr*exo_nbr*ndraws array
+ *   H             nobs*nobs matrix, or nobs*nobs*ndraws array, or 0 (no measurement errors)
+ *   steady_state  endo_nbr*1 initial value of the steady state, for all draws
+ *   data          nobs*nper observations (in the order of options_.varobs_id)
+ *
+ * Outputs:
+ *   alphahat      m*nper*ndraws smoothed state vector
+ *   etahat        exo_nbr*nper*ndraws smoothed shocks
+ *   epsilonhat    nobs*nper*ndraws smoothed measurement errors
+ *   loglik        1*ndraws log-likelihoods
+ *   state_var     m*1 indices of the endogenous variables of the state vector
+ *   info          1*ndraws, nonzero if the smoother failed for this draw (the
+ *                 other outputs are then NaN)
+ *
+ * The draws are processed in parallel with options_.threads.kalman_smoother
+ * threads, each thread having its own smoother and thus its own workspace.
+ */
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+#include "Vector.hh"
+#include "Matrix.hh"
+#include "KalmanFilter.hh"
+#include "KalmanSmoother.hh"
+
+#include <dynmex.h>
+#include <instrumentation.hh>
+
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
+void
+mexFunction(int nlhs, mxArray *plhs[],
+            int nrhs, const mxArray *prhs[])
+{
+  if (Instrumentation::mexCommand("kalman_smoother", nlhs, plhs, nrhs, prhs))
+    return;
+  INSTRUMENT_SCOPE("kalman_smoother");
+
+  if (nrhs != 7)
+    DYN_MEX_FUNC_ERR_MSG_TXT("kalman_smoother: exactly 7 input arguments are required.");
+  if (nlhs > 6)
+    DYN_MEX_FUNC_ERR_MSG_TXT("kalman_smoother returns 6 output arguments at the most.");
+  for (int i = 0; i < 5; ++i)
+    if (!mxIsDouble(prhs[i]) || mxIsComplex(prhs[i]) || mxIsSparse(prhs[i]))
+      DYN_MEX_FUNC_ERR_MSG_TXT("kalman_smoother: the first five arguments must be real dense arrays");
+  if (!mxIsStruct(prhs[5]) || !mxIsStruct(prhs[6]))
+    DYN_MEX_FUNC_ERR_MSG_TXT("kalman_smoother: the last two arguments must be options_ and M_");
+
+  const mxArray *options_ = prhs[5];
+  const mxArray *M_ = prhs[6];
+
+  char *fName = mxArrayToString(mxGetField(M_, 0, "fname"));
+  std::string basename(fName);
+  mxFree(fName);
+
+  size_t n_endo = (size_t) *mxGetPr(mxGetField(M_, 0, "endo_nbr"));
+  size_t n_exo = (size_t) *mxGetPr(mxGetField(M_, 0, "exo_nbr"));
+  size_t param_nbr = (size_t) *mxGetPr(mxGetField(M_, 0, "param_nbr"));
+
+  if (*mxGetPr(mxGetField(options_, 0, "loglinear")) == 1)
+    DYN_MEX_FUNC_ERR_MSG_TXT("kalman_smoother: option loglinear is not supported");
+
+  std::vector<size_t> zeta_fwrd, zeta_back, zeta_mixed, zeta_static;
+  const mxArray *lli_mx = mxGetField(M_, 0, "lead_lag_incidence");
+  MatrixConstView lli(mxGetPr(lli_mx), mxGetM(lli_mx), mxGetN(lli_mx), mxGetM(lli_mx));
+  if (lli.getRows() != 3)
+    DYN_MEX_FUNC_ERR_MSG_TXT("kalman_smoother: purely backward or purely forward models are not supported");
+  if (lli.getCols() != n_endo)
+    DYN_MEX_FUNC_ERR_MSG_TXT("kalman_smoother: incorrect lead/lag incidence matrix");
+  for (size_t i = 0; i < n_endo; i++)
+    {
+      if (lli(0, i) == 0 && lli(2, i) == 0)
+        zeta_static.push_back(i);
+      else if (lli(0, i) != 0 && lli(2, i) == 0)
+        zeta_back.push_back(i);
+      else if (lli(0, i) == 0 && lli(2, i) != 0)
+        zeta_fwrd.push_back(i);
+      else
+        zeta_mixed.push_back(i);
+    }
+
+  std::vector<size_t> varobs;
+  const mxArray *varobs_mx = mxGetField(options_, 0, "varobs_id");
+  if (mxGetM(varobs_mx) != 1)
+    DYN_MEX_FUNC_ERR_MSG_TXT("kalman_smoother: options_.varobs_id must be a row vector");
+  size_t n_varobs = mxGetN(varobs_mx);
+  std::transform(mxGetPr(varobs_mx), mxGetPr(varobs_mx) + n_varobs, back_inserter(varobs),
+                 std::bind2nd(std::minus<size_t>(), 1));
+
+  double qz_criterium = *mxGetPr(mxGetField(options_, 0, "qz_criterium"));
+  double lyapunov_tol = *mxGetPr(mxGetField(options_, 0, "lyapunov_complex_threshold"));
+  double riccati_tol = *mxGetPr(mxGetField(options_, 0, "riccati_tol"));
+  bool noconstant = (bool) *mxGetPr(mxGetField(options_, 0, "noconstant"));
+
+  int number_of_threads = 1;
+  const mxArray *threads_mx = mxGetField(options_, 0, "threads");
+  if (threads_mx != NULL)
+    threads_mx = mxGetField(threads_mx, 0, "kalman_smoother");
+  if (threads_mx != NULL)
+    number_of_threads = (int) mxGetScalar(threads_mx);
+
+  // Check the dimensions of the numerical arguments
+  const mxArray *params_mx = prhs[0], *Q_mx = prhs[1], *H_mx = prhs[2], *ss_mx = prhs[3], *data_mx = prhs[4];
+  if (mxGetM(params_mx) != param_nbr)
+    DYN_MEX_FUNC_ERR_MSG_TXT("kalman_smoother: params must have param_nbr rows");
+  size_t ndraws = mxGetN(params_mx);
+  if (mxGetM(Q_mx) != n_exo || (mxGetNumberOfElements(Q_mx) != n_exo*n_exo
+                               && mxGetNumberOfElements(Q_mx) != n_exo*n_exo*ndraws))
+    DYN_MEX_FUNC_ERR_MSG_TXT("kalman_smoother: Sigma_e must be exo_nbr*exo_nbr or exo_nbr*exo_nbr*ndraws");
+  bool no_measurement_errors = mxGetNumberOfElements(H_mx) == 1 && *mxGetPr(H_mx) == 0;
+  if (!no_measurement_errors
+      && (mxGetM(H_mx) != n_varobs || (mxGetNumberOfElements(H_mx) != n_varobs*n_varobs
+                                       && mxGetNumberOfElements(H_mx) != n_varobs*n_varobs*ndraws)))
+    DYN_MEX_FUNC_ERR_MSG_TXT("kalman_smoother: H must be 0, nobs*nobs or nobs*nobs*ndraws");
+  if (mxGetNumberOfElements(ss_mx) != n_endo)
+    DYN_MEX_FUNC_ERR_MSG_TXT("kalman_smoother: steady_state must have endo_nbr elements");
+  if (mxGetM(data_mx) != n_varobs)
+    DYN_MEX_FUNC_ERR_MSG_TXT("kalman_smoother: data does not have as many rows as there are observed variables");
+  size_t nper = mxGetN(data_mx);
+  const MatrixConstView data(mxGetPr(data_mx), n_varobs, nper, n_varobs);
+  size_t Q_stride = mxGetNumberOfElements(Q_mx) == n_exo*n_exo ? 0 : n_exo*n_exo;
+  size_t H_stride = no_measurement_errors || mxGetNumberOfElements(H_mx) == n_varobs*n_varobs ? 0 : n_varobs*n_varobs;
+
+  std::vector<size_t> state_var = KalmanFilter::compute_zeta_varobs_back_mixed(zeta_back, zeta_mixed, varobs);
+  size_t n_state = state_var.size();
+
+  // The output arrays are allocated before the parallel region, since the mx API is not thread-safe
+  mwSize dims[3];
+  dims[1] = nper;
+  dims[2] = ndraws;
+  dims[0] = n_state;
+  mxArray *alphahat_mx = mxCreateNumericArray(3, dims, mxDOUBLE_CLASS, mxREAL);
+  dims[0] = n_exo;
+  mxArray *etahat_mx = mxCreateNumericArray(3, dims, mxDOUBLE_CLASS, mxREAL);
+  dims[0] = n_varobs;
+  mxArray *epsilonhat_mx = mxCreateNumericArray(3, dims, mxDOUBLE_CLASS, mxREAL);
+  mxArray *loglik_mx = mxCreateDoubleMatrix(1, ndraws, mxREAL);
+  mxArray *info_mx = mxCreateDoubleMatrix(1, ndraws, mxREAL);
+  double *alphahat_data = mxGetPr(alphahat_mx), *etahat_data = mxGetPr(etahat_mx),
+    *epsilonhat_data = mxGetPr(epsilonhat_mx), *loglik = mxGetPr(loglik_mx), *info = mxGetPr(info_mx);
+
+  std::vector<std::string> errMsgs(ndraws);
+
+#ifdef USE_OMP
+# pragma omp parallel num_threads(number_of_threads)
+#endif
+  {
+    KalmanSmoother *smoother = NULL;
+    std::string initErrMsg;
+    try
+      {
+        smoother = new KalmanSmoother(basename, n_endo, n_exo, zeta_fwrd, zeta_back, zeta_mixed, zeta_static,
+                                      qz_criterium, varobs, riccati_tol, lyapunov_tol, noconstant);
+      }
+    catch (const TSException &e)
+      {
+        initErrMsg = e.getMessage();
+      }
+    Vector steadyState(n_endo), deepParams(param_nbr);
+    VectorView steadyStateView(steadyState, 0, n_endo);
+    Matrix Q(n_exo), H(n_varobs), detrendedData(n_varobs, nper);
+    MatrixView detrendedDataView(detrendedData, 0, 0, n_varobs, nper);
+
+#ifdef USE_OMP
+# pragma omp for schedule(dynamic)
+#endif
+    for (int d = 0; d < (int) ndraws; ++d)
+      {
+        MatrixView alphahat(alphahat_data + d*n_state*nper, n_state, nper, n_state),
+          etahat(etahat_data + d*n_exo*nper, n_exo, nper, n_exo),
+          epsilonhat(epsilonhat_data + d*n_varobs*nper, n_varobs, nper, n_varobs);
+        try
+          {
+            if (smoother == NULL)
+              throw std::runtime_error(initErrMsg);
+            steadyState = VectorConstView(mxGetPr(ss_mx), n_endo, 1);
+            deepParams = VectorConstView(mxGetPr(params_mx) + d*param_nbr, param_nbr, 1);
+            Q = MatrixConstView(mxGetPr(Q_mx) + d*Q_stride, n_exo, n_exo, n_exo);
+            if (no_measurement_errors)
+              H.setAll(0.0);
+            else
+              H = MatrixConstView(mxGetPr(H_mx) + d*H_stride, n_varobs, n_varobs, n_varobs);
+            loglik[d] = smoother->compute(data, steadyStateView, Q, H, deepParams, detrendedDataView,
+                                          alphahat, etahat, epsilonhat);
+          }
+        catch (DecisionRules::BlanchardKahnException &e)
+          {
+            info[d] = 1;
+          }
+        catch (GeneralizedSchurDecomposition::GSDException &e)
+          {
+            info[d] = 2;
+          }
+        catch (SteadyStateSolver::SteadyStateException &e)
+          {
+            info[d] = 3;
+            errMsgs[d] = e.message;
+          }
+        catch (DiscLyapFast::DLPException &e)
+          {
+            info[d] = 4;
+          }
+        catch (std::exception &e)
+          {
+            info[d] = 5;
+            errMsgs[d] = e.what();
+          }
+        if (info[d] != 0)
+          {
+            loglik[d] = std::numeric_limits<double>::quiet_NaN();
+            alphahat.setAll(std::numeric_limits<double>::quiet_NaN());
+            etahat.setAll(std::numeric_limits<double>::quiet_NaN());
+            epsilonhat.setAll(std::numeric_limits<double>::quiet_NaN());
+          }
+      }
+
+    delete smoother;
+  }
+
+  for (size_t d = 0; d < ndraws; ++d)
+    if (!errMsgs[d].empty())
+      mexPrintf("kalman_smoother: draw %d: %s\n", (int) d+1, errMsgs[d].c_str());
+
+  plhs[0] = alphahat_mx;
+  if (nlhs > 1)
+    plhs[1] = etahat_mx;
+  else
+    mxDestroyArray(etahat_mx);
+  if (nlhs > 2)
+    plhs[2] = epsilonhat_mx;
+  else
+    mxDestroyArray(epsilonhat_mx);
+  if (nlhs > 3)
+    plhs[3] = loglik_mx;
+  else
+    mxDestroyArray(loglik_mx);
+  if (nlhs > 4)
+    {
+      plhs[4] = mxCreateDoubleMatrix(n_state, 1, mxREAL);
+      for (size_t i = 0; i < n_state; ++i)
+        mxGetPr(plhs[4])[i] = state_var[i] + 1;
+    }
+  if (nlhs > 5)
+    plhs[5] = info_mx;
+  else
+    mxDestroyArray(info_mx);
+}
@@ -24,6 +24,7 @@
 
 #include "Vector.hh"
 #include "Matrix.hh"
+#include "SmallKernels.hh"
 
 namespace blas
 {
@@ -75,6 +76,12 @@ namespace blas
         assert(B.getSize() == A.getCols());
       }
     blas_int lda = A.getLd(), ldb = B.getStride(), ldc = C.getStride();
+    if (m > 0 && n > 0 && m <= (blas_int) small_kernel_threshold && n <= (blas_int) small_kernel_threshold)
+      {
+        small::gemv(*transa == 'T', m, n, alpha, A.getData(), lda,
+                    B.getData(), ldb, beta, C.getData(), ldc);
+        return;
+      }
     dgemv(transa, &m, &n, &alpha, A.getData(), &lda,
           B.getData(), &ldb, &beta, C.getData(), &ldc);
   }
@@ -97,6 +104,17 @@ namespace blas
           B.getData(), &ldb, &beta, C.getData(), &ldc);
   }
 
+  //! Triangular system solve: b = inv(A)*b, or b = inv(A')*b
+  template<class Mat, class Vec>
+  inline void
+  trsv(const char *uplo, const char *trans, const char *diag, const Mat &A, Vec &B)
+  {
+    assert(A.getRows() == A.getCols() && A.getRows() == B.getSize());
+    blas_int n = A.getRows();
+    blas_int lda = A.getLd(), incb = B.getStride();
+    dtrsv(uplo, trans, diag, &n, A.getData(), &lda, B.getData(), &incb);
+  }
+
   /* Level 3 */
 
   //! General matrix multiplication
@@ -142,10 +160,34 @@ namespace blas
           }
       }
     blas_int lda = A.getLd(), ldb = B.getLd(), ldc = C.getLd();
+    if (m > 0 && n > 0 && k > 0 && m <= (blas_int) small_kernel_threshold
+        && n <= (blas_int) small_kernel_threshold && k <= (blas_int) small_kernel_threshold)
+      {
+        small::gemm(*transa == 'T', *transb == 'T', m, n, k, alpha, A.getData(), lda,
+                    B.getData(), ldb, beta, C.getData(), ldc);
+        return;
+      }
     dgemm(transa, transb, &m, &n, &k, &alpha, A.getData(), &lda,
           B.getData(), &ldb, &beta, C.getData(), &ldc);
   }
 
+  //! Triangular system solve with multiple right hand sides: B = alpha*inv(A)*B, or B = alpha*inv(A')*B (side "L"), or B = alpha*B*inv(A), or B = alpha*B*inv(A') (side "R")
+  template<class Mat1, class Mat2>
+  inline void
+  trsm(const char *side, const char *uplo, const char *transa, const char *diag,
+       double alpha, const Mat1 &A, Mat2 &B)
+  {
+    assert(A.getRows() == A.getCols());
+    if (*side == 'L' || *side == 'l')
+      assert(A.getRows() == B.getRows());
+    else
+      assert(A.getRows() == B.getCols());
+    blas_int m = B.getRows(), n = B.getCols();
+    blas_int lda = A.getLd(), ldb = B.getLd();
+    dtrsm(side, uplo, transa, diag, &m, &n, &alpha, A.getData(), &lda,
+          B.getData(), &ldb);
+  }
+
   //! Symmetric matrix A * (poss. rectangular) matrix B multiplication
   template<class Mat1, class Mat2, class Mat3>
   inline void
@@ -167,6 +209,37 @@ namespace blas
           B.getData(), &ldb, &beta, C.getData(), &ldc);
   }
 
+  //! Symmetric rank k update: C = alpha*A*A' + beta*C, or C = alpha*A'*A + beta*C
+  // where C is a symmetric matrix of which only the triangle given by uplo
+  // is updated
+  template<class Mat1, class Mat2>
+  inline void
+  syrk(const char *uplo, const char *trans, double alpha, const Mat1 &A,
+       double beta, Mat2 &C)
+  {
+    assert(C.getRows() == C.getCols());
+    blas_int n = C.getRows(), k;
+    if (*trans == 'T')
+      {
+        assert(A.getCols() == C.getRows());
+        k = A.getRows();
+      }
+    else
+      {
+        assert(A.getRows() == C.getRows());
+        k = A.getCols();
+      }
+    blas_int lda = A.getLd(), ldc = C.getLd();
+    if (n > 0 && k > 0 && n <= (blas_int) small_kernel_threshold && k <= (blas_int) small_kernel_threshold)
+      {
+        small::syrk(*uplo == 'U', *trans == 'T', n, k, alpha, A.getData(), lda,
+                    beta, C.getData(), ldc);
+        return;
+      }
+    dsyrk(uplo, trans, &n, &k, &alpha, A.getData(), &lda,
+          &beta, C.getData(), &ldc);
+  }
+
 } // End of namespace
 
 #endif
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "ConditionalVarianceDecomposition.hh"
+
+namespace
+{
+  // Orders the indices of the horizons by increasing horizon
+  class StepsComparator
+  {
+    const std::vector<size_t> &steps;
+  public:
+    StepsComparator(const std::vector<size_t> &steps_arg) : steps(steps_arg)
+    {
+    };
+    bool
+    operator()(size_t i, size_t j) const
+    {
+      return steps[i] < steps[j];
+    };
+  };
+}
+
+ConditionalVarianceDecomposition::ConditionalVarianceDecomposition(size_t n_arg, size_t nshocks_arg,
+                                                                   const std::vector<size_t> &steps_arg,
+                                                                   const std::vector<size_t> &rows_arg) :
+  n(n_arg), nshocks(nshocks_arg), steps(steps_arg.size()), steps_order(steps_arg.size()),
+  rows(rows_arg), X(n, nshocks), X_new(n, nshocks), acc(rows_arg.size(), nshocks)
+{
+  for (size_t i = 0; i < steps_order.size(); i++)
+    {
+      assert(steps_arg[i] > 0);
+      steps_order[i] = i;
+    }
+  std::stable_sort(steps_order.begin(), steps_order.end(), StepsComparator(steps_arg));
+  for (size_t i = 0; i < steps.size(); i++)
+    steps[i] = steps_arg[steps_order[i]];
+  for (size_t r = 0; r < rows.size(); r++)
+    assert(rows[r] < n);
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CONDITIONAL_VARIANCE_DECOMPOSITION_HH
+#define _CONDITIONAL_VARIANCE_DECOMPOSITION_HH
+
+#include <vector>
+
+#include "Matrix.hh"
+#include "BlasBindings.hh"
+
+/*!
+  Computes the conditional variance decomposition of x(t) = T*x(t-1) + B*e(t),
+  var(e(t)) = I (the algorithm of matlab/conditional_variance_decomposition.m).
+
+  The conditional variance at horizon h due to shock k is the diagonal of
+  sum_{j=0}^{h-1} T^j*B(:,k)*B(:,k)'*T^j', i.e. the sum of the squares of the
+  impulse responses T^j*B(:,k). The responses to all the shocks are propagated
+  together, with one product by T per period, and only the diagonal of the
+  symmetric variance matrices is accumulated.
+
+  The workspace is allocated in the constructor, so that the same object can
+  be used for many draws of the same model without any allocation.
+*/
+class ConditionalVarianceDecomposition
+{
+private:
+  const size_t n, nshocks;
+  //! Horizons, and their order in the output
+  std::vector<size_t> steps, steps_order;
+  //! Rows of the state vector in the output
+  const std::vector<size_t> rows;
+  Matrix X, X_new, acc;
+public:
+  /*!
+    \param steps_arg Horizons (strictly positive, in any order)
+    \param rows_arg Rows of x(t) for which the decomposition is computed
+  */
+  ConditionalVarianceDecomposition(size_t n_arg, size_t nshocks_arg,
+                                   const std::vector<size_t> &steps_arg,
+                                   const std::vector<size_t> &rows_arg);
+  virtual ~ConditionalVarianceDecomposition()
+  {
+  };
+  /*!
+    Computes, from T (n*n) and B (n*nshocks), the share of each shock in the
+    conditional variance: decomp(r, k*nsteps+s) for row rows[r], shock k and
+    horizon steps_arg[s]. If variance is not NULL, the conditional variances
+    themselves are stored in it, with the same layout.
+  */
+  template<class Mat1, class Mat2, class Mat3>
+  void compute(const Mat1 &T, const Mat2 &B, Mat3 &decomp, MatrixView *variance = NULL);
+};
+
+template<class Mat1, class Mat2, class Mat3>
+void
+ConditionalVarianceDecomposition::compute(const Mat1 &T, const Mat2 &B, Mat3 &decomp, MatrixView *variance)
+{
+  const size_t nrows = rows.size(), nsteps = steps.size();
+  assert(T.getRows() == n && T.getCols() == n
+         && B.getRows() == n && B.getCols() == nshocks
+         && decomp.getRows() == nrows && decomp.getCols() == nshocks*nsteps);
+
+  X = B;
+  acc.setAll(0.0);
+  size_t s = 0;
+  for (size_t h = 1; s < nsteps; h++)
+    {
+      for (size_t k = 0; k < nshocks; k++)
+        for (size_t r = 0; r < nrows; r++)
+          {
+            const double x = X(rows[r], k);
+            acc(r, k) += x*x;
+          }
+
+      for (; s < nsteps && steps[s] == h; s++)
+        for (size_t k = 0; k < nshocks; k++)
+          for (size_t r = 0; r < nrows; r++)
+            decomp(r, k*nsteps+steps_order[s]) = acc(r, k);
+
+      if (s < nsteps)
+        {
+          blas::gemm("N", "N", 1.0, T, X, 0.0, X_new);
+          X = X_new;
+        }
+    }
+
+  if (variance != NULL)
+    *variance = decomp;
+
+  for (size_t t = 0; t < nsteps; t++)
+    for (size_t r = 0; r < nrows; r++)
+      {
+        double sum = 0.0;
+        for (size_t k = 0; k < nshocks; k++)
+          sum += decomp(r, k*nsteps+t);
+        for (size_t k = 0; k < nshocks; k++)
+          decomp(r, k*nsteps+t) /= sum;
+      }
+}
+
+#endif
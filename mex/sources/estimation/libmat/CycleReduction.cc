@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CycleReduction.hh"
+
+CycleReduction::CycleReduction(size_t n_arg, double tol_arg, size_t max_it_arg) :
+  n(n_arg), tol(tol_arg), max_it(max_it_arg), iterations(0),
+  A0(n), A1(n), A2(n), Ahat1(n), A1_lu(n), W(n, 2*n), A0_new(n), A2_new(n),
+  LU(n)
+{
+}
+
+std::ostream &
+operator<<(std::ostream &out, const CycleReduction::CRException &e)
+{
+  if (e.info == 4)
+    out << "Cycle reduction did not converge: the norm of A2 is still exp(" << e.value << ")";
+  else
+    out << "Cycle reduction did not converge: the norm of A1 is exp(" << e.value << ")";
+  return out;
+}
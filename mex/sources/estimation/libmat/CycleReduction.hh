@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CYCLE_REDUCTION_HH
+#define _CYCLE_REDUCTION_HH
+
+#include <cmath>
+#include <limits>
+
+#include "Vector.hh"
+#include "Matrix.hh"
+#include "BlasBindings.hh"
+#include "LUSolver.hh"
+
+/*!
+  Solves the quadratic matrix equation A0 + A1*X + A2*X*X = 0 by cycle
+  reduction (the algorithm of matlab/cycle_reduction/cycle_reduction.m),
+  returning the solution whose eigenvalues are inside the unit circle.
+
+  The workspace is allocated in the constructor, so that the same object can
+  be used for many equations of the same size without any allocation.
+*/
+class CycleReduction
+{
+private:
+  const size_t n;
+  const double tol;
+  const size_t max_it;
+  size_t iterations;
+  Matrix A0, A1, A2, Ahat1, A1_lu, W, A0_new, A2_new;
+  LUSolver LU;
+public:
+  class CRException
+  {
+  public:
+    //! 3 if the algorithm did not converge, 4 if A0 converged but not A2 (the info codes of cycle_reduction.m)
+    const int info;
+    //! Logarithm of the 1-norm of A1 (if info == 3) or of A2 (if info == 4)
+    const double value;
+    CRException(int info_arg, double value_arg) : info(info_arg), value(value_arg)
+    {
+    };
+  };
+  /*!
+    \param tol_arg Tolerance on the 1-norms of A0 and A2 at convergence
+    \param max_it_arg Maximum number of iterations
+  */
+  CycleReduction(size_t n_arg, double tol_arg, size_t max_it_arg = 300);
+  virtual ~CycleReduction()
+  {
+  };
+  //! Computes X
+  template<class Mat1, class Mat2, class Mat3, class Mat4>
+  void compute(const Mat1 &A0_arg, const Mat2 &A1_arg, const Mat3 &A2_arg, Mat4 &X) throw (CRException);
+  //! Number of iterations of the last call to compute()
+  size_t
+  getIterations() const
+  {
+    return iterations;
+  };
+};
+
+std::ostream &operator<<(std::ostream &out, const CycleReduction::CRException &e);
+
+template<class Mat1, class Mat2, class Mat3, class Mat4>
+void
+CycleReduction::compute(const Mat1 &A0_arg, const Mat2 &A1_arg, const Mat3 &A2_arg, Mat4 &X) throw (CRException)
+{
+  assert(A0_arg.getRows() == n && A0_arg.getCols() == n
+         && A1_arg.getRows() == n && A1_arg.getCols() == n
+         && A2_arg.getRows() == n && A2_arg.getCols() == n
+         && X.getRows() == n && X.getCols() == n);
+
+  A0 = A0_arg;
+  A1 = A1_arg;
+  A2 = A2_arg;
+  Ahat1 = A1_arg;
+  MatrixView W0(W, 0, 0, n, n), W2(W, 0, n, n, n);
+
+  for (iterations = 0;; iterations++)
+    {
+      // W = A1\[A0 A2]
+      W0 = A0;
+      W2 = A2;
+      A1_lu = A1;
+      try
+        {
+          LU.invMult("N", A1_lu, W);
+        }
+      catch (LUSolver::LUException &e)
+        {
+          throw CRException(3, std::numeric_limits<double>::infinity());
+        }
+
+      blas::gemm("N", "N", -1.0, A0, W2, 1.0, A1);
+      blas::gemm("N", "N", -1.0, A2, W0, 1.0, A1);
+      blas::gemm("N", "N", -1.0, A2, W0, 1.0, Ahat1);
+      blas::gemm("N", "N", -1.0, A0, W0, 0.0, A0_new);
+      blas::gemm("N", "N", -1.0, A2, W2, 0.0, A2_new);
+      A0 = A0_new;
+      A2 = A2_new;
+
+      double crit = mat::nrm1(A0);
+      if (crit < tol && mat::nrm1(A2) < tol)
+        break;
+      if (crit != crit || iterations == max_it) // crit != crit if crit is NaN
+        {
+          if (crit < tol)
+            throw CRException(4, log(mat::nrm1(A2)));
+          else
+            throw CRException(3, log(mat::nrm1(A1)));
+        }
+    }
+
+  // X = -Ahat1\A0
+  X = A0_arg;
+  A1_lu = Ahat1;
+  try
+    {
+      LU.invMult("N", A1_lu, X);
+    }
+  catch (LUSolver::LUException &e)
+    {
+      throw CRException(3, std::numeric_limits<double>::infinity());
+    }
+  mat::negate(X);
+}
+
+#endif
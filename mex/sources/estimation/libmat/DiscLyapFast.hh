@@ -30,11 +30,19 @@
    % based on work of Joe Pearlman and Alejandro Justiniano
    % 3/5/2005
    % C++ version 28/07/09 by Dynare team
+   %
+   % solve_lyap_warm first tries fixed point iterations X=G*X*G'+V
+   % started from the solution of the previous call (the lyapunov_fp
+   % option of the Matlab code), and falls back to the doubling
+   % algorithm if they do not converge fast enough
 ****************************************************************/
 
 #if !defined(DiscLyapFast_INCLUDE)
 #define DiscLyapFast_INCLUDE
 
+#include <cmath>
+#include <algorithm>
+
 #include "dynlapack.h"
 #include "Matrix.hh"
 #include "BlasBindings.hh"
@@ -42,6 +50,9 @@
 class DiscLyapFast
 {
   Matrix A0, A1, Ptmp, P0, P1, I;
+  //! Solution of the last call, used as starting point by solve_lyap_warm
+  Matrix Xprev;
+  bool hasPrevious;
 
 public:
   class DLPException
@@ -56,7 +67,7 @@ public:
   };
 
   DiscLyapFast(size_t n) :
-    A0(n), A1(n), Ptmp(n), P0(n), P1(n), I(n)
+    A0(n), A1(n), Ptmp(n), P0(n), P1(n), I(n), Xprev(n), hasPrevious(false)
   {
     mat::set_identity(I);
   };
@@ -65,7 +76,25 @@ public:
   };
   template <class MatG, class MatV, class MatX >
   void solve_lyap(const MatG &G, const MatV &V, MatX &X, double tol = 1e-16, size_t flag_ch = 0) throw (DLPException);
+  /*!
+    Warm-started solver: fixed point iterations from the previous solution
+    until the increment is below fp_tol, or doubling algorithm with tolerance
+    tol if the increments indicate that more than max_iter iterations would
+    be needed. The first call always uses the doubling algorithm.
+  */
+  template <class MatG, class MatV, class MatX >
+  void solve_lyap_warm(const MatG &G, const MatV &V, MatX &X, double fp_tol, double tol = 1e-16,
+                       size_t max_iter = 300, size_t flag_ch = 0) throw (DLPException);
+  //! Discards the previous solution, so that the next call to solve_lyap_warm starts from scratch
+  void
+  reset()
+  {
+    hasPrevious = false;
+  };
 
+private:
+  //! Throws if P0 is not positive definite (destroys P0)
+  void checkPositiveDefinite() throw (DLPException);
 };
 
 template <class MatG, class MatV, class MatX >
@@ -108,17 +137,82 @@ DiscLyapFast::solve_lyap(const MatG &G, const MatV &V, MatX &X, double tol, size
 
   // Check that X is positive definite
   if (flag_ch == 1) // calc NormCholesky (P0)
+    checkPositiveDefinite();
+}
+
+template <class MatG, class MatV, class MatX >
+void
+DiscLyapFast::solve_lyap_warm(const MatG &G, const MatV &V, MatX &X, double fp_tol, double tol,
+                              size_t max_iter, size_t flag_ch) throw (DLPException)
+{
+  bool converged = false;
+  if (hasPrevious)
     {
-      lapack_int lpinfo = 0;
-      lapack_int lrows = P0.getRows();
-      lapack_int ldl = P0.getLd();
-      dpotrf("L", &lrows, P0.getData(), &ldl, &lpinfo);
-      if (lpinfo < 0)
-        throw DLPException((int) lpinfo, std::string("DiscLyapFast:Internal error in NormCholesky calculator"));
-      else if (lpinfo > 0)
-        throw DLPException((int) lpinfo, std::string("DiscLyapFast:The matrix is not positive definite in NormCholesky calculator"));
+      P0 = Xprev;
+      double oldIncr = 0.0;
+      for (size_t iter = 1; iter <= max_iter; iter++)
+        {
+          // P1=G*P0*G'+V
+          blas::gemm("N", "T", 1.0, P0, G, 0.0, Ptmp);
+          P1 = V;
+          blas::gemm("N", "N", 1.0, G, Ptmp, 1.0, P1);
+
+          // incr = max( max( abs( P1 - P0 ) ) )
+          double incr = 0.0;
+          for (size_t j = 0; j < P1.getCols(); j++)
+            for (size_t i = 0; i <= j; i++)
+              incr = std::max(incr, fabs(P1(i, j) - P0(i, j)));
+          P0 = P1;
+          if (incr <= fp_tol)
+            {
+              converged = true;
+              break;
+            }
+
+          /* The increments decrease geometrically at the rate of the square of
+             the spectral radius of G: stop as soon as this rate shows that
+             max_iter iterations will not be enough */
+          if (iter > 1)
+            {
+              double rate = incr / oldIncr;
+              if (!(rate < 1.0) || iter + log(fp_tol / incr) / log(rate) > max_iter)
+                break;
+            }
+          oldIncr = incr;
+        }
+    }
 
+  if (converged)
+    {
+      // ensure symmetry of X=P0=(P1+P1')/2;
+      blas::gemm("T", "N", 0.5, P1, I, 0.5, P0);
+      X = P0;
     }
+  else
+    solve_lyap(G, V, X, tol, 0);
+
+  Xprev = X;
+  hasPrevious = true;
+
+  if (flag_ch == 1)
+    {
+      P0 = X;
+      checkPositiveDefinite();
+    }
+}
+
+inline void
+DiscLyapFast::checkPositiveDefinite() throw (DLPException)
+{
+  // calc NormCholesky (P0)
+  lapack_int lpinfo = 0;
+  lapack_int lrows = P0.getRows();
+  lapack_int ldl = P0.getLd();
+  dpotrf("L", &lrows, P0.getData(), &ldl, &lpinfo);
+  if (lpinfo < 0)
+    throw DLPException((int) lpinfo, std::string("DiscLyapFast:Internal error in NormCholesky calculator"));
+  else if (lpinfo > 0)
+    throw DLPException((int) lpinfo, std::string("DiscLyapFast:The matrix is not positive definite in NormCholesky calculator"));
 }
 
 #endif //if !defined(DiscLyapFast_INCLUDE)
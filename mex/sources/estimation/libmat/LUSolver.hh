@@ -17,6 +17,9 @@
  * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#ifndef _LUSOLVER_HH
+#define _LUSOLVER_HH
+
 #include <cstdlib>
 #include <cassert>
 
@@ -64,3 +67,5 @@ LUSolver::invMult(const char *trans, Mat1 &A, Mat2 &B) throw (LUException)
   dgetrs(trans, &n, &nrhs, A.getData(), &lda, ipiv, B.getData(), &ldb, &info);
   assert(info == 0);
 }
+
+#endif
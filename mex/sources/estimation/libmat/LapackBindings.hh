@@ -41,6 +41,25 @@ namespace lapack
     return info;
   }
 
+  // calc inverse of the symmetric positive definite Mat A in place (both
+  // triangles are returned), using its Cholesky decomposition
+  template<class Mat>
+  inline int
+  choleskyInverse(Mat &A)
+  {
+    int info = choleskyDecomp(A, "L");
+    if (info != 0)
+      return info;
+    lapack_int lpinfo = 0;
+    lapack_int lrows = A.getRows();
+    lapack_int ldl = A.getLd();
+    dpotri("L", &lrows, A.getData(), &ldl, &lpinfo);
+    for (size_t j = 0; j < A.getCols(); j++)
+      for (size_t i = 0; i < j; i++)
+        A(i, j) = A(j, i);
+    return (int) lpinfo;
+  }
+
   // calc Cholesky Decomposition based solution X to A*X=B
   // for A pos. def. and symmetric supplied as uppper/lower triangle
   // packed in a vector if UPLO = 'U', AP(i + (j-1)*j/2) = A(i,j) for 1<=i<=j;
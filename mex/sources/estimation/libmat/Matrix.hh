@@ -513,6 +513,48 @@ namespace mat
     return nrm;
   }
 
+  // Computes the 1-norm of a matrix (maximum of the column sums of absolute values)
+  template<class Mat>
+  double
+  nrm1(const Mat &m)
+  {
+    double nrm = 0;
+    const double *p = m.getData();
+    while (p < m.getData() + m.getCols() * m.getLd())
+      {
+        double sum = 0;
+        for (const double *pp = p; pp < p + m.getRows(); pp++)
+          sum += fabs(*pp);
+        if (sum > nrm)
+          nrm = sum;
+
+        p += m.getLd();
+      }
+    return nrm;
+  }
+
+  // Returns the i-th index of an index vector, where a zero sized vector (or
+  // mat::nullVec) stands for ":", so that no temporary vector of indices has
+  // to be allocated
+  inline size_t
+  vecIndex(const std::vector<size_t> &v, size_t i)
+  {
+    return v.size() == 0 ? i : v[i];
+  }
+
+  // Returns the number of indices in an index vector, where a zero sized vector
+  // (or mat::nullVec) stands for all the n indices, and checks that they are smaller than n
+  inline size_t
+  vecIndexSize(const std::vector<size_t> &v, size_t n)
+  {
+    if (v.size() == 0)
+      return n;
+    for (size_t i = 0; i < v.size(); ++i)
+      assert(v[i] < n); //Negative or too large indices
+    assert(v.size() <= n); // check wrong dimensions for assignment by vector
+    return v.size();
+  }
+
   // emulates Matlab command A(:,b)=B(:,d) where b,d are size_t vectors or nullVec as a proxy for ":")
   // i.e. zero sized vector (or mat::nullVec) is interpreted as if one supplied ":" in matlab
   template<class Mat1, class Mat2>
@@ -520,56 +562,18 @@ namespace mat
   reorderColumnsByVectors(Mat1 &a, const std::vector<size_t> &vToCols,
                           const Mat2 &b, const std::vector<size_t> &vcols)
   {
-    size_t ncols = 0, toncols = 0;
-    const std::vector<size_t> *vpToCols = 0, *vpCols = 0;
-    std::vector<size_t> tmpvpToCols(0), tmpvpCols(0);
     assert(b.getRows() ==  a.getRows());
 
     if (vToCols.size() == 0  && vcols.size() == 0)
       a = b;
     else
       {
-        if (vToCols.size() == 0)
-          {
-            toncols = a.getCols();
-            tmpvpToCols.reserve(toncols);
-            for (size_t i = 0; i < toncols; ++i)
-              tmpvpToCols[i] = i;
-            vpToCols = (const std::vector<size_t> *)&tmpvpToCols;
-          }
-        else
-          {
-            for (size_t i = 0; i < vToCols.size(); ++i)
-              {
-                assert(vToCols[i] < a.getCols()); //Negative or too large indices
-                toncols++;
-              }
-            assert(toncols <= a.getCols()); // check wrong dimensions for assignment by vector
-            vpToCols = &vToCols;
-          }
-
-        if (vcols.size() == 0)
-          {
-            ncols = b.getCols();
-            tmpvpCols.reserve(ncols);
-            for (size_t i = 0; i < ncols; ++i)
-              tmpvpCols[i] = i;
-            vpCols = (const std::vector<size_t> *)&tmpvpCols;
-          }
-        else
-          {
-            for (size_t i = 0; i < vcols.size(); ++i)
-              {
-                assert(vcols[i] < b.getCols()); //Negative or too large indices
-                ncols++;
-              }
-            assert(ncols <= b.getCols()); // check wrong dimensions for assignment by vector
-            vpCols = &vcols;
-          }
+        size_t toncols = vecIndexSize(vToCols, a.getCols());
+        size_t ncols = vecIndexSize(vcols, b.getCols());
 
         assert(toncols == ncols && ncols > 0);
         for (size_t j = 0; j < ncols; ++j)
-          col_copy(b,  (*vpCols)[j], a,  (*vpToCols)[j]);
+          col_copy(b, vecIndex(vcols, j), a, vecIndex(vToCols, j));
       }
   }
 
@@ -580,57 +584,18 @@ namespace mat
   reorderRowsByVectors(Mat1 &a, const std::vector<size_t> &vToRows,
                        const Mat2 &b, const std::vector<size_t> &vrows)
   {
-    size_t nrows = 0, tonrows = 0;
-    const std::vector<size_t>  *vpToRows = 0, *vpRows = 0;
-    std::vector<size_t>  tmpvpToRows(0), tmpvpRows(0);
-
     //assert(b.getRows() >=  a.getRows() && b.getCols() ==  a.getCols());
     assert(b.getCols() ==  a.getCols());
     if (vToRows.size() == 0  && vrows.size() == 0)
       a = b;
     else
       {
-        if (vToRows.size() == 0)
-          {
-            tonrows = a.getRows();
-            tmpvpToRows.reserve(tonrows);
-            for (size_t i = 0; i < tonrows; ++i)
-              tmpvpToRows[i] = i;
-            vpToRows = (const std::vector<size_t> *)&tmpvpToRows;
-          }
-        else
-          {
-            for (size_t i = 0; i < vToRows.size(); ++i)
-              {
-                assert(vToRows[i] < a.getRows()); //Negative or too large indices
-                tonrows++;
-              }
-            assert(tonrows <= a.getRows()); // check wrong dimensions for assignment by vector
-            vpToRows = &vToRows;
-          }
-
-        if (vrows.size() == 0)
-          {
-            nrows = b.getRows();
-            tmpvpRows.reserve(nrows);
-            for (size_t i = 0; i < nrows; ++i)
-              tmpvpRows[i] = i;
-            vpRows = (const std::vector<size_t> *)&tmpvpRows;
-          }
-        else
-          {
-            for (size_t i = 0; i < vrows.size(); ++i)
-              {
-                assert(vrows[i] < b.getRows()); //Negative or too large indices
-                nrows++;
-              }
-            assert(nrows <= b.getRows()); // check wrong dimensions for assignment by vector
-            vpRows = &vrows;
-          }
+        size_t tonrows = vecIndexSize(vToRows, a.getRows());
+        size_t nrows = vecIndexSize(vrows, b.getRows());
 
         assert(tonrows == nrows && nrows > 0);
         for (size_t i = 0; i < nrows; ++i)
-          row_copy(b, (*vpRows)[i], a, (*vpToRows)[i]);
+          row_copy(b, vecIndex(vrows, i), a, vecIndex(vToRows, i));
       }
   }
 
@@ -641,98 +606,23 @@ namespace mat
   assignByVectors(Mat1 &a, const std::vector<size_t> &vToRows, const std::vector<size_t> &vToCols,
                   const Mat2 &b, const std::vector<size_t> &vrows, const std::vector<size_t> &vcols)
   {
-    size_t nrows = 0, ncols = 0, tonrows = 0, toncols = 0;
-    const std::vector<size_t> *vpToCols = 0, *vpToRows = 0, *vpRows = 0, *vpCols = 0;
-    std::vector<size_t> tmpvpToCols(0), tmpvpToRows(0), tmpvpRows(0), tmpvpCols(0);
-
     if (vToRows.size() == 0 && vToCols.size() == 0 && vrows.size() == 0 && vcols.size() == 0)
       a = b;
-    else if (vToRows.size() == 0 && vrows.size() == 0)                                                                                                                                                                                                                                                                                                                                                                                                    // just reorder columns
+    else if (vToRows.size() == 0 && vrows.size() == 0) // just reorder columns
       reorderColumnsByVectors(a, vToCols, b, vcols);
-    else if (vToCols.size() == 0 && vcols.size() == 0)                                                                                                                                                                                                                                                                                                                                                                                                    // just reorder rows
+    else if (vToCols.size() == 0 && vcols.size() == 0) // just reorder rows
       reorderRowsByVectors(a, vToRows, b, vrows);
     else
       {
-        if (vToRows.size() == 0)
-          {
-            tonrows = a.getRows();
-            tmpvpToRows.reserve(tonrows);
-            for (size_t i = 0; i < tonrows; ++i)
-              tmpvpToRows[i] = i;
-            vpToRows = (const std::vector<size_t> *)&tmpvpToRows;
-          }
-        else
-          {
-            for (size_t i = 0; i < vToRows.size(); ++i)
-              {
-                assert(vToRows[i] < a.getRows()); //Negative or too large indices
-                tonrows++;
-              }
-            assert(tonrows <= a.getRows()); // check wrong dimensions for assignment by vector
-            vpToRows = &vToRows;
-          }
-
-        if (vToCols.size() == 0)
-          {
-            toncols = a.getCols();
-            tmpvpToCols.reserve(toncols);
-            for (size_t i = 0; i < toncols; ++i)
-              tmpvpToCols[i] = i;
-            vpToCols = (const std::vector<size_t> *)&tmpvpToCols;
-          }
-        else
-          {
-            for (size_t i = 0; i < vToCols.size(); ++i)
-              {
-                assert(vToCols[i] < a.getCols()); //Negative or too large indices
-                toncols++;
-              }
-            assert(toncols <= a.getCols()); // check wrong dimensions for assignment by vector
-            vpToCols = &vToCols;
-          }
-
-        if (vrows.size() == 0)
-          {
-            nrows = b.getRows();
-            tmpvpRows.reserve(nrows);
-            for (size_t i = 0; i < nrows; ++i)
-              tmpvpRows[i] = i;
-            vpRows = (const std::vector<size_t> *)&tmpvpRows;
-          }
-        else
-          {
-            for (size_t i = 0; i < vrows.size(); ++i)
-              {
-                assert(vrows[i] < b.getRows()); //Negative or too large indices
-                nrows++;
-              }
-            assert(nrows <= b.getRows()); // check wrong dimensions for assignment by vector
-            vpRows = &vrows;
-          }
-
-        if (vcols.size() == 0)
-          {
-            ncols = b.getCols();
-            tmpvpCols.reserve(ncols);
-            for (size_t i = 0; i < ncols; ++i)
-              tmpvpCols[i] = i;
-            vpCols = (const std::vector<size_t> *)&tmpvpCols;
-          }
-        else
-          {
-            for (size_t i = 0; i < vcols.size(); ++i)
-              {
-                assert(vcols[i] < b.getCols()); //Negative or too large indices
-                ncols++;
-              }
-            assert(ncols <= b.getCols()); // check wrong dimensions for assignment by vector
-            vpCols = &vcols;
-          }
+        size_t tonrows = vecIndexSize(vToRows, a.getRows());
+        size_t toncols = vecIndexSize(vToCols, a.getCols());
+        size_t nrows = vecIndexSize(vrows, b.getRows());
+        size_t ncols = vecIndexSize(vcols, b.getCols());
 
         assert(tonrows == nrows && toncols == ncols && nrows * ncols > 0);
-        for (size_t i = 0; i < nrows; ++i)
-          for (size_t j = 0; j < ncols; ++j)
-            a((*vpToRows)[i], (*vpToCols)[j]) = b((*vpRows)[i], (*vpCols)[j]);
+        for (size_t j = 0; j < ncols; ++j)
+          for (size_t i = 0; i < nrows; ++i)
+            a(vecIndex(vToRows, i), vecIndex(vToCols, j)) = b(vecIndex(vrows, i), vecIndex(vcols, j));
       }
   }
 
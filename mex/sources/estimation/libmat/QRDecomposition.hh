@@ -17,6 +17,9 @@
  * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#ifndef _QR_DECOMPOSITION_HH
+#define _QR_DECOMPOSITION_HH
+
 #include <algorithm> // For std::min()
 
 #include <dynlapack.h>
@@ -51,6 +54,12 @@ public:
   */
   template<class Mat1, class Mat2>
   void computeAndLeftMultByQ(Mat1 &A, const char *trans, Mat2 &C);
+  //! Performs the QR decomposition of a matrix, when only R is needed
+  /*!
+    \param[in,out] A On input, the matrix to be decomposed. On output, equals to the output of dgeqrf (R is in the upper triangle)
+  */
+  template<class Mat>
+  void compute(Mat &A);
 };
 
 template<class Mat1, class Mat2>
@@ -71,3 +80,17 @@ QRDecomposition::computeAndLeftMultByQ(Mat1 &A, const char *trans, Mat2 &C)
          work2, &lwork2, &info);
   assert(info == 0);
 }
+
+template<class Mat>
+void
+QRDecomposition::compute(Mat &A)
+{
+  assert(A.getRows() == rows && A.getCols() == cols);
+
+  lapack_int m = rows, n = cols, lda = A.getLd();
+  lapack_int info;
+  dgeqrf(&m, &n, A.getData(), &lda, tau, work, &lwork, &info);
+  assert(info == 0);
+}
+
+#endif
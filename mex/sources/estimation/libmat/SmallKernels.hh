@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Plain loop kernels for the BLAS operations used by the estimation code,
+ * meant for the small matrices of small models (a handful of states), for
+ * which the call overhead and the packing done by optimized BLAS
+ * implementations dominate the cost of the operation itself.
+ *
+ * The kernels work on column-major storage and have the same semantics as
+ * their BLAS counterparts (in particular C is not read when beta is zero).
+ * Each of them is a template on the dimension of its innermost loop, so that
+ * the compiler can fully unroll it and keep the accumulators in registers;
+ * the Fixed class template selects the instance matching a size known only
+ * at runtime. The bindings of BlasBindings.hh dispatch to these kernels when
+ * all the dimensions are at most small_kernel_threshold.
+ */
+
+#ifndef _SMALL_KERNELS_HH
+#define _SMALL_KERNELS_HH
+
+#include <cstddef>
+#include <cassert>
+
+namespace blas
+{
+  //! Largest dimension for which the bindings use the loop kernels instead of BLAS
+  /*! Determined with tests/bench-small against OpenBLAS, at the -O2
+      optimization level used for the MEX files: above this size, the matrix
+      multiplication of optimized BLAS implementations is at least as fast. */
+  const size_t small_kernel_threshold = 4;
+
+  namespace small
+  {
+    //! C = alpha*A*op(B) + beta*C, where C is M*n and A is M*k
+    template<size_t M>
+    inline void
+    gemm_n(bool transb, size_t n, size_t k, double alpha, const double *A, size_t lda,
+           const double *B, size_t ldb, double beta, double *C, size_t ldc)
+    {
+      for (size_t j = 0; j < n; j++)
+        {
+          double acc[M];
+          for (size_t i = 0; i < M; i++)
+            acc[i] = 0.0;
+          const double *Bj = transb ? B + j : B + j*ldb;
+          size_t incb = transb ? ldb : 1;
+          for (size_t l = 0; l < k; l++)
+            {
+              double temp = Bj[l*incb];
+              const double *Al = A + l*lda;
+              for (size_t i = 0; i < M; i++)
+                acc[i] += temp*Al[i];
+            }
+          double *Cj = C + j*ldc;
+          if (beta == 0.0)
+            for (size_t i = 0; i < M; i++)
+              Cj[i] = alpha*acc[i];
+          else
+            for (size_t i = 0; i < M; i++)
+              Cj[i] = beta*Cj[i] + alpha*acc[i];
+        }
+    }
+
+    //! C = alpha*A'*op(B) + beta*C, where C is m*n and A is K*m
+    template<size_t K>
+    inline void
+    gemm_t(bool transb, size_t m, size_t n, double alpha, const double *A, size_t lda,
+           const double *B, size_t ldb, double beta, double *C, size_t ldc)
+    {
+      for (size_t j = 0; j < n; j++)
+        {
+          double Bj[K];
+          for (size_t l = 0; l < K; l++)
+            Bj[l] = transb ? B[j + l*ldb] : B[l + j*ldb];
+          double *Cj = C + j*ldc;
+          for (size_t i = 0; i < m; i++)
+            {
+              const double *Ai = A + i*lda;
+              double temp = 0.0;
+              for (size_t l = 0; l < K; l++)
+                temp += Ai[l]*Bj[l];
+              Cj[i] = (beta == 0.0 ? 0.0 : beta*Cj[i]) + alpha*temp;
+            }
+        }
+    }
+
+    //! y = alpha*A*x + beta*y, where A is M*n
+    template<size_t M>
+    inline void
+    gemv_n(size_t n, double alpha, const double *A, size_t lda,
+           const double *x, size_t incx, double beta, double *y, size_t incy)
+    {
+      double acc[M];
+      for (size_t i = 0; i < M; i++)
+        acc[i] = 0.0;
+      for (size_t j = 0; j < n; j++)
+        {
+          double temp = x[j*incx];
+          const double *Aj = A + j*lda;
+          for (size_t i = 0; i < M; i++)
+            acc[i] += temp*Aj[i];
+        }
+      for (size_t i = 0; i < M; i++)
+        y[i*incy] = (beta == 0.0 ? 0.0 : beta*y[i*incy]) + alpha*acc[i];
+    }
+
+    //! y = alpha*A'*x + beta*y, where A is M*n
+    template<size_t M>
+    inline void
+    gemv_t(size_t n, double alpha, const double *A, size_t lda,
+           const double *x, size_t incx, double beta, double *y, size_t incy)
+    {
+      double xl[M];
+      for (size_t i = 0; i < M; i++)
+        xl[i] = x[i*incx];
+      for (size_t j = 0; j < n; j++)
+        {
+          const double *Aj = A + j*lda;
+          double temp = 0.0;
+          for (size_t i = 0; i < M; i++)
+            temp += Aj[i]*xl[i];
+          y[j*incy] = (beta == 0.0 ? 0.0 : beta*y[j*incy]) + alpha*temp;
+        }
+    }
+
+    //! Symmetric rank-k update C = alpha*A*A' + beta*C, where C is N*N and A is N*k
+    /*! Only the triangle of C given by upper is updated. The whole columns
+        are accumulated, so that the inner loop has a fixed length. */
+    template<size_t N>
+    inline void
+    syrk_n(bool upper, size_t k, double alpha, const double *A, size_t lda,
+           double beta, double *C, size_t ldc)
+    {
+      for (size_t j = 0; j < N; j++)
+        {
+          double acc[N];
+          for (size_t i = 0; i < N; i++)
+            acc[i] = 0.0;
+          for (size_t l = 0; l < k; l++)
+            {
+              double temp = A[j + l*lda];
+              const double *Al = A + l*lda;
+              for (size_t i = 0; i < N; i++)
+                acc[i] += temp*Al[i];
+            }
+          double *Cj = C + j*ldc;
+          for (size_t i = (upper ? 0 : j); i < (upper ? j + 1 : N); i++)
+            Cj[i] = (beta == 0.0 ? 0.0 : beta*Cj[i]) + alpha*acc[i];
+        }
+    }
+
+    //! Symmetric rank-k update C = alpha*A'*A + beta*C, where C is n*n and A is K*n
+    /*! Only the triangle of C given by upper is updated. */
+    template<size_t K>
+    inline void
+    syrk_t(bool upper, size_t n, double alpha, const double *A, size_t lda,
+           double beta, double *C, size_t ldc)
+    {
+      for (size_t j = 0; j < n; j++)
+        {
+          double Aj[K];
+          for (size_t l = 0; l < K; l++)
+            Aj[l] = A[l + j*lda];
+          double *Cj = C + j*ldc;
+          for (size_t i = (upper ? 0 : j); i < (upper ? j + 1 : n); i++)
+            {
+              const double *Ai = A + i*lda;
+              double temp = 0.0;
+              for (size_t l = 0; l < K; l++)
+                temp += Ai[l]*Aj[l];
+              Cj[i] = (beta == 0.0 ? 0.0 : beta*Cj[i]) + alpha*temp;
+            }
+        }
+    }
+
+    //! Calls the instance of a kernel for a size s between S and Max
+    /*! The search starts from the smallest sizes, for which the cost of the
+        dispatch matters most. */
+    template<size_t S, size_t Max>
+    struct Fixed
+    {
+      static void
+      gemm(bool transa, bool transb, size_t s, size_t m, size_t n, size_t k, double alpha,
+           const double *A, size_t lda, const double *B, size_t ldb, double beta, double *C, size_t ldc)
+      {
+        if (s != S)
+          Fixed<S+1, Max>::gemm(transa, transb, s, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+        else if (transa)
+          gemm_t<S>(transb, m, n, alpha, A, lda, B, ldb, beta, C, ldc);
+        else
+          gemm_n<S>(transb, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+      }
+
+      static void
+      gemv(bool transa, size_t s, size_t n, double alpha, const double *A, size_t lda,
+           const double *x, size_t incx, double beta, double *y, size_t incy)
+      {
+        if (s != S)
+          Fixed<S+1, Max>::gemv(transa, s, n, alpha, A, lda, x, incx, beta, y, incy);
+        else if (transa)
+          gemv_t<S>(n, alpha, A, lda, x, incx, beta, y, incy);
+        else
+          gemv_n<S>(n, alpha, A, lda, x, incx, beta, y, incy);
+      }
+
+      static void
+      syrk(bool upper, bool trans, size_t s, size_t n, size_t k, double alpha,
+           const double *A, size_t lda, double beta, double *C, size_t ldc)
+      {
+        if (s != S)
+          Fixed<S+1, Max>::syrk(upper, trans, s, n, k, alpha, A, lda, beta, C, ldc);
+        else if (trans)
+          syrk_t<S>(upper, n, alpha, A, lda, beta, C, ldc);
+        else
+          syrk_n<S>(upper, k, alpha, A, lda, beta, C, ldc);
+      }
+    };
+
+    template<size_t Max>
+    struct Fixed<Max, Max>
+    {
+      static void
+      gemm(bool transa, bool transb, size_t s, size_t m, size_t n, size_t k, double alpha,
+           const double *A, size_t lda, const double *B, size_t ldb, double beta, double *C, size_t ldc)
+      {
+        assert(s == Max);
+        if (transa)
+          gemm_t<Max>(transb, m, n, alpha, A, lda, B, ldb, beta, C, ldc);
+        else
+          gemm_n<Max>(transb, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+      }
+
+      static void
+      gemv(bool transa, size_t s, size_t n, double alpha, const double *A, size_t lda,
+           const double *x, size_t incx, double beta, double *y, size_t incy)
+      {
+        assert(s == Max);
+        if (transa)
+          gemv_t<Max>(n, alpha, A, lda, x, incx, beta, y, incy);
+        else
+          gemv_n<Max>(n, alpha, A, lda, x, incx, beta, y, incy);
+      }
+
+      static void
+      syrk(bool upper, bool trans, size_t s, size_t n, size_t k, double alpha,
+           const double *A, size_t lda, double beta, double *C, size_t ldc)
+      {
+        assert(s == Max);
+        if (trans)
+          syrk_t<Max>(upper, n, alpha, A, lda, beta, C, ldc);
+        else
+          syrk_n<Max>(upper, k, alpha, A, lda, beta, C, ldc);
+      }
+    };
+
+    //! C = alpha*op(A)*op(B) + beta*C, where C is m*n and op(A) is m*k, all between 1 and small_kernel_threshold
+    inline void
+    gemm(bool transa, bool transb, size_t m, size_t n, size_t k,
+         double alpha, const double *A, size_t lda, const double *B, size_t ldb,
+         double beta, double *C, size_t ldc)
+    {
+      Fixed<1, small_kernel_threshold>::gemm(transa, transb, transa ? k : m, m, n, k,
+                                             alpha, A, lda, B, ldb, beta, C, ldc);
+    }
+
+    //! y = alpha*op(A)*x + beta*y, where A is m*n, both between 1 and small_kernel_threshold
+    inline void
+    gemv(bool transa, size_t m, size_t n, double alpha, const double *A, size_t lda,
+         const double *x, size_t incx, double beta, double *y, size_t incy)
+    {
+      Fixed<1, small_kernel_threshold>::gemv(transa, m, n, alpha, A, lda, x, incx, beta, y, incy);
+    }
+
+    //! C = alpha*op(A)*op(A)' + beta*C, where C is n*n and op(A) is n*k, both between 1 and small_kernel_threshold
+    /*! Only the triangle of C given by upper is updated. */
+    inline void
+    syrk(bool upper, bool trans, size_t n, size_t k, double alpha,
+         const double *A, size_t lda, double beta, double *C, size_t ldc)
+    {
+      Fixed<1, small_kernel_threshold>::syrk(upper, trans, trans ? k : n, n, k,
+                                             alpha, A, lda, beta, C, ldc);
+    }
+  } // End of namespace small
+} // End of namespace blas
+
+#endif
@@ -38,6 +38,14 @@ VDVEigDecomposition::VDVEigDecomposition(size_t inn) throw (VDVEigException) :
   lda(inn), n(inn), lwork(3*inn-1),
   info(0),   converged(false), V(inn), D(inn)
 {
+  // Allocate the optimal workspace now, so that calculate() does not need to
+  double tmpwork;
+  lapack_int tmplwork = -1;
+  dsyev("V", "U", &n, V.getData(), &lda, D.getData(), &tmpwork, &tmplwork, &info);
+  if (info == 0 && lwork < (lapack_int) tmpwork)
+    lwork = (lapack_int) tmpwork;
+  if (lwork < 1)
+    lwork = 1;
   work = new double[lwork];
 };
 
@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Checks the loop kernels of SmallKernels.hh against BLAS, and compares
+ * their running times for square matrices of size 2 to 64 (beyond
+ * blas::small_kernel_threshold, the kernels are instantiated here only for
+ * the comparison). The timings are used to set blas::small_kernel_threshold.
+ *
+ * An optional argument scales the number of repetitions.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cmath>
+#include <ctime>
+
+#include "BlasBindings.hh"
+
+typedef blas::small::Fixed<1, 64> Kernels;
+
+// Returns the maximum absolute difference between the n*n matrices A and B;
+// if upper_only is true, only the upper triangles are compared
+double
+maxDiff(size_t n, const Matrix &A, const Matrix &B, bool upper_only = false)
+{
+  double d = 0.0;
+  for (size_t j = 0; j < n; j++)
+    for (size_t i = 0; i < (upper_only ? j + 1 : n); i++)
+      d = std::max(d, std::fabs(A(i, j) - B(i, j)));
+  return d;
+}
+
+double
+elapsed(std::clock_t begin)
+{
+  return double (std::clock() - begin) / CLOCKS_PER_SEC;
+}
+
+int
+main(int argc, char **argv)
+{
+  double scale = argc > 1 ? atof(argv[1]) : 1.0;
+  const size_t sizes[] = { 2, 3, 4, 5, 6, 8, 10, 12, 16, 20, 24, 32, 48, 64 };
+  const size_t nsizes = sizeof(sizes)/sizeof(size_t);
+  const double tol = 1e-10;
+  bool ok = true;
+
+  srand(1);
+  std::cout << "  n   gemm NN (small/BLAS)     gemm TN (small/BLAS)     gemv N (small/BLAS)      syrk N (small/BLAS)" << std::endl;
+  for (size_t s = 0; s < nsizes; s++)
+    {
+      blas_int n = sizes[s];
+      size_t nrep = std::max((size_t) 1, (size_t) (scale*2e7/(n*n*n)));
+      size_t nrepv = std::max((size_t) 1, (size_t) (scale*2e7/(n*n)));
+
+      Matrix A(n), B(n), C1(n), C2(n);
+      Vector x(n), y1(n), y2(n);
+      for (blas_int j = 0; j < n; j++)
+        {
+          x(j) = (double) rand() / RAND_MAX - 0.5;
+          for (blas_int i = 0; i < n; i++)
+            {
+              A(i, j) = (double) rand() / RAND_MAX - 0.5;
+              B(i, j) = (double) rand() / RAND_MAX - 0.5;
+            }
+        }
+      double one = 1.0, zero = 0.0, half = 0.5;
+      blas_int inc = 1;
+      double t[8];
+      std::clock_t begin;
+
+      // C = A*B
+      begin = std::clock();
+      for (size_t r = 0; r < nrep; r++)
+        Kernels::gemm(false, false, n, n, n, n, 1.0, A.getData(), n, B.getData(), n, 0.0, C1.getData(), n);
+      t[0] = elapsed(begin);
+      begin = std::clock();
+      for (size_t r = 0; r < nrep; r++)
+        dgemm("N", "N", &n, &n, &n, &one, A.getData(), &n, B.getData(), &n, &zero, C2.getData(), &n);
+      t[1] = elapsed(begin);
+      if (maxDiff(n, C1, C2) > tol)
+        {
+          std::cerr << "gemm NN differs from BLAS for n=" << n << std::endl;
+          ok = false;
+        }
+
+      // C = A'*B + 0.5*C
+      C1 = C2;
+      begin = std::clock();
+      for (size_t r = 0; r < nrep; r++)
+        Kernels::gemm(true, false, n, n, n, n, 1.0, A.getData(), n, B.getData(), n, 0.5, C1.getData(), n);
+      t[2] = elapsed(begin);
+      begin = std::clock();
+      for (size_t r = 0; r < nrep; r++)
+        dgemm("T", "N", &n, &n, &n, &one, A.getData(), &n, B.getData(), &n, &half, C2.getData(), &n);
+      t[3] = elapsed(begin);
+      if (maxDiff(n, C1, C2) > tol)
+        {
+          std::cerr << "gemm TN differs from BLAS for n=" << n << std::endl;
+          ok = false;
+        }
+
+      // y = A*x
+      begin = std::clock();
+      for (size_t r = 0; r < nrepv; r++)
+        Kernels::gemv(false, n, n, 1.0, A.getData(), n, x.getData(), 1, 0.0, y1.getData(), 1);
+      t[4] = elapsed(begin);
+      begin = std::clock();
+      for (size_t r = 0; r < nrepv; r++)
+        dgemv("N", &n, &n, &one, A.getData(), &n, x.getData(), &inc, &zero, y2.getData(), &inc);
+      t[5] = elapsed(begin);
+      for (blas_int i = 0; i < n; i++)
+        if (std::fabs(y1(i) - y2(i)) > tol)
+          {
+            std::cerr << "gemv N differs from BLAS for n=" << n << std::endl;
+            ok = false;
+            break;
+          }
+
+      // C = A*A'
+      begin = std::clock();
+      for (size_t r = 0; r < nrep; r++)
+        Kernels::syrk(true, false, n, n, n, 1.0, A.getData(), n, 0.0, C1.getData(), n);
+      t[6] = elapsed(begin);
+      begin = std::clock();
+      for (size_t r = 0; r < nrep; r++)
+        dsyrk("U", "N", &n, &n, &one, A.getData(), &n, &zero, C2.getData(), &n);
+      t[7] = elapsed(begin);
+      if (maxDiff(n, C1, C2, true) > tol)
+        {
+          std::cerr << "syrk N differs from BLAS for n=" << n << std::endl;
+          ok = false;
+        }
+
+      // Time per call, in nanoseconds
+      std::cout << std::setw(3) << n << std::fixed << std::setprecision(1);
+      for (size_t i = 0; i < 8; i += 2)
+        {
+          size_t nr = (i == 4 ? nrepv : nrep);
+          std::cout << std::setw(11) << 1e9*t[i]/nr << " / " << std::setw(10) << 1e9*t[i+1]/nr;
+        }
+      std::cout << std::endl;
+    }
+
+  // The bindings must give the same results as BLAS around the threshold
+  for (size_t n = blas::small_kernel_threshold - 1; n <= blas::small_kernel_threshold + 1; n++)
+    {
+      Matrix A(n, n+1), At(n+1, n), C1(n), C2(n);
+      for (size_t j = 0; j < n+1; j++)
+        for (size_t i = 0; i < n; i++)
+          At(j, i) = A(i, j) = (double) rand() / RAND_MAX - 0.5;
+      blas::gemm("N", "T", 1.0, A, A, 0.0, C1);
+      blas::syrk("U", "N", 1.0, A, 0.0, C2);
+      if (maxDiff(n, C1, C2, true) > tol)
+        {
+          std::cerr << "blas::gemm and blas::syrk differ for n=" << n << std::endl;
+          ok = false;
+        }
+      blas::gemm("T", "N", 1.0, At, At, 0.0, C1);
+      blas::syrk("U", "T", 1.0, At, 0.0, C2);
+      if (maxDiff(n, C1, C2, true) > tol)
+        {
+          std::cerr << "blas::gemm and blas::syrk differ for transposed matrices and n=" << n << std::endl;
+          ok = false;
+        }
+      Vector x(n+1), y1(n), y2(n);
+      for (size_t i = 0; i < n+1; i++)
+        x(i) = (double) rand() / RAND_MAX - 0.5;
+      blas::gemv("N", 1.0, A, x, 0.0, y1);
+      blas::gemv("T", 1.0, At, x, 0.0, y2);
+      for (size_t i = 0; i < n; i++)
+        if (std::fabs(y1(i) - y2(i)) > tol)
+          {
+            std::cerr << "blas::gemv differs for transposed matrices and n=" << n << std::endl;
+            ok = false;
+            break;
+          }
+    }
+
+  if (!ok)
+    return EXIT_FAILURE;
+  std::cout << "All kernels agree with BLAS" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+
+#include "CycleReduction.hh"
+
+int
+main(int argc, char **argv)
+{
+  size_t n = 3;
+
+  /* Builds A0, A1, A2 = P*diag(r1*r2, -(r1+r2), 1)*P^(-1), whose stable
+     solution is X = P*diag(r1)*P^(-1) */
+  double P_data[] = { 2, 1, 0,
+                      -1, 3, 1,
+                      0.5, 0, 1 };
+  double r1[] = { 0.5, -0.3, 0.8 }, r2[] = { 2, 3, -1.5 };
+  MatrixView P(P_data, n, n, n);
+  mat::transpose(P);
+
+  Matrix Pinv(n), P_lu(n);
+  mat::set_identity(Pinv);
+  P_lu = P;
+  LUSolver LU(n);
+  LU.invMult("N", P_lu, Pinv);
+
+  Matrix A0(n), A1(n), A2(n), X_expected(n), tmp(n);
+  tmp = P;
+  for (size_t j = 0; j < n; j++)
+    for (size_t i = 0; i < n; i++)
+      tmp(i, j) *= r1[j]*r2[j];
+  blas::gemm("N", "N", 1.0, tmp, Pinv, 0.0, A0);
+  tmp = P;
+  for (size_t j = 0; j < n; j++)
+    for (size_t i = 0; i < n; i++)
+      tmp(i, j) *= -(r1[j]+r2[j]);
+  blas::gemm("N", "N", 1.0, tmp, Pinv, 0.0, A1);
+  mat::set_identity(A2);
+  tmp = P;
+  for (size_t j = 0; j < n; j++)
+    for (size_t i = 0; i < n; i++)
+      tmp(i, j) *= r1[j];
+  blas::gemm("N", "N", 1.0, tmp, Pinv, 0.0, X_expected);
+
+  CycleReduction CR(n, 1e-13);
+  Matrix X(n);
+
+  // Solve twice with the same object, to check that the workspace is correctly reused
+  for (int k = 0; k < 2; k++)
+    {
+      CR.compute(A0, A1, A2, X);
+      std::cout << "X =" << std::endl << X << std::endl
+                << "(" << CR.getIterations() << " iterations)" << std::endl;
+      mat::sub(X, X_expected);
+      assert(mat::nrminf(X) < 1e-10);
+    }
+
+  // With roots 2 and -2, no solution is separated from the other one
+  A0.setAll(0.0);
+  for (size_t i = 0; i < n; i++)
+    A0(i, i) = -4.0;
+  A1.setAll(0.0);
+  bool failed = false;
+  try
+    {
+      CR.compute(A0, A1, A2, X);
+    }
+  catch (CycleReduction::CRException &e)
+    {
+      std::cout << e << std::endl;
+      failed = true;
+    }
+  assert(failed);
+
+  return 0;
+}
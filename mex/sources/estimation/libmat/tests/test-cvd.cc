@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cmath>
+
+#include "ConditionalVarianceDecomposition.hh"
+
+int
+main(int argc, char **argv)
+{
+  const size_t n = 4, nshocks = 3;
+
+  double T_data[] = { 0.5, 0.1, 0, 0.2,
+                      0, 0.9, 0.3, 0,
+                      -0.2, 0, 0.7, 0.1,
+                      0.1, 0.4, 0, -0.6 };
+  double B_data[] = { 1, 0, 0.5, 0,
+                      0, 2, 0, 0.3,
+                      0.1, 0, 0, 1 };
+  MatrixView T(T_data, n, n, n), B(B_data, n, nshocks, n);
+
+  std::vector<size_t> steps, rows;
+  steps.push_back(10);
+  steps.push_back(1);
+  steps.push_back(4);
+  steps.push_back(4);
+  rows.push_back(3);
+  rows.push_back(0);
+  rows.push_back(2);
+  const size_t nsteps = steps.size(), nrows = rows.size();
+
+  // Brute force: V_h = T*V_{h-1}*T' + B(:,k)*B(:,k)' for each shock
+  Matrix expected(nrows, nshocks*nsteps), V(n), V_new(n), tmp(n), bb(n);
+  for (size_t k = 0; k < nshocks; k++)
+    {
+      for (size_t j = 0; j < n; j++)
+        for (size_t i = 0; i < n; i++)
+          bb(i, j) = B(i, k)*B(j, k);
+      V.setAll(0.0);
+      for (size_t h = 1; h <= 10; h++)
+        {
+          blas::gemm("N", "N", 1.0, T, V, 0.0, tmp);
+          blas::gemm("N", "T", 1.0, tmp, T, 0.0, V_new);
+          V = V_new;
+          mat::add(V, bb);
+          for (size_t s = 0; s < nsteps; s++)
+            if (steps[s] == h)
+              for (size_t r = 0; r < nrows; r++)
+                expected(r, k*nsteps+s) = V(rows[r], rows[r]);
+        }
+    }
+  for (size_t s = 0; s < nsteps; s++)
+    for (size_t r = 0; r < nrows; r++)
+      {
+        double sum = 0.0;
+        for (size_t k = 0; k < nshocks; k++)
+          sum += expected(r, k*nsteps+s);
+        for (size_t k = 0; k < nshocks; k++)
+          expected(r, k*nsteps+s) /= sum;
+      }
+
+  ConditionalVarianceDecomposition CVD(n, nshocks, steps, rows);
+  Matrix decomp(nrows, nshocks*nsteps), variance(nrows, nshocks*nsteps);
+  MatrixView variance_view(variance, 0, 0, nrows, nshocks*nsteps);
+
+  // Compute twice with the same object, to check that the workspace is correctly reused
+  for (int i = 0; i < 2; i++)
+    {
+      CVD.compute(T, B, decomp, &variance_view);
+      std::cout << "decomp =" << std::endl << decomp << std::endl;
+      mat::sub(decomp, expected);
+      assert(mat::nrminf(decomp) < 1e-12);
+    }
+
+  // At horizon 1, the conditional variance of x(0) is diag(B*B')
+  for (size_t k = 0; k < nshocks; k++)
+    assert(std::fabs(variance(1, k*nsteps+1) - B(0, k)*B(0, k)) < 1e-14);
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cstdlib>
+
+#include "DiscLyapFast.hh"
+
+// Fills G with a random matrix whose diagonal is rho, and V with a random positive semidefinite matrix
+void
+draw(size_t n, double rho, Matrix &G, Matrix &V)
+{
+  Matrix R(n, 2);
+  for (size_t j = 0; j < n; j++)
+    {
+      for (size_t i = 0; i < n; i++)
+        G(i, j) = (i == j ? rho : 0.2*((double) rand() / RAND_MAX - 0.5)/n);
+      R(j, 0) = (double) rand() / RAND_MAX - 0.5;
+      R(j, 1) = (double) rand() / RAND_MAX - 0.5;
+    }
+  blas::gemm("N", "T", 1.0, R, R, 0.0, V);
+}
+
+// Returns the largest absolute element of the residual G*X*G'+V-X
+double
+residual(const Matrix &G, const Matrix &V, const Matrix &X)
+{
+  size_t n = X.getRows();
+  Matrix XGt(n), Res(V);
+  blas::gemm("N", "T", 1.0, X, G, 0.0, XGt);
+  blas::gemm("N", "N", 1.0, G, XGt, 1.0, Res);
+  mat::sub(Res, X);
+  return mat::nrminf(Res);
+}
+
+int
+main(int argc, char **argv)
+{
+  const size_t n = 6;
+  const double fp_tol = 1e-12;
+  Matrix G(n), V(n), X(n), Xcold(n);
+  DiscLyapFast cold(n), warm(n);
+
+  srand(1);
+  for (size_t k = 0; k < 2; k++)
+    {
+      // Moderately persistent (the fixed point iterations converge) and nearly unit root (fallback to doubling)
+      double rho = (k == 0 ? 0.5 : 0.97);
+      draw(n, rho, G, V);
+      warm.reset();
+      warm.solve_lyap_warm(G, V, X, fp_tol);
+      for (int draws = 0; draws < 5; draws++)
+        {
+          // Small perturbation of the parameters, as between two MCMC draws
+          for (size_t i = 0; i < n; i++)
+            G(i, i) = rho + 1e-4*((double) rand() / RAND_MAX - 0.5);
+          cold.solve_lyap(G, V, Xcold);
+          warm.solve_lyap_warm(G, V, X, fp_tol, 1e-16, 300, 1);
+
+          mat::sub(Xcold, X);
+          double diff = mat::nrminf(Xcold), res = residual(G, V, X);
+          std::cout << "rho=" << rho << " draw " << draws << ": difference with the doubling solution="
+                    << diff << ", residual=" << res << std::endl;
+          assert(res < 1e-9);
+          assert(diff < 1e-6);
+        }
+    }
+}
@@ -18,6 +18,7 @@
  */
 
 #include <string>
+#include <cstring>
 #include <vector>
 #include <algorithm>
 #include <functional>
@@ -28,6 +29,7 @@
 #include "RandomWalkMetropolisHastings.hh"
 
 #include <dynmex.h>
+#include <instrumentation.hh>
 #if defined MATLAB_MEX_FILE
 # include "mat.h"
 #else   //  OCTAVE_MEX_FILE e.t.c.
@@ -115,18 +117,130 @@ fillEstParamsInfo(const mxArray *estim_params_info, EstimatedParameter::pType ty
     }
 }
 
+
+/**
+ * Objects and state of a Metropolis-Hastings chain (mh-block). Each chain owns
+ * its posterior density evaluator, its workspaces and its random number
+ * generator, so that the chains can be simulated in parallel and give the
+ * same draws whatever the number of threads.
+ */
+struct MHChain
+{
+  size_t block; // 1-based number of the chain
+  LogPosteriorDensity *lpd;
+  RandomWalkMetropolisHastings *rwmh;
+  Proposal *pdd;
+  Vector steadyState, deepParams, startParams;
+  Matrix Q, H;
+  mxArray *mxMhLogPostDensPtr, *mxMhParamDrawsPtr; // draws of the current file
+  double *mhLogPostDensData, *mhParamDrawsData;
+  size_t currInitSizeArray, irun, j;
+  double sux, jsux;
+  bool openOldFile;
+
+  MHChain(size_t block_arg, size_t npar, LogPosteriorDensity *lpd_arg, RandomWalkMetropolisHastings *rwmh_arg, Proposal *pdd_arg,
+          const VectorView &steadyState_arg, const VectorView &deepParams_arg, const MatrixView &Q_arg, const Matrix &H_arg) :
+    block(block_arg), lpd(lpd_arg), rwmh(rwmh_arg), pdd(pdd_arg),
+    steadyState(steadyState_arg.getSize()), deepParams(deepParams_arg.getSize()), startParams(npar),
+    Q(Q_arg.getRows(), Q_arg.getCols()), H(H_arg), mxMhLogPostDensPtr(NULL), mxMhParamDrawsPtr(NULL),
+    mhLogPostDensData(NULL), mhParamDrawsData(NULL), currInitSizeArray(0), irun(0), j(0), sux(0), jsux(0),
+    openOldFile(false)
+  {
+    steadyState = steadyState_arg;
+    deepParams = deepParams_arg;
+    Q = Q_arg;
+  }
+};
+
+/**
+ * Simulates the draws of the current file of a chain. Since this is called
+ * inside a parallel region, it does not use the mx API and returns exceptions
+ * as an error code and a message.
+ */
+int
+runMHChain(MHChain &chain, const MatrixConstView &data, size_t presampleStart, size_t npar,
+           EstimatedParametersDescription &epd, std::string &errMsg)
+{
+  std::ostringstream ssErrMsg;
+  VectorView steadyState(chain.steadyState, 0, chain.steadyState.getSize());
+  VectorView deepParams(chain.deepParams, 0, chain.deepParams.getSize());
+  MatrixView Q(chain.Q, 0, 0, chain.Q.getRows(), chain.Q.getCols());
+  VectorView mhLogPostDens(chain.mhLogPostDensData, chain.currInitSizeArray, (size_t) 1);
+  MatrixView mhParamDraws(chain.mhParamDrawsData, chain.currInitSizeArray, npar, chain.currInitSizeArray);
+  try
+    {
+      chain.jsux = chain.rwmh->compute(mhLogPostDens, mhParamDraws, steadyState, chain.startParams, deepParams, data, Q, chain.H,
+                                       presampleStart, chain.irun, chain.currInitSizeArray, *chain.lpd, *chain.pdd, epd);
+      chain.irun = chain.currInitSizeArray;
+      chain.sux += chain.jsux*chain.currInitSizeArray;
+      chain.j += chain.currInitSizeArray; //j=j+1;
+      return 0;
+    }
+  catch (const TSException &tse)
+    {
+      ssErrMsg << " TSException Exception in RandomWalkMH dynamic_dll: " << tse.getMessage() << " \n";
+      errMsg = ssErrMsg.str();
+      return -100;
+    }
+  catch (const DecisionRules::BlanchardKahnException &bke)
+    {
+      ssErrMsg << " Too many Blanchard-Kahn Exceptions in RandomWalkMH : n_fwrd_vars " << bke.n_fwrd_vars
+               << " n_explosive_eigenvals " << bke.n_explosive_eigenvals << " \n";
+      errMsg = ssErrMsg.str();
+      return -90;
+    }
+  catch (const GeneralizedSchurDecomposition::GSDException &gsde)
+    {
+      ssErrMsg << " GeneralizedSchurDecomposition Exception in RandomWalkMH: info " << gsde.info << ", n " << gsde.n << "  \n";
+      errMsg = ssErrMsg.str();
+      return -80;
+    }
+  catch (const LUSolver::LUException &lue)
+    {
+      ssErrMsg << " LU Exception in RandomWalkMH : info " << lue.info << " \n";
+      errMsg = ssErrMsg.str();
+      return -70;
+    }
+  catch (const VDVEigDecomposition::VDVEigException &vdve)
+    {
+      ssErrMsg << " VDV Eig Exception in RandomWalkMH : " << vdve.message << " ,  info: " << vdve.info << "\n";
+      errMsg = ssErrMsg.str();
+      return -60;
+    }
+  catch (const DiscLyapFast::DLPException &dlpe)
+    {
+      ssErrMsg << " Lyapunov solver Exception in RandomWalkMH : " << dlpe.message << " ,  info: " << dlpe.info << "\n";
+      errMsg = ssErrMsg.str();
+      return -50;
+    }
+  catch (const std::runtime_error &re)
+    {
+      ssErrMsg << " Runtime Error Exception in RandomWalkMH: " << re.what() << " \n";
+      errMsg = ssErrMsg.str();
+      return -3;
+    }
+  catch (const std::exception &e)
+    {
+      ssErrMsg << " Standard System Exception in RandomWalkMH: " << e.what() << " \n";
+      errMsg = ssErrMsg.str();
+      return -2;
+    }
+  catch (...)
+    {
+      errMsg = " Unknown unhandled Exception in RandomWalkMH! \n";
+      return -1000;
+    }
+}
+
 int
-sampleMHMC(LogPosteriorDensity &lpd, RandomWalkMetropolisHastings &rwmh,
-           VectorView &steadyState, VectorConstView &estParams, VectorView &deepParams, const MatrixConstView &data,
-           MatrixView &Q, Matrix &H, size_t presampleStart, const VectorConstView &nruns,
-           size_t fblock, size_t nBlocks, Proposal pdd, EstimatedParametersDescription &epd,
-           const std::string &resultsFileStem, size_t console_mode, size_t load_mh_file)
+sampleMHMC(std::vector<MHChain> &chains, const MatrixConstView &data, size_t presampleStart, size_t npar,
+           const VectorConstView &nruns, size_t fblock, size_t nBlocks, EstimatedParametersDescription &epd,
+           const std::string &resultsFileStem, size_t console_mode, size_t load_mh_file, int number_of_threads)
 {
   enum {iMin, iMax};
   int iret = 0; // return value
-  std::vector<size_t> OpenOldFile(nBlocks, 0);
-  size_t jloop = 0, irun, j; // counters
-  double dsum, dmax, dmin, sux = 0, jsux = 0;
+  size_t b, irun = 0; // counters
+  double dsum, dmax, dmin;
   std::string mhFName;
   std::stringstream ssFName;
 #if defined MATLAB_MEX_FILE
@@ -145,7 +259,9 @@ sampleMHMC(LogPosteriorDensity &lpd, RandomWalkMetropolisHastings &rwmh,
   int matfStatus;
 #endif
   FILE *fidlog;  // log file
-  size_t npar = estParams.getSize();
+  std::vector<MHChain *> running; // chains simulated in the current round
+  std::vector<int> errCodes;
+  std::vector<std::string> errMsgs;
   Matrix MinMax(npar, 2);
 
   const mxArray *InitSizeArrayPtr = mexGetVariablePtr("caller", "InitSizeArray");
@@ -181,7 +297,6 @@ sampleMHMC(LogPosteriorDensity &lpd, RandomWalkMetropolisHastings &rwmh,
 
   const mxArray *blockStartParamsPtr = mexGetVariable("caller", "ix2");
   MatrixView blockStartParamsMxVw(mxGetPr(blockStartParamsPtr), nBlocks, npar, nBlocks);
-  Vector startParams(npar);
 
   const mxArray *mxFirstLogLikPtr = mexGetVariable("caller", "ilogpo2");
   VectorView FirstLogLiK(mxGetPr(mxFirstLogLikPtr), nBlocks, 1);
@@ -208,10 +323,6 @@ sampleMHMC(LogPosteriorDensity &lpd, RandomWalkMetropolisHastings &rwmh,
   mxArray *mxLastLogLikPtr = mxGetField(record, 0, "LastLogLiK");
   VectorView LastLogLiK(mxGetPr(mxLastLogLikPtr), nBlocks, 1);
 
-  mxArray *mxMhLogPostDensPtr = 0;
-  mxArray *mxMhParamDrawsPtr = 0;
-  size_t currInitSizeArray = 0;
-
 #if defined MATLAB_MEX_FILE
   // Waitbar
   mxArray *waitBarRhs[3], *waitBarLhs[1];
@@ -233,12 +344,14 @@ sampleMHMC(LogPosteriorDensity &lpd, RandomWalkMetropolisHastings &rwmh,
     }
 #endif
 
-  for (size_t b = fblock; b <= nBlocks; ++b)
+
+  // Initial state of the chains
+  for (b = fblock; b <= nBlocks; ++b)
     {
-      jloop = jloop+1;
+      MHChain &chain = chains[b-fblock];
 
 #if defined MATLAB_MEX_FILE
-      if ((load_mh_file != 0)  && (fline(b) > 1) && OpenOldFile[b])
+      if ((load_mh_file != 0)  && (fline(b) > 1) && chain.openOldFile)
         {
           //  load(['./' MhDirectoryName '/' ModelName '_mh' int2str(NewFile(b)) '_blck' int2str(b) '.mat'])
           ssFName.clear();
@@ -255,45 +368,33 @@ sampleMHMC(LogPosteriorDensity &lpd, RandomWalkMetropolisHastings &rwmh,
             }
           else
             {
-              currInitSizeArray = (size_t) InitSizeArray(b-1);
-              mxMhParamDrawsPtr = matGetVariable(drawmat, "x2");
-              mxMhLogPostDensPtr = matGetVariable(drawmat, "logpo2");
+              chain.currInitSizeArray = (size_t) InitSizeArray(b-1);
+              chain.mxMhParamDrawsPtr = matGetVariable(drawmat, "x2");
+              chain.mxMhLogPostDensPtr = matGetVariable(drawmat, "logpo2");
               matClose(drawmat);
-              OpenOldFile[b] = 1;
+              chain.openOldFile = true;
             }
         } // end if
-      if (console_mode == 0)
-        {
-          ssbarTitle.clear();
-          ssbarTitle.str("");
-          ssbarTitle << "Please wait... Metropolis-Hastings  " << b << "/" << nBlocks << "  ...";
-          barTitle = ssbarTitle.str();
-          waitBarRhs[2] = mxCreateString(barTitle.c_str());
-          //strcpy( *mxGetPr(waitBarRhs[1]), mhFName.c_str());
-          *mxGetPr(waitBarRhs[0]) = (double) 0.0;
-          mexCallMATLAB(0, NULL, 3, waitBarRhs, "waitbar");
-          mxDestroyArray(waitBarRhs[2]);
-        }
 #else //if defined OCTAVE_MEX_FILE
-      if ((load_mh_file != 0)  && (fline(b) > 1) && OpenOldFile[b])
+      if ((load_mh_file != 0)  && (fline(b) > 1) && chain.openOldFile)
         {
           //  load(['./' MhDirectoryName '/' ModelName '_mh' int2str(NewFile(b)) '_blck' int2str(b) '.mat'])
-          if ((currInitSizeArray != (size_t) InitSizeArray(b-1)) &&   OpenOldFile[b] != 1)
+          if ((chain.currInitSizeArray != (size_t) InitSizeArray(b-1)) &&   !chain.openOldFile)
             {
               // new or different size result arrays/matrices
-              currInitSizeArray = (size_t) InitSizeArray(b-1);
-              if (mxMhLogPostDensPtr)
-                mxDestroyArray(mxMhLogPostDensPtr);                                                                                                                                                                // log post density array
-              mxMhLogPostDensPtr = mxCreateDoubleMatrix(currInitSizeArray, 1, mxREAL);
-              if (mxMhLogPostDensPtr == NULL)
+              chain.currInitSizeArray = (size_t) InitSizeArray(b-1);
+              if (chain.mxMhLogPostDensPtr)
+                mxDestroyArray(chain.mxMhLogPostDensPtr);                                                                                                                                                                // log post density array
+              chain.mxMhLogPostDensPtr = mxCreateDoubleMatrix(chain.currInitSizeArray, 1, mxREAL);
+              if (chain.mxMhLogPostDensPtr == NULL)
                 {
                   mexPrintf("Metropolis-Hastings mxMhLogPostDensPtr Initialisation failed!\n");
                   return (-1);
                 }
-              if (mxMhParamDrawsPtr)
-                mxDestroyArray(mxMhParamDrawsPtr);                                                                                                                                                             // accepted MCMC MH draws
-              mxMhParamDrawsPtr =  mxCreateDoubleMatrix(currInitSizeArray, npar,  mxREAL);
-              if (mxMhParamDrawsPtr == NULL)
+              if (chain.mxMhParamDrawsPtr)
+                mxDestroyArray(chain.mxMhParamDrawsPtr);                                                                                                                                                             // accepted MCMC MH draws
+              chain.mxMhParamDrawsPtr =  mxCreateDoubleMatrix(chain.currInitSizeArray, npar,  mxREAL);
+              if (chain.mxMhParamDrawsPtr == NULL)
                 {
                   mexPrintf("Metropolis-Hastings mxMhParamDrawsPtr Initialisation failed!\n");
                   return (-1);
@@ -328,7 +429,7 @@ sampleMHMC(LogPosteriorDensity &lpd, RandomWalkMetropolisHastings &rwmh,
                   // GetVariable(drawmat, "x2");
                   edge[0] = matvar->dims[0];
                   edge[1] = matvar->dims[1];
-                  err = Mat_VarReadData(drawmat, matvar, mxGetPr(mxMhParamDrawsPtr), start, stride, edge);
+                  err = Mat_VarReadData(drawmat, matvar, mxGetPr(chain.mxMhParamDrawsPtr), start, stride, edge);
                   if (err)
                     {
                       fline(b) = 1;
@@ -350,7 +451,7 @@ sampleMHMC(LogPosteriorDensity &lpd, RandomWalkMetropolisHastings &rwmh,
                   // GetVariable(drawmat, "x2");
                   edge[0] = matvar->dims[0];
                   edge[1] = matvar->dims[1];
-                  err = Mat_VarReadData(drawmat, matvar, mxGetPr(mxMhLogPostDensPtr), start, stride, edge);
+                  err = Mat_VarReadData(drawmat, matvar, mxGetPr(chain.mxMhLogPostDensPtr), start, stride, edge);
                   if (err)
                     {
                       fline(b) = 1;
@@ -360,119 +461,88 @@ sampleMHMC(LogPosteriorDensity &lpd, RandomWalkMetropolisHastings &rwmh,
                   Mat_VarFree(matvar);
                 }
               Mat_Close(drawmat);
-              OpenOldFile[b] = 1;
+              chain.openOldFile = true;
             }
         } // end if
 
 #endif
 
-      VectorView LastParametersRow = mat::get_row(LastParameters, b-1);
+      chain.irun = (size_t) fline(b-1);
+    }
 
-      sux = 0.0;
-      jsux = 0;
-      irun = (size_t) fline(b-1);
-      j = 0; //1;
-      while (j < nruns(b-1))
+  /* The chains are simulated by rounds: every round adds a file to each
+     unfinished chain. The mx API is not thread-safe, so the draws arrays are
+     allocated before, and the files written after, the parallel part */
+  while (true)
+    {
+      running.clear();
+      for (b = fblock; b <= nBlocks; ++b)
         {
-          if ((currInitSizeArray != (size_t) InitSizeArray(b-1)) &&   OpenOldFile[b] != 1)
+          MHChain &chain = chains[b-fblock];
+          if (chain.j >= nruns(b-1))
+            continue;
+          if ((chain.currInitSizeArray != (size_t) InitSizeArray(b-1)) && !chain.openOldFile)
             {
               // new or different size result arrays/matrices
-              currInitSizeArray = (size_t) InitSizeArray(b-1);
-              if (mxMhLogPostDensPtr)
-                mxDestroyArray(mxMhLogPostDensPtr);                                                                                                                                                                // log post density array
-              mxMhLogPostDensPtr = mxCreateDoubleMatrix(currInitSizeArray, 1, mxREAL);
-              if (mxMhLogPostDensPtr == NULL)
+              chain.currInitSizeArray = (size_t) InitSizeArray(b-1);
+              if (chain.mxMhLogPostDensPtr)
+                mxDestroyArray(chain.mxMhLogPostDensPtr);                                                                                                                                                                // log post density array
+              chain.mxMhLogPostDensPtr = mxCreateDoubleMatrix(chain.currInitSizeArray, 1, mxREAL);
+              if (chain.mxMhLogPostDensPtr == NULL)
                 {
                   mexPrintf("Metropolis-Hastings mxMhLogPostDensPtr Initialisation failed!\n");
                   return (-1);
                 }
-              if (mxMhParamDrawsPtr)
-                mxDestroyArray(mxMhParamDrawsPtr);                                                                                                                                                             // accepted MCMC MH draws
-              mxMhParamDrawsPtr =  mxCreateDoubleMatrix(currInitSizeArray, npar,  mxREAL);
-              if (mxMhParamDrawsPtr == NULL)
+              if (chain.mxMhParamDrawsPtr)
+                mxDestroyArray(chain.mxMhParamDrawsPtr);                                                                                                                                                             // accepted MCMC MH draws
+              chain.mxMhParamDrawsPtr =  mxCreateDoubleMatrix(chain.currInitSizeArray, npar,  mxREAL);
+              if (chain.mxMhParamDrawsPtr == NULL)
                 {
                   mexPrintf("Metropolis-Hastings mxMhParamDrawsPtr Initialisation failed!\n");
                   return (-1);
                 }
             }
-          startParams = LastParametersRow;
-          VectorView mhLogPostDens(mxGetPr(mxMhLogPostDensPtr), currInitSizeArray, (size_t) 1);
-          MatrixView mhParamDraws(mxGetPr(mxMhParamDrawsPtr), currInitSizeArray, npar, currInitSizeArray);
-          try
-            {
-              jsux = rwmh.compute(mhLogPostDens, mhParamDraws, steadyState, startParams, deepParams, data, Q, H,
-                                  presampleStart, irun, currInitSizeArray, lpd, pdd, epd);
-              irun = currInitSizeArray;
-              sux += jsux*currInitSizeArray;
-              j += currInitSizeArray; //j=j+1;
-            }
-          catch (const TSException &tse)
-            {
-              iret = -100;
-              mexPrintf(" TSException Exception in RandomWalkMH dynamic_dll: %s \n", (tse.getMessage()).c_str());
-              goto cleanup;
-            }
-          catch (const DecisionRules::BlanchardKahnException &bke)
-            {
-              iret = -90;
-              mexPrintf(" Too many Blanchard-Kahn Exceptions in RandomWalkMH : n_fwrd_vars %d n_explosive_eigenvals %d \n", bke.n_fwrd_vars, bke.n_explosive_eigenvals);
-              goto cleanup;
-            }
-          catch (const GeneralizedSchurDecomposition::GSDException &gsde)
-            {
-              iret = -80;
-              mexPrintf(" GeneralizedSchurDecomposition Exception in RandomWalkMH: info %d, n %d  \n", gsde.info, gsde.n);
-              goto cleanup;
-            }
-          catch (const LUSolver::LUException &lue)
-            {
-              iret = -70;
-              mexPrintf(" LU Exception in RandomWalkMH : info %d \n", lue.info);
-              goto cleanup;
-            }
-          catch (const VDVEigDecomposition::VDVEigException &vdve)
-            {
-              iret = -60;
-              mexPrintf(" VDV Eig Exception in RandomWalkMH : %s ,  info: %d\n", vdve.message.c_str(), vdve.info);
-              goto cleanup;
-            }
-          catch (const DiscLyapFast::DLPException &dlpe)
-            {
-              iret = -50;
-              mexPrintf(" Lyapunov solver Exception in RandomWalkMH : %s ,  info: %d\n", dlpe.message.c_str(), dlpe.info);
-              goto cleanup;
-            }
-          catch (const std::runtime_error &re)
-            {
-              iret = -3;
-              mexPrintf(" Runtime Error Exception in RandomWalkMH: %s \n", re.what());
-              goto cleanup;
-            }
-          catch (const std::exception &e)
-            {
-              iret = -2;
-              mexPrintf(" Standard System Exception in RandomWalkMH: %s \n", e.what());
-              goto cleanup;
-            }
-          catch (...)
+          chain.mhLogPostDensData = mxGetPr(chain.mxMhLogPostDensPtr);
+          chain.mhParamDrawsData = mxGetPr(chain.mxMhParamDrawsPtr);
+          chain.startParams = mat::get_row(LastParameters, b-1);
+          running.push_back(&chain);
+        }
+      if (running.empty())
+        break;
+
+      errCodes.assign(running.size(), 0);
+      errMsgs.assign(running.size(), std::string());
+#ifdef USE_OMP
+# pragma omp parallel for num_threads(number_of_threads) schedule(dynamic)
+#endif
+      for (int k = 0; k < (int) running.size(); ++k)
+        errCodes[k] = runMHChain(*running[k], data, presampleStart, npar, epd, errMsgs[k]);
+
+      for (size_t k = 0; k < running.size(); ++k)
+        {
+          MHChain &chain = *running[k];
+          b = chain.block;
+          if (errCodes[k] != 0)
             {
-              iret = -1000;
-              mexPrintf(" Unknown unhandled Exception in RandomWalkMH! %s \n");
+              iret = errCodes[k];
+              mexPrintf("%s", errMsgs[k].c_str());
               goto cleanup;
             }
+          VectorView mhLogPostDens(chain.mhLogPostDensData, chain.currInitSizeArray, (size_t) 1);
+          MatrixView mhParamDraws(chain.mhParamDrawsData, chain.currInitSizeArray, npar, chain.currInitSizeArray);
 
 #if defined MATLAB_MEX_FILE
           if (console_mode)
-            mexPrintf("   MH: Computing Metropolis-Hastings (chain %d/%d): %3.f \b%% done, acceptance rate: %3.f \b%%\r", b, nBlocks, 100 * j/nruns(b-1), 100 * sux / j);
+            mexPrintf("   MH: Computing Metropolis-Hastings (chain %d/%d): %3.f \b%% done, acceptance rate: %3.f \b%%\r", b, nBlocks, 100 * chain.j/nruns(b-1), 100 * chain.sux / chain.j);
           else
             {
               // Waitbar
               ssbarTitle.clear();
               ssbarTitle.str("");
-              ssbarTitle << "Metropolis-Hastings : " << b << "/" << nBlocks << " Acceptance: " << 100 * sux/j << "%";
+              ssbarTitle << "Metropolis-Hastings : " << b << "/" << nBlocks << " Acceptance: " << 100 * chain.sux/chain.j << "%";
               barTitle = ssbarTitle.str();
               waitBarRhs[2] = mxCreateString(barTitle.c_str());
-              *mxGetPr(waitBarRhs[0]) = j / nruns(b-1);
+              *mxGetPr(waitBarRhs[0]) = chain.j / nruns(b-1);
               mexCallMATLAB(0, NULL, 3, waitBarRhs, "waitbar");
               mxDestroyArray(waitBarRhs[2]);
 
@@ -490,13 +560,13 @@ sampleMHMC(LogPosteriorDensity &lpd, RandomWalkMetropolisHastings &rwmh,
               mexPrintf("Error in MH: Can not open draws Mat file for writing:  %s \n", mhFName.c_str());
               exit(1);
             }
-          matfStatus = matPutVariable(drawmat, "x2", mxMhParamDrawsPtr);
+          matfStatus = matPutVariable(drawmat, "x2", chain.mxMhParamDrawsPtr);
           if (matfStatus)
             {
               mexPrintf("Error in MH: Can not use draws Mat file for writing:  %s \n", mhFName.c_str());
               exit(1);
             }
-          matfStatus = matPutVariable(drawmat, "logpo2", mxMhLogPostDensPtr);
+          matfStatus = matPutVariable(drawmat, "logpo2", chain.mxMhLogPostDensPtr);
           if (matfStatus)
             {
               mexPrintf("Error in MH: Can not usee draws Mat file for writing:  %s \n", mhFName.c_str());
@@ -505,7 +575,7 @@ sampleMHMC(LogPosteriorDensity &lpd, RandomWalkMetropolisHastings &rwmh,
           matClose(drawmat);
 #else
 
-          printf("   MH: Computing Metropolis-Hastings (chain %ld/%ld): %3.f \b%% done, acceptance rate: %3.f \b%%\r", b, nBlocks, 100 * j/nruns(b-1), 100 * sux / j);
+          printf("   MH: Computing Metropolis-Hastings (chain %ld/%ld): %3.f \b%% done, acceptance rate: %3.f \b%%\r", b, nBlocks, 100 * chain.j/nruns(b-1), 100 * chain.sux / chain.j);
           // % Now I save the simulations
           // save draw  2 mat file ([MhDirectoryName '/' ModelName '_mh' int2str(NewFile(b)) '_blck' int2str(b) '.mat'],'x2','logpo2');
           ssFName.clear();
@@ -519,9 +589,9 @@ sampleMHMC(LogPosteriorDensity &lpd, RandomWalkMetropolisHastings &rwmh,
               mexPrintf("Error in MH: Can not open draws Mat file for writing:  %s \n", mhFName.c_str());
               exit(1);
             }
-          dims[0] = currInitSizeArray;
+          dims[0] = chain.currInitSizeArray;
           dims[1] = npar;
-          matvar = Mat_VarCreate("x2", MAT_C_DOUBLE, MAT_T_DOUBLE, 2, dims, mxGetPr(mxMhParamDrawsPtr), 0);
+          matvar = Mat_VarCreate("x2", MAT_C_DOUBLE, MAT_T_DOUBLE, 2, dims, mxGetPr(chain.mxMhParamDrawsPtr), 0);
           matfStatus = Mat_VarWrite(drawmat, matvar, compression);
           Mat_VarFree(matvar);
           if (matfStatus)
@@ -529,9 +599,9 @@ sampleMHMC(LogPosteriorDensity &lpd, RandomWalkMetropolisHastings &rwmh,
               mexPrintf("Error in MH: Can not use draws Mat file for writing:  %s \n", mhFName.c_str());
               exit(1);
             }
-          //matfStatus = matPutVariable(drawmat, "logpo2", mxMhLogPostDensPtr);
+          //matfStatus = matPutVariable(drawmat, "logpo2", chain.mxMhLogPostDensPtr);
           dims[1] = 1;
-          matvar = Mat_VarCreate("logpo2", MAT_C_DOUBLE, MAT_T_DOUBLE, 2, dims, mxGetPr(mxMhLogPostDensPtr), 0);
+          matvar = Mat_VarCreate("logpo2", MAT_C_DOUBLE, MAT_T_DOUBLE, 2, dims, mxGetPr(chain.mxMhLogPostDensPtr), 0);
           matfStatus = Mat_VarWrite(drawmat, matvar, compression);
           Mat_VarFree(matvar);
           if (matfStatus)
@@ -550,8 +620,8 @@ sampleMHMC(LogPosteriorDensity &lpd, RandomWalkMetropolisHastings &rwmh,
           fprintf(fidlog, "\n");
           fprintf(fidlog, "%% Mh%dBlck%lu ( %s %s )\n", (int) NewFileVw(b-1), b, __DATE__, __TIME__);
           fprintf(fidlog, " \n");
-          fprintf(fidlog, "  Number of simulations.: %lu \n", currInitSizeArray); // (length(logpo2)) ');
-          fprintf(fidlog, "  Acceptation rate......: %f \n", jsux);
+          fprintf(fidlog, "  Number of simulations.: %lu \n", chain.currInitSizeArray); // (length(logpo2)) ');
+          fprintf(fidlog, "  Acceptation rate......: %f \n", chain.jsux);
           fprintf(fidlog, "  Posterior mean........:\n");
           for (size_t i = 0; i < npar; ++i)
             {
@@ -572,22 +642,25 @@ sampleMHMC(LogPosteriorDensity &lpd, RandomWalkMetropolisHastings &rwmh,
           fprintf(fidlog, " \n");
           fclose(fidlog);
 
-          jsux = 0;
-          LastParametersRow = mat::get_row(mhParamDraws, currInitSizeArray-1); //x2(end,:);
-          LastLogLiK(b-1) = mhLogPostDens(currInitSizeArray-1); //logpo2(end);
-          InitSizeArray(b-1) = std::min((size_t) nruns(b-1)-j, MAX_nruns);
+          chain.jsux = 0;
+          mat::get_row(LastParameters, b-1) = mat::get_row(mhParamDraws, chain.currInitSizeArray-1); //x2(end,:);
+          LastLogLiK(b-1) = mhLogPostDens(chain.currInitSizeArray-1); //logpo2(end);
+          InitSizeArray(b-1) = std::min((size_t) nruns(b-1)-chain.j, MAX_nruns);
           // initialization of next file if necessary
           if (InitSizeArray(b-1))
             {
               NewFileVw(b-1)++; // = NewFile(b-1) + 1;
-              irun = 1;
+              chain.irun = 1;
             } // end
-          //irun++;
-        } // end  while % End of the simulations for one mh-block.
-      //record.
-      AcceptationRates(b-1) = sux/j;
-      OpenOldFile[b] = 0;
-    } // end % End of the loop over the mh-blocks.
+          // the draws file of an interrupted run is only completed once
+          chain.openOldFile = false;
+          //record.
+          if (chain.j >= nruns(b-1))
+            AcceptationRates(b-1) = chain.sux/chain.j;
+        }
+    } // end % End of the simulations of the mh-blocks.
+  if (!chains.empty())
+    irun = chains.back().irun;
 
   if (mexPutVariable("caller", "record_AcceptationRates", AcceptationRatesPtr))
     mexPrintf("MH Warning: due to error record_AcceptationRates is NOT set !! \n");
@@ -606,10 +679,14 @@ sampleMHMC(LogPosteriorDensity &lpd, RandomWalkMetropolisHastings &rwmh,
   mexPrintf("MH Cleanup !! \n");
 
  cleanup:
-  if (mxMhLogPostDensPtr)
-    mxDestroyArray(mxMhLogPostDensPtr);                                                                                      // delete log post density array
-  if (mxMhParamDrawsPtr)
-    mxDestroyArray(mxMhParamDrawsPtr);                                                                                     // delete accepted MCMC MH draws
+  for (b = fblock; b <= nBlocks; ++b)
+    {
+      MHChain &chain = chains[b-fblock];
+      if (chain.mxMhLogPostDensPtr)
+        mxDestroyArray(chain.mxMhLogPostDensPtr);                                                                                      // delete log post density array
+      if (chain.mxMhParamDrawsPtr)
+        mxDestroyArray(chain.mxMhParamDrawsPtr);                                                                                     // delete accepted MCMC MH draws
+    }
 
 #ifdef MATLAB_MEX_FILE
   // Waitbar
@@ -717,25 +794,98 @@ logMCMCposterior(VectorConstView &estParams, const MatrixConstView &data,
   EstimatedParametersDescription epd(estSubsamples, estParamsInfo);
 
   bool noconstant = (bool) *mxGetPr(mxGetField(options_, 0, "noconstant"));
+  bool fast_kalman_filter = (bool) *mxGetPr(mxGetField(options_, 0, "fast_kalman_filter"));
+  bool sqrt_kalman_filter = (bool) *mxGetPr(mxGetField(options_, 0, "sqrt_kalman_filter"));
+  // With the lyapunov=fixed_point option, Pstar is warm-started from its value for the previous draw
+  double lyapunov_fixed_point_tol = 0.0;
+  if (*mxGetPr(mxGetField(options_, 0, "lyapunov_fp")) == 1)
+    lyapunov_fixed_point_tol = *mxGetPr(mxGetField(options_, 0, "lyapunov_fixed_point_tol"));
+
+  int number_of_threads = 1;
+  const mxArray *threads_mx = mxGetField(options_, 0, "threads");
+  if (threads_mx != NULL)
+    threads_mx = mxGetField(threads_mx, 0, "logMHMCMCposterior");
+  if (threads_mx != NULL)
+    number_of_threads = (int) mxGetScalar(threads_mx);
+
+  // Thinning and number of draws by write of the binary draws files
+  size_t dump_thinning = 1, dump_flush_interval = 10000;
+  const mxArray *mh_dump_mx = mxGetField(options_, 0, "mh_dump");
+  if (mh_dump_mx != NULL)
+    {
+      if (mxGetField(mh_dump_mx, 0, "thinning") != NULL)
+        dump_thinning = (size_t) mxGetScalar(mxGetField(mh_dump_mx, 0, "thinning"));
+      if (mxGetField(mh_dump_mx, 0, "flush_interval") != NULL)
+        dump_flush_interval = (size_t) mxGetScalar(mxGetField(mh_dump_mx, 0, "flush_interval"));
+    }
+  if (dump_thinning == 0 || dump_flush_interval == 0)
+    throw LogMHMCMCposteriorMexErrMsgTxtException("Error in logMCMCposterior: options_.mh_dump.thinning and options_.mh_dump.flush_interval must be positive");
 
-  // Allocate LogPosteriorDensity object
-  LogPosteriorDensity lpd(basename, epd, n_endo, n_exo, zeta_fwrd, zeta_back, zeta_mixed, zeta_static,
-                          qz_criterium, varobs, riccati_tol, lyapunov_tol, noconstant);
-
-  // Construct MHMCMC Sampler
-  RandomWalkMetropolisHastings rwmh(estParams.getSize());
-  // Construct GaussianPrior drawDistribution m=0, sd=1
-  GaussianPrior drawGaussDist01(0.0, 1.0, -INFINITY, INFINITY, 0.0, 1.0);
   // get Jscale = diag(bayestopt_.jscale);
-  const Matrix Jscale(n_estParams);
   const VectorConstView vJscale(mxGetPr(mxGetField(bayestopt_, 0, "jscale")), n_estParams, 1);
-  Proposal pdd(vJscale, D);
+
+  // Adaptive proposal (random walk) or randomized blocks (tailored random block sampler)
+  bool adaptive = false, random_blocks = false;
+  size_t adaptation_prior_weight = 100;
+  double new_block_probability = 0.25;
+  const mxArray *sampler_options_mx = mxGetField(options_, 0, "posterior_sampler_options");
+  if (sampler_options_mx != NULL)
+    {
+      const mxArray *method_mx = mxGetField(sampler_options_mx, 0, "posterior_sampling_method");
+      if (method_mx != NULL && mxIsChar(method_mx))
+        {
+          char *method = mxArrayToString(method_mx);
+          random_blocks = !strcmp(method, "tailored_random_block_metropolis_hastings");
+          mxFree(method);
+        }
+      const mxArray *rwmh_mx = mxGetField(sampler_options_mx, 0, "rwmh");
+      if (rwmh_mx != NULL && mxGetField(rwmh_mx, 0, "adaptive") != NULL)
+        adaptive = (bool) mxGetScalar(mxGetField(rwmh_mx, 0, "adaptive"));
+      if (rwmh_mx != NULL && mxGetField(rwmh_mx, 0, "adaptation_prior_weight") != NULL)
+        adaptation_prior_weight = (size_t) mxGetScalar(mxGetField(rwmh_mx, 0, "adaptation_prior_weight"));
+      const mxArray *tarb_mx = mxGetField(sampler_options_mx, 0, "tarb");
+      if (tarb_mx != NULL && mxGetField(tarb_mx, 0, "new_block_probability") != NULL)
+        new_block_probability = mxGetScalar(mxGetField(tarb_mx, 0, "new_block_probability"));
+    }
+  if (new_block_probability < 0 || new_block_probability > 1)
+    throw LogMHMCMCposteriorMexErrMsgTxtException("Error in logMCMCposterior: options_.posterior_sampler_options.tarb.new_block_probability must be between 0 and 1");
+
+  // The chains draw from non-overlapping streams of the same seed
+  int master_seed = 0;
+  const mxArray *random_streams_mx = mxGetField(options_, 0, "DynareRandomStreams");
+  if (random_streams_mx != NULL && mxGetField(random_streams_mx, 0, "seed") != NULL)
+    master_seed = (int) mxGetScalar(mxGetField(random_streams_mx, 0, "seed"));
+
+  /* Allocate the LogPosteriorDensity object, the MHMCMC Sampler and the
+     proposal of each chain. The random stream of the chains only depends on
+     their number, so that their draws do not depend on the number of threads */
+  std::vector<MHChain> chains;
+  for (size_t b = fblock; b <= nBlocks; ++b)
+    {
+      LogPosteriorDensity *lpd = new LogPosteriorDensity(basename, epd, n_endo, n_exo, zeta_fwrd, zeta_back, zeta_mixed, zeta_static,
+                                                         qz_criterium, varobs, riccati_tol, lyapunov_tol, noconstant, fast_kalman_filter, sqrt_kalman_filter,
+                                                         lyapunov_fixed_point_tol);
+      Proposal *pdd = new Proposal(vJscale, D);
+      pdd->seed(master_seed, b-1);
+      if (random_blocks)
+        pdd->setRandomBlocks(new_block_probability);
+      else if (adaptive)
+        pdd->setAdaptive(adaptation_prior_weight);
+      chains.push_back(MHChain(b, n_estParams, lpd, new RandomWalkMetropolisHastings(n_estParams, b, dump_thinning, dump_flush_interval), pdd,
+                               steadyState, deepParams, Q, H));
+    }
 
   //sample MHMCMC draws and get get last line run in the last MH block sub-array
-  int lastMHblockArrayLine = sampleMHMC(lpd, rwmh, steadyState, estParams, deepParams, data, Q, H, presample,
-                                        nMHruns, fblock, nBlocks, pdd, epd, resultsFileStem, console_mode, load_mh_file);
+  int lastMHblockArrayLine = sampleMHMC(chains, data, presample, n_estParams, nMHruns, fblock, nBlocks, epd,
+                                        resultsFileStem, console_mode, load_mh_file, number_of_threads);
 
   // Cleanups
+  for (std::vector<MHChain>::iterator it = chains.begin(); it != chains.end(); it++)
+    {
+      delete it->lpd;
+      delete it->rwmh;
+      delete it->pdd;
+    }
   for (std::vector<EstimatedParameter>::iterator it = estParamsInfo.begin();
        it != estParamsInfo.end(); it++)
     delete it->prior;
@@ -747,6 +897,10 @@ void
 mexFunction(int nlhs, mxArray *plhs[],
             int nrhs, const mxArray *prhs[])
 {
+  if (Instrumentation::mexCommand("logMHMCMCposterior", nlhs, plhs, nrhs, prhs))
+    return;
+  INSTRUMENT_SCOPE("logMHMCMCposterior");
+
   if (nrhs != 10)
     DYN_MEX_FUNC_ERR_MSG_TXT("logposterior: exactly 11 arguments are required.");
   if (nlhs != 2)
@@ -22,12 +22,14 @@
 #include <algorithm>
 #include <functional>
 #include <sstream>
+#include <stdexcept>
 
 #include "Vector.hh"
 #include "Matrix.hh"
 #include "LogPosteriorDensity.hh"
 
 #include <dynmex.h>
+#include <instrumentation.hh>
 
 class LogposteriorMexErrMsgTxtException
 {
@@ -108,7 +110,7 @@ double
 logposterior(VEC1 &estParams, const MatrixConstView &data,
              const mxArray *options_, const mxArray *M_, const mxArray *estim_params_,
              const mxArray *bayestopt_, const mxArray *oo_, VEC2 &steadyState, double *trend_coeff,
-             VectorView &deepParams, Matrix &H, MatrixView &Q)
+             VectorView &deepParams, Matrix &H, MatrixView &Q, Vector *score)
 {
   double loglinear = *mxGetPr(mxGetField(options_, 0, "loglinear"));
   if (loglinear == 1)
@@ -185,15 +187,34 @@ logposterior(VEC1 &estParams, const MatrixConstView &data,
   EstimatedParametersDescription epd(estSubsamples, estParamsInfo);
 
   bool noconstant = (bool) *mxGetPr(mxGetField(options_, 0, "noconstant"));
+  bool fast_kalman_filter = (bool) *mxGetPr(mxGetField(options_, 0, "fast_kalman_filter"));
+  bool sqrt_kalman_filter = (bool) *mxGetPr(mxGetField(options_, 0, "sqrt_kalman_filter"));
+  // With the lyapunov=fixed_point option, Pstar is warm-started from its value for the previous draw
+  double lyapunov_fixed_point_tol = 0.0;
+  if (*mxGetPr(mxGetField(options_, 0, "lyapunov_fp")) == 1)
+    lyapunov_fixed_point_tol = *mxGetPr(mxGetField(options_, 0, "lyapunov_fixed_point_tol"));
+
+  // The estimation subsamples are evaluated in parallel
+  int number_of_threads = 1;
+  const mxArray *threads_mx = mxGetField(options_, 0, "threads");
+  if (threads_mx != NULL)
+    threads_mx = mxGetField(threads_mx, 0, "logposterior");
+  if (threads_mx != NULL)
+    number_of_threads = (int) mxGetScalar(threads_mx);
 
   // Allocate LogPosteriorDensity object
   LogPosteriorDensity lpd(basename, epd, n_endo, n_exo, zeta_fwrd, zeta_back, zeta_mixed, zeta_static,
-                          qz_criterium, varobs, riccati_tol, lyapunov_tol, noconstant);
+                          qz_criterium, varobs, riccati_tol, lyapunov_tol, noconstant, fast_kalman_filter, sqrt_kalman_filter,
+                          lyapunov_fixed_point_tol, number_of_threads);
 
   // Construct arguments of compute() method
 
-  // Compute the posterior
-  double logPD = lpd.compute(steadyState, estParams, deepParams, data, Q, H, presample);
+  // Compute the posterior, and its derivatives if requested
+  double logPD;
+  if (score)
+    logPD = lpd.computeScore(steadyState, estParams, deepParams, data, Q, H, presample, *score);
+  else
+    logPD = lpd.compute(steadyState, estParams, deepParams, data, Q, H, presample);
 
   // Cleanups
   for (std::vector<EstimatedParameter>::iterator it = estParamsInfo.begin();
@@ -207,11 +228,15 @@ void
 mexFunction(int nlhs, mxArray *plhs[],
             int nrhs, const mxArray *prhs[])
 {
+  if (Instrumentation::mexCommand("logposterior", nlhs, plhs, nrhs, prhs))
+    return;
+  INSTRUMENT_SCOPE("logposterior");
+
   if (nrhs != 7)
     DYN_MEX_FUNC_ERR_MSG_TXT("logposterior: exactly 7 input arguments are required.");
 
   if (nlhs > 9)
-    DYN_MEX_FUNC_ERR_MSG_TXT("logposterior returns 8 output arguments at the most.");
+    DYN_MEX_FUNC_ERR_MSG_TXT("logposterior returns 9 output arguments at the most.");
 
   // Check and retrieve the RHS arguments
 
@@ -270,20 +295,38 @@ mexFunction(int nlhs, mxArray *plhs[],
   double *trend_coeff  = mxGetPr(plhs[3]);
   double *info_mx  = mxGetPr(plhs[4]);
 
+  // The 9th output is the gradient of minus the log posterior (analytic_derivation)
+  Vector *score = NULL;
+  if (nlhs > 8)
+    {
+      plhs[8] = mxCreateDoubleMatrix(estParams.getSize(), 1, mxREAL);
+      score = new Vector(estParams.getSize());
+    }
+
   // Compute and return the value
   try
     {
       *lik = logposterior(estParams, data, options_, M_, estim_params_, bayestopt_, oo_,
-                          steadyState, trend_coeff, deepParams, H, Q);
+                          steadyState, trend_coeff, deepParams, H, Q, score);
       *info_mx = 0;
       *exit_flag = 0;
+      if (score)
+        std::copy(score->getData(), score->getData() + score->getSize(), mxGetPr(plhs[8]));
+      delete score;
     }
   catch (LogposteriorMexErrMsgTxtException e)
     {
+      delete score;
       DYN_MEX_FUNC_ERR_MSG_TXT(e.getErrMsg());
     }
   catch (SteadyStateSolver::SteadyStateException e)
     {
+      delete score;
       DYN_MEX_FUNC_ERR_MSG_TXT(e.message.c_str());
     }
+  catch (std::runtime_error &e)
+    {
+      delete score;
+      DYN_MEX_FUNC_ERR_MSG_TXT(e.what());
+    }
 }
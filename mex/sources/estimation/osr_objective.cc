@@ -0,0 +1,353 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * [loss, info, vx, gradient] = osr_objective(x, i_params, i_var, weights, M_, options_, steady_state[, gradient_method])
+ *
+ * Computes the loss function of the optimal simple rules, sum(sum(weights.*vx))
+ * where vx is the theoretical variance of the endogenous variables i_var
+ * (in declaration order), for the values x of the parameters i_params, as
+ * osr_obj.m.
+ *
+ * Inputs:
+ *   x                np*ncols matrix: each column is a value of the
+ *                    parameters i_params, the other parameters are M_.params
+ *   steady_state     endo_nbr*1 initial value of the steady state
+ *   gradient_method  0 (default): no gradient
+ *                    1: gradient computed from the derivatives of the
+ *                       decision rules with respect to the parameters
+ *                    2: central differences of step options_.gradient_epsilon,
+ *                       whose 2*np directions are evaluated in parallel
+ *
+ * Outputs:
+ *   loss      1*ncols
+ *   info      1*ncols, nonzero for the columns that failed (1: Blanchard-Kahn
+ *             conditions, 2: QZ, 3: steady state, 4: Lyapunov equation,
+ *             5: infinite variance, 6: other error); loss is then NaN, and
+ *             the caller should use osr_obj.m to get the penalty
+ *   vx        nvar*nvar variance of the variables i_var for the first column
+ *   gradient  np*1 gradient of the loss at the first column (elements which
+ *             could not be computed are set to zero, as in numgrad2.m)
+ *
+ * The columns (and the directions of the central differences) are evaluated
+ * in parallel with options_.threads.osr_objective threads. Each thread keeps
+ * its copy of the model solution between calls, so that its Lyapunov
+ * equations are warm-started from its previous solution if options_.lyapunov_fp
+ * is set.
+ */
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <limits>
+
+#include "Vector.hh"
+#include "Matrix.hh"
+#include "OsrObjective.hh"
+
+#include <dynmex.h>
+#include <instrumentation.hh>
+
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
+// One objective per thread, kept between calls
+static std::vector<OsrObjective *> objectives;
+static std::string objectives_key;
+
+static void
+freeObjectives()
+{
+  for (size_t i = 0; i < objectives.size(); ++i)
+    delete objectives[i];
+  objectives.clear();
+  objectives_key.clear();
+}
+
+void
+mexFunction(int nlhs, mxArray *plhs[],
+            int nrhs, const mxArray *prhs[])
+{
+  if (Instrumentation::mexCommand("osr_objective", nlhs, plhs, nrhs, prhs))
+    return;
+  INSTRUMENT_SCOPE("osr_objective");
+
+  if (nrhs != 7 && nrhs != 8)
+    DYN_MEX_FUNC_ERR_MSG_TXT("osr_objective: seven or eight input arguments are required.");
+  if (nlhs > 4)
+    DYN_MEX_FUNC_ERR_MSG_TXT("osr_objective returns 4 output arguments at the most.");
+  for (int i = 0; i < nrhs; ++i)
+    if (i != 4 && i != 5 && (!mxIsDouble(prhs[i]) || mxIsComplex(prhs[i]) || mxIsSparse(prhs[i])))
+      DYN_MEX_FUNC_ERR_MSG_TXT("osr_objective: all the arguments but M_ and options_ must be real dense arrays");
+  if (!mxIsStruct(prhs[4]) || !mxIsStruct(prhs[5]))
+    DYN_MEX_FUNC_ERR_MSG_TXT("osr_objective: the fifth and sixth arguments must be M_ and options_");
+
+  const mxArray *M_ = prhs[4];
+  const mxArray *options_ = prhs[5];
+
+  char *fName = mxArrayToString(mxGetField(M_, 0, "fname"));
+  std::string basename(fName);
+  mxFree(fName);
+
+  size_t n_endo = (size_t) *mxGetPr(mxGetField(M_, 0, "endo_nbr"));
+  size_t n_exo = (size_t) *mxGetPr(mxGetField(M_, 0, "exo_nbr"));
+  size_t param_nbr = (size_t) *mxGetPr(mxGetField(M_, 0, "param_nbr"));
+
+  std::vector<size_t> zeta_fwrd, zeta_back, zeta_mixed, zeta_static;
+  const mxArray *lli_mx = mxGetField(M_, 0, "lead_lag_incidence");
+  MatrixConstView lli(mxGetPr(lli_mx), mxGetM(lli_mx), mxGetN(lli_mx), mxGetM(lli_mx));
+  if (lli.getRows() != 3)
+    DYN_MEX_FUNC_ERR_MSG_TXT("osr_objective: purely backward or purely forward models are not supported");
+  if (lli.getCols() != n_endo)
+    DYN_MEX_FUNC_ERR_MSG_TXT("osr_objective: incorrect lead/lag incidence matrix");
+  for (size_t i = 0; i < n_endo; i++)
+    {
+      if (lli(0, i) == 0 && lli(2, i) == 0)
+        zeta_static.push_back(i);
+      else if (lli(0, i) != 0 && lli(2, i) == 0)
+        zeta_back.push_back(i);
+      else if (lli(0, i) == 0 && lli(2, i) != 0)
+        zeta_fwrd.push_back(i);
+      else
+        zeta_mixed.push_back(i);
+    }
+
+  double qz_criterium = *mxGetPr(mxGetField(options_, 0, "qz_criterium"));
+  double lyapunov_tol = *mxGetPr(mxGetField(options_, 0, "lyapunov_complex_threshold"));
+  double lyapunov_fp_tol = 0.0;
+  if (*mxGetPr(mxGetField(options_, 0, "lyapunov_fp")) == 1)
+    lyapunov_fp_tol = *mxGetPr(mxGetField(options_, 0, "lyapunov_fixed_point_tol"));
+  double gradient_epsilon = *mxGetPr(mxGetField(options_, 0, "gradient_epsilon"));
+
+  int number_of_threads = 1;
+  const mxArray *threads_mx = mxGetField(options_, 0, "threads");
+  if (threads_mx != NULL)
+    threads_mx = mxGetField(threads_mx, 0, "osr_objective");
+  if (threads_mx != NULL)
+    number_of_threads = (int) mxGetScalar(threads_mx);
+  if (number_of_threads < 1)
+    number_of_threads = 1;
+
+  const mxArray *x_mx = prhs[0], *ss_mx = prhs[6];
+  const size_t np = mxGetM(x_mx), ncols = mxGetN(x_mx);
+  if (ncols == 0)
+    DYN_MEX_FUNC_ERR_MSG_TXT("osr_objective: x must have at least one column");
+  if (mxGetNumberOfElements(prhs[1]) != np)
+    DYN_MEX_FUNC_ERR_MSG_TXT("osr_objective: i_params must have one element per row of x");
+  std::vector<size_t> i_params(np);
+  for (size_t i = 0; i < np; ++i)
+    {
+      double p = mxGetPr(prhs[1])[i];
+      if (p < 1 || p > param_nbr)
+        DYN_MEX_FUNC_ERR_MSG_TXT("osr_objective: i_params must contain indices of parameters");
+      i_params[i] = (size_t) p - 1;
+    }
+  std::vector<size_t> var_list;
+  for (size_t i = 0; i < mxGetNumberOfElements(prhs[2]); ++i)
+    {
+      double v = mxGetPr(prhs[2])[i];
+      if (v < 1 || v > n_endo)
+        DYN_MEX_FUNC_ERR_MSG_TXT("osr_objective: i_var must contain indices of endogenous variables");
+      var_list.push_back((size_t) v - 1);
+    }
+  const size_t nvar = var_list.size();
+  if (mxGetM(prhs[3]) != nvar || mxGetN(prhs[3]) != nvar)
+    DYN_MEX_FUNC_ERR_MSG_TXT("osr_objective: weights must be a square matrix with one row per element of i_var");
+  if (mxGetNumberOfElements(ss_mx) != n_endo)
+    DYN_MEX_FUNC_ERR_MSG_TXT("osr_objective: steady_state must have endo_nbr elements");
+  const mxArray *Sigma_e_mx = mxGetField(M_, 0, "Sigma_e");
+  if (mxGetM(Sigma_e_mx) != n_exo || mxGetN(Sigma_e_mx) != n_exo)
+    DYN_MEX_FUNC_ERR_MSG_TXT("osr_objective: M_.Sigma_e must be exo_nbr*exo_nbr");
+  const mxArray *params_mx = mxGetField(M_, 0, "params");
+  if (mxGetNumberOfElements(params_mx) != param_nbr)
+    DYN_MEX_FUNC_ERR_MSG_TXT("osr_objective: M_.params must have param_nbr elements");
+  int gradient_method = nrhs > 7 ? (int) mxGetScalar(prhs[7]) : 0;
+  if (gradient_method < 0 || gradient_method > 2)
+    DYN_MEX_FUNC_ERR_MSG_TXT("osr_objective: gradient_method must be 0, 1 or 2");
+  if (nlhs < 4)
+    gradient_method = 0;
+
+  MatrixConstView W(mxGetPr(prhs[3]), nvar, nvar, nvar);
+  MatrixConstView Q(mxGetPr(Sigma_e_mx), n_exo, n_exo, n_exo);
+
+  // (Re)create the objectives if the model, the targets or the options have changed
+  std::ostringstream key;
+  key.precision(17);
+  key << basename << ' ' << n_endo << ' ' << n_exo << ' ' << qz_criterium << ' ' << lyapunov_tol
+      << ' ' << lyapunov_fp_tol << " lli";
+  for (size_t i = 0; i < 3*n_endo; ++i)
+    key << ' ' << mxGetPr(lli_mx)[i];
+  key << " var";
+  for (size_t i = 0; i < nvar; ++i)
+    key << ' ' << var_list[i];
+  if (key.str() != objectives_key)
+    freeObjectives();
+  try
+    {
+      while (objectives.size() < (size_t) number_of_threads)
+        {
+          if (objectives.empty())
+            mexAtExit(freeObjectives);
+          objectives.push_back(new OsrObjective(basename, n_endo, n_exo, zeta_fwrd, zeta_back, zeta_mixed, zeta_static,
+                                                qz_criterium, lyapunov_tol, lyapunov_fp_tol, var_list));
+        }
+    }
+  catch (const TSException &e)
+    {
+      freeObjectives();
+      DYN_MEX_FUNC_ERR_MSG_TXT(e.getMessage().c_str());
+    }
+  objectives_key = key.str();
+
+  // Points to evaluate: the columns of x, followed by x(:,1)+h*e_i and x(:,1)-h*e_i
+  const size_t npoints = ncols + (gradient_method == 2 ? 2*np : 0);
+  std::vector<double> points(mxGetPr(x_mx), mxGetPr(x_mx) + np*ncols);
+  points.resize(np*npoints);
+  for (size_t i = 0; i < np && gradient_method == 2; ++i)
+    for (int side = 0; side < 2; ++side)
+      {
+        double *p = &points[0] + np*(ncols + 2*i + side);
+        std::copy(mxGetPr(x_mx), mxGetPr(x_mx) + np, p);
+        p[i] += side == 0 ? gradient_epsilon : -gradient_epsilon;
+      }
+
+  std::vector<double> loss(npoints, std::numeric_limits<double>::quiet_NaN());
+  std::vector<int> info(npoints, 0);
+  std::vector<std::string> errMsgs(npoints);
+  Matrix vx(nvar);
+  vx.setAll(std::numeric_limits<double>::quiet_NaN());
+
+#ifdef USE_OMP
+# pragma omp parallel num_threads(number_of_threads)
+#endif
+  {
+    int thread = 0;
+#ifdef USE_OMP
+    thread = omp_get_thread_num();
+#endif
+    OsrObjective *objective = objectives[thread];
+    Vector steadyState(n_endo), deepParams(param_nbr);
+    Matrix vx_c(nvar);
+
+#ifdef USE_OMP
+# pragma omp for schedule(dynamic)
+#endif
+    for (int c = 0; c < (int) npoints; ++c)
+      {
+        try
+          {
+            steadyState = VectorConstView(mxGetPr(ss_mx), n_endo, 1);
+            deepParams = VectorConstView(mxGetPr(params_mx), param_nbr, 1);
+            for (size_t i = 0; i < np; ++i)
+              deepParams(i_params[i]) = points[c*np + i];
+            double l = objective->compute(steadyState, deepParams, Q, W, vx_c);
+            if (mxIsFinite(l))
+              loss[c] = l;
+            else
+              info[c] = 5;
+            if (c == 0)
+              vx = vx_c;
+          }
+        catch (DecisionRules::BlanchardKahnException &e)
+          {
+            info[c] = 1;
+          }
+        catch (GeneralizedSchurDecomposition::GSDException &e)
+          {
+            info[c] = 2;
+          }
+        catch (SteadyStateSolver::SteadyStateException &e)
+          {
+            info[c] = 3;
+            errMsgs[c] = e.message;
+          }
+        catch (DiscLyapFast::DLPException &e)
+          {
+            info[c] = 4;
+            errMsgs[c] = e.message;
+          }
+        catch (std::exception &e)
+          {
+            info[c] = 6;
+            errMsgs[c] = e.what();
+          }
+      }
+  }
+
+  for (size_t c = 0; c < ncols; ++c)
+    if (!errMsgs[c].empty())
+      mexPrintf("osr_objective: column %d: %s\n", (int) c+1, errMsgs[c].c_str());
+
+  std::vector<double> gradient(np, 0.0);
+  if (gradient_method == 2)
+    for (size_t i = 0; i < np; ++i)
+      {
+        size_t c = ncols + 2*i;
+        if (info[c] == 0 && info[c+1] == 0)
+          gradient[i] = (loss[c] - loss[c+1])/(2*gradient_epsilon);
+      }
+  else if (gradient_method == 1 && info[0] == 0)
+    {
+      /* The derivatives need the decision rules of the first column in the
+         objective of the master thread: this call is cheap since
+         ModelSolution caches the last solution */
+      Vector steadyState(n_endo), deepParams(param_nbr);
+      steadyState = VectorConstView(mxGetPr(ss_mx), n_endo, 1);
+      deepParams = VectorConstView(mxGetPr(params_mx), param_nbr, 1);
+      for (size_t i = 0; i < np; ++i)
+        deepParams(i_params[i]) = points[i];
+      Matrix vx_c(nvar);
+      try
+        {
+          objectives[0]->compute(steadyState, deepParams, Q, W, vx_c);
+          for (size_t i = 0; i < np; ++i)
+            gradient[i] = objectives[0]->computeDerivative(steadyState, deepParams, i_params[i], W);
+        }
+      catch (...)
+        {
+          gradient.assign(np, 0.0);
+        }
+    }
+  for (size_t i = 0; i < np; ++i)
+    if (!(fabs(gradient[i]) < 1e15))
+      gradient[i] = 0.0;
+
+  plhs[0] = mxCreateDoubleMatrix(1, ncols, mxREAL);
+  std::copy(loss.begin(), loss.begin() + ncols, mxGetPr(plhs[0]));
+  if (nlhs > 1)
+    {
+      plhs[1] = mxCreateDoubleMatrix(1, ncols, mxREAL);
+      std::copy(info.begin(), info.begin() + ncols, mxGetPr(plhs[1]));
+    }
+  if (nlhs > 2)
+    {
+      plhs[2] = mxCreateDoubleMatrix(nvar, nvar, mxREAL);
+      MatrixView vx_out(mxGetPr(plhs[2]), nvar, nvar, nvar);
+      vx_out = vx;
+    }
+  if (nlhs > 3)
+    {
+      plhs[3] = mxCreateDoubleMatrix(np, 1, mxREAL);
+      std::copy(gradient.begin(), gradient.end(), mxGetPr(plhs[3]));
+    }
+}
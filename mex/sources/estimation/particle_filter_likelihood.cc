@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * [lik, lik_periods] = particle_filter_likelihood(data, ghx, ghu, constant, ghxx, ghuu, ghxu, ss, Q, H, mf0, mf1, seed, options_)
+ *
+ * Computes the likelihood of a second order approximation of the model with
+ * a particle filter, all the periods being filtered in C++ (see
+ * ParticleFilter.hh).
+ *
+ * Inputs:
+ *   data          p*T observations
+ *   ghx .. ghxu   second order reduced form restricted to the union of the
+ *                 m states and observed variables, as for
+ *                 local_state_space_iteration_2
+ *   constant      m*1 steady state plus second order correction
+ *   ss            m*1 steady state
+ *   Q, H          covariance matrices of the structural innovations and of the
+ *                 measurement errors (positive definite)
+ *   mf0, mf1      indices of the states and observed variables among the m
+ *                 variables
+ *   seed          seed of the random streams, so that calls with the same
+ *                 seed use common random numbers
+ *
+ * The options are those of options_.particle: number_of_particles, pruning,
+ * filter_algorithm ('sis' or 'apf'), resampling.status (systematic: every
+ * period, generic: below resampling.threshold, none: never) and
+ * resampling.method (kitagawa or stratified). options_.presample periods are
+ * excluded from lik. The particles are processed with
+ * options_.threads.particle_filter_likelihood threads.
+ */
+
+#include <string>
+#include <vector>
+#include <limits>
+
+#include "ParticleFilter.hh"
+
+#include <dynmex.h>
+#include <instrumentation.hh>
+
+static double
+getScalarField(const mxArray *s, const char *name)
+{
+  const mxArray *f = mxGetField(s, 0, name);
+  if (f == NULL)
+    mexErrMsgTxt((std::string("particle_filter_likelihood: missing option ") + name).c_str());
+  return mxGetScalar(f);
+}
+
+void
+mexFunction(int nlhs, mxArray *plhs[],
+            int nrhs, const mxArray *prhs[])
+{
+  if (Instrumentation::mexCommand("particle_filter_likelihood", nlhs, plhs, nrhs, prhs))
+    return;
+  INSTRUMENT_SCOPE("particle_filter_likelihood");
+
+  if (nrhs != 14)
+    DYN_MEX_FUNC_ERR_MSG_TXT("particle_filter_likelihood: exactly 14 input arguments are required.");
+  if (nlhs > 2)
+    DYN_MEX_FUNC_ERR_MSG_TXT("particle_filter_likelihood returns 2 output arguments at the most.");
+  for (int i = 0; i < 13; ++i)
+    if (!mxIsDouble(prhs[i]) || mxIsComplex(prhs[i]) || mxIsSparse(prhs[i]))
+      DYN_MEX_FUNC_ERR_MSG_TXT("particle_filter_likelihood: all the arguments but options_ must be real dense arrays");
+  if (!mxIsStruct(prhs[13]))
+    DYN_MEX_FUNC_ERR_MSG_TXT("particle_filter_likelihood: the last argument must be options_");
+
+  size_t p = mxGetM(prhs[0]), T = mxGetN(prhs[0]);
+  size_t m = mxGetM(prhs[1]), n = mxGetN(prhs[1]), q = mxGetN(prhs[2]);
+  if (mxGetM(prhs[2]) != m || mxGetNumberOfElements(prhs[3]) != m
+      || mxGetM(prhs[4]) != m || mxGetN(prhs[4]) != n*n
+      || mxGetM(prhs[5]) != m || mxGetN(prhs[5]) != q*q
+      || mxGetM(prhs[6]) != m || mxGetN(prhs[6]) != n*q
+      || mxGetNumberOfElements(prhs[7]) != m
+      || mxGetM(prhs[8]) != q || mxGetN(prhs[8]) != q
+      || mxGetM(prhs[9]) != p || mxGetN(prhs[9]) != p
+      || mxGetNumberOfElements(prhs[10]) != n || mxGetNumberOfElements(prhs[11]) != p)
+    DYN_MEX_FUNC_ERR_MSG_TXT("particle_filter_likelihood: input dimension mismatch");
+
+  std::vector<size_t> mf0(n), mf1(p);
+  for (size_t i = 0; i < n; ++i)
+    {
+      double v = mxGetPr(prhs[10])[i];
+      if (v < 1 || v > m)
+        DYN_MEX_FUNC_ERR_MSG_TXT("particle_filter_likelihood: the indices of the states are out of bounds");
+      mf0[i] = (size_t) v - 1;
+    }
+  for (size_t i = 0; i < p; ++i)
+    {
+      double v = mxGetPr(prhs[11])[i];
+      if (v < 1 || v > m)
+        DYN_MEX_FUNC_ERR_MSG_TXT("particle_filter_likelihood: the indices of the observed variables are out of bounds");
+      mf1[i] = (size_t) v - 1;
+    }
+  uint64_t seed = (uint64_t) mxGetScalar(prhs[12]);
+
+  const mxArray *options_ = prhs[13];
+  const mxArray *particle = mxGetField(options_, 0, "particle");
+  if (particle == NULL)
+    DYN_MEX_FUNC_ERR_MSG_TXT("particle_filter_likelihood: missing options_.particle");
+  size_t number_of_particles = (size_t) getScalarField(particle, "number_of_particles");
+  bool pruning = getScalarField(particle, "pruning") != 0;
+
+  ParticleFilter::Algorithm algorithm;
+  char *algorithm_name = mxArrayToString(mxGetField(particle, 0, "filter_algorithm"));
+  std::string filter_algorithm(algorithm_name == NULL ? "" : algorithm_name);
+  mxFree(algorithm_name);
+  if (filter_algorithm == "sis")
+    algorithm = ParticleFilter::sequentialImportanceResampling;
+  else if (filter_algorithm == "apf")
+    algorithm = ParticleFilter::auxiliary;
+  else
+    DYN_MEX_FUNC_ERR_MSG_TXT("particle_filter_likelihood: only the sis and apf filter algorithms are available");
+
+  const mxArray *resampling = mxGetField(particle, 0, "resampling");
+  if (resampling == NULL)
+    DYN_MEX_FUNC_ERR_MSG_TXT("particle_filter_likelihood: missing options_.particle.resampling");
+  const mxArray *status = mxGetField(resampling, 0, "status"), *method = mxGetField(resampling, 0, "method");
+  if (status == NULL || method == NULL)
+    DYN_MEX_FUNC_ERR_MSG_TXT("particle_filter_likelihood: missing resampling status or method");
+  double resampling_threshold = std::numeric_limits<double>::infinity();
+  if (getScalarField(status, "none") != 0)
+    resampling_threshold = 0.0;
+  else if (getScalarField(status, "generic") != 0)
+    resampling_threshold = getScalarField(resampling, "threshold");
+  if (getScalarField(method, "smooth") != 0)
+    DYN_MEX_FUNC_ERR_MSG_TXT("particle_filter_likelihood: smooth resampling is not available");
+  bool stratified = getScalarField(method, "stratified") != 0;
+
+  double lyapunov_tol = getScalarField(options_, "lyapunov_complex_threshold");
+  size_t presample = (size_t) getScalarField(options_, "presample");
+
+  int number_of_threads = 1;
+  const mxArray *threads_mx = mxGetField(options_, 0, "threads");
+  if (threads_mx != NULL)
+    threads_mx = mxGetField(threads_mx, 0, "particle_filter_likelihood");
+  if (threads_mx != NULL)
+    number_of_threads = (int) mxGetScalar(threads_mx);
+
+  MatrixConstView data(mxGetPr(prhs[0]), p, T, p);
+  MatrixConstView ghx(mxGetPr(prhs[1]), m, n, m), ghu(mxGetPr(prhs[2]), m, q, m),
+    ghxx(mxGetPr(prhs[4]), m, n*n, m), ghuu(mxGetPr(prhs[5]), m, q*q, m), ghxu(mxGetPr(prhs[6]), m, n*q, m);
+  VectorConstView constant(mxGetPr(prhs[3]), m, 1), ss(mxGetPr(prhs[7]), m, 1);
+  Matrix Q(q), H(p);
+  Q = MatrixConstView(mxGetPr(prhs[8]), q, q, q);
+  H = MatrixConstView(mxGetPr(prhs[9]), p, p, p);
+
+  Vector vll(T);
+  VectorView vllView(vll, 0, T);
+  double lik;
+  try
+    {
+      ParticleFilter pf(m, q, mf0, mf1, number_of_particles, algorithm, pruning, resampling_threshold,
+                        stratified, lyapunov_tol, number_of_threads);
+      pf.seed(seed, true);
+      lik = pf.compute(data, ghx, ghu, constant, ghxx, ghuu, ghxu, ss, Q, H, vllView, presample);
+    }
+  catch (DiscLyapFast::DLPException &e)
+    {
+      DYN_MEX_FUNC_ERR_MSG_TXT(("particle_filter_likelihood: " + e.message).c_str());
+    }
+  catch (std::exception &e)
+    {
+      DYN_MEX_FUNC_ERR_MSG_TXT(e.what());
+    }
+
+  plhs[0] = mxCreateDoubleScalar(lik);
+  if (nlhs > 1)
+    {
+      plhs[1] = mxCreateDoubleMatrix(T, 1, mxREAL);
+      VectorView(mxGetPr(plhs[1]), T, 1) = vll;
+    }
+}
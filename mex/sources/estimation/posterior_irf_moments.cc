@@ -0,0 +1,294 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * [irf_q, variance_q, decomposition_q, info] = posterior_irf_moments(params, Sigma_e, steady_state, options_, M_, var_list, irf_periods, quantiles)
+ *
+ * Computes the IRFs, the theoretical variances and the variance
+ * decompositions of the endogenous variables var_list for a block of
+ * posterior draws, and returns their quantiles across the draws.
+ *
+ * Inputs:
+ *   params        param_nbr*ndraws matrix of deep parameters
+ *   Sigma_e       exo_nbr*exo_nbr matrix, or exo_nbr*exo_nbr*ndraws array
+ *   steady_state  endo_nbr*1 initial value of the steady state, for all draws
+ *   var_list      indices of the endogenous variables (in declaration order),
+ *                 or [] for all of them
+ *   irf_periods   number of periods of the IRFs (can be 0)
+ *   quantiles     probabilities of the quantiles (Matlab's quantile method)
+ *
+ * Outputs:
+ *   irf_q            nvar*irf_periods*exo_nbr*nq
+ *   variance_q       nvar*nq
+ *   decomposition_q  nvar*exo_nbr*nq, in percent
+ *   info             1*ndraws, nonzero for the draws that failed (they are
+ *                    excluded from the quantiles)
+ *
+ * The draws are processed in parallel with options_.threads.posterior_irf_moments
+ * threads, each thread having its own copy of the model solution.
+ */
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+#include "Vector.hh"
+#include "Matrix.hh"
+#include "ReducedFormMoments.hh"
+
+#include <dynmex.h>
+#include <instrumentation.hh>
+
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
+// Quantiles of x (destroyed), with the method of Matlab's quantile function (R-5)
+static void
+computeQuantiles(std::vector<double> &x, const std::vector<double> &p, double *q, size_t q_stride)
+{
+  size_t n = x.size();
+  if (n == 0)
+    {
+      for (size_t k = 0; k < p.size(); ++k)
+        q[k*q_stride] = std::numeric_limits<double>::quiet_NaN();
+      return;
+    }
+  std::sort(x.begin(), x.end());
+  for (size_t k = 0; k < p.size(); ++k)
+    {
+      double h = n*p[k] + 0.5; // 1-based position in x
+      if (h <= 1.0)
+        q[k*q_stride] = x[0];
+      else if (h >= n)
+        q[k*q_stride] = x[n-1];
+      else
+        {
+          size_t i = (size_t) h;
+          q[k*q_stride] = x[i-1] + (h - i)*(x[i] - x[i-1]);
+        }
+    }
+}
+
+void
+mexFunction(int nlhs, mxArray *plhs[],
+            int nrhs, const mxArray *prhs[])
+{
+  if (Instrumentation::mexCommand("posterior_irf_moments", nlhs, plhs, nrhs, prhs))
+    return;
+  INSTRUMENT_SCOPE("posterior_irf_moments");
+
+  if (nrhs != 8)
+    DYN_MEX_FUNC_ERR_MSG_TXT("posterior_irf_moments: exactly 8 input arguments are required.");
+  if (nlhs > 4)
+    DYN_MEX_FUNC_ERR_MSG_TXT("posterior_irf_moments returns 4 output arguments at the most.");
+  for (int i = 0; i < 8; ++i)
+    if (i != 3 && i != 4 && (!mxIsDouble(prhs[i]) || mxIsComplex(prhs[i]) || mxIsSparse(prhs[i])))
+      DYN_MEX_FUNC_ERR_MSG_TXT("posterior_irf_moments: all the arguments but options_ and M_ must be real dense arrays");
+  if (!mxIsStruct(prhs[3]) || !mxIsStruct(prhs[4]))
+    DYN_MEX_FUNC_ERR_MSG_TXT("posterior_irf_moments: the fourth and fifth arguments must be options_ and M_");
+
+  const mxArray *options_ = prhs[3];
+  const mxArray *M_ = prhs[4];
+
+  char *fName = mxArrayToString(mxGetField(M_, 0, "fname"));
+  std::string basename(fName);
+  mxFree(fName);
+
+  size_t n_endo = (size_t) *mxGetPr(mxGetField(M_, 0, "endo_nbr"));
+  size_t n_exo = (size_t) *mxGetPr(mxGetField(M_, 0, "exo_nbr"));
+  size_t param_nbr = (size_t) *mxGetPr(mxGetField(M_, 0, "param_nbr"));
+
+  std::vector<size_t> zeta_fwrd, zeta_back, zeta_mixed, zeta_static;
+  const mxArray *lli_mx = mxGetField(M_, 0, "lead_lag_incidence");
+  MatrixConstView lli(mxGetPr(lli_mx), mxGetM(lli_mx), mxGetN(lli_mx), mxGetM(lli_mx));
+  if (lli.getRows() != 3)
+    DYN_MEX_FUNC_ERR_MSG_TXT("posterior_irf_moments: purely backward or purely forward models are not supported");
+  if (lli.getCols() != n_endo)
+    DYN_MEX_FUNC_ERR_MSG_TXT("posterior_irf_moments: incorrect lead/lag incidence matrix");
+  for (size_t i = 0; i < n_endo; i++)
+    {
+      if (lli(0, i) == 0 && lli(2, i) == 0)
+        zeta_static.push_back(i);
+      else if (lli(0, i) != 0 && lli(2, i) == 0)
+        zeta_back.push_back(i);
+      else if (lli(0, i) == 0 && lli(2, i) != 0)
+        zeta_fwrd.push_back(i);
+      else
+        zeta_mixed.push_back(i);
+    }
+
+  double qz_criterium = *mxGetPr(mxGetField(options_, 0, "qz_criterium"));
+  double lyapunov_tol = *mxGetPr(mxGetField(options_, 0, "lyapunov_complex_threshold"));
+
+  int number_of_threads = 1;
+  const mxArray *threads_mx = mxGetField(options_, 0, "threads");
+  if (threads_mx != NULL)
+    threads_mx = mxGetField(threads_mx, 0, "posterior_irf_moments");
+  if (threads_mx != NULL)
+    number_of_threads = (int) mxGetScalar(threads_mx);
+
+  const mxArray *params_mx = prhs[0], *Q_mx = prhs[1], *ss_mx = prhs[2];
+  if (mxGetM(params_mx) != param_nbr)
+    DYN_MEX_FUNC_ERR_MSG_TXT("posterior_irf_moments: params must have param_nbr rows");
+  size_t ndraws = mxGetN(params_mx);
+  if (mxGetM(Q_mx) != n_exo || (mxGetNumberOfElements(Q_mx) != n_exo*n_exo
+                               && mxGetNumberOfElements(Q_mx) != n_exo*n_exo*ndraws))
+    DYN_MEX_FUNC_ERR_MSG_TXT("posterior_irf_moments: Sigma_e must be exo_nbr*exo_nbr or exo_nbr*exo_nbr*ndraws");
+  size_t Q_stride = mxGetNumberOfElements(Q_mx) == n_exo*n_exo ? 0 : n_exo*n_exo;
+  if (mxGetNumberOfElements(ss_mx) != n_endo)
+    DYN_MEX_FUNC_ERR_MSG_TXT("posterior_irf_moments: steady_state must have endo_nbr elements");
+
+  std::vector<size_t> var_list;
+  for (size_t i = 0; i < mxGetNumberOfElements(prhs[5]); ++i)
+    {
+      double v = mxGetPr(prhs[5])[i];
+      if (v < 1 || v > n_endo)
+        DYN_MEX_FUNC_ERR_MSG_TXT("posterior_irf_moments: var_list must contain indices of endogenous variables");
+      var_list.push_back((size_t) v - 1);
+    }
+  if (var_list.empty())
+    for (size_t i = 0; i < n_endo; ++i)
+      var_list.push_back(i);
+  size_t nvar = var_list.size();
+  size_t irf_periods = (size_t) mxGetScalar(prhs[6]);
+  std::vector<double> quantiles(mxGetPr(prhs[7]), mxGetPr(prhs[7]) + mxGetNumberOfElements(prhs[7]));
+  size_t nq = quantiles.size();
+
+  // Results of all the draws, in the order irf, variance, decomposition
+  const size_t irf_size = nvar*irf_periods*n_exo, draw_size = irf_size + nvar + nvar*n_exo;
+  std::vector<double> results(draw_size*ndraws);
+  std::vector<int> info(ndraws, 0);
+  std::vector<std::string> errMsgs(ndraws);
+
+#ifdef USE_OMP
+# pragma omp parallel num_threads(number_of_threads)
+#endif
+  {
+    ReducedFormMoments *rfm = NULL;
+    std::string initErrMsg;
+    try
+      {
+        rfm = new ReducedFormMoments(basename, n_endo, n_exo, zeta_fwrd, zeta_back, zeta_mixed, zeta_static,
+                                     qz_criterium, lyapunov_tol, var_list, irf_periods);
+      }
+    catch (const TSException &e)
+      {
+        initErrMsg = e.getMessage();
+      }
+    Vector steadyState(n_endo), deepParams(param_nbr);
+    VectorView steadyStateView(steadyState, 0, n_endo);
+    Matrix Q(n_exo);
+
+#ifdef USE_OMP
+# pragma omp for schedule(dynamic)
+#endif
+    for (int d = 0; d < (int) ndraws; ++d)
+      {
+        double *res = &results[0] + d*draw_size;
+        MatrixView irf(res, nvar, irf_periods*n_exo, nvar), decomposition(res + irf_size + nvar, nvar, n_exo, nvar);
+        VectorView variance(res + irf_size, nvar, 1);
+        try
+          {
+            if (rfm == NULL)
+              throw std::runtime_error(initErrMsg);
+            steadyState = VectorConstView(mxGetPr(ss_mx), n_endo, 1);
+            deepParams = VectorConstView(mxGetPr(params_mx) + d*param_nbr, param_nbr, 1);
+            Q = MatrixConstView(mxGetPr(Q_mx) + d*Q_stride, n_exo, n_exo, n_exo);
+            rfm->compute(steadyStateView, deepParams, Q, irf, variance, decomposition);
+          }
+        catch (DecisionRules::BlanchardKahnException &e)
+          {
+            info[d] = 1;
+          }
+        catch (GeneralizedSchurDecomposition::GSDException &e)
+          {
+            info[d] = 2;
+          }
+        catch (SteadyStateSolver::SteadyStateException &e)
+          {
+            info[d] = 3;
+            errMsgs[d] = e.message;
+          }
+        catch (DiscLyapFast::DLPException &e)
+          {
+            info[d] = 4;
+            errMsgs[d] = e.message;
+          }
+        catch (std::exception &e)
+          {
+            info[d] = 5;
+            errMsgs[d] = e.what();
+          }
+      }
+
+    delete rfm;
+  }
+
+  for (size_t d = 0; d < ndraws; ++d)
+    if (!errMsgs[d].empty())
+      mexPrintf("posterior_irf_moments: draw %d: %s\n", (int) d+1, errMsgs[d].c_str());
+
+  // Quantiles of each element across the successful draws
+  mwSize dims[4];
+  dims[0] = nvar;
+  dims[1] = irf_periods;
+  dims[2] = n_exo;
+  dims[3] = nq;
+  plhs[0] = mxCreateNumericArray(4, dims, mxDOUBLE_CLASS, mxREAL);
+  mxArray *variance_mx = mxCreateDoubleMatrix(nvar, nq, mxREAL);
+  dims[1] = n_exo;
+  dims[2] = nq;
+  mxArray *decomposition_mx = mxCreateNumericArray(3, dims, mxDOUBLE_CLASS, mxREAL);
+
+  std::vector<double> x;
+  x.reserve(ndraws);
+  for (size_t e = 0; e < draw_size; ++e)
+    {
+      x.clear();
+      for (size_t d = 0; d < ndraws; ++d)
+        if (info[d] == 0)
+          x.push_back(results[d*draw_size + e]);
+      if (e < irf_size)
+        computeQuantiles(x, quantiles, mxGetPr(plhs[0]) + e, irf_size);
+      else if (e < irf_size + nvar)
+        computeQuantiles(x, quantiles, mxGetPr(variance_mx) + e - irf_size, nvar);
+      else
+        computeQuantiles(x, quantiles, mxGetPr(decomposition_mx) + e - irf_size - nvar, nvar*n_exo);
+    }
+  for (size_t i = 0; i < nvar*n_exo*nq; ++i)
+    mxGetPr(decomposition_mx)[i] *= 100;
+
+  if (nlhs > 1)
+    plhs[1] = variance_mx;
+  else
+    mxDestroyArray(variance_mx);
+  if (nlhs > 2)
+    plhs[2] = decomposition_mx;
+  else
+    mxDestroyArray(decomposition_mx);
+  if (nlhs > 3)
+    {
+      plhs[3] = mxCreateDoubleMatrix(1, ndraws, mxREAL);
+      std::copy(info.begin(), info.end(), mxGetPr(plhs[3]));
+    }
+}
@@ -0,0 +1,357 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Samples the posterior with the tempered sequential Monte Carlo sampler.
+ *
+ * [particles, loglik, logprior, logmdd, phi] = smc_posterior(dataset, options_, M_, estim_params_, bayestopt_, oo_)
+ *
+ * returns the equally weighted particles in the columns of particles, their
+ * log likelihoods and log prior densities (row vectors), the log of the
+ * marginal data density, and the tempering schedule. The options are read
+ * from options_.posterior_sampler_options.smc, the number of threads from
+ * options_.threads.smc_posterior and the seed from
+ * options_.DynareRandomStreams.seed.
+ */
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+
+#include "Vector.hh"
+#include "Matrix.hh"
+#include "LogPosteriorDensity.hh"
+#include "SequentialMonteCarlo.hh"
+
+#include <dynmex.h>
+#include <instrumentation.hh>
+
+class SMCPosteriorMexErrMsgTxtException
+{
+public:
+  std::string errMsg;
+  SMCPosteriorMexErrMsgTxtException(const std::string &msg) : errMsg(msg)
+  {
+  }
+  inline const char *
+  getErrMsg()
+  {
+    return errMsg.c_str();
+  }
+};
+
+/**
+ * Log likelihood evaluator of a thread: it owns a posterior density evaluator
+ * and copies of the steady state and of the parameters, which are
+ * overwritten by each evaluation.
+ */
+struct SMCWorker
+{
+  LogPosteriorDensity *lpd;
+  Vector steadyState, deepParams;
+  Matrix Q, H;
+  const MatrixConstView &data;
+  size_t presampleStart;
+
+  SMCWorker(LogPosteriorDensity *lpd_arg, const VectorView &steadyState_arg, const VectorView &deepParams_arg,
+            const MatrixView &Q_arg, const Matrix &H_arg, const MatrixConstView &data_arg, size_t presampleStart_arg) :
+    lpd(lpd_arg), steadyState(steadyState_arg.getSize()), deepParams(deepParams_arg.getSize()),
+    Q(Q_arg.getRows(), Q_arg.getCols()), H(H_arg), data(data_arg), presampleStart(presampleStart_arg)
+  {
+    steadyState = steadyState_arg;
+    deepParams = deepParams_arg;
+    Q = Q_arg;
+  }
+
+  double
+  logLikelihood(VectorView &params)
+  {
+    VectorView ss(steadyState, 0, steadyState.getSize());
+    VectorView dp(deepParams, 0, deepParams.getSize());
+    MatrixView q(Q, 0, 0, Q.getRows(), Q.getCols());
+    return lpd->computeLogLikelihood(ss, params, dp, data, q, H, presampleStart);
+  }
+};
+
+void
+fillEstParamsInfo(const mxArray *bayestopt_, const mxArray *estim_params_info, EstimatedParameter::pType type,
+                  std::vector<EstimatedParameter> &estParamsInfo)
+{
+  const mxArray *bayestopt_ubp = mxGetField(bayestopt_, 0, "ub"); // upper bound
+  const mxArray *bayestopt_lbp = mxGetField(bayestopt_, 0, "lb"); // lower bound
+  const mxArray *bayestopt_p3p = mxGetField(bayestopt_, 0, "p3"); // lower bound
+  const mxArray *bayestopt_p4p = mxGetField(bayestopt_, 0, "p4"); // upper bound
+  const mxArray *bayestopt_p6p = mxGetField(bayestopt_, 0, "p6"); // first hyper-parameter
+  const mxArray *bayestopt_p7p = mxGetField(bayestopt_, 0, "p7"); // second hyper-parameter
+
+  const size_t bayestopt_size = mxGetM(bayestopt_ubp);
+  const VectorConstView bayestopt_ub(mxGetPr(bayestopt_ubp), bayestopt_size, 1);
+  const VectorConstView bayestopt_lb(mxGetPr(bayestopt_lbp), bayestopt_size, 1);
+  const VectorConstView bayestopt_p3(mxGetPr(bayestopt_p3p), bayestopt_size, 1);
+  const VectorConstView bayestopt_p4(mxGetPr(bayestopt_p4p), bayestopt_size, 1);
+  const VectorConstView bayestopt_p6(mxGetPr(bayestopt_p6p), bayestopt_size, 1);
+  const VectorConstView bayestopt_p7(mxGetPr(bayestopt_p7p), bayestopt_size, 1);
+
+  size_t m = mxGetM(estim_params_info), n = mxGetN(estim_params_info);
+  MatrixConstView epi(mxGetPr(estim_params_info), m, n, m);
+  size_t bayestopt_count = estParamsInfo.size();
+
+  for (size_t i = 0; i < m; i++)
+    {
+      size_t col = 0;
+      size_t id1 = (size_t) epi(i, col++) - 1;
+      size_t id2 = 0;
+      if (type == EstimatedParameter::shock_Corr
+          || type == EstimatedParameter::measureErr_Corr)
+        id2 = (size_t) epi(i, col++) - 1;
+      col += 3; // Skip init_val, lower and upper bounds
+      Prior::pShape shape = (Prior::pShape) epi(i, col++);
+      double mean = epi(i, col++);
+      double std = epi(i, col++);
+
+      Prior *p = Prior::constructPrior(shape, mean, std, bayestopt_p3(bayestopt_count), bayestopt_p4(bayestopt_count),
+                                       bayestopt_p6(bayestopt_count), bayestopt_p7(bayestopt_count));
+
+      // Only one subsample
+      std::vector<size_t> subSampleIDs;
+      subSampleIDs.push_back(0);
+      estParamsInfo.push_back(EstimatedParameter(type, id1, id2, subSampleIDs,
+                                                 bayestopt_lb(bayestopt_count), bayestopt_ub(bayestopt_count), p));
+      bayestopt_count++;
+    }
+}
+
+double
+smcPosterior(const MatrixConstView &data, const mxArray *options_, const mxArray *M_, const mxArray *estim_params_,
+             const mxArray *bayestopt_, VectorView &steadyState, VectorView &deepParams, MatrixView &Q, Matrix &H,
+             mxArray *plhs[])
+{
+  if (*mxGetPr(mxGetField(options_, 0, "loglinear")) == 1)
+    throw SMCPosteriorMexErrMsgTxtException("Option loglinear is not supported");
+  if (*mxGetPr(mxGetField(options_, 0, "endogenous_prior")) == 1)
+    throw SMCPosteriorMexErrMsgTxtException("Option endogenous_prior is not supported");
+  if (*mxGetPr(mxGetField(bayestopt_, 0, "with_trend")) == 1)
+    throw SMCPosteriorMexErrMsgTxtException("Observation trends are not supported");
+
+  char *fName = mxArrayToString(mxGetField(M_, 0, "fname"));
+  std::string basename(fName);
+  mxFree(fName);
+
+  size_t n_endo = (size_t) *mxGetPr(mxGetField(M_, 0, "endo_nbr"));
+  size_t n_exo = (size_t) *mxGetPr(mxGetField(M_, 0, "exo_nbr"));
+
+  std::vector<size_t> zeta_fwrd, zeta_back, zeta_mixed, zeta_static;
+  const mxArray *lli_mx = mxGetField(M_, 0, "lead_lag_incidence");
+  MatrixConstView lli(mxGetPr(lli_mx), mxGetM(lli_mx), mxGetN(lli_mx), mxGetM(lli_mx));
+  if (lli.getRows() != 3)
+    throw SMCPosteriorMexErrMsgTxtException("Purely backward or purely forward models are not supported");
+  if (lli.getCols() != n_endo)
+    throw SMCPosteriorMexErrMsgTxtException("Incorrect lead/lag incidence matrix");
+  for (size_t i = 0; i < n_endo; i++)
+    {
+      if (lli(0, i) == 0 && lli(2, i) == 0)
+        zeta_static.push_back(i);
+      else if (lli(0, i) != 0 && lli(2, i) == 0)
+        zeta_back.push_back(i);
+      else if (lli(0, i) == 0 && lli(2, i) != 0)
+        zeta_fwrd.push_back(i);
+      else
+        zeta_mixed.push_back(i);
+    }
+
+  double qz_criterium = *mxGetPr(mxGetField(options_, 0, "qz_criterium"));
+  double lyapunov_tol = *mxGetPr(mxGetField(options_, 0, "lyapunov_complex_threshold"));
+  double riccati_tol = *mxGetPr(mxGetField(options_, 0, "riccati_tol"));
+  size_t presample = (size_t) *mxGetPr(mxGetField(options_, 0, "presample"));
+
+  std::vector<size_t> varobs;
+  const mxArray *varobs_mx = mxGetField(options_, 0, "varobs_id");
+  if (mxGetM(varobs_mx) != 1)
+    throw SMCPosteriorMexErrMsgTxtException("options_.varobs_id must be a row vector");
+  size_t n_varobs = mxGetN(varobs_mx);
+  std::transform(mxGetPr(varobs_mx), mxGetPr(varobs_mx) + n_varobs, back_inserter(varobs),
+                 std::bind2nd(std::minus<size_t>(), 1));
+  if (data.getRows() != n_varobs)
+    throw SMCPosteriorMexErrMsgTxtException("Data does not have as many rows as there are observed variables");
+
+  std::vector<EstimationSubsample> estSubsamples;
+  estSubsamples.push_back(EstimationSubsample(0, data.getCols() - 1));
+
+  std::vector<EstimatedParameter> estParamsInfo;
+  fillEstParamsInfo(bayestopt_, mxGetField(estim_params_, 0, "var_exo"), EstimatedParameter::shock_SD,
+                    estParamsInfo);
+  fillEstParamsInfo(bayestopt_, mxGetField(estim_params_, 0, "var_endo"), EstimatedParameter::measureErr_SD,
+                    estParamsInfo);
+  fillEstParamsInfo(bayestopt_, mxGetField(estim_params_, 0, "corrx"), EstimatedParameter::shock_Corr,
+                    estParamsInfo);
+  fillEstParamsInfo(bayestopt_, mxGetField(estim_params_, 0, "corrn"), EstimatedParameter::measureErr_Corr,
+                    estParamsInfo);
+  fillEstParamsInfo(bayestopt_, mxGetField(estim_params_, 0, "param_vals"), EstimatedParameter::deepPar,
+                    estParamsInfo);
+  EstimatedParametersDescription epd(estSubsamples, estParamsInfo);
+
+  bool noconstant = (bool) *mxGetPr(mxGetField(options_, 0, "noconstant"));
+  bool fast_kalman_filter = (bool) *mxGetPr(mxGetField(options_, 0, "fast_kalman_filter"));
+  bool sqrt_kalman_filter = (bool) *mxGetPr(mxGetField(options_, 0, "sqrt_kalman_filter"));
+  double lyapunov_fixed_point_tol = 0.0;
+  if (*mxGetPr(mxGetField(options_, 0, "lyapunov_fp")) == 1)
+    lyapunov_fixed_point_tol = *mxGetPr(mxGetField(options_, 0, "lyapunov_fixed_point_tol"));
+
+  int number_of_threads = 1;
+  const mxArray *threads_mx = mxGetField(options_, 0, "threads");
+  if (threads_mx != NULL)
+    threads_mx = mxGetField(threads_mx, 0, "smc_posterior");
+  if (threads_mx != NULL)
+    number_of_threads = std::max((int) mxGetScalar(threads_mx), 1);
+
+  size_t number_of_particles = 2000, mutation_steps = 2;
+  double conditional_ess_ratio = 0.95, resampling_threshold = 0.5;
+  const mxArray *smc_mx = mxGetField(options_, 0, "posterior_sampler_options");
+  if (smc_mx != NULL)
+    smc_mx = mxGetField(smc_mx, 0, "smc");
+  if (smc_mx != NULL)
+    {
+      if (mxGetField(smc_mx, 0, "number_of_particles") != NULL)
+        number_of_particles = (size_t) mxGetScalar(mxGetField(smc_mx, 0, "number_of_particles"));
+      if (mxGetField(smc_mx, 0, "conditional_ess_ratio") != NULL)
+        conditional_ess_ratio = mxGetScalar(mxGetField(smc_mx, 0, "conditional_ess_ratio"));
+      if (mxGetField(smc_mx, 0, "resampling_threshold") != NULL)
+        resampling_threshold = mxGetScalar(mxGetField(smc_mx, 0, "resampling_threshold"));
+      if (mxGetField(smc_mx, 0, "mutation_steps") != NULL)
+        mutation_steps = (size_t) mxGetScalar(mxGetField(smc_mx, 0, "mutation_steps"));
+    }
+
+  int seed = 0;
+  const mxArray *random_streams_mx = mxGetField(options_, 0, "DynareRandomStreams");
+  if (random_streams_mx != NULL && mxGetField(random_streams_mx, 0, "seed") != NULL)
+    seed = (int) mxGetScalar(mxGetField(random_streams_mx, 0, "seed"));
+
+  // One posterior density evaluator by thread
+  std::vector<SMCWorker *> workers;
+  for (int t = 0; t < number_of_threads; ++t)
+    {
+      LogPosteriorDensity *lpd = new LogPosteriorDensity(basename, epd, n_endo, n_exo, zeta_fwrd, zeta_back, zeta_mixed, zeta_static,
+                                                         qz_criterium, varobs, riccati_tol, lyapunov_tol, noconstant, fast_kalman_filter, sqrt_kalman_filter,
+                                                         lyapunov_fixed_point_tol);
+      workers.push_back(new SMCWorker(lpd, steadyState, deepParams, Q, H, data, presample));
+    }
+
+  double logMarginalDensity;
+  std::string errMsg;
+  try
+    {
+      SequentialMonteCarlo smc(epd, number_of_particles, seed, conditional_ess_ratio, resampling_threshold, mutation_steps);
+      logMarginalDensity = smc.compute(workers);
+
+      const Matrix &particles = smc.getParticles();
+      plhs[0] = mxCreateDoubleMatrix(particles.getRows(), particles.getCols(), mxREAL);
+      MatrixView(mxGetPr(plhs[0]), particles.getRows(), particles.getCols(), particles.getRows()) = particles;
+      plhs[1] = mxCreateDoubleMatrix(1, number_of_particles, mxREAL);
+      std::copy(smc.getLogLikelihoods().getData(), smc.getLogLikelihoods().getData() + number_of_particles, mxGetPr(plhs[1]));
+      plhs[2] = mxCreateDoubleMatrix(1, number_of_particles, mxREAL);
+      std::copy(smc.getLogPriors().getData(), smc.getLogPriors().getData() + number_of_particles, mxGetPr(plhs[2]));
+      const std::vector<double> &temperatures = smc.getTemperatures();
+      plhs[4] = mxCreateDoubleMatrix(1, temperatures.size(), mxREAL);
+      std::copy(temperatures.begin(), temperatures.end(), mxGetPr(plhs[4]));
+    }
+  catch (const std::exception &e)
+    {
+      errMsg = e.what();
+    }
+
+  // Cleanups
+  for (std::vector<SMCWorker *>::iterator it = workers.begin(); it != workers.end(); it++)
+    {
+      delete (*it)->lpd;
+      delete *it;
+    }
+  for (std::vector<EstimatedParameter>::iterator it = estParamsInfo.begin();
+       it != estParamsInfo.end(); it++)
+    delete it->prior;
+
+  if (!errMsg.empty())
+    throw SMCPosteriorMexErrMsgTxtException("smc_posterior: " + errMsg);
+
+  return logMarginalDensity;
+}
+
+void
+mexFunction(int nlhs, mxArray *plhs[],
+            int nrhs, const mxArray *prhs[])
+{
+  if (Instrumentation::mexCommand("smc_posterior", nlhs, plhs, nrhs, prhs))
+    return;
+  INSTRUMENT_SCOPE("smc_posterior");
+
+  if (nrhs != 6)
+    DYN_MEX_FUNC_ERR_MSG_TXT("smc_posterior: exactly 6 input arguments are required.");
+  if (nlhs != 5)
+    DYN_MEX_FUNC_ERR_MSG_TXT("smc_posterior: exactly 5 output arguments are required.");
+
+  for (int i = 0; i < 6; ++i)
+    if (!mxIsStruct(prhs[i]))
+      {
+        std::stringstream msg;
+        msg << "smc_posterior: argument " << i+1 << " must be a Matlab structure";
+        DYN_MEX_FUNC_ERR_MSG_TXT(msg.str().c_str());
+      }
+
+  const mxArray *dataset = prhs[0];
+  const mxArray *options_ = prhs[1];
+  const mxArray *M_ = prhs[2];
+  const mxArray *estim_params_ = prhs[3];
+  const mxArray *bayestopt_ = prhs[4];
+  const mxArray *oo_ = prhs[5];
+
+  const mxArray *dataset_data = mxGetField(dataset, 0, "data");
+  MatrixConstView data(mxGetPr(dataset_data), mxGetM(dataset_data), mxGetN(dataset_data), mxGetM(dataset_data));
+
+  size_t endo_nbr = (size_t) *mxGetPr(mxGetField(M_, 0, "endo_nbr"));
+  size_t exo_nbr = (size_t) *mxGetPr(mxGetField(M_, 0, "exo_nbr"));
+  size_t param_nbr = (size_t) *mxGetPr(mxGetField(M_, 0, "param_nbr"));
+  size_t varobs_nbr = mxGetM(mxGetField(options_, 0, "varobs"));
+
+  VectorView steadyState(mxGetPr(mxGetField(oo_, 0, "steady_state")), endo_nbr, 1);
+  VectorView deepParams(mxGetPr(mxGetField(M_, 0, "params")), param_nbr, 1);
+  MatrixView Q(mxGetPr(mxGetField(M_, 0, "Sigma_e")), exo_nbr, exo_nbr, exo_nbr);
+
+  Matrix H(varobs_nbr, varobs_nbr);
+  const mxArray *H_mx = mxGetField(M_, 0, "H");
+  if (mxGetM(H_mx) == 1 && mxGetN(H_mx) == 1 && *mxGetPr(H_mx) == 0)
+    H.setAll(0.0);
+  else
+    H = MatrixConstView(mxGetPr(H_mx), varobs_nbr, varobs_nbr, varobs_nbr);
+
+  try
+    {
+      double logMarginalDensity = smcPosterior(data, options_, M_, estim_params_, bayestopt_, steadyState, deepParams, Q, H, plhs);
+      plhs[3] = mxCreateDoubleScalar(logMarginalDensity);
+    }
+  catch (SMCPosteriorMexErrMsgTxtException e)
+    {
+      DYN_MEX_FUNC_ERR_MSG_TXT(e.getErrMsg());
+    }
+  catch (SteadyStateSolver::SteadyStateException e)
+    {
+      DYN_MEX_FUNC_ERR_MSG_TXT(e.message.c_str());
+    }
+}
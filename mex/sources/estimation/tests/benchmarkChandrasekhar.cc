@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compares the likelihood and the running time of the standard Kalman filter
+ * and of the Chandrasekhar recursions, either on fs2000k2e.mod or on
+ * large_state.mod (200 states, 3 observables).
+ */
+
+#include <cstdlib>
+#include <ctime>
+
+#include "KalmanFilter.hh"
+#include "ChandrasekharFilter.hh"
+
+template <class Filter>
+double
+run(Filter &filter, size_t nrep, const MatrixConstView &dataView, VectorView &steadyState, const Matrix &Q,
+    const Matrix &H, const Vector &deepParams, VectorView &vll, double &seconds)
+{
+  double ll = 0.0;
+  std::clock_t begin = std::clock();
+  for (size_t i = 0; i < nrep; ++i)
+    ll = filter.compute(dataView, steadyState, Q, H, deepParams, vll, 0, 0);
+  seconds = double (std::clock() - begin) / CLOCKS_PER_SEC;
+  return ll;
+}
+
+int
+main(int argc, char **argv)
+{
+  if (argc < 3)
+    {
+      std::cerr << argv[0] << ": please provide as arguments fs2000 or large, and the name of the dynamic DLL generated from fs2000k2e.mod or large_state.mod" << std::endl;
+      std::cerr << "and optionally the number of repetitions" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+
+  std::string model = argv[1], modName = argv[2];
+  size_t nrep = argc > 3 ? atoi(argv[3]) : 100;
+  const size_t nper = 192;
+  size_t n_endo, n_exo;
+  std::vector<size_t> zeta_fwrd_arg, zeta_back_arg, zeta_mixed_arg, zeta_static_arg, varobs_arg;
+  Vector *steadyState, *deepParams;
+  Matrix *Q;
+
+  if (model == "fs2000")
+    {
+      n_endo = 15;
+      n_exo = 2;
+      double dYSparams [] = {
+        1.000199998312523, 0.993250551764778, 1.006996670195112, 1, 2.718562165733039,
+        1.007250753636589, 18.982191739915155, 0.860847884886309, 0.316729149714572, 0.861047883198832,
+        1.00853622757204, 0.991734328394345, 1.355876776121869, 1.00853622757204, 0.992853374047708
+      };
+      double dparams[] = { 0.3560, 0.9930, 0.0085, 1.0002, 0.1290, 0.6500, 0.0100 };
+      steadyState = new Vector(n_endo);
+      *steadyState = VectorView(dYSparams, n_endo, 1);
+      deepParams = new Vector(7);
+      *deepParams = VectorView(dparams, 7, 1);
+      Q = new Matrix(n_exo);
+      Q->setAll(0.0);
+      (*Q)(0, 0) = 0.001256631601;
+      (*Q)(1, 1) = 0.000078535044;
+
+      // Matlab indices of order_var = [ stat_var(:); pred_var(:); both_var(:); fwrd_var(:)]
+      size_t statc[] = { 4, 5, 6, 8, 9, 10, 11, 12, 14};
+      size_t back[] = {1, 7, 13};
+      size_t fwd[] = { 3, 15};
+      for (int i = 0; i < 9; ++i)
+        zeta_static_arg.push_back(statc[i]-1);
+      for (int i = 0; i < 3; ++i)
+        zeta_back_arg.push_back(back[i]-1);
+      zeta_mixed_arg.push_back(1);
+      for (int i = 0; i < 2; ++i)
+        zeta_fwrd_arg.push_back(fwd[i]-1);
+      varobs_arg.push_back(11);
+      varobs_arg.push_back(10);
+    }
+  else if (model == "large")
+    {
+      n_endo = 200;
+      n_exo = 3;
+      steadyState = new Vector(n_endo);
+      steadyState->setAll(0.0);
+      deepParams = new Vector(2);
+      (*deepParams)(0) = 0.9;
+      (*deepParams)(1) = 0.05;
+      Q = new Matrix(n_exo);
+      mat::set_identity(*Q);
+      for (size_t i = 0; i < n_endo; ++i)
+        zeta_back_arg.push_back(i);
+      varobs_arg.push_back(0);
+      varobs_arg.push_back(n_endo/2-1);
+      varobs_arg.push_back(n_endo-1);
+    }
+  else
+    {
+      std::cerr << argv[0] << ": unknown model " << model << std::endl;
+      exit(EXIT_FAILURE);
+    }
+
+  size_t nobs = varobs_arg.size();
+  Matrix H(nobs);
+  H.setAll(0.0);
+  double qz_criterium = 1.000001, lyapunov_tol = 1e-16, riccati_tol = 1e-16;
+
+  Matrix y(nobs, nper); // dummy
+  y.setAll(0.2);
+  const MatrixConstView dataView(y, 0, 0, nobs, nper);
+  Vector vll(nper);
+  VectorView vllView(vll, 0, nper);
+  VectorView steadyStateView(*steadyState, 0, n_endo);
+
+  KalmanFilter kalman(modName, n_endo, n_exo, zeta_fwrd_arg, zeta_back_arg, zeta_mixed_arg, zeta_static_arg,
+                      qz_criterium, varobs_arg, riccati_tol, lyapunov_tol, true);
+  ChandrasekharFilter chandrasekhar(modName, n_endo, n_exo, zeta_fwrd_arg, zeta_back_arg, zeta_mixed_arg, zeta_static_arg,
+                                    qz_criterium, varobs_arg, riccati_tol, lyapunov_tol, true);
+
+  double tk, tc;
+  double llk = run(kalman, nrep, dataView, steadyStateView, *Q, H, *deepParams, vllView, tk);
+  double llc = run(chandrasekhar, nrep, dataView, steadyStateView, *Q, H, *deepParams, vllView, tc);
+
+  std::cout << "Kalman filter:         ll=" << llk << ", " << tk << "s for " << nrep << " evaluations" << std::endl
+            << "Chandrasekhar filter:  ll=" << llc << ", " << tc << "s for " << nrep << " evaluations" << std::endl;
+
+  delete steadyState;
+  delete deepParams;
+  delete Q;
+
+  return fabs(llk-llc) > 1e-6*(1+fabs(llk)) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,28 @@
+/* Backward-looking model with a large state vector and few observables, used
+   by benchmarkChandrasekhar to compare the Riccati and Chandrasekhar
+   recursions of the Kalman filter */
+
+@#define nstates = 200
+
+var @#for i in 1:nstates
+  x@{i}
+@#endfor
+;
+varexo e1 e2 e3;
+
+parameters rho phi;
+
+rho = 0.9;
+phi = 0.05;
+
+model (use_dll, linear);
+x1 = rho*x1(-1) + e1;
+x2 = rho*x2(-1) + phi*x1(-1) + e2;
+x3 = rho*x3(-1) + phi*x2(-1) + e3;
+@#for i in 4:nstates
+x@{i} = rho*x@{i}(-1) + phi*x@{i-1}(-1) + phi*x@{i-3}(-1);
+@#endfor
+end;
+
+steady;
+check;
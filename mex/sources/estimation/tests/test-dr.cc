@@ -21,7 +21,7 @@
  * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include "DecisionRules.hh"
+#include "DecisionRulesBatch.hh"
 
 int
 main(int argc, char **argv)
@@ -190,4 +190,75 @@ main(int argc, char **argv)
   mat::sub(real_g_u, g_u);
 
   assert(mat::nrminf(real_g_u) < 1e-12);
+
+  // Cycle reduction gives the same decision rules
+  DecisionRules dr_cr(endo_nbr, exo_nbr, zeta_fwrd, zeta_back, zeta_mixed,
+                      zeta_static, qz_criterium, 1e-13);
+  Matrix g_y_cr(6, 3), g_u_cr(6, 2);
+  dr_cr.compute(jacobian, g_y_cr, g_u_cr);
+  mat::sub(g_y_cr, g_y);
+  mat::sub(g_u_cr, g_u);
+  assert(mat::nrminf(g_y_cr) < 1e-10);
+  assert(mat::nrminf(g_u_cr) < 1e-10);
+
+  // Check the derivatives of the decision rules in the direction of a
+  // perturbation of the nonzero elements of the jacobian against central differences
+  Matrix d_jacobian(6, 14), jacobian_pert(6, 14), d_g_y(6, 3), d_g_u(6, 2),
+    g_y_plus(6, 3), g_u_plus(6, 2), g_y_minus(6, 3), g_u_minus(6, 2);
+  for (size_t j = 0; j < 14; j++)
+    for (size_t i = 0; i < 6; i++)
+      d_jacobian(i, j) = (jacobian(i, j) == 0 ? 0 : 0.1*((double) ((3*i + 5*j) % 7) - 3));
+  dr.compute(jacobian, g_y, g_u);
+  dr.computeDerivatives(jacobian, d_jacobian, g_y, g_u, d_g_y, d_g_u);
+
+  const double h = 1e-6;
+  for (size_t j = 0; j < 14; j++)
+    for (size_t i = 0; i < 6; i++)
+      jacobian_pert(i, j) = jacobian(i, j) + h*d_jacobian(i, j);
+  dr.compute(jacobian_pert, g_y_plus, g_u_plus);
+  for (size_t j = 0; j < 14; j++)
+    for (size_t i = 0; i < 6; i++)
+      jacobian_pert(i, j) = jacobian(i, j) - h*d_jacobian(i, j);
+  dr.compute(jacobian_pert, g_y_minus, g_u_minus);
+  mat::sub(g_y_plus, g_y_minus);
+  mat::sub(g_u_plus, g_u_minus);
+  for (size_t j = 0; j < 3; j++)
+    for (size_t i = 0; i < 6; i++)
+      g_y_plus(i, j) = g_y_plus(i, j)/(2*h) - d_g_y(i, j);
+  for (size_t j = 0; j < 2; j++)
+    for (size_t i = 0; i < 6; i++)
+      g_u_plus(i, j) = g_u_plus(i, j)/(2*h) - d_g_u(i, j);
+
+  std::cout << std::endl << "d_g_y = " << std::endl << d_g_y << std::endl
+            << "d_g_u = " << std::endl << d_g_u;
+  assert(mat::nrminf(g_y_plus) < 1e-6);
+  assert(mat::nrminf(g_u_plus) < 1e-6);
+
+  // Batch of three draws: the jacobian, a perturbed jacobian, and a jacobian
+  // whose lags are doubled, which has too many explosive roots
+  DecisionRulesBatch drb(endo_nbr, exo_nbr, zeta_fwrd, zeta_back, zeta_mixed,
+                         zeta_static, qz_criterium, 2);
+  assert(drb.getJacobianCols() == 14 && drb.getBackMixedNbr() == 3);
+  Matrix jacobians(6, 3*14), g_y_batch(6, 3*3), g_u_batch(6, 3*2);
+  DecisionRulesBatch::Info info[3];
+  for (size_t j = 0; j < 14; j++)
+    for (size_t i = 0; i < 6; i++)
+      {
+        jacobians(i, j) = jacobian(i, j);
+        jacobians(i, 14+j) = jacobian(i, j) + 0.01*d_jacobian(i, j);
+        jacobians(i, 28+j) = (j < 3 ? 2 : 1)*jacobian(i, j);
+      }
+  drb.compute(jacobians.getData(), 3, g_y_batch.getData(), g_u_batch.getData(), info);
+  assert(info[0] == DecisionRulesBatch::success && info[1] == DecisionRulesBatch::success
+         && info[2] == DecisionRulesBatch::noStableEquilibrium);
+  for (size_t d = 0; d < 2; d++)
+    {
+      jacobian_pert = MatrixView(jacobians, 0, 14*d, 6, 14);
+      dr.compute(jacobian_pert, g_y, g_u);
+      MatrixView g_y_d(g_y_batch, 0, 3*d, 6, 3), g_u_d(g_u_batch, 0, 2*d, 6, 2);
+      mat::sub(g_y_d, g_y);
+      mat::sub(g_u_d, g_u);
+      assert(mat::nrminf(g_y_d) == 0 && mat::nrminf(g_u_d) == 0);
+    }
+  assert(g_y_batch(0, 6) != g_y_batch(0, 6) && g_u_batch(0, 4) != g_u_batch(0, 4));
 }
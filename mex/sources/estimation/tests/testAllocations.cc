@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Checks that, once the objects are constructed, an evaluation of the log
+ * posterior density does not allocate memory on the heap, with both the
+ * standard and the Chandrasekhar Kalman filters. The model is either
+ * fs2000k2e.mod, or large_state.mod (200 states, 3 observables).
+ *
+ * Allocations are counted by replacing the global operator new and, with the
+ * GNU C library, malloc and friends (which are used by GSL and LAPACK, and by
+ * the replacement operator new, which then does not count itself).
+ */
+
+#include <cstdlib>
+#include <new>
+
+#include "LogPosteriorDensity.hh"
+
+namespace
+{
+  bool counting = false;
+  size_t nAllocations = 0;
+}
+
+void *
+operator new(size_t size) throw (std::bad_alloc)
+{
+#ifndef __GLIBC__
+  if (counting)
+    nAllocations++;
+#endif
+  void *p = malloc(size);
+  if (p == NULL)
+    throw std::bad_alloc();
+  return p;
+}
+
+void *
+operator new[](size_t size) throw (std::bad_alloc)
+{
+  return operator new(size);
+}
+
+void
+operator delete(void *p) throw ()
+{
+  free(p);
+}
+
+void
+operator delete[](void *p) throw ()
+{
+  free(p);
+}
+
+#ifdef __GLIBC__
+extern "C"
+{
+  void *__libc_malloc(size_t size);
+  void *__libc_calloc(size_t nmemb, size_t size);
+  void *__libc_realloc(void *ptr, size_t size);
+
+  void *
+  malloc(size_t size)
+  {
+    if (counting)
+      nAllocations++;
+    return __libc_malloc(size);
+  }
+
+  void *
+  calloc(size_t nmemb, size_t size)
+  {
+    if (counting)
+      nAllocations++;
+    return __libc_calloc(nmemb, size);
+  }
+
+  void *
+  realloc(void *ptr, size_t size)
+  {
+    if (counting)
+      nAllocations++;
+    return __libc_realloc(ptr, size);
+  }
+}
+#endif
+
+int
+main(int argc, char **argv)
+{
+  if (argc < 3)
+    {
+      std::cerr << argv[0] << ": please provide as arguments fs2000 or large, and the name of the dynamic DLL generated from fs2000k2e.mod or large_state.mod" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+
+  std::string model = argv[1], modName = argv[2];
+  const size_t nper = 192, nevals = 10;
+  size_t n_endo, n_exo;
+  std::vector<size_t> zeta_fwrd_arg, zeta_back_arg, zeta_mixed_arg, zeta_static_arg, varobs_arg;
+  Vector *steadyState, *deepParams, *estParams;
+  Matrix *Q;
+  std::vector<EstimatedParameter> estParamsInfo;
+  std::vector<size_t> subSampleIDs(1, 0);
+
+  if (model == "fs2000")
+    {
+      n_endo = 15;
+      n_exo = 2;
+      double dYSparams [] = {
+        1.000199998312523, 0.993250551764778, 1.006996670195112, 1, 2.718562165733039,
+        1.007250753636589, 18.982191739915155, 0.860847884886309, 0.316729149714572, 0.861047883198832,
+        1.00853622757204, 0.991734328394345, 1.355876776121869, 1.00853622757204, 0.992853374047708
+      };
+      double dparams[] = { 0.3560, 0.9930, 0.0085, 1.0002, 0.1290, 0.6500, 0.0100 };
+      steadyState = new Vector(n_endo);
+      *steadyState = VectorView(dYSparams, n_endo, 1);
+      deepParams = new Vector(7);
+      *deepParams = VectorView(dparams, 7, 1);
+
+      size_t statc[] = { 4, 5, 6, 8, 9, 10, 11, 12, 14};
+      size_t back[] = {1, 7, 13};
+      size_t fwd[] = { 3, 15};
+      for (int i = 0; i < 9; ++i)
+        zeta_static_arg.push_back(statc[i]-1);
+      for (int i = 0; i < 3; ++i)
+        zeta_back_arg.push_back(back[i]-1);
+      zeta_mixed_arg.push_back(1);
+      for (int i = 0; i < 2; ++i)
+        zeta_fwrd_arg.push_back(fwd[i]-1);
+      varobs_arg.push_back(11);
+      varobs_arg.push_back(10);
+
+      // alpha and the standard deviation of e_a
+      estParams = new Vector(2);
+      (*estParams)(0) = 0.356;
+      (*estParams)(1) = 0.035;
+      estParamsInfo.push_back(EstimatedParameter(EstimatedParameter::deepPar, 0, 0, subSampleIDs, 0.0, 1.0,
+                                                 Prior::constructPrior(Prior::Gaussian, 0.356, 0.02, 0.0, 1.0, 0.356, 0.02)));
+    }
+  else if (model == "large")
+    {
+      n_endo = 200;
+      n_exo = 3;
+      steadyState = new Vector(n_endo);
+      steadyState->setAll(0.0);
+      deepParams = new Vector(2);
+      (*deepParams)(0) = 0.9;
+      (*deepParams)(1) = 0.05;
+      for (size_t i = 0; i < n_endo; ++i)
+        zeta_back_arg.push_back(i);
+      // The shocks hit the first three states, the variance of the others is negligible
+      for (size_t i = 0; i < 3; ++i)
+        varobs_arg.push_back(i);
+
+      // rho and the standard deviation of e1
+      estParams = new Vector(2);
+      (*estParams)(0) = 0.9;
+      (*estParams)(1) = 1.0;
+      estParamsInfo.push_back(EstimatedParameter(EstimatedParameter::deepPar, 0, 0, subSampleIDs, -1.0, 1.0,
+                                                 Prior::constructPrior(Prior::Gaussian, 0.9, 0.05, -1.0, 1.0, 0.9, 0.05)));
+    }
+  else
+    {
+      std::cerr << argv[0] << ": unknown model " << model << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  estParamsInfo.push_back(EstimatedParameter(EstimatedParameter::shock_SD, 0, 0, subSampleIDs, 0.0, 10.0,
+                                             Prior::constructPrior(Prior::Gaussian, (*estParams)(1), 1.0, 0.0, 10.0,
+                                                                   (*estParams)(1), 1.0)));
+
+  Q = new Matrix(n_exo);
+  mat::set_identity(*Q);
+  MatrixView QView(*Q, 0, 0, n_exo, n_exo);
+  size_t nobs = varobs_arg.size();
+  Matrix H(nobs);
+  H.setAll(0.0);
+  double qz_criterium = 1.000001, lyapunov_tol = 1e-16, riccati_tol = 1e-16;
+
+  Matrix y(nobs, nper);
+  for (size_t t = 0; t < nper; ++t)
+    for (size_t i = 0; i < nobs; ++i)
+      y(i, t) = 0.01*sin(0.3*t + i);
+  const MatrixConstView dataView(y, 0, 0, nobs, nper);
+  VectorView steadyStateView(*steadyState, 0, n_endo), deepParamsView(*deepParams, 0, deepParams->getSize());
+
+  std::vector<EstimationSubsample> estSubsamples(1, EstimationSubsample(0, nper - 1));
+  EstimatedParametersDescription epd(estSubsamples, estParamsInfo);
+
+  bool ok = true;
+  const char *filterNames[] = { "Standard", "Chandrasekhar", "Square-root" };
+  for (int filter = 0; filter < 3; ++filter)
+    {
+      LogPosteriorDensity lpd(modName, epd, n_endo, n_exo, zeta_fwrd_arg, zeta_back_arg, zeta_mixed_arg, zeta_static_arg,
+                              qz_criterium, varobs_arg, riccati_tol, lyapunov_tol, true, filter == 1, filter == 2, 0.0);
+
+      // The first evaluation may trigger one-time allocations in the libraries (e.g. BLAS buffers)
+      double lpost = lpd.compute(steadyStateView, *estParams, deepParamsView, dataView, QView, H, 0);
+
+      nAllocations = 0;
+      counting = true;
+      for (size_t i = 0; i < nevals; ++i)
+        {
+          (*estParams)(0) *= 1.0001;
+          lpost = lpd.compute(steadyStateView, *estParams, deepParamsView, dataView, QView, H, 0);
+        }
+      counting = false;
+
+      std::cout << filterNames[filter] << " filter: log posterior=" << lpost << ", "
+                << nAllocations << " heap allocations in " << nevals << " evaluations" << std::endl;
+      if (nAllocations > 0)
+        ok = false;
+    }
+
+  for (size_t i = 0; i < estParamsInfo.size(); ++i)
+    delete estParamsInfo[i].prior;
+  delete steadyState;
+  delete deepParams;
+  delete estParams;
+  delete Q;
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
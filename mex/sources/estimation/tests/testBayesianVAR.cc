@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "BayesianVAR.hh"
+#include "BlasBindings.hh"
+#include "LapackBindings.hh"
+
+/* Prior or posterior computed as in bvar_toolbox.m, by stacking the
+   observations of the VAR with nlags lags (rows first-train to last, or
+   first-train to first-1) and the dummy observations */
+void
+reference(const Matrix &data, size_t first, size_t last, size_t train, size_t nlags, bool prefilter,
+          const BayesianVAR::PriorOptions &prior, bool posterior, BayesianVAR::NormalInverseWishart &niw)
+{
+  size_t ny = data.getCols(), nx = prefilter ? 0 : 1, k = ny*nlags + nx;
+  size_t start = first - train - nlags, end = posterior ? last : first - 1;
+  std::vector<double> mean(ny, 0.0), sig(ny), ybar(ny, 0.0);
+  if (prefilter)
+    for (size_t i = 0; i < ny; i++)
+      {
+        for (size_t t = start; t <= last; t++)
+          mean[i] += data(t, i);
+        mean[i] /= (double) (last - start + 1);
+      }
+  for (size_t i = 0; i < ny; i++)
+    {
+      double m = 0.0, v = 0.0;
+      for (size_t t = first - nlags; t <= first; t++)
+        m += data(t, i)/(nlags + 1);
+      for (size_t t = first - nlags; t <= first; t++)
+        v += (data(t, i) - m)*(data(t, i) - m)/nlags;
+      sig[i] = sqrt(v);
+      for (size_t t = start; t < start + nlags; t++)
+        ybar[i] += (data(t, i) - mean[i])/nlags;
+    }
+
+  std::vector<std::vector<double> > X, Y;
+  std::vector<double> x(k), y(ny);
+  for (size_t t = start + nlags; t <= end; t++)
+    {
+      for (size_t i = 0; i < ny; i++)
+        {
+          y[i] = data(t, i) - mean[i];
+          for (size_t l = 1; l <= nlags; l++)
+            x[(l-1)*ny + i] = data(t-l, i) - mean[i];
+        }
+      if (nx)
+        x[k-1] = 1.0;
+      X.push_back(x);
+      Y.push_back(y);
+    }
+  for (size_t i = 0; i < ny; i++)
+    for (size_t l = 1; l <= nlags; l++)
+      {
+        std::fill(x.begin(), x.end(), 0.0);
+        std::fill(y.begin(), y.end(), 0.0);
+        if (l == 1)
+          y[i] = prior.tau*sig[i];
+        x[(l-1)*ny + i] = prior.tau*pow((double) l, prior.decay)*sig[i];
+        X.push_back(x);
+        Y.push_back(y);
+      }
+  for (int w = 0; w < prior.omega; w++)
+    for (size_t i = 0; i < ny; i++)
+      {
+        std::fill(x.begin(), x.end(), 0.0);
+        std::fill(y.begin(), y.end(), 0.0);
+        y[i] = sig[i];
+        X.push_back(x);
+        Y.push_back(y);
+      }
+  std::fill(x.begin(), x.end(), 0.0);
+  for (size_t i = 0; i < ny; i++)
+    {
+      y[i] = prior.lambda*ybar[i];
+      for (size_t l = 0; l < nlags; l++)
+        x[l*ny + i] = prior.lambda*ybar[i];
+    }
+  if (nx)
+    x[k-1] = prior.lambda;
+  X.push_back(x);
+  Y.push_back(y);
+  for (size_t i = 0; i < ny; i++)
+    {
+      std::fill(x.begin(), x.end(), 0.0);
+      std::fill(y.begin(), y.end(), 0.0);
+      y[i] = prior.mu*ybar[i];
+      for (size_t l = 0; l < nlags; l++)
+        x[l*ny + i] = prior.mu*ybar[i];
+      X.push_back(x);
+      Y.push_back(y);
+    }
+
+  size_t T = X.size();
+  Matrix Xm(T, k), Ym(T, ny), U(T, ny);
+  for (size_t t = 0; t < T; t++)
+    {
+      for (size_t j = 0; j < k; j++)
+        Xm(t, j) = X[t][j];
+      for (size_t j = 0; j < ny; j++)
+        Ym(t, j) = Y[t][j];
+    }
+  blas::gemm("T", "N", 1.0, Xm, Xm, 0.0, niw.XXi);
+  lapack::choleskyInverse(niw.XXi);
+  Matrix XY(k, ny);
+  blas::gemm("T", "N", 1.0, Xm, Ym, 0.0, XY);
+  blas::gemm("N", "N", 1.0, niw.XXi, XY, 0.0, niw.PhiHat);
+  U = Ym;
+  blas::gemm("N", "N", -1.0, Xm, niw.PhiHat, 1.0, U);
+  blas::gemm("T", "N", 1.0, U, U, 0.0, niw.S);
+  niw.df = (double) T - (double) k - prior.flat*(ny+1);
+}
+
+double
+distance(const BayesianVAR::NormalInverseWishart &a, const BayesianVAR::NormalInverseWishart &b)
+{
+  Matrix S(a.S), XXi(a.XXi), PhiHat(a.PhiHat);
+  mat::sub(S, b.S);
+  mat::sub(XXi, b.XXi);
+  mat::sub(PhiHat, b.PhiHat);
+  return std::max(fabs(a.df - b.df), std::max(mat::nrminf(S)/mat::nrminf(b.S),
+                                              std::max(mat::nrminf(XXi)/mat::nrminf(b.XXi), mat::nrminf(PhiHat)/mat::nrminf(b.PhiHat))));
+}
+
+int
+main(int argc, char **argv)
+{
+  // Simulated VAR(1) with 3 variables
+  size_t ny = 3, T = 120;
+  Matrix data(T, ny);
+  srand(1);
+  for (size_t i = 0; i < ny; i++)
+    data(0, i) = 1.0 + i;
+  for (size_t t = 1; t < T; t++)
+    for (size_t i = 0; i < ny; i++)
+      data(t, i) = 0.2*(1.0 + i) + 0.8*data(t-1, i) + 0.1*data(t-1, (i+1) % ny)
+        + ((double) rand() / RAND_MAX - 0.5);
+
+  BayesianVAR::PriorOptions prior;
+  size_t first = 20, last = T - 5, train = 8, maxLags = 4;
+
+  for (int prefilter = 0; prefilter < 2; prefilter++)
+    {
+      BayesianVAR bvar(data, first, last, train, maxLags, true, prefilter, prior);
+      for (size_t nlags = 1; nlags <= maxLags; nlags++)
+        {
+          size_t k = bvar.getNumberOfRegressors(nlags);
+          BayesianVAR::NormalInverseWishart posterior(ny, k), prior_dist(ny, k), ref_posterior(ny, k), ref_prior(ny, k);
+          bvar.compute(nlags, posterior, prior_dist);
+          reference(data, first, last, train, nlags, prefilter, prior, true, ref_posterior);
+          reference(data, first, last, train, nlags, prefilter, prior, false, ref_prior);
+          double d = std::max(distance(posterior, ref_posterior), distance(prior_dist, ref_prior));
+          double ldens = BayesianVAR::logMarginalDensity(posterior, prior_dist);
+          std::cout << "prefilter=" << prefilter << ", nlags=" << nlags << ": log density=" << ldens
+                    << ", distance to the stacked regression=" << d << std::endl;
+          if (d > 1e-8 || !std::isfinite(ldens))
+            {
+              std::cerr << "Wrong prior or posterior" << std::endl;
+              exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+  // Forecasts: the draws do not depend on the number of threads
+  size_t nlags = 2, horizon = 8, draws = 4000;
+  BayesianVAR bvar(data, first, last, train, nlags, true, false, prior);
+  size_t k = bvar.getNumberOfRegressors(nlags);
+  BayesianVAR::NormalInverseWishart posterior(ny, k), prior_dist(ny, k);
+  bvar.compute(nlags, posterior, prior_dist);
+  Matrix initval(nlags, ny), xdata(horizon, 1);
+  initval = MatrixConstView(data, last - nlags + 1, 0, nlags, ny);
+  xdata.setAll(1.0);
+  Matrix noShock1(horizon*ny, draws), withShocks1(horizon*ny, draws), noShock2(horizon*ny, draws), withShocks2(horizon*ny, draws);
+  size_t explosive1 = BayesianVAR::forecast(posterior, nlags, initval, xdata, draws, 42, 1, noShock1, withShocks1);
+  size_t explosive2 = BayesianVAR::forecast(posterior, nlags, initval, xdata, draws, 42, 4, noShock2, withShocks2);
+  mat::sub(noShock2, noShock1);
+  mat::sub(withShocks2, withShocks1);
+  std::cout << "Explosive draws: " << explosive1 << std::endl;
+  if (explosive1 != explosive2 || mat::nrminf(noShock2) != 0 || mat::nrminf(withShocks2) != 0)
+    {
+      std::cerr << "The forecasts depend on the number of threads" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+
+  // The mean of the one step ahead forecasts without shocks is the forecast of the posterior mean
+  Vector X(k), y(ny);
+  for (size_t l = 1; l <= nlags; l++)
+    for (size_t i = 0; i < ny; i++)
+      X((l-1)*ny + i) = initval(nlags - l, i);
+  X(k-1) = 1.0;
+  blas::gemv("T", 1.0, posterior.PhiHat, X, 0.0, y);
+  for (size_t i = 0; i < ny; i++)
+    {
+      double m = 0.0, v = 0.0;
+      for (size_t d = 0; d < draws; d++)
+        m += noShock1(i*horizon, d)/draws;
+      for (size_t d = 0; d < draws; d++)
+        v += (noShock1(i*horizon, d) - m)*(noShock1(i*horizon, d) - m)/draws;
+      std::cout << "Variable " << i << ": mean forecast " << m << " (expected " << y(i) << ")" << std::endl;
+      if (fabs(m - y(i)) > 5*sqrt(v/draws))
+        {
+          std::cerr << "Wrong mean of the forecasts" << std::endl;
+          exit(EXIT_FAILURE);
+        }
+
+      // The one step ahead shocks have the covariance matrix E(Sigma) = S/(df-ny-1)
+      double var_shock = 0.0;
+      for (size_t d = 0; d < draws; d++)
+        var_shock += pow(withShocks1(i*horizon, d) - noShock1(i*horizon, d), 2)/draws;
+      double expected = posterior.S(i, i)/(posterior.df - ny - 1);
+      std::cout << "Variable " << i << ": variance of the shocks " << var_shock << " (expected " << expected << ")" << std::endl;
+      if (fabs(var_shock/expected - 1) > 0.1)
+        {
+          std::cerr << "Wrong variance of the shocks" << std::endl;
+          exit(EXIT_FAILURE);
+        }
+    }
+}
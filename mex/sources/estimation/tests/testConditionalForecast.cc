@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "ConditionalForecast.hh"
+#include "BlasBindings.hh"
+
+double
+uniform()
+{
+  return (double) rand() / RAND_MAX - 0.5;
+}
+
+int
+main(int argc, char **argv)
+{
+  size_t n = 6, nexo = 4, periods = 12, cL = 5, replic = 150;
+  srand(1);
+  Matrix T(n), R(n, nexo);
+  for (size_t i = 0; i < n; i++)
+    for (size_t j = 0; j < n; j++)
+      T(i, j) = 0.3*uniform();
+  for (size_t i = 0; i < n; i++)
+    for (size_t j = 0; j < nexo; j++)
+      R(i, j) = uniform();
+
+  std::vector<size_t> idx, jdx;
+  idx.push_back(1);
+  idx.push_back(4);
+  jdx.push_back(0);
+  jdx.push_back(2);
+  size_t nc = idx.size();
+
+  Matrix paths(nc, cL), shocks(nexo, periods*replic);
+  for (size_t i = 0; i < nc; i++)
+    for (size_t t = 0; t < cL; t++)
+      paths(i, t) = uniform();
+  for (size_t j = 0; j < periods*replic; j++)
+    for (size_t i = 0; i < nexo; i++)
+      shocks(i, j) = (i == jdx[0] || i == jdx[1]) ? 0.0 : uniform();
+
+  ConditionalForecast cf(T, R, idx, jdx);
+  Matrix forcs1(n, (periods+1)*replic), forcs2(n, (periods+1)*replic), e1(nc, cL*replic), e2(nc, cL*replic);
+  for (size_t b = 0; b < replic; b++)
+    for (size_t i = 0; i < n; i++)
+      forcs1(i, b*(periods+1)) = forcs2(i, b*(periods+1)) = uniform();
+  MatrixView f1(forcs1, 0, 0, n, (periods+1)*replic), f2(forcs2, 0, 0, n, (periods+1)*replic),
+    v1(e1, 0, 0, nc, cL*replic), v2(e2, 0, 0, nc, cL*replic);
+  MatrixConstView p(paths, 0, 0, nc, cL), s(shocks, 0, 0, nexo, periods*replic);
+  cf.simulate(cL, periods, replic, p, s, f1, v1, 1);
+  cf.simulate(cL, periods, replic, p, s, f2, v2, 4);
+
+  // The forecasts do not depend on the number of threads
+  mat::sub(forcs2, forcs1);
+  mat::sub(e2, e1);
+  if (mat::nrminf(forcs2) != 0 || mat::nrminf(e2) != 0)
+    {
+      std::cerr << "The forecasts depend on the number of threads" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+
+  // The constrained variables follow their paths, and the forecasts follow the state equation
+  double err_path = 0.0, err_state = 0.0;
+  Vector u(nexo), y(n);
+  for (size_t b = 0; b < replic; b++)
+    for (size_t t = 0; t < periods; t++)
+      {
+        for (size_t i = 0; i < nexo; i++)
+          u(i) = shocks(i, b*periods + t);
+        if (t < cL)
+          for (size_t i = 0; i < nc; i++)
+            {
+              u(jdx[i]) = e1(i, b*cL + t);
+              err_path = std::max(err_path, fabs(forcs1(idx[i], b*(periods+1) + t + 1) - paths(i, t)));
+            }
+        for (size_t i = 0; i < n; i++)
+          {
+            y(i) = forcs1(i, b*(periods+1) + t + 1);
+            for (size_t j = 0; j < n; j++)
+              y(i) -= T(i, j)*forcs1(j, b*(periods+1) + t);
+            for (size_t j = 0; j < nexo; j++)
+              y(i) -= R(i, j)*u(j);
+            err_state = std::max(err_state, fabs(y(i)));
+          }
+      }
+  std::cout << "Distance to the constrained paths: " << err_path << std::endl
+            << "Error in the state equation: " << err_state << std::endl;
+  if (err_path > 1e-10 || err_state > 1e-10)
+    {
+      std::cerr << "Wrong conditional forecasts" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+}
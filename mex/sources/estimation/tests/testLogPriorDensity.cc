@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Checks the log prior density against the logs of the Prior::pdf() of the parameters
+
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+
+#include "LogPriorDensity.hh"
+
+int
+main(int argc, char **argv)
+{
+  // Two parameters of each family, in interleaved order
+  std::vector<Prior *> priors;
+  priors.push_back(Prior::constructPrior(Prior::Beta, 0, 0, 0, 1, 2.5, 4.0));
+  priors.push_back(Prior::constructPrior(Prior::Gamma, 0, 0, 0, 1, 3.0, 0.5));
+  priors.push_back(Prior::constructPrior(Prior::Gaussian, 0, 0, -10, 10, 0.3, 0.2));
+  priors.push_back(Prior::constructPrior(Prior::Inv_gamma_1, 0, 0, 0, 1, 0.02, 4.0));
+  priors.push_back(Prior::constructPrior(Prior::Uniform, 0, 0, -1, 2, 0.0, 1.0));
+  priors.push_back(Prior::constructPrior(Prior::Inv_gamma_2, 0, 0, 0, 1, 0.5, 5.0));
+  priors.push_back(Prior::constructPrior(Prior::Beta, 0, 0, 0.5, 2, 1.0, 3.0));
+  priors.push_back(Prior::constructPrior(Prior::Gamma, 0, 0, 0.1, 1, 1.5, 2.0));
+  priors.push_back(Prior::constructPrior(Prior::Gaussian, 0, 0, 0, 10, 1.0, 1.5));
+  priors.push_back(Prior::constructPrior(Prior::Inv_gamma_1, 0, 0, 0.05, 1, 0.1, 2.0));
+  priors.push_back(Prior::constructPrior(Prior::Uniform, 0, 0, 0, 1, 0.2, 0.8));
+  priors.push_back(Prior::constructPrior(Prior::Inv_gamma_2, 0, 0, 0.1, 1, 1.0, 3.0));
+
+  std::vector<EstimationSubsample> subsamples(1, EstimationSubsample(0, 0));
+  std::vector<size_t> subsampleIDs(1, 0);
+  std::vector<EstimatedParameter> params;
+  for (size_t i = 0; i < priors.size(); i++)
+    params.push_back(EstimatedParameter(EstimatedParameter::deepPar, i, 0, subsampleIDs, -100, 100, priors[i]));
+  EstimatedParametersDescription desc(subsamples, params);
+  LogPriorDensity lpd(desc);
+
+  // Draws in the columns, the last one being outside of the support of the first prior
+  const size_t ndraws = 5;
+  Matrix draws(priors.size(), ndraws);
+  for (size_t j = 0; j < ndraws; j++)
+    {
+      double u = (j + 1.0)/(ndraws + 1);
+      draws(0, j) = j == ndraws-1 ? 1.5 : u;
+      draws(1, j) = 4*u;
+      draws(2, j) = u - 0.2;
+      draws(3, j) = 0.05 + u;
+      draws(4, j) = u;
+      draws(5, j) = 0.2 + u;
+      draws(6, j) = 0.5 + 1.5*u;
+      draws(7, j) = 0.1 + 3*u;
+      draws(8, j) = 3*u;
+      draws(9, j) = 0.1 + u;
+      draws(10, j) = 0.2 + 0.6*u;
+      draws(11, j) = 0.2 + 2*u;
+    }
+
+  int failures = 0;
+  Vector batch(ndraws);
+  lpd.computeBatch(draws, batch);
+  for (size_t j = 0; j < ndraws; j++)
+    {
+      double expected = 0;
+      for (size_t i = 0; i < priors.size(); i++)
+        if (priors[i]->getShape() != Prior::Beta || (draws(i, j) >= priors[i]->lower_bound && draws(i, j) <= priors[i]->upper_bound))
+          expected += log(priors[i]->pdf(draws(i, j)));
+        else
+          expected = -std::numeric_limits<double>::infinity(); // boost::math::pdf() throws outside of the support
+      VectorView draw(draws.getData() + j*draws.getLd(), priors.size(), 1);
+      double logPrior = lpd.compute(draw);
+      if (!(fabs(logPrior - expected) <= 1e-10*std::max(1.0, fabs(expected)) || logPrior == expected)
+          || batch(j) != logPrior)
+        {
+          std::cerr << "draw " << j << ": log prior density " << logPrior << " (batch: " << batch(j)
+                    << "), expected " << expected << std::endl;
+          failures++;
+        }
+    }
+
+  for (size_t i = 0; i < priors.size(); i++)
+    delete priors[i];
+
+  if (failures > 0)
+    {
+      std::cerr << failures << " failure(s)" << std::endl;
+      return EXIT_FAILURE;
+    }
+  std::cout << "All log prior densities are correct" << std::endl;
+  return EXIT_SUCCESS;
+}
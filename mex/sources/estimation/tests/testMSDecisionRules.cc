@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#include "MSDecisionRules.hh"
+
+/* Residual of the equations of the decision rules of regime s:
+   A_m(s) + A_0(s)*g_y(s) + A_p(s)*(sum_j P(s, j)*g_y_fwrd(j))*g_y_back(s) */
+double
+residual(size_t s, const std::vector<Matrix> &jacobians, const Matrix &P, const std::vector<Matrix> &g_y,
+         const std::vector<size_t> &zeta_fwrd_mixed, const std::vector<size_t> &zeta_back_mixed)
+{
+  size_t n = g_y[s].getRows(), nb = zeta_back_mixed.size(), nf = zeta_fwrd_mixed.size();
+  Matrix E(nf, nb), g_y_back(nb), EG(nf, nb), R(n, nb);
+  E.setAll(0.0);
+  for (size_t r = 0; r < P.getRows(); r++)
+    for (size_t i = 0; i < nf; i++)
+      for (size_t j = 0; j < nb; j++)
+        E(i, j) += P(s, r)*g_y[r](zeta_fwrd_mixed[i], j);
+  for (size_t i = 0; i < nb; i++)
+    mat::row_copy(g_y[s], zeta_back_mixed[i], g_y_back, i);
+  R = MatrixConstView(jacobians[s], 0, 0, n, nb);
+  blas::gemm("N", "N", 1.0, MatrixConstView(jacobians[s], 0, nb, n, n), g_y[s], 1.0, R);
+  blas::gemm("N", "N", 1.0, E, g_y_back, 0.0, EG);
+  blas::gemm("N", "N", 1.0, MatrixConstView(jacobians[s], 0, nb+n, n, nf), EG, 1.0, R);
+  return mat::nrminf(R);
+}
+
+int
+main(int argc, char **argv)
+{
+  size_t endo_nbr = 6, exo_nbr = 2;
+
+  // Same model as in test-dr
+  std::vector<size_t> zeta_fwrd, zeta_back, zeta_mixed, zeta_static, zeta_fwrd_mixed, zeta_back_mixed;
+  zeta_fwrd.push_back(0);
+  zeta_fwrd.push_back(1);
+  zeta_back.push_back(2);
+  zeta_back.push_back(3);
+  zeta_static.push_back(4);
+  zeta_mixed.push_back(5);
+  zeta_fwrd_mixed.push_back(0);
+  zeta_fwrd_mixed.push_back(1);
+  zeta_fwrd_mixed.push_back(5);
+  zeta_back_mixed.push_back(2);
+  zeta_back_mixed.push_back(3);
+  zeta_back_mixed.push_back(5);
+
+  double qz_criterium = 1.000001;
+
+  double jacob_data[] = {
+    0.000000000000000,
+    0.000000000000000,
+    -0.035101010101010,
+    -0.975000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    -0.950000000000000,
+    -0.025000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    -0.025000000000000,
+    -0.950000000000000,
+    -0.640000000000000,
+    0.000000000000000,
+    1.000000000000000,
+    -1.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.860681114551094,
+    -13.792569659442703,
+    0.000000000000000,
+    1.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.034750000000000,
+    0.000000000000000,
+    1.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    -1.080682530956729,
+    0.000000000000000,
+    1.000000000000000,
+    0.000000000000000,
+    2.370597639417809,
+    0.000000000000000,
+    -2.370597639417800,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    -11.083604432603581,
+    0.000000000000000,
+    -0.277090110815090,
+    0.000000000000000,
+    1.000000000000000,
+    0.000000000000000,
+    -0.356400000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    13.792569659442703,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    10.698449178570606,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    -1.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    0.000000000000000,
+    -1.000000000000000
+  };
+
+  Matrix jacobian(6, 14);
+  jacobian = MatrixView(jacob_data, 6, 14, 6);
+
+  DecisionRules dr(endo_nbr, exo_nbr, zeta_fwrd, zeta_back, zeta_mixed, zeta_static, qz_criterium);
+  Matrix g_y(6, 3), g_u(6, 2);
+  dr.compute(jacobian, g_y, g_u);
+
+  // Two regimes, the second one with less persistent exogenous processes
+  std::vector<Matrix> jacobians(2, jacobian), ms_g_y(2, Matrix(6, 3)), ms_g_u(2, Matrix(6, 2));
+  jacobians[1](4, 1) *= 0.5;
+  jacobians[1](5, 2) *= 0.5;
+  Matrix P(2);
+  P(0, 0) = 0.9;
+  P(0, 1) = 0.1;
+  P(1, 0) = 0.3;
+  P(1, 1) = 0.7;
+
+  Vector pi(2);
+  MSDecisionRules::ergodicDistribution(P, pi);
+  std::cout << "Ergodic distribution: " << pi;
+  if (fabs(pi(0) - 0.75) > 1e-12 || fabs(pi(1) - 0.25) > 1e-12)
+    {
+      std::cerr << "Wrong ergodic distribution" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+
+  MSDecisionRules msdr(endo_nbr, exo_nbr, zeta_fwrd, zeta_back, zeta_mixed, zeta_static, qz_criterium, 2, 2);
+
+  // With identical regimes, the constant-parameter solution is found at once
+  std::vector<Matrix> same_jacobians(2, jacobian);
+  size_t iter = msdr.compute(same_jacobians, P, ms_g_y, ms_g_u);
+  for (size_t s = 0; s < 2; s++)
+    {
+      mat::sub(ms_g_y[s], g_y);
+      mat::sub(ms_g_u[s], g_u);
+      if (iter > 2 || mat::nrminf(ms_g_y[s]) > 1e-10 || mat::nrminf(ms_g_u[s]) > 1e-10)
+        {
+          std::cerr << "The decision rules of identical regimes differ from the constant-parameter ones" << std::endl;
+          exit(EXIT_FAILURE);
+        }
+    }
+
+  iter = msdr.compute(jacobians, P, ms_g_y, ms_g_u);
+  std::cout << "Converged in " << iter << " iterations" << std::endl;
+  for (size_t s = 0; s < 2; s++)
+    {
+      double res = residual(s, jacobians, P, ms_g_y, zeta_fwrd_mixed, zeta_back_mixed);
+      std::cout << "Regime " << s+1 << ": residual = " << res << std::endl
+                << "g_y = " << std::endl << ms_g_y[s] << std::endl
+                << "g_u = " << std::endl << ms_g_u[s] << std::endl;
+      if (res > 1e-9)
+        {
+          std::cerr << "The decision rules of regime " << s+1 << " do not solve the model" << std::endl;
+          exit(EXIT_FAILURE);
+        }
+    }
+}
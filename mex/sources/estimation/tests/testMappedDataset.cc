@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Writes a dataset, maps it back and checks its contents
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+#include "MappedDataset.hh"
+
+int
+main(int argc, char **argv)
+{
+  const char *filename = "testMappedDataset.bin";
+  const size_t nvars = 3, nobs = 5;
+
+  // The observations are written from a view with a leading dimension larger than nvars
+  Matrix storage(nvars+2, nobs);
+  for (size_t t = 0; t < nobs; t++)
+    for (size_t i = 0; i < nvars+2; i++)
+      storage(i, t) = i < nvars ? 10.0*i + t : -1;
+  std::vector<std::string> names, dates;
+  names.push_back("y");
+  names.push_back("c");
+  names.push_back("inv");
+  for (size_t t = 0; t < nobs; t++)
+    dates.push_back(std::string("2000Q") + (char) ('1' + t));
+  MappedDataset::write(filename, names, dates, MatrixConstView(storage, 0, 0, nvars, nobs));
+
+  int failures = 0;
+  {
+    MappedDataset ds(filename);
+    if (ds.getNumberOfVariables() != nvars || ds.getNumberOfObservations() != nobs
+        || ds.getNames() != names || ds.getDates() != dates)
+      {
+        std::cerr << "wrong header" << std::endl;
+        failures++;
+      }
+    if (ds.getIndex("c") != 1 || ds.getIndex("k") != -1)
+      {
+        std::cerr << "wrong index" << std::endl;
+        failures++;
+      }
+    if ((size_t) ds.getData().getData() % 64 != 0)
+      {
+        std::cerr << "data is not aligned" << std::endl;
+        failures++;
+      }
+    MatrixConstView all = ds.getData();
+    for (size_t t = 0; t < nobs; t++)
+      for (size_t i = 0; i < nvars; i++)
+        if (all(i, t) != storage(i, t))
+          {
+            std::cerr << "wrong observation (" << i << "," << t << ")" << std::endl;
+            failures++;
+          }
+    MatrixConstView sub = ds.getData(1, 2, 2, 3);
+    if (sub.getRows() != 2 || sub.getCols() != 3 || sub(0, 0) != storage(1, 2) || sub(1, 2) != storage(2, 4))
+      {
+        std::cerr << "wrong sub view" << std::endl;
+        failures++;
+      }
+  }
+
+  // A truncated file is rejected
+  FILE *fd = fopen(filename, "r+b");
+  fseek(fd, 0, SEEK_END);
+  long size = ftell(fd);
+  fclose(fd);
+  std::vector<char> content(size);
+  fd = fopen(filename, "rb");
+  if (fread(&content[0], 1, size, fd) != (size_t) size)
+    failures++;
+  fclose(fd);
+  fd = fopen(filename, "wb");
+  fwrite(&content[0], 1, size - sizeof(double), fd);
+  fclose(fd);
+  try
+    {
+      MappedDataset ds(filename);
+      std::cerr << "truncated file accepted" << std::endl;
+      failures++;
+    }
+  catch (const std::runtime_error &e)
+    {
+    }
+  remove(filename);
+
+  if (failures > 0)
+    {
+      std::cerr << failures << " failures" << std::endl;
+      return EXIT_FAILURE;
+    }
+  std::cout << "MappedDataset: all tests passed" << std::endl;
+  return EXIT_SUCCESS;
+}
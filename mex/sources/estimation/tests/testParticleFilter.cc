@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Checks the particle filters on a linear Gaussian model, where the
+// likelihood is given by the Kalman filter
+
+#include <cstdlib>
+#include <cmath>
+#include <iostream>
+
+#include <boost/random/normal_distribution.hpp>
+
+#include "ParticleFilter.hh"
+
+const size_t m = 2, q = 2, T = 40;
+
+// Log-likelihood of the linear model x_t = ss + A*(x_t-1 - ss) + e_t, y_t = x_t + u_t
+double
+kalmanLogLikelihood(const Matrix &A, const Vector &ss, const Matrix &Q, const Matrix &H, const Matrix &data)
+{
+  // Stationary variance of the states, by fixed point iterations
+  Matrix P(m, m), Pnew(m, m);
+  P = Q;
+  for (int k = 0; k < 2000; ++k)
+    {
+      for (size_t i = 0; i < m; ++i)
+        for (size_t j = 0; j < m; ++j)
+          {
+            Pnew(i, j) = Q(i, j);
+            for (size_t k1 = 0; k1 < m; ++k1)
+              for (size_t k2 = 0; k2 < m; ++k2)
+                Pnew(i, j) += A(i, k1)*P(k1, k2)*A(j, k2);
+          }
+      P = Pnew;
+    }
+
+  double ll = 0.0;
+  Vector a(m), v(m);
+  a.setAll(0.0);
+  for (size_t t = 0; t < T; ++t)
+    {
+      // Prediction: a=A*a, P=A*P*A'+Q (P is the stationary variance for t=0)
+      if (t > 0)
+        {
+          Vector a_new(m);
+          for (size_t i = 0; i < m; ++i)
+            {
+              a_new(i) = 0.0;
+              for (size_t k = 0; k < m; ++k)
+                a_new(i) += A(i, k)*a(k);
+            }
+          a = a_new;
+          for (size_t i = 0; i < m; ++i)
+            for (size_t j = 0; j < m; ++j)
+              {
+                Pnew(i, j) = Q(i, j);
+                for (size_t k1 = 0; k1 < m; ++k1)
+                  for (size_t k2 = 0; k2 < m; ++k2)
+                    Pnew(i, j) += A(i, k1)*P(k1, k2)*A(j, k2);
+              }
+          P = Pnew;
+        }
+      // Update, with F=P+H inverted explicitly (2x2)
+      double F00 = P(0, 0)+H(0, 0), F01 = P(0, 1)+H(0, 1), F11 = P(1, 1)+H(1, 1);
+      double det = F00*F11 - F01*F01;
+      double Fi00 = F11/det, Fi01 = -F01/det, Fi11 = F00/det;
+      for (size_t i = 0; i < m; ++i)
+        v(i) = data(i, t) - ss(i) - a(i);
+      double vFv = v(0)*(Fi00*v(0) + Fi01*v(1)) + v(1)*(Fi01*v(0) + Fi11*v(1));
+      ll += -0.5*(m*log(2*M_PI) + log(det) + vFv);
+      // a=a+P*inv(F)*v, P=P-P*inv(F)*P
+      double K00 = P(0, 0)*Fi00 + P(0, 1)*Fi01, K01 = P(0, 0)*Fi01 + P(0, 1)*Fi11,
+        K10 = P(1, 0)*Fi00 + P(1, 1)*Fi01, K11 = P(1, 0)*Fi01 + P(1, 1)*Fi11;
+      a(0) += K00*v(0) + K01*v(1);
+      a(1) += K10*v(0) + K11*v(1);
+      Matrix KP(m, m);
+      KP(0, 0) = K00*P(0, 0) + K01*P(1, 0);
+      KP(0, 1) = K00*P(0, 1) + K01*P(1, 1);
+      KP(1, 0) = K10*P(0, 0) + K11*P(1, 0);
+      KP(1, 1) = K10*P(0, 1) + K11*P(1, 1);
+      mat::sub(P, KP);
+    }
+  return ll;
+}
+
+int
+main(int argc, char **argv)
+{
+  Matrix A(m, m), Q(m, m), H(m, m), data(m, T);
+  Vector ss(m);
+  A(0, 0) = 0.9;
+  A(0, 1) = 0.1;
+  A(1, 0) = 0.0;
+  A(1, 1) = 0.5;
+  Q(0, 0) = 1.0;
+  Q(0, 1) = 0.3;
+  Q(1, 0) = 0.3;
+  Q(1, 1) = 0.5;
+  H.setAll(0.0);
+  H(0, 0) = 0.2;
+  H(1, 1) = 0.1;
+  ss(0) = 1.0;
+  ss(1) = -2.0;
+
+  // Simulated data
+  Xoshiro256StarStar g(42);
+  boost::normal_distribution<double> normal;
+  double x[m] = { 0.0, 0.0 };
+  for (size_t t = 0; t < T; ++t)
+    {
+      double e0 = normal(g), e1 = normal(g);
+      double u0 = e0*sqrt(Q(0, 0)), u1 = e0*Q(0, 1)/sqrt(Q(0, 0)) + e1*sqrt(Q(1, 1) - Q(0, 1)*Q(0, 1)/Q(0, 0));
+      double x0 = A(0, 0)*x[0] + A(0, 1)*x[1] + u0, x1 = A(1, 0)*x[0] + A(1, 1)*x[1] + u1;
+      x[0] = x0;
+      x[1] = x1;
+      data(0, t) = ss(0) + x[0] + sqrt(H(0, 0))*normal(g);
+      data(1, t) = ss(1) + x[1] + sqrt(H(1, 1))*normal(g);
+    }
+  MatrixConstView dataView(data, 0, 0, m, T);
+
+  // Reduced form of the linear model
+  Matrix ghx(m, m), ghu(m, q), ghxx(m, m*m), ghuu(m, q*q), ghxu(m, m*q);
+  ghx = A;
+  mat::set_identity(ghu);
+  ghxx.setAll(0.0);
+  ghuu.setAll(0.0);
+  ghxu.setAll(0.0);
+  std::vector<size_t> mf0, mf1;
+  mf0.push_back(0);
+  mf0.push_back(1);
+  mf1 = mf0;
+
+  double llKalman = kalmanLogLikelihood(A, ss, Q, H, data);
+  std::cout << "Kalman filter: " << llKalman << std::endl;
+
+  Vector vll(T);
+  VectorView vllView(vll, 0, T);
+  const size_t nParticles = 20000;
+  double llSIR[2], llAPF;
+  for (int threads = 1; threads <= 2; ++threads)
+    {
+      ParticleFilter pf(m, q, mf0, mf1, nParticles, ParticleFilter::sequentialImportanceResampling,
+                        false, 0.5, false, 1e-15, threads);
+      pf.seed(1234, true);
+      llSIR[threads-1] = pf.compute(dataView, ghx, ghu, ss, ghxx, ghuu, ghxu, ss, Q, H, vllView, 0);
+      // Common random numbers: the same likelihood at each evaluation
+      assert(pf.compute(dataView, ghx, ghu, ss, ghxx, ghuu, ghxu, ss, Q, H, vllView, 0) == llSIR[threads-1]);
+    }
+  std::cout << "Bootstrap particle filter: " << llSIR[0] << std::endl;
+  // The draws do not depend on the number of threads
+  assert(llSIR[0] == llSIR[1]);
+  assert(fabs(llSIR[0] - llKalman) < 0.5);
+
+  ParticleFilter apf(m, q, mf0, mf1, nParticles, ParticleFilter::auxiliary, false, 0.5, true, 1e-15, 2);
+  apf.seed(1234, true);
+  llAPF = apf.compute(dataView, ghx, ghu, ss, ghxx, ghuu, ghxu, ss, Q, H, vllView, 0);
+  std::cout << "Auxiliary particle filter: " << llAPF << std::endl;
+  assert(fabs(llAPF - llKalman) < 0.5);
+
+  // Without second order terms, pruning does not change the particles
+  ParticleFilter ppf(m, q, mf0, mf1, nParticles, ParticleFilter::sequentialImportanceResampling,
+                     true, 0.5, false, 1e-15, 2);
+  ppf.seed(1234, true);
+  double llPruned = ppf.compute(dataView, ghx, ghu, ss, ghxx, ghuu, ghxu, ss, Q, H, vllView, 0);
+  assert(fabs(llPruned - llSIR[0]) < 1e-8);
+
+  // A presample is excluded from the likelihood
+  double llPresample = ppf.compute(dataView, ghx, ghu, ss, ghxx, ghuu, ghxu, ss, Q, H, vllView, 5);
+  double sum = 0.0;
+  for (size_t t = 5; t < T; ++t)
+    sum += vll(t);
+  assert(fabs(llPresample - sum) < 1e-8);
+
+  // With second order terms, pruning makes a difference
+  ghxx(0, 0) = 0.1;
+  ghuu(1, 3) = -0.05;
+  ghxu(0, 1) = 0.02;
+  double llPrunedSecondOrder = ppf.compute(dataView, ghx, ghu, ss, ghxx, ghuu, ghxu, ss, Q, H, vllView, 0);
+  ParticleFilter pf(m, q, mf0, mf1, nParticles, ParticleFilter::sequentialImportanceResampling,
+                    false, 0.5, false, 1e-15, 2);
+  pf.seed(1234, true);
+  double llSecondOrder = pf.compute(dataView, ghx, ghu, ss, ghxx, ghuu, ghxu, ss, Q, H, vllView, 0);
+  std::cout << "Second order: " << llSecondOrder << ", with pruning: " << llPrunedSecondOrder << std::endl;
+  assert(std::isfinite(llSecondOrder) && std::isfinite(llPrunedSecondOrder) && llSecondOrder != llPrunedSecondOrder);
+}
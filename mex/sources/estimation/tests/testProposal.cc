@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Checks the moments of the draws of the random walk, adaptive and randomized block proposals
+
+#include <cstdlib>
+#include <cmath>
+#include <iostream>
+
+#include "Proposal.hh"
+
+namespace
+{
+  int failures = 0;
+
+  void
+  check(const char *what, double value, double expected, double tol)
+  {
+    if (fabs(value - expected) > tol*(1 + fabs(expected)))
+      {
+        std::cerr << what << ": " << value << " instead of " << expected << std::endl;
+        failures++;
+      }
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  const size_t n = 3, ndraws = 200000;
+
+  Matrix D(n);
+  D(0, 0) = 1.0; D(0, 1) = 0.5; D(0, 2) = -0.2;
+  D(1, 0) = 0.5; D(1, 1) = 2.0; D(1, 2) = 0.3;
+  D(2, 0) = -0.2; D(2, 1) = 0.3; D(2, 2) = 0.5;
+  Vector jscale(n);
+  jscale(0) = 0.5; jscale(1) = 1.0; jscale(2) = 2.0;
+  Vector unit(n);
+  unit.setAll(1.0);
+  VectorConstView vJscale(jscale.getData(), n, 1), vUnit(unit.getData(), n, 1);
+  MatrixConstView vD(D.getData(), n, n, n);
+
+  // Streams of the same seed are distinct and reproducible
+  {
+    Xoshiro256StarStar a(42), b(42);
+    Xoshiro256StarStar c = b.split();
+    if (a != c || a == b || a() == b())
+      {
+        std::cerr << "split streams" << std::endl;
+        failures++;
+      }
+  }
+
+  // Random walk: the covariance of the increments is J*D*J
+  {
+    Proposal p(vJscale, vD);
+    p.seed(1, 0);
+    Vector mean(n), draw(n);
+    mean.setAll(0.0);
+    Matrix cov(n);
+    cov.setAll(0.0);
+    for (size_t k = 0; k < ndraws; k++)
+      {
+        p.draw(mean, draw);
+        for (size_t i = 0; i < n; i++)
+          for (size_t j = 0; j < n; j++)
+            cov(i, j) += draw(i)*draw(j)/ndraws;
+      }
+    for (size_t i = 0; i < n; i++)
+      for (size_t j = 0; j < n; j++)
+        check("random walk covariance", cov(i, j), jscale(i)*D(i, j)*jscale(j), 0.03);
+  }
+
+  // Adaptive proposal: fed with draws of N(0, D), its covariance converges to D
+  {
+    Proposal p(vJscale, vD);
+    p.seed(2, 0);
+    p.setAdaptive(10);
+    Vector zero(n), state(n);
+    zero.setAll(0.0);
+    Proposal target(vUnit, vD);
+    target.seed(3, 0);
+    for (size_t k = 0; k < ndraws; k++)
+      {
+        target.draw(zero, state);
+        p.adapt(state, 0.234);
+      }
+    Matrix &C = p.getVar();
+    for (size_t i = 0; i < n; i++)
+      for (size_t j = 0; j < n; j++)
+        {
+          double cov = 0;
+          for (size_t k = 0; k <= std::min(i, j); k++)
+            cov += C(k, i)*C(k, j);
+          check("adapted covariance", cov, D(i, j), 0.03);
+        }
+  }
+
+  // Randomized blocks: the blocks partition the parameters, and each block is
+  // drawn from the conditional proposal inflated by n/(block size)
+  {
+    Proposal p(vJscale, vD);
+    p.seed(4, 0);
+    p.setRandomBlocks(0.5);
+    Vector mean(n), draw(n);
+    for (size_t i = 0; i < n; i++)
+      mean(i) = i + 1.0;
+    size_t nblocks = 0;
+    for (size_t k = 0; k < 1000; k++)
+      {
+        p.drawBlocks();
+        const std::vector<std::vector<size_t> > &blocks = p.getBlocks();
+        std::vector<int> seen(n, 0);
+        for (size_t b = 0; b < blocks.size(); b++)
+          for (size_t i = 0; i < blocks[b].size(); i++)
+            seen[blocks[b][i]]++;
+        for (size_t i = 0; i < n; i++)
+          if (seen[i] != 1)
+            {
+              std::cerr << "blocks are not a partition" << std::endl;
+              failures++;
+            }
+        nblocks += blocks.size();
+      }
+    // Expected number of blocks: 1 + (n-1)*0.5
+    check("number of blocks", nblocks/1000.0, 2.0, 0.05);
+
+    // Block {2}: conditional variance given the other parameters, times n
+    Matrix S(n);
+    for (size_t i = 0; i < n; i++)
+      for (size_t j = 0; j < n; j++)
+        S(i, j) = jscale(i)*D(i, j)*jscale(j);
+    double s01 = S(0, 0)*S(1, 1) - S(0, 1)*S(0, 1);
+    double condVar = S(2, 2)
+      - (S(2, 0)*(S(1, 1)*S(0, 2) - S(0, 1)*S(1, 2)) + S(2, 1)*(S(0, 0)*S(1, 2) - S(0, 1)*S(0, 2)))/s01;
+    std::vector<size_t> block(1, 2);
+    double var = 0;
+    for (size_t k = 0; k < ndraws; k++)
+      {
+        p.drawBlock(block, mean, draw);
+        if (draw(0) != mean(0) || draw(1) != mean(1))
+          {
+            std::cerr << "parameters outside of the block were changed" << std::endl;
+            failures++;
+            break;
+          }
+        var += (draw(2)-mean(2))*(draw(2)-mean(2))/ndraws;
+      }
+    check("block variance", var, n*condVar, 0.03);
+  }
+
+  if (failures > 0)
+    {
+      std::cerr << failures << " failure(s)" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
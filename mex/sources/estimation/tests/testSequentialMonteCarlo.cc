@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Checks the SMC sampler on a Gaussian model with a conjugate prior, where
+// the posterior and the marginal density are known
+
+#include <cstdlib>
+#include <cmath>
+#include <iostream>
+
+#include "SequentialMonteCarlo.hh"
+
+// y_j ~ N(theta_j, sigma^2), with theta_j ~ N(0, 1)
+class GaussianWorker
+{
+public:
+  Vector y;
+  double sigma;
+
+  GaussianWorker(const Vector &y_arg, double sigma_arg) : y(y_arg), sigma(sigma_arg)
+  {
+  };
+  double
+  logLikelihood(VectorView &params)
+  {
+    double ll = 0;
+    for (size_t j = 0; j < y.getSize(); ++j)
+      ll += -0.5*log(2*M_PI*sigma*sigma) - 0.5*(y(j)-params(j))*(y(j)-params(j))/(sigma*sigma);
+    return ll;
+  };
+};
+
+double
+run(EstimatedParametersDescription &epd, const Vector &y, double sigma, size_t nThreads, Vector &mean)
+{
+  std::vector<GaussianWorker *> workers;
+  for (size_t t = 0; t < nThreads; ++t)
+    workers.push_back(new GaussianWorker(y, sigma));
+  SequentialMonteCarlo smc(epd, 4000, 12345);
+  double logMarginalDensity = smc.compute(workers);
+  const Matrix &particles = smc.getParticles();
+  mean.setAll(0.0);
+  for (size_t i = 0; i < particles.getCols(); ++i)
+    for (size_t j = 0; j < particles.getRows(); ++j)
+      mean(j) += particles(j, i)/particles.getCols();
+  for (size_t t = 0; t < nThreads; ++t)
+    delete workers[t];
+  std::cout << smc.getTemperatures().size() << " stages" << std::endl;
+  return logMarginalDensity;
+}
+
+int
+main(int argc, char **argv)
+{
+  const size_t npar = 2;
+  const double sigma = 0.5;
+  Vector y(npar);
+  y(0) = 1.0;
+  y(1) = -0.5;
+
+  std::vector<EstimationSubsample> subsamples(1, EstimationSubsample(0, 0));
+  std::vector<size_t> subsampleIDs(1, 0);
+  std::vector<EstimatedParameter> params;
+  for (size_t j = 0; j < npar; ++j)
+    params.push_back(EstimatedParameter(EstimatedParameter::deepPar, j, 0, subsampleIDs, -10, 10,
+                                        Prior::constructPrior(Prior::Gaussian, 0, 1, -10, 10, 0, 1)));
+  EstimatedParametersDescription epd(subsamples, params);
+
+  int failures = 0;
+
+  Vector mean(npar), mean4(npar);
+  double logMarginalDensity = run(epd, y, sigma, 1, mean);
+  double expected = 0;
+  for (size_t j = 0; j < npar; ++j)
+    {
+      expected += -0.5*log(2*M_PI*(1+sigma*sigma)) - 0.5*y(j)*y(j)/(1+sigma*sigma);
+      double postMean = y(j)/(1+sigma*sigma);
+      if (fabs(mean(j) - postMean) > 0.03)
+        {
+          std::cerr << "Posterior mean of parameter " << j << ": " << mean(j) << " instead of " << postMean << std::endl;
+          failures++;
+        }
+    }
+  if (fabs(logMarginalDensity - expected) > 0.05)
+    {
+      std::cerr << "Log marginal density: " << logMarginalDensity << " instead of " << expected << std::endl;
+      failures++;
+    }
+
+  // The draws do not depend on the number of threads
+  double logMarginalDensity4 = run(epd, y, sigma, 4, mean4);
+  if (logMarginalDensity4 != logMarginalDensity || mean4(0) != mean(0) || mean4(1) != mean(1))
+    {
+      std::cerr << "The results depend on the number of threads" << std::endl;
+      failures++;
+    }
+
+  for (size_t j = 0; j < npar; ++j)
+    delete params[j].prior;
+
+  if (failures > 0)
+    {
+      std::cerr << failures << " failure(s)" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -66,9 +66,9 @@ public:
     assert(modParams.getStride() == 1);
     assert(ySteady.getStride() == 1);
     assert(residual.getStride() == 1);
-    assert(g1->getLd() == g1->getRows());
-    assert(g2->getLd() == g2->getRows());
-    assert(g3->getLd() == g3->getRows());
+    assert(g1 == NULL || g1->getLd() == g1->getRows());
+    assert(g2 == NULL || g2->getLd() == g2->getRows());
+    assert(g3 == NULL || g3->getLd() == g3->getRows());
 
     Dynamic(y.getData(), x.getData(), 1, modParams.getData(), ySteady.getData(), 0, residual.getData(),
             g1 == NULL ? NULL : g1->getData(), g2 == NULL ? NULL : g2->getData(), g3 == NULL ? NULL : g3->getData());
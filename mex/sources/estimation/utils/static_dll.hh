@@ -64,8 +64,8 @@ public:
     assert(x.getLd() == x.getRows());
     assert(modParams.getStride() == 1);
     assert(residual.getStride() == 1);
-    assert(g1->getLd() == g1->getRows());
-    assert(v2->getLd() == v2->getRows());
+    assert(g1 == NULL || g1->getLd() == g1->getRows());
+    assert(v2 == NULL || v2->getLd() == v2->getRows());
 
     Static(y.getData(), x.getData(), 1, modParams.getData(), residual.getData(),
            g1 == NULL ? NULL : g1->getData(), v2 == NULL ? NULL : v2->getData());
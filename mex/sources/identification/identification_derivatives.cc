@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * [dA, dB, dOm, info] = identification_derivatives(GAM0, GAM1, A, B, Sigma_e, Dg0, Dg1, Dg2, Dg3, number_of_threads)
+ *
+ * Computes the derivatives of the first order solution y(t) = A*y(t-1) + B*e(t)
+ * of the model GAM0*y(t) = GAM1*y(t+1) + GAM2*y(t-1) + GAM3*e(t) with respect
+ * to the parameters, as the generalized Sylvester branch of getH.m.
+ * Dg0, Dg1, Dg2 and Dg3 are the m*m*p (m*n*p for Dg3) derivatives of the
+ * GAM matrices with respect to the p parameters, obtained from the
+ * analytical parameter derivatives of the dynamic model.
+ *
+ * For each parameter j, dA(:,:,j) solves
+ *   (GAM0-GAM1*A)*X - GAM1*X*A = Dg2(:,:,j) - (Dg0(:,:,j)-Dg1(:,:,j)*A)*A,
+ * and
+ *   dB(:,:,j) = inv(GAM0-GAM1*A)*(Dg3(:,:,j) - (Dg0(:,:,j)-Dg1(:,:,j)*A-GAM1*dA(:,:,j))*B)
+ *   dOm(:,:,j) = dB(:,:,j)*Sigma_e*B' + B*Sigma_e*dB(:,:,j)'
+ *
+ * The Sylvester equations share the decompositions of their left hand side,
+ * computed once by dynare++'s GeneralSylvesterDecomp, and the parameters are
+ * processed in parallel if compiled with OpenMP.
+ *
+ * info is 0 on success, 1 if a solution is not finite.
+ */
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <dynmex.h>
+#include <dynblas.h>
+#include <dynlapack.h>
+
+#include "GeneralSylvester.h"
+#include "SylvException.h"
+
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
+void
+mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+  if (nrhs != 10)
+    DYN_MEX_FUNC_ERR_MSG_TXT("identification_derivatives: exactly ten input arguments are required.");
+  if (nlhs > 4)
+    DYN_MEX_FUNC_ERR_MSG_TXT("identification_derivatives: at most four output arguments are returned.");
+
+  for (int i = 0; i < 9; i++)
+    if (!mxIsDouble(prhs[i]) || mxIsComplex(prhs[i]) || mxIsSparse(prhs[i]))
+      DYN_MEX_FUNC_ERR_MSG_TXT("identification_derivatives: the matrices must be real and dense.");
+
+  const size_t m = mxGetM(prhs[2]);
+  const size_t n = mxGetN(prhs[3]);
+  if (mxGetN(prhs[2]) != m || mxGetM(prhs[0]) != m || mxGetN(prhs[0]) != m
+      || mxGetM(prhs[1]) != m || mxGetN(prhs[1]) != m)
+    DYN_MEX_FUNC_ERR_MSG_TXT("identification_derivatives: GAM0, GAM1 and A must be square matrices of the same size.");
+  if (mxGetM(prhs[3]) != m || mxGetM(prhs[4]) != n || mxGetN(prhs[4]) != n)
+    DYN_MEX_FUNC_ERR_MSG_TXT("identification_derivatives: B must be m*n and Sigma_e n*n.");
+
+  const size_t p = mxGetNumberOfElements(prhs[5])/(m*m);
+  for (int i = 5; i < 8; i++)
+    if (mxGetM(prhs[i]) != m || mxGetNumberOfElements(prhs[i]) != m*m*p)
+      DYN_MEX_FUNC_ERR_MSG_TXT("identification_derivatives: Dg0, Dg1 and Dg2 must be m*m*p arrays.");
+  if (mxGetM(prhs[8]) != m || mxGetNumberOfElements(prhs[8]) != m*n*p)
+    DYN_MEX_FUNC_ERR_MSG_TXT("identification_derivatives: Dg3 must be an m*n*p array.");
+
+  int number_of_threads = static_cast<int>(mxGetScalar(prhs[9]));
+  if (number_of_threads < 1)
+    number_of_threads = 1;
+
+  const double *GAM0 = mxGetPr(prhs[0]);
+  const double *GAM1 = mxGetPr(prhs[1]);
+  const double *A = mxGetPr(prhs[2]);
+  const double *B = mxGetPr(prhs[3]);
+  const double *Sigma_e = mxGetPr(prhs[4]);
+  const double *Dg0 = mxGetPr(prhs[5]);
+  const double *Dg1 = mxGetPr(prhs[6]);
+  const double *Dg2 = mxGetPr(prhs[7]);
+  const double *Dg3 = mxGetPr(prhs[8]);
+
+  mwSize dims[3] = { (mwSize) m, (mwSize) m, (mwSize) p };
+  plhs[0] = mxCreateNumericArray(3, dims, mxDOUBLE_CLASS, mxREAL);
+  dims[1] = n;
+  mxArray *dB_mx = mxCreateNumericArray(3, dims, mxDOUBLE_CLASS, mxREAL);
+  dims[1] = m;
+  mxArray *dOm_mx = mxCreateNumericArray(3, dims, mxDOUBLE_CLASS, mxREAL);
+  double *dA = mxGetPr(plhs[0]);
+  double *dB = mxGetPr(dB_mx);
+  double *dOm = mxGetPr(dOm_mx);
+
+  const blas_int bm = m, bn = n;
+  const double one = 1.0, mone = -1.0, zero = 0.0;
+
+  // a = GAM0-GAM1*A, b = -GAM1, and the LU factors of a
+  std::vector<double> a(GAM0, GAM0+m*m), b(m*m), alu, SBt(n*m);
+  for (size_t i = 0; i < m*m; i++)
+    b[i] = -GAM1[i];
+  if (m > 0)
+    dgemm("N", "N", &bm, &bm, &bm, &mone, GAM1, &bm, A, &bm, &one, &a[0], &bm);
+  alu = a;
+  std::vector<lapack_int> ipiv(m);
+  lapack_int lm = m, linfo = 0;
+  if (m > 0)
+    dgetrf(&lm, &lm, &alu[0], &lm, &ipiv[0], &linfo);
+  if (linfo != 0)
+    DYN_MEX_FUNC_ERR_MSG_TXT("identification_derivatives: GAM0-GAM1*A is singular.");
+
+  // Sigma_e*B'
+  if (m > 0 && n > 0)
+    dgemm("N", "T", &bn, &bm, &bn, &one, Sigma_e, &bn, B, &bm, &zero, &SBt[0], &bn);
+
+  GeneralSylvesterDecomp *decomp = NULL;
+  SylvParams ps;
+  try
+    {
+      if (m > 0 && p > 0)
+        decomp = new GeneralSylvesterDecomp(m, m, 0, &a[0], &b[0], A, ps);
+    }
+  catch (const SylvException &e)
+    {
+      char mes[1000];
+      e.printMessage(mes, 999);
+      DYN_MEX_FUNC_ERR_MSG_TXT(mes);
+    }
+
+  bool failed = false;
+  std::string error_message;
+  int info = 0;
+
+#ifdef USE_OMP
+# pragma omp parallel num_threads(number_of_threads)
+#endif
+  {
+    std::vector<double> elem(m*m), rhs(m*n), y(m*m);
+
+#ifdef USE_OMP
+# pragma omp for schedule(dynamic)
+#endif
+    for (int j = 0; j < static_cast<int>(p); j++)
+      {
+        const double *Dg0j = Dg0 + j*m*m, *Dg1j = Dg1 + j*m*m, *Dg2j = Dg2 + j*m*m, *Dg3j = Dg3 + j*m*n;
+        double *x = dA + j*m*m, *dBj = dB + j*m*n, *dOmj = dOm + j*m*m;
+
+        // elem = Dg0-Dg1*A, x = Dg2-elem*A
+        memcpy(&elem[0], Dg0j, m*m*sizeof(double));
+        dgemm("N", "N", &bm, &bm, &bm, &mone, Dg1j, &bm, A, &bm, &one, &elem[0], &bm);
+        memcpy(x, Dg2j, m*m*sizeof(double));
+        dgemm("N", "N", &bm, &bm, &bm, &mone, &elem[0], &bm, A, &bm, &one, x, &bm);
+
+        bool ok = true;
+        try
+          {
+            GeneralSylvester sylv(1, *decomp, x, ps);
+            sylv.solve();
+          }
+        catch (const SylvException &e)
+          {
+            char mes[1000];
+            e.printMessage(mes, 999);
+#ifdef USE_OMP
+# pragma omp critical
+#endif
+            {
+              failed = true;
+              error_message = mes;
+            }
+            ok = false;
+          }
+        if (!ok)
+          continue;
+
+        // dB = inv(a)*(Dg3-(elem-GAM1*x)*B)
+        dgemm("N", "N", &bm, &bm, &bm, &mone, GAM1, &bm, x, &bm, &one, &elem[0], &bm);
+        memcpy(dBj, Dg3j, m*n*sizeof(double));
+        if (n > 0)
+          {
+            dgemm("N", "N", &bm, &bn, &bm, &mone, &elem[0], &bm, B, &bm, &one, dBj, &bm);
+            lapack_int ln = n, linfoj = 0;
+            dgetrs("N", &lm, &ln, &alu[0], &lm, &ipiv[0], dBj, &lm, &linfoj);
+
+            // dOm = dB*Sigma_e*B' + B*Sigma_e*dB'
+            dgemm("N", "N", &bm, &bm, &bn, &one, dBj, &bm, &SBt[0], &bn, &zero, &y[0], &bm);
+          }
+        for (size_t c = 0; c < m; c++)
+          for (size_t r = 0; r < m; r++)
+            dOmj[c*m+r] = y[c*m+r] + y[r*m+c];
+
+        bool finite = true;
+        for (size_t i = 0; i < m*m && finite; i++)
+          finite = mxIsFinite(x[i]) && mxIsFinite(dOmj[i]);
+        if (!finite)
+#ifdef USE_OMP
+# pragma omp critical
+#endif
+          info = 1;
+      }
+  }
+
+  delete decomp;
+
+  if (failed)
+    {
+      mxDestroyArray(dB_mx);
+      mxDestroyArray(dOm_mx);
+      DYN_MEX_FUNC_ERR_MSG_TXT(error_message.c_str());
+    }
+
+  if (nlhs > 1)
+    plhs[1] = dB_mx;
+  else
+    mxDestroyArray(dB_mx);
+  if (nlhs > 2)
+    plhs[2] = dOm_mx;
+  else
+    mxDestroyArray(dOm_mx);
+  if (nlhs > 3)
+    plhs[3] = mxCreateDoubleScalar(info);
+}
@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * [dGAM, info] = identification_moments_derivatives(A, GAM, dA, dOm, nlags, number_of_threads)
+ *
+ * Computes the derivatives of the autocovariances of y(t) = A*y(t-1) + e(t),
+ * var(e(t)) = Om, with respect to the parameters, given the derivatives dA
+ * and dOm (m*m*p arrays) of A and Om and the variance GAM of y, as getJJ.m.
+ *
+ * For each parameter j, dGAM(:,:,1,j) solves the Lyapunov equation
+ *   X - A*X*A' = dA(:,:,j)*GAM*A' + A*GAM*dA(:,:,j)' + dOm(:,:,j)
+ * and the derivatives of the autocovariances GAM_i = A^i*GAM are given by
+ *   dGAM(:,:,i+1,j) = A*dGAM(:,:,i,j) + dA(:,:,j)*A^(i-1)*GAM,  i = 1..nlags.
+ * Elements of the variance derivatives smaller than 1e-12 in absolute value
+ * are set to zero, as in getJJ.m.
+ *
+ * The Lyapunov equations are solved with dynare++'s GeneralSylvester, sharing
+ * one decomposition of A, and the parameters are processed in parallel if
+ * compiled with OpenMP.
+ *
+ * info is 0 on success, 1 if a solution is not finite (e.g. if A has unit
+ * roots, in which case getJJ.m falls back on lyapunov_symm).
+ */
+
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <dynmex.h>
+#include <dynblas.h>
+
+#include "GeneralSylvester.h"
+#include "SylvException.h"
+
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
+void
+mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+  if (nrhs != 6)
+    DYN_MEX_FUNC_ERR_MSG_TXT("identification_moments_derivatives: exactly six input arguments are required.");
+  if (nlhs > 2)
+    DYN_MEX_FUNC_ERR_MSG_TXT("identification_moments_derivatives: at most two output arguments are returned.");
+
+  for (int i = 0; i < 4; i++)
+    if (!mxIsDouble(prhs[i]) || mxIsComplex(prhs[i]) || mxIsSparse(prhs[i]))
+      DYN_MEX_FUNC_ERR_MSG_TXT("identification_moments_derivatives: the matrices must be real and dense.");
+
+  const size_t m = mxGetM(prhs[0]);
+  if (mxGetN(prhs[0]) != m || mxGetM(prhs[1]) != m || mxGetN(prhs[1]) != m)
+    DYN_MEX_FUNC_ERR_MSG_TXT("identification_moments_derivatives: A and GAM must be square matrices of the same size.");
+  const size_t p = m > 0 ? mxGetNumberOfElements(prhs[2])/(m*m) : 0;
+  if (mxGetM(prhs[2]) != m || mxGetNumberOfElements(prhs[2]) != m*m*p
+      || mxGetM(prhs[3]) != m || mxGetNumberOfElements(prhs[3]) != m*m*p)
+    DYN_MEX_FUNC_ERR_MSG_TXT("identification_moments_derivatives: dA and dOm must be m*m*p arrays.");
+
+  const int nlags_i = static_cast<int>(mxGetScalar(prhs[4]));
+  if (nlags_i < 0)
+    DYN_MEX_FUNC_ERR_MSG_TXT("identification_moments_derivatives: nlags must be non-negative.");
+  const size_t nlags = nlags_i;
+  int number_of_threads = static_cast<int>(mxGetScalar(prhs[5]));
+  if (number_of_threads < 1)
+    number_of_threads = 1;
+
+  const double *A = mxGetPr(prhs[0]);
+  const double *GAM = mxGetPr(prhs[1]);
+  const double *dA = mxGetPr(prhs[2]);
+  const double *dOm = mxGetPr(prhs[3]);
+
+  mwSize dims[4] = { (mwSize) m, (mwSize) m, (mwSize) (nlags+1), (mwSize) p };
+  plhs[0] = mxCreateNumericArray(4, dims, mxDOUBLE_CLASS, mxREAL);
+  double *dGAM = mxGetPr(plhs[0]);
+
+  const blas_int bm = m;
+  const double one = 1.0, zero = 0.0;
+  const size_t mm = m*m;
+
+  // Shared products: GAM*A', and A^i*GAM for i = 0..nlags-1
+  std::vector<double> GAMAt(mm), AiGAM(mm*nlags);
+  if (m > 0)
+    {
+      dgemm("N", "T", &bm, &bm, &bm, &one, GAM, &bm, A, &bm, &zero, &GAMAt[0], &bm);
+      if (nlags > 0)
+        memcpy(&AiGAM[0], GAM, mm*sizeof(double));
+      for (size_t i = 1; i < nlags; i++)
+        dgemm("N", "N", &bm, &bm, &bm, &one, A, &bm, &AiGAM[(i-1)*mm], &bm, &zero, &AiGAM[i*mm], &bm);
+    }
+
+  // X - A*X*A' = Q, i.e. I*X + (-A)*X*A' = Q
+  std::vector<double> eye(mm, 0.0), mA(mm), At(mm);
+  for (size_t i = 0; i < m; i++)
+    eye[i*m+i] = 1.0;
+  for (size_t c = 0; c < m; c++)
+    for (size_t r = 0; r < m; r++)
+      {
+        mA[c*m+r] = -A[c*m+r];
+        At[c*m+r] = A[r*m+c];
+      }
+
+  GeneralSylvesterDecomp *decomp = NULL;
+  SylvParams ps;
+  try
+    {
+      if (m > 0 && p > 0)
+        decomp = new GeneralSylvesterDecomp(m, m, 0, &eye[0], &mA[0], &At[0], ps);
+    }
+  catch (const SylvException &e)
+    {
+      char mes[1000];
+      e.printMessage(mes, 999);
+      DYN_MEX_FUNC_ERR_MSG_TXT(mes);
+    }
+
+  bool failed = false;
+  std::string error_message;
+  int info = 0;
+
+#ifdef USE_OMP
+# pragma omp parallel num_threads(number_of_threads)
+#endif
+  {
+    std::vector<double> T(mm);
+
+#ifdef USE_OMP
+# pragma omp for schedule(dynamic)
+#endif
+    for (int j = 0; j < static_cast<int>(p); j++)
+      {
+        const double *dAj = dA + j*mm, *dOmj = dOm + j*mm;
+        double *X = dGAM + j*mm*(nlags+1);
+
+        // Q = T + T' + dOm, with T = dA*GAM*A'
+        dgemm("N", "N", &bm, &bm, &bm, &one, dAj, &bm, &GAMAt[0], &bm, &zero, &T[0], &bm);
+        for (size_t c = 0; c < m; c++)
+          for (size_t r = 0; r < m; r++)
+            X[c*m+r] = T[c*m+r] + T[r*m+c] + dOmj[c*m+r];
+
+        bool ok = true;
+        try
+          {
+            GeneralSylvester sylv(1, *decomp, X, ps);
+            sylv.solve();
+          }
+        catch (const SylvException &e)
+          {
+            char mes[1000];
+            e.printMessage(mes, 999);
+#ifdef USE_OMP
+# pragma omp critical
+#endif
+            {
+              failed = true;
+              error_message = mes;
+            }
+            ok = false;
+          }
+        if (!ok)
+          continue;
+
+        bool finite = true;
+        for (size_t c = 0; c < m; c++)
+          for (size_t r = c; r < m; r++)
+            {
+              double x = 0.5*(X[c*m+r] + X[r*m+c]);
+              if (fabs(x) < 1e-12)
+                x = 0.0;
+              finite = finite && mxIsFinite(x);
+              X[c*m+r] = X[r*m+c] = x;
+            }
+        if (!finite)
+          {
+#ifdef USE_OMP
+# pragma omp critical
+#endif
+            info = 1;
+            continue;
+          }
+
+        // dGAM_i = A*dGAM_{i-1} + dA*A^(i-1)*GAM
+        for (size_t i = 1; i <= nlags; i++)
+          {
+            double *Xi = X + i*mm;
+            dgemm("N", "N", &bm, &bm, &bm, &one, A, &bm, Xi - mm, &bm, &zero, Xi, &bm);
+            dgemm("N", "N", &bm, &bm, &bm, &one, dAj, &bm, &AiGAM[(i-1)*mm], &bm, &one, Xi, &bm);
+          }
+      }
+  }
+
+  delete decomp;
+
+  if (failed)
+    DYN_MEX_FUNC_ERR_MSG_TXT(error_message.c_str());
+
+  if (nlhs > 1)
+    plhs[1] = mxCreateDoubleScalar(info);
+}
@@ -0,0 +1,340 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Run-time instrumentation shared by the MEX files: named counters, and
+ * timers attached to nested scopes.
+ *
+ * The instrumented code uses the two macros
+ *   INSTRUMENT_SCOPE("name");        times the rest of the enclosing C++ block
+ *   INSTRUMENT_COUNT("name", value); adds value to a counter
+ * Scopes nest: a scope opened while "outer" is active is recorded as
+ * "outer/inner". Scopes are only recorded outside of OpenMP parallel regions
+ * (and must only be opened from the thread that called mexFunction), while
+ * counters can be updated from anywhere.
+ *
+ * Instrumentation is off by default, in which case the macros only test a
+ * boolean; defining NO_INSTRUMENTATION at compile time removes them
+ * altogether. Each MEX file keeps its own profile, which persists across
+ * calls until the MEX file is cleared, and passes its arguments to
+ * Instrumentation::mexCommand() first, so that it can be controlled with:
+ *   mexname('instrumentation', 'on')     starts recording
+ *   mexname('instrumentation', 'off')    stops recording
+ *   mexname('instrumentation', 'reset')  clears the profile
+ *   s = mexname('instrumentation', 'get')
+ *     returns the profile as a structure with fields "timers" (name, calls,
+ *     seconds) and "counters" (name, value)
+ *   mexname('instrumentation', 'dump', filename)
+ *     writes the recorded scopes as a trace file in the Trace Event format
+ *     (which can be loaded in chrome://tracing)
+ * See also matlab/dynare_instrumentation.m, which does the same for all the
+ * instrumented MEX files at once. Outside of MEX files (e.g. in the test
+ * programs), the profile can still be enabled and dumped from C++.
+ */
+
+#ifndef _INSTRUMENTATION_HH
+#define _INSTRUMENTATION_HH
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#if defined(MATLAB_MEX_FILE) || defined(OCTAVE_MEX_FILE)
+# include <dynmex.h>
+#endif
+
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
+#if defined(_WIN32) || defined(__CYGWIN32__)
+# include <windows.h>
+#else
+# include <sys/time.h>
+#endif
+
+class Instrumentation
+{
+public:
+  //! Is instrumentation on? Only this flag is tested when it is off
+  bool enabled;
+
+  static Instrumentation &
+  instance()
+  {
+    static Instrumentation prof;
+    return prof;
+  }
+
+  void
+  count(const char *name, double value)
+  {
+#ifdef USE_OMP
+# pragma omp critical (instrumentation)
+#endif
+    counters[name] += value;
+  }
+
+  //! Opens a scope, returns false if it is not recorded
+  bool
+  enter(const char *name)
+  {
+#ifdef USE_OMP
+    if (omp_in_parallel())
+      return false;
+#endif
+    Frame f;
+    f.path = stack.empty() ? std::string(name) : stack.back().path + "/" + name;
+    f.start = now();
+    stack.push_back(f);
+    return true;
+  }
+
+  void
+  leave()
+  {
+    const Frame &f = stack.back();
+    double end = now();
+    Timer &t = timers[f.path];
+    t.calls++;
+    t.seconds += end-f.start;
+    if (events.size() < max_events)
+      {
+        Event e;
+        e.path = f.path;
+        e.start = f.start-origin;
+        e.duration = end-f.start;
+        e.depth = stack.size()-1;
+        events.push_back(e);
+      }
+    else
+      dropped_events++;
+    stack.pop_back();
+  }
+
+  void
+  reset()
+  {
+    counters.clear();
+    timers.clear();
+    events.clear();
+    dropped_events = 0;
+    origin = now();
+  }
+
+#if defined(MATLAB_MEX_FILE) || defined(OCTAVE_MEX_FILE)
+  //! Returns the profile as a MATLAB structure
+  mxArray *
+  toStruct() const
+  {
+    const char *timer_fields[] = { "name", "calls", "seconds" };
+    mxArray *mx_timers = mxCreateStructMatrix(timers.size(), 1, 3, timer_fields);
+    mwIndex i = 0;
+    for (std::map<std::string, Timer>::const_iterator it = timers.begin(); it != timers.end(); ++it, i++)
+      {
+        mxSetField(mx_timers, i, "name", mxCreateString(it->first.c_str()));
+        mxSetField(mx_timers, i, "calls", mxCreateDoubleScalar(it->second.calls));
+        mxSetField(mx_timers, i, "seconds", mxCreateDoubleScalar(it->second.seconds));
+      }
+    const char *counter_fields[] = { "name", "value" };
+    mxArray *mx_counters = mxCreateStructMatrix(counters.size(), 1, 2, counter_fields);
+    i = 0;
+    for (std::map<std::string, double>::const_iterator it = counters.begin(); it != counters.end(); ++it, i++)
+      {
+        mxSetField(mx_counters, i, "name", mxCreateString(it->first.c_str()));
+        mxSetField(mx_counters, i, "value", mxCreateDoubleScalar(it->second));
+      }
+    const char *fields[] = { "timers", "counters", "dropped_events" };
+    mxArray *s = mxCreateStructMatrix(1, 1, 3, fields);
+    mxSetField(s, 0, "timers", mx_timers);
+    mxSetField(s, 0, "counters", mx_counters);
+    mxSetField(s, 0, "dropped_events", mxCreateDoubleScalar(dropped_events));
+    return s;
+  }
+#endif
+
+  //! Writes the recorded scopes and the counters in the Trace Event format
+  bool
+  dumpTrace(const char *filename, const char *process_name) const
+  {
+    FILE *fd = fopen(filename, "w");
+    if (fd == NULL)
+      return false;
+    fprintf(fd, "{\"traceEvents\":[\n");
+    fprintf(fd, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"%s\"}}", process_name);
+    for (std::vector<Event>::const_iterator it = events.begin(); it != events.end(); ++it)
+      fprintf(fd, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"depth\":%d}}",
+              basename(it->path), process_name, 1e6*it->start, 1e6*it->duration, it->depth);
+    fprintf(fd, "\n],\n\"otherData\":{\"dropped_events\":\"%lu\"", dropped_events);
+    for (std::map<std::string, double>::const_iterator it = counters.begin(); it != counters.end(); ++it)
+      fprintf(fd, ",\"%s\":\"%.17g\"", it->first.c_str(), it->second);
+    fprintf(fd, "}}\n");
+    fclose(fd);
+    return true;
+  }
+
+#if defined(MATLAB_MEX_FILE) || defined(OCTAVE_MEX_FILE)
+  /* Handles the calls of the form mexname('instrumentation', ...), returns
+     false if the arguments are those of a regular call */
+  static bool
+  mexCommand(const char *mexname, int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+  {
+    /* No scope is open when mexFunction is entered, but a previous call may
+       have been interrupted by an error without closing its scopes */
+    instance().stack.clear();
+
+    if (nrhs < 1 || !mxIsChar(prhs[0]))
+      return false;
+    char *keyword = mxArrayToString(prhs[0]);
+    bool is_command = !strcmp(keyword, "instrumentation");
+    mxFree(keyword);
+    if (!is_command)
+      return false;
+
+    Instrumentation &prof = instance();
+    char *cmd = nrhs > 1 && mxIsChar(prhs[1]) ? mxArrayToString(prhs[1]) : NULL;
+    if (cmd == NULL)
+      mexErrMsgTxt("instrumentation: the second argument must be one of 'on', 'off', 'reset', 'get' or 'dump'");
+    std::string command(cmd);
+    mxFree(cmd);
+    if (command == "on")
+      {
+#ifdef NO_INSTRUMENTATION
+        mexWarnMsgTxt("instrumentation: this MEX file has been compiled without instrumentation");
+#endif
+        if (!prof.enabled && prof.timers.empty() && prof.counters.empty())
+          prof.origin = now();
+        prof.enabled = true;
+      }
+    else if (command == "off")
+      prof.enabled = false;
+    else if (command == "reset")
+      prof.reset();
+    else if (command == "get")
+      plhs[0] = prof.toStruct();
+    else if (command == "dump")
+      {
+        char *filename = nrhs > 2 && mxIsChar(prhs[2]) ? mxArrayToString(prhs[2]) : NULL;
+        if (filename == NULL)
+          mexErrMsgTxt("instrumentation: 'dump' expects a file name");
+        bool ok = prof.dumpTrace(filename, mexname);
+        mxFree(filename);
+        if (!ok)
+          mexErrMsgTxt("instrumentation: can't open the trace file");
+      }
+    else
+      mexErrMsgTxt("instrumentation: the second argument must be one of 'on', 'off', 'reset', 'get' or 'dump'");
+    if (nlhs > 0 && command != "get")
+      plhs[0] = mxCreateDoubleScalar(prof.enabled);
+    return true;
+  }
+#endif
+
+  //! Wall clock time, in seconds
+  static double
+  now()
+  {
+#if defined(_WIN32) || defined(__CYGWIN32__)
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return double (count.QuadPart)/double (frequency.QuadPart);
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec+1e-6*tv.tv_usec;
+#endif
+  }
+
+private:
+  struct Timer
+  {
+    double calls, seconds;
+    Timer() : calls(0), seconds(0)
+    {
+    };
+  };
+  struct Frame
+  {
+    std::string path;
+    double start;
+  };
+  struct Event
+  {
+    std::string path;
+    double start, duration;
+    int depth;
+  };
+  //! The trace is truncated beyond this number of scopes
+  static const size_t max_events = 1000000;
+
+  std::map<std::string, double> counters;
+  std::map<std::string, Timer> timers;
+  std::vector<Frame> stack;
+  std::vector<Event> events;
+  unsigned long dropped_events;
+  //! Time origin of the trace
+  double origin;
+
+  Instrumentation() : enabled(false), dropped_events(0), origin(now())
+  {
+  };
+
+  static const char *
+  basename(const std::string &path)
+  {
+    size_t pos = path.rfind('/');
+    return pos == std::string::npos ? path.c_str() : path.c_str()+pos+1;
+  }
+};
+
+//! Times the rest of the enclosing C++ block, when instrumentation is on
+class InstrumentationScope
+{
+public:
+  explicit InstrumentationScope(const char *name)
+  {
+    active = Instrumentation::instance().enabled && Instrumentation::instance().enter(name);
+  };
+  ~InstrumentationScope()
+  {
+    if (active)
+      Instrumentation::instance().leave();
+  };
+private:
+  bool active;
+};
+
+#ifdef NO_INSTRUMENTATION
+# define INSTRUMENT_SCOPE(name) do { } while (0)
+# define INSTRUMENT_COUNT(name, value) do { } while (0)
+#else
+# define INSTRUMENT_CONCAT_(a, b) a ## b
+# define INSTRUMENT_CONCAT(a, b) INSTRUMENT_CONCAT_(a, b)
+# define INSTRUMENT_SCOPE(name) InstrumentationScope INSTRUMENT_CONCAT(instrumentation_scope_, __LINE__)(name)
+# define INSTRUMENT_COUNT(name, value)                                  \
+  do {                                                                  \
+    if (Instrumentation::instance().enabled)                            \
+      Instrumentation::instance().count(name, value);                   \
+  } while (0)
+#endif
+
+#endif
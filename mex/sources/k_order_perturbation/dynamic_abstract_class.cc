@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2010-2014 Dynare Team
+ * Copyright (C) 2010-2017 Dynare Team
  *
  * This file is part of Dynare.
  *
@@ -33,40 +33,67 @@ DynamicModelAC::copyDoubleIntoTwoDMatData(double *dm, TwoDMatrix *tdm, int rows,
       tdm->get(i, j) = dm[dmIdx++];
 }
 
-double *
-DynamicModelAC::unpackSparseMatrix(mxArray *sparseMat)
+/* Writes the (row, column, value) triplets of the sparse matrix into tdm,
+   which has as many rows as the nonzero elements allocated in the sparse
+   matrix */
+void
+DynamicModelAC::unpackSparseMatrix(mxArray *sparseMat, TwoDMatrix *tdm)
 {
   int totalCols = mxGetN(sparseMat);
   mwIndex *rowIdxVector = mxGetIr(sparseMat);
   mwSize sizeRowIdxVector = mxGetNzmax(sparseMat);
   mwIndex *colIdxVector = mxGetJc(sparseMat);
 
+  assert((int) sizeRowIdxVector == tdm->nrows());
+  assert(tdm->ncols() == 3);
+
   double *ptr = mxGetPr(sparseMat);
-  double *newMat = (double *) malloc(sizeRowIdxVector*3*sizeof(double));
 
   int rind = 0;
-  int retvalind0 = 0;
-  int retvalind1 = sizeRowIdxVector;
-  int retvalind2 = sizeRowIdxVector*2;
-
   for (int i = 0; i < totalCols; i++)
     for (int j = 0; j < (int) (colIdxVector[i+1]-colIdxVector[i]); j++, rind++)
       {
-        newMat[retvalind0++] = rowIdxVector[rind] + 1;
-        newMat[retvalind1++] = i + 1;
-        newMat[retvalind2++] = ptr[rind];
+        tdm->get(rind, 0) = rowIdxVector[rind] + 1;
+        tdm->get(rind, 1) = i + 1;
+        tdm->get(rind, 2) = ptr[rind];
       }
 
   /* If there are less elements than Nzmax (that might happen if some
      derivative is symbolically not zero but numerically zero at the evaluation
      point), then fill in the matrix with empty entries, that will be
      recognized as such by KordpDynare::populateDerivativesContainer() */
-  while (retvalind0 < (int) sizeRowIdxVector)
+  for (; rind < (int) sizeRowIdxVector; rind++)
     {
-      newMat[retvalind0++] = 0;
-      newMat[retvalind1++] = 0;
-      newMat[retvalind2++] = 0;
+      tdm->get(rind, 0) = 0;
+      tdm->get(rind, 1) = 0;
+      tdm->get(rind, 2) = 0;
     }
+}
+
+void
+DynamicModelAC::checkBatchDimensions(const TwoDMatrix &y, const TwoDMatrix &x, const TwoDMatrix &residual,
+                                     const std::vector<TwoDMatrix *> &g1, const std::vector<TwoDMatrix *> &g2,
+                                     const std::vector<TwoDMatrix *> &g3) throw (DynareException)
+{
+  size_t npoints = y.ncols();
+  if ((size_t) x.nrows() != npoints || (size_t) residual.ncols() != npoints || g1.size() != npoints
+      || (!g2.empty() && g2.size() != npoints) || (!g3.empty() && g3.size() != npoints))
+    throw DynareException(__FILE__, __LINE__, "Inconsistent numbers of evaluation points");
+}
 
-  return newMat;
+void
+DynamicModelAC::evalBatch(const TwoDMatrix &y, const TwoDMatrix &x, const Vector &params, const Vector &ySteady,
+                          TwoDMatrix &residual, const std::vector<TwoDMatrix *> &g1,
+                          const std::vector<TwoDMatrix *> &g2, const std::vector<TwoDMatrix *> &g3) throw (DynareException)
+{
+  checkBatchDimensions(y, x, residual, g1, g2, g3);
+  Vector xj(x.ncols());
+  for (int j = 0; j < y.ncols(); j++)
+    {
+      Vector yj(y.base() + j*y.getLD(), y.nrows());
+      for (int k = 0; k < x.ncols(); k++)
+        xj[k] = x.get(j, k);
+      Vector residualj(residual, j);
+      eval(yj, xj, params, ySteady, residualj, g1[j], g2.empty() ? NULL : g2[j], g3.empty() ? NULL : g3[j]);
+    }
 }
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2010-2014 Dynare Team
+ * Copyright (C) 2010-2017 Dynare Team
  *
  * This file is part of Dynare.
  *
@@ -20,14 +20,42 @@
 #ifndef _DYNAMICMODELAC_HH
 #define _DYNAMICMODELAC_HH
 
+#include <vector>
+
 #include "k_ord_dynare.hh"
 
 class DynamicModelAC
 {
 public:
-  static double *unpackSparseMatrix(mxArray *sparseMatrix);
+  DynamicModelAC() : sparse_jacobian(false)
+  {
+  }
+  virtual ~DynamicModelAC()
+  {
+  }
+  /* Whether eval() and evalBatch() return the Jacobian as (row, column,
+     value) triplets with one row per nonzero element, like the Hessian,
+     instead of a dense matrix (sparse_jacobian option of the preprocessor) */
+  bool
+  hasSparseJacobian() const
+  {
+    return sparse_jacobian;
+  }
+  static void unpackSparseMatrix(mxArray *sparseMatrix, TwoDMatrix *tdm);
   static void copyDoubleIntoTwoDMatData(double *dm, TwoDMatrix *tdm, int rows, int cols);
   virtual void eval(const Vector &y, const Vector &x, const Vector &params, const Vector &ySteady,
                     Vector &residual, TwoDMatrix *g1, TwoDMatrix *g2, TwoDMatrix *g3) throw (DynareException) = 0;
+  /* Evaluates the model at several points: column j of y and row j of x are
+     the endogenous and exogenous variables of the j-th point, whose residuals
+     are stored in column j of residual and derivatives in g1[j], g2[j] and
+     g3[j] (g2 and g3 are empty if these derivatives are not requested) */
+  virtual void evalBatch(const TwoDMatrix &y, const TwoDMatrix &x, const Vector &params, const Vector &ySteady,
+                         TwoDMatrix &residual, const std::vector<TwoDMatrix *> &g1,
+                         const std::vector<TwoDMatrix *> &g2, const std::vector<TwoDMatrix *> &g3) throw (DynareException);
+protected:
+  bool sparse_jacobian;
+  static void checkBatchDimensions(const TwoDMatrix &y, const TwoDMatrix &x, const TwoDMatrix &residual,
+                                   const std::vector<TwoDMatrix *> &g1, const std::vector<TwoDMatrix *> &g2,
+                                   const std::vector<TwoDMatrix *> &g3) throw (DynareException);
 };
 #endif
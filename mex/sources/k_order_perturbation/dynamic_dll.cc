@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2008-2012 Dynare Team
+ * Copyright (C) 2008-2017 Dynare Team
  *
  * This file is part of Dynare.
  *
@@ -20,8 +20,78 @@
 #include "dynamic_dll.hh"
 
 #include <sstream>
+#include <map>
+#include <sys/stat.h>
 
-DynamicModelDLL::DynamicModelDLL(const string &modName) throw (DynareException)
+#include <dynmex.h>
+
+/* Process-wide cache of the loaded DLLs, indexed by file name */
+struct LoadedDynamicDLL
+{
+#if defined(_WIN32) || defined(__CYGWIN32__)
+  HINSTANCE handle;
+#else
+  void *handle;
+#endif
+  DynamicDLLFn Dynamic;
+  const int *g1_nnz, *g1_jc, *g1_ir;
+  time_t mtime;
+};
+
+static map<string, LoadedDynamicDLL> loaded_dynamic_dlls;
+
+/* Unloads the DLL taken from the cache. On Windows, a loaded DLL cannot be
+   overwritten by the next run of the preprocessor, hence it is also unloaded
+   when the DynamicModelDLL object is destroyed */
+static void
+unloadDynamicDLL(map<string, LoadedDynamicDLL>::iterator it)
+{
+#if defined(__CYGWIN32__) || defined(_WIN32)
+  bool result = FreeLibrary(it->second.handle);
+  loaded_dynamic_dlls.erase(it);
+  if (result == 0)
+    throw DynareException(__FILE__, __LINE__, string("Can't free the *_dynamic DLL"));
+#else
+  dlclose(it->second.handle);
+  loaded_dynamic_dlls.erase(it);
+#endif
+}
+
+void
+DynamicModelDLL::unloadAll()
+{
+  while (!loaded_dynamic_dlls.empty())
+    unloadDynamicDLL(loaded_dynamic_dlls.begin());
+}
+
+static void
+unloadAllAtExit()
+{
+  DynamicModelDLL::unloadAll();
+}
+
+/* Returns the address of a symbol of the DLL, or NULL if it does not export it */
+template<class T>
+static T
+findDynamicDLLSymbol(
+#if defined(_WIN32) || defined(__CYGWIN32__)
+                     HINSTANCE handle,
+#else
+                     void *handle,
+#endif
+                     const char *name)
+{
+#if defined(_WIN32) || defined(__CYGWIN32__)
+  return (T) GetProcAddress(handle, name);
+#else
+  dlerror();
+  void *symbol = dlsym(handle, name);
+  return dlerror() == NULL ? (T) symbol : NULL;
+#endif
+}
+
+DynamicModelDLL::DynamicModelDLL(const string &modName) throw (DynareException) :
+  g1_nnz(NULL), g1_jc(NULL), g1_ir(NULL)
 {
   string fName;
 #if !defined(__CYGWIN32__) && !defined(_WIN32)
@@ -29,6 +99,25 @@ DynamicModelDLL::DynamicModelDLL(const string &modName) throw (DynareException)
 #endif
   fName += modName + "_dynamic" + MEXEXT;
 
+  // Reuse the cached DLL, unless the file has been modified since it was loaded
+  struct stat fStat;
+  time_t mtime = (stat(fName.c_str(), &fStat) == 0 ? fStat.st_mtime : 0);
+  map<string, LoadedDynamicDLL>::iterator it = loaded_dynamic_dlls.find(fName);
+  if (it != loaded_dynamic_dlls.end())
+    {
+      if (it->second.mtime == mtime)
+        {
+          dynamicHinstance = it->second.handle;
+          Dynamic = it->second.Dynamic;
+          g1_nnz = it->second.g1_nnz;
+          g1_jc = it->second.g1_jc;
+          g1_ir = it->second.g1_ir;
+          sparse_jacobian = g1_nnz != NULL;
+          return;
+        }
+      unloadDynamicDLL(it);
+    }
+
   try
     {
 #if defined(__CYGWIN32__) || defined(_WIN32)
@@ -73,23 +162,73 @@ DynamicModelDLL::DynamicModelDLL(const string &modName) throw (DynareException)
     {
       throw DynareException(__FILE__, __LINE__, string("Can't find Dynamic function in ") + fName);
     }
+
+  g1_nnz = findDynamicDLLSymbol<const int *>(dynamicHinstance, "Dynamic_g1_nnz");
+  g1_jc = findDynamicDLLSymbol<const int *>(dynamicHinstance, "Dynamic_g1_jc");
+  g1_ir = findDynamicDLLSymbol<const int *>(dynamicHinstance, "Dynamic_g1_ir");
+  if (g1_nnz == NULL || g1_jc == NULL || g1_ir == NULL)
+    g1_nnz = g1_jc = g1_ir = NULL;
+  sparse_jacobian = g1_nnz != NULL;
+
+  if (loaded_dynamic_dlls.empty())
+    mexAtExit(unloadAllAtExit);
+  LoadedDynamicDLL loaded;
+  loaded.handle = dynamicHinstance;
+  loaded.Dynamic = Dynamic;
+  loaded.g1_nnz = g1_nnz;
+  loaded.g1_jc = g1_jc;
+  loaded.g1_ir = g1_ir;
+  loaded.mtime = mtime;
+  loaded_dynamic_dlls[fName] = loaded;
 }
 
 DynamicModelDLL::~DynamicModelDLL()
 {
 #if defined(__CYGWIN32__) || defined(_WIN32)
-  bool result = FreeLibrary(dynamicHinstance);
-  if (result == 0)
-    throw DynareException(__FILE__, __LINE__, string("Can't free the *_dynamic DLL"));
-#else
-  dlclose(dynamicHinstance);
+  for (map<string, LoadedDynamicDLL>::iterator it = loaded_dynamic_dlls.begin();
+       it != loaded_dynamic_dlls.end(); ++it)
+    if (it->second.handle == dynamicHinstance)
+      {
+        unloadDynamicDLL(it);
+        break;
+      }
 #endif
 }
 
+double *
+DynamicModelDLL::sparseJacobianValues(TwoDMatrix &g1) const throw (DynareException)
+{
+  if (g1.nrows() != *g1_nnz || g1.ncols() != 3)
+    throw DynareException(__FILE__, __LINE__, "The sparse Jacobian does not have the size of the pattern exported by the dynamic DLL");
+  int k = 0;
+  for (int j = 0; k < *g1_nnz; j++)
+    for (; k < g1_jc[j+1]; k++)
+      {
+        g1.get(k, 0) = g1_ir[k] + 1;
+        g1.get(k, 1) = j + 1;
+      }
+  // The Dynamic() function fills the third column
+  return g1.base() + 2*g1.getLD();
+}
+
 void
 DynamicModelDLL::eval(const Vector &y, const Vector &x, const Vector &modParams, const Vector &ySteady,
                       Vector &residual, TwoDMatrix *g1, TwoDMatrix *g2, TwoDMatrix *g3) throw (DynareException)
 {
-  Dynamic(y.base(), x.base(), 1, modParams.base(), ySteady.base(), 0, residual.base(), g1->base(),
+  Dynamic(y.base(), x.base(), 1, modParams.base(), ySteady.base(), 0, residual.base(),
+          sparse_jacobian ? sparseJacobianValues(*g1) : g1->base(),
           g2 == NULL ? NULL : g2->base(), g3 == NULL ? NULL : g3->base());
 }
+
+void
+DynamicModelDLL::evalBatch(const TwoDMatrix &y, const TwoDMatrix &x, const Vector &modParams, const Vector &ySteady,
+                           TwoDMatrix &residual, const std::vector<TwoDMatrix *> &g1,
+                           const std::vector<TwoDMatrix *> &g2, const std::vector<TwoDMatrix *> &g3) throw (DynareException)
+{
+  checkBatchDimensions(y, x, residual, g1, g2, g3);
+  // The rows of x are the exogenous variables of the successive points, selected by the it_ argument
+  for (int j = 0; j < y.ncols(); j++)
+    Dynamic(y.base() + j*y.getLD(), x.base(), x.getLD(), modParams.base(), ySteady.base(), j,
+            residual.base() + j*residual.getLD(), sparse_jacobian ? sparseJacobianValues(*g1[j]) : g1[j]->base(),
+            g2.empty() ? NULL : g2[j]->base(), g3.empty() ? NULL : g3[j]->base());
+}
@@ -41,6 +41,9 @@ typedef void (*DynamicDLLFn)(const double *y, const double *x, int nb_row_x, con
 /**
  * creates pointer to Dynamic function inside <model>_dynamic.dll
  * and handles calls to it.
+ * The loaded DLLs are kept in a process-wide cache, so that successive
+ * calls to the MEX do not load the same DLL again (it is reloaded if its
+ * modification time has changed).
  **/
 class DynamicModelDLL : public DynamicModelAC
 {
@@ -51,6 +54,10 @@ private:
 #else
   void *dynamicHinstance; // and in Linux or Mac
 #endif
+  // Sparsity pattern of the Jacobian, exported by the DLL with the sparse_jacobian option (0-based, compressed sparse column)
+  const int *g1_nnz, *g1_jc, *g1_ir;
+  // Writes the row and column indices of the Jacobian triplets, and returns a pointer to their values
+  double *sparseJacobianValues(TwoDMatrix &g1) const throw (DynareException);
 
 public:
   // construct and load Dynamic model DLL
@@ -60,5 +67,10 @@ public:
 
   void eval(const Vector &y, const Vector &x, const Vector &params, const Vector &ySteady,
             Vector &residual, TwoDMatrix *g1, TwoDMatrix *g2, TwoDMatrix *g3) throw (DynareException);
+  void evalBatch(const TwoDMatrix &y, const TwoDMatrix &x, const Vector &params, const Vector &ySteady,
+                 TwoDMatrix &residual, const std::vector<TwoDMatrix *> &g1,
+                 const std::vector<TwoDMatrix *> &g2, const std::vector<TwoDMatrix *> &g3) throw (DynareException);
+  // unload all the cached DLLs
+  static void unloadAll();
 };
 #endif
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2010-2011 Dynare Team
+ * Copyright (C) 2010-2017 Dynare Team
  *
  * This file is part of Dynare.
  *
@@ -19,9 +19,10 @@
 
 #include "dynamic_m.hh"
 
-DynamicModelMFile::DynamicModelMFile(const string &modName) throw (DynareException) :
+DynamicModelMFile::DynamicModelMFile(const string &modName, bool sparse_jacobian_arg) throw (DynareException) :
   DynamicMFilename(modName + "_dynamic")
 {
+  sparse_jacobian = sparse_jacobian_arg;
 }
 
 DynamicModelMFile::~DynamicModelMFile()
@@ -50,11 +51,18 @@ DynamicModelMFile::eval(const Vector &y, const Vector &x, const Vector &modParam
     throw DynareException(__FILE__, __LINE__, "Trouble calling " + DynamicMFilename);
 
   residual = Vector(mxGetPr(plhs[0]), residual.skip(), (int) mxGetM(plhs[0]));
-  copyDoubleIntoTwoDMatData(mxGetPr(plhs[1]), g1, (int) mxGetM(plhs[1]), (int) mxGetN(plhs[1]));
+  if (sparse_jacobian)
+    {
+      if (!mxIsSparse(plhs[1]))
+        throw DynareException(__FILE__, __LINE__, DynamicMFilename + " does not return a sparse Jacobian, please run the preprocessor again");
+      unpackSparseMatrix(plhs[1], g1);
+    }
+  else
+    copyDoubleIntoTwoDMatData(mxGetPr(plhs[1]), g1, (int) mxGetM(plhs[1]), (int) mxGetN(plhs[1]));
   if (g2 != NULL)
-    copyDoubleIntoTwoDMatData(unpackSparseMatrix(plhs[2]), g2, (int) mxGetNzmax(plhs[2]), 3);
+    unpackSparseMatrix(plhs[2], g2);
   if (g3 != NULL)
-    copyDoubleIntoTwoDMatData(unpackSparseMatrix(plhs[3]), g3, (int) mxGetNzmax(plhs[3]), 3);
+    unpackSparseMatrix(plhs[3], g3);
 
   for (int i = 0; i < nrhs_dynamic; i++)
     mxDestroyArray(prhs[i]);
@@ -36,7 +36,7 @@ private:
   const static int nlhs_dynamic = 4;
   const static int nrhs_dynamic = 5;
 public:
-  DynamicModelMFile(const string &modName) throw (DynareException);
+  DynamicModelMFile(const string &modName, bool sparse_jacobian_arg = false) throw (DynareException);
   virtual
   ~DynamicModelMFile();
   void eval(const Vector &y, const Vector &x, const Vector &params, const Vector &ySteady,
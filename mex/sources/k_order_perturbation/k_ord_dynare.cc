@@ -20,6 +20,7 @@
 // GP, based on work by O.Kamenik
 
 #include <vector>
+#include <algorithm>
 #include "first_order.h"
 #include "dynamic_abstract_class.hh"
 
@@ -47,7 +48,7 @@ KordpDynare::KordpDynare(const vector<string> &endo, int num_endo,
   nOrder(norder), journal(jr), ySteady(ysteady), params(inParams), vCov(vcov),
   md(1), dnl(*this, endo), denl(*this, exo), dsnl(*this, dnl, denl), ss_tol(sstol), varOrder(var_order),
   ll_Incidence(llincidence), qz_criterium(criterium), g1p(NULL),
-  g2p(NULL), g3p(NULL), dynamicModelFile(dynamicModelFile_arg)
+  g2p(NULL), g3p(NULL), g1Sparse(false), dynamicModelFile(dynamicModelFile_arg)
 {
   ReorderDynareJacobianIndices();
 
@@ -63,13 +64,14 @@ KordpDynare::KordpDynare(const vector<string> &endo, int num_endo,
                          const int nsteps, int norder,
                          Journal &jr, DynamicModelAC *dynamicModelFile_arg, double sstol,
                          const vector<int> &var_order, const TwoDMatrix &llincidence, double criterium,
-                         TwoDMatrix *g1_arg, TwoDMatrix *g2_arg, TwoDMatrix *g3_arg) throw (TLException) :
+                         TwoDMatrix *g1_arg, TwoDMatrix *g2_arg, TwoDMatrix *g3_arg,
+                         bool g1_sparse_arg) throw (TLException) :
   nStat(nstat), nBoth(nboth), nPred(npred), nForw(nforw), nExog(nexog), nPar(npar),
   nYs(npred + nboth), nYss(nboth + nforw), nY(num_endo), nJcols(jcols), NNZD(nnzd), nSteps(nsteps),
   nOrder(norder), journal(jr), ySteady(ysteady), params(inParams), vCov(vcov),
   md(1), dnl(*this, endo), denl(*this, exo), dsnl(*this, dnl, denl), ss_tol(sstol), varOrder(var_order),
   ll_Incidence(llincidence), qz_criterium(criterium),
-  g1p(g1_arg), g2p(g2_arg), g3p(g3_arg), dynamicModelFile(dynamicModelFile_arg)
+  g1p(g1_arg), g2p(g2_arg), g3p(g3_arg), g1Sparse(g1_sparse_arg), dynamicModelFile(dynamicModelFile_arg)
 {
   ReorderDynareJacobianIndices();
 
@@ -114,7 +116,12 @@ KordpDynare::calcDerivativesAtSteady()
 {
   if (g1p == NULL)
     {
-      g1p = new TwoDMatrix(nY, nJcols);
+      // A sparse Jacobian is stored as triplets, like the Hessian
+      g1Sparse = dynamicModelFile->hasSparseJacobian();
+      if (g1Sparse)
+        g1p = new TwoDMatrix((int) NNZD[0], 3);
+      else
+        g1p = new TwoDMatrix(nY, nJcols);
       g1p->zeros();
 
       if (nOrder > 1)
@@ -157,6 +164,27 @@ KordpDynare::calcDerivativesAtSteady()
     }
 }
 
+/* Entry of a folded derivative tensor, ordered by index and row */
+struct FoldedEntry
+{
+  int index[3];
+  int row;
+  double value;
+  bool
+  operator<(const FoldedEntry &e) const
+  {
+    for (int k = 0; k < 3; k++)
+      if (index[k] != e.index[k])
+        return index[k] < e.index[k];
+    return row < e.row;
+  }
+  bool
+  sameIndexAndRow(const FoldedEntry &e) const
+  {
+    return index[0] == e.index[0] && index[1] == e.index[1] && index[2] == e.index[2] && row == e.row;
+  }
+};
+
 /*******************************************************************************
  * populateDerivatives to sparse Tensor and fit it in the Derivatives Container
  *******************************************************************************/
@@ -164,12 +192,13 @@ void
 KordpDynare::populateDerivativesContainer(const TwoDMatrix &g, int ord, const vector<int> &vOrder)
 {
   // model derivatives FSSparseTensor instance
-  FSSparseTensor *mdTi = (new FSSparseTensor(ord, nJcols, nY));
+  FSSparseTensorBuilder *mdTi = new FSSparseTensorBuilder(ord, nJcols, nY);
 
   IntSequence s(ord, 0);
 
-  if (ord == 1)
+  if (ord == 1 && !g1Sparse)
     {
+      // The columns and then the rows are visited in increasing order
       for (int i = 0; i < g.ncols(); i++)
         {
           for (int j = 0; j < g.nrows(); j++)
@@ -180,75 +209,62 @@ KordpDynare::populateDerivativesContainer(const TwoDMatrix &g, int ord, const ve
               else
                 x = g.get(j, s[0]);
               if (x != 0.0)
-                mdTi->insert(s, j, x);
+                mdTi->append(s, j, x);
             }
           s[0]++;
         }
     }
-  else if (ord == 2)
+  else
     {
+      // Position in the Dynare++ ordering of each column of the Jacobian
       int nJcols1 = nJcols-nExog;
-      vector<int> revOrder(nJcols1);
+      vector<int> revOrder(nJcols);
       for (int i = 0; i < nJcols1; i++)
         revOrder[vOrder[i]] = i;
+      for (int i = nJcols1; i < nJcols; i++)
+        revOrder[i] = i;
+
+      /* The triplets of g contain all the permutations of the indices of each
+         derivative: only the ones with sorted indices are kept in the folded
+         tensor. A sparse Jacobian (ord == 1) is also given as triplets, whose
+         numerically zero elements are dropped as in the dense case */
+      vector<FoldedEntry> entries;
+      entries.reserve(g.nrows());
       for (int i = 0; i < g.nrows(); i++)
         {
-          int j = (int) g.get(i, 0)-1; // hessian indices start with 1
-          int i1 = (int) g.get(i, 1) -1;
-          if (j < 0 || i1 < 0)
+          int j = (int) g.get(i, 0)-1; // derivatives indices start with 1
+          int col = (int) g.get(i, 1)-1;
+          if (j < 0 || col < 0)
             continue; // Discard empty entries (see comment in DynamicModelAC::unpackSparseMatrix())
-          int s0 = i1 / nJcols;
-          int s1 = i1 % nJcols;
-          if (s0 < nJcols1)
-            s[0] = revOrder[s0];
-          else
-            s[0] = s0;
-          if (s1 < nJcols1)
-            s[1] = revOrder[s1];
-          else
-            s[1] = s1;
-          if (s[1] >= s[0])
+          FoldedEntry e;
+          e.index[0] = e.index[1] = e.index[2] = 0;
+          for (int k = ord-1; k >= 0; k--)
+            {
+              e.index[k] = revOrder[col % nJcols];
+              col /= nJcols;
+            }
+          if ((ord == 1 ? g.get(i, 2) != 0.0 : e.index[0] <= e.index[1])
+              && (ord <= 2 || e.index[1] <= e.index[2]))
             {
-              double x = g.get(i, 2);
-              mdTi->insert(s, j, x);
+              e.row = j;
+              e.value = g.get(i, 2);
+              entries.push_back(e);
             }
         }
-    }
-  else if (ord == 3)
-    {
-      int nJcols1 = nJcols-nExog;
-      int nJcols2 = nJcols*nJcols;
-      vector<int> revOrder(nJcols1);
-      for (int i = 0; i < nJcols1; i++)
-        revOrder[vOrder[i]] = i;
-      for (int i = 0; i < g.nrows(); i++)
+
+      sort(entries.begin(), entries.end());
+      for (size_t i = 0; i < entries.size(); i++)
         {
-          int j = (int) g.get(i, 0)-1;
-          int i1 = (int) g.get(i, 1) -1;
-          if (j < 0 || i1 < 0)
-            continue; // Discard empty entries (see comment in DynamicModelAC::unpackSparseMatrix())
-          int s0 = i1 / nJcols2;
-          int i2 = i1 % nJcols2;
-          int s1 = i2 / nJcols;
-          int s2 = i2 % nJcols;
-          if (s0 < nJcols1)
-            s[0] = revOrder[s0];
-          else
-            s[0] = s0;
-          if (s1 < nJcols1)
-            s[1] = revOrder[s1];
-          else
-            s[1] = s1;
-          if (s2 < nJcols1)
-            s[2] = revOrder[s2];
-          else
-            s[2] = s2;
-          double x = g.get(i, 2);
-          if (s.isSorted())
-            mdTi->insert(s, j, x);
+          TL_RAISE_IF(i > 0 && entries[i].sameIndexAndRow(entries[i-1]),
+                      "Duplicate <key, r> insertion in KordpDynare::populateDerivativesContainer");
+          for (int k = 0; k < ord; k++)
+            s[k] = entries[i].index[k];
+          mdTi->append(s, entries[i].row, entries[i].value);
         }
     }
 
+  mdTi->freeze();
+
   // md container
   md.remove(Symmetry(ord));
   md.insert(mdTi);
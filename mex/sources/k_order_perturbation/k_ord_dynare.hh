@@ -20,6 +20,7 @@
 #ifndef K_ORD_DYNARE3_H
 #define K_ORD_DYNARE3_H
 #include <vector>
+#include <cmath>
 #include "t_container.h"
 #include "sparse_tensor.h"
 #include "decision_rule.h"
@@ -73,6 +74,30 @@ public:
     return names[i].c_str();
   }
 };
+/* Folded sparse tensor filled with entries sorted by index and row, which are
+   appended at the end of the map in constant time, without the lookup and the
+   uniqueness check of FSSparseTensor::insert() */
+class FSSparseTensorBuilder : public FSSparseTensor
+{
+public:
+  FSSparseTensorBuilder(int d, int nvar, int r) : FSSparseTensor(d, nvar, r)
+  {
+  }
+  void
+  append(const IntSequence &s, int r, double c)
+  {
+    TL_RAISE_IF(r < 0 || r >= nr,
+                "Row number out of dimension of tensor in FSSparseTensorBuilder::append");
+    TL_RAISE_IF(!std::isfinite(c),
+                "Insertion of non-finite value in FSSparseTensorBuilder::append");
+    m.insert(m.end(), Map::value_type(s, Item(r, c)));
+    if (first_nz_row > r)
+      first_nz_row = r;
+    if (last_nz_row < r)
+      last_nz_row = r;
+  }
+};
+
 /*********************************************/
 // The following only implements DynamicModel with help of ogdyn::DynareModel
 // instantiation of pure abstract DynamicModel decl. in dynamic_model.h
@@ -117,6 +142,7 @@ class KordpDynare : public DynamicModel
   TwoDMatrix *g1p;
   TwoDMatrix *g2p;
   TwoDMatrix *g3p;
+  bool g1Sparse; // Whether g1p holds the (row, column, value) triplets of the Jacobian
 public:
   KordpDynare(const vector<string> &endo, int num_endo,
               const vector<string> &exo, int num_exo, int num_par,
@@ -133,7 +159,8 @@ public:
               const int nSteps, const int ord,
               Journal &jr, DynamicModelAC *dynamicModelFile_arg, double sstol,
               const vector<int> &varOrder, const TwoDMatrix &ll_Incidence,
-              double qz_criterium, TwoDMatrix *g1_arg, TwoDMatrix *g2_arg, TwoDMatrix *g3_arg) throw (TLException);
+              double qz_criterium, TwoDMatrix *g1_arg, TwoDMatrix *g2_arg, TwoDMatrix *g3_arg,
+              bool g1_sparse_arg = false) throw (TLException);
 
   virtual
   ~KordpDynare();
@@ -33,15 +33,18 @@
 
 #include "dynamic_m.hh"
 #include "dynamic_dll.hh"
+#include <instrumentation.hh>
 
 #include <cmath>
 #include <cstring>
 #include <cctype>
 #include <cassert>
+#include <algorithm>
 
 #if defined(MATLAB_MEX_FILE) || defined(OCTAVE_MEX_FILE)  // exclude mexFunction for other applications
 
 # include "dynmex.h"
+# include "tl_mxarray.hh"
 
 //////////////////////////////////////////////////////
 // Convert MATLAB Dynare endo and exo names array to a vector<string> array of string pointers
@@ -62,15 +65,39 @@ DynareMxArrayToString(const mxArray *mxFldp, const int len, const int width, vec
         out[j] += cNamesCharStr[j+i*len];
 }
 
+/* Part of the model kept between successive calls of the MEX (e.g. for each
+   parameter draw of an estimation), which does not depend on the parameters */
+struct KOrderContext
+{
+  vector<mxChar> rawEndoNames, rawExoNames;
+  vector<string> endoNames, exoNames;
+  int tlsOrder, tlsNvars; // dimensions for which the tensor library has been initialized
+  KOrderContext() : tlsOrder(0), tlsNvars(0)
+  {
+  }
+};
+
+static KOrderContext context;
+
+/* Converts the names, unless they are the same as in the previous call */
+const vector<string> &
+cachedNames(const mxArray *mxFldp, const int len, const int width, vector<mxChar> &raw, vector<string> &names)
+{
+  const mxChar *chars = mxGetChars(mxFldp);
+  size_t n = (size_t) len*width;
+  if (raw.size() != n || (int) names.size() != len || !equal(raw.begin(), raw.end(), chars))
+    {
+      raw.assign(chars, chars+n);
+      names.clear();
+      DynareMxArrayToString(mxFldp, len, width, names);
+    }
+  return names;
+}
+
 void
 copy_derivatives(mxArray *destin, const Symmetry &sym, const FGSContainer *derivs, const std::string &fieldname)
 {
-  const TwoDMatrix *x = derivs->get(sym);
-  int n = x->numRows();
-  int m = x->numCols();
-  mxArray *tmp = mxCreateDoubleMatrix(n, m, mxREAL);
-  memcpy(mxGetPr(tmp), x->getData().base(), n*m*sizeof(double));
-  mxSetField(destin, 0, fieldname.c_str(), tmp);
+  mxSetField(destin, 0, fieldname.c_str(), mxCreateFromTwoDMatrix(*(derivs->get(sym))));
 }
 
 extern "C" {
@@ -79,6 +106,10 @@ extern "C" {
   mexFunction(int nlhs, mxArray *plhs[],
               int nrhs, const mxArray *prhs[])
   {
+    if (Instrumentation::mexCommand("k_order_perturbation", nlhs, plhs, nrhs, prhs))
+      return;
+    INSTRUMENT_SCOPE("k_order_perturbation");
+
     if (nrhs < 3 || nlhs < 2)
       DYN_MEX_FUNC_ERR_MSG_TXT("Must have at least 3 input parameters and takes at least 2 output parameters.");
 
@@ -110,24 +141,29 @@ extern "C" {
     if (mxGetNumberOfElements(mxFldp) > 0 && mxIsNumeric(mxFldp))
       qz_criterium = (double) mxGetScalar(mxFldp);
 
+    /* keep the decompositions of the Sylvester equation for the next call,
+       useful in estimation when the first order solution does not change */
+    mxFldp = mxGetField(options_, 0, "k_order_reuse_sylvester");
+    if (mxFldp != NULL && mxGetNumberOfElements(mxFldp) > 0
+        && (mxIsNumeric(mxFldp) || mxIsLogical(mxFldp)))
+      KOrder::reuse_sylvester = (mxGetScalar(mxFldp) != 0);
+    else
+      KOrder::reuse_sylvester = false;
+    if (!KOrder::reuse_sylvester)
+      KOrder::clearSylvesterCache();
+
     mxFldp = mxGetField(M_, 0, "params");
-    double *dparams = mxGetPr(mxFldp);
-    int npar = (int) mxGetM(mxFldp);
-    Vector modParams(dparams, npar);
+    MxVector modParams(mxFldp);
     if (!modParams.isFinite())
       DYN_MEX_FUNC_ERR_MSG_TXT("The parameters vector contains NaN or Inf");
 
     mxFldp = mxGetField(M_, 0, "Sigma_e");
-    dparams = mxGetPr(mxFldp);
-    npar = (int) mxGetN(mxFldp);
-    TwoDMatrix vCov(npar, npar, dparams);
+    MxTwoDMatrix vCov(mxFldp);
     if (!vCov.isFinite())
       DYN_MEX_FUNC_ERR_MSG_TXT("The covariance matrix of shocks contains NaN or Inf");
 
     mxFldp = mxGetField(dr, 0, "ys");  // and not in order of dr.order_var
-    dparams = mxGetPr(mxFldp);
-    const int nSteady = (int) mxGetM(mxFldp);
-    Vector ySteady(dparams, nSteady);
+    MxVector ySteady(mxFldp);
     if (!ySteady.isFinite())
       DYN_MEX_FUNC_ERR_MSG_TXT("The steady state vector contains NaN or Inf");
 
@@ -152,8 +188,8 @@ extern "C" {
     const int nPar = (int) mxGetScalar(mxFldp);
 
     mxFldp = mxGetField(dr, 0, "order_var");
-    dparams = mxGetPr(mxFldp);
-    npar = (int) mxGetM(mxFldp);
+    double *dparams = mxGetPr(mxFldp);
+    int npar = (int) mxGetM(mxFldp);
     if (npar != nEndo)
       DYN_MEX_FUNC_ERR_MSG_TXT("Incorrect number of input var_order vars.");
 
@@ -163,11 +199,8 @@ extern "C" {
 
     // the lag, current and lead blocks of the jacobian respectively
     mxFldp = mxGetField(M_, 0, "lead_lag_incidence");
-    dparams = mxGetPr(mxFldp);
     npar = (int) mxGetN(mxFldp);
-    int nrows = (int) mxGetM(mxFldp);
-
-    TwoDMatrix llincidence(nrows, npar, dparams);
+    MxTwoDMatrix llincidence(mxFldp);
     if (npar != nEndo)
       {
         ostringstream strstrm;
@@ -176,24 +209,25 @@ extern "C" {
       }
     //get NNZH =NNZD(2) = the total number of non-zero Hessian elements
     mxFldp = mxGetField(M_, 0, "NNZDerivatives");
-    dparams = mxGetPr(mxFldp);
-    Vector NNZD(dparams, (int)mxGetM(mxFldp));
+    MxVector NNZD(mxFldp);
     if (NNZD[kOrder-1] == -1)
       DYN_MEX_FUNC_ERR_MSG_TXT("The derivatives were not computed for the required order. Make sure that you used the right order option inside the stoch_simul command");
 
+    // Whether the M-file returns a sparse Jacobian (the DLL exports its sparsity pattern)
+    mxFldp = mxGetField(M_, 0, "sparse_jacobian");
+    const bool sparse_jacobian = mxFldp != NULL && mxIsLogicalScalarTrue(mxFldp);
+
     const int jcols = nExog+nEndo+nsPred+nsForw; // Num of Jacobian columns
 
     mxFldp = mxGetField(M_, 0, "var_order_endo_names");
     const int nendo = (int) mxGetM(mxFldp);
     const int widthEndo = (int) mxGetN(mxFldp);
-    vector<string> endoNames;
-    DynareMxArrayToString(mxFldp, nendo, widthEndo, endoNames);
+    const vector<string> &endoNames = cachedNames(mxFldp, nendo, widthEndo, context.rawEndoNames, context.endoNames);
 
     mxFldp = mxGetField(M_, 0, "exo_names");
     const int nexo = (int) mxGetM(mxFldp);
     const int widthExog = (int) mxGetN(mxFldp);
-    vector<string> exoNames;
-    DynareMxArrayToString(mxFldp, nexo, widthExog, exoNames);
+    const vector<string> &exoNames = cachedNames(mxFldp, nexo, widthExog, context.rawExoNames, context.exoNames);
 
     if ((nEndo != nendo) || (nExog != nexo))
       DYN_MEX_FUNC_ERR_MSG_TXT("Incorrect number of input parameters.");
@@ -201,26 +235,25 @@ extern "C" {
     TwoDMatrix *g1m = NULL;
     TwoDMatrix *g2m = NULL;
     TwoDMatrix *g3m = NULL;
+    bool g1_sparse = false;
     // derivatives passed as arguments */
     if (nrhs > 3)
       {
         const mxArray *g1 = prhs[3];
-        int m = (int) mxGetM(g1);
-        int n = (int) mxGetN(g1);
-        g1m = new TwoDMatrix(m, n, mxGetPr(g1));
+        if (mxIsSparse(g1))
+          {
+            // Converted to triplets, like the Hessian
+            g1_sparse = true;
+            g1m = new TwoDMatrix((int) mxGetNzmax(g1), 3);
+            DynamicModelAC::unpackSparseMatrix(const_cast<mxArray *>(g1), g1m);
+          }
+        else
+          g1m = new MxTwoDMatrix(g1);
         if (nrhs > 4)
           {
-            const mxArray *g2 = prhs[4];
-            int m = (int) mxGetM(g2);
-            int n = (int) mxGetN(g2);
-            g2m = new TwoDMatrix(m, n, mxGetPr(g2));
+            g2m = new MxTwoDMatrix(prhs[4]);
             if (nrhs > 5)
-              {
-                const mxArray *g3 = prhs[5];
-                int m = (int) mxGetM(g3);
-                int n = (int) mxGetN(g3);
-                g3m = new TwoDMatrix(m, n, mxGetPr(g3));
-              }
+              g3m = new MxTwoDMatrix(prhs[5]);
           }
       }
 
@@ -240,23 +273,36 @@ extern "C" {
         if (use_dll == 1)
           dynamicModelFile = new DynamicModelDLL(fName);
         else
-          dynamicModelFile = new DynamicModelMFile(fName);
+          dynamicModelFile = new DynamicModelMFile(fName, sparse_jacobian);
 
-        // intiate tensor library
-        tls.init(kOrder, nStat+2*nPred+3*nBoth+2*nForw+nExog);
+        /* intiate tensor library: the equivalence and permutation bundles are
+           kept between calls, so this is only needed for larger dimensions */
+        const int nVars = nStat+2*nPred+3*nBoth+2*nForw+nExog;
+        if (kOrder > context.tlsOrder || nVars > context.tlsNvars)
+          {
+            context.tlsOrder = max(kOrder, context.tlsOrder);
+            context.tlsNvars = max(nVars, context.tlsNvars);
+            INSTRUMENT_SCOPE("tensor_library_init");
+            tls.init(context.tlsOrder, context.tlsNvars);
+          }
 
         // make KordpDynare object
         KordpDynare dynare(endoNames, nEndo, exoNames, nExog, nPar,
                            ySteady, vCov, modParams, nStat, nPred, nForw, nBoth,
                            jcols, NNZD, nSteps, kOrder, journal, dynamicModelFile,
                            sstol, var_order_vp, llincidence, qz_criterium,
-                           g1m, g2m, g3m);
+                           g1m, g2m, g3m, g1_sparse);
 
         // construct main K-order approximation class
 
         Approximation app(dynare, journal,  nSteps, false, qz_criterium);
         // run stochastic steady
-        app.walkStochSteady();
+        {
+          INSTRUMENT_SCOPE("walkStochSteady");
+          app.walkStochSteady();
+        }
+        INSTRUMENT_COUNT("order", kOrder);
+        INSTRUMENT_COUNT("variables", nVars);
 
         /* Write derivative outputs into memory map */
         map<string, ConstTwoDMatrix> mm;
@@ -270,12 +316,7 @@ extern "C" {
             /* Set the output pointer to the output matrix ysteady. */
             map<string, ConstTwoDMatrix>::const_iterator cit = mm.begin();
             ++cit;
-            plhs[1] = mxCreateDoubleMatrix((*cit).second.numRows(), (*cit).second.numCols(), mxREAL);
-
-            // Copy Dynare++ matrix into MATLAB matrix
-            const ConstVector &vec = (*cit).second.getData();
-            assert(vec.skip() == 1);
-            memcpy(mxGetPr(plhs[1]), vec.base(), vec.length() * sizeof(double));
+            plhs[1] = mxCreateFromTwoDMatrix((*cit).second);
           }
         if (kOrder >= 2)
           {
@@ -283,15 +324,8 @@ extern "C" {
             for (map<string, ConstTwoDMatrix>::const_iterator cit = mm.begin();
                  ((cit != mm.end()) && (ii < nlhs)); ++cit)
               {
-                plhs[ii] = mxCreateDoubleMatrix((*cit).second.numRows(), (*cit).second.numCols(), mxREAL);
-
-                // Copy Dynare++ matrix into MATLAB matrix
-                const ConstVector &vec = (*cit).second.getData();
-                assert(vec.skip() == 1);
-                memcpy(mxGetPr(plhs[ii]), vec.base(), vec.length() * sizeof(double));
-
+                plhs[ii] = mxCreateFromTwoDMatrix((*cit).second);
                 ++ii;
-
               }
             if (kOrder == 3 && nlhs > 4)
               {
@@ -317,6 +351,9 @@ extern "C" {
                 copy_derivatives(plhs[ii], Symmetry(0, 1, 0, 2), derivs, "guss");
               }
           }
+
+        // The DLL itself stays loaded for the next calls
+        delete dynamicModelFile;
       }
     catch (const KordException &e)
       {
@@ -1,6 +1,6 @@
 /* kalman_steady_state.cc
 **
-** Copyright (C) 2009-2013 Dynare Team.
+** Copyright (C) 2009-2017 Dynare Team.
 **
 ** This file is part of Dynare.
 **
@@ -31,7 +31,9 @@
   ++
   ++      [2]  Z       (double)   n-by-p selection matrix.
   ++
-  ++      [3]  H       (double)   p-by-p covariance matrix of the measurement errors.
+  ++      [3]  H       (double)   p-by-p covariance matrix of the measurement errors (may be empty if [4] is given).
+  ++
+  ++      [4]  P0      (double)   [OPTIONAL] n-by-n previous solution of the Riccati equation (warm start).
   ++
   ++
   ++
@@ -47,11 +49,17 @@
   ++    =====
   ++
   ++    [1] T = transpose(dynare transition matrix) and Z = transpose(dynare selection matrix).
+  ++
+  ++    [2] If P0 is given, the Riccati equation is solved by Newton iterations starting from P0, and the
+  ++        Slicot routine is only called if they do not converge.
 */
 
 #include <string.h>
 #include <stdlib.h>
+#include <math.h>
+#include <vector>
 #include <dynmex.h>
+#include <dynblas.h>
 #include <dynlapack.h>
 
 #if !defined(MATLAB_MEX_FILE) || !defined(_WIN32)
@@ -77,18 +85,142 @@ max(T x, T y, T z)
   return max(x, max(y, z));
 }
 
+/*
+** Workspace of the Newton iterations, kept between two calls of the mex file (in an estimation, all the
+** calls have the same dimensions).
+*/
+struct NewtonWorkspace
+{
+  std::vector<double> XA, XB, S, K, RK, Ac, Qk, Xn, M, XM, MXM, zeros;
+  std::vector<lapack_int> ipiv;
+  void
+  resize(size_t n, size_t p)
+  {
+    XA.resize(n*n);
+    XB.resize(n*p);
+    S.resize(p*p);
+    K.resize(p*n);
+    RK.resize(p*n);
+    Ac.resize(n*n);
+    Qk.resize(n*n);
+    Xn.resize(n*n);
+    M.resize(n*n);
+    XM.resize(n*n);
+    MXM.resize(n*n);
+    zeros.assign(p*p, 0.0);
+    ipiv.resize(p);
+  }
+};
+
+NewtonWorkspace newton_workspace;
+
+// Returns the 1-norm of the n*n matrix X, or NaN if X has a NaN element
+double
+norm1(const double *X, blas_int n)
+{
+  double norm = 0.0;
+  for (blas_int j = 0; j < n; j++)
+    {
+      double column = 0.0;
+      for (blas_int i = 0; i < n; i++)
+        column += fabs(X[j*n+i]);
+      if (column != column)
+        return column;
+      if (column > norm)
+        norm = column;
+    }
+  return norm;
+}
+
+/*
+** Solves X = A'*X*A - A'*X*B*inv(R+B'*X*B)*B'*X*A + Q by Newton (Hewer) iterations starting from X:
+** given K = inv(R+B'*X*B)*B'*X*A, the next iterate solves the Stein equation X = Ac'*X*Ac + Q + K'*R*K,
+** with Ac = A-B*K, which is solved by doubling. The iterations converge quadratically if the initial
+** condition is stabilizing (which is the case if it is close to the solution). Returns false if they
+** do not converge (unstable closed loop, singular R+B'*X*B, or too many iterations).
+*/
+bool
+newton_riccati(blas_int n, blas_int p, const double *A, const double *B, const double *Q, const double *R, double *X)
+{
+  const double tolerance = 1e-12, stein_tolerance = 1e-15;
+  const int max_newton_iterations = 50, max_doubling_iterations = 100;
+  const double one = 1.0, mone = -1.0, zero = 0.0;
+  NewtonWorkspace &w = newton_workspace;
+  w.resize(n, p);
+  for (int it = 0; it < max_newton_iterations; it++)
+    {
+      // K = inv(R+B'*X*B)*B'*X*A
+      dgemm("N", "N", &n, &n, &n, &one, X, &n, A, &n, &zero, &w.XA[0], &n);
+      dgemm("T", "N", &p, &n, &n, &one, B, &n, &w.XA[0], &n, &zero, &w.K[0], &p);
+      dgemm("N", "N", &n, &p, &n, &one, X, &n, B, &n, &zero, &w.XB[0], &n);
+      memcpy(&w.S[0], R, p*p*sizeof(double));
+      dgemm("T", "N", &p, &p, &n, &one, B, &n, &w.XB[0], &n, &one, &w.S[0], &p);
+      lapack_int lp = p, ln = n, info;
+      dgesv(&lp, &ln, &w.S[0], &lp, &w.ipiv[0], &w.K[0], &lp, &info);
+      if (info != 0)
+        return false;
+      // Ac = A-B*K and Qk = Q+K'*R*K
+      memcpy(&w.Ac[0], A, n*n*sizeof(double));
+      dgemm("N", "N", &n, &n, &p, &mone, B, &n, &w.K[0], &p, &one, &w.Ac[0], &n);
+      memcpy(&w.Qk[0], Q, n*n*sizeof(double));
+      dgemm("N", "N", &p, &n, &p, &one, R, &p, &w.K[0], &p, &zero, &w.RK[0], &p);
+      dgemm("T", "N", &n, &n, &p, &one, &w.K[0], &p, &w.RK[0], &p, &one, &w.Qk[0], &n);
+      // Doubling: Xn = sum_j (Ac')^j*Qk*Ac^j, accumulated as Xn += M'*Xn*M and M = M*M
+      memcpy(&w.Xn[0], &w.Qk[0], n*n*sizeof(double));
+      memcpy(&w.M[0], &w.Ac[0], n*n*sizeof(double));
+      bool converged = false;
+      for (int d = 0; d < max_doubling_iterations; d++)
+        {
+          dgemm("N", "N", &n, &n, &n, &one, &w.Xn[0], &n, &w.M[0], &n, &zero, &w.XM[0], &n);
+          dgemm("T", "N", &n, &n, &n, &one, &w.M[0], &n, &w.XM[0], &n, &zero, &w.MXM[0], &n);
+          double increment = norm1(&w.MXM[0], n);
+          for (blas_int i = 0; i < n*n; i++)
+            w.Xn[i] += w.MXM[i];
+          double norm = norm1(&w.Xn[0], n);
+          if (!(norm < HUGE_VAL))
+            return false;
+          if (increment <= stein_tolerance*norm)
+            {
+              converged = true;
+              break;
+            }
+          dgemm("N", "N", &n, &n, &n, &one, &w.M[0], &n, &w.M[0], &n, &zero, &w.XM[0], &n);
+          w.M.swap(w.XM);
+        }
+      if (!converged)
+        return false;
+      // Symmetrization and convergence check
+      if (!(norm1(&w.Xn[0], n) < HUGE_VAL))
+        return false;
+      double change = 0.0;
+      for (blas_int j = 0; j < n; j++)
+        for (blas_int i = 0; i < n; i++)
+          {
+            double x = .5*(w.Xn[j*n+i] + w.Xn[i*n+j]);
+            double c = fabs(x - X[j*n+i]);
+            if (c > change)
+              change = c;
+            w.XA[j*n+i] = x;
+          }
+      memcpy(X, &w.XA[0], n*n*sizeof(double));
+      if (change <= tolerance*max(1.0, norm1(X, n)))
+        return true;
+    }
+  return false;
+}
+
 void
 mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 {
   // Check the number of arguments and set some flags.
   int measurement_error_flag = 1;
-  if (nrhs < 3 || 4 < nrhs)
-    DYN_MEX_FUNC_ERR_MSG_TXT("kalman_steady_state accepts either 3 or 4 input arguments!");
+  if (nrhs < 3 || 5 < nrhs)
+    DYN_MEX_FUNC_ERR_MSG_TXT("kalman_steady_state accepts 3, 4 or 5 input arguments!");
 
   if (nlhs < 1 || 2 < nlhs)
     DYN_MEX_FUNC_ERR_MSG_TXT("kalman_steady_state requires at least 1, but no more than 2, output arguments!");
 
-  if (nrhs == 3)
+  if (nrhs == 3 || mxIsEmpty(prhs[3]))
     measurement_error_flag = 0;
 
   // Check the type of the input arguments and get the size of the matrices.
@@ -138,6 +270,24 @@ mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
           DYN_MEX_FUNC_ERR_MSG_TXT("kalman_steady_state: The fifth input argument (H) must be a real matrix!");
         }
     }
+  // Warm start from a previous solution.
+  if (nrhs == 5)
+    {
+      if (mxGetM(prhs[4]) != (size_t) n || mxGetN(prhs[4]) != (size_t) n)
+        {
+          DYN_MEX_FUNC_ERR_MSG_TXT("kalman_steady_state: The fifth input argument (P0) must be a square matrix with the same size as the first argument (T)!");
+        }
+      plhs[1] = mxCreateDoubleMatrix(n, n, mxREAL);
+      memcpy(mxGetPr(plhs[1]), mxGetPr(prhs[4]), n*n*sizeof(double));
+      newton_workspace.resize(n, p);
+      if (newton_riccati(n, p, mxGetPr(prhs[0]), mxGetPr(prhs[2]), mxGetPr(prhs[1]),
+                         measurement_error_flag ? mxGetPr(prhs[3]) : &newton_workspace.zeros[0], mxGetPr(plhs[1])))
+        {
+          plhs[0] = mxCreateDoubleScalar(0);
+          return;
+        }
+      mxDestroyArray(plhs[1]);
+    }
   // Get input matrices.
   double *T, *QQ, *Z, *H, *L; // Remark. L will not be used.
   T = (double *) mxCalloc(n*n, sizeof(double));
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2007-2011 Dynare Team
+ * Copyright (C) 2007-2017 Dynare Team
  *
  * This file is part of Dynare.
  *
@@ -22,109 +22,82 @@
  * one can consider large matrices B and/or C.
  */
 
-#include <string.h>
+#include <vector>
 
 #include <dynmex.h>
 #include <dynblas.h>
+#include <instrumentation.hh>
 
 #ifdef USE_OMP
 # include <omp.h>
 #endif
 
-#define DEBUG_OMP 0
+/*
+ * A*kron(B,C) is computed without building kron(B,C), by splitting it into two
+ * matrix products. Let A_r (r=0..mB-1) be the blocks of mC consecutive columns
+ * of A, and D_j (j=0..nB-1) the blocks of nC consecutive columns of D. Then
+ *   D_j = sum_r B(r,j)*A_r*C
+ * which can be computed in either order:
+ *  - right first: the mB products T_r = A_r*C are stored contiguously as an
+ *    (mA*nC)*mB matrix T, and then [D_0 ... D_{nB-1}] = T*B (one dgemm, where
+ *    D is seen as an (mA*nC)*nB matrix);
+ *  - left first: the blocks U_j = sum_r B(r,j)*A_r are given by the single
+ *    product U = A*B, where A is seen as an (mA*mC)*mB matrix and U as an
+ *    (mA*mC)*nB matrix, and then D_j = U_j*C.
+ * Both orders only call dgemm on large operands (instead of one small dgemm by
+ * element of B, or an axpy by column of A and D), and the one with the fewest
+ * flops is selected. The independent products of the second stage are
+ * distributed over the threads.
+ */
 
 void
 full_A_times_kronecker_B_C(double *A, double *B, double *C, double *D,
                            blas_int mA, blas_int nA, blas_int mB, blas_int nB, blas_int mC, blas_int nC, int number_of_threads)
 {
+  if (mA == 0 || nB == 0 || nC == 0)
+    return;
+  double one = 1.0, zero = 0.0;
+  const blas_int mAnC = mA*nC, mAmC = mA*mC;
+  // Number of flops (divided by 2*mA) of each order
+  const double right_first = (double) mB*nC*(mC+nB), left_first = (double) nB*mC*(mB+nC);
+  INSTRUMENT_COUNT("flops", 2.0*mA*(right_first <= left_first ? right_first : left_first));
+  if (right_first <= left_first)
+    {
+      INSTRUMENT_SCOPE("right_first");
+      std::vector<double> T(mAnC*mB);
 #if USE_OMP
 # pragma omp parallel for num_threads(number_of_threads)
-  for (blas_int colD = 0; colD < nB*nC; colD++)
-    {
-# if DEBUG_OMP
-      mexPrintf("%d thread number is %d (%d).\n", colD, omp_get_thread_num(), omp_get_num_threads());
-# endif
-      blas_int colB = colD/nC;
-      blas_int colC = colD%nC;
-      for (blas_int colA = 0; colA < nA; colA++)
-        {
-          blas_int rowB = colA/mC;
-          blas_int rowC = colA%mC;
-          blas_int idxA = colA*mA;
-          blas_int idxD = colD*mA;
-          double BC = B[colB*mB+rowB]*C[colC*mC+rowC];
-          for (blas_int rowD = 0; rowD < mA; rowD++)
-            {
-              D[idxD+rowD] += A[idxA+rowD]*BC;
-            }
-        }
+#endif
+      for (blas_int r = 0; r < mB; r++)
+        dgemm("N", "N", &mA, &nC, &mC, &one, &A[r*mAmC], &mA, C, &mC, &zero, &T[r*mAnC], &mA);
+      dgemm("N", "N", &mAnC, &nB, &mB, &one, &T[0], &mAnC, B, &mB, &zero, D, &mAnC);
     }
-#else
-  const blas_int shiftA = mA*mC;
-  const blas_int shiftD = mA*nC;
-  blas_int kd = 0, ka = 0;
-  char transpose[2] = "N";
-  double one = 1.0;
-  for (blas_int col = 0; col < nB; col++)
+  else
     {
-      ka = 0;
-      for (blas_int row = 0; row < mB; row++)
-        {
-          dgemm(transpose, transpose, &mA, &nC, &mC, &B[mB*col+row], &A[ka], &mA, &C[0], &mC, &one, &D[kd], &mA);
-          ka += shiftA;
-        }
-      kd += shiftD;
-    }
+      INSTRUMENT_SCOPE("left_first");
+      std::vector<double> U(mAmC*nB);
+      dgemm("N", "N", &mAmC, &nB, &mB, &one, A, &mAmC, B, &mB, &zero, &U[0], &mAmC);
+#if USE_OMP
+# pragma omp parallel for num_threads(number_of_threads)
 #endif
+      for (blas_int j = 0; j < nB; j++)
+        dgemm("N", "N", &mA, &nC, &mC, &one, &U[j*mAmC], &mA, C, &mC, &zero, &D[j*mAnC], &mA);
+    }
 }
 
 void
 full_A_times_kronecker_B_B(double *A, double *B, double *D, blas_int mA, blas_int nA, blas_int mB, blas_int nB, int number_of_threads)
 {
-#if USE_OMP
-# pragma omp parallel for num_threads(number_of_threads)
-  for (blas_int colD = 0; colD < nB*nB; colD++)
-    {
-# if DEBUG_OMP
-      mexPrintf("%d thread number is %d (%d).\n", colD, omp_get_thread_num(), omp_get_num_threads());
-# endif
-      blas_int j1B = colD/nB;
-      blas_int j2B = colD%nB;
-      for (blas_int colA = 0; colA < nA; colA++)
-        {
-          blas_int i1B = colA/mB;
-          blas_int i2B = colA%mB;
-          blas_int idxA = colA*mA;
-          blas_int idxD = colD*mA;
-          double BB = B[j1B*mB+i1B]*B[j2B*mB+i2B];
-          for (blas_int rowD = 0; rowD < mA; rowD++)
-            {
-              D[idxD+rowD] += A[idxA+rowD]*BB;
-            }
-        }
-    }
-#else
-  const blas_int shiftA = mA*mB;
-  const blas_int shiftD = mA*nB;
-  blas_int kd = 0, ka = 0;
-  char transpose[2] = "N";
-  double one = 1.0;
-  for (blas_int col = 0; col < nB; col++)
-    {
-      ka = 0;
-      for (blas_int row = 0; row < mB; row++)
-        {
-          dgemm(transpose, transpose, &mA, &nB, &mB, &B[mB*col+row], &A[ka], &mA, &B[0], &mB, &one, &D[kd], &mA);
-          ka += shiftA;
-        }
-      kd += shiftD;
-    }
-#endif
+  full_A_times_kronecker_B_C(A, B, B, D, mA, nA, mB, nB, mB, nB, number_of_threads);
 }
 
 void
 mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 {
+  if (Instrumentation::mexCommand("A_times_B_kronecker_C", nlhs, plhs, nrhs, prhs))
+    return;
+  INSTRUMENT_SCOPE("A_times_B_kronecker_C");
+
   // Check input and output:
   if (nrhs > 4 || nrhs < 3)
     DYN_MEX_FUNC_ERR_MSG_TXT("A_times_B_kronecker_C takes 3 or 4 input arguments and provides 2 output arguments.");
@@ -24,94 +24,177 @@
  */
 
 #include <string.h>
+#include <vector>
 
 #include <dynmex.h>
+#include <instrumentation.hh>
 
 #ifdef USE_OMP
 # include <omp.h>
 #endif
 
-#define DEBUG_OMP 0
+/*
+ * The columns of the hessian are indexed by pairs (i1,i2), and the columns
+ * (i1,i2) and (i2,i1) are equal. Only the non empty columns with i1<=i2 are
+ * used: they are listed once (the listing only depends on the sparsity
+ * pattern), so that the computational loops do not scan the empty columns,
+ * and they are combined with the symmetrized products of B and C (the values
+ * of the hessian are assumed to be symmetric whenever its pattern is):
+ *   A*kron(B,C)(:,(jB,jC)) = sum_{i1<=i2} A(:,(i1,i2))*w(i1,i2)
+ * with w(i1,i2) = B(i1,jB)*C(i2,jC)+B(i2,jB)*C(i1,jC) if i1<i2, and
+ * B(i1,jB)*C(i1,jC) if i1=i2.
+ */
+struct HessianPattern
+{
+  // Sparsity pattern of the hessian
+  mwSize mA, nA;
+  std::vector<mwIndex> ir, jc;
+  // Non empty columns (i1,i2) with i1<=i2, their first and last+1 non zero elements
+  std::vector<mwIndex> i1, i2, begin, end;
+  // True if the pattern of column (i1,i2) is equal to the pattern of column (i2,i1) for all i1,i2
+  bool symmetric;
+};
+
+/*
+ * The patterns of the last hessians are cached, since the sparsity pattern
+ * does not change between two evaluations of the decision rules (e.g. for two
+ * parameter draws).
+ */
+const size_t max_cached_patterns = 4;
+std::vector<HessianPattern> cached_patterns;
+size_t next_cached_pattern = 0;
+
+bool
+samePattern(const HessianPattern &pattern, const mwIndex *isparseA, const mwIndex *jsparseA, mwSize mA, mwSize nA)
+{
+  return pattern.mA == mA && pattern.nA == nA && pattern.jc.size() == nA+1
+    && memcmp(&pattern.jc[0], jsparseA, (nA+1)*sizeof(mwIndex)) == 0
+    && (jsparseA[nA] == 0 || memcmp(&pattern.ir[0], isparseA, jsparseA[nA]*sizeof(mwIndex)) == 0);
+}
+
+const HessianPattern &
+getPattern(const mwIndex *isparseA, const mwIndex *jsparseA, mwSize mA, mwSize nA, mwSize mB)
+{
+  for (size_t i = 0; i < cached_patterns.size(); i++)
+    if (samePattern(cached_patterns[i], isparseA, jsparseA, mA, nA))
+      {
+        INSTRUMENT_COUNT("pattern_cache_hits", 1);
+        return cached_patterns[i];
+      }
+  INSTRUMENT_COUNT("pattern_cache_misses", 1);
+
+  // Replaces the oldest cached pattern
+  if (cached_patterns.size() < max_cached_patterns)
+    cached_patterns.push_back(HessianPattern());
+  HessianPattern &pattern = cached_patterns[next_cached_pattern];
+  next_cached_pattern = (next_cached_pattern + 1) % max_cached_patterns;
+  pattern.mA = mA;
+  pattern.nA = nA;
+  pattern.jc.assign(jsparseA, jsparseA + nA + 1);
+  pattern.ir.assign(isparseA, isparseA + jsparseA[nA]);
+  pattern.i1.clear();
+  pattern.i2.clear();
+  pattern.begin.clear();
+  pattern.end.clear();
+  pattern.symmetric = (mB*mB == nA);
+  for (mwIndex a = 0; a < mB && pattern.symmetric; a++)
+    for (mwIndex b = a; b < mB; b++)
+      {
+        mwIndex ii = a*mB+b, ti = b*mB+a;
+        mwSize nz = jsparseA[ii+1] - jsparseA[ii];
+        if (nz != jsparseA[ti+1] - jsparseA[ti]
+            || (nz > 0 && memcmp(&isparseA[jsparseA[ii]], &isparseA[jsparseA[ti]], nz*sizeof(mwIndex)) != 0))
+          {
+            pattern.symmetric = false;
+            break;
+          }
+        if (nz > 0)
+          {
+            pattern.i1.push_back(a);
+            pattern.i2.push_back(b);
+            pattern.begin.push_back(jsparseA[ii]);
+            pattern.end.push_back(jsparseA[ii+1]);
+          }
+      }
+  return pattern;
+}
+
+// Adds to the column d (of length mA) the sum of the listed columns of A, weighted by the symmetrized products of b and c
+inline void
+symmetricColumn(const HessianPattern &pattern, const mwIndex *isparseA, const double *vsparseA,
+                const double *b, const double *c, double *d)
+{
+  for (size_t l = 0; l < pattern.i1.size(); l++)
+    {
+      const mwIndex i1 = pattern.i1[l], i2 = pattern.i2[l];
+      const double w = (i1 == i2 ? b[i1]*c[i1] : b[i1]*c[i2] + b[i2]*c[i1]);
+      for (mwIndex k = pattern.begin[l]; k < pattern.end[l]; k++)
+        d[isparseA[k]] += w*vsparseA[k];
+    }
+}
 
 void
-sparse_hessian_times_B_kronecker_B(mwIndex *isparseA, mwIndex *jsparseA, double *vsparseA,
+sparse_hessian_times_B_kronecker_B(const HessianPattern &pattern, mwIndex *isparseA, double *vsparseA,
                                    double *B, double *D, mwSize mA, mwSize nA, mwSize mB, mwSize nB, int number_of_threads)
 {
   /*
   **   Loop over the columns of kron(B,B) (or of the result matrix D).
-  **   This loop is splitted into two nested loops because we use the
-  **   symmetric pattern of the hessian matrix.
+  **   This loop is splitted into two nested loops because the columns
+  **   (j1B,j2B) and (j2B,j1B) of D are equal.
   */
 #if USE_OMP
-# pragma omp parallel for num_threads(number_of_threads)
+# pragma omp parallel for num_threads(number_of_threads) schedule(dynamic)
 #endif
   for (mwIndex j1B = 0; j1B < nB; j1B++)
     {
-#if DEBUG_OMP
-      mexPrintf("%d thread number is %d (%d).\n", j1B, omp_get_thread_num(), omp_get_num_threads());
-#endif
       for (mwIndex j2B = j1B; j2B < nB; j2B++)
         {
           mwIndex jj = j1B*nB+j2B; // column of kron(B,B) index.
-          mwIndex iv = 0;
-          int nz_in_column_ii_of_A = 0;
-          mwIndex k1 = 0;
-          mwIndex k2 = 0;
-          /*
-          ** Loop over the rows of kron(B,B) (column jj).
-          */
-          for (mwIndex ii = 0; ii < nA; ii++)
-            {
-              k1 = jsparseA[ii];
-              k2 = jsparseA[ii+1];
-              if (k1 < k2) // otherwise column ii of A does not have non zero elements (and there is nothing to compute).
-                {
-                  ++nz_in_column_ii_of_A;
-                  mwIndex i1B = (ii/mB);
-                  mwIndex i2B = (ii%mB);
-                  double bb  = B[j1B*mB+i1B]*B[j2B*mB+i2B];
-                  /*
-                  ** Loop over the non zero entries of A(:,ii).
-                  */
-                  for (mwIndex k = k1; k < k2; k++)
-                    {
-                      mwIndex kk = isparseA[k];
-                      D[jj*mA+kk] = D[jj*mA+kk] + bb*vsparseA[iv];
-                      iv++;
-                    }
-                }
-            }
-          if (nz_in_column_ii_of_A > 0)
-            {
-              memcpy(&D[(j2B*nB+j1B)*mA], &D[jj*mA], mA*sizeof(double));
-            }
+          symmetricColumn(pattern, isparseA, vsparseA, &B[j1B*mB], &B[j2B*mB], &D[jj*mA]);
+          if (j2B > j1B)
+            memcpy(&D[(j2B*nB+j1B)*mA], &D[jj*mA], mA*sizeof(double));
         }
     }
 }
 
 void
-sparse_hessian_times_B_kronecker_C(mwIndex *isparseA, mwIndex *jsparseA, double *vsparseA,
+sparse_hessian_times_B_kronecker_C(const HessianPattern &pattern, mwIndex *isparseA, double *vsparseA,
                                    double *B, double *C, double *D,
                                    mwSize mA, mwSize nA, mwSize mB, mwSize nB, mwSize mC, mwSize nC, int number_of_threads)
 {
   /*
-  **   Loop over the columns of kron(B,B) (or of the result matrix D).
+  **   Loop over the columns of kron(B,C) (or of the result matrix D).
   */
 #if USE_OMP
 # pragma omp parallel for num_threads(number_of_threads)
 #endif
   for (mwIndex jj = 0; jj < nB*nC; jj++) // column of kron(B,C) index.
     {
-      // Uncomment the following line to check if all processors are used.
-#if DEBUG_OMP
-      mexPrintf("%d thread number is %d (%d).\n", jj, omp_get_thread_num(), omp_get_num_threads());
+      symmetricColumn(pattern, isparseA, vsparseA, &B[(jj/nC)*mB], &C[(jj%nC)*mC], &D[jj*mA]);
+    }
+}
+
+/*
+ * General case, when the pattern of the hessian is not symmetric, or when B
+ * and C do not have the same number of rows.
+ */
+void
+sparse_hessian_times_B_kronecker_C_general(mwIndex *isparseA, mwIndex *jsparseA, double *vsparseA,
+                                           double *B, double *C, double *D,
+                                           mwSize mA, mwSize nA, mwSize mB, mwSize nB, mwSize mC, mwSize nC, int number_of_threads)
+{
+  /*
+  **   Loop over the columns of kron(B,C) (or of the result matrix D).
+  */
+#if USE_OMP
+# pragma omp parallel for num_threads(number_of_threads)
 #endif
+  for (mwIndex jj = 0; jj < nB*nC; jj++) // column of kron(B,C) index.
+    {
       mwIndex jB = jj/nC;
       mwIndex jC = jj%nC;
       mwIndex k1 = 0;
       mwIndex k2 = 0;
-      mwIndex iv = 0;
-      int nz_in_column_ii_of_A = 0;
       /*
       ** Loop over the rows of kron(B,C) (column jj).
       */
@@ -121,9 +204,8 @@ sparse_hessian_times_B_kronecker_C(mwIndex *isparseA, mwIndex *jsparseA, double
           k2 = jsparseA[ii+1];
           if (k1 < k2) // otherwise column ii of A does not have non zero elements (and there is nothing to compute).
             {
-              ++nz_in_column_ii_of_A;
-              mwIndex iC = (ii%mB);
-              mwIndex iB = (ii/mB);
+              mwIndex iC = (ii%mC);
+              mwIndex iB = (ii/mC);
               double cb = C[jC*mC+iC]*B[jB*mB+iB];
               /*
               ** Loop over the non zero entries of A(:,ii).
@@ -131,8 +213,7 @@ sparse_hessian_times_B_kronecker_C(mwIndex *isparseA, mwIndex *jsparseA, double
               for (mwIndex k = k1; k < k2; k++)
                 {
                   mwIndex kk = isparseA[k];
-                  D[jj*mA+kk] = D[jj*mA+kk] + cb*vsparseA[iv];
-                  iv++;
+                  D[jj*mA+kk] += cb*vsparseA[k];
                 }
             }
         }
@@ -142,6 +223,10 @@ sparse_hessian_times_B_kronecker_C(mwIndex *isparseA, mwIndex *jsparseA, double
 void
 mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 {
+  if (Instrumentation::mexCommand("sparse_hessian_times_B_kronecker_C", nlhs, plhs, nrhs, prhs))
+    return;
+  INSTRUMENT_SCOPE("sparse_hessian_times_B_kronecker_C");
+
   // Check input and output:
   if ((nrhs > 4) || (nrhs < 3))
     DYN_MEX_FUNC_ERR_MSG_TXT("sparse_hessian_times_B_kronecker_C takes 3 or 4 input arguments and provides 2 output arguments.");
@@ -193,13 +278,24 @@ mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     }
   D = mxGetPr(plhs[0]);
   // Computational part:
-  if (nrhs == 3)
+  const HessianPattern &pattern = getPattern(isparseA, jsparseA, mA, nA, mB);
+  INSTRUMENT_COUNT("nnz", jsparseA[nA]);
+  INSTRUMENT_COUNT("columns", nrhs == 4 ? nB*nC : nB*nB);
+  if (nrhs == 3 && pattern.symmetric)
+    {
+      sparse_hessian_times_B_kronecker_B(pattern, isparseA, vsparseA, B, D, mA, nA, mB, nB, numthreads);
+    }
+  else if (nrhs == 3)
+    {
+      sparse_hessian_times_B_kronecker_C_general(isparseA, jsparseA, vsparseA, B, B, D, mA, nA, mB, nB, mB, nB, numthreads);
+    }
+  else if (pattern.symmetric && mB == mC)
     {
-      sparse_hessian_times_B_kronecker_B(isparseA, jsparseA, vsparseA, B, D, mA, nA, mB, nB, numthreads);
+      sparse_hessian_times_B_kronecker_C(pattern, isparseA, vsparseA, B, C, D, mA, nA, mB, nB, mC, nC, numthreads);
     }
   else
     {
-      sparse_hessian_times_B_kronecker_C(isparseA, jsparseA, vsparseA, B, C, D, mA, nA, mB, nB, mC, nC, numthreads);
+      sparse_hessian_times_B_kronecker_C_general(isparseA, jsparseA, vsparseA, B, C, D, mA, nA, mB, nB, mC, nC, numthreads);
     }
   plhs[1] = mxCreateDoubleScalar(0);
 }
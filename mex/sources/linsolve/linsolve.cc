@@ -2,7 +2,8 @@
  * Oct-file for bringing MATLAB's linsolve function to Octave.
  *
  * The implementation is incomplete:
- * - it only knows about the TRANSA, LT, UT and SYM options
+ * - it only knows about the TRANSA, LT, UT and SYM options (and NUMTHREADS,
+ *   for the handle-based interface, which is specific to this implementation)
  * - it only works with square matrices
  * - it only works on double matrices (no single precision or complex)
  *
@@ -28,14 +29,347 @@
  * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
 #include <octave/oct.h>
 #include <octave/ov-struct.h>
+#include <octave/f77-fcn.h>
+
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
+extern "C"
+{
+  F77_RET_T
+  F77_FUNC(dgetrf, DGETRF) (const octave_idx_type &, const octave_idx_type &, double *, const octave_idx_type &,
+                            octave_idx_type *, octave_idx_type &);
+
+  F77_RET_T
+  F77_FUNC(dgetrs, DGETRS) (F77_CONST_CHAR_ARG_DECL, const octave_idx_type &, const octave_idx_type &,
+                            const double *, const octave_idx_type &, const octave_idx_type *,
+                            double *, const octave_idx_type &, octave_idx_type &);
+
+  F77_RET_T
+  F77_FUNC(dgecon, DGECON) (F77_CONST_CHAR_ARG_DECL, const octave_idx_type &, const double *, const octave_idx_type &,
+                            const double &, double &, double *, octave_idx_type *, octave_idx_type &);
+
+  F77_RET_T
+  F77_FUNC(dpotrf, DPOTRF) (F77_CONST_CHAR_ARG_DECL, const octave_idx_type &, double *, const octave_idx_type &,
+                            octave_idx_type &);
+
+  F77_RET_T
+  F77_FUNC(dpotrs, DPOTRS) (F77_CONST_CHAR_ARG_DECL, const octave_idx_type &, const octave_idx_type &,
+                            const double *, const octave_idx_type &, double *, const octave_idx_type &,
+                            octave_idx_type &);
+
+  F77_RET_T
+  F77_FUNC(dpocon, DPOCON) (F77_CONST_CHAR_ARG_DECL, const octave_idx_type &, const double *, const octave_idx_type &,
+                            const double &, double &, double *, octave_idx_type *, octave_idx_type &);
+
+  F77_RET_T
+  F77_FUNC(dtrtrs, DTRTRS) (F77_CONST_CHAR_ARG_DECL, F77_CONST_CHAR_ARG_DECL, F77_CONST_CHAR_ARG_DECL,
+                            const octave_idx_type &, const octave_idx_type &, const double *, const octave_idx_type &,
+                            double *, const octave_idx_type &, octave_idx_type &);
+
+  F77_RET_T
+  F77_FUNC(dtrcon, DTRCON) (F77_CONST_CHAR_ARG_DECL, F77_CONST_CHAR_ARG_DECL, F77_CONST_CHAR_ARG_DECL,
+                            const octave_idx_type &, const double *, const octave_idx_type &, double &,
+                            double *, octave_idx_type *, octave_idx_type &);
+}
+
+/*
+ * Factorizations kept between calls, indexed by the handles returned by
+ * linsolve('factor', ...). When there are more than max_factorizations of
+ * them, the least recently used one is freed.
+ */
+struct Factorization
+{
+  enum { LU, Cholesky, Triangular } kind;
+  octave_idx_type n;
+  std::vector<double> factors;
+  std::vector<octave_idx_type> ipiv;
+  const char *uplo;
+  double rcond;
+  unsigned long last_use;
+};
+
+static std::map<double, Factorization> factorizations;
+static double next_handle = 1;
+static unsigned long use_counter = 0;
+static size_t max_factorizations = 16;
+
+static void
+freeLeastRecentlyUsed()
+{
+  while (factorizations.size() > max_factorizations)
+    {
+      std::map<double, Factorization>::iterator lru = factorizations.begin();
+      for (std::map<double, Factorization>::iterator it = factorizations.begin(); it != factorizations.end(); ++it)
+        if (it->second.last_use < lru->second.last_use)
+          lru = it;
+      factorizations.erase(lru);
+    }
+}
+
+/*
+ * Factorizes the n*n matrix A: Cholesky factorization if it is marked as
+ * symmetric and is positive definite, LU factorization with partial pivoting
+ * otherwise, or nothing but a copy if it is triangular. Also computes the
+ * reciprocal condition number (in the 1-norm) from the factors.
+ */
+static void
+factorize(Factorization &f, const Matrix &A, MatrixType &typA)
+{
+  octave_idx_type n = A.rows(), info;
+  f.n = n;
+  f.factors.assign(A.data(), A.data() + n*n);
+  f.rcond = 1.0;
+  if (n == 0)
+    {
+      f.kind = Factorization::Triangular;
+      f.uplo = "U";
+      return;
+    }
+  std::vector<double> work(4*n);
+  std::vector<octave_idx_type> iwork(n);
+
+  double anorm = 0.0;
+  for (octave_idx_type j = 0; j < n; j++)
+    {
+      double colsum = 0.0;
+      for (octave_idx_type i = 0; i < n; i++)
+        colsum += fabs(f.factors[j*n+i]);
+      anorm = std::max(anorm, colsum);
+    }
+
+  int t = typA.type();
+  if (t == MatrixType::Upper || t == MatrixType::Lower)
+    {
+      f.kind = Factorization::Triangular;
+      f.uplo = (t == MatrixType::Upper ? "U" : "L");
+      F77_XFCN(dtrcon, DTRCON, (F77_CONST_CHAR_ARG("1"), F77_CONST_CHAR_ARG(f.uplo), F77_CONST_CHAR_ARG("N"),
+                                n, &f.factors[0], n, f.rcond, &work[0], &iwork[0], info));
+      return;
+    }
+
+  if (t == MatrixType::Hermitian)
+    {
+      f.kind = Factorization::Cholesky;
+      f.uplo = "U";
+      F77_XFCN(dpotrf, DPOTRF, (F77_CONST_CHAR_ARG(f.uplo), n, &f.factors[0], n, info));
+      if (info == 0)
+        {
+          F77_XFCN(dpocon, DPOCON, (F77_CONST_CHAR_ARG(f.uplo), n, &f.factors[0], n, anorm, f.rcond,
+                                    &work[0], &iwork[0], info));
+          return;
+        }
+      // Not positive definite, falls back on LU
+      f.factors.assign(A.data(), A.data() + n*n);
+    }
+
+  f.kind = Factorization::LU;
+  f.ipiv.resize(n);
+  f.uplo = "U";
+  F77_XFCN(dgetrf, DGETRF, (n, n, &f.factors[0], n, &f.ipiv[0], info));
+  if (info > 0)
+    f.rcond = 0.0;
+  else
+    F77_XFCN(dgecon, DGECON, (F77_CONST_CHAR_ARG("1"), n, &f.factors[0], n, anorm, f.rcond,
+                              &work[0], &iwork[0], info));
+}
+
+/*
+ * Overwrites the n*nrhs matrix B with the solution of A*X = B (or A'*X = B).
+ * The right hand sides are split in contiguous blocks of columns, solved in
+ * parallel. LAPACK is called directly (not through F77_XFCN) since the
+ * Octave exception handling of F77_XFCN is not thread safe.
+ */
+static void
+solveFactorized(const Factorization &f, bool transa, double *B, octave_idx_type nrhs, int numthreads)
+{
+  if (nrhs == 0 || f.n == 0)
+    return;
+  octave_idx_type chunk = (nrhs + numthreads - 1)/numthreads;
+  int nchunks = (int) ((nrhs + chunk - 1)/chunk);
+  const char *trans = transa ? "T" : "N";
+#ifdef USE_OMP
+# pragma omp parallel for num_threads(numthreads)
+#endif
+  for (int c = 0; c < nchunks; c++)
+    {
+      octave_idx_type first = c*chunk, m = std::min(chunk, nrhs - first), info;
+      double *Bc = B + first*f.n;
+      switch (f.kind)
+        {
+        case Factorization::LU:
+          F77_FUNC(dgetrs, DGETRS) (F77_CONST_CHAR_ARG(trans), f.n, m, &f.factors[0], f.n, &f.ipiv[0], Bc, f.n, info);
+          break;
+        case Factorization::Cholesky:
+          F77_FUNC(dpotrs, DPOTRS) (F77_CONST_CHAR_ARG(f.uplo), f.n, m, &f.factors[0], f.n, Bc, f.n, info);
+          break;
+        case Factorization::Triangular:
+          F77_FUNC(dtrtrs, DTRTRS) (F77_CONST_CHAR_ARG(f.uplo), F77_CONST_CHAR_ARG(trans), F77_CONST_CHAR_ARG("N"),
+                                    f.n, m, &f.factors[0], f.n, Bc, f.n, info);
+          break;
+        }
+    }
+}
+
+/*
+ * Reads the TRANSA, UT, LT, SYM and NUMTHREADS fields of the options structure.
+ */
+static bool
+readOptions(const octave_value &arg, MatrixType &typA, bool &transa, int &numthreads)
+{
+  octave_scalar_map opts = arg.scalar_map_value();
+  if (error_state)
+    return false;
+
+  octave_value tmp = opts.contents("TRANSA");
+  transa = tmp.is_defined() && tmp.bool_matrix_value().elem(0);
+
+  tmp = opts.contents("UT");
+  if (tmp.is_defined() && tmp.bool_matrix_value().elem(0))
+    typA.mark_as_upper_triangular();
+
+  tmp = opts.contents("LT");
+  if (tmp.is_defined() && tmp.bool_matrix_value().elem(0))
+    typA.mark_as_lower_triangular();
+
+  tmp = opts.contents("SYM");
+  if (tmp.is_defined() && tmp.bool_matrix_value().elem(0))
+    typA.mark_as_symmetric();
+
+  tmp = opts.contents("NUMTHREADS");
+  if (tmp.is_defined())
+    numthreads = std::max(1, tmp.int_value());
+
+  return !error_state;
+}
+
+/*
+ * Handle-based interface: linsolve('factor', A[, options]),
+ * linsolve('solve', H, B[, options]), linsolve('free'[, H]) and
+ * linsolve('limit', N).
+ */
+static octave_value_list
+handleCommand(const octave_value_list &args, int nargout)
+{
+  int nargin = args.length();
+  octave_value_list retval;
+  std::string command = args(0).string_value();
+
+  MatrixType typA;
+  typA.mark_as_full();
+  bool transa = false;
+  int numthreads = 1;
+
+  if (command == "factor")
+    {
+      if (nargin < 2 || nargin > 3 || nargout > 2)
+        {
+          print_usage();
+          return retval;
+        }
+      Matrix A = args(1).matrix_value();
+      if (error_state || (nargin == 3 && !readOptions(args(2), typA, transa, numthreads)))
+        return retval;
+      if (A.rows() != A.cols())
+        {
+          error("linsolve: rectangular A not yet supported");
+          return retval;
+        }
+      double handle = next_handle++;
+      Factorization &f = factorizations[handle];
+      factorize(f, A, typA);
+      f.last_use = use_counter++;
+      if (f.rcond < std::numeric_limits<double>::epsilon())
+        warning("linsolve: matrix singular to machine precision, rcond = %g", f.rcond);
+      freeLeastRecentlyUsed();
+      retval(0) = handle;
+      if (nargout == 2)
+        retval(1) = f.rcond;
+    }
+  else if (command == "solve")
+    {
+      if (nargin < 3 || nargin > 4 || nargout > 2)
+        {
+          print_usage();
+          return retval;
+        }
+      double handle = args(1).double_value();
+      Matrix B = args(2).matrix_value();
+      if (error_state || (nargin == 4 && !readOptions(args(3), typA, transa, numthreads)))
+        return retval;
+      std::map<double, Factorization>::iterator it = factorizations.find(handle);
+      if (it == factorizations.end())
+        {
+          error("linsolve: invalid handle (the factorization may have been freed)");
+          return retval;
+        }
+      Factorization &f = it->second;
+      if (B.rows() != f.n)
+        {
+          error("linsolve: must have same number of lines in A and B");
+          return retval;
+        }
+      f.last_use = use_counter++;
+#ifndef USE_OMP
+      numthreads = 1;
+#endif
+      solveFactorized(f, transa, B.fortran_vec(), B.cols(), numthreads);
+      retval(0) = B;
+      if (nargout == 2)
+        retval(1) = f.rcond;
+    }
+  else if (command == "free")
+    {
+      if (nargin > 2 || nargout > 0)
+        {
+          print_usage();
+          return retval;
+        }
+      if (nargin == 1)
+        factorizations.clear();
+      else
+        factorizations.erase(args(1).double_value());
+    }
+  else if (command == "limit")
+    {
+      if (nargin != 2 || nargout > 0)
+        {
+          print_usage();
+          return retval;
+        }
+      int limit = args(1).int_value();
+      if (error_state || limit < 1)
+        {
+          error("linsolve: the maximum number of factorizations must be a positive integer");
+          return retval;
+        }
+      max_factorizations = limit;
+      freeLeastRecentlyUsed();
+    }
+  else
+    error("linsolve: unknown command '%s'", command.c_str());
+
+  return retval;
+}
 
 DEFUN_DLD(linsolve, args, nargout, "-*- texinfo -*-\n\
 @deftypefn {Loadable Function} @var{x} = linsolve (@var{a}, @var{b})\n\
 @deftypefnx {Loadable Function} [ @var{x}, @var{r} ] = linsolve (@var{a}, @var{b})\n\
 @deftypefnx {Loadable Function} @var{x} = linsolve (@var{a}, @var{b}, @var{options})\n\
 @deftypefnx {Loadable Function} [ @var{x}, @var{r} ] = linsolve (@var{a}, @var{b}, @var{options})\n\
+@deftypefnx {Loadable Function} [ @var{h}, @var{r} ] = linsolve ('factor', @var{a}, @var{options})\n\
+@deftypefnx {Loadable Function} [ @var{x}, @var{r} ] = linsolve ('solve', @var{h}, @var{b}, @var{options})\n\
+@deftypefnx {Loadable Function} linsolve ('free', @var{h})\n\
+@deftypefnx {Loadable Function} linsolve ('limit', @var{n})\n\
 \n\
 Solves the linear system @math{A*X = B} and returns @var{X}.\n\
 \n\
@@ -48,12 +382,27 @@ triangular; similarly, the @code{SYM} field can be set to @code{true} to \
 indicate that the matrix is symmetric.\n\
 \n\
 If requested, @var{r} will contain the reciprocal condition number.\n\
+\n\
+The factorization of @var{a} (Cholesky if @code{SYM} is @code{true} and \
+@var{a} is positive definite, LU otherwise) can be kept between calls: \
+@code{linsolve ('factor', @var{a})} returns a handle @var{h}, which can be \
+passed any number of times to @code{linsolve ('solve', @var{h}, @var{b})}. \
+The @code{TRANSA} option is then given to the solve, and the \
+@code{NUMTHREADS} field of @var{options} sets the number of threads among \
+which the columns of @var{b} are split. The factorization is freed by \
+@code{linsolve ('free', @var{h})} (@code{linsolve ('free')} frees all of \
+them), or automatically when more than @var{n} factorizations exist (16 by \
+default, see @code{linsolve ('limit', @var{n})}), the least recently used \
+being freed first.\n\
 @end deftypefn\n\
 ")
 {
   int nargin = args.length();
   octave_value_list retval;
 
+  if (nargin > 0 && args(0).is_string())
+    return handleCommand(args, nargout);
+
   if (nargin > 3 || nargin < 2 || nargout > 2)
     {
       print_usage();
@@ -121,3 +470,29 @@ If requested, @var{r} will contain the reciprocal condition number.\n\
 
   return retval;
 }
+
+/*
+
+  %!test
+  %! A = randn(50) + 50*eye(50);
+  %! B = randn(50, 7);
+  %! h = linsolve('factor', A);
+  %! assert(linsolve('solve', h, B), A\B, sqrt(eps))
+  %! opts.TRANSA = true;
+  %! opts.NUMTHREADS = 2;
+  %! assert(linsolve('solve', h, B, opts), A'\B, sqrt(eps))
+  %! linsolve('free', h);
+  %! fail("linsolve('solve', h, B)")
+
+  %!test
+  %! A = randn(20); A = A*A' + eye(20);
+  %! opts.SYM = true;
+  %! h = linsolve('factor', A, opts);
+  %! assert(linsolve('solve', h, eye(20)), inv(A), sqrt(eps))
+  %! linsolve('limit', 1);
+  %! h2 = linsolve('factor', eye(20));
+  %! fail("linsolve('solve', h, eye(20))")
+  %! linsolve('limit', 16);
+  %! linsolve('free');
+
+*/
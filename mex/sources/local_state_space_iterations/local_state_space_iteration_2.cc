@@ -22,221 +22,10 @@
  * using a second order approximation of the nonlinear state space model.
  */
 
-#include <iostream>
-#include <cstring>
-#include <vector>
 #include <dynmex.h>
-#include <dynblas.h>
+#include <instrumentation.hh>
 
-#ifdef USE_OMP
-# include <omp.h>
-#endif
-
-using namespace std;
-
-#define FIRST_ORDER_LOOP 1// Comment out this line to use mkl-blas instead of loops when computing ghx*yhat and ghu*epsilon
-
-void
-set_vector_of_indices(const int n, const int r, vector<int> &v1, vector<int> &v2, vector<int> &v3)
-{
-  const int m = n*(n+1)/2;
-  v1.resize(m, 0);
-  v2.resize(m, 0);
-  v3.resize(m, 0);
-  for (int i = 0, index = 0, jndex = 0; i < n; i++)
-    {
-      jndex += i;
-      for (int j = i; j < n; j++, index++, jndex++)
-        {
-          v1[index] = i;
-          v2[index] = j;
-          v3[index] = jndex*r;
-        }
-    }
-}
-
-void
-ss2Iteration_pruning(double *y2, double *y1, const double *yhat2, const double *yhat1, const double *epsilon,
-                     double *ghx, double *ghu,
-                     const double *constant, const double *ghxx, const double *ghuu, const double *ghxu, const double *ss,
-                     const blas_int m, const blas_int n, const blas_int q, const blas_int s, const int number_of_threads)
-{
-#ifndef FIRST_ORDER_LOOP
-  const char transpose[2] = "N";
-  const double one = 1.0;
-  const blas_int ONE = 1;
-#endif
-  vector<int> ii1, ii2, ii3;// vector indices for ghxx
-  vector<int> jj1, jj2, jj3;// vector indices for ghuu
-  set_vector_of_indices(n, m, ii1, ii2, ii3);
-  set_vector_of_indices(q, m, jj1, jj2, jj3);
-#ifdef USE_OMP
-# pragma omp parallel for num_threads(number_of_threads)
-#endif
-  for (int particle = 0; particle < s; particle++)
-    {
-      int particle_ = particle*m;
-      int particle__ = particle*n;
-      int particle___ = particle*q;
-      memcpy(&y2[particle_], &constant[0], m*sizeof(double));
-      memcpy(&y1[particle_], &ss[0], m*sizeof(double));
-#ifndef FIRST_ORDER_LOOP
-      dgemv(transpose, &m, &n, &one, &ghx[0], &m, &yhat2[particle__], &ONE, &one, &y2[particle_], &ONE);
-      dgemv(transpose, &m, &q, &one, &ghu[0], &m, &epsilon[particle___], &ONE, &one, &y2[particle_], &ONE);
-#endif
-      for (int variable = 0; variable < m; variable++)
-        {
-          int variable_ = variable + particle_;
-          // +ghx*yhat2+ghu*u
-#ifdef FIRST_ORDER_LOOP
-          for (int column = 0, column_ = 0; column < q; column++, column_ += m)
-            {
-              int i1 = variable+column_;
-              int i2 = column+particle__;
-              int i3 = column+particle___;
-              y2[variable_] += ghx[i1]*yhat2[i2];
-              y2[variable_] += ghu[i1]*epsilon[i3];
-            }
-          for (int column = q, column_ = q*m; column < n; column++, column_ += m)
-            {
-              y2[variable_] += ghx[variable+column_]*yhat2[column+particle__];
-            }
-#endif
-          // +ghxx*kron(yhat1,yhat1)
-          for (int i = 0; i < n*(n+1)/2; i++)
-            {
-              int i1 = particle__+ii1[i];
-              int i2 = particle__+ii2[i];
-              if (i1 == i2)
-                {
-                  y2[variable_] += .5*ghxx[variable+ii3[i]]*yhat1[i1]*yhat1[i1];
-                }
-              else
-                {
-                  y2[variable_] += ghxx[variable+ii3[i]]*yhat1[i1]*yhat1[i2];
-                }
-            }
-          // +ghuu*kron(u,u)
-          for (int j = 0; j < q*(q+1)/2; j++)
-            {
-              int j1 = particle___+jj1[j];
-              int j2 = particle___+jj2[j];
-              if (j1 == j2)
-                {
-                  y2[variable_] += .5*ghuu[variable+jj3[j]]*epsilon[j1]*epsilon[j1];
-                }
-              else
-                {
-                  y2[variable_] += ghuu[variable+jj3[j]]*epsilon[j1]*epsilon[j2];
-                }
-            }
-          // +ghxu*kron(yhat1,u)
-          for (int v = particle__, i = 0; v < particle__+n; v++)
-            for (int s = particle___; s < particle___+q; s++, i += m)
-              y2[variable_] += ghxu[variable+i]*epsilon[s]*yhat2[v];
-#ifdef FIRST_ORDER_LOOP
-          for (int column = 0, column_ = 0; column < q; column++, column_ += m)
-            {
-              int i1 = variable+column_;
-              int i2 = column+particle__;
-              int i3 = column+particle___;
-              y1[variable_] += ghx[i1]*yhat1[i2];
-              y1[variable_] += ghu[i1]*epsilon[i3];
-            }
-          for (int column = q, column_ = q*m; column < n; column++, column_ += m)
-            {
-              y1[variable_] += ghx[variable+column_]*yhat1[column+particle__];
-            }
-#endif
-        }
-#ifndef FIRST_ORDER_LOOP
-      dgemv(transpose, &m, &n, &one, &ghx[0], &m, &yhat1[particle__], &ONE, &one, &y1[particle_], &ONE);
-      dgemv(transpose, &m, &q, &one, &ghu[0], &m, &epsilon[particle___], &ONE, &one, &y1[particle_], &ONE);
-#endif
-    }
-}
-
-void
-ss2Iteration(double *y, const double *yhat, const double *epsilon,
-             double *ghx, double *ghu,
-             const double *constant, const double *ghxx, const double *ghuu, const double *ghxu,
-             const blas_int m, const blas_int n, const blas_int q, const blas_int s, const int number_of_threads)
-{
-#ifndef FIRST_ORDER_LOOP
-  const char transpose[2] = "N";
-  const double one = 1.0;
-  const blas_int ONE = 1;
-#endif
-  vector<int> ii1, ii2, ii3;// vector indices for ghxx
-  vector<int> jj1, jj2, jj3;// vector indices for ghuu
-  set_vector_of_indices(n, m, ii1, ii2, ii3);
-  set_vector_of_indices(q, m, jj1, jj2, jj3);
-#ifdef USE_OMP
-# pragma omp parallel for num_threads(number_of_threads)
-#endif
-  for (int particle = 0; particle < s; particle++)
-    {
-      int particle_ = particle*m;
-      int particle__ = particle*n;
-      int particle___ = particle*q;
-      memcpy(&y[particle_], &constant[0], m*sizeof(double));
-#ifndef FIRST_ORDER_LOOP
-      dgemv(transpose, &m, &n, &one, &ghx[0], &m, &yhat[particle__], &ONE, &one, &y[particle_], &ONE);
-      dgemv(transpose, &m, &q, &one, &ghu[0], &m, &epsilon[particle___], &ONE, &one, &y[particle_], &ONE);
-#endif
-      for (int variable = 0; variable < m; variable++)
-        {
-          int variable_ = variable + particle_;
-          // +ghx*yhat+ghu*u
-#ifdef FIRST_ORDER_LOOP
-          for (int column = 0, column_ = 0; column < q; column++, column_ += m)
-            {
-              int i1 = variable+column_;
-              int i2 = column+particle__;
-              int i3 = column+particle___;
-              y[variable_] += ghx[i1]*yhat[i2];
-              y[variable_] += ghu[i1]*epsilon[i3];
-            }
-          for (int column = q, column_ = q*m; column < n; column++, column_ += m)
-            {
-              y[variable_] += ghx[variable+column_]*yhat[column+particle__];
-            }
-#endif
-          // +ghxx*kron(yhat,yhat)
-          for (int i = 0; i < n*(n+1)/2; i++)
-            {
-              int i1 = particle__+ii1[i];
-              int i2 = particle__+ii2[i];
-              if (i1 == i2)
-                {
-                  y[variable_] += .5*ghxx[variable+ii3[i]]*yhat[i1]*yhat[i1];
-                }
-              else
-                {
-                  y[variable_] += ghxx[variable+ii3[i]]*yhat[i1]*yhat[i2];
-                }
-            }
-          // +ghuu*kron(u,u)
-          for (int j = 0; j < q*(q+1)/2; j++)
-            {
-              int j1 = particle___+jj1[j];
-              int j2 = particle___+jj2[j];
-              if (j1 == j2)
-                {
-                  y[variable_] += .5*ghuu[variable+jj3[j]]*epsilon[j1]*epsilon[j1];
-                }
-              else
-                {
-                  y[variable_] += ghuu[variable+jj3[j]]*epsilon[j1]*epsilon[j2];
-                }
-            }
-          // +ghxu*kron(yhat,u)
-          for (int v = particle__, i = 0; v < particle__+n; v++)
-            for (int s = particle___; s < particle___+q; s++, i += m)
-              y[variable_] += ghxu[variable+i]*epsilon[s]*yhat[v];
-        }
-    }
-}
+#include "ss2_iteration.hh"
 
 void
 mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
@@ -258,6 +47,10 @@ mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
   **
   */
 
+  if (Instrumentation::mexCommand("local_state_space_iteration_2", nlhs, plhs, nrhs, prhs))
+    return;
+  INSTRUMENT_SCOPE("local_state_space_iteration_2");
+
   // Check the number of input and output.
   if ((nrhs != 9) && (nrhs != 11))
     {
@@ -302,6 +95,7 @@ mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
           mexErrMsgTxt("Input dimension mismatch!.");
         }
     }
+  INSTRUMENT_COUNT("particles", s);
   // Get Input arrays.
   double *yhat = mxGetPr(prhs[0]);
   double *epsilon = mxGetPr(prhs[1]);
@@ -323,7 +117,7 @@ mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
       double *y;
       plhs[0] = mxCreateDoubleMatrix(m, s, mxREAL);
       y = mxGetPr(plhs[0]);
-      ss2Iteration(y, yhat, epsilon, ghx, ghu, constant, ghxx, ghuu, ghxu, (int) m, (int) n, (int) q, (int) s, numthreads);
+      ss2Iteration(y, NULL, yhat, yhat, epsilon, ghx, ghu, constant, ghxx, ghuu, ghxu, NULL, (int) m, (int) n, (int) q, (int) s, numthreads);
     }
   else
     {
@@ -333,6 +127,6 @@ mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
       plhs[1] = mxCreateDoubleMatrix(m, s, mxREAL);
       y = mxGetPr(plhs[0]);
       y_ = mxGetPr(plhs[1]);
-      ss2Iteration_pruning(y, y_, yhat, yhat_, epsilon, ghx, ghu, constant, ghxx, ghuu, ghxu, ss, (int) m, (int) n, (int) q, (int) s, numthreads);
+      ss2Iteration(y, y_, yhat, yhat_, epsilon, ghx, ghu, constant, ghxx, ghuu, ghxu, ss, (int) m, (int) n, (int) q, (int) s, numthreads);
     }
 }
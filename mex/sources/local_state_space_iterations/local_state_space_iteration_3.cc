@@ -0,0 +1,342 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This mex file computes particles at time t+1 given particles and innovations at time t,
+ * using a third order approximation of the nonlinear state space model, with or without
+ * the pruning scheme of Andreasen, Fernández-Villaverde and Rubio-Ramírez (2018).
+ *
+ * The derivatives of the decision rules are the folded tensors (FGSTensor) of dynare++,
+ * as returned in the last output of k_order_perturbation: each of their columns
+ * corresponds to a monomial of the states and innovations, with sorted indices
+ * (e.g. gyyu has a column for each x_i*x_j*u_k with i<=j). These monomials are
+ * computed only once per particle, and weighted by their multiplicity divided by
+ * the factorial of the order of the derivative.
+ *
+ * As in local_state_space_iteration_2, the particles are processed by tiles: the
+ * monomials of the particles of a tile are stacked in a matrix B (one column by
+ * particle), and the new particles are given by a single matrix product A*B, with
+ *   A = [ gy gu gyy gyu guu gyyy gyyu gyuu guuu gyss guss ]
+ * (three products per tile with pruning, one for each order of the pruned states,
+ * whose matrices B have zero rows for the blocks of A that they do not use).
+ */
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <dynmex.h>
+#include <dynblas.h>
+#include <instrumentation.hh>
+
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
+using namespace std;
+
+const blas_int particles_per_tile = 128;
+
+// Names of the blocks of A, and corresponding fields of the structure of derivatives
+const int number_of_blocks = 11;
+const char *block_names[number_of_blocks] = { "gy", "gu", "gyy", "gyu", "guu", "gyyy", "gyyu", "gyuu", "guuu", "gyss", "guss" };
+enum { gy, gu, gyy, gyu, guu, gyyy, gyyu, gyuu, guuu, gyss, guss };
+
+// Folded monomials of degree 2 of x (i<=j), weighted by 1/2 for the squares
+double *
+monomials2(const double *x, const blas_int n, double *b)
+{
+  for (blas_int i = 0; i < n; i++)
+    {
+      *b++ = .5*x[i]*x[i];
+      for (blas_int j = i+1; j < n; j++)
+        *b++ = x[i]*x[j];
+    }
+  return b;
+}
+
+// Folded monomials of degree 3 of x (i<=j<=k), weighted by their multiplicity divided by 3!
+double *
+monomials3(const double *x, const blas_int n, double *b)
+{
+  for (blas_int i = 0; i < n; i++)
+    for (blas_int j = i; j < n; j++)
+      for (blas_int k = j; k < n; k++)
+        *b++ = (i == k ? 1.0/6 : (i == j || j == k ? .5 : 1.0))*x[i]*x[j]*x[k];
+  return b;
+}
+
+// Monomials x_i*u_j (the column order of gyu)
+double *
+kronecker(const double *x, const blas_int n, const double *u, const blas_int q, double *b)
+{
+  for (blas_int i = 0; i < n; i++)
+    for (blas_int j = 0; j < q; j++)
+      *b++ = x[i]*u[j];
+  return b;
+}
+
+// Monomials x_i*x_j*u_k (i<=j) of gyyu, weighted by their multiplicity divided by 2!
+double *
+monomials21(const double *x, const blas_int n, const double *u, const blas_int q, double *b)
+{
+  for (blas_int i = 0; i < n; i++)
+    for (blas_int j = i; j < n; j++)
+      {
+        double xx = (i == j ? .5 : 1.0)*x[i]*x[j];
+        for (blas_int k = 0; k < q; k++)
+          *b++ = xx*u[k];
+      }
+  return b;
+}
+
+// Monomials x_i*u_j*u_k (j<=k) of gyuu, weighted by their multiplicity divided by 2!
+double *
+monomials12(const double *x, const blas_int n, const double *u, const blas_int q, double *b)
+{
+  for (blas_int i = 0; i < n; i++)
+    for (blas_int j = 0; j < q; j++)
+      for (blas_int k = j; k < q; k++)
+        *b++ = (j == k ? .5 : 1.0)*x[i]*u[j]*u[k];
+  return b;
+}
+
+// Folded products of x and y (i<=j) such that gyy*kron(x,y) is their product with the folded gyy
+double *
+symmetric_product(const double *x, const double *y, const blas_int n, double *b)
+{
+  for (blas_int i = 0; i < n; i++)
+    {
+      *b++ = x[i]*y[i];
+      for (blas_int j = i+1; j < n; j++)
+        *b++ = x[i]*y[j] + x[j]*y[i];
+    }
+  return b;
+}
+
+double *
+zeros(const blas_int n, double *b)
+{
+  memset(b, 0, n*sizeof(double));
+  return b + n;
+}
+
+/*
+ * Without pruning (yhat_s and yhat_rd are NULL), computes for each particle
+ *   y = ss + .5*gss + (gy+.5*gyss)*x + (gu+.5*guss)*u + .5*gyy*x² + gyu*kron(x,u) + .5*guu*u²
+ *       + gyyy*x³/6 + .5*gyyu*kron(x²,u) + .5*gyuu*kron(x,u²) + guuu*u³/6
+ * where x is yhat and u is epsilon. With pruning, the states are split into their
+ * first (x_f=yhat), second (x_s=yhat_s) and third (x_rd=yhat_rd) order parts, and
+ * the new ones are
+ *   y_f = gy*x_f + gu*u
+ *   y_s = .5*gss + gy*x_s + .5*gyy*x_f² + gyu*kron(x_f,u) + .5*guu*u²
+ *   y_rd = gy*x_rd + gyy*kron(x_f,x_s) + gyu*kron(x_s,u) + gyyy*x_f³/6 + .5*gyyu*kron(x_f²,u)
+ *          + .5*gyuu*kron(x_f,u²) + guuu*u³/6 + .5*gyss*x_f + .5*guss*u
+ *   y = ss + y_f + y_s + y_rd
+ */
+void
+ss3Iteration(double *y, double *y_f, double *y_s, double *y_rd,
+             const double *yhat, const double *yhat_s, const double *yhat_rd, const double *epsilon,
+             const double *const *g, const double *gss, const double *ss,
+             const blas_int m, const blas_int n, const blas_int q, const blas_int s, const int number_of_threads)
+{
+  const blas_int cols[number_of_blocks] = { n, q, n*(n+1)/2, n*q, q*(q+1)/2, n*(n+1)*(n+2)/6,
+                                            n*(n+1)/2*q, n*q*(q+1)/2, q*(q+1)*(q+2)/6, n, q };
+  blas_int k = 0;
+  for (int i = 0; i < number_of_blocks; i++)
+    k += cols[i];
+  // Number of columns of A used by the second order pruned states (up to guu)
+  const blas_int k_s = cols[gy] + cols[gu] + cols[gyy] + cols[gyu] + cols[guu];
+  const blas_int k_f = cols[gy] + cols[gu];
+  const double one = 1.0, zero = 0.0;
+  const bool pruning = (yhat_s != NULL);
+
+  vector<double> A(m*k);
+  for (int i = 0, offset = 0; i < number_of_blocks; offset += m*cols[i], i++)
+    memcpy(&A[offset], g[i], m*cols[i]*sizeof(double));
+
+  // Second order correction of the constant
+  vector<double> constant(m);
+  for (blas_int i = 0; i < m; i++)
+    constant[i] = .5*gss[i];
+
+  const int number_of_tiles = (s + particles_per_tile - 1)/particles_per_tile;
+#ifdef USE_OMP
+# pragma omp parallel num_threads(number_of_threads)
+#endif
+  {
+    vector<double> B(k*particles_per_tile), B_s(pruning ? k_s*particles_per_tile : 0),
+      B_rd(pruning ? k*particles_per_tile : 0);
+#ifdef USE_OMP
+# pragma omp for
+#endif
+    for (int tile = 0; tile < number_of_tiles; tile++)
+      {
+        const blas_int first = tile*particles_per_tile;
+        const blas_int np = (first + particles_per_tile <= s ? particles_per_tile : s - first);
+        for (blas_int particle = first; particle < first + np; particle++)
+          {
+            const double *x = &yhat[particle*n], *u = &epsilon[particle*q];
+            if (!pruning)
+              {
+                double *b = &B[(particle-first)*k];
+                memcpy(b, x, n*sizeof(double));
+                memcpy(b+n, u, q*sizeof(double));
+                b = monomials2(x, n, b+n+q);
+                b = kronecker(x, n, u, q, b);
+                b = monomials2(u, q, b);
+                b = monomials3(x, n, b);
+                b = monomials21(x, n, u, q, b);
+                b = monomials12(x, n, u, q, b);
+                b = monomials3(u, q, b);
+                for (blas_int i = 0; i < n; i++)
+                  *b++ = .5*x[i];
+                for (blas_int i = 0; i < q; i++)
+                  *b++ = .5*u[i];
+                for (blas_int i = 0; i < m; i++)
+                  y[particle*m+i] = ss[i] + constant[i];
+                continue;
+              }
+
+            const double *x_s = &yhat_s[particle*n], *x_rd = &yhat_rd[particle*n];
+            // First order: [x_f;u]
+            double *b = &B[(particle-first)*k_f];
+            memcpy(b, x, n*sizeof(double));
+            memcpy(b+n, u, q*sizeof(double));
+            // Second order: [x_s;0;x_f²;kron(x_f,u);u²]
+            b = &B_s[(particle-first)*k_s];
+            memcpy(b, x_s, n*sizeof(double));
+            b = zeros(q, b+n);
+            b = monomials2(x, n, b);
+            b = kronecker(x, n, u, q, b);
+            monomials2(u, q, b);
+            // Third order: [x_rd;0;kron(x_f,x_s);kron(x_s,u);0;x_f³;kron(x_f²,u);kron(x_f,u²);u³;x_f/2;u/2]
+            b = &B_rd[(particle-first)*k];
+            memcpy(b, x_rd, n*sizeof(double));
+            b = zeros(q, b+n);
+            b = symmetric_product(x, x_s, n, b);
+            b = kronecker(x_s, n, u, q, b);
+            b = zeros(cols[guu], b);
+            b = monomials3(x, n, b);
+            b = monomials21(x, n, u, q, b);
+            b = monomials12(x, n, u, q, b);
+            b = monomials3(u, q, b);
+            for (blas_int i = 0; i < n; i++)
+              *b++ = .5*x[i];
+            for (blas_int i = 0; i < q; i++)
+              *b++ = .5*u[i];
+            memcpy(&y_s[particle*m], &constant[0], m*sizeof(double));
+          }
+        if (!pruning)
+          {
+            dgemm("N", "N", &m, &np, &k, &one, &A[0], &m, &B[0], &k, &one, &y[first*m], &m);
+            continue;
+          }
+        dgemm("N", "N", &m, &np, &k_f, &one, &A[0], &m, &B[0], &k_f, &zero, &y_f[first*m], &m);
+        dgemm("N", "N", &m, &np, &k_s, &one, &A[0], &m, &B_s[0], &k_s, &one, &y_s[first*m], &m);
+        dgemm("N", "N", &m, &np, &k, &one, &A[0], &m, &B_rd[0], &k, &zero, &y_rd[first*m], &m);
+        for (blas_int i = first*m; i < (first+np)*m; i++)
+          y[i] = ss[i % m] + y_f[i] + y_s[i] + y_rd[i];
+      }
+  }
+}
+
+void
+mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+  /*
+  ** Without pruning:
+  ** prhs[0] yhat          [double]  n*s array, time t particles (deviations from the steady state).
+  ** prhs[1] epsilon       [double]  q*s array, time t innovations.
+  ** prhs[2] derivs        [struct]  folded derivatives of the decision rules (fields gy, gu, gyy, gyu, guu, gss,
+  **                                 gyyy, gyyu, gyuu, guuu, gyss and guss, as returned by k_order_perturbation),
+  **                                 restricted to the m rows of the union of the states and observed variables.
+  ** prhs[3] ss            [double]  m*1 array, steady state for the union of the states and observed variables.
+  ** prhs[4] numthreads    [double]  number of threads.
+  **
+  ** plhs[0] y             [double]  m*s array, time t+1 particles.
+  **
+  ** With pruning, the first three arguments are the first, second and third order states (n*s arrays),
+  ** followed by epsilon, derivs, ss and numthreads, and
+  ** plhs[0] y             [double]  m*s array, time t+1 particles.
+  ** plhs[1..3] y_f, y_s, y_rd [double]  m*s arrays, time t+1 first, second and third order pruned states.
+  */
+
+  if (Instrumentation::mexCommand("local_state_space_iteration_3", nlhs, plhs, nrhs, prhs))
+    return;
+  INSTRUMENT_SCOPE("local_state_space_iteration_3");
+
+  if (nrhs != 5 && nrhs != 7)
+    mexErrMsgTxt("Five or seven input arguments are required.");
+  const bool pruning = (nrhs == 7);
+  if ((!pruning && nlhs > 1) || (pruning && nlhs != 4))
+    mexErrMsgTxt("One output argument is required without pruning, and four with pruning.");
+
+  const int p = pruning ? 2 : 0; // Shift of the arguments after the states
+  const mxArray *derivs = prhs[p+2];
+  if (!mxIsStruct(derivs))
+    mexErrMsgTxt("The derivatives must be a structure.");
+
+  // Get dimensions.
+  size_t n = mxGetM(prhs[0]);// Number of states.
+  size_t s = mxGetN(prhs[0]);// Number of particles.
+  size_t q = mxGetM(prhs[p+1]);// Number of innovations.
+  size_t m = mxGetM(prhs[p+3]);// Number of elements in the union of states and observed variables.
+  if (s != mxGetN(prhs[p+1]) || mxGetN(prhs[p+3]) != 1)
+    mexErrMsgTxt("Input dimension mismatch!.");
+  if (pruning)
+    for (int i = 1; i < 3; i++)
+      if (mxGetM(prhs[i]) != n || mxGetN(prhs[i]) != s)
+        mexErrMsgTxt("Input dimension mismatch!.");
+
+  const size_t cols[number_of_blocks] = { n, q, n*(n+1)/2, n*q, q*(q+1)/2, n*(n+1)*(n+2)/6,
+                                          n*(n+1)/2*q, n*q*(q+1)/2, q*(q+1)*(q+2)/6, n, q };
+  const double *g[number_of_blocks];
+  for (int i = 0; i < number_of_blocks; i++)
+    {
+      const mxArray *field = mxGetField(derivs, 0, block_names[i]);
+      if (field == NULL || !mxIsDouble(field) || mxGetM(field) != m || mxGetN(field) != cols[i])
+        {
+          string msg = string("Field ") + block_names[i] + " of the derivatives is missing or has wrong dimensions.";
+          mexErrMsgTxt(msg.c_str());
+        }
+      g[i] = mxGetPr(field);
+    }
+  const mxArray *gss = mxGetField(derivs, 0, "gss");
+  if (gss == NULL || !mxIsDouble(gss) || mxGetM(gss) != m || mxGetN(gss) != 1)
+    mexErrMsgTxt("Field gss of the derivatives is missing or has wrong dimensions.");
+
+  INSTRUMENT_COUNT("particles", s);
+  const double *epsilon = mxGetPr(prhs[p+1]);
+  const double *ss = mxGetPr(prhs[p+3]);
+  int numthreads = (int) mxGetScalar(prhs[p+4]);
+
+  plhs[0] = mxCreateDoubleMatrix(m, s, mxREAL);
+  double *y = mxGetPr(plhs[0]);
+  if (pruning)
+    {
+      for (int i = 1; i < 4; i++)
+        plhs[i] = mxCreateDoubleMatrix(m, s, mxREAL);
+      ss3Iteration(y, mxGetPr(plhs[1]), mxGetPr(plhs[2]), mxGetPr(plhs[3]),
+                   mxGetPr(prhs[0]), mxGetPr(prhs[1]), mxGetPr(prhs[2]), epsilon,
+                   g, mxGetPr(gss), ss, (int) m, (int) n, (int) q, (int) s, numthreads);
+    }
+  else
+    ss3Iteration(y, NULL, NULL, NULL, mxGetPr(prhs[0]), NULL, NULL, epsilon,
+                 g, mxGetPr(gss), ss, (int) m, (int) n, (int) q, (int) s, numthreads);
+}
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This mex file performs one period of a sequential importance particle filter
+ * with a second order approximation of the nonlinear state space model: it
+ * propagates the particles, computes their Gaussian measurement log-densities,
+ * updates and normalizes the weights (with the log-sum-exp trick), and
+ * resamples the particles (systematic or stratified resampling) if the
+ * effective sample size falls below a threshold. The particles only cross the
+ * MATLAB interface once per period.
+ */
+
+#include <cmath>
+#include <vector>
+#include <dynmex.h>
+#include <dynlapack.h>
+#include <instrumentation.hh>
+
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
+#include "ss2_iteration.hh"
+
+using namespace std;
+
+/*
+ * Computes the log-density of the measurement y-Y of each particle, where y
+ * collects the rows mf1 of the propagated particles and the measurement error
+ * has covariance LL' (L lower triangular, p*p). The log-weights lnw are
+ * incremented by these log-densities, and the function returns their maximum.
+ */
+double
+measurementLogDensities(double *lnw, const double *y, const double *Y, const vector<blas_int> &mf1, const double *L,
+                        const double logdet, const blas_int m, const blas_int s, const int number_of_threads)
+{
+  const blas_int p = mf1.size();
+  const double c = -.5*(p*log(2*M_PI) + logdet);
+  double lnw_max = -INFINITY;
+#ifdef USE_OMP
+# pragma omp parallel num_threads(number_of_threads)
+#endif
+  {
+    vector<double> z(p);
+    double local_max = -INFINITY;
+#ifdef USE_OMP
+# pragma omp for
+#endif
+    for (blas_int particle = 0; particle < s; particle++)
+      {
+        // Solves L*z = y-Y by forward substitution
+        double zz = 0.0;
+        for (blas_int i = 0; i < p; i++)
+          {
+            double zi = y[particle*m+mf1[i]] - Y[i];
+            for (blas_int j = 0; j < i; j++)
+              zi -= L[j*p+i]*z[j];
+            z[i] = zi/L[i*p+i];
+            zz += z[i]*z[i];
+          }
+        lnw[particle] += c - .5*zz;
+        if (lnw[particle] > local_max)
+          local_max = lnw[particle];
+      }
+#ifdef USE_OMP
+# pragma omp critical
+#endif
+    if (local_max > lnw_max)
+      lnw_max = local_max;
+  }
+  return lnw_max;
+}
+
+/*
+ * Selects the indices of the resampled particles, given the normalized weights
+ * and one uniform draw (systematic resampling) or s uniform draws (stratified
+ * resampling). The j-th particle is drawn at the position (j+u_j)/s of the
+ * cumulated weights.
+ */
+void
+resamplingIndices(vector<blas_int> &indices, const double *weights, const double *u, const bool stratified,
+                  const blas_int s)
+{
+  double cumulated = weights[0];
+  blas_int i = 0;
+  for (blas_int j = 0; j < s; j++)
+    {
+      const double position = (j + u[stratified ? j : 0])/s;
+      while (cumulated < position && i < s - 1)
+        cumulated += weights[++i];
+      indices[j] = i;
+    }
+}
+
+void
+mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+  /*
+  ** prhs[0] yhat          [double]  n*s array, time t particles (deviations from the steady state).
+  ** prhs[1] epsilon       [double]  q*s array, time t innovations.
+  ** prhs[2] ghx           [double]  m*n array, first order reduced form.
+  ** prhs[3] ghu           [double]  m*q array, first order reduced form.
+  ** prhs[4] constant      [double]  m*1 array, deterministic steady state + second order correction for the union of the states and observed variables.
+  ** prhs[5] ghxx          [double]  m*n^2 array, second order reduced form.
+  ** prhs[6] ghuu          [double]  m*q^2 array, second order reduced form.
+  ** prhs[7] ghxu          [double]  m*nq array, second order reduced form.
+  ** prhs[8] weights       [double]  1*s array, time t weights of the particles.
+  ** prhs[9] Y             [double]  p*1 array, time t+1 observations.
+  ** prhs[10] mf0          [double]  n*1 array, indices of the states in the union of the states and observed variables.
+  ** prhs[11] mf1          [double]  p*1 array, indices of the observed variables in the union of the states and observed variables.
+  ** prhs[12] H            [double]  p*p array, covariance matrix of the measurement errors (positive definite).
+  ** prhs[13] ss           [double]  n*1 array, steady state of the states.
+  ** prhs[14] u            [double]  scalar (systematic resampling) or 1*s array (stratified resampling), uniform draws in [0,1).
+  ** prhs[15] threshold    [double]  scalar, the particles are resampled if the effective sample size is below threshold*s.
+  ** prhs[16] numthreads   [double]  scalar, number of threads.
+  **
+  ** plhs[0] yhat          [double]  n*s array, time t+1 particles (deviations from the steady state).
+  ** plhs[1] weights       [double]  1*s array, time t+1 normalized weights of the particles.
+  ** plhs[2] lik           [double]  scalar, log-likelihood of the time t+1 observations.
+  ** plhs[3] resampled     [double]  scalar, 1 if the particles have been resampled, 0 otherwise.
+  **
+  */
+
+  if (Instrumentation::mexCommand("particle_filter_step", nlhs, plhs, nrhs, prhs))
+    return;
+  INSTRUMENT_SCOPE("particle_filter_step");
+
+  // Check the number of input and output.
+  if (nrhs != 17)
+    {
+      mexErrMsgTxt("Seventeen input arguments are required.");
+    }
+  if (nlhs > 4)
+    {
+      mexErrMsgTxt("Too many output arguments.");
+    }
+  // Get dimensions.
+  size_t n = mxGetM(prhs[0]);// Number of states.
+  size_t s = mxGetN(prhs[0]);// Number of particles.
+  size_t q = mxGetM(prhs[1]);// Number of innovations.
+  size_t m = mxGetM(prhs[2]);// Number of elements in the union of states and observed variables.
+  size_t p = mxGetM(prhs[9]);// Number of observed variables.
+  size_t nu = mxGetNumberOfElements(prhs[14]);// Number of uniform draws.
+  // Check the dimensions.
+  if (
+      (s != mxGetN(prhs[1]))      // Number of columns for epsilon
+      || (n != mxGetN(prhs[2])) // Number of columns for ghx
+      || (m != mxGetM(prhs[3])) // Number of rows for ghu
+      || (q != mxGetN(prhs[3])) // Number of columns for ghu
+      || (m != mxGetM(prhs[4])) // Number of rows for 2nd order constant correction + deterministic steady state
+      || (m != mxGetM(prhs[5])) // Number of rows for ghxx
+      || (n*n != mxGetN(prhs[5])) // Number of columns for ghxx
+      || (m != mxGetM(prhs[6])) // Number of rows for ghuu
+      || (q*q != mxGetN(prhs[6])) // Number of columns for ghuu
+      || (m != mxGetM(prhs[7])) // Number of rows for ghxu
+      || (n*q != mxGetN(prhs[7]))    // Number of rows for ghxu
+      || (s != mxGetNumberOfElements(prhs[8])) // Number of weights
+      || (n != mxGetNumberOfElements(prhs[10])) // Number of indices of the states
+      || (p != mxGetNumberOfElements(prhs[11])) // Number of indices of the observed variables
+      || (p != mxGetM(prhs[12])) // Number of rows for H
+      || (p != mxGetN(prhs[12])) // Number of columns for H
+      || (n != mxGetNumberOfElements(prhs[13])) // Number of elements of the steady state
+      || (nu != 1 && nu != s)   // Number of uniform draws
+      )
+    {
+      mexErrMsgTxt("Input dimension mismatch!.");
+    }
+  // Get Input arrays.
+  double *yhat = mxGetPr(prhs[0]);
+  double *epsilon = mxGetPr(prhs[1]);
+  double *ghx = mxGetPr(prhs[2]);
+  double *ghu = mxGetPr(prhs[3]);
+  double *constant = mxGetPr(prhs[4]);
+  double *ghxx = mxGetPr(prhs[5]);
+  double *ghuu = mxGetPr(prhs[6]);
+  double *ghxu = mxGetPr(prhs[7]);
+  double *weights = mxGetPr(prhs[8]);
+  double *Y = mxGetPr(prhs[9]);
+  double *ss = mxGetPr(prhs[13]);
+  double *u = mxGetPr(prhs[14]);
+  double threshold = mxGetScalar(prhs[15]);
+  int numthreads = (int) mxGetScalar(prhs[16]);
+
+  vector<blas_int> mf0(n), mf1(p);
+  for (size_t i = 0; i < n; i++)
+    {
+      mf0[i] = (blas_int) mxGetPr(prhs[10])[i] - 1;
+      if (mf0[i] < 0 || mf0[i] >= (blas_int) m)
+        mexErrMsgTxt("The indices of the states are out of bounds.");
+    }
+  for (size_t i = 0; i < p; i++)
+    {
+      mf1[i] = (blas_int) mxGetPr(prhs[11])[i] - 1;
+      if (mf1[i] < 0 || mf1[i] >= (blas_int) m)
+        mexErrMsgTxt("The indices of the observed variables are out of bounds.");
+    }
+
+  // Cholesky decomposition of the covariance matrix of the measurement errors
+  vector<double> L(mxGetPr(prhs[12]), mxGetPr(prhs[12]) + p*p);
+  lapack_int info, lp = p;
+  dpotrf("L", &lp, &L[0], &lp, &info);
+  if (info != 0)
+    mexErrMsgTxt("The covariance matrix of the measurement errors is not positive definite.");
+  double logdet = 0.0;
+  for (size_t i = 0; i < p; i++)
+    logdet += 2*log(L[i*p+i]);
+
+  // Propagation of the particles
+  vector<double> y(m*s);
+  ss2Iteration(&y[0], NULL, yhat, yhat, epsilon, ghx, ghu, constant, ghxx, ghuu, ghxu, NULL, (int) m, (int) n, (int) q, (int) s, numthreads);
+
+  // Update and normalization of the weights
+  plhs[1] = mxCreateDoubleMatrix(1, s, mxREAL);
+  double *w = mxGetPr(plhs[1]);
+  for (size_t particle = 0; particle < s; particle++)
+    w[particle] = log(weights[particle]);
+  double lnw_max = measurementLogDensities(w, &y[0], Y, mf1, &L[0], logdet, m, s, numthreads);
+  double sum = 0.0;
+  for (size_t particle = 0; particle < s; particle++)
+    {
+      w[particle] = exp(w[particle] - lnw_max);
+      sum += w[particle];
+    }
+  double sum2 = 0.0;
+  for (size_t particle = 0; particle < s; particle++)
+    {
+      w[particle] /= sum;
+      sum2 += w[particle]*w[particle];
+    }
+  if (nlhs > 2)
+    plhs[2] = mxCreateDoubleScalar(log(sum) + lnw_max);
+
+  // Resampling of the particles if the effective sample size 1/sum(w.^2) is too small
+  bool resample = (1.0 < threshold*s*sum2);
+  vector<blas_int> indices;
+  INSTRUMENT_COUNT("particles", s);
+  INSTRUMENT_COUNT("resamplings", resample);
+  if (resample)
+    {
+      indices.resize(s);
+      resamplingIndices(indices, w, u, nu == s, s);
+      for (size_t particle = 0; particle < s; particle++)
+        w[particle] = 1.0/s;
+    }
+  plhs[0] = mxCreateDoubleMatrix(n, s, mxREAL);
+  double *yhat_new = mxGetPr(plhs[0]);
+#ifdef USE_OMP
+# pragma omp parallel for num_threads(numthreads)
+#endif
+  for (int particle = 0; particle < (int) s; particle++)
+    {
+      const double *x = &y[(resample ? indices[particle] : particle)*m];
+      for (size_t i = 0; i < n; i++)
+        yhat_new[particle*n+i] = x[mf0[i]] - ss[i];
+    }
+  if (nlhs > 3)
+    plhs[3] = mxCreateDoubleScalar(resample ? 1.0 : 0.0);
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2010-2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Second order iteration of the particles, shared by local_state_space_iteration_2
+ * and particle_filter_step.
+ */
+
+#include <cstring>
+#include <vector>
+
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
+#include "ss2_iteration.hh"
+
+using namespace std;
+
+/*
+ * The particles are processed by tiles. For each tile, the terms of the
+ * second order approximation of all its particles are stacked in a matrix B,
+ * with one column by particle:
+ *   B = [ yhat ; epsilon ; kron_u(yhat,yhat) ; kron_u(epsilon,epsilon) ; kron(yhat,epsilon) ]
+ * where kron_u only keeps the products of the upper triangle (and halves those
+ * of the diagonal). The new particles are then given by a single matrix
+ * product per tile, y = constant + A*B with
+ *   A = [ ghx ghu ghxx_u ghuu_u ghxu ]
+ * where ghxx_u and ghuu_u are the columns of ghxx and ghuu matching kron_u.
+ */
+const blas_int particles_per_tile = 128;
+
+// Copies into a the columns of the m*n^2 matrix g matching the upper triangle of kron(x,x), and returns the end of the copy
+static double *
+copy_upper_kronecker_columns(const double *g, const blas_int m, const blas_int n, double *a)
+{
+  for (blas_int i = 0; i < n; i++)
+    for (blas_int j = i; j < n; j++, a += m)
+      memcpy(a, &g[(i*n+j)*m], m*sizeof(double));
+  return a;
+}
+
+// Stores the upper triangle of kron(x,x) in b (halving the squares), and returns the end of the storage
+static double *
+upper_kronecker_product(const double *x, const blas_int n, double *b)
+{
+  for (blas_int i = 0; i < n; i++)
+    {
+      *b++ = .5*x[i]*x[i];
+      for (blas_int j = i+1; j < n; j++)
+        *b++ = x[i]*x[j];
+    }
+  return b;
+}
+
+void
+ss2Iteration(double *y, double *y_, const double *yhat, const double *yhat_, const double *epsilon,
+             const double *ghx, const double *ghu,
+             const double *constant, const double *ghxx, const double *ghuu, const double *ghxu, const double *ss,
+             const blas_int m, const blas_int n, const blas_int q, const blas_int s, const int number_of_threads)
+{
+  const blas_int nq = n + q, k = nq + n*(n+1)/2 + q*(q+1)/2 + n*q;
+  const double one = 1.0;
+
+  // A=[ghx ghu ghxx_u ghuu_u ghxu]
+  vector<double> A(m*k);
+  memcpy(&A[0], ghx, m*n*sizeof(double));
+  memcpy(&A[m*n], ghu, m*q*sizeof(double));
+  double *a = copy_upper_kronecker_columns(ghxx, m, n, &A[m*nq]);
+  a = copy_upper_kronecker_columns(ghuu, m, q, a);
+  memcpy(a, ghxu, m*n*q*sizeof(double));
+
+  const int number_of_tiles = (s + particles_per_tile - 1)/particles_per_tile;
+#ifdef USE_OMP
+# pragma omp parallel num_threads(number_of_threads)
+#endif
+  {
+    vector<double> B(k*particles_per_tile), B_(y_ ? nq*particles_per_tile : 0);
+#ifdef USE_OMP
+# pragma omp for
+#endif
+    for (int tile = 0; tile < number_of_tiles; tile++)
+      {
+        const blas_int first = tile*particles_per_tile;
+        const blas_int np = (first + particles_per_tile <= s ? particles_per_tile : s - first);
+        for (blas_int particle = first; particle < first + np; particle++)
+          {
+            const double *x = &yhat[particle*n], *x_ = &yhat_[particle*n], *u = &epsilon[particle*q];
+            double *b = &B[(particle-first)*k];
+            memcpy(b, x, n*sizeof(double));
+            memcpy(b+n, u, q*sizeof(double));
+            b = upper_kronecker_product(x_, n, b+nq);
+            b = upper_kronecker_product(u, q, b);
+            for (blas_int v = 0; v < n; v++)
+              for (blas_int i = 0; i < q; i++)
+                *b++ = x[v]*u[i];
+            memcpy(&y[particle*m], constant, m*sizeof(double));
+            if (y_)
+              {
+                memcpy(&B_[(particle-first)*nq], x_, n*sizeof(double));
+                memcpy(&B_[(particle-first)*nq+n], u, q*sizeof(double));
+                memcpy(&y_[particle*m], ss, m*sizeof(double));
+              }
+          }
+        dgemm("N", "N", &m, &np, &k, &one, &A[0], &m, &B[0], &k, &one, &y[first*m], &m);
+        // y_=ss+[ghx ghu]*[yhat_;epsilon]
+        if (y_)
+          dgemm("N", "N", &m, &np, &nq, &one, &A[0], &m, &B_[0], &nq, &one, &y_[first*m], &m);
+      }
+  }
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2010-2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SS2_ITERATION_HH
+#define _SS2_ITERATION_HH
+
+#include <dynblas.h>
+
+/*
+ * Computes y = constant + ghx*yhat + ghu*epsilon + .5*ghxx*kron(yhat_,yhat_)
+ * + .5*ghuu*kron(epsilon,epsilon) + ghxu*kron(yhat,epsilon) for the s
+ * particles. Without pruning, yhat_ is yhat and y_ is NULL. With pruning,
+ * y_ = ss + ghx*yhat_ + ghu*epsilon.
+ */
+void ss2Iteration(double *y, double *y_, const double *yhat, const double *yhat_, const double *epsilon,
+                  const double *ghx, const double *ghu,
+                  const double *constant, const double *ghxx, const double *ghuu, const double *ghxu, const double *ss,
+                  const blas_int m, const blas_int n, const blas_int q, const blas_int s, const int number_of_threads);
+
+#endif
@@ -18,11 +18,16 @@
  */
 
 #include <string.h>
+#include <stdlib.h>
 #include <math.h>
 
 #include <dynmex.h>
 #include <dynlapack.h>
 
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
 double criterium;
 
 lapack_int
@@ -31,37 +36,55 @@ my_criteria(const double *alphar, const double *alphai, const double *beta)
   return ((*alphar **alphar + *alphai **alphai) < criterium **beta **beta);
 }
 
-void
-mjdgges(double *a, double *b, double *z, double *n, double *sdim, double *eval_r, double *eval_i, double zhreshold, double *info)
+/* Workspace of dgges, allocated once per thread and reused for all the pencils of a batch */
+typedef struct
 {
-  lapack_int i_n, i_info, i_sdim, lwork;
-  double *alphar, *alphai, *beta, *work, *par, *pai, *pb, *per, *pei;
-  double *junk;
+  double *alphar, *alphai, *beta, *work, *junk;
   lapack_int *bwork;
+  lapack_int lwork;
+} mjdgges_workspace;
 
-  i_n = (lapack_int)*n;
-  alphar = mxCalloc(i_n, sizeof(double));
-  alphai = mxCalloc(i_n, sizeof(double));
-  beta = mxCalloc(i_n, sizeof(double));
-  lwork = 16*i_n+16;
-  work = mxCalloc(lwork, sizeof(double));
-  bwork = mxCalloc(i_n, sizeof(lapack_int));
+int
+alloc_workspace(mjdgges_workspace *ws, lapack_int i_n)
+{
+  ws->lwork = 16*i_n+16;
+  ws->alphar = calloc(i_n, sizeof(double));
+  ws->alphai = calloc(i_n, sizeof(double));
+  ws->beta = calloc(i_n, sizeof(double));
+  ws->work = calloc(ws->lwork, sizeof(double));
+  ws->bwork = calloc(i_n, sizeof(lapack_int));
   /* made necessary by bug in Lapack */
-  junk = mxCalloc(i_n*i_n, sizeof(double));
+  ws->junk = calloc(i_n*i_n, sizeof(double));
+  return (i_n == 0 || (ws->alphar && ws->alphai && ws->beta && ws->bwork && ws->junk)) && ws->work;
+}
+
+void
+free_workspace(mjdgges_workspace *ws)
+{
+  free(ws->alphar);
+  free(ws->alphai);
+  free(ws->beta);
+  free(ws->work);
+  free(ws->bwork);
+  free(ws->junk);
+}
 
-  dgges("N", "V", "S", my_criteria, &i_n, a, &i_n, b, &i_n, &i_sdim, alphar, alphai, beta, junk, &i_n, z, &i_n, work, &lwork, bwork, &i_info);
+void
+mjdgges(double *a, double *b, double *z, lapack_int i_n, double *sdim, double *eval_r, double *eval_i, double zhreshold, double *info,
+        mjdgges_workspace *ws)
+{
+  lapack_int i_info, i_sdim, i;
+
+  dgges("N", "V", "S", my_criteria, &i_n, a, &i_n, b, &i_n, &i_sdim, ws->alphar, ws->alphai, ws->beta, ws->junk, &i_n, z, &i_n,
+        ws->work, &ws->lwork, ws->bwork, &i_info);
 
   *sdim = i_sdim;
   *info = i_info;
 
-  par = alphar;
-  pai = alphai;
-  pb = beta;
-  pei = eval_i;
-  for (per = eval_r; per <= &eval_r[i_n-1]; ++per)
+  for (i = 0; i < i_n; i++)
     {
-      if ((fabs(*par) > zhreshold) || (fabs(*pb) > zhreshold))
-        *per = *par / *pb;
+      if ((fabs(ws->alphar[i]) > zhreshold) || (fabs(ws->beta[i]) > zhreshold))
+        eval_r[i] = ws->alphar[i] / ws->beta[i];
       else
         {
           /* the ratio is too close to 0/0;
@@ -69,14 +92,10 @@ mjdgges(double *a, double *b, double *z, double *n, double *sdim, double *eval_r
           if (i_info == 0)
             *info = -30;
         }
-      if (*pai == 0.0 && *pb == 0.0)
-        *pei = 0.0;
+      if (ws->alphai[i] == 0.0 && ws->beta[i] == 0.0)
+        eval_i[i] = 0.0;
       else
-        *pei = *pai / *pb;
-      ++par;
-      ++pai;
-      ++pb;
-      ++pei;
+        eval_i[i] = ws->alphai[i] / ws->beta[i];
     }
 }
 
@@ -86,33 +105,50 @@ mexFunction(int nlhs, mxArray *plhs[],
             int nrhs, const mxArray *prhs[])
 
 {
-  unsigned int m1, n1, m2, n2;
+  size_t n1, npencils, k;
+  const mwSize *dims;
+  mwSize ndims, array_dims[3];
   double *s, *t, *z, *sdim, *eval_r, *eval_i, *info, *a, *b;
-  double n;
+  int failed;
 
   /* Check for proper number of arguments */
 
-  if (nrhs < 2 || nrhs > 4 || nlhs == 0 || nlhs > 7)
-    DYN_MEX_FUNC_ERR_MSG_TXT("MJDGGES: takes 2, 3 or 4 input arguments and between 1 and 7 output arguments.");
+  if (nrhs < 2 || nrhs > 5 || nlhs == 0 || nlhs > 7)
+    DYN_MEX_FUNC_ERR_MSG_TXT("MJDGGES: takes between 2 and 5 input arguments and between 1 and 7 output arguments.");
 
-  /* Check that A and B are real matrices of the same dimension.*/
+  /* Check that A and B are real matrices (or 3-D arrays of matrices) of the same dimensions.*/
 
-  m1 = mxGetM(prhs[0]);
-  n1 = mxGetN(prhs[0]);
-  m2 = mxGetM(prhs[1]);
-  n2 = mxGetN(prhs[1]);
+  ndims = mxGetNumberOfDimensions(prhs[0]);
+  dims = mxGetDimensions(prhs[0]);
+  n1 = dims[0];
+  npencils = (ndims == 3 ? dims[2] : 1);
   if (!mxIsDouble(prhs[0]) || mxIsComplex(prhs[0])
       || !mxIsDouble(prhs[1]) || mxIsComplex(prhs[1])
-      || (m1 != n1) || (m2 != n1) || (m2 != n2))
-    DYN_MEX_FUNC_ERR_MSG_TXT("MJDGGES requires two square real matrices of the same dimension.");
+      || ndims > 3 || dims[1] != n1
+      || mxGetNumberOfDimensions(prhs[1]) != ndims
+      || memcmp(mxGetDimensions(prhs[1]), dims, ndims*sizeof(mwSize)))
+    DYN_MEX_FUNC_ERR_MSG_TXT("MJDGGES requires two square real matrices (or two n*n*N arrays of square real matrices) of the same dimension.");
 
   /* Create a matrix for the return argument */
-  plhs[1] = mxCreateDoubleMatrix(n1, n1, mxREAL);
-  plhs[2] = mxCreateDoubleMatrix(n1, n1, mxREAL);
-  plhs[3] = mxCreateDoubleMatrix(n1, n1, mxREAL);
-  plhs[4] = mxCreateDoubleMatrix(1, 1, mxREAL);
-  plhs[5] = mxCreateDoubleMatrix(n1, 1, mxCOMPLEX);
-  plhs[6] = mxCreateDoubleMatrix(1, 1, mxREAL);
+  if (ndims == 3)
+    {
+      /* Batch of pencils: the results are stacked along the third dimension (ss, tt, w) or the columns (sdim, eigval, info) */
+      array_dims[0] = n1;
+      array_dims[1] = n1;
+      array_dims[2] = npencils;
+      plhs[1] = mxCreateNumericArray(3, array_dims, mxDOUBLE_CLASS, mxREAL);
+      plhs[2] = mxCreateNumericArray(3, array_dims, mxDOUBLE_CLASS, mxREAL);
+      plhs[3] = mxCreateNumericArray(3, array_dims, mxDOUBLE_CLASS, mxREAL);
+    }
+  else
+    {
+      plhs[1] = mxCreateDoubleMatrix(n1, n1, mxREAL);
+      plhs[2] = mxCreateDoubleMatrix(n1, n1, mxREAL);
+      plhs[3] = mxCreateDoubleMatrix(n1, n1, mxREAL);
+    }
+  plhs[4] = mxCreateDoubleMatrix(1, npencils, mxREAL);
+  plhs[5] = mxCreateDoubleMatrix(n1, npencils, mxCOMPLEX);
+  plhs[6] = mxCreateDoubleMatrix(1, npencils, mxREAL);
 
   /* Assign pointers to the various parameters */
   s = mxGetPr(plhs[1]);
@@ -138,7 +174,7 @@ mexFunction(int nlhs, mxArray *plhs[],
 
   /* set criterium for 0/0 generalized eigenvalues */
   double zhreshold;
-  if (nrhs == 4 && mxGetM(prhs[3]) > 0)
+  if (nrhs >= 4 && mxGetM(prhs[3]) > 0)
     {
       zhreshold = *mxGetPr(prhs[3]);
     }
@@ -147,14 +183,41 @@ mexFunction(int nlhs, mxArray *plhs[],
       zhreshold = 1e-6;
     }
 
-  /* keep a and b intact */
-  memcpy(s, a, sizeof(double)*n1*n1);
-  memcpy(t, b, sizeof(double)*n1*n1);
+#ifdef USE_OMP
+  /* set the number of threads used for a batch of pencils */
+  int numthreads;
+  if (nrhs == 5)
+    numthreads = (int) mxGetScalar(prhs[4]);
+  else
+    numthreads = 1;
+#endif
 
-  n = n1;
+  /* keep a and b intact */
+  memcpy(s, a, sizeof(double)*n1*n1*npencils);
+  memcpy(t, b, sizeof(double)*n1*n1*npencils);
 
   /* Do the actual computations in a subroutine */
-  mjdgges(s, t, z, &n, sdim, eval_r, eval_i, zhreshold, info);
+  failed = 0;
+#ifdef USE_OMP
+# pragma omp parallel num_threads(numthreads) reduction(||:failed)
+#endif
+  {
+    mjdgges_workspace ws;
+    if (alloc_workspace(&ws, (lapack_int) n1))
+      {
+#ifdef USE_OMP
+# pragma omp for schedule(dynamic)
+#endif
+        for (k = 0; k < npencils; k++)
+          mjdgges(&s[k*n1*n1], &t[k*n1*n1], &z[k*n1*n1], (lapack_int) n1, &sdim[k], &eval_r[k*n1], &eval_i[k*n1],
+                  zhreshold, &info[k], &ws);
+      }
+    else
+      failed = 1;
+    free_workspace(&ws);
+  }
+  if (failed)
+    DYN_MEX_FUNC_ERR_MSG_TXT("MJDGGES: out of memory.");
 
   plhs[0] = mxCreateDoubleScalar(0);
 }
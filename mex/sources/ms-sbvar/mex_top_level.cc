@@ -17,6 +17,19 @@
  * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+/*
+ * The MEX file accepts three forms of input:
+ * - a string of space separated options, as on the command line;
+ * - a cell array of strings, each one being one option or one option value
+ *   (values may then contain spaces, e.g. file paths);
+ * - a cell array of such cell arrays, each one being a specification run in
+ *   turn. The output is then a vector holding the status of each run (0 on
+ *   success, 1 on error), and an error in one run does not prevent the
+ *   following ones.
+ * Note that the MS-SBVAR routines keep global state, so the runs of a batch
+ * can not be done concurrently within one MATLAB process.
+ */
+
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
@@ -26,74 +39,152 @@
 
 int main(int nargs, char **args);
 
-void
-mexFunction(int nlhs, mxArray *plhs[],
-            int nrhs, const mxArray *prhs[])
-{
-  int nargs = 0;
-  int n = 0;
-  int maxnargs = 0;
-
-  const char *mainarg = "./a.out";
-  char *argument = NULL;
-  char *beginarg = NULL;
-  char **args = NULL;
-
-  /*
-   * Check args
-   */
-  if (nrhs != 1 || !mxIsChar(prhs[0]) || nlhs != 1)
-    DYN_MEX_FUNC_ERR_MSG_TXT("Error in MS-SBVAR MEX file: this function takes 1 string input argument and returns 1 output argument.");
-
-  /*
-   * Allocate memory
-   */
-  maxnargs = (int) (mxGetN(prhs[0])/2+1);
-  argument = (char *) mxCalloc(mxGetN(prhs[0])+1, sizeof(char));
-  args = (char **) mxCalloc(maxnargs, sizeof(char *));
-  if (argument == NULL || args == NULL)
-    DYN_MEX_FUNC_ERR_MSG_TXT("Error in MS-SBVAR MEX file: could not allocate memory. (1)");
+static const char *mainarg = "./a.out";
 
-  /*
-   * Create argument string from prhs and parse to create args / nargs
-   */
-  if (!(args[nargs] = (char *) mxCalloc(strlen(mainarg)+1, sizeof(char))))
-    DYN_MEX_FUNC_ERR_MSG_TXT("Error in MS-SBVAR MEX file: could not allocate memory. (2)");
-
-  strncpy(args[nargs++], mainarg, strlen(mainarg));
+/* Copies a string with mxCalloc, returns NULL if memory is exhausted */
+static char *
+copy_arg(const char *src, size_t n)
+{
+  char *dst = (char *) mxCalloc(n+1, sizeof(char));
+  if (dst != NULL)
+    strncpy(dst, src, n);
+  return dst;
+}
 
-  if (mxGetString(prhs[0], argument, mxGetN(prhs[0])+1))
-    DYN_MEX_FUNC_ERR_MSG_TXT("Error in MS-SBVAR MEX file: error using mxGetString.\n");
+/* Splits a string of space separated options, returns NULL on error */
+static char **
+args_from_string(const mxArray *str, int &nargs)
+{
+  size_t n;
+  char *argument = (char *) mxCalloc(mxGetN(str)+1, sizeof(char));
+  char **args = (char **) mxCalloc(mxGetN(str)/2+2, sizeof(char *));
+  if (argument == NULL || args == NULL
+      || mxGetString(str, argument, mxGetN(str)+1))
+    return NULL;
 
-  beginarg = &argument[0];
+  nargs = 0;
+  if (!(args[nargs++] = copy_arg(mainarg, strlen(mainarg))))
+    return NULL;
+  char *beginarg = &argument[0];
   while ((n = strcspn(beginarg, " ")))
     {
-      if (!(args[nargs] = (char *) mxCalloc(n+1, sizeof(char))))
-        DYN_MEX_FUNC_ERR_MSG_TXT("Error in MS-SBVAR MEX file: could not allocate memory. (3)");
-
-      strncpy(args[nargs++], beginarg, n);
+      if (!(args[nargs++] = copy_arg(beginarg, n)))
+        return NULL;
       beginarg += (isspace(beginarg[n]) || isblank(beginarg[n]) ? ++n : n);
     }
   mxFree(argument);
+  return args;
+}
 
-  /*
-   * Call top_level function (formerly main)
-   */
+/* Takes the options from a cell array of strings, returns NULL on error */
+static char **
+args_from_cell(const mxArray *cell, int &nargs)
+{
+  size_t ncells = mxGetNumberOfElements(cell);
+  char **args = (char **) mxCalloc(ncells+1, sizeof(char *));
+  if (args == NULL)
+    return NULL;
+
+  nargs = 0;
+  if (!(args[nargs++] = copy_arg(mainarg, strlen(mainarg))))
+    return NULL;
+  for (size_t i = 0; i < ncells; i++)
+    {
+      const mxArray *elt = mxGetCell(cell, i);
+      if (elt == NULL || !mxIsChar(elt))
+        return NULL;
+      if (!(args[nargs++] = mxArrayToString(elt)))
+        return NULL;
+    }
+  return args;
+}
+
+static void
+free_args(char **args, int nargs)
+{
+  for (int n = 0; n < nargs; n++)
+    mxFree(args[n]);
+  mxFree(args);
+}
+
+/* Calls the top_level function (formerly main), returns NULL on success or the error message */
+static const char *
+run(char **args, int nargs)
+{
   try
     {
       main(nargs, args);
     }
   catch (const char *str)
     {
-      DYN_MEX_FUNC_ERR_MSG_TXT(str);
+      return str;
+    }
+  return NULL;
+}
+
+static bool
+is_batch(const mxArray *arg)
+{
+  if (!mxIsCell(arg) || mxGetNumberOfElements(arg) == 0)
+    return false;
+  for (size_t i = 0; i < mxGetNumberOfElements(arg); i++)
+    {
+      const mxArray *elt = mxGetCell(arg, i);
+      if (elt == NULL || !mxIsCell(elt))
+        return false;
+    }
+  return true;
+}
+
+void
+mexFunction(int nlhs, mxArray *plhs[],
+            int nrhs, const mxArray *prhs[])
+{
+  int nargs = 0;
+  char **args = NULL;
+
+  /*
+   * Check args
+   */
+  if (nrhs != 1 || !(mxIsChar(prhs[0]) || mxIsCell(prhs[0])) || nlhs != 1)
+    DYN_MEX_FUNC_ERR_MSG_TXT("Error in MS-SBVAR MEX file: this function takes 1 string or cell array input argument and returns 1 output argument.");
+
+  if (is_batch(prhs[0]))
+    {
+      size_t nruns = mxGetNumberOfElements(prhs[0]);
+      plhs[0] = mxCreateDoubleMatrix(nruns, 1, mxREAL);
+      double *status = mxGetPr(plhs[0]);
+      for (size_t i = 0; i < nruns; i++)
+        {
+          if (!(args = args_from_cell(mxGetCell(prhs[0], i), nargs)))
+            DYN_MEX_FUNC_ERR_MSG_TXT("Error in MS-SBVAR MEX file: each specification must be a cell array of strings.");
+          const char *err = run(args, nargs);
+          if (err != NULL)
+            mexPrintf("%s", err);
+          status[i] = err == NULL ? 0 : 1;
+          free_args(args, nargs);
+        }
+      return;
     }
 
+  /*
+   * Create args / nargs from prhs
+   */
+  if (mxIsChar(prhs[0]))
+    args = args_from_string(prhs[0], nargs);
+  else
+    args = args_from_cell(prhs[0], nargs);
+  if (args == NULL)
+    DYN_MEX_FUNC_ERR_MSG_TXT("Error in MS-SBVAR MEX file: could not parse the options (options must be strings).");
+
+  const char *err = run(args, nargs);
+  if (err != NULL)
+    DYN_MEX_FUNC_ERR_MSG_TXT(err);
+
   /*
    * free memory
    */
-  for (n = 0; n < nargs; n++)
-    mxFree(args[n]);
-  mxFree(args);
+  free_args(args, nargs);
 
   plhs[0] = mxCreateDoubleScalar(0);
 }
@@ -26,6 +26,9 @@
  * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <vector>
+
 #include <octave/oct.h>
 #include <octave/f77-fcn.h>
 
@@ -38,22 +41,161 @@ extern "C"
                             double *, double *, octave_idx_type &, double &, double &, double *,
                             const octave_idx_type &, octave_idx_type *,
                             const octave_idx_type &, octave_idx_type &);
+
+  F77_RET_T
+  F77_FUNC(dtrexc, DTREXC) (F77_CONST_CHAR_ARG_DECL, const octave_idx_type &,
+                            double *, const octave_idx_type &, double *, const octave_idx_type &,
+                            octave_idx_type &, octave_idx_type &, double *, octave_idx_type &);
+
+  F77_RET_T
+  F77_FUNC(dgemm, DGEMM) (F77_CONST_CHAR_ARG_DECL, F77_CONST_CHAR_ARG_DECL,
+                          const octave_idx_type &, const octave_idx_type &, const octave_idx_type &,
+                          const double &, const double *, const octave_idx_type &,
+                          const double *, const octave_idx_type &,
+                          const double &, double *, const octave_idx_type &);
+}
+
+// Default size of the windows of the blocked reordering (unblocked dtrsen is used for smaller matrices)
+const octave_idx_type default_window_size = 64;
+
+// Size of the diagonal block of T starting at row i
+static inline octave_idx_type
+blockSize(const double *T, octave_idx_type n, octave_idx_type i)
+{
+  return (i < n-1 && T[i+1+i*n] != 0.0) ? 2 : 1;
+}
+
+/*
+ * Moves the selected blocks of the window T(w1:w2-1,w1:w2-1) to its top with
+ * dtrexc, applied to the window only, and accumulates the orthogonal
+ * transformation in Qw. The rows and columns of T outside the window are then
+ * updated with level-3 BLAS. Returns the number of selected rows at the top of
+ * the window, or -1 if a swap has been rejected.
+ */
+static octave_idx_type
+reorderWindow(double *T, double *U, octave_idx_type n, std::vector<bool> &select,
+              octave_idx_type w1, octave_idx_type w2, std::vector<double> &Qw,
+              std::vector<double> &work, std::vector<double> &tmp)
+{
+  octave_idx_type nw = w2 - w1;
+  std::fill(Qw.begin(), Qw.begin() + nw*nw, 0.0);
+  for (octave_idx_type i = 0; i < nw; i++)
+    Qw[i*nw+i] = 1.0;
+
+  octave_idx_type top = w1;
+  octave_idx_type i = w1;
+  bool moved = false;
+  while (i < w2)
+    {
+      octave_idx_type bs = blockSize(T, n, i);
+      if (select[i])
+        {
+          if (i > top)
+            {
+              octave_idx_type ifst = i - w1 + 1, ilst = top - w1 + 1, info;
+              F77_XFCN(dtrexc, DTREXC, (F77_CONST_CHAR_ARG("V"), nw, T + w1 + w1*n, n, &Qw[0], nw,
+                                        ifst, ilst, &work[0], info));
+              if (info != 0)
+                return -1;
+              std::rotate(select.begin() + top, select.begin() + i, select.begin() + i + bs);
+              moved = true;
+            }
+          top += bs;
+        }
+      i += bs;
+    }
+  if (!moved)
+    return top - w1;
+
+  double one = 1.0, zero = 0.0;
+  // T(0:w1-1,w1:w2-1) = T(0:w1-1,w1:w2-1)*Qw
+  if (w1 > 0)
+    {
+      F77_XFCN(dgemm, DGEMM, (F77_CONST_CHAR_ARG("N"), F77_CONST_CHAR_ARG("N"), w1, nw, nw,
+                              one, T + w1*n, n, &Qw[0], nw, zero, &tmp[0], w1));
+      for (octave_idx_type j = 0; j < nw; j++)
+        std::copy(&tmp[j*w1], &tmp[j*w1] + w1, T + (w1+j)*n);
+    }
+  // T(w1:w2-1,w2:n-1) = Qw'*T(w1:w2-1,w2:n-1)
+  if (w2 < n)
+    {
+      F77_XFCN(dgemm, DGEMM, (F77_CONST_CHAR_ARG("T"), F77_CONST_CHAR_ARG("N"), nw, n-w2, nw,
+                              one, &Qw[0], nw, T + w1 + w2*n, n, zero, &tmp[0], nw));
+      for (octave_idx_type j = 0; j < n-w2; j++)
+        std::copy(&tmp[j*nw], &tmp[j*nw] + nw, T + w1 + (w2+j)*n);
+    }
+  // U(:,w1:w2-1) = U(:,w1:w2-1)*Qw
+  F77_XFCN(dgemm, DGEMM, (F77_CONST_CHAR_ARG("N"), F77_CONST_CHAR_ARG("N"), n, nw, nw,
+                          one, U + w1*n, n, &Qw[0], nw, zero, &tmp[0], n));
+  std::copy(tmp.begin(), tmp.begin() + n*nw, U + w1*n);
+  return top - w1;
+}
+
+/*
+ * Blocked reordering of the real Schur form (Kressner, 2006, "Block algorithms
+ * for reordering standard and generalized Schur forms", ACM TOMS 32(4)). The
+ * next selected eigenvalues are gathered into a bunch of at most nw/2 rows,
+ * which is then moved up to its final position with a chain of overlapping
+ * windows of nw rows. The swaps only touch the current window; the rest of T
+ * and U is updated with matrix-matrix products once per window.
+ */
+static bool
+blockedReorder(double *T, double *U, octave_idx_type n, std::vector<bool> &select, octave_idx_type nw)
+{
+  std::vector<double> Qw(nw*nw), work(nw), tmp(n*nw);
+  octave_idx_type ilst = 0;
+  while (true)
+    {
+      while (ilst < n && select[ilst])
+        ilst++;
+      octave_idx_type ifst = ilst;
+      while (ifst < n && !select[ifst])
+        ifst++;
+      if (ifst == n)
+        break;
+
+      // Gathers the selected eigenvalues of T(ifst:w2-1,ifst:w2-1) at its top
+      octave_idx_type w2 = ifst;
+      while (w2 < n && w2 + blockSize(T, n, w2) <= ifst + nw/2)
+        w2 += blockSize(T, n, w2);
+      octave_idx_type k = reorderWindow(T, U, n, select, ifst, w2, Qw, work, tmp);
+      if (k < 0)
+        return false;
+
+      // Moves the bunch T(ifst:ifst+k-1,ifst:ifst+k-1) up to row ilst
+      while (ifst > ilst)
+        {
+          octave_idx_type w1 = std::max(ilst, ifst + k - nw);
+          if (w1 > 0 && T[w1+(w1-1)*n] != 0.0)
+            w1++;
+          if (reorderWindow(T, U, n, select, w1, ifst + k, Qw, work, tmp) != k)
+            return false;
+          ifst = w1;
+        }
+      ilst = ifst + k;
+    }
+  return true;
 }
 
 DEFUN_DLD(ordschur, args, nargout, "-*- texinfo -*-\n\
 @deftypefn {Loadable Function} [ @var{us}, @var{ts} ] = ordschur (@var{u}, @var{t}, @var{select})\n\
+@deftypefnx {Loadable Function} [ @var{us}, @var{ts} ] = ordschur (@var{u}, @var{t}, @var{select}, @var{nw})\n\
 \n\
 Reorders the real Schur factorization @math{X = U*T*U'} so that selected\n\
 eigenvalues appear in the upper left diagonal blocks of the quasi triangular\n\
 Schur matrix @math{T}. The logical vector @var{select} specifies the selected\n\
 eigenvalues as they appear along @math{T}'s diagonal.\n\
+\n\
+Matrices larger than @var{nw} (64 by default) are reordered by a blocked\n\
+algorithm working on windows of size @var{nw}. If @var{nw} is 0, the\n\
+unblocked LAPACK routine dtrsen is used.\n\
 @end deftypefn\n\
 ")
 {
   int nargin = args.length();
   octave_value_list retval;
 
-  if (nargin != 3 || nargout != 2)
+  if (nargin < 3 || nargin > 4 || nargout != 2)
     {
       print_usage();
       return retval;
@@ -78,6 +220,38 @@ eigenvalues as they appear along @math{T}'s diagonal.\n\
       error("ordschur: selection vector has wrong size");
       return retval;
     }
+  octave_idx_type nw = default_window_size;
+  if (nargin > 3)
+    {
+      nw = args(3).idx_type_value();
+      if (error_state || (nw != 0 && nw < 4))
+        {
+          error("ordschur: window size must be 0 or larger than 3");
+          return retval;
+        }
+    }
+
+  if (nw > 0 && n > nw)
+    {
+      // A 2x2 block is selected if one of its eigenvalues is selected (as in dtrsen)
+      std::vector<bool> select(n);
+      for (octave_idx_type i = 0; i < n; i++)
+        select[i] = S(i);
+      for (octave_idx_type i = 0; i < n - 1; i++)
+        if (T(i+1, i) != 0.0)
+          {
+            select[i] = select[i+1] = (select[i] || select[i+1]);
+            i++;
+          }
+      if (!blockedReorder(T.fortran_vec(), U.fortran_vec(), n, select, nw))
+        {
+          error("ordschur: dtrexc failed");
+          return retval;
+        }
+      retval(0) = octave_value(U);
+      retval(1) = octave_value(T);
+      return retval;
+    }
 
   octave_idx_type lwork = n, liwork = n;
   OCTAVE_LOCAL_BUFFER(double, wr, n);
@@ -114,4 +288,13 @@ eigenvalues as they appear along @math{T}'s diagonal.\n\
   %! [US, TS] = ordschur(U, T, [ 0 0 1 1 ]);
   %! assert(US*TS*US', A, sqrt(eps))
 
+  %!test
+  %! A = randn(300);
+  %! [U, T] = schur(A);
+  %! S = abs(ordeig(T)) > 1;
+  %! [US, TS] = ordschur(U, T, S, 8);
+  %! assert(US*TS*US', A, sqrt(eps)*norm(A))
+  %! assert(all(abs(ordeig(TS(1:sum(S),1:sum(S)))) > 1))
+  %! assert(all(abs(ordeig(TS(sum(S)+1:end,sum(S)+1:end))) <= 1))
+
 */
@@ -0,0 +1,588 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * [endo_simul, status, err, iterations] = perfect_foresight_newton(endo_simul, exo_simul, steady_state, M_, options_)
+ *
+ * Solves the perfect foresight problem by a Newton method on the stacked
+ * system, as sim1.m, calling the dynamic model compiled with the use_dll
+ * option. The model must have one lag and one lead (lead_lag_incidence with
+ * three rows, maximum_lag and maximum_lead equal to 1).
+ *
+ * endo_simul (endo_nbr*(periods+2)) holds the initial guess, the initial
+ * and the terminal conditions, and is returned with the solution in its
+ * columns 2 to periods+1. status is true if the Newton iterations converged
+ * (max(abs(residuals)) < options_.dynatol.f) to a finite solution, err is
+ * the largest absolute residual at the last iteration and iterations is the
+ * number of iterations.
+ *
+ * At each iteration, the residuals and the Jacobian of the equations of the
+ * successive periods are evaluated in parallel (with
+ * options_.threads.perfect_foresight_newton threads, if compiled with
+ * OpenMP), and scattered in the stacked Jacobian, stored in compressed
+ * sparse column form. Its sparsity pattern is built once from the pattern of
+ * the Jacobian of one period (the one exported by the DLL with the
+ * sparse_jacobian option, or else the union of the nonzero elements over the
+ * periods), and only rebuilt if a new nonzero element appears. The pattern
+ * being fixed, the symbolic analysis of the sparse LU factorization is done
+ * once and reused across the iterations, with UMFPACK or, if
+ * options_.simul.sparse_backend is 'klu', KLU (the pivot sequence of the
+ * previous factorization is then also reused, as long as it remains stable).
+ *
+ * The dynamic model is evaluated from several threads: this requires that it
+ * does not call external functions written in MATLAB.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dynmex.h>
+#include "dynumfpack.h"
+#ifdef HAVE_KLU
+# include <klu.h>
+#endif
+
+#include "dynamic_dll.hh"
+#include "dynare_exception.h"
+
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
+//! Below this reciprocal condition number estimate, a KLU refactorization is replaced by a factorization with pivoting
+const double klu_refactor_rcond = 1e-12;
+
+/* Sparse LU factorization of the stacked Jacobian. The symbolic analysis only
+   depends on the sparsity pattern, hence it is kept until newPattern() is called */
+class StackedJacobianSolver
+{
+private:
+  bool use_klu;
+  void *Symbolic, *Numeric;
+  double Control[UMFPACK_CONTROL], Info[UMFPACK_INFO];
+#ifdef HAVE_KLU
+  klu_l_common KLU_Common;
+  klu_l_symbolic *KLU_Symbolic;
+  klu_l_numeric *KLU_Numeric;
+#endif
+  void freeFactorizations();
+public:
+  StackedJacobianSolver(bool use_klu_arg);
+  ~StackedJacobianSolver();
+  void newPattern();
+  void factorize(SuiteSparse_long n, const SuiteSparse_long *Ap, const SuiteSparse_long *Ai, const double *Ax) throw (DynareException);
+  // Solves A*x = b, with A factorized by the last call to factorize()
+  void solve(SuiteSparse_long n, const SuiteSparse_long *Ap, const SuiteSparse_long *Ai, const double *Ax,
+             double *x, const double *b) throw (DynareException);
+};
+
+StackedJacobianSolver::StackedJacobianSolver(bool use_klu_arg) :
+  use_klu(use_klu_arg), Symbolic(NULL), Numeric(NULL)
+{
+  umfpack_dl_defaults(Control);
+#ifdef HAVE_KLU
+  klu_l_defaults(&KLU_Common);
+  KLU_Symbolic = NULL;
+  KLU_Numeric = NULL;
+#endif
+}
+
+StackedJacobianSolver::~StackedJacobianSolver()
+{
+  freeFactorizations();
+}
+
+void
+StackedJacobianSolver::freeFactorizations()
+{
+  if (Symbolic)
+    umfpack_dl_free_symbolic(&Symbolic);
+  if (Numeric)
+    umfpack_dl_free_numeric(&Numeric);
+  Symbolic = Numeric = NULL;
+#ifdef HAVE_KLU
+  if (KLU_Numeric)
+    klu_l_free_numeric(&KLU_Numeric, &KLU_Common);
+  if (KLU_Symbolic)
+    klu_l_free_symbolic(&KLU_Symbolic, &KLU_Common);
+  KLU_Symbolic = NULL;
+  KLU_Numeric = NULL;
+#endif
+}
+
+void
+StackedJacobianSolver::newPattern()
+{
+  freeFactorizations();
+}
+
+void
+StackedJacobianSolver::factorize(SuiteSparse_long n, const SuiteSparse_long *Ap, const SuiteSparse_long *Ai,
+                                 const double *Ax) throw (DynareException)
+{
+#ifdef HAVE_KLU
+  if (use_klu)
+    {
+      if (!KLU_Symbolic)
+        {
+          KLU_Symbolic = klu_l_analyze(n, const_cast<SuiteSparse_long *>(Ap), const_cast<SuiteSparse_long *>(Ai), &KLU_Common);
+          if (!KLU_Symbolic)
+            {
+              std::ostringstream msg;
+              msg << "klu_l_analyze failed (status = " << KLU_Common.status << ")";
+              throw DynareException(__FILE__, __LINE__, msg.str());
+            }
+        }
+      bool refactored = false;
+      if (KLU_Numeric
+          && klu_l_refactor(const_cast<SuiteSparse_long *>(Ap), const_cast<SuiteSparse_long *>(Ai), const_cast<double *>(Ax),
+                            KLU_Symbolic, KLU_Numeric, &KLU_Common)
+          && klu_l_rcond(KLU_Symbolic, KLU_Numeric, &KLU_Common))
+        refactored = KLU_Common.rcond >= klu_refactor_rcond;
+      if (!refactored)
+        {
+          if (KLU_Numeric)
+            klu_l_free_numeric(&KLU_Numeric, &KLU_Common);
+          KLU_Numeric = klu_l_factor(const_cast<SuiteSparse_long *>(Ap), const_cast<SuiteSparse_long *>(Ai), const_cast<double *>(Ax),
+                                     KLU_Symbolic, &KLU_Common);
+          if (!KLU_Numeric)
+            {
+              std::ostringstream msg;
+              msg << "klu_l_factor failed (status = " << KLU_Common.status << ")";
+              throw DynareException(__FILE__, __LINE__, msg.str());
+            }
+        }
+      return;
+    }
+#endif
+  SuiteSparse_long status;
+  if (!Symbolic)
+    {
+      status = umfpack_dl_symbolic(n, n, Ap, Ai, Ax, &Symbolic, Control, Info);
+      if (status < 0)
+        {
+          umfpack_dl_report_status(Control, status);
+          throw DynareException(__FILE__, __LINE__, "umfpack_dl_symbolic failed");
+        }
+    }
+  if (Numeric)
+    umfpack_dl_free_numeric(&Numeric);
+  status = umfpack_dl_numeric(Ap, Ai, Ax, Symbolic, &Numeric, Control, Info);
+  if (status < 0)
+    {
+      umfpack_dl_report_status(Control, status);
+      throw DynareException(__FILE__, __LINE__, "umfpack_dl_numeric failed");
+    }
+}
+
+void
+StackedJacobianSolver::solve(SuiteSparse_long n, const SuiteSparse_long *Ap, const SuiteSparse_long *Ai, const double *Ax,
+                             double *x, const double *b) throw (DynareException)
+{
+#ifdef HAVE_KLU
+  if (use_klu)
+    {
+      memcpy(x, b, n*sizeof(double));
+      if (!klu_l_solve(KLU_Symbolic, KLU_Numeric, n, 1, x, &KLU_Common))
+        {
+          std::ostringstream msg;
+          msg << "klu_l_solve failed (status = " << KLU_Common.status << ")";
+          throw DynareException(__FILE__, __LINE__, msg.str());
+        }
+      return;
+    }
+#endif
+  SuiteSparse_long status = umfpack_dl_solve(0, Ap, Ai, Ax, x, b, Numeric, Control, Info);
+  // A singular matrix is only a warning for UMFPACK: the non-finite elements of the solution are set to zero below
+  if (status < 0)
+    {
+      umfpack_dl_report_status(Control, status);
+      throw DynareException(__FILE__, __LINE__, "umfpack_dl_solve failed");
+    }
+}
+
+/* Element (row, column) of the Jacobian of one period (with respect to the
+   endogenous variables of the dynamic model), at position src of the
+   Jacobian returned by the DLL */
+struct JacobianElement
+{
+  int row, col, src;
+};
+
+/* Returns the name of the first of the fields (a NULL terminated list) which
+   is missing in the structure s, or NULL if they all exist */
+static const char *
+missing_field(const mxArray *s, const char **fields)
+{
+  for (int i = 0; fields[i] != NULL; i++)
+    if (mxGetField(s, 0, fields[i]) == NULL)
+      return fields[i];
+  return NULL;
+}
+
+void
+mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+  if (nrhs != 5)
+    DYN_MEX_FUNC_ERR_MSG_TXT("perfect_foresight_newton: exactly five input arguments are required.");
+  if (nlhs > 4)
+    DYN_MEX_FUNC_ERR_MSG_TXT("perfect_foresight_newton: at most four output arguments are returned.");
+  for (int i = 0; i < 3; i++)
+    if (!mxIsDouble(prhs[i]) || mxIsComplex(prhs[i]) || mxIsSparse(prhs[i]))
+      DYN_MEX_FUNC_ERR_MSG_TXT("perfect_foresight_newton: endo_simul, exo_simul and steady_state must be real dense matrices.");
+  if (!mxIsStruct(prhs[3]) || !mxIsStruct(prhs[4]))
+    DYN_MEX_FUNC_ERR_MSG_TXT("perfect_foresight_newton: M_ and options_ must be structures.");
+  const mxArray *M_ = prhs[3], *options_ = prhs[4];
+
+  const char *M_fields[] = { "fname", "params", "endo_nbr", "exo_nbr", "exo_det_nbr", "lead_lag_incidence",
+                             "maximum_lag", "maximum_lead", "NNZDerivatives", NULL };
+  const char *options_fields[] = { "periods", "dynatol", "simul", "verbosity", NULL };
+  const char *simul_fields[] = { "maxit", NULL };
+  const char *dynatol_fields[] = { "f", NULL };
+  const char *missing = missing_field(M_, M_fields);
+  if (missing == NULL)
+    missing = missing_field(options_, options_fields);
+  if (missing == NULL)
+    missing = missing_field(mxGetField(options_, 0, "simul"), simul_fields);
+  if (missing == NULL)
+    missing = missing_field(mxGetField(options_, 0, "dynatol"), dynatol_fields);
+  if (missing != NULL)
+    DYN_MEX_FUNC_ERR_MSG_TXT((std::string("perfect_foresight_newton: missing field ") + missing + " in M_ or options_.").c_str());
+
+  const int ny = static_cast<int>(mxGetScalar(mxGetField(M_, 0, "endo_nbr")));
+  const int nexo = static_cast<int>(mxGetScalar(mxGetField(M_, 0, "exo_nbr")))
+    + static_cast<int>(mxGetScalar(mxGetField(M_, 0, "exo_det_nbr")));
+  const mxArray *lli_mx = mxGetField(M_, 0, "lead_lag_incidence");
+  if (mxGetM(lli_mx) != 3 || static_cast<int>(mxGetN(lli_mx)) != ny
+      || mxGetScalar(mxGetField(M_, 0, "maximum_lag")) != 1
+      || mxGetScalar(mxGetField(M_, 0, "maximum_lead")) != 1)
+    DYN_MEX_FUNC_ERR_MSG_TXT("perfect_foresight_newton: the model must have exactly one lag and one lead.");
+  const mxArray *params_mx = mxGetField(M_, 0, "params");
+  const mxArray *nnz_mx = mxGetField(M_, 0, "NNZDerivatives");
+  char *fname_c = mxArrayToString(mxGetField(M_, 0, "fname"));
+  std::string fname(fname_c);
+  mxFree(fname_c);
+
+  const int periods = static_cast<int>(mxGetScalar(mxGetField(options_, 0, "periods")));
+  const double tolf = mxGetScalar(mxGetField(mxGetField(options_, 0, "dynatol"), 0, "f"));
+  const mxArray *simul = mxGetField(options_, 0, "simul");
+  const int maxit = static_cast<int>(mxGetScalar(mxGetField(simul, 0, "maxit")));
+  const bool verbose = mxGetScalar(mxGetField(options_, 0, "verbosity")) != 0;
+  bool use_klu = false;
+  const mxArray *backend_mx = mxGetField(simul, 0, "sparse_backend");
+  if (backend_mx != NULL && mxIsChar(backend_mx))
+    {
+      char *backend = mxArrayToString(backend_mx);
+      std::string backend_name(backend);
+      mxFree(backend);
+      if (backend_name == "klu")
+        {
+#ifdef HAVE_KLU
+          use_klu = true;
+#else
+          DYN_MEX_FUNC_ERR_MSG_TXT("perfect_foresight_newton has been compiled without KLU, sparse_backend=klu is not available");
+#endif
+        }
+      else if (backend_name != "umfpack")
+        DYN_MEX_FUNC_ERR_MSG_TXT(("perfect_foresight_newton: unknown sparse_backend: " + backend_name).c_str());
+    }
+  int number_of_threads = 1;
+  const mxArray *threads = mxGetField(options_, 0, "threads");
+  if (threads != NULL && mxGetField(threads, 0, "perfect_foresight_newton") != NULL)
+    number_of_threads = static_cast<int>(mxGetScalar(mxGetField(threads, 0, "perfect_foresight_newton")));
+  if (number_of_threads < 1)
+    number_of_threads = 1;
+
+  if (static_cast<int>(mxGetM(prhs[0])) != ny || static_cast<int>(mxGetN(prhs[0])) != periods+2)
+    DYN_MEX_FUNC_ERR_MSG_TXT("perfect_foresight_newton: endo_simul must have endo_nbr rows and periods+2 columns.");
+  if (mxGetM(prhs[1]) < static_cast<size_t>(periods+2))
+    DYN_MEX_FUNC_ERR_MSG_TXT("perfect_foresight_newton: exo_simul must have at least periods+2 rows.");
+  if (static_cast<int>(mxGetNumberOfElements(prhs[2])) != ny)
+    DYN_MEX_FUNC_ERR_MSG_TXT("perfect_foresight_newton: steady_state must have endo_nbr elements.");
+
+  // Dynamic variables: lag (k=0), current (k=1) or lead (k=2) of the endogenous variable dyn_endo[v]
+  const double *lli = mxGetPr(lli_mx);
+  std::vector<int> dyn_lag, dyn_endo, lli_v(3*ny, -1);
+  for (int i = 0; i < ny; i++)
+    for (int k = 0; k < 3; k++)
+      if (lli[3*i+k] != 0)
+        lli_v[3*i+k] = static_cast<int>(lli[3*i+k]) - 1;
+  const int nd = 3*ny - static_cast<int>(std::count(lli_v.begin(), lli_v.end(), -1));
+  dyn_lag.resize(nd);
+  dyn_endo.resize(nd);
+  for (int i = 0; i < 3*ny; i++)
+    if (lli_v[i] >= 0)
+      {
+        if (lli_v[i] >= nd)
+          DYN_MEX_FUNC_ERR_MSG_TXT("perfect_foresight_newton: invalid lead_lag_incidence.");
+        dyn_lag[lli_v[i]] = i % 3;
+        dyn_endo[lli_v[i]] = i / 3;
+      }
+
+  plhs[0] = mxDuplicateArray(prhs[0]);
+  double *Y = mxGetPr(plhs[0]);
+  const double *exo = mxGetPr(prhs[1]);
+  const int exo_rows = mxGetM(prhs[1]), exo_cols = mxGetN(prhs[1]);
+  const int nx = nexo > exo_cols ? nexo : exo_cols;
+
+  DynamicModelDLL *dynamicDLL = NULL;
+  try
+    {
+      dynamicDLL = new DynamicModelDLL(fname);
+    }
+  catch (const DynareException &e)
+    {
+      DYN_MEX_FUNC_ERR_MSG_TXT(e.message());
+    }
+  const bool sparse_g1 = dynamicDLL->hasSparseJacobian();
+  const int g1_rows = sparse_g1 ? static_cast<int>(mxGetPr(nnz_mx)[0]) : ny;
+  const int g1_cols = sparse_g1 ? 3 : nd + nexo;
+  Vector params(mxGetPr(params_mx), static_cast<int>(mxGetNumberOfElements(params_mx)));
+  Vector ySteady(mxGetPr(prhs[2]), ny);
+
+  const int n = periods*ny;
+  std::vector<double> res(n), J, dy(n);
+  // Pattern of the Jacobian of one period, sorted by column, the position of each element (or -1) and its start by column
+  std::vector<JacobianElement> pattern;
+  std::vector<int> position(static_cast<size_t>(ny)*nd, -1), pattern_jc(nd+1, 0);
+  // Stacked Jacobian, and the position in J (period*pattern.size()+element) of each of its elements
+  std::vector<SuiteSparse_long> Ap(n+1), Ai;
+  std::vector<double> Ax;
+  std::vector<size_t> Amap;
+  StackedJacobianSolver solver(use_klu);
+
+  bool stop = false, failed = false;
+  std::string error_message;
+  double err = 0;
+  int iter;
+  for (iter = 1; iter <= maxit && !failed; iter++)
+    {
+      // Evaluates the residuals and Jacobians of all the periods, again if the pattern has to be extended
+      std::vector<JacobianElement> new_elements;
+      do
+        {
+          new_elements.clear();
+          const size_t nb = pattern.size();
+          J.resize(periods*nb);
+#ifdef USE_OMP
+# pragma omp parallel num_threads(number_of_threads)
+#endif
+          {
+            std::vector<double> y_data(nd), x_data(nx, 0.0), g1_data(static_cast<size_t>(g1_rows)*g1_cols, 0.0);
+            Vector y(&y_data[0], nd), x(&x_data[0], nx);
+            TwoDMatrix g1(g1_rows, g1_cols, &g1_data[0]);
+            std::vector<JacobianElement> thread_new_elements;
+            std::vector<char> seen(sparse_g1 ? 0 : static_cast<size_t>(ny)*nd, 0);
+#ifdef USE_OMP
+# pragma omp for schedule(dynamic)
+#endif
+            for (int t = 0; t < periods; t++)
+              {
+                // Period t is column t+1 of endo_simul and row t+1 of exo_simul
+                for (int v = 0; v < nd; v++)
+                  y_data[v] = Y[(t+dyn_lag[v])*ny+dyn_endo[v]];
+                for (int j = 0; j < exo_cols; j++)
+                  x_data[j] = exo[j*exo_rows+t+1];
+                Vector residual_t(&res[t*ny], ny);
+                try
+                  {
+                    dynamicDLL->eval(y, x, params, ySteady, residual_t, &g1, NULL, NULL);
+                  }
+                catch (const DynareException &e)
+                  {
+#ifdef USE_OMP
+# pragma omp critical
+#endif
+                    {
+                      failed = true;
+                      error_message = e.message();
+                    }
+                    continue;
+                  }
+
+                for (size_t b = 0; b < nb; b++)
+                  J[t*nb+b] = g1_data[pattern[b].src];
+
+                // Structural elements (or nonzero elements of a dense Jacobian) which are not in the pattern yet
+                if (sparse_g1)
+                  {
+                    if (nb == 0 && thread_new_elements.empty())
+                      for (int k = 0; k < g1_rows; k++)
+                        {
+                          JacobianElement e;
+                          e.row = static_cast<int>(g1_data[k]) - 1;
+                          e.col = static_cast<int>(g1_data[g1_rows+k]) - 1;
+                          e.src = 2*g1_rows+k;
+                          if (e.col < nd && position[static_cast<size_t>(e.col)*ny+e.row] < 0)
+                            thread_new_elements.push_back(e);
+                        }
+                  }
+                else
+                  for (int v = 0; v < nd; v++)
+                    for (int r = 0; r < ny; r++)
+                      if (g1_data[v*ny+r] != 0.0 && position[static_cast<size_t>(v)*ny+r] < 0
+                          && !seen[static_cast<size_t>(v)*ny+r])
+                        {
+                          seen[static_cast<size_t>(v)*ny+r] = 1;
+                          JacobianElement e;
+                          e.row = r;
+                          e.col = v;
+                          e.src = v*ny+r;
+                          thread_new_elements.push_back(e);
+                        }
+              }
+            if (!thread_new_elements.empty())
+#ifdef USE_OMP
+# pragma omp critical
+#endif
+              new_elements.insert(new_elements.end(), thread_new_elements.begin(), thread_new_elements.end());
+          }
+          if (failed || new_elements.empty())
+            break;
+
+          // Extends the pattern of one period, and rebuilds the stacked pattern
+          for (size_t e = 0; e < new_elements.size(); e++)
+            {
+              size_t p = static_cast<size_t>(new_elements[e].col)*ny+new_elements[e].row;
+              if (position[p] < 0)
+                {
+                  position[p] = 0;
+                  pattern.push_back(new_elements[e]);
+                }
+            }
+          std::vector<JacobianElement> sorted;
+          sorted.reserve(pattern.size());
+          for (int v = 0; v < nd; v++)
+            {
+              pattern_jc[v] = sorted.size();
+              for (int r = 0; r < ny; r++)
+                {
+                  size_t p = static_cast<size_t>(v)*ny+r;
+                  if (position[p] >= 0)
+                    {
+                      position[p] = sorted.size();
+                      sorted.push_back(JacobianElement());
+                    }
+                }
+            }
+          pattern_jc[nd] = sorted.size();
+          for (size_t b = 0; b < pattern.size(); b++)
+            sorted[position[static_cast<size_t>(pattern[b].col)*ny+pattern[b].row]] = pattern[b];
+          pattern.swap(sorted);
+
+          /* Column s*ny+i of the stacked Jacobian contains, by increasing row,
+             the derivatives of the equations of period s-1 with respect to
+             the lead of variable i, of period s with respect to its current
+             value and of period s+1 with respect to its lag */
+          const size_t nb_new = pattern.size();
+          Ai.clear();
+          Amap.clear();
+          Ap[0] = 0;
+          for (int s = 0; s < periods; s++)
+            for (int i = 0; i < ny; i++)
+              {
+                for (int k = 2; k >= 0; k--)
+                  {
+                    const int v = lli_v[3*i+k], t = s+1-k;
+                    if (v < 0 || t < 0 || t >= periods)
+                      continue;
+                    for (int b = pattern_jc[v]; b < pattern_jc[v+1]; b++)
+                      {
+                        Ai.push_back(t*ny+pattern[b].row);
+                        Amap.push_back(t*nb_new+b);
+                      }
+                  }
+                Ap[s*ny+i+1] = Ai.size();
+              }
+          Ax.resize(Ai.size());
+          solver.newPattern();
+        }
+      while (true);
+      if (failed)
+        break;
+
+      err = 0;
+      double norm_res = 0;
+      for (int i = 0; i < n; i++)
+        {
+          // NaN are ignored, as by max() in sim1.m (the status is checked below)
+          if (fabs(res[i]) > err)
+            err = fabs(res[i]);
+          norm_res += res[i]*res[i];
+        }
+      if (verbose)
+        mexPrintf("Iter: %d,\t err. = %g\n", iter, err);
+      if (err < tolf)
+        {
+          stop = true;
+          break;
+        }
+
+      // As in sim1.m, x = 0 is taken as the solution if the residuals are negligible
+      if (sqrt(norm_res) < sqrt(2.220446049250313e-16))
+        continue;
+
+      const int nnz = Ax.size();
+#ifdef USE_OMP
+# pragma omp parallel for num_threads(number_of_threads)
+#endif
+      for (int e = 0; e < nnz; e++)
+        Ax[e] = J[Amap[e]];
+      try
+        {
+          solver.factorize(n, &Ap[0], &Ai[0], &Ax[0]);
+          solver.solve(n, &Ap[0], &Ai[0], &Ax[0], &dy[0], &res[0]);
+        }
+      catch (const DynareException &e)
+        {
+          failed = true;
+          error_message = e.message();
+          break;
+        }
+      for (int i = 0; i < n; i++)
+        if (mxIsFinite(dy[i]))
+          Y[ny+i] -= dy[i];
+    }
+
+  delete dynamicDLL;
+  if (failed)
+    DYN_MEX_FUNC_ERR_MSG_TXT(("perfect_foresight_newton: " + error_message).c_str());
+
+  bool status = stop;
+  if (stop)
+    {
+      for (int i = 0; i < n && status; i++)
+        status = mxIsFinite(res[i]);
+      for (int i = 0; i < ny*(periods+2) && status; i++)
+        status = mxIsFinite(Y[i]);
+    }
+  else
+    iter = maxit;
+
+  if (nlhs > 1)
+    plhs[1] = mxCreateLogicalScalar(status);
+  if (nlhs > 2)
+    plhs[2] = mxCreateDoubleScalar(err);
+  if (nlhs > 3)
+    plhs[3] = mxCreateDoubleScalar(iter);
+}
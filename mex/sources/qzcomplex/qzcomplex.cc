@@ -36,6 +36,9 @@
 # define M_PI 3.14159265358979323846
 #endif
 
+#include <algorithm>
+#include <vector>
+
 #include <octave/oct.h>
 #include <octave/f77-fcn.h>
 
@@ -50,6 +53,11 @@ extern "C"
                           double *, octave_idx_type *, octave_idx_type &);
 }
 
+// Workspaces of zgges, kept across calls. The optimal size of work is queried once for each matrix size.
+static octave_idx_type cached_n = -1;
+static std::vector<Complex> work;
+static std::vector<double> rwork;
+
 DEFUN_DLD(qzcomplex, args, nargout, "-*- texinfo -*-\n\
 @deftypefn {Loadable Function} [ @var{aa}, @var{bb}, @var{q}, @var{z} ] = qzcomplex (@var{a}, @var{b})\n\
 \n\
@@ -83,19 +91,30 @@ Computes the complex QZ decomposition of @math{(A, B)}, satisfying:\n\
       return retval;
     }
 
-  octave_idx_type lwork = 2*n;
   OCTAVE_LOCAL_BUFFER(Complex, alpha, n);
   OCTAVE_LOCAL_BUFFER(Complex, beta, n);
-  OCTAVE_LOCAL_BUFFER(Complex, work, lwork);
-  OCTAVE_LOCAL_BUFFER(double, rwork, 8*n);
   ComplexMatrix vsl(n, n), vsr(n, n);
   octave_idx_type sdim, info;
 
+  if (n != cached_n)
+    {
+      Complex lwork_query;
+      rwork.resize(std::max(octave_idx_type(1), 8*n));
+      F77_XFCN(zgges, ZGGES, (F77_CONST_CHAR_ARG("V"), F77_CONST_CHAR_ARG("V"),
+                              F77_CONST_CHAR_ARG("N"), NULL,
+                              n, A.fortran_vec(), n, B.fortran_vec(), n, sdim,
+                              alpha, beta, vsl.fortran_vec(), n, vsr.fortran_vec(), n,
+                              &lwork_query, -1, &rwork[0], NULL, info));
+      work.resize(std::max(std::max(octave_idx_type(1), 2*n), (octave_idx_type) lwork_query.real()));
+      cached_n = n;
+    }
+  octave_idx_type lwork = work.size();
+
   F77_XFCN(zgges, ZGGES, (F77_CONST_CHAR_ARG("V"), F77_CONST_CHAR_ARG("V"),
                           F77_CONST_CHAR_ARG("N"), NULL,
                           n, A.fortran_vec(), n, B.fortran_vec(), n, sdim,
                           alpha, beta, vsl.fortran_vec(), n, vsr.fortran_vec(), n,
-                          work, lwork, rwork, NULL, info));
+                          &work[0], lwork, &rwork[0], NULL, info));
 
   if (info != 0)
     {
@@ -0,0 +1,390 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Node-local cache of read-only artefacts, shared by the MEX files of all the
+ * Matlab/Octave processes of a user on a machine (typically the workers of a
+ * parallel run on a multi-core node). An artefact built by one process, such
+ * as the bytecode of a model once loaded and optimized, is then mapped by the
+ * other processes instead of being built again and stored once per process.
+ *
+ * Each artefact is a POSIX shared memory object, named after the user and a
+ * hash of its key, made of a one page header (magic, key, size of the
+ * payload, completion flag) followed by the payload. The key must identify
+ * the content: for an artefact computed from a file, it contains the
+ * canonical path of the file and its stamp (size, modification time to the
+ * nanosecond, inode and checksum of the contents), so that a modified file
+ * never matches a stale artefact, even if it is rewritten with the same size
+ * within the resolution of the modification times. The object is created
+ * exclusively by the first process, which sets the completion flag once the
+ * payload is written: until then, the other processes do not find it and
+ * build the artefact themselves. The names of the objects are appended to a
+ * small registry (itself a shared memory object), so that they can be
+ * removed.
+ *
+ * The cache is off by default. It is turned on in a process if the
+ * environment variable DYNARE_SHARED_CACHE is set to 1 when the process
+ * starts (the workers of a parallel run inherit it), or with
+ *   mexname('shared_cache', 'on')     (resp. 'off')
+ * and all the artefacts of the user are removed with
+ *   n = mexname('shared_cache', 'clear')
+ * Otherwise, they persist until the machine is rebooted. The cache is not
+ * available on Windows, where nothing is ever found nor published.
+ */
+
+#ifndef _SHARED_CACHE_HH
+#define _SHARED_CACHE_HH
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined(MATLAB_MEX_FILE) || defined(OCTAVE_MEX_FILE)
+# include <dynmex.h>
+#endif
+
+#if !defined(_WIN32) && !defined(__CYGWIN32__)
+# define SHARED_CACHE_POSIX
+# include <climits>
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+#endif
+
+class SharedCache
+{
+public:
+  //! Read-only mapping of an artefact, unmapped by the destructor
+  class Artefact
+  {
+  public:
+    const uint8_t *
+    data() const
+    {
+      return payload;
+    }
+    size_t
+    size() const
+    {
+      return payload_size;
+    }
+    ~Artefact()
+    {
+#ifdef SHARED_CACHE_POSIX
+      munmap(base, length);
+#endif
+    }
+  private:
+    friend class SharedCache;
+    void *base;
+    size_t length;
+    const uint8_t *payload;
+    size_t payload_size;
+    Artefact(void *base_arg, size_t length_arg, const uint8_t *payload_arg, size_t payload_size_arg) :
+      base(base_arg), length(length_arg), payload(payload_arg), payload_size(payload_size_arg)
+    {
+    };
+    // Forbid copy (the mapping is owned)
+    Artefact(const Artefact &);
+    Artefact &operator=(const Artefact &);
+  };
+
+  //! Is the cache used by this process?
+  static bool &
+  enabled()
+  {
+    static bool on = getenv("DYNARE_SHARED_CACHE") != NULL && !strcmp(getenv("DYNARE_SHARED_CACHE"), "1");
+    return on;
+  }
+
+  //! Returns the artefact of the given key, or NULL if it is not (yet) in the cache
+  static Artefact *
+  find(const std::string &key)
+  {
+#ifdef SHARED_CACHE_POSIX
+    std::string name = objectName(key);
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+      return NULL;
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size < (off_t) header_size)
+      {
+        close(fd);
+        return NULL;
+      }
+    size_t length = (size_t) st.st_size;
+    void *base = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+      return NULL;
+    const Header *h = (const Header *) base;
+    bool valid = !memcmp(h->magic, magic(), sizeof(h->magic)) && h->complete;
+    __sync_synchronize(); // The payload is read after the flag
+    // A different key is a collision of the hashes
+    if (!valid || h->payload_size > length - header_size
+        || strncmp(h->key, key.c_str(), sizeof(h->key)))
+      {
+        munmap(base, length);
+        return NULL;
+      }
+    return new Artefact(base, length, (const uint8_t *) base + header_size, (size_t) h->payload_size);
+#else
+    return NULL;
+#endif
+  }
+
+  //! Stores an artefact, returns false if it is already being stored by another process, or on failure
+  static bool
+  publish(const std::string &key, const void *payload, size_t size)
+  {
+#ifdef SHARED_CACHE_POSIX
+    if (key.size() >= sizeof(((Header *) NULL)->key))
+      return false;
+    std::string name = objectName(key);
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+    if (fd < 0)
+      return false;
+    size_t length = header_size + size;
+    void *base = MAP_FAILED;
+    if (!ftruncate(fd, (off_t) length))
+      base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+      {
+        shm_unlink(name.c_str());
+        return false;
+      }
+    Header *h = (Header *) base;
+    memcpy(h->magic, magic(), sizeof(h->magic));
+    h->payload_size = size;
+    strcpy(h->key, key.c_str());
+    memcpy((uint8_t *) base + header_size, payload, size);
+    __sync_synchronize(); // The flag is set after the payload is written
+    h->complete = 1;
+    munmap(base, length);
+    registerName(name);
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  //! Stamp identifying the contents of a file, or "" if the file can not be read
+  /*! The size, the modification time and the inode are not enough when a file is
+    rewritten with the same size within the resolution of the modification times
+    (e.g. the .cod file of a model regenerated with other numerical values), so the
+    stamp also contains a checksum of the contents */
+  static std::string
+  fileStamp(const std::string &filename)
+  {
+    struct stat st;
+    if (stat(filename.c_str(), &st))
+      return "";
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (f == NULL)
+      return "";
+    uint64_t hash = fnv1a_init;
+    char buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+      hash = fnv1a(hash, buffer, n);
+    fclose(f);
+    long long nsec = 0, ino = 0;
+#if defined(__APPLE__)
+    nsec = st.st_mtimespec.tv_nsec;
+#elif defined(SHARED_CACHE_POSIX)
+    nsec = st.st_mtim.tv_nsec;
+#endif
+#ifdef SHARED_CACHE_POSIX
+    ino = (long long) st.st_ino;
+#endif
+    char stamp[128];
+    sprintf(stamp, "%lld:%lld.%09lld:%lld:%016llx", (long long) st.st_size, (long long) st.st_mtime,
+            nsec, ino, (unsigned long long) hash);
+    return stamp;
+  }
+
+  //! Key of an artefact computed from a file (canonical path and stamp), or "" if the file does not exist
+  static std::string
+  fileKey(const std::string &kind, const std::string &filename)
+  {
+#ifdef SHARED_CACHE_POSIX
+    char path[PATH_MAX];
+    if (realpath(filename.c_str(), path) == NULL)
+      return "";
+    std::string stamp = fileStamp(path);
+    if (stamp.empty())
+      return "";
+    return kind + ":" + stamp + ":" + path;
+#else
+    return "";
+#endif
+  }
+
+  //! Removes all the artefacts of the user, returns their number
+  static int
+  clear()
+  {
+    int n = 0;
+#ifdef SHARED_CACHE_POSIX
+    std::string name = registryName();
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+      return 0;
+    struct stat st;
+    void *base = MAP_FAILED;
+    if (!fstat(fd, &st) && st.st_size >= (off_t) sizeof(Registry))
+      base = mmap(NULL, sizeof(Registry), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base != MAP_FAILED)
+      {
+        const Registry *r = (const Registry *) base;
+        for (uint32_t i = 0; i < r->count && i < registry_size; i++)
+          if (r->names[i][0] != '\0' && !shm_unlink(r->names[i]))
+            n++;
+        munmap(base, sizeof(Registry));
+      }
+    shm_unlink(name.c_str());
+#endif
+    return n;
+  }
+
+#if defined(MATLAB_MEX_FILE) || defined(OCTAVE_MEX_FILE)
+  /* Handles the calls of the form mexname('shared_cache', ...), returns
+     false if the arguments are those of a regular call */
+  static bool
+  mexCommand(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+  {
+    if (nrhs < 1 || !mxIsChar(prhs[0]))
+      return false;
+    char *keyword = mxArrayToString(prhs[0]);
+    bool is_command = !strcmp(keyword, "shared_cache");
+    mxFree(keyword);
+    if (!is_command)
+      return false;
+
+    char *cmd = nrhs > 1 && mxIsChar(prhs[1]) ? mxArrayToString(prhs[1]) : NULL;
+    if (cmd == NULL)
+      mexErrMsgTxt("shared_cache: the second argument must be one of 'on', 'off' or 'clear'");
+    std::string command(cmd);
+    mxFree(cmd);
+    double result = 0;
+    if (command == "on")
+      {
+#ifndef SHARED_CACHE_POSIX
+        mexWarnMsgTxt("shared_cache: the shared cache is not available on this platform");
+#endif
+        result = enabled() = true;
+      }
+    else if (command == "off")
+      result = enabled() = false;
+    else if (command == "clear")
+      result = clear();
+    else
+      mexErrMsgTxt("shared_cache: the second argument must be one of 'on', 'off' or 'clear'");
+    if (nlhs > 0)
+      plhs[0] = mxCreateDoubleScalar(result);
+    return true;
+  }
+#endif
+
+private:
+  //! Size of the header of an artefact, a page, so that the payload is page-aligned
+  static const size_t header_size = 4096;
+  struct Header
+  {
+    char magic[8];
+    volatile uint64_t complete;
+    uint64_t payload_size;
+    char key[header_size - 8 - 2*sizeof(uint64_t)];
+  };
+  //! Maximal number of artefacts in the registry
+  static const uint32_t registry_size = 4096;
+  struct Registry
+  {
+    volatile uint32_t count;
+    char names[registry_size][32];
+  };
+
+  static const char *
+  magic()
+  {
+    return "DYNSHM01";
+  }
+
+  //! 64-bit FNV-1a hash
+  static const uint64_t fnv1a_init = 14695981039346656037ULL;
+  static uint64_t
+  fnv1a(uint64_t hash, const char *data, size_t n)
+  {
+    for (size_t i = 0; i < n; i++)
+      {
+        hash ^= (uint8_t) data[i];
+        hash *= 1099511628211ULL;
+      }
+    return hash;
+  }
+
+#ifdef SHARED_CACHE_POSIX
+  /* Names of the shared memory objects: they are at most 31 characters long,
+     the limit of some systems */
+  static std::string
+  objectName(const std::string &key)
+  {
+    uint64_t hash = fnv1a(fnv1a_init, key.data(), key.size());
+    char name[32];
+    sprintf(name, "/dyn%x-%016llx", (unsigned int) getuid(), (unsigned long long) hash);
+    return name;
+  }
+  static std::string
+  registryName()
+  {
+    char name[32];
+    sprintf(name, "/dyn%x-registry", (unsigned int) getuid());
+    return name;
+  }
+  static void
+  registerName(const std::string &name)
+  {
+    int fd = shm_open(registryName().c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    if (fd < 0)
+      return;
+    // Extending the object fills it with zeros, and other processes can only extend it to the same size
+    struct stat st;
+    void *base = MAP_FAILED;
+    if (!fstat(fd, &st) && (st.st_size >= (off_t) sizeof(Registry) || !ftruncate(fd, sizeof(Registry))))
+      base = mmap(NULL, sizeof(Registry), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+      return;
+    Registry *r = (Registry *) base;
+    uint32_t i = __sync_fetch_and_add(&r->count, 1);
+    if (i < registry_size)
+      strncpy(r->names[i], name.c_str(), sizeof(r->names[i]) - 1);
+    munmap(base, sizeof(Registry));
+  }
+#endif
+};
+
+#endif // _SHARED_CACHE_HH
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * [z, first] = fast_shock_decomposition(A, B, i_state, epsilon, smoothed, init_state[, Af[, z_prev, epsilon_prev]])
+ *
+ * Computes the shock decomposition of a first order model
+ * y(t) = A*y(t-1)(i_state) + B*epsilon(t) in a single pass over the periods,
+ * as the loop of shock_decomposition.m:
+ *
+ *   z(:,k,t)        = A*z(i_state,k,t-1) + B(:,k)*epsilon(k,t)  for each shock k
+ *   z(:,nshocks+1,t) = z(:,nshocks+2,t) - sum(z(:,1:nshocks,t),2)  (initial condition)
+ *   z(:,nshocks+2,t) = smoothed(:,t)
+ *
+ * A and B are ghx and ghu in declaration order (i.e. dr.ghx(dr.inv_order_var,:)
+ * and dr.ghu(dr.inv_order_var,:)), and i_state gives the rows of z
+ * corresponding to the columns of A (the model must have maximum_lag = 1).
+ * The shock contributions are only added for t > init_state.
+ *
+ * epsilon may have more columns than smoothed: the periods after the end of
+ * smoothed are forecasts, where all the columns of z, including the smoothed
+ * variables, are propagated with Af (A if not given or empty), as in
+ * realtime_shock_decomposition.m.
+ *
+ * If the decomposition z_prev of a previous vintage, computed with the same
+ * A and B, is given together with its shocks epsilon_prev, the leading
+ * in-sample periods where epsilon and smoothed are unchanged are copied from
+ * z_prev, and the recursion only starts at the first period which differs.
+ * This index is returned in first (1 if nothing was reused).
+ */
+
+#include <cstring>
+#include <vector>
+
+#include <dynmex.h>
+#include <dynblas.h>
+
+/* Returns true if the n first elements of a and b are equal */
+static bool
+same_column(const double *a, const double *b, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+    if (a[i] != b[i])
+      return false;
+  return true;
+}
+
+void
+mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+  if (nrhs != 6 && nrhs != 7 && nrhs != 9)
+    DYN_MEX_FUNC_ERR_MSG_TXT("fast_shock_decomposition: six, seven or nine input arguments are required.");
+  if (nlhs > 2)
+    DYN_MEX_FUNC_ERR_MSG_TXT("fast_shock_decomposition: at most two output arguments are returned.");
+
+  for (int i = 0; i < nrhs; i++)
+    if (!mxIsDouble(prhs[i]) || mxIsComplex(prhs[i]) || mxIsSparse(prhs[i]))
+      DYN_MEX_FUNC_ERR_MSG_TXT("fast_shock_decomposition: all the arguments must be real dense matrices.");
+
+  const size_t endo_nbr = mxGetM(prhs[0]);
+  const size_t nstate = mxGetN(prhs[0]);
+  const size_t nshocks = mxGetN(prhs[1]);
+  const size_t ncols = nshocks + 2;
+
+  if (mxGetM(prhs[1]) != endo_nbr)
+    DYN_MEX_FUNC_ERR_MSG_TXT("fast_shock_decomposition: A and B must have the same number of rows.");
+  if (mxGetNumberOfElements(prhs[2]) != nstate)
+    DYN_MEX_FUNC_ERR_MSG_TXT("fast_shock_decomposition: i_state must have one element per column of A.");
+  if (mxGetM(prhs[3]) != nshocks)
+    DYN_MEX_FUNC_ERR_MSG_TXT("fast_shock_decomposition: epsilon must have one row per column of B.");
+  if (mxGetM(prhs[4]) != endo_nbr)
+    DYN_MEX_FUNC_ERR_MSG_TXT("fast_shock_decomposition: smoothed must have one row per row of A.");
+  if (mxGetNumberOfElements(prhs[5]) != 1)
+    DYN_MEX_FUNC_ERR_MSG_TXT("fast_shock_decomposition: init_state must be a scalar.");
+
+  const size_t nper = mxGetN(prhs[3]);
+  const size_t gend = mxGetN(prhs[4]);
+  if (gend > nper)
+    DYN_MEX_FUNC_ERR_MSG_TXT("fast_shock_decomposition: epsilon must have at least as many columns as smoothed.");
+
+  const double *A = mxGetPr(prhs[0]);
+  const double *B = mxGetPr(prhs[1]);
+  const double *epsilon = mxGetPr(prhs[3]);
+  const double *smoothed = mxGetPr(prhs[4]);
+  const double init_state = mxGetScalar(prhs[5]);
+
+  std::vector<size_t> i_state(nstate);
+  const double *i_state_d = mxGetPr(prhs[2]);
+  for (size_t i = 0; i < nstate; i++)
+    {
+      if (i_state_d[i] < 1 || i_state_d[i] > endo_nbr)
+        DYN_MEX_FUNC_ERR_MSG_TXT("fast_shock_decomposition: the elements of i_state must be between 1 and the number of rows of A (maximum_lag must be 1).");
+      i_state[i] = static_cast<size_t>(i_state_d[i]) - 1;
+    }
+
+  const double *Af = A;
+  if (nrhs >= 7 && !mxIsEmpty(prhs[6]))
+    {
+      if (mxGetM(prhs[6]) != endo_nbr || mxGetN(prhs[6]) != nstate)
+        DYN_MEX_FUNC_ERR_MSG_TXT("fast_shock_decomposition: Af must have the same size as A.");
+      Af = mxGetPr(prhs[6]);
+    }
+
+  mwSize dims[3] = { (mwSize) endo_nbr, (mwSize) ncols, (mwSize) nper };
+  plhs[0] = mxCreateNumericArray(3, dims, mxDOUBLE_CLASS, mxREAL);
+  double *z = mxGetPr(plhs[0]);
+  const size_t slice = endo_nbr*ncols;
+
+  // Reuse the leading periods of the previous vintage which are unchanged
+  size_t first = 0;
+  if (nrhs == 9 && !mxIsEmpty(prhs[7]))
+    {
+      const mxArray *z_prev_mx = prhs[7];
+      const mwSize *dims_prev = mxGetDimensions(z_prev_mx);
+      const size_t nper_prev = mxGetNumberOfDimensions(z_prev_mx) > 2 ? dims_prev[2] : 1;
+      if (dims_prev[0] != endo_nbr || dims_prev[1] != ncols)
+        DYN_MEX_FUNC_ERR_MSG_TXT("fast_shock_decomposition: z_prev must have the same number of rows and columns as z.");
+      if (mxGetM(prhs[8]) != nshocks)
+        DYN_MEX_FUNC_ERR_MSG_TXT("fast_shock_decomposition: epsilon_prev must have one row per column of B.");
+      const double *z_prev = mxGetPr(z_prev_mx);
+      const double *epsilon_prev = mxGetPr(prhs[8]);
+      size_t max_reuse = nper_prev;
+      if (mxGetN(prhs[8]) < max_reuse)
+        max_reuse = mxGetN(prhs[8]);
+      if (gend < max_reuse)
+        max_reuse = gend;
+      while (first < max_reuse
+             && same_column(epsilon + first*nshocks, epsilon_prev + first*nshocks, nshocks)
+             && same_column(smoothed + first*endo_nbr, z_prev + first*slice + (ncols-1)*endo_nbr, endo_nbr))
+        first++;
+      if (first > 0)
+        memcpy(z, z_prev, first*slice*sizeof(double));
+    }
+
+  std::vector<double> zs(nstate*(nshocks+1));
+  const blas_int m = endo_nbr, n_state = nstate;
+  const double one = 1.0, zero = 0.0;
+  for (size_t t = first; t < nper; t++)
+    {
+      double *zt = z + t*slice;
+      const bool forecast = t >= gend;
+      const double *At = forecast ? Af : A;
+
+      // Propagate the contributions (and, in the forecast, the smoothed variables)
+      if (t > 0 && nstate > 0)
+        {
+          const double *zlag = zt - slice;
+          for (size_t k = 0; k < nshocks; k++)
+            for (size_t i = 0; i < nstate; i++)
+              zs[k*nstate+i] = zlag[k*endo_nbr+i_state[i]];
+          if (forecast)
+            for (size_t i = 0; i < nstate; i++)
+              zs[nshocks*nstate+i] = zlag[(ncols-1)*endo_nbr+i_state[i]];
+
+          blas_int n = nshocks;
+          if (n > 0)
+            dgemm("N", "N", &m, &n, &n_state, &one, At, &m, &zs[0], &n_state, &zero, zt, &m);
+          if (forecast)
+            {
+              n = 1;
+              dgemm("N", "N", &m, &n, &n_state, &one, At, &m, &zs[nshocks*nstate], &n_state, &zero,
+                    zt + (ncols-1)*endo_nbr, &m);
+            }
+        }
+
+      if (!forecast)
+        memcpy(zt + (ncols-1)*endo_nbr, smoothed + t*endo_nbr, endo_nbr*sizeof(double));
+
+      if (static_cast<double>(t+1) > init_state)
+        for (size_t k = 0; k < nshocks; k++)
+          {
+            const double e = epsilon[t*nshocks+k];
+            if (e != 0.0)
+              for (size_t i = 0; i < endo_nbr; i++)
+                zt[k*endo_nbr+i] += B[k*endo_nbr+i]*e;
+          }
+
+      // Initial condition
+      for (size_t i = 0; i < endo_nbr; i++)
+        {
+          double s = zt[(ncols-1)*endo_nbr+i];
+          for (size_t k = 0; k < nshocks; k++)
+            s -= zt[k*endo_nbr+i];
+          zt[nshocks*endo_nbr+i] = s;
+        }
+    }
+
+  if (nlhs > 1)
+    plhs[1] = mxCreateDoubleScalar(static_cast<double>(first+1));
+}
@@ -27,6 +27,7 @@
 #include <iomanip>
 #include <cmath>
 #include <ctime>
+#include <vector>
 
 #include <dynblas.h>
 
@@ -142,7 +143,7 @@ void
 icdfm(const int n, T *U)
 {
 #if USE_OMP
-# pragma omp parallel for num_threads(omp_get_num_threads())
+# pragma omp parallel for
 #endif
   for (int i = 0; i < n; i++)
     {
@@ -151,28 +152,37 @@ icdfm(const int n, T *U)
   return;
 }
 
+// Multiplies the d*n array of gaussian deviates U by LowerCholSigma
 template<typename T>
 void
-icdfmSigma(const int d, const int n, T *U, const double *LowerCholSigma)
+mvnSigma(const int d, const int n, T *U, const double *LowerCholSigma)
 {
   double one = 1.0;
   double zero = 0.0;
   blas_int dd(d);
   blas_int nn(n);
-  icdfm(n*d, U);
-  double tmp[n*d];
-  dgemm("N", "N", &dd, &nn, &dd, &one, LowerCholSigma, &dd, U, &dd, &zero, tmp, &dd);
-  memcpy(U, tmp, d*n*sizeof(double));
+  std::vector<double> tmp(n*d);
+  dgemm("N", "N", &dd, &nn, &dd, &one, LowerCholSigma, &dd, U, &dd, &zero, &tmp[0], &dd);
+  memcpy(U, &tmp[0], d*n*sizeof(double));
   return;
 }
 
 template<typename T>
 void
-usphere(const int d, const int n, T *U)
+icdfmSigma(const int d, const int n, T *U, const double *LowerCholSigma)
 {
   icdfm(n*d, U);
+  mvnSigma(d, n, U, LowerCholSigma);
+  return;
+}
+
+// Projects the n columns of the d*n array of gaussian deviates U on the hypersphere of the given radius
+template<typename T>
+void
+projectOnSphere(const int d, const int n, double radius, T *U)
+{
 #if USE_OMP
-# pragma omp parallel for num_threads(omp_get_num_threads())
+# pragma omp parallel for
 #endif
   for (int j = 0; j < n; j++)// sequence index.
     {
@@ -185,33 +195,26 @@ usphere(const int d, const int n, T *U)
       norm = sqrt(norm);
       for (int i = 0; i < d; i++)// dimension index.
         {
-          U[k+i] = U[k+i]/norm;
+          U[k+i] = radius*U[k+i]/norm;
         }
     }
   return;
 }
 
+template<typename T>
+void
+usphere(const int d, const int n, T *U)
+{
+  icdfm(n*d, U);
+  projectOnSphere(d, n, 1.0, U);
+  return;
+}
+
 template<typename T>
 void
 usphereRadius(const int d, const int n, double radius, T *U)
 {
   icdfm(n*d, U);
-#if USE_OMP
-# pragma omp parallel for num_threads(omp_get_num_threads())
-#endif
-  for (int j = 0; j < n; j++)// sequence index.
-    {
-      int k = j*d;
-      double norm = 0.0;
-      for (int i = 0; i < d; i++)// dimension index.
-        {
-          norm = norm + U[k+i]*U[k+i];
-        }
-      norm = sqrt(norm);
-      for (int i = 0; i < d; i++)// dimension index.
-        {
-          U[k+i] = radius*U[k+i]/norm;
-        }
-    }
+  projectOnSphere(d, n, radius, U);
   return;
 }
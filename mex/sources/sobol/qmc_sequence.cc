@@ -170,14 +170,12 @@ mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
       identity_covariance_matrix = 0;
     }
   double radius = 1.0;
-  int unit_radius = 1;
   if ((type == 2) && (nrhs > 4))
     {
       double *tmp;
       tmp = (double *) mxCalloc(1, sizeof(double));
       memcpy(tmp, mxGetPr(prhs[4]), sizeof(double));
       radius = tmp[0];
-      unit_radius = 0;
     }
   /*
   ** Initialize outputs of the mex file.
@@ -187,30 +185,24 @@ mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
   qmc_draws = mxGetPr(plhs[0]);
   int64_T seed_out;
 
+  // The gaussian transformation (types 1 and 2) is applied while the sequence is generated.
+  double (*transform)(const double) = (type == 0 ? NULL : &icdf<double>);
   if (sequence_size == 1)
     {
       next_sobol(dimension, &seed, qmc_draws);
+      if (transform)
+        icdfm(dimension, qmc_draws);
       seed_out = seed;
     }
   else
-    seed_out = sobol_block(dimension, sequence_size, seed, qmc_draws);
+    seed_out = sobol_block(dimension, sequence_size, seed, qmc_draws, transform);
 
   if (type == 0 && unit_hypercube_flag == 0) // Uniform QMC sequence in an hypercube.
     expand_unit_hypercube(dimension, sequence_size, qmc_draws, lower_bounds, upper_bounds);
-  else if (type == 1)// Normal QMC sequance in R^n.
-    {
-      if (identity_covariance_matrix == 1)
-        icdfm(dimension*sequence_size, qmc_draws);
-      else
-        icdfmSigma(dimension, sequence_size, qmc_draws, cholcov);
-    }
+  else if (type == 1 && identity_covariance_matrix == 0)// Normal QMC sequance in R^n.
+    mvnSigma(dimension, sequence_size, qmc_draws, cholcov);
   else if (type == 2)// Uniform QMC sequence on an hypershere.
-    {
-      if (unit_radius == 1)
-        usphere(dimension, sequence_size, qmc_draws);
-      else
-        usphereRadius(dimension, sequence_size, radius, qmc_draws);
-    }
+    projectOnSphere(dimension, sequence_size, radius, qmc_draws);
 
   if (nlhs >= 2)
     {
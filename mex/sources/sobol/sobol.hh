@@ -24,6 +24,12 @@
 #include <iomanip>
 #include <cmath>
 #include <ctime>
+#include <vector>
+#include <algorithm>
+
+#ifdef USE_OMP
+# include <omp.h>
+#endif
 
 #include "initialize_v_array.hh"
 
@@ -172,75 +178,10 @@ ixor(T i, T j)
 
 template<typename T1, typename T2>
 void
-next_sobol(int dim_num, T1 *seed, T2 *quasi)
+sobol_directions(int dim_num, T1 ***v_out, T1 *maxcol_out, T2 *recipd_out)
 /*
-**  This function generates a new quasirandom Sobol vector with each call.
-**
-**  Discussion:
-**
-**    The routine adapts the ideas of Antonov and Saleev.
-**
-**    This routine uses LONG LONG INT for integers and DOUBLE for real values or
-**                                INT for integers and FLOAT  for real values.
-**
-**    Thanks to Steffan Berridge for supplying (twice) the properly
-**    formatted V data needed to extend the original routine's dimension
-**    limit from 40 to 1111, 05 June 2007.
-**
-**    Thanks to Francis Dalaudier for pointing out that the range of allowed
-**    values of DIM_NUM should start at 1, not 2!  17 February 2009.
-**
-**  Original files downloaded from http://people.sc.fsu.edu/~burkardt/cpp_src/sobol/ (version 17-Feb-2009 09:46)
-**
-**  Reference:
-**
-**    IA Antonov, VM Saleev,
-**    An Economic Method of Computing LP Tau-Sequences,
-**    USSR Computational Mathematics and Mathematical Physics,
-**    Volume 19, 1980, pages 252 - 256.
-**
-**    Paul Bratley, Bennett Fox,
-**    Algorithm 659:
-**    Implementing Sobol's Quasirandom Sequence Generator,
-**    ACM Transactions on Mathematical Software,
-**    Volume 14, Number 1, pages 88-100, 1988.
-**
-**    Bennett Fox,
-**    Algorithm 647:
-**    Implementation and Relative Efficiency of Quasirandom
-**    Sequence Generators,
-**    ACM Transactions on Mathematical Software,
-**    Volume 12, Number 4, pages 362-376, 1986.
-**
-**    Stephen Joe, Frances Kuo
-**    Remark on Algorithm 659:
-**    Implementing Sobol's Quasirandom Sequence Generator,
-**    ACM Transactions on Mathematical Software,
-**    Volume 29, Number 1, pages 49-57, March 2003.
-**
-**    Ilya Sobol,
-**    USSR Computational Mathematics and Mathematical Physics,
-**    Volume 16, pages 236-242, 1977.
-**
-**    Ilya Sobol, YL Levitan,
-**    The Production of Points Uniformly Distributed in a Multidimensional
-**    Cube (in Russian),
-**    Preprint IPM Akad. Nauk SSSR,
-**    Number 40, Moscow 1976.
-**
-**  Parameters:
-**
-**    Input, int DIM_NUM, the number of spatial dimensions.
-**    DIM_NUM must satisfy 1 <= DIM_NUM <= 1111.
-**
-**    Input/output, long long int *SEED, the "seed" for the sequence.
-**    This is essentially the index in the sequence of the quasirandom
-**    value to be generated.  On output, SEED has been set to the
-**    appropriate next value, usually simply SEED+1.
-**    If SEED is less than 0 on input, it is treated as though it were 0.
-**    An input value of 0 requests the first (0-th) element of the sequence.
-**
-**    Output, double QUASI[DIM_NUM], the next quasirandom vector.
+**  This function computes (once) the direction numbers V of the Sobol sequence, the position MAXCOL
+**  of the highest bit of the seeds and the common denominator RECIPD of the elements of V.
 */
 {
   static T1 atmost;
@@ -248,7 +189,6 @@ next_sobol(int dim_num, T1 *seed, T2 *quasi)
   int LOG_MAX = sizeof(T1)*8-2;
   bool includ[LOG_MAX];
   static bool initialized = false;
-  static T1 lastq[DIM_MAX];
   static T1 maxcol;
   T1 l = 0;
   static T1 poly[DIM_MAX] =
@@ -367,7 +307,6 @@ next_sobol(int dim_num, T1 *seed, T2 *quasi)
       16381
     };
   static T2 recipd;
-  static T1 seed_save = -1;
   static T1 **v;
   if (!initialized || dim_num != dim_num_save)
     {
@@ -477,6 +416,109 @@ next_sobol(int dim_num, T1 *seed, T2 *quasi)
       */
       recipd = 1.0E+00 / ((T2) (2 * l));
     }
+  *v_out = v;
+  *maxcol_out = maxcol;
+  *recipd_out = recipd;
+}
+
+template<typename T1>
+void
+sobol_skip_ahead(int dim_num, T1 seed, T1 **v, T1 *lastq)
+/*
+**  This function sets LASTQ to the integer state of the Sobol sequence for SEED, that is the exclusive
+**  OR of the direction numbers selected by the bits of the Gray code of SEED. In the Antonov and Saleev
+**  ordering, this is the state reached after SEED iterations, which is thus obtained in O(log(SEED)).
+*/
+{
+  for (int i = 0; i < dim_num; i++)
+    lastq[i] = 0;
+  T1 gray = seed ^ (seed/2);
+  for (int j = 0; gray > 0; j++, gray /= 2)
+    if (gray % 2)
+      for (int i = 0; i < dim_num; i++)
+        lastq[i] = (lastq[i] ^ v[i][j]);
+}
+
+template<typename T1, typename T2>
+void
+next_sobol(int dim_num, T1 *seed, T2 *quasi)
+/*
+**  This function generates a new quasirandom Sobol vector with each call.
+**
+**  Discussion:
+**
+**    The routine adapts the ideas of Antonov and Saleev.
+**
+**    This routine uses LONG LONG INT for integers and DOUBLE for real values or
+**                                INT for integers and FLOAT  for real values.
+**
+**    Thanks to Steffan Berridge for supplying (twice) the properly
+**    formatted V data needed to extend the original routine's dimension
+**    limit from 40 to 1111, 05 June 2007.
+**
+**    Thanks to Francis Dalaudier for pointing out that the range of allowed
+**    values of DIM_NUM should start at 1, not 2!  17 February 2009.
+**
+**  Original files downloaded from http://people.sc.fsu.edu/~burkardt/cpp_src/sobol/ (version 17-Feb-2009 09:46)
+**
+**  Reference:
+**
+**    IA Antonov, VM Saleev,
+**    An Economic Method of Computing LP Tau-Sequences,
+**    USSR Computational Mathematics and Mathematical Physics,
+**    Volume 19, 1980, pages 252 - 256.
+**
+**    Paul Bratley, Bennett Fox,
+**    Algorithm 659:
+**    Implementing Sobol's Quasirandom Sequence Generator,
+**    ACM Transactions on Mathematical Software,
+**    Volume 14, Number 1, pages 88-100, 1988.
+**
+**    Bennett Fox,
+**    Algorithm 647:
+**    Implementation and Relative Efficiency of Quasirandom
+**    Sequence Generators,
+**    ACM Transactions on Mathematical Software,
+**    Volume 12, Number 4, pages 362-376, 1986.
+**
+**    Stephen Joe, Frances Kuo
+**    Remark on Algorithm 659:
+**    Implementing Sobol's Quasirandom Sequence Generator,
+**    ACM Transactions on Mathematical Software,
+**    Volume 29, Number 1, pages 49-57, March 2003.
+**
+**    Ilya Sobol,
+**    USSR Computational Mathematics and Mathematical Physics,
+**    Volume 16, pages 236-242, 1977.
+**
+**    Ilya Sobol, YL Levitan,
+**    The Production of Points Uniformly Distributed in a Multidimensional
+**    Cube (in Russian),
+**    Preprint IPM Akad. Nauk SSSR,
+**    Number 40, Moscow 1976.
+**
+**  Parameters:
+**
+**    Input, int DIM_NUM, the number of spatial dimensions.
+**    DIM_NUM must satisfy 1 <= DIM_NUM <= 1111.
+**
+**    Input/output, long long int *SEED, the "seed" for the sequence.
+**    This is essentially the index in the sequence of the quasirandom
+**    value to be generated.  On output, SEED has been set to the
+**    appropriate next value, usually simply SEED+1.
+**    If SEED is less than 0 on input, it is treated as though it were 0.
+**    An input value of 0 requests the first (0-th) element of the sequence.
+**
+**    Output, double QUASI[DIM_NUM], the next quasirandom vector.
+*/
+{
+  static T1 lastq[DIM_MAX];
+  static T1 seed_save = -1;
+  T1 **v;
+  T1 maxcol;
+  T2 recipd;
+  T1 l = 0;
+  sobol_directions(dim_num, &v, &maxcol, &recipd);
   if (*seed < 0)
     *seed = 0;
 
@@ -492,32 +534,9 @@ next_sobol(int dim_num, T1 *seed, T2 *quasi)
     {
       l = bit_lo0(*seed);
     }
-  else if (*seed <= seed_save)
-    {
-      seed_save = 0;
-      l = 1;
-      for (int i = 0; i < dim_num; i++)
-        lastq[i] = 0;
-      for (T1 seed_temp = seed_save; seed_temp <= (*seed)-1; seed_temp++)
-        {
-          l = bit_lo0(seed_temp);
-          for (int i = 0; i < dim_num; i++)
-            {
-              lastq[i] = (lastq[i] ^ v[i][l-1]);
-            }
-        }
-      l = bit_lo0(*seed);
-    }
-  else if (seed_save+1 < *seed)
+  else
     {
-      for (T1 seed_temp = seed_save+1; seed_temp <= (*seed)-1; seed_temp++)
-        {
-          l = bit_lo0(seed_temp);
-          for (int i = 0; i < dim_num; i++)
-            {
-              lastq[i] = (lastq[i] ^ v[i][l-1]);
-            }
-        }
+      sobol_skip_ahead(dim_num, *seed, v, lastq);
       l = bit_lo0(*seed);
     }
   /*
@@ -549,13 +568,61 @@ next_sobol(int dim_num, T1 *seed, T2 *quasi)
 
 template<typename T1, typename T2>
 T1
-sobol_block(int dimension, int block_size, T1 seed, T2 *block)
+sobol_block(int dimension, int block_size, T1 seed, T2 *block, T2 (*transform)(const T2) = NULL)
+/*
+**  This function fills the DIMENSION*BLOCK_SIZE array BLOCK with the elements SEED to SEED+BLOCK_SIZE-1
+**  of the Sobol sequence, and returns the seed of the next element. The block is split into contiguous
+**  chunks, one by thread, and the state at the beginning of each chunk is obtained by skip ahead. If
+**  TRANSFORM is not NULL, it is applied to each element in the same pass (e.g. the inverse of the
+**  gaussian cumulative distribution function).
+*/
 {
-  for (int iter = 0; iter < block_size; iter++)
+  T1 **v;
+  T1 maxcol;
+  T2 recipd;
+  sobol_directions(dimension, &v, &maxcol, &recipd);
+  if (seed < 0)
+    seed = 0;
+  if (maxcol < bit_hi1(seed + block_size))
     {
-      next_sobol(dimension, &seed, &block[iter*dimension]);
+      cout << "\n";
+      cout << "SOBOL_BLOCK - Fatal error!\n";
+      cout << "  The value of SEED seems to be too large!\n";
+      cout << "  SEED =   " << seed + block_size << "\n";
+      cout << "  MAXCOL = " << maxcol << "\n";
+      exit(2);
     }
-  return seed;
+#if USE_OMP
+# pragma omp parallel
+#endif
+  {
+    int number_of_chunks = 1, chunk = 0;
+#if USE_OMP
+    number_of_chunks = omp_get_num_threads();
+    chunk = omp_get_thread_num();
+#endif
+    int chunk_size = (block_size + number_of_chunks - 1)/number_of_chunks;
+    int begin = chunk*chunk_size, end = std::min(begin + chunk_size, block_size);
+    if (begin < end)
+      {
+        std::vector<T1> lastq(dimension);
+        sobol_skip_ahead(dimension, seed + begin, v, &lastq[0]);
+        for (int iter = begin; iter < end; iter++)
+          {
+            int l = bit_lo0(seed + iter);
+            T2 *quasi = &block[iter*dimension];
+            for (int i = 0; i < dimension; i++)
+              {
+                quasi[i] = ((T2) lastq[i]) * recipd;
+                lastq[i] = (lastq[i]^v[i][l-1]);
+              }
+            if (transform)
+              for (int i = 0; i < dimension; i++)
+                quasi[i] = transform(quasi[i]);
+          }
+      }
+  }
+  return seed + block_size;
 }
 
 template<typename T>
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compressed sparse row copy of (a block of columns of) the transition matrix
+ * of a state space model, used by the Kalman filters to compute the predicted
+ * covariance P = T*S*T' + Q when T is sparse. In large models most state
+ * variables only depend on a few lagged states (the blocks determined by the
+ * preprocessor), so that T is block sparse and the dense products waste most
+ * of their time multiplying zeros.
+ */
+
+#ifndef _SPARSE_TRANSITION_HH
+#define _SPARSE_TRANSITION_HH
+
+#include <cstddef>
+#include <vector>
+
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
+/* Above this density, the dense BLAS products are faster than the sparse ones */
+const double sparse_transition_max_density = 0.1;
+
+class SparseTransition
+{
+public:
+  SparseTransition() : nrows(0), ncols(0), row_start(1, 0)
+  {
+  }
+
+  /* Stores the nonzero elements of the nrows*ncols matrix T of leading
+     dimension ldT */
+  void
+  compress(const double *T, size_t ldT, size_t nrows_arg, size_t ncols_arg)
+  {
+    nrows = nrows_arg;
+    ncols = ncols_arg;
+    row_start.assign(nrows+1, 0);
+    col_index.clear();
+    values.clear();
+    for (size_t i = 0; i < nrows; i++)
+      {
+        for (size_t j = 0; j < ncols; j++)
+          if (T[i+j*ldT] != 0.0)
+            {
+              col_index.push_back(j);
+              values.push_back(T[i+j*ldT]);
+            }
+        row_start[i+1] = values.size();
+      }
+  }
+
+  size_t
+  getNonZeros() const
+  {
+    return values.size();
+  }
+
+  double
+  density() const
+  {
+    return nrows*ncols > 0 ? (double) values.size()/(nrows*ncols) : 1.0;
+  }
+
+  /* Returns true if the sparse products should be preferred to the dense ones */
+  bool
+  isSparse(double max_density = sparse_transition_max_density) const
+  {
+    return density() < max_density;
+  }
+
+  /* Computes P = T*S*T' + Q, where S is a ncols*ncols symmetric matrix (both
+     triangles are referenced), Q and P are nrows*nrows matrices (P is
+     returned full), and W is a workspace of size ncols*nrows. */
+  void
+  symmetricProduct(const double *S, size_t ldS, const double *Q, size_t ldQ, double *P, size_t ldP,
+                   double *W, int numthreads) const
+  {
+    // W = S*T', column i of W is the combination of the columns of S given by row i of T
+#ifdef USE_OMP
+# pragma omp parallel for num_threads(numthreads) schedule(dynamic)
+#endif
+    for (int i = 0; i < (int) nrows; i++)
+      {
+        double *Wi = W + i*ncols;
+        for (size_t k = 0; k < ncols; k++)
+          Wi[k] = 0.0;
+        for (size_t l = row_start[i]; l < row_start[i+1]; l++)
+          {
+            const size_t j = col_index[l];
+            const double v = values[l];
+            const double *Sj = S + j*ldS;
+            for (size_t k = 0; k < ncols; k++)
+              Wi[k] += v*Sj[k];
+          }
+      }
+    // Upper triangle of P = T*W + Q, then symmetrization
+#ifdef USE_OMP
+# pragma omp parallel for num_threads(numthreads) schedule(dynamic)
+#endif
+    for (int c = 0; c < (int) nrows; c++)
+      {
+        const double *Wc = W + c*ncols;
+        for (int r = 0; r <= c; r++)
+          {
+            double s = Q[r+c*ldQ];
+            for (size_t l = row_start[r]; l < row_start[r+1]; l++)
+              s += values[l]*Wc[col_index[l]];
+            P[r+c*ldP] = s;
+          }
+      }
+    for (size_t c = 0; c < nrows; c++)
+      for (size_t r = c+1; r < nrows; r++)
+        P[r+c*ldP] = P[c+r*ldP];
+  }
+
+private:
+  size_t nrows, ncols;
+  std::vector<size_t> row_start, col_index;
+  std::vector<double> values;
+};
+
+#endif
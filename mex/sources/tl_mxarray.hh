@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if !defined(TL_MXARRAY_HH_INCLUDED)
+#define TL_MXARRAY_HH_INCLUDED
+
+#include <cstring>
+
+#include <dynmex.h>
+
+#include "twod_matrix.h"
+#include "Vector.h"
+
+/*
+ * Dynare++ matrices and vectors over the data of real full double mxArrays,
+ * for the MEX gateways linked with dynare++. Nothing is copied: the objects
+ * are views, valid as long as the mxArray, and writing to them writes to the
+ * mxArray. Inputs are passed to dynare++ through const objects; outputs are
+ * created with mxCreateDoubleMatrix() and filled in place through a view.
+ */
+
+class MxTwoDMatrix : public TwoDMatrix
+{
+public:
+  explicit MxTwoDMatrix(const mxArray *a)
+    : TwoDMatrix((int) mxGetM(a), (int) mxGetN(a), mxGetPr(a))
+  {
+  }
+  using TwoDMatrix::operator=;
+private:
+  // A copy would not be a view
+  MxTwoDMatrix(const MxTwoDMatrix &);
+};
+
+class MxVector : public Vector
+{
+public:
+  explicit MxVector(const mxArray *a)
+    : Vector(mxGetPr(a), (int) mxGetNumberOfElements(a))
+  {
+  }
+  const Vector &
+  operator=(const Vector &v)
+  {
+    return Vector::operator=(v);
+  }
+  const Vector &
+  operator=(const ConstVector &v)
+  {
+    return Vector::operator=(v);
+  }
+private:
+  MxVector(const MxVector &);
+};
+
+//! Creates a Matlab matrix with the contents of a matrix owned by dynare++
+inline mxArray *
+mxCreateFromTwoDMatrix(const ConstTwoDMatrix &m)
+{
+  mxArray *res = mxCreateDoubleMatrix(m.numRows(), m.numCols(), mxREAL);
+  const ConstVector &data = m.getData();
+  if (data.skip() == 1 && data.length() == m.numRows()*m.numCols())
+    memcpy(mxGetPr(res), data.base(), data.length()*sizeof(double));
+  else
+    MxTwoDMatrix(res).place(m, 0, 0);
+  return res;
+}
+
+#endif // !defined(TL_MXARRAY_HH_INCLUDED)
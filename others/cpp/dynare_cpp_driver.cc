@@ -304,9 +304,9 @@ ModFilePrior::ModFilePrior(const int index_arg,
 ModFileStructuralInnovationPrior::ModFileStructuralInnovationPrior(const int index_arg,
                                                                    const string shape_arg,
                                                                    const double mean_arg,
+                                                                   const double mode_arg,
                                                                    const double stdev_arg,
                                                                    const double variance_arg,
-                                                                   const double mode_arg,
                                                                    const vector <double> domain_arg) :
   BasicModFilePrior(index_arg,
                     shape_arg,
@@ -321,9 +321,9 @@ ModFileStructuralInnovationPrior::ModFileStructuralInnovationPrior(const int ind
 ModFileMeasurementErrorPrior::ModFileMeasurementErrorPrior(const int index_arg,
                                                            const string shape_arg,
                                                            const double mean_arg,
+                                                           const double mode_arg,
                                                            const double stdev_arg,
                                                            const double variance_arg,
-                                                           const double mode_arg,
                                                            const vector <double> domain_arg) :
   BasicModFilePrior(index_arg,
                     shape_arg,
@@ -339,9 +339,9 @@ ModFileStructuralInnovationCorrPrior::ModFileStructuralInnovationCorrPrior(const
                                                                            const int index2_arg,
                                                                            const string shape_arg,
                                                                            const double mean_arg,
+                                                                           const double mode_arg,
                                                                            const double stdev_arg,
                                                                            const double variance_arg,
-                                                                           const double mode_arg,
                                                                            const vector <double> domain_arg) :
   BasicModFilePrior(index1_arg,
                     shape_arg,
@@ -359,9 +359,9 @@ ModFileMeasurementErrorCorrPrior::ModFileMeasurementErrorCorrPrior(const int ind
                                                                    const int index2_arg,
                                                                    const string shape_arg,
                                                                    const double mean_arg,
+                                                                   const double mode_arg,
                                                                    const double stdev_arg,
                                                                    const double variance_arg,
-                                                                   const double mode_arg,
                                                                    const vector <double> domain_arg) :
   BasicModFilePrior(index1_arg,
                     shape_arg,
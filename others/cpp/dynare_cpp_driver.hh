@@ -188,9 +188,9 @@ public:
   ModFileMeasurementErrorPrior(const int index_arg,
                                const string shape_arg,
                                const double mean_arg,
+                               const double mode_arg,
                                const double stdev_arg,
                                const double variance_arg,
-                               const double mode_arg,
                                const vector <double> domain_arg);
 };
 
@@ -203,10 +203,15 @@ public:
                                        const int index2_arg,
                                        const string shape_arg,
                                        const double mean_arg,
+                                       const double mode_arg,
                                        const double stdev_arg,
                                        const double variance_arg,
-                                       const double mode_arg,
                                        const vector <double> domain_arg);
+  inline int
+  get_index2() const
+  {
+    return index2;
+  };
 };
 
 class ModFileMeasurementErrorCorrPrior : public BasicModFilePrior
@@ -218,10 +223,15 @@ public:
                                    const int index2_arg,
                                    const string shape_arg,
                                    const double mean_arg,
+                                   const double mode_arg,
                                    const double stdev_arg,
                                    const double variance_arg,
-                                   const double mode_arg,
                                    const vector <double> domain_arg);
+  inline int
+  get_index2() const
+  {
+    return index2;
+  };
 };
 
 class BasicModFileOption
@@ -280,6 +290,11 @@ public:
   ModFileStructuralInnovationCorrOption(const int index1_arg,
                                         const int index2_arg,
                                         const double init_arg);
+  inline int
+  get_index2() const
+  {
+    return index2;
+  };
 };
 
 class ModFileMeasurementErrorCorrOption : public BasicModFileOption
@@ -290,6 +305,11 @@ public:
   ModFileMeasurementErrorCorrOption(const int index1_arg,
                                     const int index2_arg,
                                     const double init_arg);
+  inline int
+  get_index2() const
+  {
+    return index2;
+  };
 };
 
 class DynareInfo
@@ -325,6 +345,7 @@ public:
              vector<int> predetermined_variables_arg,
              vector<int> varobs_arg,
              vector<int> NNZDerivatives_arg);
+  ~DynareInfo();
 
   inline void
   addMarkovSwitching(MarkovSwitching *ms)
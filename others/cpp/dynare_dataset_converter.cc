@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Converts a dataset to the binary format of MappedDataset, which the C++
+ * estimation driver maps in memory instead of parsing it.
+ *
+ * The input is either:
+ * - a CSV file as written by dseries: a first line with the names of the
+ *   variables (after an empty cell if the first column holds the dates),
+ *   then one line by period. Without a header the variables are named V1,
+ *   V2... Empty cells and NaN are missing observations;
+ * - a MAT file (read with matio), each real double vector being a variable.
+ *   All the vectors must have the same length.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <matio.h>
+
+#include "Matrix.hh"
+#include "MappedDataset.hh"
+
+static std::string
+trim(const std::string &s)
+{
+  size_t b = s.find_first_not_of(" \t\r\""), e = s.find_last_not_of(" \t\r\"");
+  return b == std::string::npos ? std::string() : s.substr(b, e-b+1);
+}
+
+static bool
+parse_number(const std::string &s, double &v)
+{
+  if (s.empty() || s == "NaN" || s == "nan" || s == "NA")
+    {
+      v = std::numeric_limits<double>::quiet_NaN();
+      return true;
+    }
+  char *end;
+  v = strtod(s.c_str(), &end);
+  return *end == '\0';
+}
+
+static void
+split(const std::string &line, std::vector<std::string> &cells)
+{
+  cells.clear();
+  std::istringstream ss(line);
+  std::string cell;
+  while (std::getline(ss, cell, ','))
+    cells.push_back(trim(cell));
+  if (!line.empty() && line[line.size()-1] == ',')
+    cells.push_back("");
+}
+
+static void
+read_csv(const std::string &filename, std::vector<std::string> &names, std::vector<std::string> &dates,
+         std::vector<double> &values)
+{
+  std::ifstream in(filename.c_str());
+  if (!in.is_open())
+    throw std::runtime_error("can't open " + filename);
+
+  std::vector<std::vector<std::string> > rows;
+  std::string line;
+  std::vector<std::string> cells;
+  while (std::getline(in, line))
+    {
+      if (trim(line).empty())
+        continue;
+      split(line, cells);
+      rows.push_back(cells);
+    }
+  if (rows.empty())
+    throw std::runtime_error(filename + " is empty");
+
+  // A header has a cell which is not a number, apart from the first one
+  bool header = false;
+  double v;
+  for (size_t j = 1; j < rows[0].size(); j++)
+    header = header || !parse_number(rows[0][j], v);
+  if (rows[0].size() == 1)
+    header = !parse_number(rows[0][0], v);
+  const size_t first_row = header ? 1 : 0;
+  if (rows.size() == first_row)
+    throw std::runtime_error(filename + " has no observations");
+
+  // The first column holds the dates if the header starts with an empty cell, or if it is not numeric
+  bool dated = header && rows[0][0].empty();
+  for (size_t t = first_row; t < rows.size(); t++)
+    dated = dated || !parse_number(rows[t][0], v);
+  const size_t first_col = dated ? 1 : 0, ncells = rows[first_row].size();
+  if (ncells <= first_col)
+    throw std::runtime_error(filename + " has no variables");
+
+  for (size_t j = first_col; j < ncells; j++)
+    if (header)
+      names.push_back(rows[0][j]);
+    else
+      {
+        std::ostringstream name;
+        name << "V" << j-first_col+1;
+        names.push_back(name.str());
+      }
+  for (size_t t = first_row; t < rows.size(); t++)
+    {
+      if (rows[t].size() != ncells)
+        {
+          std::ostringstream msg;
+          msg << filename << ": line " << t+1 << " has " << rows[t].size() << " cells instead of " << ncells;
+          throw std::runtime_error(msg.str());
+        }
+      if (dated)
+        dates.push_back(rows[t][0]);
+      for (size_t j = first_col; j < ncells; j++)
+        {
+          if (!parse_number(rows[t][j], v))
+            throw std::runtime_error(filename + ": invalid number " + rows[t][j]);
+          values.push_back(v);
+        }
+    }
+}
+
+static void
+read_mat(const std::string &filename, std::vector<std::string> &names, std::vector<double> &values)
+{
+  mat_t *mat = Mat_Open(filename.c_str(), MAT_ACC_RDONLY);
+  if (mat == NULL)
+    throw std::runtime_error("can't open " + filename);
+
+  std::vector<std::vector<double> > series;
+  matvar_t *var;
+  while ((var = Mat_VarReadNext(mat)) != NULL)
+    {
+      if (var->class_type == MAT_C_DOUBLE && !var->isComplex && var->rank == 2
+          && (var->dims[0] == 1 || var->dims[1] == 1) && var->dims[0]*var->dims[1] > 1)
+        {
+          const double *d = (const double *) var->data;
+          const size_t n = var->dims[0]*var->dims[1];
+          if (!series.empty() && n != series[0].size())
+            std::cerr << "Warning: " << var->name << " does not have the length of " << names[0] << ", skipped" << std::endl;
+          else
+            {
+              names.push_back(var->name);
+              series.push_back(std::vector<double>(d, d + n));
+            }
+        }
+      Mat_VarFree(var);
+    }
+  Mat_Close(mat);
+  if (series.empty())
+    throw std::runtime_error(filename + " has no vector of doubles");
+
+  // Stored by period
+  for (size_t t = 0; t < series[0].size(); t++)
+    for (size_t i = 0; i < series.size(); i++)
+      values.push_back(series[i][t]);
+}
+
+int
+main(int argc, char **argv)
+{
+  if (argc != 3)
+    {
+      std::cerr << "Usage: " << argv[0] << " input.csv|input.mat output" << std::endl;
+      return EXIT_FAILURE;
+    }
+  const std::string input = argv[1], output = argv[2];
+  try
+    {
+      std::vector<std::string> names, dates;
+      std::vector<double> values;
+      if (input.size() > 4 && input.compare(input.size()-4, 4, ".mat") == 0)
+        read_mat(input, names, values);
+      else
+        read_csv(input, names, dates, values);
+      const size_t nobs = values.size()/names.size();
+      MappedDataset::write(output, names, dates, MatrixConstView(&values[0], names.size(), nobs, names.size()));
+      std::cout << output << ": " << names.size() << " variables, " << nobs << " observations" << std::endl;
+    }
+  catch (const std::exception &e)
+    {
+      std::cerr << "Error: " << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,1017 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Bayesian estimation of a model without Matlab or Octave. The description of
+ * the model (symbols, calibration, observed variables, priors and initial
+ * values of the estimated parameters) is the DynareInfo object written by the
+ * preprocessor with the language=C++ option, the dynamic and static models are
+ * loaded from the <basename>_dynamic and <basename>_static shared libraries
+ * (compiled from the C files written with the use_dll option) and the
+ * posterior density is computed by the estimation library of
+ * mex/sources/estimation.
+ *
+ * The posterior mode is found by a BFGS quasi-Newton method, the covariance
+ * of the proposal is the inverse of the Hessian at the mode, then the
+ * Metropolis-Hastings chains are simulated in parallel. The accepted draws of
+ * chain b are written to <basename>_mh_blck<b>.bin, in the layout of
+ * MHDrawsFile (the first column holds the log posterior density).
+ *
+ * The data file is either a dataset written by dynare_dataset_converter,
+ * which is memory mapped and used in place, or a text file.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/normal_distribution.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <boost/math/special_functions/gamma.hpp>
+
+#ifdef USE_OMP
+# include <omp.h>
+#endif
+
+#include "dynare_cpp_driver.hh"
+
+#include "Vector.hh"
+#include "Matrix.hh"
+#include "LapackBindings.hh"
+#include "LogPosteriorDensity.hh"
+#include "RandomWalkMetropolisHastings.hh"
+#include "MHDrawsFile.hh"
+#include "MappedDataset.hh"
+
+struct EstimationOptions
+{
+  std::string basename, datafile, steadystatefile;
+  size_t first_obs, nobs, presample;
+  size_t mh_replic, mh_nblocks, thinning, flush_interval;
+  double mh_jscale, mh_init_scale, mh_drop;
+  double qz_criterium, riccati_tol, lyapunov_tol, lyapunov_fixed_point_tol;
+  bool noconstant, fast_kalman_filter, sqrt_kalman_filter;
+  size_t maxit;
+  double gtol;
+  int threads, seed;
+
+  EstimationOptions() :
+    first_obs(1), nobs(0), presample(0),
+    mh_replic(20000), mh_nblocks(2), thinning(1), flush_interval(10000),
+    mh_jscale(0.2), mh_init_scale(0.4), mh_drop(0.5),
+    qz_criterium(1.000001), riccati_tol(1e-6), lyapunov_tol(1e-16), lyapunov_fixed_point_tol(0.0),
+    noconstant(false), fast_kalman_filter(false), sqrt_kalman_filter(false),
+    maxit(1000), gtol(1e-5), threads(1), seed(0)
+  {
+  }
+};
+
+/**
+ * Evaluates minus the log posterior density at a vector of estimated
+ * parameters. Each thread needs its own kernel, since the posterior density
+ * object, the steady state (used as starting point of the next steady state
+ * computation) and the covariance matrices are updated at each evaluation.
+ */
+class PosteriorKernel
+{
+public:
+  PosteriorKernel(const EstimationOptions &options, EstimatedParametersDescription &epd_arg, DynareInfo &info,
+                  const std::vector<size_t> &varobs, const MatrixConstView &data_arg,
+                  const Vector &steadyState_arg, const Vector &deepParams_arg, const Matrix &Q_arg, const Matrix &H_arg) :
+    epd(epd_arg),
+    lpd(options.basename, epd_arg, info.get_endo_nbr(), info.get_exo_nbr(), info.get_zeta_fwrd(), info.get_zeta_back(),
+        info.get_zeta_mixed(), info.get_zeta_static(), options.qz_criterium, varobs, options.riccati_tol, options.lyapunov_tol,
+        options.noconstant, options.fast_kalman_filter, options.sqrt_kalman_filter,
+        options.lyapunov_fixed_point_tol),
+    data(data_arg), presample(options.presample),
+    steadyState(steadyState_arg), deepParams(deepParams_arg), Q(Q_arg), H(H_arg)
+  {
+  }
+
+  //! Returns minus the log posterior density, or INFINITY outside of the bounds or if the model can not be solved
+  double
+  compute(Vector &x)
+  {
+    for (size_t i = 0; i < x.getSize(); i++)
+      if (!(x(i) >= epd.estParams[i].lower_bound && x(i) <= epd.estParams[i].upper_bound))
+        return INFINITY;
+    VectorView steadyStateView(steadyState, 0, steadyState.getSize());
+    VectorView deepParamsView(deepParams, 0, deepParams.getSize());
+    MatrixView QView(Q, 0, 0, Q.getRows(), Q.getCols());
+    double f;
+    try
+      {
+        f = lpd.compute(steadyStateView, x, deepParamsView, data, QView, H, presample);
+      }
+    catch (...)
+      {
+        return INFINITY;
+      }
+    if (std::isnan(f))
+      return INFINITY;
+    return f;
+  }
+
+  EstimatedParametersDescription &epd;
+  LogPosteriorDensity lpd;
+  const MatrixConstView data;
+  size_t presample;
+  Vector steadyState, deepParams;
+  Matrix Q, H;
+};
+
+/**
+ * Returns the 0-based index of the kernel of the calling thread
+ */
+static int
+thread_index()
+{
+#ifdef USE_OMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
+/**
+ * Computes the prior of an estimated parameter from the mean and the
+ * standard deviation given in the mod file, and its bounds. The
+ * hyperparameters are those computed by set_prior.m
+ */
+static Prior *
+make_prior(BasicModFilePrior *p, const std::string &name, double &lower_bound, double &upper_bound)
+{
+  const std::string shape_name = p->get_shape();
+  Prior::pShape shape;
+  if (shape_name == "beta")
+    shape = Prior::Beta;
+  else if (shape_name == "gamma")
+    shape = Prior::Gamma;
+  else if (shape_name == "normal")
+    shape = Prior::Gaussian;
+  else if (shape_name == "inv_gamma")
+    shape = Prior::Inv_gamma_1;
+  else if (shape_name == "uniform")
+    shape = Prior::Uniform;
+  else if (shape_name == "inv_gamma2")
+    shape = Prior::Inv_gamma_2;
+  else
+    throw std::runtime_error("the " + shape_name + " prior of " + name + " is not supported");
+
+  if (!p->mean_has_val())
+    throw std::runtime_error("the prior of " + name + " has no mean");
+  double mean = p->get_mean(), stdev;
+  if (p->stdev_has_val())
+    stdev = p->get_stdev();
+  else if (p->variance_has_val())
+    stdev = sqrt(p->get_variance());
+  else
+    throw std::runtime_error("the prior of " + name + " has no standard deviation");
+
+  double p3, p4;
+  if (p->domain_has_val())
+    {
+      std::vector<double> domain = p->get_domain();
+      p3 = domain[0];
+      p4 = domain[1];
+    }
+  else if (shape == Prior::Beta)
+    {
+      p3 = 0;
+      p4 = 1;
+    }
+  else if (shape == Prior::Gaussian)
+    {
+      p3 = -INFINITY;
+      p4 = INFINITY;
+    }
+  else if (shape == Prior::Uniform)
+    {
+      p3 = mean - sqrt(3.0)*stdev;
+      p4 = mean + sqrt(3.0)*stdev;
+    }
+  else
+    {
+      p3 = 0;
+      p4 = INFINITY;
+    }
+
+  double fhp, shp;
+  switch (shape)
+    {
+    case Prior::Beta:
+      {
+        double mu = (mean-p3)/(p4-p3), s = stdev/(p4-p3);
+        fhp = (1-mu)*mu*mu/(s*s) - mu;
+        shp = fhp*(1/mu-1);
+      }
+      break;
+    case Prior::Gamma:
+      fhp = (mean-p3)*(mean-p3)/(stdev*stdev);
+      shp = stdev*stdev/(mean-p3);
+      break;
+    case Prior::Gaussian:
+      fhp = mean;
+      shp = stdev;
+      break;
+    case Prior::Inv_gamma_1:
+      {
+        // Solves for the degrees of freedom nu > 2 as in inverse_gamma_specification.m
+        double m = mean-p3, m2 = m*m + stdev*stdev;
+        double nu_lo = 2, nu_hi = 4;
+        while (log(m) - 0.5*log(m2*(nu_hi-2)/2) - boost::math::lgamma((nu_hi-1)/2) + boost::math::lgamma(nu_hi/2) < 0
+               && nu_hi < 1e9)
+          nu_hi *= 2;
+        for (int it = 0; it < 200; it++)
+          {
+            double nu = 0.5*(nu_lo+nu_hi);
+            if (log(m) - 0.5*log(m2*(nu-2)/2) - boost::math::lgamma((nu-1)/2) + boost::math::lgamma(nu/2) < 0)
+              nu_hi = nu;
+            else
+              nu_lo = nu;
+          }
+        shp = 0.5*(nu_lo+nu_hi);
+        fhp = m2*(shp-2);
+      }
+      break;
+    case Prior::Uniform:
+      fhp = p3;
+      shp = p4;
+      break;
+    case Prior::Inv_gamma_2:
+      {
+        double m = mean-p3, r = m*m/(stdev*stdev);
+        shp = 2*(2+r);
+        fhp = 2*m*(1+r);
+      }
+      break;
+    }
+
+  lower_bound = p3;
+  upper_bound = p4;
+  return Prior::constructPrior(shape, mean, stdev, p3, p4, fhp, shp);
+}
+
+static size_t
+varobs_position(const std::vector<size_t> &varobs, int endo, DynareInfo &info)
+{
+  std::vector<size_t>::const_iterator it = std::find(varobs.begin(), varobs.end(), (size_t) endo);
+  if (it == varobs.end())
+    throw std::runtime_error("measurement error on " + info.get_endo_name_by_index(endo) + ", which is not observed");
+  return it - varobs.begin();
+}
+
+/**
+ * Builds the description of the estimated parameters from the priors of the
+ * mod file, in the order of estim_params_: standard deviations and
+ * correlations of the structural shocks and of the measurement errors, then
+ * the deep parameters. The initial values are the init options if any, else
+ * the calibrated values of the deep parameters and the prior means.
+ */
+static void
+make_estimated_parameters(DynareInfo &info, const std::vector<size_t> &varobs, std::vector<EstimatedParameter> &estParams,
+                          std::vector<std::string> &names, std::vector<double> &init, std::vector<double> &prior_stdev)
+{
+  std::vector<size_t> subSampleIDs(1, 0);
+  double lb, ub;
+
+  std::vector<ModFileStructuralInnovationPrior *> sip = info.get_structural_innovation_prior();
+  std::vector<ModFileStructuralInnovationOption *> sio = info.get_structural_innovation_option();
+  for (size_t i = 0; i < sip.size(); i++)
+    {
+      int id = sip[i]->get_index();
+      names.push_back("SE_" + info.get_exo_name_by_index(id));
+      Prior *p = make_prior(sip[i], names.back(), lb, ub);
+      estParams.push_back(EstimatedParameter(EstimatedParameter::shock_SD, id, 0, subSampleIDs, lb, ub, p));
+      double x0 = p->mean;
+      for (size_t j = 0; j < sio.size(); j++)
+        if (sio[j]->get_index() == id && !std::isnan(sio[j]->get_init()))
+          x0 = sio[j]->get_init();
+      init.push_back(x0);
+    }
+
+  std::vector<ModFileMeasurementErrorPrior *> mep = info.get_measurement_error_prior();
+  std::vector<ModFileMeasurementErrorOption *> meo = info.get_measurement_error_option();
+  for (size_t i = 0; i < mep.size(); i++)
+    {
+      int id = mep[i]->get_index();
+      names.push_back("EE_" + info.get_endo_name_by_index(id));
+      Prior *p = make_prior(mep[i], names.back(), lb, ub);
+      estParams.push_back(EstimatedParameter(EstimatedParameter::measureErr_SD, varobs_position(varobs, id, info), 0,
+                                             subSampleIDs, lb, ub, p));
+      double x0 = p->mean;
+      for (size_t j = 0; j < meo.size(); j++)
+        if (meo[j]->get_index() == id && !std::isnan(meo[j]->get_init()))
+          x0 = meo[j]->get_init();
+      init.push_back(x0);
+    }
+
+  std::vector<ModFileStructuralInnovationCorrPrior *> sicp = info.get_structural_innovation_corr_prior();
+  std::vector<ModFileStructuralInnovationCorrOption *> sico = info.get_structural_innovation_corr_option();
+  for (size_t i = 0; i < sicp.size(); i++)
+    {
+      int id1 = sicp[i]->get_index(), id2 = sicp[i]->get_index2();
+      names.push_back("CC_" + info.get_exo_name_by_index(id1) + "_" + info.get_exo_name_by_index(id2));
+      Prior *p = make_prior(sicp[i], names.back(), lb, ub);
+      estParams.push_back(EstimatedParameter(EstimatedParameter::shock_Corr, id1, id2, subSampleIDs, lb, ub, p));
+      double x0 = p->mean;
+      for (size_t j = 0; j < sico.size(); j++)
+        if (sico[j]->get_index() == id1 && sico[j]->get_index2() == id2 && !std::isnan(sico[j]->get_init()))
+          x0 = sico[j]->get_init();
+      init.push_back(x0);
+    }
+
+  std::vector<ModFileMeasurementErrorCorrPrior *> mecp = info.get_measurement_error_corr_prior();
+  std::vector<ModFileMeasurementErrorCorrOption *> meco = info.get_measurement_error_corr_option();
+  for (size_t i = 0; i < mecp.size(); i++)
+    {
+      int id1 = mecp[i]->get_index(), id2 = mecp[i]->get_index2();
+      names.push_back("CE_" + info.get_endo_name_by_index(id1) + "_" + info.get_endo_name_by_index(id2));
+      Prior *p = make_prior(mecp[i], names.back(), lb, ub);
+      estParams.push_back(EstimatedParameter(EstimatedParameter::measureErr_Corr, varobs_position(varobs, id1, info),
+                                             varobs_position(varobs, id2, info), subSampleIDs, lb, ub, p));
+      double x0 = p->mean;
+      for (size_t j = 0; j < meco.size(); j++)
+        if (meco[j]->get_index() == id1 && meco[j]->get_index2() == id2 && !std::isnan(meco[j]->get_init()))
+          x0 = meco[j]->get_init();
+      init.push_back(x0);
+    }
+
+  std::vector<ModFilePrior *> pp = info.get_prior();
+  std::vector<ModFileOption *> po = info.get_option();
+  std::vector<double> params = info.get_params();
+  for (size_t i = 0; i < pp.size(); i++)
+    {
+      int id = pp[i]->get_index();
+      names.push_back(info.get_param_name_by_index(id));
+      Prior *p = make_prior(pp[i], names.back(), lb, ub);
+      estParams.push_back(EstimatedParameter(EstimatedParameter::deepPar, id, 0, subSampleIDs, lb, ub, p));
+      double x0 = std::isnan(params[id]) ? p->mean : params[id];
+      for (size_t j = 0; j < po.size(); j++)
+        if (po[j]->get_index() == id && !std::isnan(po[j]->get_init()))
+          x0 = po[j]->get_init();
+      init.push_back(x0);
+    }
+
+  for (size_t i = 0; i < estParams.size(); i++)
+    prior_stdev.push_back(estParams[i].prior->standard);
+}
+
+/**
+ * Returns true if the file starts with the magic string of MappedDataset
+ */
+static bool
+is_mapped_dataset(const std::string &filename)
+{
+  char buf[sizeof(MappedDataset::magic)];
+  std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+  return in.read(buf, sizeof(buf)) && memcmp(buf, MappedDataset::magic, sizeof(buf)) == 0;
+}
+
+/**
+ * Reads the observations from a text file with one period by line and one
+ * column by observed variable (in the order of varobs), separated by blanks
+ * or commas. Empty lines and lines starting with % or # are skipped.
+ */
+static void
+read_data(const std::string &filename, size_t n_varobs, std::vector<std::vector<double> > &obs)
+{
+  std::ifstream in(filename.c_str());
+  if (!in.is_open())
+    throw std::runtime_error("can't open data file " + filename);
+  std::string line;
+  size_t lineno = 0;
+  while (std::getline(in, line))
+    {
+      lineno++;
+      std::replace(line.begin(), line.end(), ',', ' ');
+      std::istringstream ss(line);
+      std::vector<double> row;
+      std::string tok;
+      while (ss >> tok)
+        {
+          if (row.empty() && (tok[0] == '%' || tok[0] == '#'))
+            break;
+          char *end;
+          double v = strtod(tok.c_str(), &end);
+          if (*end != '\0')
+            {
+              std::ostringstream msg;
+              msg << filename << ":" << lineno << ": invalid number " << tok;
+              throw std::runtime_error(msg.str());
+            }
+          row.push_back(v);
+        }
+      if (row.empty())
+        continue;
+      if (row.size() != n_varobs)
+        {
+          std::ostringstream msg;
+          msg << filename << ":" << lineno << ": " << row.size() << " observations instead of " << n_varobs;
+          throw std::runtime_error(msg.str());
+        }
+      obs.push_back(row);
+    }
+}
+
+/**
+ * Central finite difference gradient of f at x, the evaluations are shared
+ * among the kernels
+ */
+static void
+gradient(std::vector<PosteriorKernel *> &kernels, const Vector &x, double fx, Vector &g)
+{
+  const int n = (int) x.getSize();
+#ifdef USE_OMP
+# pragma omp parallel for num_threads(kernels.size()) schedule(dynamic)
+#endif
+  for (int i = 0; i < n; i++)
+    {
+      PosteriorKernel &kernel = *kernels[thread_index()];
+      Vector xh(x);
+      double h = 1e-5*std::max(1.0, fabs(x(i)));
+      xh(i) = x(i) + h;
+      double fp = kernel.compute(xh);
+      xh(i) = x(i) - h;
+      double fm = kernel.compute(xh);
+      if (std::isinf(fp) && std::isinf(fm))
+        g(i) = 0;
+      else if (std::isinf(fp))
+        g(i) = (fx-fm)/h;
+      else if (std::isinf(fm))
+        g(i) = (fp-fx)/h;
+      else
+        g(i) = (fp-fm)/(2*h);
+    }
+}
+
+/**
+ * Minimizes minus the log posterior density with the BFGS method, starting
+ * from x (which holds the mode on exit). The initial inverse Hessian is the
+ * diagonal of the prior variances, Hinv holds the last approximation on
+ * exit. Returns minus the log posterior density at the mode.
+ */
+static double
+find_mode(std::vector<PosteriorKernel *> &kernels, const EstimationOptions &options, const std::vector<double> &prior_stdev,
+          Vector &x, Matrix &Hinv)
+{
+  const size_t n = x.getSize();
+  Vector g(n), gnew(n), xnew(n), d(n), s(n), y(n), Hy(n);
+
+  double f = kernels[0]->compute(x);
+  if (std::isinf(f))
+    throw std::runtime_error("the posterior density is not finite at the initial values of the estimated parameters");
+  gradient(kernels, x, f, g);
+
+  Hinv.setAll(0.0);
+  for (size_t i = 0; i < n; i++)
+    Hinv(i, i) = prior_stdev[i]*prior_stdev[i];
+
+  size_t it;
+  for (it = 0; it < options.maxit; it++)
+    {
+      double gmax = 0;
+      for (size_t i = 0; i < n; i++)
+        gmax = std::max(gmax, fabs(g(i))*std::max(1.0, fabs(x(i))));
+      if (gmax < options.gtol)
+        break;
+
+      // Search direction, reset to the scaled steepest descent if it is not a descent direction
+      double slope = 0;
+      for (size_t i = 0; i < n; i++)
+        {
+          d(i) = 0;
+          for (size_t j = 0; j < n; j++)
+            d(i) -= Hinv(i, j)*g(j);
+          slope += d(i)*g(i);
+        }
+      if (slope >= 0)
+        {
+          Hinv.setAll(0.0);
+          slope = 0;
+          for (size_t i = 0; i < n; i++)
+            {
+              Hinv(i, i) = prior_stdev[i]*prior_stdev[i];
+              d(i) = -Hinv(i, i)*g(i);
+              slope += d(i)*g(i);
+            }
+        }
+
+      // Backtracking line search with the Armijo condition
+      double t = 1, fnew;
+      do
+        {
+          for (size_t i = 0; i < n; i++)
+            xnew(i) = x(i) + t*d(i);
+          fnew = kernels[0]->compute(xnew);
+          if (fnew <= f + 1e-4*t*slope)
+            break;
+          t *= 0.5;
+        }
+      while (t > 1e-12);
+      if (!(fnew < f))
+        break;
+
+      gradient(kernels, xnew, fnew, gnew);
+      double sy = 0;
+      for (size_t i = 0; i < n; i++)
+        {
+          s(i) = xnew(i) - x(i);
+          y(i) = gnew(i) - g(i);
+          sy += s(i)*y(i);
+        }
+      // Skip the update if the curvature condition does not hold
+      if (sy > 1e-12)
+        {
+          double yHy = 0;
+          for (size_t i = 0; i < n; i++)
+            {
+              Hy(i) = 0;
+              for (size_t j = 0; j < n; j++)
+                Hy(i) += Hinv(i, j)*y(j);
+              yHy += y(i)*Hy(i);
+            }
+          for (size_t i = 0; i < n; i++)
+            for (size_t j = 0; j < n; j++)
+              Hinv(i, j) += ((sy+yHy)*s(i)*s(j))/(sy*sy) - (Hy(i)*s(j) + s(i)*Hy(j))/sy;
+        }
+
+      bool converged = (f - fnew < 1e-10*(1+fabs(f)));
+      x = xnew;
+      g = gnew;
+      f = fnew;
+      if (converged)
+        break;
+    }
+  std::cout << "Mode found in " << it << " iterations, minus log posterior density: " << f << std::endl;
+  return f;
+}
+
+/**
+ * Finite difference Hessian of f at the mode x, the pairs of parameters are
+ * shared among the kernels
+ */
+static void
+hessian(std::vector<PosteriorKernel *> &kernels, const Vector &x, double fx, Matrix &hess)
+{
+  const int n = (int) x.getSize();
+  std::vector<double> h(n);
+  for (int i = 0; i < n; i++)
+    h[i] = 1e-4*std::max(1.0, fabs(x(i)));
+  const int npairs = n*(n+1)/2;
+#ifdef USE_OMP
+# pragma omp parallel for num_threads(kernels.size()) schedule(dynamic)
+#endif
+  for (int k = 0; k < npairs; k++)
+    {
+      int i = 0, j = k;
+      while (j >= n-i)
+        {
+          j -= n-i;
+          i++;
+        }
+      j += i;
+      PosteriorKernel &kernel = *kernels[thread_index()];
+      Vector xh(x);
+      if (i == j)
+        {
+          xh(i) = x(i) + h[i];
+          double fp = kernel.compute(xh);
+          xh(i) = x(i) - h[i];
+          double fm = kernel.compute(xh);
+          hess(i, i) = (fp - 2*fx + fm)/(h[i]*h[i]);
+        }
+      else
+        {
+          double f4[4];
+          for (int c = 0; c < 4; c++)
+            {
+              xh(i) = x(i) + ((c & 1) ? -h[i] : h[i]);
+              xh(j) = x(j) + ((c & 2) ? -h[j] : h[j]);
+              f4[c] = kernel.compute(xh);
+            }
+          hess(i, j) = (f4[0] - f4[1] - f4[2] + f4[3])/(4*h[i]*h[j]);
+          hess(j, i) = hess(i, j);
+        }
+    }
+}
+
+static void
+usage(const char *progname)
+{
+  std::cerr << "Usage: " << progname << " basename datafile [options]" << std::endl
+            << "The datafile is a dataset written by dynare_dataset_converter, or a text file" << std::endl
+            << "with one line by period and one column by observed variable." << std::endl
+            << "  --first-obs N         first observation used (1-based, default 1)" << std::endl
+            << "  --nobs N              number of observations used (default: all)" << std::endl
+            << "  --presample N         number of periods excluded from the likelihood (default 0)" << std::endl
+            << "  --steady-state FILE   initial guess of the steady state (endo_nbr values)" << std::endl
+            << "  --mh-replic N         number of draws of each chain (default 20000, 0 for the mode only)" << std::endl
+            << "  --mh-nblocks N        number of chains (default 2)" << std::endl
+            << "  --mh-jscale X         scale of the jumps of the proposal (default 0.2)" << std::endl
+            << "  --mh-init-scale X     scale of the dispersion of the initial draws (default 0.4)" << std::endl
+            << "  --mh-drop X           share of the draws dropped as burn-in (default 0.5)" << std::endl
+            << "  --mh-thinning N       thinning of the proposed draws files (default 1)" << std::endl
+            << "  --qz-criterium X      (default 1.000001)" << std::endl
+            << "  --riccati-tol X       (default 1e-6)" << std::endl
+            << "  --lyapunov-tol X      (default 1e-16)" << std::endl
+            << "  --noconstant" << std::endl
+            << "  --fast-kalman-filter" << std::endl
+            << "  --sqrt-kalman-filter" << std::endl
+            << "  --maxit N             maximum number of BFGS iterations (default 1000)" << std::endl
+            << "  --gtol X              tolerance on the gradient at the mode (default 1e-5)" << std::endl
+            << "  --threads N           number of threads (default 1)" << std::endl
+            << "  --seed N              seed of the initial draws of the chains (default 0)" << std::endl
+            << "The standard deviations of the shocks which are not estimated are set to 1." << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+static void
+parse_options(int argc, char **argv, EstimationOptions &options)
+{
+  if (argc < 3)
+    usage(argv[0]);
+  options.basename = argv[1];
+  options.datafile = argv[2];
+  for (int i = 3; i < argc; i++)
+    {
+      std::string opt = argv[i];
+      if (opt == "--noconstant")
+        {
+          options.noconstant = true;
+          continue;
+        }
+      if (opt == "--fast-kalman-filter")
+        {
+          options.fast_kalman_filter = true;
+          continue;
+        }
+      if (opt == "--sqrt-kalman-filter")
+        {
+          options.sqrt_kalman_filter = true;
+          continue;
+        }
+      if (i+1 >= argc)
+        usage(argv[0]);
+      const char *val = argv[++i];
+      if (opt == "--first-obs")
+        options.first_obs = atol(val);
+      else if (opt == "--nobs")
+        options.nobs = atol(val);
+      else if (opt == "--presample")
+        options.presample = atol(val);
+      else if (opt == "--steady-state")
+        options.steadystatefile = val;
+      else if (opt == "--mh-replic")
+        options.mh_replic = atol(val);
+      else if (opt == "--mh-nblocks")
+        options.mh_nblocks = atol(val);
+      else if (opt == "--mh-jscale")
+        options.mh_jscale = atof(val);
+      else if (opt == "--mh-init-scale")
+        options.mh_init_scale = atof(val);
+      else if (opt == "--mh-drop")
+        options.mh_drop = atof(val);
+      else if (opt == "--mh-thinning")
+        options.thinning = atol(val);
+      else if (opt == "--qz-criterium")
+        options.qz_criterium = atof(val);
+      else if (opt == "--riccati-tol")
+        options.riccati_tol = atof(val);
+      else if (opt == "--lyapunov-tol")
+        options.lyapunov_tol = atof(val);
+      else if (opt == "--maxit")
+        options.maxit = atol(val);
+      else if (opt == "--gtol")
+        options.gtol = atof(val);
+      else if (opt == "--threads")
+        options.threads = atoi(val);
+      else if (opt == "--seed")
+        options.seed = atoi(val);
+      else
+        usage(argv[0]);
+    }
+  if (options.first_obs < 1 || options.mh_nblocks < 1 || options.thinning < 1 || options.threads < 1
+      || options.mh_drop < 0 || options.mh_drop >= 1)
+    usage(argv[0]);
+#ifndef USE_OMP
+  if (options.threads > 1)
+    std::cerr << "Warning: compiled without OpenMP, using one thread" << std::endl;
+  options.threads = 1;
+#endif
+}
+
+static int
+estimate(int argc, char **argv)
+{
+  EstimationOptions options;
+  parse_options(argc, argv, options);
+
+  DynareInfo info;
+  const size_t n_endo = info.get_endo_nbr(), n_exo = info.get_exo_nbr();
+  std::vector<int> varobs_int = info.get_varobs();
+  std::vector<size_t> varobs(varobs_int.begin(), varobs_int.end());
+  const size_t n_varobs = varobs.size();
+  if (n_varobs == 0)
+    throw std::runtime_error("no observed variables (varobs) in the mod file");
+
+  // Estimated parameters
+  std::vector<EstimatedParameter> estParamsInfo;
+  std::vector<std::string> names;
+  std::vector<double> init, prior_stdev;
+  make_estimated_parameters(info, varobs, estParamsInfo, names, init, prior_stdev);
+  const size_t npar = estParamsInfo.size();
+  if (npar == 0)
+    throw std::runtime_error("no estimated parameters (priors) in the mod file");
+
+  /* Observations, stored by column. The observed variables of a mapped
+     dataset are found by name, they are used in place if they are
+     consecutive in the dataset and in the order of varobs */
+  MappedDataset *dataset = NULL;
+  std::vector<std::vector<double> > obs;
+  std::vector<int> dataIndex(n_varobs);
+  size_t nobs_data;
+  bool inPlace = false;
+  if (is_mapped_dataset(options.datafile))
+    {
+      dataset = new MappedDataset(options.datafile);
+      nobs_data = dataset->getNumberOfObservations();
+      for (size_t i = 0; i < n_varobs; i++)
+        {
+          std::string name = info.get_endo_name_by_index(varobs[i]);
+          dataIndex[i] = dataset->getIndex(name);
+          if (dataIndex[i] < 0)
+            throw std::runtime_error("the observed variable " + name + " is not in " + options.datafile);
+        }
+      inPlace = true;
+      for (size_t i = 1; i < n_varobs; i++)
+        inPlace = inPlace && dataIndex[i] == dataIndex[0] + (int) i;
+    }
+  else
+    {
+      read_data(options.datafile, n_varobs, obs);
+      nobs_data = obs.size();
+    }
+  if (options.first_obs > nobs_data)
+    throw std::runtime_error("first_obs is beyond the end of the data");
+  size_t nobs = nobs_data - options.first_obs + 1;
+  if (options.nobs > 0)
+    {
+      if (options.nobs > nobs)
+        throw std::runtime_error("not enough observations in the data file");
+      nobs = options.nobs;
+    }
+  if (options.presample >= nobs)
+    throw std::runtime_error("presample is larger than the number of observations");
+  Matrix data(inPlace ? 0 : n_varobs, inPlace ? 0 : nobs);
+  if (dataset != NULL && !inPlace)
+    {
+      MatrixConstView all = dataset->getData();
+      for (size_t t = 0; t < nobs; t++)
+        for (size_t i = 0; i < n_varobs; i++)
+          data(i, t) = all(dataIndex[i], options.first_obs-1+t);
+    }
+  else if (dataset == NULL)
+    for (size_t t = 0; t < nobs; t++)
+      for (size_t i = 0; i < n_varobs; i++)
+        data(i, t) = obs[options.first_obs-1+t][i];
+  const MatrixConstView dataView = inPlace ? dataset->getData(dataIndex[0], n_varobs, options.first_obs-1, nobs)
+    : MatrixConstView(data, 0, 0, n_varobs, nobs);
+
+  std::vector<EstimationSubsample> estSubsamples;
+  estSubsamples.push_back(EstimationSubsample(0, nobs - 1));
+  EstimatedParametersDescription epd(estSubsamples, estParamsInfo);
+
+  // Initial steady state, calibration and covariance matrices
+  Vector steadyState(n_endo), deepParams(info.get_param_nbr());
+  steadyState.setAll(0.0);
+  if (!options.steadystatefile.empty())
+    {
+      std::ifstream in(options.steadystatefile.c_str());
+      for (size_t i = 0; i < n_endo; i++)
+        if (!(in >> steadyState(i)))
+          throw std::runtime_error("can't read " + options.steadystatefile);
+    }
+  std::vector<double> params = info.get_params();
+  for (size_t i = 0; i < params.size(); i++)
+    deepParams(i) = params[i];
+  Matrix Q(n_exo), H(n_varobs);
+  Q.setAll(0.0);
+  for (size_t i = 0; i < n_exo; i++)
+    Q(i, i) = 1.0;
+  H.setAll(0.0);
+
+  std::vector<PosteriorKernel *> kernels;
+  for (int i = 0; i < options.threads; i++)
+    kernels.push_back(new PosteriorKernel(options, epd, info, varobs, dataView, steadyState, deepParams, Q, H));
+
+  // Posterior mode and covariance of the proposal
+  Vector mode(npar);
+  for (size_t i = 0; i < npar; i++)
+    mode(i) = init[i];
+  Matrix Hinv(npar), Sigma(npar);
+  double fmode = find_mode(kernels, options, prior_stdev, mode, Hinv);
+  hessian(kernels, mode, fmode, Sigma);
+  if (lapack::choleskyInverse(Sigma) != 0)
+    {
+      std::cerr << "Warning: the Hessian at the mode is not positive definite, "
+                << "using the BFGS approximation of its inverse" << std::endl;
+      Sigma = Hinv;
+    }
+
+  std::ofstream modeFile((options.basename + "_mode.txt").c_str());
+  std::cout << std::endl << std::setw(20) << "parameter" << std::setw(14) << "mode" << std::setw(14) << "s.d." << std::endl;
+  for (size_t i = 0; i < npar; i++)
+    {
+      std::cout << std::setw(20) << names[i] << std::setw(14) << mode(i) << std::setw(14) << sqrt(Sigma(i, i)) << std::endl;
+      modeFile << names[i] << " " << std::setprecision(17) << mode(i) << " " << sqrt(Sigma(i, i)) << std::endl;
+    }
+  modeFile.close();
+
+  if (options.mh_replic == 0)
+    {
+      for (size_t i = 0; i < kernels.size(); i++)
+        delete kernels[i];
+      for (size_t i = 0; i < npar; i++)
+        delete estParamsInfo[i].prior;
+      delete dataset;
+      return EXIT_SUCCESS;
+    }
+
+  /* Initial draws of the chains around the mode, they are drawn before the
+     parallel region so that they do not depend on the number of threads */
+  const size_t nblocks = options.mh_nblocks, nruns = options.mh_replic;
+  Matrix cholSigma(Sigma);
+  lapack::choleskyDecomp(cholSigma, "L");
+  boost::mt19937 initRng(options.seed);
+  boost::normal_distribution<double> normal(0, 1);
+  boost::variate_generator<boost::mt19937 &, boost::normal_distribution<double> > initNormal(initRng, normal);
+  std::vector<Vector> startParams(nblocks, Vector(npar));
+  for (size_t b = 0; b < nblocks; b++)
+    {
+      int trial;
+      for (trial = 0; trial < 100; trial++)
+        {
+          Vector z(npar);
+          for (size_t i = 0; i < npar; i++)
+            z(i) = initNormal();
+          for (size_t i = 0; i < npar; i++)
+            {
+              startParams[b](i) = mode(i);
+              for (size_t j = 0; j <= i; j++)
+                startParams[b](i) += options.mh_init_scale*cholSigma(i, j)*z(j);
+            }
+          if (!std::isinf(kernels[0]->compute(startParams[b])))
+            break;
+        }
+      if (trial == 100)
+        {
+          std::cerr << "Warning: chain " << b+1 << " starts at the mode" << std::endl;
+          startParams[b] = mode;
+        }
+    }
+
+  // The proposals are seeded as in logMHMCMCposterior, from the number of the chain
+  Vector jscale(npar);
+  jscale.setAll(options.mh_jscale);
+  const VectorConstView jscaleView(jscale, 0, npar);
+  const MatrixConstView SigmaView(Sigma, 0, 0, npar, npar);
+  boost::mt19937 chainSeeds;
+  std::vector<int> seeds;
+  for (size_t b = 0; b < nblocks; b++)
+    seeds.push_back((int) chainSeeds());
+
+  for (size_t i = 1; i < kernels.size(); i++)
+    delete kernels[i];
+  kernels.resize(1);
+
+  std::vector<double> acceptance(nblocks, 0.0);
+  std::vector<Vector> posteriorMean(nblocks, Vector(npar));
+  std::vector<std::string> errors(nblocks);
+  const size_t ndrop = (size_t) floor(options.mh_drop*nruns);
+#ifdef USE_OMP
+# pragma omp parallel for num_threads(std::min((size_t) options.threads, nblocks)) schedule(dynamic)
+#endif
+  for (int b = 0; b < (int) nblocks; b++)
+    {
+      try
+        {
+          PosteriorKernel kernel(options, epd, info, varobs, dataView, steadyState, deepParams, Q, H);
+          Proposal pdd(jscaleView, SigmaView);
+          pdd.seed(seeds[b]);
+          RandomWalkMetropolisHastings rwmh(npar, b+1, options.thinning, options.flush_interval);
+          Vector mhLogPostDens(nruns);
+          Matrix mhParams(nruns, npar);
+          VectorView mhLogPostDensView(mhLogPostDens, 0, nruns);
+          MatrixView mhParamsView(mhParams, 0, 0, nruns, npar);
+          VectorView steadyStateView(kernel.steadyState, 0, n_endo);
+          VectorView deepParamsView(kernel.deepParams, 0, kernel.deepParams.getSize());
+          MatrixView QView(kernel.Q, 0, 0, n_exo, n_exo);
+          acceptance[b] = rwmh.compute(mhLogPostDensView, mhParamsView, steadyStateView, startParams[b], deepParamsView,
+                                       dataView, QView, kernel.H, options.presample, 1, nruns, kernel.lpd, pdd, epd);
+
+          std::ostringstream filename;
+          filename << options.basename << "_mh_blck" << b+1 << ".bin";
+          MHDrawsFile drawsFile(filename.str(), npar, nruns, 1, options.flush_interval);
+          Vector draw(npar);
+          posteriorMean[b].setAll(0.0);
+          for (size_t r = 0; r < nruns; r++)
+            {
+              for (size_t i = 0; i < npar; i++)
+                draw(i) = mhParams(r, i);
+              drawsFile.add(mhLogPostDens(r), draw);
+              if (r >= ndrop)
+                for (size_t i = 0; i < npar; i++)
+                  posteriorMean[b](i) += draw(i)/(nruns-ndrop);
+            }
+          drawsFile.close();
+        }
+      catch (const std::exception &e)
+        {
+          errors[b] = e.what();
+        }
+      catch (const TSException &e)
+        {
+          errors[b] = e.getMessage();
+        }
+      catch (...)
+        {
+          errors[b] = "unknown exception";
+        }
+    }
+
+  int ret = EXIT_SUCCESS;
+  for (size_t b = 0; b < nblocks; b++)
+    if (!errors[b].empty())
+      {
+        std::cerr << "Error in chain " << b+1 << ": " << errors[b] << std::endl;
+        ret = EXIT_FAILURE;
+      }
+  if (ret == EXIT_SUCCESS)
+    {
+      std::cout << std::endl << "Acceptance rates:";
+      for (size_t b = 0; b < nblocks; b++)
+        std::cout << " " << acceptance[b];
+      std::cout << std::endl << std::endl << std::setw(20) << "parameter" << std::setw(14) << "post. mean" << std::endl;
+      for (size_t i = 0; i < npar; i++)
+        {
+          double m = 0;
+          for (size_t b = 0; b < nblocks; b++)
+            m += posteriorMean[b](i)/nblocks;
+          std::cout << std::setw(20) << names[i] << std::setw(14) << m << std::endl;
+        }
+    }
+
+  delete kernels[0];
+  for (size_t i = 0; i < npar; i++)
+    delete estParamsInfo[i].prior;
+  delete dataset;
+  return ret;
+}
+
+int
+main(int argc, char **argv)
+{
+  try
+    {
+      return estimate(argc, argv);
+    }
+  catch (const std::exception &e)
+    {
+      std::cerr << "Error: " << e.what() << std::endl;
+    }
+  catch (const TSException &e)
+    {
+      std::cerr << "Error: " << e.getMessage() << std::endl;
+    }
+  catch (const ValueNotSetException &e)
+    {
+      std::cerr << "Error: value not set: " << e.name << std::endl;
+    }
+  return EXIT_FAILURE;
+}
@@ -223,6 +223,26 @@ MarkovSwitching::get_restriction_map() throw (ValueNotSetException)
   throw ValueNotSetException("restriction_map");
 }
 
+vector<vector<double> >
+MarkovSwitching::get_transition_matrix() const
+{
+  /* A regime of expected duration d is left with probability 1/d, towards
+     the other regimes with equal probabilities. There is either one duration
+     for all the regimes or one by regime */
+  vector<vector<double> > P(number_of_regimes, vector<double>(number_of_regimes));
+  for (int i = 0; i < number_of_regimes; i++)
+    {
+      double d = duration.size() == 1 ? duration[0] : duration[i];
+      assert(d >= 1);
+      for (int j = 0; j < number_of_regimes; j++)
+        if (i == j)
+          P[i][j] = number_of_regimes == 1 ? 1 : 1 - 1/d;
+        else
+          P[i][j] = 1/d/(number_of_regimes - 1);
+    }
+  return P;
+}
+
 BasicModFilePrior::BasicModFilePrior(const int index_arg,
                                      const string shape_arg,
                                      const double mean_arg,
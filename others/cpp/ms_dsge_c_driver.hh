@@ -91,6 +91,8 @@ public:
     return duration;
   };
   restriction_map_t get_restriction_map() throw (ValueNotSetException);
+  //! Transition matrix of the chain (P[i][j] is the probability of moving from regime i to regime j) implied by the expected durations of the regimes
+  vector<vector<double> > get_transition_matrix() const;
 };
 
 class BasicModFilePrior
@@ -0,0 +1,32 @@
+// Estimation of example 1 with the standalone C++ estimation driver
+var h, c, y, k, a, b;
+varexo e, u;
+
+parameters beta, rho, alpha, delta, theta, psi, tau;
+
+alpha = 0.36;
+rho   = 0.95;
+tau   = 0.025;
+beta  = 0.99;
+delta = 0.025;
+psi   = 0;
+theta = 2.95;
+
+model(use_dll);
+c*theta*exp(h)^(1+psi)=(1-alpha)*y;
+exp(k) = beta*(((exp(b)*c)/(exp(b(+1))*c(+1)))
+    *(exp(b(+1))*alpha*y(+1)+(1-delta)*exp(k)));
+y = exp(a)*(exp(k(-1))^alpha)*(exp(h)^(1-alpha));
+exp(k) = exp(b)*(y-c)+(1-delta)*exp(k(-1));
+a = rho*a(-1)+tau*b(-1) + e;
+b = tau*a(-1)+rho*b(-1) + u;
+end;
+
+varobs y, c;
+
+alpha.prior(shape=beta, mean=0.35, stdev=0.02);
+rho.prior(shape=beta, mean=0.9, stdev=0.05);
+theta.prior(shape=gamma, mean=3, stdev=0.5);
+std(e).prior(shape=inv_gamma, mean=0.01, stdev=0.01);
+std(u).prior(shape=inv_gamma, mean=0.01, stdev=0.01);
+rho.options(init=0.95);
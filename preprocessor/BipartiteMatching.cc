@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <climits>
+#include <cassert>
+
+#include "BipartiteMatching.hh"
+
+BipartiteMatching::BipartiteMatching(int nb_left_arg, int nb_right_arg) :
+  nb_left(nb_left_arg), nb_right(nb_right_arg),
+  adj_start(nb_left_arg+1, 0),
+  left_mate(nb_left_arg, -1), right_mate(nb_right_arg, -1),
+  dist(nb_left_arg), next_edge(nb_left_arg)
+{
+}
+
+void
+BipartiteMatching::setEdges(const vector<pair<int, int> > &edges)
+{
+  // Counting sort of the edges by left vertex, keeping their order for a given left vertex
+  adj_start.assign(nb_left+1, 0);
+  for (vector<pair<int, int> >::const_iterator it = edges.begin(); it != edges.end(); it++)
+    {
+      assert(it->first >= 0 && it->first < nb_left && it->second >= 0 && it->second < nb_right);
+      adj_start[it->first+1]++;
+    }
+  for (int u = 0; u < nb_left; u++)
+    adj_start[u+1] += adj_start[u];
+  adj.resize(edges.size());
+  vector<int> pos(adj_start.begin(), adj_start.end()-1);
+  for (vector<pair<int, int> >::const_iterator it = edges.begin(); it != edges.end(); it++)
+    adj[pos[it->first]++] = it->second;
+
+  // Drop the matched pairs which are no longer edges
+  for (int u = 0; u < nb_left; u++)
+    if (left_mate[u] >= 0)
+      {
+        bool found = false;
+        for (int e = adj_start[u]; e < adj_start[u+1] && !found; e++)
+          found = adj[e] == left_mate[u];
+        if (!found)
+          {
+            right_mate[left_mate[u]] = -1;
+            left_mate[u] = -1;
+          }
+      }
+}
+
+bool
+BipartiteMatching::buildLayers()
+{
+  vector<int> queue;
+  queue.reserve(nb_left);
+  for (int u = 0; u < nb_left; u++)
+    if (left_mate[u] < 0)
+      {
+        dist[u] = 0;
+        queue.push_back(u);
+      }
+    else
+      dist[u] = INT_MAX;
+
+  bool found = false;
+  for (size_t i = 0; i < queue.size(); i++)
+    {
+      int u = queue[i];
+      for (int e = adj_start[u]; e < adj_start[u+1]; e++)
+        {
+          int w = right_mate[adj[e]];
+          if (w < 0)
+            found = true;
+          else if (dist[w] == INT_MAX)
+            {
+              dist[w] = dist[u] + 1;
+              queue.push_back(w);
+            }
+        }
+    }
+  return found;
+}
+
+bool
+BipartiteMatching::augment(int root)
+{
+  /* Depth-first search with an explicit stack of left vertices, since
+     augmenting paths can be as long as the model is big. For each vertex on
+     the stack, next_edge points to the edge leading to the next vertex */
+  vector<int> path(1, root);
+  while (!path.empty())
+    {
+      int u = path.back();
+      if (next_edge[u] == adj_start[u+1])
+        {
+          // Dead end: remove u from the layers
+          dist[u] = INT_MAX;
+          path.pop_back();
+          if (!path.empty())
+            next_edge[path.back()]++;
+          continue;
+        }
+      int w = right_mate[adj[next_edge[u]]];
+      if (w < 0)
+        {
+          // Augmenting path found: flip the edges along it
+          for (vector<int>::const_iterator it = path.begin(); it != path.end(); it++)
+            {
+              int v = adj[next_edge[*it]];
+              left_mate[*it] = v;
+              right_mate[v] = *it;
+            }
+          return true;
+        }
+      if (dist[w] == dist[u] + 1)
+        path.push_back(w);
+      else
+        next_edge[u]++;
+    }
+  return false;
+}
+
+int
+BipartiteMatching::maximize()
+{
+  while (buildLayers())
+    {
+      for (int u = 0; u < nb_left; u++)
+        next_edge[u] = adj_start[u];
+      for (int u = 0; u < nb_left; u++)
+        if (left_mate[u] < 0)
+          augment(u);
+    }
+
+  int cardinality = 0;
+  for (int u = 0; u < nb_left; u++)
+    if (left_mate[u] >= 0)
+      cardinality++;
+  return cardinality;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BIPARTITEMATCHING_HH
+#define _BIPARTITEMATCHING_HH
+
+#include <vector>
+
+using namespace std;
+
+//! Maximum cardinality matching in a bipartite graph, with the Hopcroft-Karp algorithm
+/*!
+  The graph is stored in compressed sparse row format: the neighbours of each
+  left vertex are stored contiguously. The matching is kept from one call of
+  maximize() to the next, so that when edges are added to the graph (e.g. when
+  the cutoff of the normalization is lowered), only the few missing augmenting
+  paths have to be searched.
+*/
+class BipartiteMatching
+{
+private:
+  int nb_left, nb_right;
+  //! Neighbours of left vertex u are adj[adj_start[u]] to adj[adj_start[u+1]-1]
+  vector<int> adj_start, adj;
+  //! Mates of the vertices, -1 for unmatched ones
+  vector<int> left_mate, right_mate;
+  //! Layer of the left vertices in the current phase
+  vector<int> dist;
+  //! Next neighbour to explore for each left vertex in the current phase
+  vector<int> next_edge;
+  //! Builds the layers of the alternating paths starting from the unmatched left vertices; returns true if an augmenting path exists
+  bool buildLayers();
+  //! Looks for an augmenting path starting from root within the layers, and applies it if found
+  bool augment(int root);
+public:
+  BipartiteMatching(int nb_left_arg, int nb_right_arg);
+  //! Replaces the edges of the graph, given as pairs (left vertex, right vertex)
+  /*! The matched pairs of the current matching which are still edges are kept */
+  void setEdges(const vector<pair<int, int> > &edges);
+  //! Augments the current matching until it is of maximum cardinality, and returns that cardinality
+  int maximize();
+  //! Returns the mate of a left vertex, or -1 if it is unmatched
+  inline int
+  getLeftMate(int u) const
+  {
+    return left_mate[u];
+  };
+  //! Returns the mate of a right vertex, or -1 if it is unmatched
+  inline int
+  getRightMate(int v) const
+  {
+    return right_mate[v];
+  };
+};
+
+#endif
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <map>
+
+#include "BytecodePatterns.hh"
+#include "CodeInterpreter.hh"
+
+template<class T>
+static inline void
+appendInstruction(string &signature, const T &instruction)
+{
+  signature.append(reinterpret_cast<const char *>(&instruction), sizeof(T));
+}
+
+bool
+BytecodePatterns::analyze(const string &code, string &signature, vector<unsigned int> &operands)
+{
+  const char *p = code.data(), *end = p + code.size();
+  while (p < end)
+    switch ((uint8_t) *p)
+      {
+      case FNUMEXPR:
+        {
+          // The equation is stored apart
+          FNUMEXPR_ fnumexpr;
+          memcpy(&fnumexpr, p, sizeof(fnumexpr));
+          if (fnumexpr.get_expression_type() != ModelEquation)
+            return false;
+          appendInstruction(signature, FNUMEXPR_(ModelEquation, 0));
+          p += sizeof(fnumexpr);
+        }
+        break;
+      case FLDV:
+        {
+          FLDV_ fldv;
+          memcpy(&fldv, p, sizeof(fldv));
+          if (fldv.get_type() != eEndogenous && fldv.get_type() != eExogenous
+              && fldv.get_type() != eExogenousDet && fldv.get_type() != eParameter)
+            return false;
+          operands.push_back(fldv.get_pos());
+          appendInstruction(signature, FLDV_(fldv.get_type(), 0, fldv.get_lead_lag()));
+          p += sizeof(fldv);
+        }
+        break;
+      case FLDSV:
+        {
+          FLDSV_ fldsv;
+          memcpy(&fldsv, p, sizeof(fldsv));
+          if (fldsv.get_type() != eEndogenous && fldsv.get_type() != eExogenous
+              && fldsv.get_type() != eExogenousDet && fldsv.get_type() != eParameter)
+            return false;
+          operands.push_back(fldsv.get_pos());
+          appendInstruction(signature, FLDSV_(fldsv.get_type(), 0));
+          p += sizeof(fldsv);
+        }
+        break;
+      case FLDT:
+        {
+          FLDT_ fldt;
+          memcpy(&fldt, p, sizeof(fldt));
+          operands.push_back(fldt.get_pos());
+          appendInstruction(signature, FLDT_(0));
+          p += sizeof(fldt);
+        }
+        break;
+      case FLDST:
+        {
+          FLDST_ fldst;
+          memcpy(&fldst, p, sizeof(fldst));
+          operands.push_back(fldst.get_pos());
+          appendInstruction(signature, FLDST_(0));
+          p += sizeof(fldst);
+        }
+        break;
+      case FSTPR:
+        {
+          FSTPR_ fstpr;
+          memcpy(&fstpr, p, sizeof(fstpr));
+          operands.push_back(fstpr.get_pos());
+          appendInstruction(signature, FSTPR_(0));
+          p += sizeof(fstpr);
+        }
+        break;
+      case FLDZ:
+        signature.append(p, sizeof(FLDZ_));
+        p += sizeof(FLDZ_);
+        break;
+      case FLDC:
+        // The constants are part of the structure
+        signature.append(p, sizeof(FLDC_));
+        p += sizeof(FLDC_);
+        break;
+      case FUNARY:
+        signature.append(p, sizeof(FUNARY_));
+        p += sizeof(FUNARY_);
+        break;
+      case FBINARY:
+        signature.append(p, sizeof(FBINARY_));
+        p += sizeof(FBINARY_);
+        break;
+      case FTRINARY:
+        signature.append(p, sizeof(FTRINARY_));
+        p += sizeof(FTRINARY_);
+        break;
+      default:
+        return false;
+      }
+  return true;
+}
+
+void
+BytecodePatterns::add(unsigned int equation, const string &code, unsigned int nb_instructions)
+{
+  residuals.push_back(residual_t());
+  residual_t &residual = residuals.back();
+  residual.equation = equation;
+  residual.nb_instructions = nb_instructions;
+  residual.code = code;
+  if (!analyze(code, residual.signature, residual.operands))
+    {
+      residual.signature.clear();
+      residual.operands.clear();
+    }
+}
+
+void
+BytecodePatterns::write(ostream &code_file, unsigned int &instruction_number)
+{
+  map<string, vector<unsigned int> > groups;
+  for (unsigned int i = 0; i < residuals.size(); i++)
+    if (!residuals[i].signature.empty())
+      groups[residuals[i].signature].push_back(i);
+
+  for (unsigned int i = 0; i < residuals.size(); i++)
+    {
+      const residual_t &residual = residuals[i];
+      const vector<unsigned int> *group = NULL;
+      if (!residual.signature.empty())
+        {
+          group = &groups[residual.signature];
+          if (group->size() < min_rows)
+            group = NULL;
+          else if ((*group)[0] != i)
+            // Already written with the first equation of the group
+            continue;
+        }
+      if (group != NULL)
+        {
+          unsigned int nb_rows = group->size(), nb_operands = residual.operands.size();
+          vector<unsigned int> equations(nb_rows), operands(nb_rows*nb_operands);
+          for (unsigned int r = 0; r < nb_rows; r++)
+            {
+              const residual_t &row = residuals[(*group)[r]];
+              equations[r] = row.equation;
+              for (unsigned int k = 0; k < nb_operands; k++)
+                operands[k*nb_rows+r] = row.operands[k];
+            }
+          FPATTERN_ fpattern(residual.nb_instructions, nb_rows, nb_operands);
+          fpattern.write(code_file, instruction_number, equations, operands);
+        }
+      code_file.write(residual.code.data(), residual.code.size());
+      instruction_number += residual.nb_instructions;
+    }
+  residuals.clear();
+}
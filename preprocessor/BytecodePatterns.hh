@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BYTECODEPATTERNS_HH
+#define _BYTECODEPATTERNS_HH
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//! Shares the bytecode of the structurally identical residual equations of a block
+/*!
+  Models generated with macro-processor loops (multi-country or multi-sector
+  models) contain many equations which only differ by the variables,
+  parameters and temporary terms they use. The code of each residual equation
+  is compiled apart and given to add(); write() then compares the codes in
+  which the operands of the loads and of the store of the residual have been
+  blanked out. The equations sharing the same blanked code are written as an
+  FPATTERN instruction, holding the table of their operands, followed by the
+  code of the first one: the bytecode MEX evaluates all of them at once.
+  Equations using instructions other than loads of variables, parameters,
+  constants or temporary terms and arithmetic operators (e.g. external
+  functions) are written as is.
+*/
+class BytecodePatterns
+{
+private:
+  struct residual_t
+  {
+    unsigned int equation, nb_instructions;
+    string code;
+    //! Code with the operands blanked out, empty if it can't be shared
+    string signature;
+    vector<unsigned int> operands;
+  };
+  vector<residual_t> residuals;
+  //! Computes the signature and the operands of a code, returns false if it can't be shared
+  static bool analyze(const string &code, string &signature, vector<unsigned int> &operands);
+public:
+  //! Minimal number of equations for their code to be shared
+  static const unsigned int min_rows = 2;
+  //! Adds the code of the residual of an equation (original numbering), made of nb_instructions instructions
+  void add(unsigned int equation, const string &code, unsigned int nb_instructions);
+  //! Writes the codes added so far, in the order of their first occurrence, and forgets them
+  void write(ostream &code_file, unsigned int &instruction_number);
+};
+
+#endif
@@ -27,6 +27,7 @@
 #include <fstream>
 #include <cstring>
 #include <vector>
+#include <map>
 #ifdef LINBCG
 # include "linbcg.hh"
 #endif
@@ -36,6 +37,9 @@
 # else
 #  include "mex_interface.hh"
 # endif
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <shared_cache.hh>
 #endif
 
 #include <stdint.h>
@@ -105,7 +109,18 @@ enum Tags
     FLDTEFD,      //!< Stores the result of an external function in the stack - 28 (40)
     FSTPTEFD,     //!< Loads the result of an external function from the stack- 29 (41)
     FLDTEFDD,     //!< Stores the result of an external function in the stack - 28 (42)
-    FSTPTEFDD     //!< Loads the result of an external function from the stack- 29 (43)
+    FSTPTEFDD,    //!< Loads the result of an external function from the stack- 29 (43)
+
+    FPATTERN,     //!< Applies the code which follows to the operands of several structurally identical equations - 2A (44)
+
+    /* The following superinstructions are never written in the .cod file: they are
+       created by CodeLoad when the code is loaded by the bytecode MEX */
+    FBINARYC,     //!< A binary operator whose second operand is a constant (FLDC followed by FBINARY) - 2B (45)
+    FBINARYT,     //!< A binary operator whose second operand is a temporary term - dynamic context (FLDT followed by FBINARY) - 2C (46)
+    FBINARYST,    //!< A binary operator whose second operand is a temporary term - static context (FLDST followed by FBINARY) - 2D (47)
+    FLDY,         //!< Loads an endogenous variable, at a precomputed offset from the current period - dynamic context (resolved FLDV) - 2E (48)
+    FLDX,         //!< Loads an exogenous variable, at a precomputed offset from the current period - dynamic context (resolved FLDV) - 2F (49)
+    FLDXD         //!< Loads an exogenous deterministic variable, at a precomputed offset from the current period - dynamic context (resolved FLDV) - 30 (50)
 
   };
 
@@ -793,6 +808,148 @@ public:
   };
 };
 
+/* The superinstructions FBINARYC_, FBINARYT_ and FBINARYST_ store the operator
+   type at the same place as FBINARY_, so that they can be read as FBINARY_ */
+class FBINARYC_ : public TagWithTwoArguments<uint8_t, double>
+{
+public:
+  inline
+  FBINARYC_() : TagWithTwoArguments<uint8_t, double>::TagWithTwoArguments(FBINARYC)
+  {
+  };
+  inline
+  FBINARYC_(const int op_type_arg, const double value_arg) : TagWithTwoArguments<uint8_t, double>::TagWithTwoArguments(FBINARYC, op_type_arg, value_arg)
+  {
+  };
+  inline uint8_t
+  get_op_type()
+  {
+    return arg1;
+  };
+  inline double
+  get_value()
+  {
+    return arg2;
+  };
+};
+
+class FBINARYT_ : public TagWithTwoArguments<uint8_t, unsigned int>
+{
+public:
+  inline
+  FBINARYT_() : TagWithTwoArguments<uint8_t, unsigned int>::TagWithTwoArguments(FBINARYT)
+  {
+  };
+  inline
+  FBINARYT_(const int op_type_arg, const unsigned int pos_arg) : TagWithTwoArguments<uint8_t, unsigned int>::TagWithTwoArguments(FBINARYT, op_type_arg, pos_arg)
+  {
+  };
+  inline uint8_t
+  get_op_type()
+  {
+    return arg1;
+  };
+  inline unsigned int
+  get_pos()
+  {
+    return arg2;
+  };
+};
+
+class FBINARYST_ : public TagWithTwoArguments<uint8_t, unsigned int>
+{
+public:
+  inline
+  FBINARYST_() : TagWithTwoArguments<uint8_t, unsigned int>::TagWithTwoArguments(FBINARYST)
+  {
+  };
+  inline
+  FBINARYST_(const int op_type_arg, const unsigned int pos_arg) : TagWithTwoArguments<uint8_t, unsigned int>::TagWithTwoArguments(FBINARYST, op_type_arg, pos_arg)
+  {
+  };
+  inline uint8_t
+  get_op_type()
+  {
+    return arg1;
+  };
+  inline unsigned int
+  get_pos()
+  {
+    return arg2;
+  };
+};
+
+/* The instructions FLDY_, FLDX_ and FLDXD_ store the offset of the variable
+   from the current period in the array, together with the index of the variable */
+class FLDY_ : public TagWithTwoArguments<int, unsigned int>
+{
+public:
+  inline
+  FLDY_() : TagWithTwoArguments<int, unsigned int>::TagWithTwoArguments(FLDY)
+  {
+  };
+  inline
+  FLDY_(const int offset_arg, const unsigned int pos_arg) : TagWithTwoArguments<int, unsigned int>::TagWithTwoArguments(FLDY, offset_arg, pos_arg)
+  {
+  };
+  inline int
+  get_offset()
+  {
+    return arg1;
+  };
+  inline unsigned int
+  get_pos()
+  {
+    return arg2;
+  };
+};
+
+class FLDX_ : public TagWithTwoArguments<int, unsigned int>
+{
+public:
+  inline
+  FLDX_() : TagWithTwoArguments<int, unsigned int>::TagWithTwoArguments(FLDX)
+  {
+  };
+  inline
+  FLDX_(const int offset_arg, const unsigned int pos_arg) : TagWithTwoArguments<int, unsigned int>::TagWithTwoArguments(FLDX, offset_arg, pos_arg)
+  {
+  };
+  inline int
+  get_offset()
+  {
+    return arg1;
+  };
+  inline unsigned int
+  get_pos()
+  {
+    return arg2;
+  };
+};
+
+class FLDXD_ : public TagWithTwoArguments<int, unsigned int>
+{
+public:
+  inline
+  FLDXD_() : TagWithTwoArguments<int, unsigned int>::TagWithTwoArguments(FLDXD)
+  {
+  };
+  inline
+  FLDXD_(const int offset_arg, const unsigned int pos_arg) : TagWithTwoArguments<int, unsigned int>::TagWithTwoArguments(FLDXD, offset_arg, pos_arg)
+  {
+  };
+  inline int
+  get_offset()
+  {
+    return arg1;
+  };
+  inline unsigned int
+  get_pos()
+  {
+    return arg2;
+  };
+};
+
 class FTRINARY_ : public TagWithOneArgument<uint8_t>
 {
 public:
@@ -1421,6 +1578,8 @@ private:
   vector<unsigned int> other_endogenous;
   vector<unsigned int> exogenous;
   vector<unsigned int> det_exogenous;
+  //! Blocks containing endogenous variables used in this block
+  vector<unsigned int> dependencies;
   bool is_linear;
   vector<Block_contain_type> Block_Contain_;
   int endo_nbr;
@@ -1554,6 +1713,16 @@ public:
   {
     return exogenous;
   }
+  inline vector<unsigned int>
+  get_dependencies()
+  {
+    return dependencies;
+  }
+  inline void
+  set_dependencies(const vector<unsigned int> &dependencies_arg)
+  {
+    dependencies = dependencies_arg;
+  }
   inline void
   write(ostream &CompileCode, unsigned int &instruction_number)
   {
@@ -1588,6 +1757,10 @@ public:
       CompileCode.write(reinterpret_cast<char *>(&exogenous[i]), sizeof(exogenous[0]));
     for (unsigned int i = 0; i < other_endo_size; i++)
       CompileCode.write(reinterpret_cast<char *>(&other_endogenous[i]), sizeof(other_endogenous[0]));
+    unsigned int nb_dependencies = dependencies.size();
+    CompileCode.write(reinterpret_cast<char *>(&nb_dependencies), sizeof(nb_dependencies));
+    for (unsigned int i = 0; i < nb_dependencies; i++)
+      CompileCode.write(reinterpret_cast<char *>(&dependencies[i]), sizeof(dependencies[0]));
     instruction_number++;
   };
 #ifdef BYTE_CODE
@@ -1640,11 +1813,90 @@ public:
         memcpy(&tmp_i, code, sizeof(tmp_i)); code += sizeof(tmp_i);
         other_endogenous.push_back(tmp_i);
       }
+    unsigned int nb_dependencies;
+    memcpy(&nb_dependencies, code, sizeof(nb_dependencies)); code += sizeof(nb_dependencies);
+    for (unsigned int i = 0; i < nb_dependencies; i++)
+      {
+        unsigned int tmp_i;
+        memcpy(&tmp_i, code, sizeof(tmp_i)); code += sizeof(tmp_i);
+        dependencies.push_back(tmp_i);
+      }
     return code;
   };
 #endif
 };
 
+/* Code shared by structurally identical equations (e.g. the equations of the
+   different countries of a multi-country model), written by BytecodePatterns.
+   The instruction is followed by the code of one of the equations (its body,
+   made of nb_instructions instructions), which is evaluated once for each row
+   of a table of operands. The operands are those of the instructions of the
+   body which load a variable or a temporary term, or which store the residual,
+   in the order of the body.
+   In the code, the instruction is followed by the equation of each row, then
+   by the operands, operand by operand (the values of the first operand for
+   all the rows, then those of the second operand...): the accessors to these
+   tables are only valid on an instruction loaded in place in the code. */
+class FPATTERN_
+{
+private:
+  uint8_t op_code;
+  unsigned int nb_instructions, nb_rows, nb_operands;
+public:
+  inline
+  FPATTERN_(unsigned int nb_instructions_arg, unsigned int nb_rows_arg, unsigned int nb_operands_arg) :
+    op_code(FPATTERN), nb_instructions(nb_instructions_arg), nb_rows(nb_rows_arg), nb_operands(nb_operands_arg)
+  {
+  };
+  inline unsigned int
+  get_nb_instructions()
+  {
+    return nb_instructions;
+  };
+  inline void
+  set_nb_instructions(unsigned int nb_instructions_arg)
+  {
+    nb_instructions = nb_instructions_arg;
+  };
+  inline unsigned int
+  get_nb_rows()
+  {
+    return nb_rows;
+  };
+  inline unsigned int
+  get_nb_operands()
+  {
+    return nb_operands;
+  };
+  //! Size of the instruction in the code, tables included
+  inline size_t
+  get_size()
+  {
+    return sizeof(FPATTERN_) + nb_rows*(nb_operands+1)*sizeof(unsigned int);
+  };
+  //! Original equation number of each row
+  inline unsigned int *
+  get_equations()
+  {
+    return reinterpret_cast<unsigned int *>(this + 1);
+  };
+  //! Values of the operand k for all the rows
+  inline unsigned int *
+  get_operands(unsigned int k)
+  {
+    return get_equations() + (k+1)*nb_rows;
+  };
+  inline void
+  write(ostream &CompileCode, unsigned int &instruction_number, const vector<unsigned int> &equations, const vector<unsigned int> &operands)
+  {
+    CompileCode.write(reinterpret_cast<char *>(this), sizeof(FPATTERN_));
+    CompileCode.write(reinterpret_cast<const char *>(&equations[0]), nb_rows*sizeof(unsigned int));
+    if (nb_operands > 0)
+      CompileCode.write(reinterpret_cast<const char *>(&operands[0]), nb_rows*nb_operands*sizeof(unsigned int));
+    instruction_number++;
+  };
+};
+
 #ifdef BYTE_CODE
 typedef vector<pair<Tags, void * > > tags_liste_t;
 class CodeLoad
@@ -1653,16 +1905,301 @@ private:
   uint8_t *code;
   unsigned int nb_blocks;
   vector<size_t> begin_block;
+
+  //! Code of a file, as loaded and optimized by get_op_code()
+  struct cached_code_t
+  {
+    //! Stamp of the file (see SharedCache::fileStamp())
+    string stamp;
+    vector<uint8_t> buffer;
+    //! Instructions, as offsets in the code
+    vector<pair<Tags, size_t> > instructions;
+    unsigned int nb_blocks;
+    vector<size_t> begin_block;
+    //! If the code comes from the node-local shared cache, its mapping (buffer is then empty)
+    SharedCache::Artefact *shared;
+    const uint8_t *shared_code;
+    size_t shared_code_size;
+    cached_code_t() : shared(NULL), shared_code(NULL), shared_code_size(0)
+    {
+    };
+    const uint8_t *
+    code_begin() const
+    {
+      return shared ? shared_code : &buffer[0];
+    };
+    size_t
+    code_size() const
+    {
+      return shared ? shared_code_size : buffer.size();
+    };
+  };
+
+  /*! The code of a file in the node-local shared cache (see shared_cache.hh) is stored as
+    a sequence of 64-bit words: the number of blocks, the number of blocks followed by
+    their first instructions, the number of instructions followed by their tags and
+    offsets, and the size of the code followed by the code itself (padded to a whole
+    number of words) */
+  static inline void
+  serialize_code(const cached_code_t &c, vector<uint64_t> &words)
+  {
+    words.clear();
+    words.push_back(c.nb_blocks);
+    words.push_back(c.begin_block.size());
+    words.insert(words.end(), c.begin_block.begin(), c.begin_block.end());
+    words.push_back(c.instructions.size());
+    for (vector<pair<Tags, size_t> >::const_iterator it = c.instructions.begin(); it != c.instructions.end(); it++)
+      {
+        words.push_back(it->first);
+        words.push_back(it->second);
+      }
+    words.push_back(c.buffer.size());
+    size_t start = words.size();
+    words.resize(start + (c.buffer.size() + sizeof(uint64_t) - 1)/sizeof(uint64_t), 0);
+    memcpy(&words[start], &c.buffer[0], c.buffer.size());
+  };
+
+  //! Reads the code of a file from the shared cache, the code itself is used in place
+  static inline bool
+  deserialize_code(SharedCache::Artefact *artefact, cached_code_t &c)
+  {
+    const uint64_t *p = (const uint64_t *) artefact->data();
+    const uint64_t *end = p + artefact->size()/sizeof(uint64_t);
+    if (end - p < 2 || (uint64_t) (end - p - 2) < p[1])
+      return false;
+    c.nb_blocks = (unsigned int) *p++;
+    size_t n = (size_t) *p++;
+    c.begin_block.assign(p, p + n);
+    p += n;
+    if (end - p < 1 || (uint64_t) (end - p - 1)/2 < *p)
+      return false;
+    n = (size_t) *p++;
+    c.instructions.resize(n);
+    for (size_t i = 0; i < n; i++, p += 2)
+      c.instructions[i] = make_pair((Tags) p[0], (size_t) p[1]);
+    if (end - p < 1 || (uint64_t) (end - p - 1)*sizeof(uint64_t) < *p)
+      return false;
+    c.shared_code_size = (size_t) *p++;
+    c.shared_code = (const uint8_t *) p;
+    c.buffer.clear();
+    c.shared = artefact;
+    return true;
+  };
+
+  //! Copies a code of the cache into a new buffer, which becomes the current code
+  inline tags_liste_t
+  load_cached_code(const cached_code_t &c)
+  {
+    tags_liste_t tags_liste;
+    code = (uint8_t *) mxMalloc(c.code_size());
+    memcpy(code, c.code_begin(), c.code_size());
+    for (vector<pair<Tags, size_t> >::const_iterator it = c.instructions.begin();
+         it != c.instructions.end(); it++)
+      tags_liste.push_back(make_pair(it->first, code + it->second));
+    nb_blocks = c.nb_blocks;
+    begin_block = c.begin_block;
+    return tags_liste;
+  };
+
+  //! Codes already loaded by the current process, indexed by file name
+  /*! The MEX is usually called many times on the same model (e.g. in extended path or
+    Monte Carlo loops): the code is then copied from this cache rather than read and
+    parsed again, as long as the stamp of the file (size, modification time, inode and
+    checksum of the contents) is unchanged */
+  static inline map<string, cached_code_t> &
+  code_cache()
+  {
+    static map<string, cached_code_t> cache;
+    return cache;
+  };
+
+  //! Element of the code being optimized by optimize_code()
+  struct optimized_tag
+  {
+    Tags tag;
+    void *instruction;
+    //! Index of the first instruction of the original code merged in this element
+    size_t first;
+  };
+
+  //! Can a binary operator applied to two constants be computed when loading the code?
+  /*! Only operators whose result is computed by the interpreter without error checking
+    are considered: the computation is therefore exactly the same */
+  static inline bool
+  foldable(int op, double v1, double v2, double &result)
+  {
+    switch (op)
+      {
+      case oPlus:
+        result = v1 + v2;
+        break;
+      case oMinus:
+        result = v1 - v2;
+        break;
+      case oTimes:
+        result = v1 * v2;
+        break;
+      default:
+        return false;
+      }
+    return true;
+  };
+
+  //! Peephole optimizer, applied to the code once it is loaded
+  /*! Folds the operations on constants (FLDC FLDC FBINARY and FLDC FUNARY(-)),
+    and fuses a load of a constant or of a temporary term followed by a binary
+    operator into a superinstruction, in order to reduce the number of
+    instructions dispatched by the interpreter.
+    Instructions which are the target of a jump, the beginning of a block, or
+    the first instruction after the body of an FPATTERN, are never merged with
+    the previous instructions, and the jumps, the lengths of the bodies and the
+    block positions are updated accordingly.
+    The new instructions are written in place in the code buffer: they are never
+    larger than the sequence of instructions they replace, which are contiguous. */
+  inline void
+  optimize_code(tags_liste_t &tags_liste)
+  {
+    size_t n = tags_liste.size();
+    vector<bool> is_target(n + 1, false);
+    for (size_t i = 0; i < n; i++)
+      if (tags_liste[i].first == FJMPIFEVAL)
+        is_target[min(n, i + ((FJMPIFEVAL_ *) tags_liste[i].second)->get_pos() + 1)] = true;
+      else if (tags_liste[i].first == FJMP)
+        is_target[min(n, i + ((FJMP_ *) tags_liste[i].second)->get_pos() + 1)] = true;
+      else if (tags_liste[i].first == FPATTERN)
+        is_target[min(n, i + ((FPATTERN_ *) tags_liste[i].second)->get_nb_instructions() + 1)] = true;
+    for (vector<size_t>::const_iterator it = begin_block.begin(); it != begin_block.end(); it++)
+      is_target[*it] = true;
+
+    vector<optimized_tag> out;
+    for (size_t i = 0; i < n; i++)
+      {
+        optimized_tag ot;
+        ot.tag = tags_liste[i].first;
+        ot.instruction = tags_liste[i].second;
+        ot.first = i;
+        size_t m = out.size();
+        // The last element of out and the current instruction can be merged
+        bool mergeable = !is_target[i] && m >= 1;
+        // The last two elements of out and the current instruction can be merged
+        bool mergeable2 = mergeable && m >= 2 && !is_target[out[m-1].first];
+        double result;
+        if (ot.tag == FBINARY && mergeable2 && out[m-1].tag == FLDC && out[m-2].tag == FLDC
+            && foldable(((FBINARY_ *) ot.instruction)->get_op_type(),
+                        ((FLDC_ *) out[m-2].instruction)->get_value(),
+                        ((FLDC_ *) out[m-1].instruction)->get_value(), result))
+          {
+            out.pop_back();
+            *((FLDC_ *) out.back().instruction) = FLDC_(result);
+            continue;
+          }
+        if (ot.tag == FUNARY && mergeable && out[m-1].tag == FLDC
+            && ((FUNARY_ *) ot.instruction)->get_op_type() == oUminus)
+          {
+            *((FLDC_ *) out.back().instruction) = FLDC_(-((FLDC_ *) out[m-1].instruction)->get_value());
+            continue;
+          }
+        if (ot.tag == FBINARY && mergeable)
+          {
+            int op = ((FBINARY_ *) ot.instruction)->get_op_type();
+            switch (out[m-1].tag)
+              {
+              case FLDC:
+                out.back().tag = FBINARYC;
+                *((FBINARYC_ *) out.back().instruction) = FBINARYC_(op, ((FLDC_ *) out[m-1].instruction)->get_value());
+                continue;
+              case FLDT:
+                out.back().tag = FBINARYT;
+                *((FBINARYT_ *) out.back().instruction) = FBINARYT_(op, ((FLDT_ *) out[m-1].instruction)->get_pos());
+                continue;
+              case FLDST:
+                out.back().tag = FBINARYST;
+                *((FBINARYST_ *) out.back().instruction) = FBINARYST_(op, ((FLDST_ *) out[m-1].instruction)->get_pos());
+                continue;
+              default:
+                break;
+              }
+          }
+        out.push_back(ot);
+      }
+
+    if (out.size() == n)
+      return;
+
+    // New position of each instruction which begins an element
+    vector<size_t> new_pos(n + 1, 0);
+    for (size_t j = 0; j < out.size(); j++)
+      new_pos[out[j].first] = j;
+    new_pos[n] = out.size();
+
+    tags_liste.clear();
+    for (size_t j = 0; j < out.size(); j++)
+      {
+        size_t i = out[j].first;
+        if (out[j].tag == FJMPIFEVAL)
+          {
+            size_t target = min(n, i + ((FJMPIFEVAL_ *) out[j].instruction)->get_pos() + 1);
+            *((FJMPIFEVAL_ *) out[j].instruction) = FJMPIFEVAL_(new_pos[target] - j - 1);
+          }
+        else if (out[j].tag == FJMP)
+          {
+            size_t target = min(n, i + ((FJMP_ *) out[j].instruction)->get_pos() + 1);
+            *((FJMP_ *) out[j].instruction) = FJMP_(new_pos[target] - j - 1);
+          }
+        else if (out[j].tag == FPATTERN)
+          {
+            size_t target = min(n, i + ((FPATTERN_ *) out[j].instruction)->get_nb_instructions() + 1);
+            ((FPATTERN_ *) out[j].instruction)->set_nb_instructions(new_pos[target] - j - 1);
+          }
+        tags_liste.push_back(make_pair(out[j].tag, out[j].instruction));
+      }
+    for (vector<size_t>::iterator it = begin_block.begin(); it != begin_block.end(); it++)
+      *it = new_pos[*it];
+  };
 public:
 
   inline unsigned int
-  get_block_number()
+  get_block_number() const
   {
     return nb_blocks;
   };
 
+  //! Resolves the loads of dynamic variables once the dimensions of the arrays are known
+  /*! Each FLDV of an endogenous or exogenous variable is replaced in place by a FLDY,
+    FLDX or FLDXD instruction storing the offset of the variable from the current
+    period, so that the interpreter does not have to decode the type of the variable
+    nor to recompute its position at each evaluation */
+  inline void
+  resolve_variables(tags_liste_t &tags_liste, int y_size, int nb_row_x, int nb_row_xd)
+  {
+    for (tags_liste_t::iterator it = tags_liste.begin(); it != tags_liste.end(); it++)
+      if (it->first == FLDV)
+        {
+          FLDV_ *fldv = (FLDV_ *) it->second;
+          int var = fldv->get_pos();
+          int lag = fldv->get_lead_lag();
+          switch (fldv->get_type())
+            {
+            case eEndogenous:
+              it->first = FLDY;
+              *((FLDY_ *) fldv) = FLDY_(lag*y_size+var, var);
+              break;
+            case eExogenous:
+              it->first = FLDX;
+              *((FLDX_ *) fldv) = FLDX_(lag+var*nb_row_x, var);
+              break;
+            case eExogenousDet:
+              it->first = FLDXD;
+              *((FLDXD_ *) fldv) = FLDXD_(lag+var*nb_row_xd, var);
+              break;
+            default:
+              break;
+            }
+        }
+  };
+
   size_t inline
-  get_begin_block(int block)
+  get_begin_block(int block) const
   {
     return begin_block[block];
   }
@@ -1675,9 +2212,37 @@ public:
   get_op_code(string file_name)
   {
     tags_liste_t tags_liste;
+    string cod_file_name = file_name + ".cod";
+    string stamp = SharedCache::fileStamp(cod_file_name);
+    if (stamp.empty())
+      return tags_liste;
+    map<string, cached_code_t>::const_iterator cached = code_cache().find(cod_file_name);
+    if (cached != code_cache().end() && cached->second.stamp == stamp)
+      return load_cached_code(cached->second);
+
+    /* Otherwise, the code may have been loaded by another process of the node: the
+       pristine code is then mapped once for all of them */
+    string shared_key;
+    if (SharedCache::enabled())
+      shared_key = SharedCache::fileKey("bytecode", cod_file_name);
+    if (!shared_key.empty())
+      {
+        SharedCache::Artefact *artefact = SharedCache::find(shared_key);
+        cached_code_t shared_code;
+        if (artefact != NULL && deserialize_code(artefact, shared_code))
+          {
+            cached_code_t &cache = code_cache()[cod_file_name];
+            delete cache.shared;
+            cache = shared_code;
+            cache.stamp = stamp;
+            return load_cached_code(cache);
+          }
+        delete artefact;
+      }
+
     ifstream CompiledCode;
     streamoff Code_Size;
-    CompiledCode.open((file_name + ".cod").c_str(), std::ios::in | std::ios::binary| std::ios::ate);
+    CompiledCode.open(cod_file_name.c_str(), std::ios::in | std::ios::binary| std::ios::ate);
     if (!CompiledCode.is_open())
       {
         return tags_liste;
@@ -1685,6 +2250,7 @@ public:
     Code_Size = CompiledCode.tellg();
     CompiledCode.seekg(std::ios::beg);
     code = (uint8_t *) mxMalloc(Code_Size);
+    uint8_t *code_begin = code;
     CompiledCode.seekg(0);
     CompiledCode.read(reinterpret_cast<char *>(code), Code_Size);
     CompiledCode.close();
@@ -1941,6 +2507,13 @@ public:
             tags_liste.push_back(make_pair(FJMP, code));
             code += sizeof(FJMP_);
             break;
+          case FPATTERN:
+# ifdef DEBUGL
+            mexPrintf("FPATTERN\n");
+# endif
+            tags_liste.push_back(make_pair(FPATTERN, code));
+            code += ((FPATTERN_ *) code)->get_size();
+            break;
           case FCALL:
             {
 # ifdef DEBUGL
@@ -2019,6 +2592,24 @@ public:
           }
         instruction++;
       }
+    optimize_code(tags_liste);
+
+    cached_code_t &cache = code_cache()[cod_file_name];
+    delete cache.shared;
+    cache.shared = NULL;
+    cache.stamp = stamp;
+    cache.buffer.assign(code_begin, code_begin + Code_Size);
+    cache.instructions.clear();
+    for (tags_liste_t::const_iterator it = tags_liste.begin(); it != tags_liste.end(); it++)
+      cache.instructions.push_back(make_pair(it->first, (size_t) ((uint8_t *) it->second - code_begin)));
+    cache.nb_blocks = nb_blocks;
+    cache.begin_block = begin_block;
+    if (!shared_key.empty())
+      {
+        vector<uint64_t> words;
+        serialize_code(cache, words);
+        SharedCache::publish(shared_key, &words[0], words.size()*sizeof(uint64_t));
+      }
     return tags_liste;
   };
 };
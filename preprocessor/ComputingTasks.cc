@@ -793,7 +793,16 @@ EstimationStatement::checkPass(ModFileStructure &mod_file_struct, WarningConsoli
   // Fill in mod_file_struct.estimation_analytic_derivation
   it = options_list.num_options.find("analytic_derivation");
   if (it != options_list.num_options.end() && it->second == "1")
-    mod_file_struct.estimation_analytic_derivation = true;
+    {
+      mod_file_struct.estimation_analytic_derivation = true;
+      /* The analytic Hessian of the likelihood (see dsge_likelihood.m and
+         getH.m) uses the third derivatives of the dynamic model, the second
+         derivatives of the static model, and the second derivatives w.r.t. the
+         parameters */
+      mod_file_struct.dynamic_derivs_order = max(mod_file_struct.dynamic_derivs_order, 3);
+      mod_file_struct.static_derivs_order = max(mod_file_struct.static_derivs_order, 2);
+      mod_file_struct.params_derivs_order = max(mod_file_struct.params_derivs_order, 2);
+    }
 
   it = options_list.num_options.find("dsge_var");
   if (it != options_list.num_options.end())
@@ -891,7 +900,12 @@ DynareSensitivityStatement::checkPass(ModFileStructure &mod_file_struct, Warning
   OptionsList::num_options_t::const_iterator it = options_list.num_options.find("identification");
   if (it != options_list.num_options.end()
       && it->second == "1")
-    mod_file_struct.identification_present = true;
+    {
+      mod_file_struct.identification_present = true;
+      // See IdentificationStatement::checkPass()
+      mod_file_struct.dynamic_derivs_order = max(mod_file_struct.dynamic_derivs_order, 2);
+      mod_file_struct.params_derivs_order = max(mod_file_struct.params_derivs_order, 1);
+    }
 }
 
 void
@@ -2289,6 +2303,11 @@ void
 IdentificationStatement::checkPass(ModFileStructure &mod_file_struct, WarningConsolidation &warnings)
 {
   mod_file_struct.identification_present = true;
+  /* The identification analysis is done at first order: it uses the second
+     derivatives of the dynamic model and the first derivatives w.r.t. the
+     parameters (see getJJ.m and getH.m) */
+  mod_file_struct.dynamic_derivs_order = max(mod_file_struct.dynamic_derivs_order, 2);
+  mod_file_struct.params_derivs_order = max(mod_file_struct.params_derivs_order, 1);
 }
 
 void
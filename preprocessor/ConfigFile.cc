@@ -53,11 +53,11 @@ Path::Path(vector<string> &includepath_arg)
 SlaveNode::SlaveNode(string &computerName_arg, string port_arg, int minCpuNbr_arg, int maxCpuNbr_arg, string &userName_arg,
                      string &password_arg, string &remoteDrive_arg, string &remoteDirectory_arg,
                      string &dynarePath_arg, string &matlabOctavePath_arg, bool singleCompThread_arg, int numberOfThreadsPerJob_arg,
-                     string &operatingSystem_arg) :
-  computerName(computerName_arg), port(port_arg), minCpuNbr(minCpuNbr_arg), maxCpuNbr(maxCpuNbr_arg), userName(userName_arg),
+                     string &operatingSystem_arg, int threads_arg, string &affinity_arg) :
+  computerName(computerName_arg.empty() && threads_arg > 0 ? string("localhost") : computerName_arg), port(port_arg), minCpuNbr(minCpuNbr_arg), maxCpuNbr(maxCpuNbr_arg), userName(userName_arg),
   password(password_arg), remoteDrive(remoteDrive_arg), remoteDirectory(remoteDirectory_arg), dynarePath(dynarePath_arg),
   matlabOctavePath(matlabOctavePath_arg), singleCompThread(singleCompThread_arg), numberOfThreadsPerJob(numberOfThreadsPerJob_arg),
-  operatingSystem(operatingSystem_arg)
+  operatingSystem(operatingSystem_arg), threads(threads_arg), affinity(affinity_arg)
 {
   if (computerName.empty())
     {
@@ -71,16 +71,34 @@ SlaveNode::SlaveNode(string &computerName_arg, string port_arg, int minCpuNbr_ar
         cerr << "ERROR: The OperatingSystem must be either 'unix' or 'windows' (Case Sensitive)." << endl;
         exit(EXIT_FAILURE);
       }
+
+  if (!affinity.empty())
+    if (threads == 0)
+      {
+        cerr << "ERROR: The Affinity option may only be passed to a node with the Threads option." << endl;
+        exit(EXIT_FAILURE);
+      }
+    else if (affinity.compare("none") != 0 && affinity.compare("compact") != 0 && affinity.compare("scatter") != 0)
+      {
+        cerr << "ERROR: The Affinity must be either 'none', 'compact' or 'scatter' (Case Sensitive)." << endl;
+        exit(EXIT_FAILURE);
+      }
 }
 
-Cluster::Cluster(member_nodes_t  member_nodes_arg) :
-  member_nodes(member_nodes_arg)
+Cluster::Cluster(member_nodes_t  member_nodes_arg, string &balancing_arg) :
+  member_nodes(member_nodes_arg), balancing(balancing_arg.empty() ? string("static") : balancing_arg)
 {
   if (member_nodes.empty())
     {
       cerr << "ERROR: The cluster must have at least one member node." << endl;
       exit(EXIT_FAILURE);
     }
+
+  if (balancing.compare("static") != 0 && balancing.compare("measured") != 0)
+    {
+      cerr << "ERROR: The Balancing must be either 'static' or 'measured' (Case Sensitive)." << endl;
+      exit(EXIT_FAILURE);
+    }
 }
 
 ConfigFile::ConfigFile(bool parallel_arg, bool parallel_test_arg,
@@ -160,10 +178,11 @@ ConfigFile::getConfigFileInfo(const string &config_file)
 
   string name, computerName, port, userName, password, remoteDrive,
     remoteDirectory, dynarePath, matlabOctavePath, operatingSystem,
-    global_init_file;
+    global_init_file, affinity, balancing;
   vector<string> includepath;
   int minCpuNbr = 0, maxCpuNbr = 0;
   int numberOfThreadsPerJob = 1;
+  int threads = 0;
   bool singleCompThread = false;
   member_nodes_t member_nodes;
 
@@ -196,7 +215,7 @@ ConfigFile::getConfigFileInfo(const string &config_file)
                                        computerName, port, minCpuNbr, maxCpuNbr, userName,
                                        password, remoteDrive, remoteDirectory,
                                        dynarePath, matlabOctavePath, singleCompThread, numberOfThreadsPerJob,
-                                       operatingSystem);
+                                       operatingSystem, threads, affinity, balancing);
 
           //! Reset communication vars / option defaults
           if (!line.compare("[hooks]"))
@@ -230,10 +249,11 @@ ConfigFile::getConfigFileInfo(const string &config_file)
 
           name = userName = computerName = port = password = remoteDrive
             = remoteDirectory = dynarePath = matlabOctavePath
-            = operatingSystem = global_init_file = "";
+            = operatingSystem = global_init_file = affinity = balancing = "";
           includepath.clear();
           minCpuNbr = maxCpuNbr = 0;
           numberOfThreadsPerJob = 1;
+          threads = 0;
           singleCompThread = false;
           member_nodes.clear();
         }
@@ -353,6 +373,27 @@ ConfigFile::getConfigFileInfo(const string &config_file)
               matlabOctavePath = tokenizedLine.back();
             else if (!tokenizedLine.front().compare("NumberOfThreadsPerJob"))
               numberOfThreadsPerJob = atoi(tokenizedLine.back().c_str());
+            else if (!tokenizedLine.front().compare("Threads"))
+              {
+                try
+                  {
+                    threads = lexical_cast< int >(tokenizedLine.back());
+                  }
+                catch (const bad_lexical_cast &)
+                  {
+                    cerr << "ERROR: Could not convert value to integer for Threads." << endl;
+                    exit(EXIT_FAILURE);
+                  }
+                if (threads <= 0)
+                  {
+                    cerr << "ERROR: The Threads option must be an integer > 0." << endl;
+                    exit(EXIT_FAILURE);
+                  }
+              }
+            else if (!tokenizedLine.front().compare("Affinity"))
+              affinity = tokenizedLine.back();
+            else if (!tokenizedLine.front().compare("Balancing"))
+              balancing = tokenizedLine.back();
             else if (!tokenizedLine.front().compare("SingleCompThread"))
               if (tokenizedLine.back().compare("true") == 0)
                 singleCompThread = true;
@@ -442,7 +483,7 @@ ConfigFile::getConfigFileInfo(const string &config_file)
                                computerName, port, minCpuNbr, maxCpuNbr, userName,
                                password, remoteDrive, remoteDirectory,
                                dynarePath, matlabOctavePath, singleCompThread, numberOfThreadsPerJob,
-                               operatingSystem);
+                               operatingSystem, threads, affinity, balancing);
 
   configFile->close();
   delete configFile;
@@ -477,11 +518,11 @@ ConfigFile::addParallelConfFileElement(bool inNode, bool inCluster, member_nodes
                                        string &name, string &computerName, string port, int minCpuNbr, int maxCpuNbr, string &userName,
                                        string &password, string &remoteDrive, string &remoteDirectory,
                                        string &dynarePath, string &matlabOctavePath, bool singleCompThread, int numberOfThreadsPerJob,
-                                       string &operatingSystem)
+                                       string &operatingSystem, int threads, string &affinity, string &balancing)
 {
   //! ADD NODE
   if (inNode)
-    if (!member_nodes.empty())
+    if (!member_nodes.empty() || !balancing.empty())
       {
         cerr << "Invalid option passed to [node]." << endl;
         exit(EXIT_FAILURE);
@@ -496,12 +537,13 @@ ConfigFile::addParallelConfFileElement(bool inNode, bool inCluster, member_nodes
         slave_nodes[name] = new SlaveNode(computerName, port, minCpuNbr, maxCpuNbr, userName,
                                           password, remoteDrive, remoteDirectory, dynarePath,
                                           matlabOctavePath, singleCompThread, numberOfThreadsPerJob,
-                                          operatingSystem);
+                                          operatingSystem, threads, affinity);
   //! ADD CLUSTER
   else if (inCluster)
     if (minCpuNbr > 0 || maxCpuNbr > 0 || !userName.empty()
         || !password.empty() || !remoteDrive.empty() || !remoteDirectory.empty()
-        || !dynarePath.empty() || !matlabOctavePath.empty() || !operatingSystem.empty())
+        || !dynarePath.empty() || !matlabOctavePath.empty() || !operatingSystem.empty()
+        || threads > 0 || !affinity.empty())
       {
         cerr << "Invalid option passed to [cluster]." << endl;
         exit(EXIT_FAILURE);
@@ -516,7 +558,7 @@ ConfigFile::addParallelConfFileElement(bool inNode, bool inCluster, member_nodes
         {
           if (clusters.empty())
             firstClusterName = name;
-          clusters[name] = new Cluster(member_nodes);
+          clusters[name] = new Cluster(member_nodes, balancing);
         }
 }
 
@@ -551,6 +593,22 @@ ConfigFile::checkPass(WarningConsolidation &warnings) const
   for (map<string, SlaveNode *>::const_iterator it = slave_nodes.begin();
        it != slave_nodes.end(); it++)
     {
+      if (it->second->isThreaded())
+        {
+          // The work is done by threads of the master process: none of the options launching slaves applies
+          if (it->second->computerName.compare("localhost") || !it->second->port.empty()
+              || it->second->minCpuNbr > 0 || it->second->maxCpuNbr > 0
+              || !it->second->userName.empty() || !it->second->password.empty()
+              || !it->second->remoteDrive.empty() || !it->second->remoteDirectory.empty()
+              || !it->second->dynarePath.empty() || !it->second->matlabOctavePath.empty()
+              || !it->second->operatingSystem.empty())
+            {
+              cerr << "ERROR (node " << it->first << "): a node with the Threads option runs within the local "
+                   << "MATLAB/Octave process, it only accepts the Name, ComputerName = localhost, Threads and Affinity options." << endl;
+              exit(EXIT_FAILURE);
+            }
+          continue;
+        }
 #if !defined(_WIN32) && !defined(__CYGWIN32__)
       //For Linux/Mac, check that cpuNbr starts at 0
       if (it->second->minCpuNbr != 0)
@@ -625,6 +683,9 @@ ConfigFile::checkPass(WarningConsolidation &warnings) const
     }
 
   //! Check Clusters
+  if (clusters.empty() && slave_nodes.size() == 1 && slave_nodes.begin()->second->isThreaded())
+    return; // A single threaded node does not need a cluster
+
   if (clusters.empty())
     {
       cerr << "ERROR: At least one cluster must be defined in the config file." << endl;
@@ -646,6 +707,36 @@ ConfigFile::checkPass(WarningConsolidation &warnings) const
           cerr << "Error: node " << itmn->first << " specified in cluster " << it->first << " was not found" << endl;
           exit(EXIT_FAILURE);
         }
+      else if (slave_nodes.find(itmn->first)->second->isThreaded() && it->second->member_nodes.size() > 1)
+        {
+          cerr << "Error: node " << itmn->first << " specified in cluster " << it->first << " has the Threads option, "
+               << "it must be the only member of the cluster" << endl;
+          exit(EXIT_FAILURE);
+        }
+}
+
+const SlaveNode *
+ConfigFile::getThreadedNode() const
+{
+  if (clusters.empty())
+    {
+      if (slave_nodes.size() == 1 && slave_nodes.begin()->second->isThreaded())
+        return slave_nodes.begin()->second;
+      return NULL;
+    }
+
+  map<string, Cluster *>::const_iterator cluster_it;
+  if (cluster_name.empty())
+    cluster_it = clusters.find(firstClusterName);
+  else
+    cluster_it = clusters.find(cluster_name);
+
+  if (cluster_it == clusters.end() || cluster_it->second->member_nodes.size() != 1)
+    return NULL;
+  map<string, SlaveNode *>::const_iterator node_it = slave_nodes.find(cluster_it->second->member_nodes.begin()->first);
+  if (node_it == slave_nodes.end() || !node_it->second->isThreaded())
+    return NULL;
+  return node_it->second;
 }
 
 void
@@ -665,6 +756,9 @@ ConfigFile::transformPass()
       }
 #endif
 
+  if (getThreadedNode() != NULL)
+    return;
+
   map<string, Cluster *>::const_iterator cluster_it;
   if (cluster_name.empty())
     cluster_it = clusters.find(firstClusterName);
@@ -712,6 +806,28 @@ ConfigFile::writeCluster(ostream &output) const
   if (!parallel && !parallel_test)
     return;
 
+  const SlaveNode *threaded_node = getThreadedNode();
+  if (threaded_node != NULL)
+    {
+      /* No slave process is launched: options_.parallel stays at 0, so that
+         the parallelized routines run in the master process, and the
+         threaded MEX files use the threads of the node */
+      output << "options_.parallel_threads = struct('Threads', " << threaded_node->threads << ", "
+             << "'Affinity', '" << (threaded_node->affinity.empty() ? "none" : threaded_node->affinity) << "');" << endl
+             << "set_dynare_threads('all', " << threaded_node->threads << ");" << endl;
+      if (!threaded_node->affinity.compare("compact"))
+        output << "setenv('OMP_PROC_BIND', 'close');" << endl
+               << "setenv('OMP_PLACES', 'cores');" << endl;
+      else if (!threaded_node->affinity.compare("scatter"))
+        output << "setenv('OMP_PROC_BIND', 'spread');" << endl
+               << "setenv('OMP_PLACES', 'cores');" << endl;
+      if (parallel_test)
+        output << "disp(['In-process parallel computations with ' num2str(options_.parallel_threads.Threads) ' threads']);" << endl
+               << "diary off;" << endl
+               << "return;" << endl;
+      return;
+    }
+
   map<string, Cluster *>::const_iterator cluster_it;
   if (cluster_name.empty())
     cluster_it = clusters.find(firstClusterName);
@@ -760,6 +876,8 @@ ConfigFile::writeCluster(ostream &output) const
         output << "'SingleCompThread', 'false');" << endl;
     }
 
+  output << "options_.parallel_info.balancing = '" << cluster_it->second->balancing << "';" << endl;
+
   if (parallel_slave_open_mode)
     output << "options_.parallel_info.leaveSlaveOpen = 1;" << endl;
 
@@ -774,7 +892,7 @@ ConfigFile::writeCluster(ostream &output) const
 void
 ConfigFile::writeEndParallel(ostream &output) const
 {
-  if ((!parallel && !parallel_test) || !parallel_slave_open_mode)
+  if ((!parallel && !parallel_test) || !parallel_slave_open_mode || getThreadedNode() != NULL)
     return;
 
   output << "if options_.parallel_info.leaveSlaveOpen == 1" << endl
@@ -66,7 +66,7 @@ public:
   SlaveNode(string &computerName_arg, string port_arg, int minCpuNbr_arg, int maxCpuNbr_arg, string &userName_arg,
             string &password_arg, string &remoteDrive_arg, string &remoteDirectory_arg,
             string &dynarePath_arg, string &matlabOctavePath_arg, bool singleCompThread_arg, int numberOfThreadsPerJob_arg,
-            string &operatingSystem_arg);
+            string &operatingSystem_arg, int threads_arg, string &affinity_arg);
   ~SlaveNode();
 
 protected:
@@ -83,17 +83,30 @@ protected:
   const bool singleCompThread;
   const int numberOfThreadsPerJob;
   const string operatingSystem;
+  //! Number of threads of an in-process node (0 for a node running MATLAB/Octave slaves)
+  const int threads;
+  //! Thread placement of an in-process node: "none", "compact" or "scatter"
+  const string affinity;
+public:
+  //! Whether the node runs its tasks with threads within the master process
+  inline bool
+  isThreaded() const
+  {
+    return threads > 0;
+  };
 };
 
 class Cluster
 {
   friend class ConfigFile;
 public:
-  Cluster(member_nodes_t member_nodes_arg);
+  Cluster(member_nodes_t member_nodes_arg, string &balancing_arg);
   ~Cluster();
 
 protected:
   member_nodes_t member_nodes;
+  //! How the jobs are split among the nodes: "static" (by NodeWeight) or "measured" (by observed throughput)
+  const string balancing;
 };
 
 //! The abstract representation of a "config" file
@@ -126,7 +139,9 @@ private:
                                   string &computerName, string port, int minCpuNbr, int maxCpuNbr, string &userName,
                                   string &password, string &remoteDrive, string &remoteDirectory,
                                   string &dynarePath, string &matlabOctavePath, bool singleCompThread, int numberOfThreadsPerJob,
-                                  string &operatingSystem);
+                                  string &operatingSystem, int threads, string &affinity, string &balancing);
+  //! Returns the threaded node selected for parallel computations, or NULL if the slaves are MATLAB/Octave processes
+  const SlaveNode *getThreadedNode() const;
 public:
   //! Parse config file
   void getConfigFileInfo(const string &parallel_config_file);
@@ -29,7 +29,9 @@ DataTree::DataTree(SymbolTable &symbol_table_arg,
   symbol_table(symbol_table_arg),
   num_constants(num_constants_arg),
   external_functions_table(external_functions_table_arg),
-  node_counter(0)
+  node_counter(0),
+  node_slab_free(NULL),
+  node_slab_left(0)
 {
   Zero = AddNonNegativeConstant("0");
   One = AddNonNegativeConstant("1");
@@ -46,8 +48,46 @@ DataTree::DataTree(SymbolTable &symbol_table_arg,
 
 DataTree::~DataTree()
 {
+  // The nodes are destroyed in place, their memory goes with the slabs
   for (node_list_t::iterator it = node_list.begin(); it != node_list.end(); it++)
-    delete *it;
+    (*it)->~ExprNode();
+  for (vector<char *>::iterator it = node_slabs.begin(); it != node_slabs.end(); it++)
+    delete[] *it;
+}
+
+void *
+DataTree::allocateNode(size_t size)
+{
+  // Keep the nodes aligned for any of their members
+  const size_t alignment = 2*sizeof(double);
+  size = (size + alignment - 1) / alignment * alignment;
+  if (size > node_slab_left)
+    {
+      if (size > node_slab_size)
+        {
+          // An oversized node gets its own slab, the current one stays
+          char *slab = new char[size];
+          node_slabs.push_back(slab);
+          return slab;
+        }
+      node_slab_free = new char[node_slab_size];
+      node_slab_left = node_slab_size;
+      node_slabs.push_back(node_slab_free);
+    }
+  void *p = node_slab_free;
+  node_slab_free += size;
+  node_slab_left -= size;
+  return p;
+}
+
+void
+DataTree::clearDerivationCaches()
+{
+  for (node_list_t::iterator it = node_list.begin(); it != node_list.end(); it++)
+    (*it)->preparedForDerivation = false;
+  // Swap with empty containers, since clear() would keep the bucket array of the hash table
+  deque<vector<int> >().swap(non_null_derivatives);
+  derivatives_cache_t().swap(derivatives_cache);
 }
 
 expr_t
@@ -59,7 +99,7 @@ DataTree::AddNonNegativeConstant(const string &value)
   if (it != num_const_node_map.end())
     return it->second;
   else
-    return new NumConstNode(*this, id);
+    return new (*this) NumConstNode(*this, id);
 }
 
 VariableNode *
@@ -69,7 +109,7 @@ DataTree::AddVariableInternal(int symb_id, int lag)
   if (it != variable_node_map.end())
     return it->second;
   else
-    return new VariableNode(*this, symb_id, lag);
+    return new (*this) VariableNode(*this, symb_id, lag);
 }
 
 bool
@@ -518,7 +558,7 @@ DataTree::AddExternalFunction(int symb_id, const vector<expr_t> &arguments)
   if (it != external_function_node_map.end())
     return it->second;
 
-  return new ExternalFunctionNode(*this, symb_id, arguments);
+  return new (*this) ExternalFunctionNode(*this, symb_id, arguments);
 }
 
 expr_t
@@ -532,7 +572,7 @@ DataTree::AddFirstDerivExternalFunction(int top_level_symb_id, const vector<expr
   if (it != first_deriv_external_function_node_map.end())
     return it->second;
 
-  return new FirstDerivExternalFunctionNode(*this, top_level_symb_id, arguments, input_index);
+  return new (*this) FirstDerivExternalFunctionNode(*this, top_level_symb_id, arguments, input_index);
 }
 
 expr_t
@@ -547,7 +587,7 @@ DataTree::AddSecondDerivExternalFunction(int top_level_symb_id, const vector<exp
   if (it != second_deriv_external_function_node_map.end())
     return it->second;
 
-  return new SecondDerivExternalFunctionNode(*this, top_level_symb_id, arguments, input_index1, input_index2);
+  return new (*this) SecondDerivExternalFunctionNode(*this, top_level_symb_id, arguments, input_index1, input_index2);
 }
 
 bool
@@ -25,10 +25,14 @@ using namespace std;
 #include <string>
 #include <map>
 #include <list>
+#include <deque>
 #include <sstream>
 #include <iomanip>
 #include <cmath>
 
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
+
 #include "SymbolTable.hh"
 #include "NumericalConstants.hh"
 #include "ExternalFunctionsTable.hh"
@@ -58,16 +62,71 @@ protected:
 
   typedef map<int, NumConstNode *> num_const_node_map_t;
   num_const_node_map_t num_const_node_map;
-  //! Pair (symbol_id, lag) used as key
-  typedef map<pair<int, int>, VariableNode *> variable_node_map_t;
+
+  /*! The tables used for sharing variable and operator nodes are hash tables, since they
+    are queried each time a node is created (in particular during derivation). The hash
+    only depends on the opcode and on the indices of the arguments (and not on their
+    addresses), so that the layout of the tables is the same from one run to another. */
+
+  //! Key for variable nodes: pair (symbol_id, lag)
+  typedef pair<int, int> variable_node_key_t;
+  //! Key for unary op nodes: Pair( Pair(arg1, UnaryOpCode), Pair( Expectation Info Set, Pair(param1_symb_id, param2_symb_id)) ))
+  typedef pair<pair<expr_t, UnaryOpcode>, pair<int, pair<int, int> > > unary_op_node_key_t;
+  //! Key for binary op nodes: Pair( Pair( Pair(arg1, arg2), order of Power Derivative), opCode)
+  typedef pair<pair<pair<expr_t, expr_t>, int>, BinaryOpcode> binary_op_node_key_t;
+  //! Key for trinary op nodes: Pair( Pair( Pair(arg1, arg2), arg3), opCode)
+  typedef pair<pair<pair<expr_t, expr_t>, expr_t>, TrinaryOpcode> trinary_op_node_key_t;
+
+  struct unary_op_node_hash
+  {
+    size_t
+    operator()(const unary_op_node_key_t &key) const
+    {
+      size_t seed = 0;
+      boost::hash_combine(seed, key.first.first->idx);
+      boost::hash_combine(seed, static_cast<int>(key.first.second));
+      boost::hash_combine(seed, key.second.first);
+      boost::hash_combine(seed, key.second.second.first);
+      boost::hash_combine(seed, key.second.second.second);
+      return seed;
+    }
+  };
+
+  struct binary_op_node_hash
+  {
+    size_t
+    operator()(const binary_op_node_key_t &key) const
+    {
+      size_t seed = 0;
+      boost::hash_combine(seed, key.first.first.first->idx);
+      boost::hash_combine(seed, key.first.first.second->idx);
+      boost::hash_combine(seed, key.first.second);
+      boost::hash_combine(seed, static_cast<int>(key.second));
+      return seed;
+    }
+  };
+
+  struct trinary_op_node_hash
+  {
+    size_t
+    operator()(const trinary_op_node_key_t &key) const
+    {
+      size_t seed = 0;
+      boost::hash_combine(seed, key.first.first.first->idx);
+      boost::hash_combine(seed, key.first.first.second->idx);
+      boost::hash_combine(seed, key.first.second->idx);
+      boost::hash_combine(seed, static_cast<int>(key.second));
+      return seed;
+    }
+  };
+
+  typedef boost::unordered_map<variable_node_key_t, VariableNode *, boost::hash<variable_node_key_t> > variable_node_map_t;
   variable_node_map_t variable_node_map;
-  //! Pair( Pair(arg1, UnaryOpCode), Pair( Expectation Info Set, Pair(param1_symb_id, param2_symb_id)) ))
-  typedef map<pair<pair<expr_t, UnaryOpcode>, pair<int, pair<int, int> > >, UnaryOpNode *> unary_op_node_map_t;
+  typedef boost::unordered_map<unary_op_node_key_t, UnaryOpNode *, unary_op_node_hash> unary_op_node_map_t;
   unary_op_node_map_t unary_op_node_map;
-  //! Pair( Pair( Pair(arg1, arg2), order of Power Derivative), opCode)
-  typedef map<pair<pair<pair<expr_t, expr_t>, int>, BinaryOpcode>, BinaryOpNode *> binary_op_node_map_t;
+  typedef boost::unordered_map<binary_op_node_key_t, BinaryOpNode *, binary_op_node_hash> binary_op_node_map_t;
   binary_op_node_map_t binary_op_node_map;
-  typedef map<pair<pair<pair<expr_t, expr_t>, expr_t>, TrinaryOpcode>, TrinaryOpNode *> trinary_op_node_map_t;
+  typedef boost::unordered_map<trinary_op_node_key_t, TrinaryOpNode *, trinary_op_node_hash> trinary_op_node_map_t;
   trinary_op_node_map_t trinary_op_node_map;
 
   // (arguments, symb_id) -> ExternalFunctionNode
@@ -91,12 +150,42 @@ protected:
   //! Internal implementation of ParamUsedWithLeadLag()
   bool ParamUsedWithLeadLagInternal() const;
 private:
-  typedef list<expr_t> node_list_t;
-  //! The list of nodes
+  typedef vector<expr_t> node_list_t;
+  //! The nodes, in the order of their creation
   node_list_t node_list;
   //! A counter for filling ExprNode's idx field
   int node_counter;
 
+  /*! The nodes are allocated one after the other in large slabs (see
+    ExprNode::operator new), which are freed at once by the destructor */
+
+  //! The slabs of the nodes
+  vector<char *> node_slabs;
+  //! The free space at the end of the last slab
+  char *node_slab_free;
+  size_t node_slab_left;
+  //! Size of a slab
+  static const size_t node_slab_size = 1 << 20;
+
+  //! Allocates the memory of a node in the slabs
+  void *allocateNode(size_t size);
+
+  /*! The derivation data of the nodes is kept in side tables indexed by
+    ExprNode::idx rather than in the nodes themselves, so that it can be freed
+    at once when the derivatives have been computed */
+
+  //! For each node, the sorted derivation IDs w.r.t. which its derivative is potentially non-null
+  /*! A deque, so that the references returned by ExprNode::getNonNullDerivatives() stay valid
+    when nodes are created */
+  deque<vector<int> > non_null_derivatives;
+  //! Cache of the first order derivatives of the nodes: (ExprNode::idx, derivation ID) -> derivative
+  typedef boost::unordered_map<pair<int, int>, expr_t, boost::hash<pair<int, int> > > derivatives_cache_t;
+  derivatives_cache_t derivatives_cache;
+
+  //! Returns the set of potentially non-null derivation IDs of a node, creating an empty one if needed
+  inline vector<int> &nonNullDerivatives(int idx);
+
+protected:
   inline expr_t AddPossiblyNegativeConstant(double val);
   inline expr_t AddUnaryOp(UnaryOpcode op_code, expr_t arg, int arg_exp_info_set = 0, int param1_symb_id = 0, int param2_symb_id = 0);
   inline expr_t AddBinaryOp(expr_t arg1, BinaryOpcode op_code, expr_t arg2, int powerDerivOrder = 0);
@@ -107,6 +196,10 @@ public:
   virtual
   ~DataTree();
 
+  //! Frees the derivation data of all the nodes
+  /*! To be called once the derivatives have been computed; they are recomputed if needed again */
+  void clearDerivationCaches();
+
   //! Some predefined constants
   expr_t Zero, One, Two, MinusOne, NaN, Infinity, MinusInfinity, Pi;
 
@@ -219,6 +312,12 @@ public:
   expr_t AddFirstDerivExternalFunction(int top_level_symb_id, const vector<expr_t> &arguments, int input_index);
   //! Adds an external function node for the second derivative of an external function
   expr_t AddSecondDerivExternalFunction(int top_level_symb_id, const vector<expr_t> &arguments, int input_index1, int input_index2);
+  //! Returns the number of nodes created so far in the data tree
+  int
+  node_number() const
+  {
+    return node_counter;
+  };
   //! Checks if a given symbol is used somewhere in the data tree
   bool isSymbolUsed(int symb_id) const;
   //! Checks if a given unary op is used somewhere in the data tree
@@ -327,7 +426,7 @@ DataTree::AddUnaryOp(UnaryOpcode op_code, expr_t arg, int arg_exp_info_set, int
         {
         }
     }
-  return new UnaryOpNode(*this, op_code, arg, arg_exp_info_set, param1_symb_id, param2_symb_id);
+  return new (*this) UnaryOpNode(*this, op_code, arg, arg_exp_info_set, param1_symb_id, param2_symb_id);
 }
 
 inline expr_t
@@ -348,7 +447,7 @@ DataTree::AddBinaryOp(expr_t arg1, BinaryOpcode op_code, expr_t arg2, int powerD
   catch (ExprNode::EvalException &e)
     {
     }
-  return new BinaryOpNode(*this, arg1, op_code, arg2, powerDerivOrder);
+  return new (*this) BinaryOpNode(*this, arg1, op_code, arg2, powerDerivOrder);
 }
 
 inline expr_t
@@ -370,7 +469,15 @@ DataTree::AddTrinaryOp(expr_t arg1, TrinaryOpcode op_code, expr_t arg2, expr_t a
   catch (ExprNode::EvalException &e)
     {
     }
-  return new TrinaryOpNode(*this, arg1, op_code, arg2, arg3);
+  return new (*this) TrinaryOpNode(*this, arg1, op_code, arg2, arg3);
+}
+
+inline vector<int> &
+DataTree::nonNullDerivatives(int idx)
+{
+  if (idx >= (int) non_null_derivatives.size())
+    non_null_derivatives.resize(node_counter);
+  return non_null_derivatives[idx];
 }
 
 #endif
@@ -25,7 +25,9 @@
 #include <cerrno>
 #include <algorithm>
 #include <iterator>
+#include <sstream>
 #include "DynamicModel.hh"
+#include "BytecodePatterns.hh"
 
 // For mkdir() and chdir()
 #ifdef _WIN32
@@ -36,17 +38,36 @@
 # include <sys/types.h>
 #endif
 
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
 DynamicModel::DynamicModel(SymbolTable &symbol_table_arg,
                            NumericalConstants &num_constants_arg,
                            ExternalFunctionsTable &external_functions_table_arg) :
   ModelTree(symbol_table_arg, num_constants_arg, external_functions_table_arg),
+  deriv_id_index_min_lag(0), deriv_id_index_nb_lags(0),
   max_lag(0), max_lead(0),
   max_endo_lag(0), max_endo_lead(0),
   max_exo_lag(0), max_exo_lead(0),
   max_exo_det_lag(0), max_exo_det_lead(0),
   dynJacobianColsNbr(0),
-  global_temporary_terms(true)
+  global_temporary_terms(true),
+  c_chunk_size(0),
+  sparse_jacobian(false)
+{
+}
+
+void
+DynamicModel::setCChunkSize(int c_chunk_size_arg)
+{
+  c_chunk_size = c_chunk_size_arg;
+}
+
+void
+DynamicModel::setSparseJacobian(bool sparse_jacobian_arg)
 {
+  sparse_jacobian = sparse_jacobian_arg;
 }
 
 VariableNode *
@@ -84,12 +105,8 @@ DynamicModel::compileChainRuleDerivative(ofstream &code_file, unsigned int &inst
 void
 DynamicModel::computeTemporaryTermsOrdered()
 {
-  map<expr_t, pair<int, int> > first_occurence;
-  map<expr_t, int> reference_count;
+  BlockReferenceCount reference_count(node_number());
   BinaryOpNode *eq_node;
-  first_derivatives_t::const_iterator it;
-  first_chain_rule_derivatives_t::const_iterator it_chr;
-  ostringstream tmp_s;
   v_temporary_terms.clear();
   map_idx.clear();
 
@@ -111,22 +128,22 @@ DynamicModel::computeTemporaryTermsOrdered()
           for (unsigned int i = 0; i < block_size; i++)
             {
               if (i < block_nb_recursives && isBlockEquationRenormalized(block, i))
-                getBlockEquationRenormalizedExpr(block, i)->computeTemporaryTerms(reference_count, temporary_terms, first_occurence, block, v_temporary_terms,  i);
+                getBlockEquationRenormalizedExpr(block, i)->computeTemporaryTerms(reference_count, temporary_terms, block, v_temporary_terms,  i);
               else
                 {
                   eq_node = (BinaryOpNode *) getBlockEquationExpr(block, i);
-                  eq_node->computeTemporaryTerms(reference_count, temporary_terms, first_occurence, block, v_temporary_terms,  i);
+                  eq_node->computeTemporaryTerms(reference_count, temporary_terms, block, v_temporary_terms,  i);
                 }
             }
           for (block_derivatives_equation_variable_laglead_nodeid_t::const_iterator it = blocks_derivatives[block].begin(); it != (blocks_derivatives[block]).end(); it++)
             {
               expr_t id = it->second.second;
-              id->computeTemporaryTerms(reference_count, temporary_terms, first_occurence, block, v_temporary_terms,  block_size-1);
+              id->computeTemporaryTerms(reference_count, temporary_terms, block, v_temporary_terms,  block_size-1);
             }
           for (derivative_t::const_iterator it = derivative_endo[block].begin(); it != derivative_endo[block].end(); it++)
-            it->second->computeTemporaryTerms(reference_count, temporary_terms, first_occurence, block, v_temporary_terms,  block_size-1);
+            it->second->computeTemporaryTerms(reference_count, temporary_terms, block, v_temporary_terms,  block_size-1);
           for (derivative_t::const_iterator it = derivative_other_endo[block].begin(); it != derivative_other_endo[block].end(); it++)
-            it->second->computeTemporaryTerms(reference_count, temporary_terms, first_occurence, block, v_temporary_terms,  block_size-1);
+            it->second->computeTemporaryTerms(reference_count, temporary_terms, block, v_temporary_terms,  block_size-1);
           set<int> temporary_terms_in_use;
           temporary_terms_in_use.clear();
           v_temporary_terms_inuse[block] = temporary_terms_in_use;
@@ -144,57 +161,71 @@ DynamicModel::computeTemporaryTermsOrdered()
           for (unsigned int i = 0; i < block_size; i++)
             {
               if (i < block_nb_recursives && isBlockEquationRenormalized(block, i))
-                getBlockEquationRenormalizedExpr(block, i)->computeTemporaryTerms(reference_count, temporary_terms, first_occurence, block, v_temporary_terms,  i);
+                getBlockEquationRenormalizedExpr(block, i)->computeTemporaryTerms(reference_count, temporary_terms, block, v_temporary_terms,  i);
               else
                 {
                   eq_node = (BinaryOpNode *) getBlockEquationExpr(block, i);
-                  eq_node->computeTemporaryTerms(reference_count, temporary_terms, first_occurence, block, v_temporary_terms, i);
+                  eq_node->computeTemporaryTerms(reference_count, temporary_terms, block, v_temporary_terms, i);
                 }
             }
           for (block_derivatives_equation_variable_laglead_nodeid_t::const_iterator it = blocks_derivatives[block].begin(); it != (blocks_derivatives[block]).end(); it++)
             {
               expr_t id = it->second.second;
-              id->computeTemporaryTerms(reference_count, temporary_terms, first_occurence, block, v_temporary_terms, block_size-1);
+              id->computeTemporaryTerms(reference_count, temporary_terms, block, v_temporary_terms, block_size-1);
             }
           for (derivative_t::const_iterator it = derivative_endo[block].begin(); it != derivative_endo[block].end(); it++)
-            it->second->computeTemporaryTerms(reference_count, temporary_terms, first_occurence, block, v_temporary_terms, block_size-1);
+            it->second->computeTemporaryTerms(reference_count, temporary_terms, block, v_temporary_terms, block_size-1);
           for (derivative_t::const_iterator it = derivative_other_endo[block].begin(); it != derivative_other_endo[block].end(); it++)
-            it->second->computeTemporaryTerms(reference_count, temporary_terms, first_occurence, block, v_temporary_terms, block_size-1);
+            it->second->computeTemporaryTerms(reference_count, temporary_terms, block, v_temporary_terms, block_size-1);
         }
-      for (unsigned int block = 0; block < nb_blocks; block++)
+      // Collect the temporary terms reordered
+      runBlockThreads(collectTemporaryTermsThread);
+      computeTemporaryTermsMapping();
+    }
+}
+
+void
+DynamicModel::collectBlockTemporaryTerms(unsigned int block)
+{
+  BinaryOpNode *eq_node;
+  unsigned int block_size = getBlockSize(block);
+  unsigned int block_nb_mfs = getBlockMfs(block);
+  unsigned int block_nb_recursives = block_size - block_nb_mfs;
+  set<int> temporary_terms_in_use;
+  for (unsigned int i = 0; i < block_size; i++)
+    {
+      if (i < block_nb_recursives && isBlockEquationRenormalized(block, i))
+        getBlockEquationRenormalizedExpr(block, i)->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
+      else
         {
-          // Collect the temporary terms reordered
-          unsigned int block_size = getBlockSize(block);
-          unsigned int block_nb_mfs = getBlockMfs(block);
-          unsigned int block_nb_recursives = block_size - block_nb_mfs;
-          set<int> temporary_terms_in_use;
-          for (unsigned int i = 0; i < block_size; i++)
-            {
-              if (i < block_nb_recursives && isBlockEquationRenormalized(block, i))
-                getBlockEquationRenormalizedExpr(block, i)->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
-              else
-                {
-                  eq_node = (BinaryOpNode *) getBlockEquationExpr(block, i);
-                  eq_node->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
-                }
-            }
-          for (block_derivatives_equation_variable_laglead_nodeid_t::const_iterator it = blocks_derivatives[block].begin(); it != (blocks_derivatives[block]).end(); it++)
-            {
-              expr_t id = it->second.second;
-              id->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
-            }
-          for (derivative_t::const_iterator it = derivative_endo[block].begin(); it != derivative_endo[block].end(); it++)
-            it->second->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
-          for (derivative_t::const_iterator it = derivative_other_endo[block].begin(); it != derivative_other_endo[block].end(); it++)
-            it->second->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
-          for (derivative_t::const_iterator it = derivative_exo[block].begin(); it != derivative_exo[block].end(); it++)
-            it->second->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
-          for (derivative_t::const_iterator it = derivative_exo_det[block].begin(); it != derivative_exo_det[block].end(); it++)
-            it->second->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
-          v_temporary_terms_inuse[block] = temporary_terms_in_use;
+          eq_node = (BinaryOpNode *) getBlockEquationExpr(block, i);
+          eq_node->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
         }
-      computeTemporaryTermsMapping();
     }
+  for (block_derivatives_equation_variable_laglead_nodeid_t::const_iterator it = blocks_derivatives[block].begin(); it != (blocks_derivatives[block]).end(); it++)
+    {
+      expr_t id = it->second.second;
+      id->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
+    }
+  for (derivative_t::const_iterator it = derivative_endo[block].begin(); it != derivative_endo[block].end(); it++)
+    it->second->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
+  for (derivative_t::const_iterator it = derivative_other_endo[block].begin(); it != derivative_other_endo[block].end(); it++)
+    it->second->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
+  for (derivative_t::const_iterator it = derivative_exo[block].begin(); it != derivative_exo[block].end(); it++)
+    it->second->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
+  for (derivative_t::const_iterator it = derivative_exo_det[block].begin(); it != derivative_exo_det[block].end(); it++)
+    it->second->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
+  v_temporary_terms_inuse[block] = temporary_terms_in_use;
+}
+
+void *
+DynamicModel::collectTemporaryTermsThread(void *arg)
+{
+  BlockThreadArg *barg = static_cast<BlockThreadArg *>(arg);
+  DynamicModel *model = static_cast<DynamicModel *>(barg->model);
+  for (unsigned int block = barg->first_block; block < model->getNbBlocks(); block += barg->step)
+    model->collectBlockTemporaryTerms(block);
+  return NULL;
 }
 
 void
@@ -1069,6 +1100,7 @@ DynamicModel::writeModelEquationsCode_Block(string &file_name, const string &bin
   map<expr_t, int> reference_count;
   deriv_node_temp_terms_t tef_terms;
   vector<int> feedback_variables;
+  BytecodePatterns patterns;
   bool file_open = false;
 
   string main_name = file_name;
@@ -1084,6 +1116,7 @@ DynamicModel::writeModelEquationsCode_Block(string &file_name, const string &bin
   FDIMT_ fdimt(temporary_terms.size());
   fdimt.write(code_file, instruction_number);
 
+  vector<vector<unsigned int> > block_dependencies = computeBlockDependencies();
   for (unsigned int block = 0; block < getNbBlocks(); block++)
     {
       feedback_variables.clear();
@@ -1186,6 +1219,7 @@ DynamicModel::writeModelEquationsCode_Block(string &file_name, const string &bin
                                exo,
                                other_endo
                                );
+      fbeginblock.set_dependencies(block_dependencies[block]);
       fbeginblock.write(code_file, instruction_number);
 
       // The equations
@@ -1271,20 +1305,28 @@ DynamicModel::writeModelEquationsCode_Block(string &file_name, const string &bin
               goto end;
             default:
             end:
-              FNUMEXPR_ fnumexpr(ModelEquation, getBlockEquationID(block, i));
-              fnumexpr.write(code_file, instruction_number);
-              eq_node = (BinaryOpNode *) getBlockEquationExpr(block, i);
-              lhs = eq_node->get_arg1();
-              rhs = eq_node->get_arg2();
-              lhs->compile(code_file, instruction_number, false, temporary_terms, map_idx, true, false);
-              rhs->compile(code_file, instruction_number, false, temporary_terms, map_idx, true, false);
-
-              FBINARY_ fbinary(oMinus);
-              fbinary.write(code_file, instruction_number);
-              FSTPR_ fstpr(i - block_recursive);
-              fstpr.write(code_file, instruction_number);
+              {
+                /* The residuals are compiled apart, so that the equations
+                   sharing the same code can be evaluated together */
+                ostringstream residual_code;
+                unsigned int residual_instruction_number = 0;
+                FNUMEXPR_ fnumexpr(ModelEquation, getBlockEquationID(block, i));
+                fnumexpr.write(residual_code, residual_instruction_number);
+                eq_node = (BinaryOpNode *) getBlockEquationExpr(block, i);
+                lhs = eq_node->get_arg1();
+                rhs = eq_node->get_arg2();
+                lhs->compile(residual_code, residual_instruction_number, false, temporary_terms, map_idx, true, false);
+                rhs->compile(residual_code, residual_instruction_number, false, temporary_terms, map_idx, true, false);
+
+                FBINARY_ fbinary(oMinus);
+                fbinary.write(residual_code, residual_instruction_number);
+                FSTPR_ fstpr(i - block_recursive);
+                fstpr.write(residual_code, residual_instruction_number);
+                patterns.add(getBlockEquationID(block, i), residual_code.str(), residual_instruction_number);
+              }
             }
         }
+      patterns.write(code_file, instruction_number);
       FENDEQU_ fendequ;
       fendequ.write(code_file, instruction_number);
 
@@ -1544,7 +1586,8 @@ DynamicModel::writeDynamicMFile(const string &dynamic_basename) const
                     << "%   residual  [M_.endo_nbr by 1] double    vector of residuals of the dynamic model equations in order of " << endl
                     << "%                                          declaration of the equations." << endl
                     << "%                                          Dynare may prepend auxiliary equations, see M_.aux_vars" << endl
-                    << "%   g1        [M_.endo_nbr by #dynamic variables] double    Jacobian matrix of the dynamic model equations;" << endl
+                    << "%   g1        [M_.endo_nbr by #dynamic variables] " << (sparse_jacobian ? "sparse" : "double")
+                    << "    Jacobian matrix of the dynamic model equations;" << endl
                     << "%                                                           rows: equations in order of declaration" << endl
                     << "%                                                           columns: variables in order stored in M_.lead_lag_incidence followed by the ones in M_.exo_names" << endl
                     << "%   g2        [M_.endo_nbr by (#dynamic variables)^2] double   Hessian matrix of the dynamic model equations;" << endl
@@ -1582,7 +1625,7 @@ DynamicModel::writeDynamicJuliaFile(const string &basename) const
          << "#     from " << basename << ".mod" << endl
          << "#" << endl
          << "using Utils" << endl << endl
-         << "export dynamic!" << endl << endl;
+         << "export dynamic!, dynamic_jacobian_pattern" << endl << endl;
   writeDynamicModel(output, false, true);
   output << "end" << endl;
   output.close();
@@ -1615,8 +1658,13 @@ DynamicModel::writeDynamicCFile(const string &dynamic_basename, const int order)
                     << "#include <math.h>" << endl;
 
   if (external_functions_table.get_total_number_of_unique_model_block_external_functions())
-    // External Matlab function, implies Dynamic function will call mex
-    mDynamicModelFile << "#include \"mex.h\"" << endl;
+    {
+      // External Matlab function, implies Dynamic function will call mex
+      mDynamicModelFile << "#include \"mex.h\"" << endl;
+      // The workspace of the chunked functions is allocated with malloc()
+      if (c_chunk_size > 0)
+        mDynamicModelFile << "#include <stdlib.h>" << endl;
+    }
   else
     mDynamicModelFile << "#include <stdlib.h>" << endl;
 
@@ -1627,6 +1675,13 @@ DynamicModel::writeDynamicCFile(const string &dynamic_basename, const int order)
   writePowerDerivCHeader(mDynamicModelFile);
   writeNormcdfCHeader(mDynamicModelFile);
 
+  map<pair<int, int>, int> jacobian_csc_index;
+  if (sparse_jacobian)
+    {
+      computeJacobianCSCIndex(jacobian_csc_index);
+      writeSparseJacobianPattern(mDynamicModelFile, oCDynamicModel, jacobian_csc_index);
+    }
+
   // Writing the function body
   writeDynamicModel(mDynamicModelFile, true, false);
 
@@ -1651,13 +1706,18 @@ DynamicModel::writeDynamicCFile(const string &dynamic_basename, const int order)
                   << endl
                   << " */" << endl << endl
                   << "#include \"mex.h\"" << endl << endl
-                  << "void Dynamic(double *y, double *x, int nb_row_x, double *params, double *steady_state, int it_, double *residual, double *g1, double *v2, double *v3);" << endl
-                  << "void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])" << endl
+                  << "void Dynamic(double *y, double *x, int nb_row_x, double *params, double *steady_state, int it_, double *residual, double *g1, double *v2, double *v3);" << endl;
+  if (sparse_jacobian)
+    mDynamicMexFile << "extern const int Dynamic_g1_nnz, Dynamic_g1_jc[], Dynamic_g1_ir[];" << endl;
+  mDynamicMexFile << "void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])" << endl
                   << "{" << endl
                   << "  double *y, *x, *params, *steady_state;" << endl
                   << "  double *residual, *g1, *v2, *v3;" << endl
-                  << "  int nb_row_x, it_;" << endl
-                  << endl
+                  << "  int nb_row_x, it_;" << endl;
+  if (sparse_jacobian)
+    mDynamicMexFile << "  mwIndex *ir, *jc;" << endl
+                    << "  int i;" << endl;
+  mDynamicMexFile << endl
                   << "  /* Check that no derivatives of higher order than computed are being requested */" << endl
                   << "  if (nlhs > " << order + 1 << ")" << endl
                   << "    mexErrMsgTxt(\"Derivatives of higher order than computed have been requested\");" << endl
@@ -1690,12 +1750,25 @@ DynamicModel::writeDynamicCFile(const string &dynamic_basename, const int order)
                   << endl
                   << "  g1 = NULL;" << endl
                   << "  if (nlhs >= 2)" << endl
-                  << "  {" << endl
-                  << "     /* Set the output pointer to the output matrix g1. */" << endl
-                  << "     plhs[1] = mxCreateDoubleMatrix(" << equations.size() << ", " << dynJacobianColsNbr << ", mxREAL);" << endl
-                  << "     /* Create a C pointer to a copy of the output matrix g1. */" << endl
-                  << "     g1 = mxGetPr(plhs[1]);" << endl
-                  << "  }" << endl
+                  << "  {" << endl;
+  if (sparse_jacobian)
+    mDynamicMexFile << "     /* Set the output pointer to the sparse output matrix g1, with the sparsity pattern of the Jacobian. */" << endl
+                    << "     plhs[1] = mxCreateSparse(" << equations.size() << ", " << dynJacobianColsNbr << ", "
+                    << max((int) jacobian_csc_index.size(), 1) << ", mxREAL);" << endl
+                    << "     ir = mxGetIr(plhs[1]);" << endl
+                    << "     jc = mxGetJc(plhs[1]);" << endl
+                    << "     for (i = 0; i < Dynamic_g1_nnz; i++)" << endl
+                    << "       ir[i] = Dynamic_g1_ir[i];" << endl
+                    << "     for (i = 0; i <= " << dynJacobianColsNbr << "; i++)" << endl
+                    << "       jc[i] = Dynamic_g1_jc[i];" << endl
+                    << "     /* Create a C pointer to the values of the nonzero elements of g1. */" << endl
+                    << "     g1 = mxGetPr(plhs[1]);" << endl;
+  else
+    mDynamicMexFile << "     /* Set the output pointer to the output matrix g1. */" << endl
+                    << "     plhs[1] = mxCreateDoubleMatrix(" << equations.size() << ", " << dynJacobianColsNbr << ", mxREAL);" << endl
+                    << "     /* Create a C pointer to a copy of the output matrix g1. */" << endl
+                    << "     g1 = mxGetPr(plhs[1]);" << endl;
+  mDynamicMexFile << "  }" << endl
                   << endl
                   << "  v2 = NULL;" << endl
                   << " if (nlhs >= 3)" << endl
@@ -1720,6 +1793,68 @@ DynamicModel::writeDynamicCFile(const string &dynamic_basename, const int order)
   mDynamicMexFile.close();
 }
 
+void
+DynamicModel::computeJacobianCSCIndex(map<pair<int, int>, int> &csc_index) const
+{
+  for (first_derivatives_t::const_iterator it = first_derivatives.begin();
+       it != first_derivatives.end(); it++)
+    csc_index[make_pair(getDynJacobianCol(it->first.second), it->first.first)] = 0;
+  int nz = 0;
+  for (map<pair<int, int>, int>::iterator it = csc_index.begin(); it != csc_index.end(); it++)
+    it->second = ++nz;
+}
+
+void
+DynamicModel::writeSparseJacobianPattern(ostream &output, ExprNodeOutputType output_type,
+                                         const map<pair<int, int>, int> &csc_index) const
+{
+  const int per_line = 20;
+  int k = 0;
+  if (IS_MATLAB(output_type))
+    {
+      output << "persistent g1_i g1_j" << endl
+             << "if isempty(g1_i)" << endl
+             << "  % Sparsity pattern of the Jacobian" << endl
+             << "  g1_i = [";
+      for (map<pair<int, int>, int>::const_iterator it = csc_index.begin();
+           it != csc_index.end(); it++, k++)
+        output << (k == 0 ? "" : (k % per_line == 0 ? ";\n          " : "; "))
+               << it->first.second + 1;
+      output << "];" << endl
+             << "  g1_j = [";
+      k = 0;
+      for (map<pair<int, int>, int>::const_iterator it = csc_index.begin();
+           it != csc_index.end(); it++, k++)
+        output << (k == 0 ? "" : (k % per_line == 0 ? ";\n          " : "; "))
+               << it->first.first + 1;
+      output << "];" << endl
+             << "end" << endl;
+    }
+  else
+    {
+      vector<int> colptr(dynJacobianColsNbr + 1, 0);
+      for (map<pair<int, int>, int>::const_iterator it = csc_index.begin();
+           it != csc_index.end(); it++)
+        colptr[it->first.first + 1]++;
+      for (int j = 0; j < dynJacobianColsNbr; j++)
+        colptr[j + 1] += colptr[j];
+
+      output << "/* Sparsity pattern of the Jacobian (compressed sparse column) */" << endl
+             << "const int Dynamic_g1_nnz = " << csc_index.size() << ";" << endl
+             << "const int Dynamic_g1_jc[] = {";
+      for (int j = 0; j <= dynJacobianColsNbr; j++)
+        output << (j == 0 ? " " : (j % per_line == 0 ? ",\n  " : ", ")) << colptr[j];
+      output << " };" << endl
+             << "const int Dynamic_g1_ir[] = {";
+      for (map<pair<int, int>, int>::const_iterator it = csc_index.begin();
+           it != csc_index.end(); it++, k++)
+        output << (k == 0 ? " " : (k % per_line == 0 ? ",\n  " : ", ")) << it->first.second;
+      if (csc_index.empty())
+        output << " 0";
+      output << " };" << endl << endl;
+    }
+}
+
 string
 DynamicModel::reform(const string name1) const
 {
@@ -2158,6 +2293,7 @@ DynamicModel::writeDynamicModel(ostream &DynamicOutput, bool use_dll, bool julia
   ostringstream jacobian_output;          // Used for storing jacobian equations
   ostringstream hessian_output;           // Used for storing Hessian equations
   ostringstream third_derivatives_output; // Used for storing third order derivatives equations
+  ostringstream sparse_jacobian_output;   // Used for storing the sparse jacobian equations (Julia only)
 
   ExprNodeOutputType output_type = (use_dll ? oCDynamicModel :
                                     julia ? oJuliaDynamicModel : oMatlabDynamicModel);
@@ -2171,7 +2307,12 @@ DynamicModel::writeDynamicModel(ostream &DynamicOutput, bool use_dll, bool julia
 
   writeTemporaryTerms(temporary_terms_res, temp_term_union_m_1, model_output, output_type, tef_terms);
 
-  writeModelEquations(model_output, output_type);
+  /* In C, the families of structurally identical equations are computed in loops,
+     except in the chunked and batched variants, which rewrite the code line by line */
+  vector<equation_family_t> equation_families;
+  if (output_type == oCDynamicModel && c_chunk_size == 0 && !c_batch)
+    computeEquationFamilies(temporary_terms, equation_families);
+  writeModelEquations(model_output, output_type, equation_families);
 
   int nrows = equations.size();
   int hessianColsNbr = dynJacobianColsNbr * dynJacobianColsNbr;
@@ -2184,6 +2325,14 @@ DynamicModel::writeDynamicModel(ostream &DynamicOutput, bool use_dll, bool julia
       writeTemporaryTerms(temp_term_union, temp_term_empty, jacobian_output, output_type, tef_terms);
     else
       writeTemporaryTerms(temp_term_union, temp_term_union_m_1, jacobian_output, output_type, tef_terms);
+
+  // Position of the Jacobian elements in the sparse matrix, ordered by column
+  map<pair<int, int>, int> jacobian_csc_index;
+  if (julia || sparse_jacobian)
+    computeJacobianCSCIndex(jacobian_csc_index);
+  if (julia)
+    sparse_jacobian_output << jacobian_output.str();
+
   for (first_derivatives_t::const_iterator it = first_derivatives.begin();
        it != first_derivatives.end(); it++)
     {
@@ -2191,10 +2340,24 @@ DynamicModel::writeDynamicModel(ostream &DynamicOutput, bool use_dll, bool julia
       int var = it->first.second;
       expr_t d1 = it->second;
 
-      jacobianHelper(jacobian_output, eq, getDynJacobianCol(var), output_type);
-      jacobian_output << "=";
-      d1->writeOutput(jacobian_output, output_type, temp_term_union, tef_terms);
-      jacobian_output << ";" << endl;
+      ostringstream d1_output;
+      d1->writeOutput(d1_output, output_type, temp_term_union, tef_terms);
+
+      if (sparse_jacobian && !julia)
+        {
+          // The position is 1-based in MATLAB, 0-based in C
+          int k = jacobian_csc_index[make_pair(getDynJacobianCol(var), eq)];
+          jacobian_output << "  " << (use_dll ? "g1" : "g1_v") << LEFT_ARRAY_SUBSCRIPT(output_type)
+                          << (use_dll ? k - 1 : k) << RIGHT_ARRAY_SUBSCRIPT(output_type);
+        }
+      else
+        jacobianHelper(jacobian_output, eq, getDynJacobianCol(var), output_type);
+      jacobian_output << "=" << d1_output.str() << ";" << endl;
+
+      if (julia)
+        sparse_jacobian_output << "  @inbounds g1.nzval["
+                               << jacobian_csc_index[make_pair(getDynJacobianCol(var), eq)] << "] = "
+                               << d1_output.str() << endl;
     }
 
   // Writing Hessian
@@ -2357,6 +2520,9 @@ DynamicModel::writeDynamicModel(ostream &DynamicOutput, bool use_dll, bool julia
       fixNestedParenthesis(hessian_output, tmp_paren_vars, message_printed);
       fixNestedParenthesis(third_derivatives_output, tmp_paren_vars, message_printed);
 
+      if (sparse_jacobian)
+        writeSparseJacobianPattern(DynamicOutput, output_type, jacobian_csc_index);
+
       DynamicOutput << "%" << endl
                     << "% Model equations" << endl
                     << "%" << endl
@@ -2365,15 +2531,20 @@ DynamicModel::writeDynamicModel(ostream &DynamicOutput, bool use_dll, bool julia
                     << model_local_vars_output.str()
                     << model_output.str()
         // Writing initialization instruction for matrix g1
-                    << "if nargout >= 2," << endl
-                    << "  g1 = zeros(" << nrows << ", " << dynJacobianColsNbr << ");" << endl
-                    << endl
+                    << "if nargout >= 2," << endl;
+      if (sparse_jacobian)
+        DynamicOutput << "  g1_v = zeros(" << jacobian_csc_index.size() << ", 1);" << endl;
+      else
+        DynamicOutput << "  g1 = zeros(" << nrows << ", " << dynJacobianColsNbr << ");" << endl;
+      DynamicOutput << endl
                     << "  %" << endl
                     << "  % Jacobian matrix" << endl
                     << "  %" << endl
                     << endl
-                    << jacobian_output.str()
-                    << endl
+                    << jacobian_output.str();
+      if (sparse_jacobian)
+        DynamicOutput << "  g1 = sparse(g1_i, g1_j, g1_v, " << nrows << ", " << dynJacobianColsNbr << ");" << endl;
+      DynamicOutput << endl
 
         // Initialize g2 matrix
                     << "if nargout >= 3," << endl
@@ -2406,6 +2577,9 @@ DynamicModel::writeDynamicModel(ostream &DynamicOutput, bool use_dll, bool julia
                     << "end" << endl
                     << "end" << endl;
     }
+  else if (output_type == oCDynamicModel && c_chunk_size > 0)
+    writeDynamicCChunkedModel(DynamicOutput, model_local_vars_output.str(), model_output.str(),
+                              jacobian_output.str(), hessian_output.str(), third_derivatives_output.str());
   else if (output_type == oCDynamicModel)
     {
       DynamicOutput << "void Dynamic(double *y, double *x, int nb_row_x, double *params, double *steady_state, int it_, double *residual, double *g1, double *v2, double *v3)" << endl
@@ -2491,6 +2665,28 @@ DynamicModel::writeDynamicModel(ostream &DynamicOutput, bool use_dll, bool julia
                     << "  # Jacobian matrix" << endl
                     << "  #" << endl
                     << jacobian_output.str()
+                    << "end" << endl << endl;
+
+      writeJuliaJacobianPattern(DynamicOutput, "dynamic_jacobian_pattern", jacobian_csc_index,
+                                nrows, dynJacobianColsNbr);
+
+      DynamicOutput << "function dynamic!(y::Vector{Float64}, x::Matrix{Float64}, "
+                    << "params::Vector{Float64}," << endl
+                    << "                  steady_state::Vector{Float64}, it_::Int, "
+                    << "residual::Vector{Float64}," << endl
+                    << "                  g1::SparseMatrixCSC{Float64, Int})" << endl
+                    << "#=" << endl
+                    << "Same as above, but the Jacobian is a sparse matrix created by dynamic_jacobian_pattern()," << endl
+                    << "whose values are overwritten in place" << endl
+                    << "=#" << endl
+                    << "  @assert size(g1) == (" << nrows << ", " << dynJacobianColsNbr << ")" << endl
+                    << "  @assert length(g1.nzval) == " << jacobian_csc_index.size() << endl
+                    << "  dynamic!(y, x, params, steady_state, it_, residual)" << endl
+                    << model_local_vars_output.str()
+                    << "  #" << endl
+                    << "  # Jacobian matrix" << endl
+                    << "  #" << endl
+                    << sparse_jacobian_output.str()
                     << "end" << endl << endl
                     << "function dynamic!(y::Vector{Float64}, x::Matrix{Float64}, "
                     << "params::Vector{Float64}," << endl
@@ -2536,6 +2732,158 @@ DynamicModel::writeDynamicModel(ostream &DynamicOutput, bool use_dll, bool julia
                       << third_derivatives_output.str();
       DynamicOutput << "end" << endl;
     }
+
+  if (output_type == oCDynamicModel && c_batch)
+    writeDynamicCBatchedModel(DynamicOutput, model_local_vars_output.str(), model_output.str(),
+                              jacobian_output.str());
+}
+
+void
+DynamicModel::writeDynamicCBatchedModel(ostream &DynamicOutput, const string &model_local_vars_output, const string &model_output,
+                                         const string &jacobian_output) const
+{
+  DynamicOutput << "/* Computes the residuals and the Jacobian at K points at once." << endl
+                << "   Every element of y, x, params, steady_state, residual and g1 is a vector of K" << endl
+                << "   contiguous values, one for each point. g1 must be initialized to zero. */" << endl
+                << "void Dynamic_batch(int K, double *y, double *x, int nb_row_x, double *params, double *steady_state, int it_, double *residual, double *g1)" << endl
+                << "{" << endl
+                << "  int k;" << endl
+                << endl
+                << "  if (g1 == NULL)" << endl
+                << "    for (k = 0; k < K; k++)" << endl
+                << "      {" << endl
+                << "        double lhs, rhs;" << endl
+                << endl
+                << "        /* Residual equations */" << endl;
+  writeCBatchedCode(DynamicOutput, model_local_vars_output + model_output, "        ");
+  DynamicOutput << "      }" << endl
+                << "  else" << endl
+                << "    for (k = 0; k < K; k++)" << endl
+                << "      {" << endl
+                << "        double lhs, rhs;" << endl
+                << endl
+                << "        /* Residual equations */" << endl;
+  writeCBatchedCode(DynamicOutput, model_local_vars_output + model_output, "        ");
+  DynamicOutput << "        /* Jacobian  */" << endl;
+  writeCBatchedCode(DynamicOutput, jacobian_output, "        ");
+  DynamicOutput << "      }" << endl
+                << "}" << endl << endl;
+}
+
+//! Splits C code in statements, for writeDynamicCChunkedModel()
+/*! Declarations of temporary terms and model local variables are turned
+  into assignments (they are stored in the workspace). An equation is kept
+  in one statement with the computation of its lhs and rhs. */
+static void
+splitCStatements(const string &code, vector<string> &statements)
+{
+  istringstream input(code);
+  string line, statement;
+  while (getline(input, line))
+    {
+      if (line.empty())
+        continue;
+      if (line.compare(0, 7, "double ") == 0)
+        line.erase(0, 7);
+      statement += line + "\n";
+      if (line.compare(0, 5, "lhs =") != 0 && line.compare(0, 5, "rhs =") != 0)
+        {
+          statements.push_back(statement);
+          statement.clear();
+        }
+    }
+  if (!statement.empty())
+    statements.push_back(statement);
+}
+
+void
+DynamicModel::writeDynamicCChunkedModel(ostream &DynamicOutput, const string &model_local_vars_output, const string &model_output,
+                                         const string &jacobian_output, const string &hessian_output, const string &third_derivatives_output) const
+{
+  const string args = "double *y, double *x, int nb_row_x, double *params, double *steady_state, int it_, double *residual, double *g1, double *v2, double *v3, double *T_";
+  const string call_args = "y, x, nb_row_x, params, steady_state, it_, residual, g1, v2, v3, T_";
+
+  // Workspace holding the temporary terms and the model local variables
+  vector<string> workspace;
+  deriv_node_temp_terms_t tef_terms;
+  for (temporary_terms_t::const_iterator it = temporary_terms.begin();
+       it != temporary_terms.end(); it++)
+    {
+      ostringstream name;
+      (*it)->writeOutput(name, oCDynamicModel, temporary_terms, tef_terms);
+      workspace.push_back(name.str());
+    }
+  set<int> used_local_vars;
+  for (size_t i = 0; i < equations.size(); i++)
+    equations[i]->collectVariables(eModelLocalVariable, used_local_vars);
+  for (set<int>::const_iterator it = used_local_vars.begin();
+       it != used_local_vars.end(); it++)
+    workspace.push_back(symbol_table.getName(*it) + "__");
+
+  DynamicOutput << "/* Workspace shared by the functions computing the model */" << endl;
+  for (size_t i = 0; i < workspace.size(); i++)
+    DynamicOutput << "#define " << workspace[i] << " T_[" << i << "]" << endl;
+  DynamicOutput << endl;
+
+  // Sections: residuals, jacobian, hessian, third derivatives
+  const int nsections = 4;
+  const string section_names[nsections] = { "residuals", "g1", "g2", "g3" };
+  vector<vector<string> > statements(nsections);
+  splitCStatements(model_local_vars_output, statements[0]);
+  splitCStatements(model_output, statements[0]);
+  splitCStatements(jacobian_output, statements[1]);
+  if (second_derivatives.size())
+    splitCStatements(hessian_output, statements[2]);
+  if (third_derivatives.size())
+    splitCStatements(third_derivatives_output, statements[3]);
+
+  vector<int> nchunks(nsections, 0);
+  for (int s = 0; s < nsections; s++)
+    for (size_t i = 0; i < statements[s].size(); i += c_chunk_size)
+      {
+        DynamicOutput << "void Dynamic_" << section_names[s] << "_" << nchunks[s] << "(" << args << ")" << endl
+                      << "{" << endl;
+        if (s == 0)
+          DynamicOutput << "  double lhs, rhs;" << endl;
+        for (size_t j = i; j < statements[s].size() && j < i + c_chunk_size; j++)
+          DynamicOutput << statements[s][j];
+        DynamicOutput << "}" << endl << endl;
+        nchunks[s]++;
+      }
+
+  // Main function, calling the chunks of each section in turn
+  DynamicOutput << "void Dynamic(double *y, double *x, int nb_row_x, double *params, double *steady_state, int it_, double *residual, double *g1, double *v2, double *v3)" << endl
+                << "{" << endl
+                << "  double *T_ = (double *) malloc(" << (workspace.size() > 0 ? workspace.size() : 1) << "*sizeof(double));" << endl
+                << endl;
+  const string guards[nsections] = { "", "g1", "v2", "v3" };
+  const string comments[nsections] = { "Residual equations", "Jacobian", "Hessian for endogenous and exogenous variables",
+                                       "Third derivatives for endogenous and exogenous variables" };
+  string indent = "  ";
+  int nguards = 0;
+  for (int s = 0; s < nsections; s++)
+    {
+      if (s > 0)
+        {
+          if (nchunks[s] == 0)
+            break;
+          DynamicOutput << indent << "if (" << guards[s] << " != NULL)" << endl
+                        << indent << "  {" << endl;
+          indent += "    ";
+          nguards++;
+        }
+      DynamicOutput << indent << "/* " << comments[s] << " */" << endl;
+      for (int k = 0; k < nchunks[s]; k++)
+        DynamicOutput << indent << "Dynamic_" << section_names[s] << "_" << k << "(" << call_args << ");" << endl;
+    }
+  for (; nguards > 0; nguards--)
+    {
+      indent.erase(indent.size() - 4);
+      DynamicOutput << indent << "  }" << endl;
+    }
+  DynamicOutput << endl
+                << "  free(T_);" << endl
+                << "}" << endl;
 }
 
 void
@@ -3137,6 +3485,9 @@ DynamicModel::writeOutput(ostream &output, const string &basename, bool block_de
   else
     output << "-1";
   output << "];" << endl;
+
+  if (sparse_jacobian && !julia)
+    output << modstruct << "sparse_jacobian = true;" << endl;
 }
 
 map<pair<int, pair<int, int > >, expr_t>
@@ -3192,12 +3543,16 @@ DynamicModel::computingPass(bool jacobianExo, bool hessian, bool thirdDerivative
   // Launch computations
   cout << "Computing dynamic model derivatives:" << endl
        << " - order 1" << endl;
+  clock_t t0 = clock();
   computeJacobian(vars);
+  printDerivationTiming(t0);
 
   if (hessian)
     {
       cout << " - order 2" << endl;
+      t0 = clock();
       computeHessian(vars);
+      printDerivationTiming(t0);
     }
 
   if (paramsDerivsOrder > 0)
@@ -3212,7 +3567,9 @@ DynamicModel::computingPass(bool jacobianExo, bool hessian, bool thirdDerivative
   if (thirdDerivatives)
     {
       cout << " - order 3" << endl;
+      t0 = clock();
       computeThirdDerivatives(vars);
+      printDerivationTiming(t0);
     }
 
   if (block)
@@ -3275,43 +3632,133 @@ DynamicModel::computingPass(bool jacobianExo, bool hessian, bool thirdDerivative
         if (bytecode)
           computeTemporaryTermsMapping();
       }
+
+  clearDerivationCaches();
+}
+
+void *
+DynamicModel::computeXrefsThread(void *arg)
+{
+  XrefsThreadArg *xarg = static_cast<XrefsThreadArg *>(arg);
+  for (size_t i = xarg->first; i < xarg->last; i++)
+    (*xarg->equations)[i]->computeXrefs((*xarg->infos)[i]);
+  return NULL;
 }
 
 void
 DynamicModel::computeXrefs()
 {
-  int i = 0;
-  for (vector<BinaryOpNode *>::iterator it = equations.begin();
-       it != equations.end(); it++)
+  vector<ExprNode::EquationInfo> infos(equations.size());
+
+  // Each thread walks a contiguous range of equations, and fills its own slots of infos
+  size_t nthreads = 1;
+#if defined(HAVE_PTHREAD) && defined(_SC_NPROCESSORS_ONLN)
+  long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (ncpus > 1)
+    nthreads = min((size_t) ncpus, equations.size() / 64 + 1);
+#endif
+  vector<XrefsThreadArg> args(nthreads);
+  for (size_t t = 0; t < nthreads; t++)
     {
-      ExprNode::EquationInfo ei;
-      (*it)->computeXrefs(ei);
-      xrefs[i++] = ei;
+      args[t].equations = &equations;
+      args[t].infos = &infos;
+      args[t].first = equations.size() * t / nthreads;
+      args[t].last = equations.size() * (t + 1) / nthreads;
     }
+#ifdef HAVE_PTHREAD
+  vector<pthread_t> threads(nthreads);
+  vector<bool> started(nthreads, false);
+  for (size_t t = 1; t < nthreads; t++)
+    started[t] = !pthread_create(&threads[t], NULL, computeXrefsThread, &args[t]);
+#endif
+  computeXrefsThread(&args[0]);
+#ifdef HAVE_PTHREAD
+  for (size_t t = 1; t < nthreads; t++)
+    if (started[t])
+      pthread_join(threads[t], NULL);
+    else
+      computeXrefsThread(&args[t]);
+#endif
 
-  i = 0;
-  for (map<int, ExprNode::EquationInfo>::const_iterator it = xrefs.begin();
-       it != xrefs.end(); it++, i++)
+  xref_param.fill(infos, &ExprNode::EquationInfo::param);
+  xref_endo.fill(infos, &ExprNode::EquationInfo::endo);
+  xref_exo.fill(infos, &ExprNode::EquationInfo::exo);
+  xref_exo_det.fill(infos, &ExprNode::EquationInfo::exo_det);
+}
+
+void
+DynamicModel::XrefIndex::fill(const vector<ExprNode::EquationInfo> &infos, set<pair<int, int> > ExprNode::EquationInfo::*field)
+{
+  ref_ptr.assign(1, 0);
+  refs.clear();
+  for (vector<ExprNode::EquationInfo>::const_iterator it = infos.begin();
+       it != infos.end(); it++)
     {
-      computeRevXref(xref_param, it->second.param, i);
-      computeRevXref(xref_endo, it->second.endo, i);
-      computeRevXref(xref_exo, it->second.exo, i);
-      computeRevXref(xref_exo_det, it->second.exo_det, i);
+      refs.insert(refs.end(), ((*it).*field).begin(), ((*it).*field).end());
+      ref_ptr.push_back(refs.size());
     }
+
+  // Sorting the (pair, equation) couples groups the equations of each pair, in increasing order
+  vector<pair<pair<int, int>, int> > rev;
+  rev.reserve(refs.size());
+  for (size_t eq = 0; eq + 1 < ref_ptr.size(); eq++)
+    for (int k = ref_ptr[eq]; k < ref_ptr[eq+1]; k++)
+      rev.push_back(make_pair(refs[k], (int) eq));
+  sort(rev.begin(), rev.end());
+
+  keys.clear();
+  eq_ptr.clear();
+  eqs.clear();
+  eqs.reserve(rev.size());
+  for (vector<pair<pair<int, int>, int> >::const_iterator it = rev.begin();
+       it != rev.end(); it++)
+    {
+      if (keys.empty() || keys.back() != it->first)
+        {
+          keys.push_back(it->first);
+          eq_ptr.push_back(eqs.size());
+        }
+      eqs.push_back(it->second);
+    }
+  eq_ptr.push_back(eqs.size());
+}
+
+int
+DynamicModel::XrefIndex::findKey(int symb_id, int lag) const
+{
+  vector<pair<int, int> >::const_iterator it = lower_bound(keys.begin(), keys.end(), make_pair(symb_id, lag));
+  if (it == keys.end() || *it != make_pair(symb_id, lag))
+    return -1;
+  return it - keys.begin();
 }
 
 void
-DynamicModel::computeRevXref(map<pair<int, int>, set<int> > &xrefset, const set<pair<int, int> > &eiref, int eqn)
+DynamicModel::getXrefEquations(int symb_id, int lag, vector<int> &eqs) const
 {
-  for (set<pair<int, int> >::const_iterator it = eiref.begin();
-       it != eiref.end(); it++)
+  const XrefIndex *xref;
+  switch (symbol_table.getType(symb_id))
     {
-      set<int> eq;
-      if (xrefset.find(*it) != xrefset.end())
-        eq = xrefset[*it];
-      eq.insert(eqn);
-      xrefset[*it] = eq;
+    case eParameter:
+      xref = &xref_param;
+      break;
+    case eEndogenous:
+      xref = &xref_endo;
+      break;
+    case eExogenous:
+      xref = &xref_exo;
+      break;
+    case eExogenousDet:
+      xref = &xref_exo_det;
+      break;
+    default:
+      eqs.clear();
+      return;
     }
+  int k = xref->findKey(symb_id, lag);
+  if (k < 0)
+    eqs.clear();
+  else
+    eqs.assign(xref->eqs.begin() + xref->eq_ptr[k], xref->eqs.begin() + xref->eq_ptr[k+1]);
 }
 
 void
@@ -3321,33 +3768,16 @@ DynamicModel::writeXrefs(ostream &output) const
          << "M_.xref1.endo = cell(1, M_.eq_nbr);" << endl
          << "M_.xref1.exo = cell(1, M_.eq_nbr);" << endl
          << "M_.xref1.exo_det = cell(1, M_.eq_nbr);" << endl;
-  int i = 1;
-  for (map<int, ExprNode::EquationInfo>::const_iterator it = xrefs.begin();
-       it != xrefs.end(); it++, i++)
+  for (size_t eq = 0; eq + 1 < xref_param.ref_ptr.size(); eq++)
     {
-      output << "M_.xref1.param{" << i << "} = [ ";
-      for (set<pair<int, int> >::const_iterator it1 = it->second.param.begin();
-           it1 != it->second.param.end(); it1++)
-        output << symbol_table.getTypeSpecificID(it1->first) + 1 << " ";
+      output << "M_.xref1.param{" << eq + 1 << "} = [ ";
+      for (int k = xref_param.ref_ptr[eq]; k < xref_param.ref_ptr[eq+1]; k++)
+        output << symbol_table.getTypeSpecificID(xref_param.refs[k].first) + 1 << " ";
       output << "];" << endl;
 
-      output << "M_.xref1.endo{" << i << "} = [ ";
-      for (set<pair<int, int> >::const_iterator it1 = it->second.endo.begin();
-           it1 != it->second.endo.end(); it1++)
-        output << "struct('id', " << symbol_table.getTypeSpecificID(it1->first) + 1 << ", 'shift', " << it1->second << ");";
-      output << "];" << endl;
-
-      output << "M_.xref1.exo{" << i << "} = [ ";
-      for (set<pair<int, int> >::const_iterator it1 = it->second.exo.begin();
-           it1 != it->second.exo.end(); it1++)
-        output << "struct('id', " << symbol_table.getTypeSpecificID(it1->first) + 1 << ", 'shift', " << it1->second << ");";
-      output << "];" << endl;
-
-      output << "M_.xref1.exo_det{" << i << "} = [ ";
-      for (set<pair<int, int> >::const_iterator it1 = it->second.exo_det.begin();
-           it1 != it->second.exo_det.end(); it1++)
-        output << "struct('id', " << symbol_table.getTypeSpecificID(it1->first) + 1 << ", 'shift', " << it1->second << ");";
-      output << "];" << endl;
+      writeXrefs(output, xref_endo, eq, "endo");
+      writeXrefs(output, xref_exo, eq, "exo");
+      writeXrefs(output, xref_exo_det, eq, "exo_det");
     }
 
   output << "M_.xref2.param = cell(1, M_.param_nbr);" << endl
@@ -3361,25 +3791,32 @@ DynamicModel::writeXrefs(ostream &output) const
 }
 
 void
-DynamicModel::writeRevXrefs(ostream &output, const map<pair<int, int>, set<int> > &xrefmap, const string &type) const
+DynamicModel::writeXrefs(ostream &output, const XrefIndex &xref, int eq, const string &type) const
+{
+  output << "M_.xref1." << type << "{" << eq + 1 << "} = [ ";
+  for (int k = xref.ref_ptr[eq]; k < xref.ref_ptr[eq+1]; k++)
+    output << "struct('id', " << symbol_table.getTypeSpecificID(xref.refs[k].first) + 1 << ", 'shift', " << xref.refs[k].second << ");";
+  output << "];" << endl;
+}
+
+void
+DynamicModel::writeRevXrefs(ostream &output, const XrefIndex &xref, const string &type) const
 {
   int last_tsid = -1;
-  for (map<pair<int, int>, set<int> >::const_iterator it = xrefmap.begin();
-       it != xrefmap.end(); it++)
+  for (size_t k = 0; k < xref.keys.size(); k++)
     {
-      int tsid = symbol_table.getTypeSpecificID(it->first.first) + 1;
+      int tsid = symbol_table.getTypeSpecificID(xref.keys[k].first) + 1;
       output << "M_.xref2." << type << "{" << tsid << "} = [ ";
       if (last_tsid == tsid)
         output << "M_.xref2." << type << "{" << tsid << "}; ";
       else
         last_tsid = tsid;
 
-      for (set<int>::const_iterator it1 = it->second.begin();
-           it1 != it->second.end(); it1++)
+      for (int i = xref.eq_ptr[k]; i < xref.eq_ptr[k+1]; i++)
         if (type == "param")
-          output << *it1 + 1 << " ";
+          output << xref.eqs[i] + 1 << " ";
         else
-          output << "struct('shift', " << it->first.second << ", 'eq', " << *it1+1 << ");";
+          output << "struct('shift', " << xref.keys[k].second << ", 'eq', " << xref.eqs[i]+1 << ");";
       output << "];" << endl;
     }
 }
@@ -3977,6 +4414,21 @@ DynamicModel::computeDerivIDs()
       deriv_id_table[*it] = deriv_id;
       inv_deriv_id_table.push_back(*it);
     }
+
+  // Freeze the table into a dense array, since getDerivID() is called in the innermost loops
+  deriv_id_index_min_lag = 0;
+  int index_max_lag = 0;
+  for (deriv_id_table_t::const_iterator it = deriv_id_table.begin();
+       it != deriv_id_table.end(); it++)
+    {
+      deriv_id_index_min_lag = min(deriv_id_index_min_lag, it->first.second);
+      index_max_lag = max(index_max_lag, it->first.second);
+    }
+  deriv_id_index_nb_lags = index_max_lag - deriv_id_index_min_lag + 1;
+  deriv_id_index.assign((symbol_table.maxID() + 1) * deriv_id_index_nb_lags, -1);
+  for (deriv_id_table_t::const_iterator it = deriv_id_table.begin();
+       it != deriv_id_table.end(); it++)
+    deriv_id_index[it->first.first * deriv_id_index_nb_lags + it->first.second - deriv_id_index_min_lag] = it->second;
 }
 
 SymbolType
@@ -4006,11 +4458,20 @@ DynamicModel::getSymbIDByDerivID(int deriv_id) const throw (UnknownDerivIDExcept
 int
 DynamicModel::getDerivID(int symb_id, int lag) const throw (UnknownDerivIDException)
 {
-  deriv_id_table_t::const_iterator it = deriv_id_table.find(make_pair(symb_id, lag));
-  if (it == deriv_id_table.end())
+  if (deriv_id_index.empty())
     throw UnknownDerivIDException();
-  else
-    return it->second;
+
+  // Symbols created after computeDerivIDs() are out of the index, and have no deriv ID
+  int nb_symbols = deriv_id_index.size() / deriv_id_index_nb_lags;
+  int lag_offset = lag - deriv_id_index_min_lag;
+  if (symb_id < 0 || symb_id >= nb_symbols
+      || lag_offset < 0 || lag_offset >= deriv_id_index_nb_lags)
+    throw UnknownDerivIDException();
+
+  int deriv_id = deriv_id_index[symb_id * deriv_id_index_nb_lags + lag_offset];
+  if (deriv_id < 0)
+    throw UnknownDerivIDException();
+  return deriv_id;
 }
 
 void
@@ -4027,6 +4488,7 @@ DynamicModel::computeDynJacobianCols(bool jacobianExo)
   /* Sort the dynamic endogenous variables by lexicographic order over (lag, type_specific_symbol_id)
      and fill the dynamic columns for exogenous and exogenous deterministic */
   map<pair<int, int>, int> ordered_dyn_endo;
+  dyn_jacobian_cols_table.assign(inv_deriv_id_table.size(), -1);
 
   for (deriv_id_table_t::const_iterator it = deriv_id_table.begin();
        it != deriv_id_table.end(); it++)
@@ -4078,11 +4540,11 @@ DynamicModel::computeDynJacobianCols(bool jacobianExo)
 int
 DynamicModel::getDynJacobianCol(int deriv_id) const throw (UnknownDerivIDException)
 {
-  map<int, int>::const_iterator it = dyn_jacobian_cols_table.find(deriv_id);
-  if (it == dyn_jacobian_cols_table.end())
+  if (deriv_id < 0 || deriv_id >= (int) dyn_jacobian_cols_table.size()
+      || dyn_jacobian_cols_table[deriv_id] < 0)
     throw UnknownDerivIDException();
   else
-    return it->second;
+    return dyn_jacobian_cols_table[deriv_id];
 }
 
 void
@@ -4847,6 +5309,51 @@ DynamicModel::isChecksumMatching(const string &basename) const
   return true;
 }
 
+unsigned int
+DynamicModel::computeChecksum() const
+{
+  boost::crc_32_type result;
+
+  std::stringstream buffer;
+
+  ExprNodeOutputType buffer_type = oCDynamicModel;
+  temporary_terms_t temp_terms_empty;
+
+  for (size_t i = 0; i < equation_tags.size(); i++)
+    buffer << "  " << equation_tags[i].first + 1
+           << equation_tags[i].second.first
+           << equation_tags[i].second.second;
+
+  for (map<int, expr_t>::const_iterator it = local_variables_table.begin();
+       it != local_variables_table.end(); it++)
+    {
+      buffer << symbol_table.getName(it->first) << " =";
+      it->second->writeOutput(buffer, buffer_type, temp_terms_empty);
+      buffer << ";" << endl;
+    }
+
+  for (int eq = 0; eq < (int) equations.size(); eq++)
+    {
+      buffer << "residual" << LEFT_ARRAY_SUBSCRIPT(buffer_type)
+             << eq + ARRAY_SUBSCRIPT_OFFSET(buffer_type)
+             << RIGHT_ARRAY_SUBSCRIPT(buffer_type)
+             << " = ";
+      equations[eq]->get_arg1()->writeOutput(buffer, buffer_type, temp_terms_empty);
+      buffer << " - (";
+      equations[eq]->get_arg2()->writeOutput(buffer, buffer_type, temp_terms_empty);
+      buffer << ");" << endl;
+    }
+
+  char private_buffer[PRIVATE_BUFFER_SIZE];
+  while (buffer)
+    {
+      buffer.get(private_buffer, PRIVATE_BUFFER_SIZE);
+      result.process_bytes(private_buffer, strlen(private_buffer));
+    }
+
+  return result.checksum();
+}
+
 void
 DynamicModel::writeCOutput(ostream &output, const string &basename, bool block_decomposition, bool byte_code, bool use_dll, int order, bool estimation_present) const
 {
@@ -4981,6 +5488,8 @@ DynamicModel::writeResidualsC(const string &basename, bool cuda) const
   deriv_node_temp_terms_t tef_terms;
 
   ostringstream model_output;    // Used for storing model equations
+  temporary_terms_t temp_term_empty;
+  writeTemporaryTerms(temporary_terms_res, temp_term_empty, model_output, oCDynamic2Model, tef_terms);
   writeModelEquations(model_output, oCDynamic2Model);
 
   mDynamicModelFile << "  double lhs, rhs;" << endl
@@ -5035,6 +5544,13 @@ DynamicModel::writeFirstDerivativesC(const string &basename, bool cuda) const
   // this is always empty here, but needed by d1->writeOutput
   deriv_node_temp_terms_t tef_terms;
 
+  /* Temporary terms shared by the residuals and the jacobian, written once at
+     the top of the function */
+  temporary_terms_t temp_term_empty;
+  temporary_terms_t temp_term_union = temporary_terms_res;
+  temp_term_union.insert(temporary_terms_g1.begin(), temporary_terms_g1.end());
+  writeTemporaryTerms(temp_term_union, temp_term_empty, mDynamicModelFile, oCDynamicModel, tef_terms);
+
   // Writing Jacobian
   for (first_derivatives_t::const_iterator it = first_derivatives.begin();
        it != first_derivatives.end(); it++)
@@ -5047,7 +5563,7 @@ DynamicModel::writeFirstDerivativesC(const string &basename, bool cuda) const
       mDynamicModelFile << "=";
       // oCStaticModel makes reference to the static variables
       // oCDynamicModel makes reference to the dynamic variables
-      d1->writeOutput(mDynamicModelFile, oCDynamicModel, temporary_terms, tef_terms);
+      d1->writeOutput(mDynamicModelFile, oCDynamicModel, temp_term_union, tef_terms);
       mDynamicModelFile << ";" << endl;
     }
 
@@ -5131,6 +5647,12 @@ DynamicModel::writeFirstDerivativesC_csr(const string &basename, bool cuda) cons
     }
   sort(D.begin(), D.end(), derivative_less_than());
 
+  // Temporary terms shared by the residuals and the jacobian
+  temporary_terms_t temp_term_empty;
+  temporary_terms_t temp_term_union = temporary_terms_res;
+  temp_term_union.insert(temporary_terms_g1.begin(), temporary_terms_g1.end());
+  writeTemporaryTerms(temp_term_union, temp_term_empty, mDynamicModelFile, oCDynamic2Model, tef_terms);
+
   // writing sparse Jacobian
   vector<int> row_ptr(equations.size());
   fill(row_ptr.begin(), row_ptr.end(), 0.0);
@@ -5142,7 +5664,7 @@ DynamicModel::writeFirstDerivativesC_csr(const string &basename, bool cuda) cons
                         << "=" << it->col_nbr << ";" << endl;
       mDynamicModelFile << "value[" << k << "] = ";
       // oCstaticModel makes reference to the static variables
-      it->value->writeOutput(mDynamicModelFile, oCDynamic2Model, temporary_terms, tef_terms);
+      it->value->writeOutput(mDynamicModelFile, oCDynamic2Model, temp_term_union, tef_terms);
       mDynamicModelFile << ";" << endl;
       k++;
     }
@@ -5230,6 +5752,13 @@ DynamicModel::writeSecondDerivativesC_csr(const string &basename, bool cuda) con
     }
   sort(D.begin(), D.end(), derivative_less_than());
 
+  // Temporary terms shared by the residuals, the jacobian and the hessian
+  temporary_terms_t temp_term_empty;
+  temporary_terms_t temp_term_union = temporary_terms_res;
+  temp_term_union.insert(temporary_terms_g1.begin(), temporary_terms_g1.end());
+  temp_term_union.insert(temporary_terms_g2.begin(), temporary_terms_g2.end());
+  writeTemporaryTerms(temp_term_union, temp_term_empty, mDynamicModelFile, oCStaticModel, tef_terms);
+
   // Writing Hessian
   vector<int> row_ptr(equations.size());
   fill(row_ptr.begin(), row_ptr.end(), 0.0);
@@ -5241,7 +5770,7 @@ DynamicModel::writeSecondDerivativesC_csr(const string &basename, bool cuda) con
                         << "=" << it->col_nbr << ";" << endl;
       mDynamicModelFile << "value[" << k << "] = ";
       // oCstaticModel makes reference to the static variables
-      it->value->writeOutput(mDynamicModelFile, oCStaticModel, temporary_terms, tef_terms);
+      it->value->writeOutput(mDynamicModelFile, oCStaticModel, temp_term_union, tef_terms);
       mDynamicModelFile << ";" << endl;
       k++;
     }
@@ -5462,80 +5991,38 @@ DynamicModel::writeJsonXrefs(ostream &output) const
 {
   output << "\"xrefs\": {"
          << "\"parameters\": [";
-  for (map<pair<int, int>, set<int> >::const_iterator it = xref_param.begin();
-       it != xref_param.end(); it++)
-    {
-      if (it != xref_param.begin())
-        output << ", ";
-      output << "{\"parameter\": \"" << symbol_table.getName(it->first.first) << "\""
-             << ", \"equations\": [";
-      for (set<int>::const_iterator it1 = it->second.begin();
-           it1 != it->second.end(); it1++)
-        {
-          if (it1 != it->second.begin())
-            output << ", ";
-          output << *it1 + 1;
-        }
-      output << "]}";
-    }
+  writeJsonRevXrefs(output, xref_param, "parameter");
   output << "]"
          << ", \"endogenous\": [";
-  for (map<pair<int, int>, set<int> >::const_iterator it = xref_endo.begin();
-       it != xref_endo.end(); it++)
-    {
-      if (it != xref_endo.begin())
-        output << ", ";
-      output << "{\"endogenous\": \"" << symbol_table.getName(it->first.first) << "\""
-             << ", \"shift\": " << it->first.second
-             << ", \"equations\": [";
-      for (set<int>::const_iterator it1 = it->second.begin();
-           it1 != it->second.end(); it1++)
-        {
-          if (it1 != it->second.begin())
-            output << ", ";
-          output << *it1 + 1;
-        }
-      output << "]}";
-    }
+  writeJsonRevXrefs(output, xref_endo, "endogenous");
   output << "]"
          << ", \"exogenous\": [";
-  for (map<pair<int, int>, set<int> >::const_iterator it = xref_exo.begin();
-       it != xref_exo.end(); it++)
-    {
-      if (it != xref_exo.begin())
-        output << ", ";
-      output << "{\"exogenous\": \"" << symbol_table.getName(it->first.first) << "\""
-             << ", \"shift\": " << it->first.second
-             << ", \"equations\": [";
-      for (set<int>::const_iterator it1 = it->second.begin();
-           it1 != it->second.end(); it1++)
-        {
-          if (it1 != it->second.begin())
-            output << ", ";
-          output << *it1 + 1;
-        }
-      output << "]}";
-    }
+  writeJsonRevXrefs(output, xref_exo, "exogenous");
   output << "]"
          << ", \"exogenous_deterministic\": [";
-  for (map<pair<int, int>, set<int> >::const_iterator it = xref_exo_det.begin();
-       it != xref_exo_det.end(); it++)
+  writeJsonRevXrefs(output, xref_exo_det, "exogenous_det");
+  output << "]}" << endl;
+}
+
+void
+DynamicModel::writeJsonRevXrefs(ostream &output, const XrefIndex &xref, const string &type) const
+{
+  for (size_t k = 0; k < xref.keys.size(); k++)
     {
-      if (it != xref_exo_det.begin())
+      if (k > 0)
         output << ", ";
-      output << "{\"exogenous_det\": \"" << symbol_table.getName(it->first.first) << "\""
-             << ", \"shift\": " << it->first.second
-             << ", \"equations\": [";
-      for (set<int>::const_iterator it1 = it->second.begin();
-           it1 != it->second.end(); it1++)
+      output << "{\"" << type << "\": \"" << symbol_table.getName(xref.keys[k].first) << "\"";
+      if (type != "parameter")
+        output << ", \"shift\": " << xref.keys[k].second;
+      output << ", \"equations\": [";
+      for (int i = xref.eq_ptr[k]; i < xref.eq_ptr[k+1]; i++)
         {
-          if (it1 != it->second.begin())
+          if (i > xref.eq_ptr[k])
             output << ", ";
-          output << *it1 + 1;
+          output << xref.eqs[i] + 1;
         }
       output << "]}";
     }
-  output << "]}" << endl;
 }
 
 void
@@ -5547,12 +6034,6 @@ DynamicModel::writeJsonOriginalModelOutput(ostream &output) const
 void
 DynamicModel::writeJsonComputingPassOutput(ostream &output, bool writeDetails) const
 {
-  ostringstream model_local_vars_output;  // Used for storing model local vars
-  ostringstream model_output;             // Used for storing model temp vars and equations
-  ostringstream jacobian_output;          // Used for storing jacobian equations
-  ostringstream hessian_output;           // Used for storing Hessian equations
-  ostringstream third_derivatives_output; // Used for storing third order derivatives equations
-
   deriv_node_temp_terms_t tef_terms;
   temporary_terms_t temp_term_empty;
   temporary_terms_t temp_term_union = temporary_terms_res;
@@ -5561,26 +6042,32 @@ DynamicModel::writeJsonComputingPassOutput(ostream &output, bool writeDetails) c
   string concat = "";
   int hessianColsNbr = dynJacobianColsNbr * dynJacobianColsNbr;
 
-  writeJsonModelLocalVariables(model_local_vars_output, tef_terms);
+  if (writeDetails)
+    output << "\"dynamic_model_derivative_details\": {";
+  else
+    output << "\"dynamic_model_derivatives\": {";
+  writeJsonModelLocalVariables(output, tef_terms);
 
-  writeJsonTemporaryTerms(temporary_terms_res, temp_term_union_m_1, model_output, tef_terms, concat);
-  model_output << ", ";
-  writeJsonModelEquations(model_output, true);
+  output << ", ";
+  writeJsonTemporaryTerms(temporary_terms_res, temp_term_union_m_1, output, tef_terms, concat);
+  output << ", ";
+  writeJsonModelEquations(output, true);
 
   // Writing Jacobian
   temp_term_union_m_1 = temp_term_union;
   temp_term_union.insert(temporary_terms_g1.begin(), temporary_terms_g1.end());
   concat = "jacobian";
-  writeJsonTemporaryTerms(temp_term_union, temp_term_union_m_1, jacobian_output, tef_terms, concat);
-  jacobian_output << ", \"jacobian\": {"
-                  << "  \"nrows\": " << equations.size()
-                  << ", \"ncols\": " << dynJacobianColsNbr
-                  << ", \"entries\": [";
+  output << ", ";
+  writeJsonTemporaryTerms(temp_term_union, temp_term_union_m_1, output, tef_terms, concat);
+  output << ", \"jacobian\": {"
+         << "  \"nrows\": " << equations.size()
+         << ", \"ncols\": " << dynJacobianColsNbr
+         << ", \"entries\": [";
   for (first_derivatives_t::const_iterator it = first_derivatives.begin();
        it != first_derivatives.end(); it++)
     {
       if (it != first_derivatives.begin())
-        jacobian_output << ", ";
+        output << ", ";
 
       int eq = it->first.first;
       int var = it->first.second;
@@ -5588,32 +6075,33 @@ DynamicModel::writeJsonComputingPassOutput(ostream &output, bool writeDetails) c
       expr_t d1 = it->second;
 
       if (writeDetails)
-        jacobian_output << "{\"eq\": " << eq + 1
-                        << ", \"var\": \"" << symbol_table.getName(getSymbIDByDerivID(var)) << "\""
-                        << ", \"lag\": " << getLagByDerivID(var);
+        output << "{\"eq\": " << eq + 1
+               << ", \"var\": \"" << symbol_table.getName(getSymbIDByDerivID(var)) << "\""
+               << ", \"lag\": " << getLagByDerivID(var);
       else
-        jacobian_output << "{\"row\": " << eq + 1;
-      jacobian_output << ", \"col\": " << col + 1
-                      << ", \"val\": \"";
-      d1->writeJsonOutput(jacobian_output, temp_term_union, tef_terms);
-      jacobian_output << "\"}" << endl;
+        output << "{\"row\": " << eq + 1;
+      output << ", \"col\": " << col + 1
+             << ", \"val\": \"";
+      d1->writeJsonOutput(output, temp_term_union, tef_terms);
+      output << "\"}" << endl;
     }
-  jacobian_output << "]}";
+  output << "]}";
 
   // Writing Hessian
   temp_term_union_m_1 = temp_term_union;
   temp_term_union.insert(temporary_terms_g2.begin(), temporary_terms_g2.end());
   concat = "hessian";
-  writeJsonTemporaryTerms(temp_term_union, temp_term_union_m_1, hessian_output, tef_terms, concat);
-  hessian_output << ", \"hessian\": {"
-                 << "  \"nrows\": " << equations.size()
-                 << ", \"ncols\": " << hessianColsNbr
-                 << ", \"entries\": [";
+  output << ", ";
+  writeJsonTemporaryTerms(temp_term_union, temp_term_union_m_1, output, tef_terms, concat);
+  output << ", \"hessian\": {"
+         << "  \"nrows\": " << equations.size()
+         << ", \"ncols\": " << hessianColsNbr
+         << ", \"entries\": [";
   for (second_derivatives_t::const_iterator it = second_derivatives.begin();
        it != second_derivatives.end(); it++)
     {
       if (it != second_derivatives.begin())
-        hessian_output << ", ";
+        output << ", ";
 
       int eq = it->first.first;
       int var1 = it->first.second.first;
@@ -5625,38 +6113,39 @@ DynamicModel::writeJsonComputingPassOutput(ostream &output, bool writeDetails) c
       int col_nb_sym = id2 * dynJacobianColsNbr + id1;
 
       if (writeDetails)
-        hessian_output << "{\"eq\": " << eq + 1
-                       << ", \"var1\": \"" << symbol_table.getName(getSymbIDByDerivID(var1)) << "\""
-                       << ", \"lag1\": " << getLagByDerivID(var1)
-                       << ", \"var2\": \"" << symbol_table.getName(getSymbIDByDerivID(var2)) << "\""
-                       << ", \"lag2\": " << getLagByDerivID(var2);
+        output << "{\"eq\": " << eq + 1
+               << ", \"var1\": \"" << symbol_table.getName(getSymbIDByDerivID(var1)) << "\""
+               << ", \"lag1\": " << getLagByDerivID(var1)
+               << ", \"var2\": \"" << symbol_table.getName(getSymbIDByDerivID(var2)) << "\""
+               << ", \"lag2\": " << getLagByDerivID(var2);
       else
-        hessian_output << "{\"row\": " << eq + 1;
+        output << "{\"row\": " << eq + 1;
 
-      hessian_output << ", \"col\": [" << col_nb + 1;
+      output << ", \"col\": [" << col_nb + 1;
       if (id1 != id2)
-        hessian_output << ", " << col_nb_sym + 1;
-      hessian_output << "]"
-                     << ", \"val\": \"";
-      d2->writeJsonOutput(hessian_output, temp_term_union, tef_terms);
-      hessian_output << "\"}" << endl;
+        output << ", " << col_nb_sym + 1;
+      output << "]"
+             << ", \"val\": \"";
+      d2->writeJsonOutput(output, temp_term_union, tef_terms);
+      output << "\"}" << endl;
     }
-  hessian_output << "]}";
+  output << "]}";
 
   // Writing third derivatives
   temp_term_union_m_1 = temp_term_union;
   temp_term_union.insert(temporary_terms_g3.begin(), temporary_terms_g3.end());
   concat = "third_derivatives";
-  writeJsonTemporaryTerms(temp_term_union, temp_term_union_m_1, third_derivatives_output, tef_terms, concat);
-  third_derivatives_output << ", \"third_derivative\": {"
-                           << "  \"nrows\": " << equations.size()
-                           << ", \"ncols\": " << hessianColsNbr * dynJacobianColsNbr
-                           << ", \"entries\": [";
+  output << ", ";
+  writeJsonTemporaryTerms(temp_term_union, temp_term_union_m_1, output, tef_terms, concat);
+  output << ", \"third_derivative\": {"
+         << "  \"nrows\": " << equations.size()
+         << ", \"ncols\": " << hessianColsNbr * dynJacobianColsNbr
+         << ", \"entries\": [";
   for (third_derivatives_t::const_iterator it = third_derivatives.begin();
        it != third_derivatives.end(); it++)
     {
       if (it != third_derivatives.begin())
-        third_derivatives_output << ", ";
+        output << ", ";
 
       int eq = it->first.first;
       int var1 = it->first.second.first;
@@ -5665,15 +6154,15 @@ DynamicModel::writeJsonComputingPassOutput(ostream &output, bool writeDetails) c
       expr_t d3 = it->second;
 
       if (writeDetails)
-        third_derivatives_output << "{\"eq\": " << eq + 1
-                                 << ", \"var1\": \"" << symbol_table.getName(getSymbIDByDerivID(var1)) << "\""
-                                 << ", \"lag1\": " << getLagByDerivID(var1)
-                                 << ", \"var2\": \"" << symbol_table.getName(getSymbIDByDerivID(var2)) << "\""
-                                 << ", \"lag2\": " << getLagByDerivID(var2)
-                                 << ", \"var3\": \"" << symbol_table.getName(getSymbIDByDerivID(var3)) << "\""
-                                 << ", \"lag3\": " << getLagByDerivID(var3);
+        output << "{\"eq\": " << eq + 1
+               << ", \"var1\": \"" << symbol_table.getName(getSymbIDByDerivID(var1)) << "\""
+               << ", \"lag1\": " << getLagByDerivID(var1)
+               << ", \"var2\": \"" << symbol_table.getName(getSymbIDByDerivID(var2)) << "\""
+               << ", \"lag2\": " << getLagByDerivID(var2)
+               << ", \"var3\": \"" << symbol_table.getName(getSymbIDByDerivID(var3)) << "\""
+               << ", \"lag3\": " << getLagByDerivID(var3);
       else
-        third_derivatives_output << "{\"row\": " << eq + 1;
+        output << "{\"row\": " << eq + 1;
 
       int id1 = getDynJacobianCol(var1);
       int id2 = getDynJacobianCol(var2);
@@ -5686,30 +6175,21 @@ DynamicModel::writeJsonComputingPassOutput(ostream &output, bool writeDetails) c
       cols.insert(id3 * hessianColsNbr + id1 * dynJacobianColsNbr + id2);
       cols.insert(id3 * hessianColsNbr + id2 * dynJacobianColsNbr + id1);
 
-      third_derivatives_output << ", \"col\": [";
+      output << ", \"col\": [";
       for (set<int>::iterator it2 = cols.begin(); it2 != cols.end(); it2++)
         {
           if (it2 != cols.begin())
-            third_derivatives_output << ", ";
-          third_derivatives_output << *it2 + 1;
+            output << ", ";
+          output << *it2 + 1;
         }
-      third_derivatives_output << "]"
-                               << ", \"val\": \"";
-      d3->writeJsonOutput(third_derivatives_output, temp_term_union, tef_terms);
-      third_derivatives_output << "\"}" << endl;
+      output << "]"
+             << ", \"val\": \"";
+      d3->writeJsonOutput(output, temp_term_union, tef_terms);
+      output << "\"}" << endl;
     }
-  third_derivatives_output << "]}";
+  output << "]}";
 
-  if (writeDetails)
-    output << "\"dynamic_model_derivative_details\": {";
-  else
-    output << "\"dynamic_model_derivatives\": {";
-  output << model_local_vars_output.str()
-         << ", " << model_output.str()
-         << ", " << jacobian_output.str()
-         << ", " << hessian_output.str()
-         << ", " << third_derivatives_output.str()
-         << "}";
+  output << "}";
 }
 
 void
@@ -5722,29 +6202,26 @@ DynamicModel::writeJsonParamsDerivativesFile(ostream &output, bool writeDetails)
       && !hessian_params_derivatives.size())
     return;
 
-  ostringstream model_local_vars_output;   // Used for storing model local vars
-  ostringstream model_output;              // Used for storing model temp vars and equations
-  ostringstream jacobian_output;           // Used for storing jacobian equations
-  ostringstream hessian_output;            // Used for storing Hessian equations
-  ostringstream hessian1_output;           // Used for storing Hessian equations
-  ostringstream third_derivs_output;       // Used for storing third order derivatives equations
-  ostringstream third_derivs1_output;      // Used for storing third order derivatives equations
-
   deriv_node_temp_terms_t tef_terms;
-  writeJsonModelLocalVariables(model_local_vars_output, tef_terms);
+  if (writeDetails)
+    output << "\"dynamic_model_params_derivative_details\": {";
+  else
+    output << "\"dynamic_model_params_derivatives\": {";
+  writeJsonModelLocalVariables(output, tef_terms);
 
   temporary_terms_t temp_terms_empty;
   string concat = "all";
-  writeJsonTemporaryTerms(params_derivs_temporary_terms, temp_terms_empty, model_output, tef_terms, concat);
-  jacobian_output << "\"deriv_wrt_params\": {"
-                  << "  \"neqs\": " << equations.size()
-                  << ", \"nparamcols\": " << symbol_table.param_nbr()
-                  << ", \"entries\": [";
+  output << ", ";
+  writeJsonTemporaryTerms(params_derivs_temporary_terms, temp_terms_empty, output, tef_terms, concat);
+  output << ", \"deriv_wrt_params\": {"
+         << "  \"neqs\": " << equations.size()
+         << ", \"nparamcols\": " << symbol_table.param_nbr()
+         << ", \"entries\": [";
   for (first_derivatives_t::const_iterator it = residuals_params_derivatives.begin();
        it != residuals_params_derivatives.end(); it++)
     {
       if (it != residuals_params_derivatives.begin())
-        jacobian_output << ", ";
+        output << ", ";
 
       int eq = it->first.first;
       int param = it->first.second;
@@ -5753,26 +6230,26 @@ DynamicModel::writeJsonParamsDerivativesFile(ostream &output, bool writeDetails)
       int param_col = symbol_table.getTypeSpecificID(getSymbIDByDerivID(param)) + 1;
 
       if (writeDetails)
-        jacobian_output << "{\"eq\": " << eq + 1
-                        << ", \"param\": \"" << symbol_table.getName(getSymbIDByDerivID(param)) << "\"";
+        output << "{\"eq\": " << eq + 1
+               << ", \"param\": \"" << symbol_table.getName(getSymbIDByDerivID(param)) << "\"";
       else
-        jacobian_output << "{\"row\": " << eq + 1;
-      jacobian_output << ", \"param_col\": " << param_col + 1
-                      << ", \"val\": \"";
-      d1->writeJsonOutput(jacobian_output, params_derivs_temporary_terms, tef_terms);
-      jacobian_output << "\"}" << endl;
-    }
-  jacobian_output << "]}";
-  hessian_output << "\"deriv_jacobian_wrt_params\": {"
-                 << "  \"neqs\": " << equations.size()
-                 << ", \"nvarcols\": " << dynJacobianColsNbr
-                 << ", \"nparamcols\": " << symbol_table.param_nbr()
-                 << ", \"entries\": [";
+        output << "{\"row\": " << eq + 1;
+      output << ", \"param_col\": " << param_col + 1
+             << ", \"val\": \"";
+      d1->writeJsonOutput(output, params_derivs_temporary_terms, tef_terms);
+      output << "\"}" << endl;
+    }
+  output << "]}";
+  output << ", \"deriv_jacobian_wrt_params\": {"
+         << "  \"neqs\": " << equations.size()
+         << ", \"nvarcols\": " << dynJacobianColsNbr
+         << ", \"nparamcols\": " << symbol_table.param_nbr()
+         << ", \"entries\": [";
   for (second_derivatives_t::const_iterator it = jacobian_params_derivatives.begin();
        it != jacobian_params_derivatives.end(); it++)
     {
       if (it != jacobian_params_derivatives.begin())
-        hessian_output << ", ";
+        output << ", ";
 
       int eq = it->first.first;
       int var = it->first.second.first;
@@ -5783,30 +6260,30 @@ DynamicModel::writeJsonParamsDerivativesFile(ostream &output, bool writeDetails)
       int param_col = symbol_table.getTypeSpecificID(getSymbIDByDerivID(param)) + 1;
 
       if (writeDetails)
-        hessian_output << "{\"eq\": " << eq + 1
-                       << ", \"var\": \"" << symbol_table.getName(getSymbIDByDerivID(var)) << "\""
-                       << ", \"lag\": " << getLagByDerivID(var)
-                       << ", \"param\": \"" << symbol_table.getName(getSymbIDByDerivID(param)) << "\"";
+        output << "{\"eq\": " << eq + 1
+               << ", \"var\": \"" << symbol_table.getName(getSymbIDByDerivID(var)) << "\""
+               << ", \"lag\": " << getLagByDerivID(var)
+               << ", \"param\": \"" << symbol_table.getName(getSymbIDByDerivID(param)) << "\"";
       else
-        hessian_output << "{\"row\": " << eq + 1;
-      hessian_output << ", \"var_col\": " << var_col + 1
-                     << ", \"param_col\": " << param_col + 1
-                     << ", \"val\": \"";
-      d2->writeJsonOutput(hessian_output, params_derivs_temporary_terms, tef_terms);
-      hessian_output << "\"}" << endl;
-    }
-  hessian_output << "]}";
-
-  hessian1_output << "\"second_deriv_residuals_wrt_params\": {"
-                  << "  \"nrows\": " << equations.size()
-                  << ", \"nparam1cols\": " << symbol_table.param_nbr()
-                  << ", \"nparam2cols\": " << symbol_table.param_nbr()
-                  << ", \"entries\": [";
+        output << "{\"row\": " << eq + 1;
+      output << ", \"var_col\": " << var_col + 1
+             << ", \"param_col\": " << param_col + 1
+             << ", \"val\": \"";
+      d2->writeJsonOutput(output, params_derivs_temporary_terms, tef_terms);
+      output << "\"}" << endl;
+    }
+  output << "]}";
+
+  output << ", \"second_deriv_residuals_wrt_params\": {"
+         << "  \"nrows\": " << equations.size()
+         << ", \"nparam1cols\": " << symbol_table.param_nbr()
+         << ", \"nparam2cols\": " << symbol_table.param_nbr()
+         << ", \"entries\": [";
   for (second_derivatives_t::const_iterator it = residuals_params_second_derivatives.begin();
        it != residuals_params_second_derivatives.end(); ++it)
     {
       if (it != residuals_params_second_derivatives.begin())
-        hessian1_output << ", ";
+        output << ", ";
 
       int eq = it->first.first;
       int param1 = it->first.second.first;
@@ -5817,29 +6294,29 @@ DynamicModel::writeJsonParamsDerivativesFile(ostream &output, bool writeDetails)
       int param2_col = symbol_table.getTypeSpecificID(getSymbIDByDerivID(param2)) + 1;
 
       if (writeDetails)
-        hessian1_output << "{\"eq\": " << eq + 1
-                        << ", \"param1\": \"" << symbol_table.getName(getSymbIDByDerivID(param1)) << "\""
-                        << ", \"param2\": \"" << symbol_table.getName(getSymbIDByDerivID(param2)) << "\"";
+        output << "{\"eq\": " << eq + 1
+               << ", \"param1\": \"" << symbol_table.getName(getSymbIDByDerivID(param1)) << "\""
+               << ", \"param2\": \"" << symbol_table.getName(getSymbIDByDerivID(param2)) << "\"";
       else
-        hessian1_output << "{\"row\": " << eq + 1;
-      hessian1_output << ", \"param1_col\": " << param1_col + 1
-                      << ", \"param2_col\": " << param2_col + 1
-                      << ", \"val\": \"";
-      d2->writeJsonOutput(hessian1_output, params_derivs_temporary_terms, tef_terms);
-      hessian1_output << "\"}" << endl;
-    }
-  hessian1_output << "]}";
-  third_derivs_output << "\"second_deriv_jacobian_wrt_params\": {"
-                      << "  \"neqs\": " << equations.size()
-                      << ", \"nvarcols\": " << dynJacobianColsNbr
-                      << ", \"nparam1cols\": " << symbol_table.param_nbr()
-                      << ", \"nparam2cols\": " << symbol_table.param_nbr()
-                      << ", \"entries\": [";
+        output << "{\"row\": " << eq + 1;
+      output << ", \"param1_col\": " << param1_col + 1
+             << ", \"param2_col\": " << param2_col + 1
+             << ", \"val\": \"";
+      d2->writeJsonOutput(output, params_derivs_temporary_terms, tef_terms);
+      output << "\"}" << endl;
+    }
+  output << "]}";
+  output << ", \"second_deriv_jacobian_wrt_params\": {"
+         << "  \"neqs\": " << equations.size()
+         << ", \"nvarcols\": " << dynJacobianColsNbr
+         << ", \"nparam1cols\": " << symbol_table.param_nbr()
+         << ", \"nparam2cols\": " << symbol_table.param_nbr()
+         << ", \"entries\": [";
   for (third_derivatives_t::const_iterator it = jacobian_params_second_derivatives.begin();
        it != jacobian_params_second_derivatives.end(); ++it)
     {
       if (it != jacobian_params_second_derivatives.begin())
-        third_derivs_output << ", ";
+        output << ", ";
 
       int eq = it->first.first;
       int var = it->first.second.first;
@@ -5852,33 +6329,33 @@ DynamicModel::writeJsonParamsDerivativesFile(ostream &output, bool writeDetails)
       int param2_col = symbol_table.getTypeSpecificID(getSymbIDByDerivID(param2)) + 1;
 
       if (writeDetails)
-        third_derivs_output << "{\"eq\": " << eq + 1
-                            << ", \"var\": \"" << symbol_table.getName(var) << "\""
-                            << ", \"lag\": " << getLagByDerivID(var)
-                            << ", \"param1\": \"" << symbol_table.getName(getSymbIDByDerivID(param1)) << "\""
-                            << ", \"param2\": \"" << symbol_table.getName(getSymbIDByDerivID(param2)) << "\"";
+        output << "{\"eq\": " << eq + 1
+               << ", \"var\": \"" << symbol_table.getName(var) << "\""
+               << ", \"lag\": " << getLagByDerivID(var)
+               << ", \"param1\": \"" << symbol_table.getName(getSymbIDByDerivID(param1)) << "\""
+               << ", \"param2\": \"" << symbol_table.getName(getSymbIDByDerivID(param2)) << "\"";
       else
-        third_derivs_output << "{\"row\": " << eq + 1;
-      third_derivs_output << ", \"var_col\": " << var_col + 1
-                          << ", \"param1_col\": " << param1_col + 1
-                          << ", \"param2_col\": " << param2_col + 1
-                          << ", \"val\": \"";
-      d2->writeJsonOutput(third_derivs_output, params_derivs_temporary_terms, tef_terms);
-      third_derivs_output << "\"}" << endl;
-    }
-  third_derivs_output << "]}" << endl;
-
-  third_derivs1_output << "\"derivative_hessian_wrt_params\": {"
-                       << "  \"neqs\": " << equations.size()
-                       << ", \"nvar1cols\": " << dynJacobianColsNbr
-                       << ", \"nvar2cols\": " << dynJacobianColsNbr
-                       << ", \"nparamcols\": " << symbol_table.param_nbr()
-                       << ", \"entries\": [";
+        output << "{\"row\": " << eq + 1;
+      output << ", \"var_col\": " << var_col + 1
+             << ", \"param1_col\": " << param1_col + 1
+             << ", \"param2_col\": " << param2_col + 1
+             << ", \"val\": \"";
+      d2->writeJsonOutput(output, params_derivs_temporary_terms, tef_terms);
+      output << "\"}" << endl;
+    }
+  output << "]}" << endl;
+
+  output << ", \"derivative_hessian_wrt_params\": {"
+         << "  \"neqs\": " << equations.size()
+         << ", \"nvar1cols\": " << dynJacobianColsNbr
+         << ", \"nvar2cols\": " << dynJacobianColsNbr
+         << ", \"nparamcols\": " << symbol_table.param_nbr()
+         << ", \"entries\": [";
   for (third_derivatives_t::const_iterator it = hessian_params_derivatives.begin();
        it != hessian_params_derivatives.end(); ++it)
     {
       if (it != hessian_params_derivatives.begin())
-        third_derivs1_output << ", ";
+        output << ", ";
 
       int eq = it->first.first;
       int var1 = it->first.second.first;
@@ -5891,33 +6368,22 @@ DynamicModel::writeJsonParamsDerivativesFile(ostream &output, bool writeDetails)
       int param_col = symbol_table.getTypeSpecificID(getSymbIDByDerivID(param)) + 1;
 
       if (writeDetails)
-        third_derivs1_output << "{\"eq\": " << eq + 1
-                             << ", \"var1\": \"" << symbol_table.getName(getSymbIDByDerivID(var1)) << "\""
-                             << ", \"lag1\": " << getLagByDerivID(var1)
-                             << ", \"var2\": \"" << symbol_table.getName(getSymbIDByDerivID(var2)) << "\""
-                             << ", \"lag2\": " << getLagByDerivID(var2)
-                             << ", \"param\": \"" << symbol_table.getName(getSymbIDByDerivID(param)) << "\"";
+        output << "{\"eq\": " << eq + 1
+               << ", \"var1\": \"" << symbol_table.getName(getSymbIDByDerivID(var1)) << "\""
+               << ", \"lag1\": " << getLagByDerivID(var1)
+               << ", \"var2\": \"" << symbol_table.getName(getSymbIDByDerivID(var2)) << "\""
+               << ", \"lag2\": " << getLagByDerivID(var2)
+               << ", \"param\": \"" << symbol_table.getName(getSymbIDByDerivID(param)) << "\"";
       else
-        third_derivs1_output << "{\"row\": " << eq + 1;
-      third_derivs1_output << ", \"var1_col\": " << var1_col + 1
-                           << ", \"var2_col\": " << var2_col + 1
-                           << ", \"param_col\": " << param_col + 1
-                           << ", \"val\": \"";
-      d2->writeJsonOutput(third_derivs1_output, params_derivs_temporary_terms, tef_terms);
-      third_derivs1_output << "\"}" << endl;
+        output << "{\"row\": " << eq + 1;
+      output << ", \"var1_col\": " << var1_col + 1
+             << ", \"var2_col\": " << var2_col + 1
+             << ", \"param_col\": " << param_col + 1
+             << ", \"val\": \"";
+      d2->writeJsonOutput(output, params_derivs_temporary_terms, tef_terms);
+      output << "\"}" << endl;
     }
-  third_derivs1_output << "]}" << endl;
+  output << "]}" << endl;
 
-  if (writeDetails)
-    output << "\"dynamic_model_params_derivative_details\": {";
-  else
-    output << "\"dynamic_model_params_derivatives\": {";
-  output << model_local_vars_output.str()
-         << ", " << model_output.str()
-         << ", " << jacobian_output.str()
-         << ", " << hessian_output.str()
-         << ", " << hessian1_output.str()
-         << ", " << third_derivs_output.str()
-         << ", " << third_derivs1_output.str()
-         << "}";
+  output << "}";
 }
@@ -44,10 +44,15 @@ private:
   deriv_id_table_t deriv_id_table;
   //! Maps a deriv ID to a pair (symbol_id, lag)
   vector<pair<int, int> > inv_deriv_id_table;
+  //! Dense version of deriv_id_table, used by getDerivID()
+  /*! Built at the end of computeDerivIDs(). The deriv ID of (symb_id, lag) is at index
+    symb_id*deriv_id_index_nb_lags+lag-deriv_id_index_min_lag, -1 if there is none */
+  vector<int> deriv_id_index;
+  int deriv_id_index_min_lag, deriv_id_index_nb_lags;
 
-  //! Maps a deriv_id to the column index of the dynamic Jacobian
+  //! Maps a deriv_id to the column index of the dynamic Jacobian, -1 if there is none
   /*! Contains only endogenous, exogenous and exogenous deterministic */
-  map<int, int> dyn_jacobian_cols_table;
+  vector<int> dyn_jacobian_cols_table;
 
   //! Maximum lag and lead over all types of variables (positive values)
   /*! Set by computeDerivIDs() */
@@ -62,12 +67,25 @@ private:
   /*! Set by computeDerivIDs() */
   int max_exo_det_lag, max_exo_det_lead;
 
+  //! Cross references for one type of symbol, in compressed sparse row form
+  /*! The (symbol ID, lag) pairs used by equation eq are refs[ref_ptr[eq]] to refs[ref_ptr[eq+1]-1].
+    The reverse references are indexed in the same way: keys contains the pairs used in the model,
+    and the equations using keys[k] are eqs[eq_ptr[k]] to eqs[eq_ptr[k+1]-1]. All the ranges are sorted. */
+  struct XrefIndex
+  {
+    vector<int> ref_ptr;
+    vector<pair<int, int> > refs;
+    vector<pair<int, int> > keys;
+    vector<int> eq_ptr;
+    vector<int> eqs;
+    //! Fills the forward references from the cross reference information of each equation
+    void fill(const vector<ExprNode::EquationInfo> &infos, set<pair<int, int> > ExprNode::EquationInfo::*field);
+    //! Returns the position of a (symbol ID, lag) pair in keys, or -1 if no equation uses it
+    int findKey(int symb_id, int lag) const;
+  };
+
   //! Cross reference information
-  map<int, ExprNode::EquationInfo> xrefs;
-  map<pair<int, int>, set<int> > xref_param;
-  map<pair<int, int>, set<int> > xref_endo;
-  map<pair<int, int>, set<int> > xref_exo;
-  map<pair<int, int>, set<int> > xref_exo_det;
+  XrefIndex xref_param, xref_endo, xref_exo, xref_exo_det;
 
   //! Number of columns of dynamic jacobian
   /*! Set by computeDerivID()s and computeDynJacobianCols() */
@@ -93,6 +111,20 @@ private:
   //! Writes the dynamic model equations and its derivatives
   /*! \todo add third derivatives handling in C output */
   void writeDynamicModel(ostream &DynamicOutput, bool use_dll, bool julia) const;
+  //! Writes the Dynamic() C function as a sequence of calls to functions of at most c_chunk_size statements
+  /*! The temporary terms and model local variables are stored in a workspace array shared by those functions.
+    The arguments are the outputs of the residuals and of the derivatives of each order, as computed by writeDynamicModel() */
+  void writeDynamicCChunkedModel(ostream &DynamicOutput, const string &model_local_vars_output, const string &model_output,
+                                 const string &jacobian_output, const string &hessian_output, const string &third_derivatives_output) const;
+  //! Computes the 1-based position of each element of the Jacobian in compressed sparse column order, indexed by (column, equation)
+  void computeJacobianCSCIndex(map<pair<int, int>, int> &csc_index) const;
+  //! Writes the sparsity pattern of the Jacobian, for the sparse_jacobian option
+  /*! In MATLAB, initializes the persistent g1_i and g1_j vectors of row and column indices; in C, defines
+    the Dynamic_g1_nnz, Dynamic_g1_jc and Dynamic_g1_ir constants (0-based, in the mxArray convention) */
+  void writeSparseJacobianPattern(ostream &output, ExprNodeOutputType output_type, const map<pair<int, int>, int> &csc_index) const;
+  //! Writes the Dynamic_batch() C function, computing the residuals and the Jacobian at several points at once
+  void writeDynamicCBatchedModel(ostream &DynamicOutput, const string &model_local_vars_output, const string &model_output,
+                                 const string &jacobian_output) const;
   //! Writes the Block reordred structure of the model in M output
   void writeModelEquationsOrdered_M(const string &dynamic_basename) const;
   //! Writes the code of the Block reordred structure of the model in virtual machine bytecode
@@ -117,6 +149,10 @@ private:
 
   //! sorts the temporary terms in the blocks order
   void computeTemporaryTermsOrdered();
+  //! Collects the temporary terms used by a block
+  void collectBlockTemporaryTerms(unsigned int block);
+  //! Thread function for runBlockThreads
+  static void *collectTemporaryTermsThread(void *arg);
 
   //! creates a mapping from the index of temporary terms to a natural index
   void computeTemporaryTermsMapping();
@@ -162,6 +198,12 @@ private:
   //! Indicate if the temporary terms are computed for the overall model (true) or not (false). Default value true
   bool global_temporary_terms;
 
+  //! Maximum number of statements per C function in the use_dll dynamic file (0 means no limit)
+  int c_chunk_size;
+
+  //! Whether the MATLAB and C dynamic files return the Jacobian as a sparse matrix
+  bool sparse_jacobian;
+
   //! Vector describing equations: BlockSimulationType, if BlockSimulationType == EVALUATE_s then a expr_t on the new normalized equation
   equation_type_and_normalized_equation_t equation_type_and_normalized_equation;
 
@@ -196,11 +238,22 @@ private:
   /*! pair< pair<static, forward>, pair<backward,mixed> > */
   vector<pair< pair<int, int>, pair<int, int> > > block_col_type;
 
-  //! Help computeXrefs to compute the reverse references (i.e. param->eqs, endo->eqs, etc)
-  void computeRevXref(map<pair<int, int>, set<int> > &xrefset, const set<pair<int, int> > &eiref, int eqn);
+  //! Arguments of computeXrefsThread
+  struct XrefsThreadArg
+  {
+    const vector<BinaryOpNode *> *equations;
+    vector<ExprNode::EquationInfo> *infos;
+    size_t first, last;
+  };
+  //! Computes the cross reference information of a range of equations
+  static void *computeXrefsThread(void *arg);
 
+  //! Write forward cross references of an equation
+  void writeXrefs(ostream &output, const XrefIndex &xref, int eq, const string &type) const;
   //! Write reverse cross references
-  void writeRevXrefs(ostream &output, const map<pair<int, int>, set<int> > &xrefmap, const string &type) const;
+  void writeRevXrefs(ostream &output, const XrefIndex &xref, const string &type) const;
+  //! Write reverse cross references in JSON
+  void writeJsonRevXrefs(ostream &output, const XrefIndex &xref, const string &type) const;
 
   //! List for each variable its block number and its maximum lag and lead inside the block
   vector<pair<int, pair<int, int> > > variable_block_lead_lag;
@@ -216,9 +269,22 @@ public:
   /*! This implementation allows for non-zero lag */
   virtual VariableNode *AddVariable(int symb_id, int lag = 0);
 
+  //! Sets the maximum number of statements per C function in the use_dll dynamic file (0 means no limit)
+  void setCChunkSize(int c_chunk_size_arg);
+  //! Sets whether the MATLAB and C dynamic files return the Jacobian as a sparse matrix
+  /*! The sparsity pattern is written once in the file, and only the nonzero elements are computed:
+    the MATLAB function returns a sparse matrix, the C function fills the values of the nonzero
+    elements in compressed sparse column order (the pattern is exported as Dynamic_g1_jc and Dynamic_g1_ir) */
+  void setSparseJacobian(bool sparse_jacobian_arg);
+
   //! Compute cross references
+  /*! The equations are walked in parallel when pthreads are available */
   void computeXrefs();
 
+  //! Returns the equations (numbered from 0) in which a symbol appears with a given lag
+  /*! Parameters always have a zero lag. Must be called after computeXrefs() */
+  void getXrefEquations(int symb_id, int lag, vector<int> &eqs) const;
+
   //! Write cross references
   void writeXrefs(ostream &output) const;
 
@@ -530,6 +596,10 @@ public:
   void writeThirdDerivativesC_csr(const string &basename, bool cuda) const;
 
   bool isChecksumMatching(const string &basename) const;
+
+  //! Computes a checksum of the equations, equation tags and model local variables
+  /*! Contrary to isChecksumMatching(), does not depend on temporary terms, and can therefore be called before computingPass() */
+  unsigned int computeChecksum() const;
 };
 
 inline bool
@@ -90,7 +90,7 @@ class ParsingDriver;
 %token BVAR_PRIOR_DECAY BVAR_PRIOR_FLAT BVAR_PRIOR_LAMBDA INTERACTIVE SCREEN_SHOCKS STEADYSTATE
 %token BVAR_PRIOR_MU BVAR_PRIOR_OMEGA BVAR_PRIOR_TAU BVAR_PRIOR_TRAIN DETAIL_PLOT TYPE
 %token BVAR_REPLIC BYTECODE ALL_VALUES_REQUIRED PROPOSAL_DISTRIBUTION REALTIME VINTAGE
-%token CALIB_SMOOTHER CHANGE_TYPE CHECK CONDITIONAL_FORECAST CONDITIONAL_FORECAST_PATHS CONF_SIG CONSTANT CONTROLLED_VAREXO CORR COVAR CUTOFF CYCLE_REDUCTION LOGARITHMIC_REDUCTION
+%token CALIB_SMOOTHER CHANGE_TYPE CHECK COMPACT_LAGS CONDITIONAL_FORECAST CONDITIONAL_FORECAST_PATHS CONF_SIG CONSTANT CONTROLLED_VAREXO CORR COVAR CUTOFF CYCLE_REDUCTION LOGARITHMIC_REDUCTION
 %token CONSIDER_ALL_ENDOGENOUS CONSIDER_ONLY_OBSERVED INITIAL_CONDITION_DECOMPOSITION
 %token DATAFILE FILE SERIES DOUBLING DR_CYCLE_REDUCTION_TOL DR_LOGARITHMIC_REDUCTION_TOL DR_LOGARITHMIC_REDUCTION_MAXITER DR_ALGO DROP DSAMPLE DYNASAVE DYNATYPE CALIBRATION DIFFERENTIATE_FORWARD_VARS
 %token END ENDVAL EQUAL ESTIMATION ESTIMATED_PARAMS ESTIMATED_PARAMS_BOUNDS ESTIMATED_PARAMS_INIT EXTENDED_PATH ENDOGENOUS_PRIOR
@@ -124,9 +124,9 @@ class ParsingDriver;
 %token QZ_CRITERIUM QZ_ZERO_THRESHOLD FULL DSGE_VAR DSGE_VARLAG DSGE_PRIOR_WEIGHT TRUNCATE
 %token RELATIVE_IRF REPLIC SIMUL_REPLIC RPLOT SAVE_PARAMS_AND_STEADY_STATE PARAMETER_UNCERTAINTY
 %token SHOCKS SHOCK_DECOMPOSITION SHOCK_GROUPS USE_SHOCK_GROUPS SIGMA_E SIMUL SIMUL_ALGO SIMUL_SEED ENDOGENOUS_TERMINAL_PERIOD
-%token SMOOTHER SMOOTHER2HISTVAL SQUARE_ROOT_SOLVER STACK_SOLVE_ALGO STEADY_STATE_MODEL SOLVE_ALGO SOLVER_PERIODS ROBUST_LIN_SOLVE
+%token SMOOTHER SMOOTHER2HISTVAL SQRT_KALMAN_FILTER SQUARE_ROOT_SOLVER STACK_SOLVE_ALGO STEADY_STATE_MODEL SOLVE_ALGO SOLVER_PERIODS ROBUST_LIN_SOLVE SIMPLIFIED_NEWTON SPARSE_BACKEND
 %token STDERR STEADY STOCH_SIMUL SURPRISE SYLVESTER SYLVESTER_FIXED_POINT_TOL REGIMES REGIME REALTIME_SHOCK_DECOMPOSITION
-%token TEX RAMSEY_MODEL RAMSEY_POLICY RAMSEY_CONSTRAINTS PLANNER_DISCOUNT DISCRETIONARY_POLICY DISCRETIONARY_TOL
+%token TEX RAMSEY_MODEL RAMSEY_POLICY RAMSEY_CONSTRAINTS PLANNER_DISCOUNT DISCRETIONARY_POLICY DISCRETIONARY_TOL ANDERSON_DEPTH
 %token <string_val> TEX_NAME
 %token UNIFORM_PDF UNIT_ROOT_VARS USE_DLL USEAUTOCORR GSA_SAMPLE_FILE USE_UNIVARIATE_FILTERS_IF_SINGULARITY_IS_DETECTED
 %token VALUES VAR VAREXO VAREXO_DET VAROBS PREDETERMINED_VARIABLES PLOT_SHOCK_DECOMPOSITION
@@ -689,6 +689,7 @@ model_options : BLOCK { driver.block(); }
               | BYTECODE { driver.byte_code(); }
               | USE_DLL { driver.use_dll(); }
               | NO_STATIC { driver.no_static();}
+              | COMPACT_LAGS { driver.compact_lags(); }
               | DIFFERENTIATE_FORWARD_VARS { driver.differentiate_forward_vars_all(); }
               | DIFFERENTIATE_FORWARD_VARS EQUAL '(' symbol_list ')' { driver.differentiate_forward_vars_some(); }
               | o_linear
@@ -1066,6 +1067,8 @@ perfect_foresight_solver_options : o_stack_solve_algo
                                  | o_no_homotopy
                                  | o_solve_algo
                                  | o_robust_lin_solve
+                                 | o_simplified_newton
+                                 | o_sparse_backend
 				 | o_lmmcp
 				 | o_occbin
                                  | o_pf_tolf
@@ -1767,6 +1770,7 @@ estimation_options : o_datafile
                    | o_contemporaneous_correlation
                    | o_filtered_vars
                    | o_fast_kalman_filter
+                   | o_sqrt_kalman_filter
                    | o_kalman_algo
                    | o_kalman_tol
 		   | o_diffuse_kalman_tol
@@ -2092,6 +2096,7 @@ discretionary_policy_options_list : discretionary_policy_options_list COMMA disc
 discretionary_policy_options : ramsey_policy_options 
                              | o_discretionary_tol;
                              | o_dp_maxit;
+                             | o_dp_anderson_depth;
                              ;
 
 ramsey_model_options_list : ramsey_model_options_list COMMA ramsey_model_options
@@ -2817,6 +2822,8 @@ o_simul_algo : SIMUL_ALGO EQUAL INT_NUMBER {
                                            };
 o_stack_solve_algo : STACK_SOLVE_ALGO EQUAL INT_NUMBER { driver.option_num("stack_solve_algo", $3); };
 o_robust_lin_solve : ROBUST_LIN_SOLVE { driver.option_num("simul.robust_lin_solve", "1"); };
+o_simplified_newton : SIMPLIFIED_NEWTON EQUAL INT_NUMBER { driver.option_num("simul.simplified_newton", $3); };
+o_sparse_backend : SPARSE_BACKEND EQUAL symbol { driver.option_str("simul.sparse_backend", $3); };
 o_endogenous_terminal_period : ENDOGENOUS_TERMINAL_PERIOD { driver.option_num("endogenous_terminal_period", "1"); };
 o_linear : LINEAR { driver.linear(); };
 o_order : ORDER EQUAL INT_NUMBER { driver.option_num("order", $3); };
@@ -2845,6 +2852,7 @@ o_bandpass_filter : BANDPASS_FILTER { driver.option_num("bandpass.indicator", "1
                     }
                    ;
 o_dp_maxit : MAXIT EQUAL INT_NUMBER { driver.option_num("dp.maxit", $3); };
+o_dp_anderson_depth : ANDERSON_DEPTH EQUAL INT_NUMBER { driver.option_num("dp.anderson_depth", $3); };
 o_osr_maxit : MAXIT EQUAL INT_NUMBER { driver.option_num("osr.maxit", $3); };
 o_osr_tolf : TOLF EQUAL non_negative_number { driver.option_num("osr.tolf", $3); };
 o_pf_tolf : TOLF EQUAL non_negative_number { driver.option_num("dynatol.f", $3); };
@@ -2998,6 +3006,7 @@ o_contemporaneous_correlation : CONTEMPORANEOUS_CORRELATION { driver.option_num(
 o_filtered_vars : FILTERED_VARS { driver.option_num("filtered_vars", "1"); };
 o_relative_irf : RELATIVE_IRF { driver.option_num("relative_irf", "1"); };
 o_fast_kalman_filter : FAST_KALMAN_FILTER  { driver.option_num("fast_kalman_filter", "1"); };
+o_sqrt_kalman_filter : SQRT_KALMAN_FILTER  { driver.option_num("sqrt_kalman_filter", "1"); };
 o_kalman_algo : KALMAN_ALGO EQUAL INT_NUMBER { driver.option_num("kalman_algo", $3); };
 o_kalman_tol : KALMAN_TOL EQUAL non_negative_number { driver.option_num("kalman_tol", $3); };
 o_diffuse_kalman_tol : DIFFUSE_KALMAN_TOL EQUAL non_negative_number { driver.option_num("diffuse_kalman_tol", $3); };
@@ -31,6 +31,7 @@
 #include "ParsingDriver.hh"
 #include "ExtendedPreprocessorTypes.hh"
 #include "ConfigFile.hh"
+#include "Profiler.hh"
 
 /* Prototype for second part of main function
    Splitting main() in two parts was necessary because ParsingDriver.h and MacroDriver.h can't be
@@ -45,7 +46,8 @@ void main2(stringstream &in, string &basename, bool debug, bool clear_all, bool
 #if defined(_WIN32) || defined(__CYGWIN32__) || defined(__MINGW32__)
            , bool cygwin, bool msvc, bool mingw
 #endif
-           , JsonOutputPointType json, JsonFileOutputType json_output_mode, bool onlyjson, bool jsonprintderivdetail
+           , JsonOutputPointType json, JsonFileOutputType json_output_mode, bool onlyjson, bool jsonprintderivdetail,
+           Profiler &profiler, int c_chunk_size, bool c_batch, bool sparse_jacobian, bool model_ir
            );
 
 void main1(char *modfile, string &basename, bool debug, bool save_macro, string &save_macro_file,
@@ -58,11 +60,11 @@ usage()
   cerr << "Dynare usage: dynare mod_file [debug] [noclearall] [onlyclearglobals] [savemacro[=macro_file]] [onlymacro] [nolinemacro] [notmpterms] [nolog] [warn_uninit]"
        << " [console] [nograph] [nointeractive] [parallel[=cluster_name]] [conffile=parallel_config_path_and_filename] [parallel_slave_open_mode] [parallel_test]"
        << " [-D<variable>[=<value>]] [-I/path] [nostrict] [fast] [minimal_workspace] [compute_xrefs] [output=dynamic|first|second|third] [language=C|C++|julia]"
-       << " [params_derivs_order=0|1|2]"
+       << " [params_derivs_order=0|1|2] [c_chunk_size=INTEGER] [c_batch] [sparse_jacobian] [model_ir]"
 #if defined(_WIN32) || defined(__CYGWIN32__) || defined(__MINGW32__)
        << " [cygwin] [msvc] [mingw]"
 #endif
-       << "[json=parse|check|transform|compute] [jsonstdout] [onlyjson] [jsonprintderivdetail]"
+       << "[json=parse|check|transform|compute] [jsonstdout] [jsoncbor] [onlyjson] [jsonprintderivdetail] [profile]"
        << endl;
   exit(EXIT_FAILURE);
 }
@@ -94,6 +96,10 @@ main(int argc, char **argv)
   bool no_log = false;
   bool no_warn = false;
   int params_derivs_order = 2;
+  int c_chunk_size = 0;
+  bool c_batch = false;
+  bool sparse_jacobian = false;
+  bool model_ir = false;
   bool warn_uninit = false;
   bool console = false;
   bool nograph = false;
@@ -119,6 +125,7 @@ main(int argc, char **argv)
   JsonFileOutputType json_output_mode = file;
   bool onlyjson = false;
   bool jsonprintderivdetail = false;
+  bool profile = false;
   LanguageOutputType language = matlab;
 
   // Parse options
@@ -138,6 +145,21 @@ main(int argc, char **argv)
             }
           params_derivs_order = atoi(argv[arg] + 20);
         }
+      else if (strlen(argv[arg]) >= 12 && !strncmp(argv[arg], "c_chunk_size", 12))
+        {
+          if (strlen(argv[arg]) == 12 || argv[arg][12] != '=' || atoi(argv[arg] + 13) <= 0)
+            {
+              cerr << "Incorrect syntax for c_chunk_size option" << endl;
+              usage();
+            }
+          c_chunk_size = atoi(argv[arg] + 13);
+        }
+      else if (!strcmp(argv[arg], "c_batch"))
+        c_batch = true;
+      else if (!strcmp(argv[arg], "sparse_jacobian"))
+        sparse_jacobian = true;
+      else if (!strcmp(argv[arg], "model_ir"))
+        model_ir = true;
       else if (!strcmp(argv[arg], "onlyclearglobals"))
         {
           clear_all = false;
@@ -299,8 +321,12 @@ main(int argc, char **argv)
         }
       else if (!strcmp(argv[arg], "jsonstdout"))
         json_output_mode = standardout;
+      else if (!strcmp(argv[arg], "jsoncbor"))
+        json_output_mode = cborfile;
       else if (!strcmp(argv[arg], "onlyjson"))
         onlyjson = true;
+      else if (!strcmp(argv[arg], "profile"))
+        profile = true;
       else if (!strcmp(argv[arg], "jsonprintderivdetail"))
         jsonprintderivdetail = true;
       else if (strlen(argv[arg]) >= 4 && !strncmp(argv[arg], "json", 4))
@@ -355,9 +381,12 @@ main(int argc, char **argv)
        it != config_include_paths.end(); it++)
     path.push_back(*it);
 
+  Profiler profiler(profile);
+
   // Do macro processing
   stringstream macro_output;
   main1(argv[1], basename, debug, save_macro, save_macro_file, no_line_macro, defines, path, macro_output);
+  profiler.endPhase("macroprocessing");
 
   if (only_macro)
     return EXIT_SUCCESS;
@@ -370,7 +399,7 @@ main(int argc, char **argv)
 #if defined(_WIN32) || defined(__CYGWIN32__) || defined(__MINGW32__)
         , cygwin, msvc, mingw
 #endif
-        , json, json_output_mode, onlyjson, jsonprintderivdetail
+        , json, json_output_mode, onlyjson, jsonprintderivdetail, profiler, c_chunk_size, c_batch, sparse_jacobian, model_ir
         );
 
   return EXIT_SUCCESS;
@@ -23,6 +23,7 @@
 #include "ModFile.hh"
 #include "ConfigFile.hh"
 #include "ExtendedPreprocessorTypes.hh"
+#include "Profiler.hh"
 
 void
 main2(stringstream &in, string &basename, bool debug, bool clear_all, bool clear_global,
@@ -34,33 +35,59 @@ main2(stringstream &in, string &basename, bool debug, bool clear_all, bool clear
 #if defined(_WIN32) || defined(__CYGWIN32__) || defined(__MINGW32__)
       , bool cygwin, bool msvc, bool mingw
 #endif
-      , JsonOutputPointType json, JsonFileOutputType json_output_mode, bool onlyjson, bool jsonprintderivdetail
+      , JsonOutputPointType json, JsonFileOutputType json_output_mode, bool onlyjson, bool jsonprintderivdetail,
+      Profiler &profiler, int c_chunk_size, bool c_batch, bool sparse_jacobian, bool model_ir
       )
 {
   ParsingDriver p(warnings, nostrict);
 
   // Do parsing and construct internal representation of mod file
   ModFile *mod_file = p.parse(in, debug);
+  profiler.endPhase("parsing", mod_file->dynamic_model.node_number());
+  mod_file->dynamic_model.setCChunkSize(c_chunk_size);
+  if (c_batch && mod_file->external_functions_table.get_total_number_of_unique_model_block_external_functions())
+    {
+      warnings << "WARNING: the c_batch option is ignored, since the model calls external functions" << endl;
+      c_batch = false;
+    }
+  if (sparse_jacobian && (mod_file->block || mod_file->byte_code))
+    {
+      warnings << "WARNING: the sparse_jacobian option is ignored, since it is incompatible with the block and bytecode options" << endl;
+      sparse_jacobian = false;
+    }
+  mod_file->dynamic_model.setSparseJacobian(sparse_jacobian);
+  // The batched dynamic C function evaluates dense Jacobians
+  mod_file->dynamic_model.setCBatch(c_batch && !sparse_jacobian);
+  mod_file->static_model.setCBatch(c_batch);
   if (json == parsing)
     mod_file->writeJsonOutput(basename, json, json_output_mode, onlyjson);
 
   // Run checking pass
   mod_file->checkPass(nostrict);
+  profiler.endPhase("checkpass", mod_file->dynamic_model.node_number());
   if (json == checkpass)
     mod_file->writeJsonOutput(basename, json, json_output_mode, onlyjson);
 
   // Perform transformations on the model (creation of auxiliary vars and equations)
   mod_file->transformPass(nostrict, compute_xrefs || json == transformpass);
+  profiler.endPhase("transformpass", mod_file->dynamic_model.node_number());
   if (json == transformpass)
     mod_file->writeJsonOutput(basename, json, json_output_mode, onlyjson);
 
   // Evaluate parameters initialization, initval, endval and pounds
   mod_file->evalAllExpressions(warn_uninit);
+  profiler.endPhase("evaluation");
 
   // Do computations
-  mod_file->computingPass(no_tmp_terms, output_mode, params_derivs_order);
+  /* With the fast option, derivatives are only recomputed if the model or
+     the options changed, unless they are needed for other outputs */
+  bool use_derivatives_cache = check_model_changes && output_mode == none && json != computingpass && !model_ir;
+  mod_file->computingPass(no_tmp_terms, output_mode, params_derivs_order, basename, use_derivatives_cache);
+  profiler.endPhase("computingpass", mod_file->dynamic_model.node_number(), mod_file->static_model.node_number());
   if (json == computingpass)
     mod_file->writeJsonOutput(basename, json, json_output_mode, onlyjson, jsonprintderivdetail);
+  if (model_ir)
+    mod_file->writeModelIR(basename);
 
   // Write outputs
   if (output_mode != none)
@@ -72,6 +99,8 @@ main2(stringstream &in, string &basename, bool debug, bool clear_all, bool clear
                                , cygwin, msvc, mingw
 #endif
                                );
+  profiler.endPhase("writing");
+  profiler.writeJsonOutput(basename);
 
   delete mod_file;
 
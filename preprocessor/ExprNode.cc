@@ -43,6 +43,22 @@ ExprNode::~ExprNode()
 {
 }
 
+void *
+ExprNode::operator new(size_t size, DataTree &datatree)
+{
+  return datatree.allocateNode(size);
+}
+
+void
+ExprNode::operator delete(void *p, DataTree &datatree)
+{
+}
+
+void
+ExprNode::operator delete(void *p)
+{
+}
+
 expr_t
 ExprNode::getDerivative(int deriv_id)
 {
@@ -50,22 +66,30 @@ ExprNode::getDerivative(int deriv_id)
     prepareForDerivation();
 
   // Return zero if derivative is necessarily null (using symbolic a priori)
-  set<int>::const_iterator it = non_null_derivatives.find(deriv_id);
-  if (it == non_null_derivatives.end())
+  const vector<int> &non_null_derivatives = datatree.nonNullDerivatives(idx);
+  if (!binary_search(non_null_derivatives.begin(), non_null_derivatives.end(), deriv_id))
     return datatree.Zero;
 
   // If derivative is stored in cache, use the cached value, otherwise compute it (and cache it)
-  map<int, expr_t>::const_iterator it2 = derivatives.find(deriv_id);
-  if (it2 != derivatives.end())
-    return it2->second;
+  DataTree::derivatives_cache_t::const_iterator it = datatree.derivatives_cache.find(make_pair(idx, deriv_id));
+  if (it != datatree.derivatives_cache.end())
+    return it->second;
   else
     {
       expr_t d = computeDerivative(deriv_id);
-      derivatives[deriv_id] = d;
+      datatree.derivatives_cache[make_pair(idx, deriv_id)] = d;
       return d;
     }
 }
 
+const vector<int> &
+ExprNode::getNonNullDerivatives()
+{
+  if (!preparedForDerivation)
+    prepareForDerivation();
+  return datatree.nonNullDerivatives(idx);
+}
+
 int
 ExprNode::precedence(ExprNodeOutputType output_type, const temporary_terms_t &temporary_terms) const
 {
@@ -139,9 +163,8 @@ ExprNode::computeTemporaryTerms(map<expr_t, pair<int, NodeTreeReference> > &refe
 }
 
 void
-ExprNode::computeTemporaryTerms(map<expr_t, int> &reference_count,
+ExprNode::computeTemporaryTerms(BlockReferenceCount &reference_count,
                                 temporary_terms_t &temporary_terms,
-                                map<expr_t, pair<int, int> > &first_occurence,
                                 int Curr_block,
                                 vector<vector<temporary_terms_t> > &v_temporary_terms,
                                 int equation) const
@@ -305,7 +328,7 @@ void
 NumConstNode::prepareForDerivation()
 {
   preparedForDerivation = true;
-  // All derivatives are null, so non_null_derivatives is left empty
+  // All derivatives are null, so the set of non-null derivatives is left empty
 }
 
 expr_t
@@ -357,6 +380,14 @@ NumConstNode::eval(const eval_context_t &eval_context) const throw (EvalExceptio
   return (datatree.num_constants.getDouble(id));
 }
 
+int
+NumConstNode::appendEvalInstruction(EvalProgram &program) const
+{
+  EvalProgram::Instruction instruction(EvalProgram::iConstant);
+  instruction.constant = datatree.num_constants.getDouble(id);
+  return program.appendInstruction(instruction);
+}
+
 void
 NumConstNode::compile(ostream &CompileCode, unsigned int &instruction_number,
                       bool lhs_rhs, const temporary_terms_t &temporary_terms,
@@ -559,7 +590,8 @@ VariableNode::prepareForDerivation()
 
   preparedForDerivation = true;
 
-  // Fill in non_null_derivatives
+  // Fill in the set of non-null derivatives
+  vector<int> &non_null_derivatives = datatree.nonNullDerivatives(idx);
   switch (type)
     {
     case eEndogenous:
@@ -569,12 +601,12 @@ VariableNode::prepareForDerivation()
     case eTrend:
     case eLogTrend:
       // For a variable or a parameter, the only non-null derivative is with respect to itself
-      non_null_derivatives.insert(datatree.getDerivID(symb_id, lag));
+      non_null_derivatives.push_back(datatree.getDerivID(symb_id, lag));
       break;
     case eModelLocalVariable:
       datatree.local_variables_table[symb_id]->prepareForDerivation();
       // Non null derivatives are those of the value of the local parameter
-      non_null_derivatives = datatree.local_variables_table[symb_id]->non_null_derivatives;
+      non_null_derivatives = datatree.nonNullDerivatives(datatree.local_variables_table[symb_id]->idx);
       break;
     case eModFileLocalVariable:
     case eStatementDeclaredVariable:
@@ -914,6 +946,14 @@ VariableNode::eval(const eval_context_t &eval_context) const throw (EvalExceptio
   return it->second;
 }
 
+int
+VariableNode::appendEvalInstruction(EvalProgram &program) const
+{
+  EvalProgram::Instruction instruction(EvalProgram::iVariable);
+  instruction.arg1 = symb_id;
+  return program.appendInstruction(instruction);
+}
+
 void
 VariableNode::compile(ostream &CompileCode, unsigned int &instruction_number,
                       bool lhs_rhs, const temporary_terms_t &temporary_terms,
@@ -989,15 +1029,14 @@ VariableNode::compile(ostream &CompileCode, unsigned int &instruction_number,
 }
 
 void
-VariableNode::computeTemporaryTerms(map<expr_t, int> &reference_count,
+VariableNode::computeTemporaryTerms(BlockReferenceCount &reference_count,
                                     temporary_terms_t &temporary_terms,
-                                    map<expr_t, pair<int, int> > &first_occurence,
                                     int Curr_block,
                                     vector<vector<temporary_terms_t> > &v_temporary_terms,
                                     int equation) const
 {
   if (type == eModelLocalVariable)
-    datatree.local_variables_table[symb_id]->computeTemporaryTerms(reference_count, temporary_terms, first_occurence, Curr_block, v_temporary_terms, equation);
+    datatree.local_variables_table[symb_id]->computeTemporaryTerms(reference_count, temporary_terms, Curr_block, v_temporary_terms, equation);
 }
 
 void
@@ -1060,8 +1099,8 @@ VariableNode::getChainRuleDerivative(int deriv_id, const map<int, expr_t> &recur
           map<int, expr_t>::const_iterator it = recursive_variables.find(datatree.getDerivID(symb_id, lag));
           if (it != recursive_variables.end())
             {
-              map<int, expr_t>::const_iterator it2 = derivatives.find(deriv_id);
-              if (it2 != derivatives.end())
+              DataTree::derivatives_cache_t::const_iterator it2 = datatree.derivatives_cache.find(make_pair(idx, deriv_id));
+              if (it2 != datatree.derivatives_cache.end())
                 return it2->second;
               else
                 {
@@ -1070,7 +1109,7 @@ VariableNode::getChainRuleDerivative(int deriv_id, const map<int, expr_t> &recur
                   //expr_t c = datatree.AddNonNegativeConstant("1");
                   expr_t d = datatree.AddUMinus(it->second->getChainRuleDerivative(deriv_id, recursive_vars2));
                   //d = datatree.AddTimes(c, d);
-                  derivatives[deriv_id] = d;
+                  datatree.derivatives_cache[make_pair(idx, deriv_id)] = d;
                   return d;
                 }
             }
@@ -1497,7 +1536,7 @@ VariableNode::removeTrendLeadLag(map<int, expr_t> trend_symbols_map) const
     return const_cast<VariableNode *>(this);
 
   map<int, expr_t>::const_iterator it = trend_symbols_map.find(symb_id);
-  expr_t noTrendLeadLagNode = new VariableNode(datatree, it->first, 0);
+  expr_t noTrendLeadLagNode = new (datatree) VariableNode(datatree, it->first, 0);
   bool log_trend = get_type() == eLogTrend;
   expr_t trend = it->second;
 
@@ -1566,10 +1605,15 @@ UnaryOpNode::prepareForDerivation()
   arg->prepareForDerivation();
 
   // Non-null derivatives are those of the argument (except for STEADY_STATE)
-  non_null_derivatives = arg->non_null_derivatives;
+  vector<int> &non_null_derivatives = datatree.nonNullDerivatives(idx);
+  non_null_derivatives = datatree.nonNullDerivatives(arg->idx);
   if (op_code == oSteadyState || op_code == oSteadyStateParamDeriv
       || op_code == oSteadyStateParam2ndDeriv)
-    datatree.addAllParamDerivId(non_null_derivatives);
+    {
+      set<int> deriv_id_set(non_null_derivatives.begin(), non_null_derivatives.end());
+      datatree.addAllParamDerivId(deriv_id_set);
+      non_null_derivatives.assign(deriv_id_set.begin(), deriv_id_set.end());
+    }
 }
 
 expr_t
@@ -1847,29 +1891,23 @@ UnaryOpNode::computeTemporaryTerms(map<expr_t, pair<int, NodeTreeReference> > &r
 }
 
 void
-UnaryOpNode::computeTemporaryTerms(map<expr_t, int> &reference_count,
+UnaryOpNode::computeTemporaryTerms(BlockReferenceCount &reference_count,
                                    temporary_terms_t &temporary_terms,
-                                   map<expr_t, pair<int, int> > &first_occurence,
                                    int Curr_block,
                                    vector< vector<temporary_terms_t> > &v_temporary_terms,
                                    int equation) const
 {
   expr_t this2 = const_cast<UnaryOpNode *>(this);
-  map<expr_t, int>::iterator it = reference_count.find(this2);
-  if (it == reference_count.end())
+  int count = reference_count.addReference(idx, Curr_block, equation);
+  if (count == 1)
     {
-      reference_count[this2] = 1;
-      first_occurence[this2] = make_pair(Curr_block, equation);
-      arg->computeTemporaryTerms(reference_count, temporary_terms, first_occurence, Curr_block, v_temporary_terms, equation);
+      arg->computeTemporaryTerms(reference_count, temporary_terms, Curr_block, v_temporary_terms, equation);
     }
-  else
+  else if (count * cost(temporary_terms, false) > MIN_COST_C)
     {
-      reference_count[this2]++;
-      if (reference_count[this2] * cost(temporary_terms, false) > MIN_COST_C)
-        {
-          temporary_terms.insert(this2);
-          v_temporary_terms[first_occurence[this2].first][first_occurence[this2].second].insert(this2);
-        }
+      temporary_terms.insert(this2);
+      const pair<int, int> &first_occurence = reference_count.getFirstOccurence(idx);
+      v_temporary_terms[first_occurence.first][first_occurence.second].insert(this2);
     }
 }
 
@@ -2303,6 +2341,15 @@ UnaryOpNode::eval(const eval_context_t &eval_context) const throw (EvalException
   return eval_opcode(op_code, v);
 }
 
+int
+UnaryOpNode::appendEvalInstruction(EvalProgram &program) const
+{
+  EvalProgram::Instruction instruction(EvalProgram::iUnaryOp);
+  instruction.op_code = op_code;
+  instruction.arg1 = program.addNode(arg);
+  return program.appendInstruction(instruction);
+}
+
 void
 UnaryOpNode::compile(ostream &CompileCode, unsigned int &instruction_number,
                      bool lhs_rhs, const temporary_terms_t &temporary_terms,
@@ -2805,12 +2852,11 @@ BinaryOpNode::prepareForDerivation()
   arg2->prepareForDerivation();
 
   // Non-null derivatives are the union of those of the arguments
-  // Compute set union of arg1->non_null_derivatives and arg2->non_null_derivatives
-  set_union(arg1->non_null_derivatives.begin(),
-            arg1->non_null_derivatives.end(),
-            arg2->non_null_derivatives.begin(),
-            arg2->non_null_derivatives.end(),
-            inserter(non_null_derivatives, non_null_derivatives.begin()));
+  const vector<int> &nnd1 = datatree.nonNullDerivatives(arg1->idx),
+    &nnd2 = datatree.nonNullDerivatives(arg2->idx);
+  vector<int> &non_null_derivatives = datatree.nonNullDerivatives(idx);
+  set_union(nnd1.begin(), nnd1.end(), nnd2.begin(), nnd2.end(),
+            back_inserter(non_null_derivatives));
 }
 
 expr_t
@@ -3146,31 +3192,25 @@ BinaryOpNode::computeTemporaryTerms(map<expr_t, pair<int, NodeTreeReference> > &
 }
 
 void
-BinaryOpNode::computeTemporaryTerms(map<expr_t, int> &reference_count,
+BinaryOpNode::computeTemporaryTerms(BlockReferenceCount &reference_count,
                                     temporary_terms_t &temporary_terms,
-                                    map<expr_t, pair<int, int> > &first_occurence,
                                     int Curr_block,
                                     vector<vector<temporary_terms_t> > &v_temporary_terms,
                                     int equation) const
 {
   expr_t this2 = const_cast<BinaryOpNode *>(this);
-  map<expr_t, int>::iterator it = reference_count.find(this2);
-  if (it == reference_count.end())
+  int count = reference_count.addReference(idx, Curr_block, equation);
+  if (count == 1)
     {
-      reference_count[this2] = 1;
-      first_occurence[this2] = make_pair(Curr_block, equation);
-      arg1->computeTemporaryTerms(reference_count, temporary_terms, first_occurence, Curr_block, v_temporary_terms, equation);
-      arg2->computeTemporaryTerms(reference_count, temporary_terms, first_occurence, Curr_block, v_temporary_terms, equation);
+      arg1->computeTemporaryTerms(reference_count, temporary_terms, Curr_block, v_temporary_terms, equation);
+      arg2->computeTemporaryTerms(reference_count, temporary_terms, Curr_block, v_temporary_terms, equation);
     }
-  else
+  else if (count * cost(temporary_terms, false) > MIN_COST_C
+           && op_code != oEqual)
     {
-      reference_count[this2]++;
-      if (reference_count[this2] * cost(temporary_terms, false) > MIN_COST_C
-          && op_code != oEqual)
-        {
-          temporary_terms.insert(this2);
-          v_temporary_terms[first_occurence[this2].first][first_occurence[this2].second].insert(this2);
-        }
+      temporary_terms.insert(this2);
+      const pair<int, int> &first_occurence = reference_count.getFirstOccurence(idx);
+      v_temporary_terms[first_occurence.first][first_occurence.second].insert(this2);
     }
 }
 
@@ -3239,6 +3279,17 @@ BinaryOpNode::eval(const eval_context_t &eval_context) const throw (EvalExceptio
   return eval_opcode(v1, op_code, v2, powerDerivOrder);
 }
 
+int
+BinaryOpNode::appendEvalInstruction(EvalProgram &program) const
+{
+  EvalProgram::Instruction instruction(EvalProgram::iBinaryOp);
+  instruction.op_code = op_code;
+  instruction.arg1 = program.addNode(arg1);
+  instruction.arg2 = program.addNode(arg2);
+  instruction.powerDerivOrder = powerDerivOrder;
+  return program.appendInstruction(instruction);
+}
+
 void
 BinaryOpNode::compile(ostream &CompileCode, unsigned int &instruction_number,
                       bool lhs_rhs, const temporary_terms_t &temporary_terms,
@@ -4268,18 +4319,16 @@ TrinaryOpNode::prepareForDerivation()
   arg3->prepareForDerivation();
 
   // Non-null derivatives are the union of those of the arguments
-  // Compute set union of arg{1,2,3}->non_null_derivatives
-  set<int> non_null_derivatives_tmp;
-  set_union(arg1->non_null_derivatives.begin(),
-            arg1->non_null_derivatives.end(),
-            arg2->non_null_derivatives.begin(),
-            arg2->non_null_derivatives.end(),
-            inserter(non_null_derivatives_tmp, non_null_derivatives_tmp.begin()));
-  set_union(non_null_derivatives_tmp.begin(),
-            non_null_derivatives_tmp.end(),
-            arg3->non_null_derivatives.begin(),
-            arg3->non_null_derivatives.end(),
-            inserter(non_null_derivatives, non_null_derivatives.begin()));
+  const vector<int> &nnd1 = datatree.nonNullDerivatives(arg1->idx),
+    &nnd2 = datatree.nonNullDerivatives(arg2->idx),
+    &nnd3 = datatree.nonNullDerivatives(arg3->idx);
+  vector<int> non_null_derivatives_tmp;
+  set_union(nnd1.begin(), nnd1.end(), nnd2.begin(), nnd2.end(),
+            back_inserter(non_null_derivatives_tmp));
+  vector<int> &non_null_derivatives = datatree.nonNullDerivatives(idx);
+  set_union(non_null_derivatives_tmp.begin(), non_null_derivatives_tmp.end(),
+            nnd3.begin(), nnd3.end(),
+            back_inserter(non_null_derivatives));
 }
 
 expr_t
@@ -4457,31 +4506,25 @@ TrinaryOpNode::computeTemporaryTerms(map<expr_t, pair<int, NodeTreeReference> >
 }
 
 void
-TrinaryOpNode::computeTemporaryTerms(map<expr_t, int> &reference_count,
+TrinaryOpNode::computeTemporaryTerms(BlockReferenceCount &reference_count,
                                      temporary_terms_t &temporary_terms,
-                                     map<expr_t, pair<int, int> > &first_occurence,
                                      int Curr_block,
                                      vector<vector<temporary_terms_t> > &v_temporary_terms,
                                      int equation) const
 {
   expr_t this2 = const_cast<TrinaryOpNode *>(this);
-  map<expr_t, int>::iterator it = reference_count.find(this2);
-  if (it == reference_count.end())
+  int count = reference_count.addReference(idx, Curr_block, equation);
+  if (count == 1)
     {
-      reference_count[this2] = 1;
-      first_occurence[this2] = make_pair(Curr_block, equation);
-      arg1->computeTemporaryTerms(reference_count, temporary_terms, first_occurence, Curr_block, v_temporary_terms, equation);
-      arg2->computeTemporaryTerms(reference_count, temporary_terms, first_occurence, Curr_block, v_temporary_terms, equation);
-      arg3->computeTemporaryTerms(reference_count, temporary_terms, first_occurence, Curr_block, v_temporary_terms, equation);
+      arg1->computeTemporaryTerms(reference_count, temporary_terms, Curr_block, v_temporary_terms, equation);
+      arg2->computeTemporaryTerms(reference_count, temporary_terms, Curr_block, v_temporary_terms, equation);
+      arg3->computeTemporaryTerms(reference_count, temporary_terms, Curr_block, v_temporary_terms, equation);
     }
-  else
+  else if (count * cost(temporary_terms, false) > MIN_COST_C)
     {
-      reference_count[this2]++;
-      if (reference_count[this2] * cost(temporary_terms, false) > MIN_COST_C)
-        {
-          temporary_terms.insert(this2);
-          v_temporary_terms[first_occurence[this2].first][first_occurence[this2].second].insert(this2);
-        }
+      temporary_terms.insert(this2);
+      const pair<int, int> &first_occurence = reference_count.getFirstOccurence(idx);
+      v_temporary_terms[first_occurence.first][first_occurence.second].insert(this2);
     }
 }
 
@@ -4509,6 +4552,17 @@ TrinaryOpNode::eval(const eval_context_t &eval_context) const throw (EvalExcepti
   return eval_opcode(v1, op_code, v2, v3);
 }
 
+int
+TrinaryOpNode::appendEvalInstruction(EvalProgram &program) const
+{
+  EvalProgram::Instruction instruction(EvalProgram::iTrinaryOp);
+  instruction.op_code = op_code;
+  instruction.arg1 = program.addNode(arg1);
+  instruction.arg2 = program.addNode(arg2);
+  instruction.arg3 = program.addNode(arg3);
+  return program.appendInstruction(instruction);
+}
+
 void
 TrinaryOpNode::compile(ostream &CompileCode, unsigned int &instruction_number,
                        bool lhs_rhs, const temporary_terms_t &temporary_terms,
@@ -4968,13 +5022,17 @@ AbstractExternalFunctionNode::prepareForDerivation()
   for (vector<expr_t>::const_iterator it = arguments.begin(); it != arguments.end(); it++)
     (*it)->prepareForDerivation();
 
-  non_null_derivatives = arguments.at(0)->non_null_derivatives;
+  vector<int> &non_null_derivatives = datatree.nonNullDerivatives(idx);
+  non_null_derivatives = datatree.nonNullDerivatives(arguments.at(0)->idx);
   for (int i = 1; i < (int) arguments.size(); i++)
-    set_union(non_null_derivatives.begin(),
-              non_null_derivatives.end(),
-              arguments.at(i)->non_null_derivatives.begin(),
-              arguments.at(i)->non_null_derivatives.end(),
-              inserter(non_null_derivatives, non_null_derivatives.begin()));
+    {
+      const vector<int> &nnd = datatree.nonNullDerivatives(arguments.at(i)->idx);
+      vector<int> non_null_derivatives_tmp;
+      set_union(non_null_derivatives.begin(), non_null_derivatives.end(),
+                nnd.begin(), nnd.end(),
+                back_inserter(non_null_derivatives_tmp));
+      non_null_derivatives.swap(non_null_derivatives_tmp);
+    }
 
   preparedForDerivation = true;
 }
@@ -5041,6 +5099,13 @@ AbstractExternalFunctionNode::eval(const eval_context_t &eval_context) const thr
   throw EvalExternalFunctionException();
 }
 
+int
+AbstractExternalFunctionNode::appendEvalInstruction(EvalProgram &program) const
+{
+  // The arguments are not needed, since the evaluation always fails
+  return program.appendInstruction(EvalProgram::Instruction(EvalProgram::iExternalFunction));
+}
+
 int
 AbstractExternalFunctionNode::maxEndoLead() const
 {
@@ -5360,16 +5425,14 @@ ExternalFunctionNode::computeTemporaryTerms(map<expr_t, pair<int, NodeTreeRefere
 }
 
 void
-ExternalFunctionNode::computeTemporaryTerms(map<expr_t, int> &reference_count,
+ExternalFunctionNode::computeTemporaryTerms(BlockReferenceCount &reference_count,
                                             temporary_terms_t &temporary_terms,
-                                            map<expr_t, pair<int, int> > &first_occurence,
                                             int Curr_block,
                                             vector< vector<temporary_terms_t> > &v_temporary_terms,
                                             int equation) const
 {
   expr_t this2 = const_cast<ExternalFunctionNode *>(this);
   temporary_terms.insert(this2);
-  first_occurence[this2] = make_pair(Curr_block, equation);
   v_temporary_terms[Curr_block][equation].insert(this2);
 }
 
@@ -5677,16 +5740,14 @@ FirstDerivExternalFunctionNode::computeTemporaryTerms(map<expr_t, pair<int, Node
 }
 
 void
-FirstDerivExternalFunctionNode::computeTemporaryTerms(map<expr_t, int> &reference_count,
+FirstDerivExternalFunctionNode::computeTemporaryTerms(BlockReferenceCount &reference_count,
                                                       temporary_terms_t &temporary_terms,
-                                                      map<expr_t, pair<int, int> > &first_occurence,
                                                       int Curr_block,
                                                       vector< vector<temporary_terms_t> > &v_temporary_terms,
                                                       int equation) const
 {
   expr_t this2 = const_cast<FirstDerivExternalFunctionNode *>(this);
   temporary_terms.insert(this2);
-  first_occurence[this2] = make_pair(Curr_block, equation);
   v_temporary_terms[Curr_block][equation].insert(this2);
 }
 
@@ -6063,16 +6124,14 @@ SecondDerivExternalFunctionNode::computeTemporaryTerms(map<expr_t, pair<int, Nod
 }
 
 void
-SecondDerivExternalFunctionNode::computeTemporaryTerms(map<expr_t, int> &reference_count,
+SecondDerivExternalFunctionNode::computeTemporaryTerms(BlockReferenceCount &reference_count,
                                                        temporary_terms_t &temporary_terms,
-                                                       map<expr_t, pair<int, int> > &first_occurence,
                                                        int Curr_block,
                                                        vector< vector<temporary_terms_t> > &v_temporary_terms,
                                                        int equation) const
 {
   expr_t this2 = const_cast<SecondDerivExternalFunctionNode *>(this);
   temporary_terms.insert(this2);
-  first_occurence[this2] = make_pair(Curr_block, equation);
   v_temporary_terms[Curr_block][equation].insert(this2);
 }
 
@@ -6375,3 +6434,131 @@ SecondDerivExternalFunctionNode::compileExternalFunctionOutput(ostream &CompileC
   cerr << "SecondDerivExternalFunctionNode::compileExternalFunctionOutput: not implemented." << endl;
   exit(EXIT_FAILURE);
 }
+
+EvalProgram::EvalProgram() : nb_variables(0)
+{
+}
+
+int
+EvalProgram::addExpression(expr_t e)
+{
+  expressions.push_back(addNode(e));
+  return expressions.size()-1;
+}
+
+int
+EvalProgram::addNode(const ExprNode *node)
+{
+  map<const ExprNode *, int>::const_iterator it = node_slots.find(node);
+  if (it != node_slots.end())
+    return it->second;
+
+  int slot = node->appendEvalInstruction(*this);
+  node_slots[node] = slot;
+  return slot;
+}
+
+int
+EvalProgram::appendInstruction(const Instruction &instruction)
+{
+  if (instruction.code == iVariable)
+    nb_variables = max(nb_variables, instruction.arg1+1);
+  instructions.push_back(instruction);
+  return instructions.size()-1;
+}
+
+void
+EvalProgram::eval(const eval_context_t &eval_context)
+{
+  variables.assign(nb_variables, 0.0);
+  variable_defined.assign(nb_variables, false);
+  for (eval_context_t::const_iterator it = eval_context.begin(); it != eval_context.end(); it++)
+    if (it->first < nb_variables)
+      {
+        variables[it->first] = it->second;
+        variable_defined[it->first] = true;
+      }
+
+  int n = instructions.size();
+  values.resize(n);
+  status.assign(n, sOk);
+  for (int i = 0; i < n; i++)
+    {
+      const Instruction &ins = instructions[i];
+      switch (ins.code)
+        {
+        case iConstant:
+          values[i] = ins.constant;
+          continue;
+        case iVariable:
+          if (variable_defined[ins.arg1])
+            values[i] = variables[ins.arg1];
+          else
+            status[i] = sEvalException;
+          continue;
+        case iExternalFunction:
+          status[i] = sExternalFunction;
+          continue;
+        default:
+          break;
+        }
+
+      // For an operator, fail like the first argument that failed, as ExprNode::eval() would do
+      if (status[ins.arg1] != sOk)
+        {
+          status[i] = status[ins.arg1];
+          continue;
+        }
+      if (ins.arg2 >= 0 && status[ins.arg2] != sOk)
+        {
+          status[i] = status[ins.arg2];
+          continue;
+        }
+      if (ins.arg3 >= 0 && status[ins.arg3] != sOk)
+        {
+          status[i] = status[ins.arg3];
+          continue;
+        }
+      try
+        {
+          switch (ins.code)
+            {
+            case iUnaryOp:
+              values[i] = UnaryOpNode::eval_opcode(static_cast<UnaryOpcode>(ins.op_code), values[ins.arg1]);
+              break;
+            case iBinaryOp:
+              values[i] = BinaryOpNode::eval_opcode(values[ins.arg1], static_cast<BinaryOpcode>(ins.op_code),
+                                                    values[ins.arg2], ins.powerDerivOrder);
+              break;
+            case iTrinaryOp:
+              values[i] = TrinaryOpNode::eval_opcode(values[ins.arg1], static_cast<TrinaryOpcode>(ins.op_code),
+                                                     values[ins.arg2], values[ins.arg3]);
+              break;
+            default:
+              break;
+            }
+        }
+      catch (ExprNode::EvalExternalFunctionException &e)
+        {
+          status[i] = sExternalFunction;
+        }
+      catch (ExprNode::EvalException &e)
+        {
+          status[i] = sEvalException;
+        }
+    }
+}
+
+double
+EvalProgram::value(int expression) const throw (ExprNode::EvalException, ExprNode::EvalExternalFunctionException)
+{
+  int slot = expressions[expression];
+  switch (status[slot])
+    {
+    case sEvalException:
+      throw ExprNode::EvalException();
+    case sExternalFunction:
+      throw ExprNode::EvalExternalFunctionException();
+    }
+  return values[slot];
+}
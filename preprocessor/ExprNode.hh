@@ -34,6 +34,7 @@ using namespace std;
 class DataTree;
 class VariableNode;
 class BinaryOpNode;
+class EvalProgram;
 
 typedef class ExprNode *expr_t;
 
@@ -52,6 +53,48 @@ typedef map<int, int> map_idx_t;
 /*! The key is a symbol id. Lags are assumed to be null */
 typedef map<int, double> eval_context_t;
 
+//! Reference counts and first occurrences of the nodes, for the temporary terms of block decomposed models
+/*! They are stored in arrays indexed by ExprNode::idx. The visited nodes are recorded, so
+  that clear() only resets them, and that an instance can be reused for each block */
+class BlockReferenceCount
+{
+private:
+  vector<int> count;
+  vector<pair<int, int> > first_occurence;
+  vector<int> visited;
+public:
+  //! nb_nodes must be larger than the index of any node that will be counted
+  explicit BlockReferenceCount(int nb_nodes) : count(nb_nodes, 0), first_occurence(nb_nodes)
+  {
+  };
+  //! Adds a reference to a node, found in the given block and equation, and returns its new reference count
+  /*! The first reference sets the first occurrence of the node */
+  inline int
+  addReference(int idx, int block, int equation)
+  {
+    if (count[idx]++ == 0)
+      {
+        first_occurence[idx] = make_pair(block, equation);
+        visited.push_back(idx);
+      }
+    return count[idx];
+  };
+  //! Returns the (block, equation) where a node has been first referenced
+  inline const pair<int, int> &
+  getFirstOccurence(int idx) const
+  {
+    return first_occurence[idx];
+  };
+  //! Forgets all references
+  void
+  clear()
+  {
+    for (vector<int>::const_iterator it = visited.begin(); it != visited.end(); it++)
+      count[*it] = 0;
+    visited.clear();
+  };
+};
+
 //! Type for tracking first/second derivative functions that have already been written as temporary terms
 typedef map<pair<int, vector<expr_t> >, int> deriv_node_temp_terms_t;
 
@@ -147,15 +190,11 @@ enum ExprNodeOutputType
       //! Index number
       int idx;
 
-      //! Is the data member non_null_derivatives initialized ?
+      //! Is the set of potentially non-null derivatives initialized ?
+      /*! That set, and the cache of first order derivatives, are stored in
+        the side tables of the DataTree (see DataTree::non_null_derivatives) */
       bool preparedForDerivation;
 
-      //! Set of derivation IDs with respect to which the derivative is potentially non-null
-      set<int> non_null_derivatives;
-
-      //! Used for caching of first order derivatives (when non-null)
-      map<int, expr_t> derivatives;
-
       //! Cost of computing current node
       /*! Nodes included in temporary_terms are considered having a null cost */
       virtual int cost(int cost, bool is_matlab) const;
@@ -176,7 +215,14 @@ enum ExprNodeOutputType
       virtual
       ~ExprNode();
 
-      //! Initializes data member non_null_derivatives
+      //! Allocates a node in the slabs of the DataTree, which frees them with all its nodes
+      /*! Hence a node is created with new (datatree) and never deleted */
+      static void *operator new(size_t size, DataTree &datatree);
+      //! Called if the constructor throws, the memory stays in the slabs
+      static void operator delete(void *p, DataTree &datatree);
+      static void operator delete(void *p);
+
+      //! Initializes the set of potentially non-null derivatives
       virtual void prepareForDerivation() = 0;
 
       //! Returns derivative w.r. to derivation ID
@@ -184,6 +230,11 @@ enum ExprNodeOutputType
         For an equal node, returns the derivative of lhs minus rhs */
       expr_t getDerivative(int deriv_id);
 
+      //! Returns the set of derivation IDs with respect to which the derivative is potentially non-null
+      /*! Initializes it first if needed. Used to avoid looping over all derivation IDs when computing higher order derivatives.
+        The derivation IDs are sorted */
+      const vector<int> &getNonNullDerivatives();
+
       //! Computes derivatives by applying the chain rule for some variables
       /*!
         \param deriv_id The derivation ID with respect to which we are derivating
@@ -279,9 +330,8 @@ enum ExprNodeOutputType
 
       virtual void collectTemporary_terms(const temporary_terms_t &temporary_terms, temporary_terms_inuse_t &temporary_terms_inuse, int Curr_Block) const = 0;
 
-      virtual void computeTemporaryTerms(map<expr_t, int> &reference_count,
+      virtual void computeTemporaryTerms(BlockReferenceCount &reference_count,
                                          temporary_terms_t &temporary_terms,
-                                         map<expr_t, pair<int, int> > &first_occurence,
                                          int Curr_block,
                                          vector< vector<temporary_terms_t> > &v_temporary_terms,
                                          int equation) const;
@@ -297,6 +347,9 @@ enum ExprNodeOutputType
       };
 
       virtual double eval(const eval_context_t &eval_context) const throw (EvalException, EvalExternalFunctionException) = 0;
+      //! Appends the instruction computing the node to a flattened evaluation program, and returns its slot
+      /*! Only to be called by EvalProgram::addNode(), which avoids adding a node twice */
+      virtual int appendEvalInstruction(EvalProgram &program) const = 0;
       virtual void compile(ostream &CompileCode, unsigned int &instruction_number, bool lhs_rhs, const temporary_terms_t &temporary_terms, const map_idx_t &map_idx, bool dynamic, bool steady_dynamic, deriv_node_temp_terms_t &tef_terms) const = 0;
       void compile(ostream &CompileCode, unsigned int &instruction_number, bool lhs_rhs, const temporary_terms_t &temporary_terms, const map_idx_t &map_idx, bool dynamic, bool steady_dynamic) const;
       //! Creates a static version of this node
@@ -495,6 +548,7 @@ public:
   virtual void collectDynamicVariables(SymbolType type_arg, set<pair<int, int> > &result) const;
   virtual void collectTemporary_terms(const temporary_terms_t &temporary_terms, temporary_terms_inuse_t &temporary_terms_inuse, int Curr_Block) const;
   virtual double eval(const eval_context_t &eval_context) const throw (EvalException, EvalExternalFunctionException);
+  virtual int appendEvalInstruction(EvalProgram &program) const;
   virtual void compile(ostream &CompileCode, unsigned int &instruction_number, bool lhs_rhs, const temporary_terms_t &temporary_terms, const map_idx_t &map_idx, bool dynamic, bool steady_dynamic, deriv_node_temp_terms_t &tef_terms) const;
   virtual expr_t toStatic(DataTree &static_datatree) const;
   virtual void computeXrefs(EquationInfo &ei) const;
@@ -543,14 +597,14 @@ public:
   virtual void writeJsonOutput(ostream &output, const temporary_terms_t &temporary_terms, deriv_node_temp_terms_t &tef_terms) const;
   virtual bool containsExternalFunction() const;
   virtual void collectDynamicVariables(SymbolType type_arg, set<pair<int, int> > &result) const;
-  virtual void computeTemporaryTerms(map<expr_t, int > &reference_count,
+  virtual void computeTemporaryTerms(BlockReferenceCount &reference_count,
                                      temporary_terms_t &temporary_terms,
-                                     map<expr_t, pair<int, int> > &first_occurence,
                                      int Curr_block,
                                      vector< vector<temporary_terms_t> > &v_temporary_terms,
                                      int equation) const;
   virtual void collectTemporary_terms(const temporary_terms_t &temporary_terms, temporary_terms_inuse_t &temporary_terms_inuse, int Curr_Block) const;
   virtual double eval(const eval_context_t &eval_context) const throw (EvalException, EvalExternalFunctionException);
+  virtual int appendEvalInstruction(EvalProgram &program) const;
   virtual void compile(ostream &CompileCode, unsigned int &instruction_number, bool lhs_rhs, const temporary_terms_t &temporary_terms, const map_idx_t &map_idx, bool dynamic, bool steady_dynamic, deriv_node_temp_terms_t &tef_terms) const;
   virtual expr_t toStatic(DataTree &static_datatree) const;
   virtual void computeXrefs(EquationInfo &ei) const;
@@ -632,9 +686,8 @@ public:
                                              bool lhs_rhs, const temporary_terms_t &temporary_terms,
                                              const map_idx_t &map_idx, bool dynamic, bool steady_dynamic,
                                              deriv_node_temp_terms_t &tef_terms) const;
-  virtual void computeTemporaryTerms(map<expr_t, int> &reference_count,
+  virtual void computeTemporaryTerms(BlockReferenceCount &reference_count,
                                      temporary_terms_t &temporary_terms,
-                                     map<expr_t, pair<int, int> > &first_occurence,
                                      int Curr_block,
                                      vector< vector<temporary_terms_t> > &v_temporary_terms,
                                      int equation) const;
@@ -642,6 +695,7 @@ public:
   virtual void collectTemporary_terms(const temporary_terms_t &temporary_terms, temporary_terms_inuse_t &temporary_terms_inuse, int Curr_Block) const;
   static double eval_opcode(UnaryOpcode op_code, double v) throw (EvalException, EvalExternalFunctionException);
   virtual double eval(const eval_context_t &eval_context) const throw (EvalException, EvalExternalFunctionException);
+  virtual int appendEvalInstruction(EvalProgram &program) const;
   virtual void compile(ostream &CompileCode, unsigned int &instruction_number, bool lhs_rhs, const temporary_terms_t &temporary_terms, const map_idx_t &map_idx, bool dynamic, bool steady_dynamic, deriv_node_temp_terms_t &tef_terms) const;
   //! Returns operand
   expr_t
@@ -724,9 +778,8 @@ public:
                                              bool lhs_rhs, const temporary_terms_t &temporary_terms,
                                              const map_idx_t &map_idx, bool dynamic, bool steady_dynamic,
                                              deriv_node_temp_terms_t &tef_terms) const;
-  virtual void computeTemporaryTerms(map<expr_t, int> &reference_count,
+  virtual void computeTemporaryTerms(BlockReferenceCount &reference_count,
                                      temporary_terms_t &temporary_terms,
-                                     map<expr_t, pair<int, int> > &first_occurence,
                                      int Curr_block,
                                      vector< vector<temporary_terms_t> > &v_temporary_terms,
                                      int equation) const;
@@ -734,6 +787,7 @@ public:
   virtual void collectTemporary_terms(const temporary_terms_t &temporary_terms, temporary_terms_inuse_t &temporary_terms_inuse, int Curr_Block) const;
   static double eval_opcode(double v1, BinaryOpcode op_code, double v2, int derivOrder) throw (EvalException, EvalExternalFunctionException);
   virtual double eval(const eval_context_t &eval_context) const throw (EvalException, EvalExternalFunctionException);
+  virtual int appendEvalInstruction(EvalProgram &program) const;
   virtual void compile(ostream &CompileCode, unsigned int &instruction_number, bool lhs_rhs, const temporary_terms_t &temporary_terms, const map_idx_t &map_idx, bool dynamic, bool steady_dynamic, deriv_node_temp_terms_t &tef_terms) const;
   virtual expr_t Compute_RHS(expr_t arg1, expr_t arg2, int op, int op_type) const;
   //! Returns first operand
@@ -833,9 +887,8 @@ public:
                                              bool lhs_rhs, const temporary_terms_t &temporary_terms,
                                              const map_idx_t &map_idx, bool dynamic, bool steady_dynamic,
                                              deriv_node_temp_terms_t &tef_terms) const;
-  virtual void computeTemporaryTerms(map<expr_t, int> &reference_count,
+  virtual void computeTemporaryTerms(BlockReferenceCount &reference_count,
                                      temporary_terms_t &temporary_terms,
-                                     map<expr_t, pair<int, int> > &first_occurence,
                                      int Curr_block,
                                      vector< vector<temporary_terms_t> > &v_temporary_terms,
                                      int equation) const;
@@ -843,6 +896,7 @@ public:
   virtual void collectTemporary_terms(const temporary_terms_t &temporary_terms, temporary_terms_inuse_t &temporary_terms_inuse, int Curr_Block) const;
   static double eval_opcode(double v1, TrinaryOpcode op_code, double v2, double v3) throw (EvalException, EvalExternalFunctionException);
   virtual double eval(const eval_context_t &eval_context) const throw (EvalException, EvalExternalFunctionException);
+  virtual int appendEvalInstruction(EvalProgram &program) const;
   virtual void compile(ostream &CompileCode, unsigned int &instruction_number, bool lhs_rhs, const temporary_terms_t &temporary_terms, const map_idx_t &map_idx, bool dynamic, bool steady_dynamic, deriv_node_temp_terms_t &tef_terms) const;
   virtual expr_t toStatic(DataTree &static_datatree) const;
   virtual void computeXrefs(EquationInfo &ei) const;
@@ -916,15 +970,15 @@ public:
                                              bool lhs_rhs, const temporary_terms_t &temporary_terms,
                                              const map_idx_t &map_idx, bool dynamic, bool steady_dynamic,
                                              deriv_node_temp_terms_t &tef_terms) const = 0;
-  virtual void computeTemporaryTerms(map<expr_t, int> &reference_count,
+  virtual void computeTemporaryTerms(BlockReferenceCount &reference_count,
                                      temporary_terms_t &temporary_terms,
-                                     map<expr_t, pair<int, int> > &first_occurence,
                                      int Curr_block,
                                      vector< vector<temporary_terms_t> > &v_temporary_terms,
                                      int equation) const = 0;
   virtual void collectDynamicVariables(SymbolType type_arg, set<pair<int, int> > &result) const;
   virtual void collectTemporary_terms(const temporary_terms_t &temporary_terms, temporary_terms_inuse_t &temporary_terms_inuse, int Curr_Block) const;
   virtual double eval(const eval_context_t &eval_context) const throw (EvalException, EvalExternalFunctionException);
+  virtual int appendEvalInstruction(EvalProgram &program) const;
   unsigned int compileExternalFunctionArguments(ostream &CompileCode, unsigned int &instruction_number,
                                                 bool lhs_rhs, const temporary_terms_t &temporary_terms,
                                                 const map_idx_t &map_idx, bool dynamic, bool steady_dynamic,
@@ -985,9 +1039,8 @@ public:
                                              bool lhs_rhs, const temporary_terms_t &temporary_terms,
                                              const map_idx_t &map_idx, bool dynamic, bool steady_dynamic,
                                              deriv_node_temp_terms_t &tef_terms) const;
-  virtual void computeTemporaryTerms(map<expr_t, int> &reference_count,
+  virtual void computeTemporaryTerms(BlockReferenceCount &reference_count,
                                      temporary_terms_t &temporary_terms,
-                                     map<expr_t, pair<int, int> > &first_occurence,
                                      int Curr_block,
                                      vector< vector<temporary_terms_t> > &v_temporary_terms,
                                      int equation) const;
@@ -1011,9 +1064,8 @@ public:
   virtual void computeTemporaryTerms(map<expr_t, pair<int, NodeTreeReference> > &reference_count,
                                      map<NodeTreeReference, temporary_terms_t> &temp_terms_map,
                                      bool is_matlab, NodeTreeReference tr) const;
-  virtual void computeTemporaryTerms(map<expr_t, int> &reference_count,
+  virtual void computeTemporaryTerms(BlockReferenceCount &reference_count,
                                      temporary_terms_t &temporary_terms,
-                                     map<expr_t, pair<int, int> > &first_occurence,
                                      int Curr_block,
                                      vector< vector<temporary_terms_t> > &v_temporary_terms,
                                      int equation) const;
@@ -1054,9 +1106,8 @@ public:
   virtual void computeTemporaryTerms(map<expr_t, pair<int, NodeTreeReference> > &reference_count,
                                      map<NodeTreeReference, temporary_terms_t> &temp_terms_map,
                                      bool is_matlab, NodeTreeReference tr) const;
-  virtual void computeTemporaryTerms(map<expr_t, int> &reference_count,
+  virtual void computeTemporaryTerms(BlockReferenceCount &reference_count,
                                      temporary_terms_t &temporary_terms,
-                                     map<expr_t, pair<int, int> > &first_occurence,
                                      int Curr_block,
                                      vector< vector<temporary_terms_t> > &v_temporary_terms,
                                      int equation) const;
@@ -1082,4 +1133,84 @@ public:
   virtual expr_t cloneDynamic(DataTree &dynamic_datatree) const;
 };
 
+//! A flattened program evaluating a set of expressions numerically
+/*! The DAG below the expressions is sorted topologically into a vector of instructions,
+  each storing its result in its own slot of a dense array of values. Evaluating the
+  program is then a single loop, in which shared subexpressions are computed only once,
+  and variables are read from a dense array indexed by symbol ID instead of being looked
+  up in the evaluation context.
+  Evaluating an expression with the program gives the same result as ExprNode::eval(),
+  including the exception that it would throw, which is raised by value() */
+class EvalProgram
+{
+public:
+  enum InstructionCode
+    {
+      iConstant,
+      iVariable,
+      iUnaryOp,
+      iBinaryOp,
+      iTrinaryOp,
+      iExternalFunction
+    };
+
+  struct Instruction
+  {
+    InstructionCode code;
+    //! The UnaryOpcode, BinaryOpcode or TrinaryOpcode of an operator
+    int op_code;
+    //! The slots of the arguments of an operator, or the symbol ID of a variable in arg1
+    int arg1, arg2, arg3;
+    //! Order of derivation, for oPowerDeriv
+    int powerDerivOrder;
+    //! Value of a constant
+    double constant;
+    Instruction(InstructionCode code_arg) : code(code_arg), op_code(0), arg1(-1), arg2(-1), arg3(-1),
+                                            powerDerivOrder(0), constant(0)
+    {
+    };
+  };
+
+private:
+  //! Status of a slot after evaluation
+  enum SlotStatus
+    {
+      sOk,
+      sEvalException,
+      sExternalFunction
+    };
+
+  vector<Instruction> instructions;
+  //! Slots of the nodes already in the program
+  map<const ExprNode *, int> node_slots;
+  //! Slots of the expressions added with addExpression()
+  vector<int> expressions;
+  //! Number of entries of the dense array of variables (maximum symbol ID plus one)
+  int nb_variables;
+
+  vector<double> values;
+  vector<char> status;
+  vector<double> variables;
+  vector<bool> variable_defined;
+public:
+  EvalProgram();
+  //! Adds an expression to the program, and returns its index, to be passed to value()
+  int addExpression(expr_t e);
+  //! Returns the slot of a node, adding it and its arguments to the program if needed
+  int addNode(const ExprNode *node);
+  //! Appends an instruction, and returns its slot
+  int appendInstruction(const Instruction &instruction);
+  //! Number of instructions
+  int
+  size() const
+  {
+    return instructions.size();
+  };
+  //! Evaluates all the expressions
+  void eval(const eval_context_t &eval_context);
+  //! Returns the value of an expression computed by the last call to eval()
+  /*! Throws the exception that ExprNode::eval() would have thrown for that expression */
+  double value(int expression) const throw (ExprNode::EvalException, ExprNode::EvalExternalFunctionException);
+};
+
 #endif
@@ -43,6 +43,7 @@ enum JsonFileOutputType
   {
     file,                             // output JSON files to file
     standardout,                      // output JSON files to stdout
+    cborfile,                         // output JSON files to file, encoded in CBOR
   };
 
 enum JsonOutputPointType
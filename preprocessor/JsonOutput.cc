@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2018 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "JsonOutput.hh"
+
+JsonToCborStreambuf::JsonToCborStreambuf(ostream &dest_arg) :
+  dest(dest_arg), state(between_tokens), high_surrogate(0)
+{
+}
+
+JsonToCborStreambuf::~JsonToCborStreambuf()
+{
+  // A literal at the end of the stream has no terminating character
+  if (state == in_literal)
+    endLiteral();
+  dest.flush();
+}
+
+JsonToCborStreambuf::int_type
+JsonToCborStreambuf::overflow(int_type c)
+{
+  if (!traits_type::eq_int_type(c, traits_type::eof()))
+    feed(traits_type::to_char_type(c));
+  return traits_type::not_eof(c);
+}
+
+streamsize
+JsonToCborStreambuf::xsputn(const char *s, streamsize n)
+{
+  for (streamsize i = 0; i < n; i++)
+    feed(s[i]);
+  return n;
+}
+
+int
+JsonToCborStreambuf::sync()
+{
+  dest.flush();
+  return dest.good() ? 0 : -1;
+}
+
+void
+JsonToCborStreambuf::writeHeader(unsigned char major_type, unsigned long long value)
+{
+  unsigned char b = major_type << 5;
+  if (value < 24)
+    dest.put(b | value);
+  else
+    {
+      int nbytes;
+      if (value < 0x100ULL)
+        {
+          dest.put(b | 24);
+          nbytes = 1;
+        }
+      else if (value < 0x10000ULL)
+        {
+          dest.put(b | 25);
+          nbytes = 2;
+        }
+      else if (value < 0x100000000ULL)
+        {
+          dest.put(b | 26);
+          nbytes = 4;
+        }
+      else
+        {
+          dest.put(b | 27);
+          nbytes = 8;
+        }
+      for (int i = nbytes - 1; i >= 0; i--)
+        dest.put((value >> (8*i)) & 0xff);
+    }
+}
+
+void
+JsonToCborStreambuf::writeUTF8(unsigned int code_point)
+{
+  if (code_point < 0x80)
+    token += (char) code_point;
+  else if (code_point < 0x800)
+    {
+      token += (char) (0xc0 | (code_point >> 6));
+      token += (char) (0x80 | (code_point & 0x3f));
+    }
+  else if (code_point < 0x10000)
+    {
+      token += (char) (0xe0 | (code_point >> 12));
+      token += (char) (0x80 | ((code_point >> 6) & 0x3f));
+      token += (char) (0x80 | (code_point & 0x3f));
+    }
+  else
+    {
+      token += (char) (0xf0 | (code_point >> 18));
+      token += (char) (0x80 | ((code_point >> 12) & 0x3f));
+      token += (char) (0x80 | ((code_point >> 6) & 0x3f));
+      token += (char) (0x80 | (code_point & 0x3f));
+    }
+}
+
+void
+JsonToCborStreambuf::endLiteral()
+{
+  state = between_tokens;
+  if (!token.compare("true"))
+    dest.put((char) 0xf5);
+  else if (!token.compare("false"))
+    dest.put((char) 0xf4);
+  else if (!token.compare("null"))
+    dest.put((char) 0xf6);
+  else
+    {
+      char *end;
+      errno = 0;
+      if (token.find_first_of(".eE") == string::npos)
+        {
+          long long v = strtoll(token.c_str(), &end, 10);
+          if (*end == '\0' && errno == 0 && !token.empty())
+            {
+              if (v >= 0)
+                writeHeader(0, v);
+              else
+                writeHeader(1, -(v + 1));
+              token.clear();
+              return;
+            }
+        }
+      errno = 0;
+      double d = strtod(token.c_str(), &end);
+      if (*end == '\0' && !token.empty())
+        {
+          unsigned long long bits;
+          memcpy(&bits, &d, sizeof(bits));
+          dest.put((char) 0xfb);
+          for (int i = 7; i >= 0; i--)
+            dest.put((bits >> (8*i)) & 0xff);
+        }
+      else
+        {
+          writeHeader(3, token.size());
+          dest.write(token.data(), token.size());
+        }
+    }
+  token.clear();
+}
+
+void
+JsonToCborStreambuf::feed(char c)
+{
+  switch (state)
+    {
+    case in_string:
+      if (c == '"')
+        {
+          writeHeader(3, token.size());
+          dest.write(token.data(), token.size());
+          token.clear();
+          state = between_tokens;
+        }
+      else if (c == '\\')
+        state = in_escape;
+      else
+        token += c;
+      return;
+    case in_escape:
+      state = in_string;
+      switch (c)
+        {
+        case 'b':
+          token += '\b';
+          break;
+        case 'f':
+          token += '\f';
+          break;
+        case 'n':
+          token += '\n';
+          break;
+        case 'r':
+          token += '\r';
+          break;
+        case 't':
+          token += '\t';
+          break;
+        case 'u':
+          unicode_digits.clear();
+          state = in_unicode_escape;
+          break;
+        default:
+          token += c;
+        }
+      return;
+    case in_unicode_escape:
+      unicode_digits += c;
+      if (unicode_digits.size() == 4)
+        {
+          unsigned int code_point = strtoul(unicode_digits.c_str(), NULL, 16);
+          if (code_point >= 0xd800 && code_point < 0xdc00)
+            high_surrogate = code_point;
+          else if (code_point >= 0xdc00 && code_point < 0xe000 && high_surrogate != 0)
+            {
+              writeUTF8(0x10000 + ((high_surrogate - 0xd800) << 10) + (code_point - 0xdc00));
+              high_surrogate = 0;
+            }
+          else
+            writeUTF8(code_point);
+          state = in_string;
+        }
+      return;
+    case in_literal:
+      if (isspace(c) || c == ',' || c == ':' || c == ']' || c == '}')
+        endLiteral();
+      else
+        {
+          token += c;
+          return;
+        }
+      break;
+    case between_tokens:
+      break;
+    }
+
+  // Between tokens
+  switch (c)
+    {
+    case '{':
+      dest.put((char) 0xbf);
+      break;
+    case '[':
+      dest.put((char) 0x9f);
+      break;
+    case '}':
+    case ']':
+      dest.put((char) 0xff);
+      break;
+    case '"':
+      state = in_string;
+      break;
+    case ',':
+    case ':':
+      break;
+    default:
+      if (!isspace(c))
+        {
+          token += c;
+          state = in_literal;
+        }
+    }
+}
+
+JsonOutputFile::JsonOutputFile(const string &basename, bool cbor_arg) :
+  buffer(1 << 20), cbor(NULL), output(&file)
+{
+  string fname = basename + (cbor_arg ? ".cbor" : ".json");
+  file.rdbuf()->pubsetbuf(&buffer[0], buffer.size());
+  file.open(fname.c_str(), ios::out | ios::binary);
+  if (!file.is_open())
+    {
+      cerr << "ERROR: Can't open file " << fname << " for writing" << endl;
+      exit(EXIT_FAILURE);
+    }
+  if (cbor_arg)
+    {
+      cbor = new JsonToCborStreambuf(file);
+      output = new ostream(cbor);
+    }
+}
+
+JsonOutputFile::~JsonOutputFile()
+{
+  if (cbor != NULL)
+    {
+      output->flush();
+      delete output;
+      delete cbor;
+    }
+  file.close();
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2018 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _JSON_OUTPUT_HH
+#define _JSON_OUTPUT_HH
+
+#include <fstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//! Stream buffer translating the JSON text written to it into CBOR (RFC 7049)
+/*! The translation is done on the fly, token by token: objects and arrays
+  are written as indefinite-length maps and arrays, so that only the token
+  being read (e.g. a string holding an expression) is kept in memory.
+  Integers become CBOR integers, other numbers double precision floats. A
+  literal which is not valid JSON is written as a text string. */
+class JsonToCborStreambuf : public streambuf
+{
+private:
+  enum State
+    {
+      between_tokens,
+      in_string,
+      in_escape,
+      in_unicode_escape,
+      in_literal
+    };
+  ostream &dest;
+  State state;
+  //! Current string (decoded) or literal
+  string token;
+  //! Hexadecimal digits of a \u escape, and the first half of a surrogate pair
+  string unicode_digits;
+  unsigned int high_surrogate;
+  void feed(char c);
+  void endLiteral();
+  void writeHeader(unsigned char major_type, unsigned long long value);
+  void writeUTF8(unsigned int code_point);
+protected:
+  virtual int_type overflow(int_type c);
+  virtual streamsize xsputn(const char *s, streamsize n);
+  virtual int sync();
+public:
+  JsonToCborStreambuf(ostream &dest_arg);
+  ~JsonToCborStreambuf();
+};
+
+//! A JSON output file of the preprocessor, written as text or as CBOR
+/*! The file is opened with a large buffer, the JSON is written to stream()
+  as it is produced and does not have to be held in memory. */
+class JsonOutputFile
+{
+private:
+  ofstream file;
+  vector<char> buffer;
+  JsonToCborStreambuf *cbor;
+  ostream *output;
+public:
+  //! Opens basename followed by ".json", or by ".cbor" if cbor_arg is true (exits on failure)
+  JsonOutputFile(const string &basename, bool cbor_arg);
+  ~JsonOutputFile();
+  inline ostream &
+  stream()
+  {
+    return *output;
+  };
+};
+
+#endif
@@ -18,6 +18,7 @@
  */
 
 #include <iostream>
+#include <algorithm>
 
 #include "MinimumFeedbackSet.hh"
 
@@ -454,4 +455,294 @@ namespace MFS
     if (num_vertices(G))
       cout << "Error in the computation of feedback vertex set\n";
   }
+
+  CompactGraph::CompactGraph(const AdjacencyList_t &G) : stamp(0)
+  {
+    nb_vertices = num_vertices(G);
+    property_map<AdjacencyList_t, vertex_index_t>::const_type v_index = get(vertex_index, G);
+    property_map<AdjacencyList_t, vertex_index1_t>::const_type v_index1 = get(vertex_index1, G);
+    map<AdjacencyList_t::vertex_descriptor, int> position;
+    AdjacencyList_t::vertex_iterator it, it_end;
+    int i = 0;
+    for (tie(it, it_end) = vertices(G); it != it_end; ++it, i++)
+      {
+        position[*it] = i;
+        index.push_back(v_index[*it]);
+        index1.push_back(v_index1[*it]);
+      }
+    out.resize(nb_vertices);
+    in.resize(nb_vertices);
+    for (tie(it, it_end) = vertices(G), i = 0; it != it_end; ++it, i++)
+      {
+        AdjacencyList_t::out_edge_iterator it_out, out_end;
+        for (tie(it_out, out_end) = out_edges(*it, G); it_out != out_end; ++it_out)
+          out[i].push_back(position[target(*it_out, G)]);
+        AdjacencyList_t::in_edge_iterator it_in, in_end;
+        for (tie(it_in, in_end) = in_edges(*it, G); it_in != in_end; ++it_in)
+          in[i].push_back(position[source(*it_in, G)]);
+      }
+    next.resize(nb_vertices);
+    prev.resize(nb_vertices);
+    for (i = 0; i < nb_vertices; i++)
+      {
+        next[i] = (i + 1 < nb_vertices ? i + 1 : -1);
+        prev[i] = i - 1;
+      }
+    head = (nb_vertices > 0 ? 0 : -1);
+    out_mark.resize(nb_vertices, 0);
+    in_mark.resize(nb_vertices, 0);
+  }
+
+  void
+  CompactGraph::mark_neighbours(int v)
+  {
+    stamp++;
+    for (vector<int>::const_iterator it = out[v].begin(); it != out[v].end(); ++it)
+      out_mark[*it] = stamp;
+    for (vector<int>::const_iterator it = in[v].begin(); it != in[v].end(); ++it)
+      in_mark[*it] = stamp;
+  }
+
+  void
+  CompactGraph::add_edge(int u, int v)
+  {
+    out[u].push_back(v);
+    in[v].push_back(u);
+  }
+
+  void
+  CompactGraph::suppress(int v)
+  {
+    for (vector<int>::const_iterator it = out[v].begin(); it != out[v].end(); ++it)
+      if (*it != v)
+        in[*it].erase(remove(in[*it].begin(), in[*it].end(), v), in[*it].end());
+    for (vector<int>::const_iterator it = in[v].begin(); it != in[v].end(); ++it)
+      if (*it != v)
+        out[*it].erase(remove(out[*it].begin(), out[*it].end(), v), out[*it].end());
+    out[v].clear();
+    in[v].clear();
+
+    if (prev[v] >= 0)
+      next[prev[v]] = next[v];
+    else
+      head = next[v];
+    if (next[v] >= 0)
+      prev[next[v]] = prev[v];
+    nb_vertices--;
+  }
+
+  void
+  CompactGraph::eliminate(int v)
+  {
+    if (in[v].size() > 0 && out[v].size() > 0)
+      for (size_t i = 0; i < in[v].size(); i++)
+        {
+          int k = in[v][i];
+          mark_neighbours(k);
+          for (size_t j = 0; j < out[v].size(); j++)
+            if (out_mark[out[v][j]] != stamp)
+              {
+                out_mark[out[v][j]] = stamp;
+                add_edge(k, out[v][j]);
+              }
+        }
+    suppress(v);
+  }
+
+  bool
+  CompactGraph::has_self_loop(int v) const
+  {
+    return find(in[v].begin(), in[v].end(), v) != in[v].end();
+  }
+
+  bool
+  CompactGraph::belongs_to_a_clique(int v)
+  {
+    // Same test as Vertex_Belong_to_a_Clique()
+    vector<int> liste;
+    bool agree = true;
+    size_t p;
+    for (p = 0; p < in[v].size() && p < out[v].size() && agree; p++)
+      {
+        agree = (in[v][p] == out[v][p] && in[v][p] != v);
+        liste.push_back(in[v][p]);
+      }
+    if (agree)
+      {
+        if (p < in[v].size() || p < out[v].size())
+          agree = false;
+        for (size_t i = 1; i < liste.size() && agree; i++)
+          {
+            mark_neighbours(liste[i]);
+            for (size_t j = i + 1; j < liste.size() && agree; j++)
+              agree = (out_mark[liste[j]] == stamp && in_mark[liste[j]] == stamp);
+          }
+      }
+    return agree;
+  }
+
+  bool
+  CompactGraph::has_cycle() const
+  {
+    // Repeatedly remove the vertices without in-edges: a cycle remains iff some vertices are left
+    vector<int> in_degree_n(in.size(), 0);
+    vector<int> sources;
+    for (int v = head; v >= 0; v = next[v])
+      {
+        in_degree_n[v] = in[v].size();
+        if (in_degree_n[v] == 0)
+          sources.push_back(v);
+      }
+    int nb_removed = 0;
+    while (!sources.empty())
+      {
+        int v = sources.back();
+        sources.pop_back();
+        nb_removed++;
+        for (vector<int>::const_iterator it = out[v].begin(); it != out[v].end(); ++it)
+          if (--in_degree_n[*it] == 0)
+            sources.push_back(*it);
+      }
+    return nb_removed < nb_vertices;
+  }
+
+  /* The reduction steps below scan the vertices in the same order as their
+     AdjacencyList_t counterparts, including the restart of the scan (which skips
+     the new first vertex) when the first vertex is removed */
+
+  //! Next vertex to scan after the removal of v, which was the i-th scanned vertex
+  static int
+  next_after_removal(const CompactGraph &G, int next_v, int &i)
+  {
+    if (i > 0)
+      return next_v;
+    i = -1;
+    return G.head >= 0 ? G.next[G.head] : -1;
+  }
+
+  static bool
+  Elimination_of_Vertex_With_One_or_Less_Indegree_or_Outdegree_Step(CompactGraph &G)
+  {
+    bool something_has_been_done = false;
+    int v = G.head, i = 0;
+    while (v >= 0)
+      {
+        int next_v = G.next[v];
+        int in_degree_n = G.in[v].size();
+        int out_degree_n = G.out[v].size();
+        // Do not eliminate a vertex if it loops on itself!
+        if ((in_degree_n <= 1 || out_degree_n <= 1)
+            && !(in_degree_n >= 1 && out_degree_n >= 1 && G.has_self_loop(v)))
+          {
+            G.eliminate(v);
+            something_has_been_done = true;
+            next_v = next_after_removal(G, next_v, i);
+          }
+        v = next_v;
+        i++;
+      }
+    return something_has_been_done;
+  }
+
+  static bool
+  Elimination_of_Vertex_belonging_to_a_clique_Step(CompactGraph &G)
+  {
+    bool something_has_been_done = false;
+    int v = G.head, i = 0;
+    while (v >= 0)
+      {
+        int next_v = G.next[v];
+        if (G.belongs_to_a_clique(v))
+          {
+            G.eliminate(v);
+            something_has_been_done = true;
+            next_v = next_after_removal(G, next_v, i);
+          }
+        v = next_v;
+        i++;
+      }
+    return something_has_been_done;
+  }
+
+  static bool
+  Suppression_of_Vertex_X_if_it_loops_store_in_set_of_feedback_vertex_Step(set<int> &feed_back_vertices, CompactGraph &G)
+  {
+    bool something_has_been_done = false;
+    int v = G.head, i = 0;
+    while (v >= 0)
+      {
+        int next_v = G.next[v];
+        if (G.has_self_loop(v))
+          {
+            feed_back_vertices.insert(G.index1[v]);
+            G.suppress(v);
+            something_has_been_done = true;
+            next_v = next_after_removal(G, next_v, i);
+          }
+        v = next_v;
+        i++;
+      }
+    return something_has_been_done;
+  }
+
+  void
+  Minimal_set_of_feedback_vertex_compact(set<int> &feed_back_vertices, vector<int> &Reordered_Vertices, const AdjacencyList_t &G1)
+  {
+    feed_back_vertices.clear();
+    CompactGraph G(G1);
+    bool something_has_been_done = true;
+    while (G.nb_vertices > 0)
+      {
+        while (something_has_been_done && G.nb_vertices > 0)
+          {
+            something_has_been_done = Elimination_of_Vertex_With_One_or_Less_Indegree_or_Outdegree_Step(G);
+            something_has_been_done = (Elimination_of_Vertex_belonging_to_a_clique_Step(G) || something_has_been_done);
+            something_has_been_done = (Suppression_of_Vertex_X_if_it_loops_store_in_set_of_feedback_vertex_Step(feed_back_vertices, G) || something_has_been_done);
+          }
+        if (!G.has_cycle())
+          break;
+        if (G.nb_vertices > 0)
+          {
+            // Cut the vertex with the maximum in_degree+out_degree
+            unsigned int max_degree = 0;
+            int max_degree_vertex = -1;
+            for (int v = G.head; v >= 0; v = G.next[v])
+              if (G.in[v].size() + G.out[v].size() > max_degree)
+                {
+                  max_degree = G.in[v].size() + G.out[v].size();
+                  max_degree_vertex = v;
+                }
+            feed_back_vertices.insert(G.index1[max_degree_vertex]);
+            G.suppress(max_degree_vertex);
+            something_has_been_done = true;
+          }
+      }
+
+    // Reorder the recursive variables, on the original graph without the feedback vertices
+    CompactGraph G2(G1);
+    for (set<int>::const_reverse_iterator it = feed_back_vertices.rbegin();
+         it != feed_back_vertices.rend(); ++it)
+      G2.suppress(*it); // Vertices are removed in decreasing order, as in Reorder_the_recursive_variables()
+    something_has_been_done = true;
+    while (something_has_been_done)
+      {
+        something_has_been_done = false;
+        int v = G2.head, i = 0;
+        while (v >= 0)
+          {
+            int next_v = G2.next[v];
+            if (G2.in[v].size() == 0)
+              {
+                Reordered_Vertices.push_back(G2.index[v]);
+                G2.suppress(v);
+                something_has_been_done = true;
+                next_v = next_after_removal(G2, next_v, i);
+              }
+            v = next_v;
+            i++;
+          }
+      }
+    if (G2.nb_vertices)
+      cout << "Error in the computation of feedback vertex set\n";
+  }
 }
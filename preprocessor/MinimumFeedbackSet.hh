@@ -79,6 +79,47 @@ namespace MFS
   //! Reorder the recursive variables
   /*! They appear first in a quasi triangular form and they are followed by the feedback variables */
   void Reorder_the_recursive_variables(const AdjacencyList_t &G1, set<int> &feedback_vertices, vector< int> &Reordered_Vertices);
+
+  //! Compact representation of a graph, used by the fast computation of the feedback set
+  /*! Vertices are numbered by their position in the original graph, and kept in a linked list
+    (in the order of the original graph) as they are removed. Adjacency lists are vectors, in the
+    order of the edge lists of the original graph, so that the graph reduction rules are
+    applied in exactly the same order as on an AdjacencyList_t. Edge existence is tested with
+    marks instead of scanning adjacency lists. */
+  class CompactGraph
+  {
+  public:
+    //! Property vertex_index of the vertices
+    vector<int> index;
+    //! Property vertex_index1 of the vertices
+    vector<int> index1;
+    //! Out and in neighbours of the vertices
+    vector<vector<int> > out, in;
+    //! Linked list of the vertices still in the graph (-1 is the end of the list)
+    vector<int> next, prev;
+    int head, nb_vertices;
+    //! Marks used for testing the existence of edges
+    vector<int> out_mark, in_mark;
+    int stamp;
+    CompactGraph(const AdjacencyList_t &G);
+    //! Marks the out and in neighbours of a vertex, setting out_mark and in_mark to stamp
+    void mark_neighbours(int v);
+    //! Adds an edge
+    void add_edge(int u, int v);
+    //! Removes all the edges of a vertex, and the vertex itself
+    void suppress(int v);
+    //! Replaces all paths k->v->j by an edge k->j, then suppresses v
+    void eliminate(int v);
+    //! Does the vertex loop on itself?
+    bool has_self_loop(int v) const;
+    bool belongs_to_a_clique(int v);
+    bool has_cycle() const;
+  };
+  //! Computes the feedback set and the reordering of the recursive variables
+  /*! Gives the same results as Minimal_set_of_feedback_vertex() followed by
+    Reorder_the_recursive_variables(), which are kept as a reference implementation,
+    but with linear-time graph reduction steps */
+  void Minimal_set_of_feedback_vertex_compact(set<int> &feed_back_vertices, vector<int> &Reordered_Vertices, const AdjacencyList_t &G);
 };
 
 #endif // _MINIMUMFEEDBACKSET_HH
@@ -26,6 +26,10 @@
 # include <unistd.h>
 #endif
 
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
 #include "ModFile.hh"
 #include "ConfigFile.hh"
 #include "ComputingTasks.hh"
@@ -39,9 +43,11 @@ ModFile::ModFile(WarningConsolidation &warnings_arg)
     orig_ramsey_dynamic_model(symbol_table, num_constants, external_functions_table),
     static_model(symbol_table, num_constants, external_functions_table),
     steady_state_model(symbol_table, num_constants, external_functions_table, static_model),
-    linear(false), block(false), byte_code(false), use_dll(false), no_static(false),
+    linear(false), block(false), byte_code(false), use_dll(false), no_static(false), compact_lags(false),
     differentiate_forward_vars(false), nonstationary_variables(false),
-    param_used_with_lead_lag(false), warnings(warnings_arg)
+    param_used_with_lead_lag(false), warnings(warnings_arg),
+    derivatives_cache_key(0), derivatives_cache_hit(false), cached_hessian_eq_zero(false),
+    use_equation_derivatives_cache(false)
 {
 }
 
@@ -196,6 +202,18 @@ ModFile::checkPass(bool nostrict)
       exit(EXIT_FAILURE);
     }
 
+  if (compact_lags && (stochastic_statement_present || mod_file_struct.check_present))
+    {
+      cerr << "ERROR: compact_lags option is incompatible with stoch_simul, estimation, osr, ramsey_policy, discretionary_policy and check commands" << endl;
+      exit(EXIT_FAILURE);
+    }
+
+  if (compact_lags && !block && !byte_code)
+    {
+      cerr << "ERROR: In 'model' block, 'compact_lags' option requires the 'block' or 'bytecode' option" << endl;
+      exit(EXIT_FAILURE);
+    }
+
   if (mod_file_struct.dsge_var_estimated)
     if (!mod_file_struct.dsge_prior_weight_in_estimated_params)
       {
@@ -398,7 +416,7 @@ ModFile::transformPass(bool nostrict, bool compute_xrefs)
       dynamic_model.substituteEndoLagGreaterThanTwo(false);
       dynamic_model.substituteExoLag(false);
     }
-  else
+  else if (!compact_lags)
     {
       // In deterministic models, create auxiliary vars for leads and lags endogenous greater than 2, only on endos (useless on exos)
       dynamic_model.substituteEndoLeadGreaterThanTwo(true);
@@ -499,8 +517,32 @@ ModFile::transformPass(bool nostrict, bool compute_xrefs)
 }
 
 void
-ModFile::computingPass(bool no_tmp_terms, FileOutputType output, int params_derivs_order)
+ModFile::computingPass(bool no_tmp_terms, FileOutputType output, int params_derivs_order,
+                       const string &basename, bool use_derivatives_cache)
 {
+  /* The cache is not used with block or bytecode (whose outputs depend on
+     more than the derivatives), nor with linear (which needs the hessian for
+     the linearity check) */
+  if (use_derivatives_cache && dynamic_model.equation_number() > 0
+      && !block && !byte_code && !linear)
+    {
+      derivatives_cache_key = computeDerivativesCacheKey(no_tmp_terms, output, params_derivs_order);
+      derivatives_cache_hit = readDerivativesCache(basename);
+      if (derivatives_cache_hit)
+        cout << "Model and options unchanged since previous run: skipping derivatives of order 2 and above" << endl;
+    }
+
+  /* Otherwise, only the equations which have changed since the previous run
+     are derived (the cache files are not rewritten in case of a hit, since the
+     derivatives of order 2 and above are then not computed) */
+  if (use_derivatives_cache && dynamic_model.equation_number() > 0 && !derivatives_cache_hit)
+    {
+      use_equation_derivatives_cache = true;
+      dynamic_model.readEquationDerivativesCache(basename + "/dynamic_equation_derivatives");
+      if (!no_static)
+        static_model.readEquationDerivativesCache(basename + "/static_equation_derivatives");
+    }
+
   // Mod file may have no equation (for example in a standalone BVAR estimation)
   if (dynamic_model.equation_number() > 0)
     {
@@ -517,11 +559,11 @@ ModFile::computingPass(bool no_tmp_terms, FileOutputType output, int params_deri
               || mod_file_struct.calib_smoother_present)
             static_model.set_cutoff_to_zero();
 
-          const bool static_hessian = mod_file_struct.identification_present
-            || mod_file_struct.estimation_analytic_derivation;
+          const bool static_hessian = !derivatives_cache_hit
+            && mod_file_struct.static_derivs_order >= 2;
           int paramsDerivsOrder = 0;
-          if (mod_file_struct.identification_present || mod_file_struct.estimation_analytic_derivation)
-            paramsDerivsOrder = params_derivs_order;
+          if (!derivatives_cache_hit)
+            paramsDerivsOrder = min(params_derivs_order, mod_file_struct.params_derivs_order);
           static_model.computingPass(global_eval_context, no_tmp_terms, static_hessian,
                                      false, paramsDerivsOrder, block, byte_code);
         }
@@ -546,25 +588,27 @@ ModFile::computingPass(bool no_tmp_terms, FileOutputType output, int params_deri
                   cerr << "ERROR: Incorrect order option..." << endl;
                   exit(EXIT_FAILURE);
                 }
-              bool hessian = mod_file_struct.order_option >= 2
-                || mod_file_struct.identification_present
-                || mod_file_struct.estimation_analytic_derivation
-                || linear
-                || output == second
-                || output == third;
-              bool thirdDerivatives = mod_file_struct.order_option == 3
-                || mod_file_struct.estimation_analytic_derivation
-                || output == third;
+              // Only compute the derivatives that the computing tasks declared in their checkPass()
+              bool hessian = !derivatives_cache_hit
+                && (mod_file_struct.order_option >= 2
+                    || mod_file_struct.dynamic_derivs_order >= 2
+                    || linear
+                    || output == second
+                    || output == third);
+              bool thirdDerivatives = !derivatives_cache_hit
+                && (mod_file_struct.order_option == 3
+                    || mod_file_struct.dynamic_derivs_order >= 3
+                    || output == third);
               int paramsDerivsOrder = 0;
-              if (mod_file_struct.identification_present || mod_file_struct.estimation_analytic_derivation)
-                paramsDerivsOrder = params_derivs_order;
+              if (!derivatives_cache_hit)
+                paramsDerivsOrder = min(params_derivs_order, mod_file_struct.params_derivs_order);
               dynamic_model.computingPass(true, hessian, thirdDerivatives, paramsDerivsOrder, global_eval_context, no_tmp_terms, block, use_dll, byte_code);
               if (linear && mod_file_struct.ramsey_model_present)
                 orig_ramsey_dynamic_model.computingPass(true, true, false, paramsDerivsOrder, global_eval_context, no_tmp_terms, block, use_dll, byte_code);
             }
         }
       else // No computing task requested, compute derivatives up to 2nd order by default
-        dynamic_model.computingPass(true, true, false, none, global_eval_context, no_tmp_terms, block, use_dll, byte_code);
+        dynamic_model.computingPass(true, !derivatives_cache_hit, false, none, global_eval_context, no_tmp_terms, block, use_dll, byte_code);
 
       if ((linear && !mod_file_struct.ramsey_model_present && !dynamic_model.checkHessianZero())
           || (linear && mod_file_struct.ramsey_model_present && !orig_ramsey_dynamic_model.checkHessianZero()))
@@ -593,6 +637,90 @@ ModFile::computingPass(bool no_tmp_terms, FileOutputType output, int params_deri
     (*it)->computingPass();
 }
 
+unsigned int
+ModFile::computeDerivativesCacheKey(bool no_tmp_terms, FileOutputType output, int params_derivs_order) const
+{
+  ostringstream options;
+  options << PACKAGE_VERSION << " " << dynamic_model.computeChecksum()
+          << " " << no_tmp_terms << " " << output << " " << params_derivs_order
+          << " " << use_dll << " " << no_static << " " << compact_lags << " " << mod_file_struct.order_option
+          << " " << mod_file_struct.perfect_foresight_solver_present
+          << " " << mod_file_struct.check_present
+          << " " << mod_file_struct.stoch_simul_present
+          << " " << mod_file_struct.estimation_present
+          << " " << mod_file_struct.osr_present
+          << " " << mod_file_struct.ramsey_model_present
+          << " " << mod_file_struct.identification_present
+          << " " << mod_file_struct.calib_smoother_present
+          << " " << mod_file_struct.estimation_analytic_derivation
+          << " " << mod_file_struct.dynamic_derivs_order
+          << " " << mod_file_struct.static_derivs_order
+          << " " << mod_file_struct.params_derivs_order;
+
+  const string &s = options.str();
+  boost::crc_32_type result;
+  result.process_bytes(s.c_str(), s.size());
+  return result.checksum();
+}
+
+bool
+ModFile::readDerivativesCache(const string &basename)
+{
+  string filename = basename + "/derivatives_cache";
+  ifstream cache_file(filename.c_str(), ios::in | ios::binary);
+  if (!cache_file.is_open())
+    return false;
+
+  unsigned int key;
+  int nnz2, nnz3;
+  bool hessian_eq_zero;
+  cache_file >> key >> nnz2 >> nnz3 >> hessian_eq_zero;
+  if (cache_file.fail() || key != derivatives_cache_key)
+    return false;
+
+  dynamic_model.setNNZDerivatives(2, nnz2);
+  dynamic_model.setNNZDerivatives(3, nnz3);
+  cached_hessian_eq_zero = hessian_eq_zero;
+  return true;
+}
+
+void
+ModFile::writeDynamicFiles(const string &basename) const
+{
+  dynamic_model.writeDynamicFile(basename, block, byte_code, use_dll, mod_file_struct.order_option, false);
+  dynamic_model.writeParamsDerivativesFile(basename, false);
+
+  if (derivatives_cache_key != 0)
+    writeDerivativesCache(basename);
+  if (use_equation_derivatives_cache)
+    dynamic_model.writeEquationDerivativesCache(basename + "/dynamic_equation_derivatives");
+}
+
+void *
+ModFile::writeDynamicFilesThread(void *arg)
+{
+  pair<const ModFile *, const string *> *mod_file_and_basename = static_cast<pair<const ModFile *, const string *> *>(arg);
+  mod_file_and_basename->first->writeDynamicFiles(*mod_file_and_basename->second);
+  return NULL;
+}
+
+void
+ModFile::writeDerivativesCache(const string &basename) const
+{
+  string filename = basename + "/derivatives_cache";
+  ofstream cache_file(filename.c_str(), ios::out | ios::binary);
+  if (!cache_file.is_open())
+    {
+      cerr << "ERROR: Can't open file " << filename << " for writing" << endl;
+      exit(EXIT_FAILURE);
+    }
+  cache_file << derivatives_cache_key << " "
+             << dynamic_model.getNNZDerivatives(2) << " "
+             << dynamic_model.getNNZDerivatives(3) << " "
+             << dynamic_model.checkHessianZero() << endl;
+  cache_file.close();
+}
+
 void
 ModFile::writeOutputFiles(const string &basename, bool clear_all, bool clear_global, bool no_log, bool no_warn,
                           bool console, bool nograph, bool nointeractive, const ConfigFile &config_file,
@@ -722,7 +850,9 @@ ModFile::writeOutputFiles(const string &basename, bool clear_all, bool clear_glo
       mOutputFile << "};" << endl;
     }
 
-  mOutputFile << "M_.hessian_eq_zero = " << dynamic_model.checkHessianZero() << ";" << endl;
+  mOutputFile << "M_.hessian_eq_zero = "
+              << (derivatives_cache_hit ? cached_hessian_eq_zero : dynamic_model.checkHessianZero())
+              << ";" << endl;
 
   config_file.writeCluster(mOutputFile);
 
@@ -731,9 +861,16 @@ ModFile::writeOutputFiles(const string &basename, bool clear_all, bool clear_glo
                 << "  error('DYNARE: Can''t find bytecode DLL. Please compile it or remove the ''bytecode'' option.')" << endl
                 << "end" << endl;
 
-  bool hasModelChanged = !dynamic_model.isChecksumMatching(basename);
-  if (!check_model_changes)
-    hasModelChanged = true;
+  /* If the derivatives have been found in the cache, the static and dynamic
+     files of the previous run are up to date. Otherwise, when the cache is
+     used, something changed (possibly only the options): rewrite them. */
+  bool hasModelChanged = false;
+  if (!derivatives_cache_hit)
+    {
+      hasModelChanged = !dynamic_model.isChecksumMatching(basename);
+      if (!check_model_changes || derivatives_cache_key != 0)
+        hasModelChanged = true;
+    }
 
   if (hasModelChanged)
     {
@@ -887,6 +1024,19 @@ ModFile::writeOutputFiles(const string &basename, bool clear_all, bool clear_glo
 
   if (hasModelChanged)
     {
+      /* The dynamic files are written in a separate thread, concurrently with
+         the static and steady state files: the two models have distinct trees,
+         and only read the symbol table and the numerical constants. This is
+         not done with block and bytecode, whose writers change the
+         current directory or use shared output files. */
+      bool dynamic_files_thread = false;
+#ifdef HAVE_PTHREAD
+      pthread_t dynamic_thread;
+      pair<const ModFile *, const string *> thread_arg(this, &basename);
+      if (dynamic_model.equation_number() > 0 && !block && !byte_code)
+        dynamic_files_thread = !pthread_create(&dynamic_thread, NULL, writeDynamicFilesThread, &thread_arg);
+#endif
+
       // Create static and dynamic files
       if (dynamic_model.equation_number() > 0)
         {
@@ -894,14 +1044,21 @@ ModFile::writeOutputFiles(const string &basename, bool clear_all, bool clear_glo
             {
               static_model.writeStaticFile(basename, block, byte_code, use_dll, false);
               static_model.writeParamsDerivativesFile(basename, false);
+              if (use_equation_derivatives_cache)
+                static_model.writeEquationDerivativesCache(basename + "/static_equation_derivatives");
             }
 
-          dynamic_model.writeDynamicFile(basename, block, byte_code, use_dll, mod_file_struct.order_option, false);
-          dynamic_model.writeParamsDerivativesFile(basename, false);
+          if (!dynamic_files_thread)
+            writeDynamicFiles(basename);
         }
 
       // Create steady state file
       steady_state_model.writeSteadyStateFile(basename, mod_file_struct.ramsey_model_present, false);
+
+#ifdef HAVE_PTHREAD
+      if (dynamic_files_thread)
+        pthread_join(dynamic_thread, NULL);
+#endif
     }
 
   cout << "done" << endl;
@@ -1239,7 +1396,9 @@ ModFile::writeExternalFilesJulia(const string &basename, FileOutputType output)
     (*it)->writeJuliaOutput(jlOutputFile, basename);
 
   jlOutputFile << "model_.static = " << basename << "Static.static!" << endl
+               << "model_.static_jacobian_pattern = " << basename << "Static.static_jacobian_pattern" << endl
                << "model_.dynamic = " << basename << "Dynamic.dynamic!" << endl
+               << "model_.dynamic_jacobian_pattern = " << basename << "Dynamic.dynamic_jacobian_pattern" << endl
                << "if isfile(\"" << basename << "SteadyState.jl"  "\")" << endl
                << "    model_.user_written_analytical_steady_state = true" << endl
                << "    model_.steady_state = " << basename << "SteadyState.steady_state!" << endl
@@ -1261,6 +1420,19 @@ ModFile::writeExternalFilesJulia(const string &basename, FileOutputType output)
   cout << "done" << endl;
 }
 
+void
+ModFile::writeModelIR(const string &basename) const
+{
+  if (dynamic_model.equation_number() == 0)
+    return;
+
+  cout << "Writing the model IR files...";
+  dynamic_model.writeModelIR(basename + "_dynamic.ir");
+  if (!no_static)
+    static_model.writeModelIR(basename + "_static.ir");
+  cout << "done" << endl;
+}
+
 void
 ModFile::writeJsonOutput(const string &basename, JsonOutputPointType json, JsonFileOutputType json_output_mode, bool onlyjson, bool jsonprintderivdetail)
 {
@@ -1304,7 +1476,8 @@ ModFile::writeJsonOutput(const string &basename, JsonOutputPointType json, JsonF
 void
 ModFile::writeJsonOutputParsingCheck(const string &basename, JsonFileOutputType json_output_mode) const
 {
-  ostringstream output;
+  JsonOutputFile *file = openJsonOutput(basename, json_output_mode);
+  ostream &output = file == NULL ? cout : file->stream();
   output << "{" << endl;
 
   symbol_table.writeJsonOutput(output);
@@ -1324,173 +1497,103 @@ ModFile::writeJsonOutputParsingCheck(const string &basename, JsonFileOutputType
       output << "]" << endl;
     }
   output << "}" << endl;
-
-  if (json_output_mode == standardout)
-    cout << output.str();
-  else
-    {
-      ofstream jsonOutputFile;
-
-      if (basename.size())
-        {
-          string fname(basename);
-          fname += ".json";
-          jsonOutputFile.open(fname.c_str(), ios::out | ios::binary);
-          if (!jsonOutputFile.is_open())
-            {
-              cerr << "ERROR: Can't open file " << fname << " for writing" << endl;
-              exit(EXIT_FAILURE);
-            }
-        }
-      else
-        {
-          cerr << "ERROR: Missing file name" << endl;
-          exit(EXIT_FAILURE);
-        }
-
-      jsonOutputFile << output.str();
-      jsonOutputFile.close();
-    }
+  delete file;
 }
 
 void
 ModFile::writeJsonComputingPassOutput(const string &basename, JsonFileOutputType json_output_mode, bool jsonprintderivdetail) const
 {
-  ostringstream static_output, static_detail_output;
-  static_output << "{";
-  static_model.writeJsonComputingPassOutput(static_output, false);
-  static_output << "}" << endl;
-
-  ostringstream dynamic_output, dynamic_detail_output;
-  dynamic_output << "{";
-  dynamic_model.writeJsonComputingPassOutput(dynamic_output, false);
-  dynamic_output << "}" << endl;
-
-  ostringstream original_model_output;
-  original_model_output << "{";
-  original_model.writeJsonOriginalModelOutput(original_model_output);
-  original_model_output << "}" << endl;
-
-  ostringstream tmp_out, static_paramsd_output, static_paramsd_detail_output;
-  tmp_out << "";
-  static_paramsd_output << "";
-  static_paramsd_detail_output << "";
-  static_model.writeJsonParamsDerivativesFile(tmp_out, false);
-  if (!tmp_out.str().empty())
-    static_paramsd_output << "{" << tmp_out.str() << "}" << endl;
-
-  ostringstream tmp1_out, dynamic_paramsd_output, dynamic_paramsd_detail_output;
-  tmp1_out << "";
-  dynamic_paramsd_output << "";
-  dynamic_paramsd_detail_output << "";
-  dynamic_model.writeJsonParamsDerivativesFile(tmp1_out, false);
-  if (!tmp1_out.str().empty())
-    dynamic_paramsd_output << "{" << tmp1_out.str() << "}" << endl;
-
-  if (jsonprintderivdetail)
-    {
-      static_detail_output << "{";
-      static_model.writeJsonComputingPassOutput(static_detail_output, true);
-      static_detail_output << "}";
-
-      dynamic_detail_output << "{";
-      dynamic_model.writeJsonComputingPassOutput(dynamic_detail_output, true);
-      dynamic_detail_output << "}";
-
-      ostringstream tmpd_out, tmpd1_out;
-      tmpd_out << "";
-      tmpd1_out << "";
-      static_model.writeJsonParamsDerivativesFile(tmpd_out, true);
-      if (!tmpd_out.str().empty())
-        static_paramsd_detail_output << "{" << tmpd_out.str() << "}" << endl;
-
-      dynamic_model.writeJsonParamsDerivativesFile(tmpd1_out, true);
-      if (!tmpd1_out.str().empty())
-        dynamic_paramsd_detail_output << "{" << tmpd1_out.str() << "}" << endl;
+  /* Every document is written directly to its file (or to the standard
+     output, one after the other), as the derivatives are walked */
+  JsonOutputFile *file = openJsonOutput(basename + "_original", json_output_mode);
+  ostream *output = file == NULL ? &cout : &file->stream();
+  *output << "{";
+  original_model.writeJsonOriginalModelOutput(*output);
+  *output << "}" << endl;
+  delete file;
+
+  file = openJsonOutput(basename + "_static", json_output_mode);
+  output = file == NULL ? &cout : &file->stream();
+  *output << "{";
+  static_model.writeJsonComputingPassOutput(*output, false);
+  *output << "}" << endl;
+  delete file;
+
+  file = openJsonOutput(basename + "_dynamic", json_output_mode);
+  output = file == NULL ? &cout : &file->stream();
+  *output << "{";
+  dynamic_model.writeJsonComputingPassOutput(*output, false);
+  *output << "}" << endl;
+  delete file;
+
+  if (static_model.hasParamsDerivatives())
+    {
+      file = openJsonOutput(basename + "_static_params_derivs", json_output_mode);
+      output = file == NULL ? &cout : &file->stream();
+      *output << "{";
+      static_model.writeJsonParamsDerivativesFile(*output, false);
+      *output << "}" << endl;
+      delete file;
     }
 
-  if (json_output_mode == standardout)
+  if (dynamic_model.hasParamsDerivatives())
     {
-      cout << original_model_output.str() << endl
-           << static_output.str() << endl
-           << dynamic_output.str() << endl;
-
-      if (!static_paramsd_output.str().empty())
-        cout << static_paramsd_output.str() << endl;
-
-      if (!dynamic_paramsd_output.str().empty())
-        cout << dynamic_paramsd_output.str() << endl;
-
-      if (jsonprintderivdetail)
-        {
-          cout << static_detail_output.str() << endl
-               << dynamic_detail_output.str() << endl;
-
-          if (!static_paramsd_detail_output.str().empty())
-            cout << static_paramsd_detail_output.str() << endl;
-
-          if (!dynamic_paramsd_detail_output.str().empty())
-            cout << dynamic_paramsd_detail_output.str() << endl;
-        }
+      file = openJsonOutput(basename + "_params_derivs", json_output_mode);
+      output = file == NULL ? &cout : &file->stream();
+      *output << "{";
+      dynamic_model.writeJsonParamsDerivativesFile(*output, false);
+      *output << "}" << endl;
+      delete file;
     }
-  else
-    {
-      if (basename.empty())
-        {
-          cerr << "ERROR: Missing file name" << endl;
-          exit(EXIT_FAILURE);
-        }
 
-      string fname_original, fname_static, fname_dynamic;
-      fname_original = basename + "_original.json";
-      fname_static = basename + "_static.json";
-      fname_dynamic = basename + "_dynamic.json";
-
-      writeJsonFileHelper(fname_original, original_model_output);
-      writeJsonFileHelper(fname_static, static_output);
-      writeJsonFileHelper(fname_dynamic, dynamic_output);
-
-      if (jsonprintderivdetail)
-        {
-          string fname_static_details, fname_dynamic_details;
-          fname_static_details = basename + "_static_details.json";
-          fname_dynamic_details = basename + "_dynamic_details.json";
-
-          writeJsonFileHelper(fname_static_details, static_detail_output);
-          writeJsonFileHelper(fname_dynamic_details, dynamic_detail_output);
-        }
+  if (!jsonprintderivdetail)
+    return;
 
-      if (!static_paramsd_output.str().empty())
-        {
-          string fname_static_params, fname_static_params_details;
-          fname_static_params = basename + "_static_params_derivs.json";
-          fname_static_params_details = basename + "_static_params_derivs_details.json";
-          writeJsonFileHelper(fname_static_params, static_paramsd_output);
-          writeJsonFileHelper(fname_static_params_details, static_paramsd_detail_output);
-        }
+  file = openJsonOutput(basename + "_static_details", json_output_mode);
+  output = file == NULL ? &cout : &file->stream();
+  *output << "{";
+  static_model.writeJsonComputingPassOutput(*output, true);
+  *output << "}" << endl;
+  delete file;
+
+  file = openJsonOutput(basename + "_dynamic_details", json_output_mode);
+  output = file == NULL ? &cout : &file->stream();
+  *output << "{";
+  dynamic_model.writeJsonComputingPassOutput(*output, true);
+  *output << "}" << endl;
+  delete file;
+
+  if (static_model.hasParamsDerivatives())
+    {
+      file = openJsonOutput(basename + "_static_params_derivs_details", json_output_mode);
+      output = file == NULL ? &cout : &file->stream();
+      *output << "{";
+      static_model.writeJsonParamsDerivativesFile(*output, true);
+      *output << "}" << endl;
+      delete file;
+    }
 
-      if (!dynamic_paramsd_output.str().empty())
-        {
-          string fname_dynamic_params, fname_dynamic_params_details;
-          fname_dynamic_params = basename + "_params_derivs.json";
-          fname_dynamic_params_details = basename + "_params_derivs_details.json";
-          writeJsonFileHelper(fname_dynamic_params, dynamic_paramsd_output);
-          writeJsonFileHelper(fname_dynamic_params_details, dynamic_paramsd_detail_output);
-        }
+  if (dynamic_model.hasParamsDerivatives())
+    {
+      file = openJsonOutput(basename + "_params_derivs_details", json_output_mode);
+      output = file == NULL ? &cout : &file->stream();
+      *output << "{";
+      dynamic_model.writeJsonParamsDerivativesFile(*output, true);
+      *output << "}" << endl;
+      delete file;
     }
 }
 
-void
-ModFile::writeJsonFileHelper(string &fname, ostringstream &output) const
+JsonOutputFile *
+ModFile::openJsonOutput(const string &basename, JsonFileOutputType json_output_mode) const
 {
-  ofstream jsonOutput;
-  jsonOutput.open(fname.c_str(), ios::out | ios::binary);
-  if (!jsonOutput.is_open())
+  if (json_output_mode == standardout)
+    return NULL;
+
+  if (basename.empty())
     {
-      cerr << "ERROR: Can't open file " << fname << " for writing" << endl;
+      cerr << "ERROR: Missing file name" << endl;
       exit(EXIT_FAILURE);
     }
-  jsonOutput << output.str();
-  jsonOutput.close();
-
+  return new JsonOutputFile(basename, json_output_mode == cborfile);
 }
@@ -38,6 +38,7 @@ using namespace std;
 #include "ConfigFile.hh"
 #include "WarningConsolidation.hh"
 #include "ExtendedPreprocessorTypes.hh"
+#include "JsonOutput.hh"
 
 // for checksum computation
 #ifndef PRIVATE_BUFFER_SIZE
@@ -87,6 +88,9 @@ public:
   //! Is the static model have to computed (no_static=false) or not (no_static=true). Option of 'model'
   bool no_static;
 
+  //! Are the leads and lags greater than one kept in the equations of a deterministic model, instead of being substituted by auxiliary variables? Option of 'model'
+  bool compact_lags;
+
   //! Is the 'differentiate_forward_vars' option used?
   bool differentiate_forward_vars;
 
@@ -117,10 +121,34 @@ private:
   ModFileStructure mod_file_struct;
   //! Warnings Encountered
   WarningConsolidation &warnings;
+  //! Key identifying the model and derivation options in the derivatives cache (0 if the cache is not used)
+  unsigned int derivatives_cache_key;
+  //! Whether the derivatives computed in a previous run with the same key have been found in the cache
+  /*! In that case, only the first order derivatives have been computed, and the static and dynamic files are not rewritten */
+  bool derivatives_cache_hit;
+  //! Value of DynamicModel::checkHessianZero() read from the derivatives cache
+  bool cached_hessian_eq_zero;
+  //! Whether the derivatives of the unchanged equations are restored from the previous run
+  /*! They are stored equation by equation in <basename>/static_equation_derivatives and <basename>/dynamic_equation_derivatives,
+    and complement the derivatives cache when the model has changed */
+  bool use_equation_derivatives_cache;
+  //! Computes the key of the derivatives cache, from the checksum of the dynamic model and the options affecting the derivation
+  unsigned int computeDerivativesCacheKey(bool no_tmp_terms, FileOutputType output, int params_derivs_order) const;
+  //! Reads the derivatives cache stored in <basename>/derivatives_cache
+  /*! Returns true if it matches derivatives_cache_key, in which case the summary of the derivatives stored in the cache is restored */
+  bool readDerivativesCache(const string &basename);
+  //! Writes the derivatives cache, to be reused by the next run with the same model and options
+  void writeDerivativesCache(const string &basename) const;
+  //! Writes the dynamic and dynamic params derivatives files (and the derivatives cache)
+  void writeDynamicFiles(const string &basename) const;
+  //! Thread entry point for writeDynamicFiles(), used by writeOutputFiles()
+  /*! The argument is a pointer to a pair<const ModFile *, const string *> (the mod file and the basename) */
+  static void *writeDynamicFilesThread(void *arg);
   //! Functions used in writing of JSON outut. See writeJsonOutput
   void writeJsonOutputParsingCheck(const string &basename, JsonFileOutputType json_output_mode) const;
   void writeJsonComputingPassOutput(const string &basename, JsonFileOutputType json_output_mode, bool jsonprintderivdetail) const;
-  void writeJsonFileHelper(string &fname, ostringstream &output) const;
+  //! Opens the JSON output file basename.json (or .cbor), returns NULL if the JSON goes to the standard output
+  JsonOutputFile *openJsonOutput(const string &basename, JsonFileOutputType json_output_mode) const;
 public:
   //! Add a statement
   void addStatement(Statement *st);
@@ -137,8 +165,10 @@ public:
   void transformPass(bool nostrict, bool compute_xrefs);
   //! Execute computations
   /*! \param no_tmp_terms if true, no temporary terms will be computed in the static and dynamic files */
-  /*! \param params_derivs_order compute this order of derivs wrt parameters */
-  void computingPass(bool no_tmp_terms, FileOutputType output, int params_derivs_order);
+  /*! \param params_derivs_order maximum order of derivs wrt parameters (the computing tasks may need less) */
+  /*! \param use_derivatives_cache if true, the derivatives of order 2 and above are not recomputed when neither the model nor the options changed since the last run (see the fast option) */
+  void computingPass(bool no_tmp_terms, FileOutputType output, int params_derivs_order,
+                     const string &basename, bool use_derivatives_cache);
   //! Writes Matlab/Octave output files
   /*!
     \param basename The base name used for writing output files. Should be the name of the mod file without its extension
@@ -168,6 +198,8 @@ public:
   //! Writes Cpp output files only => No further Matlab processing
   void writeCCOutputFiles(const string &basename) const;
   void writeModelCC(const string &basename) const;
+  //! Writes the dynamic and static models in the binary format of ModelIR.hh (model_ir option)
+  void writeModelIR(const string &basename) const;
 
   void computeChecksum();
   //! Write JSON representation of ModFile object
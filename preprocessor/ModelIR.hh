@@ -0,0 +1,594 @@
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Binary intermediate representation of a model, written by the preprocessor
+ * with the model_ir option (in <basename>_dynamic.ir and <basename>_static.ir),
+ * so that other tools can load the equations and their derivatives without
+ * parsing the generated MATLAB or JSON files.
+ *
+ * A file is made of a header followed by sections, which are arrays of the
+ * fixed-size records declared below, starting at offsets that are multiples of
+ * 8 bytes. It can therefore be mapped in memory and used in place, provided
+ * that the byte order is that of the machine (which the reader checks).
+ *
+ * The expressions form a single DAG, stored in the nodes section: each
+ * distinct node of the model appears once, after its arguments. Model local
+ * variables are expanded, i.e. a reference to a local variable is replaced
+ * by the node of its definition. Derivatives refer to the columns of the
+ * derivation variables section: for the dynamic model, these are the columns
+ * of the dynamic Jacobian (i.e. those of lead_lag_incidence, followed by the
+ * exogenous and deterministic exogenous variables), and for the static model
+ * the endogenous variables in declaration order. Second and third derivatives
+ * are only stored for one ordering of the variables, as in the MATLAB output.
+ *
+ * ModelIRReader is a self-contained reader, which only depends on this file
+ * and on CodeInterpreter.hh (for the operator codes).
+ */
+
+#ifndef _MODEL_IR_HH
+#define _MODEL_IR_HH
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#if !defined(_WIN32) && !defined(__CYGWIN32__) && !defined(__MINGW32__)
+# define MODEL_IR_USE_MMAP
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+#include "CodeInterpreter.hh"
+
+//! Incremented each time the layout of the file changes
+#define MODEL_IR_VERSION 1
+//! Written as is, so that a file with another byte order can be detected
+#define MODEL_IR_BYTE_ORDER 0x01020304
+
+enum ModelIRSection
+  {
+    irStrings,               //!< Symbol names, as NUL-terminated strings (the count is in bytes)
+    irSymbols,               //!< ModelIRSymbol records, indexed by symbol ID
+    irNodes,                 //!< ModelIRNode records
+    irEquations,             //!< ModelIREquation records
+    irLocalVariables,        //!< ModelIRLocalVariable records
+    irDerivationVariables,   //!< ModelIRDerivationVariable records, indexed by column
+    irFirstDerivatives,      //!< ModelIRDerivative<1> records
+    irSecondDerivatives,     //!< ModelIRDerivative<2> records
+    irThirdDerivatives,      //!< ModelIRDerivative<3> records
+    irSectionNumber
+  };
+
+enum ModelIRNodeKind
+  {
+    irConstant,
+    irVariable,
+    irUnaryOp,
+    irBinaryOp,
+    irTrinaryOp
+  };
+
+struct ModelIRSectionEntry
+{
+  uint64_t offset;
+  uint64_t count;
+};
+
+struct ModelIRHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  //! 1 for the dynamic model, 0 for the static model
+  uint32_t dynamic;
+  //! Highest order of the derivatives that have been computed (the derivatives of higher orders are absent, not null)
+  uint32_t order;
+  ModelIRSectionEntry sections[irSectionNumber];
+};
+
+struct ModelIRSymbol
+{
+  //! Offset of the name in the strings section
+  int32_t name;
+  //! A SymbolType
+  int32_t type;
+  //! Index among the symbols of the same type, or -1 if not applicable
+  int32_t type_specific_id;
+  int32_t padding;
+};
+
+struct ModelIRNode
+{
+  //! A ModelIRNodeKind
+  int32_t kind;
+  //! The UnaryOpcode, BinaryOpcode or TrinaryOpcode of an operator
+  int32_t op_code;
+  //! Indices of the arguments of an operator, or symbol ID and lag of a variable in arg[0] and arg[1]
+  int32_t arg[3];
+  //! Order of derivation, for oPowerDeriv
+  int32_t power_deriv_order;
+  //! Value of a constant
+  double constant;
+};
+
+//! An equation is lhs = rhs, its residual being lhs - rhs
+struct ModelIREquation
+{
+  int32_t lhs, rhs;
+};
+
+struct ModelIRLocalVariable
+{
+  int32_t symbol, node;
+};
+
+struct ModelIRDerivationVariable
+{
+  int32_t symbol, lag;
+};
+
+template<int order>
+struct ModelIRDerivative
+{
+  int32_t equation;
+  //! Columns in the derivation variables section
+  int32_t var[order];
+  int32_t node;
+};
+
+//! Returns the number of bytes to add after a section of the given size so that the next one is aligned
+inline uint64_t
+modelIRPadding(uint64_t size)
+{
+  return (8 - size % 8) % 8;
+}
+
+//! Reads a model IR file, and evaluates its nodes
+/*! On POSIX systems, the file is mapped in memory rather than read */
+class ModelIRReader
+{
+public:
+  //! Callback returning the value of a variable, given its symbol ID and lag
+  typedef double (*variable_value_t)(int symb_id, int lag, void *data);
+
+  ModelIRReader() : data(NULL), size(0), mapped(false), header(NULL)
+  {
+  };
+  ~ModelIRReader()
+  {
+    close();
+  };
+
+  //! Opens and checks a file, returns false (with a message in error()) if it can't be used
+  bool
+  open(const char *filename)
+  {
+    close();
+#ifdef MODEL_IR_USE_MMAP
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0)
+      return fail(std::string("can't open ") + filename);
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+      {
+        void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED)
+          {
+            data = static_cast<char *>(p);
+            size = st.st_size;
+            mapped = true;
+          }
+      }
+    ::close(fd);
+    if (!mapped)
+      return fail(std::string("can't map ") + filename);
+#else
+    FILE *fd = fopen(filename, "rb");
+    if (fd == NULL)
+      return fail(std::string("can't open ") + filename);
+    fseek(fd, 0, SEEK_END);
+    long length = ftell(fd);
+    fseek(fd, 0, SEEK_SET);
+    if (length > 0)
+      {
+        // malloc() returns memory aligned for any type, as the records require
+        data = static_cast<char *>(malloc(length));
+        size = length;
+        if (data != NULL && fread(data, 1, size, fd) != size)
+          {
+            free(data);
+            data = NULL;
+          }
+      }
+    fclose(fd);
+    if (data == NULL)
+      return fail(std::string("can't read ") + filename);
+#endif
+    return check();
+  };
+
+  void
+  close()
+  {
+    if (data != NULL)
+      {
+#ifdef MODEL_IR_USE_MMAP
+        if (mapped)
+          munmap(data, size);
+#else
+        free(data);
+#endif
+      }
+    data = NULL;
+    size = 0;
+    mapped = false;
+    header = NULL;
+  };
+
+  const std::string &
+  error() const
+  {
+    return error_message;
+  };
+
+  bool
+  isDynamic() const
+  {
+    return header->dynamic != 0;
+  };
+
+  int
+  order() const
+  {
+    return header->order;
+  };
+
+  //! Number of records (or of bytes, for the strings) of a section
+  size_t
+  count(ModelIRSection section) const
+  {
+    return header->sections[section].count;
+  };
+
+  const ModelIRSymbol *
+  symbols() const
+  {
+    return records<ModelIRSymbol>(irSymbols);
+  };
+  const char *
+  symbolName(int symb_id) const
+  {
+    return records<char>(irStrings) + symbols()[symb_id].name;
+  };
+  const ModelIRNode *
+  nodes() const
+  {
+    return records<ModelIRNode>(irNodes);
+  };
+  const ModelIREquation *
+  equations() const
+  {
+    return records<ModelIREquation>(irEquations);
+  };
+  const ModelIRLocalVariable *
+  localVariables() const
+  {
+    return records<ModelIRLocalVariable>(irLocalVariables);
+  };
+  const ModelIRDerivationVariable *
+  derivationVariables() const
+  {
+    return records<ModelIRDerivationVariable>(irDerivationVariables);
+  };
+  const ModelIRDerivative<1> *
+  firstDerivatives() const
+  {
+    return records<ModelIRDerivative<1> >(irFirstDerivatives);
+  };
+  const ModelIRDerivative<2> *
+  secondDerivatives() const
+  {
+    return records<ModelIRDerivative<2> >(irSecondDerivatives);
+  };
+  const ModelIRDerivative<3> *
+  thirdDerivatives() const
+  {
+    return records<ModelIRDerivative<3> >(irThirdDerivatives);
+  };
+
+  //! Computes the values of all the nodes, in a single pass
+  /*! Operators are evaluated as ExprNode::eval() does, except that the
+    operators which can't be evaluated (expectations and derivatives of the
+    steady state) give NaN instead of failing. */
+  void
+  evaluate(std::vector<double> &values, variable_value_t variable_value, void *user_data) const
+  {
+    size_t n = count(irNodes);
+    const ModelIRNode *node = nodes();
+    values.resize(n);
+    for (size_t i = 0; i < n; i++, node++)
+      switch (node->kind)
+        {
+        case irConstant:
+          values[i] = node->constant;
+          break;
+        case irVariable:
+          values[i] = variable_value(node->arg[0], node->arg[1], user_data);
+          break;
+        case irUnaryOp:
+          values[i] = evalUnary(node->op_code, values[node->arg[0]]);
+          break;
+        case irBinaryOp:
+          values[i] = evalBinary(node->op_code, values[node->arg[0]], values[node->arg[1]],
+                                 node->power_deriv_order);
+          break;
+        case irTrinaryOp:
+          values[i] = evalTrinary(node->op_code, values[node->arg[0]], values[node->arg[1]],
+                                  values[node->arg[2]]);
+          break;
+        }
+  };
+
+private:
+  char *data;
+  size_t size;
+  bool mapped;
+  const ModelIRHeader *header;
+  std::string error_message;
+
+  template<class T>
+  const T *
+  records(ModelIRSection section) const
+  {
+    return reinterpret_cast<const T *>(data + header->sections[section].offset);
+  };
+
+  bool
+  fail(const std::string &message)
+  {
+    close();
+    error_message = message;
+    return false;
+  };
+
+  //! Checks the header, and that all the indices stored in the file are valid
+  bool
+  check()
+  {
+    header = reinterpret_cast<const ModelIRHeader *>(data);
+    if (size < sizeof(ModelIRHeader) || memcmp(header->magic, "DYNIR", 6))
+      return fail("not a model IR file");
+    if (header->byte_order != MODEL_IR_BYTE_ORDER)
+      return fail("the byte order of the file is not that of this machine");
+    if (header->version != MODEL_IR_VERSION)
+      return fail("unsupported version of the model IR format");
+
+    static const size_t record_size[irSectionNumber] = {
+      1, sizeof(ModelIRSymbol), sizeof(ModelIRNode), sizeof(ModelIREquation),
+      sizeof(ModelIRLocalVariable), sizeof(ModelIRDerivationVariable),
+      sizeof(ModelIRDerivative<1>), sizeof(ModelIRDerivative<2>), sizeof(ModelIRDerivative<3>)
+    };
+    for (int s = 0; s < irSectionNumber; s++)
+      {
+        uint64_t offset = header->sections[s].offset, n = header->sections[s].count;
+        if (offset % 8 || offset > size || n > (size - offset) / record_size[s])
+          return fail("truncated or corrupted model IR file");
+      }
+
+    size_t nb_strings = count(irStrings), nb_symbols = count(irSymbols), nb_nodes = count(irNodes),
+      nb_columns = count(irDerivationVariables);
+    if (nb_strings > 0 && records<char>(irStrings)[nb_strings-1] != '\0')
+      return fail("invalid strings section");
+    for (size_t i = 0; i < nb_symbols; i++)
+      if (symbols()[i].name < 0 || (size_t) symbols()[i].name >= nb_strings)
+        return fail("invalid symbol name");
+
+    // Arguments must precede the nodes that use them, so that evaluate() needs a single pass
+    const ModelIRNode *node = nodes();
+    for (size_t i = 0; i < nb_nodes; i++, node++)
+      {
+        int nb_args;
+        switch (node->kind)
+          {
+          case irConstant:
+            nb_args = 0;
+            break;
+          case irVariable:
+            if (node->arg[0] < 0 || (size_t) node->arg[0] >= nb_symbols)
+              return fail("invalid variable node");
+            nb_args = 0;
+            break;
+          case irUnaryOp:
+            nb_args = 1;
+            break;
+          case irBinaryOp:
+            nb_args = 2;
+            break;
+          case irTrinaryOp:
+            nb_args = 3;
+            break;
+          default:
+            return fail("invalid node kind");
+          }
+        for (int j = 0; j < nb_args; j++)
+          if (node->arg[j] < 0 || (size_t) node->arg[j] >= i)
+            return fail("invalid node argument");
+      }
+
+    for (size_t i = 0; i < count(irEquations); i++)
+      if (!validIndex(equations()[i].lhs, nb_nodes) || !validIndex(equations()[i].rhs, nb_nodes))
+        return fail("invalid equation");
+    for (size_t i = 0; i < count(irLocalVariables); i++)
+      if (!validIndex(localVariables()[i].symbol, nb_symbols) || !validIndex(localVariables()[i].node, nb_nodes))
+        return fail("invalid local variable");
+    for (size_t i = 0; i < nb_columns; i++)
+      if (!validIndex(derivationVariables()[i].symbol, nb_symbols))
+        return fail("invalid derivation variable");
+    if (!checkDerivatives(firstDerivatives(), count(irFirstDerivatives), nb_nodes, nb_columns)
+        || !checkDerivatives(secondDerivatives(), count(irSecondDerivatives), nb_nodes, nb_columns)
+        || !checkDerivatives(thirdDerivatives(), count(irThirdDerivatives), nb_nodes, nb_columns))
+      return fail("invalid derivative");
+    return true;
+  };
+
+  static bool
+  validIndex(int32_t i, size_t n)
+  {
+    return i >= 0 && (size_t) i < n;
+  };
+
+  template<int deriv_order>
+  bool
+  checkDerivatives(const ModelIRDerivative<deriv_order> *d, size_t n, size_t nb_nodes, size_t nb_columns) const
+  {
+    for (size_t i = 0; i < n; i++, d++)
+      {
+        if (!validIndex(d->equation, count(irEquations)) || !validIndex(d->node, nb_nodes))
+          return false;
+        for (int j = 0; j < deriv_order; j++)
+          if (!validIndex(d->var[j], nb_columns))
+            return false;
+      }
+    return true;
+  };
+
+  static double
+  evalUnary(int op_code, double v)
+  {
+    switch (op_code)
+      {
+      case oUminus:
+        return -v;
+      case oExp:
+        return exp(v);
+      case oLog:
+        return log(v);
+      case oLog10:
+        return log10(v);
+      case oCos:
+        return cos(v);
+      case oSin:
+        return sin(v);
+      case oTan:
+        return tan(v);
+      case oAcos:
+        return acos(v);
+      case oAsin:
+        return asin(v);
+      case oAtan:
+        return atan(v);
+      case oCosh:
+        return cosh(v);
+      case oSinh:
+        return sinh(v);
+      case oTanh:
+        return tanh(v);
+      case oAcosh:
+        return acosh(v);
+      case oAsinh:
+        return asinh(v);
+      case oAtanh:
+        return atanh(v);
+      case oSqrt:
+        return sqrt(v);
+      case oAbs:
+        return fabs(v);
+      case oSign:
+        return v > 0 ? 1 : (v < 0 ? -1 : 0);
+      case oSteadyState:
+        return v;
+      case oErf:
+        return erf(v);
+      default:
+        return NAN;
+      }
+  };
+
+  static double
+  evalBinary(int op_code, double v1, double v2, int deriv_order)
+  {
+    switch (op_code)
+      {
+      case oPlus:
+        return v1 + v2;
+      case oMinus:
+        return v1 - v2;
+      case oTimes:
+        return v1 * v2;
+      case oDivide:
+        return v1 / v2;
+      case oPower:
+        return pow(v1, v2);
+      case oPowerDeriv:
+        if (fabs(v1) < NEAR_ZERO && v2 > 0
+            && deriv_order > v2
+            && fabs(v2-nearbyint(v2)) < NEAR_ZERO)
+          return 0.0;
+        else
+          {
+            double dxp = pow(v1, v2-deriv_order);
+            for (int i = 0; i < deriv_order; i++)
+              dxp *= v2--;
+            return dxp;
+          }
+      case oMax:
+        return v1 < v2 ? v2 : v1;
+      case oMin:
+        return v1 > v2 ? v2 : v1;
+      case oLess:
+        return v1 < v2;
+      case oGreater:
+        return v1 > v2;
+      case oLessEqual:
+        return v1 <= v2;
+      case oGreaterEqual:
+        return v1 >= v2;
+      case oEqualEqual:
+        return v1 == v2;
+      case oDifferent:
+        return v1 != v2;
+      default:
+        return NAN;
+      }
+  };
+
+  static double
+  evalTrinary(int op_code, double v1, double v2, double v3)
+  {
+    switch (op_code)
+      {
+      case oNormcdf:
+        return 0.5*(1+erf((v1-v2)/v3/M_SQRT2));
+      case oNormpdf:
+        return 1/(v3*sqrt(2*M_PI)*exp(pow((v1-v2)/v3, 2)/2));
+      default:
+        return NAN;
+      }
+  };
+};
+
+#endif
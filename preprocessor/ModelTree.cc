@@ -22,82 +22,76 @@
 #include <cmath>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <cctype>
+
+#ifndef _WIN32
+# include <unistd.h>
+#endif
+
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
 
 #include "ModelTree.hh"
 #include "MinimumFeedbackSet.hh"
+#include "ModelIR.hh"
 #include <boost/graph/adjacency_list.hpp>
 #include <boost/graph/max_cardinality_matching.hpp>
 #include <boost/graph/strong_components.hpp>
 #include <boost/graph/topological_sort.hpp>
 
+//! First line of the equation derivatives cache, which is discarded when written by another version
+static const string equation_derivatives_cache_header = "Dynare " PACKAGE_VERSION " equation derivatives cache";
+
 using namespace boost;
 using namespace MFS;
 
 bool
-ModelTree::computeNormalization(const jacob_map_t &contemporaneous_jacobian, bool verbose)
+ModelTree::computeNormalization(const jacob_map_t &contemporaneous_jacobian, bool verbose, BipartiteMatching &matching)
 {
   const int n = equations.size();
 
   assert(n == symbol_table.endo_nbr());
 
-  typedef adjacency_list<vecS, vecS, undirectedS> BipartiteGraph;
-
   /*
-    Vertices 0 to n-1 are for endogenous (using type specific ID)
-    Vertices n to 2*n-1 are for equations (using equation no.)
+    Equations are the left vertices of the bipartite graph, endogenous (using
+    type specific ID) are the right ones
   */
-  BipartiteGraph g(2 * n);
-
-  // Fill in the graph
-  set<pair<int, int> > endo;
-
+  vector<pair<int, int> > edges;
+  edges.reserve(contemporaneous_jacobian.size());
   for (jacob_map_t::const_iterator it = contemporaneous_jacobian.begin(); it != contemporaneous_jacobian.end(); it++)
-    add_edge(it->first.first + n, it->first.second, g);
-
-  // Compute maximum cardinality matching
-  vector<int> mate_map(2*n);
+    edges.push_back(it->first);
 
-#if 1
-  bool check = checked_edmonds_maximum_cardinality_matching(g, &mate_map[0]);
-#else // Alternative way to compute normalization, by giving an initial matching using natural normalizations
-  fill(mate_map.begin(), mate_map.end(), graph_traits<BipartiteGraph>::null_vertex());
-
-  multimap<int, int> natural_endo2eqs;
-  computeNormalizedEquations(natural_endo2eqs);
-
-  for (int i = 0; i < symbol_table.endo_nbr(); i++)
-    {
-      if (natural_endo2eqs.count(i) == 0)
-        continue;
-
-      int j = natural_endo2eqs.find(i)->second;
-
-      put(&mate_map[0], i, n+j);
-      put(&mate_map[0], n+j, i);
-    }
-
-  edmonds_augmenting_path_finder<BipartiteGraph, size_t *, property_map<BipartiteGraph, vertex_index_t>::type> augmentor(g, &mate_map[0], get(vertex_index, g));
-  bool not_maximum_yet = true;
-  while (not_maximum_yet)
-    {
-      not_maximum_yet = augmentor.augment_matching();
-    }
-  augmentor.get_current_matching(&mate_map[0]);
-
-  bool check = maximum_cardinality_matching_verifier<BipartiteGraph, size_t *, property_map<BipartiteGraph, vertex_index_t>::type>::verify_matching(g, &mate_map[0], get(vertex_index, g));
-#endif
-
-  assert(check);
+  // Compute maximum cardinality matching, starting from the matching of the previous call
+  matching.setEdges(edges);
+  int cardinality = matching.maximize();
 
 #ifdef DEBUG
+  {
+    // Validate the cardinality of the matching with the general graph algorithm of Boost
+    typedef adjacency_list<vecS, vecS, undirectedS> BipartiteGraph;
+    /*
+      Vertices 0 to n-1 are for endogenous (using type specific ID)
+      Vertices n to 2*n-1 are for equations (using equation no.)
+    */
+    BipartiteGraph g(2 * n);
+    for (jacob_map_t::const_iterator it = contemporaneous_jacobian.begin(); it != contemporaneous_jacobian.end(); it++)
+      add_edge(it->first.first + n, it->first.second, g);
+    vector<size_t> mate_map(2*n);
+    bool check = checked_edmonds_maximum_cardinality_matching(g, &mate_map[0]);
+    assert(check);
+    assert((int) matching_size(g, &mate_map[0]) == cardinality);
+  }
+
   for (int i = 0; i < n; i++)
     cout << "Endogenous " << symbol_table.getName(symbol_table.getID(eEndogenous, i))
-         << " matched with equation " << (mate_map[i]-n+1) << endl;
+         << " matched with equation " << (matching.getRightMate(i)+1) << endl;
 #endif
 
-  // Create the resulting map, by copying the n first elements of mate_map, and substracting n to them
-  endo2eq.resize(equations.size());
-  transform(mate_map.begin(), mate_map.begin() + n, endo2eq.begin(), bind2nd(minus<int>(), n));
+  endo2eq.resize(n);
+  for (int i = 0; i < n; i++)
+    endo2eq[i] = matching.getRightMate(i);
 
 #ifdef DEBUG
   multimap<int, int> natural_endo2eqs;
@@ -124,16 +118,18 @@ ModelTree::computeNormalization(const jacob_map_t &contemporaneous_jacobian, boo
 #endif
 
   // Check if all variables are normalized
-  vector<int>::const_iterator it = find(mate_map.begin(), mate_map.begin() + n, graph_traits<BipartiteGraph>::null_vertex());
-  if (it != mate_map.begin() + n)
+  if (cardinality < n)
     {
       if (verbose)
-        cerr << "ERROR: Could not normalize the model. Variable "
-             << symbol_table.getName(symbol_table.getID(eEndogenous, it - mate_map.begin()))
-             << " is not in the maximum cardinality matching." << endl;
-      check = false;
+        {
+          vector<int>::const_iterator it = find(endo2eq.begin(), endo2eq.end(), -1);
+          cerr << "ERROR: Could not normalize the model. Variable "
+               << symbol_table.getName(symbol_table.getID(eEndogenous, it - endo2eq.begin()))
+               << " is not in the maximum cardinality matching." << endl;
+        }
+      return false;
     }
-  return check;
+  return true;
 }
 
 void
@@ -159,6 +155,9 @@ ModelTree::computeNonSingularNormalization(jacob_map_t &contemporaneous_jacobian
   //We start with the highest value of the cutoff and try to normalize the model
   double current_cutoff = 0.99999999;
 
+  /* The edges kept for a given cutoff are a subset of those kept for a lower
+     one, so each attempt starts from the matching found by the previous one */
+  BipartiteMatching matching(n, n);
   int suppressed = 0;
   while (!check && current_cutoff > 1e-19)
     {
@@ -171,14 +170,14 @@ ModelTree::computeNonSingularNormalization(jacob_map_t &contemporaneous_jacobian
           suppress++;
 
       if (suppress != suppressed)
-        check = computeNormalization(tmp_normalized_contemporaneous_jacobian, false);
+        check = computeNormalization(tmp_normalized_contemporaneous_jacobian, false, matching);
       suppressed = suppress;
       if (!check)
         {
           current_cutoff /= 2;
           // In this last case try to normalize with the complete jacobian
           if (current_cutoff <= 1e-19)
-            check = computeNormalization(normalized_contemporaneous_jacobian, false);
+            check = computeNormalization(normalized_contemporaneous_jacobian, false, matching);
         }
     }
 
@@ -195,7 +194,8 @@ ModelTree::computeNonSingularNormalization(jacob_map_t &contemporaneous_jacobian
           for (set<pair<int, int> >::const_iterator it = endo.begin(); it != endo.end(); it++)
             tmp_normalized_contemporaneous_jacobian[make_pair(i, it->first)] = 1;
         }
-      check = computeNormalization(tmp_normalized_contemporaneous_jacobian, true);
+      BipartiteMatching symbolic_matching(n, n);
+      check = computeNormalization(tmp_normalized_contemporaneous_jacobian, true, symbolic_matching);
       if (check)
         {
           // Update the jacobian matrix
@@ -257,6 +257,18 @@ ModelTree::evaluateAndReduceJacobian(const eval_context_t &eval_context, jacob_m
 {
   int nb_elements_contemparenous_Jacobian = 0;
   set<pair<int, int> > jacobian_elements_to_delete;
+
+  /* Evaluate all the elements at once with a flattened program, which
+     computes the subexpressions shared by the derivatives only once */
+  EvalProgram program;
+  vector<int> jacobian_elements;
+  for (first_derivatives_t::const_iterator it = first_derivatives.begin();
+       it != first_derivatives.end(); it++)
+    if (getTypeByDerivID(it->first.second) == eEndogenous)
+      jacobian_elements.push_back(program.addExpression(it->second));
+  program.eval(eval_context);
+
+  vector<int>::const_iterator element = jacobian_elements.begin();
   for (first_derivatives_t::const_iterator it = first_derivatives.begin();
        it != first_derivatives.end(); it++)
     {
@@ -271,7 +283,7 @@ ModelTree::evaluateAndReduceJacobian(const eval_context_t &eval_context, jacob_m
           double val = 0;
           try
             {
-              val = Id->eval(eval_context);
+              val = program.value(*element++);
             }
           catch (ExprNode::EvalExternalFunctionException &e)
             {
@@ -664,12 +676,19 @@ ModelTree::computeBlockDecompositionAndFeedbackVariablesForEachBlock(const jacob
       AdjacencyList_t G = extract_subgraph(G2, components_set[i].first);
       set<int> feed_back_vertices;
       //Print(G);
-      AdjacencyList_t G1 = Minimal_set_of_feedback_vertex(feed_back_vertices, G);
+      vector<int> Reordered_Vertice;
+      Minimal_set_of_feedback_vertex_compact(feed_back_vertices, Reordered_Vertice, G);
+#ifdef DEBUG
+      // Check against the reference implementation
+      set<int> feed_back_vertices_ref;
+      vector<int> Reordered_Vertice_ref;
+      Minimal_set_of_feedback_vertex(feed_back_vertices_ref, G);
+      Reorder_the_recursive_variables(G, feed_back_vertices_ref, Reordered_Vertice_ref);
+      assert(feed_back_vertices == feed_back_vertices_ref && Reordered_Vertice == Reordered_Vertice_ref);
+#endif
       property_map<AdjacencyList_t, vertex_index_t>::type v_index = get(vertex_index, G);
       components_set[i].second.first = feed_back_vertices;
       blocks[i].second = feed_back_vertices.size();
-      vector<int> Reordered_Vertice;
-      Reorder_the_recursive_variables(G, feed_back_vertices, Reordered_Vertice);
 
       //First we have the recursive equations conditional on feedback variables
       for (int j = 0; j < 4; j++)
@@ -940,6 +959,33 @@ ModelTree::reduceBlocksAndTypeDetermination(const dynamic_jacob_map_t &dynamic_j
   return (block_type_size_mfs);
 }
 
+vector<vector<unsigned int> >
+ModelTree::computeBlockDependencies() const
+{
+  unsigned int nb_blocks = getNbBlocks();
+  map<int, unsigned int> variable_block;
+  for (unsigned int block = 0; block < nb_blocks; block++)
+    for (unsigned int i = 0; i < getBlockSize(block); i++)
+      variable_block[getBlockVariableID(block, i)] = block;
+
+  vector<vector<unsigned int> > dependencies(nb_blocks);
+  for (unsigned int block = 0; block < nb_blocks; block++)
+    {
+      set<pair<int, int> > endogenous;
+      for (unsigned int i = 0; i < getBlockSize(block); i++)
+        getBlockEquationExpr(block, i)->collectEndogenous(endogenous);
+      set<unsigned int> blocks;
+      for (set<pair<int, int> >::const_iterator it = endogenous.begin(); it != endogenous.end(); it++)
+        {
+          map<int, unsigned int>::const_iterator it1 = variable_block.find(it->first);
+          if (it1 != variable_block.end() && it1->second != block)
+            blocks.insert(it1->second);
+        }
+      dependencies[block] = vector<unsigned int>(blocks.begin(), blocks.end());
+    }
+  return dependencies;
+}
+
 vector<bool>
 ModelTree::BlockLinear(const blocks_derivatives_t &blocks_derivatives, const vector<int> &variable_reordered) const
 {
@@ -1006,6 +1052,9 @@ ModelTree::ModelTree(SymbolTable &symbol_table_arg,
                      NumericalConstants &num_constants_arg,
                      ExternalFunctionsTable &external_functions_table_arg) :
   DataTree(symbol_table_arg, num_constants_arg, external_functions_table_arg),
+  c_batch(false),
+  use_equation_derivatives_cache(false),
+  derivation_order(0),
   cutoff(1e-15),
   mfs(0)
 
@@ -1020,6 +1069,117 @@ ModelTree::equation_number() const
   return (equations.size());
 }
 
+bool
+ModelTree::hasParamsDerivatives() const
+{
+  return residuals_params_derivatives.size()
+    || residuals_params_second_derivatives.size()
+    || jacobian_params_derivatives.size()
+    || jacobian_params_second_derivatives.size()
+    || hessian_params_derivatives.size();
+}
+
+int
+ModelTree::getNNZDerivatives(int order) const
+{
+  assert(order >= 1 && order <= 3);
+  return NNZDerivatives[order-1];
+}
+
+void
+ModelTree::setNNZDerivatives(int order, int nnz)
+{
+  assert(order >= 1 && order <= 3);
+  NNZDerivatives[order-1] = nnz;
+}
+
+void
+ModelTree::setCBatch(bool c_batch_arg)
+{
+  c_batch = c_batch_arg;
+}
+
+void
+ModelTree::writeCBatchedCode(ostream &output, const string &code, const string &indent)
+{
+  const int narrays = 6;
+  const string arrays[narrays] = { "y", "x", "params", "steady_state", "residual", "g1" };
+
+  istringstream input(code);
+  string line;
+  while (getline(input, line))
+    {
+      if (line.empty())
+        {
+          output << endl;
+          continue;
+        }
+      output << indent;
+      size_t i = 0;
+      while (i < line.size())
+        {
+          bool rewritten = false;
+          if (i == 0 || !(isalnum(line[i-1]) || line[i-1] == '_'))
+            for (int a = 0; a < narrays && !rewritten; a++)
+              {
+                size_t len = arrays[a].size();
+                if (line.compare(i, len, arrays[a]) == 0 && i + len < line.size()
+                    && line[i+len] == '[')
+                  {
+                    // Look for the matching closing bracket
+                    size_t j = i + len + 1;
+                    int depth = 1;
+                    while (j < line.size() && depth > 0)
+                      {
+                        if (line[j] == '[')
+                          depth++;
+                        else if (line[j] == ']')
+                          depth--;
+                        j++;
+                      }
+                    assert(depth == 0);
+                    output << arrays[a] << "[(" << line.substr(i + len + 1, j - i - len - 2) << ")*K+k]";
+                    i = j;
+                    rewritten = true;
+                  }
+              }
+          if (!rewritten)
+            output << line[i++];
+        }
+      output << endl;
+    }
+}
+
+void
+ModelTree::writeJuliaJacobianPattern(ostream &output, const string &func_name,
+                                     const map<pair<int, int>, int> &csc_index, int nrows, int ncols)
+{
+  vector<int> colptr(ncols + 1, 0);
+  for (map<pair<int, int>, int>::const_iterator it = csc_index.begin();
+       it != csc_index.end(); it++)
+    colptr[it->first.first + 1]++;
+  colptr[0] = 1;
+  for (int j = 0; j < ncols; j++)
+    colptr[j + 1] += colptr[j];
+
+  output << "#" << endl
+         << "# Sparsity pattern of the Jacobian (compressed sparse column)" << endl
+         << "#" << endl
+         << "const g1_colptr = Int[";
+  for (int j = 0; j <= ncols; j++)
+    output << (j > 0 ? ", " : "") << colptr[j];
+  output << "]" << endl
+         << "const g1_rowval = Int[";
+  for (map<pair<int, int>, int>::const_iterator it = csc_index.begin();
+       it != csc_index.end(); it++)
+    output << (it != csc_index.begin() ? ", " : "") << it->first.second + 1;
+  output << "]" << endl << endl
+         << "function " << func_name << "()" << endl
+         << "  return SparseMatrixCSC(" << nrows << ", " << ncols << ", copy(g1_colptr), copy(g1_rowval), "
+         << "zeros(Float64, " << csc_index.size() << "))" << endl
+         << "end" << endl << endl;
+}
+
 void
 ModelTree::writeDerivative(ostream &output, int eq, int symb_id, int lag,
                            ExprNodeOutputType output_type,
@@ -1035,11 +1195,44 @@ ModelTree::writeDerivative(ostream &output, int eq, int symb_id, int lag,
 void
 ModelTree::computeJacobian(const set<int> &vars)
 {
+  derivation_order = 1;
+  restored_equations.assign(equations.size(), NULL);
+  restored_derivatives.assign(equations.size(), vector<pair<vector<int>, expr_t> >());
+  if (use_equation_derivatives_cache)
+    {
+      equation_keys.resize(equations.size());
+      equation_derivation_vars.resize(equations.size());
+      int nb_restored = 0;
+      for (int eq = 0; eq < (int) equations.size(); eq++)
+        {
+          const vector<int> &nnd = equations[eq]->getNonNullDerivatives();
+          equation_derivation_vars[eq].clear();
+          for (vector<int>::const_iterator it = nnd.begin(); it != nnd.end(); it++)
+            if (vars.find(*it) != vars.end())
+              equation_derivation_vars[eq].push_back(*it);
+
+          equation_keys[eq] = computeEquationKey(eq);
+          if (equation_keys[eq].empty())
+            continue;
+          map<string, cached_equation_derivatives_t>::const_iterator it = equation_derivatives_cache.find(equation_keys[eq]);
+          if (it != equation_derivatives_cache.end() && restoreEquationDerivatives(eq, it->second))
+            {
+              restored_equations[eq] = &it->second;
+              nb_restored++;
+            }
+        }
+      if (!equation_derivatives_cache.empty())
+        cout << "   derivatives of " << nb_restored << " equation(s) out of " << equations.size()
+             << " restored from the cache" << endl;
+    }
+
   for (set<int>::const_iterator it = vars.begin();
        it != vars.end(); it++)
     {
       for (int eq = 0; eq < (int) equations.size(); eq++)
         {
+          if (restored_equations[eq] != NULL)
+            continue;
           expr_t d1 = equations[eq]->getDerivative(*it);
           if (d1 == Zero)
             continue;
@@ -1052,40 +1245,53 @@ ModelTree::computeJacobian(const set<int> &vars)
 void
 ModelTree::computeHessian(const set<int> &vars)
 {
+  derivation_order = 2;
   for (first_derivatives_t::const_iterator it = first_derivatives.begin();
        it != first_derivatives.end(); it++)
     {
       int eq = it->first.first;
+      if (restored_equations[eq] != NULL && restored_equations[eq]->order >= 2)
+        continue;
       int var1 = it->first.second;
       expr_t d1 = it->second;
 
+      /* Only loop over the derivation IDs for which the derivative is
+         potentially non-null: this gives the same derivatives, created in the
+         same order, as looping over all of vars */
+      const vector<int> &nnd = d1->getNonNullDerivatives();
+
       // Store only second derivatives with var2 <= var1
-      for (set<int>::const_iterator it2 = vars.begin();
-           it2 != vars.end(); it2++)
+      for (vector<int>::const_iterator it2 = nnd.begin();
+           it2 != nnd.end() && *it2 <= var1; it2++)
         {
           int var2 = *it2;
-          if (var2 > var1)
+          if (vars.find(var2) == vars.end())
             continue;
 
           expr_t d2 = d1->getDerivative(var2);
           if (d2 == Zero)
             continue;
-          second_derivatives[make_pair(eq, make_pair(var1, var2))] = d2;
+          second_derivatives.insert(make_pair(eq, make_pair(var1, var2)), d2);
           if (var2 == var1)
             ++NNZDerivatives[1];
           else
             NNZDerivatives[1] += 2;
         }
     }
+
+  insertRestoredDerivatives(2);
 }
 
 void
 ModelTree::computeThirdDerivatives(const set<int> &vars)
 {
+  derivation_order = 3;
   for (second_derivatives_t::const_iterator it = second_derivatives.begin();
        it != second_derivatives.end(); it++)
     {
       int eq = it->first.first;
+      if (restored_equations[eq] != NULL && restored_equations[eq]->order >= 3)
+        continue;
 
       int var1 = it->first.second.first;
       int var2 = it->first.second.second;
@@ -1093,18 +1299,21 @@ ModelTree::computeThirdDerivatives(const set<int> &vars)
 
       expr_t d2 = it->second;
 
+      // See computeHessian()
+      const vector<int> &nnd = d2->getNonNullDerivatives();
+
       // Store only third derivatives such that var3 <= var2 <= var1
-      for (set<int>::const_iterator it2 = vars.begin();
-           it2 != vars.end(); it2++)
+      for (vector<int>::const_iterator it2 = nnd.begin();
+           it2 != nnd.end() && *it2 <= var2; it2++)
         {
           int var3 = *it2;
-          if (var3 > var2)
+          if (vars.find(var3) == vars.end())
             continue;
 
           expr_t d3 = d2->getDerivative(var3);
           if (d3 == Zero)
             continue;
-          third_derivatives[make_pair(eq, make_pair(var1, make_pair(var2, var3)))] = d3;
+          third_derivatives.insert(make_pair(eq, make_pair(var1, make_pair(var2, var3))), d3);
           if (var3 == var2 && var2 == var1)
             ++NNZDerivatives[2];
           else if (var3 == var2 || var2 == var1)
@@ -1113,6 +1322,593 @@ ModelTree::computeThirdDerivatives(const set<int> &vars)
             NNZDerivatives[2] += 6;
         }
     }
+
+  insertRestoredDerivatives(3);
+}
+
+void
+ModelTree::insertRestoredDerivatives(int order)
+{
+  for (int eq = 0; eq < (int) restored_derivatives.size(); eq++)
+    for (vector<pair<vector<int>, expr_t> >::const_iterator it = restored_derivatives[eq].begin();
+         it != restored_derivatives[eq].end(); it++)
+      {
+        const vector<int> &ids = it->first;
+        if ((int) ids.size() != order)
+          continue;
+        // See computeHessian() and computeThirdDerivatives() for the counting of the non-null elements
+        if (order == 2)
+          {
+            second_derivatives.insert(make_pair(eq, make_pair(ids[0], ids[1])), it->second);
+            if (ids[0] == ids[1])
+              ++NNZDerivatives[1];
+            else
+              NNZDerivatives[1] += 2;
+          }
+        else
+          {
+            third_derivatives.insert(make_pair(eq, make_pair(ids[0], make_pair(ids[1], ids[2]))), it->second);
+            if (ids[0] == ids[1] && ids[1] == ids[2])
+              ++NNZDerivatives[2];
+            else if (ids[0] == ids[1] || ids[1] == ids[2])
+              NNZDerivatives[2] += 3;
+            else
+              NNZDerivatives[2] += 6;
+          }
+      }
+}
+
+int
+ModelTree::serializeExpression(expr_t e, bool expand_local_variables, map<expr_t, int> &positions, vector<string> &nodes) const
+{
+  map<expr_t, int>::const_iterator it = positions.find(e);
+  if (it != positions.end())
+    return it->second;
+
+  ostringstream node;
+  if (NumConstNode *nc = dynamic_cast<NumConstNode *>(e))
+    node << "n " << num_constants.get(nc->get_id());
+  else if (VariableNode *v = dynamic_cast<VariableNode *>(e))
+    {
+      if (expand_local_variables && v->get_type() == eModelLocalVariable)
+        {
+          int pos = serializeExpression(local_variables_table.find(v->get_symb_id())->second,
+                                        true, positions, nodes);
+          positions[e] = pos;
+          return pos;
+        }
+      node << "v " << v->get_type() << " " << symbol_table.getName(v->get_symb_id()) << " " << v->get_lag();
+    }
+  else if (UnaryOpNode *u = dynamic_cast<UnaryOpNode *>(e))
+    {
+      UnaryOpcode op_code = u->get_op_code();
+      if (op_code == oExpectation || op_code == oSteadyStateParamDeriv || op_code == oSteadyStateParam2ndDeriv)
+        return -1;
+      int arg = serializeExpression(u->get_arg(), expand_local_variables, positions, nodes);
+      if (arg < 0)
+        return -1;
+      node << "u " << op_code << " " << arg;
+    }
+  else if (BinaryOpNode *b = dynamic_cast<BinaryOpNode *>(e))
+    {
+      int arg1 = serializeExpression(b->get_arg1(), expand_local_variables, positions, nodes);
+      int arg2 = serializeExpression(b->get_arg2(), expand_local_variables, positions, nodes);
+      if (arg1 < 0 || arg2 < 0)
+        return -1;
+      node << "b " << b->get_op_code() << " " << arg1 << " " << arg2 << " " << b->get_power_deriv_order();
+    }
+  else if (TrinaryOpNode *t = dynamic_cast<TrinaryOpNode *>(e))
+    {
+      int arg1 = serializeExpression(t->arg1, expand_local_variables, positions, nodes);
+      int arg2 = serializeExpression(t->arg2, expand_local_variables, positions, nodes);
+      int arg3 = serializeExpression(t->arg3, expand_local_variables, positions, nodes);
+      if (arg1 < 0 || arg2 < 0 || arg3 < 0)
+        return -1;
+      node << "t " << t->op_code << " " << arg1 << " " << arg2 << " " << arg3;
+    }
+  else
+    return -1;
+
+  nodes.push_back(node.str());
+  positions[e] = nodes.size() - 1;
+  return nodes.size() - 1;
+}
+
+string
+ModelTree::computeEquationKey(int eq) const
+{
+  map<expr_t, int> positions;
+  vector<string> nodes;
+  if (serializeExpression(equations[eq], true, positions, nodes) < 0)
+    return "";
+
+  ostringstream key;
+  for (vector<string>::const_iterator it = nodes.begin(); it != nodes.end(); it++)
+    {
+      if (it != nodes.begin())
+        key << "|";
+      key << *it;
+    }
+  return key.str();
+}
+
+string
+ModelTree::serializeDerivID(int deriv_id) const
+{
+  int symb_id = getSymbIDByDerivID(deriv_id);
+  ostringstream output;
+  output << symbol_table.getType(symb_id) << " " << symbol_table.getName(symb_id) << " " << getLagByDerivID(deriv_id);
+  return output.str();
+}
+
+int
+ModelTree::readDerivID(istream &input) const
+{
+  int type, lag;
+  string name;
+  input >> type >> name >> lag;
+  if (input.fail() || !symbol_table.exists(name) || symbol_table.getType(name) != type)
+    return -1;
+  try
+    {
+      return getDerivID(symbol_table.getID(name), lag);
+    }
+  catch (UnknownDerivIDException &e)
+    {
+      return -1;
+    }
+}
+
+bool
+ModelTree::restoreEquationDerivatives(int eq, const cached_equation_derivatives_t &cached)
+{
+  // The derivatives must have been computed w.r. to the same variables
+  istringstream vars_input(cached.vars);
+  int nb_vars;
+  vars_input >> nb_vars;
+  if (vars_input.fail() || nb_vars != (int) equation_derivation_vars[eq].size())
+    return false;
+  set<int> vars;
+  for (int i = 0; i < nb_vars; i++)
+    vars.insert(readDerivID(vars_input));
+  if (vars != set<int>(equation_derivation_vars[eq].begin(), equation_derivation_vars[eq].end()))
+    return false;
+
+  // Rebuild the nodes of the derivatives, which are shared with the rest of the tree
+  vector<expr_t> nodes;
+  for (vector<string>::const_iterator it = cached.nodes.begin(); it != cached.nodes.end(); it++)
+    {
+      istringstream node_input(*it);
+      char node_type;
+      int op_code, arg1, arg2, arg3, power_deriv_order, symb_type, lag;
+      string value;
+      int nb_nodes = nodes.size();
+      node_input >> node_type;
+      switch (node_type)
+        {
+        case 'n':
+          node_input >> value;
+          if (node_input.fail())
+            return false;
+          nodes.push_back(AddNonNegativeConstant(value));
+          break;
+        case 'v':
+          node_input >> symb_type >> value >> lag;
+          if (node_input.fail() || !symbol_table.exists(value) || symbol_table.getType(value) != symb_type)
+            return false;
+          nodes.push_back(AddVariable(symbol_table.getID(value), lag));
+          break;
+        case 'u':
+          node_input >> op_code >> arg1;
+          if (node_input.fail() || arg1 < 0 || arg1 >= nb_nodes)
+            return false;
+          nodes.push_back(AddUnaryOp((UnaryOpcode) op_code, nodes[arg1]));
+          break;
+        case 'b':
+          node_input >> op_code >> arg1 >> arg2 >> power_deriv_order;
+          if (node_input.fail() || arg1 < 0 || arg1 >= nb_nodes || arg2 < 0 || arg2 >= nb_nodes)
+            return false;
+          nodes.push_back(AddBinaryOp(nodes[arg1], (BinaryOpcode) op_code, nodes[arg2], power_deriv_order));
+          break;
+        case 't':
+          node_input >> op_code >> arg1 >> arg2 >> arg3;
+          if (node_input.fail() || arg1 < 0 || arg1 >= nb_nodes || arg2 < 0 || arg2 >= nb_nodes
+              || arg3 < 0 || arg3 >= nb_nodes)
+            return false;
+          nodes.push_back(AddTrinaryOp(nodes[arg1], (TrinaryOpcode) op_code, nodes[arg2], nodes[arg3]));
+          break;
+        default:
+          return false;
+        }
+    }
+
+  vector<pair<vector<int>, expr_t> > derivatives;
+  for (vector<string>::const_iterator it = cached.derivatives.begin(); it != cached.derivatives.end(); it++)
+    {
+      istringstream deriv_input(*it);
+      int node, order;
+      deriv_input >> node >> order;
+      if (deriv_input.fail() || node < 0 || node >= (int) nodes.size() || order < 1 || order > cached.order)
+        return false;
+      vector<int> ids;
+      for (int i = 0; i < order; i++)
+        {
+          int deriv_id = readDerivID(deriv_input);
+          if (vars.find(deriv_id) == vars.end())
+            return false;
+          ids.push_back(deriv_id);
+        }
+      // The derivation IDs may be ordered differently than in the previous run
+      sort(ids.rbegin(), ids.rend());
+      derivatives.push_back(make_pair(ids, nodes[node]));
+    }
+
+  for (vector<pair<vector<int>, expr_t> >::const_iterator it = derivatives.begin(); it != derivatives.end(); it++)
+    if (it->first.size() == 1)
+      {
+        first_derivatives[make_pair(eq, it->first[0])] = it->second;
+        ++NNZDerivatives[0];
+      }
+    else
+      restored_derivatives[eq].push_back(*it);
+  return true;
+}
+
+void
+ModelTree::readEquationDerivativesCache(const string &filename)
+{
+  use_equation_derivatives_cache = true;
+
+  ifstream cache_file(filename.c_str(), ios::in | ios::binary);
+  if (!cache_file.is_open())
+    return;
+  string line;
+  if (!getline(cache_file, line) || line != equation_derivatives_cache_header)
+    return;
+
+  while (getline(cache_file, line))
+    {
+      istringstream header(line);
+      string tag, key;
+      int order, nb_nodes, nb_derivatives;
+      header >> tag >> order >> nb_nodes >> nb_derivatives;
+      if (header.fail() || tag != "equation" || nb_nodes < 0 || nb_derivatives < 0
+          || !getline(cache_file, key))
+        break;
+
+      cached_equation_derivatives_t &cached = equation_derivatives_cache[key];
+      cached.order = order;
+      getline(cache_file, cached.vars);
+      cached.nodes.resize(nb_nodes);
+      for (int i = 0; i < nb_nodes; i++)
+        getline(cache_file, cached.nodes[i]);
+      cached.derivatives.resize(nb_derivatives);
+      for (int i = 0; i < nb_derivatives; i++)
+        getline(cache_file, cached.derivatives[i]);
+      if (cache_file.fail())
+        {
+          // Truncated file
+          equation_derivatives_cache.erase(key);
+          break;
+        }
+    }
+}
+
+void
+ModelTree::writeEquationDerivativesCache(const string &filename) const
+{
+  // Group the derivatives by equation
+  vector<vector<pair<vector<int>, expr_t> > > derivatives(equations.size());
+  for (first_derivatives_t::const_iterator it = first_derivatives.begin();
+       it != first_derivatives.end(); it++)
+    derivatives[it->first.first].push_back(make_pair(vector<int>(1, it->first.second), it->second));
+  for (second_derivatives_t::const_iterator it = second_derivatives.begin();
+       it != second_derivatives.end(); it++)
+    {
+      vector<int> ids(2);
+      ids[0] = it->first.second.first;
+      ids[1] = it->first.second.second;
+      derivatives[it->first.first].push_back(make_pair(ids, it->second));
+    }
+  for (third_derivatives_t::const_iterator it = third_derivatives.begin();
+       it != third_derivatives.end(); it++)
+    {
+      vector<int> ids(3);
+      ids[0] = it->first.second.first;
+      ids[1] = it->first.second.second.first;
+      ids[2] = it->first.second.second.second;
+      derivatives[it->first.first].push_back(make_pair(ids, it->second));
+    }
+
+  ofstream cache_file(filename.c_str(), ios::out | ios::binary);
+  if (!cache_file.is_open())
+    {
+      cerr << "ERROR: Can't open file " << filename << " for writing" << endl;
+      exit(EXIT_FAILURE);
+    }
+  cache_file << equation_derivatives_cache_header << endl;
+
+  set<string> written_keys;
+  for (int eq = 0; eq < (int) equations.size(); eq++)
+    {
+      if (equation_keys[eq].empty() || !written_keys.insert(equation_keys[eq]).second)
+        continue;
+
+      cached_equation_derivatives_t cached;
+      if (restored_equations[eq] != NULL && restored_equations[eq]->order > derivation_order)
+        // Keep the higher order derivatives restored from the cache
+        cached = *restored_equations[eq];
+      else
+        {
+          cached.order = derivation_order;
+          ostringstream vars;
+          vars << equation_derivation_vars[eq].size();
+          for (vector<int>::const_iterator it = equation_derivation_vars[eq].begin();
+               it != equation_derivation_vars[eq].end(); it++)
+            vars << " " << serializeDerivID(*it);
+          cached.vars = vars.str();
+
+          map<expr_t, int> positions;
+          bool cacheable = true;
+          for (vector<pair<vector<int>, expr_t> >::const_iterator it = derivatives[eq].begin();
+               it != derivatives[eq].end() && cacheable; it++)
+            {
+              int node = serializeExpression(it->second, false, positions, cached.nodes);
+              cacheable = node >= 0;
+              ostringstream derivative;
+              derivative << node << " " << it->first.size();
+              for (vector<int>::const_iterator it2 = it->first.begin(); it2 != it->first.end(); it2++)
+                derivative << " " << serializeDerivID(*it2);
+              cached.derivatives.push_back(derivative.str());
+            }
+          if (!cacheable)
+            continue;
+        }
+
+      cache_file << "equation " << cached.order << " " << cached.nodes.size() << " " << cached.derivatives.size() << endl
+                 << equation_keys[eq] << endl
+                 << cached.vars << endl;
+      for (vector<string>::const_iterator it = cached.nodes.begin(); it != cached.nodes.end(); it++)
+        cache_file << *it << endl;
+      for (vector<string>::const_iterator it = cached.derivatives.begin(); it != cached.derivatives.end(); it++)
+        cache_file << *it << endl;
+    }
+  cache_file.close();
+}
+
+int
+ModelTree::appendModelIRNode(expr_t e, map<expr_t, int> &positions, vector<ModelIRNode> &nodes) const
+{
+  map<expr_t, int>::const_iterator it = positions.find(e);
+  if (it != positions.end())
+    return it->second;
+
+  ModelIRNode node;
+  memset(&node, 0, sizeof(node));
+  node.arg[0] = node.arg[1] = node.arg[2] = -1;
+  if (NumConstNode *nc = dynamic_cast<NumConstNode *>(e))
+    {
+      node.kind = irConstant;
+      node.constant = num_constants.getDouble(nc->get_id());
+    }
+  else if (VariableNode *v = dynamic_cast<VariableNode *>(e))
+    {
+      if (v->get_type() == eModelLocalVariable)
+        {
+          int pos = appendModelIRNode(local_variables_table.find(v->get_symb_id())->second, positions, nodes);
+          positions[e] = pos;
+          return pos;
+        }
+      node.kind = irVariable;
+      node.arg[0] = v->get_symb_id();
+      node.arg[1] = v->get_lag();
+    }
+  else if (UnaryOpNode *u = dynamic_cast<UnaryOpNode *>(e))
+    {
+      node.kind = irUnaryOp;
+      node.op_code = u->get_op_code();
+      node.arg[0] = appendModelIRNode(u->get_arg(), positions, nodes);
+      if (node.arg[0] < 0)
+        return -1;
+    }
+  else if (BinaryOpNode *b = dynamic_cast<BinaryOpNode *>(e))
+    {
+      node.kind = irBinaryOp;
+      node.op_code = b->get_op_code();
+      node.arg[0] = appendModelIRNode(b->get_arg1(), positions, nodes);
+      node.arg[1] = appendModelIRNode(b->get_arg2(), positions, nodes);
+      node.power_deriv_order = b->get_power_deriv_order();
+      if (node.arg[0] < 0 || node.arg[1] < 0)
+        return -1;
+    }
+  else if (TrinaryOpNode *t = dynamic_cast<TrinaryOpNode *>(e))
+    {
+      node.kind = irTrinaryOp;
+      node.op_code = t->op_code;
+      node.arg[0] = appendModelIRNode(t->arg1, positions, nodes);
+      node.arg[1] = appendModelIRNode(t->arg2, positions, nodes);
+      node.arg[2] = appendModelIRNode(t->arg3, positions, nodes);
+      if (node.arg[0] < 0 || node.arg[1] < 0 || node.arg[2] < 0)
+        return -1;
+    }
+  else
+    return -1;
+
+  nodes.push_back(node);
+  positions[e] = nodes.size() - 1;
+  return nodes.size() - 1;
+}
+
+void
+ModelTree::writeModelIR(const string &filename) const
+{
+  map<expr_t, int> positions;
+  vector<ModelIRNode> nodes;
+  bool ok = true;
+
+  // Symbol table
+  string strings;
+  vector<ModelIRSymbol> symbols(symbol_table.maxID() + 1);
+  for (int i = 0; i < (int) symbols.size(); i++)
+    {
+      memset(&symbols[i], 0, sizeof(ModelIRSymbol));
+      symbols[i].name = strings.size();
+      symbols[i].type = symbol_table.getType(i);
+      symbols[i].type_specific_id = symbol_table.getTypeSpecificID(i);
+      strings += symbol_table.getName(i);
+      strings += '\0';
+    }
+
+  vector<ModelIRLocalVariable> local_variables;
+  for (map<int, expr_t>::const_iterator it = local_variables_table.begin();
+       it != local_variables_table.end() && ok; it++)
+    {
+      ModelIRLocalVariable lv;
+      lv.symbol = it->first;
+      lv.node = appendModelIRNode(it->second, positions, nodes);
+      ok = lv.node >= 0;
+      local_variables.push_back(lv);
+    }
+
+  vector<ModelIREquation> eqs;
+  for (int eq = 0; eq < (int) equations.size() && ok; eq++)
+    {
+      ModelIREquation e;
+      e.lhs = appendModelIRNode(equations[eq]->get_arg1(), positions, nodes);
+      e.rhs = appendModelIRNode(equations[eq]->get_arg2(), positions, nodes);
+      ok = e.lhs >= 0 && e.rhs >= 0;
+      eqs.push_back(e);
+    }
+
+  /* Derivation variables, indexed by column (parameters and trends have no
+     column). The derivation IDs are contiguous, so they are enumerated until
+     an unknown one is found. */
+  vector<ModelIRDerivationVariable> derivation_vars;
+  map<int, int> columns;
+  try
+    {
+      for (int deriv_id = 0;; deriv_id++)
+        {
+          SymbolType type = getTypeByDerivID(deriv_id);
+          if (type != eEndogenous && type != eExogenous && type != eExogenousDet)
+            continue;
+          int col = isDynamic() ? getDynJacobianCol(deriv_id) : deriv_id;
+          columns[deriv_id] = col;
+          if (col >= (int) derivation_vars.size())
+            derivation_vars.resize(col + 1);
+          derivation_vars[col].symbol = getSymbIDByDerivID(deriv_id);
+          derivation_vars[col].lag = getLagByDerivID(deriv_id);
+        }
+    }
+  catch (UnknownDerivIDException &e)
+    {
+    }
+
+  vector<ModelIRDerivative<1> > g1;
+  for (first_derivatives_t::const_iterator it = first_derivatives.begin();
+       it != first_derivatives.end() && ok; it++)
+    {
+      ModelIRDerivative<1> d;
+      d.equation = it->first.first;
+      d.var[0] = columns[it->first.second];
+      d.node = appendModelIRNode(it->second, positions, nodes);
+      ok = d.node >= 0;
+      g1.push_back(d);
+    }
+  vector<ModelIRDerivative<2> > g2;
+  for (second_derivatives_t::const_iterator it = second_derivatives.begin();
+       it != second_derivatives.end() && ok; it++)
+    {
+      ModelIRDerivative<2> d;
+      d.equation = it->first.first;
+      d.var[0] = columns[it->first.second.first];
+      d.var[1] = columns[it->first.second.second];
+      d.node = appendModelIRNode(it->second, positions, nodes);
+      ok = d.node >= 0;
+      g2.push_back(d);
+    }
+  vector<ModelIRDerivative<3> > g3;
+  for (third_derivatives_t::const_iterator it = third_derivatives.begin();
+       it != third_derivatives.end() && ok; it++)
+    {
+      ModelIRDerivative<3> d;
+      d.equation = it->first.first;
+      d.var[0] = columns[it->first.second.first];
+      d.var[1] = columns[it->first.second.second.first];
+      d.var[2] = columns[it->first.second.second.second];
+      d.node = appendModelIRNode(it->second, positions, nodes);
+      ok = d.node >= 0;
+      g3.push_back(d);
+    }
+
+  if (!ok)
+    {
+      cerr << "WARNING: " << filename << " not written, since the model calls external functions" << endl;
+      return;
+    }
+
+  ModelIRHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "DYNIR", 6);
+  header.version = MODEL_IR_VERSION;
+  header.byte_order = MODEL_IR_BYTE_ORDER;
+  header.dynamic = isDynamic();
+  header.order = derivation_order;
+
+  const char *section_data[irSectionNumber] = {
+    strings.data(),
+    reinterpret_cast<const char *>(symbols.empty() ? NULL : &symbols[0]),
+    reinterpret_cast<const char *>(nodes.empty() ? NULL : &nodes[0]),
+    reinterpret_cast<const char *>(eqs.empty() ? NULL : &eqs[0]),
+    reinterpret_cast<const char *>(local_variables.empty() ? NULL : &local_variables[0]),
+    reinterpret_cast<const char *>(derivation_vars.empty() ? NULL : &derivation_vars[0]),
+    reinterpret_cast<const char *>(g1.empty() ? NULL : &g1[0]),
+    reinterpret_cast<const char *>(g2.empty() ? NULL : &g2[0]),
+    reinterpret_cast<const char *>(g3.empty() ? NULL : &g3[0])
+  };
+  const uint64_t section_count[irSectionNumber] = {
+    strings.size(), symbols.size(), nodes.size(), eqs.size(), local_variables.size(),
+    derivation_vars.size(), g1.size(), g2.size(), g3.size()
+  };
+  const uint64_t record_size[irSectionNumber] = {
+    1, sizeof(ModelIRSymbol), sizeof(ModelIRNode), sizeof(ModelIREquation), sizeof(ModelIRLocalVariable),
+    sizeof(ModelIRDerivationVariable), sizeof(ModelIRDerivative<1>), sizeof(ModelIRDerivative<2>),
+    sizeof(ModelIRDerivative<3>)
+  };
+  uint64_t offset = sizeof(header) + modelIRPadding(sizeof(header));
+  for (int s = 0; s < irSectionNumber; s++)
+    {
+      header.sections[s].offset = offset;
+      header.sections[s].count = section_count[s];
+      offset += section_count[s] * record_size[s];
+      offset += modelIRPadding(offset);
+    }
+
+  ofstream ir_file(filename.c_str(), ios::out | ios::binary);
+  if (!ir_file.is_open())
+    {
+      cerr << "ERROR: Can't open file " << filename << " for writing" << endl;
+      exit(EXIT_FAILURE);
+    }
+  const char zeros[8] = { 0 };
+  ir_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  ir_file.write(zeros, modelIRPadding(sizeof(header)));
+  for (int s = 0; s < irSectionNumber; s++)
+    {
+      uint64_t size = section_count[s] * record_size[s];
+      if (size > 0)
+        ir_file.write(section_data[s], size);
+      ir_file.write(zeros, modelIRPadding(header.sections[s].offset + size));
+    }
+  ir_file.close();
+}
+
+void
+ModelTree::printDerivationTiming(clock_t start) const
+{
+  ostringstream ost;
+  ost << fixed << setprecision(2) << (double) (clock() - start) / CLOCKS_PER_SEC;
+  cout << "   done in " << ost.str() << "s (" << node_number() << " nodes in the tree)" << endl;
 }
 
 void
@@ -1486,8 +2282,270 @@ ModelTree::writeJsonModelLocalVariables(ostream &output, deriv_node_temp_terms_t
   output << "]";
 }
 
+bool
+ModelTree::writeEquationStructure(expr_t expr, const temporary_terms_t &tt, ostream &structure,
+                                  map<expr_t, int> &operand_slots, vector<expr_t> &operands)
+{
+  if (tt.find(expr) != tt.end())
+    {
+      structure << "T" << expr->idx;
+      return true;
+    }
+
+  NumConstNode *num_const = dynamic_cast<NumConstNode *>(expr);
+  if (num_const != NULL)
+    {
+      structure << "C" << num_const->get_id();
+      return true;
+    }
+
+  VariableNode *variable = dynamic_cast<VariableNode *>(expr);
+  if (variable != NULL)
+    {
+      SymbolType type = variable->get_type();
+      if (type == eEndogenous || type == eExogenous || type == eExogenousDet || type == eParameter)
+        {
+          map<expr_t, int>::const_iterator it = operand_slots.find(expr);
+          int slot;
+          if (it == operand_slots.end())
+            {
+              slot = operands.size();
+              operand_slots[expr] = slot;
+              operands.push_back(expr);
+            }
+          else
+            slot = it->second;
+          structure << "V" << type << "," << variable->get_lag() << "," << slot;
+        }
+      else
+        structure << "S" << variable->get_symb_id() << "," << variable->get_lag();
+      return true;
+    }
+
+  UnaryOpNode *unary = dynamic_cast<UnaryOpNode *>(expr);
+  if (unary != NULL)
+    {
+      // These operators write their argument in another context, or depend on hidden symbols
+      switch (unary->get_op_code())
+        {
+        case oSteadyState:
+        case oSteadyStateParamDeriv:
+        case oSteadyStateParam2ndDeriv:
+        case oExpectation:
+          return false;
+        default:
+          break;
+        }
+      structure << "U" << unary->get_op_code() << "(";
+      if (!writeEquationStructure(unary->get_arg(), tt, structure, operand_slots, operands))
+        return false;
+      structure << ")";
+      return true;
+    }
+
+  BinaryOpNode *binary = dynamic_cast<BinaryOpNode *>(expr);
+  if (binary != NULL)
+    {
+      structure << "B" << binary->get_op_code() << "," << binary->get_power_deriv_order() << "(";
+      if (!writeEquationStructure(binary->get_arg1(), tt, structure, operand_slots, operands))
+        return false;
+      structure << ",";
+      if (!writeEquationStructure(binary->get_arg2(), tt, structure, operand_slots, operands))
+        return false;
+      structure << ")";
+      return true;
+    }
+
+  TrinaryOpNode *trinary = dynamic_cast<TrinaryOpNode *>(expr);
+  if (trinary != NULL)
+    {
+      structure << "R" << trinary->op_code << "(";
+      if (!writeEquationStructure(trinary->arg1, tt, structure, operand_slots, operands))
+        return false;
+      structure << ",";
+      if (!writeEquationStructure(trinary->arg2, tt, structure, operand_slots, operands))
+        return false;
+      structure << ",";
+      if (!writeEquationStructure(trinary->arg3, tt, structure, operand_slots, operands))
+        return false;
+      structure << ")";
+      return true;
+    }
+
+  // External functions
+  return false;
+}
+
 void
-ModelTree::writeModelEquations(ostream &output, ExprNodeOutputType output_type) const
+ModelTree::computeEquationFamilies(const temporary_terms_t &tt, vector<equation_family_t> &families) const
+{
+  families.clear();
+  map<string, int> family_of_structure;
+  vector<equation_family_t> all_families;
+  for (int eq = 0; eq < (int) equations.size(); eq++)
+    {
+      ostringstream structure;
+      map<expr_t, int> operand_slots;
+      vector<expr_t> operands;
+      if (!writeEquationStructure(equations[eq], tt, structure, operand_slots, operands))
+        continue;
+      map<string, int>::const_iterator it = family_of_structure.find(structure.str());
+      int family;
+      if (it == family_of_structure.end())
+        {
+          family = all_families.size();
+          family_of_structure[structure.str()] = family;
+          all_families.push_back(equation_family_t());
+        }
+      else
+        family = it->second;
+      all_families[family].equations.push_back(eq);
+      all_families[family].operands.push_back(operands);
+    }
+
+  for (vector<equation_family_t>::const_iterator it = all_families.begin();
+       it != all_families.end(); it++)
+    if (it->equations.size() >= min_equation_family_size)
+      families.push_back(*it);
+}
+
+//! Replaces the occurrences of the given strings which are not preceded by a character of an identifier
+static string
+replaceOperands(const string &code, const vector<string> &from, const vector<string> &to)
+{
+  string result;
+  size_t i = 0;
+  while (i < code.size())
+    {
+      size_t k = from.size();
+      if (i == 0 || !(isalnum(code[i-1]) || code[i-1] == '_'))
+        for (k = 0; k < from.size(); k++)
+          if (code.compare(i, from[k].size(), from[k]) == 0)
+            break;
+      if (k < from.size())
+        {
+          result += to[k];
+          i += from[k].size();
+        }
+      else
+        result += code[i++];
+    }
+  return result;
+}
+
+bool
+ModelTree::writeEquationFamily(ostream &output, ExprNodeOutputType output_type, const temporary_terms_t &tt,
+                               const equation_family_t &family, int family_number) const
+{
+  if (!IS_C(output_type))
+    return false;
+
+  deriv_node_temp_terms_t tef_terms;
+  size_t nrows = family.equations.size(), nops = family.operands[0].size();
+  ostringstream table_name;
+  table_name << "equation_family_" << family_number;
+
+  /* The output of each operand must be the same for all the equations, up to an
+     integer, which is stored in the table of the operands */
+  vector<vector<string> > texts(nrows, vector<string>(nops));
+  vector<vector<int> > table(nrows, vector<int>(nops));
+  vector<string> loop_operands(nops);
+  for (size_t k = 0; k < nops; k++)
+    {
+      size_t min_length = string::npos;
+      for (size_t r = 0; r < nrows; r++)
+        {
+          ostringstream text;
+          family.operands[r][k]->writeOutput(text, output_type, tt, tef_terms);
+          texts[r][k] = text.str();
+          min_length = min(min_length, texts[r][k].size());
+        }
+      const string &first = texts[0][k];
+      // Longest common prefix and suffix, which must not cut the integer
+      size_t prefix = 0, suffix = 0, r;
+      while (prefix < min_length)
+        {
+          for (r = 1; r < nrows && texts[r][k][prefix] == first[prefix]; r++)
+            ;
+          if (r < nrows)
+            break;
+          prefix++;
+        }
+      while (suffix < min_length - prefix)
+        {
+          for (r = 1; r < nrows && texts[r][k][texts[r][k].size()-1-suffix] == first[first.size()-1-suffix]; r++)
+            ;
+          if (r < nrows)
+            break;
+          suffix++;
+        }
+      while (prefix > 0 && isdigit(first[prefix-1]))
+        prefix--;
+      while (suffix > 0 && isdigit(first[first.size()-suffix]))
+        suffix--;
+      for (r = 0; r < nrows; r++)
+        {
+          string index = texts[r][k].substr(prefix, texts[r][k].size()-prefix-suffix);
+          if (index.empty() || index.size() > 9 || index.find_first_not_of("0123456789") != string::npos)
+            return false;
+          table[r][k] = atoi(index.c_str());
+        }
+      ostringstream loop_operand;
+      loop_operand << first.substr(0, prefix) << table_name.str() << "[i][" << k+1 << "]"
+                   << first.substr(first.size()-suffix);
+      loop_operands[k] = loop_operand.str();
+    }
+
+  /* The body of the loop is the code of the first equation, whose operands are replaced
+     by their entries in the table. The code of each equation must be given back by
+     replacing them by its own operands */
+  string body;
+  for (size_t r = 0; r < nrows; r++)
+    {
+      ostringstream code;
+      BinaryOpNode *eq_node = equations[family.equations[r]];
+      code << "lhs =";
+      eq_node->get_arg1()->writeOutput(code, output_type, tt, tef_terms);
+      code << ";" << endl
+           << "rhs =";
+      eq_node->get_arg2()->writeOutput(code, output_type, tt, tef_terms);
+      code << ";" << endl;
+      if (r == 0)
+        body = replaceOperands(code.str(), texts[0], loop_operands);
+      if (replaceOperands(body, loop_operands, texts[r]) != code.str())
+        return false;
+    }
+
+  output << "{" << endl
+         << "  /* Equations";
+  for (size_t r = 0; r < nrows; r++)
+    output << " " << family.equations[r] + 1;
+  output << " */" << endl
+         << "  static const int " << table_name.str() << "[" << nrows << "][" << nops+1 << "] = {" << endl;
+  for (size_t r = 0; r < nrows; r++)
+    {
+      output << "    {" << family.equations[r];
+      for (size_t k = 0; k < nops; k++)
+        output << ", " << table[r][k];
+      output << "}" << (r < nrows-1 ? "," : "") << endl;
+    }
+  output << "  };" << endl
+         << "  int i;" << endl
+         << "  for (i = 0; i < " << nrows << "; i++)" << endl
+         << "    {" << endl;
+  istringstream body_lines(body);
+  string line;
+  while (getline(body_lines, line))
+    output << "      " << line << endl;
+  output << "      residual[" << table_name.str() << "[i][0]]= lhs-rhs;" << endl
+         << "    }" << endl
+         << "}" << endl;
+  return true;
+}
+
+void
+ModelTree::writeModelEquations(ostream &output, ExprNodeOutputType output_type,
+                               const vector<equation_family_t> &families) const
 {
   temporary_terms_t temp_terms;
   if (IS_JULIA(output_type))
@@ -1495,8 +2553,31 @@ ModelTree::writeModelEquations(ostream &output, ExprNodeOutputType output_type)
   else
     temp_terms = temporary_terms;
 
+  // Families written as loops, indexed by their first equation
+  map<int, string> family_loops;
+  vector<bool> in_family_loop(equations.size(), false);
+  for (size_t f = 0; f < families.size(); f++)
+    {
+      ostringstream loop;
+      if (writeEquationFamily(loop, output_type, temp_terms, families[f], f))
+        {
+          family_loops[families[f].equations[0]] = loop.str();
+          for (vector<int>::const_iterator it = families[f].equations.begin();
+               it != families[f].equations.end(); it++)
+            in_family_loop[*it] = true;
+        }
+    }
+
   for (int eq = 0; eq < (int) equations.size(); eq++)
     {
+      if (in_family_loop[eq])
+        {
+          map<int, string>::const_iterator it = family_loops.find(eq);
+          if (it != family_loops.end())
+            output << it->second;
+          continue;
+        }
+
       BinaryOpNode *eq_node = equations[eq];
       expr_t lhs = eq_node->get_arg1();
       expr_t rhs = eq_node->get_arg2();
@@ -1673,37 +2754,10 @@ ModelTree::writeLatexModelFile(const string &basename, ExprNodeOutputType output
       content_output << endl << "\\end{dmath*}" << endl;
     }
 
+  vector<string> equations_output;
+  writeEquationsInParallel(equations_output, false, false, output_type, write_equation_tags);
   for (int eq = 0; eq < (int) equations.size(); eq++)
-    {
-      content_output << "% Equation " << eq + 1 << endl;
-      bool wrote_eq_tag = false;
-      if (write_equation_tags)
-        {
-          for (vector<pair<int, pair<string, string> > >::const_iterator iteqt = equation_tags.begin();
-               iteqt != equation_tags.end(); iteqt++)
-            if (iteqt->first == eq)
-              {
-                if (!wrote_eq_tag)
-                  content_output << "\\noindent[";
-                else
-                  content_output << ", ";
-
-                content_output << iteqt->second.first;
-
-                if (iteqt->second.second.empty())
-                  content_output << "= `" << iteqt->second.second << "'";
-
-                wrote_eq_tag = true;
-              }
-        }
-      if (wrote_eq_tag)
-        content_output << "]";
-
-      content_output << "\\begin{dmath}" << endl;
-      // Here it is necessary to cast to superclass ExprNode, otherwise the overloaded writeOutput() method is not found
-      dynamic_cast<ExprNode *>(equations[eq])->writeOutput(content_output, output_type);
-      content_output << endl << "\\end{dmath}" << endl;
-    }
+    content_output << equations_output[eq];
 
   output << "\\include{" << content_basename << "}" << endl
          << "\\end{document}" << endl;
@@ -1712,6 +2766,31 @@ ModelTree::writeLatexModelFile(const string &basename, ExprNodeOutputType output
   content_output.close();
 }
 
+void
+ModelTree::writeLatexModelEquation(ostream &output, int eq, ExprNodeOutputType output_type, const vector<pair<string, string> > &eqtags) const
+{
+  output << "% Equation " << eq + 1 << endl;
+  for (vector<pair<string, string> >::const_iterator it = eqtags.begin(); it != eqtags.end(); it++)
+    {
+      if (it == eqtags.begin())
+        output << "\\noindent[";
+      else
+        output << ", ";
+
+      output << it->first;
+
+      if (it->second.empty())
+        output << "= `" << it->second << "'";
+    }
+  if (!eqtags.empty())
+    output << "]";
+
+  output << "\\begin{dmath}" << endl;
+  // Here it is necessary to cast to superclass ExprNode, otherwise the overloaded writeOutput() method is not found
+  dynamic_cast<ExprNode *>(equations[eq])->writeOutput(output, output_type);
+  output << endl << "\\end{dmath}" << endl;
+}
+
 void
 ModelTree::addEquation(expr_t eq, int lineno)
 {
@@ -1839,7 +2918,7 @@ ModelTree::computeParamsDerivatives(int paramsDerivsOrder)
             expr_t d2 = d1->getDerivative(param);
             if (d2 == Zero)
               continue;
-            residuals_params_second_derivatives[make_pair(eq, make_pair(param1, param))] = d2;
+            residuals_params_second_derivatives.insert(make_pair(eq, make_pair(param1, param)), d2);
           }
 
       for (first_derivatives_t::const_iterator it2 = first_derivatives.begin();
@@ -1852,7 +2931,7 @@ ModelTree::computeParamsDerivatives(int paramsDerivsOrder)
           expr_t d2 = d1->getDerivative(param);
           if (d2 == Zero)
             continue;
-          jacobian_params_derivatives[make_pair(eq, make_pair(var, param))] = d2;
+          jacobian_params_derivatives.insert(make_pair(eq, make_pair(var, param)), d2);
         }
 
       if (paramsDerivsOrder == 2)
@@ -1868,7 +2947,7 @@ ModelTree::computeParamsDerivatives(int paramsDerivsOrder)
               expr_t d2 = d1->getDerivative(param);
               if (d2 == Zero)
                 continue;
-              jacobian_params_second_derivatives[make_pair(eq, make_pair(var, make_pair(param1, param)))] = d2;
+              jacobian_params_second_derivatives.insert(make_pair(eq, make_pair(var, make_pair(param1, param))), d2);
             }
 
           for (second_derivatives_t::const_iterator it2 = second_derivatives.begin();
@@ -1882,7 +2961,7 @@ ModelTree::computeParamsDerivatives(int paramsDerivsOrder)
               expr_t d2 = d1->getDerivative(param);
               if (d2 == Zero)
                 continue;
-              hessian_params_derivatives[make_pair(eq, make_pair(var1, make_pair(var2, param)))] = d2;
+              hessian_params_derivatives.insert(make_pair(eq, make_pair(var1, make_pair(var2, param))), d2);
             }
         }
     }
@@ -1951,9 +3030,9 @@ ModelTree::isNonstationary(int symb_id) const
 void
 ModelTree::writeJsonModelEquations(ostream &output, bool residuals) const
 {
-  deriv_node_temp_terms_t tef_terms;
-  vector<pair<string, string> > eqtags;
-  temporary_terms_t tt_empty;
+  vector<string> equations_output;
+  writeEquationsInParallel(equations_output, true, residuals, oMatlabDynamicModel, !residuals);
+
   if (residuals)
     output << endl << "\"residuals\":[" << endl;
   else
@@ -1962,65 +3041,160 @@ ModelTree::writeJsonModelEquations(ostream &output, bool residuals) const
     {
       if (eq > 0)
         output << ", ";
+      output << equations_output[eq];
+    }
+  output << endl << "]" << endl;
+}
 
-      BinaryOpNode *eq_node = equations[eq];
-      expr_t lhs = eq_node->get_arg1();
-      expr_t rhs = eq_node->get_arg2();
+void
+ModelTree::writeJsonModelEquation(ostream &output, int eq, bool residuals, const vector<pair<string, string> > &eqtags) const
+{
+  deriv_node_temp_terms_t tef_terms;
+  temporary_terms_t tt_empty;
+  BinaryOpNode *eq_node = equations[eq];
+  expr_t lhs = eq_node->get_arg1();
+  expr_t rhs = eq_node->get_arg2();
 
-      if (residuals)
+  if (residuals)
+    {
+      output << "{\"residual\": {"
+             << "\"lhs\": \"";
+      lhs->writeJsonOutput(output, temporary_terms, tef_terms);
+      output << "\"";
+
+      output << ", \"rhs\": \"";
+      rhs->writeJsonOutput(output, temporary_terms, tef_terms);
+      output << "\"";
+      try
         {
-          output << "{\"residual\": {"
-                 << "\"lhs\": \"";
-          lhs->writeJsonOutput(output, temporary_terms, tef_terms);
-          output << "\"";
-
-          output << ", \"rhs\": \"";
-          rhs->writeJsonOutput(output, temporary_terms, tef_terms);
-          output << "\"";
-          try
+          // Test if the right hand side of the equation is empty.
+          if (rhs->eval(eval_context_t()) != 0)
             {
-              // Test if the right hand side of the equation is empty.
-              if (rhs->eval(eval_context_t()) != 0)
-                {
-                  output << ", \"rhs\": \"";
-                  rhs->writeJsonOutput(output, temporary_terms, tef_terms);
-                  output << "\"";
-                }
+              output << ", \"rhs\": \"";
+              rhs->writeJsonOutput(output, temporary_terms, tef_terms);
+              output << "\"";
             }
-          catch (ExprNode::EvalException &e)
+        }
+      catch (ExprNode::EvalException &e)
+        {
+        }
+      output << "}";
+    }
+  else
+    {
+      output << "{\"lhs\": \"";
+      lhs->writeJsonOutput(output, tt_empty, tef_terms);
+      output << "\", \"rhs\": \"";
+      rhs->writeJsonOutput(output, tt_empty, tef_terms);
+      output << "\""
+             << ", \"line\": " << equations_lineno[eq];
+
+      if (!eqtags.empty())
+        {
+          output << ", \"tags\": {";
+          int i = 0;
+          for (vector<pair<string, string> >::const_iterator it = eqtags.begin(); it != eqtags.end(); it++, i++)
             {
+              if (i != 0)
+                output << ", ";
+              output << "\"" << it->first << "\": \"" << it->second << "\"";
             }
           output << "}";
         }
+    }
+  output << "}" << endl;
+}
+
+void *
+ModelTree::writeEquationsThread(void *arg)
+{
+  EquationsOutputThreadArg *oarg = static_cast<EquationsOutputThreadArg *>(arg);
+  for (size_t eq = oarg->first; eq < oarg->last; eq++)
+    {
+      ostringstream output;
+      if (oarg->json)
+        oarg->model->writeJsonModelEquation(output, eq, oarg->residuals, (*oarg->tags)[eq]);
       else
-        {
-          output << "{\"lhs\": \"";
-          lhs->writeJsonOutput(output, tt_empty, tef_terms);
-          output << "\", \"rhs\": \"";
-          rhs->writeJsonOutput(output, tt_empty, tef_terms);
-          output << "\""
-                 << ", \"line\": " << equations_lineno[eq];
+        oarg->model->writeLatexModelEquation(output, eq, oarg->output_type, (*oarg->tags)[eq]);
+      (*oarg->output)[eq] = output.str();
+    }
+  return NULL;
+}
 
-          for (vector<pair<int, pair<string, string> > >::const_iterator it = equation_tags.begin();
-               it != equation_tags.end(); it++)
-            if (it->first == eq)
-              eqtags.push_back(it->second);
+void
+ModelTree::writeEquationsInParallel(vector<string> &output, bool json, bool residuals, ExprNodeOutputType output_type,
+                                    bool with_tags) const
+{
+  output.assign(equations.size(), string());
+  vector<vector<pair<string, string> > > tags(equations.size());
+  if (with_tags)
+    for (vector<pair<int, pair<string, string> > >::const_iterator it = equation_tags.begin();
+         it != equation_tags.end(); it++)
+      tags[it->first].push_back(it->second);
+
+  // Each thread writes a contiguous range of equations (see DynamicModel::computeXrefs())
+  size_t nthreads = 1;
+#if defined(HAVE_PTHREAD) && defined(_SC_NPROCESSORS_ONLN)
+  long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (ncpus > 1)
+    nthreads = min((size_t) ncpus, equations.size() / 64 + 1);
+#endif
+  vector<EquationsOutputThreadArg> args(nthreads);
+  for (size_t t = 0; t < nthreads; t++)
+    {
+      args[t].model = this;
+      args[t].first = equations.size() * t / nthreads;
+      args[t].last = equations.size() * (t + 1) / nthreads;
+      args[t].output = &output;
+      args[t].tags = &tags;
+      args[t].json = json;
+      args[t].residuals = residuals;
+      args[t].output_type = output_type;
+    }
+#ifdef HAVE_PTHREAD
+  vector<pthread_t> threads(nthreads);
+  vector<bool> started(nthreads, false);
+  for (size_t t = 1; t < nthreads; t++)
+    started[t] = !pthread_create(&threads[t], NULL, writeEquationsThread, &args[t]);
+#endif
+  writeEquationsThread(&args[0]);
+#ifdef HAVE_PTHREAD
+  for (size_t t = 1; t < nthreads; t++)
+    if (started[t])
+      pthread_join(threads[t], NULL);
+    else
+      writeEquationsThread(&args[t]);
+#endif
+}
 
-          if (!eqtags.empty())
-            {
-              output << ", \"tags\": {";
-              int i = 0;
-              for (vector<pair<string, string> >::const_iterator it = eqtags.begin(); it != eqtags.end(); it++, i++)
-                {
-                  if (i != 0)
-                    output << ", ";
-                  output << "\"" << it->first << "\": \"" << it->second << "\"";
-                }
-              output << "}";
-              eqtags.clear();
-            }
-        }
-      output << "}" << endl;
+void
+ModelTree::runBlockThreads(void *(*thread_function)(void *))
+{
+  unsigned int nthreads = 1;
+#if defined(HAVE_PTHREAD) && defined(_SC_NPROCESSORS_ONLN)
+  long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (ncpus > 1)
+    nthreads = min((unsigned int) ncpus, getNbBlocks() / 16 + 1);
+#endif
+  vector<BlockThreadArg> args(nthreads);
+  for (unsigned int t = 0; t < nthreads; t++)
+    {
+      args[t].model = this;
+      args[t].first_block = t;
+      args[t].step = nthreads;
     }
-  output << endl << "]" << endl;
+#ifdef HAVE_PTHREAD
+  vector<pthread_t> threads(nthreads);
+  vector<bool> started(nthreads, false);
+  for (unsigned int t = 1; t < nthreads; t++)
+    started[t] = !pthread_create(&threads[t], NULL, thread_function, &args[t]);
+#endif
+  thread_function(&args[0]);
+#ifdef HAVE_PTHREAD
+  for (unsigned int t = 1; t < nthreads; t++)
+    if (started[t])
+      pthread_join(threads[t], NULL);
+    else
+      thread_function(&args[t]);
+#endif
 }
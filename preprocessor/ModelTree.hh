@@ -27,9 +27,81 @@ using namespace std;
 #include <deque>
 #include <map>
 #include <ostream>
+#include <ctime>
+#include <algorithm>
 
 #include "DataTree.hh"
 #include "ExtendedPreprocessorTypes.hh"
+#include "BipartiteMatching.hh"
+
+//! Sparse storage for derivatives of order two and above
+/*! Non-null derivatives are stored as a flat vector of (index, node) pairs, instead of a map with one tree node per entry.
+  Insertions are appended, and the vector is sorted by index the first time it is traversed after an out-of-order insertion,
+  so that traversal order is the same as that of a map.
+  A given index must be inserted at most once. */
+template<class Key>
+class SparseDerivatives
+{
+public:
+  typedef pair<Key, expr_t> value_type;
+  typedef typename vector<value_type>::const_iterator const_iterator;
+  //! Elements cannot be modified in place, since that could break the ordering
+  typedef const_iterator iterator;
+private:
+  struct IndexLess
+  {
+    bool
+    operator()(const value_type &a, const value_type &b) const
+    {
+      return a.first < b.first;
+    }
+  };
+  mutable vector<value_type> elements;
+  //! Whether elements is currently sorted by index
+  mutable bool sorted;
+  void
+  sortIfNeeded() const
+  {
+    if (!sorted)
+      {
+        sort(elements.begin(), elements.end(), IndexLess());
+        sorted = true;
+      }
+  }
+public:
+  SparseDerivatives() : sorted(true)
+  {
+  };
+  void
+  insert(const Key &index, expr_t d)
+  {
+    if (sorted && !elements.empty() && !(elements.back().first < index))
+      sorted = false;
+    elements.push_back(make_pair(index, d));
+  };
+  const_iterator
+  begin() const
+  {
+    sortIfNeeded();
+    return elements.begin();
+  };
+  const_iterator
+  end() const
+  {
+    sortIfNeeded();
+    return elements.end();
+  };
+  size_t
+  size() const
+  {
+    return elements.size();
+  };
+  bool
+  empty() const
+  {
+    return elements.empty();
+  };
+};
 
 //! Vector describing equations: BlockSimulationType, if BlockSimulationType == EVALUATE_s then a expr_t on the new normalized equation
 typedef vector<pair<EquationType, expr_t > > equation_type_and_normalized_equation_t;
@@ -46,6 +118,8 @@ typedef vector< pair<pair<int, int>, pair< int, expr_t > > > block_derivatives_e
 //! for all blocks derivatives description
 typedef vector<block_derivatives_equation_variable_laglead_nodeid_t> blocks_derivatives_t;
 
+struct ModelIRNode;
+
 //! Shared code for static and dynamic models
 class ModelTree : public DataTree
 {
@@ -67,6 +141,9 @@ protected:
   //! Number of non-zero derivatives
   int NNZDerivatives[3];
 
+  //! Whether to also write a batched variant of the C model function (evaluating several points at once)
+  bool c_batch;
+
   typedef map<pair<int, int>, expr_t> first_derivatives_t;
   //! First order derivatives
   /*! First index is equation number, second is variable w.r. to which is computed the derivative.
@@ -75,7 +152,7 @@ protected:
   */
   first_derivatives_t first_derivatives;
 
-  typedef map<pair<int, pair<int, int> >, expr_t> second_derivatives_t;
+  typedef SparseDerivatives<pair<int, pair<int, int> > > second_derivatives_t;
   //! Second order derivatives
   /*! First index is equation number, second and third are variables w.r. to which is computed the derivative.
     Only non-null derivatives are stored in the map.
@@ -84,7 +161,7 @@ protected:
   */
   second_derivatives_t second_derivatives;
 
-  typedef map<pair<int, pair<int, pair<int, int> > >, expr_t> third_derivatives_t;
+  typedef SparseDerivatives<pair<int, pair<int, pair<int, int> > > > third_derivatives_t;
   //! Third order derivatives
   /*! First index is equation number, second, third and fourth are variables w.r. to which is computed the derivative.
     Only non-null derivatives are stored in the map.
@@ -128,6 +205,36 @@ protected:
   */
   third_derivatives_t hessian_params_derivatives;
 
+  //! Derivatives of an equation, as stored in the equation derivatives cache by a previous run
+  /*! The derivation variables are written as "<type> <name> <lag>", so that they do not depend on
+    the symbol and derivation IDs of the previous run */
+  struct cached_equation_derivatives_t
+  {
+    //! Highest derivation order stored
+    int order;
+    //! Number of derivation variables considered for the equation, followed by these variables
+    string vars;
+    //! Nodes of the derivatives, each one referring to its arguments by their position (see serializeExpression())
+    vector<string> nodes;
+    //! Derivatives, each one written as "<node> <order> <variables>"
+    vector<string> derivatives;
+  };
+  //! Equation derivatives cache read from the previous run, indexed by the serialized equations (see computeEquationKey())
+  map<string, cached_equation_derivatives_t> equation_derivatives_cache;
+  //! Whether the equation derivatives cache is used (in which case the information needed to write it is kept)
+  bool use_equation_derivatives_cache;
+  //! For each equation, its serialized form (empty if it can't be cached)
+  vector<string> equation_keys;
+  //! For each equation, the derivation IDs considered (those of its potentially non-null derivatives)
+  vector<vector<int> > equation_derivation_vars;
+  //! For each equation, the cache entry from which its derivatives have been restored (or NULL)
+  vector<const cached_equation_derivatives_t *> restored_equations;
+  //! For each equation, the restored derivatives of order 2 and 3, inserted by computeHessian() and computeThirdDerivatives()
+  /*! The derivation IDs of each derivative are sorted in decreasing order */
+  vector<vector<pair<vector<int>, expr_t> > > restored_derivatives;
+  //! Highest order of the derivatives computed for all equations
+  int derivation_order;
+
   //! Temporary terms for the static/dynamic file (those which will be noted Txxxx)
   temporary_terms_t temporary_terms;
   temporary_terms_t temporary_terms_res;
@@ -167,8 +274,31 @@ protected:
   //! Computes 3rd derivatives
   /*! \param vars the derivation IDs w.r. to which derive the 2nd derivatives */
   void computeThirdDerivatives(const set<int> &vars);
+  //! Inserts the restored derivatives of the given order (2 or 3) in second_derivatives or third_derivatives
+  void insertRestoredDerivatives(int order);
+  //! Serializes a node and its arguments in a node table, returns its position in the table
+  /*! Model local variables are replaced by their definition if expand_local_variables is true.
+    Returns -1 if the expression contains a node which can't be cached (external functions,
+    expectation and steady state parameter derivative operators) */
+  int serializeExpression(expr_t e, bool expand_local_variables, map<expr_t, int> &positions, vector<string> &nodes) const;
+  //! Returns the serialized form of an equation, in which model local variables are expanded (empty if it can't be cached)
+  string computeEquationKey(int eq) const;
+  //! Writes a derivation variable as "<type> <name> <lag>"
+  string serializeDerivID(int deriv_id) const;
+  //! Reads a derivation variable written by serializeDerivID(), returns -1 if it is not a derivation variable of this model
+  int readDerivID(istream &input) const;
+  //! Restores the derivatives of an equation from a cache entry, returns false if the entry is unusable
+  /*! The first derivatives are stored in first_derivatives, the others in restored_derivatives */
+  bool restoreEquationDerivatives(int eq, const cached_equation_derivatives_t &cached);
+  //! Adds a node and its arguments to the nodes of the model IR (see ModelIR.hh), returns its index
+  /*! Model local variables are replaced by their definition.
+    Returns -1 if the expression contains an external function */
+  int appendModelIRNode(expr_t e, map<expr_t, int> &positions, vector<ModelIRNode> &nodes) const;
   //! Computes derivatives of the Jacobian and Hessian w.r. to parameters
   void computeParamsDerivatives(int paramsDerivsOrder);
+  //! Prints the CPU time elapsed since start, and the number of nodes in the tree
+  /*! Used for reporting on the cost of each derivation step */
+  void printDerivationTiming(clock_t start) const;
   //! Write derivative of an equation w.r. to a variable
   void writeDerivative(ostream &output, int eq, int symb_id, int lag, ExprNodeOutputType output_type, const temporary_terms_t &temporary_terms) const;
   //! Computes temporary terms (for all equations and derivatives)
@@ -189,12 +319,63 @@ protected:
   //! Writes model local variables
   /*! No temporary term is used in the output, so that local parameters declarations can be safely put before temporary terms declaration in the output files */
   void writeModelLocalVariables(ostream &output, ExprNodeOutputType output_type, deriv_node_temp_terms_t &tef_terms) const;
+  //! Equations whose trees only differ by the symbols of their operands, see computeEquationFamilies()
+  struct equation_family_t
+  {
+    //! Equations of the family, in increasing order
+    vector<int> equations;
+    //! Operands of each equation: its distinct endogenous, exogenous and parameter leaves, in the order of their first occurrence
+    vector<vector<expr_t> > operands;
+  };
+  //! Minimal number of equations of a family
+  static const unsigned int min_equation_family_size = 4;
+  //! Writes the structure of an expression, in which the operands are numbered by order of first occurrence
+  /*! Returns false if the expression contains a node whose output can't be shared between equations */
+  static bool writeEquationStructure(expr_t expr, const temporary_terms_t &tt, ostream &structure,
+                                     map<expr_t, int> &operand_slots, vector<expr_t> &operands);
+  //! Groups the equations which are identical up to the symbols of their endogenous, exogenous and parameter leaves
+  /*! Models generated with macro-processor loops (multi-country or multi-sector models) contain
+    many such equations. The lags of the operands, the sharing of the leaves inside an equation,
+    the constants and the temporary terms (which can't be indexed in the output) must be the same
+    for all the equations of a family. Only the families of at least min_equation_family_size
+    equations are returned. */
+  void computeEquationFamilies(const temporary_terms_t &tt, vector<equation_family_t> &families) const;
+  //! Writes the residuals of the equations of a family as a loop over a table of their operands (C only)
+  /*! Returns false, writing nothing, if the operands of the equations don't only differ by an
+    index in the output, in which case the equations have to be written one by one */
+  bool writeEquationFamily(ostream &output, ExprNodeOutputType output_type, const temporary_terms_t &tt,
+                           const equation_family_t &family, int family_number) const;
   //! Writes model equations
-  void writeModelEquations(ostream &output, ExprNodeOutputType output_type) const;
+  /*! The equations of the families which can be written with writeEquationFamily() are computed in loops */
+  void writeModelEquations(ostream &output, ExprNodeOutputType output_type,
+                           const vector<equation_family_t> &families = vector<equation_family_t>()) const;
   //! Writes JSON model equations
   //! if residuals = true, we are writing the dynamic/static model.
   //! Otherwise, just the model equations (with line numbers, no tmp terms)
   void writeJsonModelEquations(ostream &output, bool residuals) const;
+  //! Writes one equation in JSON, as an element of the list written by writeJsonModelEquations()
+  void writeJsonModelEquation(ostream &output, int eq, bool residuals, const vector<pair<string, string> > &eqtags) const;
+  //! Writes one equation in LaTeX, preceded by its tags (if any given), as written by writeLatexModelFile()
+  void writeLatexModelEquation(ostream &output, int eq, ExprNodeOutputType output_type, const vector<pair<string, string> > &eqtags) const;
+  //! Arguments of writeEquationsThread()
+  struct EquationsOutputThreadArg
+  {
+    const ModelTree *model;
+    //! The thread writes the equations first to last-1, each one in its own string of output
+    size_t first, last;
+    vector<string> *output;
+    //! Tags of each equation
+    const vector<vector<pair<string, string> > > *tags;
+    //! Whether to write JSON (with residuals or not) or LaTeX (with output_type)
+    bool json, residuals;
+    ExprNodeOutputType output_type;
+  };
+  static void *writeEquationsThread(void *arg);
+  //! Writes each equation in a separate string, in parallel if threads are available
+  /*! Used by writeJsonModelEquations() and writeLatexModelFile(), which concatenate the strings in order:
+    the writing of a node only reads the trees and the symbol table */
+  void writeEquationsInParallel(vector<string> &output, bool json, bool residuals, ExprNodeOutputType output_type,
+                                bool with_tags) const;
   void writeJsonModelLocalVariables(ostream &output, deriv_node_temp_terms_t &tef_terms) const;
   //! Compiles model equations
   void compileModelEquations(ostream &code_file, unsigned int &instruction_number, const temporary_terms_t &tt, const map_idx_t &map_idx, bool dynamic, bool steady_dynamic) const;
@@ -223,9 +404,10 @@ protected:
   //! Compute the matching between endogenous and variable using the jacobian contemporaneous_jacobian
   /*!
     \param contemporaneous_jacobian Jacobian used as an incidence matrix: all elements declared in the map (even if they are zero), are used as vertices of the incidence matrix
+    \param matching Matching from which the computation starts, updated with the result; its matched pairs which are not in the incidence matrix are dropped
     \return True if a complete normalization has been achieved
   */
-  bool computeNormalization(const jacob_map_t &contemporaneous_jacobian, bool verbose);
+  bool computeNormalization(const jacob_map_t &contemporaneous_jacobian, bool verbose, BipartiteMatching &matching);
 
   //! Try to compute the matching between endogenous and variable using a decreasing cutoff
   /*!
@@ -253,6 +435,8 @@ protected:
   void printBlockDecomposition(const vector<pair<int, int> > &blocks) const;
   //! Determine for each block if it is linear or not
   vector<bool> BlockLinear(const blocks_derivatives_t &blocks_derivatives, const vector<int> &variable_reordered) const;
+  //! Determine for each block the other blocks containing endogenous variables used by its equations
+  vector<vector<unsigned int> > computeBlockDependencies() const;
 
   //! Determine the simulation type of each block
   virtual BlockSimulationType getBlockSimulationType(int block_number) const = 0;
@@ -304,6 +488,17 @@ protected:
   virtual int getBlockInitialOtherEndogenousID(int block_number, int variable_number) const = 0;
   //! Initialize equation_reordered & variable_reordered
   void initializeVariablesAndEquations();
+  //! Arguments of the thread functions given to runBlockThreads
+  struct BlockThreadArg
+  {
+    ModelTree *model;
+    //! The thread processes the blocks first_block, first_block+step, first_block+2*step...
+    unsigned int first_block, step;
+  };
+  //! Runs a thread function over all the blocks, in parallel if threads are available
+  /*! The blocks are interleaved among the threads, so that the large blocks are spread over them.
+    The thread function must only write the data of the blocks it is given */
+  void runBlockThreads(void *(*thread_function)(void *));
 public:
   ModelTree(SymbolTable &symbol_table_arg, NumericalConstants &num_constants_arg, ExternalFunctionsTable &external_functions_table_arg);
   //! Absolute value under which a number is considered to be zero
@@ -323,6 +518,22 @@ public:
   void addAuxEquation(expr_t eq);
   //! Returns the number of equations in the model
   int equation_number() const;
+  //! Returns the number of non-zero derivatives of the given order (between 1 and 3)
+  int getNNZDerivatives(int order) const;
+  //! Whether some derivatives with respect to the parameters have been computed
+  bool hasParamsDerivatives() const;
+  //! Sets the number of non-zero derivatives of the given order (between 1 and 3)
+  /*! Used when the derivatives have not been recomputed, but are known from a previous run */
+  void setNNZDerivatives(int order, int nnz);
+  //! Reads the equation derivatives cache written by a previous run, and enables it
+  /*! The derivatives of the equations found in the cache are restored instead of being recomputed */
+  void readEquationDerivativesCache(const string &filename);
+  //! Writes the derivatives of each equation, to be restored by the next run if the equation is unchanged
+  void writeEquationDerivativesCache(const string &filename) const;
+  //! Writes the equations and their derivatives in the binary format described in ModelIR.hh
+  void writeModelIR(const string &filename) const;
+  //! Sets whether the batched variant of the C model function is written (use_dll option only)
+  void setCBatch(bool c_batch_arg);
   //! Adds a trend variable with its growth factor
   void addTrendVariables(vector<int> trend_vars, expr_t growth_factor) throw (TrendException);
   //! Adds a nonstationary variables with their (common) deflator
@@ -337,6 +548,19 @@ public:
   /*! If order=2, writes either v2(i+1,j+1) or v2[i+j*NNZDerivatives[1]]
     If order=3, writes either v3(i+1,j+1) or v3[i+j*NNZDerivatives[2]] */
   void sparseHelper(int order, ostream &output, int row_nb, int col_nb, ExprNodeOutputType output_type) const;
+  //! Helper for writing the body of the batched C model functions
+  /*! Rewrites C code computing the model at one point so that it computes the model at point k
+    out of K: every element of the y, x, params, steady_state, residual and g1 arrays is replaced by
+    a vector of K contiguous values (structure-of-arrays layout), i.e.
+    y[i] becomes y[(i)*K+k]. Each line of the output is prefixed by indent. */
+  static void writeCBatchedCode(ostream &output, const string &code, const string &indent);
+  //! Helper for writing the sparsity pattern of the Jacobian in Julia
+  /*! csc_index maps the (column, equation) pairs of the nonzero elements to their 1-based
+    position in the nzval array of a SparseMatrixCSC, which follows the order of the map.
+    Writes the colptr and rowval arrays as constants and a function func_name() returning a
+    new SparseMatrixCSC with this pattern, to be filled in place by the model functions. */
+  static void writeJuliaJacobianPattern(ostream &output, const string &func_name,
+                                        const map<pair<int, int>, int> &csc_index, int nrows, int ncols);
   inline static std::string
   c_Equation_Type(int type)
   {
@@ -607,6 +607,12 @@ ParsingDriver::no_static()
   mod_file->no_static = true;
 }
 
+void
+ParsingDriver::compact_lags()
+{
+  mod_file->compact_lags = true;
+}
+
 void
 ParsingDriver::byte_code()
 {
@@ -285,6 +285,8 @@ public:
   void byte_code();
   //! the static model is not computed
   void no_static();
+  //! the model option compact_lags is enabled
+  void compact_lags();
   //! the differentiate_forward_vars option is enabled (for all vars)
   void differentiate_forward_vars_all();
   //! the differentiate_forward_vars option is enabled (for a subset of vars)
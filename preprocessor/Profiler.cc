@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2018 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+
+#ifndef _WIN32
+# include <sys/time.h>
+# include <sys/resource.h>
+#endif
+
+#include "Profiler.hh"
+
+Profiler::Profiler(bool enabled_arg) : enabled(enabled_arg)
+{
+  wall_start = wallClock();
+  cpu_start = clock();
+}
+
+double
+Profiler::wallClock()
+{
+#ifndef _WIN32
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+#else
+  return (double) time(NULL);
+#endif
+}
+
+long
+Profiler::peakMemory()
+{
+#ifndef _WIN32
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage))
+    return -1;
+# ifdef __APPLE__
+  // OS X reports ru_maxrss in bytes
+  return usage.ru_maxrss / 1024;
+# else
+  return usage.ru_maxrss;
+# endif
+#else
+  return -1;
+#endif
+}
+
+void
+Profiler::endPhase(const string &name, int dynamic_model_nodes, int static_model_nodes)
+{
+  if (!enabled)
+    return;
+
+  double wall_end = wallClock();
+  clock_t cpu_end = clock();
+
+  Phase phase;
+  phase.name = name;
+  phase.wall_time = wall_end - wall_start;
+  phase.cpu_time = (double) (cpu_end - cpu_start) / CLOCKS_PER_SEC;
+  phase.peak_memory = peakMemory();
+  phase.dynamic_model_nodes = dynamic_model_nodes;
+  phase.static_model_nodes = static_model_nodes;
+  phases.push_back(phase);
+
+  wall_start = wall_end;
+  cpu_start = cpu_end;
+}
+
+void
+Profiler::writeJsonOutput(const string &basename) const
+{
+  if (!enabled)
+    return;
+
+  string filename = basename + "_profile.json";
+  ofstream output;
+  output.open(filename.c_str(), ios::out | ios::binary);
+  if (!output.is_open())
+    {
+      cerr << "ERROR: Can't open file " << filename << " for writing" << endl;
+      exit(EXIT_FAILURE);
+    }
+
+  double total_wall_time = 0, total_cpu_time = 0;
+  output << "{\"phases\": [";
+  for (vector<Phase>::const_iterator it = phases.begin(); it != phases.end(); it++)
+    {
+      if (it != phases.begin())
+        output << ", ";
+      output << "{\"name\": \"" << it->name << "\""
+             << ", \"wall_time\": " << it->wall_time
+             << ", \"cpu_time\": " << it->cpu_time
+             << ", \"peak_memory_kb\": " << it->peak_memory;
+      if (it->dynamic_model_nodes >= 0)
+        output << ", \"dynamic_model_nodes\": " << it->dynamic_model_nodes;
+      if (it->static_model_nodes >= 0)
+        output << ", \"static_model_nodes\": " << it->static_model_nodes;
+      output << "}" << endl;
+      total_wall_time += it->wall_time;
+      total_cpu_time += it->cpu_time;
+    }
+  output << "]"
+         << ", \"total_wall_time\": " << total_wall_time
+         << ", \"total_cpu_time\": " << total_cpu_time
+         << "}" << endl;
+  output.close();
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2018 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PROFILER_HH
+#define _PROFILER_HH
+
+#include <ctime>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//! Records the cost of the successive phases of the preprocessor (profile option)
+/*! A phase starts at the end of the previous one (or at construction), and
+  ends with a call to endPhase(). The results are written in JSON to
+  <basename>_profile.json */
+class Profiler
+{
+private:
+  struct Phase
+  {
+    string name;
+    //! Wall clock and CPU times of the phase, in seconds
+    double wall_time, cpu_time;
+    //! Peak resident memory of the process at the end of the phase, in kilobytes (-1 if unavailable)
+    long peak_memory;
+    //! Number of nodes in the dynamic and static model trees at the end of the phase (-1 if not relevant)
+    int dynamic_model_nodes, static_model_nodes;
+  };
+  bool enabled;
+  vector<Phase> phases;
+  double wall_start;
+  clock_t cpu_start;
+  //! Returns the wall clock time, in seconds
+  static double wallClock();
+  //! Returns the peak resident memory of the process, in kilobytes (-1 if unavailable)
+  static long peakMemory();
+public:
+  Profiler(bool enabled_arg);
+  inline bool
+  isEnabled() const
+  {
+    return enabled;
+  };
+  //! Records the phase ending now
+  void endPhase(const string &name, int dynamic_model_nodes = -1, int static_model_nodes = -1);
+  //! Writes the recorded phases to <basename>_profile.json
+  void writeJsonOutput(const string &basename) const;
+};
+
+#endif
@@ -39,6 +39,9 @@ ModFileStructure::ModFileStructure() :
   svar_identification_present(false),
   identification_present(false),
   estimation_analytic_derivation(false),
+  dynamic_derivs_order(1),
+  static_derivs_order(1),
+  params_derivs_order(0),
   partial_information(false),
   k_order_solver(false),
   calibrated_measurement_errors(false),
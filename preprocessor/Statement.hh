@@ -70,6 +70,12 @@ public:
   bool identification_present;
   //! Whether the option analytic_derivation is given to estimation
   bool estimation_analytic_derivation;
+  //! Order of the derivatives of the dynamic model needed by the computing tasks, on top of those implied by order_option
+  int dynamic_derivs_order;
+  //! Order of the derivatives of the static model needed by the computing tasks
+  int static_derivs_order;
+  //! Order of the derivatives of the static and dynamic models w.r.t. the parameters needed by the computing tasks
+  int params_derivs_order;
   //! Whether the option partial_information is given to stoch_simul/estimation/osr/ramsey_policy
   bool partial_information;
   //! Whether the "k_order_solver" option is used (explictly, or implicitly if order >= 3)
@@ -24,7 +24,9 @@
 #include <cstdio>
 #include <cerrno>
 #include <algorithm>
+#include <sstream>
 #include "StaticModel.hh"
+#include "BytecodePatterns.hh"
 
 // For mkdir() and chdir()
 #ifdef _WIN32
@@ -72,12 +74,7 @@ StaticModel::compileChainRuleDerivative(ofstream &code_file, unsigned int &instr
 void
 StaticModel::computeTemporaryTermsOrdered()
 {
-  map<expr_t, pair<int, int> > first_occurence;
-  map<expr_t, int> reference_count;
   BinaryOpNode *eq_node;
-  first_derivatives_t::const_iterator it;
-  first_chain_rule_derivatives_t::const_iterator it_chr;
-  ostringstream tmp_s;
   v_temporary_terms.clear();
   map_idx.clear();
 
@@ -91,43 +88,11 @@ StaticModel::computeTemporaryTermsOrdered()
 
   temporary_terms.clear();
 
-  //local temporay terms
-  for (unsigned int block = 0; block < nb_blocks; block++)
-    {
-      map<expr_t, int> reference_count_local;
-      reference_count_local.clear();
-      map<expr_t, pair<int, int> > first_occurence_local;
-      first_occurence_local.clear();
-      temporary_terms_t temporary_terms_l;
-      temporary_terms_l.clear();
+  //local temporay terms, independent from one block to another
+  runBlockThreads(computeLocalTemporaryTermsThread);
 
-      unsigned int block_size = getBlockSize(block);
-      unsigned int block_nb_mfs = getBlockMfs(block);
-      unsigned int block_nb_recursives = block_size - block_nb_mfs;
-      v_temporary_terms_local[block] = vector<temporary_terms_t>(block_size);
-
-      for (unsigned int i = 0; i < block_size; i++)
-        {
-          if (i < block_nb_recursives && isBlockEquationRenormalized(block, i))
-            getBlockEquationRenormalizedExpr(block, i)->computeTemporaryTerms(reference_count_local, temporary_terms_l, first_occurence_local, block, v_temporary_terms_local,  i);
-          else
-            {
-              eq_node = (BinaryOpNode *) getBlockEquationExpr(block, i);
-              eq_node->computeTemporaryTerms(reference_count_local, temporary_terms_l, first_occurence_local, block, v_temporary_terms_local,  i);
-            }
-        }
-      for (block_derivatives_equation_variable_laglead_nodeid_t::const_iterator it = blocks_derivatives[block].begin(); it != (blocks_derivatives[block]).end(); it++)
-        {
-          expr_t id = it->second.second;
-          id->computeTemporaryTerms(reference_count_local, temporary_terms_l, first_occurence_local, block, v_temporary_terms_local,  block_size-1);
-        }
-      set<int> temporary_terms_in_use;
-      temporary_terms_in_use.clear();
-      v_temporary_terms_inuse[block] = temporary_terms_in_use;
-      computeTemporaryTermsMapping(temporary_terms_l, map_idx2[block]);
-    }
-
-  // global temporay terms
+  // global temporay terms, depend on the references found in the previous blocks
+  BlockReferenceCount reference_count(node_number());
   for (unsigned int block = 0; block < nb_blocks; block++)
     {
       // Compute the temporary terms reordered
@@ -138,49 +103,107 @@ StaticModel::computeTemporaryTermsOrdered()
       for (unsigned int i = 0; i < block_size; i++)
         {
           if (i < block_nb_recursives && isBlockEquationRenormalized(block, i))
-            getBlockEquationRenormalizedExpr(block, i)->computeTemporaryTerms(reference_count, temporary_terms, first_occurence, block, v_temporary_terms,  i);
+            getBlockEquationRenormalizedExpr(block, i)->computeTemporaryTerms(reference_count, temporary_terms, block, v_temporary_terms,  i);
           else
             {
               eq_node = (BinaryOpNode *) getBlockEquationExpr(block, i);
-              eq_node->computeTemporaryTerms(reference_count, temporary_terms, first_occurence, block, v_temporary_terms, i);
+              eq_node->computeTemporaryTerms(reference_count, temporary_terms, block, v_temporary_terms, i);
             }
         }
       for (block_derivatives_equation_variable_laglead_nodeid_t::const_iterator it = blocks_derivatives[block].begin(); it != (blocks_derivatives[block]).end(); it++)
         {
           expr_t id = it->second.second;
-          id->computeTemporaryTerms(reference_count, temporary_terms, first_occurence, block, v_temporary_terms, block_size-1);
+          id->computeTemporaryTerms(reference_count, temporary_terms, block, v_temporary_terms, block_size-1);
         }
     }
 
-  for (unsigned int block = 0; block < nb_blocks; block++)
+  // Collecte the temporary terms reordered
+  runBlockThreads(collectTemporaryTermsThread);
+  computeTemporaryTermsMapping(temporary_terms, map_idx);
+}
+
+void
+StaticModel::computeBlockLocalTemporaryTerms(unsigned int block, BlockReferenceCount &reference_count)
+{
+  BinaryOpNode *eq_node;
+  temporary_terms_t temporary_terms_l;
+
+  unsigned int block_size = getBlockSize(block);
+  unsigned int block_nb_mfs = getBlockMfs(block);
+  unsigned int block_nb_recursives = block_size - block_nb_mfs;
+  v_temporary_terms_local[block] = vector<temporary_terms_t>(block_size);
+
+  for (unsigned int i = 0; i < block_size; i++)
     {
-      // Collecte the temporary terms reordered
-      unsigned int block_size = getBlockSize(block);
-      unsigned int block_nb_mfs = getBlockMfs(block);
-      unsigned int block_nb_recursives = block_size - block_nb_mfs;
-      set<int> temporary_terms_in_use;
-      for (unsigned int i = 0; i < block_size; i++)
+      if (i < block_nb_recursives && isBlockEquationRenormalized(block, i))
+        getBlockEquationRenormalizedExpr(block, i)->computeTemporaryTerms(reference_count, temporary_terms_l, block, v_temporary_terms_local,  i);
+      else
         {
-          if (i < block_nb_recursives && isBlockEquationRenormalized(block, i))
-            getBlockEquationRenormalizedExpr(block, i)->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
-          else
-            {
-              eq_node = (BinaryOpNode *) getBlockEquationExpr(block, i);
-              eq_node->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
-            }
+          eq_node = (BinaryOpNode *) getBlockEquationExpr(block, i);
+          eq_node->computeTemporaryTerms(reference_count, temporary_terms_l, block, v_temporary_terms_local,  i);
         }
-      for (block_derivatives_equation_variable_laglead_nodeid_t::const_iterator it = blocks_derivatives[block].begin(); it != (blocks_derivatives[block]).end(); it++)
+    }
+  for (block_derivatives_equation_variable_laglead_nodeid_t::const_iterator it = blocks_derivatives[block].begin(); it != (blocks_derivatives[block]).end(); it++)
+    {
+      expr_t id = it->second.second;
+      id->computeTemporaryTerms(reference_count, temporary_terms_l, block, v_temporary_terms_local,  block_size-1);
+    }
+  computeTemporaryTermsMapping(temporary_terms_l, map_idx2[block]);
+}
+
+void
+StaticModel::collectBlockTemporaryTerms(unsigned int block)
+{
+  BinaryOpNode *eq_node;
+  unsigned int block_size = getBlockSize(block);
+  unsigned int block_nb_mfs = getBlockMfs(block);
+  unsigned int block_nb_recursives = block_size - block_nb_mfs;
+  set<int> temporary_terms_in_use;
+  for (unsigned int i = 0; i < block_size; i++)
+    {
+      if (i < block_nb_recursives && isBlockEquationRenormalized(block, i))
+        getBlockEquationRenormalizedExpr(block, i)->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
+      else
         {
-          expr_t id = it->second.second;
-          id->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
+          eq_node = (BinaryOpNode *) getBlockEquationExpr(block, i);
+          eq_node->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
         }
-      for (int i = 0; i < (int) getBlockSize(block); i++)
-        for (temporary_terms_t::const_iterator it = v_temporary_terms[block][i].begin();
-             it != v_temporary_terms[block][i].end(); it++)
-          (*it)->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
-      v_temporary_terms_inuse[block] = temporary_terms_in_use;
     }
-  computeTemporaryTermsMapping(temporary_terms, map_idx);
+  for (block_derivatives_equation_variable_laglead_nodeid_t::const_iterator it = blocks_derivatives[block].begin(); it != (blocks_derivatives[block]).end(); it++)
+    {
+      expr_t id = it->second.second;
+      id->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
+    }
+  for (int i = 0; i < (int) block_size; i++)
+    for (temporary_terms_t::const_iterator it = v_temporary_terms[block][i].begin();
+         it != v_temporary_terms[block][i].end(); it++)
+      (*it)->collectTemporary_terms(temporary_terms, temporary_terms_in_use, block);
+  v_temporary_terms_inuse[block] = temporary_terms_in_use;
+}
+
+void *
+StaticModel::computeLocalTemporaryTermsThread(void *arg)
+{
+  BlockThreadArg *barg = static_cast<BlockThreadArg *>(arg);
+  StaticModel *model = static_cast<StaticModel *>(barg->model);
+  // The reference counts are reset between the blocks, without reallocating them
+  BlockReferenceCount reference_count(model->node_number());
+  for (unsigned int block = barg->first_block; block < model->getNbBlocks(); block += barg->step)
+    {
+      model->computeBlockLocalTemporaryTerms(block, reference_count);
+      reference_count.clear();
+    }
+  return NULL;
+}
+
+void *
+StaticModel::collectTemporaryTermsThread(void *arg)
+{
+  BlockThreadArg *barg = static_cast<BlockThreadArg *>(arg);
+  StaticModel *model = static_cast<StaticModel *>(barg->model);
+  for (unsigned int block = barg->first_block; block < model->getNbBlocks(); block += barg->step)
+    model->collectBlockTemporaryTerms(block);
+  return NULL;
 }
 
 void
@@ -589,6 +612,7 @@ StaticModel::writeModelEquationsCode_Block(const string file_name, const string
   map<expr_t, int> reference_count;
   vector<int> feedback_variables;
   deriv_node_temp_terms_t tef_terms;
+  BytecodePatterns patterns;
   bool file_open = false;
 
   string main_name = file_name;
@@ -604,6 +628,7 @@ StaticModel::writeModelEquationsCode_Block(const string file_name, const string
   FDIMST_ fdimst(temporary_terms.size());
   fdimst.write(code_file, instruction_number);
 
+  vector<vector<unsigned int> > block_dependencies = computeBlockDependencies();
   for (unsigned int block = 0; block < getNbBlocks(); block++)
     {
       feedback_variables.clear();
@@ -640,6 +665,7 @@ StaticModel::writeModelEquationsCode_Block(const string file_name, const string
                                /*symbol_table.endo_nbr()*/ block_size
                                );
 
+      fbeginblock.set_dependencies(block_dependencies[block]);
       fbeginblock.write(code_file, instruction_number);
 
       // Get the current code_file position and jump if eval = true
@@ -712,21 +738,28 @@ StaticModel::writeModelEquationsCode_Block(const string file_name, const string
               goto end;
             default:
             end:
-              FNUMEXPR_ fnumexpr(ModelEquation, getBlockEquationID(block, i));
-              fnumexpr.write(code_file, instruction_number);
-              eq_node = (BinaryOpNode *) getBlockEquationExpr(block, i);
-              lhs = eq_node->get_arg1();
-              rhs = eq_node->get_arg2();
-              lhs->compile(code_file, instruction_number, false, temporary_terms, map_idx, false, false);
-              rhs->compile(code_file, instruction_number, false, temporary_terms, map_idx, false, false);
-
-              FBINARY_ fbinary(oMinus);
-              fbinary.write(code_file, instruction_number);
-
-              FSTPR_ fstpr(i - block_recursive);
-              fstpr.write(code_file, instruction_number);
+              {
+                /* The residuals are compiled apart, so that the equations
+                   sharing the same code can be evaluated together */
+                ostringstream residual_code;
+                unsigned int residual_instruction_number = 0;
+                FNUMEXPR_ fnumexpr(ModelEquation, getBlockEquationID(block, i));
+                fnumexpr.write(residual_code, residual_instruction_number);
+                eq_node = (BinaryOpNode *) getBlockEquationExpr(block, i);
+                lhs = eq_node->get_arg1();
+                rhs = eq_node->get_arg2();
+                lhs->compile(residual_code, residual_instruction_number, false, temporary_terms, map_idx, false, false);
+                rhs->compile(residual_code, residual_instruction_number, false, temporary_terms, map_idx, false, false);
+
+                FBINARY_ fbinary(oMinus);
+                fbinary.write(residual_code, residual_instruction_number);
+                FSTPR_ fstpr(i - block_recursive);
+                fstpr.write(residual_code, residual_instruction_number);
+                patterns.add(getBlockEquationID(block, i), residual_code.str(), residual_instruction_number);
+              }
             }
         }
+      patterns.write(code_file, instruction_number);
       FENDEQU_ fendequ;
       fendequ.write(code_file, instruction_number);
 
@@ -908,21 +941,28 @@ StaticModel::writeModelEquationsCode_Block(const string file_name, const string
               goto end_l;
             default:
             end_l:
-              FNUMEXPR_ fnumexpr(ModelEquation, getBlockEquationID(block, i));
-              fnumexpr.write(code_file, instruction_number);
-              eq_node = (BinaryOpNode *) getBlockEquationExpr(block, i);
-              lhs = eq_node->get_arg1();
-              rhs = eq_node->get_arg2();
-              lhs->compile(code_file, instruction_number, false, tt2, map_idx2[block], false, false);
-              rhs->compile(code_file, instruction_number, false, tt2, map_idx2[block], false, false);
-
-              FBINARY_ fbinary(oMinus);
-              fbinary.write(code_file, instruction_number);
-
-              FSTPR_ fstpr(i - block_recursive);
-              fstpr.write(code_file, instruction_number);
+              {
+                /* The residuals are compiled apart, so that the equations
+                   sharing the same code can be evaluated together */
+                ostringstream residual_code;
+                unsigned int residual_instruction_number = 0;
+                FNUMEXPR_ fnumexpr(ModelEquation, getBlockEquationID(block, i));
+                fnumexpr.write(residual_code, residual_instruction_number);
+                eq_node = (BinaryOpNode *) getBlockEquationExpr(block, i);
+                lhs = eq_node->get_arg1();
+                rhs = eq_node->get_arg2();
+                lhs->compile(residual_code, residual_instruction_number, false, tt2, map_idx2[block], false, false);
+                rhs->compile(residual_code, residual_instruction_number, false, tt2, map_idx2[block], false, false);
+
+                FBINARY_ fbinary(oMinus);
+                fbinary.write(residual_code, residual_instruction_number);
+                FSTPR_ fstpr(i - block_recursive);
+                fstpr.write(residual_code, residual_instruction_number);
+                patterns.add(getBlockEquationID(block, i), residual_code.str(), residual_instruction_number);
+              }
             }
         }
+      patterns.write(code_file, instruction_number);
       FENDEQU_ fendequ_l;
       fendequ_l.write(code_file, instruction_number);
 
@@ -1081,18 +1121,24 @@ StaticModel::computingPass(const eval_context_t &eval_context, bool no_tmp_terms
        << " - order 1" << endl;
   first_derivatives.clear();
 
+  clock_t t0 = clock();
   computeJacobian(vars);
+  printDerivationTiming(t0);
 
   if (hessian)
     {
       cout << " - order 2" << endl;
+      t0 = clock();
       computeHessian(vars);
+      printDerivationTiming(t0);
     }
 
   if (thirdDerivatives)
     {
       cout << " - order 3" << endl;
+      t0 = clock();
       computeThirdDerivatives(vars);
+      printDerivationTiming(t0);
     }
 
   if (paramsDerivsOrder > 0)
@@ -1151,6 +1197,8 @@ StaticModel::computingPass(const eval_context_t &eval_context, bool no_tmp_terms
             computeTemporaryTermsMapping(temporary_terms, map_idx);
         }
     }
+
+  clearDerivationCaches();
 }
 
 void
@@ -1207,6 +1255,7 @@ StaticModel::writeStaticModel(ostream &StaticOutput, bool use_dll, bool julia) c
   ostringstream jacobian_output;           // Used for storing jacobian equations
   ostringstream hessian_output;            // Used for storing Hessian equations
   ostringstream third_derivatives_output;  // Used for storing third order derivatives equations
+  ostringstream sparse_jacobian_output;    // Used for storing the sparse jacobian equations (Julia only)
   ostringstream for_sym;
   ExprNodeOutputType output_type = (use_dll ? oCStaticModel :
                                     julia ? oJuliaStaticModel : oMatlabStaticModel);
@@ -1234,6 +1283,22 @@ StaticModel::writeStaticModel(ostream &StaticOutput, bool use_dll, bool julia) c
       writeTemporaryTerms(temp_term_union, temp_term_empty, jacobian_output, output_type, tef_terms);
     else
       writeTemporaryTerms(temp_term_union, temp_term_union_m_1, jacobian_output, output_type, tef_terms);
+
+  // Position of the Jacobian elements in the Julia sparse matrix, ordered by column
+  map<pair<int, int>, int> jacobian_csc_index;
+  if (julia)
+    {
+      sparse_jacobian_output << jacobian_output.str();
+      for (first_derivatives_t::const_iterator it = first_derivatives.begin();
+           it != first_derivatives.end(); it++)
+        jacobian_csc_index[make_pair(symbol_table.getTypeSpecificID(getSymbIDByDerivID(it->first.second)),
+                                     it->first.first)] = 0;
+      int nz = 0;
+      for (map<pair<int, int>, int>::iterator it = jacobian_csc_index.begin();
+           it != jacobian_csc_index.end(); it++)
+        it->second = ++nz;
+    }
+
   for (first_derivatives_t::const_iterator it = first_derivatives.begin();
        it != first_derivatives.end(); it++)
     {
@@ -1241,10 +1306,16 @@ StaticModel::writeStaticModel(ostream &StaticOutput, bool use_dll, bool julia) c
       int symb_id = getSymbIDByDerivID(it->first.second);
       expr_t d1 = it->second;
 
+      ostringstream d1_output;
+      d1->writeOutput(d1_output, output_type, temp_term_union, tef_terms);
+
       jacobianHelper(jacobian_output, eq, symbol_table.getTypeSpecificID(symb_id), output_type);
-      jacobian_output << "=";
-      d1->writeOutput(jacobian_output, output_type, temp_term_union, tef_terms);
-      jacobian_output << ";" << endl;
+      jacobian_output << "=" << d1_output.str() << ";" << endl;
+
+      if (julia)
+        sparse_jacobian_output << "  @inbounds g1.nzval["
+                               << jacobian_csc_index[make_pair(symbol_table.getTypeSpecificID(symb_id), eq)]
+                               << "] = " << d1_output.str() << endl;
     }
 
   int g2ncols = symbol_table.endo_nbr() * symbol_table.endo_nbr();
@@ -1484,6 +1555,37 @@ StaticModel::writeStaticModel(ostream &StaticOutput, bool use_dll, bool julia) c
                      << endl
                      << third_derivatives_output.str()
                      << endl;
+      StaticOutput << "}" << endl << endl;
+
+      if (c_batch)
+        {
+          StaticOutput << "/* Computes the residuals and the Jacobian at K points at once." << endl
+                       << "   Every element of y, x, params, residual and g1 is a vector of K" << endl
+                       << "   contiguous values, one for each point. g1 must be initialized to zero. */" << endl
+                       << "void Static_batch(int K, double *y, double *x, int nb_row_x, double *params, double *residual, double *g1)" << endl
+                       << "{" << endl
+                       << "  int k;" << endl
+                       << endl
+                       << "  if (g1 == NULL)" << endl
+                       << "    for (k = 0; k < K; k++)" << endl
+                       << "      {" << endl
+                       << "        double lhs, rhs;" << endl
+                       << endl
+                       << "        /* Residual equations */" << endl;
+          writeCBatchedCode(StaticOutput, model_local_vars_output.str() + model_output.str(), "        ");
+          StaticOutput << "      }" << endl
+                       << "  else" << endl
+                       << "    for (k = 0; k < K; k++)" << endl
+                       << "      {" << endl
+                       << "        double lhs, rhs;" << endl
+                       << endl
+                       << "        /* Residual equations */" << endl;
+          writeCBatchedCode(StaticOutput, model_local_vars_output.str() + model_output.str(), "        ");
+          StaticOutput << "        /* Jacobian  */" << endl;
+          writeCBatchedCode(StaticOutput, jacobian_output.str(), "        ");
+          StaticOutput << "      }" << endl
+                       << "}" << endl << endl;
+        }
     }
   else
     {
@@ -1538,6 +1640,27 @@ StaticModel::writeStaticModel(ostream &StaticOutput, bool use_dll, bool julia) c
                    << "  if ~isreal(g1)" << endl
                    << "    g1 = real(g1)+2*imag(g1);" << endl
                    << "  end" << endl
+                   << "end" << endl << endl;
+
+      writeJuliaJacobianPattern(StaticOutput, "static_jacobian_pattern", jacobian_csc_index,
+                                nrows, JacobianColsNbr);
+
+      StaticOutput << "function static!(y::Vector{Float64}, x::Vector{Float64}, "
+                   << "params::Vector{Float64}," << endl
+                   << "                 residual::Vector{Float64}, g1::SparseMatrixCSC{Float64, Int})" << endl
+                   << "#=" << endl
+                   << "Same as above, but the Jacobian is a sparse matrix created by static_jacobian_pattern()," << endl
+                   << "whose values are overwritten in place" << endl
+                   << "=#" << endl
+                   << "  @assert size(g1) == (" << equations.size() << ", " << symbol_table.endo_nbr()
+                   << ")" << endl
+                   << "  @assert length(g1.nzval) == " << jacobian_csc_index.size() << endl
+                   << "  static!(y, x, params, residual)" << endl
+                   << model_local_vars_output.str()
+                   << "  #" << endl
+                   << "  # Jacobian matrix" << endl
+                   << "  #" << endl
+                   << sparse_jacobian_output.str()
                    << "end" << endl << endl
                    << "function static!(y::Vector{Float64}, x::Vector{Float64}, "
                    << "params::Vector{Float64}," << endl
@@ -1627,7 +1750,6 @@ StaticModel::writeStaticCFile(const string &func_name) const
 
   // Writing the function body
   writeStaticModel(output, true, false);
-  output << "}" << endl << endl;
 
   writePowerDeriv(output);
   writeNormcdf(output);
@@ -1719,7 +1841,7 @@ StaticModel::writeStaticJuliaFile(const string &basename) const
          << "#     from " << basename << ".mod" << endl
          << "#" << endl
          << "using Utils" << endl << endl
-         << "export static!" << endl << endl;
+         << "export static!, static_jacobian_pattern" << endl << endl;
   writeStaticModel(output, false, true);
   output << "end" << endl;
 }
@@ -2422,12 +2544,6 @@ StaticModel::writeJsonOutput(ostream &output) const
 void
 StaticModel::writeJsonComputingPassOutput(ostream &output, bool writeDetails) const
 {
-  ostringstream model_local_vars_output;   // Used for storing model local vars
-  ostringstream model_output;              // Used for storing model
-  ostringstream jacobian_output;           // Used for storing jacobian equations
-  ostringstream hessian_output;            // Used for storing Hessian equations
-  ostringstream third_derivatives_output;  // Used for storing third order derivatives equations
-
   deriv_node_temp_terms_t tef_terms;
   temporary_terms_t temp_term_empty;
   temporary_terms_t temp_term_union = temporary_terms_res;
@@ -2435,11 +2551,16 @@ StaticModel::writeJsonComputingPassOutput(ostream &output, bool writeDetails) co
 
   string concat = "";
 
-  writeJsonModelLocalVariables(model_local_vars_output, tef_terms);
+  if (writeDetails)
+    output << "\"static_model_derivative_details\": {";
+  else
+    output << "\"static_model_derivatives\": {";
+  writeJsonModelLocalVariables(output, tef_terms);
 
-  writeJsonTemporaryTerms(temporary_terms_res, temp_term_union_m_1, model_output, tef_terms, concat);
-  model_output << ", ";
-  writeJsonModelEquations(model_output, true);
+  output << ", ";
+  writeJsonTemporaryTerms(temporary_terms_res, temp_term_union_m_1, output, tef_terms, concat);
+  output << ", ";
+  writeJsonModelEquations(output, true);
 
   int nrows = equations.size();
   int JacobianColsNbr = symbol_table.endo_nbr();
@@ -2449,16 +2570,17 @@ StaticModel::writeJsonComputingPassOutput(ostream &output, bool writeDetails) co
   temp_term_union_m_1 = temp_term_union;
   temp_term_union.insert(temporary_terms_g1.begin(), temporary_terms_g1.end());
   concat = "jacobian";
-  writeJsonTemporaryTerms(temp_term_union, temp_term_union_m_1, jacobian_output, tef_terms, concat);
-  jacobian_output << ", \"jacobian\": {"
-                  << "  \"nrows\": " << nrows
-                  << ", \"ncols\": " << JacobianColsNbr
-                  << ", \"entries\": [";
+  output << ", ";
+  writeJsonTemporaryTerms(temp_term_union, temp_term_union_m_1, output, tef_terms, concat);
+  output << ", \"jacobian\": {"
+         << "  \"nrows\": " << nrows
+         << ", \"ncols\": " << JacobianColsNbr
+         << ", \"entries\": [";
   for (first_derivatives_t::const_iterator it = first_derivatives.begin();
        it != first_derivatives.end(); it++)
     {
       if (it != first_derivatives.begin())
-        jacobian_output << ", ";
+        output << ", ";
 
       int eq = it->first.first;
       int var = it->first.second;
@@ -2467,32 +2589,33 @@ StaticModel::writeJsonComputingPassOutput(ostream &output, bool writeDetails) co
       expr_t d1 = it->second;
 
       if (writeDetails)
-        jacobian_output << "{\"eq\": " << eq + 1
-                        << ", \"var\": \"" << symbol_table.getName(symb_id) << "\"";
+        output << "{\"eq\": " << eq + 1
+               << ", \"var\": \"" << symbol_table.getName(symb_id) << "\"";
       else
-        jacobian_output << "{\"row\": " << eq + 1;
-      jacobian_output << ", \"col\": " << col + 1
-                      << ", \"val\": \"";
-      d1->writeJsonOutput(jacobian_output, temp_term_union, tef_terms);
-      jacobian_output << "\"}" << endl;
+        output << "{\"row\": " << eq + 1;
+      output << ", \"col\": " << col + 1
+             << ", \"val\": \"";
+      d1->writeJsonOutput(output, temp_term_union, tef_terms);
+      output << "\"}" << endl;
     }
-  jacobian_output << "]}";
+  output << "]}";
 
   int g2ncols = symbol_table.endo_nbr() * symbol_table.endo_nbr();
   // Write Hessian w.r. to endogenous only (only if 2nd order derivatives have been computed)
   temp_term_union_m_1 = temp_term_union;
   temp_term_union.insert(temporary_terms_g2.begin(), temporary_terms_g2.end());
   concat = "hessian";
-  writeJsonTemporaryTerms(temp_term_union, temp_term_union_m_1, hessian_output, tef_terms, concat);
-  hessian_output << ", \"hessian\": {"
-                 << "  \"nrows\": " << equations.size()
-                 << ", \"ncols\": " << g2ncols
-                 << ", \"entries\": [";
+  output << ", ";
+  writeJsonTemporaryTerms(temp_term_union, temp_term_union_m_1, output, tef_terms, concat);
+  output << ", \"hessian\": {"
+         << "  \"nrows\": " << equations.size()
+         << ", \"ncols\": " << g2ncols
+         << ", \"entries\": [";
   for (second_derivatives_t::const_iterator it = second_derivatives.begin();
        it != second_derivatives.end(); it++)
     {
       if (it != second_derivatives.begin())
-        hessian_output << ", ";
+        output << ", ";
 
       int eq = it->first.first;
       int symb_id1 = getSymbIDByDerivID(it->first.second.first);
@@ -2506,36 +2629,37 @@ StaticModel::writeJsonComputingPassOutput(ostream &output, bool writeDetails) co
       int col_sym = tsid2*symbol_table.endo_nbr()+tsid1;
 
       if (writeDetails)
-        hessian_output << "{\"eq\": " << eq + 1
-                       << ", \"var1\": \"" << symbol_table.getName(symb_id1) << "\""
-                       << ", \"var2\": \"" << symbol_table.getName(symb_id2) << "\"";
+        output << "{\"eq\": " << eq + 1
+               << ", \"var1\": \"" << symbol_table.getName(symb_id1) << "\""
+               << ", \"var2\": \"" << symbol_table.getName(symb_id2) << "\"";
       else
-        hessian_output << "{\"row\": " << eq + 1;
+        output << "{\"row\": " << eq + 1;
 
-      hessian_output << ", \"col\": [" << col + 1;
+      output << ", \"col\": [" << col + 1;
       if (symb_id1 != symb_id2)
-        hessian_output << ", " <<  col_sym + 1;
-      hessian_output << "]"
-                     << ", \"val\": \"";
-      d2->writeJsonOutput(hessian_output, temp_term_union, tef_terms);
-      hessian_output << "\"}" << endl;
+        output << ", " <<  col_sym + 1;
+      output << "]"
+             << ", \"val\": \"";
+      d2->writeJsonOutput(output, temp_term_union, tef_terms);
+      output << "\"}" << endl;
     }
-  hessian_output << "]}";
+  output << "]}";
 
   // Writing third derivatives
   temp_term_union_m_1 = temp_term_union;
   temp_term_union.insert(temporary_terms_g3.begin(), temporary_terms_g3.end());
   concat = "third_derivatives";
-  writeJsonTemporaryTerms(temp_term_union, temp_term_union_m_1, third_derivatives_output, tef_terms, concat);
-  third_derivatives_output << ", \"third_derivative\": {"
-                           << "  \"nrows\": " << equations.size()
-                           << ", \"ncols\": " << hessianColsNbr * JacobianColsNbr
-                           << ", \"entries\": [";
+  output << ", ";
+  writeJsonTemporaryTerms(temp_term_union, temp_term_union_m_1, output, tef_terms, concat);
+  output << ", \"third_derivative\": {"
+         << "  \"nrows\": " << equations.size()
+         << ", \"ncols\": " << hessianColsNbr * JacobianColsNbr
+         << ", \"entries\": [";
   for (third_derivatives_t::const_iterator it = third_derivatives.begin();
        it != third_derivatives.end(); it++)
     {
       if (it != third_derivatives.begin())
-        third_derivatives_output << ", ";
+        output << ", ";
 
       int eq = it->first.first;
       int var1 = it->first.second.first;
@@ -2544,12 +2668,12 @@ StaticModel::writeJsonComputingPassOutput(ostream &output, bool writeDetails) co
       expr_t d3 = it->second;
 
       if (writeDetails)
-        third_derivatives_output << "{\"eq\": " << eq + 1
-                                 << ", \"var1\": \"" << symbol_table.getName(getSymbIDByDerivID(var1)) << "\""
-                                 << ", \"var2\": \"" << symbol_table.getName(getSymbIDByDerivID(var2)) << "\""
-                                 << ", \"var3\": \"" << symbol_table.getName(getSymbIDByDerivID(var3)) << "\"";
+        output << "{\"eq\": " << eq + 1
+               << ", \"var1\": \"" << symbol_table.getName(getSymbIDByDerivID(var1)) << "\""
+               << ", \"var2\": \"" << symbol_table.getName(getSymbIDByDerivID(var2)) << "\""
+               << ", \"var3\": \"" << symbol_table.getName(getSymbIDByDerivID(var3)) << "\"";
       else
-        third_derivatives_output << "{\"row\": " << eq + 1;
+        output << "{\"row\": " << eq + 1;
 
       int id1 = getSymbIDByDerivID(var1);
       int id2 = getSymbIDByDerivID(var2);
@@ -2562,30 +2686,21 @@ StaticModel::writeJsonComputingPassOutput(ostream &output, bool writeDetails) co
       cols.insert(id3 * hessianColsNbr + id1 * JacobianColsNbr + id2);
       cols.insert(id3 * hessianColsNbr + id2 * JacobianColsNbr + id1);
 
-      third_derivatives_output << ", \"col\": [";
+      output << ", \"col\": [";
       for (set<int>::iterator it2 = cols.begin(); it2 != cols.end(); it2++)
         {
           if (it2 != cols.begin())
-            third_derivatives_output << ", ";
-          third_derivatives_output << *it2 + 1;
+            output << ", ";
+          output << *it2 + 1;
         }
-      third_derivatives_output << "]"
-                               << ", \"val\": \"";
-      d3->writeJsonOutput(third_derivatives_output, temp_term_union, tef_terms);
-      third_derivatives_output << "\"}" << endl;
+      output << "]"
+             << ", \"val\": \"";
+      d3->writeJsonOutput(output, temp_term_union, tef_terms);
+      output << "\"}" << endl;
     }
-  third_derivatives_output << "]}";
+  output << "]}";
 
-  if (writeDetails)
-    output << "\"static_model_derivative_details\": {";
-  else
-    output << "\"static_model_derivatives\": {";
-  output << model_local_vars_output.str()
-         << ", " << model_output.str()
-         << ", " << jacobian_output.str()
-         << ", " << hessian_output.str()
-         << ", " << third_derivatives_output.str()
-         << "}";
+  output << "}";
 }
 
 void
@@ -2598,29 +2713,26 @@ StaticModel::writeJsonParamsDerivativesFile(ostream &output, bool writeDetails)
       && !hessian_params_derivatives.size())
     return;
 
-  ostringstream model_local_vars_output;   // Used for storing model local vars
-  ostringstream model_output;              // Used for storing model temp vars and equations
-  ostringstream jacobian_output;           // Used for storing jacobian equations
-  ostringstream hessian_output;            // Used for storing Hessian equations
-  ostringstream hessian1_output;           // Used for storing Hessian equations
-  ostringstream third_derivs_output;       // Used for storing third order derivatives equations
-  ostringstream third_derivs1_output;      // Used for storing third order derivatives equations
-
   deriv_node_temp_terms_t tef_terms;
-  writeJsonModelLocalVariables(model_local_vars_output, tef_terms);
+  if (writeDetails)
+    output << "\"static_model_params_derivative_details\": {";
+  else
+    output << "\"static_model_params_derivatives\": {";
+  writeJsonModelLocalVariables(output, tef_terms);
 
   temporary_terms_t temp_terms_empty;
   string concat = "all";
-  writeJsonTemporaryTerms(params_derivs_temporary_terms, temp_terms_empty, model_output, tef_terms, concat);
-  jacobian_output << "\"deriv_wrt_params\": {"
-                  << "  \"neqs\": " << equations.size()
-                  << ", \"nparamcols\": " << symbol_table.param_nbr()
-                  << ", \"entries\": [";
+  output << ", ";
+  writeJsonTemporaryTerms(params_derivs_temporary_terms, temp_terms_empty, output, tef_terms, concat);
+  output << ", \"deriv_wrt_params\": {"
+         << "  \"neqs\": " << equations.size()
+         << ", \"nparamcols\": " << symbol_table.param_nbr()
+         << ", \"entries\": [";
   for (first_derivatives_t::const_iterator it = residuals_params_derivatives.begin();
        it != residuals_params_derivatives.end(); it++)
     {
       if (it != residuals_params_derivatives.begin())
-        jacobian_output << ", ";
+        output << ", ";
 
       int eq = it->first.first;
       int param = it->first.second;
@@ -2629,26 +2741,26 @@ StaticModel::writeJsonParamsDerivativesFile(ostream &output, bool writeDetails)
       int param_col = symbol_table.getTypeSpecificID(getSymbIDByDerivID(param)) + 1;
 
       if (writeDetails)
-        jacobian_output << "{\"eq\": " << eq + 1
-                        << ", \"param\": \"" << symbol_table.getName(getSymbIDByDerivID(param)) << "\"";
+        output << "{\"eq\": " << eq + 1
+               << ", \"param\": \"" << symbol_table.getName(getSymbIDByDerivID(param)) << "\"";
       else
-        jacobian_output << "{\"row\": " << eq + 1;
-      jacobian_output << ", \"param_col\": " << param_col
-                      << ", \"val\": \"";
-      d1->writeJsonOutput(jacobian_output, params_derivs_temporary_terms, tef_terms);
-      jacobian_output << "\"}" << endl;
-    }
-  jacobian_output << "]}";
-  hessian_output << "\"deriv_jacobian_wrt_params\": {"
-                 << "  \"neqs\": " << equations.size()
-                 << ", \"nvarcols\": " << symbol_table.endo_nbr()
-                 << ", \"nparamcols\": " << symbol_table.param_nbr()
-                 << ", \"entries\": [";
+        output << "{\"row\": " << eq + 1;
+      output << ", \"param_col\": " << param_col
+             << ", \"val\": \"";
+      d1->writeJsonOutput(output, params_derivs_temporary_terms, tef_terms);
+      output << "\"}" << endl;
+    }
+  output << "]}";
+  output << ", \"deriv_jacobian_wrt_params\": {"
+         << "  \"neqs\": " << equations.size()
+         << ", \"nvarcols\": " << symbol_table.endo_nbr()
+         << ", \"nparamcols\": " << symbol_table.param_nbr()
+         << ", \"entries\": [";
   for (second_derivatives_t::const_iterator it = jacobian_params_derivatives.begin();
        it != jacobian_params_derivatives.end(); it++)
     {
       if (it != jacobian_params_derivatives.begin())
-        hessian_output << ", ";
+        output << ", ";
 
       int eq = it->first.first;
       int var = it->first.second.first;
@@ -2659,29 +2771,29 @@ StaticModel::writeJsonParamsDerivativesFile(ostream &output, bool writeDetails)
       int param_col = symbol_table.getTypeSpecificID(getSymbIDByDerivID(param)) + 1;
 
       if (writeDetails)
-        hessian_output << "{\"eq\": " << eq + 1
-                       << ", \"var\": \"" << symbol_table.getName(getSymbIDByDerivID(var)) << "\""
-                       << ", \"param\": \"" << symbol_table.getName(getSymbIDByDerivID(param)) << "\"";
+        output << "{\"eq\": " << eq + 1
+               << ", \"var\": \"" << symbol_table.getName(getSymbIDByDerivID(var)) << "\""
+               << ", \"param\": \"" << symbol_table.getName(getSymbIDByDerivID(param)) << "\"";
       else
-        hessian_output << "{\"row\": " << eq + 1;
-      hessian_output << ", \"var_col\": " << var_col
-                     << ", \"param_col\": " << param_col
-                     << ", \"val\": \"";
-      d2->writeJsonOutput(hessian_output, params_derivs_temporary_terms, tef_terms);
-      hessian_output << "\"}" << endl;
-    }
-  hessian_output << "]}";
-
-  hessian1_output << "\"second_deriv_residuals_wrt_params\": {"
-                  << "  \"nrows\": " << equations.size()
-                  << ", \"nparam1cols\": " << symbol_table.param_nbr()
-                  << ", \"nparam2cols\": " << symbol_table.param_nbr()
-                  << ", \"entries\": [";
+        output << "{\"row\": " << eq + 1;
+      output << ", \"var_col\": " << var_col
+             << ", \"param_col\": " << param_col
+             << ", \"val\": \"";
+      d2->writeJsonOutput(output, params_derivs_temporary_terms, tef_terms);
+      output << "\"}" << endl;
+    }
+  output << "]}";
+
+  output << ", \"second_deriv_residuals_wrt_params\": {"
+         << "  \"nrows\": " << equations.size()
+         << ", \"nparam1cols\": " << symbol_table.param_nbr()
+         << ", \"nparam2cols\": " << symbol_table.param_nbr()
+         << ", \"entries\": [";
   for (second_derivatives_t::const_iterator it = residuals_params_second_derivatives.begin();
        it != residuals_params_second_derivatives.end(); ++it)
     {
       if (it != residuals_params_second_derivatives.begin())
-        hessian1_output << ", ";
+        output << ", ";
 
       int eq = it->first.first;
       int param1 = it->first.second.first;
@@ -2692,29 +2804,29 @@ StaticModel::writeJsonParamsDerivativesFile(ostream &output, bool writeDetails)
       int param2_col = symbol_table.getTypeSpecificID(getSymbIDByDerivID(param2)) + 1;
 
       if (writeDetails)
-        hessian1_output << "{\"eq\": " << eq + 1
-                        << ", \"param1\": \"" << symbol_table.getName(getSymbIDByDerivID(param1)) << "\""
-                        << ", \"param2\": \"" << symbol_table.getName(getSymbIDByDerivID(param2)) << "\"";
+        output << "{\"eq\": " << eq + 1
+               << ", \"param1\": \"" << symbol_table.getName(getSymbIDByDerivID(param1)) << "\""
+               << ", \"param2\": \"" << symbol_table.getName(getSymbIDByDerivID(param2)) << "\"";
       else
-        hessian1_output << "{\"row\": " << eq + 1;
-      hessian1_output << ", \"param1_col\": " << param1_col
-                      << ", \"param2_col\": " << param2_col
-                      << ", \"val\": \"";
-      d2->writeJsonOutput(hessian1_output, params_derivs_temporary_terms, tef_terms);
-      hessian1_output << "\"}" << endl;
-    }
-  hessian1_output << "]}";
-  third_derivs_output << "\"second_deriv_jacobian_wrt_params\": {"
-                      << "  \"neqs\": " << equations.size()
-                      << ", \"nvarcols\": " << symbol_table.endo_nbr()
-                      << ", \"nparam1cols\": " << symbol_table.param_nbr()
-                      << ", \"nparam2cols\": " << symbol_table.param_nbr()
-                      << ", \"entries\": [";
+        output << "{\"row\": " << eq + 1;
+      output << ", \"param1_col\": " << param1_col
+             << ", \"param2_col\": " << param2_col
+             << ", \"val\": \"";
+      d2->writeJsonOutput(output, params_derivs_temporary_terms, tef_terms);
+      output << "\"}" << endl;
+    }
+  output << "]}";
+  output << ", \"second_deriv_jacobian_wrt_params\": {"
+         << "  \"neqs\": " << equations.size()
+         << ", \"nvarcols\": " << symbol_table.endo_nbr()
+         << ", \"nparam1cols\": " << symbol_table.param_nbr()
+         << ", \"nparam2cols\": " << symbol_table.param_nbr()
+         << ", \"entries\": [";
   for (third_derivatives_t::const_iterator it = jacobian_params_second_derivatives.begin();
        it != jacobian_params_second_derivatives.end(); ++it)
     {
       if (it != jacobian_params_second_derivatives.begin())
-        third_derivs_output << ", ";
+        output << ", ";
 
       int eq = it->first.first;
       int var = it->first.second.first;
@@ -2727,32 +2839,32 @@ StaticModel::writeJsonParamsDerivativesFile(ostream &output, bool writeDetails)
       int param2_col = symbol_table.getTypeSpecificID(getSymbIDByDerivID(param2)) + 1;
 
       if (writeDetails)
-        third_derivs_output << "{\"eq\": " << eq + 1
-                            << ", \"var\": \"" << symbol_table.getName(var) << "\""
-                            << ", \"param1\": \"" << symbol_table.getName(getSymbIDByDerivID(param1)) << "\""
-                            << ", \"param2\": \"" << symbol_table.getName(getSymbIDByDerivID(param2)) << "\"";
+        output << "{\"eq\": " << eq + 1
+               << ", \"var\": \"" << symbol_table.getName(var) << "\""
+               << ", \"param1\": \"" << symbol_table.getName(getSymbIDByDerivID(param1)) << "\""
+               << ", \"param2\": \"" << symbol_table.getName(getSymbIDByDerivID(param2)) << "\"";
       else
-        third_derivs_output << "{\"row\": " << eq + 1;
-      third_derivs_output << ", \"var_col\": " << var_col
-                          << ", \"param1_col\": " << param1_col
-                          << ", \"param2_col\": " << param2_col
-                          << ", \"val\": \"";
-      d2->writeJsonOutput(third_derivs_output, params_derivs_temporary_terms, tef_terms);
-      third_derivs_output << "\"}" << endl;
-    }
-  third_derivs_output << "]}" << endl;
-
-  third_derivs1_output << "\"derivative_hessian_wrt_params\": {"
-                       << "  \"neqs\": " << equations.size()
-                       << ", \"nvar1cols\": " << symbol_table.endo_nbr()
-                       << ", \"nvar2cols\": " << symbol_table.endo_nbr()
-                       << ", \"nparamcols\": " << symbol_table.param_nbr()
-                       << ", \"entries\": [";
+        output << "{\"row\": " << eq + 1;
+      output << ", \"var_col\": " << var_col
+             << ", \"param1_col\": " << param1_col
+             << ", \"param2_col\": " << param2_col
+             << ", \"val\": \"";
+      d2->writeJsonOutput(output, params_derivs_temporary_terms, tef_terms);
+      output << "\"}" << endl;
+    }
+  output << "]}" << endl;
+
+  output << ", \"derivative_hessian_wrt_params\": {"
+         << "  \"neqs\": " << equations.size()
+         << ", \"nvar1cols\": " << symbol_table.endo_nbr()
+         << ", \"nvar2cols\": " << symbol_table.endo_nbr()
+         << ", \"nparamcols\": " << symbol_table.param_nbr()
+         << ", \"entries\": [";
   for (third_derivatives_t::const_iterator it = hessian_params_derivatives.begin();
        it != hessian_params_derivatives.end(); ++it)
     {
       if (it != hessian_params_derivatives.begin())
-        third_derivs1_output << ", ";
+        output << ", ";
 
       int eq = it->first.first;
       int var1 = it->first.second.first;
@@ -2765,31 +2877,20 @@ StaticModel::writeJsonParamsDerivativesFile(ostream &output, bool writeDetails)
       int param_col = symbol_table.getTypeSpecificID(getSymbIDByDerivID(param)) + 1;
 
       if (writeDetails)
-        third_derivs1_output << "{\"eq\": " << eq + 1
-                             << ", \"var1\": \"" << symbol_table.getName(getSymbIDByDerivID(var1)) << "\""
-                             << ", \"var2\": \"" << symbol_table.getName(getSymbIDByDerivID(var2)) << "\""
-                             << ", \"param1\": \"" << symbol_table.getName(getSymbIDByDerivID(param)) << "\"";
+        output << "{\"eq\": " << eq + 1
+               << ", \"var1\": \"" << symbol_table.getName(getSymbIDByDerivID(var1)) << "\""
+               << ", \"var2\": \"" << symbol_table.getName(getSymbIDByDerivID(var2)) << "\""
+               << ", \"param1\": \"" << symbol_table.getName(getSymbIDByDerivID(param)) << "\"";
       else
-        third_derivs1_output << "{\"row\": " << eq + 1;
-      third_derivs1_output << ", \"var1_col\": " << var1_col
-                           << ", \"var2_col\": " << var2_col
-                           << ", \"param_col\": " << param_col
-                           << ", \"val\": \"";
-      d2->writeJsonOutput(third_derivs1_output, params_derivs_temporary_terms, tef_terms);
-      third_derivs1_output << "\"}" << endl;
+        output << "{\"row\": " << eq + 1;
+      output << ", \"var1_col\": " << var1_col
+             << ", \"var2_col\": " << var2_col
+             << ", \"param_col\": " << param_col
+             << ", \"val\": \"";
+      d2->writeJsonOutput(output, params_derivs_temporary_terms, tef_terms);
+      output << "\"}" << endl;
     }
-  third_derivs1_output << "]}" << endl;
+  output << "]}" << endl;
 
-  if (writeDetails)
-    output << "\"static_model_params_derivative_details\": {";
-  else
-    output << "\"static_model_params_derivatives\": {";
-  output << model_local_vars_output.str()
-         << ", " << model_output.str()
-         << ", " << jacobian_output.str()
-         << ", " << hessian_output.str()
-         << ", " << hessian1_output.str()
-         << ", " << third_derivs_output.str()
-         << ", " << third_derivs1_output.str()
-         << "}";
+  output << "}";
 }
@@ -78,6 +78,13 @@ private:
 
   //! sorts the temporary terms in the blocks order
   void computeTemporaryTermsOrdered();
+  //! Computes the temporary terms local to a block, i.e. ignoring the other blocks
+  void computeBlockLocalTemporaryTerms(unsigned int block, BlockReferenceCount &reference_count);
+  //! Collects the temporary terms used by a block
+  void collectBlockTemporaryTerms(unsigned int block);
+  //! Thread functions for runBlockThreads
+  static void *computeLocalTemporaryTermsThread(void *arg);
+  static void *collectTemporaryTermsThread(void *arg);
   //! creates a mapping from the index of temporary terms to a natural index
   void computeTemporaryTermsMapping(temporary_terms_t &temporary_terms, map_idx_t &map_idx);
 
@@ -790,11 +790,16 @@ SymbolTable::getObservedVariableIndex(int symb_id) const
 vector <int>
 SymbolTable::getTrendVarIds() const
 {
+  // Trend variables are returned in the alphabetical order of their names
+  map<string, int> sortedTrendVars;
+  for (int id = 0; id < size; id++)
+    if (getType(id) == eTrend || getType(id) == eLogTrend)
+      sortedTrendVars[name_table[id]] = id;
+
   vector <int> trendVars;
-  for (symbol_table_type::const_iterator it = symbol_table.begin();
-       it != symbol_table.end(); it++)
-    if (getType(it->second) == eTrend || getType(it->second) == eLogTrend)
-      trendVars.push_back(it->second);
+  for (map<string, int>::const_iterator it = sortedTrendVars.begin();
+       it != sortedTrendVars.end(); it++)
+    trendVars.push_back(it->second);
   return trendVars;
 }
 
@@ -802,10 +807,9 @@ set<int>
 SymbolTable::getExogenous() const
 {
   set <int> exogs;
-  for (symbol_table_type::const_iterator it = symbol_table.begin();
-       it != symbol_table.end(); it++)
-    if (getType(it->second) == eExogenous)
-      exogs.insert(it->second);
+  for (int id = 0; id < size; id++)
+    if (getType(id) == eExogenous)
+      exogs.insert(id);
   return exogs;
 }
 
@@ -813,10 +817,9 @@ set<int>
 SymbolTable::getEndogenous() const
 {
   set <int> endogs;
-  for (symbol_table_type::const_iterator it = symbol_table.begin();
-       it != symbol_table.end(); it++)
-    if (getType(it->second) == eEndogenous)
-      endogs.insert(it->second);
+  for (int id = 0; id < size; id++)
+    if (getType(id) == eEndogenous)
+      endogs.insert(id);
   return endogs;
 }
 
@@ -842,10 +845,9 @@ set<int>
 SymbolTable::getOrigEndogenous() const
 {
   set <int> origendogs;
-  for (symbol_table_type::const_iterator it = symbol_table.begin();
-       it != symbol_table.end(); it++)
-    if (getType(it->second) == eEndogenous && !isAuxiliaryVariable(it->second))
-      origendogs.insert(it->second);
+  for (int id = 0; id < size; id++)
+    if (getType(id) == eEndogenous && !isAuxiliaryVariable(id))
+      origendogs.insert(id);
   return origendogs;
 }
 
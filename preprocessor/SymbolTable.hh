@@ -28,6 +28,8 @@ using namespace std;
 #include <set>
 #include <ostream>
 
+#include <boost/unordered_map.hpp>
+
 #include "CodeInterpreter.hh"
 #include "ExprNode.hh"
 
@@ -114,8 +116,10 @@ private:
   //! Number of symbols contained in the table
   int size;
 
-  typedef map<string, int> symbol_table_type;
+  typedef boost::unordered_map<string, int> symbol_table_type;
   //! Maps strings to symbol IDs
+  /*! A hash table, since it is queried each time a name is looked up; iterate over
+    name_table to enumerate the symbols in a reproducible order */
   symbol_table_type symbol_table;
 
   //! Maps IDs to names
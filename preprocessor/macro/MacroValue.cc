@@ -295,9 +295,7 @@ IntMV::append(const MacroValue *array) const throw (TypeError)
   if (array2 == NULL)
     throw TypeError("Type mismatch for append operation");
 
-  vector<int> v(array2->values);
-  v.push_back(value);
-  return new ArrayMV<int>(driver, v);
+  return new ArrayMV<int>(driver, array2->values.append(value));
 }
 
 const MacroValue *
@@ -308,7 +306,7 @@ IntMV::in(const MacroValue *array) const throw (TypeError)
     throw TypeError("Type mismatch for 'in' operator");
 
   int result = 0;
-  for (vector<int>::const_iterator it = array2->values.begin();
+  for (SharedArray<int>::const_iterator it = array2->values.begin();
        it != array2->values.end(); it++)
     if (*it == value)
       {
@@ -381,7 +379,7 @@ StringMV::operator[](const MacroValue &mv) const throw (TypeError, OutOfBoundsEr
   if (mv2 == NULL)
     throw TypeError("Expression inside [] must be an integer array");
   string result;
-  for (vector<int>::const_iterator it = mv2->values.begin();
+  for (SharedArray<int>::const_iterator it = mv2->values.begin();
        it != mv2->values.end(); it++)
     {
       if (*it < 1 || *it > (int) value.length())
@@ -413,9 +411,7 @@ StringMV::append(const MacroValue *array) const throw (TypeError)
   if (array2 == NULL)
     throw TypeError("Type mismatch for append operation");
 
-  vector<string> v(array2->values);
-  v.push_back(value);
-  return new ArrayMV<string>(driver, v);
+  return new ArrayMV<string>(driver, array2->values.append(value));
 }
 
 const MacroValue *
@@ -426,7 +422,7 @@ StringMV::in(const MacroValue *array) const throw (TypeError)
     throw TypeError("Type mismatch for 'in' operator");
 
   int result = 0;
-  for (vector<string>::const_iterator it = array2->values.begin();
+  for (SharedArray<string>::const_iterator it = array2->values.begin();
        it != array2->values.end(); it++)
     if (*it == value)
       {
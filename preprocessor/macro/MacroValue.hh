@@ -23,6 +23,9 @@
 #include <string>
 #include <vector>
 #include <sstream>
+#include <algorithm>
+
+#include <boost/shared_ptr.hpp>
 
 using namespace std;
 
@@ -196,6 +199,120 @@ public:
   virtual const MacroValue *in(const MacroValue *array) const throw (TypeError);
 };
 
+//! Immutable view on a slice of a vector shared by several macro arrays
+/*! Copying a view, or taking a contiguous slice of it, does not copy the elements.
+  Appending to a view which ends at the end of the underlying vector extends that vector
+  in place, since no other view can see the elements beyond its own end; otherwise the
+  elements of the view are first copied to a new vector. As a consequence, building an
+  array element by element in a loop takes linear (and not quadratic) time and memory. */
+template<typename T>
+class SharedArray
+{
+private:
+  //! Underlying vector, shared between views
+  boost::shared_ptr<vector<T> > storage;
+  //! Position of the first element of the view in the underlying vector
+  size_t offset;
+  //! Number of elements in the view
+  size_t len;
+  SharedArray(const boost::shared_ptr<vector<T> > &storage_arg, size_t offset_arg, size_t len_arg) :
+    storage(storage_arg), offset(offset_arg), len(len_arg)
+  {
+  };
+  //! Returns a view on which elements can be appended in place
+  SharedArray<T> extensible() const;
+public:
+  typedef typename vector<T>::const_iterator const_iterator;
+  SharedArray() : storage(new vector<T>()), offset(0), len(0)
+  {
+  };
+  SharedArray(const vector<T> &values_arg) : storage(new vector<T>(values_arg)), offset(0), len(values_arg.size())
+  {
+  };
+  inline const_iterator
+  begin() const
+  {
+    return storage->begin() + offset;
+  };
+  inline const_iterator
+  end() const
+  {
+    return storage->begin() + offset + len;
+  };
+  inline size_t
+  size() const
+  {
+    return len;
+  };
+  inline const T &
+  operator[](size_t i) const
+  {
+    return (*storage)[offset + i];
+  };
+  inline bool
+  operator==(const SharedArray<T> &other) const
+  {
+    return len == other.len && equal(begin(), end(), other.begin());
+  };
+  inline bool
+  operator!=(const SharedArray<T> &other) const
+  {
+    return !(*this == other);
+  };
+  //! Returns the view on the n elements starting at position first
+  SharedArray<T> slice(size_t first, size_t n) const;
+  //! Returns the view with the given element added at the end
+  SharedArray<T> append(const T &value) const;
+  //! Returns the view with the elements of the argument added at the end
+  SharedArray<T> concat(const SharedArray<T> &other) const;
+};
+
+template<typename T>
+SharedArray<T>
+SharedArray<T>::extensible() const
+{
+  if (offset + len == storage->size())
+    return *this;
+  boost::shared_ptr<vector<T> > new_storage(new vector<T>(begin(), end()));
+  return SharedArray<T>(new_storage, 0, len);
+}
+
+template<typename T>
+SharedArray<T>
+SharedArray<T>::slice(size_t first, size_t n) const
+{
+  return SharedArray<T>(storage, offset + first, n);
+}
+
+template<typename T>
+SharedArray<T>
+SharedArray<T>::append(const T &value) const
+{
+  SharedArray<T> result = extensible();
+  // The value may be an element of the underlying vector, which push_back() may reallocate
+  T value_copy(value);
+  result.storage->push_back(value_copy);
+  result.len++;
+  return result;
+}
+
+template<typename T>
+SharedArray<T>
+SharedArray<T>::concat(const SharedArray<T> &other) const
+{
+  SharedArray<T> result = extensible();
+  if (other.storage == result.storage)
+    {
+      // Inserting a range of a vector into itself is not allowed
+      vector<T> other_copy(other.begin(), other.end());
+      result.storage->insert(result.storage->end(), other_copy.begin(), other_copy.end());
+    }
+  else
+    result.storage->insert(result.storage->end(), other.begin(), other.end());
+  result.len += other.len;
+  return result;
+}
+
 //! Represents an array in macro language
 template<typename T>
 class ArrayMV : public MacroValue
@@ -205,10 +322,11 @@ class ArrayMV : public MacroValue
   friend class ArrayMV<string>; // Necessary for operator[] to access values of integer array when subscripting a string array
   friend class MacroDriver;
 private:
-  //! Underlying vector
-  const vector<T> values;
+  //! Underlying elements
+  const SharedArray<T> values;
 public:
   ArrayMV(MacroDriver &driver, const vector<T> &values_arg);
+  ArrayMV(MacroDriver &driver, const SharedArray<T> &values_arg);
   virtual
   ~ArrayMV();
   //! Computes array concatenation
@@ -237,6 +355,11 @@ ArrayMV<T>::ArrayMV(MacroDriver &driver, const vector<T> &values_arg) : MacroVal
 {
 }
 
+template<typename T>
+ArrayMV<T>::ArrayMV(MacroDriver &driver, const SharedArray<T> &values_arg) : MacroValue(driver), values(values_arg)
+{
+}
+
 template<typename T>
 ArrayMV<T>::~ArrayMV()
 {
@@ -250,9 +373,7 @@ ArrayMV<T>::operator+(const MacroValue &mv) const throw (TypeError)
   if (mv2 == NULL)
     throw TypeError("Type mismatch for operands of + operator");
 
-  vector<T> values_copy(values);
-  values_copy.insert(values_copy.end(), mv2->values.begin(), mv2->values.end());
-  return new ArrayMV<T>(driver, values_copy);
+  return new ArrayMV<T>(driver, values.concat(mv2->values));
 }
 
 template<typename T>
@@ -266,10 +387,10 @@ ArrayMV<T>::operator-(const MacroValue &mv) const throw (TypeError)
   /* Highly inefficient algorithm for computing set difference
      (but vector<T> is not suited for that...) */
   vector<T> new_values;
-  for (typename vector<T>::const_iterator it = values.begin();
+  for (typename SharedArray<T>::const_iterator it = values.begin();
        it != values.end(); it++)
     {
-      typename vector<T>::const_iterator it2;
+      typename SharedArray<T>::const_iterator it2;
       for (it2 = mv2->values.begin(); it2 != mv2->values.end(); it2++)
         if (*it == *it2)
           break;
@@ -309,19 +430,28 @@ ArrayMV<T>::operator[](const MacroValue &mv) const throw (TypeError, OutOfBounds
   const ArrayMV<int> *mv2 = dynamic_cast<const ArrayMV<int> *>(&mv);
   if (mv2 == NULL)
     throw TypeError("Expression inside [] must be an integer array");
-  vector<T> result;
-  for (vector<int>::const_iterator it = mv2->values.begin();
-       it != mv2->values.end(); it++)
+  // Contiguous increasing indices (as in a[2:5]) give a slice sharing the elements of the array
+  bool contiguous = true;
+  for (size_t i = 0; i < mv2->values.size(); i++)
     {
-      if (*it < 1 || *it > (int) values.size())
+      if (mv2->values[i] < 1 || mv2->values[i] > (int) values.size())
         throw OutOfBoundsError();
-      result.push_back(values[*it - 1]);
+      if (mv2->values[i] != mv2->values[0] + (int) i)
+        contiguous = false;
     }
 
-  if (result.size() > 1 || result.size() == 0)
-    return new ArrayMV<T>(driver, result);
-  else
-    return MacroValue::new_base_value(driver, result[0]);
+  if (mv2->values.size() == 1)
+    return MacroValue::new_base_value(driver, values[mv2->values[0] - 1]);
+  else if (mv2->values.size() == 0)
+    return new ArrayMV<T>(driver, SharedArray<T>());
+  else if (contiguous)
+    return new ArrayMV<T>(driver, values.slice(mv2->values[0] - 1, mv2->values.size()));
+
+  vector<T> result;
+  for (SharedArray<int>::const_iterator it = mv2->values.begin();
+       it != mv2->values.end(); it++)
+    result.push_back(values[*it - 1]);
+  return new ArrayMV<T>(driver, result);
 }
 
 template<typename T>
@@ -329,7 +459,7 @@ string
 ArrayMV<T>::toString() const
 {
   ostringstream ss;
-  for (typename vector<T>::const_iterator it = values.begin();
+  for (typename SharedArray<T>::const_iterator it = values.begin();
        it != values.end(); it++)
     ss << *it;
   return ss.str();
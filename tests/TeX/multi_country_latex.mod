@@ -0,0 +1,86 @@
+/*
+ * Benchmark of the LaTeX and JSON writers of the preprocessor on a large
+ * macro-expanded model: a multi-country model with @{countries} countries
+ * sharing a world output, with tagged equations.
+ *
+ * The writers are timed in the "writing" phase reported by the profile
+ * option of the preprocessor, e.g. with
+ *   dynare multi_country_latex profile json=transform
+ * (the number of countries can be changed with -Dcountries=...).
+ */
+
+/*
+ * Copyright (C) 2017 Dynare Team
+ *
+ * This file is part of Dynare.
+ *
+ * Dynare is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Dynare is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+@#ifndef countries
+@#define countries = 200
+@#endif
+
+var y_world ${y^w}$ (long_name='World output')
+@#for i in 1:countries
+    y_@{i} ${y_{@{i}}}$ (long_name='Output of country @{i}')
+    c_@{i} ${c_{@{i}}}$ (long_name='Consumption of country @{i}')
+    k_@{i} ${k_{@{i}}}$ (long_name='Capital of country @{i}')
+    a_@{i} ${a_{@{i}}}$ (long_name='Technology of country @{i}')
+@#endfor
+    ;
+
+varexo
+@#for i in 1:countries
+    e_@{i} ${\varepsilon_{@{i}}}$
+@#endfor
+    ;
+
+parameters alpha ${\alpha}$ delta ${\delta}$ rho ${\rho}$ theta ${\theta}$;
+alpha = 0.36;
+delta = 0.025;
+rho = 0.95;
+theta = 0.1;
+
+model;
+@#for i in 1:countries
+[name = 'Production @{i}']
+y_@{i} = a_@{i} + alpha*k_@{i}(-1) + theta*(y_world - y_@{i}(-1));
+[name = 'Consumption @{i}']
+c_@{i} = (1-alpha)*y_@{i} + 0.5*(c_@{i}(-1) - (1-alpha)*y_@{i}(-1));
+[name = 'Capital accumulation @{i}', country = '@{i}']
+k_@{i} = (1-delta)*k_@{i}(-1) + delta*(y_@{i} - c_@{i});
+[name = 'Technology @{i}']
+a_@{i} = rho*a_@{i}(-1) + e_@{i};
+@#endfor
+[name = 'World output']
+y_world = (0
+@#for i in 1:countries
+           + y_@{i}
+@#endfor
+          )/@{countries};
+end;
+
+shocks;
+@#for i in 1:countries
+var e_@{i}; stderr 0.01;
+@#endfor
+end;
+
+steady;
+check;
+
+write_latex_original_model;
+write_latex_static_model;
+write_latex_dynamic_model(write_equation_tags);
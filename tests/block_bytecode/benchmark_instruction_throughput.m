@@ -0,0 +1,74 @@
+function throughput = benchmark_instruction_throughput(periods, repetitions)
+
+% Measures the speed of the bytecode interpreter on ls2003.mod, solved with
+% block decomposition and the bytecode Gaussian elimination
+% (stack_solve_algo=5). The instructions dispatched and the time spent
+% evaluating the blocks are read from the counters of the profile (see
+% dynare_instrumentation), so that the factorizations are left out.
+%
+% INPUTS
+%   periods      [integer]  number of simulation periods (default: 2000)
+%   repetitions  [integer]  number of calls to perfect_foresight_solver (default: 10)
+%
+% OUTPUTS
+%   throughput   [double]   millions of instructions per second of evaluation
+
+% Copyright (C) 2017 Dynare Team
+%
+% This file is part of Dynare.
+%
+% Dynare is free software: you can redistribute it and/or modify
+% it under the terms of the GNU General Public License as published by
+% the Free Software Foundation, either version 3 of the License, or
+% (at your option) any later version.
+%
+% Dynare is distributed in the hope that it will be useful,
+% but WITHOUT ANY WARRANTY; without even the implied warranty of
+% MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+% GNU General Public License for more details.
+%
+% You should have received a copy of the GNU General Public License
+% along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+
+  global options_
+
+  if nargin < 1
+      periods = 2000;
+  end
+  if nargin < 2
+      repetitions = 10;
+  end
+
+  fid = fopen('ls2003_tmp.mod', 'w');
+  assert(fid > 0);
+  fprintf(fid, ['@#define block = 1\n@#define bytecode = 1\n' ...
+      '@#define solve_algo = 0\n@#define stack_solve_algo = 5\n' ...
+      '@#define periods = %d\n@#include \"ls2003.mod\"\n'], periods);
+  fclose(fid);
+  dynare('ls2003_tmp.mod', 'console')
+
+  options_.threads.bytecode = 1;
+  perfect_foresight_setup;
+  bytecode('instrumentation', 'reset');
+  bytecode('instrumentation', 'on');
+  for i = 1:repetitions
+      perfect_foresight_solver;
+  end
+  bytecode('instrumentation', 'off');
+  profile = bytecode('instrumentation', 'get');
+
+  instructions = 0;
+  seconds = 0;
+  for i = 1:length(profile.counters)
+      name = profile.counters(i).name;
+      if length(name) > 13 && strcmp(name(end-12:end), '/instructions')
+          instructions = instructions + profile.counters(i).value;
+      elseif length(name) > 19 && strcmp(name(end-18:end), '/evaluation_seconds')
+          seconds = seconds + profile.counters(i).value;
+      end
+  end
+  assert(instructions > 0 && seconds > 0);
+  throughput = instructions/seconds/1e6;
+  fprintf('periods=%d, repetitions=%d: %.0f instructions in %f seconds, %f millions of instructions per second\n', ...
+          periods, repetitions, instructions, seconds, throughput);
+end
@@ -0,0 +1,62 @@
+function elapsed = benchmark_sparse_backends(periods, backends)
+
+% Compares the sparse direct solvers of bytecode (sparse_backend option) on
+% ls2003.mod, solved with the stacked Newton method (stack_solve_algo=0).
+%
+% INPUTS
+%   periods   [integer]  number of simulation periods (default: 2000)
+%   backends  [cell]     sparse_backend values to compare (default: {'umfpack', 'klu'})
+%
+% OUTPUTS
+%   elapsed   [double]   time spent in perfect_foresight_solver for each backend, in seconds
+
+% Copyright (C) 2017 Dynare Team
+%
+% This file is part of Dynare.
+%
+% Dynare is free software: you can redistribute it and/or modify
+% it under the terms of the GNU General Public License as published by
+% the Free Software Foundation, either version 3 of the License, or
+% (at your option) any later version.
+%
+% Dynare is distributed in the hope that it will be useful,
+% but WITHOUT ANY WARRANTY; without even the implied warranty of
+% MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+% GNU General Public License for more details.
+%
+% You should have received a copy of the GNU General Public License
+% along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+
+  global M_ options_ oo_
+
+  if nargin < 1
+      periods = 2000;
+  end
+  if nargin < 2
+      backends = {'umfpack', 'klu'};
+  end
+
+  fid = fopen('ls2003_tmp.mod', 'w');
+  assert(fid > 0);
+  fprintf(fid, ['@#define block = 1\n@#define bytecode = 1\n' ...
+      '@#define solve_algo = 0\n@#define stack_solve_algo = 0\n' ...
+      '@#define periods = %d\n@#include \"ls2003.mod\"\n'], periods);
+  fclose(fid);
+  dynare('ls2003_tmp.mod', 'console')
+
+  elapsed = zeros(1, length(backends));
+  for i = 1:length(backends)
+      options_.simul.sparse_backend = backends{i};
+      perfect_foresight_setup;
+      t = tic;
+      perfect_foresight_solver;
+      elapsed(i) = toc(t);
+      % Check that all the backends give the same paths
+      if i == 1
+          endo_simul = oo_.endo_simul;
+      else
+          assert(max(max(abs(oo_.endo_simul-endo_simul))) < 1e-8);
+      end
+      fprintf('sparse_backend=%s, periods=%d: %f seconds\n', backends{i}, periods, elapsed(i));
+  end
+end
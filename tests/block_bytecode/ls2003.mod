@@ -1,3 +1,6 @@
+@#ifndef periods
+@#define periods = 20
+@#endif
 var y y_s R pie dq pie_s de A y_obs pie_obs R_obs vv ww;
 varexo e_R e_q e_ys e_pies e_A;
 
@@ -78,7 +81,7 @@ periods 1;
 values 0.5;
 end;
 
-simul(periods=20, markowitz=0, stack_solve_algo = @{stack_solve_algo});
+simul(periods=@{periods}, markowitz=0, stack_solve_algo = @{stack_solve_algo});
 /*
 rplot vv;
 rplot ww;
@@ -0,0 +1,57 @@
+// Same model as sim_endo_lead_lag_aux_vars.mod, but the leads and lags are kept in the equations by the compact_lags option
+
+var c k z_backward z_forward;
+varexo x;
+
+parameters alph gam delt bet aa;
+alph=0.5;
+gam=0.5;
+delt=0.02;
+bet=0.05;
+aa=0.5;
+
+model(bytecode, compact_lags);
+c + k - aa*x*k(-1)^alph - (1-delt)*k(-1); // Resource constraint
+c^(-gam) - (1+bet)^(-1)*(aa*alph*x(+1)*k^(alph-1) + 1 - delt)*c(+1)^(-gam); // Euler equation
+z_backward=0.4*0.5+0.2*z_backward(-1)+0.2*z_backward(-2)+0.2*z_backward(-3) + (x(-1)-1);
+z_forward=0.1*1+0.45*z_forward(+1)+0.45*z_forward(+2)+(x(+1)-1);
+end;
+
+initval;
+c = 1.2;
+k = 12;
+x = 1; %set x(0)
+z_backward=0.5;
+end;
+
+histval;
+x(0) = 1;
+k(0) = 12;
+z_backward(0) = 0.5;
+z_backward(-1) = 0.4;
+z_backward(-2) = 0.9;
+end;
+
+shocks;
+var x; %sets x(+2)
+periods 2;
+values 0.9;
+end;
+
+simul(periods=200,maxit=100);
+
+if ~oo_.deterministic_simulation.status
+   error('Perfect foresight simulation failed')
+end
+
+if M_.maximum_endo_lag ~= 3 || M_.maximum_endo_lead ~= 2 || M_.endo_nbr ~= 4
+   error('The leads and lags have been substituted by auxiliary variables')
+end
+
+base_results_aux_vars=load('sim_endo_lead_lag_aux_vars_results.mat');
+for var_name = {'c', 'k', 'z_backward', 'z_forward'}
+    if max(abs(base_results_aux_vars.oo_.endo_simul(strmatch(var_name{1},base_results_aux_vars.M_.endo_names,'exact'),1+base_results_aux_vars.M_.maximum_endo_lag:end-base_results_aux_vars.M_.maximum_endo_lead) -...
+               oo_.endo_simul(strmatch(var_name{1},M_.endo_names,'exact'),1+M_.maximum_endo_lag:end-M_.maximum_endo_lead)))>1e-8
+        error(['The simulation of ' var_name{1} ' is wrong'])
+    end
+end
@@ -0,0 +1,82 @@
+function info = bench_A_times_B_kronecker_C(number_of_threads)
+% Times A_times_B_kronecker_C against the product with the explicit Kronecker
+% product, for the shapes of its main call sites: the second order solver
+% (dyn_second_order_solver, called by dr), where A is ghxx (endo*nspred^2) and
+% B, C are Gy (nspred*nspred) or hu1 (nspred*(nspred+exo)); and the simulations
+% (simult_), where B and C are matrices of simulated states or innovations.
+
+% Copyright (C) 2017 Dynare Team
+%
+% This file is part of Dynare.
+%
+% Dynare is free software: you can redistribute it and/or modify
+% it under the terms of the GNU General Public License as published by
+% the Free Software Foundation, either version 3 of the License, or
+% (at your option) any later version.
+%
+% Dynare is distributed in the hope that it will be useful,
+% but WITHOUT ANY WARRANTY; without even the implied warranty of
+% MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+% GNU General Public License for more details.
+%
+% You should have received a copy of the GNU General Public License
+% along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+
+if ~nargin
+    number_of_threads = 1;
+end
+
+info = 1;
+
+% Each line is [endo nspred exo], the number of particles or periods being given by the last column.
+sizes = [ 50   10   3 ;
+         200   30   5 ;
+         500   50  10 ;
+         500  100  10 ];
+nrep = 3;
+
+for i=1:size(sizes,1)
+    endo = sizes(i,1); nspred = sizes(i,2); exo = sizes(i,3);
+    ghxx = randn(endo,nspred^2);
+    Gy = randn(nspred,nspred);
+    hu1 = randn(nspred,nspred+exo);
+    disp(' ')
+    disp(['endo=' int2str(endo) ', nspred=' int2str(nspred) ', exo=' int2str(exo)])
+    info = bench('ghxx*kron(Gy,hu1)', ghxx, Gy, hu1, number_of_threads, nrep) && info;
+    info = bench('ghxx*kron(hu1,hu1)', ghxx, hu1, [], number_of_threads, nrep) && info;
+    % simult_ (one period, many replications)
+    yhat = randn(nspred,100);
+    epsilon = randn(exo,100);
+    info = bench('ghxx*kron(yhat,yhat)', ghxx, yhat, [], number_of_threads, nrep) && info;
+    info = bench('ghxu*kron(yhat,epsilon)', randn(endo,nspred*exo), yhat, epsilon, number_of_threads, nrep) && info;
+end
+
+function info = bench(name, A, B, C, number_of_threads, nrep)
+tic
+for r=1:nrep
+    if isempty(C)
+        [D1, err] = A_times_B_kronecker_C(A,B,number_of_threads);
+    else
+        [D1, err] = A_times_B_kronecker_C(A,B,C,number_of_threads);
+    end
+    mexErrCheck('A_times_B_kronecker_C', err);
+end
+t1 = toc/nrep;
+try
+    tic
+    for r=1:nrep
+        if isempty(C)
+            D2 = A*kron(B,B);
+        else
+            D2 = A*kron(B,C);
+        end
+    end
+    t2 = toc/nrep;
+    d = max(max(abs(D1-D2)))/max(1,max(max(abs(D2))));
+catch
+    % Out of memory
+    t2 = NaN;
+    d = 0;
+end
+fprintf('%-24s mex: %8.4fs   A*kron: %8.4fs   relative difference: %g\n', name, t1, t2, d);
+info = d<1e-10;
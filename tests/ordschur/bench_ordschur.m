@@ -0,0 +1,47 @@
+function info = bench_ordschur(sizes)
+% Times the blocked reordering of the ordschur mex (Octave only) against the
+% unblocked LAPACK routine dtrsen (window size 0), on random real Schur forms
+% where the eigenvalues inside the unit circle are selected, as in getH,
+% lyapunov_symm and compute_Pinf_Pstar.
+
+% Copyright (C) 2017 Dynare Team
+%
+% This file is part of Dynare.
+%
+% Dynare is free software: you can redistribute it and/or modify
+% it under the terms of the GNU General Public License as published by
+% the Free Software Foundation, either version 3 of the License, or
+% (at your option) any later version.
+%
+% Dynare is distributed in the hope that it will be useful,
+% but WITHOUT ANY WARRANTY; without even the implied warranty of
+% MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+% GNU General Public License for more details.
+%
+% You should have received a copy of the GNU General Public License
+% along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+
+if ~nargin
+    sizes = [500 1000 1500 2000];
+end
+
+info = 1;
+
+for n=sizes
+    A = randn(n)/sqrt(n)*1.2;
+    [U, T] = schur(A);
+    S = abs(ordeig(T))<1;
+    tic
+    [U1, T1] = ordschur(U, T, S);
+    t1 = toc;
+    tic
+    [U2, T2] = ordschur(U, T, S, 0);
+    t2 = toc;
+    m = sum(S);
+    r1 = norm(U1*T1*U1'-A, 1)/norm(A, 1);
+    r2 = norm(U2*T2*U2'-A, 1)/norm(A, 1);
+    e1 = sort(abs(ordeig(T1(1:m,1:m))));
+    e2 = sort(abs(ordeig(T2(1:m,1:m))));
+    fprintf('n=%5d, %5d selected   blocked: %8.3fs   dtrsen: %8.3fs   residuals: %g, %g\n', n, m, t1, t2, r1, r2);
+    info = info && r1<1e-12 && all(abs(e1-e2)<1e-8);
+end
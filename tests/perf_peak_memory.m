@@ -0,0 +1,36 @@
+function kb = perf_peak_memory()
+% Returns the peak resident set size of the running MATLAB/Octave process
+% in kB, as reported by the VmHWM entry of /proc/self/status. Returns NaN
+% where this information is not available (i.e. on non-Linux systems).
+
+% Copyright (C) 2017 Dynare Team
+%
+% This file is part of Dynare.
+%
+% Dynare is free software: you can redistribute it and/or modify
+% it under the terms of the GNU General Public License as published by
+% the Free Software Foundation, either version 3 of the License, or
+% (at your option) any later version.
+%
+% Dynare is distributed in the hope that it will be useful,
+% but WITHOUT ANY WARRANTY; without even the implied warranty of
+% MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+% GNU General Public License for more details.
+%
+% You should have received a copy of the GNU General Public License
+% along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+
+kb = NaN;
+fid = fopen('/proc/self/status', 'r');
+if fid < 0
+  return
+end
+line = fgetl(fid);
+while ischar(line)
+  if strncmp(line, 'VmHWM:', 6)
+    kb = sscanf(line(7:end), '%f');
+    break
+  end
+  line = fgetl(fid);
+end
+fclose(fid);
@@ -0,0 +1,112 @@
+#!/bin/bash
+
+# Compares the .perf files written by run_perf_test_{matlab,octave}.m with the
+# reference timings stored in a baseline file.
+#
+# Usage: read_perf_files.sh "<perf files>" <baseline file> <tolerance> <min seconds>
+#        read_perf_files.sh -u "<perf files>" <baseline file>
+#
+# A measure regresses when it exceeds its baseline by more than <tolerance>
+# percent; for timings, the increase must also be larger than <min seconds>,
+# so that short runs do not fail on noise. With -u, the baseline entries of
+# the given files are replaced by the current measures instead.
+#
+# Each line of the baseline file reads
+#   <matlab|octave> <mod file> <preprocessor time> <solve time> <peak memory (kB)>
+# and lines starting with # are ignored.
+
+update=0
+if [ "$1" == "-u" ] ; then
+  update=1
+  shift
+fi
+
+files=$1
+baseline=$2
+tolerance=${3:-20}
+minsec=${4:-0.5}
+
+# Determine if we are parsing Matlab or Octave perf files
+if [ `grep -c '\.m\.perf' <<< $files` -eq 0 ]; then
+  prg='OCTAVE';
+  key='octave'
+  ext='.o.perf'
+  outfile='run_perf_test_octave_output.txt'
+else
+  prg='MATLAB';
+  key='matlab'
+  ext='.m.perf'
+  outfile='run_perf_test_matlab_output.txt'
+fi
+
+declare -i total=0;
+declare -i failed=0;
+declare -i regressed=0;
+report=""
+
+for file in $files ; do
+  ((total++))
+  modfile=${file%$ext}.mod
+  if ! grep -q ":test-result: PASS" $file 2> /dev/null ; then
+    ((failed++))
+    report="$report|     * $modfile: FAILED\n"
+    continue
+  fi
+  pre=`grep preprocessor-time $file | cut -d: -f3 | tr -d ' '`
+  sol=`grep solve-time $file | cut -d: -f3 | tr -d ' '`
+  mem=`grep peak-memory $file | cut -d: -f3 | tr -d ' '`
+
+  if [ $update -eq 1 ] ; then
+    if [ -f $baseline ] ; then
+      grep -v "^$key $modfile " $baseline > $baseline.tmp
+      mv $baseline.tmp $baseline
+    fi
+    echo "$key $modfile $pre $sol $mem" >> $baseline
+    continue
+  fi
+
+  ref=`grep "^$key $modfile " $baseline 2> /dev/null | tail -n1`
+  if [ -z "$ref" ] ; then
+    report="$report|     * $modfile: preprocessor ${pre}s, solve ${sol}s, memory ${mem}kB (no baseline)\n"
+    continue
+  fi
+  status=`awk -v pre=$pre -v sol=$sol -v mem=$mem -v tol=$tolerance -v minsec=$minsec '{
+    msg = ""
+    if (pre > $3*(1+tol/100) && pre-$3 > minsec) msg = msg " preprocessor"
+    if (sol > $4*(1+tol/100) && sol-$4 > minsec) msg = msg " solve"
+    if (mem != "NaN" && $5 != "NaN" && mem > $5*(1+tol/100)) msg = msg " memory"
+    printf "%s", msg }' <<< "$ref"`
+  line=`awk -v pre=$pre -v sol=$sol -v mem=$mem '{
+    printf "preprocessor %.2fs (%.2fs), solve %.2fs (%.2fs), memory %skB (%skB)", pre, $3, sol, $4, mem, $5 }' <<< "$ref"`
+  if [ -n "$status" ] ; then
+    ((regressed++))
+    report="$report|     * $modfile: REGRESSION ($status ): $line\n"
+  else
+    report="$report|     * $modfile: $line\n"
+  fi
+done
+
+if [ $update -eq 1 ] ; then
+  (grep '^#' $baseline; grep -v '^#' $baseline | LC_ALL=C sort) > $baseline.tmp
+  mv $baseline.tmp $baseline
+  echo "Updated $baseline"
+  exit $failed
+fi
+
+# Print Output
+echo '================================================'  > $outfile
+echo 'DYNARE MAKE CHECK-PERF '$prg' RESULTS'            >> $outfile
+echo '================================================' >> $outfile
+echo '|      TOTAL: '$total                             >> $outfile
+echo '|       FAIL: '$failed                            >> $outfile
+echo '| REGRESSION: '$regressed                         >> $outfile
+echo '| TOLERANCE: '$tolerance'% (and '$minsec's for timings)' >> $outfile
+echo '|'                                                >> $outfile
+echo '| CURRENT (BASELINE) MEASURES:'                   >> $outfile
+printf "$report"                                        >> $outfile
+echo                                                    >> $outfile
+cat $outfile
+
+if [ $failed -gt 0 ] || [ $regressed -gt 0 ] ; then
+  exit 1
+fi
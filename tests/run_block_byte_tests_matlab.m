@@ -50,7 +50,7 @@ for blockFlag = 0:1
             solve_algos = [1:4 6:8];
             stack_solve_algos = 0:4;
         else
-            solve_algos = 1:8;
+            solve_algos = 1:9;
             stack_solve_algos = 0:5;
         end
         if has_optimization_toolbox
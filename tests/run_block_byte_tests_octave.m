@@ -54,7 +54,7 @@ for blockFlag = 0:1
             solve_algos = [0:4 6 8];
             stack_solve_algos = [0 1 3 4];
         else
-            solve_algos = [0:6 8];
+            solve_algos = [0:6 8 9];
             stack_solve_algos = [0 1 3:5];
         endif
 
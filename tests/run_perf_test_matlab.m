@@ -0,0 +1,71 @@
+% Copyright (C) 2017 Dynare Team
+%
+% This file is part of Dynare.
+%
+% Dynare is free software: you can redistribute it and/or modify
+% it under the terms of the GNU General Public License as published by
+% the Free Software Foundation, either version 3 of the License, or
+% (at your option) any later version.
+%
+% Dynare is distributed in the hope that it will be useful,
+% but WITHOUT ANY WARRANTY; without even the implied warranty of
+% MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+% GNU General Public License for more details.
+%
+% You should have received a copy of the GNU General Public License
+% along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+
+% See run_perf_test_octave.m for how the timings are split.
+
+top_test_dir = getenv('TOP_TEST_DIR');
+addpath(top_test_dir);
+addpath([top_test_dir filesep '..' filesep 'matlab']);
+
+% Test Dynare Version
+if ~strcmp(dynare_version(), getenv('DYNARE_VERSION'))
+  error('Incorrect version of Dynare is being tested')
+end
+
+% Run the MOD file listed in PERFMODFILES
+[modfile, name] = strtok(getenv('FILESTEM'));
+[directory, testfile, ext] = fileparts([top_test_dir '/' modfile]);
+cd(directory);
+
+disp('');
+disp(['***  PERFORMANCE TEST: ' modfile ' ***']);
+
+tic;
+save(['wsMat' testfile '.mat']);
+try
+  dynare([testfile ext], 'console')
+  solve_time = toc(tic0);
+  total_time = toc;
+  testFailed = false;
+catch exception
+  printMakeCheckMatlabErrMsg(strtok(getenv('FILESTEM')), exception);
+  testFailed = true;
+end
+peak_memory = perf_peak_memory();
+top_test_dir = getenv('TOP_TEST_DIR');
+[modfile, name] = strtok(getenv('FILESTEM'));
+[directory, testfile, ext] = fileparts([top_test_dir '/' modfile]);
+load(['wsMat' testfile '.mat']);
+delete(['wsMat' testfile '.mat']);
+
+cd(top_test_dir);
+name = strtok(getenv('FILESTEM'));
+fid = fopen([name '.m.perf'], 'w');
+if fid < 0
+  error(['ERROR: problem opening file ' name '.m.perf for writing....']);
+end
+if testFailed
+  fprintf(fid,':test-result: FAIL\n');
+else
+  fprintf(fid,':test-result: PASS\n');
+  fprintf(fid,':preprocessor-time: %f\n', total_time - solve_time);
+  fprintf(fid,':solve-time: %f\n', solve_time);
+  fprintf(fid,':peak-memory: %.0f\n', peak_memory);
+end
+fclose(fid);
+warning off
+exit
@@ -0,0 +1,81 @@
+## Copyright (C) 2017 Dynare Team
+##
+## This file is part of Dynare.
+##
+## Dynare is free software: you can redistribute it and/or modify
+## it under the terms of the GNU General Public License as published by
+## the Free Software Foundation, either version 3 of the License, or
+## (at your option) any later version.
+##
+## Dynare is distributed in the hope that it will be useful,
+## but WITHOUT ANY WARRANTY; without even the implied warranty of
+## MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+## GNU General Public License for more details.
+##
+## You should have received a copy of the GNU General Public License
+## along with Dynare.  If not, see <http://www.gnu.org/licenses/>.
+
+## Implementation notes:
+##
+## Runs one MOD file of PERFMODFILES and writes its timings to a .o.perf
+## file, which is compared with perf_baselines.txt by read_perf_files.sh.
+##
+## The solve time is read from the 'tic0' timer that the driver generated by
+## the preprocessor starts on its first line; whatever remains of the time
+## spent in the call to Dynare is accounted as preprocessor time. The
+## workspace is saved and reloaded around the call, as in run_test_octave.m.
+
+load_octave_packages
+
+top_test_dir = getenv('TOP_TEST_DIR');
+addpath(top_test_dir);
+addpath([top_test_dir filesep '..' filesep 'matlab']);
+
+## Test Dynare Version
+if !strcmp(dynare_version(), getenv("DYNARE_VERSION"))
+    error("Incorrect version of Dynare is being tested")
+endif
+
+## Ask gnuplot to create graphics in text mode
+graphics_toolkit gnuplot;
+setenv("GNUTERM", "dumb");
+
+name = getenv("FILESTEM");
+[directory, testfile, ext] = fileparts([top_test_dir '/' name]);
+cd(directory);
+
+printf("\n***  PERFORMANCE TEST: %s ***\n", name);
+
+tic;
+save(['wsOct' testfile '.mat']);
+try
+  dynare([testfile ext])
+  solve_time = toc(tic0);
+  total_time = toc;
+  testFailed = false;
+catch
+  printMakeCheckOctaveErrMsg(getenv("FILESTEM"), lasterror);
+  testFailed = true;
+end_try_catch
+peak_memory = perf_peak_memory();
+top_test_dir = getenv('TOP_TEST_DIR');
+name = getenv("FILESTEM");
+[directory, testfile, ext] = fileparts([top_test_dir '/' name]);
+load(['wsOct' testfile '.mat']);
+delete(['wsOct' testfile '.mat']);
+
+cd(top_test_dir);
+fid = fopen([name '.o.perf'], 'w+');
+if testFailed
+  fprintf(fid,':test-result: FAIL\n');
+else
+  fprintf(fid,':test-result: PASS\n');
+  fprintf(fid,':preprocessor-time: %f\n', total_time - solve_time);
+  fprintf(fid,':solve-time: %f\n', solve_time);
+  fprintf(fid,':peak-memory: %.0f\n', peak_memory);
+end
+fclose(fid);
+
+## Local variables:
+## mode: Octave
+## End: